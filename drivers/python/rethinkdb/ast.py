@@ -1039,6 +1039,9 @@ class Table(RqlQuery):
     def sync(self, *args):
         return Sync(self, *args)
 
+    def truncate(self, *args, **kwargs):
+        return Truncate(self, *args, **kwargs)
+
     def get_intersecting(self, *args, **kwargs):
         return GetIntersecting(self, *args, **kwargs)
 
@@ -1298,6 +1301,10 @@ class Sync(RqlMethodQuery):
     tt = pTerm.SYNC
     st = 'sync'
 
+class Truncate(RqlMethodQuery):
+    tt = pTerm.TRUNCATE
+    st = 'truncate'
+
 class Branch(RqlTopLevelQuery):
     tt = pTerm.BRANCH
     st = "branch"
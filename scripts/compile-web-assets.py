@@ -2,6 +2,9 @@
 
 from __future__ import print_function, division
 
+import gzip
+import hashlib
+import io
 import os
 import sys
 import itertools
@@ -35,14 +38,46 @@ prelude = """
 #include <string>
 """
 
+# Assets that are worth serving gzipped; the others are already compressed.
+compressible_extensions = ['.html', '.js', '.css', '.svg', '.ttf', '.eot', '.ico']
+
 def write_assets(asset_root, assets):
 
-    print('std::map<std::string, const std::string> static_web_assets = {')
-    for i, asset in enumerate(assets):
+    contents = [(asset, open(os.path.join(asset_root, asset), "rb").read())
+                for asset in assets]
+
+    write_map('static_web_assets', contents)
+
+    # Compressing the assets here saves the server from gzipping every response.
+    # Only the ones that get noticeably smaller are included.
+    gzipped = []
+    for asset, data in contents:
+        if os.path.splitext(asset)[1] in compressible_extensions:
+            compressed = gzip_bytes(data)
+            if len(compressed) < len(data) * 9 // 10:
+                gzipped.append((asset, compressed))
+    write_map('static_web_assets_gzipped', gzipped)
+
+    print('std::map<std::string, const std::string> static_web_asset_etags = {')
+    for asset, data in contents:
+        etag = '"' + hashlib.sha1(data).hexdigest()[:16] + '"'
+        print('    { ' + encode('/' + asset) + ', ' + encode(etag) + ' },')
+    print('};')
+
+def gzip_bytes(data):
+    out = io.BytesIO()
+    # A fixed mtime keeps the output the same from one build to the next.
+    with gzip.GzipFile(fileobj=out, mode='wb', compresslevel=9, mtime=0) as f:
+        f.write(data)
+    return out.getvalue()
+
+def write_map(name, contents):
+
+    print('std::map<std::string, const std::string> ' + name + ' = {')
+    for asset, data in contents:
 
         print('    { ' + encode('/' + asset) + ', {', end='')
 
-        data = open(os.path.join(asset_root, asset), "rb").read()
         position = 0 # track the position to keep lines short
         trigraph = 0 # track consecutive question marks to avoid writing trigraphs
         prev_e = None # track the previous character to avoid tacking on hex digits
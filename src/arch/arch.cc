@@ -23,3 +23,9 @@ void co_write(file_t *file, int64_t offset, size_t length, void *buf,
     file->write_async(offset, length, buf, account, &adapter, wrap_in_datasyncs);
     coro_t::wait();
 }
+
+void co_datasync(file_t *file) {
+    io_coroutine_adapter_t adapter;
+    file->datasync_async(&adapter);
+    coro_t::wait();
+}
@@ -3,6 +3,7 @@
 
 #include <string.h>
 
+#include "arch/runtime/thread_pool.hpp"
 #include "config/args.hpp"
 #include "utils.hpp"
 
@@ -98,6 +99,8 @@ blocker_pool_t::blocker_pool_t(int nthreads, linux_event_queue_t *_queue)
         // fails.
         UNUSED int ignored_res = pthread_attr_setstacksize(&attr, COROUTINE_STACK_SIZE);
 
+        linux_thread_pool_t::set_helper_thread_affinity(&attr);
+
         res = pthread_create(&threads[i], &attr,
             &blocker_pool_t::event_loop, reinterpret_cast<void*>(this));
         guarantee_xerr(res == 0, res, "Could not create blocker-pool thread.");
@@ -9,6 +9,10 @@
 #include <unistd.h>
 #include <libgen.h>
 #include <limits.h>
+#ifdef __linux__
+#include <linux/falloc.h>
+#include <linux/fs.h>
+#endif
 
 #include <algorithm>
 #include <functional>
@@ -16,7 +20,11 @@
 #include "arch/types.hpp"
 #include "arch/runtime/thread_pool.hpp"
 #include "arch/runtime/runtime.hpp"
+#include "arch/io/disk/coalescing.hpp"
+#include "arch/io/disk/datasync_coordinator.hpp"
 #include "arch/io/disk/filestat.hpp"
+#include "arch/io/disk/latency_stats.hpp"
+#include "arch/io/disk/native.hpp"
 #include "arch/io/disk/pool.hpp"
 #include "arch/io/disk/conflict_resolving.hpp"
 #include "arch/io/disk/stats.hpp"
@@ -46,14 +54,41 @@ public:
     linux_disk_manager_t(linux_event_queue_t *queue,
                          int batch_factor,
                          int max_concurrent_io_requests,
+                         io_backend_mode_t io_backend,
                          perfmon_collection_t *stats) :
         stack_stats(stats, "stack"),
         conflict_resolver(stats),
         accounter(batch_factor),
         backend_stats(stats, "backend", accounter.producer),
-        backend(queue, backend_stats.producer, max_concurrent_io_requests),
+        coalescer(stats, backend_stats.producer, IO_COALESCING_MAX_BYTES),
+        datasync_coordinator(stats),
         outstanding_txn(0)
     {
+        switch (io_backend) {
+        case io_backend_mode_t::pool:
+            pool_backend.init(new pool_diskmgr_t(queue, coalescer.producer,
+                                                 max_concurrent_io_requests));
+            pool_backend->done_fun = std::bind(&coalescing_diskmgr_t::done,
+                                               &coalescer, ph::_1);
+            break;
+        case io_backend_mode_t::io_uring:
+            native_backend.init(new native_diskmgr_t(queue, coalescer.producer,
+                                                     max_concurrent_io_requests,
+                                                     native_diskmgr_t::IO_URING));
+            break;
+        case io_backend_mode_t::aio:
+            native_backend.init(new native_diskmgr_t(queue, coalescer.producer,
+                                                     max_concurrent_io_requests,
+                                                     native_diskmgr_t::AIO));
+            break;
+        default:
+            unreachable();
+        }
+        if (native_backend.has()) {
+            native_backend->done_fun = std::bind(&coalescing_diskmgr_t::done,
+                                                 &coalescer, ph::_1);
+        }
+
         /* Hook up the `submit_fun`s of the parts of the IO stack that are above the
         queue. (The parts below the queue use the `passive_producer_t` interface instead
         of a callback function.) */
@@ -62,8 +97,8 @@ public:
         conflict_resolver.submit_fun = std::bind(&accounting_diskmgr_t::submit,
                                                  &accounter, ph::_1);
 
-        /* Hook up everything's `done_fun`. */
-        backend.done_fun = std::bind(&stats_diskmgr_2_t::done, &backend_stats, ph::_1);
+        /* Hook up everything's `done_fun`. (The backend's was set above.) */
+        coalescer.done_fun = std::bind(&stats_diskmgr_2_t::done, &backend_stats, ph::_1);
         backend_stats.done_fun = std::bind(&accounting_diskmgr_t::done, &accounter, ph::_1);
         accounter.done_fun = std::bind(&conflict_resolving_diskmgr_t::done,
                                        &conflict_resolver, ph::_1);
@@ -77,8 +112,17 @@ public:
                 outstanding_txn);
     }
 
-    void *create_account(int pri, int outstanding_requests_limit) {
-        return new accounting_diskmgr_t::account_t(&accounter, pri, outstanding_requests_limit);
+    void *create_account(
+            int pri, int outstanding_requests_limit,
+            const std::shared_ptr<accounting_diskmgr_weight_group_t> &weight_group) {
+        return new accounting_diskmgr_t::account_t(&accounter, pri,
+                                                   outstanding_requests_limit,
+                                                   weight_group);
+    }
+
+    void set_io_weight(accounting_diskmgr_weight_group_t *weight_group, double weight) {
+        assert_thread();
+        accounter.set_weight(weight_group, weight);
     }
 
     void delayed_destroy(void *_account) {
@@ -101,12 +145,13 @@ public:
 
     void submit_write(fd_t fd, const void *buf, size_t count, int64_t offset,
                       void *account, linux_iocallback_t *cb,
-                      bool wrap_in_datasyncs) {
+                      bool wrap_in_datasyncs, file_latency_stats_t *latency_stats) {
         threadnum_t calling_thread = get_thread_id();
 
         action_t *a = new action_t(calling_thread, cb);
         a->make_write(fd, buf, count, offset, wrap_in_datasyncs);
         a->account = static_cast<accounting_diskmgr_t::account_t *>(account);
+        a->latency_stats = latency_stats;
 
         do_on_thread(home_thread(),
                      std::bind(&linux_disk_manager_t::submit_action_to_stack_stats, this,
@@ -127,16 +172,39 @@ public:
                                a));
     }
 
+    void submit_discard(fd_t fd, int64_t offset, size_t count,
+                        void *account, linux_iocallback_t *cb) {
+        threadnum_t calling_thread = get_thread_id();
+
+        action_t *a = new action_t(calling_thread, cb);
+        a->make_discard(fd, offset, count);
+        a->account = static_cast<accounting_diskmgr_t::account_t *>(account);
+
+        do_on_thread(home_thread(),
+                     std::bind(&linux_disk_manager_t::submit_action_to_stack_stats, this,
+                               a));
+    }
+
+    // Datasyncs don't go through the I/O stack, because they don't conflict with
+    // anything and the datasync coordinator batches them on its own.
+    void submit_datasync(fd_t fd, boost::optional<dev_t> file_system,
+                         linux_iocallback_t *cb, file_latency_stats_t *latency_stats) {
+        coro_t::spawn_sometime(std::bind(&linux_disk_manager_t::do_datasync, this,
+                                         fd, file_system, cb, latency_stats));
+    }
+
 #ifndef USE_WRITEV
 #error "USE_WRITEV not defined.  Did you include pool.hpp?"
 #elif USE_WRITEV
     void submit_writev(fd_t fd, scoped_array_t<iovec> &&bufs, size_t count,
-                       int64_t offset, void *account, linux_iocallback_t *cb) {
+                       int64_t offset, void *account, linux_iocallback_t *cb,
+                       file_latency_stats_t *latency_stats) {
         threadnum_t calling_thread = get_thread_id();
 
         action_t *a = new action_t(calling_thread, cb);
         a->make_writev(fd, std::move(bufs), count, offset);
         a->account = static_cast<accounting_diskmgr_t::account_t *>(account);
+        a->latency_stats = latency_stats;
 
         do_on_thread(home_thread(),
                      std::bind(&linux_disk_manager_t::submit_action_to_stack_stats, this,
@@ -144,12 +212,14 @@ public:
     }
 #endif  // USE_WRITEV
 
-    void submit_read(fd_t fd, void *buf, size_t count, int64_t offset, void *account, linux_iocallback_t *cb) {
+    void submit_read(fd_t fd, void *buf, size_t count, int64_t offset, void *account,
+                     linux_iocallback_t *cb, file_latency_stats_t *latency_stats) {
         threadnum_t calling_thread = get_thread_id();
 
         action_t *a = new action_t(calling_thread, cb);
         a->make_read(fd, buf, count, offset);
         a->account = static_cast<accounting_diskmgr_t::account_t*>(account);
+        a->latency_stats = latency_stats;
 
         do_on_thread(home_thread(),
                      std::bind(&linux_disk_manager_t::submit_action_to_stack_stats, this,
@@ -175,13 +245,37 @@ public:
     }
 
 private:
+    void do_datasync(fd_t fd, boost::optional<dev_t> file_system,
+                     linux_iocallback_t *cb, file_latency_stats_t *latency_stats) {
+        const ticks_t submit_time = get_ticks();
+        int errcode;
+        {
+            on_thread_t thread_switcher(home_thread());
+            outstanding_txn++;
+            errcode = datasync_coordinator.datasync(fd, file_system);
+            outstanding_txn--;
+            if (latency_stats != NULL) {
+                latency_stats->datasync.record(get_ticks() - submit_time);
+            }
+        }
+        if (errcode == 0) {
+            cb->on_io_complete();
+        } else {
+            cb->on_io_failure(errcode, 0, 0);
+        }
+    }
+
     /* These fields describe the entire IO stack. At the top level, we allocate a new
     action_t object for each operation and record its callback. Then it passes through
     the conflict resolver, which enforces ordering constraints between IO operations by
     holding back operations that must be run after other, currently-running, operations.
     Then it goes to the account manager, which queues up running IO operations according
     to which account they are part of. Finally the "backend" pops the IO operations
-    from the queue.
+    from the queue. Depending on `--io-backend` that's either a `pool_diskmgr_t`, which
+    runs blocking syscalls on a thread pool, or a `native_diskmgr_t`, which submits
+    them in batches through io_uring or kernel AIO. Exactly one of the two is set.
+    Right above the backend, the coalescer merges runs of adjacent writes into single
+    vectored writes.
 
     At two points in the process--once as soon as it is submitted, and again right
     as the backend pops it off the queue--its statistics are recorded. The "stack stats"
@@ -194,31 +288,72 @@ private:
     conflict_resolving_diskmgr_t conflict_resolver;
     accounting_diskmgr_t accounter;
     stats_diskmgr_2_t backend_stats;
-    pool_diskmgr_t backend;
+    coalescing_diskmgr_t coalescer;
+    scoped_ptr_t<pool_diskmgr_t> pool_backend;
+    scoped_ptr_t<native_diskmgr_t> native_backend;
 
+    datasync_coordinator_t datasync_coordinator;
 
     intptr_t outstanding_txn;
 
     DISABLE_COPYING(linux_disk_manager_t);
 };
 
+io_backend_mode_t choose_supported_io_backend(io_backend_mode_t requested) {
+    if (requested == io_backend_mode_t::io_uring) {
+        if (native_diskmgr_t::is_supported(native_diskmgr_t::IO_URING)) {
+            return io_backend_mode_t::io_uring;
+        }
+        logWRN("io_uring is not available on this system. Trying kernel AIO instead.");
+        requested = io_backend_mode_t::aio;
+    }
+    if (requested == io_backend_mode_t::aio) {
+        if (native_diskmgr_t::is_supported(native_diskmgr_t::AIO)) {
+            return io_backend_mode_t::aio;
+        }
+        logWRN("Kernel AIO is not available on this system. Using the thread pool "
+               "I/O backend instead.");
+        requested = io_backend_mode_t::pool;
+    }
+    return requested;
+}
+
 io_backender_t::io_backender_t(file_direct_io_mode_t _direct_io_mode,
-                               int max_concurrent_io_requests)
+                               int max_concurrent_io_requests,
+                               io_backend_mode_t requested_io_backend)
     : direct_io_mode(_direct_io_mode),
-      diskmgr(new linux_disk_manager_t(&linux_thread_pool_t::get_thread()->queue,
-                                       DEFAULT_IO_BATCH_FACTOR,
-                                       max_concurrent_io_requests,
-                                       &stats)) { }
+      io_backend(choose_supported_io_backend(requested_io_backend)) {
+    if (io_backend == io_backend_mode_t::aio
+        && direct_io_mode != file_direct_io_mode_t::direct_desired) {
+        // Kernel AIO only runs asynchronously on files opened with O_DIRECT.
+        // Otherwise `io_submit` blocks the event loop until the I/O is done.
+        logWRN("The 'aio' I/O backend is only asynchronous with --direct-io. "
+               "Expect degraded performance.");
+    }
+    diskmgr.init(new linux_disk_manager_t(&linux_thread_pool_t::get_thread()->queue,
+                                          DEFAULT_IO_BATCH_FACTOR,
+                                          max_concurrent_io_requests,
+                                          io_backend,
+                                          &stats));
+}
 
 io_backender_t::~io_backender_t() { }
 
 file_direct_io_mode_t io_backender_t::get_direct_io_mode() const { return direct_io_mode; }
 
+io_backend_mode_t io_backender_t::get_io_backend() const { return io_backend; }
+
 
 /* Disk file object */
 
-linux_file_t::linux_file_t(scoped_fd_t &&_fd, int64_t _file_size, linux_disk_manager_t *_diskmgr)
-    : fd(std::move(_fd)), file_size(_file_size), diskmgr(_diskmgr) {
+linux_file_t::linux_file_t(scoped_fd_t &&_fd, int64_t _file_size,
+                           boost::optional<dev_t> _file_system,
+                           linux_disk_manager_t *_diskmgr)
+    : fd(std::move(_fd)), file_size(_file_size), file_system(_file_system),
+      diskmgr(_diskmgr),
+      latency_stats(NULL),
+      io_weight_group(std::make_shared<accounting_diskmgr_weight_group_t>()),
+      discard_supported(true) {
     // TODO: Why do we care whether we're in a thread pool?  (Maybe it's that you can't create a
     // file_account_t outside of the thread pool?  But they're associated with the diskmgr,
     // aren't they?)
@@ -257,6 +392,41 @@ void linux_file_t::set_file_size(int64_t size) {
     file_size = size;
 }
 
+void linux_file_t::discard(int64_t offset, int64_t length) {
+    assert_thread();
+    rassert(diskmgr, "No diskmgr has been constructed (are we running without an event queue?)");
+    rassert(divides(DEVICE_BLOCK_SIZE, offset));
+    rassert(divides(DEVICE_BLOCK_SIZE, length));
+    if (!discard_supported) {
+        return;
+    }
+
+    struct discard_callback_t : public linux_iocallback_t {
+        void on_io_complete() {
+            delete this;
+        }
+
+        // Discards are only a hint, so it's not worth crashing over them.  We
+        // simply stop sending more.
+        void on_io_failure(int errsv, int64_t, int64_t) {
+            if (parent->discard_supported) {
+                parent->discard_supported = false;
+                logNTC("Not discarding freed space in the database file anymore: %s",
+                       errno_string(errsv).c_str());
+            }
+            delete this;
+        }
+
+        linux_file_t *parent;
+        auto_drainer_t::lock_t lock;
+    };
+    discard_callback_t *discard_callback = new discard_callback_t();
+    discard_callback->parent = this;
+    discard_callback->lock = file_size_ops_drainer.lock();
+    diskmgr->submit_discard(fd.get(), offset, length, default_account->get_account(),
+                            discard_callback);
+}
+
 // For growing in large chunks at a time.
 int64_t chunk_factor(int64_t size) {
     // x is at most 6.25% of size.
@@ -277,7 +447,7 @@ void linux_file_t::read_async(int64_t offset, size_t length, void *buf, file_acc
     verify_aligned_file_access(file_size, offset, length, buf);
     diskmgr->submit_read(fd.get(), buf, length, offset,
         account == DEFAULT_DISK_ACCOUNT ? default_account->get_account() : account->get_account(),
-        callback);
+        callback, latency_stats);
 }
 
 void linux_file_t::write_async(int64_t offset, size_t length, const void *buf,
@@ -288,7 +458,12 @@ void linux_file_t::write_async(int64_t offset, size_t length, const void *buf,
     diskmgr->submit_write(fd.get(), buf, length, offset,
                           account == DEFAULT_DISK_ACCOUNT ? default_account->get_account() : account->get_account(),
                           callback,
-                          wrap_in_datasyncs == WRAP_IN_DATASYNCS);
+                          wrap_in_datasyncs == WRAP_IN_DATASYNCS, latency_stats);
+}
+
+void linux_file_t::datasync_async(linux_iocallback_t *callback) {
+    rassert(diskmgr, "No diskmgr has been constructed (are we running without an event queue?)");
+    diskmgr->submit_datasync(fd.get(), file_system, callback, latency_stats);
 }
 
 void linux_file_t::writev_async(int64_t offset, size_t length,
@@ -305,7 +480,7 @@ void linux_file_t::writev_async(int64_t offset, size_t length,
                            account == DEFAULT_DISK_ACCOUNT
                            ? default_account->get_account()
                            : account->get_account(),
-                           callback);
+                           callback, latency_stats);
 #else  // USE_WRITEV
     // OS X doesn't have pwritev.  Using lseek followed by a writev would
     // require adding a mutex for OS X.  We simply break up the writes into
@@ -339,7 +514,7 @@ void linux_file_t::writev_async(int64_t offset, size_t length,
                               ? default_account->get_account()
                               : account->get_account(),
                               intermediate_cb,
-                              false);
+                              false, latency_stats);
         partial_offset += bufs[i].iov_len;
     }
     guarantee(partial_offset - offset == static_cast<int64_t>(length));
@@ -360,7 +535,8 @@ bool linux_file_t::coop_lock_and_check() {
 
 void *linux_file_t::create_account(int priority, int outstanding_requests_limit) {
     assert_thread();
-    return diskmgr->create_account(priority, outstanding_requests_limit);
+    return diskmgr->create_account(priority, outstanding_requests_limit,
+                                   io_weight_group);
 }
 
 void linux_file_t::destroy_account(void *account) {
@@ -368,6 +544,17 @@ void linux_file_t::destroy_account(void *account) {
     diskmgr->destroy_account(account);
 }
 
+void linux_file_t::set_latency_stats(file_latency_stats_t *stats) {
+    assert_thread();
+    latency_stats = stats;
+}
+
+void linux_file_t::set_io_weight(double weight) {
+    rassert(diskmgr, "No diskmgr has been constructed (are we running without an event queue?)");
+    on_thread_t thread_switcher(diskmgr->home_thread());
+    diskmgr->set_io_weight(io_weight_group.get(), weight);
+}
+
 
 
 linux_file_t::~linux_file_t() {
@@ -517,11 +704,20 @@ file_open_result_t open_file(const char *path, const int mode, io_backender_t *b
 
     const int64_t file_size = get_file_size(fd.get());
 
+    // Only regular files can share their datasyncs with other files on the same file
+    // system.  The st_dev of a block device is the file system of its device node.
+    boost::optional<dev_t> file_system;
+    struct stat st;
+    if (fstat(fd.get(), &st) == 0 && S_ISREG(st.st_mode)) {
+        file_system = st.st_dev;
+    }
+
     // Call fsync() on the parent directory to guarantee that the newly
     // created file's directory entry is persisted to disk.
     warn_fsync_parent_directory(path);
 
-    out->init(new linux_file_t(std::move(fd), file_size, backender->get_diskmgr_ptr()));
+    out->init(new linux_file_t(std::move(fd), file_size, file_system,
+                               backender->get_diskmgr_ptr()));
 
     return open_res;
 }
@@ -583,6 +779,46 @@ int perform_datasync(fd_t fd) {
 #endif  // __MACH__
 }
 
+// Upon error, returns the errno value.
+int perform_file_system_sync(fd_t fd) {
+#ifdef __linux__
+    int res = syncfs(fd);
+    return res == -1 ? get_errno() : 0;
+#else
+    (void)fd;
+    return ENOSYS;
+#endif
+}
+
+#ifdef __linux__
+int perform_discard(fd_t fd, int64_t offset, int64_t length) {
+    int res;
+    do {
+        res = fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, length);
+    } while (res == -1 && get_errno() == EINTR);
+    if (res == 0) {
+        return 0;
+    }
+
+    // Older kernels can't punch holes into block devices, but can discard them.
+    int errsv = get_errno();
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISBLK(st.st_mode)) {
+        uint64_t range[2] = { static_cast<uint64_t>(offset),
+                              static_cast<uint64_t>(length) };
+        if (ioctl(fd, BLKDISCARD, range) == 0) {
+            return 0;
+        }
+        errsv = get_errno();
+    }
+    return errsv;
+}
+#else  // __linux__
+int perform_discard(UNUSED fd_t fd, UNUSED int64_t offset, UNUSED int64_t length) {
+    return EOPNOTSUPP;
+}
+#endif  // __linux__
+
 MUST_USE int fsync_parent_directory(const char *path) {
     // Locate the parent directory
     char absolute_path[PATH_MAX];
@@ -2,6 +2,13 @@
 #ifndef ARCH_IO_DISK_HPP_
 #define ARCH_IO_DISK_HPP_
 
+#include <sys/types.h>
+
+#include <memory>
+
+#include "errors.hpp"
+#include <boost/optional.hpp>
+
 #include "arch/io/io_utils.hpp"
 #include "arch/types.hpp"
 #include "concurrency/auto_drainer.hpp"
@@ -21,6 +28,7 @@ struct iovec;
 
 class linux_iocallback_t;
 
+class accounting_diskmgr_weight_group_t;
 class linux_disk_manager_t;
 
 class io_backender_t : public home_thread_mixin_debug_only_t {
@@ -29,13 +37,17 @@ public:
     // stops us from specifying this on a file-by-file basis, but right now there's no desire for
     // that.  See https://github.com/rethinkdb/rethinkdb/issues/97#issuecomment-19778177 .
     io_backender_t(file_direct_io_mode_t direct_io_mode,
-                   int max_concurrent_io_requests = DEFAULT_MAX_CONCURRENT_IO_REQUESTS);
+                   int max_concurrent_io_requests = DEFAULT_MAX_CONCURRENT_IO_REQUESTS,
+                   io_backend_mode_t io_backend = io_backend_mode_t::pool);
     ~io_backender_t();
     linux_disk_manager_t *get_diskmgr_ptr() { return diskmgr.get(); }
     file_direct_io_mode_t get_direct_io_mode() const;
+    // The backend that is actually in use, after falling back from unsupported ones.
+    io_backend_mode_t get_io_backend() const;
 
 protected:
     const file_direct_io_mode_t direct_io_mode;
+    const io_backend_mode_t io_backend;
     perfmon_collection_t stats;
     scoped_ptr_t<linux_disk_manager_t> diskmgr;
 
@@ -87,26 +99,46 @@ public:
     void writev_async(int64_t offset, size_t length, scoped_array_t<iovec> &&bufs,
                       file_account_t *account, linux_iocallback_t *cb);
 
+    void datasync_async(linux_iocallback_t *cb);
+
+    void discard(int64_t offset, int64_t length);
+
     bool coop_lock_and_check();
 
     void *create_account(int priority, int outstanding_requests_limit);
     void destroy_account(void *account);
 
+    void set_io_weight(double weight);
+
+    void set_latency_stats(file_latency_stats_t *stats);
+
     ~linux_file_t();
 
 private:
-    linux_file_t(scoped_fd_t &&fd, int64_t file_size, linux_disk_manager_t *diskmgr);
+    linux_file_t(scoped_fd_t &&fd, int64_t file_size,
+                 boost::optional<dev_t> file_system, linux_disk_manager_t *diskmgr);
     friend file_open_result_t open_file(const char *path, int mode,
                                         io_backender_t *backender,
                                         scoped_ptr_t<file_t> *out);
 
     scoped_fd_t fd;
     int64_t file_size;
+    // The file system the file lives on, if it's a regular file.
+    boost::optional<dev_t> file_system;
 
     linux_disk_manager_t *diskmgr;
 
+    file_latency_stats_t *latency_stats;
+
+    // The weight group of the file's accounts.
+    std::shared_ptr<accounting_diskmgr_weight_group_t> io_weight_group;
+
     scoped_ptr_t<file_account_t> default_account;
 
+    // Set to false once a discard fails, since that usually means that the file
+    // system or device doesn't support them.
+    bool discard_supported;
+
     // Used to make sure we do not destruct the linux_file_t until all file size
     // operations have completed.
     auto_drainer_t file_size_ops_drainer;
@@ -138,6 +170,14 @@ void verify_aligned_file_access(int64_t file_size, int64_t offset, size_t length
 // Makes blocking syscalls.  Upon error, returns the errno value.
 int perform_datasync(fd_t fd);
 
+// Makes everything written to the file system that `fd` lives on durable.  Makes
+// blocking syscalls.  Upon error, returns the errno value.
+int perform_file_system_sync(fd_t fd);
+
+// Deallocates the given range of the file, or discards it if the file is a block
+// device.  Makes blocking syscalls.  Upon error, returns the errno value.
+int perform_discard(fd_t fd, int64_t offset, int64_t length);
+
 // Calls fsync() on the parent directory of the given path.
 // Returns the errno value in case of an error and 0 otherwise.
 MUST_USE int fsync_parent_directory(const char *path);
@@ -10,10 +10,10 @@ struct accounting_diskmgr_eager_account_t : public semaphore_available_callback_
     typedef accounting_diskmgr_action_t action_t;
 
     accounting_diskmgr_eager_account_t(accounting_diskmgr_t *par,
-                                       int pri,
+                                       double shares,
                                        int outstanding_requests_limit) :
         outstanding_requests_limiter(outstanding_requests_limit == UNLIMITED_OUTSTANDING_REQUESTS ? SEMAPHORE_NO_LIMIT : outstanding_requests_limit),
-        account(&par->queue, &queue, pri),
+        account(&par->queue, &queue, shares),
         accounter_lock(par->get_auto_drainer()) {
         rassert(outstanding_requests_limit == UNLIMITED_OUTSTANDING_REQUESTS || outstanding_requests_limit > 0);
     }
@@ -30,6 +30,9 @@ struct accounting_diskmgr_eager_account_t : public semaphore_available_callback_
     co_semaphore_t *get_outstanding_requests_limiter() {
         return &outstanding_requests_limiter;
     }
+    void set_shares(double shares) {
+        account.set_shares(shares);
+    }
 
 private:
     // It would be nice if we could just use a limited_fifo_queue to
@@ -47,14 +50,22 @@ private:
     DISABLE_COPYING(accounting_diskmgr_eager_account_t);
 };
 
-accounting_diskmgr_account_t::accounting_diskmgr_account_t(accounting_diskmgr_t *_par,
-                                                           int _pri,
-                                                           int _outstanding_requests_limit)
+accounting_diskmgr_account_t::accounting_diskmgr_account_t(
+        accounting_diskmgr_t *_par,
+        int _pri,
+        int _outstanding_requests_limit,
+        const std::shared_ptr<accounting_diskmgr_weight_group_t> &_weight_group)
         : par(_par), pri(_pri),
-          outstanding_requests_limit(_outstanding_requests_limit) { }
+          outstanding_requests_limit(_outstanding_requests_limit),
+          weight_group(_weight_group) {
+    guarantee(weight_group.get() != NULL);
+}
 
 accounting_diskmgr_account_t::~accounting_diskmgr_account_t() {
     par->assert_thread();
+    if (eager_account.has()) {
+        weight_group->accounts.erase(this);
+    }
 }
 
 void accounting_diskmgr_account_t::push(action_t *action) {
@@ -83,10 +94,16 @@ co_semaphore_t *accounting_diskmgr_account_t::get_outstanding_requests_limiter()
 void accounting_diskmgr_account_t::maybe_init(){
     if (!eager_account.has()) {
         par->assert_thread();
-        eager_account.init(new eager_account_t(par, pri, outstanding_requests_limit));
+        eager_account.init(new eager_account_t(par, shares(),
+                                               outstanding_requests_limit));
+        weight_group->accounts.insert(this);
     }
 }
 
+double accounting_diskmgr_account_t::shares() const {
+    return pri * weight_group->weight;
+}
+
 
 
 
@@ -107,6 +124,16 @@ void accounting_diskmgr_t::submit(action_t *a) {
     a->account->push(a);
 }
 
+void accounting_diskmgr_t::set_weight(accounting_diskmgr_weight_group_t *group,
+                                      double weight) {
+    assert_thread();
+    guarantee(weight > 0);
+    group->weight = weight;
+    for (account_t *account : group->accounts) {
+        account->eager_account->set_shares(account->shares());
+    }
+}
+
 void accounting_diskmgr_t::done(accounting_payload_t *p) {
     // p really is an action_t...
     action_t *a = static_cast<action_t *>(p);
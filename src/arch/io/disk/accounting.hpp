@@ -3,6 +3,8 @@
 #define ARCH_IO_DISK_ACCOUNTING_HPP_
 
 #include <functional>
+#include <memory>
+#include <set>
 
 #include "containers/intrusive_list.hpp"
 #include "containers/scoped.hpp"
@@ -32,7 +34,10 @@ private:
 };
 
 /* `accounting_diskmgr_t` shares disk throughput proportionally between a
-number of different "accounts". */
+number of different "accounts". An account's share is its priority, which says
+what kind of I/O it's for, times the weight of the account's weight group, which
+says whose I/O it is (each file has its own group, so tables can be weighed against
+each other). */
 
 typedef stats_diskmgr_2_t::action_t accounting_payload_t;
 
@@ -42,12 +47,33 @@ struct accounting_diskmgr_action_t;
 
 struct accounting_diskmgr_eager_account_t;
 
+struct accounting_diskmgr_account_t;
+
+/* The weight of a number of accounts. Apart from construction and destruction, it
+may only be used on the `accounting_diskmgr_t`'s thread. */
+class accounting_diskmgr_weight_group_t {
+public:
+    accounting_diskmgr_weight_group_t() : weight(1.0) { }
+
+private:
+    friend class accounting_diskmgr_t;
+    friend struct accounting_diskmgr_account_t;
+
+    double weight;
+    /* The accounts that have been initialized. */
+    std::set<accounting_diskmgr_account_t *> accounts;
+
+    DISABLE_COPYING(accounting_diskmgr_weight_group_t);
+};
+
 struct accounting_diskmgr_account_t {
     typedef accounting_diskmgr_action_t action_t;
 
-    accounting_diskmgr_account_t(accounting_diskmgr_t *_par,
-                                 int _pri,
-                                 int _outstanding_requests_limit);
+    accounting_diskmgr_account_t(
+        accounting_diskmgr_t *_par,
+        int _pri,
+        int _outstanding_requests_limit,
+        const std::shared_ptr<accounting_diskmgr_weight_group_t> &_weight_group);
 
     ~accounting_diskmgr_account_t();
 
@@ -56,13 +82,18 @@ struct accounting_diskmgr_account_t {
     co_semaphore_t *get_outstanding_requests_limiter();
 
 private:
+    friend class accounting_diskmgr_t;
     typedef accounting_diskmgr_eager_account_t eager_account_t;
 
     void maybe_init();
+    double shares() const;
 
     accounting_diskmgr_t *par;
     int pri;
     int outstanding_requests_limit;
+    /* The group outlives the file that made it if the account is destroyed after the
+    file, which can happen because accounts are destroyed asynchronously. */
+    std::shared_ptr<accounting_diskmgr_weight_group_t> weight_group;
     scoped_ptr_t<eager_account_t> eager_account;
     // A scoped pointer because we create the drainer lazily on first use.
     scoped_ptr_t<auto_drainer_t> requests_drainer;
@@ -96,6 +127,10 @@ public:
 
     void submit(action_t *a);
 
+    /* Scales the shares of all of the group's accounts to `weight` times their
+    priorities. */
+    void set_weight(accounting_diskmgr_weight_group_t *group, double weight);
+
     std::function<void (action_t *)> done_fun;
 
     passive_producer_t<accounting_payload_t *> * const producer;
@@ -0,0 +1,143 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/io/disk/coalescing.hpp"
+
+#include <limits.h>
+#include <sys/uio.h>
+
+coalescing_diskmgr_t::coalescing_diskmgr_t(perfmon_collection_t *stats,
+                                           passive_producer_t<action_t *> *_source,
+                                           int64_t _max_coalesced_bytes)
+    : passive_producer_t<action_t *>(&available_control),
+      producer(this),
+      source(_source),
+      max_coalesced_bytes(_max_coalesced_bytes),
+      held(NULL),
+      in_produce(false),
+      stats_membership(stats,
+                       &coalesced_writes, "coalesced_writes",
+                       &coalesced_parts, "coalesced_parts") {
+    source->available->set_callback(this);
+    update_availability();
+}
+
+coalescing_diskmgr_t::~coalescing_diskmgr_t() {
+    rassert(held == NULL);
+    source->available->unset_callback();
+}
+
+bool coalescing_diskmgr_t::can_merge(action_t *prev, int64_t prev_end,
+                                     action_t *next) {
+    return next->get_is_write()
+        && !next->wrap_in_datasyncs
+        && next->get_fd() == prev->get_fd()
+        && next->get_offset() == prev_end;
+}
+
+pool_diskmgr_action_t *coalescing_diskmgr_t::produce_next_value() {
+    in_produce = true;
+    action_t *first;
+    if (held != NULL) {
+        first = held;
+        held = NULL;
+    } else {
+        first = source->pop();
+    }
+
+    if (!USE_WRITEV
+        || max_coalesced_bytes == 0
+        || !first->get_is_write()
+        || first->wrap_in_datasyncs
+        || !source->available->get()) {
+        in_produce = false;
+        update_availability();
+        return first;
+    }
+
+    std::vector<action_t *> parts;
+    parts.push_back(first);
+    int64_t end = first->get_offset() + first->get_count();
+    int64_t total_bytes = first->get_count();
+    size_t total_iovecs;
+    {
+        iovec *vecs;
+        first->get_bufs(&vecs, &total_iovecs);
+    }
+
+    while (source->available->get()) {
+        action_t *next = source->pop();
+        iovec *vecs;
+        size_t vecs_len;
+        next->get_bufs(&vecs, &vecs_len);
+        if (!can_merge(first, end, next)
+            || total_bytes + static_cast<int64_t>(next->get_count()) > max_coalesced_bytes
+            || total_iovecs + vecs_len > IOV_MAX) {
+            held = next;
+            break;
+        }
+        parts.push_back(next);
+        end += next->get_count();
+        total_bytes += next->get_count();
+        total_iovecs += vecs_len;
+    }
+
+    in_produce = false;
+    update_availability();
+
+    if (parts.size() == 1) {
+        return first;
+    }
+
+#if USE_WRITEV
+    scoped_array_t<iovec> merged_vecs(total_iovecs);
+    size_t j = 0;
+    for (auto it = parts.begin(); it != parts.end(); ++it) {
+        iovec *vecs;
+        size_t vecs_len;
+        (*it)->get_bufs(&vecs, &vecs_len);
+        for (size_t i = 0; i < vecs_len; ++i) {
+            merged_vecs[j++] = vecs[i];
+        }
+    }
+    rassert(j == total_iovecs);
+
+    coalescing_diskmgr_action_t *merged = new coalescing_diskmgr_action_t;
+    merged->make_writev(first->get_fd(), std::move(merged_vecs), total_bytes,
+                        first->get_offset());
+    merged->parts = std::move(parts);
+
+    ++coalesced_writes;
+    coalesced_parts += merged->parts.size();
+    return merged;
+#else
+    unreachable();
+#endif
+}
+
+void coalescing_diskmgr_t::done(action_t *a) {
+    coalescing_diskmgr_action_t *merged = dynamic_cast<coalescing_diskmgr_action_t *>(a);
+    if (merged == NULL) {
+        done_fun(a);
+        return;
+    }
+
+    // On failure every part reports the error; on success each one reports that
+    // all of its bytes were written.
+    const bool succeeded = merged->get_succeeded();
+    for (auto it = merged->parts.begin(); it != merged->parts.end(); ++it) {
+        (*it)->io_result = succeeded
+            ? static_cast<int64_t>((*it)->get_count())
+            : merged->io_result;
+        done_fun(*it);
+    }
+    delete merged;
+}
+
+void coalescing_diskmgr_t::on_source_availability_changed() {
+    if (!in_produce) {
+        update_availability();
+    }
+}
+
+void coalescing_diskmgr_t::update_availability() {
+    available_control.set_available(held != NULL || source->available->get());
+}
@@ -0,0 +1,70 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_DISK_COALESCING_HPP_
+#define ARCH_IO_DISK_COALESCING_HPP_
+
+#include <functional>
+#include <vector>
+
+#include "arch/io/disk/pool.hpp"
+#include "concurrency/queue/passive_producer.hpp"
+#include "perfmon/perfmon.hpp"
+
+/* `coalescing_diskmgr_t` sits right above the disk backend. When the backend pops
+a write, the coalescing disk manager keeps popping from its own source for as long
+as the following writes go to the same file and continue exactly where the
+previous one ended. All of them are handed to the backend as a single vectored
+write. When that write completes, `done_fun` gets called on each of the original
+actions with the combined result.
+
+Only writes are merged, and only if they are exactly adjacent; filling a gap
+between two writes would require reading the bytes in between first. The size of
+a merged write is bounded by `max_coalesced_bytes` and by `IOV_MAX`.
+
+It's safe to merge the writes because the `conflict_resolving_diskmgr_t` above us
+never lets two overlapping operations through at the same time, and actions that
+reach us together would have been in flight concurrently anyway. */
+
+struct coalescing_diskmgr_action_t : public pool_diskmgr_action_t {
+    // The actions that make up this one, in offset order.
+    std::vector<pool_diskmgr_action_t *> parts;
+};
+
+class coalescing_diskmgr_t : private passive_producer_t<pool_diskmgr_action_t *>,
+                             private availability_callback_t {
+public:
+    typedef pool_diskmgr_action_t action_t;
+
+    coalescing_diskmgr_t(perfmon_collection_t *stats,
+                         passive_producer_t<action_t *> *source,
+                         int64_t max_coalesced_bytes);
+    ~coalescing_diskmgr_t();
+
+    passive_producer_t<action_t *> *const producer;
+
+    std::function<void (action_t *)> done_fun;
+    void done(action_t *a);
+
+private:
+    action_t *produce_next_value();
+    void on_source_availability_changed();
+    void update_availability();
+
+    static bool can_merge(action_t *prev, int64_t prev_end, action_t *next);
+
+    passive_producer_t<action_t *> *const source;
+    const int64_t max_coalesced_bytes;
+
+    availability_control_t available_control;
+    // An action we popped from `source` while looking for something to merge, but
+    // that couldn't be merged. It's the next thing we hand out.
+    action_t *held;
+    bool in_produce;
+
+    // How many merged writes we issued, and how many actions went into them.
+    perfmon_counter_t coalesced_writes, coalesced_parts;
+    perfmon_multi_membership_t stats_membership;
+
+    DISABLE_COPYING(coalescing_diskmgr_t);
+};
+
+#endif  // ARCH_IO_DISK_COALESCING_HPP_
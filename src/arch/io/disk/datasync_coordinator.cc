@@ -0,0 +1,91 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "arch/io/disk/datasync_coordinator.hpp"
+
+#include <algorithm>
+#include <functional>
+
+#include "arch/io/disk.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/thread_pool.hpp"
+
+datasync_coordinator_t::datasync_coordinator_t(perfmon_collection_t *stats) :
+    datasyncs_membership(stats, &datasyncs_counter, "datasyncs"),
+    barriers_membership(stats, &barriers_counter, "datasync_barriers")
+{ }
+
+datasync_coordinator_t::~datasync_coordinator_t() {
+    assert_thread();
+}
+
+int datasync_coordinator_t::datasync(fd_t fd, boost::optional<dev_t> file_system) {
+    assert_thread();
+    ++datasyncs_counter;
+
+    if (!file_system) {
+        ++barriers_counter;
+        int errcode;
+        thread_pool_t::run_in_blocker_pool([&]() { errcode = perform_datasync(fd); });
+        return errcode;
+    }
+
+    waiter_t waiter;
+    waiter.fd = fd;
+    waiter.errcode = 0;
+
+    file_system_t *fs = &file_systems[*file_system];
+    fs->pending.push_back(&waiter);
+    if (!fs->syncing) {
+        fs->syncing = true;
+        coro_t::spawn_sometime(std::bind(&datasync_coordinator_t::run_barriers, this,
+                                         *file_system, drainer.lock()));
+    }
+
+    waiter.done.wait();
+    return waiter.errcode;
+}
+
+void datasync_coordinator_t::run_barriers(dev_t file_system,
+                                          auto_drainer_t::lock_t) {
+    assert_thread();
+    // `std::map` doesn't move its elements, and nobody else erases this one while
+    // `syncing` is set.
+    file_system_t *fs = &file_systems[file_system];
+    rassert(fs->syncing);
+
+    while (!fs->pending.empty()) {
+        // Everything that arrives from here on waits for the next barrier, since it
+        // might have been written after this one started.
+        std::vector<waiter_t *> round;
+        round.swap(fs->pending);
+
+        std::vector<fd_t> fds;
+        for (waiter_t *w : round) {
+            fds.push_back(w->fd);
+        }
+        std::sort(fds.begin(), fds.end());
+        fds.erase(std::unique(fds.begin(), fds.end()), fds.end());
+
+        ++barriers_counter;
+        int errcode = 0;
+        thread_pool_t::run_in_blocker_pool([&]() {
+            // One file is cheaper to sync on its own than the whole file system.
+            if (fds.size() > 1 && perform_file_system_sync(fds[0]) == 0) {
+                return;
+            }
+            for (fd_t fd : fds) {
+                int res = perform_datasync(fd);
+                if (res != 0) {
+                    errcode = res;
+                }
+            }
+        });
+
+        for (waiter_t *w : round) {
+            w->errcode = errcode;
+            w->done.pulse();
+        }
+    }
+
+    fs->syncing = false;
+    file_systems.erase(file_system);
+}
@@ -0,0 +1,64 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_DISK_DATASYNC_COORDINATOR_HPP_
+#define ARCH_IO_DISK_DATASYNC_COORDINATOR_HPP_
+
+#include <sys/types.h>
+
+#include <map>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/optional.hpp>
+
+#include "arch/runtime/runtime_utils.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
+#include "perfmon/perfmon.hpp"
+#include "threading.hpp"
+
+/* `datasync_coordinator_t` does group commit for datasyncs.  Every serializer makes its
+metablock durable on its own schedule, so with many tables on one device every flush
+cycle used to cost one barrier per table.  Datasyncs of files on the same file system
+that arrive while a barrier for that file system is in flight now wait for it to
+finish and are then all served by a single `syncfs()`.  A lone datasync still costs
+one barrier and doesn't wait for anything. */
+class datasync_coordinator_t : public home_thread_mixin_t {
+public:
+    explicit datasync_coordinator_t(perfmon_collection_t *stats);
+    ~datasync_coordinator_t();
+
+    // Blocks until everything that was written to `fd` before the call is durable.
+    // `file_system` is the device of the file system the file lives on, or empty if
+    // the file must be synced on its own (block devices, for example).  Must be
+    // called in a coroutine on the home thread.  Returns an errno value on failure,
+    // 0 otherwise.
+    int datasync(fd_t fd, boost::optional<dev_t> file_system);
+
+private:
+    struct waiter_t {
+        fd_t fd;
+        int errcode;
+        cond_t done;
+    };
+    struct file_system_t {
+        file_system_t() : syncing(false) { }
+        bool syncing;
+        // The waiters for the next barrier.
+        std::vector<waiter_t *> pending;
+    };
+
+    void run_barriers(dev_t file_system, auto_drainer_t::lock_t keepalive);
+
+    std::map<dev_t, file_system_t> file_systems;
+
+    perfmon_counter_t datasyncs_counter;
+    perfmon_membership_t datasyncs_membership;
+    perfmon_counter_t barriers_counter;
+    perfmon_membership_t barriers_membership;
+
+    auto_drainer_t drainer;
+
+    DISABLE_COPYING(datasync_coordinator_t);
+};
+
+#endif  // ARCH_IO_DISK_DATASYNC_COORDINATOR_HPP_
@@ -0,0 +1,23 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_DISK_LATENCY_STATS_HPP_
+#define ARCH_IO_DISK_LATENCY_STATS_HPP_
+
+#include "perfmon/histogram.hpp"
+
+/* The latencies of one file's I/O, from when an operation is submitted to the disk
+manager until it completes, so they include the time spent queueing behind other
+operations.  A file only records them if it's been given a `file_latency_stats_t`
+with `file_t::set_latency_stats()`; the records happen on the disk manager's
+thread. */
+struct file_latency_stats_t {
+    file_latency_stats_t()
+        : read(secs_to_ticks(LATENCY_HISTOGRAM_INTERVAL_SECS)),
+          write(secs_to_ticks(LATENCY_HISTOGRAM_INTERVAL_SECS)),
+          datasync(secs_to_ticks(LATENCY_HISTOGRAM_INTERVAL_SECS)) { }
+
+    perfmon_latency_histogram_t read;
+    perfmon_latency_histogram_t write;
+    perfmon_latency_histogram_t datasync;
+};
+
+#endif  // ARCH_IO_DISK_LATENCY_STATS_HPP_
@@ -0,0 +1,474 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/io/disk/native.hpp"
+
+#include <limits.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifdef __linux
+#include <linux/aio_abi.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifndef NO_IO_URING
+#include <linux/io_uring.h>
+#endif
+#endif
+
+#include <algorithm>
+
+#include "arch/io/disk.hpp"
+#include "logger.hpp"
+
+// How many threads the fallback pool gets. It only sees resizes, datasyncs and
+// the rare operation that the kernel interface didn't complete in one go.
+const int NATIVE_DISKMGR_FALLBACK_THREADS = 4;
+
+// Both io_uring and kernel AIO put a system-wide limit on the size of a ring, so
+// we cap the number of in-flight operations independently of `--io-threads`.
+const int NATIVE_DISKMGR_MAX_QUEUE_DEPTH = 4096;
+
+#ifdef __linux
+
+#ifndef NO_IO_URING
+struct native_diskmgr_t::io_uring_state_t {
+    io_uring_state_t() : ring_fd(-1), sq_ring(MAP_FAILED), cq_ring(MAP_FAILED),
+                         sqes(MAP_FAILED), sq_ring_size(0), cq_ring_size(0),
+                         sqes_size(0), pending(0) { }
+
+    ~io_uring_state_t() {
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqes_size);
+        }
+        if (cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+            munmap(cq_ring, cq_ring_size);
+        }
+        if (sq_ring != MAP_FAILED) {
+            munmap(sq_ring, sq_ring_size);
+        }
+        if (ring_fd != -1) {
+            int res = close(ring_fd);
+            guarantee_err(res == 0 || get_errno() == EINTR, "Could not close io_uring");
+        }
+    }
+
+    // Returns 0 on success or an errno value.
+    int init(unsigned entries) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+        if (ring_fd == -1) {
+            return get_errno();
+        }
+
+        sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap) {
+            sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+        }
+
+        sq_ring = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if (sq_ring == MAP_FAILED) {
+            return get_errno();
+        }
+        if (single_mmap) {
+            cq_ring = sq_ring;
+        } else {
+            cq_ring = mmap(NULL, cq_ring_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+            if (cq_ring == MAP_FAILED) {
+                return get_errno();
+            }
+        }
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            return get_errno();
+        }
+
+        char *sq = static_cast<char *>(sq_ring);
+        sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sq_mask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        sq_entries = params.sq_entries;
+
+        char *cq = static_cast<char *>(cq_ring);
+        cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+        return 0;
+    }
+
+    int register_eventfd(int fd) {
+        int res = syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_EVENTFD,
+                          &fd, 1);
+        return res == -1 ? get_errno() : 0;
+    }
+
+    io_uring_sqe *next_sqe() {
+        // We are the only producer, so a relaxed load of our own tail is enough.
+        const unsigned tail = *sq_tail + pending;
+        const unsigned index = tail & sq_mask;
+        io_uring_sqe *sqe = static_cast<io_uring_sqe *>(sqes) + index;
+        memset(sqe, 0, sizeof(*sqe));
+        sq_array[index] = index;
+        ++pending;
+        return sqe;
+    }
+
+    // Returns the number of entries the kernel accepted, or -errno.
+    int submit() {
+        if (pending == 0) {
+            return 0;
+        }
+        __atomic_store_n(sq_tail, *sq_tail + pending, __ATOMIC_RELEASE);
+        const unsigned to_submit = pending;
+        pending = 0;
+        int res;
+        do {
+            res = syscall(__NR_io_uring_enter, ring_fd, to_submit, 0, 0, NULL, 0);
+        } while (res == -1 && get_errno() == EINTR);
+        return res == -1 ? -get_errno() : res;
+    }
+
+    int ring_fd;
+    void *sq_ring;
+    void *cq_ring;
+    void *sqes;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    size_t sqes_size;
+
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned *sq_array;
+    unsigned sq_entries;
+    unsigned pending;
+
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    io_uring_cqe *cqes;
+
+    DISABLE_COPYING(io_uring_state_t);
+};
+#else
+struct native_diskmgr_t::io_uring_state_t { };
+#endif  // NO_IO_URING
+
+struct native_diskmgr_t::aio_state_t {
+    aio_state_t() : ctx(0) { }
+    ~aio_state_t() {
+        if (ctx != 0) {
+            int res = syscall(__NR_io_destroy, ctx);
+            guarantee_err(res == 0, "Could not destroy AIO context");
+        }
+    }
+
+    // Returns 0 on success or an errno value.
+    int init(unsigned entries) {
+        int res = syscall(__NR_io_setup, entries, &ctx);
+        if (res == -1) {
+            ctx = 0;
+            return get_errno();
+        }
+        return 0;
+    }
+
+    aio_context_t ctx;
+    std::vector<iocb> prepared;
+    std::vector<iocb *> prepared_ptrs;
+    std::vector<io_event> events;
+
+    DISABLE_COPYING(aio_state_t);
+};
+
+bool native_diskmgr_t::is_supported(kernel_interface_t interface) {
+    switch (interface) {
+    case IO_URING: {
+#ifdef NO_IO_URING
+        return false;
+#else
+        io_uring_state_t probe;
+        return probe.init(1) == 0;
+#endif
+    }
+    case AIO: {
+        aio_state_t probe;
+        return probe.init(1) == 0;
+    }
+    default:
+        unreachable();
+    }
+}
+
+native_diskmgr_t::native_diskmgr_t(linux_event_queue_t *_queue,
+                                   passive_producer_t<action_t *> *_source,
+                                   int max_concurrent_io_requests,
+                                   kernel_interface_t _interface)
+    : queue(_queue),
+      source(_source),
+      interface(_interface),
+      queue_depth(std::min(blocker_pool_queue_depth(max_concurrent_io_requests),
+                           NATIVE_DISKMGR_MAX_QUEUE_DEPTH)),
+      n_in_flight(0),
+      n_prepared(0),
+      fallback(_queue, &fallback_queue,
+               std::min(max_concurrent_io_requests, NATIVE_DISKMGR_FALLBACK_THREADS)) {
+    fallback.done_fun = std::bind(&native_diskmgr_t::on_fallback_done, this, ph::_1);
+
+#ifndef NO_IO_URING
+    if (interface == IO_URING) {
+        uring.init(new io_uring_state_t());
+        int errsv = uring->init(queue_depth);
+        if (errsv == 0) {
+            errsv = uring->register_eventfd(completion_event.get_notify_fd());
+        }
+        if (errsv != 0) {
+            logWRN("Could not set up io_uring (%s). Falling back to kernel AIO.",
+                   errno_string(errsv).c_str());
+            uring.reset();
+            interface = AIO;
+        }
+    }
+#else
+    interface = AIO;
+#endif
+
+    if (interface == AIO) {
+        aio.init(new aio_state_t());
+        int errsv = aio->init(queue_depth);
+        guarantee_xerr(errsv == 0, errsv, "Could not set up kernel AIO context.");
+        aio->events.resize(queue_depth);
+    }
+
+    queue->watch_resource(completion_event.get_notify_fd(), poll_event_in, this);
+
+    if (source->available->get()) { pump(); }
+    source->available->set_callback(this);
+}
+
+native_diskmgr_t::~native_diskmgr_t() {
+    assert_thread();
+    rassert(n_in_flight == 0);
+    source->available->unset_callback();
+    queue->forget_resource(completion_event.get_notify_fd(), this);
+}
+
+void native_diskmgr_t::on_source_availability_changed() {
+    assert_thread();
+    if (source->available->get()) pump();
+}
+
+void native_diskmgr_t::pump() {
+    assert_thread();
+    while (source->available->get() && n_in_flight + n_prepared < queue_depth) {
+        action_t *a = source->pop();
+        if (!prepare(a)) {
+            push_to_fallback(a);
+        }
+    }
+    submit_prepared();
+}
+
+bool native_diskmgr_t::prepare(action_t *a) {
+    if (a->get_is_resize() || a->get_is_discard() || a->wrap_in_datasyncs) {
+        return false;
+    }
+    iovec *vecs;
+    size_t vecs_len;
+    a->get_bufs(&vecs, &vecs_len);
+    if (vecs_len > IOV_MAX) {
+        return false;
+    }
+
+#ifndef NO_IO_URING
+    if (interface == IO_URING) {
+        io_uring_sqe *sqe = uring->next_sqe();
+        sqe->opcode = a->get_is_read() ? IORING_OP_READV : IORING_OP_WRITEV;
+        sqe->fd = a->get_fd();
+        sqe->off = a->get_offset();
+        sqe->addr = reinterpret_cast<uint64_t>(vecs);
+        sqe->len = vecs_len;
+        sqe->user_data = reinterpret_cast<uint64_t>(a);
+        ++n_prepared;
+        return true;
+    }
+#endif
+
+    iocb cb;
+    memset(&cb, 0, sizeof(cb));
+    cb.aio_lio_opcode = a->get_is_read() ? IOCB_CMD_PREADV : IOCB_CMD_PWRITEV;
+    cb.aio_fildes = a->get_fd();
+    cb.aio_offset = a->get_offset();
+    cb.aio_buf = reinterpret_cast<uint64_t>(vecs);
+    cb.aio_nbytes = vecs_len;
+    cb.aio_data = reinterpret_cast<uint64_t>(a);
+    cb.aio_flags = IOCB_FLAG_RESFD;
+    cb.aio_resfd = completion_event.get_notify_fd();
+    aio->prepared.push_back(cb);
+    ++n_prepared;
+    return true;
+}
+
+void native_diskmgr_t::submit_prepared() {
+    if (n_prepared == 0) {
+        return;
+    }
+
+#ifndef NO_IO_URING
+    if (interface == IO_URING) {
+        const int res = uring->submit();
+        // The kernel consumes the submission queue in order, so everything it
+        // didn't take is still sitting at the tail. If it refused the whole batch
+        // there's no cheap way to pull the entries back out, so we crash just like
+        // the pool backend would on an impossible syscall failure.
+        guarantee_xerr(res >= 0, -res, "io_uring_enter failed");
+        guarantee(res == n_prepared, "io_uring only accepted %d of %d requests",
+                  res, n_prepared);
+        n_in_flight += n_prepared;
+        n_prepared = 0;
+        return;
+    }
+#endif
+
+    aio->prepared_ptrs.resize(aio->prepared.size());
+    for (size_t i = 0; i < aio->prepared.size(); ++i) {
+        aio->prepared_ptrs[i] = &aio->prepared[i];
+    }
+    size_t submitted = 0;
+    while (submitted < aio->prepared_ptrs.size()) {
+        long res = syscall(__NR_io_submit, aio->ctx,
+                           aio->prepared_ptrs.size() - submitted,
+                           aio->prepared_ptrs.data() + submitted);
+        if (res == -1 && get_errno() == EINTR) {
+            continue;
+        }
+        if (res <= 0) {
+            // The kernel is out of resources (or doesn't like this file); run the
+            // rest on the thread pool.
+            break;
+        }
+        submitted += res;
+    }
+    n_in_flight += submitted;
+    for (size_t i = submitted; i < aio->prepared.size(); ++i) {
+        push_to_fallback(reinterpret_cast<action_t *>(aio->prepared[i].aio_data));
+    }
+    aio->prepared.clear();
+    n_prepared = 0;
+}
+
+void native_diskmgr_t::on_event(DEBUG_VAR int events) {
+    assert_thread();
+    rassert(events == poll_event_in);
+    completion_event.consume_wakey_wakeys();
+    reap_completions();
+    pump();
+}
+
+void native_diskmgr_t::reap_completions() {
+    std::vector<std::pair<action_t *, int64_t> > completed;
+
+#ifndef NO_IO_URING
+    if (interface == IO_URING) {
+        unsigned head = *uring->cq_head;
+        const unsigned tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            const io_uring_cqe *cqe = &uring->cqes[head & uring->cq_mask];
+            completed.push_back(std::make_pair(
+                reinterpret_cast<action_t *>(cqe->user_data),
+                static_cast<int64_t>(cqe->res)));
+            ++head;
+        }
+        __atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+    }
+#endif
+
+    if (interface == AIO) {
+        timespec no_wait;
+        no_wait.tv_sec = 0;
+        no_wait.tv_nsec = 0;
+        for (;;) {
+            long res = syscall(__NR_io_getevents, aio->ctx, 0, aio->events.size(),
+                               aio->events.data(), &no_wait);
+            if (res == -1 && get_errno() == EINTR) {
+                continue;
+            }
+            guarantee_err(res >= 0, "io_getevents failed");
+            for (long i = 0; i < res; ++i) {
+                completed.push_back(std::make_pair(
+                    reinterpret_cast<action_t *>(aio->events[i].data),
+                    static_cast<int64_t>(aio->events[i].res)));
+            }
+            if (static_cast<size_t>(res) < aio->events.size()) {
+                break;
+            }
+        }
+    }
+
+    n_in_flight -= completed.size();
+    rassert(n_in_flight >= 0);
+    for (auto it = completed.begin(); it != completed.end(); ++it) {
+        complete(it->first, it->second);
+    }
+}
+
+void native_diskmgr_t::complete(action_t *a, int64_t res) {
+    if (res == static_cast<int64_t>(a->get_count())) {
+        a->io_result = res;
+        done_fun(a);
+    } else if (res == -EINTR || res == -EAGAIN
+               || (res >= 0 && res < static_cast<int64_t>(a->get_count()))) {
+        // Short or interrupted operations are rare. Rather than tracking partial
+        // progress here, we let the pool run the whole operation again; pread and
+        // pwrite are idempotent.
+        push_to_fallback(a);
+    } else {
+        a->io_result = res;
+        done_fun(a);
+    }
+}
+
+void native_diskmgr_t::push_to_fallback(action_t *a) {
+    fallback_queue.push(a);
+}
+
+void native_diskmgr_t::on_fallback_done(action_t *a) {
+    done_fun(a);
+}
+
+#else  // __linux
+
+struct native_diskmgr_t::io_uring_state_t { };
+struct native_diskmgr_t::aio_state_t { };
+
+bool native_diskmgr_t::is_supported(kernel_interface_t) {
+    return false;
+}
+
+native_diskmgr_t::native_diskmgr_t(linux_event_queue_t *_queue,
+                                   passive_producer_t<action_t *> *_source,
+                                   int max_concurrent_io_requests,
+                                   kernel_interface_t _interface)
+    : queue(_queue),
+      source(_source),
+      interface(_interface),
+      queue_depth(std::min(blocker_pool_queue_depth(max_concurrent_io_requests),
+                           NATIVE_DISKMGR_MAX_QUEUE_DEPTH)),
+      n_in_flight(0),
+      n_prepared(0),
+      fallback(_queue, &fallback_queue, NATIVE_DISKMGR_FALLBACK_THREADS) {
+    crash("Native disk I/O is only supported on Linux.");
+}
+
+native_diskmgr_t::~native_diskmgr_t() { }
+void native_diskmgr_t::on_source_availability_changed() { unreachable(); }
+void native_diskmgr_t::on_event(int) { unreachable(); }
+
+#endif  // __linux
@@ -0,0 +1,93 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_DISK_NATIVE_HPP_
+#define ARCH_IO_DISK_NATIVE_HPP_
+
+#include <functional>
+#include <vector>
+
+#include "arch/io/disk/pool.hpp"
+#include "arch/runtime/event_queue.hpp"
+#include "arch/runtime/system_event.hpp"
+#include "concurrency/queue/passive_producer.hpp"
+#include "concurrency/queue/unlimited_fifo.hpp"
+#include "containers/scoped.hpp"
+
+/* The native disk manager hands reads and writes directly to the kernel's
+asynchronous I/O interface instead of running blocking syscalls on a thread pool.
+It prefers io_uring and falls back to kernel AIO (io_setup/io_submit) if io_uring
+isn't available. All reads and writes that are popped off the source during one
+`pump()` are submitted with a single syscall.
+
+Completions are signalled through an eventfd that is registered with the event
+queue, so no other threads are involved on the fast path.
+
+Operations that the kernel interfaces can't express well (resizes, discards,
+writes that are wrapped in datasyncs, and operations that come back short or with
+`EAGAIN`/`EINTR`) are passed on to an internal `pool_diskmgr_t`, which runs them
+the same way the regular pool backend would. */
+
+class native_diskmgr_t : private availability_callback_t,
+                         public home_thread_mixin_debug_only_t,
+                         private linux_event_callback_t {
+public:
+    typedef pool_diskmgr_action_t action_t;
+
+    enum kernel_interface_t { IO_URING, AIO };
+
+    /* Returns whether the given kernel interface can be set up in this process.
+    Used to decide whether we have to fall back to a different backend. */
+    static bool is_supported(kernel_interface_t interface);
+
+    /* Like `pool_diskmgr_t`, the `native_diskmgr_t` draws actions from `source` and
+    calls `done_fun` on each one when it's done. If `interface` is `IO_URING` but
+    io_uring can't be set up, kernel AIO is used instead. */
+    native_diskmgr_t(linux_event_queue_t *queue,
+                     passive_producer_t<action_t *> *source,
+                     int max_concurrent_io_requests,
+                     kernel_interface_t interface);
+    ~native_diskmgr_t();
+
+    std::function<void(action_t *)> done_fun;
+
+    kernel_interface_t get_interface() const { return interface; }
+
+private:
+    struct io_uring_state_t;
+    struct aio_state_t;
+
+    void on_source_availability_changed();
+    void on_event(int events);
+
+    void pump();
+    // Returns false if the kernel refused the operation and it must be run on the
+    // fallback pool instead.
+    bool prepare(action_t *a);
+    void submit_prepared();
+    void reap_completions();
+    void complete(action_t *a, int64_t res);
+
+    void push_to_fallback(action_t *a);
+    void on_fallback_done(action_t *a);
+
+    linux_event_queue_t *const queue;
+    passive_producer_t<action_t *> *const source;
+    kernel_interface_t interface;
+    const int queue_depth;
+
+    // Number of operations that are currently owned by the kernel.
+    int n_in_flight;
+    // Number of operations that have been prepared but not yet submitted.
+    int n_prepared;
+
+    system_event_t completion_event;
+
+    scoped_ptr_t<io_uring_state_t> uring;
+    scoped_ptr_t<aio_state_t> aio;
+
+    unlimited_fifo_queue_t<action_t *> fallback_queue;
+    pool_diskmgr_t fallback;
+
+    DISABLE_COPYING(native_diskmgr_t);
+};
+
+#endif  // ARCH_IO_DISK_NATIVE_HPP_
@@ -165,6 +165,10 @@ void pool_diskmgr_t::action_t::run() {
             return;
         }
     } break;
+    case ACTION_DISCARD: {
+        int errcode = perform_discard(fd, offset, get_count());
+        io_result = errcode == 0 ? static_cast<int64_t>(get_count()) : -errcode;
+    } break;
     case ACTION_READ:
     case ACTION_WRITE: {
         // Copy the io vectors because perform_read_write will modify them
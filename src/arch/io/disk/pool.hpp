@@ -19,9 +19,15 @@
 #endif
 
 struct iovec;
+class coalescing_diskmgr_t;
+class native_diskmgr_t;
 class pool_diskmgr_t;
 class printf_buffer_t;
 
+// The number of actions a disk manager keeps outstanding for the given value of
+// `--io-threads`.
+int blocker_pool_queue_depth(int max_concurrent_io_requests);
+
 /* The pool disk manager uses a thread pool in conjunction with synchronous
 (blocking) IO calls to asynchronously run IO requests. */
 
@@ -49,6 +55,15 @@ struct pool_diskmgr_action_t
         offset = _new_size;
     }
 
+    void make_discard(fd_t _fd, int64_t _offset, size_t _count) {
+        type = ACTION_DISCARD;
+        wrap_in_datasyncs = false;
+        fd = _fd;
+        buf_and_count.iov_base = NULL;
+        buf_and_count.iov_len = _count;
+        offset = _offset;
+    }
+
 #ifndef USE_WRITEV
 #error "USE_WRITEV not defined... but we are in pool.hpp.  Where is it?"
 #elif USE_WRITEV
@@ -74,6 +89,7 @@ struct pool_diskmgr_action_t
 
     bool get_is_write() const { return type == ACTION_WRITE; }
     bool get_is_resize() const { return type == ACTION_RESIZE; }
+    bool get_is_discard() const { return type == ACTION_DISCARD; }
     bool get_is_read() const { return type == ACTION_READ; }
     fd_t get_fd() const { return fd; }
     void get_bufs(iovec **iovecs_out, size_t *iovecs_len_out) {
@@ -97,17 +113,19 @@ struct pool_diskmgr_action_t
 
 private:
     friend class pool_diskmgr_t;
+    friend class coalescing_diskmgr_t;
+    friend class native_diskmgr_t;
     pool_diskmgr_t *parent;
 
-    enum action_type_t {ACTION_READ, ACTION_WRITE, ACTION_RESIZE};
+    enum action_type_t {ACTION_READ, ACTION_WRITE, ACTION_RESIZE, ACTION_DISCARD};
     action_type_t type;
     bool wrap_in_datasyncs;
     fd_t fd;
 
-    // Either type is ACTION_RESIZE, or buf_and_count.iov_base is used, or iovecs
-    // is used (for writev).  If iovecs is used, then buf_and_count.iov_len is the
-    // sum of the iovecs' iov_len fields.  Currently readv is not supported, but if
-    // you need it, it should be easy to add.
+    // Either type is ACTION_RESIZE or ACTION_DISCARD, or buf_and_count.iov_base is
+    // used, or iovecs is used (for writev).  If iovecs is used, then
+    // buf_and_count.iov_len is the sum of the iovecs' iov_len fields.  Currently
+    // readv is not supported, but if you need it, it should be easy to add.
     scoped_array_t<iovec> iovecs;
     iovec buf_and_count;
     int64_t offset;
@@ -3,12 +3,17 @@
 stats_diskmgr_t::stats_diskmgr_t(perfmon_collection_t *stats, const std::string &name) :
     read_sampler(secs_to_ticks(1)),
     write_sampler(secs_to_ticks(1)),
+    read_latency(secs_to_ticks(LATENCY_HISTOGRAM_INTERVAL_SECS)),
+    write_latency(secs_to_ticks(LATENCY_HISTOGRAM_INTERVAL_SECS)),
     stats_membership(stats,
                      &read_sampler, (name + "_read").c_str(),
-                     &write_sampler, (name + "_write").c_str()) { }
+                     &write_sampler, (name + "_write").c_str(),
+                     &read_latency, (name + "_read_latency").c_str(),
+                     &write_latency, (name + "_write_latency").c_str()) { }
 
 
 void stats_diskmgr_t::submit(action_t *a) {
+    a->submit_time = get_ticks();
     if (a->get_is_read()) {
         read_sampler.begin(&a->start_time);
     } else {
@@ -24,5 +29,19 @@ void stats_diskmgr_t::done(conflict_resolving_diskmgr_action_t *p) {
     } else {
         write_sampler.end(&a->start_time);
     }
+    // Resizes and discards count as writes for the samplers, but they aren't what
+    // anybody wants the latencies of.
+    if (a->get_is_read() || a->get_is_write()) {
+        const ticks_t latency = get_ticks() - a->submit_time;
+        perfmon_latency_histogram_t *histogram =
+            a->get_is_read() ? &read_latency : &write_latency;
+        histogram->record(latency);
+        if (a->latency_stats != NULL) {
+            histogram = a->get_is_read()
+                ? &a->latency_stats->read
+                : &a->latency_stats->write;
+            histogram->record(latency);
+        }
+    }
     done_fun(a);
 }
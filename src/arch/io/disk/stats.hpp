@@ -7,6 +7,7 @@
 
 #include "arch/io/disk/pool.hpp"
 #include "arch/io/disk/conflict_resolving.hpp"
+#include "arch/io/disk/latency_stats.hpp"
 #include "perfmon/types.hpp"
 
 /* There are two types of stat-collectors in the disk stack. One type is a passive
@@ -17,7 +18,11 @@ struct stats_diskmgr_t {
     stats_diskmgr_t(perfmon_collection_t *stats, const std::string &name);
 
     struct action_t : public conflict_resolving_diskmgr_action_t {
+        action_t() : latency_stats(NULL) { }
         ticks_t start_time;
+        ticks_t submit_time;
+        // The stats of the file the action is for, if it has any.
+        file_latency_stats_t *latency_stats;
     };
 
     void submit(action_t *a);
@@ -30,6 +35,8 @@ struct stats_diskmgr_t {
 
 private:
     perfmon_duration_sampler_t read_sampler, write_sampler;
+    // Unlike the samplers, these always get timings.
+    perfmon_latency_histogram_t read_latency, write_latency;
     perfmon_multi_membership_t stats_membership;
 };
 
@@ -4,6 +4,7 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/tcp.h>
@@ -11,6 +12,7 @@
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #include "utils.hpp"
 #include <boost/bind.hpp>
@@ -20,7 +22,9 @@
 #include "arch/timing.hpp"
 #include "arch/types.hpp"
 #include "concurrency/auto_drainer.hpp"
+#include "concurrency/pmap.hpp"
 #include "concurrency/wait_any.hpp"
+#include "containers/buffer_group.hpp"
 #include "containers/printf_buffer.hpp"
 #include "logger.hpp"
 #include "perfmon/perfmon.hpp"
@@ -96,6 +100,7 @@ linux_tcp_conn_t::linux_tcp_conn_t(const ip_address_t &peer,
         sock(create_socket_wrapper(peer.get_address_family())),
         event_watcher(new linux_event_watcher_t(sock.get(), this)),
         read_in_progress(false), write_in_progress(false),
+        read_buffer_offset(0), read_chunk_size(IO_BUFFER_SIZE),
         write_handler(this),
         write_queue_limiter(WRITE_QUEUE_MAX_SIZE),
         write_coro_pool(1, &write_queue, &write_handler),
@@ -148,6 +153,7 @@ linux_tcp_conn_t::linux_tcp_conn_t(fd_t s) :
     sock(s),
     event_watcher(new linux_event_watcher_t(sock.get(), this)),
     read_in_progress(false), write_in_progress(false),
+    read_buffer_offset(0), read_chunk_size(IO_BUFFER_SIZE),
     write_handler(this),
     write_queue_limiter(WRITE_QUEUE_MAX_SIZE),
     write_coro_pool(1, &write_queue, &write_handler),
@@ -243,35 +249,90 @@ size_t linux_tcp_conn_t::read_internal(void *buffer, size_t size) THROWS_ONLY(tc
     }
 }
 
+size_t linux_tcp_conn_t::consume_buffered(void *buf, size_t size) {
+    size_t bytes = std::min(buffered_size(), size);
+    memcpy(buf, buffered_data(), bytes);
+    pop_buffered(bytes);
+    return bytes;
+}
+
+void linux_tcp_conn_t::pop_buffered(size_t size) {
+    rassert(size <= buffered_size());
+    read_buffer_offset += size;
+    if (read_buffer_offset == read_buffer.size()) {
+        read_buffer.clear();
+        read_buffer_offset = 0;
+    }
+}
+
+void linux_tcp_conn_t::fill_read_buffer() THROWS_ONLY(tcp_conn_read_closed_exc_t) {
+    /* Drop the consumed part first, so that the buffer doesn't grow without bounds.
+    We only get here when the buffered data isn't enough, so there's little left to
+    move. */
+    if (read_buffer_offset > 0) {
+        read_buffer.erase(read_buffer.begin(), read_buffer.begin() + read_buffer_offset);
+        read_buffer_offset = 0;
+    }
+    /* Give back the memory of a large buffer once we've shrunk the chunk size. */
+    if (read_buffer.capacity() > 2 * (read_buffer.size() + read_chunk_size)) {
+        std::vector<char>(read_buffer).swap(read_buffer);
+    }
+
+    size_t old_size = read_buffer.size();
+    read_buffer.resize(old_size + read_chunk_size);
+    size_t delta;
+    try {
+        delta = read_internal(read_buffer.data() + old_size, read_chunk_size);
+    } catch (const tcp_conn_read_closed_exc_t &) {
+        read_buffer.resize(old_size);
+        throw;
+    }
+    read_buffer.resize(old_size + delta);
+
+    if (delta == read_chunk_size) {
+        read_chunk_size = std::min<size_t>(read_chunk_size * 2,
+                                           TCP_CONN_MAX_READ_BUFFER_SIZE);
+    } else if (delta < read_chunk_size / 4) {
+        read_chunk_size = std::max<size_t>(read_chunk_size / 2, IO_BUFFER_SIZE);
+    }
+}
+
 size_t linux_tcp_conn_t::read_some(void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
     rassert(size > 0);
     read_op_wrapper_t sentry(this, closer);
 
-    if (read_buffer.size()) {
-        /* Return the data from the peek buffer */
-        size_t read_buffer_bytes = std::min(read_buffer.size(), size);
-        memcpy(buf, read_buffer.data(), read_buffer_bytes);
-        read_buffer.erase(read_buffer.begin(), read_buffer.begin() + read_buffer_bytes);
-        return read_buffer_bytes;
-    } else {
-        /* Go to the kernel _once_. */
-        return read_internal(buf, size);
+    if (buffered_size() == 0) {
+        /* Go to the kernel _once_. Small reads go through the read buffer, so that
+        the next ones can be served from what we got. */
+        if (size >= read_chunk_size) {
+            return read_internal(buf, size);
+        }
+        fill_read_buffer();
     }
+    /* Return the data from the peek buffer */
+    return consume_buffered(buf, size);
 }
 
 void linux_tcp_conn_t::read(void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
     read_op_wrapper_t sentry(this, closer);
 
     /* First, consume any data in the peek buffer */
-    int read_buffer_bytes = std::min(read_buffer.size(), size);
-    memcpy(buf, read_buffer.data(), read_buffer_bytes);
-    read_buffer.erase(read_buffer.begin(), read_buffer.begin() + read_buffer_bytes);
+    size_t read_buffer_bytes = consume_buffered(buf, size);
     buf = reinterpret_cast<void *>(reinterpret_cast<char *>(buf) + read_buffer_bytes);
     size -= read_buffer_bytes;
 
-    /* Now go to the kernel for any more data that we need */
+    /* Now go to the kernel for any more data that we need. Large reads go straight
+    into `buf`; small ones are read together with whatever follows them, which saves
+    system calls when the peer sends many small messages or a header followed by a
+    body. */
     while (size > 0) {
-        size_t delta = read_internal(buf, size);
+        size_t delta;
+        if (size >= read_chunk_size) {
+            delta = read_internal(buf, size);
+        } else {
+            fill_read_buffer();
+            delta = consume_buffered(buf, size);
+        }
         rassert(delta <= size);
         buf = reinterpret_cast<void *>(reinterpret_cast<char *>(buf) + delta);
         size -= delta;
@@ -281,11 +342,7 @@ void linux_tcp_conn_t::read(void *buf, size_t size, signal_t *closer) THROWS_ONL
 void linux_tcp_conn_t::read_more_buffered(signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
     read_op_wrapper_t sentry(this, closer);
 
-    size_t old_size = read_buffer.size();
-    read_buffer.resize(old_size + IO_BUFFER_SIZE);
-    size_t delta = read_internal(read_buffer.data() + old_size, IO_BUFFER_SIZE);
-
-    read_buffer.resize(old_size + delta);
+    fill_read_buffer();
 }
 
 const_charslice linux_tcp_conn_t::peek() const THROWS_ONLY(tcp_conn_read_closed_exc_t) {
@@ -293,14 +350,14 @@ const_charslice linux_tcp_conn_t::peek() const THROWS_ONLY(tcp_conn_read_closed_
     rassert(!read_in_progress);   // Is there a read already in progress?
     if (read_closed.is_pulsed()) throw tcp_conn_read_closed_exc_t();
 
-    return const_charslice(read_buffer.data(), read_buffer.data() + read_buffer.size());
+    return const_charslice(buffered_data(), buffered_data() + buffered_size());
 }
 
 const_charslice linux_tcp_conn_t::peek(size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
-    while (read_buffer.size() < size) {
+    while (buffered_size() < size) {
         read_more_buffered(closer);
     }
-    return const_charslice(read_buffer.data(), read_buffer.data() + size);
+    return const_charslice(buffered_data(), buffered_data() + size);
 }
 
 void linux_tcp_conn_t::pop(size_t len, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
@@ -309,7 +366,7 @@ void linux_tcp_conn_t::pop(size_t len, signal_t *closer) THROWS_ONLY(tcp_conn_re
     if (read_closed.is_pulsed()) throw tcp_conn_read_closed_exc_t();
 
     peek(len, closer);
-    read_buffer.erase(read_buffer.begin(), read_buffer.begin() + len);  // INEFFICIENT
+    pop_buffered(len);
 }
 
 void linux_tcp_conn_t::shutdown_read() {
@@ -337,7 +394,9 @@ linux_tcp_conn_t::write_handler_t::write_handler_t(linux_tcp_conn_t *_parent) :
 { }
 
 void linux_tcp_conn_t::write_handler_t::coro_pool_callback(write_queue_op_t *operation, UNUSED signal_t *interruptor) {
-    if (operation->buffer != NULL) {
+    if (operation->buffers != NULL) {
+        parent->perform_write(operation->buffers);
+    } else if (operation->buffer != NULL) {
         parent->perform_write(operation->buffer, operation->size);
         if (operation->dealloc != NULL) {
             parent->release_write_buffer(operation->dealloc);
@@ -363,6 +422,7 @@ void linux_tcp_conn_t::internal_flush_write_buffer() {
     op->buffer = current_write_buffer->buffer;
     op->size = current_write_buffer->size;
     op->dealloc = current_write_buffer.release();
+    op->buffers = NULL;
     op->cond = NULL;
     op->keepalive = auto_drainer_t::lock_t(drainer.get());
     current_write_buffer.init(get_write_buffer());
@@ -377,6 +437,30 @@ void linux_tcp_conn_t::internal_flush_write_buffer() {
 }
 
 void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
+    iovec iov;
+    iov.iov_base = const_cast<void *>(buf);
+    iov.iov_len = size;
+    perform_writev(&iov, 1);
+}
+
+void linux_tcp_conn_t::perform_write(const const_buffer_group_t *buffers) {
+    std::vector<iovec> iov;
+    iov.reserve(buffers->num_buffers());
+    for (size_t i = 0; i < buffers->num_buffers(); ++i) {
+        const_buffer_group_t::buffer_t b = buffers->get_buffer(i);
+        if (b.size > 0) {
+            iovec v;
+            v.iov_base = const_cast<void *>(b.data);
+            v.iov_len = b.size;
+            iov.push_back(v);
+        }
+    }
+    if (!iov.empty()) {
+        perform_writev(iov.data(), iov.size());
+    }
+}
+
+void linux_tcp_conn_t::perform_writev(iovec *iov, size_t iovcnt) {
     assert_thread();
 
     if (write_closed.is_pulsed()) {
@@ -386,8 +470,8 @@ void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
         return;
     }
 
-    while (size > 0) {
-        ssize_t res = ::write(sock.get(), buf, size);
+    while (iovcnt > 0) {
+        ssize_t res = ::writev(sock.get(), iov, std::min<size_t>(iovcnt, IOV_MAX));
 
         if (res == -1 && (get_errno() == EAGAIN || get_errno() == EWOULDBLOCK)) {
             /* Wait for a notification from the event queue, or for an order to
@@ -425,10 +509,21 @@ void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
             break;
 
         } else {
-            rassert(res <= static_cast<ssize_t>(size));
-            buf = reinterpret_cast<const void *>(reinterpret_cast<const char *>(buf) + res);
-            size -= res;
             if (write_perfmon) write_perfmon->record(res);
+
+            /* Skip over what has been written, which may end in the middle of an
+            entry. */
+            size_t written = res;
+            while (iovcnt > 0 && written >= iov->iov_len) {
+                written -= iov->iov_len;
+                ++iov;
+                --iovcnt;
+            }
+            if (written > 0) {
+                rassert(iovcnt > 0);
+                iov->iov_base = static_cast<char *>(iov->iov_base) + written;
+                iov->iov_len -= written;
+            }
         }
     }
 }
@@ -448,6 +543,7 @@ void linux_tcp_conn_t::write(const void *buf, size_t size, signal_t *closer) THR
     /* Enqueue the write so it will happen eventually */
     op.buffer = buf;
     op.size = size;
+    op.buffers = NULL;
     op.dealloc = NULL;
     op.cond = &to_signal_when_done;
     write_queue.push(&op);
@@ -460,6 +556,29 @@ void linux_tcp_conn_t::write(const void *buf, size_t size, signal_t *closer) THR
     if (write_closed.is_pulsed()) throw tcp_conn_write_closed_exc_t();
 }
 
+void linux_tcp_conn_t::write(const const_buffer_group_t *buffers, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
+    write_op_wrapper_t sentry(this, closer);
+
+    write_queue_op_t op;
+    cond_t to_signal_when_done;
+
+    /* Flush out any data that's been buffered, so that things don't get out of order */
+    if (current_write_buffer->size > 0) internal_flush_write_buffer();
+
+    /* As in `write()`, we block until the write is done, so the buffers stay
+    valid and we don't need the write semaphore. */
+    op.buffer = NULL;
+    op.size = buffers->get_size();
+    op.buffers = buffers;
+    op.dealloc = NULL;
+    op.cond = &to_signal_when_done;
+    write_queue.push(&op);
+
+    to_signal_when_done.wait();
+
+    if (write_closed.is_pulsed()) throw tcp_conn_write_closed_exc_t();
+}
+
 void linux_tcp_conn_t::write_buffered(const void *vbuf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
     write_op_wrapper_t sentry(this, closer);
 
@@ -507,6 +626,7 @@ void linux_tcp_conn_t::flush_buffer(signal_t *closer) THROWS_ONLY(tcp_conn_write
     write_queue_op_t op;
     cond_t to_signal_when_done;
     op.buffer = NULL;
+    op.buffers = NULL;
     op.dealloc = NULL;
     op.cond = &to_signal_when_done;
     write_queue.push(&op);
@@ -636,11 +756,15 @@ void linux_tcp_conn_descriptor_t::make_overcomplicated(linux_tcp_conn_t **tcp_co
 /* Network listener object */
 linux_nonthrowing_tcp_listener_t::linux_nonthrowing_tcp_listener_t(
         const std::set<ip_address_t> &bind_addresses, int _port,
-        const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &cb) :
+        const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &cb,
+        accept_sharding_t _sharding) :
     callback(cb),
     local_addresses(bind_addresses),
     port(_port),
     bound(false),
+    sharding(_sharding),
+    is_shard(false),
+    home_thread(get_thread_id()),
     socks(),
     last_used_socket_index(0),
     event_watchers(),
@@ -676,9 +800,71 @@ bool linux_nonthrowing_tcp_listener_t::begin_listening() {
     coro_t::spawn_sometime(std::bind(
         &linux_nonthrowing_tcp_listener_t::accept_loop, this, auto_drainer_t::lock_t(accept_loop_drainer.get())));
 
+    if (sharding == accept_sharding_t::per_thread && !is_shard) {
+        start_shards();
+    }
+
     return true;
 }
 
+void linux_nonthrowing_tcp_listener_t::start_shards() {
+    rassert(get_thread_id() == home_thread);
+    shards.init(get_num_threads());
+    shard_drainers.init(get_num_threads());
+    pmap(get_num_threads(), [&](int i) {
+        if (threadnum_t(i) == home_thread) {
+            return;
+        }
+        on_thread_t thread_switcher((threadnum_t(i)));
+        shard_drainers[i].init(new auto_drainer_t);
+        scoped_ptr_t<linux_nonthrowing_tcp_listener_t> shard(
+            new linux_nonthrowing_tcp_listener_t(
+                local_addresses, port,
+                std::bind(&linux_nonthrowing_tcp_listener_t::handle_from_shard,
+                          this, i, ph::_1),
+                accept_sharding_t::per_thread));
+        shard->is_shard = true;
+        bool listening;
+        try {
+            listening = shard->begin_listening();
+        } catch (const tcp_socket_exc_t &) {
+            listening = false;
+        }
+        if (listening) {
+            shards[i] = std::move(shard);
+        } else {
+            // The listener on our own thread still accepts everything.
+            logWRN("Could not open an additional listener for port %d on thread %d.",
+                   port, i);
+        }
+    });
+}
+
+void linux_nonthrowing_tcp_listener_t::stop_shards() {
+    pmap(shards.size(), [&](int i) {
+        if (!shard_drainers[i].has()) {
+            return;
+        }
+        on_thread_t thread_switcher((threadnum_t(i)));
+        /* Stop accepting, then wait for the connections that are on their way to
+        us. */
+        shards[i].reset();
+        shard_drainers[i].reset();
+    });
+}
+
+void linux_nonthrowing_tcp_listener_t::handle_from_shard(
+        int shard, scoped_ptr_t<linux_tcp_conn_descriptor_t> &nconn) {
+    auto_drainer_t::lock_t lock(shard_drainers[shard].get());
+    fd_t sock = nconn->fd_;
+    nconn->fd_ = -1;
+    on_thread_t thread_switcher(home_thread);
+    /* Like `accept_loop()`, start the callback right away, but don't wait for it
+    to finish. It may keep the connection for a long time. */
+    coro_t::spawn_now_dangerously(
+        std::bind(&linux_nonthrowing_tcp_listener_t::handle, this, sock));
+}
+
 bool linux_nonthrowing_tcp_listener_t::is_bound() const {
     return bound;
 }
@@ -710,6 +896,20 @@ int linux_nonthrowing_tcp_listener_t::init_sockets() {
         int res = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &sockoptval, sizeof(sockoptval));
         guarantee_err(res != -1, "Could not set REUSEADDR option");
 
+        if (sharding == accept_sharding_t::per_thread) {
+#ifdef SO_REUSEPORT
+            res = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEPORT, &sockoptval, sizeof(sockoptval));
+#else
+            res = -1;
+            set_errno(ENOPROTOOPT);
+#endif
+            if (res == -1) {
+                logWRN("Could not set REUSEPORT option, accepting connections on one "
+                       "thread only: %s", errno_string(get_errno()).c_str());
+                sharding = accept_sharding_t::none;
+            }
+        }
+
         /* XXX Making our socket NODELAY prevents the problem where responses to
          * pipelined requests are delayed, since the TCP Nagle algorithm will
          * notice when we send multiple small packets and try to coalesce them. But
@@ -931,6 +1131,10 @@ void linux_nonthrowing_tcp_listener_t::handle(fd_t socket) {
 }
 
 linux_nonthrowing_tcp_listener_t::~linux_nonthrowing_tcp_listener_t() {
+    if (shards.has()) {
+        stop_shards();
+    }
+
     /* Interrupt the accept loop */
     accept_loop_drainer.reset();
 
@@ -957,8 +1161,10 @@ int linux_tcp_bound_socket_t::get_port() const {
 }
 
 linux_tcp_listener_t::linux_tcp_listener_t(const std::set<ip_address_t> &bind_addresses, int port,
-    const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &callback) :
-        listener(new linux_nonthrowing_tcp_listener_t(bind_addresses, port, callback))
+    const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &callback,
+    accept_sharding_t sharding) :
+        listener(new linux_nonthrowing_tcp_listener_t(bind_addresses, port, callback,
+                                                      sharding))
 {
     if (!listener->begin_listening()) {
         throw address_in_use_exc_t("localhost", listener->get_port());
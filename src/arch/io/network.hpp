@@ -30,6 +30,8 @@
 #include "containers/intrusive_list.hpp"
 #include "perfmon/types.hpp"
 
+class const_buffer_group_t;
+
 /* linux_tcp_conn_t provides a disgusting wrapper around a TCP network connection. */
 
 class linux_tcp_conn_t :
@@ -105,6 +107,11 @@ public:
     pipe and throws `tcp_conn_write_closed_exc_t`. */
     void write(const void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
 
+    /* Like `write()`, but sends all of the buffers in `buffers` in order, using as
+    few `writev()` calls as possible. The data isn't copied, so the buffers must stay
+    valid until this returns. */
+    void write(const const_buffer_group_t *buffers, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
+
     /* write_buffered() is like write(), but it might not send the data until
     flush_buffer*() or write() is called. Internally, it bundles together the
     buffered writes; this may improve performance. */
@@ -223,8 +230,32 @@ private:
     /* These are pulsed if and only if the read/write end of the connection has been closed. */
     cond_t read_closed, write_closed;
 
-    /* Holds data that we read from the socket but hasn't been consumed yet */
+    /* Holds data that we read from the socket but hasn't been consumed yet, starting at
+    `read_buffer_offset`. Consuming data only moves the offset; the consumed part is
+    dropped the next time we read into the buffer. */
     std::vector<char> read_buffer;
+    size_t read_buffer_offset;
+
+    /* How many bytes we ask for when reading into `read_buffer`. Doubles whenever a
+    read fills the whole chunk and halves when a read gets less than a quarter of
+    it, staying between `IO_BUFFER_SIZE` and `TCP_CONN_MAX_READ_BUFFER_SIZE`. */
+    size_t read_chunk_size;
+
+    size_t buffered_size() const {
+        return read_buffer.size() - read_buffer_offset;
+    }
+    const char *buffered_data() const {
+        return read_buffer.data() + read_buffer_offset;
+    }
+
+    /* Copies up to `size` bytes out of `read_buffer` and consumes them. Returns the
+    number of bytes copied. */
+    size_t consume_buffered(void *buf, size_t size);
+    void pop_buffered(size_t size);
+
+    /* Makes one call to `read_internal()`, appending up to `read_chunk_size` bytes to
+    `read_buffer`. */
+    void fill_read_buffer() THROWS_ONLY(tcp_conn_read_closed_exc_t);
 
     /* Reads up to the given number of bytes, but not necessarily that many. Simple wrapper around
     ::read(). Returns the number of bytes read or throws tcp_conn_read_closed_exc_t. Bypasses read_buffer. */
@@ -243,6 +274,8 @@ private:
         write_buffer_t *dealloc;
         const void *buffer;
         size_t size;
+        /* If non-NULL, the data to write instead of `buffer` and `size`. */
+        const const_buffer_group_t *buffers;
         cond_t *cond;
         auto_drainer_t::lock_t keepalive;
     };
@@ -300,6 +333,11 @@ private:
     /* Used to actually perform a write. If the write end of the connection is open, then writes
     `size` bytes from `buffer` to the socket. */
     void perform_write(const void *buffer, size_t size);
+    void perform_write(const const_buffer_group_t *buffers);
+
+    /* Writes out `iovcnt` entries of `iov`, which it modifies to keep track of
+    partial writes. */
+    void perform_writev(iovec *iov, size_t iovcnt);
 
     scoped_ptr_t<auto_drainer_t> drainer;
 };
@@ -332,7 +370,8 @@ the provided callback will be called in a new coroutine every time something con
 class linux_nonthrowing_tcp_listener_t : private linux_event_callback_t {
 public:
     linux_nonthrowing_tcp_listener_t(const std::set<ip_address_t> &bind_addresses, int _port,
-        const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &callback);
+        const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &callback,
+        accept_sharding_t sharding = accept_sharding_t::none);
 
     ~linux_nonthrowing_tcp_listener_t();
 
@@ -363,6 +402,15 @@ private:
 
     void handle(fd_t sock);
 
+    /* Opens the listeners on the other threads for `accept_sharding_t::per_thread`,
+    and closes them again. */
+    void start_shards();
+    void stop_shards();
+
+    /* The callback of the listener on `shard`'s thread. Passes the connection on to
+    `handle()` on our thread. */
+    void handle_from_shard(int shard, scoped_ptr_t<linux_tcp_conn_descriptor_t> &nconn);
+
     /* event_watcher sends any error conditions to here */
     void on_event(int events);
 
@@ -375,6 +423,19 @@ private:
     // Inidicates successful binding to a port
     bool bound;
 
+    accept_sharding_t sharding;
+
+    // True for the listeners that `start_shards()` creates on the other threads
+    bool is_shard;
+
+    // The thread we were created on, which is where the callback gets called
+    threadnum_t home_thread;
+
+    // For `accept_sharding_t::per_thread`, the listener on each other thread, and
+    // drainers for the connections they are passing to us. Indexed by thread.
+    scoped_array_t<scoped_ptr_t<linux_nonthrowing_tcp_listener_t> > shards;
+    scoped_array_t<scoped_ptr_t<auto_drainer_t> > shard_drainers;
+
     // The sockets to listen for connections on
     scoped_array_t<scoped_fd_t> socks;
 
@@ -404,7 +465,8 @@ public:
     linux_tcp_listener_t(linux_tcp_bound_socket_t *bound_socket,
         const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &callback);
     linux_tcp_listener_t(const std::set<ip_address_t> &bind_addresses, int port,
-        const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &callback);
+        const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &callback,
+        accept_sharding_t sharding = accept_sharding_t::none);
 
     int get_port() const;
 
@@ -38,16 +38,20 @@ bool artificial_stack_context_ref_t::is_nil() {
     return pointer == NULL;
 }
 
-artificial_stack_t::artificial_stack_t(void (*initial_fun)(void), size_t _stack_size)
-    : stack_size(_stack_size) {
-    /* Allocate the stack */
-    stack = malloc_aligned(stack_size, getpagesize());
+// Written just below the retained part of a stack by `release_unused_pages()`.
+static const uintptr_t UNUSED_PAGES_MARKER = 0x5afe57ac6bad1dea;
 
-    /* Tell the operating system that it can unmap the stack space
-    (except for the first page, which we are definitely going to need).
-    This is an optimization to keep memory consumption in check. */
+artificial_stack_t::artificial_stack_t(void (*initial_fun)(void), size_t _stack_size)
+    : stack_size(_stack_size), marked_retained_size(0) {
+    /* Allocate the stack. We map it directly rather than going through the
+    allocator, so that the operating system only backs the pages that the
+    coroutine actually touches, and so that `release_unused_pages()` can hand
+    pages back without interfering with the allocator. */
     guarantee(stack_size >= static_cast<size_t>(getpagesize()));
-    madvise(stack, stack_size - getpagesize(), MADV_DONTNEED);
+    guarantee(stack_size % getpagesize() == 0);
+    stack = mmap(NULL, stack_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANON, -1, 0);
+    guarantee_err(stack != MAP_FAILED, "Could not allocate coroutine stack");
 
     /* Protect the end of the stack so that we crash when we get a stack
     overflow instead of corrupting memory. */
@@ -154,17 +158,45 @@ artificial_stack_t::~artificial_stack_t() {
     /* Return the memory to the operating system right away. This makes
     sense because we keep our own cache of coroutine stacks around and
     don't need to rely on the allocator to optimize for the case of
-    us quickly re-allocating an object of the same size.
-    On OS X we use MADV_FREE. On Linux MADV_FREE is not available,
-    and we use MADV_DONTNEED instead. */
-#ifdef __MACH__
-    madvise(stack, stack_size, MADV_FREE);
-#else
-    madvise(stack, stack_size, MADV_DONTNEED);
-#endif
+    us quickly re-allocating an object of the same size. */
+    int res = munmap(stack, stack_size);
+    guarantee_err(res == 0, "Could not free coroutine stack");
+}
+
+uintptr_t *artificial_stack_t::unused_pages_marker(size_t retained_size) {
+    const uintptr_t retained_bound =
+        floor_aligned(reinterpret_cast<uintptr_t>(get_stack_base()) - retained_size,
+                      getpagesize());
+    return reinterpret_cast<uintptr_t *>(retained_bound) - 1;
+}
+
+void artificial_stack_t::release_unused_pages(size_t retained_size) {
+    // Leave at least the protection page and one usable page below the retained
+    // region, otherwise there's nothing worth releasing.
+    if (retained_size + 2 * getpagesize() >= stack_size) {
+        return;
+    }
+
+    uintptr_t *marker = unused_pages_marker(retained_size);
+    if (marked_retained_size == retained_size && *marker == UNUSED_PAGES_MARKER) {
+        // Nobody went past the retained region since the last time.
+        return;
+    }
+
+    char dummy;
+    guarantee(reinterpret_cast<uintptr_t>(&dummy) > reinterpret_cast<uintptr_t>(marker),
+              "release_unused_pages() called too deep into the stack");
+
+    // Everything between the protection page and the retained region is below the
+    // current stack pointer, so it doesn't hold anything live.
+    char *release_begin = static_cast<char *>(stack) + getpagesize();
+    char *release_end = reinterpret_cast<char *>(marker + 1);
+    if (release_end > release_begin) {
+        madvise(release_begin, release_end - release_begin, MADV_DONTNEED);
+    }
 
-    /* Release the stack we allocated */
-    free(stack);
+    *marker = UNUSED_PAGES_MARKER;
+    marked_retained_size = retained_size;
 }
 
 bool artificial_stack_t::address_in_stack(void *addr) {
@@ -65,9 +65,23 @@ public:
     /* Returns the end of the stack */
     void *get_stack_bound() { return stack; }
 
+    /* Gives the pages of the stack that lie more than `retained_size` bytes below
+    its base back to the operating system, so that a stack whose coroutine once
+    went deep doesn't keep that memory resident forever. Must be called while
+    running on this stack, with the stack pointer inside the retained region.
+
+    To keep this cheap for the common case of a shallow coroutine, we only make
+    the syscall if a marker word just below the retained region has been
+    overwritten since the last call. A deep excursion that happens to skip the
+    marker word isn't noticed, and its pages stay resident until a later one. */
+    void release_unused_pages(size_t retained_size);
+
 private:
+    uintptr_t *unused_pages_marker(size_t retained_size);
+
     void *stack;
     size_t stack_size;
+    size_t marked_retained_size;
 #ifdef VALGRIND
     int valgrind_stack_id;
 #endif
@@ -177,6 +191,9 @@ public:
     /* Returns the end of the stack */
     void *get_stack_bound();
 
+    /* The thread's stack is managed by pthreads, so there's nothing to release. */
+    void release_unused_pages(UNUSED size_t retained_size) { }
+
 private:
     static void *internal_run(void *p);
     void get_stack_addr_size(void **stackaddr_out, size_t *stacksize_out);
@@ -0,0 +1,51 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/runtime/coro_latency.hpp"
+
+#include <string.h>
+
+#include "config/args.hpp"
+
+// Spawn site descriptions longer than this are cut off. The callable types of
+// `std::bind` expressions can get very long.
+static const size_t MAX_SPAWN_SITE_DESCRIPTION_LENGTH = 256;
+
+coro_latency_histogram_t::coro_latency_histogram_t() {
+    memset(buckets, 0, sizeof(buckets));
+}
+
+void coro_latency_histogram_t::add(ticks_t duration) {
+    uint64_t usecs = duration / THOUSAND;
+    int bucket = 0;
+    while (usecs != 0 && bucket < CORO_LATENCY_HISTOGRAM_BUCKETS - 1) {
+        usecs >>= 1;
+        ++bucket;
+    }
+    ++buckets[bucket];
+}
+
+void coro_latency_histogram_t::merge(const coro_latency_histogram_t &other) {
+    for (int i = 0; i < CORO_LATENCY_HISTOGRAM_BUCKETS; ++i) {
+        buckets[i] += other.buckets[i];
+    }
+}
+
+std::string describe_coro_spawn_site(const char *spawn_site) {
+    // The key looks like
+    // "static coro_t* coro_t::get_and_init_coro(Callable&&) [with Callable = ...]".
+    std::string description(spawn_site);
+    const std::string marker = "Callable = ";
+    size_t begin = description.find(marker);
+    if (begin != std::string::npos) {
+        begin += marker.size();
+        size_t end = description.rfind(']');
+        if (end == std::string::npos || end < begin) {
+            end = description.size();
+        }
+        description = description.substr(begin, end - begin);
+    }
+    if (description.size() > MAX_SPAWN_SITE_DESCRIPTION_LENGTH) {
+        description.resize(MAX_SPAWN_SITE_DESCRIPTION_LENGTH);
+        description += "...";
+    }
+    return description;
+}
@@ -0,0 +1,46 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_CORO_LATENCY_HPP_
+#define ARCH_RUNTIME_CORO_LATENCY_HPP_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+
+#include "time.hpp"
+
+/* Unlike the `coro_profiler_t`, the coroutine latency sampler is always compiled
+in. Every `CORO_LATENCY_SAMPLE_INTERVAL`th coroutine notification on a thread is
+sampled: we record how long the coroutine then waited in the message queue before
+it got to run ("wait"), and how long it ran before it yielded again ("run"). The
+samples are aggregated per spawn site, i.e. per type of callable the coroutine was
+spawned with, into logarithmic histograms.
+
+The histograms are exported as the `coroutine_latency` stat, which can be read
+through the `rethinkdb._debug_stats` table. */
+
+// Bucket 0 counts durations below 1us, bucket i durations of [2^(i-1), 2^i) us, and
+// the last bucket everything longer.
+#define CORO_LATENCY_HISTOGRAM_BUCKETS 24
+
+struct coro_latency_histogram_t {
+    coro_latency_histogram_t();
+    void add(ticks_t duration);
+    void merge(const coro_latency_histogram_t &other);
+
+    uint64_t buckets[CORO_LATENCY_HISTOGRAM_BUCKETS];
+};
+
+struct coro_latency_site_stats_t {
+    coro_latency_histogram_t wait, run;
+};
+
+// Keyed by the `__PRETTY_FUNCTION__` of the `coro_t::get_and_init_coro()`
+// instantiation that spawned the coroutine. The pointers are string literals, so
+// they're the same on every thread.
+typedef std::map<const char *, coro_latency_site_stats_t> coro_latency_stats_t;
+
+// Turns a spawn site key into something readable: the type of the callable.
+std::string describe_coro_spawn_site(const char *spawn_site);
+
+#endif  // ARCH_RUNTIME_CORO_LATENCY_HPP_
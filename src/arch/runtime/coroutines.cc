@@ -1,6 +1,7 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "arch/runtime/coroutines.hpp"
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -12,6 +13,7 @@
 #endif
 
 #include "arch/runtime/context_switching.hpp"
+#include "arch/runtime/coro_latency.hpp"
 #include "arch/runtime/coro_profiler.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "arch/runtime/thread_pool.hpp"
@@ -23,6 +25,7 @@
 #include "utils.hpp"
 
 size_t coro_stack_size = COROUTINE_STACK_SIZE; //Default, setable by command-line parameter
+size_t coro_stack_retained_size = COROUTINE_STACK_RETAINED_SIZE;
 
 /* `coro_globals_t` holds all of the thread-local variables that coroutines need
 to operate. There is one per thread; it is constructed by the constructor for
@@ -43,6 +46,18 @@ struct coro_globals_t {
     /* A list of coro_t objects that are not in use. */
     intrusive_list_t<coro_t> free_coros;
 
+    /* A coroutine on this thread that was notified by the current coroutine and
+    will be switched to directly once the current coroutine blocks, instead of going
+    through the message queue. `handoffs_until_message_hub` counts down the direct
+    handoffs we may still do before control has to go back to the message hub. */
+    coro_t *handoff_coro;
+    int handoffs_until_message_hub;
+
+    /* Latency samples of coroutines that ran on this thread, and how many more
+    notifications to let through until we take the next sample. */
+    coro_latency_stats_t latency_stats;
+    int notifies_until_latency_sample;
+
 #ifndef NDEBUG
 
     /* An integer counting the number of coros on this thread */
@@ -68,6 +83,9 @@ struct coro_globals_t {
     coro_globals_t()
         : current_coro(NULL)
         , prev_coro(NULL)
+        , handoff_coro(NULL)
+        , handoffs_until_message_hub(COROUTINE_MAX_DIRECT_HANDOFFS)
+        , notifies_until_latency_sample(CORO_LATENCY_SAMPLE_INTERVAL)
 #ifndef NDEBUG
         , coro_count(0)
         , assert_no_coro_waiting_counter(0)
@@ -78,6 +96,7 @@ struct coro_globals_t {
     ~coro_globals_t() {
         /* We shouldn't be shutting down from within a coroutine */
         rassert(!current_coro);
+        rassert(!handoff_coro);
 
         /* Destroy remaining coroutines */
         while (coro_t *s = free_coros.head()) {
@@ -94,9 +113,73 @@ TLS_with_init(coro_globals_t *, cglobals, NULL);
 // construction depends on coro_t::coroutines_have_been_initialized() which in turn
 // depends on cglobals.
 static perfmon_counter_t pm_active_coroutines, pm_allocated_coroutines;
+
+class perfmon_coro_latency_t
+    : public perfmon_perthread_t<coro_latency_stats_t> {
+public:
+    perfmon_coro_latency_t() { }
+
+private:
+    void get_thread_stat(coro_latency_stats_t *stat_out) {
+        *stat_out = TLS_get_cglobals()->latency_stats;
+    }
+
+    coro_latency_stats_t combine_stats(const coro_latency_stats_t *stats) {
+        coro_latency_stats_t combined;
+        for (int i = 0; i < get_num_threads(); ++i) {
+            for (auto it = stats[i].begin(); it != stats[i].end(); ++it) {
+                coro_latency_site_stats_t *site = &combined[it->first];
+                site->wait.merge(it->second.wait);
+                site->run.merge(it->second.run);
+            }
+        }
+        return combined;
+    }
+
+    static ql::datum_t histogram_to_datum(const coro_latency_histogram_t &histogram) {
+        ql::datum_object_builder_t builder;
+        for (int i = 0; i < CORO_LATENCY_HISTOGRAM_BUCKETS; ++i) {
+            if (histogram.buckets[i] == 0) {
+                continue;
+            }
+            std::string label = i == CORO_LATENCY_HISTOGRAM_BUCKETS - 1
+                ? strprintf(">=%" PRIu64 "us", uint64_t(1) << (i - 1))
+                : strprintf("<%" PRIu64 "us", uint64_t(1) << i);
+            builder.overwrite(label.c_str(),
+                ql::datum_t(static_cast<double>(histogram.buckets[i])));
+        }
+        return std::move(builder).to_datum();
+    }
+
+    ql::datum_t output_stat(const coro_latency_stats_t &stats) {
+        // Different instantiations can have the same description after
+        // shortening, so we merge them again by description.
+        std::map<std::string, coro_latency_site_stats_t> by_description;
+        for (auto it = stats.begin(); it != stats.end(); ++it) {
+            coro_latency_site_stats_t *site =
+                &by_description[describe_coro_spawn_site(it->first)];
+            site->wait.merge(it->second.wait);
+            site->run.merge(it->second.run);
+        }
+        ql::datum_object_builder_t builder;
+        for (auto it = by_description.begin(); it != by_description.end(); ++it) {
+            ql::datum_object_builder_t site_builder;
+            site_builder.overwrite("wait", histogram_to_datum(it->second.wait));
+            site_builder.overwrite("run", histogram_to_datum(it->second.run));
+            builder.overwrite(it->first.c_str(), std::move(site_builder).to_datum());
+        }
+        return std::move(builder).to_datum();
+    }
+
+    DISABLE_COPYING(perfmon_coro_latency_t);
+};
+
+static perfmon_coro_latency_t pm_coroutine_latency;
+
 static perfmon_multi_membership_t pm_coroutines_membership(&get_global_perfmon_collection(),
     &pm_active_coroutines, "active_coroutines",
-    &pm_allocated_coroutines, "allocated_coroutines");
+    &pm_allocated_coroutines, "allocated_coroutines",
+    &pm_coroutine_latency, "coroutine_latency");
 
 coro_runtime_t::coro_runtime_t() {
     rassert(!TLS_get_cglobals(), "coro runtime initialized twice on this thread");
@@ -126,7 +209,11 @@ coro_t::coro_t() :
     stack(&coro_t::run, coro_stack_size),
     current_thread_(linux_thread_pool_t::get_thread_id()),
     notified_(false),
-    waiting_(false)
+    waiting_(false),
+    sampled_notify_at_(0),
+    sampled_resume_at_(0),
+    run_time_account_(NULL),
+    run_time_started_at_(0)
 #ifndef NDEBUG
     , selfname_number(get_thread_id().threadnum + MAX_THREADS *
           // The comma here is the comma operator, to implement the semantics
@@ -185,6 +272,7 @@ void coro_t::run() {
         rassert(coro->notified_ == false);
         rassert(coro->waiting_ == true);
         coro->waiting_ = false;
+        coro->sample_resume();
 
 #ifndef NDEBUG
         // Keep track of how many coroutines of each type ran
@@ -195,6 +283,10 @@ void coro_t::run() {
         PROFILER_CORO_RESUME;
         coro->action_wrapper.run();
         PROFILER_CORO_YIELD(0);
+        coro->sample_yield();
+        // Accounts are scoped, so they can't outlive the action that set them.
+        rassert(coro->run_time_account_ == NULL);
+        coro->run_time_account_ = NULL;
 #ifndef NDEBUG
         TLS_get_cglobals()->running_coroutine_counts[coro->coroutine_type]--;
         TLS_get_cglobals()->active_coroutines.erase(coro);
@@ -205,15 +297,37 @@ void coro_t::run() {
         // Destroy the Callable object which was either allocated within the coro_t or on the heap
         coro->action_wrapper.reset();
 
+        // We're at the bottom of the coroutine's call stack now, so this is the
+        // time to give back the stack pages the action used beyond the retained size.
+        if (coro_stack_retained_size != 0) {
+            coro->stack.release_unused_pages(coro_stack_retained_size);
+        }
+
         /* Return the context to the free-contexts list we took it from. */
         do_on_thread(coro->home_thread(), std::bind(&coro_t::return_coro_to_free_list, coro));
         --pm_active_coroutines;
 
-        if (TLS_get_cglobals()->prev_coro) {
-            context_switch(&coro->stack.context, &TLS_get_cglobals()->prev_coro->stack.context);
-        } else {
-            context_switch(&coro->stack.context, &TLS_get_cglobals()->scheduler);
-        }
+        switch_out_of(coro);
+    }
+}
+
+void coro_t::switch_out_of(coro_t *coro) {
+    coro_globals_t *cglobals = TLS_get_cglobals();
+    rassert(cglobals->current_coro == coro);
+    if (cglobals->prev_coro) {
+        // We were entered through `notify_now_deprecated()`, which expects us to
+        // come back to it. A pending handoff is done once the outer coroutine blocks.
+        context_switch(&coro->stack.context, &cglobals->prev_coro->stack.context);
+    } else if (cglobals->handoff_coro != NULL) {
+        coro_t *next = cglobals->handoff_coro;
+        cglobals->handoff_coro = NULL;
+        --cglobals->handoffs_until_message_hub;
+        rassert(next->notified_);
+        next->notified_ = false;
+        cglobals->current_coro = next;
+        context_switch(&coro->stack.context, &next->stack.context);
+    } else {
+        context_switch(&coro->stack.context, &cglobals->scheduler);
     }
 }
 
@@ -247,16 +361,14 @@ void coro_t::wait() {   /* class method */
     self()->waiting_ = true;
 
     PROFILER_CORO_YIELD(1);
-    if (TLS_get_cglobals()->prev_coro) {
-        context_switch(&self()->stack.context, &TLS_get_cglobals()->prev_coro->stack.context);
-    } else {
-        context_switch(&self()->stack.context, &TLS_get_cglobals()->scheduler);
-    }
+    self()->sample_yield();
+    switch_out_of(self());
     PROFILER_CORO_RESUME;
 
     rassert(self());
     rassert(self()->waiting_);
     self()->waiting_ = false;
+    self()->sample_resume();
 }
 
 void coro_t::yield() {  /* class method */
@@ -300,7 +412,9 @@ void coro_t::notify_now_deprecated() {
         context_switch(&TLS_get_cglobals()->scheduler, &this->stack.context);
     }
 
-    rassert(TLS_get_cglobals()->current_coro == this);
+    // If we were called from the main context, this coroutine may have handed off
+    // to another one, and it's that one which switched back to us.
+    rassert(TLS_get_cglobals()->current_coro == this || TLS_get_cglobals()->prev_coro == NULL);
     TLS_get_cglobals()->current_coro = TLS_get_cglobals()->prev_coro;
     TLS_get_cglobals()->prev_coro = prev_prev_coro;
     if (coro_t::self() != NULL) {
@@ -316,6 +430,19 @@ void coro_t::notify_now_deprecated() {
 void coro_t::notify_sometime() {
     rassert(!notified_);
     notified_ = true;
+    maybe_sample_notify();
+
+    coro_globals_t *cglobals = TLS_get_cglobals();
+    if (cglobals != NULL
+        && cglobals->current_coro != NULL
+        && cglobals->current_coro != this
+        && cglobals->handoff_coro == NULL
+        && cglobals->handoffs_until_message_hub > 0
+        && current_thread_.threadnum == linux_thread_pool_t::get_thread_id()) {
+        cglobals->handoff_coro = this;
+        return;
+    }
+
     linux_thread_pool_t::get_thread()->message_hub.store_message_sometime(
         current_thread_,
         this);
@@ -324,6 +451,7 @@ void coro_t::notify_sometime() {
 void coro_t::notify_later_ordered() {
     rassert(!notified_);
     notified_ = true;
+    maybe_sample_notify();
 
     /* `current_thread` is the thread that the coroutine lives on, which may or may not be the
     same as `get_thread_id()`.  (In a call to move_to_thread, it won't be.) */
@@ -332,6 +460,53 @@ void coro_t::notify_later_ordered() {
         this);
 }
 
+void coro_t::maybe_sample_notify() {
+    coro_globals_t *cglobals = TLS_get_cglobals();
+    if (cglobals != NULL && --cglobals->notifies_until_latency_sample <= 0) {
+        cglobals->notifies_until_latency_sample = CORO_LATENCY_SAMPLE_INTERVAL;
+        sampled_notify_at_ = get_ticks();
+    }
+}
+
+void coro_t::sample_resume() {
+    if (run_time_account_ != NULL) {
+        run_time_started_at_ = get_ticks();
+    }
+    if (sampled_notify_at_ != 0) {
+        // The samples are recorded on the thread the coroutine runs on, which after
+        // `move_to_thread()` isn't the thread that notified it.
+        ticks_t now = get_ticks();
+        TLS_get_cglobals()->latency_stats[spawn_site_].wait.add(now - sampled_notify_at_);
+        sampled_notify_at_ = 0;
+        sampled_resume_at_ = now;
+    }
+}
+
+void coro_t::sample_yield() {
+    if (run_time_account_ != NULL) {
+        run_time_account_->fetch_add(get_ticks() - run_time_started_at_);
+    }
+    if (sampled_resume_at_ != 0) {
+        TLS_get_cglobals()->latency_stats[spawn_site_].run.add(
+            get_ticks() - sampled_resume_at_);
+        sampled_resume_at_ = 0;
+    }
+}
+
+std::atomic<ticks_t> *coro_t::set_run_time_account(std::atomic<ticks_t> *account) {
+    coro_t *coro = self();
+    rassert(coro != NULL, "coro_t::set_run_time_account() called when not in a "
+                          "coroutine.");
+    const ticks_t now = get_ticks();
+    std::atomic<ticks_t> *prev_account = coro->run_time_account_;
+    if (prev_account != NULL) {
+        prev_account->fetch_add(now - coro->run_time_started_at_);
+    }
+    coro->run_time_account_ = account;
+    coro->run_time_started_at_ = now;
+    return prev_account;
+}
+
 void coro_t::move_to_thread(threadnum_t thread) {
     assert_good_thread_id(thread);
     rassert(coro_t::self(), "coro_t::move_to_thread() called when not in a coroutine.");
@@ -348,6 +523,9 @@ void coro_t::on_thread_switch() {
     rassert(notified_);
     notified_ = false;
 
+    // We're being run by the message hub, so other messages had their turn.
+    TLS_get_cglobals()->handoffs_until_message_hub = COROUTINE_MAX_DIRECT_HANDOFFS;
+
     /* TODO: When `notify_now_deprecated()` is finally removed, just fold it
     into this function. */
     notify_now_deprecated();
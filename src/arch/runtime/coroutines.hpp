@@ -2,6 +2,7 @@
 #ifndef ARCH_RUNTIME_COROUTINES_HPP_
 #define ARCH_RUNTIME_COROUTINES_HPP_
 
+#include <atomic>
 #ifndef NDEBUG
 #include <string>
 #endif
@@ -105,7 +106,9 @@ public:
     /* Schedules the coroutine to be woken up eventually. Can be safely called
     from any thread. Returns immediately. Does not provide any ordering
     guarantees. If you don't need the ordering guarantees that
-    `notify_later_ordered()` provides, use `notify_sometime()`. */
+    `notify_later_ordered()` provides, use `notify_sometime()`. If the calling
+    coroutine is on the same thread and blocks afterwards, it may switch straight to
+    this coroutine instead of going through the message queue. */
     void notify_sometime();
 
     /* Pushes the coroutine onto the event queue for the thread it's currently
@@ -134,6 +137,12 @@ public:
 
     static void set_coroutine_stack_size(size_t size);
 
+    /* From now on, the time the current coroutine spends running (as opposed to
+    waiting) gets added to `*account`, in ticks, on whichever thread it runs.
+    Returns the previous account, which may be `NULL` for none. Use
+    `scoped_coro_run_time_account_t` rather than calling this directly. */
+    static std::atomic<ticks_t> *set_run_time_account(std::atomic<ticks_t> *account);
+
     coro_stack_t *get_stack();
 
     void set_priority(int _priority) {
@@ -170,6 +179,7 @@ private:
 #ifndef NDEBUG
         coro->parse_coroutine_type(__PRETTY_FUNCTION__);
 #endif
+        coro->spawn_site_ = __PRETTY_FUNCTION__;
         coro->grab_spawn_backtrace();
         coro->action_wrapper.reset(std::forward<Callable>(action));
 
@@ -208,6 +218,23 @@ private:
 
     callable_action_wrapper_t action_wrapper;
 
+    // Switches away from `coro`, which must be the current coroutine. See
+    // `COROUTINE_MAX_DIRECT_HANDOFFS`.
+    static void switch_out_of(coro_t *coro);
+
+    // Latency sampling; see coro_latency.hpp. The timestamps are 0 unless the
+    // current notification or run is being sampled.
+    void maybe_sample_notify();
+    void sample_resume();
+    void sample_yield();
+    ticks_t sampled_notify_at_;
+    ticks_t sampled_resume_at_;
+
+    // See `set_run_time_account()`. `run_time_started_at_` is when the coroutine
+    // last resumed, if it has an account.
+    std::atomic<ticks_t> *run_time_account_;
+    ticks_t run_time_started_at_;
+
 #ifndef NDEBUG
     int64_t selfname_number;
     std::string coroutine_type;
@@ -222,6 +249,20 @@ private:
     DISABLE_COPYING(coro_t);
 };
 
+/* Charges the running time of the current coroutine to `*account` for as long as it
+exists; the destructor charges the time to whatever account was set before. */
+class scoped_coro_run_time_account_t {
+public:
+    explicit scoped_coro_run_time_account_t(std::atomic<ticks_t> *account)
+        : prev_account_(coro_t::set_run_time_account(account)) { }
+    ~scoped_coro_run_time_account_t() {
+        coro_t::set_run_time_account(prev_account_);
+    }
+private:
+    std::atomic<ticks_t> *prev_account_;
+    DISABLE_COPYING(scoped_coro_run_time_account_t);
+};
+
 /* Returns true if the given address is in the protection page of the current coroutine. */
 bool is_coroutine_stack_overflow(void *addr);
 bool coroutines_have_been_initialized();
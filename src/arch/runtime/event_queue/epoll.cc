@@ -12,12 +12,14 @@
 #include <new>
 #include <algorithm>
 #include <string>
+#include <vector>
 
 #include "config/args.hpp"
 #include "utils.hpp"
 #include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/thread_pool.hpp"
 #include "perfmon/perfmon.hpp"
+#include "rdb_protocol/datum.hpp"
 
 int user_to_epoll(int mode) {
 
@@ -45,6 +47,54 @@ int epoll_to_user(int mode) {
     return out_mode;
 }
 
+/* Exposes each thread's `epoll_batch_stats_t`.  Unlike most perfmons, this one
+doesn't combine the per-thread values, because the point is to see which threads
+are busy. */
+class perfmon_epoll_batching_t
+    : public perfmon_perthread_t<epoll_batch_stats_t, std::vector<epoll_batch_stats_t> > {
+public:
+    perfmon_epoll_batching_t() { }
+
+private:
+    void get_thread_stat(epoll_batch_stats_t *stat_out) {
+        *stat_out = linux_thread_pool_t::get_thread()->queue.get_batch_stats();
+    }
+
+    std::vector<epoll_batch_stats_t> combine_stats(const epoll_batch_stats_t *stats) {
+        return std::vector<epoll_batch_stats_t>(stats, stats + get_num_threads());
+    }
+
+    ql::datum_t output_stat(const std::vector<epoll_batch_stats_t> &stats) {
+        ql::datum_object_builder_t builder;
+        for (size_t i = 0; i < stats.size(); ++i) {
+            const epoll_batch_stats_t &s = stats[i];
+            ql::datum_object_builder_t thread_builder;
+            thread_builder.overwrite("wakeups",
+                                     ql::datum_t(static_cast<double>(s.wakeups)));
+            thread_builder.overwrite("events_per_wakeup",
+                s.wakeups == 0
+                ? ql::datum_t::null()
+                : ql::datum_t(static_cast<double>(s.events) / s.wakeups));
+            thread_builder.overwrite("callback_secs",
+                                     ql::datum_t(ticks_to_secs(s.callback_ticks)));
+            thread_builder.overwrite("batch_size",
+                                     ql::datum_t(static_cast<double>(s.batch_size)));
+            builder.overwrite(strprintf("%zu", i).c_str(),
+                              std::move(thread_builder).to_datum());
+        }
+        return std::move(builder).to_datum();
+    }
+
+    DISABLE_COPYING(perfmon_epoll_batching_t);
+};
+
+// A singleton for the same reason as `pm_eventloop_singleton_t`.
+static void ensure_epoll_batching_perfmon() {
+    static perfmon_epoll_batching_t pm_batching;
+    static perfmon_membership_t pm_batching_membership(
+        &get_global_perfmon_collection(), &pm_batching, "eventloop_batching");
+}
+
 epoll_event_queue_t::epoll_event_queue_t(linux_queue_parent_t *_parent)
     : parent(_parent) {
     // Create a poll fd
@@ -56,10 +106,14 @@ epoll_event_queue_t::epoll_event_queue_t(linux_queue_parent_t *_parent)
 void epoll_event_queue_t::run() {
     int res;
 
+    ensure_epoll_batching_perfmon();
+    thread_activity_stats_t *activity_stats =
+        &linux_thread_pool_t::get_thread()->activity_stats;
+
     // Now, start the loop
     while (!parent->should_shut_down()) {
         // Grab the events from the kernel!
-        res = epoll_wait(epoll_fd, events, MAX_IO_EVENT_PROCESSING_BATCH_SIZE, -1);
+        res = epoll_wait(epoll_fd, events, batch_stats.batch_size, -1);
 
         // epoll_wait might return with EINTR in some cases (in
         // particular under GDB), we just need to retry.
@@ -97,6 +151,8 @@ void epoll_event_queue_t::run() {
         // Caches by Goetz Graege and Pre-Ake Larson).
 
         block_pm_duration event_loop_timer(pm_eventloop_singleton_t::get());
+        thread_activity_sampler_t activity_sampler(activity_stats);
+        const int events_gotten_count = nevents;
 
         for (int i = 0; i < nevents; i++) {
             if (events[i].data.ptr == NULL) {
@@ -118,10 +174,29 @@ void epoll_event_queue_t::run() {
 
         nevents = 0;
 
+        adapt_batch_size(events_gotten_count, activity_sampler.callbacks_done());
+
         parent->pump();
     }
 }
 
+void epoll_event_queue_t::adapt_batch_size(int events_gotten, ticks_t callback_ticks) {
+    ++batch_stats.wakeups;
+    batch_stats.events += events_gotten;
+    batch_stats.callback_ticks += callback_ticks;
+
+    if (callback_ticks > static_cast<ticks_t>(IO_EVENT_BATCH_LATENCY_TARGET_USECS * THOUSAND)) {
+        // The callbacks are keeping the message hub (and timers) waiting too long.
+        batch_stats.batch_size = std::max(batch_stats.batch_size / 2,
+                                          MIN_ADAPTIVE_IO_EVENT_BATCH_SIZE);
+    } else if (events_gotten == batch_stats.batch_size) {
+        // There were (probably) more events ready than we asked for, so we'd have
+        // taken another trip through epoll_wait just to get them.
+        batch_stats.batch_size = std::min(batch_stats.batch_size * 2,
+                                          MAX_ADAPTIVE_IO_EVENT_BATCH_SIZE);
+    }
+}
+
 epoll_event_queue_t::~epoll_event_queue_t() {
     DEBUG_VAR int res = close(epoll_fd);
     rassert_err(res == 0, "Could not close epoll_fd");
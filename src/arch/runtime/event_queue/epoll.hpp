@@ -11,6 +11,18 @@
 #include "arch/runtime/event_queue_types.hpp"
 #include "arch/runtime/runtime_utils.hpp"
 #include "config/args.hpp"
+#include "time.hpp"
+
+// Counters describing how the event loop on one thread has been batching events.
+struct epoll_batch_stats_t {
+    epoll_batch_stats_t()
+        : wakeups(0), events(0), callback_ticks(0),
+          batch_size(MAX_IO_EVENT_PROCESSING_BATCH_SIZE) { }
+    uint64_t wakeups;
+    uint64_t events;
+    ticks_t callback_ticks;
+    int batch_size;
+};
 
 // Event queue structure
 struct epoll_event_queue_t {
@@ -25,7 +37,13 @@ public:
     void adjust_resource(fd_t resource, int events, linux_event_callback_t *cb);
     void forget_resource(fd_t resource, linux_event_callback_t *cb);
 
+    // Only valid on the queue's own thread.
+    const epoll_batch_stats_t &get_batch_stats() const { return batch_stats; }
+
 private:
+    // Picks the size of the next batch based on how the last one went.
+    void adapt_batch_size(int events_gotten, ticks_t callback_ticks);
+
     linux_queue_parent_t *parent;
 
     fd_t epoll_fd;
@@ -33,9 +51,11 @@ private:
     // We store this as a class member because forget_resource needs
     // to go through the events and remove queued messages for
     // resources that are being destroyed.
-    epoll_event events[MAX_IO_EVENT_PROCESSING_BATCH_SIZE];
+    epoll_event events[MAX_ADAPTIVE_IO_EVENT_BATCH_SIZE];
     int nevents;
 
+    epoll_batch_stats_t batch_stats;
+
 #ifndef NDEBUG
     /* In debug mode, check to make sure epoll() doesn't give us events that
     we didn't ask for. The ints stored here are combinations of poll_event_in
@@ -60,6 +60,9 @@ int call_kevent(int kq, const struct kevent *changelist, int nchanges,
 }
 
 void kqueue_event_queue_t::run() {
+    thread_activity_stats_t *activity_stats =
+        &linux_thread_pool_t::get_thread()->activity_stats;
+
     // Now, start the loop
     while (!parent->should_shut_down()) {
         // Grab the events from the kqueue!
@@ -67,6 +70,7 @@ void kqueue_event_queue_t::run() {
                               events, MAX_IO_EVENT_PROCESSING_BATCH_SIZE, NULL);
 
         block_pm_duration event_loop_timer(pm_eventloop_singleton_t::get());
+        thread_activity_sampler_t activity_sampler(activity_stats);
 
         for (int i = 0; i < nevents; i++) {
             if (events[i].udata == NULL) {
@@ -80,6 +84,7 @@ void kqueue_event_queue_t::run() {
                 cb->on_event(kevent_filter_to_user(events[i].filter));
             }
         }
+        activity_sampler.callbacks_done();
 
         parent->pump();
     }
@@ -97,6 +97,9 @@ void poll_event_queue_t::run() {
     guarantee_err(res == 0, "Could not create a full signal mask");
 #endif  // RDB_TIMER_PROVIDER
 
+    thread_activity_stats_t *activity_stats =
+        &linux_thread_pool_t::get_thread()->activity_stats;
+
     // Now, start the loop
     while (!parent->should_shut_down()) {
         // Grab the events from the kernel!
@@ -118,6 +121,7 @@ void poll_event_queue_t::run() {
         guarantee_err(res != -1, "Waiting for poll events failed");
 
         block_pm_duration event_loop_timer(pm_eventloop_singleton_t::get());
+        thread_activity_sampler_t activity_sampler(activity_stats);
 
         int count = 0;
         for (unsigned int i = 0; i < watched_fds.size(); i++) {
@@ -129,6 +133,7 @@ void poll_event_queue_t::run() {
             if (count == res)
                 break;
         }
+        activity_sampler.callbacks_done();
 
 #ifndef RDB_TIMER_PROVIDER
 #error "RDB_TIMER_PROVIDER not defined."
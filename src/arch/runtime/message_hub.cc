@@ -6,6 +6,7 @@
 
 #include "config/args.hpp"
 #include "arch/runtime/event_queue.hpp"
+#include "arch/runtime/thread_activity.hpp"
 #include "arch/runtime/thread_pool.hpp"
 #include "logger.hpp"
 #include "utils.hpp"
@@ -17,10 +18,12 @@
 
 linux_message_hub_t::linux_message_hub_t(linux_event_queue_t *queue,
                                          linux_thread_pool_t *thread_pool,
-                                         threadnum_t current_thread)
+                                         threadnum_t current_thread,
+                                         thread_activity_stats_t *activity_stats)
     : queue_(queue),
       thread_pool_(thread_pool),
-      is_woken_up_(false),
+      activity_stats_(activity_stats),
+      incoming_messages_head_(NULL),
       current_thread_(current_thread) {
 
 #ifndef NDEBUG
@@ -44,7 +47,7 @@ linux_message_hub_t::~linux_message_hub_t() {
         guarantee(get_priority_msg_list(p).empty());
     }
 
-    guarantee(incoming_messages_.empty());
+    guarantee(incoming_messages_head_ == NULL);
 }
 
 void linux_message_hub_t::do_store_message(threadnum_t nthread, linux_thread_message_t *msg) {
@@ -91,19 +94,42 @@ void linux_message_hub_t::store_message_sometime(threadnum_t nthread, linux_thre
 
 
 void linux_message_hub_t::insert_external_message(linux_thread_message_t *msg) {
-    bool do_wake_up;
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        do_wake_up = !check_and_set_is_woken_up();
-        incoming_messages_.push_back(msg);
-    }
-
     // Wakey wakey eggs and bakey
-    if (do_wake_up) {
+    if (push_incoming_message(msg)) {
         event_.wakey_wakey();
     }
 }
 
+bool linux_message_hub_t::push_incoming_messages(msg_list_t *msgs) {
+    rassert(!msgs->empty());
+
+    // Link the messages up in reverse, so that the last one ends up on top.
+    linux_thread_message_t *bottom = msgs->head();
+    linux_thread_message_t *top = NULL;
+    while (linux_thread_message_t *m = msgs->head()) {
+        msgs->remove(m);
+        m->next_incoming_ = top;
+        top = m;
+    }
+
+    linux_thread_message_t *old_head = incoming_messages_head_;
+    for (;;) {
+        bottom->next_incoming_ = old_head;
+        linux_thread_message_t *prev =
+            __sync_val_compare_and_swap(&incoming_messages_head_, old_head, top);
+        if (prev == old_head) {
+            return old_head == NULL;
+        }
+        old_head = prev;
+    }
+}
+
+bool linux_message_hub_t::push_incoming_message(linux_thread_message_t *msg) {
+    msg_list_t msgs;
+    msgs.push_back(msg);
+    return push_incoming_messages(&msgs);
+}
+
 linux_message_hub_t::msg_list_t &linux_message_hub_t::get_priority_msg_list(int priority) {
     rassert(priority >= MESSAGE_SCHEDULER_MIN_PRIORITY);
     rassert(priority <= MESSAGE_SCHEDULER_MAX_PRIORITY);
@@ -133,7 +159,9 @@ void linux_message_hub_t::on_event(int events) {
     const size_t effective_granularity = std::min(total_pending_msgs,
                                                   static_cast<size_t>(MESSAGE_SCHEDULER_GRANULARITY));
 
-    // Process a certain number of messages from each priority
+    // Process a certain number of messages from each priority. Each message is
+    // timed until the next one starts.
+    ticks_t message_start = get_ticks();
     for (int current_priority = MESSAGE_SCHEDULER_MAX_PRIORITY;
          current_priority >= MESSAGE_SCHEDULER_MIN_PRIORITY; --current_priority) {
 
@@ -164,23 +192,30 @@ void linux_message_hub_t::on_event(int events) {
             }
 #endif
 
+            // `m` may be gone once it has run.
+            const char *spawn_site = m->spawn_site_;
             m->on_thread_switch();
+            const ticks_t message_end = get_ticks();
+            activity_stats_->record_message(message_end - message_start, spawn_site);
+            message_start = message_end;
         }
     }
 
     // We might have left some messages unprocessed.
     // Check if that is the case, and if yes, make sure we are called again.
+    size_t remaining_msgs = 0;
+    for (int i = 0; i < NUM_SCHEDULER_PRIORITIES; ++i) {
+        remaining_msgs += priority_msg_lists_[i].size();
+    }
+    activity_stats_->message_queue_length = remaining_msgs;
     for (int i = 0; i < NUM_SCHEDULER_PRIORITIES; ++i) {
         if (!priority_msg_lists_[i].empty()) {
             // Place wakey_wakey and then yield to the event processing.
             // It will wake us up again immediately, but can handle a few
             // OS events (such as timers, network messages etc.) in the meantime.
-            bool do_wake_up;
-            {
-                spinlock_acq_t acq(&incoming_messages_lock_);
-                do_wake_up = !check_and_set_is_woken_up();
-            }
-            if (do_wake_up) {
+            // If the incoming stack isn't empty, whoever pushed onto it has
+            // already notified us.
+            if (incoming_messages_head_ == NULL) {
                 event_.wakey_wakey();
             }
             break;
@@ -189,17 +224,26 @@ void linux_message_hub_t::on_event(int events) {
 }
 
 void linux_message_hub_t::sort_incoming_messages_by_priority() {
-    // We do this in two steps to release the spinlock faster.
-    // append_and_clear is a very cheap operation, while
-    // assigning each message to a different priority queue
-    // is more expensive.
+    // 1. Take everything off the incoming stack. A sender that pushes after this
+    // finds the stack empty again and notifies us.
+    linux_thread_message_t *top = incoming_messages_head_;
+    for (;;) {
+        linux_thread_message_t *prev =
+            __sync_val_compare_and_swap(&incoming_messages_head_, top, NULL);
+        if (prev == top) {
+            break;
+        }
+        top = prev;
+    }
 
-    // 1. Pull the messages
+    // The stack has the newest message on top, so reverse it to get the messages
+    // back into the order in which they were sent.
     msg_list_t new_messages;
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        new_messages.append_and_clear(&incoming_messages_);
-        is_woken_up_ = false;
+    while (top != NULL) {
+        linux_thread_message_t *next = top->next_incoming_;
+        top->next_incoming_ = NULL;
+        new_messages.push_front(top);
+        top = next;
     }
 
     // 2. Sort the messages into their respective priority queues
@@ -218,37 +262,25 @@ void linux_message_hub_t::sort_incoming_messages_by_priority() {
     }
 }
 
-bool linux_message_hub_t::check_and_set_is_woken_up() {
-    const bool was_woken_up = is_woken_up_;
-    is_woken_up_ = true;
-    return was_woken_up;
-}
-
-// Pushes messages collected locally global lists available to all
-// threads.
+// Pushes messages collected locally onto the incoming stacks of the threads
+// they're destined for.
 void linux_message_hub_t::push_messages() {
     for (int i = 0; i < thread_pool_->n_threads; i++) {
-        // Append the local list for ith thread to that thread's global
-        // message list.
+        // Push the local list for ith thread onto that thread's incoming
+        // stack.
         thread_queue_t *queue = &queues_[i];
         if (!queue->msg_local_list.empty()) {
             // Transfer messages to the other core
 
-            bool do_wake_up;
-            {
-                spinlock_acq_t acq(&thread_pool_->threads[i]->message_hub.incoming_messages_lock_);
+            linux_message_hub_t *hub = &thread_pool_->threads[i]->message_hub;
 
-                // We only need to do a wake up if we're the first people to do a
-                // wake up.
-                do_wake_up =
-                    !thread_pool_->threads[i]->message_hub.check_and_set_is_woken_up();
-
-                thread_pool_->threads[i]->message_hub.incoming_messages_.append_and_clear(&queue->msg_local_list);
-            }
+            // We only need to do a wake up if the other thread's incoming stack
+            // was empty; otherwise a wake up is still pending.
+            bool do_wake_up = hub->push_incoming_messages(&queue->msg_local_list);
 
             // Wakey wakey, perhaps eggs and bakey
             if (do_wake_up) {
-                thread_pool_->threads[i]->message_hub.event_.wakey_wakey();
+                hub->event_.wakey_wakey();
             }
         }
     }
@@ -8,7 +8,6 @@
 #include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/runtime_utils.hpp"
 #include "arch/runtime/system_event.hpp"
-#include "arch/spinlock.hpp"
 #include "config/args.hpp"
 #include "containers/intrusive_list.hpp"
 #include "threading.hpp"
@@ -20,6 +19,7 @@
 
 
 class linux_thread_pool_t;
+struct thread_activity_stats_t;
 
 /* There is one message hub per thread, NOT one message hub for the entire program.
 
@@ -31,7 +31,8 @@ public:
     typedef intrusive_list_t<linux_thread_message_t> msg_list_t;
 
     linux_message_hub_t(linux_event_queue_t *queue, linux_thread_pool_t *thread_pool,
-                        threadnum_t current_thread);
+                        threadnum_t current_thread,
+                        thread_activity_stats_t *activity_stats);
 
     /* For each thread, transfer messages from our msg_local_list for that thread to our
     msg_global_list for that thread */
@@ -56,7 +57,7 @@ private:
     // debug mode.
     void do_store_message(threadnum_t nthread, linux_thread_message_t *msg);
 
-    // Moves messages from incoming_messages_ into the respective entries of
+    // Moves messages from the incoming stack into the respective entries of
     // priority_msg_lists, depending on the messages' priorities.
     void sort_incoming_messages_by_priority();
 
@@ -64,21 +65,26 @@ private:
 
     linux_event_queue_t *const queue_;
     linux_thread_pool_t *const thread_pool_;
+    thread_activity_stats_t *const activity_stats_;
 
     /* Queue for messages going from this->current_thread to other threads */
     struct thread_queue_t {
         //TODO this doesn't need to be a class anymore
 
-        /* Messages are cached here before being pushed to the global list so that we don't
-        have to acquire the spinlock as often */
+        /* Messages are cached here before being pushed to the other thread's incoming
+        stack, so that we only do one compare-and-swap per batch */
         msg_list_t msg_local_list;
     } queues_[MAX_THREADS];
 
-    // Must only be used with acquired incoming_messages_lock_
-    bool check_and_set_is_woken_up();
-    bool is_woken_up_;
-    msg_list_t incoming_messages_;
-    spinlock_t incoming_messages_lock_;
+    /* Messages from other threads are pushed onto a lock-free stack, linked
+    through `linux_thread_message_t::next_incoming_`, with the newest message on
+    top. Every sender pushes its whole batch for us with a single compare-and-swap,
+    and we take everything at once by swapping in `NULL`. Only the sender that
+    finds the stack empty has to notify `event_`; as long as the stack is non-empty
+    a wakeup is already pending. Returns true if the stack was empty. */
+    bool push_incoming_messages(msg_list_t *msgs);
+    bool push_incoming_message(linux_thread_message_t *msg);
+    linux_thread_message_t *volatile incoming_messages_head_;
 
     // Use `sort_incoming_messages_by_priority()` to sort incoming_messages_ into
     // these lists.
@@ -91,7 +97,7 @@ private:
     void on_event(int events);
 
     // The eventfd (or pipe-based alternative) notified after the first incoming
-    // message is put onto incoming_messages_.
+    // message is pushed onto the empty incoming stack.
     system_event_t event_;
 
     /* The thread that we queue messages originating from. (Recall that there is one
@@ -0,0 +1,88 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/runtime/numa.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+
+#include "arch/runtime/runtime_utils.hpp"
+#include "errors.hpp"
+#include "utils.hpp"
+
+#ifdef __linux
+// Parses a list such as "0-3,8-11" as found in sysfs `cpulist` files.
+static bool parse_cpu_list(const char *list, std::vector<int> *cpus_out) {
+    const char *p = list;
+    while (*p != '\0' && *p != '\n') {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0) {
+            return false;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            ++p;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) {
+                return false;
+            }
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; ++cpu) {
+            cpus_out->push_back(cpu);
+        }
+        if (*p == ',') {
+            ++p;
+        }
+    }
+    return true;
+}
+
+static bool read_node_cpus(int node, std::vector<int> *cpus_out) {
+    const std::string path =
+        strprintf("/sys/devices/system/node/node%d/cpulist", node);
+    FILE *f = fopen(path.c_str(), "r");
+    if (f == NULL) {
+        return false;
+    }
+    char buf[4096];
+    bool ok = fgets(buf, sizeof(buf), f) != NULL && parse_cpu_list(buf, cpus_out);
+    fclose(f);
+    return ok;
+}
+#endif  // __linux
+
+numa_topology_t::numa_topology_t() {
+#ifdef __linux
+    // Node numbers can have holes (for example on machines with memory-only
+    // nodes), so we skip nodes without CPUs instead of stopping at the first one.
+    for (int node = 0; node < MAX_NUMA_NODES; ++node) {
+        std::vector<int> cpus;
+        if (read_node_cpus(node, &cpus) && !cpus.empty()) {
+            node_cpus.push_back(cpus);
+        }
+    }
+#endif
+
+    if (node_cpus.empty()) {
+        std::vector<int> cpus;
+        for (int cpu = 0; cpu < get_cpu_count(); ++cpu) {
+            cpus.push_back(cpu);
+        }
+        node_cpus.push_back(cpus);
+    }
+
+    for (size_t node = 0; node < node_cpus.size(); ++node) {
+        for (auto it = node_cpus[node].begin(); it != node_cpus[node].end(); ++it) {
+            cpus_by_node.push_back(*it);
+            cpu_nodes.push_back(node);
+        }
+    }
+}
+
+const std::vector<int> &numa_topology_t::cpus_on_node(int node) const {
+    guarantee(node >= 0 && node < num_nodes());
+    return node_cpus[node];
+}
@@ -0,0 +1,29 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_NUMA_HPP_
+#define ARCH_RUNTIME_NUMA_HPP_
+
+#include <vector>
+
+/* `numa_topology_t` describes which CPUs belong to which NUMA node. On Linux it is
+read from `/sys/devices/system/node`. If the topology can't be determined (or we
+aren't on Linux), it reports a single node that contains all online CPUs. */
+
+class numa_topology_t {
+public:
+    numa_topology_t();
+
+    int num_nodes() const { return node_cpus.size(); }
+    const std::vector<int> &cpus_on_node(int node) const;
+
+    /* All CPUs, ordered by node. Consecutive entries are on the same node
+    whenever possible. */
+    const std::vector<int> &all_cpus() const { return cpus_by_node; }
+    int node_of_cpu_index(int index) const { return cpu_nodes[index]; }
+
+private:
+    std::vector<std::vector<int> > node_cpus;
+    std::vector<int> cpus_by_node;
+    std::vector<int> cpu_nodes;
+};
+
+#endif  // ARCH_RUNTIME_NUMA_HPP_
@@ -11,6 +11,10 @@ threadnum_t get_thread_id();
 
 int get_num_threads();
 
+// The NUMA node the given thread runs on. Always 0 unless the thread pool was started
+// with `thread_affinity_t::numa`.
+int get_thread_numa_node(threadnum_t thread);
+
 #ifndef NDEBUG
 void assert_good_thread_id(threadnum_t thread);
 #else
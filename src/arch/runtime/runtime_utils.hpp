@@ -15,14 +15,18 @@ class linux_thread_message_t : public intrusive_list_node_t<linux_thread_message
 public:
     explicit linux_thread_message_t(int _priority)
         : priority(_priority),
-        is_ordered(false)
+        is_ordered(false),
+        next_incoming_(NULL),
+        spawn_site_(NULL)
 #ifndef NDEBUG
         , reloop_count_(0)
 #endif
         { }
     linux_thread_message_t()
         : priority(MESSAGE_SCHEDULER_DEFAULT_PRIORITY),
-        is_ordered(false)
+        is_ordered(false),
+        next_incoming_(NULL),
+        spawn_site_(NULL)
 #ifndef NDEBUG
         , reloop_count_(0)
 #endif
@@ -37,6 +41,13 @@ private:
     friend class linux_message_hub_t;
     int priority;
     bool is_ordered; // Used internally by the message hub
+    // Links the message into the receiving message hub's lock-free incoming stack.
+    linux_thread_message_t *next_incoming_;
+protected:
+    // Set by `coro_t` to the coroutine's spawn site, so that the message hub can
+    // tell what it spends its time on. NULL for other messages.
+    const char *spawn_site_;
+private:
 #ifndef NDEBUG
     int reloop_count_;
 #endif
@@ -46,6 +57,11 @@ typedef linux_thread_message_t thread_message_t;
 
 int get_cpu_count();
 
+/* How the thread pool places its threads on CPUs. `cpus` pins thread i to CPU
+i % get_cpu_count(). `numa` pins the threads to cores so that they are spread evenly
+over the NUMA nodes, with consecutive threads on the same node. */
+enum class thread_affinity_t { none, cpus, numa };
+
 // More pollution of runtime_utils.hpp.
 #ifndef NDEBUG
 
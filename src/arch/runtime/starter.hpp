@@ -6,10 +6,14 @@
 
 #include <functional>
 
+#include "arch/runtime/runtime_utils.hpp"
+
 /* `run_in_thread_pool()` starts a RethinkDB thread pool, runs the given
 function in a coroutine inside of it, waits for the function to return, and then
-shuts down the thread pool. */
+shuts down the thread pool. `thread_affinity` controls how the pool's threads are
+pinned to CPUs. */
 
-void run_in_thread_pool(const std::function<void()> &fun, int worker_threads);
+void run_in_thread_pool(const std::function<void()> &fun, int worker_threads,
+                        thread_affinity_t thread_affinity = thread_affinity_t::none);
 
 #endif  // ARCH_RUNTIME_STARTER_HPP_
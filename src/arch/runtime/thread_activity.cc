@@ -0,0 +1,115 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/runtime/thread_activity.hpp"
+
+#include <vector>
+
+#include "arch/runtime/coro_latency.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "config/args.hpp"
+#include "perfmon/perfmon.hpp"
+#include "rdb_protocol/datum.hpp"
+
+thread_activity_window_t::thread_activity_window_t()
+    : busy_ticks(0), longest_message_ticks(0), longest_message_site(NULL) { }
+
+thread_activity_stats_t::thread_activity_stats_t()
+    : busy_ticks(0), callback_ticks(0), message_queue_length(0),
+      window_start(get_ticks()) { }
+
+void thread_activity_stats_t::record_wakeup(ticks_t start, ticks_t callbacks_end,
+                                            ticks_t end) {
+    busy_ticks += end - start;
+    callback_ticks += callbacks_end - start;
+    current_window.busy_ticks += end - start;
+    maybe_rotate_window(end);
+}
+
+void thread_activity_stats_t::maybe_rotate_window(ticks_t now) {
+    const ticks_t window_ticks = THREAD_ACTIVITY_WINDOW_MS * MILLION;
+    if (now - window_start < window_ticks) {
+        return;
+    }
+    last_window = now - window_start < 2 * window_ticks
+        ? current_window
+        : thread_activity_window_t();
+    current_window = thread_activity_window_t();
+    window_start = now;
+}
+
+thread_activity_sampler_t::thread_activity_sampler_t(thread_activity_stats_t *stats)
+    : stats_(stats), start_(get_ticks()), callbacks_end_(0) { }
+
+thread_activity_sampler_t::~thread_activity_sampler_t() {
+    const ticks_t end = get_ticks();
+    stats_->record_wakeup(start_, callbacks_end_ == 0 ? end : callbacks_end_, end);
+}
+
+ticks_t thread_activity_sampler_t::callbacks_done() {
+    callbacks_end_ = get_ticks();
+    return callbacks_end_ - start_;
+}
+
+/* Like `eventloop_batching`, this doesn't combine the per-thread values, because
+the point is to see which threads are busy. */
+class perfmon_thread_activity_t
+    : public perfmon_perthread_t<thread_activity_stats_t,
+                                  std::vector<thread_activity_stats_t> > {
+public:
+    perfmon_thread_activity_t() { }
+
+private:
+    void get_thread_stat(thread_activity_stats_t *stat_out) {
+        thread_activity_stats_t *stats =
+            &linux_thread_pool_t::get_thread()->activity_stats;
+        // Otherwise an idle thread would keep reporting its last busy window.
+        stats->maybe_rotate_window(get_ticks());
+        *stat_out = *stats;
+    }
+
+    std::vector<thread_activity_stats_t> combine_stats(
+            const thread_activity_stats_t *stats) {
+        return std::vector<thread_activity_stats_t>(stats, stats + get_num_threads());
+    }
+
+    ql::datum_t output_stat(const std::vector<thread_activity_stats_t> &stats) {
+        const double window_secs = THREAD_ACTIVITY_WINDOW_MS / 1000.0;
+        ql::datum_object_builder_t builder;
+        for (size_t i = 0; i < stats.size(); ++i) {
+            const thread_activity_stats_t &s = stats[i];
+            // The longest message of the current and the last window.
+            const thread_activity_window_t &longest =
+                s.current_window.longest_message_ticks
+                    > s.last_window.longest_message_ticks
+                ? s.current_window
+                : s.last_window;
+            ql::datum_object_builder_t thread_builder;
+            thread_builder.overwrite("busy_secs",
+                                     ql::datum_t(ticks_to_secs(s.busy_ticks)));
+            thread_builder.overwrite("callback_secs",
+                                     ql::datum_t(ticks_to_secs(s.callback_ticks)));
+            thread_builder.overwrite("utilization",
+                ql::datum_t(ticks_to_secs(s.last_window.busy_ticks) / window_secs));
+            thread_builder.overwrite("message_queue_length",
+                ql::datum_t(static_cast<double>(s.message_queue_length)));
+            thread_builder.overwrite("longest_message_secs",
+                ql::datum_t(ticks_to_secs(longest.longest_message_ticks)));
+            thread_builder.overwrite("longest_message_site",
+                longest.longest_message_site == NULL
+                ? ql::datum_t::null()
+                : ql::datum_t(datum_string_t(
+                      describe_coro_spawn_site(longest.longest_message_site))));
+            builder.overwrite(strprintf("%zu", i).c_str(),
+                              std::move(thread_builder).to_datum());
+        }
+        return std::move(builder).to_datum();
+    }
+
+    DISABLE_COPYING(perfmon_thread_activity_t);
+};
+
+// A singleton for the same reason as `pm_eventloop_singleton_t`.
+void ensure_thread_activity_perfmon() {
+    static perfmon_thread_activity_t pm_thread_activity;
+    static perfmon_membership_t pm_thread_activity_membership(
+        &get_global_perfmon_collection(), &pm_thread_activity, "thread_activity");
+}
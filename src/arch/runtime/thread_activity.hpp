@@ -0,0 +1,75 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_THREAD_ACTIVITY_HPP_
+#define ARCH_RUNTIME_THREAD_ACTIVITY_HPP_
+
+#include <stddef.h>
+
+#include <string>
+
+#include "time.hpp"
+
+/* Always-on counters for how busy one thread of the thread pool is. They are
+updated by the thread's event queue and message hub, and exported as the
+`thread_activity` stat, one entry per thread, so that threads which get more than
+their share of the work stand out.
+
+"Busy" is the time the event loop spends outside of waiting for events, and
+"callbacks" the part of it spent in event callbacks (including the message hub's).
+The message hub times every message it delivers; a coroutine's time includes any
+coroutines it directly hands off to, and is attributed to its spawn site. */
+
+struct thread_activity_window_t {
+    thread_activity_window_t();
+    ticks_t busy_ticks;
+    ticks_t longest_message_ticks;
+    // The spawn site (see `coro_t`) of the longest message, or NULL if it wasn't a
+    // coroutine.
+    const char *longest_message_site;
+};
+
+struct thread_activity_stats_t {
+    thread_activity_stats_t();
+
+    void record_wakeup(ticks_t start, ticks_t callbacks_end, ticks_t end);
+    void record_message(ticks_t duration, const char *spawn_site) {
+        if (duration > current_window.longest_message_ticks) {
+            current_window.longest_message_ticks = duration;
+            current_window.longest_message_site = spawn_site;
+        }
+    }
+
+    /* Starts a new window if `THREAD_ACTIVITY_WINDOW_MS` have passed since the
+    current one started. */
+    void maybe_rotate_window(ticks_t now);
+
+    ticks_t busy_ticks;
+    ticks_t callback_ticks;
+    // How many messages were left in the message hub after its last pass.
+    size_t message_queue_length;
+
+    ticks_t window_start;
+    thread_activity_window_t current_window;
+    // All zeros if the thread didn't get to rotate its window for a full window.
+    thread_activity_window_t last_window;
+};
+
+/* Times one pass of the event loop, from the wakeup to when the loop goes back to
+waiting for events. Call `callbacks_done()` once the event callbacks have run. */
+class thread_activity_sampler_t {
+public:
+    explicit thread_activity_sampler_t(thread_activity_stats_t *stats);
+    ~thread_activity_sampler_t();
+
+    // Returns how long the callbacks took.
+    ticks_t callbacks_done();
+
+private:
+    thread_activity_stats_t *const stats_;
+    const ticks_t start_;
+    ticks_t callbacks_end_;
+};
+
+// Registers the `thread_activity` stat; called by each thread as it starts up.
+void ensure_thread_activity_perfmon();
+
+#endif  // ARCH_RUNTIME_THREAD_ACTIVITY_HPP_
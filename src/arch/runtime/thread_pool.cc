@@ -43,18 +43,34 @@ NOINLINE void linux_thread_pool_t::set_thread(linux_thread_t *val) {
     thread = val;
 }
 
-linux_thread_pool_t::linux_thread_pool_t(int worker_threads, bool _do_set_affinity) :
+linux_thread_pool_t::linux_thread_pool_t(int worker_threads,
+                                         thread_affinity_t _thread_affinity) :
 #ifndef NDEBUG
       coroutine_summary(false),
 #endif
       interrupt_message(NULL),
       generic_blocker_pool(NULL),
       n_threads(worker_threads + 1),    // we create an extra utility thread
-      do_set_affinity(_do_set_affinity)
+      thread_affinity(_thread_affinity)
 {
     rassert(n_threads > 1);             // we want at least one non-utility thread
     rassert(n_threads <= MAX_THREADS);
 
+    // Spread the threads evenly over the CPUs in node order. If there are more
+    // threads than CPUs, we wrap around.
+    const std::vector<int> &cpus = numa_topology.all_cpus();
+    const int ncpus = cpus.size();
+    for (int i = 0; i < n_threads; ++i) {
+        if (thread_affinity == thread_affinity_t::numa) {
+            int index = n_threads <= ncpus ? i * ncpus / n_threads : i % ncpus;
+            thread_cpus[i] = cpus[index];
+            thread_numa_nodes[i] = numa_topology.node_of_cpu_index(index);
+        } else {
+            thread_cpus[i] = -1;
+            thread_numa_nodes[i] = 0;
+        }
+    }
+
     int res;
 
     res = pthread_cond_init(&shutdown_cond, NULL);
@@ -100,6 +116,18 @@ void *linux_thread_pool_t::start_thread(void *arg) {
 
     thread_data_t *tdata = reinterpret_cast<thread_data_t *>(arg);
 
+#ifdef _GNU_SOURCE
+    // Pin ourselves before allocating anything, so that our memory is allocated on
+    // our local NUMA node.
+    if (tdata->thread_pool->thread_affinity == thread_affinity_t::numa) {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(tdata->thread_pool->thread_cpus[tdata->current_thread], &mask);
+        int res = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &mask);
+        guarantee_xerr(res == 0, res, "Could not set thread affinity");
+    }
+#endif
+
     // Set thread-local variables
     set_thread_pool(tdata->thread_pool);
     set_thread_id(tdata->current_thread);
@@ -152,6 +180,8 @@ void *linux_thread_pool_t::start_thread(void *arg) {
             local_thread.message_hub.insert_external_message(tdata->initial_message);
         }
 
+        ensure_thread_activity_perfmon();
+
         local_thread.queue.run();
 
         // If one thread is allowed to delete itself before another one has
@@ -177,6 +207,27 @@ void *linux_thread_pool_t::start_thread(void *arg) {
     return NULL;
 }
 
+void linux_thread_pool_t::set_helper_thread_affinity(UNUSED pthread_attr_t *attr) {
+#ifdef _GNU_SOURCE
+    linux_thread_pool_t *pool = get_thread_pool();
+    const int current_thread = get_thread_id();
+    if (pool == NULL
+        || pool->thread_affinity != thread_affinity_t::numa
+        || current_thread < 0) {
+        return;
+    }
+    const std::vector<int> &cpus =
+        pool->numa_topology.cpus_on_node(pool->thread_numa_nodes[current_thread]);
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (auto it = cpus.begin(); it != cpus.end(); ++it) {
+        CPU_SET(*it, &mask);
+    }
+    int res = pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t), &mask);
+    guarantee_xerr(res == 0, res, "Could not set helper thread affinity");
+#endif
+}
+
 #ifndef NDEBUG
 void linux_thread_pool_t::enable_coroutine_summary() {
     coroutine_summary = true;
@@ -200,7 +251,7 @@ void linux_thread_pool_t::run_thread_pool(linux_thread_message_t *initial_messag
         int res = pthread_create(&pthreads[i], NULL, &start_thread, tdata);
         guarantee_xerr(res == 0, res, "Could not create thread");
 
-        if (do_set_affinity) {
+        if (thread_affinity == thread_affinity_t::cpus) {
             // On Apple, the thread affinity API has awful documentation, so we don't even bother.
 #ifdef _GNU_SOURCE
             // Distribute threads evenly among CPUs
@@ -377,7 +428,7 @@ linux_thread_pool_t::~linux_thread_pool_t() {
 
 linux_thread_t::linux_thread_t(linux_thread_pool_t *parent_pool, int thread_id)
     : queue(this),
-      message_hub(&queue, parent_pool, threadnum_t(thread_id)),
+      message_hub(&queue, parent_pool, threadnum_t(thread_id), &activity_stats),
       timer_handler(&queue),
       do_shutdown(false)
 #ifndef NDEBUG
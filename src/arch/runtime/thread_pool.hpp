@@ -11,6 +11,9 @@
 #include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/system_event.hpp"
 #include "arch/runtime/message_hub.hpp"
+#include "arch/runtime/numa.hpp"
+#include "arch/runtime/thread_activity.hpp"
+#include "arch/spinlock.hpp"
 #include "arch/runtime/coroutines.hpp"
 #include "arch/io/blocker_pool.hpp"
 #include "arch/io/timer_provider.hpp"
@@ -39,7 +42,7 @@ and shutting down the threads and event queues. */
 
 class linux_thread_pool_t {
 public:
-    linux_thread_pool_t(int worker_threads, bool do_set_affinity);
+    linux_thread_pool_t(int worker_threads, thread_affinity_t thread_affinity);
 
     // When the process receives a SIGINT or SIGTERM, interrupt_message will be delivered to the
     // same thread that initial_message was delivered to, and interrupt_message will be set to
@@ -90,7 +93,23 @@ public:
     static void run_in_blocker_pool(const Callable &);
 
     int n_threads;
-    bool do_set_affinity;
+    const thread_affinity_t thread_affinity;
+
+    /* If `thread_affinity` is `numa`, thread i gets pinned to `thread_cpus[i]`, which
+    is on NUMA node `thread_numa_nodes[i]`. The thread pins itself before it sets up
+    its event queue, message hub and coroutine runtime, so that (with the kernel's
+    default first-touch policy) all of its memory ends up on its local node.
+    Otherwise every thread is considered to be on node 0. */
+    numa_topology_t numa_topology;
+    int thread_cpus[MAX_THREADS];
+    int thread_numa_nodes[MAX_THREADS];
+
+    /* Restricts threads created with `attr` to the CPUs of the current thread's NUMA
+    node if `thread_affinity` is `numa`. Blocker pools (including the disk I/O
+    threads) use this so that they run on the same socket as the thread that uses
+    them, instead of inheriting the single-core mask of the creating thread. Does
+    nothing otherwise. */
+    static void set_helper_thread_affinity(pthread_attr_t *attr);
 
     // Non-inlinable getters and setters for the thread local variables.
     // See thread_local.hpp for an explanation of why these must not be
@@ -160,6 +179,9 @@ public:
     linux_thread_t(linux_thread_pool_t *parent_pool, int thread_id);
     ~linux_thread_t();
 
+    // Only accessed from the thread itself.
+    thread_activity_stats_t activity_stats;
+
     linux_event_queue_t queue;
     linux_message_hub_t message_hub;
     timer_handler_t timer_handler;
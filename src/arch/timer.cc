@@ -1,17 +1,25 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "arch/timer.hpp"
 
+#include <algorithm>
+#include <limits>
+
 #include "arch/runtime/thread_pool.hpp"
+#include "config/args.hpp"
 #include "time.hpp"
 #include "utils.hpp"
 
-class timer_token_t : public intrusive_priority_queue_node_t<timer_token_t> {
+class timer_token_t : public intrusive_list_node_t<timer_token_t> {
     friend class timer_handler_t;
 
 private:
-    timer_token_t() : interval_nanos(-1), next_time_in_nanos(-1), callback(NULL) { }
+    timer_token_t()
+        : interval_nanos(-1), next_time_in_nanos(-1), callback(NULL),
+          level(NOT_IN_A_LIST), slot(-1) { }
 
-    friend bool left_is_higher_priority(const timer_token_t *left, const timer_token_t *right);
+    // Values of `level` for tokens that aren't in a slot of the wheel.
+    static const int IN_DUE_TOKENS = -1;
+    static const int NOT_IN_A_LIST = -2;
 
     // The time between rings, if a repeating timer, otherwise zero.
     int64_t interval_nanos;
@@ -22,81 +30,251 @@ private:
     // The callback we call upon each 'ring'.
     timer_callback_t *callback;
 
+    // Where the token is in the wheel.
+    int level;
+    int slot;
+
     DISABLE_COPYING(timer_token_t);
 };
 
-bool left_is_higher_priority(const timer_token_t *left, const timer_token_t *right) {
-    return left->next_time_in_nanos < right->next_time_in_nanos;
+static const int64_t TIMER_TICK_IN_NANOS = TIMER_TICKS_IN_MS * MILLION;
+
+// The number of slots from `index` to the first slot after it (or `index` itself) that
+// isn't empty.  `bits` must not be zero.
+static int slots_to_next_occupied(uint64_t bits, int index) {
+    rassert(bits != 0);
+    const uint64_t rotated = index == 0 ? bits : (bits >> index) | (bits << (64 - index));
+    return __builtin_ctzll(rotated);
 }
 
 timer_handler_t::timer_handler_t(linux_event_queue_t *queue)
     : timer_provider(queue),
-      expected_oneshot_time_in_nanos(0) {
+      expected_oneshot_time_in_nanos(0),
+      scheduled_oneshot_time_in_nanos(-1),
+      in_oneshot(false),
+      current_tick(get_ticks() / TIMER_TICK_IN_NANOS),
+      num_tokens(0) {
     // Right now, we have no tokens.  So we don't ask the timer provider to do anything for us.
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        occupied_slots[level] = 0;
+    }
 }
 
 timer_handler_t::~timer_handler_t() {
-    guarantee(token_queue.empty());
+    guarantee(num_tokens == 0);
+}
+
+void timer_handler_t::insert_token(timer_token_t *token) {
+    int64_t tick = std::max(current_tick, token->next_time_in_nanos / TIMER_TICK_IN_NANOS);
+    const int64_t wheel_ticks = int64_t(1) << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS);
+    if (tick - current_tick >= wheel_ticks) {
+        // Too far off for the wheel.  The token goes in the last slot it can reach, and
+        // it gets another one when that slot gets cascaded.
+        tick = current_tick + wheel_ticks - 1;
+    }
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1
+           && tick - current_tick >= int64_t(1) << (TIMER_WHEEL_SLOT_BITS * (level + 1))) {
+        ++level;
+    }
+    const int slot = (tick >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK;
+    token->level = level;
+    token->slot = slot;
+    slots[level][slot].push_back(token);
+    occupied_slots[level] |= uint64_t(1) << slot;
+}
+
+void timer_handler_t::remove_token(timer_token_t *token) {
+    if (token->level == timer_token_t::IN_DUE_TOKENS) {
+        due_tokens.remove(token);
+    } else {
+        rassert(token->level >= 0);
+        intrusive_list_t<timer_token_t> *list = &slots[token->level][token->slot];
+        list->remove(token);
+        if (list->empty()) {
+            occupied_slots[token->level] &= ~(uint64_t(1) << token->slot);
+        }
+    }
+    token->level = timer_token_t::NOT_IN_A_LIST;
+    token->slot = -1;
+}
+
+void timer_handler_t::cascade(int level) {
+    const int slot = (current_tick >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK;
+    intrusive_list_t<timer_token_t> tokens;
+    tokens.append_and_clear(&slots[level][slot]);
+    occupied_slots[level] &= ~(uint64_t(1) << slot);
+    while (!tokens.empty()) {
+        timer_token_t *token = tokens.head();
+        tokens.remove(token);
+        insert_token(token);
+    }
+}
+
+void timer_handler_t::advance_to(int64_t tick) {
+    while (current_tick < tick) {
+        const int slot = current_tick & TIMER_WHEEL_SLOT_MASK;
+        while (!slots[0][slot].empty()) {
+            timer_token_t *token = slots[0][slot].head();
+            remove_token(token);
+            token->level = timer_token_t::IN_DUE_TOKENS;
+            due_tokens.push_back(token);
+        }
+
+        // Skip the empty level 0 slots, but not past the end of level 0, where the higher
+        // levels get cascaded.
+        int64_t next_tick = std::min(tick, (current_tick | TIMER_WHEEL_SLOT_MASK) + 1);
+        const uint64_t later_slots =
+            occupied_slots[0] & ~((uint64_t(2) << slot) - 1);
+        if (later_slots != 0) {
+            next_tick = std::min(next_tick,
+                                 (current_tick & ~TIMER_WHEEL_SLOT_MASK)
+                                 + __builtin_ctzll(later_slots));
+        }
+        current_tick = next_tick;
+
+        for (int level = 1; level < TIMER_WHEEL_LEVELS; ++level) {
+            const int64_t level_mask = (int64_t(1) << (TIMER_WHEEL_SLOT_BITS * level)) - 1;
+            if ((current_tick & level_mask) != 0) {
+                break;
+            }
+            cascade(level);
+        }
+    }
+}
+
+int64_t timer_handler_t::next_oneshot_time_in_nanos() const {
+    int64_t next_time = std::numeric_limits<int64_t>::max();
+    if (occupied_slots[0] != 0) {
+        const int slot = (current_tick + slots_to_next_occupied(
+            occupied_slots[0], current_tick & TIMER_WHEEL_SLOT_MASK))
+            & TIMER_WHEEL_SLOT_MASK;
+        const intrusive_list_t<timer_token_t> &list = slots[0][slot];
+        for (timer_token_t *t = list.head(); t != NULL; t = list.next(t)) {
+            next_time = std::min(next_time, t->next_time_in_nanos);
+        }
+    }
+    for (int level = 1; level < TIMER_WHEEL_LEVELS; ++level) {
+        if (occupied_slots[level] == 0) {
+            continue;
+        }
+        // The slot of the current digit was cascaded on the way in, so anything in it
+        // is a full turn of the level away.
+        const int shift = TIMER_WHEEL_SLOT_BITS * level;
+        const int64_t digit = current_tick >> shift;
+        const int64_t cascade_tick = (digit + 1 + slots_to_next_occupied(
+            occupied_slots[level], (digit + 1) & TIMER_WHEEL_SLOT_MASK)) << shift;
+        next_time = std::min(next_time, cascade_tick * TIMER_TICK_IN_NANOS);
+    }
+    guarantee(next_time != std::numeric_limits<int64_t>::max());
+    return next_time;
+}
+
+void timer_handler_t::reschedule_oneshot() {
+    if (num_tokens == 0) {
+        if (scheduled_oneshot_time_in_nanos != -1) {
+            timer_provider.unschedule_oneshot();
+            scheduled_oneshot_time_in_nanos = -1;
+        }
+        return;
+    }
+    const int64_t next_time_in_nanos = next_oneshot_time_in_nanos();
+    if (next_time_in_nanos != scheduled_oneshot_time_in_nanos) {
+        timer_provider.schedule_oneshot(next_time_in_nanos, this);
+        scheduled_oneshot_time_in_nanos = next_time_in_nanos;
+        expected_oneshot_time_in_nanos = next_time_in_nanos;
+    }
 }
 
 void timer_handler_t::on_oneshot() {
+    scheduled_oneshot_time_in_nanos = -1;
+    in_oneshot = true;
+
     // If the timer_provider tends to return its callback a touch early, we don't want to make a
     // bunch of calls to it, returning a tad early over and over again, leading up to a ticks
-    // threshold.  So we bump the real time up to the threshold when processing the priority queue.
+    // threshold.  So we bump the real time up to the threshold when processing the wheel.
     int64_t real_ticks = get_ticks();
     int64_t ticks = std::max(real_ticks, expected_oneshot_time_in_nanos);
 
-    while (!token_queue.empty() && token_queue.peek()->next_time_in_nanos <= ticks) {
-        timer_token_t *token = token_queue.pop();
+    advance_to(ticks / TIMER_TICK_IN_NANOS);
+    // The current slot has the tokens of this tick, which aren't all due yet.
+    intrusive_list_t<timer_token_t> *current = &slots[0][current_tick & TIMER_WHEEL_SLOT_MASK];
+    for (timer_token_t *token = current->head(); token != NULL;) {
+        timer_token_t *next = current->next(token);
+        if (token->next_time_in_nanos <= ticks) {
+            remove_token(token);
+            token->level = timer_token_t::IN_DUE_TOKENS;
+            due_tokens.push_back(token);
+        }
+        token = next;
+    }
+
+    // The callbacks may cancel tokens that are still in `due_tokens`.
+    while (!due_tokens.empty()) {
+        timer_token_t *token = due_tokens.head();
+        remove_token(token);
 
-        // Put the repeating timer back on the queue before the callback can be called (so that it
-        // may be canceled).
+        // Put the repeating timer back in the wheel before the callback can be called (so that
+        // it may be canceled).
         if (token->interval_nanos != 0) {
             token->next_time_in_nanos = real_ticks + token->interval_nanos;
-            token_queue.push(token);
+            insert_token(token);
         }
 
         token->callback->on_timer();
 
         // Delete nonrepeating timer tokens.
         if (token->interval_nanos == 0) {
+            --num_tokens;
             delete token;
         }
     }
 
-    // We've processed young tokens.  Now schedule a new one-shot (if necessary).
-    if (!token_queue.empty()) {
-        timer_provider.schedule_oneshot(token_queue.peek()->next_time_in_nanos, this);
-    }
+    in_oneshot = false;
+    reschedule_oneshot();
 }
 
 timer_token_t *timer_handler_t::add_timer_internal(const int64_t ms, timer_callback_t *callback, const bool once) {
     const int64_t nanos = ms * MILLION;
     rassert(nanos > 0);
 
-    const int64_t next_time_in_nanos = get_ticks() + nanos;
+    const int64_t now = get_ticks();
+    const int64_t next_time_in_nanos = now + nanos;
+
+    if (num_tokens == 0) {
+        // Nothing's in the wheel, so it can jump ahead instead of walking through the ticks
+        // that passed while it was idle.
+        current_tick = std::max(current_tick, now / TIMER_TICK_IN_NANOS);
+    }
 
     timer_token_t *const token = new timer_token_t;
     token->interval_nanos = once ? 0 : nanos;
     token->next_time_in_nanos = next_time_in_nanos;
     token->callback = callback;
+    insert_token(token);
+    ++num_tokens;
 
-    const timer_token_t *top_entry = token_queue.peek();
-    token_queue.push(token);
-
-    if (top_entry == NULL || next_time_in_nanos < top_entry->next_time_in_nanos) {
+    // Only set the oneshot if it has to go off earlier than it's already set to.
+    if (!in_oneshot
+        && (scheduled_oneshot_time_in_nanos == -1
+            || next_time_in_nanos < scheduled_oneshot_time_in_nanos)) {
         timer_provider.schedule_oneshot(next_time_in_nanos, this);
+        scheduled_oneshot_time_in_nanos = next_time_in_nanos;
+        expected_oneshot_time_in_nanos = next_time_in_nanos;
     }
 
     return token;
 }
 
 void timer_handler_t::cancel_timer(timer_token_t *token) {
-    token_queue.remove(token);
+    remove_token(token);
+    --num_tokens;
     delete token;
 
-    if (token_queue.empty()) {
-        timer_provider.unschedule_oneshot();
+    // A oneshot set for the canceled timer is left alone; `on_oneshot` just finds nothing to
+    // do and sets the next one.
+    if (num_tokens == 0 && !in_oneshot) {
+        reschedule_oneshot();
     }
 }
 
@@ -2,7 +2,9 @@
 #ifndef ARCH_TIMER_HPP_
 #define ARCH_TIMER_HPP_
 
-#include "containers/intrusive_priority_queue.hpp"
+#include <stdint.h>
+
+#include "containers/intrusive_list.hpp"
 #include "arch/io/timer_provider.hpp"
 
 class timer_token_t;
@@ -14,7 +16,13 @@ struct timer_callback_t {
 
 /* This timer class uses the underlying OS timer provider to get one-shot timing events. It then
  * manages a list of application timers based on that lower level interface. Everyone who needs a
- * timer should use this class (through the thread pool). */
+ * timer should use this class (through the thread pool).
+ *
+ * The timers are kept in a hierarchical timing wheel, so adding and canceling a timer takes
+ * constant time.  Each level has `TIMER_WHEEL_SLOTS` slots; a slot of level 0 holds the timers
+ * that are due in one tick of `TIMER_TICKS_IN_MS`, and a slot of level `n` covers as many ticks
+ * as all of level `n - 1`.  Timers move down a level when the wheel gets to their slot.  The
+ * ticks only decide where a timer is kept: every timer still fires at its own time. */
 class timer_handler_t : private timer_provider_callback_t {
 public:
     explicit timer_handler_t(linux_event_queue_t *queue);
@@ -24,8 +32,31 @@ public:
     void cancel_timer(timer_token_t *timer);
 
 private:
+    static const int TIMER_WHEEL_LEVELS = 4;
+    static const int TIMER_WHEEL_SLOT_BITS = 6;
+    static const int TIMER_WHEEL_SLOTS = 1 << TIMER_WHEEL_SLOT_BITS;
+    static const int64_t TIMER_WHEEL_SLOT_MASK = TIMER_WHEEL_SLOTS - 1;
+
     void on_oneshot();
 
+    // Puts the token in the slot for its `next_time_in_nanos`.
+    void insert_token(timer_token_t *token);
+    void remove_token(timer_token_t *token);
+
+    // Advances `current_tick` to `tick`, cascading the higher levels on the way and moving
+    // the tokens of the level 0 slots it passes to `due_tokens`.
+    void advance_to(int64_t tick);
+    void cascade(int level);
+
+    // The time at which the oneshot has to go off next: the time of the soonest timer, or
+    // the time at which a higher level slot that isn't empty has to be cascaded, whichever
+    // comes first.
+    int64_t next_oneshot_time_in_nanos() const;
+
+    // Asks the timer provider for a oneshot at the time the wheel needs, unless that's
+    // the one it already has.
+    void reschedule_oneshot();
+
     // The timer provider, a platform-dependent typedef for interfacing with the OS.
     timer_provider_t timer_provider;
 
@@ -33,8 +64,25 @@ private:
     // time, we pretend that it had arrived on time.
     int64_t expected_oneshot_time_in_nanos;
 
-    // A priority queue of timer tokens, ordered by the soonest.
-    intrusive_priority_queue_t<timer_token_t> token_queue;
+    // The time the timer provider's oneshot is set for, or -1 if it's not set.
+    int64_t scheduled_oneshot_time_in_nanos;
+
+    // True during `on_oneshot`, which reschedules the oneshot once at the end instead of
+    // letting the callbacks' `add_timer_internal` calls do it.
+    bool in_oneshot;
+
+    // The tick that the wheel is at.  The level 0 slots of earlier ticks are empty.
+    int64_t current_tick;
+
+    size_t num_tokens;
+
+    intrusive_list_t<timer_token_t> slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+
+    // A bit for each slot of each level, set if the slot isn't empty.
+    uint64_t occupied_slots[TIMER_WHEEL_LEVELS];
+
+    // The tokens `on_oneshot` is about to call.
+    intrusive_list_t<timer_token_t> due_tokens;
 
     DISABLE_COPYING(timer_handler_t);
 };
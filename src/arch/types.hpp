@@ -74,6 +74,7 @@ class linux_thread_pool_t;
 typedef linux_thread_pool_t thread_pool_t;
 
 class file_account_t;
+struct file_latency_stats_t;
 
 class linux_iocallback_t;
 typedef linux_iocallback_t iocallback_t;
@@ -96,11 +97,28 @@ typedef linux_tcp_conn_descriptor_t tcp_conn_descriptor_t;
 class linux_tcp_conn_t;
 typedef linux_tcp_conn_t tcp_conn_t;
 
+/* With `accept_sharding_t::per_thread`, a listener also opens its sockets on every
+other thread, bound to the same port with `SO_REUSEPORT`. The kernel then spreads
+incoming connections over all of them, so connection storms are accepted by all
+threads instead of queueing up behind a single accept loop. The callback is still
+called on the listener's thread. Since `SO_REUSEPORT` would also let another process
+of the same user bind our port, this is off by default. */
+enum class accept_sharding_t { none, per_thread };
+
 enum class file_direct_io_mode_t {
     direct_desired,
     buffered_desired
 };
 
+// Which mechanism the disk manager uses to get reads and writes to the kernel.
+// `io_uring` falls back to `aio` if io_uring is unavailable, and `aio` falls back to
+// `pool` if kernel AIO is unavailable.
+enum class io_backend_mode_t {
+    pool,
+    io_uring,
+    aio
+};
+
 class semantic_checking_file_t {
 public:
     semantic_checking_file_t() { }
@@ -136,9 +154,27 @@ public:
     virtual void writev_async(int64_t offset, size_t length, scoped_array_t<iovec> &&bufs,
                               file_account_t *account, linux_iocallback_t *cb) = 0;
 
+    // Calls `cb` once everything written to the file before the call is durable.
+    // Files on the same file system that sync at the same time may share a single
+    // barrier.
+    virtual void datasync_async(linux_iocallback_t *cb) = 0;
+
+    // Tells the file system or device that the given range doesn't hold any data we
+    // care about anymore, so that it can reclaim the space.  Doesn't block, and
+    // silently does nothing where that isn't supported.
+    virtual void discard(int64_t offset, int64_t length) = 0;
+
     virtual void *create_account(int priority, int outstanding_requests_limit) = 0;
     virtual void destroy_account(void *account) = 0;
 
+    // Weighs the I/O of all of the file's accounts, current and future, against the
+    // I/O of other files' accounts.  The default weight is 1.  Blocks the coroutine.
+    virtual void set_io_weight(double weight) = 0;
+
+    // Has the file record the latencies of its reads, writes and datasyncs in
+    // `stats`, which must outlive the file's I/O.  NULL makes it stop.
+    virtual void set_latency_stats(file_latency_stats_t *stats) = 0;
+
     virtual bool coop_lock_and_check() = 0;
 
 private:
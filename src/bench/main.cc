@@ -0,0 +1,436 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+
+/* A benchmark for the storage engine. It creates a `store_t` on a real serializer
+file and drives it directly, without any of the clustering or query layers, with a
+configurable mix of point reads, point writes and range scans. It reports the
+throughput and a latency histogram for each kind of operation.
+
+Run it with `make bench`, passing options in `BENCH_FLAGS`, or run the
+`rethinkdb-bench` binary directly; `--help` lists the options. */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "arch/io/disk.hpp"
+#include "arch/runtime/starter.hpp"
+#include "buffer_cache/cache_balancer.hpp"
+#include "concurrency/pmap.hpp"
+#include "containers/uuid.hpp"
+#include "perfmon/histogram.hpp"
+#include "rdb_protocol/context.hpp"
+#include "rdb_protocol/protocol.hpp"
+#include "rdb_protocol/store.hpp"
+#include "serializer/config.hpp"
+#include "utils.hpp"
+
+namespace {
+
+enum class key_distribution_t { UNIFORM, ZIPF };
+
+struct bench_config_t {
+    bench_config_t()
+        : clients(16), duration_secs(10), keys(100000), value_size(256),
+          read_percent(80), write_percent(15), scan_percent(5), scan_length(100),
+          distribution(key_distribution_t::UNIFORM), zipf_theta(0.99),
+          cache_size_mb(256), direct_io(false), hard_durability(false),
+          pool_threads(1) { }
+    int clients;
+    int duration_secs;
+    int keys;
+    int value_size;
+    int read_percent;
+    int write_percent;
+    int scan_percent;
+    int scan_length;
+    key_distribution_t distribution;
+    double zipf_theta;
+    int cache_size_mb;
+    bool direct_io;
+    bool hard_durability;
+    int pool_threads;
+    // Empty for a temporary directory that gets removed afterwards.
+    std::string directory;
+};
+
+/* Picks keys in [0, n) so that the i-th most popular key has a probability
+proportional to 1 / i^theta, using the method from Gray et al., "Quickly
+generating billion-record synthetic databases". The popular keys are then scattered
+over the key space, so that they don't all end up in the same leaf nodes. */
+class zipf_generator_t {
+public:
+    zipf_generator_t(int n, double theta) : n_(n), theta_(theta) {
+        guarantee(n > 1 && theta > 0 && theta < 1);
+        zeta_n_ = zeta(n, theta);
+        alpha_ = 1 / (1 - theta);
+        eta_ = (1 - pow(2.0 / n, 1 - theta)) / (1 - zeta(2, theta) / zeta_n_);
+    }
+
+    int next(rng_t *rng) const {
+        const double u = rng->randdouble();
+        const double uz = u * zeta_n_;
+        int rank;
+        if (uz < 1) {
+            rank = 0;
+        } else if (uz < 1 + pow(0.5, theta_)) {
+            rank = 1;
+        } else {
+            rank = std::min(n_ - 1,
+                            static_cast<int>(n_ * pow(eta_ * u - eta_ + 1, alpha_)));
+        }
+        // Fibonacci hashing of the rank.
+        return static_cast<int>(
+            (static_cast<uint64_t>(rank) * UINT64_C(11400714819323198485)) % n_);
+    }
+
+private:
+    static double zeta(int n, double theta) {
+        double sum = 0;
+        for (int i = 1; i <= n; ++i) {
+            sum += 1 / pow(i, theta);
+        }
+        return sum;
+    }
+
+    int n_;
+    double theta_;
+    double zeta_n_;
+    double alpha_;
+    double eta_;
+};
+
+store_key_t key_for_index(int i) {
+    return store_key_t(ql::datum_t(static_cast<double>(i)).print_primary());
+}
+
+class bench_store_t {
+public:
+    bench_store_t(store_t *store, const bench_config_t &config)
+        : store_(store), config_(config),
+          timestamp_(state_timestamp_t::zero()),
+          value_(std::string(config.value_size, 'x').c_str()) { }
+
+    void write(int i) {
+        ql::datum_object_builder_t builder;
+        builder.overwrite("id", ql::datum_t(static_cast<double>(i)));
+        builder.overwrite("value", ql::datum_t(value_));
+        write_t w(point_write_t(key_for_index(i), std::move(builder).to_datum(), true),
+                  config_.hard_durability
+                      ? DURABILITY_REQUIREMENT_HARD
+                      : DURABILITY_REQUIREMENT_SOFT,
+                  profile_bool_t::DONT_PROFILE,
+                  ql::configured_limits_t());
+
+#ifndef NDEBUG
+        trivial_metainfo_checker_callback_t checker_cb;
+        metainfo_checker_t checker(&checker_cb, store_->get_region());
+#endif
+        // The write token and the timestamp have to be handed out in the same order.
+        write_token_t token;
+        store_->new_write_token(&token);
+        timestamp_ = timestamp_.next();
+        const state_timestamp_t timestamp = timestamp_;
+
+        write_response_t response;
+        cond_t non_interruptor;
+        store_->write(DEBUG_ONLY(checker, )
+                      region_map_t<binary_blob_t>(store_->get_region(),
+                                                  binary_blob_t(timestamp)),
+                      w, &response,
+                      config_.hard_durability
+                          ? write_durability_t::HARD
+                          : write_durability_t::SOFT,
+                      timestamp, order_token_t::ignore, &token, &non_interruptor);
+    }
+
+    void point_read(int i) {
+        read(read_t(point_read_t(key_for_index(i)), profile_bool_t::DONT_PROFILE));
+    }
+
+    void range_scan(int i) {
+        // The primary keys of numbers sort like the numbers, so this reads the
+        // `scan_length` keys starting at `i`.
+        const key_range_t range(key_range_t::closed, key_for_index(i),
+                                key_range_t::open,
+                                key_for_index(i + config_.scan_length));
+        read(read_t(rget_read_t(region_t(range),
+                                std::map<std::string, ql::wire_func_t>(),
+                                "",
+                                ql::batchspec_t::all(),
+                                std::vector<ql::transform_variant_t>(),
+                                boost::optional<ql::terminal_variant_t>(),
+                                boost::optional<sindex_rangespec_t>(),
+                                sorting_t::ASCENDING),
+                    profile_bool_t::DONT_PROFILE));
+    }
+
+private:
+    void read(const read_t &r) {
+#ifndef NDEBUG
+        trivial_metainfo_checker_callback_t checker_cb;
+        metainfo_checker_t checker(&checker_cb, store_->get_region());
+#endif
+        read_token_t token;
+        store_->new_read_token(&token);
+        read_response_t response;
+        cond_t non_interruptor;
+        store_->read(DEBUG_ONLY(checker, )
+                     r, &response, order_token_t::ignore, &token, &non_interruptor);
+    }
+
+    store_t *const store_;
+    const bench_config_t &config_;
+    state_timestamp_t timestamp_;
+    const datum_string_t value_;
+
+    DISABLE_COPYING(bench_store_t);
+};
+
+enum op_type_t { POINT_READ = 0, POINT_WRITE, RANGE_SCAN, NUM_OP_TYPES };
+const char *const op_names[NUM_OP_TYPES] = { "read", "write", "scan" };
+
+struct client_stats_t {
+    latency_histogram_t latencies[NUM_OP_TYPES];
+};
+
+void run_client(bench_store_t *bench, const bench_config_t &config,
+                const zipf_generator_t *zipf, ticks_t deadline, int seed,
+                client_stats_t *stats_out) {
+    rng_t rng(seed);
+    // Scans start early enough that they stay within the loaded keys.
+    const int scan_keys = std::max(1, config.keys - config.scan_length);
+    while (get_ticks() < deadline) {
+        const int dice = rng.randint(100);
+        const op_type_t op = dice < config.read_percent
+            ? POINT_READ
+            : dice < config.read_percent + config.write_percent
+                ? POINT_WRITE
+                : RANGE_SCAN;
+        int key = zipf != NULL ? zipf->next(&rng) : rng.randint(config.keys);
+
+        const ticks_t start = get_ticks();
+        switch (op) {
+        case POINT_READ: bench->point_read(key); break;
+        case POINT_WRITE: bench->write(key); break;
+        case RANGE_SCAN: bench->range_scan(key % scan_keys); break;
+        case NUM_OP_TYPES: // fallthru
+        default: unreachable();
+        }
+        stats_out->latencies[op].record(get_ticks() - start);
+    }
+}
+
+void run_benchmark(const bench_config_t &config, const base_path_t &base_path) {
+    recreate_temporary_directory(base_path);
+    const serializer_filepath_t path(base_path, "bench_store");
+
+    io_backender_t io_backender(config.direct_io
+                                ? file_direct_io_mode_t::direct_desired
+                                : file_direct_io_mode_t::buffered_desired);
+    dummy_cache_balancer_t balancer(static_cast<uint64_t>(config.cache_size_mb)
+                                    * MEGABYTE);
+    filepath_file_opener_t file_opener(path, &io_backender);
+    standard_serializer_t::create(&file_opener,
+                                  standard_serializer_t::static_config_t());
+    standard_serializer_t serializer(standard_serializer_t::dynamic_config_t(),
+                                     &file_opener,
+                                     &get_global_perfmon_collection());
+    rdb_context_t ctx;
+    store_t store(&serializer, &balancer, "bench_store", true,
+                  &get_global_perfmon_collection(), &ctx, &io_backender,
+                  base_path, NULL, generate_uuid());
+    bench_store_t bench(&store, config);
+
+    printf("Loading %d keys with %d byte values...\n", config.keys, config.value_size);
+    ticks_t start = get_ticks();
+    pmap(config.clients, [&](int client) {
+        for (int i = client; i < config.keys; i += config.clients) {
+            bench.write(i);
+        }
+    });
+    double secs = ticks_to_secs(get_ticks() - start);
+    printf("Loaded in %.2f s (%.0f writes/s)\n\n", secs, config.keys / secs);
+
+    scoped_ptr_t<zipf_generator_t> zipf;
+    if (config.distribution == key_distribution_t::ZIPF) {
+        zipf.init(new zipf_generator_t(config.keys, config.zipf_theta));
+    }
+
+    printf("Running %d clients (%d%% reads, %d%% writes, %d%% scans of %d keys, "
+           "%s keys) for %d s...\n",
+           config.clients, config.read_percent, config.write_percent,
+           config.scan_percent, config.scan_length,
+           zipf.has() ? "zipfian" : "uniform", config.duration_secs);
+    std::vector<client_stats_t> client_stats(config.clients);
+    start = get_ticks();
+    const ticks_t deadline = start + secs_to_ticks(config.duration_secs);
+    pmap(config.clients, [&](int client) {
+        run_client(&bench, config, zipf.get_or_null(), deadline, client + 1,
+                   &client_stats[client]);
+    });
+    secs = ticks_to_secs(get_ticks() - start);
+
+    printf("\n%-6s %10s %10s %10s %10s %10s %10s\n",
+           "op", "count", "ops/s", "p50 ms", "p99 ms", "p99.9 ms", "max ms");
+    uint64_t total = 0;
+    for (int op = 0; op < NUM_OP_TYPES; ++op) {
+        latency_histogram_t latencies;
+        for (const client_stats_t &s : client_stats) {
+            latencies.merge(s.latencies[op]);
+        }
+        if (latencies.count() == 0) {
+            continue;
+        }
+        total += latencies.count();
+        printf("%-6s %10" PRIu64 " %10.0f %10.3f %10.3f %10.3f %10.3f\n",
+               op_names[op], latencies.count(), latencies.count() / secs,
+               latencies.percentile(0.5) * 1000, latencies.percentile(0.99) * 1000,
+               latencies.percentile(0.999) * 1000, latencies.max() * 1000);
+    }
+    printf("%-6s %10" PRIu64 " %10.0f\n", "total", total, total / secs);
+}
+
+void print_usage(const char *name) {
+    printf("Usage: %s [options]\n"
+           "  --clients N          concurrent clients (default 16)\n"
+           "  --duration SECS      how long to run the mix for (default 10)\n"
+           "  --keys N             keys to load before running the mix (default 100000)\n"
+           "  --value-size BYTES   size of each value (default 256)\n"
+           "  --mix R:W:S          percentages of point reads, point writes and range\n"
+           "                       scans (default 80:15:5)\n"
+           "  --scan-length N      keys per range scan (default 100)\n"
+           "  --distribution D     `uniform` or `zipf` (default uniform)\n"
+           "  --zipf-theta T       skew of the zipf distribution, in (0, 1) "
+           "(default 0.99)\n"
+           "  --cache-size MB      cache size (default 256)\n"
+           "  --direct-io          use O_DIRECT for the serializer file\n"
+           "  --hard-durability    wait for writes to reach the disk\n"
+           "  --threads N          threads in the thread pool (default 1)\n"
+           "  --directory DIR      where to put the serializer file (it gets\n"
+           "                       overwritten); by default a temporary directory is\n"
+           "                       used and removed\n",
+           name);
+}
+
+bool parse_int(const char *str, int min, int *out) {
+    char *end;
+    long res = strtol(str, &end, 10);  // NOLINT(runtime/int)
+    if (*str == '\0' || *end != '\0' || res < min || res > INT_MAX) {
+        return false;
+    }
+    *out = static_cast<int>(res);
+    return true;
+}
+
+bool parse_options(int argc, char **argv, bench_config_t *config) {
+    const struct option long_options[] = {
+        { "clients", required_argument, NULL, 'c' },
+        { "duration", required_argument, NULL, 'd' },
+        { "keys", required_argument, NULL, 'k' },
+        { "value-size", required_argument, NULL, 'v' },
+        { "mix", required_argument, NULL, 'm' },
+        { "scan-length", required_argument, NULL, 'l' },
+        { "distribution", required_argument, NULL, 'D' },
+        { "zipf-theta", required_argument, NULL, 'z' },
+        { "cache-size", required_argument, NULL, 's' },
+        { "direct-io", no_argument, NULL, 'o' },
+        { "hard-durability", no_argument, NULL, 'H' },
+        { "threads", required_argument, NULL, 't' },
+        { "directory", required_argument, NULL, 'f' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 } };
+    for (;;) {
+        int option_index = 0;
+        const int c = getopt_long(argc, argv, "", long_options, &option_index);
+        if (c == -1) {
+            break;
+        }
+        bool ok = true;
+        switch (c) {
+        case 'c': ok = parse_int(optarg, 1, &config->clients); break;
+        case 'd': ok = parse_int(optarg, 1, &config->duration_secs); break;
+        case 'k': ok = parse_int(optarg, 2, &config->keys); break;
+        case 'v': ok = parse_int(optarg, 0, &config->value_size); break;
+        case 'l': ok = parse_int(optarg, 1, &config->scan_length); break;
+        case 's': ok = parse_int(optarg, 1, &config->cache_size_mb); break;
+        case 't': ok = parse_int(optarg, 1, &config->pool_threads); break;
+        case 'm': {
+            int r, w, s;
+            ok = sscanf(optarg, "%d:%d:%d", &r, &w, &s) == 3
+                && r >= 0 && w >= 0 && s >= 0 && r + w + s == 100;
+            if (ok) {
+                config->read_percent = r;
+                config->write_percent = w;
+                config->scan_percent = s;
+            }
+        } break;
+        case 'D':
+            if (strcmp(optarg, "uniform") == 0) {
+                config->distribution = key_distribution_t::UNIFORM;
+            } else if (strcmp(optarg, "zipf") == 0) {
+                config->distribution = key_distribution_t::ZIPF;
+            } else {
+                ok = false;
+            }
+            break;
+        case 'z': {
+            char *end;
+            config->zipf_theta = strtod(optarg, &end);
+            ok = *end == '\0' && config->zipf_theta > 0 && config->zipf_theta < 1;
+        } break;
+        case 'o': config->direct_io = true; break;
+        case 'H': config->hard_durability = true; break;
+        case 'f': config->directory = optarg; break;
+        case 'h': // fallthru
+        default:
+            print_usage(argv[0]);
+            return false;
+        }
+        if (!ok) {
+            fprintf(stderr, "Invalid value for --%s: %s\n",
+                    long_options[option_index].name, optarg);
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+    if (optind != argc) {
+        print_usage(argv[0]);
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    startup_shutdown_t startup_shutdown;
+
+    bench_config_t config;
+    if (!parse_options(argc, argv, &config)) {
+        return EXIT_FAILURE;
+    }
+
+    std::string directory = config.directory;
+    if (directory.empty()) {
+        char tmpl[] = "/tmp/rdb_bench.XXXXXX";
+        guarantee_err(mkdtemp(tmpl) != NULL, "Couldn't create a temporary directory");
+        directory = tmpl;
+    }
+    const base_path_t base_path(directory);
+
+    run_in_thread_pool(std::bind(&run_benchmark, std::cref(config), std::cref(base_path)),
+                       config.pool_threads);
+
+    if (config.directory.empty()) {
+        remove_directory_recursive(directory.c_str());
+    }
+    return EXIT_SUCCESS;
+}
@@ -55,4 +55,11 @@ void do_agnostic_btree_backfill(value_sizer_t *sizer,
                                 signal_t *interruptor)
     THROWS_ONLY(interrupted_exc_t);
 
+/* Only calls `callback->on_sindexes()`, like `do_agnostic_btree_backfill()` does
+before it traverses the tree. */
+void do_agnostic_btree_backfill_sindexes(buf_lock_t *sindex_block,
+                                         agnostic_backfill_callback_t *callback,
+                                         signal_t *interruptor)
+    THROWS_ONLY(interrupted_exc_t);
+
 #endif  // BTREE_BACKFILL_HPP_
@@ -0,0 +1,244 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "btree/bulk_load.hpp"
+
+#include <stddef.h>
+
+#include "btree/internal_node.hpp"
+#include "btree/leaf_node.hpp"
+#include "btree/node.hpp"
+#include "btree/operations.hpp"
+#include "btree/slice.hpp"
+
+btree_bulk_loader_t::btree_bulk_loader_t(value_sizer_t *_sizer, double fill_factor)
+    : sizer(_sizer),
+      max_used_size(fill_factor * _sizer->block_size().value()),
+      superblock(NULL), has_last_key(false), population_change(0) {
+    guarantee(fill_factor >= 0.5 && fill_factor <= 1.0);
+}
+
+btree_bulk_loader_t::~btree_bulk_loader_t() {
+    rassert(spine.empty(), "btree_bulk_loader_t destroyed without release()");
+}
+
+void btree_bulk_loader_t::append(superblock_t *_superblock, const btree_key_t *key,
+                                 const void *value, repli_timestamp_t tstamp,
+                                 btree_stats_t *stats) {
+    if (spine.empty()) {
+        superblock = _superblock;
+        acquire_right_edge();
+        if (!has_last_key) {
+            buf_read_t read(&spine.back());
+            guarantee(spine.size() == 1
+                      && leaf::is_empty(
+                          static_cast<const leaf_node_t *>(read.get_data_read())),
+                      "Bulk loading into a B-tree that isn't empty.");
+        }
+    }
+    rassert(superblock == _superblock);
+    rassert(!has_last_key || btree_key_cmp(last_key.btree_key(), key) < 0);
+
+    bool has_room;
+    {
+        buf_read_t read(&spine.back());
+        has_room = leaf_has_room(
+            static_cast<const leaf_node_t *>(read.get_data_read()), key, value);
+    }
+    if (!has_room) {
+        buf_lock_t leaf(parent_of_new_node(spine.size() - 1), alt_create_t::create);
+        {
+            buf_write_t write(&leaf);
+            leaf::init(sizer, static_cast<leaf_node_t *>(write.get_data_write()));
+        }
+        store_key_t separator;
+        btree_key_separator(last_key.btree_key(), key, separator.btree_key());
+        link(spine.size() - 1, separator.btree_key(), std::move(leaf));
+    }
+
+    {
+        buf_write_t write(&spine.back());
+        leaf::insert(sizer, static_cast<leaf_node_t *>(write.get_data_write()),
+                     key, value, tstamp, key_modification_proof_t::real_proof());
+    }
+    stats->pm_keys_set.record();
+    stats->pm_total_keys_set += 1;
+    ++population_change;
+
+    last_key.assign(key);
+    has_last_key = true;
+}
+
+bool btree_bulk_loader_t::start_after_existing_keys(superblock_t *_superblock,
+                                                    const btree_key_t *key) {
+    rassert(spine.empty() && !has_last_key);
+    superblock = _superblock;
+    acquire_right_edge();
+
+    bool ok;
+    {
+        buf_read_t read(&spine.back());
+        const btree_key_t *tree_last_key = leaf::last_key(
+            static_cast<const leaf_node_t *>(read.get_data_read()));
+        if (tree_last_key == NULL) {
+            // An empty leaf is only the whole tree if it's the root.
+            ok = spine.size() == 1;
+        } else {
+            ok = btree_key_cmp(tree_last_key, key) < 0;
+            if (ok) {
+                last_key.assign(tree_last_key);
+                has_last_key = true;
+            }
+        }
+    }
+    if (!ok) {
+        spine.clear();
+        superblock = NULL;
+    }
+    return ok;
+}
+
+void btree_bulk_loader_t::release() {
+    if (superblock != NULL && population_change != 0
+        && superblock->get_stat_block_id() != NULL_BLOCK_ID) {
+        // Like in `apply_keyvalue_change`, the stat block is detached from the rest
+        // of the tree.
+        buf_lock_t stat_block(buf_parent_t(superblock->expose_buf().txn()),
+                              superblock->get_stat_block_id(), access_t::write);
+        buf_write_t write(&stat_block);
+        auto stat_block_buf = static_cast<btree_statblock_t *>(
+            write.get_data_write(BTREE_STATBLOCK_SIZE));
+        stat_block_buf->population += population_change;
+    }
+    population_change = 0;
+    spine.clear();
+    superblock = NULL;
+}
+
+void btree_bulk_loader_t::acquire_right_edge() {
+    rassert(spine.empty());
+    buf_lock_t node = get_root(sizer, superblock);
+    for (;;) {
+        block_id_t child_id;
+        {
+            buf_read_t read(&node);
+            const node_t *n = static_cast<const node_t *>(read.get_data_read());
+            if (node::is_leaf(n)) {
+                break;
+            }
+            const internal_node_t *internal
+                = reinterpret_cast<const internal_node_t *>(n);
+            child_id = internal_node::get_pair_by_index(
+                internal, internal->npairs - 1)->lnode;
+        }
+        spine.push_back(std::move(node));
+        node = buf_lock_t(buf_parent_t(&spine.back()), child_id, access_t::write);
+    }
+    spine.push_back(std::move(node));
+}
+
+void btree_bulk_loader_t::link(size_t level, const btree_key_t *separator,
+                               buf_lock_t &&node) {
+    const block_size_t block_size = sizer->block_size();
+
+    if (level == 0) {
+        // `spine[0]` is the root, so we need a new root above it.
+        superblock->expose_buf().detach_child(spine[0].block_id());
+        buf_lock_t root(superblock->expose_buf(), alt_create_t::create);
+        {
+            buf_write_t write(&root);
+            auto root_node = static_cast<internal_node_t *>(write.get_data_write());
+            internal_node::init(block_size, root_node);
+            DEBUG_VAR bool success = internal_node::insert(
+                root_node, separator, spine[0].block_id(), node.block_id());
+            rassert(success);
+        }
+        insert_root(root.block_id(), superblock);
+        spine[0] = std::move(node);
+        spine.insert(spine.begin(), std::move(root));
+        return;
+    }
+
+    buf_lock_t *parent = &spine[level - 1];
+    bool has_room;
+    {
+        buf_read_t read(parent);
+        has_room = internal_node_has_room(
+            static_cast<const internal_node_t *>(read.get_data_read()), separator);
+    }
+    if (has_room) {
+        buf_write_t write(parent);
+        DEBUG_VAR bool success = internal_node::insert(
+            static_cast<internal_node_t *>(write.get_data_write()),
+            separator, spine[level].block_id(), node.block_id());
+        rassert(success);
+        spine[level] = std::move(node);
+        return;
+    }
+
+    // The parent is full.  An internal node needs two children, so the new parent
+    // takes the parent's rightmost child along with `node`.  The key that
+    // separated that child from its left neighbor now separates the two parents.
+    store_key_t parent_separator;
+    {
+        buf_write_t write(parent);
+        auto parent_node = static_cast<internal_node_t *>(write.get_data_write());
+        guarantee(parent_node->npairs > 2);
+        parent_separator.assign(
+            &internal_node::get_pair_by_index(parent_node,
+                                              parent_node->npairs - 2)->key);
+        // This removes the last pair, and the one before takes its place.
+        internal_node::remove(block_size, parent_node, separator);
+    }
+    parent->detach_child(spine[level].block_id());
+
+    buf_lock_t new_parent(parent_of_new_node(level - 1), alt_create_t::create);
+    {
+        buf_write_t write(&new_parent);
+        auto new_parent_node = static_cast<internal_node_t *>(write.get_data_write());
+        internal_node::init(block_size, new_parent_node);
+        DEBUG_VAR bool success = internal_node::insert(
+            new_parent_node, separator, spine[level].block_id(), node.block_id());
+        rassert(success);
+    }
+    spine[level] = std::move(node);
+    link(level - 1, parent_separator.btree_key(), std::move(new_parent));
+}
+
+buf_parent_t btree_bulk_loader_t::parent_of_new_node(size_t level) {
+    // A new node goes next to `spine[level]`.  It starts out with the same parent,
+    // which is only a hint for snapshotting since the node is empty.
+    return level == 0
+        ? superblock->expose_buf()
+        : buf_parent_t(&spine[level - 1]);
+}
+
+bool btree_bulk_loader_t::leaf_has_room(const leaf_node_t *leaf,
+                                        const btree_key_t *key,
+                                        const void *value) const {
+    if (leaf::is_full(sizer, leaf, key, value)) {
+        return false;
+    }
+    if (leaf::is_empty(leaf)) {
+        return true;
+    }
+    // `live_size` counts the entries and their offsets, but not their timestamps.
+    const int used = offsetof(leaf_node_t, pair_offsets) + leaf->live_size
+        + leaf->num_pairs * sizeof(repli_timestamp_t);
+    const int cost = sizeof(uint16_t) + sizeof(repli_timestamp_t) + key->full_size()
+        + sizer->size(value);
+    return used + cost <= max_used_size;
+}
+
+bool btree_bulk_loader_t::internal_node_has_room(const internal_node_t *node,
+                                                 const btree_key_t *key) const {
+    if (internal_node::is_full(node)) {
+        return false;
+    }
+    // Taking a child away from a node with two children would leave it with one.
+    if (node->npairs <= 2) {
+        return true;
+    }
+    const int used = sizeof(internal_node_t) + node->npairs * sizeof(uint16_t)
+        + (sizer->block_size().value() - node->frontmost_offset);
+    const int cost = sizeof(uint16_t) + sizeof(block_id_t) + key->full_size();
+    return used + cost <= max_used_size;
+}
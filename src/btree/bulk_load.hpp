@@ -0,0 +1,87 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BTREE_BULK_LOAD_HPP_
+#define BTREE_BULK_LOAD_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "btree/keys.hpp"
+#include "buffer_cache/alt.hpp"
+#include "repli_timestamp.hpp"
+
+class btree_stats_t;
+class superblock_t;
+class value_sizer_t;
+struct internal_node_t;
+struct leaf_node_t;
+
+/* Builds a B-tree bottom-up out of keys that arrive in increasing order.  Going
+through `apply_keyvalue_change` for that descends from the root for every key and
+splits every full node in half, so the tree ends up half empty.  The bulk loader
+instead keeps the right edge of the tree locked and appends to its rightmost leaf.
+Once a node is filled up to `fill_factor`, the next key goes into a new node next
+to it, and the separator goes into the parent, which is filled the same way.
+
+The tree must be empty when the first key is appended, and nothing else may write
+to it while it's loaded.  The tree is valid after every call, so `release()` can be
+called at any time to let go of the superblock and its transaction; the next
+`append()` picks up from where the last one left off.
+
+Alternatively, `start_after_existing_keys()` lets a loader append to a tree that
+already has keys, as long as they're all smaller than the ones that get appended.
+Writes in between loaders are fine then, since each loader starts from the tree as
+it is. */
+class btree_bulk_loader_t {
+public:
+    // `fill_factor` is the part of each node's block that's filled before a new
+    // node is started, between 0.5 and 1.
+    btree_bulk_loader_t(value_sizer_t *sizer, double fill_factor);
+    ~btree_bulk_loader_t();
+
+    // `key` must be greater than any key appended before.  `superblock` must stay
+    // the same until the next `release()`.
+    void append(superblock_t *superblock, const btree_key_t *key, const void *value,
+                repli_timestamp_t tstamp, btree_stats_t *stats);
+
+    // Locks the right edge of the tree for appending after the keys in it, if `key`
+    // is greater than all of them.  Returns false, leaving the tree alone, if it
+    // isn't, or if the tree's rightmost leaf is empty so that we can't tell.  Must
+    // be called before the first `append()`, which has to append `key`.
+    bool start_after_existing_keys(superblock_t *superblock, const btree_key_t *key);
+
+    // Updates the tree's population in the stat block and releases the locks on
+    // the tree.  The superblock itself is left to the caller.
+    void release();
+
+private:
+    // Locks the nodes along the right edge of the tree.
+    void acquire_right_edge();
+
+    // Inserts `separator` and `node`, which goes right of `spine[level]`, into
+    // the parent of `spine[level]`, starting a new parent (or root) if needed.
+    // `node` then replaces `spine[level]`.
+    void link(size_t level, const btree_key_t *separator, buf_lock_t &&node);
+
+    buf_parent_t parent_of_new_node(size_t level);
+
+    bool leaf_has_room(const leaf_node_t *leaf, const btree_key_t *key,
+                       const void *value) const;
+    bool internal_node_has_room(const internal_node_t *node,
+                                const btree_key_t *key) const;
+
+    value_sizer_t *const sizer;
+    const int max_used_size;
+
+    superblock_t *superblock;
+    // The right edge of the tree, from the root down to the rightmost leaf.
+    std::vector<buf_lock_t> spine;
+
+    bool has_last_key;
+    store_key_t last_key;
+    int64_t population_change;
+
+    DISABLE_COPYING(btree_bulk_loader_t);
+};
+
+#endif  // BTREE_BULK_LOAD_HPP_
@@ -0,0 +1,127 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "btree/compaction.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "btree/internal_node.hpp"
+#include "btree/node.hpp"
+#include "btree/operations.hpp"
+#include "buffer_cache/alt.hpp"
+
+namespace {
+
+// Whether an earlier pass went through the node whose keys are greater than
+// `left_excl_or_null`, i.e. whether it got to a key in the node before `start`.
+bool visited_before(const store_key_t *left_excl_or_null, const store_key_t &start) {
+    if (left_excl_or_null == NULL) {
+        return start != store_key_t::min();
+    }
+    store_key_t first = *left_excl_or_null;
+    if (!first.increment()) {
+        // The node can't have any keys.
+        return true;
+    }
+    return first < start;
+}
+
+void dirty_node(buf_lock_t *buf) {
+    buf_write_t write(buf);
+    write.get_data_write();
+}
+
+// Returns `done_traversing_t::YES` if it used up `*leaves_left` before the end of
+// the B-tree.
+done_traversing_t compact_subtree(buf_lock_t *buf,
+                                  const store_key_t *left_excl_or_null,
+                                  const store_key_t *right_incl_or_null,
+                                  size_t *leaves_left,
+                                  store_key_t *start_inout,
+                                  bool *is_leaf_out) {
+    std::vector<block_id_t> child_ids;
+    std::vector<store_key_t> child_keys;
+    int first_child = 0;
+    {
+        buf_read_t read(buf);
+        const node_t *node = static_cast<const node_t *>(read.get_data_read());
+        *is_leaf_out = node::is_leaf(node);
+        if (!*is_leaf_out) {
+            const internal_node_t *inode
+                = reinterpret_cast<const internal_node_t *>(node);
+            if (inode->npairs > 0) {
+                first_child
+                    = internal_node::get_offset_index(inode, start_inout->btree_key());
+            }
+            for (int i = 0; i < inode->npairs; ++i) {
+                const btree_internal_pair *pair
+                    = internal_node::get_pair_by_index(inode, i);
+                child_ids.push_back(pair->lnode);
+                // The last pair's key is never looked at.
+                if (i != inode->npairs - 1) {
+                    child_keys.push_back(store_key_t(&pair->key));
+                }
+            }
+        }
+    }
+
+    if (*is_leaf_out) {
+        // Leaves get rewritten even if an earlier pass got to them, since the
+        // B-tree can have changed in between.
+        dirty_node(buf);
+        --*leaves_left;
+        if (right_incl_or_null == NULL) {
+            return done_traversing_t::NO;
+        }
+        *start_inout = *right_incl_or_null;
+        DEBUG_VAR bool incremented = start_inout->increment();
+        rassert(incremented);
+        return *leaves_left == 0 ? done_traversing_t::YES : done_traversing_t::NO;
+    }
+
+    if (!visited_before(left_excl_or_null, *start_inout)) {
+        dirty_node(buf);
+    }
+
+    const int num_children = child_ids.size();
+    for (int i = first_child; i < num_children; ++i) {
+        const store_key_t *child_left
+            = i > 0 ? &child_keys[i - 1] : left_excl_or_null;
+        const store_key_t *child_right
+            = i < num_children - 1 ? &child_keys[i] : right_incl_or_null;
+        bool child_is_leaf;
+        {
+            buf_lock_t child(buf_parent_t(buf), child_ids[i], access_t::write);
+            if (compact_subtree(&child, child_left, child_right, leaves_left,
+                                start_inout, &child_is_leaf)
+                == done_traversing_t::YES) {
+                return done_traversing_t::YES;
+            }
+        }
+        if (child_is_leaf && i == first_child && i + 1 < num_children) {
+            // Start loading the other leaves that this pass is going to rewrite.
+            const int end = std::min<int>(num_children, i + 1 + *leaves_left);
+            buf->prefetch_children(std::vector<block_id_t>(
+                child_ids.begin() + i + 1, child_ids.begin() + end));
+        }
+    }
+    return done_traversing_t::NO;
+}
+
+}  // namespace
+
+done_traversing_t btree_compact_nodes(superblock_t *superblock,
+                                      size_t max_leaves,
+                                      store_key_t *start_inout) {
+    guarantee(max_leaves > 0);
+    const block_id_t root_id = superblock->get_root_block_id();
+    if (root_id == NULL_BLOCK_ID) {
+        return done_traversing_t::YES;
+    }
+    buf_lock_t root(superblock->expose_buf(), root_id, access_t::write);
+    size_t leaves_left = max_leaves;
+    bool is_leaf;
+    return compact_subtree(&root, NULL, NULL, &leaves_left, start_inout, &is_leaf)
+        == done_traversing_t::YES
+        ? done_traversing_t::NO
+        : done_traversing_t::YES;
+}
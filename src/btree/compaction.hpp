@@ -0,0 +1,22 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef BTREE_COMPACTION_HPP_
+#define BTREE_COMPACTION_HPP_
+
+#include "btree/keys.hpp"
+#include "btree/types.hpp"
+
+class superblock_t;
+
+/* Rewrites the nodes of the B-tree under `superblock` in key order, starting with
+the leaf that `*start_inout` is in, until it has rewritten `max_leaves` leaves.  The
+superblock must be acquired for write.  An internal node is rewritten along with
+its first leaf.  The nodes only get dirtied; the cache writes them out with its
+next flush, in the order they were dirtied, and their old copies become garbage for
+the serializer's GC.  Values that are too big to be stored in the leaves are left
+where they are.  Sets `*start_inout` to where the next call should start, and
+returns `done_traversing_t::YES` once it has rewritten the last leaf. */
+done_traversing_t btree_compact_nodes(superblock_t *superblock,
+                                      size_t max_leaves,
+                                      store_key_t *start_inout);
+
+#endif  // BTREE_COMPACTION_HPP_
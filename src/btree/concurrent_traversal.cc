@@ -166,3 +166,27 @@ bool btree_concurrent_traversal(superblock_t *superblock,
     guarantee(!(failure_seen && !failure_cond.is_pulsed()));
     return !failure_cond.is_pulsed();
 }
+
+bool btree_parallel_concurrent_traversal(
+        superblock_t *superblock,
+        const key_range_t &range,
+        const std::vector<concurrent_traversal_callback_t *> &cbs,
+        release_superblock_t release_superblock) {
+    // The adapters share `failure_cond`, so that they all give up together.
+    cond_t failure_cond;
+    bool failure_seen;
+    {
+        std::vector<scoped_ptr_t<concurrent_traversal_adapter_t> > adapters;
+        std::vector<depth_first_traversal_callback_t *> adapter_ptrs;
+        for (auto it = cbs.begin(); it != cbs.end(); ++it) {
+            adapters.push_back(
+                make_scoped<concurrent_traversal_adapter_t>(*it, &failure_cond));
+            adapter_ptrs.push_back(adapters.back().get());
+        }
+        failure_seen = !btree_parallel_depth_first_traversal(
+            superblock, range, adapter_ptrs, release_superblock);
+    }
+    // See `btree_concurrent_traversal`.
+    guarantee(!(failure_seen && !failure_cond.is_pulsed()));
+    return !failure_cond.is_pulsed();
+}
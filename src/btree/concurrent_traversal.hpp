@@ -2,6 +2,8 @@
 #ifndef BTREE_CONCURRENT_TRAVERSAL_HPP_
 #define BTREE_CONCURRENT_TRAVERSAL_HPP_
 
+#include <vector>
+
 #include "btree/depth_first_traversal.hpp"
 #include "concurrency/interruptor.hpp"
 
@@ -59,4 +61,14 @@ bool btree_concurrent_traversal(superblock_t *superblock,
                                 direction_t direction,
                                 release_superblock_t release_superblock);
 
+/* Like `btree_concurrent_traversal`, but for callbacks that don't care about the
+order of the keys: the parts of `range` are traversed in parallel, one per callback,
+as in `btree_parallel_depth_first_traversal`.  Once one of them is done, all of them
+stop. */
+bool btree_parallel_concurrent_traversal(
+        superblock_t *superblock,
+        const key_range_t &range,
+        const std::vector<concurrent_traversal_callback_t *> &cbs,
+        release_superblock_t release_superblock);
+
 #endif  // BTREE_CONCURRENT_TRAVERSAL_HPP_
@@ -1,8 +1,12 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "btree/depth_first_traversal.hpp"
 
+#include <algorithm>
+#include <vector>
+
 #include "btree/internal_node.hpp"
 #include "btree/operations.hpp"
+#include "concurrency/pmap.hpp"
 #include "rdb_protocol/profile.hpp"
 
 class counted_buf_lock_t : public buf_lock_t,
@@ -63,7 +67,8 @@ bool btree_depth_first_traversal(counted_t<counted_buf_lock_t> block,
                                  depth_first_traversal_callback_t *cb,
                                  direction_t direction,
                                  const btree_key_t *left_excl_or_null,
-                                 const btree_key_t *right_incl_or_null);
+                                 const btree_key_t *right_incl_or_null,
+                                 bool *is_leaf_out);
 
 bool btree_depth_first_traversal(superblock_t *superblock,
                                  const key_range_t &range,
@@ -94,9 +99,82 @@ bool btree_depth_first_traversal(superblock_t *superblock,
             // profiling information is correct.
             root_block->read_acq_signal()->wait();
         }
+        bool is_leaf;
         return btree_depth_first_traversal(std::move(root_block), range, cb,
-                                           direction, NULL, NULL);
+                                           direction, NULL, NULL, &is_leaf);
+    }
+}
+
+bool btree_parallel_depth_first_traversal(
+        superblock_t *superblock,
+        const key_range_t &range,
+        const std::vector<depth_first_traversal_callback_t *> &cbs,
+        release_superblock_t release_superblock) {
+    guarantee(!cbs.empty());
+    block_id_t root_block_id = superblock->get_root_block_id();
+    if (root_block_id == NULL_BLOCK_ID) {
+        if (release_superblock == release_superblock_t::RELEASE) {
+            superblock->release();
+        }
+        return true;
+    }
+    counted_t<counted_buf_lock_t> root_block
+        = make_counted<counted_buf_lock_t>(superblock->expose_buf(), root_block_id,
+                                           access_t::read);
+    if (release_superblock == release_superblock_t::RELEASE) {
+        superblock->release();
     }
+
+    std::vector<key_range_t> parts;
+    {
+        buf_read_t read(root_block.get());
+        const node_t *node = static_cast<const node_t *>(read.get_data_read());
+        if (node::is_internal(node) && cbs.size() > 1) {
+            const internal_node_t *inode
+                = reinterpret_cast<const internal_node_t *>(node);
+            // The children that `range` touches, like in the traversal below.
+            int start_index
+                = internal_node::get_offset_index(inode, range.left.btree_key());
+            int end_index;
+            if (range.right.unbounded) {
+                end_index = inode->npairs;
+            } else {
+                store_key_t r = range.right.key;
+                r.decrement();
+                end_index = internal_node::get_offset_index(inode, r.btree_key()) + 1;
+            }
+            const int num_children = end_index - start_index;
+            const int num_parts = std::min<int>(cbs.size(), num_children);
+            // Each part but the last ends with the rightmost key of a child, which is
+            // less than the range's rightmost key.
+            store_key_t left = range.left;
+            for (int i = 1; i < num_parts; ++i) {
+                const int last_child = start_index + i * num_children / num_parts - 1;
+                store_key_t separator(
+                    &internal_node::get_pair_by_index(inode, last_child)->key);
+                parts.push_back(key_range_t(key_range_t::closed, left,
+                                            key_range_t::closed, separator));
+                left = separator;
+                DEBUG_VAR bool incremented = left.increment();
+                rassert(incremented);
+            }
+            key_range_t last_part = range;
+            last_part.left = left;
+            parts.push_back(last_part);
+        } else {
+            parts.push_back(range);
+        }
+    }
+
+    bool reached_end = true;
+    pmap(parts.size(), [&](int64_t i) {
+        bool is_leaf;
+        if (!btree_depth_first_traversal(root_block, parts[i], cbs[i], FORWARD,
+                                         NULL, NULL, &is_leaf)) {
+            reached_end = false;
+        }
+    });
+    return reached_end;
 }
 
 void get_child_key_range(const internal_node_t *inode,
@@ -122,14 +200,67 @@ void get_child_key_range(const internal_node_t *inode,
     }
 }
 
+/* Detects sequential leaf access among the children of one internal node, and
+prefetches the upcoming siblings so that their reads overlap with the traversal of
+the current leaf.  Read-ahead kicks in once `BTREE_READ_AHEAD_TRIGGER` leaves in a row
+have been traversed to the end, and its window doubles every time it gets
+refilled, up to `BTREE_READ_AHEAD_MAX_WINDOW` children.  Point lookups and short
+range reads stop before the trigger and never pay for read-ahead. */
+class leaf_read_ahead_t {
+public:
+    leaf_read_ahead_t()
+        : leaves_traversed_(0), window_(BTREE_READ_AHEAD_MIN_WINDOW),
+          prefetched_until_(0) { }
+
+    void on_leaf_traversed() { ++leaves_traversed_; }
+
+    // Called right before the child at position `i` (in traversal order) is
+    // acquired.  `child_id(j, &id)` returns false if the child at position `j` isn't
+    // going to be traversed.
+    template <class child_id_fun_t>
+    void maybe_prefetch(buf_lock_t *parent, int i, int num_children,
+                        const child_id_fun_t &child_id) {
+        if (leaves_traversed_ < BTREE_READ_AHEAD_TRIGGER) {
+            return;
+        }
+        // Refill once we've used up half of the window, so that there's always
+        // something in flight.
+        if (i + window_ / 2 < prefetched_until_) {
+            return;
+        }
+        std::vector<block_id_t> ids;
+        const int end = std::min(num_children, i + 1 + window_);
+        for (int j = std::max(i + 1, prefetched_until_); j < end; ++j) {
+            block_id_t id;
+            if (child_id(j, &id)) {
+                ids.push_back(id);
+            }
+        }
+        prefetched_until_ = end;
+        window_ = std::min(window_ * 2, BTREE_READ_AHEAD_MAX_WINDOW);
+        if (!ids.empty()) {
+            parent->prefetch_children(ids);
+        }
+    }
+
+private:
+    int leaves_traversed_;
+    int window_;
+    int prefetched_until_;
+
+    DISABLE_COPYING(leaf_read_ahead_t);
+};
+
 bool btree_depth_first_traversal(counted_t<counted_buf_lock_t> block,
                                  const key_range_t &range,
                                  depth_first_traversal_callback_t *cb,
                                  direction_t direction,
                                  const btree_key_t *left_excl_or_null,
-                                 const btree_key_t *right_incl_or_null) {
+                                 const btree_key_t *right_incl_or_null,
+                                 bool *is_leaf_out) {
     auto read = make_counted<counted_buf_read_t>(block.get());
     const node_t *node = static_cast<const node_t *>(read->get_data_read());
+    *is_leaf_out = !node::is_internal(node);
     if (node::is_internal(node)) {
         const internal_node_t *inode = reinterpret_cast<const internal_node_t *>(node);
         int start_index = internal_node::get_offset_index(inode, range.left.btree_key());
@@ -141,7 +272,23 @@ bool btree_depth_first_traversal(counted_t<counted_buf_lock_t> block,
             r.decrement();
             end_index = internal_node::get_offset_index(inode, r.btree_key()) + 1;
         }
-        for (int i = 0; i < end_index - start_index; ++i) {
+        const int num_children = end_index - start_index;
+        auto interesting_child_id = [&](int i, block_id_t *id_out) -> bool {
+            int true_index = (direction == FORWARD ? start_index + i : (end_index - 1) - i);
+            const btree_key_t *child_left_excl_or_null;
+            const btree_key_t *child_right_incl_or_null;
+            get_child_key_range(inode, true_index,
+                                left_excl_or_null, right_incl_or_null,
+                                &child_left_excl_or_null, &child_right_incl_or_null);
+            if (!cb->is_range_interesting(child_left_excl_or_null,
+                                          child_right_incl_or_null)) {
+                return false;
+            }
+            *id_out = internal_node::get_pair_by_index(inode, true_index)->lnode;
+            return true;
+        };
+        leaf_read_ahead_t read_ahead;
+        for (int i = 0; i < num_children; ++i) {
             int true_index = (direction == FORWARD ? start_index + i : (end_index - 1) - i);
             const btree_internal_pair *pair = internal_node::get_pair_by_index(inode, true_index);
 
@@ -153,18 +300,25 @@ bool btree_depth_first_traversal(counted_t<counted_buf_lock_t> block,
                                 &child_left_excl_or_null, &child_right_incl_or_null);
 
             if (cb->is_range_interesting(child_left_excl_or_null, child_right_incl_or_null)) {
+                read_ahead.maybe_prefetch(block.get(), i, num_children,
+                                          interesting_child_id);
                 counted_t<counted_buf_lock_t> lock;
                 {
                     profile::starter_t starter("Acquire block for read.", cb->get_trace());
                     lock = make_counted<counted_buf_lock_t>(block.get(), pair->lnode,
                                                             access_t::read);
                 }
+                bool child_is_leaf;
                 if (!btree_depth_first_traversal(std::move(lock),
                                                  range, cb, direction,
                                                  child_left_excl_or_null,
-                                                 child_right_incl_or_null)) {
+                                                 child_right_incl_or_null,
+                                                 &child_is_leaf)) {
                     return false;
                 }
+                if (child_is_leaf) {
+                    read_ahead.on_leaf_traversed();
+                }
             }
         }
         return true;
@@ -2,6 +2,8 @@
 #ifndef BTREE_DEPTH_FIRST_TRAVERSAL_HPP_
 #define BTREE_DEPTH_FIRST_TRAVERSAL_HPP_
 
+#include <vector>
+
 #include "btree/keys.hpp"
 #include "btree/types.hpp"
 #include "containers/archive/archive.hpp"
@@ -82,4 +84,14 @@ bool btree_depth_first_traversal(superblock_t *superblock,
                                  direction_t direction,
                                  release_superblock_t release_superblock);
 
+/* Splits `range` at the separator keys in the root node into up to `cbs.size()`
+parts, and traverses them forward all at the same time, the `i`th part with
+`cbs[i]`.  The root node is acquired once and shared.  Callbacks that don't get a
+part aren't called.  Returns `false` if any of the callbacks stopped its traversal. */
+bool btree_parallel_depth_first_traversal(
+        superblock_t *superblock,
+        const key_range_t &range,
+        const std::vector<depth_first_traversal_callback_t *> &cbs,
+        release_superblock_t release_superblock);
+
 #endif /* BTREE_DEPTH_FIRST_TRAVERSAL_HPP_ */
@@ -357,7 +357,28 @@ btree_internal_pair *get_pair_by_index(internal_node_t *node, int index) {
 }
 
 int get_offset_index(const internal_node_t *node, const btree_key_t *key) {
-    return std::lower_bound(node->pair_offsets, node->pair_offsets+node->npairs-1, (uint16_t) internal_key_comp::faux_offset, internal_key_comp(node, key)) - node->pair_offsets;
+    // Finds the first key that is at least `key`, like `std::lower_bound`, leaving
+    // out the special last pair.  Keys before `beg` are less than `key`, and keys
+    // from `end` on aren't.  `beg_common` and `end_common` are the lengths of the
+    // prefixes that `key` shares with the keys at `beg - 1` and `end`; the keys in
+    // between are sorted, so they share the shorter of the two with it.
+    int beg = 0;
+    int end = node->npairs - 1;
+    int beg_common = 0;
+    int end_common = 0;
+    while (beg < end) {
+        const int test_point = beg + (end - beg) / 2;
+        int common = std::min(beg_common, end_common);
+        if (btree_key_cmp_from(&get_pair_by_index(node, test_point)->key, key,
+                               &common) < 0) {
+            beg = test_point + 1;
+            beg_common = common;
+        } else {
+            end = test_point;
+            end_common = common;
+        }
+    }
+    return beg;
 }
 
 int nodecmp(const internal_node_t *node1, const internal_node_t *node2) {
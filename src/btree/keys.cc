@@ -15,6 +15,48 @@ int sized_strcmp(const uint8_t *str1, int len1, const uint8_t *str2, int len2) {
     return res;
 }
 
+int btree_key_cmp_from(const btree_key_t *left, const btree_key_t *right,
+                       int *common_inout) {
+    const int min_len = std::min(left->size, right->size);
+    int i = *common_inout;
+    rassert(i <= min_len);
+    // Eight bytes at a time while they match.
+    while (i + static_cast<int>(sizeof(uint64_t)) <= min_len) {
+        uint64_t left_word, right_word;
+        memcpy(&left_word, left->contents + i, sizeof(uint64_t));
+        memcpy(&right_word, right->contents + i, sizeof(uint64_t));
+        if (left_word != right_word) {
+            break;
+        }
+        i += sizeof(uint64_t);
+    }
+    while (i < min_len && left->contents[i] == right->contents[i]) {
+        ++i;
+    }
+    *common_inout = i;
+    if (i < min_len) {
+        return static_cast<int>(left->contents[i]) - static_cast<int>(right->contents[i]);
+    }
+    return static_cast<int>(left->size) - static_cast<int>(right->size);
+}
+
+void btree_key_separator(const btree_key_t *left, const btree_key_t *right,
+                         btree_key_t *separator_out) {
+    rassert(btree_key_cmp(left, right) < 0);
+    int common = 0;
+    btree_key_cmp_from(left, right, &common);
+    // `right` is greater, so it can't be a prefix of `left`.
+    rassert(common < right->size);
+    if (common + 1 < right->size) {
+        // One byte past the common prefix, `right`'s prefix becomes greater than
+        // `left`.
+        separator_out->size = common + 1;
+        memcpy(separator_out->contents, right->contents, common + 1);
+    } else {
+        memcpy(separator_out, left, left->full_size());
+    }
+}
+
 bool unescaped_str_to_key(const char *str, int len, store_key_t *buf) {
     if (len <= MAX_KEY_SIZE) {
         memcpy(buf->contents(), str, len);
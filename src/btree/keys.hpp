@@ -42,6 +42,21 @@ inline int btree_key_cmp(const btree_key_t *left, const btree_key_t *right) {
     return sized_strcmp(left->contents, left->size, right->contents, right->size);
 }
 
+// Compares like `btree_key_cmp`, given that the first `*common_inout` bytes of the
+// keys are known to be equal, and sets `*common_inout` to the length of their
+// common prefix.  Binary searches use this to skip the prefix that every key left in
+// the search range shares with the key they look for.
+int btree_key_cmp_from(const btree_key_t *left, const btree_key_t *right,
+                       int *common_inout);
+
+// Sets `*separator_out` to the shortest key that is at least `left` and less than
+// `right`, for the parent of two neighboring nodes whose last and first keys these
+// are.  Keys that sort together tend to share most of their bytes (secondary index
+// keys all end in a primary key), so this is usually much shorter than `left`, and
+// internal nodes get more children.
+void btree_key_separator(const btree_key_t *left, const btree_key_t *right,
+                         btree_key_t *separator_out);
+
 struct store_key_t {
 public:
     store_key_t() {
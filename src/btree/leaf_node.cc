@@ -516,6 +516,13 @@ bool is_empty(const leaf_node_t *node) {
     return node->num_pairs == 0;
 }
 
+const btree_key_t *last_key(const leaf_node_t *node) {
+    if (node->num_pairs == 0) {
+        return NULL;
+    }
+    return entry_key(get_entry(node, node->pair_offsets[node->num_pairs - 1]));
+}
+
 bool is_full(value_sizer_t *sizer, const leaf_node_t *node, const btree_key_t *key, const void *value) {
 
     // Upon an insertion, we preserve `MANDATORY_TIMESTAMPS - 1`
@@ -1009,7 +1016,9 @@ void split(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_ke
     move_elements(sizer, node, s, node->num_pairs, 0, rnode, node_copysize,
                   tstamp_back_offset, NULL);
 
-    keycpy(median_out, entry_key(get_entry(node, node->pair_offsets[s - 1])));
+    btree_key_separator(entry_key(get_entry(node, node->pair_offsets[s - 1])),
+                       entry_key(get_entry(rnode, rnode->pair_offsets[0])),
+                       median_out);
 }
 
 void merge(value_sizer_t *sizer, leaf_node_t *left, leaf_node_t *right) {
@@ -1138,9 +1147,13 @@ bool level(value_sizer_t *sizer, int nodecmp_node_with_sib,
     guarantee(sibling->num_pairs > 0);
 
     if (nodecmp_node_with_sib < 0) {
-        keycpy(replacement_key_out, entry_key(get_entry(node, node->pair_offsets[node->num_pairs - 1])));
+        btree_key_separator(entry_key(get_entry(node, node->pair_offsets[node->num_pairs - 1])),
+                           entry_key(get_entry(sibling, sibling->pair_offsets[0])),
+                           replacement_key_out);
     } else {
-        keycpy(replacement_key_out, entry_key(get_entry(sibling, sibling->pair_offsets[sibling->num_pairs - 1])));
+        btree_key_separator(entry_key(get_entry(sibling, sibling->pair_offsets[sibling->num_pairs - 1])),
+                           entry_key(get_entry(node, node->pair_offsets[0])),
+                           replacement_key_out);
     }
 
     return true;
@@ -1160,20 +1173,28 @@ bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out) {
     // beg == 0 or key > *(beg - 1).
     // end == num_pairs or key < *end.
 
+    // The lengths of the prefixes that key shares with *(beg - 1) and *end.  The
+    // keys in between are sorted, so they all share the shorter of the two with key.
+    int beg_common = 0;
+    int end_common = 0;
+
     while (beg < end) {
         // when (end - beg) > 0, (end - beg) / 2 is always less than (end - beg).  So beg <= test_point < end.
         int test_point = beg + (end - beg) / 2;
 
         const btree_key_t *ek = entry_key(get_entry(node, node->pair_offsets[test_point]));
 
-        int res = btree_key_cmp(key, ek);
+        int common = std::min(beg_common, end_common);
+        int res = btree_key_cmp_from(key, ek, &common);
 
         if (res < 0) {
             // key < *test_point.
             end = test_point;
+            end_common = common;
         } else if (res > 0) {
             // key > *test_point.  Since test_point < end, we have test_point + 1 <= end.
             beg = test_point + 1;
+            beg_common = common;
         } else {
             // We found the key!
             *index_out = test_point;
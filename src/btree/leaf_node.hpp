@@ -122,10 +122,17 @@ void init(value_sizer_t *sizer, leaf_node_t *node);
 
 bool is_empty(const leaf_node_t *node);
 
+// Returns the greatest key in the node, counting deletion entries, or NULL if the
+// node is empty.
+const btree_key_t *last_key(const leaf_node_t *node);
+
 bool is_full(value_sizer_t *sizer, const leaf_node_t *node, const btree_key_t *key, const void *value);
 
 bool is_underfull(value_sizer_t *sizer, const leaf_node_t *node);
 
+// `*median_out` is set to the shortest key that separates `node` from `sibling`,
+// which is often much shorter than the last key of `node`.  The same goes for the
+// `replacement_key_out` of `level`.
 void split(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *sibling,
            btree_key_t *median_out);
 
@@ -392,6 +392,25 @@ void create_stat_block(superblock_t *sb) {
     sb->set_stat_block_id(stats_block.block_id());
 }
 
+bool get_btree_population(superblock_t *sb, int64_t *population_out) {
+    const block_id_t stat_block_id = sb->get_stat_block_id();
+    if (stat_block_id == NULL_BLOCK_ID) {
+        return false;
+    }
+    // The stat block is detached from the rest of the tree, but we read it while
+    // holding the superblock, so we see the population of the same version of the
+    // tree.
+    buf_lock_t stat_block(buf_parent_t(sb->expose_buf().txn()),
+                          stat_block_id, access_t::read);
+    buf_read_t read(&stat_block);
+    uint32_t size;
+    const btree_statblock_t *stat_block_buf
+        = static_cast<const btree_statblock_t *>(read.get_data_read(&size));
+    guarantee(size == BTREE_STATBLOCK_SIZE);
+    *population_out = stat_block_buf->population;
+    return true;
+}
+
 buf_lock_t get_root(value_sizer_t *sizer, superblock_t *sb) {
     const block_id_t node_id = sb->get_root_block_id();
 
@@ -805,6 +824,9 @@ void find_keyvalue_location_for_write(
         profile::starter_t starter("Acquiring block for write.\n", trace);
         buf = get_root(sizer, superblock);
     }
+    // Where the key range of `buf` ends, for `move_keyvalue_location_for_write`.
+    bool buf_is_bounded = false;
+    store_key_t buf_right_bound;
 
     // Walk down the tree to the leaf.
     for (;;) {
@@ -828,6 +850,20 @@ void find_keyvalue_location_for_write(
                                        balancing_detacher);
         }
 
+        // The range of `buf` ends where the parent's does, unless `buf` isn't the
+        // parent's last child.  Splitting or leveling `buf` may have just moved
+        // that end, so we look it up afterwards.
+        if (!last_buf.empty()) {
+            buf_read_t read(&last_buf);
+            auto parent = static_cast<const internal_node_t *>(read.get_data_read());
+            const int index = internal_node::get_offset_index(parent, key);
+            if (index < parent->npairs - 1) {
+                buf_is_bounded = true;
+                buf_right_bound.assign(
+                    &internal_node::get_pair_by_index(parent, index)->key);
+            }
+        }
+
         // Release the superblock, if we've gone past the root (and haven't
         // already released it). If we're still at the root or at one of
         // its direct children, we might still want to replace the root, so
@@ -877,10 +913,65 @@ void find_keyvalue_location_for_write(
         }
     }
 
+    if (!last_buf.empty()) {
+        // The parent is the last node we went through, so its range is the one we
+        // kept track of.
+        keyvalue_location_out->last_buf_is_bounded = buf_is_bounded;
+        keyvalue_location_out->last_buf_right_bound = buf_right_bound;
+    }
     keyvalue_location_out->last_buf.swap(last_buf);
     keyvalue_location_out->buf.swap(buf);
 }
 
+bool move_keyvalue_location_for_write(
+        value_sizer_t *sizer, const btree_key_t *key,
+        keyvalue_location_t *keyvalue_location) THROWS_NOTHING {
+    block_id_t node_id = keyvalue_location->buf.block_id();
+    if (!keyvalue_location->last_buf.empty()) {
+        // If the previous write merged the leaf with its only sibling, the leaf has
+        // become the root and `last_buf` has been deleted.
+        if (keyvalue_location->superblock != NULL
+            && keyvalue_location->superblock->get_root_block_id() == node_id) {
+            return false;
+        }
+        buf_read_t read(&keyvalue_location->last_buf);
+        auto parent = static_cast<const internal_node_t *>(read.get_data_read());
+        if (internal_node::is_full(parent)) {
+            return false;
+        }
+        // Keys after the end of the parent's range belong to another subtree.
+        if (keyvalue_location->last_buf_is_bounded
+            && btree_key_cmp(key,
+                             keyvalue_location->last_buf_right_bound.btree_key()) > 0) {
+            return false;
+        }
+        node_id = internal_node::lookup(parent, key);
+    } else if (keyvalue_location->superblock == NULL) {
+        // We couldn't split the root without the superblock.
+        return false;
+    }
+
+    if (node_id != keyvalue_location->buf.block_id()) {
+        // The siblings of a leaf are leaves too.
+        keyvalue_location->buf.reset_buf_lock();
+        keyvalue_location->buf = buf_lock_t(&keyvalue_location->last_buf, node_id,
+                                            access_t::write);
+    }
+
+    keyvalue_location->there_originally_was_value = false;
+    keyvalue_location->value.reset();
+    {
+        scoped_malloc_t<void> tmp(sizer->max_possible_size());
+        buf_read_t read(&keyvalue_location->buf);
+        auto node = static_cast<const leaf_node_t *>(read.get_data_read());
+        if (leaf::lookup(sizer, node, key, tmp.get())) {
+            keyvalue_location->there_originally_was_value = true;
+            keyvalue_location->value = std::move(tmp);
+        }
+    }
+    return true;
+}
+
 void find_keyvalue_location_for_read(
         value_sizer_t *sizer,
         superblock_t *superblock, const btree_key_t *key,
@@ -958,6 +1049,145 @@ void find_keyvalue_location_for_read(
     }
 }
 
+bool find_keyvalue_optimistically(
+        value_sizer_t *sizer, cache_t *cache, const btree_key_t *key,
+        scoped_malloc_t<void> *value_out) {
+    ASSERT_NO_CORO_WAITING;
+
+    // The blocks we've looked at and their versions, to validate at the end.
+    std::vector<std::pair<block_id_t, uint64_t> > path;
+
+    uint64_t version;
+    const btree_superblock_t *sb = static_cast<const btree_superblock_t *>(
+        cache->peek_block(SUPERBLOCK_ID, &version));
+    if (sb == NULL) {
+        return false;
+    }
+    // Every write changes the superblock's metainfo, so we don't require the
+    // superblock itself to be unmodified.  Only `root_block` matters to us, and a
+    // writer that changes it is still modifying the new root.
+    path.push_back(std::make_pair(SUPERBLOCK_ID, version));
+    block_id_t node_id = sb->root_block;
+    rassert(node_id != SUPERBLOCK_ID);
+
+    scoped_malloc_t<void> value;
+    if (node_id != NULL_BLOCK_ID) {
+        for (;;) {
+            const node_t *node
+                = static_cast<const node_t *>(cache->peek_block(node_id, &version));
+            if (node == NULL || version % 2 != 0) {
+                return false;
+            }
+            path.push_back(std::make_pair(node_id, version));
+            if (!node::is_internal(node)) {
+                scoped_malloc_t<void> tmp(sizer->max_possible_size());
+                if (leaf::lookup(sizer, reinterpret_cast<const leaf_node_t *>(node),
+                                 key, tmp.get())) {
+                    value = std::move(tmp);
+                }
+                break;
+            }
+            node_id = internal_node::lookup(
+                reinterpret_cast<const internal_node_t *>(node), key);
+            rassert(node_id != NULL_BLOCK_ID && node_id != SUPERBLOCK_ID);
+        }
+    }
+
+    // Nothing can change the blocks while we don't yield, but this is cheap, and it
+    // keeps the read correct if that ever stops being true.
+    for (const auto &pair : path) {
+        if (!cache->peeked_block_is_unchanged(pair.first, pair.second)) {
+            return false;
+        }
+    }
+
+    *value_out = std::move(value);
+    return true;
+}
+
+namespace {
+// Looks up `keys[begin]` through `keys[end - 1]` in the subtree rooted at `buf`.
+void find_keyvalues_in_subtree(
+        value_sizer_t *sizer, buf_lock_t *buf,
+        const std::vector<store_key_t> &keys, size_t begin, size_t end,
+        found_keyvalue_callback_t *cb, profile::trace_t *trace) {
+    // Each child that some of the keys lead to, with the index of the first of them.
+    std::vector<std::pair<block_id_t, size_t> > children;
+    {
+        buf_read_t read(buf);
+        const node_t *node = static_cast<const node_t *>(read.get_data_read());
+#ifndef NDEBUG
+        node::validate(sizer, node);
+#endif  // NDEBUG
+        if (!node::is_internal(node)) {
+            const leaf_node_t *leaf = reinterpret_cast<const leaf_node_t *>(node);
+            scoped_malloc_t<void> value(sizer->max_possible_size());
+            for (size_t i = begin; i < end; ++i) {
+                if (leaf::lookup(sizer, leaf, keys[i].btree_key(), value.get())) {
+                    cb->on_keyvalue(i, value.get(), buf_parent_t(buf));
+                }
+            }
+            return;
+        }
+        const internal_node_t *inode = reinterpret_cast<const internal_node_t *>(node);
+        for (size_t i = begin; i < end; ++i) {
+            const block_id_t child_id = internal_node::lookup(inode, keys[i].btree_key());
+            rassert(child_id != NULL_BLOCK_ID && child_id != SUPERBLOCK_ID);
+            if (children.empty() || children.back().first != child_id) {
+                children.push_back(std::make_pair(child_id, i));
+            }
+        }
+    }
+
+    if (children.size() > 1) {
+        std::vector<block_id_t> child_ids;
+        child_ids.reserve(children.size());
+        for (const auto &child : children) {
+            child_ids.push_back(child.first);
+        }
+        buf->prefetch_children(child_ids);
+    }
+    for (size_t c = 0; c < children.size(); ++c) {
+        buf_lock_t child;
+        {
+            profile::starter_t starter("Acquire a block for read.", trace);
+            child = buf_lock_t(buf, children[c].first, access_t::read);
+        }
+        const size_t child_end = c + 1 < children.size() ? children[c + 1].second : end;
+        find_keyvalues_in_subtree(sizer, &child, keys, children[c].second, child_end,
+                                  cb, trace);
+    }
+}
+}  // namespace
+
+void find_keyvalues_for_read(
+        value_sizer_t *sizer,
+        superblock_t *superblock, const std::vector<store_key_t> &keys,
+        found_keyvalue_callback_t *cb,
+        btree_stats_t *stats, profile::trace_t *trace) {
+    rassert(std::is_sorted(keys.begin(), keys.end()));
+    stats->pm_keys_read.record(keys.size());
+    stats->pm_total_keys_read += keys.size();
+
+    const block_id_t root_id = superblock->get_root_block_id();
+    rassert(root_id != SUPERBLOCK_ID);
+
+    if (root_id == NULL_BLOCK_ID || keys.empty()) {
+        // The tree is empty, or there's nothing to look up.
+        superblock->release();
+        return;
+    }
+
+    buf_lock_t root;
+    {
+        profile::starter_t starter("Acquire a block for read.", trace);
+        buf_lock_t tmp(superblock->expose_buf(), root_id, access_t::read);
+        superblock->release();
+        root = std::move(tmp);
+    }
+    find_keyvalues_in_subtree(sizer, &root, keys, 0, keys.size(), cb, trace);
+}
+
 void apply_keyvalue_change(
         value_sizer_t *sizer,
         keyvalue_location_t *kv_loc,
@@ -83,8 +83,8 @@ class keyvalue_location_t {
 public:
     keyvalue_location_t()
         : superblock(NULL), pass_back_superblock(NULL),
-          there_originally_was_value(false), stat_block(NULL_BLOCK_ID),
-          stats(NULL) { }
+          last_buf_is_bounded(false), there_originally_was_value(false),
+          stat_block(NULL_BLOCK_ID), stats(NULL) { }
 
     ~keyvalue_location_t() {
         if (pass_back_superblock != NULL && superblock != NULL) {
@@ -98,6 +98,9 @@ public:
 
     // The parent buf of buf, if buf is not the root node.  This is hacky.
     buf_lock_t last_buf;
+    // The right end (inclusive) of `last_buf`'s key range, if it has one.
+    bool last_buf_is_bounded;
+    store_key_t last_buf_right_bound;
 
     // The buf owning the leaf node which contains the value.
     buf_lock_t buf;
@@ -240,6 +243,10 @@ void insert_root(block_id_t root_id, superblock_t *sb);
 /* Create a stat block for the superblock. */
 void create_stat_block(superblock_t *sb);
 
+/* Reads the number of keys in the tree out of its stat block.  Returns false if the
+tree doesn't have a stat block (secondary indexes don't). */
+bool get_btree_population(superblock_t *sb, int64_t *population_out);
+
 void get_btree_superblock(txn_t *txn, access_t access,
                           scoped_ptr_t<real_superblock_t> *got_superblock_out);
 
@@ -273,12 +280,56 @@ void find_keyvalue_location_for_write(
         profile::trace_t *trace,
         promise_t<superblock_t *> *pass_back_superblock = NULL) THROWS_NOTHING;
 
+/* Moves `*keyvalue_location` from the key it was found for to `key`, which must not
+ * come before it, without going down the tree again, so that a batch of writes in
+ * key order can go through each leaf once.  That works if `key` is in the leaf
+ * `*keyvalue_location` already holds or in one of its siblings, and the parent has
+ * room for the split that writing `key` might cause.  Returns false, leaving
+ * `*keyvalue_location` untouched, if it doesn't work; the caller then has to
+ * destroy it and call `find_keyvalue_location_for_write` for `key` instead. */
+bool move_keyvalue_location_for_write(
+        value_sizer_t *sizer, const btree_key_t *key,
+        keyvalue_location_t *keyvalue_location) THROWS_NOTHING;
+
 void find_keyvalue_location_for_read(
         value_sizer_t *sizer,
         superblock_t *superblock, const btree_key_t *key,
         keyvalue_location_t *keyvalue_location_out,
         btree_stats_t *stats, profile::trace_t *trace);
 
+/* Looks up `key` in the primary btree without acquiring the superblock or any
+nodes, by reading their in-memory contents with `cache_t::peek_block`, so the read
+doesn't wait in line behind write transactions that hold them.  Returns false if a
+node on the way isn't in memory or is in the middle of being modified (for example,
+by a split), in which case the caller has to use `find_keyvalue_location_for_read`.
+Otherwise sets `*value_out` to a copy of the value, or leaves it empty if there is
+none.  Since no blocks are held, blobs that the value refers to can't be loaded.
+This doesn't block, and doesn't record the read in the stats, because the caller
+might still fall back. */
+bool find_keyvalue_optimistically(
+        value_sizer_t *sizer, cache_t *cache, const btree_key_t *key,
+        scoped_malloc_t<void> *value_out);
+
+/* Called by `find_keyvalues_for_read` for every key that has a value.  `value` is a
+copy of the value, and `leaf` is the leaf node it's in, to load blobs from. */
+class found_keyvalue_callback_t {
+public:
+    virtual void on_keyvalue(size_t key_index, const void *value,
+                             buf_parent_t leaf) = 0;
+protected:
+    virtual ~found_keyvalue_callback_t() { }
+};
+
+/* Looks up all of `keys`, which have to be sorted, in a single descent of the tree.
+The children of each internal node that the keys lead to get prefetched together,
+so that their reads overlap.  Calls `cb` in the order of `keys`.  Releases
+`superblock`. */
+void find_keyvalues_for_read(
+        value_sizer_t *sizer,
+        superblock_t *superblock, const std::vector<store_key_t> &keys,
+        found_keyvalue_callback_t *cb,
+        btree_stats_t *stats, profile::trace_t *trace);
+
 /* Specifies whether `apply_keyvalue_change` should delete or erase a value.
 The difference is that deleting a value updates the node's replication timestamp
 and creates a deletion entry in the leaf. This means that the deletion is going
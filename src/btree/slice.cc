@@ -12,6 +12,10 @@
 // Run backfilling at a reduced priority
 #define BACKFILL_CACHE_PRIORITY 10
 
+// Queries run with `priority: "low"` get a larger share than backfills, but still
+// far less than the other reads together.
+#define LOW_PRIORITY_QUERY_CACHE_PRIORITY 25
+
 void btree_slice_t::init_superblock(buf_lock_t *superblock,
                                     const std::vector<char> &metainfo_key,
                                     const binary_blob_t &metainfo_value) {
@@ -39,6 +43,8 @@ btree_slice_t::btree_slice_t(cache_t *c, perfmon_collection_t *parent,
                              index_type_t index_type)
     : stats(parent, identifier, index_type),
       cache_(c),
-      backfill_account_(cache()->create_cache_account(BACKFILL_CACHE_PRIORITY)) { }
+      backfill_account_(cache()->create_cache_account(BACKFILL_CACHE_PRIORITY)),
+      low_priority_query_account_(
+          cache()->create_cache_account(LOW_PRIORITY_QUERY_CACHE_PRIORITY)) { }
 
 btree_slice_t::~btree_slice_t() { }
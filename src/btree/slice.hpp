@@ -89,6 +89,9 @@ public:
 
     cache_t *cache() { return cache_; }
     cache_account_t *get_backfill_account() { return &backfill_account_; }
+    cache_account_t *get_low_priority_query_account() {
+        return &low_priority_query_account_;
+    }
 
     btree_stats_t stats;
 
@@ -98,6 +101,9 @@ private:
     // Cache account to be used when backfilling.
     cache_account_t backfill_account_;
 
+    // Cache account for the reads and writes of low-priority queries.
+    cache_account_t low_priority_query_account_;
+
     DISABLE_COPYING(btree_slice_t);
 };
 
@@ -1,11 +1,18 @@
 #include "buffer_cache/alt.hpp"
 
+#include <math.h>
+
+#include <algorithm>
 #include <stack>
 
 #include "arch/types.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
 #include "buffer_cache/stats.hpp"
 #include "concurrency/auto_drainer.hpp"
+#include "config/args.hpp"
+#include "serializer/serializer.hpp"
+#include "threading.hpp"
 #include "utils.hpp"
 
 #define ALT_DEBUG 0
@@ -22,6 +29,18 @@ const int64_t MINIMUM_SOFT_UNWRITTEN_CHANGES_LIMIT = 1;
 const int64_t SOFT_UNWRITTEN_CHANGES_LIMIT = 4000;
 const double SOFT_UNWRITTEN_CHANGES_MEMORY_FRACTION = 0.5;
 
+// Once the unwritten changes fill this fraction of their limit, new write txns get
+// delayed, by up to BACKPRESSURE_MAX_DELAY_MS as the limit is reached.
+const double BACKPRESSURE_START_FRACTION = 0.5;
+const int64_t BACKPRESSURE_MAX_DELAY_MS = 20;
+
+// How old the oldest unflushed soft durability txn may get before new soft
+// durability txns wait for it.  A crash loses at most about this much of
+// acknowledged soft writes.
+const int64_t SOFT_DURABILITY_LOSS_WINDOW_MS = 100;
+static_assert(MAX_TABLE_SOFT_FLUSH_DELAY_MS < SOFT_DURABILITY_LOSS_WINDOW_MS,
+              "Delayed soft flushes would block soft durability txns.");
+
 // There are very few ASSERT_NO_CORO_WAITING calls (instead we have
 // ASSERT_FINITE_CORO_WAITING) because most of the time we're at the mercy of the
 // page cache, which often may need to load or evict blocks, which may involve a
@@ -60,7 +79,30 @@ alt_txn_throttler_t::alt_txn_throttler_t(int64_t minimum_unwritten_changes_limit
 
 alt_txn_throttler_t::~alt_txn_throttler_t() { }
 
+int64_t alt_txn_throttler_t::backpressure_delay_ms(int64_t unwritten_changes,
+                                                   int64_t limit) {
+    const double start = BACKPRESSURE_START_FRACTION * limit;
+    if (limit <= 0 || unwritten_changes <= start) {
+        return 0;
+    }
+    const double excess = std::min<double>(1.0, (unwritten_changes - start)
+                                                / (limit - start));
+    return static_cast<int64_t>(ceil(excess * BACKPRESSURE_MAX_DELAY_MS));
+}
+
 throttler_acq_t alt_txn_throttler_t::begin_txn_or_throttle(int64_t expected_change_count) {
+    // Slow writers down gradually as the unwritten changes pile up, so that they
+    // don't run into a full semaphore all at once and then all wake up together
+    // when a big flush completes.
+    if (expected_change_count > 0) {
+        const int64_t delay_ms =
+            backpressure_delay_ms(unwritten_changes_semaphore_.current(),
+                                  unwritten_changes_semaphore_.capacity());
+        if (delay_ms > 0) {
+            nap(delay_ms);
+        }
+    }
+
     throttler_acq_t acq;
     acq.semaphore_acq_.init(&unwritten_changes_semaphore_, expected_change_count);
     acq.semaphore_acq_.acquisition_signal()->wait();
@@ -84,19 +126,40 @@ void alt_txn_throttler_t::inform_memory_limit_change(uint64_t memory_limit,
 
 cache_t::cache_t(serializer_t *serializer,
                  cache_balancer_t *balancer,
-                 perfmon_collection_t *perfmon_collection)
+                 perfmon_collection_t *perfmon_collection,
+                 eviction_policy_t eviction_policy)
     : throttler_(MINIMUM_SOFT_UNWRITTEN_CHANGES_LIMIT),
-      page_cache_(serializer, balancer, &throttler_),
+      page_cache_(serializer, balancer, &throttler_, eviction_policy),
       stats_(make_scoped<alt_cache_stats_t>(&page_cache_, perfmon_collection)) { }
 
 cache_t::~cache_t() {
     guarantee(snapshot_nodes_by_block_id_.empty());
 }
 
+void cache_t::wait_for_soft_loss_window() {
+    assert_thread();
+    const ticks_t window = SOFT_DURABILITY_LOSS_WINDOW_MS * (secs_to_ticks(1) / 1000);
+    while (!soft_flushes_.empty()) {
+        alt_soft_flush_t *oldest = soft_flushes_.head();
+        if (get_ticks() - oldest->commit_time < window) {
+            return;
+        }
+        cond_t flushed;
+        oldest->waiters.push_back(&flushed);
+        flushed.wait();
+    }
+}
+
 cache_account_t cache_t::create_cache_account(int priority) {
     return page_cache_.create_cache_account(priority);
 }
 
+void cache_t::set_io_weight(double weight) {
+    serializer_t *serializer = page_cache_.serializer();
+    on_thread_t thread_switcher(serializer->home_thread());
+    serializer->set_io_weight(weight);
+}
+
 alt_snapshot_node_t *
 cache_t::matching_snapshot_node_or_null(block_id_t block_id,
                                         block_version_t block_version) {
@@ -217,6 +280,17 @@ void txn_t::inform_tracker(cache_t *cache, throttler_acq_t *throttler_acq) {
     cache->throttler_.end_txn(std::move(*throttler_acq));
 }
 
+void txn_t::finish_soft_flush(cache_t *cache,
+                              alt_soft_flush_t *soft_flush,
+                              throttler_acq_t *throttler_acq) {
+    inform_tracker(cache, throttler_acq);
+    cache->soft_flushes_.remove(soft_flush);
+    for (cond_t *waiter : soft_flush->waiters) {
+        waiter->pulse();
+    }
+    delete soft_flush;
+}
+
 void txn_t::pulse_and_inform_tracker(cache_t *cache,
                                      throttler_acq_t *throttler_acq,
                                      cond_t *pulsee) {
@@ -227,17 +301,28 @@ void txn_t::pulse_and_inform_tracker(cache_t *cache,
 txn_t::~txn_t() {
     cache_->assert_thread();
 
-    if (durability_ == write_durability_t::SOFT) {
+    if (access_ == access_t::read) {
         cache_->page_cache_.flush_and_destroy_txn(std::move(page_txn_),
                                                   std::bind(&txn_t::inform_tracker,
                                                             cache_,
                                                             ph::_1));
+    } else if (durability_ == write_durability_t::SOFT) {
+        alt_soft_flush_t *soft_flush = new alt_soft_flush_t(get_ticks());
+        cache_->soft_flushes_.push_back(soft_flush);
+        cache_->page_cache_.flush_and_destroy_txn(std::move(page_txn_),
+                                                  std::bind(&txn_t::finish_soft_flush,
+                                                            cache_,
+                                                            soft_flush,
+                                                            ph::_1),
+                                                  alt::flush_delay_t::soft);
+        cache_->wait_for_soft_loss_window();
     } else {
         cond_t cond;
         cache_->page_cache_.flush_and_destroy_txn(
                 std::move(page_txn_),
                 std::bind(&txn_t::pulse_and_inform_tracker,
-                          cache_, ph::_1, &cond));
+                          cache_, ph::_1, &cond),
+                alt::flush_delay_t::urgent);
         cond.wait();
     }
 }
@@ -680,6 +765,12 @@ void buf_lock_t::detach_child(block_id_t child_id) {
             child_id);
 }
 
+void buf_lock_t::prefetch_children(const std::vector<block_id_t> &child_ids) {
+    ASSERT_NO_CORO_WAITING;
+    guarantee(!empty());
+    cache()->page_cache_.prefetch_blocks(child_ids, txn_->account());
+}
+
 repli_timestamp_t buf_lock_t::get_recency() const {
     guarantee(!empty());
     current_page_acq_t *cpa = current_page_acq();
@@ -8,8 +8,10 @@
 
 #include "buffer_cache/page_cache.hpp"
 #include "buffer_cache/types.hpp"
+#include "containers/intrusive_list.hpp"
 #include "containers/two_level_array.hpp"
 #include "repli_timestamp.hpp"
+#include "time.hpp"
 
 class serializer_t;
 
@@ -30,6 +32,10 @@ public:
     void inform_memory_limit_change(uint64_t memory_limit,
                                     block_size_t max_block_size);
 
+    // How long a new write txn waits before getting in line, given how many changes
+    // are unwritten and what the limit on them is.
+    static int64_t backpressure_delay_ms(int64_t unwritten_changes, int64_t limit);
+
 private:
     const int64_t minimum_unwritten_changes_limit_;
 
@@ -38,11 +44,27 @@ private:
     DISABLE_COPYING(alt_txn_throttler_t);
 };
 
+// A soft durability txn whose changes haven't been flushed yet.
+class alt_soft_flush_t : public intrusive_list_node_t<alt_soft_flush_t> {
+public:
+    explicit alt_soft_flush_t(ticks_t _commit_time) : commit_time(_commit_time) { }
+
+    const ticks_t commit_time;
+    // Pulsed once the flush is complete.
+    std::vector<cond_t *> waiters;
+
+private:
+    DISABLE_COPYING(alt_soft_flush_t);
+};
+
 class cache_t : public home_thread_mixin_t {
 public:
-    explicit cache_t(serializer_t *serializer,
-                     cache_balancer_t *balancer,
-                     perfmon_collection_t *perfmon_collection);
+    // `eviction_policy` picks how the cache chooses pages to evict once it's over
+    // its memory limit.
+    cache_t(serializer_t *serializer,
+            cache_balancer_t *balancer,
+            perfmon_collection_t *perfmon_collection,
+            eviction_policy_t eviction_policy = eviction_policy_t::APPROXIMATE_LRU);
     ~cache_t();
 
     max_block_size_t max_block_size() const { return page_cache_.max_block_size(); }
@@ -54,6 +76,29 @@ public:
     // might consider supporting a mem_cap paremeter.
     cache_account_t create_cache_account(int priority);
 
+    // See `evicter_t::set_priority`.
+    void set_memory_priority(uint64_t reserved_memory, double weight) {
+        page_cache_.evicter().set_priority(reserved_memory, weight);
+    }
+
+    // See `serializer_t::set_io_weight`.  Blocks the coroutine.
+    void set_io_weight(double weight);
+
+    // See `page_cache_t::set_soft_flush_delay`.  Soft durability write txns get
+    // their flushes delayed; hard durability ones end the delay.
+    void set_soft_flush_delay(int64_t delay_ms) {
+        page_cache_.set_soft_flush_delay(delay_ms);
+    }
+
+    // For optimistic reads, which look at blocks without acquiring them.  See
+    // `page_cache_t::peek_page`.
+    const void *peek_block(block_id_t block_id, uint64_t *version_out) {
+        return page_cache_.peek_page(block_id, version_out);
+    }
+    bool peeked_block_is_unchanged(block_id_t block_id, uint64_t version) {
+        return page_cache_.peeked_page_is_unchanged(block_id, version);
+    }
+
 private:
     friend class txn_t;
     friend class buf_read_t;
@@ -66,8 +111,17 @@ private:
     void add_snapshot_node(block_id_t block_id, alt_snapshot_node_t *node);
     void remove_snapshot_node(block_id_t block_id, alt_snapshot_node_t *node);
 
+    // Soft durability txns are acknowledged before their changes are durable.  To
+    // bound what a crash can lose, this blocks while the oldest soft txn that
+    // hasn't been flushed was committed more than SOFT_DURABILITY_LOSS_WINDOW_MS
+    // ago.
+    void wait_for_soft_loss_window();
+
     // throttler_ can cause the txn_t constructor to block
     alt_txn_throttler_t throttler_;
+    // Unflushed soft durability txns, oldest first.  This has to outlive
+    // page_cache_, which completes the remaining flushes when it's destroyed.
+    intrusive_list_t<alt_soft_flush_t> soft_flushes_;
     alt::page_cache_t page_cache_;
 
     scoped_ptr_t<alt_cache_stats_t> stats_;
@@ -103,6 +157,10 @@ private:
                                alt::throttler_acq_t *throttler_acq);
 
     // Resets the *throttler_acq parameter.
+    static void finish_soft_flush(cache_t *cache,
+                                  alt_soft_flush_t *soft_flush,
+                                  alt::throttler_acq_t *throttler_acq);
+
     static void pulse_and_inform_tracker(cache_t *cache,
                                          alt::throttler_acq_t *throttler_acq,
                                          cond_t *pulsee);
@@ -192,6 +250,11 @@ public:
 
     void detach_child(block_id_t child_id);
 
+    // Starts loading the given children of this block into the cache without
+    // acquiring them.  Acquiring them afterwards works as usual; it just won't have
+    // to wait as long.  This is a hint, so it doesn't impose any ordering.
+    void prefetch_children(const std::vector<block_id_t> &child_ids);
+
     block_id_t block_id() const {
         guarantee(txn_ != NULL);
         return current_page_acq()->block_id();
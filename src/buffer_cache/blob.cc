@@ -5,7 +5,9 @@
 
 #include <limits>
 
+#include "arch/runtime/coroutines.hpp"
 #include "buffer_cache/alt.hpp"
+#include "concurrency/cond_var.hpp"
 #include "concurrency/pmap.hpp"
 #include "containers/buffer_group.hpp"
 #include "containers/scoped.hpp"
@@ -17,6 +19,9 @@
 // can allocate.
 const int64_t BLOB_TRAVERSAL_CONCURRENCY = 8;
 
+// How many leaf blocks past the one being read a blob_read_stream_t keeps loading.
+const size_t BLOB_READ_AHEAD_BLOCKS = 8;
+
 template <class T>
 void clear_and_delete(std::vector<T *> *vec) {
     while (!vec->empty()) {
@@ -214,6 +219,16 @@ int64_t value_size(const char *ref, int maxreflen) {
     }
 }
 
+bool make_small_ref(const std::string &data, int maxreflen,
+                    std::vector<char> *ref_out) {
+    if (!size_would_be_small(data.size(), maxreflen)) {
+        return false;
+    }
+    ref_out->assign(big_size_offset(maxreflen) + data.size(), 0);
+    set_small_size_field(ref_out->data(), maxreflen, data.size());
+    memcpy(small_buffer(ref_out->data(), maxreflen), data.data(), data.size());
+    return true;
+}
 
 int btree_maxreflen = 251;
 block_magic_t internal_node_magic = { { 'l', 'a', 'r', 'i' } };
@@ -788,4 +803,112 @@ bool blob_t::remove_level(buf_parent_t parent, int *levels_ref) {
     return true;
 }
 
+struct blob_read_stream_t::leaf_t {
+    scoped_ptr_t<buf_lock_t> lock;
+    // Destroyed before `lock`.
+    scoped_ptr_t<buf_read_t> read;
+    // The part of the leaf's data that hasn't been read yet.  `data` is set once
+    // `loaded` is pulsed.
+    int64_t offset;
+    int64_t size;
+    const char *data;
+    cond_t loaded;
+};
+
+blob_read_stream_t::blob_read_stream_t(buf_parent_t parent, const char *ref,
+                                       int maxreflen)
+    : small_data_(NULL), small_remaining_(0), next_leaf_(0), next_load_(0) {
+    if (blob::is_small(ref, maxreflen)) {
+        small_data_ = blob::small_buffer(const_cast<char *>(ref), maxreflen);
+        small_remaining_ = blob::small_size(ref, maxreflen);
+        return;
+    }
+
+    const int64_t size = blob::big_size(ref, maxreflen);
+    if (size == 0) {
+        return;
+    }
+    const int levels = blob::ref_info(parent.cache()->max_block_size(),
+                                      ref, maxreflen).levels;
+
+    // This acquires the leaf blocks, but doesn't load them yet.
+    temporary_acq_tree_node_t *tree
+        = blob::make_tree_from_block_ids(parent, access_t::read, levels, 0, size,
+                                         blob::block_ids(ref, maxreflen));
+    add_leaves(parent, levels, 0, size, tree);
+    start_loads();
+}
+
+blob_read_stream_t::~blob_read_stream_t() { }
 
+void blob_read_stream_t::add_leaves(buf_parent_t parent, int levels,
+                                    int64_t offset, int64_t size,
+                                    temporary_acq_tree_node_t *tree) {
+    const max_block_size_t block_size = parent.cache()->max_block_size();
+    int lo, hi;
+    blob::compute_acquisition_offsets(block_size, levels, offset, size, &lo, &hi);
+
+    for (int i = 0; i < hi - lo; ++i) {
+        int64_t suboffset, subsize;
+        blob::shrink(block_size, levels, offset, size, lo + i, &suboffset, &subsize);
+        if (levels > 1) {
+            add_leaves(parent, levels - 1, suboffset, subsize, tree[i].child);
+        } else {
+            scoped_ptr_t<leaf_t> leaf(new leaf_t);
+            leaf->lock.init(tree[i].buf);
+            leaf->offset = suboffset;
+            leaf->size = subsize;
+            leaf->data = NULL;
+            leaves_.push_back(std::move(leaf));
+        }
+    }
+
+    delete[] tree;
+}
+
+void blob_read_stream_t::start_loads() {
+    while (next_load_ < leaves_.size()
+           && next_load_ < next_leaf_ + BLOB_READ_AHEAD_BLOCKS) {
+        coro_t::spawn_sometime(std::bind(&blob_read_stream_t::load_leaf, this,
+                                         leaves_[next_load_].get(),
+                                         drainer_.lock()));
+        ++next_load_;
+    }
+}
+
+void blob_read_stream_t::load_leaf(leaf_t *leaf, auto_drainer_t::lock_t) {
+    leaf->read.init(new buf_read_t(leaf->lock.get()));
+    uint32_t block_size;
+    const void *buf = leaf->read->get_data_read(&block_size);
+    leaf->data = blob::leaf_node_data(buf) + leaf->offset;
+    leaf->loaded.pulse();
+}
+
+int64_t blob_read_stream_t::read(void *p, int64_t n) {
+    if (small_data_ != NULL) {
+        const int64_t k = std::min(n, small_remaining_);
+        memcpy(p, small_data_, k);
+        small_data_ += k;
+        small_remaining_ -= k;
+        return k;
+    }
+
+    int64_t total = 0;
+    while (total < n && next_leaf_ < leaves_.size()) {
+        leaf_t *leaf = leaves_[next_leaf_].get();
+        leaf->loaded.wait();
+        const int64_t k = std::min(n - total, leaf->size);
+        memcpy(static_cast<char *>(p) + total, leaf->data, k);
+        leaf->data += k;
+        leaf->size -= k;
+        total += k;
+
+        if (leaf->size == 0) {
+            leaf->read.reset();
+            leaf->lock.reset();
+            ++next_leaf_;
+            start_loads();
+        }
+    }
+    return total;
+}
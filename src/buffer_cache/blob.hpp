@@ -11,7 +11,10 @@
 
 #include "buffer_cache/types.hpp"
 #include "concurrency/access.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "containers/archive/archive.hpp"
 #include "containers/buffer_group.hpp"
+#include "containers/scoped.hpp"
 #include "errors.hpp"
 #include "serializer/types.hpp"
 
@@ -126,6 +129,10 @@ extern int btree_maxreflen;
 // The size of a blob, equivalent to blob_t(ref, maxreflen).valuesize().
 int64_t value_size(const char *ref, int maxreflen);
 
+// Sets `ref_out` to the ref of a blob that holds `data` inline, which doesn't need a
+// parent or any blocks.  Returns false if `data` is too big to fit into the ref.
+bool make_small_ref(const std::string &data, int maxreflen, std::vector<char> *ref_out);
+
 struct ref_info_t {
     // The ref_size of a ref.
     int refsize;
@@ -224,5 +231,40 @@ private:
     DISABLE_COPYING(blob_t);
 };
 
+// Reads the contents of a blob as a stream.  Unlike `blob_t::expose_all`, this
+// doesn't load all of the blob's leaf blocks before the first byte can be read:
+// up to BLOB_READ_AHEAD_BLOCKS leaf blocks past the one being read get loaded in
+// the background, and every leaf block is released as soon as it has been read
+// past.  So deserializing a large value overlaps with loading it.
+class blob_read_stream_t : public read_stream_t {
+public:
+    // `ref` must stay valid while the stream is in use.
+    blob_read_stream_t(buf_parent_t parent, const char *ref, int maxreflen);
+    ~blob_read_stream_t();
+
+    MUST_USE int64_t read(void *p, int64_t n);
+
+private:
+    struct leaf_t;
+
+    void add_leaves(buf_parent_t parent, int levels, int64_t offset, int64_t size,
+                    temporary_acq_tree_node_t *tree);
+    void start_loads();
+    void load_leaf(leaf_t *leaf, auto_drainer_t::lock_t keepalive);
+
+    // Non-NULL if the blob is stored in the ref itself.
+    const char *small_data_;
+    int64_t small_remaining_;
+
+    std::vector<scoped_ptr_t<leaf_t> > leaves_;
+    // The leaf to read from next, and the first leaf that hasn't started loading.
+    size_t next_leaf_;
+    size_t next_load_;
+
+    // Destroyed first, so that no loads are running when leaves_ gets destroyed.
+    auto_drainer_t drainer_;
+
+    DISABLE_COPYING(blob_read_stream_t);
+};
 
 #endif  // BUFFER_CACHE_BLOB_HPP_
@@ -1,5 +1,6 @@
 #include "buffer_cache/cache_balancer.hpp"
 
+#include <algorithm>
 #include <limits>
 
 #include "buffer_cache/evicter.hpp"
@@ -17,7 +18,9 @@ alt_cache_balancer_t::cache_data_t::cache_data_t(alt::evicter_t *_evicter) :
     new_size(0),
     old_size(evicter->memory_limit()),
     bytes_loaded(evicter->get_clamped_bytes_loaded()),
-    access_count(evicter->access_count()) { }
+    access_count(evicter->access_count()),
+    reserved_memory(evicter->reserved_memory()),
+    weight(evicter->weight()) { }
 
 alt_cache_balancer_t::alt_cache_balancer_t(
         clone_ptr_t<watchable_t<uint64_t> > _total_cache_size_watchable) :
@@ -116,12 +119,15 @@ void alt_cache_balancer_t::coro_pool_callback(alt_cache_balancer_dummy_value_t,
     // Sum up the number of evicters, bytes loaded, and access counts
     size_t total_evicters = 0;
     uint64_t total_bytes_loaded = 0;
+    double total_weighted_bytes_loaded = 0;
     uint64_t total_access_count = 0;
     for (size_t i = 0; i < num_threads; ++i) {
         total_evicters += cache_data[i].size();
         all_zero_access_counts &= zero_access_counts[i];
         for (size_t j = 0; j < cache_data[i].size(); ++j) {
             total_bytes_loaded += cache_data[i][j].bytes_loaded;
+            total_weighted_bytes_loaded +=
+                cache_data[i][j].weight * cache_data[i][j].bytes_loaded;
             total_access_count += cache_data[i][j].access_count;
         }
     }
@@ -158,13 +164,29 @@ void alt_cache_balancer_t::coro_pool_callback(alt_cache_balancer_dummy_value_t,
                 temp /= static_cast<double>(total_cache_size);
                 temp *= static_cast<double>(total_bytes_loaded);
 
-                int64_t new_size = data->bytes_loaded;
+                // Each cache's share of the bytes loaded is weighted, so that a
+                // busy cache with a low weight can't push out the others.  With
+                // equal weights this is just `data->bytes_loaded`.
+                double weighted_bytes_loaded = 0;
+                if (total_weighted_bytes_loaded > 0) {
+                    weighted_bytes_loaded = data->weight * data->bytes_loaded;
+                    weighted_bytes_loaded /= total_weighted_bytes_loaded;
+                    weighted_bytes_loaded *= static_cast<double>(total_bytes_loaded);
+                }
+
+                int64_t new_size = static_cast<int64_t>(weighted_bytes_loaded);
                 new_size -= static_cast<int64_t>(temp);
                 new_size += data->old_size;
                 new_size = std::max<int64_t>(new_size, 0);
 
                 data->new_size = new_size;
-                total_new_sizes += new_size;
+            }
+        }
+
+        apply_reservations(total_cache_size, &cache_data);
+        for (size_t i = 0; i < cache_data.size(); ++i) {
+            for (size_t j = 0; j < cache_data[i].size(); ++j) {
+                total_new_sizes += cache_data[i][j].new_size;
             }
         }
 
@@ -209,6 +231,72 @@ void alt_cache_balancer_t::coro_pool_callback(alt_cache_balancer_dummy_value_t,
     }
 }
 
+void alt_cache_balancer_t::apply_reservations(
+        uint64_t total_cache_size,
+        scoped_array_t<std::vector<cache_data_t> > *cache_data) {
+    // If the reservations don't fit, they're all scaled down alike.
+    uint64_t total_reserved = 0;
+    for (size_t i = 0; i < cache_data->size(); ++i) {
+        for (const cache_data_t &data : (*cache_data)[i]) {
+            total_reserved += data.reserved_memory;
+        }
+    }
+    if (total_reserved == 0) {
+        return;
+    }
+    const double reservation_scale = std::min<double>(
+        1.0, static_cast<double>(total_cache_size) / total_reserved);
+
+    // Caches that are held at their reservation only make room by being scaled
+    // down, so that can push others below theirs.  Each pass holds at least one more
+    // cache at its reservation, or is the last.
+    std::vector<std::vector<bool> > held(cache_data->size());
+    for (size_t i = 0; i < cache_data->size(); ++i) {
+        held[i].resize((*cache_data)[i].size(), false);
+    }
+    for (;;) {
+        uint64_t held_size = 0;
+        uint64_t free_size = 0;
+        for (size_t i = 0; i < cache_data->size(); ++i) {
+            for (size_t j = 0; j < (*cache_data)[i].size(); ++j) {
+                cache_data_t *data = &(*cache_data)[i][j];
+                const uint64_t reservation = static_cast<uint64_t>(
+                    data->reserved_memory * reservation_scale);
+                if (held[i][j] || data->new_size < reservation) {
+                    held[i][j] = true;
+                    data->new_size = reservation;
+                    held_size += reservation;
+                } else {
+                    free_size += data->new_size;
+                }
+            }
+        }
+        const uint64_t available = total_cache_size - std::min(held_size,
+                                                               total_cache_size);
+        if (free_size <= available) {
+            return;
+        }
+
+        bool pushed_below_reservation = false;
+        const double scale = static_cast<double>(available) / free_size;
+        for (size_t i = 0; i < cache_data->size(); ++i) {
+            for (size_t j = 0; j < (*cache_data)[i].size(); ++j) {
+                cache_data_t *data = &(*cache_data)[i][j];
+                if (!held[i][j]) {
+                    data->new_size = static_cast<uint64_t>(data->new_size * scale);
+                    pushed_below_reservation |=
+                        data->new_size
+                        < static_cast<uint64_t>(data->reserved_memory
+                                                * reservation_scale);
+                }
+            }
+        }
+        if (!pushed_below_reservation) {
+            return;
+        }
+    }
+}
+
 void alt_cache_balancer_t::collect_stats_from_thread(
         int index,
         scoped_array_t<std::vector<cache_data_t> > *data_out,
@@ -148,8 +148,16 @@ private:
         uint64_t old_size;
         uint64_t bytes_loaded;
         uint64_t access_count;
+        uint64_t reserved_memory;
+        double weight;
     };
 
+    // Raises the new sizes that fall short of their caches' reservations, and
+    // scales the others down to make up for it.
+    static void apply_reservations(
+        uint64_t total_cache_size,
+        scoped_array_t<std::vector<cache_data_t> > *cache_data);
+
     // Helper function to collect stats from each thread so we don't need
     //  atomic variables slowing down normal operations
     void collect_stats_from_thread(int index,
@@ -1,5 +1,7 @@
 #include "buffer_cache/evicter.hpp"
 
+#include <zlib.h>
+
 #include "buffer_cache/alt.hpp"
 #include "buffer_cache/page.hpp"
 #include "buffer_cache/page_cache.hpp"
@@ -9,14 +11,20 @@ namespace alt {
 
 evicter_t::evicter_t()
     : initialized_(false),
+      policy_(eviction_policy_t::APPROXIMATE_LRU),
       page_cache_(nullptr),
       balancer_(nullptr),
       balancer_notify_activity_boolean_(nullptr),
       throttler_(nullptr),
+      reserved_memory_(0),
+      weight_(1.0),
       bytes_loaded_counter_(0),
       access_count_counter_(0),
       access_time_counter_(INITIAL_ACCESS_TIME),
-      evict_if_necessary_active_(false) { }
+      evict_if_necessary_active_(false),
+      ghosts_added_(0),
+      compressed_blocks_added_(0),
+      compressed_size_(0) { }
 
 evicter_t::~evicter_t() {
     assert_thread();
@@ -29,10 +37,12 @@ evicter_t::~evicter_t() {
 
 void evicter_t::initialize(page_cache_t *page_cache,
                            cache_balancer_t *balancer,
-                           alt_txn_throttler_t *throttler) {
+                           alt_txn_throttler_t *throttler,
+                           eviction_policy_t policy) {
     assert_thread();
     guarantee(balancer != nullptr);
     initialized_ = true;  // Can you really say this class is 'initialized_'?
+    policy_ = policy;
     page_cache_ = page_cache;
     memory_limit_ = balancer->base_mem_per_store();
     page_cache_ = page_cache;
@@ -71,6 +81,23 @@ uint64_t evicter_t::get_clamped_bytes_loaded() const {
     return std::max<int64_t>(bytes_loaded_counter_, 0);
 }
 
+void evicter_t::set_priority(uint64_t reserved_memory, double weight) {
+    assert_thread();
+    guarantee(weight > 0);
+    reserved_memory_ = reserved_memory;
+    weight_ = weight;
+}
+
+uint64_t evicter_t::reserved_memory() const {
+    assert_thread();
+    return reserved_memory_;
+}
+
+double evicter_t::weight() const {
+    assert_thread();
+    return weight_;
+}
+
 uint64_t evicter_t::memory_limit() const {
     assert_thread();
     guarantee(initialized_);
@@ -119,6 +146,7 @@ void evicter_t::catch_up_deferred_load(page_t *page) {
 void evicter_t::add_not_yet_loaded(page_t *page) {
     assert_thread();
     guarantee(initialized_);
+    protect_if_ghost(page);
     unevictable_.add(page, page->hypothetical_memory_usage(page_cache_));
     evict_if_necessary();
     notify_bytes_loading(page->hypothetical_memory_usage(page_cache_));
@@ -127,6 +155,8 @@ void evicter_t::add_not_yet_loaded(page_t *page) {
 void evicter_t::reloading_page(page_t *page) {
     assert_thread();
     guarantee(initialized_);
+    rassert(unevictable_.has_page(page));
+    protect_if_ghost(page);
     notify_bytes_loading(page->hypothetical_memory_usage(page_cache_));
 }
 
@@ -145,6 +175,8 @@ bool evicter_t::page_is_in_evicted_bag(page_t *page) const {
 void evicter_t::add_to_evictable_unbacked(page_t *page) {
     assert_thread();
     guarantee(initialized_);
+    // The block is new, so an old compressed copy can't be of it.
+    forget_compressed_block(page->block_id());
     evictable_unbacked_.add(page, page->hypothetical_memory_usage(page_cache_));
     evict_if_necessary();
     notify_bytes_loading(page->hypothetical_memory_usage(page_cache_));
@@ -189,7 +221,9 @@ eviction_bag_t *evicter_t::correct_eviction_category(page_t *page) {
     } else if (!page->is_loaded()) {
         return &evicted_;
     } else if (page->is_disk_backed()) {
-        return &evictable_disk_backed_;
+        return page->is_protected()
+            ? &evictable_disk_backed_protected_
+            : &evictable_disk_backed_;
     } else {
         return &evictable_unbacked_;
     }
@@ -209,7 +243,9 @@ uint64_t evicter_t::in_memory_size() const {
     guarantee(initialized_);
     return unevictable_.size()
         + evictable_disk_backed_.size()
-        + evictable_unbacked_.size();
+        + evictable_disk_backed_protected_.size()
+        + evictable_unbacked_.size()
+        + compressed_size_;
 }
 
 void evicter_t::evict_if_necessary() THROWS_NOTHING {
@@ -229,16 +265,199 @@ void evicter_t::evict_if_necessary() THROWS_NOTHING {
 
     evict_if_necessary_active_ = true;
     page_t *page;
-    while (in_memory_size() > memory_limit_
-           && evictable_disk_backed_.remove_oldish(&page, access_time_counter_,
-                                                   page_cache_)) {
-        evicted_.add(page, page->hypothetical_memory_usage(page_cache_));
-        page->evict_self(page_cache_);
-        page_cache_->consider_evicting_current_page(page->block_id());
+    while (in_memory_size() > memory_limit_) {
+        // The compressed tier gives up its oldest blocks once it's over its share of
+        // the memory limit, or when there's nothing else to evict.
+        if (compressed_size_ > memory_limit_ * COMPRESSED_PAGE_TIER_FRACTION
+            && drop_oldest_compressed_block()) {
+            continue;
+        }
+        if (remove_page_to_evict(&page)) {
+            evicted_.add(page, page->hypothetical_memory_usage(page_cache_));
+            add_compressed_copy(page);
+            page->evict_self(page_cache_);
+            page_cache_->consider_evicting_current_page(page->block_id());
+        } else if (!drop_oldest_compressed_block()) {
+            break;
+        }
     }
     evict_if_necessary_active_ = false;
 }
 
+bool evicter_t::remove_page_to_evict(page_t **page_out) {
+    switch (policy_) {
+    case eviction_policy_t::APPROXIMATE_LRU:
+        return evictable_disk_backed_.remove_oldish(page_out, access_time_counter_,
+                                                    page_cache_);
+    case eviction_policy_t::TWO_QUEUE: {
+        // The probationary queue gets its share of the memory limit, and the
+        // protected queue gets the rest.  Pages evicted from the protected queue
+        // start over in the probationary queue, since they had their second chance.
+        const bool probationary_first
+            = evictable_disk_backed_.size()
+                > memory_limit_ * TWO_QUEUE_PROBATIONARY_FRACTION
+            || evictable_disk_backed_protected_.size() == 0;
+        if (probationary_first) {
+            if (evictable_disk_backed_.remove_oldish(page_out, access_time_counter_,
+                                                     page_cache_)) {
+                add_to_ghosts((*page_out)->block_id());
+                return true;
+            }
+            if (evictable_disk_backed_protected_.remove_oldish(
+                    page_out, access_time_counter_, page_cache_)) {
+                (*page_out)->protected_ = false;
+                return true;
+            }
+            return false;
+        } else {
+            if (evictable_disk_backed_protected_.remove_oldish(
+                    page_out, access_time_counter_, page_cache_)) {
+                (*page_out)->protected_ = false;
+                return true;
+            }
+            if (evictable_disk_backed_.remove_oldish(page_out, access_time_counter_,
+                                                     page_cache_)) {
+                add_to_ghosts((*page_out)->block_id());
+                return true;
+            }
+            return false;
+        }
+    }
+    default:
+        unreachable();
+    }
+}
+
+void evicter_t::add_to_ghosts(block_id_t block_id) {
+    ghosts_[block_id] = ghosts_added_;
+    ghost_queue_.push_back(block_id);
+    ++ghosts_added_;
+
+    const size_t max_ghosts = std::max<uint64_t>(
+        1, memory_limit_ * TWO_QUEUE_GHOST_FRACTION
+               / page_cache_->max_block_size().ser_value());
+    while (ghost_queue_.size() > max_ghosts) {
+        const uint64_t number = ghosts_added_ - ghost_queue_.size();
+        auto it = ghosts_.find(ghost_queue_.front());
+        if (it != ghosts_.end() && it->second == number) {
+            ghosts_.erase(it);
+        }
+        ghost_queue_.pop_front();
+    }
+}
+
+void evicter_t::protect_if_ghost(page_t *page) {
+    if (policy_ != eviction_policy_t::TWO_QUEUE || page->protected_) {
+        return;
+    }
+    auto it = ghosts_.find(page->block_id());
+    if (it != ghosts_.end()) {
+        ghosts_.erase(it);
+        page->protected_ = true;
+    }
+}
+
+bool evicter_t::has_compressed_block(block_id_t block_id) const {
+    assert_thread();
+    return compressed_blocks_.count(block_id) == 1;
+}
+
+bool evicter_t::take_compressed_block(block_id_t block_id,
+                                      const counted_t<standard_block_token_t> &token,
+                                      buf_ptr_t *buf_out) {
+    assert_thread();
+    auto it = compressed_blocks_.find(block_id);
+    if (it == compressed_blocks_.end()) {
+        return false;
+    }
+    const bool matches = it->second.offset == token->offset()
+        && it->second.block_size.value() == token->block_size().value();
+    if (matches) {
+        buf_ptr_t buf = buf_ptr_t::alloc_uninitialized(it->second.block_size);
+        uLongf size = it->second.block_size.ser_value();
+        int res = uncompress(reinterpret_cast<Bytef *>(buf.ser_buffer()),
+                             &size,
+                             reinterpret_cast<const Bytef *>(it->second.data.data()),
+                             it->second.data.size());
+        guarantee(res == Z_OK && size == it->second.block_size.ser_value());
+        buf.fill_padding_zero();
+        *buf_out = std::move(buf);
+    }
+    compressed_size_ -= it->second.data.size();
+    compressed_blocks_.erase(it);
+    return matches;
+}
+
+void evicter_t::forget_compressed_block(block_id_t block_id) {
+    assert_thread();
+    auto it = compressed_blocks_.find(block_id);
+    if (it != compressed_blocks_.end()) {
+        compressed_size_ -= it->second.data.size();
+        compressed_blocks_.erase(it);
+    }
+}
+
+void evicter_t::add_compressed_copy(page_t *page) {
+    rassert(page->buf_.has());
+    rassert(page->block_token_.has());
+    const uint32_t size = page->buf_.block_size().ser_value();
+    const uLongf max_compressed_size = size * COMPRESSED_PAGE_MAX_RATIO;
+    if (max_compressed_size == 0
+        || memory_limit_ * COMPRESSED_PAGE_TIER_FRACTION < max_compressed_size) {
+        return;
+    }
+
+    // `compress2` fails if the data doesn't fit, so there's no need to allocate the
+    // whole `compressBound(size)`.
+    scoped_array_t<char> buffer(max_compressed_size);
+    uLongf compressed_size = max_compressed_size;
+    const int res = compress2(reinterpret_cast<Bytef *>(buffer.data()),
+                              &compressed_size,
+                              reinterpret_cast<const Bytef *>(page->buf_.ser_buffer()),
+                              size,
+                              Z_BEST_SPEED);
+    if (res != Z_OK) {
+        return;
+    }
+
+    forget_compressed_block(page->block_id());
+    compressed_block_t block(page->block_token_->offset(), page->buf_.block_size(),
+                             compressed_blocks_added_);
+    ++compressed_blocks_added_;
+    block.data.init(compressed_size);
+    memcpy(block.data.data(), buffer.data(), compressed_size);
+    compressed_size_ += compressed_size;
+    compressed_queue_.push_back(std::make_pair(page->block_id(), block.number));
+    compressed_blocks_.insert(std::make_pair(page->block_id(), std::move(block)));
+
+    // Blocks that were taken or forgotten leave entries behind in the queue, which
+    // we clear out once they're the majority.
+    if (compressed_queue_.size() > 2 * compressed_blocks_.size() + 16) {
+        std::deque<std::pair<block_id_t, uint64_t> > live;
+        for (const auto &entry : compressed_queue_) {
+            auto it = compressed_blocks_.find(entry.first);
+            if (it != compressed_blocks_.end() && it->second.number == entry.second) {
+                live.push_back(entry);
+            }
+        }
+        compressed_queue_.swap(live);
+    }
+}
+
+bool evicter_t::drop_oldest_compressed_block() {
+    while (!compressed_queue_.empty()) {
+        const std::pair<block_id_t, uint64_t> entry = compressed_queue_.front();
+        compressed_queue_.pop_front();
+        auto it = compressed_blocks_.find(entry.first);
+        if (it != compressed_blocks_.end() && it->second.number == entry.second) {
+            compressed_size_ -= it->second.data.size();
+            compressed_blocks_.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
 usage_adjuster_t::usage_adjuster_t(page_cache_t *page_cache, page_t *page)
     : page_cache_(page_cache),
       page_(page),
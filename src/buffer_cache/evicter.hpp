@@ -3,16 +3,33 @@
 
 #include <stdint.h>
 
+#include <deque>
 #include <functional>
+#include <unordered_map>
+#include <utility>
 
 #include "buffer_cache/eviction_bag.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/cache_line_padded.hpp"
 #include "concurrency/pubsub.hpp"
+#include "containers/scoped.hpp"
+#include "serializer/types.hpp"
 #include "threading.hpp"
 
 class cache_balancer_t;
 class alt_txn_throttler_t;
+class buf_ptr_t;
+
+// How the evicter picks which pages to evict.
+enum class eviction_policy_t {
+    // Evicts the least recently accessed of a handful of random pages.
+    APPROXIMATE_LRU,
+    // Like 2Q: pages start out in a probationary queue, and move to a protected
+    // queue only when they get reloaded soon after being evicted.  A scan of a
+    // whole table then only cycles through the probationary queue, instead of
+    // evicting the working set of every other query.
+    TWO_QUEUE
+};
 
 namespace alt {
 
@@ -35,13 +52,25 @@ public:
     void remove_page(page_t *page);
     void reloading_page(page_t *page);
 
+    // Evicted pages go to a compressed tier, where they stay until the tier runs
+    // out of room or their block changes.  A copy matches a block token if the block
+    // was written at the same offset.
+    bool has_compressed_block(block_id_t block_id) const;
+    // Removes the compressed copy of the block and decompresses it into `buf_out`,
+    // if there is one that matches `token`.
+    bool take_compressed_block(block_id_t block_id,
+                               const counted_t<standard_block_token_t> &token,
+                               buf_ptr_t *buf_out);
+    void forget_compressed_block(block_id_t block_id);
+
     // Evicter will be unusable until initialize is called
     evicter_t();
     ~evicter_t();
 
     void initialize(page_cache_t *page_cache,
                     cache_balancer_t *balancer,
-                    alt_txn_throttler_t *throttler);
+                    alt_txn_throttler_t *throttler,
+                    eviction_policy_t policy);
     void update_memory_limit(uint64_t new_memory_limit,
                              uint64_t bytes_loaded_accounted_for,
                              uint64_t access_count_accounted_for,
@@ -52,6 +81,15 @@ public:
         return ++access_time_counter_;
     }
 
+    // The access time that the page accessed most recently got.
+    uint64_t current_access_time() const { return access_time_counter_; }
+
+    // The cache balancer never gives this evicter less than `reserved_memory`, and
+    // weighs its demand for more memory by `weight` against other evicters'.
+    void set_priority(uint64_t reserved_memory, double weight);
+    uint64_t reserved_memory() const;
+    double weight() const;
+
     uint64_t memory_limit() const;
     uint64_t access_count() const;
     uint64_t get_clamped_bytes_loaded() const;
@@ -71,7 +109,24 @@ private:
     // Evicts any evictable pages until under the memory limit
     void evict_if_necessary() THROWS_NOTHING;
 
+    // Removes an evictable page to evict, following `policy_`.  Returns false if
+    // there are none.
+    bool remove_page_to_evict(page_t **page_out);
+
+    // For the two-queue policy, remembers that a block got evicted from the
+    // probationary queue, or marks a page as protected if its block was.
+    void add_to_ghosts(block_id_t block_id);
+    void protect_if_ghost(page_t *page);
+
+    // Puts a compressed copy of the page, which is about to be evicted, in the
+    // compressed tier, unless it doesn't compress well.
+    void add_compressed_copy(page_t *page);
+    // Drops the compressed block that was added first.  Returns false if there
+    // are none.
+    bool drop_oldest_compressed_block();
+
     bool initialized_;
+    eviction_policy_t policy_;
     page_cache_t *page_cache_;
     cache_balancer_t *balancer_;
     bool *balancer_notify_activity_boolean_;
@@ -80,6 +135,9 @@ private:
 
     uint64_t memory_limit_;
 
+    uint64_t reserved_memory_;
+    double weight_;
+
     // These are updated every time a page is loaded, created, or destroyed, and
     // cleared when cache memory limits are re-evaluated.  This value can go
     // negative, if you keep deleting blocks or suddenly drop a snapshot.
@@ -93,12 +151,42 @@ private:
     // It avoids reentrant calls to that function.
     bool evict_if_necessary_active_;
 
-    // These track every page's eviction status.
+    // These track every page's eviction status.  Protected pages go in
+    // `evictable_disk_backed_protected_` instead of `evictable_disk_backed_`, which
+    // only happens with the two-queue policy.
     eviction_bag_t unevictable_;
     eviction_bag_t evictable_disk_backed_;
+    eviction_bag_t evictable_disk_backed_protected_;
     eviction_bag_t evictable_unbacked_;
     eviction_bag_t evicted_;
 
+    // The blocks most recently evicted from the probationary queue, oldest first,
+    // and the number each got in `ghost_queue_`, counting from the first block
+    // ever added to it.  A block that got evicted twice is in the queue twice, but
+    // the map only counts its latest entry.
+    std::deque<block_id_t> ghost_queue_;
+    std::unordered_map<block_id_t, uint64_t> ghosts_;
+    uint64_t ghosts_added_;
+
+    struct compressed_block_t {
+        compressed_block_t(int64_t _offset, block_size_t _block_size,
+                           uint64_t _number)
+            : offset(_offset), block_size(_block_size), number(_number) { }
+        int64_t offset;
+        block_size_t block_size;
+        scoped_array_t<char> data;
+        // The number it got in `compressed_queue_`.
+        uint64_t number;
+    };
+    // The compressed tier, and the order its blocks were added in.  Blocks that
+    // were taken or forgotten stay in the queue, with numbers that no longer match.
+    std::unordered_map<block_id_t, compressed_block_t> compressed_blocks_;
+    std::deque<std::pair<block_id_t, uint64_t> > compressed_queue_;
+    uint64_t compressed_blocks_added_;
+    // The memory used by `compressed_blocks_`' data, which counts against the
+    // memory limit.
+    uint64_t compressed_size_;
+
     auto_drainer_t drainer_;
 
     DISABLE_COPYING(evicter_t);
@@ -56,6 +56,7 @@ page_t::page_t(block_id_t block_id, page_cache_t *page_cache)
     : block_id_(block_id),
       loader_(NULL),
       access_time_(page_cache->evicter().next_access_time()),
+      protected_(false),
       snapshot_refcount_(0) {
     page_cache->evicter().add_deferred_loaded(this);
 
@@ -70,6 +71,7 @@ page_t::page_t(block_id_t block_id, page_cache_t *page_cache,
     : block_id_(block_id),
       loader_(NULL),
       access_time_(page_cache->evicter().next_access_time()),
+      protected_(false),
       snapshot_refcount_(0) {
     page_cache->evicter().add_not_yet_loaded(this);
 
@@ -86,6 +88,7 @@ page_t::page_t(block_id_t block_id, buf_ptr_t buf,
       loader_(NULL),
       buf_(std::move(buf)),
       access_time_(page_cache->evicter().next_access_time()),
+      protected_(false),
       snapshot_refcount_(0) {
     rassert(buf_.has());
     page_cache->evicter().add_to_evictable_unbacked(this);
@@ -100,6 +103,7 @@ page_t::page_t(block_id_t block_id,
       buf_(std::move(buf)),
       block_token_(block_token),
       access_time_(READ_AHEAD_ACCESS_TIME),
+      protected_(false),
       snapshot_refcount_(0) {
     rassert(buf_.has());
     page_cache->evicter().add_to_evictable_disk_backed(this);
@@ -109,6 +113,7 @@ page_t::page_t(page_t *copyee, page_cache_t *page_cache, cache_account_t *accoun
     : block_id_(copyee->block_id_),
       loader_(NULL),
       access_time_(page_cache->evicter().next_access_time()),
+      protected_(false),
       snapshot_refcount_(0) {
     page_cache->evicter().add_not_yet_loaded(this);
     coro_t::spawn_now_dangerously(std::bind(&page_t::load_from_copyee,
@@ -151,12 +156,17 @@ void page_t::load_from_copyee(page_t *page, page_t *copyee,
 
         ASSERT_FINITE_CORO_WAITING;
         if (!loader.abandon_page()) {
-            // KSI: If somehow there are no snapshotters of copyee now (besides
-            // ourself), maybe we could avoid copying this memory.  We need to
-            // carefully track snapshotters anyway, once we're comfortable with that,
-            // we could do it.
-
-            {
+            if (copyee->num_snapshot_references() == 1) {
+                // Only copyee_ptr refers to the copyee anymore: the snapshot that
+                // made the copy necessary went away while the copyee was loading.
+                // Nobody can acquire the copyee again, so we take its buffer
+                // instead of copying it.  (The copyee stays in the unevictable
+                // bag until acq is gone, and is destroyed right after.)
+                usage_adjuster_t copyee_adjuster(page_cache, copyee);
+                usage_adjuster_t adjuster(page_cache, page);
+                page->buf_ = std::move(copyee->buf_);
+                page->loader_ = NULL;
+            } else {
                 usage_adjuster_t adjuster(page_cache, page);
                 page->buf_ = buf_ptr_t::alloc_copy(copyee->buf_);
                 page->loader_ = NULL;
@@ -349,8 +359,22 @@ void page_t::load_with_block_id(page_t *page, block_id_t block_id,
     buf_ptr_t buf;
     counted_t<standard_block_token_t> block_token;
 
-    {
-        serializer_t *const serializer = page_cache->serializer();
+    serializer_t *const serializer = page_cache->serializer();
+    if (page_cache->evicter().has_compressed_block(block_id)) {
+        // We need the block token to tell whether the compressed copy is current,
+        // so the index read gets a trip of its own.
+        {
+            on_thread_t th(serializer->home_thread());
+            block_token = serializer->index_read(block_id);
+            rassert(block_token.has());
+        }
+        if (!page_cache->evicter().take_compressed_block(block_id, block_token,
+                                                         &buf)) {
+            on_thread_t th(serializer->home_thread());
+            buf = serializer->block_read(block_token,
+                                         account->get());
+        }
+    } else {
         on_thread_t th(serializer->home_thread());
         block_token = serializer->index_read(block_id);
         rassert(block_token.has());
@@ -446,7 +470,8 @@ void page_t::load_using_block_token(page_t *page, page_cache_t *page_cache,
     rassert(block_token.has());
 
     buf_ptr_t buf;
-    {
+    if (!page_cache->evicter().take_compressed_block(page->block_id_, block_token,
+                                                     &buf)) {
         serializer_t *const serializer = page_cache->serializer();
 
         on_thread_t th(serializer->home_thread());
@@ -505,7 +530,7 @@ void *page_t::get_page_buf(page_cache_t *page_cache) {
     return buf_.cache_data();
 }
 
-void page_t::reset_block_token(DEBUG_VAR page_cache_t *page_cache) {
+void page_t::reset_block_token(page_cache_t *page_cache) {
     // The page is supposed to have its buffer acquired in reset_block_token -- it's
     // the thing modifying the page.  We thus assume that the page is unevictable and
     // resetting block_token_ doesn't change that.
@@ -517,6 +542,8 @@ void page_t::reset_block_token(DEBUG_VAR page_cache_t *page_cache) {
         const uint32_t usage_before = hypothetical_memory_usage(page_cache);
 #endif
         block_token_.reset();
+        // The block is about to change, so a compressed copy would be out of date.
+        page_cache->evicter().forget_compressed_block(block_id_);
         // Hypothetical memory usage shouldn't have changed -- because the buf is
         // already loaded in memory.
         rassert(usage_before == hypothetical_memory_usage(page_cache));
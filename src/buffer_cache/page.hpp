@@ -65,6 +65,7 @@ public:
     bool has_waiters() const { return !waiters_.empty(); }
     bool is_loaded() const { return buf_.has(); }
     bool is_disk_backed() const { return block_token_.has(); }
+    bool is_protected() const { return protected_; }
 
     void evict_self(page_cache_t *page_cache);
 
@@ -118,6 +119,7 @@ private:
                                        cache_account_t *account);
 
     friend backindex_bag_index_t *access_backindex(page_t *page);
+    friend class evicter_t;
 
     // The block id.  Used to (potentially) delete the page_t and current_page_t when
     // it gets evicted.
@@ -132,6 +134,10 @@ private:
 
     uint64_t access_time_;
 
+    // Set by the evicter's two-queue policy when the page is reloaded soon after
+    // it got evicted.  The evicter keeps such pages in a bag of their own.
+    bool protected_;
+
     // How many page_ptr_t's point at this page, expecting nothing to modify it,
     // other than themselves.
     size_t snapshot_refcount_;
@@ -8,6 +8,7 @@
 #include "arch/runtime/coroutines.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "arch/runtime/runtime_utils.hpp"
+#include "arch/timing.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/new_mutex.hpp"
 #include "buffer_cache/cache_balancer.hpp"
@@ -60,7 +61,7 @@ void page_read_ahead_cb_t::offer_read_ahead_buf(
     buf_ptr_t local_buf = std::move(*buf);
 
     block_size_t block_size = block_size_t::undefined();
-    scoped_malloc_t<ser_buffer_t> ptr;
+    scoped_ser_buffer_t ptr;
     local_buf.release(&block_size, &ptr);
 
     // We're going to reconstruct the buf_ptr_t on the other side of this do_on_thread
@@ -123,7 +124,7 @@ void page_cache_t::add_read_ahead_buf(block_id_t block_id,
                                       const counted_t<standard_block_token_t> &token) {
     assert_thread();
 
-    scoped_malloc_t<ser_buffer_t> ptr(ser_buffer);
+    scoped_ser_buffer_t ptr(ser_buffer);
 
     // We MUST stop if read_ahead_cb_ is NULL because that means current_page_t's
     // could start being destroyed.
@@ -178,6 +179,84 @@ void page_cache_t::consider_evicting_all_current_pages(page_cache_t *page_cache,
 }
 
 
+void page_cache_t::report_hot_blocks(page_cache_t *page_cache,
+                                     auto_drainer_t::lock_t lock) {
+    const uint64_t access_time = page_cache->evicter_.current_access_time();
+    std::vector<std::pair<uint64_t, block_id_t> > ages;
+    for (block_id_t id = 0; id < page_cache->current_pages_.size(); ++id) {
+        current_page_t *current_page = page_cache->current_pages_.get_sparsely(id);
+        if (current_page != NULL && !current_page->is_deleted()
+            && current_page->page_.has()) {
+            page_t *page = current_page->page_.get_page_for_read();
+            if (page->is_loaded()) {
+                ages.push_back(std::make_pair(access_time - page->access_time(), id));
+            }
+        }
+        if (id % 256 == 255) {
+            coro_t::yield();
+            if (lock.get_drain_signal()->is_pulsed()) {
+                return;
+            }
+        }
+    }
+
+    if (ages.size() > HOT_BLOCK_LIST_MAX_BLOCKS) {
+        std::nth_element(ages.begin(), ages.begin() + HOT_BLOCK_LIST_MAX_BLOCKS,
+                         ages.end());
+        ages.resize(HOT_BLOCK_LIST_MAX_BLOCKS);
+    }
+    std::vector<block_id_t> block_ids;
+    block_ids.reserve(ages.size());
+    for (auto it = ages.begin(); it != ages.end(); ++it) {
+        block_ids.push_back(it->second);
+    }
+
+    serializer_t *serializer = page_cache->serializer_;
+    on_thread_t thread_switcher(serializer->home_thread());
+    serializer->set_hot_block_ids(block_ids);
+}
+
+void page_cache_t::warm_up_hot_blocks(page_cache_t *page_cache,
+                                      const std::vector<block_id_t> &block_ids,
+                                      auto_drainer_t::lock_t lock) {
+    serializer_t *serializer = page_cache->serializer_;
+    for (size_t i = 0; i < block_ids.size(); i += HOT_BLOCK_WARMUP_BATCH_SIZE) {
+        // Once read-ahead stops, the cache is full enough, and
+        // add_read_ahead_buf would drop the blocks anyway.
+        if (page_cache->read_ahead_cb_ == NULL
+            || lock.get_drain_signal()->is_pulsed()) {
+            return;
+        }
+
+        const size_t end = std::min<size_t>(block_ids.size(),
+                                            i + HOT_BLOCK_WARMUP_BATCH_SIZE);
+        std::vector<block_id_t> read_ids;
+        std::vector<counted_t<standard_block_token_t> > tokens;
+        std::vector<buf_ptr_t> bufs;
+        {
+            on_thread_t thread_switcher(serializer->home_thread());
+            for (size_t j = i; j < end; ++j) {
+                counted_t<standard_block_token_t> token
+                    = serializer->index_read(block_ids[j]);
+                if (!token.has()) {
+                    continue;
+                }
+                bufs.push_back(serializer->block_read(
+                        token, page_cache->default_reads_account_.get()));
+                read_ids.push_back(block_ids[j]);
+                tokens.push_back(std::move(token));
+            }
+        }
+
+        for (size_t j = 0; j < bufs.size(); ++j) {
+            block_size_t block_size = block_size_t::undefined();
+            scoped_ser_buffer_t ptr;
+            bufs[j].release(&block_size, &ptr);
+            page_cache->add_read_ahead_buf(read_ids[j], ptr.release(), tokens[j]);
+        }
+    }
+}
+
 void page_cache_t::read_ahead_cb_is_destroyed() {
     assert_thread();
     read_ahead_cb_existence_.reset();
@@ -193,12 +272,15 @@ public:
 
 page_cache_t::page_cache_t(serializer_t *serializer,
                            cache_balancer_t *balancer,
-                           alt_txn_throttler_t *throttler)
+                           alt_txn_throttler_t *throttler,
+                           eviction_policy_t eviction_policy)
     : max_block_size_(serializer->max_block_size()),
       serializer_(serializer),
       free_list_(serializer),
       evicter_(),
       read_ahead_cb_(NULL),
+      soft_flush_delay_ms_(0),
+      flush_delay_ending_scheduled_(false),
       drainer_(make_scoped<auto_drainer_t>()) {
 
     const bool start_read_ahead = balancer->read_ahead_ok_at_start();
@@ -207,10 +289,12 @@ page_cache_t::page_cache_t(serializer_t *serializer,
     }
 
     page_read_ahead_cb_t *local_read_ahead_cb = NULL;
+    std::vector<block_id_t> hot_block_ids;
     {
         on_thread_t thread_switcher(serializer->home_thread());
         if (start_read_ahead) {
             local_read_ahead_cb = new page_read_ahead_cb_t(serializer, this);
+            hot_block_ids = serializer->hot_block_ids();
         }
         default_reads_account_.init(serializer->home_thread(),
                                     serializer->make_io_account(CACHE_READS_IO_PRIORITY));
@@ -225,15 +309,26 @@ page_cache_t::page_cache_t(serializer_t *serializer,
     // initialize the read_ahead_cb_ after the evicter_ because that way reentrant
     // usage by the balancer (before page_cache_t construction completes) would be
     // more likely to trip an assertion.
-    evicter_.initialize(this, balancer, throttler);
+    evicter_.initialize(this, balancer, throttler, eviction_policy);
     read_ahead_cb_ = local_read_ahead_cb;
+
+    if (read_ahead_cb_ != NULL && !hot_block_ids.empty()) {
+        coro_t::spawn_sometime(std::bind(&page_cache_t::warm_up_hot_blocks, this,
+                                         std::move(hot_block_ids), drainer_->lock()));
+    }
+    hot_block_timer_.init(new repeating_timer_t(HOT_BLOCK_LIST_INTERVAL_MS, [this]() {
+        coro_t::spawn_sometime(std::bind(&page_cache_t::report_hot_blocks, this,
+                                         drainer_->lock()));
+    }));
 }
 
 page_cache_t::~page_cache_t() {
     assert_thread();
 
+    hot_block_timer_.reset();
     have_read_ahead_cb_destroyed();
 
+    end_flush_delay();
     drainer_.reset();
     for (size_t i = 0, e = current_pages_.size(); i < e; ++i) {
         if (i % 256 == 255) {
@@ -308,12 +403,25 @@ private:
 
 void page_cache_t::flush_and_destroy_txn(
         scoped_ptr_t<page_txn_t> txn,
-        std::function<void(throttler_acq_t *)> on_flush_complete) {
+        std::function<void(throttler_acq_t *)> on_flush_complete,
+        flush_delay_t flush_delay) {
     guarantee(txn->live_acqs_ == 0,
               "A current_page_acq_t lifespan exceeds its page_txn_t's.");
     guarantee(!txn->began_waiting_for_flush_);
 
-    txn->announce_waiting_for_flush();
+    if (flush_delay == flush_delay_t::soft && soft_flush_delay_ms_ > 0) {
+        delayed_flush_txns_.push_back(txn.get());
+        if (!flush_delay_ending_scheduled_) {
+            flush_delay_ending_scheduled_ = true;
+            coro_t::spawn_sometime(std::bind(&page_cache_t::end_flush_delay_later,
+                                             this, drainer_->lock()));
+        }
+    } else {
+        if (flush_delay == flush_delay_t::urgent) {
+            end_flush_delay();
+        }
+        txn->announce_waiting_for_flush();
+    }
 
     page_txn_t *page_txn = txn.release();
     flush_and_destroy_txn_waiter_t *sub
@@ -323,6 +431,44 @@ void page_cache_t::flush_and_destroy_txn(
     sub->reset(&page_txn->flush_complete_cond_);
 }
 
+void page_cache_t::set_soft_flush_delay(int64_t delay_ms) {
+    assert_thread();
+    rassert(delay_ms >= 0);
+    soft_flush_delay_ms_ = delay_ms;
+}
+
+void page_cache_t::end_flush_delay() {
+    assert_thread();
+    ASSERT_FINITE_CORO_WAITING;
+    std::vector<page_txn_t *> txns;
+    txns.swap(delayed_flush_txns_);
+
+    // All the txns have to be waiting before we look for flushable sets, so that
+    // txns that depend on each other end up in the same set.  The txns of a set
+    // whose flush completes right away are only destroyed later on, by
+    // flush_and_destroy_txn_waiter_t.
+    for (page_txn_t *txn : txns) {
+        rassert(!txn->began_waiting_for_flush_);
+        txn->began_waiting_for_flush_ = true;
+    }
+    for (page_txn_t *txn : txns) {
+        if (!txn->spawned_flush_) {
+            im_waiting_for_flush(txn);
+        }
+    }
+}
+
+void page_cache_t::end_flush_delay_later(page_cache_t *page_cache,
+                                         auto_drainer_t::lock_t lock) {
+    try {
+        nap(page_cache->soft_flush_delay_ms_, lock.get_drain_signal());
+    } catch (const interrupted_exc_t &) {
+        // The destructor ends the delay itself.
+        return;
+    }
+    page_cache->flush_delay_ending_scheduled_ = false;
+    page_cache->end_flush_delay();
+}
 
 current_page_t *page_cache_t::page_for_block_id(block_id_t block_id) {
     assert_thread();
@@ -341,6 +487,51 @@ current_page_t *page_cache_t::page_for_block_id(block_id_t block_id) {
     return current_pages_[block_id];
 }
 
+void page_cache_t::prefetch_blocks(const std::vector<block_id_t> &block_ids,
+                                   cache_account_t *account) {
+    assert_thread();
+    ASSERT_NO_CORO_WAITING;
+    for (auto it = block_ids.begin(); it != block_ids.end(); ++it) {
+        const block_id_t block_id = *it;
+        if (recency_for_block_id(block_id) == repli_timestamp_t::invalid) {
+            continue;
+        }
+        current_page_t *current_page = current_pages_.get_sparsely(block_id);
+        if (current_page != NULL && current_page->is_deleted()) {
+            continue;
+        }
+        // If the page is already loaded or loading, this does nothing.  Otherwise
+        // it spawns the load, just like a read acquirer would.
+        page_for_block_id(block_id)->convert_from_serializer_if_necessary(
+                current_page_help_t(block_id, this), account);
+    }
+}
+
+const void *page_cache_t::peek_page(block_id_t block_id, uint64_t *version_out) {
+    assert_thread();
+    if (block_id >= current_pages_.size()) {
+        return NULL;
+    }
+    current_page_t *current_page = current_pages_.get_sparsely(block_id);
+    if (current_page == NULL || current_page->is_deleted()
+        || !current_page->page_.has()) {
+        return NULL;
+    }
+    page_t *page = current_page->page_.get_page_for_read();
+    if (!page->is_loaded()) {
+        return NULL;
+    }
+    *version_out = current_page->peek_version_;
+    return page->get_page_buf(this);
+}
+
+bool page_cache_t::peeked_page_is_unchanged(block_id_t block_id, uint64_t version) {
+    assert_thread();
+    uint64_t current_version;
+    return peek_page(block_id, &current_version) != NULL
+        && current_version == version;
+}
+
 current_page_t *page_cache_t::page_for_new_block_id(block_id_t *block_id_out) {
     assert_thread();
     block_id_t block_id = free_list_.acquire_block_id();
@@ -490,6 +681,9 @@ current_page_acq_t::~current_page_acq_t() {
     if (page_cache_ != NULL) {
         if (the_txn_ != NULL) {
             guarantee(access_ == access_t::write);
+            if (dirtied_page_) {
+                current_page_->end_modification();
+            }
             the_txn_->remove_acquirer(this);
         }
         rassert(current_page_ != NULL);
@@ -577,7 +771,10 @@ page_t *current_page_acq_t::current_page_for_write(cache_account_t *account) {
     rassert(current_page_ != NULL);
     write_cond_.wait();
     rassert(current_page_ != NULL);
-    dirtied_page_ = true;
+    if (!dirtied_page_) {
+        dirtied_page_ = true;
+        current_page_->begin_modification();
+    }
     return current_page_->the_page_for_write(help(), account);
 }
 
@@ -596,7 +793,10 @@ void current_page_acq_t::mark_deleted() {
     rassert(current_page_ != NULL);
     write_cond_.wait();
     rassert(current_page_ != NULL);
-    dirtied_page_ = true;
+    if (!dirtied_page_) {
+        dirtied_page_ = true;
+        current_page_->begin_modification();
+    }
     current_page_->mark_deleted(help());
     // No need to call consider_evicting_current_page here -- there's a
     // current_page_acq_t for it: ourselves.
@@ -637,7 +837,8 @@ current_page_t::current_page_t(block_id_t block_id)
     : block_id_(block_id),
       is_deleted_(false),
       last_write_acquirer_(NULL),
-      num_keepalives_(0) {
+      num_keepalives_(0),
+      peek_version_(0) {
     // Increment the block version so that we can distinguish between unassigned
     // current_page_acq_t::block_version_ values (which are 0) and assigned ones.
     rassert(last_write_acquirer_version_.debug_value() == 0);
@@ -651,7 +852,8 @@ current_page_t::current_page_t(block_id_t block_id,
       page_(new page_t(block_id, std::move(buf), page_cache)),
       is_deleted_(false),
       last_write_acquirer_(NULL),
-      num_keepalives_(0) {
+      num_keepalives_(0),
+      peek_version_(0) {
     // Increment the block version so that we can distinguish between unassigned
     // current_page_acq_t::block_version_ values (which are 0) and assigned ones.
     rassert(last_write_acquirer_version_.debug_value() == 0);
@@ -666,7 +868,8 @@ current_page_t::current_page_t(block_id_t block_id,
       page_(new page_t(block_id, std::move(buf), token, page_cache)),
       is_deleted_(false),
       last_write_acquirer_(NULL),
-      num_keepalives_(0) {
+      num_keepalives_(0),
+      peek_version_(0) {
     // Increment the block version so that we can distinguish between unassigned
     // current_page_acq_t::block_version_ values (which are 0) and assigned ones.
     rassert(last_write_acquirer_version_.debug_value() == 0);
@@ -848,6 +1051,16 @@ void current_page_t::pulse_pulsables(current_page_acq_t *const acq) {
     }
 }
 
+void current_page_t::begin_modification() {
+    rassert(peek_version_ % 2 == 0);
+    ++peek_version_;
+}
+
+void current_page_t::end_modification() {
+    rassert(peek_version_ % 2 == 1);
+    ++peek_version_;
+}
+
 void current_page_t::add_keepalive() {
     ++num_keepalives_;
 }
@@ -868,6 +1081,7 @@ void current_page_t::mark_deleted(current_page_help_t help) {
 
     help.page_cache->set_recency_for_block_id(help.block_id,
                                               repli_timestamp_t::invalid);
+    help.page_cache->evicter().forget_compressed_block(help.block_id);
     page_.reset_page_ptr(help.page_cache);
     // It's the caller's responsibility to call consider_evicting_current_page after
     // we return, if that would make sense (it wouldn't though).
@@ -1044,6 +1258,7 @@ page_cache_t::compute_changes(const std::vector<page_txn_t *> &txns) {
     // The map of changes we make.
     std::map<block_id_t, block_change_t> changes;
 
+    size_t dirtied_order = 0;
     for (auto it = txns.begin(); it != txns.end(); ++it) {
         page_txn_t *txn = *it;
         for (size_t i = 0, e = txn->snapshotted_dirtied_pages_.size(); i < e; ++i) {
@@ -1051,7 +1266,9 @@ page_cache_t::compute_changes(const std::vector<page_txn_t *> &txns) {
 
             block_change_t change(d.block_version, true,
                                   d.ptr.has() ? d.ptr.get_page_for_read() : NULL,
-                                  d.ptr.has() ? d.ptr.timestamp() : repli_timestamp_t::invalid);
+                                  d.ptr.has() ? d.ptr.timestamp() : repli_timestamp_t::invalid,
+                                  dirtied_order);
+            ++dirtied_order;
 
             auto res = changes.insert(std::make_pair(d.block_id, change));
 
@@ -1064,6 +1281,7 @@ page_cache_t::compute_changes(const std::vector<page_txn_t *> &txns) {
                         d.block_id,
                         change.version.debug_value());
                 if (jt->second.version < change.version) {
+                    change.dirtied_order = jt->second.dirtied_order;
                     jt->second = change;
                 }
             }
@@ -1079,7 +1297,8 @@ page_cache_t::compute_changes(const std::vector<page_txn_t *> &txns) {
                                                      block_change_t(t.block_version,
                                                                     false,
                                                                     NULL,
-                                                                    t.tstamp)));
+                                                                    t.tstamp,
+                                                                    0)));
             if (!res.second) {
                 // The insertion failed.  We need to combine the versions.
                 auto const jt = res.first;
@@ -1196,6 +1415,12 @@ void page_cache_t::do_flush_changes(page_cache_t *page_cache,
     {
         ASSERT_NO_CORO_WAITING;
 
+        // The blocks to write, which get written in the order they were dirtied
+        // rather than by block id.  That way blocks that were written one after
+        // another, like the leaves that a compaction rewrites in key order, end up
+        // next to each other on disk.
+        std::vector<std::map<block_id_t, block_change_t>::const_iterator> to_write;
+
         for (auto it = changes.begin(); it != changes.end(); ++it) {
             if (it->second.modified) {
                 if (it->second.page == NULL) {
@@ -1227,14 +1452,7 @@ void page_cache_t::do_flush_changes(page_cache_t *page_cache,
 
                         rassert(page->is_loaded());
 
-                        // KSI: Is there a page_acq_t for this buf we're writing?  Is it
-                        // possible that we might be trying to do an unbacked eviction
-                        // for this page right now?  (No, we don't do that yet.)
-                        write_infos.push_back(buf_write_info_t(page->get_loaded_ser_buffer(),
-                                                               page->get_page_buf_size(),
-                                                               it->first));
-                        ancillary_infos.push_back(ancillary_info_t(it->second.tstamp,
-                                                                   page));
+                        to_write.push_back(it);
                     }
                 }
             } else {
@@ -1246,6 +1464,22 @@ void page_cache_t::do_flush_changes(page_cache_t *page_cache,
                                                                 NULL));
             }
         }
+
+        std::sort(to_write.begin(), to_write.end(),
+                  [](const std::map<block_id_t, block_change_t>::const_iterator &a,
+                     const std::map<block_id_t, block_change_t>::const_iterator &b) {
+                      return a->second.dirtied_order < b->second.dirtied_order;
+                  });
+        for (const auto &it : to_write) {
+            page_t *page = it->second.page;
+            // KSI: Is there a page_acq_t for this buf we're writing?  Is it
+            // possible that we might be trying to do an unbacked eviction
+            // for this page right now?  (No, we don't do that yet.)
+            write_infos.push_back(buf_write_info_t(page->get_loaded_ser_buffer(),
+                                                   page->get_page_buf_size(),
+                                                   it->first));
+            ancillary_infos.push_back(ancillary_info_t(it->second.tstamp, page));
+        }
     }
 
     {
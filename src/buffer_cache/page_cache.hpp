@@ -30,6 +30,7 @@ class cache_balancer_t;
 class auto_drainer_t;
 class cache_t;
 class file_account_t;
+class repeating_timer_t;
 
 namespace alt {
 class current_page_acq_t;
@@ -100,6 +101,8 @@ private:
     void pulse_pulsables(current_page_acq_t *acq);
     void add_keepalive();
     void remove_keepalive();
+    void begin_modification();
+    void end_modification();
 
     page_t *the_page_for_write(current_page_help_t help, cache_account_t *account);
     page_t *the_page_for_read(current_page_help_t help, cache_account_t *account);
@@ -159,6 +162,12 @@ private:
     // would be evicted that would mess with the block version.
     intptr_t num_keepalives_;
 
+    // Incremented when a write acquirer starts modifying the page and when it
+    // releases the page afterwards, so it's odd while the page (and maybe its
+    // neighbors in the btree) could be in an intermediate state.  Used to
+    // validate `page_cache_t::peek_page`.
+    uint64_t peek_version_;
+
     DISABLE_COPYING(current_page_t);
 };
 
@@ -307,23 +316,59 @@ private:
 
 class page_cache_index_write_sink_t;
 
+// When a txn's flush begins.
+enum class flush_delay_t {
+    // Right away.
+    none,
+    // After up to the page cache's soft flush delay, so that the flush gets
+    // combined with later txns' flushes.
+    soft,
+    // Right away, and the delayed flushes of earlier txns, which this txn might
+    // have to be flushed after, begin right away too.
+    urgent
+};
+
 class page_cache_t : public home_thread_mixin_t {
 public:
     page_cache_t(serializer_t *serializer,
                  cache_balancer_t *balancer,
-                 alt_txn_throttler_t *throttler);
+                 alt_txn_throttler_t *throttler,
+                 eviction_policy_t eviction_policy
+                     = eviction_policy_t::APPROXIMATE_LRU);
     ~page_cache_t();
 
     // Takes a txn to be flushed.  Calls on_flush_complete() (which resets the
     // throttler_acq parameter) when done.
     void flush_and_destroy_txn(
             scoped_ptr_t<page_txn_t> txn,
-            std::function<void(throttler_acq_t *)> on_flush_complete);
+            std::function<void(throttler_acq_t *)> on_flush_complete,
+            flush_delay_t flush_delay = flush_delay_t::none);
+
+    // Sets how long the flushes of txns passed with flush_delay_t::soft wait for
+    // other txns' flushes to join them.  A block that several of the txns change is
+    // then written once instead of once per flush.
+    void set_soft_flush_delay(int64_t delay_ms);
 
     current_page_t *page_for_block_id(block_id_t block_id);
     current_page_t *page_for_new_block_id(block_id_t *block_id_out);
     current_page_t *page_for_new_chosen_block_id(block_id_t block_id);
 
+    // Starts loading the given blocks from the serializer (if they aren't in memory
+    // already) without acquiring them, so that a later acquisition doesn't have to
+    // wait for the disk.  Used for read-ahead during sequential btree scans.  Block
+    // ids that have been deleted are ignored.
+    void prefetch_blocks(const std::vector<block_id_t> &block_ids,
+                         cache_account_t *account);
+
+    // Returns the current contents of the block without acquiring it, so without
+    // waiting in line behind its write acquirers, or NULL if the block isn't in
+    // memory (or has been deleted).  The contents are only valid until the
+    // coroutine yields.  `*version_out` is set to the page's version, which is odd
+    // while a write acquirer that has modified the page still holds it.
+    const void *peek_page(block_id_t block_id, uint64_t *version_out);
+    // Returns true if the page hasn't changed since `peek_page` returned `version`.
+    bool peeked_page_is_unchanged(block_id_t block_id, uint64_t version);
+
     // Returns how much memory is being used by all the pages in the cache at this
     // moment in time.
     size_t total_page_memory() const;
@@ -366,8 +411,10 @@ private:
     // KSI: Maybe just have txn_t hold a single list of block_change_t objects.
     struct block_change_t {
         block_change_t(block_version_t _version, bool _modified,
-                       page_t *_page, repli_timestamp_t _tstamp)
-            : version(_version), modified(_modified), page(_page), tstamp(_tstamp) { }
+                       page_t *_page, repli_timestamp_t _tstamp,
+                       size_t _dirtied_order)
+            : version(_version), modified(_modified), page(_page), tstamp(_tstamp),
+              dirtied_order(_dirtied_order) { }
         block_version_t version;
 
         // True if the value of the block was modified (or the block was deleted), false
@@ -378,6 +425,9 @@ private:
         // snapshotted_dirtied_pages_ field.)
         page_t *page;
         repli_timestamp_t tstamp;
+        // Where the block was first dirtied among the flushed txns' dirtied pages,
+        // which is the order the flush writes the blocks in.
+        size_t dirtied_order;
     };
 
     friend class page_txn_t;
@@ -398,6 +448,11 @@ private:
 
     void im_waiting_for_flush(page_txn_t *txns);
 
+    // Begins the flushes of the txns in delayed_flush_txns_, together.
+    void end_flush_delay();
+    static void end_flush_delay_later(page_cache_t *page_cache,
+                                      auto_drainer_t::lock_t lock);
+
     friend class current_page_acq_t;
     repli_timestamp_t recency_for_block_id(block_id_t id) {
         return recencies_.size() <= id
@@ -420,6 +475,16 @@ private:
     static void consider_evicting_all_current_pages(page_cache_t *page_cache,
                                                     auto_drainer_t::lock_t lock);
 
+    // Tells the serializer which loaded blocks were accessed most recently, so that
+    // after a restart we can warm up with them.
+    static void report_hot_blocks(page_cache_t *page_cache,
+                                  auto_drainer_t::lock_t lock);
+    // Reads the blocks the serializer reported as hot when it started and adds them
+    // the way read-ahead does, until read-ahead stops.
+    static void warm_up_hot_blocks(page_cache_t *page_cache,
+                                   const std::vector<block_id_t> &block_ids,
+                                   auto_drainer_t::lock_t lock);
+
     const max_block_size_t max_block_size_;
 
     // We use a separate I/O account for reads in each page cache.
@@ -451,6 +516,14 @@ private:
     // destroyed and all possible read-ahead operations have completed.
     auto_drainer_t::lock_t read_ahead_cb_existence_;
 
+    scoped_ptr_t<repeating_timer_t> hot_block_timer_;
+
+    int64_t soft_flush_delay_ms_;
+    // Txns whose flushes are being delayed, oldest first.  None of them has begun
+    // waiting for its flush.
+    std::vector<page_txn_t *> delayed_flush_txns_;
+    bool flush_delay_ending_scheduled_;
+
     scoped_ptr_t<auto_drainer_t> drainer_;
 
     DISABLE_COPYING(page_cache_t);
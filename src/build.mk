@@ -206,7 +206,7 @@ ifeq ($(SERIALIZER_DEBUG),1)
 endif
 
 ifeq ($(LEGACY_LINUX),1)
-  RT_CXXFLAGS += -DLEGACY_LINUX -DNO_EPOLL -Wno-format
+  RT_CXXFLAGS += -DLEGACY_LINUX -DNO_EPOLL -DNO_IO_URING -Wno-format
 endif
 
 ifeq ($(LEGACY_GCC),1)
@@ -221,6 +221,10 @@ ifeq ($(NO_EPOLL),1)
   RT_CXXFLAGS += -DNO_EPOLL
 endif
 
+ifeq ($(NO_IO_URING),1)
+  RT_CXXFLAGS += -DNO_IO_URING
+endif
+
 ifeq ($(THREADED_COROUTINES),1)
   RT_CXXFLAGS += -DTHREADED_COROUTINES
 endif
@@ -258,7 +262,7 @@ RT_CXXFLAGS += -I$(PROTO_DIR)
 
 SOURCES := $(shell find $(SOURCE_DIR) -name '*.cc' -not -name '\.*')
 
-SERVER_EXEC_SOURCES := $(filter-out $(SOURCE_DIR)/unittest/%,$(SOURCES))
+SERVER_EXEC_SOURCES := $(filter-out $(SOURCE_DIR)/unittest/% $(SOURCE_DIR)/bench/% $(SOURCE_DIR)/microbench/%,$(SOURCES))
 
 QL2_PROTO_NAMES := rdb_protocol/ql2 rdb_protocol/ql2_extensions
 QL2_PROTO_SOURCES := $(foreach _,$(QL2_PROTO_NAMES),$(SOURCE_DIR)/$_.proto)
@@ -282,10 +286,14 @@ OBJS := $(QL2_PROTO_OBJS) $(patsubst %,$(OBJ_DIR)/%.o,$(NAMES))
 
 SERVER_EXEC_OBJS := $(OBJ_DIR)/web_assets/web_assets.o $(QL2_PROTO_OBJS) $(patsubst $(SOURCE_DIR)/%.cc,$(OBJ_DIR)/%.o,$(SERVER_EXEC_SOURCES))
 
-SERVER_NOMAIN_OBJS := $(OBJ_DIR)/web_assets/web_assets.o $(QL2_PROTO_OBJS) $(patsubst $(SOURCE_DIR)/%.cc,$(OBJ_DIR)/%.o,$(filter-out %/main.cc,$(SOURCES)))
+SERVER_NOMAIN_OBJS := $(OBJ_DIR)/web_assets/web_assets.o $(QL2_PROTO_OBJS) $(patsubst $(SOURCE_DIR)/%.cc,$(OBJ_DIR)/%.o,$(filter-out %/main.cc $(SOURCE_DIR)/bench/% $(SOURCE_DIR)/microbench/%,$(SOURCES)))
 
 SERVER_UNIT_TEST_OBJS := $(SERVER_NOMAIN_OBJS) $(OBJ_DIR)/unittest/main.o
 
+SERVER_BENCH_OBJS := $(filter-out $(OBJ_DIR)/unittest/%,$(SERVER_NOMAIN_OBJS)) $(patsubst $(SOURCE_DIR)/%.cc,$(OBJ_DIR)/%.o,$(filter $(SOURCE_DIR)/bench/%,$(SOURCES)))
+
+SERVER_MICROBENCH_OBJS := $(filter-out $(OBJ_DIR)/unittest/%,$(SERVER_NOMAIN_OBJS)) $(patsubst $(SOURCE_DIR)/%.cc,$(OBJ_DIR)/%.o,$(filter $(SOURCE_DIR)/microbench/%,$(SOURCES)))
+
 ##### Version number handling
 
 RT_CXXFLAGS += -DRETHINKDB_VERSION=\"$(RETHINKDB_VERSION)\"
@@ -306,6 +314,16 @@ unit: $(BUILD_DIR)/$(SERVER_UNIT_TEST_NAME)
 	$P RUN $(SERVER_UNIT_TEST_NAME)
 	$(BUILD_DIR)/$(SERVER_UNIT_TEST_NAME) --gtest_filter=$(UNIT_TEST_FILTER)
 
+.PHONY: bench
+bench: $(BUILD_DIR)/$(SERVER_BENCH_NAME)
+	$P RUN $(SERVER_BENCH_NAME)
+	$(BUILD_DIR)/$(SERVER_BENCH_NAME) $(BENCH_FLAGS)
+
+.PHONY: microbench
+microbench: $(BUILD_DIR)/$(SERVER_MICROBENCH_NAME)
+	$P RUN $(SERVER_MICROBENCH_NAME)
+	$(BUILD_DIR)/$(SERVER_MICROBENCH_NAME) $(MICROBENCH_FLAGS)
+
 .PRECIOUS: $(PROTO_DIR)/. $(QL2_PROTO_HEADERS) $(QL2_PROTO_CODE)
 
 $(PROTO_DIR)/%.pb.h $(PROTO_DIR)/%.pb.cc: $(SOURCE_DIR)/%.proto $(PROTOC_BIN_DEP) | $(PROTO_DIR)/.
@@ -374,6 +392,14 @@ $(BUILD_DIR)/$(SERVER_UNIT_TEST_NAME): $(SERVER_UNIT_TEST_OBJS) $(GTEST_LIBS_DEP
 	$P LD $@
 	$(RT_CXX) $(SERVER_UNIT_TEST_OBJS) $(RT_LDFLAGS) $(GTEST_LIBS) -o $@ $(LD_OUTPUT_FILTER)
 
+$(BUILD_DIR)/$(SERVER_BENCH_NAME): $(SERVER_BENCH_OBJS) | $(BUILD_DIR)/. $(RETHINKDB_DEPENDENCIES_LIBS)
+	$P LD $@
+	$(RT_CXX) $(SERVER_BENCH_OBJS) $(RT_LDFLAGS) -o $@ $(LD_OUTPUT_FILTER)
+
+$(BUILD_DIR)/$(SERVER_MICROBENCH_NAME): $(SERVER_MICROBENCH_OBJS) | $(BUILD_DIR)/. $(RETHINKDB_DEPENDENCIES_LIBS)
+	$P LD $@
+	$(RT_CXX) $(SERVER_MICROBENCH_OBJS) $(RT_LDFLAGS) -o $@ $(LD_OUTPUT_FILTER)
+
 $(BUILD_DIR)/$(GDB_FUNCTIONS_NAME): | $(BUILD_DIR)/.
 	$P CP $@
 	cp $(SCRIPTS_DIR)/$(GDB_FUNCTIONS_NAME) $@
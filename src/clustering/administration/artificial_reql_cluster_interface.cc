@@ -63,15 +63,15 @@ bool artificial_reql_cluster_interface_t::db_config(
 bool artificial_reql_cluster_interface_t::table_create(
         const name_string_t &name, counted_t<const ql::db_t> db,
         const table_generate_config_params_t &config_params,
-        const std::string &primary_key, signal_t *interruptor,
-        ql::datum_t *result_out, std::string *error_out) {
+        const std::string &primary_key, uint32_t block_size, bool compress_blocks,
+        signal_t *interruptor, ql::datum_t *result_out, std::string *error_out) {
     if (db->name == database) {
         *error_out = strprintf("Database `%s` is special; you can't create new tables "
             "in it.", database.c_str());
         return false;
     }
-    return next->table_create(name, db, config_params, primary_key,
-        interruptor, result_out, error_out);
+    return next->table_create(name, db, config_params, primary_key, block_size,
+        compress_blocks, interruptor, result_out, error_out);
 }
 
 bool artificial_reql_cluster_interface_t::table_drop(const name_string_t &name,
@@ -379,6 +379,16 @@ admin_artificial_tables_t::admin_artificial_tables_t(
     backends[name_string_t::guarantee_valid("jobs")] =
         std::make_pair(jobs_backend[0].get(), jobs_backend[1].get());
 
+    for (int i = 0; i < 2; ++i) {
+        slow_queries_backend[i].init(new slow_queries_artificial_table_backend_t(
+            _mailbox_manager,
+            _directory_view,
+            _server_config_client,
+            static_cast<admin_identifier_format_t>(i)));
+    }
+    backends[name_string_t::guarantee_valid("slow_queries")] =
+        std::make_pair(slow_queries_backend[0].get(), slow_queries_backend[1].get());
+
     debug_scratch_backend.init(new in_memory_artificial_table_backend_t);
     backends[name_string_t::guarantee_valid("_debug_scratch")] =
         std::make_pair(debug_scratch_backend.get(), debug_scratch_backend.get());
@@ -19,6 +19,7 @@
 #include "clustering/administration/issues/issues_backend.hpp"
 #include "clustering/administration/logs/logs_backend.hpp"
 #include "clustering/administration/jobs/backend.hpp"
+#include "clustering/administration/jobs/slow_queries_backend.hpp"
 #include "containers/name_string.hpp"
 #include "rdb_protocol/artificial_table/backend.hpp"
 #include "rdb_protocol/artificial_table/in_memory.hpp"
@@ -68,8 +69,8 @@ public:
 
     bool table_create(const name_string_t &name, counted_t<const ql::db_t> db,
             const table_generate_config_params_t &config_params,
-            const std::string &primary_key, signal_t *interruptor,
-            ql::datum_t *result_out, std::string *error_out);
+            const std::string &primary_key, uint32_t block_size, bool compress_blocks,
+            signal_t *interruptor, ql::datum_t *result_out, std::string *error_out);
     bool table_drop(const name_string_t &name, counted_t<const ql::db_t> db,
             signal_t *interruptor, ql::datum_t *result_out, std::string *error_out);
     bool table_list(counted_t<const ql::db_t> db,
@@ -196,6 +197,7 @@ public:
 
     scoped_ptr_t<artificial_reql_cluster_interface_t> reql_cluster_interface;
     scoped_ptr_t<jobs_artificial_table_backend_t> jobs_backend[2];
+    scoped_ptr_t<slow_queries_artificial_table_backend_t> slow_queries_backend[2];
 };
 
 #endif /* CLUSTERING_ADMINISTRATION_ARTIFICIAL_REQL_CLUSTER_INTERFACE_HPP_ */
@@ -0,0 +1,162 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/administration/http/metrics_app.hpp"
+
+#include <map>
+#include <vector>
+
+#include "containers/uuid.hpp"
+#include "perfmon/collect.hpp"
+#include "stl_utils.hpp"
+#include "utils.hpp"
+
+namespace {
+
+struct metric_family_t {
+    metric_family_t() : is_summary(false) { }
+    bool is_summary;
+    // Each line of the family, without the family's name.
+    std::vector<std::string> samples;
+};
+
+typedef std::map<std::string, metric_family_t> metric_families_t;
+
+std::string sanitize_metric_name(const std::string &name) {
+    std::string res = name;
+    for (char &c : res) {
+        if (!isalnum(c) && c != '_') {
+            c = '_';
+        }
+    }
+    return res;
+}
+
+std::string format_labels(const std::string &labels, const std::string &extra) {
+    std::string all = labels.empty() || extra.empty() ? labels + extra
+                                                        : labels + "," + extra;
+    return all.empty() ? all : "{" + all + "}";
+}
+
+void add_sample(const std::string &suffix, const std::string &labels,
+                const std::string &extra_label, double value,
+                metric_family_t *family) {
+    family->samples.push_back(
+        strprintf("%s%s %.17g", suffix.c_str(),
+                  format_labels(labels, extra_label).c_str(), value));
+}
+
+// Latency histograms come out of `perfmon_latency_histogram_t` with these fields.
+bool is_latency_histogram(const ql::datum_t &stats) {
+    return stats.obj_size() == 5
+        && stats.get_field("count", ql::NOTHROW).has()
+        && stats.get_field("p50", ql::NOTHROW).has()
+        && stats.get_field("p99", ql::NOTHROW).has()
+        && stats.get_field("p999", ql::NOTHROW).has()
+        && stats.get_field("max", ql::NOTHROW).has();
+}
+
+void add_latency_histogram(const ql::datum_t &stats, const std::string &labels,
+                           metric_family_t *family) {
+    family->is_summary = true;
+    const std::pair<const char *, const char *> quantiles[] = {
+        { "p50", "quantile=\"0.5\"" },
+        { "p99", "quantile=\"0.99\"" },
+        { "p999", "quantile=\"0.999\"" },
+        { "max", "quantile=\"1\"" } };
+    for (const auto &quantile : quantiles) {
+        ql::datum_t value = stats.get_field(quantile.first);
+        // Percentiles are `null` while the histogram has no samples.
+        if (value.get_type() == ql::datum_t::R_NUM) {
+            add_sample("", labels, quantile.second, value.as_num(), family);
+        }
+    }
+    add_sample("_count", labels, "", stats.get_field("count").as_num(), family);
+}
+
+void collect_metrics(const ql::datum_t &stats,
+                     const std::string &name,
+                     const std::string &labels,
+                     size_t depth,
+                     metric_families_t *families_out) {
+    switch (stats.get_type()) {
+    case ql::datum_t::R_NUM:
+        add_sample("", labels, "", stats.as_num(), &(*families_out)[name]);
+        break;
+    case ql::datum_t::R_BOOL:
+        add_sample("", labels, "", stats.as_bool() ? 1 : 0, &(*families_out)[name]);
+        break;
+    case ql::datum_t::R_OBJECT: {
+        if (is_latency_histogram(stats)) {
+            add_latency_histogram(stats, labels, &(*families_out)[name]);
+            break;
+        }
+        for (size_t i = 0; i < stats.obj_size(); ++i) {
+            std::pair<datum_string_t, ql::datum_t> pair = stats.get_pair(i);
+            const std::string key = pair.first.to_std();
+            uuid_u id;
+            if (str_to_uuid(key, &id)) {
+                // Top-level collections named after a uuid are tables' stats.
+                const std::string label = strprintf(
+                    "%s=\"%s\"", depth == 0 ? "table" : "id", key.c_str());
+                collect_metrics(pair.second, name,
+                                labels.empty() ? label : labels + "," + label,
+                                depth + 1, families_out);
+            } else if (key.compare(0, 6, "shard_") == 0 && key.size() > 6
+                       && key.find_first_not_of("0123456789", 6) == std::string::npos) {
+                const std::string label = "shard=\"" + key.substr(6) + "\"";
+                collect_metrics(pair.second, name,
+                                labels.empty() ? label : labels + "," + label,
+                                depth + 1, families_out);
+            } else {
+                collect_metrics(pair.second, name + "_" + sanitize_metric_name(key),
+                                labels, depth + 1, families_out);
+            }
+        }
+    } break;
+    case ql::datum_t::R_NULL:   // fallthru
+    case ql::datum_t::R_STR:    // fallthru
+    case ql::datum_t::R_ARRAY:  // fallthru
+    case ql::datum_t::R_BINARY: // fallthru
+    case ql::datum_t::UNINITIALIZED:
+        // These aren't numbers, so there's nothing to export.
+        break;
+    default: unreachable();
+    }
+}
+
+}  // namespace
+
+std::string render_metrics(const ql::datum_t &stats, bool openmetrics) {
+    metric_families_t families;
+    collect_metrics(stats, "rethinkdb", "", 0, &families);
+
+    std::string res;
+    for (const auto &family : families) {
+        res += strprintf("# TYPE %s %s\n", family.first.c_str(),
+                         family.second.is_summary ? "summary" : "gauge");
+        for (const auto &sample : family.second.samples) {
+            res += family.first + sample + "\n";
+        }
+    }
+    if (openmetrics) {
+        res += "# EOF\n";
+    }
+    return res;
+}
+
+void metrics_http_app_t::handle(const http_req_t &req, http_res_t *result,
+                                UNUSED signal_t *interruptor) {
+    if (req.method != GET) {
+        *result = http_res_t(HTTP_METHOD_NOT_ALLOWED);
+        return;
+    }
+    boost::optional<std::string> accept = req.find_header_line("accept");
+    const bool openmetrics = static_cast<bool>(accept)
+        && accept->find("application/openmetrics-text") != std::string::npos;
+
+    *result = http_res_t(
+        HTTP_OK,
+        openmetrics
+            ? "application/openmetrics-text; version=1.0.0; charset=utf-8"
+            : "text/plain; version=0.0.4; charset=utf-8",
+        render_metrics(perfmon_get_stats(), openmetrics));
+}
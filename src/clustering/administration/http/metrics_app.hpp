@@ -0,0 +1,26 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_HTTP_METRICS_APP_HPP_
+#define CLUSTERING_ADMINISTRATION_HTTP_METRICS_APP_HPP_
+
+#include <string>
+
+#include "http/http.hpp"
+#include "rdb_protocol/datum.hpp"
+
+/* This is an `http_app_t` that serves the stats of the server processing the request
+in the Prometheus text format, or in OpenMetrics if the client accepts it. The stats
+come straight from the perfmons, so scraping them doesn't involve ReQL. */
+class metrics_http_app_t : public http_app_t {
+public:
+    metrics_http_app_t() { }
+private:
+    void handle(const http_req_t &req, http_res_t *result, signal_t *interruptor);
+
+    DISABLE_COPYING(metrics_http_app_t);
+};
+
+/* Renders the output of `perfmon_get_stats()` as metric families named after the
+stats' paths. Table ids and shard numbers in the paths become labels. */
+std::string render_metrics(const ql::datum_t &stats, bool openmetrics);
+
+#endif /* CLUSTERING_ADMINISTRATION_HTTP_METRICS_APP_HPP_ */
@@ -1,6 +1,7 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "clustering/administration/jobs/manager.hpp"
 
+#include <algorithm>
 #include <functional>
 #include <iterator>
 
@@ -8,9 +9,10 @@
 #include "concurrency/watchable.hpp"
 #include "rdb_protocol/context.hpp"
 
-RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(jobs_manager_business_card_t,
+RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(jobs_manager_business_card_t,
                                     get_job_reports_mailbox_address,
-                                    job_interrupt_mailbox_address);
+                                    job_interrupt_mailbox_address,
+                                    get_slow_queries_mailbox_address);
 
 const uuid_u jobs_manager_t::base_sindex_id =
     str_to_uuid("74d855a5-0c40-4930-a451-d1ce508ef2d2");
@@ -32,13 +34,18 @@ jobs_manager_t::jobs_manager_t(mailbox_manager_t *_mailbox_manager,
                                       this, ph::_1, ph::_2)),
     job_interrupt_mailbox(_mailbox_manager,
                           std::bind(&jobs_manager_t::on_job_interrupt,
-                                    this, ph::_1, ph::_2)) { }
+                                    this, ph::_1, ph::_2)),
+    get_slow_queries_mailbox(_mailbox_manager,
+                             std::bind(&jobs_manager_t::on_get_slow_queries,
+                                       this, ph::_1, ph::_2)) { }
 
 jobs_manager_business_card_t jobs_manager_t::get_business_card() {
     business_card_t business_card;
     business_card.get_job_reports_mailbox_address =
         get_job_reports_mailbox.get_address();
     business_card.job_interrupt_mailbox_address = job_interrupt_mailbox.get_address();
+    business_card.get_slow_queries_mailbox_address =
+        get_slow_queries_mailbox.get_address();
     return business_card;
 }
 
@@ -86,11 +93,14 @@ void jobs_manager_t::on_get_job_reports(
             if (rdb_context != nullptr) {
                 for (auto const &query
                         : *rdb_context->get_query_jobs_for_this_thread()) {
+                    const query_resources_t *resources = query.second.resources;
                     job_reports_inner.emplace_back(
                         query.first,
                         "query",
                         time - std::min(query.second.start_time, time),
-                        query.second.client_addr_port);
+                        query.second.client_addr_port,
+                        resources->run_ticks.load() / static_cast<double>(THOUSAND),
+                        static_cast<double>(resources->rows_read.load()));
                 }
             }
         }
@@ -121,6 +131,19 @@ void jobs_manager_t::on_get_job_reports(
             job_reports.emplace_back(id, "disk_compaction", -1);
         }
 
+        // Unlike the serializer's GC, the stores' compactions belong to a table.
+        for (auto const &compaction_job : reactor_driver->get_compaction_jobs()) {
+            uuid_u id = uuid_u::from_hash(
+                base_disk_compaction_id,
+                uuid_to_str(server_id) + uuid_to_str(compaction_job.first));
+
+            job_reports.emplace_back(
+                id,
+                "disk_compaction",
+                time - std::min(compaction_job.second, time),
+                compaction_job.first);
+        }
+
         for (auto const &report : reactor_driver->get_backfill_progress()) {
             // Only report the duration of backfills still in progress.
             double duration = report.second.is_ready
@@ -171,3 +194,47 @@ void jobs_manager_t::on_job_interrupt(
         }
     });
 }
+
+void jobs_manager_t::on_get_slow_queries(
+        UNUSED signal_t *interruptor,
+        business_card_t::slow_queries_return_mailbox_t::address_t const &reply_address) {
+    std::vector<slow_query_t> slow_queries;
+
+    if (drainer.is_draining()) {
+        send(mailbox_manager, reply_address, slow_queries);
+        return;
+    }
+
+    auto lock = drainer.lock();
+
+    pmap(get_num_threads(), [&](int32_t threadnum) {
+        std::vector<slow_query_t> slow_queries_inner;
+        {
+            on_thread_t thread((threadnum_t(threadnum)));
+
+            if (rdb_context != nullptr) {
+                rdb_context_t::slow_queries_t const &history =
+                    rdb_context->get_slow_queries_for_this_thread();
+                slow_queries_inner.assign(history.begin(), history.end());
+            }
+        }
+        slow_queries.insert(slow_queries.end(),
+                            std::make_move_iterator(slow_queries_inner.begin()),
+                            std::make_move_iterator(slow_queries_inner.end()));
+    });
+
+    // Each thread keeps its own last `SLOW_QUERY_HISTORY_SIZE`, we only report the
+    // server's.
+    if (slow_queries.size() > SLOW_QUERY_HISTORY_SIZE) {
+        std::nth_element(
+            slow_queries.begin(),
+            slow_queries.begin() + SLOW_QUERY_HISTORY_SIZE,
+            slow_queries.end(),
+            [](slow_query_t const &a, slow_query_t const &b) {
+                return a.start_time > b.start_time;
+            });
+        slow_queries.resize(SLOW_QUERY_HISTORY_SIZE);
+    }
+
+    send(mailbox_manager, reply_address, slow_queries);
+}
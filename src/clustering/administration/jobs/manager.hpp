@@ -19,9 +19,13 @@ public:
     typedef mailbox_t<void(std::vector<job_report_t>)> return_mailbox_t;
     typedef mailbox_t<void(return_mailbox_t::address_t)> get_job_reports_mailbox_t;
     typedef mailbox_t<void(uuid_u)> job_interrupt_mailbox_t;
+    typedef mailbox_t<void(std::vector<slow_query_t>)> slow_queries_return_mailbox_t;
+    typedef mailbox_t<void(slow_queries_return_mailbox_t::address_t)>
+        get_slow_queries_mailbox_t;
 
     get_job_reports_mailbox_t::address_t get_job_reports_mailbox_address;
     job_interrupt_mailbox_t::address_t job_interrupt_mailbox_address;
+    get_slow_queries_mailbox_t::address_t get_slow_queries_mailbox_address;
 };
 RDB_DECLARE_SERIALIZABLE(jobs_manager_business_card_t);
 
@@ -56,6 +60,10 @@ private:
 
     void on_job_interrupt(UNUSED signal_t *interruptor, uuid_u const &id);
 
+    void on_get_slow_queries(
+        UNUSED signal_t *interruptor,
+        business_card_t::slow_queries_return_mailbox_t::address_t const &reply_address);
+
     mailbox_manager_t *mailbox_manager;
 
     server_id_t server_id;
@@ -67,6 +75,7 @@ private:
 
     business_card_t::get_job_reports_mailbox_t get_job_reports_mailbox;
     business_card_t::job_interrupt_mailbox_t job_interrupt_mailbox;
+    business_card_t::get_slow_queries_mailbox_t get_slow_queries_mailbox;
 
     DISABLE_COPYING(jobs_manager_t);
 };
@@ -2,6 +2,7 @@
 #include "clustering/administration/jobs/report.hpp"
 
 #include "clustering/administration/servers/config_client.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
 
 bool convert_job_type_and_id_from_datum(ql::datum_t primary_key,
                                         std::string *type_out,
@@ -27,11 +28,15 @@ job_report_t::job_report_t(
         uuid_u const &_id,
         std::string const &_type,
         double _duration,
-        ip_and_port_t const &_client_addr_port)
+        ip_and_port_t const &_client_addr_port,
+        double _cpu_time,
+        double _rows_read)
     : id(_id),
       type(_type),
       duration(_duration),
       client_addr_port(_client_addr_port),
+      cpu_time(_cpu_time),
+      rows_read(_rows_read),
       table(nil_uuid()),
       is_ready(false),
       progress_numerator(0.0),
@@ -50,6 +55,8 @@ job_report_t::job_report_t(
     : id(_id),
       type(_type),
       duration(_duration),
+      cpu_time(0.0),
+      rows_read(0.0),
       table(_table),
       is_ready(_is_ready),
       progress_numerator(progress),
@@ -66,6 +73,8 @@ job_report_t::job_report_t(
     : id(_id),
       type(_type),
       duration(_duration),
+      cpu_time(0.0),
+      rows_read(0.0),
       table(_table),
       index(_index),
       is_ready(false),
@@ -120,6 +129,8 @@ bool job_report_t::to_datum(
             convert_string_to_datum(client_addr_port.ip().to_string()));
         info_builder.overwrite("client_port",
             convert_port_to_datum(client_addr_port.port().value()));
+        info_builder.overwrite("cpu_time_sec", ql::datum_t(cpu_time / 1e6));
+        info_builder.overwrite("rows_read", ql::datum_t(rows_read));
     } else if (type == "backfill") {
         info_builder.overwrite("progress",
             ql::datum_t(progress_numerator / progress_denominator));
@@ -179,12 +190,14 @@ bool job_report_t::to_datum(
 
     return true;
 }
-RDB_IMPL_SERIALIZABLE_12_FOR_CLUSTER(
+RDB_IMPL_SERIALIZABLE_14_FOR_CLUSTER(
     job_report_t,
     type,
     id,
     duration,
     client_addr_port,
+    cpu_time,
+    rows_read,
     table,
     index,
     is_ready,
@@ -194,10 +207,77 @@ RDB_IMPL_SERIALIZABLE_12_FOR_CLUSTER(
     destination_server,
     servers);
 
+slow_query_t::slow_query_t() {
+}
+
+slow_query_t::slow_query_t(
+        uuid_u const &_id,
+        microtime_t _start_time,
+        double _duration,
+        ip_and_port_t const &_client_addr_port,
+        double _cpu_time,
+        double _rows_read,
+        std::string const &_query,
+        ql::datum_t const &_profile)
+    : id(_id),
+      start_time(_start_time),
+      duration(_duration),
+      cpu_time(_cpu_time),
+      rows_read(_rows_read),
+      client_addr_port(_client_addr_port),
+      query(_query),
+      profile(_profile),
+      server(nil_uuid()) { }
+
+bool slow_query_t::to_datum(
+        admin_identifier_format_t identifier_format,
+        server_config_client_t *server_config_client,
+        ql::datum_t *row_out) const {
+    ql::datum_t server_name_or_uuid;
+    if (!convert_server_id_to_datum(
+            server,
+            identifier_format,
+            server_config_client,
+            &server_name_or_uuid,
+            nullptr)) {
+        return false;
+    }
+
+    ql::datum_object_builder_t builder;
+    builder.overwrite("id", convert_uuid_to_datum(id));
+    builder.overwrite("server", server_name_or_uuid);
+    builder.overwrite("start_time",
+        ql::pseudo::make_time(start_time / 1e6, "+00:00"));
+    builder.overwrite("duration_sec", ql::datum_t(duration / 1e6));
+    builder.overwrite("cpu_time_sec", ql::datum_t(cpu_time / 1e6));
+    builder.overwrite("rows_read", ql::datum_t(rows_read));
+    builder.overwrite("client_address",
+        convert_string_to_datum(client_addr_port.ip().to_string()));
+    builder.overwrite("client_port",
+        convert_port_to_datum(client_addr_port.port().value()));
+    builder.overwrite("query", convert_string_to_datum(query));
+    builder.overwrite("profile", profile.has() ? profile : ql::datum_t::null());
+    *row_out = std::move(builder).to_datum();
+
+    return true;
+}
+RDB_IMPL_SERIALIZABLE_8_FOR_CLUSTER(
+    slow_query_t,
+    id,
+    start_time,
+    duration,
+    cpu_time,
+    rows_read,
+    client_addr_port,
+    query,
+    profile);
+
 query_job_t::query_job_t(
         microtime_t _start_time,
         ip_and_port_t const &_client_addr_port,
+        query_resources_t *_resources,
         cond_t *_interruptor)
     : start_time(_start_time),
       client_addr_port(_client_addr_port),
+      resources(_resources),
       interruptor(_interruptor) { }
@@ -2,6 +2,7 @@
 #ifndef CLUSTERING_ADMINISTRATION_JOBS_REPORT_HPP_
 #define CLUSTERING_ADMINISTRATION_JOBS_REPORT_HPP_
 
+#include <atomic>
 #include <string>
 
 #include "arch/address.hpp"
@@ -25,11 +26,14 @@ public:
     job_report_t();
 
     // For `"query"` jobs, taking a `ip_and_port_t` of the client issuing the query
+    // and what the query has used so far
     job_report_t(
             uuid_u const &id,
             std::string const &type,
             double duration,
-            ip_and_port_t const &client_addr_port);
+            ip_and_port_t const &client_addr_port,
+            double cpu_time,
+            double rows_read);
 
     // For `"backfill"` jobs, taking extra variables for progress, source, and
     // destination servers
@@ -61,6 +65,8 @@ public:
     std::string type;
     double duration;
     ip_and_port_t client_addr_port;
+    // Only for queries; `cpu_time` is in microseconds, like `duration`.
+    double cpu_time, rows_read;
     namespace_id_t table;
     std::string index;
     bool is_ready;
@@ -74,15 +80,68 @@ public:
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(job_report_t);
 
+/* What a query has used so far. The counters are updated on whichever thread the
+query happens to be running. */
+class query_resources_t {
+public:
+    query_resources_t() : run_ticks(0), rows_read(0) { }
+
+    // The time the query's coroutine spent running, as opposed to waiting for
+    // reads, writes or the client. This is as close as we get to its CPU time.
+    std::atomic<ticks_t> run_ticks;
+    // The rows that the query's table reads returned to it.
+    std::atomic<uint64_t> rows_read;
+
+private:
+    DISABLE_COPYING(query_resources_t);
+};
+
+/* A query that took at least the server's `--slow-query-threshold`, as reported in
+`rethinkdb.slow_queries`. */
+class slow_query_t {
+public:
+    slow_query_t();
+    slow_query_t(
+            uuid_u const &id,
+            microtime_t start_time,
+            double duration,
+            ip_and_port_t const &client_addr_port,
+            double cpu_time,
+            double rows_read,
+            std::string const &query,
+            ql::datum_t const &profile);
+
+    bool to_datum(
+            admin_identifier_format_t identifier_format,
+            server_config_client_t *server_config_client,
+            ql::datum_t *row_out) const;
+
+    uuid_u id;
+    microtime_t start_time;
+    // `duration` and `cpu_time` are in microseconds.
+    double duration, cpu_time, rows_read;
+    ip_and_port_t client_addr_port;
+    // A compact rendering of the term tree, cut off if it's very large.
+    std::string query;
+    // Empty unless the query was profiled.
+    ql::datum_t profile;
+
+    // Not serialized, `backend.cc` fills it in from the server that sent the report.
+    server_id_t server;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(slow_query_t);
+
 class query_job_t {
 public:
     query_job_t(
             microtime_t _start_time,
             ip_and_port_t const &_client_addr_port,
+            query_resources_t *_resources,
             cond_t *interruptor);
 
     microtime_t start_time;
     ip_and_port_t client_addr_port;
+    query_resources_t *resources;
     cond_t *interruptor;
 };
 
@@ -0,0 +1,122 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/administration/jobs/slow_queries_backend.hpp"
+
+#include "clustering/administration/datum_adapter.hpp"
+#include "clustering/administration/jobs/manager.hpp"
+#include "clustering/administration/jobs/report.hpp"
+#include "concurrency/cross_thread_signal.hpp"
+
+slow_queries_artificial_table_backend_t::slow_queries_artificial_table_backend_t(
+        mailbox_manager_t *_mailbox_manager,
+        const clone_ptr_t<watchable_t<change_tracking_map_t<
+            peer_id_t, cluster_directory_metadata_t> > > &_directory_view,
+        server_config_client_t *_server_config_client,
+        admin_identifier_format_t _identifier_format)
+    : mailbox_manager(_mailbox_manager),
+      directory_view(_directory_view),
+      server_config_client(_server_config_client),
+      identifier_format(_identifier_format) {
+}
+
+slow_queries_artificial_table_backend_t::~slow_queries_artificial_table_backend_t() {
+    begin_changefeed_destruction();
+}
+
+std::string slow_queries_artificial_table_backend_t::get_primary_key_name() {
+    return "id";
+}
+
+void slow_queries_artificial_table_backend_t::get_all_slow_queries(
+        signal_t *interruptor,
+        std::vector<slow_query_t> *slow_queries_out) {
+    assert_thread();  // Accessing `directory_view`
+
+    typedef std::map<peer_id_t, cluster_directory_metadata_t> peers_t;
+    peers_t peers = directory_view->get().get_inner();
+    pmap(peers.begin(), peers.end(), [&](peers_t::value_type const &peer) {
+        cond_t returned_slow_queries;
+        disconnect_watcher_t disconnect_watcher(mailbox_manager, peer.first);
+
+        mailbox_t<void(std::vector<slow_query_t>)> return_mailbox(
+            mailbox_manager,
+            [&](UNUSED signal_t *, std::vector<slow_query_t> const &slow_queries) {
+                for (auto const &slow_query : slow_queries) {
+                    slow_queries_out->push_back(slow_query);
+                    slow_queries_out->back().server = peer.second.server_id;
+                }
+
+                returned_slow_queries.pulse();
+            });
+        send(mailbox_manager,
+             peer.second.jobs_mailbox.get_slow_queries_mailbox_address,
+             return_mailbox.get_address());
+
+        wait_any_t waiter(&returned_slow_queries, &disconnect_watcher, interruptor);
+        waiter.wait();
+    });
+
+    if (interruptor->is_pulsed()) {
+        throw interrupted_exc_t();
+    }
+}
+
+bool slow_queries_artificial_table_backend_t::read_all_rows_as_vector(
+        signal_t *interruptor,
+        std::vector<ql::datum_t> *rows_out,
+        UNUSED std::string *error_out) {
+    rows_out->clear();
+
+    cross_thread_signal_t ct_interruptor(interruptor, home_thread());
+    on_thread_t rethreader(home_thread());
+
+    std::vector<slow_query_t> slow_queries;
+    get_all_slow_queries(&ct_interruptor, &slow_queries);
+
+    for (auto const &slow_query : slow_queries) {
+        ql::datum_t row;
+        if (slow_query.to_datum(identifier_format, server_config_client, &row)) {
+            rows_out->push_back(row);
+        }
+    }
+
+    return true;
+}
+
+bool slow_queries_artificial_table_backend_t::read_row(ql::datum_t primary_key,
+                                                       signal_t *interruptor,
+                                                       ql::datum_t *row_out,
+                                                       UNUSED std::string *error_out) {
+    *row_out = ql::datum_t();
+
+    cross_thread_signal_t ct_interruptor(interruptor, home_thread());
+    on_thread_t rethreader(home_thread());
+
+    uuid_u id;
+    std::string error;
+    if (convert_uuid_from_datum(primary_key, &id, &error)) {
+        std::vector<slow_query_t> slow_queries;
+        get_all_slow_queries(&ct_interruptor, &slow_queries);
+
+        for (auto const &slow_query : slow_queries) {
+            if (slow_query.id == id) {
+                ql::datum_t row;
+                if (slow_query.to_datum(identifier_format, server_config_client, &row)) {
+                    *row_out = std::move(row);
+                }
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool slow_queries_artificial_table_backend_t::write_row(
+        UNUSED ql::datum_t primary_key,
+        UNUSED bool pkey_was_autogenerated,
+        UNUSED ql::datum_t *new_value_inout,
+        UNUSED signal_t *interruptor,
+        std::string *error_out) {
+    *error_out = "It's illegal to write to the `rethinkdb.slow_queries` system table.";
+    return false;
+}
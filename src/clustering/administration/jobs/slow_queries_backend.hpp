@@ -0,0 +1,62 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_JOBS_SLOW_QUERIES_BACKEND_HPP_
+#define CLUSTERING_ADMINISTRATION_JOBS_SLOW_QUERIES_BACKEND_HPP_
+
+#include <string>
+#include <vector>
+
+#include "rdb_protocol/artificial_table/caching_cfeed_backend.hpp"
+#include "clustering/administration/metadata.hpp"
+#include "concurrency/watchable.hpp"
+
+class server_config_client_t;
+class slow_query_t;
+
+/* `rethinkdb.slow_queries` holds the last `SLOW_QUERY_HISTORY_SIZE` queries of each
+server that took at least its `--slow-query-threshold`. The history isn't persisted,
+so a server's entries go away when it restarts. */
+class slow_queries_artificial_table_backend_t :
+    public timer_cfeed_artificial_table_backend_t
+{
+public:
+    slow_queries_artificial_table_backend_t(
+        mailbox_manager_t *_mailbox_manager,
+        const clone_ptr_t<watchable_t<change_tracking_map_t<
+            peer_id_t, cluster_directory_metadata_t> > > &_directory_view,
+        server_config_client_t *_server_config_client,
+        admin_identifier_format_t _identifier_format);
+    ~slow_queries_artificial_table_backend_t();
+
+    std::string get_primary_key_name();
+
+    bool read_all_rows_as_vector(signal_t *interruptor,
+                                 std::vector<ql::datum_t> *rows_out,
+                                 std::string *error_out);
+
+    bool read_row(ql::datum_t primary_key,
+                  signal_t *interruptor,
+                  ql::datum_t *row_out,
+                  std::string *error_out);
+
+    bool write_row(ql::datum_t primary_key,
+                   bool pkey_was_autogenerated,
+                   ql::datum_t *new_value_inout,
+                   signal_t *interruptor,
+                   std::string *error_out);
+
+private:
+    void get_all_slow_queries(
+            signal_t *interruptor,
+            std::vector<slow_query_t> *slow_queries_out);
+
+    mailbox_manager_t *mailbox_manager;
+
+    clone_ptr_t<watchable_t<change_tracking_map_t<peer_id_t,
+        cluster_directory_metadata_t> > > directory_view;
+
+    server_config_client_t *server_config_client;
+
+    admin_identifier_format_t identifier_format;
+};
+
+#endif /* CLUSTERING_ADMINISTRATION_JOBS_SLOW_QUERIES_BACKEND_HPP_ */
@@ -8,6 +8,9 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <deque>
+
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
@@ -187,9 +190,11 @@ void throw_unless(bool condition, const std::string &where) {
     }
 }
 
+/* Reads the lines of a file backwards, starting from `end_offset` or from the end of
+the file if `end_offset` is negative or past the end. */
 class file_reverse_reader_t {
 public:
-    explicit file_reverse_reader_t(const std::string &filename) :
+    file_reverse_reader_t(const std::string &filename, int64_t end_offset) :
         fd(INVALID_FD),
         current_chunk(chunk_size) {
 
@@ -203,6 +208,9 @@ public:
         }
 
         int64_t fd_filesize = get_file_size(fd.get());
+        if (end_offset >= 0 && end_offset < fd_filesize) {
+            fd_filesize = end_offset;
+        }
         if (fd_filesize == 0) {
             remaining_in_current_chunk = current_chunk_start = 0;
         } else {
@@ -276,6 +284,19 @@ private:
 
     bool write(const log_message_t &msg, std::string *error_out);
     void initiate_write(log_level_t level, const std::string &message);
+
+    /* Answers as much of a `tail()` query as it can from `recent_messages`, appending
+    to `messages_out` and decrementing `*max_lines` for each message it looks at.
+    Returns true if that was the whole answer; otherwise the rest of it is in the log
+    file before `*file_end_out`, which is -1 if that's the whole file. */
+    bool tail_recent(int *max_lines,
+                     struct timespec min_timestamp,
+                     struct timespec max_timestamp,
+                     std::vector<log_message_t> *messages_out,
+                     int64_t *file_end_out);
+    void note_written(const log_message_t &msg, int64_t offset);
+    void forget_written();
+
     base_path_t filename;
     struct timespec uptime_reference;
     struct timespec last_msg_timestamp;
@@ -283,6 +304,26 @@ private:
     struct flock filelock, fileunlock;
     scoped_fd_t fd;
 
+    /* The last `max_recent_messages` messages we wrote to the log file, oldest first,
+    with the offsets they start at. Every message we wrote after the first of them is
+    in here, so queries for recent messages (which is what the `logs` table and its
+    changefeeds ask for) don't have to read the file. */
+    struct recent_message_t {
+        log_message_t message;
+        int64_t offset;
+    };
+    static const size_t max_recent_messages = 1000;
+    std::deque<recent_message_t> recent_messages;
+
+    /* The timestamp and offset of one message we wrote every `checkpoint_interval`
+    bytes or so, in increasing order of timestamp. Since the messages in the file are
+    in order too, a query for older messages can skip the file from the first
+    checkpoint after its time range onwards. */
+    static const int64_t checkpoint_interval = MEGABYTE;
+    std::vector<std::pair<struct timespec, int64_t> > checkpoints;
+
+    spinlock_t recent_messages_lock;
+
     DISABLE_COPYING(fallback_log_writer_t);
 } fallback_log_writer;
 
@@ -419,11 +460,20 @@ bool fallback_log_writer_t::write(const log_message_t &msg, std::string *error_o
         return false;
     }
 
+    /* The file is opened with `O_APPEND`, so this is where the message will go. If we
+    can't tell, we no longer know where any of our messages are. */
+    off_t offset = lseek(fd.get(), 0, SEEK_END);
     ssize_t write_res = ::write(fd.get(), formatted.data(), formatted.length());
     if (write_res != static_cast<ssize_t>(formatted.length())) {
+        forget_written();
         error_out->assign("cannot write to log file: " + errno_string(get_errno()));
         return false;
     }
+    if (offset == -1) {
+        forget_written();
+    } else {
+        note_written(msg, offset);
+    }
 
     fcntl_res = fcntl(fd.get(), F_SETLK, &fileunlock);
     if (fcntl_res != 0) {
@@ -434,6 +484,60 @@ bool fallback_log_writer_t::write(const log_message_t &msg, std::string *error_o
     return true;
 }
 
+void fallback_log_writer_t::note_written(const log_message_t &msg, int64_t offset) {
+    spinlock_acq_t lock_acq(&recent_messages_lock);
+    if (recent_messages.size() == max_recent_messages) {
+        recent_messages.pop_front();
+    }
+    recent_messages.push_back(recent_message_t{msg, offset});
+    if (checkpoints.empty() ||
+            (offset >= checkpoints.back().second + checkpoint_interval &&
+             msg.timestamp > checkpoints.back().first)) {
+        checkpoints.push_back(std::make_pair(msg.timestamp, offset));
+    }
+}
+
+void fallback_log_writer_t::forget_written() {
+    spinlock_acq_t lock_acq(&recent_messages_lock);
+    recent_messages.clear();
+    checkpoints.clear();
+}
+
+bool fallback_log_writer_t::tail_recent(int *max_lines,
+                                        struct timespec min_timestamp,
+                                        struct timespec max_timestamp,
+                                        std::vector<log_message_t> *messages_out,
+                                        int64_t *file_end_out) {
+    spinlock_acq_t lock_acq(&recent_messages_lock);
+    if (recent_messages.empty()) {
+        *file_end_out = -1;
+        return false;
+    }
+    *file_end_out = recent_messages.front().offset;
+    if (max_timestamp < recent_messages.front().message.timestamp) {
+        auto it = std::upper_bound(checkpoints.begin(), checkpoints.end(),
+            max_timestamp,
+            [](const struct timespec &t,
+               const std::pair<struct timespec, int64_t> &checkpoint) {
+                return t < checkpoint.first;
+            });
+        if (it != checkpoints.end()) {
+            *file_end_out = std::min(*file_end_out, it->second);
+        }
+        return false;
+    }
+    for (auto it = recent_messages.rbegin(); it != recent_messages.rend(); ++it) {
+        if (*max_lines <= 0) {
+            return true;
+        }
+        --*max_lines;
+        if (it->message.timestamp > max_timestamp) continue;
+        if (it->message.timestamp < min_timestamp) return true;
+        messages_out->push_back(it->message);
+    }
+    return *max_lines <= 0;
+}
+
 void fallback_log_writer_t::initiate_write(log_level_t level, const std::string &message) {
     log_message_t log_msg = assemble_log_message(level, message);
     std::string error_message;
@@ -520,7 +624,13 @@ void thread_pool_log_writer_t::write_blocking(const log_message_t &msg, std::str
 
 void thread_pool_log_writer_t::tail_blocking(int max_lines, struct timespec min_timestamp, struct timespec max_timestamp, volatile bool *cancel, std::vector<log_message_t> *messages_out, std::string *error_out, bool *ok_out) {
     try {
-        file_reverse_reader_t reader(fallback_log_writer.filename.path());
+        int64_t file_end;
+        if (fallback_log_writer.tail_recent(&max_lines, min_timestamp, max_timestamp,
+                                            messages_out, &file_end)) {
+            *ok_out = true;
+            return;
+        }
+        file_reverse_reader_t reader(fallback_log_writer.filename.path(), file_end);
         std::string line;
         while (max_lines-- > 0 && reader.get_next(&line) && !*cancel) {
             if (line == "" || line[line.length() - 1] != '\n') {
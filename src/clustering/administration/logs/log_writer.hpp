@@ -48,6 +48,9 @@ public:
     explicit thread_pool_log_writer_t(local_issue_aggregator_t *local_issue_aggregator);
     ~thread_pool_log_writer_t();
 
+    /* Returns the messages with timestamps between `min_timestamp` and
+    `max_timestamp`, newest first, looking at no more than `max_lines` messages.
+    Recent messages come from memory rather than the log file. */
     std::vector<log_message_t> tail(int max_lines, struct timespec min_timestamp, struct timespec max_timestamp, signal_t *interruptor) THROWS_ONLY(std::runtime_error, interrupted_exc_t);
 
 private:
@@ -647,7 +647,10 @@ service_address_ports_t get_service_address_ports(const std::map<std::string, op
         exists_option(opts, "--no-http-admin"),
         offseted_port(get_single_int(opts, "--http-port"), port_offset),
         offseted_port(get_single_int(opts, "--driver-port"), port_offset),
-        port_offset);
+        port_offset,
+        exists_option(opts, "--driver-reuseport")
+            ? accept_sharding_t::per_thread
+            : accept_sharding_t::none);
 }
 
 
@@ -657,6 +660,7 @@ void run_rethinkdb_create(const base_path_t &base_path,
                           boost::optional<uint64_t> total_cache_size,
                           const file_direct_io_mode_t direct_io_mode,
                           const int max_concurrent_io_requests,
+                          const io_backend_mode_t io_backend,
                           bool *const result_out) {
     server_id_t our_server_id = generate_uuid();
 
@@ -673,7 +677,7 @@ void run_rethinkdb_create(const base_path_t &base_path,
     cluster_metadata.servers.servers.insert(
         std::make_pair(our_server_id, make_deletable(server_semilattice_metadata)));
 
-    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests);
+    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests, io_backend);
 
     perfmon_collection_t metadata_perfmon_collection;
     perfmon_membership_t metadata_perfmon_membership(&get_global_perfmon_collection(), &metadata_perfmon_collection, "metadata");
@@ -724,6 +728,7 @@ void run_rethinkdb_serve(const base_path_t &base_path,
                          serve_info_t *serve_info,
                          const file_direct_io_mode_t direct_io_mode,
                          const int max_concurrent_io_requests,
+                         const io_backend_mode_t io_backend,
                          const boost::optional<boost::optional<uint64_t> >
                             &total_cache_size,
                          const server_id_t *our_server_id,
@@ -736,7 +741,7 @@ void run_rethinkdb_serve(const base_path_t &base_path,
 
     logNTC("Loading data from directory %s\n", base_path.path().c_str());
 
-    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests);
+    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests, io_backend);
 
     perfmon_collection_t metadata_perfmon_collection;
     perfmon_membership_t metadata_perfmon_membership(&get_global_perfmon_collection(), &metadata_perfmon_collection, "metadata");
@@ -810,6 +815,7 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
                              const std::set<name_string_t> &server_tag_names,
                              const file_direct_io_mode_t direct_io_mode,
                              const int max_concurrent_io_requests,
+                             const io_backend_mode_t io_backend,
                              const boost::optional<boost::optional<uint64_t> >
                                 &total_cache_size,
                              const bool new_directory,
@@ -818,7 +824,7 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
                              bool *const result_out) {
     if (!new_directory) {
         run_rethinkdb_serve(base_path, serve_info, direct_io_mode,
-                            max_concurrent_io_requests, total_cache_size,
+                            max_concurrent_io_requests, io_backend, total_cache_size,
                             NULL, NULL, data_directory_lock,
                             result_out);
     } else {
@@ -860,7 +866,7 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
         }
 
         run_rethinkdb_serve(base_path, serve_info, direct_io_mode,
-                            max_concurrent_io_requests,
+                            max_concurrent_io_requests, io_backend,
                             boost::optional<boost::optional<uint64_t> >(),
                             &our_server_id, &cluster_metadata,
                             data_directory_lock, result_out);
@@ -926,10 +932,23 @@ options::help_section_t get_file_options(std::vector<options::option_t> *options
     options_out->push_back(options::option_t(options::names_t("--direct-io"),
                                              options::OPTIONAL_NO_PARAMETER));
     help.add("--direct-io", "use direct I/O for file access");
+    options_out->push_back(options::option_t(options::names_t("--io-backend"),
+                                             options::OPTIONAL,
+                                             "pool"));
+    help.add("--io-backend {pool | io_uring | aio}",
+             "how reads and writes are sent to the kernel: through a thread pool, "
+             "or batched through io_uring or kernel AIO (defaults to 'pool')");
     options_out->push_back(options::option_t(options::names_t("--cache-size"),
                                              options::OPTIONAL));
     help.add("--cache-size mb", "total cache size (in megabytes) for the process. Can "
         "be 'auto'.");
+    options_out->push_back(options::option_t(options::names_t("--auto-rebalance"),
+                                             options::OPTIONAL,
+                                             "off"));
+    help.add("--auto-rebalance {off | propose | apply}",
+             "whether to watch the load on each table's shards and log or make the "
+             "changes to split points and primaries that would balance it (defaults to "
+             "'off'). Only turn it on for one server in the cluster.");
     return help;
 }
 
@@ -1036,6 +1055,24 @@ std::string get_reql_http_proxy_option(const std::map<std::string, options::valu
     return proxy.get();
 }
 
+int get_slow_query_threshold_option(const std::map<std::string, options::values_t> &opts) {
+    const int threshold_ms = get_single_int(opts, "--slow-query-threshold");
+    if (threshold_ms < 0) {
+        throw std::runtime_error(strprintf("--slow-query-threshold (%d) must not be "
+                                           "negative", threshold_ms));
+    }
+    return threshold_ms;
+}
+
+int get_outdated_read_cache_option(const std::map<std::string, options::values_t> &opts) {
+    const int max_age_ms = get_single_int(opts, "--outdated-read-cache");
+    if (max_age_ms < 0) {
+        throw std::runtime_error(strprintf("--outdated-read-cache (%d) must not be "
+                                           "negative", max_age_ms));
+    }
+    return max_age_ms;
+}
+
 options::help_section_t get_web_options(std::vector<options::option_t> *options_out) {
     options::help_section_t help("Web options");
     options_out->push_back(options::option_t(options::names_t("--web-static-directory"),
@@ -1078,6 +1115,12 @@ options::help_section_t get_network_options(const bool join_required, std::vecto
                                              strprintf("%d", port_defaults::reql_port)));
     help.add("--driver-port port", "port for rethinkdb protocol client drivers");
 
+    options_out->push_back(options::option_t(options::names_t("--driver-reuseport"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--driver-reuseport", "accept client driver connections on all threads, "
+             "using SO_REUSEPORT sockets (this also lets other processes of the same "
+             "user listen on the driver port)");
+
     options_out->push_back(options::option_t(options::names_t("--port-offset", "-o"),
                                              options::OPTIONAL,
                                              strprintf("%d", port_defaults::port_offset)));
@@ -1091,6 +1134,16 @@ options::help_section_t get_network_options(const bool join_required, std::vecto
                                              options::OPTIONAL));
     help.add("--reql-http-proxy [protocol://]host[:port]", "HTTP proxy to use for performing `r.http(...)` queries, default port is 1080");
 
+    options_out->push_back(options::option_t(options::names_t("--slow-query-threshold"),
+                                             options::OPTIONAL,
+                                             strprintf("%d", DEFAULT_SLOW_QUERY_THRESHOLD_MS)));
+    help.add("--slow-query-threshold ms", "queries that take at least this many milliseconds are recorded in the `rethinkdb.slow_queries` table, 0 turns this off");
+
+    options_out->push_back(options::option_t(options::names_t("--outdated-read-cache"),
+                                             options::OPTIONAL,
+                                             strprintf("%d", DEFAULT_OUTDATED_READ_CACHE_MS)));
+    help.add("--outdated-read-cache ms", "point reads with `use_outdated` may be answered with a row read at most this many milliseconds ago, 0 turns this off");
+
     options_out->push_back(options::option_t(options::names_t("--canonical-address"),
                                              options::OPTIONAL_REPEAT));
     help.add("--canonical-address addr", "address that other rethinkdb instances will use to connect to us, can be specified multiple times");
@@ -1104,9 +1157,20 @@ options::help_section_t get_cpu_options(std::vector<options::option_t> *options_
                                              options::OPTIONAL,
                                              strprintf("%d", get_cpu_count())));
     help.add("-c [ --cores ] n", "the number of cores to use");
+    options_out->push_back(options::option_t(options::names_t("--numa-affinity"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--numa-affinity", "pin threads to cores and keep each table's shards and "
+             "memory on the NUMA node of its serializer");
     return help;
 }
 
+thread_affinity_t parse_thread_affinity_option(
+        const std::map<std::string, options::values_t> &opts) {
+    return exists_option(opts, "--numa-affinity")
+        ? thread_affinity_t::numa
+        : thread_affinity_t::none;
+}
+
 MUST_USE bool parse_cores_option(const std::map<std::string, options::values_t> &opts,
                                  int *num_workers_out) {
     int num_workers = get_single_int(opts, "--cores");
@@ -1272,6 +1336,40 @@ update_check_t parse_update_checking_option(const std::map<std::string, options:
         : update_check_t::perform;
 }
 
+MUST_USE bool parse_io_backend_option(const std::map<std::string, options::values_t> &opts,
+                                      io_backend_mode_t *io_backend_out) {
+    const std::string io_backend = get_single_option(opts, "--io-backend");
+    if (io_backend == "pool") {
+        *io_backend_out = io_backend_mode_t::pool;
+    } else if (io_backend == "io_uring") {
+        *io_backend_out = io_backend_mode_t::io_uring;
+    } else if (io_backend == "aio") {
+        *io_backend_out = io_backend_mode_t::aio;
+    } else {
+        fprintf(stderr, "ERROR: io-backend must be one of 'pool', 'io_uring' or 'aio'\n");
+        return false;
+    }
+    return true;
+}
+
+MUST_USE bool parse_auto_rebalance_option(
+        const std::map<std::string, options::values_t> &opts,
+        auto_rebalance_t *auto_rebalance_out) {
+    const std::string auto_rebalance = get_single_option(opts, "--auto-rebalance");
+    if (auto_rebalance == "off") {
+        *auto_rebalance_out = auto_rebalance_t::off;
+    } else if (auto_rebalance == "propose") {
+        *auto_rebalance_out = auto_rebalance_t::propose;
+    } else if (auto_rebalance == "apply") {
+        *auto_rebalance_out = auto_rebalance_t::apply;
+    } else {
+        fprintf(stderr, "ERROR: auto-rebalance must be one of 'off', 'propose' or "
+                "'apply'\n");
+        return false;
+    }
+    return true;
+}
+
 file_direct_io_mode_t parse_direct_io_mode_option(const std::map<std::string, options::values_t> &opts) {
     if (exists_option(opts, "--no-direct-io")) {
         logWRN("Ignoring 'no-direct-io' option. 'no-direct-io' is deprecated and "
@@ -1312,6 +1410,11 @@ int main_rethinkdb_create(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        io_backend_mode_t io_backend;
+        if (!parse_io_backend_option(opts, &io_backend)) {
+            return EXIT_FAILURE;
+        }
+
         const int num_workers = get_cpu_count();
 
         bool is_new_directory = false;
@@ -1337,6 +1440,7 @@ int main_rethinkdb_create(int argc, char *argv[]) {
                                      total_cache_size,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend,
                                      &result),
                            num_workers);
 
@@ -1427,8 +1531,18 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        io_backend_mode_t io_backend;
+        if (!parse_io_backend_option(opts, &io_backend)) {
+            return EXIT_FAILURE;
+        }
+
         update_check_t do_update_checking = parse_update_checking_option(opts);
 
+        auto_rebalance_t auto_rebalance;
+        if (!parse_auto_rebalance_option(opts, &auto_rebalance)) {
+            return EXIT_FAILURE;
+        }
+
         boost::optional<boost::optional<uint64_t> > total_cache_size =
             parse_total_cache_size_option(opts);
 
@@ -1459,8 +1573,11 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
 
         serve_info_t serve_info(std::move(joins),
                                 get_reql_http_proxy_option(opts),
+                                get_slow_query_threshold_option(opts),
+                                get_outdated_read_cache_option(opts),
                                 std::move(web_path),
                                 do_update_checking,
+                                auto_rebalance,
                                 address_ports,
                                 get_optional_option(opts, "--config-file"),
                                 std::vector<std::string>(argv, argv + argc));
@@ -1473,12 +1590,13 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
                                      &serve_info,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend,
                                      total_cache_size,
                                      static_cast<server_id_t*>(NULL),
                                      static_cast<cluster_semilattice_metadata_t*>(NULL),
                                      &data_directory_lock,
                                      &result),
-                           num_workers);
+                           num_workers, parse_thread_affinity_option(opts));
         return result ? EXIT_SUCCESS : EXIT_FAILURE;
     } catch (const options::named_error_t &ex) {
         output_named_error(ex, help);
@@ -1542,8 +1660,11 @@ int main_rethinkdb_proxy(int argc, char *argv[]) {
 
         serve_info_t serve_info(std::move(joins),
                                 get_reql_http_proxy_option(opts),
+                                get_slow_query_threshold_option(opts),
+                                get_outdated_read_cache_option(opts),
                                 std::move(web_path),
                                 update_check_t::do_not_perform,
+                                auto_rebalance_t::off,
                                 address_ports,
                                 get_optional_option(opts, "--config-file"),
                                 std::vector<std::string>(argv, argv + argc));
@@ -1657,8 +1778,18 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        io_backend_mode_t io_backend;
+        if (!parse_io_backend_option(opts, &io_backend)) {
+            return EXIT_FAILURE;
+        }
+
         update_check_t do_update_checking = parse_update_checking_option(opts);
 
+        auto_rebalance_t auto_rebalance;
+        if (!parse_auto_rebalance_option(opts, &auto_rebalance)) {
+            return EXIT_FAILURE;
+        }
+
         // Attempt to create the directory early so that the log file can use it.
         // If we create the file, it will be cleaned up unless directory_initialized()
         // is called on it.  This will be done after the metadata files have been created.
@@ -1709,8 +1840,11 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
 
         serve_info_t serve_info(std::move(joins),
                                 get_reql_http_proxy_option(opts),
+                                get_slow_query_threshold_option(opts),
+                                get_outdated_read_cache_option(opts),
                                 std::move(web_path),
                                 do_update_checking,
+                                auto_rebalance,
                                 address_ports,
                                 get_optional_option(opts, "--config-file"),
                                 std::vector<std::string>(argv, argv + argc));
@@ -1724,12 +1858,13 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
                                      server_tag_names,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend,
                                      total_cache_size,
                                      is_new_directory,
                                      &serve_info,
                                      &data_directory_lock,
                                      &result),
-                           num_workers);
+                           num_workers, parse_thread_affinity_option(opts));
 
         return result ? EXIT_SUCCESS : EXIT_FAILURE;
     } catch (const options::named_error_t &ex) {
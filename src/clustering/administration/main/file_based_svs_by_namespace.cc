@@ -4,6 +4,7 @@
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
+#include "arch/runtime/runtime.hpp"
 #include "clustering/immediate_consistency/branch/multistore.hpp"
 #include "clustering/reactor/reactor.hpp"
 #include "rdb_protocol/store.hpp"
@@ -103,11 +104,17 @@ void
 file_based_svs_by_namespace_t::get_svs(
             perfmon_collection_t *serializers_perfmon_collection,
             namespace_id_t namespace_id,
+            uint32_t block_size,
+            bool compress_blocks,
             stores_lifetimer_t *stores_out,
             scoped_ptr_t<multistore_ptr_t> *svs_out,
             rdb_context_t *ctx) {
     const int num_db_threads = get_num_db_threads();
 
+    // The reactor driver starts all the tables at once, so they queue up here.
+    new_semaphore_acq_t load_acq(&table_loads_semaphore_, 1);
+    load_acq.acquisition_signal()->wait();
+
     // TODO: If the server gets killed when starting up, we can
     // get a database in an invalid startup state.
 
@@ -123,10 +130,12 @@ file_based_svs_by_namespace_t::get_svs(
         = stores_out->stores();
     stores_out_stores->init(num_stores);
 
+    // The serializer's I/O happens on (and near) the serializer thread, so we keep
+    // the CPU shards on the same NUMA node if we can.
     const threadnum_t serializer_thread = next_thread(num_db_threads);
     std::vector<threadnum_t> store_threads;
     for (int i = 0; i < num_stores; ++i) {
-        store_threads.push_back(next_thread(num_db_threads));
+        store_threads.push_back(next_thread_near(serializer_thread, num_db_threads));
     }
 
     scoped_ptr_t<serializer_t> serializer;
@@ -171,8 +180,11 @@ file_based_svs_by_namespace_t::get_svs(
                                          stores_out_stores, store_views.data()));
             mptr.init(new multistore_ptr_t(store_views.data(), num_stores));
         } else {
-            standard_serializer_t::create(&file_opener,
-                                          standard_serializer_t::static_config_t());
+            // Existing files keep the block size and compression they were
+            // created with, since the serializer reads them from the file.
+            standard_serializer_t::create(
+                &file_opener,
+                standard_serializer_t::static_config_t(block_size, compress_blocks));
             {
                 scoped_ptr_t<serializer_t> ser
                     = make_scoped<standard_serializer_t>(
@@ -231,6 +243,11 @@ void file_based_svs_by_namespace_t::destroy_svs(namespace_id_t namespace_id) {
     const int res = ::unlink(filepath.c_str());
     guarantee_err(res == 0 || get_errno() == ENOENT,
                   "unlink failed for file %s", filepath.c_str());
+
+    const std::string hot_filepath = file_name_for(namespace_id).hot_block_list_path();
+    const int hot_res = ::unlink(hot_filepath.c_str());
+    guarantee_err(hot_res == 0 || get_errno() == ENOENT,
+                  "unlink failed for file %s", hot_filepath.c_str());
 }
 
 serializer_filepath_t file_based_svs_by_namespace_t::file_name_for(namespace_id_t namespace_id) {
@@ -241,3 +258,18 @@ threadnum_t file_based_svs_by_namespace_t::next_thread(int num_db_threads) {
     thread_counter_ = (thread_counter_ + 1) % num_db_threads;
     return threadnum_t(thread_counter_);
 }
+
+threadnum_t file_based_svs_by_namespace_t::next_thread_near(threadnum_t near,
+                                                            int num_db_threads) {
+    rassert(near.threadnum < num_db_threads);
+    const int node = get_thread_numa_node(near);
+    // We come across `near` itself within `num_db_threads` steps, so this always
+    // finds a thread.
+    for (int i = 0; i < num_db_threads; ++i) {
+        threadnum_t thread = next_thread(num_db_threads);
+        if (get_thread_numa_node(thread) == node) {
+            return thread;
+        }
+    }
+    unreachable();
+}
@@ -6,6 +6,7 @@
 
 #include "clustering/administration/reactor_driver.hpp"
 #include "clustering/administration/issues/outdated_index.hpp"
+#include "concurrency/new_semaphore.hpp"
 
 class cache_balancer_t;
 class rdb_context_t;
@@ -18,10 +19,13 @@ public:
                                   local_issue_aggregator_t *local_issue_aggregator)
         : io_backender_(io_backender), balancer_(balancer),
           base_path_(base_path), thread_counter_(0),
-          outdated_index_tracker(local_issue_aggregator) { }
+          outdated_index_tracker(local_issue_aggregator),
+          table_loads_semaphore_(MAX_CONCURRENT_TABLE_LOADS) { }
 
     void get_svs(perfmon_collection_t *serializers_perfmon_collection,
                  namespace_id_t namespace_id,
+                 uint32_t block_size,
+                 bool compress_blocks,
                  stores_lifetimer_t *stores_out,
                  scoped_ptr_t<multistore_ptr_t> *svs_out,
                  rdb_context_t *);
@@ -36,10 +40,17 @@ private:
     const base_path_t base_path_;
 
     threadnum_t next_thread(int num_db_threads);
+    // Like `next_thread`, but skips threads that are on a different NUMA node than
+    // `near` (which must be one of the db threads).
+    threadnum_t next_thread_near(threadnum_t near, int num_db_threads);
     int thread_counter_; // should only be used by `next_thread`
 
     outdated_index_issue_tracker_t outdated_index_tracker;
 
+    // Every table's `get_svs` holds this while it opens the table's files, so that
+    // only `MAX_CONCURRENT_TABLE_LOADS` tables load at once.
+    new_semaphore_t table_loads_semaphore_;
+
     DISABLE_COPYING(file_based_svs_by_namespace_t);
 };
 
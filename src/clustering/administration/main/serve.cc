@@ -27,6 +27,7 @@
 #include "clustering/administration/servers/config_server.hpp"
 #include "clustering/administration/servers/config_client.hpp"
 #include "clustering/administration/servers/network_logger.hpp"
+#include "clustering/administration/tables/auto_rebalancer.hpp"
 #include "containers/incremental_lenses.hpp"
 #include "extproc/extproc_pool.hpp"
 #include "rdb_protocol/query_server.hpp"
@@ -275,7 +276,11 @@ bool do_serve(io_backender_t *io_backender,
                               NULL,   /* we'll fill this in later */
                               semilattice_manager_auth.get_root_view(),
                               &get_global_perfmon_collection(),
-                              serve_info.reql_http_proxy);
+                              serve_info.reql_http_proxy,
+                              serve_info.slow_query_threshold_ms,
+                              serve_info.outdated_read_cache_ms,
+                              i_am_a_server ? io_backender : NULL,
+                              base_path);
         jobs_manager.set_rdb_context(&rdb_ctx);
 
         real_reql_cluster_interface_t real_reql_cluster_interface(
@@ -357,6 +362,7 @@ bool do_serve(io_backender_t *io_backender,
                 rdb_query_server_t rdb_query_server(
                     serve_info.ports.local_addresses,
                     serve_info.ports.reql_port,
+                    serve_info.ports.reql_accept_sharding,
                     &rdb_ctx);
                 logNTC("Listening for client driver connections on port %d\n",
                        rdb_query_server.get_port());
@@ -444,6 +450,14 @@ bool do_serve(io_backender_t *io_backender,
                         logNTC("Proxy ready");
                     }
 
+                    scoped_ptr_t<auto_rebalancer_t> auto_rebalancer;
+                    if (i_am_a_server
+                        && serve_info.auto_rebalance != auto_rebalance_t::off) {
+                        auto_rebalancer.init(new auto_rebalancer_t(
+                            serve_info.auto_rebalance, &real_reql_cluster_interface,
+                            semilattice_manager_cluster.get_root_view()));
+                    }
+
                     scoped_ptr_t<version_checker_t> checker;
                     if (i_am_a_server
                         && serve_info.do_version_checking == update_check_t::perform) {
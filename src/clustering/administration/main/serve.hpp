@@ -10,7 +10,9 @@
 #include "clustering/administration/metadata.hpp"
 #include "clustering/administration/persist.hpp"
 #include "clustering/administration/main/version_check.hpp"
+#include "clustering/administration/tables/auto_rebalancer.hpp"
 #include "arch/address.hpp"
+#include "arch/types.hpp"
 
 class os_signal_cond_t;
 
@@ -46,7 +48,8 @@ struct service_address_ports_t {
         client_port(0),
         http_port(0),
         reql_port(0),
-        port_offset(0) { }
+        port_offset(0),
+        reql_accept_sharding(accept_sharding_t::none) { }
 
     service_address_ports_t(const std::set<ip_address_t> &_local_addresses,
                             const peer_address_t &_canonical_addresses,
@@ -55,7 +58,8 @@ struct service_address_ports_t {
                             bool _http_admin_is_disabled,
                             int _http_port,
                             int _reql_port,
-                            int _port_offset) :
+                            int _port_offset,
+                            accept_sharding_t _reql_accept_sharding) :
         local_addresses(_local_addresses),
         canonical_addresses(_canonical_addresses),
         port(_port),
@@ -63,7 +67,8 @@ struct service_address_ports_t {
         http_admin_is_disabled(_http_admin_is_disabled),
         http_port(_http_port),
         reql_port(_reql_port),
-        port_offset(_port_offset)
+        port_offset(_port_offset),
+        reql_accept_sharding(_reql_accept_sharding)
     {
             sanitize_port(port, "port", port_offset);
             sanitize_port(client_port, "client_port", port_offset);
@@ -83,6 +88,7 @@ struct service_address_ports_t {
     int http_port;
     int reql_port;
     int port_offset;
+    accept_sharding_t reql_accept_sharding;
 };
 
 peer_address_set_t look_up_peers_addresses(const std::vector<host_and_port_t> &names);
@@ -91,15 +97,21 @@ class serve_info_t {
 public:
     serve_info_t(std::vector<host_and_port_t> &&_joins,
                  std::string &&_reql_http_proxy,
+                 int _slow_query_threshold_ms,
+                 int _outdated_read_cache_ms,
                  std::string &&_web_assets,
                  update_check_t _do_version_checking,
+                 auto_rebalance_t _auto_rebalance,
                  service_address_ports_t _ports,
                  boost::optional<std::string> _config_file,
                  std::vector<std::string> &&_argv) :
         joins(std::move(_joins)),
         reql_http_proxy(std::move(_reql_http_proxy)),
+        slow_query_threshold_ms(_slow_query_threshold_ms),
+        outdated_read_cache_ms(_outdated_read_cache_ms),
         web_assets(std::move(_web_assets)),
         do_version_checking(_do_version_checking),
+        auto_rebalance(_auto_rebalance),
         ports(_ports),
         config_file(_config_file),
         argv(std::move(_argv))
@@ -112,8 +124,11 @@ public:
     const std::vector<host_and_port_t> joins;
     peer_address_set_t peers;
     std::string reql_http_proxy;
+    int slow_query_threshold_ms;
+    int outdated_read_cache_ms;
     std::string web_assets;
     update_check_t do_version_checking;
+    auto_rebalance_t auto_rebalance;
     service_address_ports_t ports;
     boost::optional<std::string> config_file;
     /* The original arguments, so we can display them in `server_status`. All the
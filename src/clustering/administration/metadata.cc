@@ -33,6 +33,21 @@ RDB_IMPL_SEMILATTICE_JOINABLE_3(cluster_semilattice_metadata_t,
 RDB_IMPL_EQUALITY_COMPARABLE_3(cluster_semilattice_metadata_t,
                                rdb_namespaces, servers, databases);
 
+void semilattice_changes(const cluster_semilattice_metadata_t &a,
+                         const cluster_semilattice_metadata_t &b,
+                         cluster_semilattice_metadata_t *changes_out) {
+    {
+        cow_ptr_t<namespaces_semilattice_metadata_t>::change_t change(
+            &changes_out->rdb_namespaces);
+        semilattice_changes(a.rdb_namespaces->namespaces, b.rdb_namespaces->namespaces,
+                            &change.get()->namespaces);
+    }
+    semilattice_changes(a.servers.servers, b.servers.servers,
+                        &changes_out->servers.servers);
+    semilattice_changes(a.databases.databases, b.databases.databases,
+                        &changes_out->databases.databases);
+}
+
 RDB_IMPL_SERIALIZABLE_1_SINCE_v1_13(auth_semilattice_metadata_t, auth_key);
 RDB_IMPL_SEMILATTICE_JOINABLE_1(auth_semilattice_metadata_t, auth_key);
 RDB_IMPL_EQUALITY_COMPARABLE_1(auth_semilattice_metadata_t, auth_key);
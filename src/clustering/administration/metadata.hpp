@@ -19,6 +19,7 @@
 #include "containers/auth_key.hpp"
 #include "rpc/semilattice/joins/cow_ptr.hpp"
 #include "rpc/semilattice/joins/macros.hpp"
+#include "rpc/semilattice/joins/map.hpp"
 #include "rpc/serialize_macros.hpp"
 
 
@@ -35,6 +36,11 @@ public:
 RDB_DECLARE_SERIALIZABLE(cluster_semilattice_metadata_t);
 RDB_DECLARE_SEMILATTICE_JOINABLE(cluster_semilattice_metadata_t);
 RDB_DECLARE_EQUALITY_COMPARABLE(cluster_semilattice_metadata_t);
+/* See `semilattice_manager_t`. Only the tables, servers and databases that are
+different in `b` end up in `*changes_out`. */
+void semilattice_changes(const cluster_semilattice_metadata_t &a,
+                         const cluster_semilattice_metadata_t &b,
+                         cluster_semilattice_metadata_t *changes_out);
 
 class auth_semilattice_metadata_t {
 public:
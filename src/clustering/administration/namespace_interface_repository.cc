@@ -9,6 +9,7 @@
 #include "clustering/reactor/namespace_interface.hpp"
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/cross_thread_watchable.hpp"
+#include "time.hpp"
 
 #define NAMESPACE_INTERFACE_EXPIRATION_MS (60 * 1000)
 
@@ -22,18 +23,16 @@ struct namespace_repo_t::namespace_cache_entry_t :
     public namespace_interface_access_t::ref_tracker_t
 {
 public:
+    /* Every query that uses the table takes and releases a reference on its
+    thread, so these mustn't wake up the coroutine that destroys the interface; it
+    checks `last_release` when its expiration timer goes off instead. */
     void add_ref() {
         ref_count++;
-        if (ref_count == 1) {
-            if (pulse_when_ref_count_becomes_nonzero) {
-                pulse_when_ref_count_becomes_nonzero->
-                    pulse_if_not_already_pulsed();
-            }
-        }
     }
     void release() {
         ref_count--;
         if (ref_count == 0) {
+            last_release = get_ticks();
             if (pulse_when_ref_count_becomes_zero) {
                 pulse_when_ref_count_becomes_zero->
                     pulse_if_not_already_pulsed();
@@ -43,8 +42,8 @@ public:
 
     promise_t<namespace_interface_t *> namespace_interface;
     int ref_count;
+    ticks_t last_release;
     cond_t *pulse_when_ref_count_becomes_zero;
-    cond_t *pulse_when_ref_count_becomes_nonzero;
 };
 
 namespace_repo_t::namespace_repo_t(
@@ -65,17 +64,9 @@ namespace_repo_t::namespace_repo_t(
 
 namespace_repo_t::~namespace_repo_t() { }
 
-void copy_region_maps_to_thread(
-        const std::map<namespace_id_t, std::map<key_range_t, server_id_t> > &from,
-        one_per_thread_t<std::map<namespace_id_t, std::map<key_range_t, server_id_t> > > *to,
-        int thread, UNUSED auto_drainer_t::lock_t keepalive) {
-    on_thread_t th((threadnum_t(thread)));
-    *to->get() = from;
-}
-
-void namespace_repo_t::on_namespaces_change(auto_drainer_t::lock_t keepalive) {
+void namespace_repo_t::on_namespaces_change(UNUSED auto_drainer_t::lock_t keepalive) {
     ASSERT_NO_CORO_WAITING;
-    std::map<namespace_id_t, std::map<key_range_t, server_id_t> > new_reg_to_pri_maps;
+    region_to_primary_maps_t new_reg_to_pri_maps;
 
     namespaces_semilattice_metadata_t::namespace_map_t::const_iterator it;
     const namespaces_semilattice_metadata_t::namespace_map_t &ns = namespaces_view.get()->get().get()->namespaces;
@@ -90,13 +81,7 @@ void namespace_repo_t::on_namespaces_change(auto_drainer_t::lock_t keepalive) {
         }
     }
 
-    for (int thread = 0; thread < get_num_threads(); ++thread) {
-        coro_t::spawn_ordered(std::bind(&copy_region_maps_to_thread,
-                                        new_reg_to_pri_maps,
-                                        &region_to_primary_maps,
-                                        thread,
-                                        keepalive));
-    }
+    region_to_primary_maps.set(std::move(new_reg_to_pri_maps));
 }
 
 void namespace_repo_t::create_and_destroy_namespace_interface(
@@ -122,7 +107,7 @@ void namespace_repo_t::create_and_destroy_namespace_interface(
 
     cluster_namespace_interface_t namespace_interface(
         mailbox_manager,
-        region_to_primary_maps.get(),
+        &region_to_primary_maps,
         cross_thread_watchable.get_watchable(),
         namespace_id,
         ctx);
@@ -136,6 +121,7 @@ void namespace_repo_t::create_and_destroy_namespace_interface(
         cache_entry->namespace_interface.pulse(&namespace_interface);
 
         /* Wait until it's time to shut down */
+        const ticks_t expiration_ticks = NAMESPACE_INTERFACE_EXPIRATION_MS * MILLION;
         while (true) {
             while (cache_entry->ref_count != 0) {
                 cond_t ref_count_is_zero;
@@ -144,20 +130,14 @@ void namespace_repo_t::create_and_destroy_namespace_interface(
                     &ref_count_is_zero);
                 wait_interruptible(&ref_count_is_zero, keepalive.get_drain_signal());
             }
-            signal_timer_t expiration_timer;
-            expiration_timer.start(NAMESPACE_INTERFACE_EXPIRATION_MS);
-            cond_t ref_count_is_nonzero;
-            assignment_sentry_t<cond_t *> notify_if_ref_count_becomes_nonzero(
-                &cache_entry->pulse_when_ref_count_becomes_nonzero,
-                &ref_count_is_nonzero);
-            wait_any_t waiter(&expiration_timer, &ref_count_is_nonzero);
-            wait_interruptible(&waiter, keepalive.get_drain_signal());
-            if (!ref_count_is_nonzero.is_pulsed()) {
-                guarantee(cache_entry->ref_count == 0);
-                /* We waited a whole `NAMESPACE_INTERFACE_EXPIRATION_MS` and
-                nothing used us. So let's destroy ourselves. */
+            const ticks_t unused_for = get_ticks() - cache_entry->last_release;
+            if (unused_for >= expiration_ticks) {
+                /* Nothing used us for a whole `NAMESPACE_INTERFACE_EXPIRATION_MS`.
+                So let's destroy ourselves. */
                 break;
             }
+            nap((expiration_ticks - unused_for + MILLION - 1) / MILLION,
+                keepalive.get_drain_signal());
         }
 
     } catch (const interrupted_exc_t &) {
@@ -185,11 +165,12 @@ namespace_interface_access_t namespace_repo_t::get_namespace_interface(
     {
         ASSERT_FINITE_CORO_WAITING;
         namespace_cache_t *cache = namespace_caches.get();
-        if (cache->entries.find(ns_id) == cache->entries.end()) {
+        auto it = cache->entries.find(ns_id);
+        if (it == cache->entries.end()) {
             cache_entry = new namespace_cache_entry_t;
             cache_entry->ref_count = 0;
+            cache_entry->last_release = get_ticks();
             cache_entry->pulse_when_ref_count_becomes_zero = NULL;
-            cache_entry->pulse_when_ref_count_becomes_nonzero = NULL;
 
             namespace_id_t id(ns_id);
             cache->entries.insert(std::make_pair(id,
@@ -200,10 +181,15 @@ namespace_interface_access_t namespace_repo_t::get_namespace_interface(
                 cache, ns_id,
                 auto_drainer_t::lock_t(&cache->drainer)));
         } else {
-            cache_entry = cache->entries[ns_id].get();
+            cache_entry = it->second.get();
         }
     }
-    wait_interruptible(cache_entry->namespace_interface.get_ready_signal(), interruptor);
+    /* Once the interface is ready this doesn't block, so a query on a thread that
+    already has it touches no other thread. */
+    if (!cache_entry->namespace_interface.get_ready_signal()->is_pulsed()) {
+        wait_interruptible(cache_entry->namespace_interface.get_ready_signal(),
+                           interruptor);
+    }
     return namespace_interface_access_t(
         cache_entry->namespace_interface.wait(),
         cache_entry,
@@ -10,6 +10,7 @@
 #include "concurrency/promise.hpp"
 #include "containers/clone_ptr.hpp"
 #include "containers/incremental_lenses.hpp"
+#include "clustering/reactor/namespace_interface.hpp"
 #include "rdb_protocol/real_table.hpp"
 #include "rpc/semilattice/view.hpp"
 
@@ -57,8 +58,7 @@ private:
                     namespace_directory_metadata_t> *directory;
     rdb_context_t *ctx;
 
-    one_per_thread_t<std::map<namespace_id_t, std::map<key_range_t, server_id_t> > >
-        region_to_primary_maps;
+    read_mostly_t<region_to_primary_maps_t> region_to_primary_maps;
 
     one_per_thread_t<namespace_cache_t> namespace_caches;
 
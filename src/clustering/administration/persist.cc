@@ -5,6 +5,8 @@
 #include <sys/types.h>
 
 #include <functional>
+#include <utility>
+#include <vector>
 
 #include "errors.hpp"
 #include <boost/bind.hpp>
@@ -104,6 +106,11 @@ cluster_version_t auth_superblock_version(const auth_metadata_superblock_t *sb)
 
 // This only takes a cluster_version_t parameter to get people thinking -- you have
 // to use LATEST_DISK.
+//
+// The blob at `ref` must hold a value already (maybe an empty one, as a zeroed ref
+// does).  Rather than being rebuilt, it's resized and only the leaf blocks whose
+// bytes change get written, so a change to one table or database writes a few
+// blocks of the metadata instead of all of it.
 template <cluster_version_t W, class T>
 static void write_blob(buf_parent_t parent, char *ref, int maxreflen,
                        const T &value) {
@@ -124,10 +131,42 @@ static void write_blob(buf_parent_t parent, char *ref, int maxreflen,
     }
     guarantee(str.size() == slen);
     blob_t blob(parent.cache()->max_block_size(), ref, maxreflen);
-    blob.clear(parent);
-    blob.append_region(parent, str.size());
-    blob.write_from_string(str, parent, 0);
-    guarantee(blob.valuesize() == static_cast<int64_t>(slen));
+    const int64_t old_size = blob.valuesize();
+    const int64_t new_size = slen;
+    if (old_size > new_size) {
+        blob.unappend_region(parent, old_size - new_size);
+    } else if (old_size < new_size) {
+        blob.append_region(parent, new_size - old_size);
+    }
+    guarantee(blob.valuesize() == new_size);
+
+    // The `(offset, size)` ranges of the blob that change, a leaf block at a time.
+    // What `append_region` just added is compared like the rest; it's rare enough
+    // that it doesn't matter that it gets read.
+    std::vector<std::pair<int64_t, int64_t> > changed;
+    {
+        buffer_group_t group;
+        blob_acq_t acq;
+        blob.expose_all(parent, access_t::read, &group, &acq);
+        int64_t offset = 0;
+        for (size_t i = 0; i < group.num_buffers(); ++i) {
+            const buffer_group_t::buffer_t buffer = group.get_buffer(i);
+            if (memcmp(buffer.data, str.data() + offset, buffer.size) != 0) {
+                if (!changed.empty()
+                    && changed.back().first + changed.back().second == offset) {
+                    changed.back().second += buffer.size;
+                } else {
+                    changed.push_back(std::make_pair(offset, buffer.size));
+                }
+            }
+            offset += buffer.size;
+        }
+        guarantee(offset == new_size);
+    }
+    for (const auto &range : changed) {
+        blob.write_from_string(str.substr(range.first, range.second),
+                               parent, range.first);
+    }
 }
 
 static void read_blob(buf_parent_t parent, const char *ref, int maxreflen,
@@ -452,6 +452,16 @@ namespace_semilattice_metadata_t migrate_table(
         repli_info.config.durability = write_durability_t::HARD;
     }
 
+    /* Tables created before 1.16 all used the default block size, and didn't
+    compress their blocks. */
+    repli_info.config.block_size = DEFAULT_BTREE_BLOCK_SIZE;
+    repli_info.config.compress_blocks = false;
+    repli_info.config.cache_reservation = DEFAULT_TABLE_CACHE_RESERVATION;
+    repli_info.config.cache_weight = DEFAULT_TABLE_CACHE_WEIGHT;
+    repli_info.config.io_weight = DEFAULT_TABLE_IO_WEIGHT;
+    repli_info.config.soft_flush_delay = DEFAULT_TABLE_SOFT_FLUSH_DELAY_MS;
+    repli_info.config.index_build_rate = DEFAULT_TABLE_INDEX_BUILD_RATE;
+
     /* Write `repli_info` back to `new_md`, wrapped in a `versioned_t` */
     new_md.replication_info =
         versioned_t<table_replication_info_t>::make_with_manual_timestamp(
@@ -1,6 +1,7 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "clustering/administration/reactor_driver.hpp"
 
+#include <algorithm>
 #include <map>
 #include <set>
 #include <utility>
@@ -8,6 +9,7 @@
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
+#include "buffer_cache/alt.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "clustering/administration/perfmon_collection_repo.hpp"
 #include "clustering/administration/servers/server_id_to_peer_id.hpp"
@@ -15,6 +17,8 @@
 #include "clustering/reactor/blueprint.hpp"
 #include "clustering/reactor/reactor.hpp"
 #include "concurrency/cross_thread_watchable.hpp"
+#include "concurrency/new_mutex.hpp"
+#include "concurrency/pmap.hpp"
 #include "concurrency/watchable.hpp"
 #include "containers/incremental_lenses.hpp"
 #include "rdb_protocol/store.hpp"
@@ -104,6 +108,28 @@ stores_lifetimer_t::sindex_jobs_t stores_lifetimer_t::get_sindex_jobs() const {
     return sindex_jobs;
 }
 
+stores_lifetimer_t::compaction_jobs_t stores_lifetimer_t::get_compaction_jobs() const {
+    stores_lifetimer_t::compaction_jobs_t compaction_jobs;
+
+    if (stores_.has()) {
+        for (size_t i = 0; i < stores_.size(); ++i) {
+            if (stores_[i].has()) {
+                microtime_t start_time = stores_[i]->get_compaction_start_time();
+                if (start_time == 0) {
+                    continue;
+                }
+                auto res = compaction_jobs.insert(
+                    std::make_pair(stores_[i]->get_table_id(), start_time));
+                if (!res.second) {
+                    res.first->second = std::min(res.first->second, start_time);
+                }
+            }
+        }
+    }
+
+    return compaction_jobs;
+}
+
 /* If the config refers to a server name for which there are multiple servers, we don't
 update the blueprint until the conflict is resolved. */
 class server_name_collision_exc_t : public std::exception {
@@ -222,6 +248,17 @@ blueprint_t construct_blueprint(const table_replication_info_t &info,
     return blueprint;
 }
 
+class write_ack_counter_t : public ack_counter_t {
+public:
+    explicit write_ack_counter_t(const write_ack_config_checker_t &checker)
+        : counter(checker) { }
+    bool note_ack(const server_id_t &server) {
+        return counter.note_ack(server);
+    }
+private:
+    write_ack_config_checker_t::counter_t counter;
+};
+
 /* This is in part because these types aren't copyable so they can't go in
  * a std::pair. This class is used to hold a reactor and a watchable that
  * it's watching. */
@@ -244,12 +281,21 @@ public:
         parent_(parent),
         namespace_id_(namespace_id),
         svs_by_namespace_(svs_by_namespace),
+        block_size_(repli_info.config.block_size),
+        compress_blocks_(repli_info.config.compress_blocks),
+        cache_reservation_(repli_info.config.cache_reservation),
+        cache_weight_(repli_info.config.cache_weight),
+        io_weight_(repli_info.config.io_weight),
+        soft_flush_delay_(repli_info.config.soft_flush_delay),
+        index_build_rate_(repli_info.config.index_build_rate),
         write_ack_config_var(write_ack_config_checker_t(repli_info.config, server_md)),
         write_durability_var(repli_info.config.durability),
         write_ack_config_cross_threader(write_ack_config_var.get_watchable()),
         write_durability_cross_threader(write_durability_var.get_watchable())
     {
         coro_t::spawn_sometime(boost::bind(&watchable_and_reactor_t::initialize_reactor, this, io_backender));
+        coro_t::spawn_sometime(boost::bind(
+            &watchable_and_reactor_t::apply_priority, this, drainer_.lock()));
     }
 
     ~watchable_and_reactor_t() {
@@ -284,6 +330,19 @@ public:
         write_ack_config_var.set_value_no_equals(
             write_ack_config_checker_t(repli_info.config, server_md));
         write_durability_var.set_value(repli_info.config.durability);
+        if (repli_info.config.cache_reservation != cache_reservation_
+                || repli_info.config.cache_weight != cache_weight_
+                || repli_info.config.io_weight != io_weight_
+                || repli_info.config.soft_flush_delay != soft_flush_delay_
+                || repli_info.config.index_build_rate != index_build_rate_) {
+            cache_reservation_ = repli_info.config.cache_reservation;
+            cache_weight_ = repli_info.config.cache_weight;
+            io_weight_ = repli_info.config.io_weight;
+            soft_flush_delay_ = repli_info.config.soft_flush_delay;
+            index_build_rate_ = repli_info.config.index_build_rate;
+            coro_t::spawn_sometime(boost::bind(
+                &watchable_and_reactor_t::apply_priority, this, drainer_.lock()));
+        }
     }
 
     bool is_acceptable_ack_set(const std::set<server_id_t> &acks) const {
@@ -295,6 +354,15 @@ public:
         return ok;
     }
 
+    scoped_ptr_t<ack_counter_t> make_ack_counter() const {
+        scoped_ptr_t<ack_counter_t> counter;
+        write_ack_config_cross_threader.get_watchable()->apply_read(
+            [&](const write_ack_config_checker_t *checker) {
+                counter.init(new write_ack_counter_t(*checker));
+            });
+        return counter;
+    }
+
     write_durability_t get_write_durability() const {
         return write_durability_cross_threader.get_watchable()->get();
     }
@@ -307,6 +375,10 @@ public:
         return stores_lifetimer_.get_sindex_jobs();
     }
 
+    stores_lifetimer_t::compaction_jobs_t get_compaction_jobs() const {
+        return stores_lifetimer_.get_compaction_jobs();
+    }
+
     typedef std::map<std::pair<namespace_id_t, region_t>, reactor_progress_report_t>
         backfill_progress_t;
     backfill_progress_t get_backfill_progress() const {
@@ -330,7 +402,8 @@ private:
         perfmon_collection_t *serializers_collection = &perfmon_collections->serializers_collection;
 
         // TODO: We probably shouldn't have to pass in this perfmon collection.
-        svs_by_namespace_->get_svs(serializers_collection, namespace_id_, &stores_lifetimer_, &svs_, ctx);
+        svs_by_namespace_->get_svs(serializers_collection, namespace_id_, block_size_,
+                                   compress_blocks_, &stores_lifetimer_, &svs_, ctx);
 
         reactor_.init(new reactor_t(
             base_path,
@@ -358,6 +431,41 @@ private:
         reactor_has_been_initialized_.pulse();
     }
 
+    /* Passes `cache_reservation_` and `cache_weight_` on to the caches of the table's
+    stores on this server, which split the reservation between them, and also
+    `soft_flush_delay_`, and passes `io_weight_` on to the stores' serializers. The
+    stores split `index_build_rate_` between them too. */
+    void apply_priority(auto_drainer_t::lock_t keepalive) {
+        /* The mutex keeps an older setting from being applied after a newer one. */
+        new_mutex_in_line_t mutex_lock(&priority_mutex_);
+        try {
+            wait_interruptible(&reactor_has_been_initialized_,
+                               keepalive.get_drain_signal());
+            wait_interruptible(mutex_lock.acq_signal(), keepalive.get_drain_signal());
+        } catch (const interrupted_exc_t &) {
+            return;
+        }
+        scoped_array_t<scoped_ptr_t<store_t> > *stores = stores_lifetimer_.stores();
+        const uint64_t reservation_per_store =
+            stores->size() == 0 ? 0 : cache_reservation_ / stores->size();
+        const double weight = cache_weight_;
+        const double io_weight = io_weight_;
+        const uint32_t soft_flush_delay = soft_flush_delay_;
+        /* A limit must not turn into no limit when it's split. */
+        const uint64_t index_build_rate_per_store =
+            index_build_rate_ == 0 || stores->size() == 0
+                ? index_build_rate_
+                : std::max<uint64_t>(1, index_build_rate_ / stores->size());
+        pmap(stores->size(), [&](size_t i) {
+            store_t *store = (*stores)[i].get();
+            on_thread_t thread_switcher(store->home_thread());
+            store->cache->set_memory_priority(reservation_per_store, weight);
+            store->cache->set_soft_flush_delay(soft_flush_delay);
+            store->cache->set_io_weight(io_weight);
+            store->set_index_build_rate(index_build_rate_per_store);
+        });
+    }
+
     table_directory_converter_t table_directory;
     const base_path_t base_path;
     cond_t reactor_has_been_initialized_;
@@ -367,6 +475,17 @@ private:
     reactor_driver_t *const parent_;
     const namespace_id_t namespace_id_;
     svs_by_namespace_t *const svs_by_namespace_;
+    /* These are only used if the table's files don't exist yet, so there's no need
+    to update them in `update_repli_info()`. */
+    const uint32_t block_size_;
+    const bool compress_blocks_;
+
+    uint64_t cache_reservation_;
+    double cache_weight_;
+    double io_weight_;
+    uint32_t soft_flush_delay_;
+    uint64_t index_build_rate_;
+    new_mutex_t priority_mutex_;
 
     watchable_variable_t<write_ack_config_checker_t> write_ack_config_var;
     watchable_variable_t<write_durability_t> write_durability_var;
@@ -382,6 +501,10 @@ private:
     scoped_ptr_t<watchable_map_entry_copier_t<
         namespace_id_t, namespace_directory_metadata_t> > directory_exporter_;
 
+    /* This must be destroyed before `stores_lifetimer_`, since
+    `apply_priority()` uses the stores. */
+    auto_drainer_t drainer_;
+
     DISABLE_COPYING(watchable_and_reactor_t);
 };
 
@@ -469,6 +592,22 @@ reactor_driver_t::sindex_jobs_t reactor_driver_t::get_sindex_jobs() {
     return sindex_jobs;
 }
 
+reactor_driver_t::compaction_jobs_t reactor_driver_t::get_compaction_jobs() {
+    rwlock_acq_t lock(&reactor_data_rwlock, access_t::read);
+
+    reactor_driver_t::compaction_jobs_t compaction_jobs;
+
+    for (auto const &reactor : reactor_data) {
+        if (reactor.second.has()) {
+            auto reactor_compaction_jobs = reactor.second->get_compaction_jobs();
+            compaction_jobs.insert(reactor_compaction_jobs.begin(),
+                                   reactor_compaction_jobs.end());
+        }
+    }
+
+    return compaction_jobs;
+}
+
 reactor_driver_t::backfill_progress_t reactor_driver_t::get_backfill_progress() {
     rwlock_acq_t lock(&reactor_data_rwlock, access_t::read);
 
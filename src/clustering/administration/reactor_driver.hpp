@@ -70,6 +70,10 @@ public:
     typedef std::multimap<std::pair<uuid_u, std::string>, microtime_t> sindex_jobs_t;
     sindex_jobs_t get_sindex_jobs() const;
 
+    // Maps the table to when the earliest of its stores' compactions started.
+    typedef std::map<namespace_id_t, microtime_t> compaction_jobs_t;
+    compaction_jobs_t get_compaction_jobs() const;
+
 private:
     scoped_ptr_t<serializer_t> serializer_;
     scoped_ptr_t<serializer_multiplexer_t> multiplexer_;
@@ -80,7 +84,10 @@ private:
 
 class svs_by_namespace_t {
 public:
+    /* `block_size` and `compress_blocks` configure the serializer if the table's
+    files have to be created. */
     virtual void get_svs(perfmon_collection_t *perfmon_collection, namespace_id_t namespace_id,
+                         uint32_t block_size, bool compress_blocks,
                          stores_lifetimer_t *stores_out,
                          scoped_ptr_t<multistore_ptr_t> *svs_out,
                          rdb_context_t *) = 0;
@@ -123,6 +130,9 @@ public:
     typedef std::multimap<std::pair<uuid_u, std::string>, microtime_t> sindex_jobs_t;
     sindex_jobs_t get_sindex_jobs();
 
+    typedef std::map<namespace_id_t, microtime_t> compaction_jobs_t;
+    compaction_jobs_t get_compaction_jobs();
+
     typedef std::map<std::pair<namespace_id_t, region_t>, reactor_progress_report_t>
         backfill_progress_t;
     backfill_progress_t get_backfill_progress();
@@ -59,6 +59,89 @@ real_reql_cluster_interface_t::real_reql_cluster_interface_t(
                     (new semilattice_watchable_t<databases_semilattice_metadata_t>(
                         metadata_field(&cluster_semilattice_metadata_t::databases, semilattice_root_view))), threadnum_t(thr)));
     }
+    name_caches.init(new one_per_thread_t<name_cache_t>(this));
+}
+
+real_reql_cluster_interface_t::name_cache_t::name_cache_t(
+        real_reql_cluster_interface_t *_parent)
+    : parent(_parent),
+      dbs_stale(true),
+      tables_stale(true),
+      dbs_subs([this]() { dbs_stale = true; }),
+      tables_subs([this]() { tables_stale = true; }) {
+    int threadnum = get_thread_id().threadnum;
+    clone_ptr_t<watchable_t<databases_semilattice_metadata_t> > dbs_watchable
+        = parent->cross_thread_database_watchables[threadnum]->get_watchable();
+    watchable_t<databases_semilattice_metadata_t>::freeze_t dbs_freeze(dbs_watchable);
+    dbs_subs.reset(dbs_watchable, &dbs_freeze);
+    clone_ptr_t<watchable_t<cow_ptr_t<namespaces_semilattice_metadata_t> > >
+        tables_watchable
+        = parent->cross_thread_namespace_watchables[threadnum]->get_watchable();
+    watchable_t<cow_ptr_t<namespaces_semilattice_metadata_t> >::freeze_t
+        tables_freeze(tables_watchable);
+    tables_subs.reset(tables_watchable, &tables_freeze);
+}
+
+bool real_reql_cluster_interface_t::name_cache_t::find_db(
+        const name_string_t &name, database_id_t *id_out, std::string *error_out) {
+    if (dbs_stale) {
+        databases_semilattice_metadata_t db_metadata;
+        parent->get_databases_metadata(&db_metadata);
+        dbs.clear();
+        for (const auto &pair : db_metadata.databases) {
+            if (!pair.second.is_deleted()) {
+                dbs.insert(std::make_pair(pair.second.get_ref().name.get_ref(),
+                                          pair.first));
+            }
+        }
+        dbs_stale = false;
+    }
+    // The same errors as `search_db_metadata_by_name()`'s.
+    auto range = dbs.equal_range(name);
+    if (range.first == range.second) {
+        *error_out = strprintf("Database `%s` does not exist.", name.c_str());
+        return false;
+    } else if (std::next(range.first) != range.second) {
+        *error_out = strprintf("Database `%s` is ambiguous; there are multiple "
+            "databases with that name.", name.c_str());
+        return false;
+    }
+    *id_out = range.first->second;
+    return true;
+}
+
+bool real_reql_cluster_interface_t::name_cache_t::find_table(
+        const database_id_t &db_id, const name_string_t &db_name,
+        const name_string_t &name, namespace_id_t *id_out,
+        std::string *primary_key_out, std::string *error_out) {
+    if (tables_stale) {
+        cow_ptr_t<namespaces_semilattice_metadata_t> ns_metadata
+            = parent->get_namespaces_metadata();
+        tables.clear();
+        for (const auto &pair : ns_metadata->namespaces) {
+            if (!pair.second.is_deleted()) {
+                const namespace_semilattice_metadata_t &table = pair.second.get_ref();
+                tables.insert(std::make_pair(
+                    std::make_pair(table.database.get_ref(), table.name.get_ref()),
+                    std::make_pair(pair.first, table.primary_key.get_ref())));
+            }
+        }
+        tables_stale = false;
+    }
+    // The same errors as `search_table_metadata_by_name()`'s.
+    auto range = tables.equal_range(std::make_pair(db_id, name));
+    if (range.first == range.second) {
+        *error_out = strprintf("Table `%s.%s` does not exist.",
+            db_name.c_str(), name.c_str());
+        return false;
+    } else if (std::next(range.first) != range.second) {
+        *error_out = strprintf("Table `%s.%s` is ambiguous; there are multiple "
+            "tables with that name in that database.", db_name.c_str(), name.c_str());
+        return false;
+    }
+    *id_out = range.first->second.first;
+    *primary_key_out = range.first->second.second;
+    return true;
 }
 
 bool real_reql_cluster_interface_t::db_create(const name_string_t &name,
@@ -167,10 +250,8 @@ bool real_reql_cluster_interface_t::db_find(const name_string_t &name,
     guarantee(name != name_string_t::guarantee_valid("rethinkdb"),
         "real_reql_cluster_interface_t should never get queries for system tables");
     /* Find the specified database */
-    databases_semilattice_metadata_t db_metadata;
-    get_databases_metadata(&db_metadata);
     database_id_t db_id;
-    if (!search_db_metadata_by_name(db_metadata, name, &db_id, error_out)) {
+    if (!name_caches->get()->find_db(name, &db_id, error_out)) {
         return false;
     }
     *db_out = make_counted<const ql::db_t>(db_id, name);
@@ -192,7 +273,7 @@ bool real_reql_cluster_interface_t::db_config(
 bool real_reql_cluster_interface_t::table_create(const name_string_t &name,
         counted_t<const ql::db_t> db,
         const table_generate_config_params_t &config_params,
-        const std::string &primary_key,
+        const std::string &primary_key, uint32_t block_size, bool compress_blocks,
         signal_t *interruptor, ql::datum_t *result_out, std::string *error_out) {
     guarantee(db->name != name_string_t::guarantee_valid("rethinkdb"),
         "real_reql_cluster_interface_t should never get queries for system tables");
@@ -247,6 +328,13 @@ bool real_reql_cluster_interface_t::table_create(const name_string_t &name,
 
         repli_info.config.write_ack_config.mode = write_ack_config_t::mode_t::majority;
         repli_info.config.durability = write_durability_t::HARD;
+        repli_info.config.block_size = block_size;
+        repli_info.config.compress_blocks = compress_blocks;
+        repli_info.config.cache_reservation = DEFAULT_TABLE_CACHE_RESERVATION;
+        repli_info.config.cache_weight = DEFAULT_TABLE_CACHE_WEIGHT;
+        repli_info.config.io_weight = DEFAULT_TABLE_IO_WEIGHT;
+        repli_info.config.soft_flush_delay = DEFAULT_TABLE_SOFT_FLUSH_DELAY_MS;
+        repli_info.config.index_build_rate = DEFAULT_TABLE_INDEX_BUILD_RATE;
 
         namespace_semilattice_metadata_t table_metadata;
         table_metadata.name = versioned_t<name_string_t>(name);
@@ -369,11 +457,10 @@ bool real_reql_cluster_interface_t::table_find(
     guarantee(db->name != name_string_t::guarantee_valid("rethinkdb"),
         "real_reql_cluster_interface_t should never get queries for system tables");
     /* Find the specified table in the semilattice metadata */
-    cow_ptr_t<namespaces_semilattice_metadata_t> namespaces_metadata
-        = get_namespaces_metadata();
     namespace_id_t table_id;
-    if (!search_table_metadata_by_name(*namespaces_metadata, db->id, db->name, name,
-            &table_id, error_out)) {
+    std::string primary_key;
+    if (!name_caches->get()->find_table(db->id, db->name, name,
+            &table_id, &primary_key, error_out)) {
         return false;
     }
 
@@ -386,7 +473,7 @@ bool real_reql_cluster_interface_t::table_find(
     table_out->reset(new real_table_t(
         table_id,
         namespace_repo.get_namespace_interface(table_id, interruptor),
-        namespaces_metadata->namespaces.at(table_id).get_ref().primary_key.get_ref(),
+        primary_key,
         &changefeed_client));
 
     return true;
@@ -734,6 +821,23 @@ bool real_reql_cluster_interface_t::reconfigure_internal(
 
     new_repli_info.config.write_ack_config.mode = write_ack_config_t::mode_t::majority;
     new_repli_info.config.durability = write_durability_t::HARD;
+    /* The servers' files for the table already have their block size and
+    compression */
+    new_repli_info.config.block_size =
+        table_md->replication_info.get_ref().config.block_size;
+    new_repli_info.config.compress_blocks =
+        table_md->replication_info.get_ref().config.compress_blocks;
+    /* Reconfiguring doesn't change how the table shares the cache and the disk */
+    new_repli_info.config.cache_reservation =
+        table_md->replication_info.get_ref().config.cache_reservation;
+    new_repli_info.config.cache_weight =
+        table_md->replication_info.get_ref().config.cache_weight;
+    new_repli_info.config.io_weight =
+        table_md->replication_info.get_ref().config.io_weight;
+    new_repli_info.config.soft_flush_delay =
+        table_md->replication_info.get_ref().config.soft_flush_delay;
+    new_repli_info.config.index_build_rate =
+        table_md->replication_info.get_ref().config.index_build_rate;
 
     if (!dry_run) {
         /* Commit the change */
@@ -2,12 +2,15 @@
 #ifndef CLUSTERING_ADMINISTRATION_REAL_REQL_CLUSTER_INTERFACE_HPP_
 #define CLUSTERING_ADMINISTRATION_REAL_REQL_CLUSTER_INTERFACE_HPP_
 
+#include <map>
 #include <set>
 #include <string>
+#include <utility>
 
 #include "clustering/administration/metadata.hpp"
 #include "clustering/administration/namespace_interface_repository.hpp"
 #include "concurrency/cross_thread_watchable.hpp"
+#include "concurrency/one_per_thread.hpp"
 #include "concurrency/watchable.hpp"
 #include "rdb_protocol/context.hpp"
 #include "rpc/semilattice/view.hpp"
@@ -53,8 +56,8 @@ public:
 
     bool table_create(const name_string_t &name, counted_t<const ql::db_t> db,
             const table_generate_config_params_t &config_params,
-            const std::string &primary_key, signal_t *interruptor,
-            ql::datum_t *result_out, std::string *error_out);
+            const std::string &primary_key, uint32_t block_size, bool compress_blocks,
+            signal_t *interruptor, ql::datum_t *result_out, std::string *error_out);
     bool table_drop(const name_string_t &name, counted_t<const ql::db_t> db,
             signal_t *interruptor, ql::datum_t *result_out, std::string *error_out);
     bool table_list(counted_t<const ql::db_t> db,
@@ -147,6 +150,33 @@ private:
         namespaces_semilattice_metadata_t> > > > cross_thread_namespace_watchables;
     scoped_array_t< scoped_ptr_t< cross_thread_watchable_variable_t<
         databases_semilattice_metadata_t > > > cross_thread_database_watchables;
+
+    /* The ids of the databases and tables with each name in this thread's copy of
+    the metadata, so that `db_find()` and `table_find()` don't have to copy or scan
+    all of it for every query. An index is rebuilt the first time it's used after
+    the metadata it came from changes. */
+    class name_cache_t {
+    public:
+        explicit name_cache_t(real_reql_cluster_interface_t *parent);
+        bool find_db(const name_string_t &name,
+                     database_id_t *id_out, std::string *error_out);
+        bool find_table(const database_id_t &db_id, const name_string_t &db_name,
+                        const name_string_t &name, namespace_id_t *id_out,
+                        std::string *primary_key_out, std::string *error_out);
+    private:
+        real_reql_cluster_interface_t *parent;
+        bool dbs_stale;
+        std::multimap<name_string_t, database_id_t> dbs;
+        bool tables_stale;
+        std::multimap<std::pair<database_id_t, name_string_t>,
+                      std::pair<namespace_id_t, std::string> > tables;
+        watchable_t<databases_semilattice_metadata_t>::subscription_t dbs_subs;
+        watchable_t<cow_ptr_t<namespaces_semilattice_metadata_t> >::subscription_t
+            tables_subs;
+        DISABLE_COPYING(name_cache_t);
+    };
+    // Initialized after the watchables it subscribes to.
+    scoped_ptr_t<one_per_thread_t<name_cache_t> > name_caches;
     rdb_context_t *rdb_context;
 
     namespace_repo_t namespace_repo;
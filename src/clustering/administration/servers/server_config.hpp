@@ -33,6 +33,10 @@ public:
             std::string *error_out);
 
 private:
+    /* The rows only depend on `servers_sl_view`, which calls `notify_all()`. (Unlike
+    `server_status`, which also reports connection state.) */
+    bool notifications_are_complete() { return true; }
+
     bool format_row(
             name_string_t const & name,
             server_id_t const & server_id,
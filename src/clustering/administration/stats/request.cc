@@ -33,7 +33,8 @@ const char *table_server_stats_request_t::table_server_request_type = "table_ser
 parsed_stats_t::server_stats_t::server_stats_t() :
     responsive(false),
     queries_per_sec(0), queries_total(0),
-    client_connections(0), clients_active(0) { }
+    client_connections(0), clients_active(0),
+    queries_queued(0), queries_refused_total(0) { }
 
 parsed_stats_t::table_stats_t::table_stats_t() :
     read_docs_per_sec(0), read_docs_total(0),
@@ -156,6 +157,43 @@ void parsed_stats_t::store_serializer_values(const ql::datum_t &ser_perf,
     stats_out->metadata_bytes *= DEFAULT_EXTENT_SIZE;
     stats_out->preallocated_bytes -= stats_out->data_bytes +
         stats_out->garbage_bytes + stats_out->metadata_bytes;
+
+    store_latency_value(ser_perf, "serializer_disk_read_latency",
+                        &stats_out->read_latency);
+    store_latency_value(ser_perf, "serializer_disk_write_latency",
+                        &stats_out->write_latency);
+    store_latency_value(ser_perf, "serializer_disk_datasync_latency",
+                        &stats_out->datasync_latency);
+    store_latency_value(ser_perf, "serializer_index_write_latency",
+                        &stats_out->flush_latency);
+}
+
+void parsed_stats_t::store_latency_value(const ql::datum_t &perf,
+                                         const std::string &key,
+                                         ql::datum_t *value_out) {
+    ql::datum_t v = perf.get_field(key.c_str(), ql::throw_bool_t::NOTHROW);
+    if (!v.has()) {
+        return;
+    }
+    r_sanity_check(v.get_type() == ql::datum_t::R_OBJECT);
+    ql::datum_object_builder_t builder;
+    for (const char *field : { "p50", "p99", "p999" }) {
+        ql::datum_t percentile = v.get_field(field, ql::throw_bool_t::NOTHROW);
+        builder.overwrite(field, percentile.has() ? percentile : ql::datum_t::null());
+    }
+    *value_out = std::move(builder).to_datum();
+}
+
+// Latencies that the server didn't report are shown as missing percentiles.
+ql::datum_t latency_value_to_datum(const ql::datum_t &latency) {
+    if (latency.has()) {
+        return latency;
+    }
+    ql::datum_object_builder_t builder;
+    for (const char *field : { "p50", "p99", "p999" }) {
+        builder.overwrite(field, ql::datum_t::null());
+    }
+    return std::move(builder).to_datum();
 }
 
 void parsed_stats_t::store_query_engine_stats(const ql::datum_t &qe_perf,
@@ -165,6 +203,10 @@ void parsed_stats_t::store_query_engine_stats(const ql::datum_t &qe_perf,
     store_perfmon_value(qe_perf, "queries_total", &stats_out->queries_total);
     store_perfmon_value(qe_perf, "client_connections", &stats_out->client_connections);
     store_perfmon_value(qe_perf, "clients_active", &stats_out->clients_active);
+    store_perfmon_value(qe_perf, "queries_queued", &stats_out->queries_queued);
+    store_perfmon_value(qe_perf, "queries_refused_total",
+                        &stats_out->queries_refused_total);
+    store_latency_value(qe_perf, "query_latency", &stats_out->query_latency);
 }
 
 void parsed_stats_t::store_table_stats(const namespace_id_t &table_id,
@@ -311,6 +353,7 @@ bool cluster_stats_request_t::to_datum(const parsed_stats_t &stats,
     ADD_CLUSTER_SERVER_STAT(qe_builder, stats, queries_per_sec);
     ADD_CLUSTER_SERVER_STAT(qe_builder, stats, client_connections);
     ADD_CLUSTER_SERVER_STAT(qe_builder, stats, clients_active);
+    ADD_CLUSTER_SERVER_STAT(qe_builder, stats, queries_queued);
     ADD_CLUSTER_TABLE_STAT(qe_builder, stats, read_docs_per_sec);
     ADD_CLUSTER_TABLE_STAT(qe_builder, stats, written_docs_per_sec);
     row_builder.overwrite("query_engine", std::move(qe_builder).to_datum());
@@ -462,6 +505,10 @@ bool server_stats_request_t::to_datum(const parsed_stats_t &stats,
         ADD_STAT(qe_builder, server_stats, clients_active);
         ADD_STAT(qe_builder, server_stats, queries_per_sec);
         ADD_STAT(qe_builder, server_stats, queries_total);
+        ADD_STAT(qe_builder, server_stats, queries_queued);
+        ADD_STAT(qe_builder, server_stats, queries_refused_total);
+        qe_builder.overwrite("query_latency",
+            latency_value_to_datum(server_stats.query_latency));
         ADD_SERVER_STAT(qe_builder, stats, server_id, read_docs_per_sec);
         ADD_SERVER_STAT(qe_builder, stats, server_id, read_docs_total);
         ADD_SERVER_STAT(qe_builder, stats, server_id, written_docs_per_sec);
@@ -584,6 +631,14 @@ bool table_server_stats_request_t::to_datum(const parsed_stats_t &stats,
         ADD_STAT(se_disk_builder, table_stats, read_bytes_total);
         ADD_STAT(se_disk_builder, table_stats, written_bytes_per_sec);
         ADD_STAT(se_disk_builder, table_stats, written_bytes_total);
+        se_disk_builder.overwrite("read_latency",
+            latency_value_to_datum(table_stats.read_latency));
+        se_disk_builder.overwrite("write_latency",
+            latency_value_to_datum(table_stats.write_latency));
+        se_disk_builder.overwrite("datasync_latency",
+            latency_value_to_datum(table_stats.datasync_latency));
+        se_disk_builder.overwrite("flush_latency",
+            latency_value_to_datum(table_stats.flush_latency));
         se_disk_builder.overwrite("space_usage", std::move(se_disk_space_builder).to_datum());
 
         ql::datum_object_builder_t se_builder;
@@ -35,6 +35,13 @@ public:
         double read_bytes_total;
         double written_bytes_per_sec;
         double written_bytes_total;
+
+        // Latency percentiles of the table's file on one server, so these aren't
+        // accumulated.  They're empty if the server didn't report them.
+        ql::datum_t read_latency;
+        ql::datum_t write_latency;
+        ql::datum_t datasync_latency;
+        ql::datum_t flush_latency;
     };
 
     struct server_stats_t {
@@ -45,6 +52,10 @@ public:
         double queries_total;
         double client_connections;
         double clients_active;
+        double queries_queued;
+        double queries_refused_total;
+        // Not accumulated either, for the same reason as the table latencies.
+        ql::datum_t query_latency;
 
         std::map<namespace_id_t, table_stats_t> tables;
     };
@@ -86,6 +97,11 @@ private:
     void store_serializer_values(const ql::datum_t &ser_perf,
                                  table_stats_t *);
 
+    // Stores the percentiles of a latency histogram stat.
+    void store_latency_value(const ql::datum_t &perf,
+                             const std::string &key,
+                             ql::datum_t *value_out);
+
     void store_query_engine_stats(const ql::datum_t &qe_perf,
                                   server_stats_t *stats_out);
 
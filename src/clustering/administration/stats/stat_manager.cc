@@ -13,6 +13,7 @@ stat_manager_t::stat_manager_t(mailbox_manager_t* mm,
                                server_id_t _own_server_id) :
     own_server_id(_own_server_id),
     mailbox_manager(mm),
+    cached_time(0),
     get_stats_mailbox(mailbox_manager,
                       std::bind(&stat_manager_t::on_stats_request,
                                 this, ph::_1, ph::_2, ph::_3))
@@ -26,14 +27,22 @@ void stat_manager_t::on_stats_request(
         UNUSED signal_t *interruptor,
         const return_address_t& reply_address,
         const std::set<std::vector<stat_id_t> >& requested_stats) {
-    perfmon_filter_t request(requested_stats);
-    ql::datum_t perfmon_result(perfmon_get_stats());
-    perfmon_result = request.filter(perfmon_result);
-
-    // Add in our own server id so the other side does not need to perform lookups
-    ql::datum_object_builder_t stats(perfmon_result);
-    stats.overwrite("server_id", convert_uuid_to_datum(own_server_id));
-    send(mailbox_manager, reply_address, std::move(stats).to_datum());
+    const microtime_t now = current_microtime();
+    if (!cached_stats.has()
+        || requested_stats != cached_request
+        || now >= cached_time + STATS_CACHE_TTL_MS * THOUSAND) {
+        perfmon_filter_t request(requested_stats);
+        ql::datum_t perfmon_result(perfmon_get_stats(request));
+
+        // Add in our own server id so the other side does not need to perform lookups
+        ql::datum_object_builder_t stats(perfmon_result);
+        stats.overwrite("server_id", convert_uuid_to_datum(own_server_id));
+
+        cached_request = requested_stats;
+        cached_stats = std::move(stats).to_datum();
+        cached_time = now;
+    }
+    send(mailbox_manager, reply_address, cached_stats);
 }
 
 bool fetch_stats_from_server(
@@ -8,6 +8,7 @@
 
 #include "perfmon/types.hpp"
 #include "rpc/mailbox/typed.hpp"
+#include "time.hpp"
 
 class stat_manager_t {
 public:
@@ -29,6 +30,14 @@ private:
 
     server_id_t own_server_id;
     mailbox_manager_t *mailbox_manager;
+
+    /* The last stats we collected, which requests for the same stats get for
+    `STATS_CACHE_TTL_MS`, so that several clients polling `rethinkdb.stats` don't
+    each make us collect them. */
+    std::set<std::vector<stat_id_t> > cached_request;
+    ql::datum_t cached_stats;
+    microtime_t cached_time;
+
     get_stats_mailbox_t get_stats_mailbox;
 
     DISABLE_COPYING(stat_manager_t);
@@ -3,6 +3,7 @@
 
 #include "clustering/administration/stats/request.hpp"
 #include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/interruptor.hpp"
 
 stats_artificial_table_backend_t::stats_artificial_table_backend_t(
         const clone_ptr_t<watchable_t<change_tracking_map_t<peer_id_t,
@@ -17,7 +18,8 @@ stats_artificial_table_backend_t::stats_artificial_table_backend_t(
     cluster_sl_view(_cluster_sl_view),
     server_config_client(_server_config_client),
     mailbox_manager(_mailbox_manager),
-    admin_format(_admin_format) { }
+    admin_format(_admin_format),
+    cached_rows_time(0) { }
 
 stats_artificial_table_backend_t::~stats_artificial_table_backend_t() {
     begin_changefeed_destruction();
@@ -94,6 +96,22 @@ bool stats_artificial_table_backend_t::read_all_rows_as_vector(
         UNUSED std::string *error_out) {
     cross_thread_signal_t ct_interruptor(interruptor, home_thread());
     on_thread_t rethreader(home_thread());
+
+    new_mutex_in_line_t mutex_acq(&cached_rows_mutex);
+    wait_interruptible(mutex_acq.acq_signal(), &ct_interruptor);
+    const microtime_t now = current_microtime();
+    if (cached_rows_time == 0 || now >= cached_rows_time + STATS_CACHE_TTL_MS * THOUSAND) {
+        read_all_rows_uncached(&ct_interruptor, &cached_rows);
+        cached_rows_time = current_microtime();
+    }
+    *rows_out = cached_rows;
+    return true;
+}
+
+void stats_artificial_table_backend_t::read_all_rows_uncached(
+        signal_t *interruptor,
+        std::vector<ql::datum_t> *rows_out) {
+    assert_thread();
     rows_out->clear();
 
     std::set<std::vector<std::string> > filter = stats_request_t::global_stats_filter();
@@ -104,7 +122,7 @@ bool stats_artificial_table_backend_t::read_all_rows_as_vector(
     cluster_semilattice_metadata_t metadata = cluster_sl_view->get();
 
     std::vector<ql::datum_t> results;
-    perform_stats_request(peers, filter, &results, &ct_interruptor);
+    perform_stats_request(peers, filter, &results, interruptor);
     parsed_stats_t parsed_stats(results);
 
     // Start building results
@@ -141,8 +159,6 @@ bool stats_artificial_table_backend_t::read_all_rows_as_vector(
                 parsed_stats, metadata, server_config_client, admin_format, rows_out);
         }
     }
-
-    return true;
 }
 
 template <class T>
@@ -11,7 +11,9 @@
 #include "rdb_protocol/artificial_table/caching_cfeed_backend.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "clustering/administration/servers/config_client.hpp"
+#include "concurrency/new_mutex.hpp"
 #include "concurrency/watchable.hpp"
+#include "time.hpp"
 
 class stats_artificial_table_backend_t :
     public timer_cfeed_artificial_table_backend_t
@@ -46,6 +48,9 @@ public:
                    std::string *error_out);
 
 private:
+    void read_all_rows_uncached(signal_t *interruptor,
+                                std::vector<ql::datum_t> *rows_out);
+
     void get_peer_stats(const peer_id_t &peer,
                         const std::set<std::vector<std::string> > &filter,
                         ql::datum_t *result_out,
@@ -63,6 +68,14 @@ private:
     server_config_client_t *server_config_client;
     mailbox_manager_t *mailbox_manager;
     admin_identifier_format_t admin_format;
+
+    /* The rows the last full read of the table produced, which reads within
+    `STATS_CACHE_TTL_MS` get too.  Reads that come while one is collecting the stats
+    wait in line on `cached_rows_mutex` for its result, so any number of admin UI
+    tabs polling the table (or changefeeds on it) cost one collection per interval. */
+    new_mutex_t cached_rows_mutex;
+    std::vector<ql::datum_t> cached_rows;
+    microtime_t cached_rows_time;
 };
 
 #endif /* CLUSTERING_ADMINISTRATION_STATS_STATS_BACKEND_HPP_ */
@@ -0,0 +1,214 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/administration/tables/auto_rebalancer.hpp"
+
+#include <algorithm>
+#include <map>
+#include <string>
+
+#include "clustering/administration/metadata.hpp"
+#include "clustering/administration/real_reql_cluster_interface.hpp"
+#include "clustering/administration/tables/split_points.hpp"
+#include "config/args.hpp"
+#include "logger.hpp"
+
+/* Returns `true` if the busiest shard carries more than its share of `total_load` by
+a factor of `AUTO_REBALANCE_IMBALANCE_RATIO`. */
+static bool has_overloaded_shard(const std::vector<int64_t> &shard_loads,
+                                 int64_t total_load) {
+    size_t busiest = 0;
+    for (size_t i = 1; i < shard_loads.size(); ++i) {
+        if (shard_loads[i] > shard_loads[busiest]) {
+            busiest = i;
+        }
+    }
+    const double mean = total_load / static_cast<double>(shard_loads.size());
+    return shard_loads[busiest] > AUTO_REBALANCE_IMBALANCE_RATIO * mean;
+}
+
+bool balance_primaries(const std::vector<int64_t> &shard_loads,
+                       table_config_t *config) {
+    guarantee(shard_loads.size() == config->shards.size());
+    std::map<server_id_t, int64_t> server_loads;
+    int64_t total_load = 0;
+    for (size_t i = 0; i < config->shards.size(); ++i) {
+        for (const server_id_t &replica : config->shards[i].replicas) {
+            server_loads[replica] += 0;
+        }
+        if (!config->shards[i].primary_replica.is_nil()) {
+            server_loads[config->shards[i].primary_replica] += shard_loads[i];
+        }
+        total_load += shard_loads[i];
+    }
+    if (server_loads.empty()) {
+        return false;
+    }
+    const double mean = total_load / static_cast<double>(server_loads.size());
+
+    bool moved = false;
+    /* Every move lowers the load on the busiest server without making another server
+    as busy as it was, so this terminates; the bound is just for safety. */
+    for (size_t iteration = 0; iteration < config->shards.size(); ++iteration) {
+        auto busiest = server_loads.begin();
+        for (auto it = server_loads.begin(); it != server_loads.end(); ++it) {
+            if (it->second > busiest->second) {
+                busiest = it;
+            }
+        }
+        if (busiest->second <= AUTO_REBALANCE_IMBALANCE_RATIO * mean) {
+            break;
+        }
+
+        /* Pick the move that leaves the two servers involved with the least load on
+        the busier of them. */
+        size_t best_shard = config->shards.size();
+        server_id_t best_target = nil_uuid();
+        int64_t best_max = busiest->second;
+        for (size_t i = 0; i < config->shards.size(); ++i) {
+            if (config->shards[i].primary_replica != busiest->first) {
+                continue;
+            }
+            for (const server_id_t &replica : config->shards[i].replicas) {
+                if (replica == busiest->first) {
+                    continue;
+                }
+                const int64_t new_max = std::max(busiest->second - shard_loads[i],
+                                                 server_loads[replica] + shard_loads[i]);
+                if (new_max < best_max) {
+                    best_shard = i;
+                    best_target = replica;
+                    best_max = new_max;
+                }
+            }
+        }
+        if (best_shard == config->shards.size()) {
+            break;
+        }
+        config->shards[best_shard].primary_replica = best_target;
+        busiest->second -= shard_loads[best_shard];
+        server_loads[best_target] += shard_loads[best_shard];
+        moved = true;
+    }
+    return moved;
+}
+
+static std::string describe_shard_loads(const std::vector<int64_t> &shard_loads,
+                                        int64_t total_load) {
+    std::string description;
+    for (size_t i = 0; i < shard_loads.size(); ++i) {
+        description += strprintf("%s%.0f%%", i == 0 ? "" : ", ",
+                                 100.0 * shard_loads[i] / total_load);
+    }
+    return description;
+}
+
+auto_rebalancer_t::auto_rebalancer_t(
+        auto_rebalance_t _mode,
+        real_reql_cluster_interface_t *_reql_cluster_interface,
+        boost::shared_ptr<semilattice_readwrite_view_t<
+            cluster_semilattice_metadata_t> > _semilattice_view) :
+    mode(_mode),
+    reql_cluster_interface(_reql_cluster_interface),
+    semilattice_view(_semilattice_view),
+    checking(false),
+    timer(AUTO_REBALANCE_INTERVAL_MS, this) {
+    guarantee(mode != auto_rebalance_t::off);
+}
+
+void auto_rebalancer_t::check_tables(auto_drainer_t::lock_t keepalive) {
+    if (checking) {
+        return;
+    }
+    checking = true;
+    try {
+        const cluster_semilattice_metadata_t snapshot = semilattice_view->get();
+        for (const auto &pair : snapshot.rdb_namespaces->namespaces) {
+            if (!pair.second.is_deleted()) {
+                check_table(pair.first, keepalive.get_drain_signal());
+            }
+        }
+    } catch (const interrupted_exc_t &) {
+        /* We're shutting down. */
+    }
+    checking = false;
+}
+
+void auto_rebalancer_t::check_table(const namespace_id_t &table_id,
+                                    signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t) {
+    std::map<store_key_t, int64_t> counts, loads;
+    std::string error;
+    if (!fetch_distribution_and_load(table_id, reql_cluster_interface, interruptor,
+                                     &counts, &loads, &error)) {
+        /* The table isn't available right now; we'll try again next time. */
+        if (interruptor->is_pulsed()) {
+            throw interrupted_exc_t();
+        }
+        return;
+    }
+
+    /* The table may have been changed or deleted while we were reading from it. */
+    cluster_semilattice_metadata_t cluster_md = semilattice_view->get();
+    auto table_it = cluster_md.rdb_namespaces->namespaces.find(table_id);
+    if (table_it == cluster_md.rdb_namespaces->namespaces.end() ||
+            table_it->second.is_deleted()) {
+        return;
+    }
+    const namespace_semilattice_metadata_t &table_md = table_it->second.get_ref();
+    const table_replication_info_t &old_info = table_md.replication_info.get_ref();
+
+    std::vector<int64_t> shard_loads =
+        calculate_shard_loads(old_info.shard_scheme, loads);
+    int64_t total_load = 0;
+    for (int64_t load : shard_loads) {
+        total_load += load;
+    }
+    if (total_load < AUTO_REBALANCE_MIN_OPS) {
+        return;
+    }
+    const std::string old_description = describe_shard_loads(shard_loads, total_load);
+
+    table_replication_info_t new_info = old_info;
+    if (has_overloaded_shard(shard_loads, total_load)) {
+        table_shard_scheme_t new_scheme;
+        if (calculate_split_points_with_load(counts, loads, AUTO_REBALANCE_LOAD_WEIGHT,
+                old_info.shard_scheme.num_shards(), &new_scheme, &error)) {
+            new_info.shard_scheme = new_scheme;
+            shard_loads = calculate_shard_loads(new_scheme, loads);
+        }
+    }
+    const bool moved_split_points = !(new_info.shard_scheme == old_info.shard_scheme);
+    const bool moved_primaries = balance_primaries(shard_loads, &new_info.config);
+    if (!moved_split_points && !moved_primaries) {
+        return;
+    }
+
+    std::string table_name = table_md.name.get_ref().str();
+    auto db_it = cluster_md.databases.databases.find(table_md.database.get_ref());
+    if (db_it != cluster_md.databases.databases.end() && !db_it->second.is_deleted()) {
+        table_name = db_it->second.get_ref().name.get_ref().str() + "." + table_name;
+    }
+    const std::string changes = strprintf("%s%s%s",
+        moved_split_points ? "moving its split points" : "",
+        moved_split_points && moved_primaries ? " and " : "",
+        moved_primaries ? "moving primaries to other replicas" : "");
+
+    if (mode == auto_rebalance_t::propose) {
+        logINF("The load on table `%s` is unbalanced over its shards (%s). Rebalancing "
+               "it would mean %s, with the shards getting %s of the load.\n",
+               table_name.c_str(), old_description.c_str(), changes.c_str(),
+               describe_shard_loads(shard_loads, total_load).c_str());
+        return;
+    }
+
+    {
+        cow_ptr_t<namespaces_semilattice_metadata_t>::change_t ns_change(
+            &cluster_md.rdb_namespaces);
+        ns_change.get()->namespaces.at(table_id).get_mutable()->replication_info.set(
+            new_info);
+    }
+    semilattice_view->join(cluster_md);
+    logINF("Rebalanced table `%s`, whose shards got %s of the load, by %s. The shards "
+           "now get %s of the load.\n",
+           table_name.c_str(), old_description.c_str(), changes.c_str(),
+           describe_shard_loads(shard_loads, total_load).c_str());
+}
@@ -0,0 +1,80 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_TABLES_AUTO_REBALANCER_HPP_
+#define CLUSTERING_ADMINISTRATION_TABLES_AUTO_REBALANCER_HPP_
+
+#include <functional>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/shared_ptr.hpp>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "containers/uuid.hpp"
+#include "rpc/semilattice/view.hpp"
+
+class cluster_semilattice_metadata_t;
+class real_reql_cluster_interface_t;
+class signal_t;
+class table_config_t;
+
+enum class auto_rebalance_t {
+    off,
+    /* Logs the changes that would rebalance a table. */
+    propose,
+    /* Makes those changes to the table's configuration. */
+    apply,
+};
+
+/* `auto_rebalancer_t` periodically measures which parts of each table the reads and
+writes go to, using the samples that distribution reads return. When the busiest shard
+of a table carries much more than its share of the load, it moves the split points so
+that the shards share a mix of the documents and the load more evenly; and when one
+server is primary for much more than its share of a table's load, it moves primaries to
+other replicas of the same shards. It never changes which servers host a shard.
+
+Servers that run it all act on their own, so it should be turned on for only one of
+the servers in a cluster. */
+class auto_rebalancer_t : private repeating_timer_callback_t {
+public:
+    auto_rebalancer_t(
+        auto_rebalance_t mode,
+        real_reql_cluster_interface_t *reql_cluster_interface,
+        boost::shared_ptr<semilattice_readwrite_view_t<
+            cluster_semilattice_metadata_t> > semilattice_view);
+
+private:
+    void on_ring() {
+        coro_t::spawn_sometime(std::bind(&auto_rebalancer_t::check_tables,
+                                         this, drainer.lock()));
+    }
+
+    void check_tables(auto_drainer_t::lock_t keepalive);
+
+    void check_table(const namespace_id_t &table_id, signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t);
+
+    const auto_rebalance_t mode;
+    real_reql_cluster_interface_t *const reql_cluster_interface;
+    const boost::shared_ptr<semilattice_readwrite_view_t<
+        cluster_semilattice_metadata_t> > semilattice_view;
+
+    /* A check that takes longer than the timer interval doesn't get a second check
+    started alongside it. */
+    bool checking;
+
+    auto_drainer_t drainer;
+    repeating_timer_t timer;
+
+    DISABLE_COPYING(auto_rebalancer_t);
+};
+
+/* `balance_primaries` moves the primaries of `config`'s shards among their replicas
+until no server is primary for more than `AUTO_REBALANCE_IMBALANCE_RATIO` times the
+mean load per server, or no move helps any more. `shard_loads` is the load on each
+shard. Returns `true` if it moved any primaries. */
+bool balance_primaries(const std::vector<int64_t> &shard_loads,
+                       table_config_t *config);
+
+#endif  // CLUSTERING_ADMINISTRATION_TABLES_AUTO_REBALANCER_HPP_
@@ -50,6 +50,9 @@ public:
             std::string *error_out);
 
 private:
+    /* The rows only depend on `database_sl_view`, which calls `notify_all()`. */
+    bool notifications_are_complete() { return true; }
+
     boost::shared_ptr< semilattice_readwrite_view_t<
         databases_semilattice_metadata_t> > database_sl_view;
     semilattice_read_view_t<databases_semilattice_metadata_t>::subscription_t subs;
@@ -115,6 +115,35 @@ bool fetch_distribution(
     return true;
 }
 
+bool fetch_distribution_and_load(
+        const namespace_id_t &table_id,
+        real_reql_cluster_interface_t *reql_cluster_interface,
+        signal_t *interruptor,
+        std::map<store_key_t, int64_t> *counts_out,
+        std::map<store_key_t, int64_t> *loads_out,
+        std::string *error_out) {
+    namespace_interface_access_t ns_if_access =
+        reql_cluster_interface->get_namespace_repo()->get_namespace_interface(
+            table_id, interruptor);
+    static const int depth = 2;
+    static const int limit = 128;
+    distribution_read_t inner_read(depth, limit);
+    read_t read(inner_read, profile_bool_t::DONT_PROFILE);
+    read_response_t resp;
+    try {
+        ns_if_access.get()->read(read, &resp, order_token_t::ignore, interruptor);
+    } catch (cannot_perform_query_exc_t) {
+        *error_out = "Cannot measure the load on the table because it isn't "
+            "currently available for reading.";
+        return false;
+    }
+    distribution_read_response_t *dist_resp =
+        boost::get<distribution_read_response_t>(&resp.response);
+    *counts_out = std::move(dist_resp->key_counts);
+    *loads_out = std::move(dist_resp->key_loads);
+    return true;
+}
+
 bool calculate_split_points_with_distribution(
         const std::map<store_key_t, int64_t> &counts,
         size_t num_shards,
@@ -157,6 +186,56 @@ bool calculate_split_points_with_distribution(
     return true;
 }
 
+bool calculate_split_points_with_load(
+        const std::map<store_key_t, int64_t> &counts,
+        const std::map<store_key_t, int64_t> &loads,
+        double load_weight,
+        size_t num_shards,
+        table_shard_scheme_t *split_points_out,
+        std::string *error_out) {
+    rassert(load_weight >= 0 && load_weight <= 1);
+    int64_t total_count = 0, total_load = 0;
+    for (auto const &pair : counts) {
+        total_count += pair.second;
+    }
+    for (auto const &pair : loads) {
+        total_load += pair.second;
+    }
+    if (total_load == 0) {
+        return calculate_split_points_with_distribution(
+            counts, num_shards, split_points_out, error_out);
+    }
+
+    /* Scale the documents and the load so that they have their share of a common
+    total. A sampled key that falls inside one of the ranges of `counts` takes over the
+    part of the range after it, which shifts that range's documents slightly to the
+    left; with ranges that small, that doesn't matter. */
+    static const double scale = static_cast<double>(1 << 30);
+    std::map<store_key_t, int64_t> weights;
+    if (total_count != 0) {
+        for (auto const &pair : counts) {
+            weights[pair.first] += static_cast<int64_t>(
+                pair.second * (1 - load_weight) * scale / total_count);
+        }
+    }
+    for (auto const &pair : loads) {
+        weights[pair.first] += static_cast<int64_t>(
+            pair.second * load_weight * scale / total_load);
+    }
+    return calculate_split_points_with_distribution(
+        weights, num_shards, split_points_out, error_out);
+}
+
+std::vector<int64_t> calculate_shard_loads(
+        const table_shard_scheme_t &shard_scheme,
+        const std::map<store_key_t, int64_t> &loads) {
+    std::vector<int64_t> shard_loads(shard_scheme.num_shards(), 0);
+    for (auto const &pair : loads) {
+        shard_loads[shard_scheme.find_shard_for_key(pair.first)] += pair.second;
+    }
+    return shard_loads;
+}
+
 store_key_t key_for_uuid(uint64_t first_8_bytes) {
     uuid_u uuid;
     bzero(uuid.data(), uuid_u::static_size());
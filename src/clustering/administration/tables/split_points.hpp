@@ -21,6 +21,17 @@ bool fetch_distribution(
         std::map<store_key_t, int64_t> *counts_out,
         std::string *error_out);
 
+/* `fetch_distribution_and_load` is like `fetch_distribution`, but it also fetches
+an estimate of how many reads and writes hit each part of the table recently. It reads
+from the primaries, because the other replicas don't see the up-to-date reads. */
+bool fetch_distribution_and_load(
+        const namespace_id_t &table_id,
+        real_reql_cluster_interface_t *reql_cluster_interface,
+        signal_t *interruptor,
+        std::map<store_key_t, int64_t> *counts_out,
+        std::map<store_key_t, int64_t> *loads_out,
+        std::string *error_out);
+
 /* `calculate_split_points_with_distribution` generates a set of split points that are
 guaranteed to divide the data approximately evenly, using the results of
 `fetch_distribution()`. It fails if there are too few documents in the database. */
@@ -30,6 +41,24 @@ bool calculate_split_points_with_distribution(
         table_shard_scheme_t *split_points_out,
         std::string *error_out);
 
+/* `calculate_split_points_with_load` is like
+`calculate_split_points_with_distribution`, but the shards get about the same share of
+a mix of the documents and of the load from `fetch_distribution_and_load()`.
+`load_weight` is the share of the load in the mix, between 0 and 1. */
+bool calculate_split_points_with_load(
+        const std::map<store_key_t, int64_t> &counts,
+        const std::map<store_key_t, int64_t> &loads,
+        double load_weight,
+        size_t num_shards,
+        table_shard_scheme_t *split_points_out,
+        std::string *error_out);
+
+/* `calculate_shard_loads` adds up the load from `fetch_distribution_and_load()` that
+falls on each of the shards of `shard_scheme`. */
+std::vector<int64_t> calculate_shard_loads(
+        const table_shard_scheme_t &shard_scheme,
+        const std::map<store_key_t, int64_t> &loads);
+
 /* `calculate_split_points_for_uuids` generates a set of split points that will divide
 the range of UUIDs evenly. */
 void calculate_split_points_for_uuids(
@@ -38,6 +38,10 @@ public:
             std::string *error_out);
 
 protected:
+    /* Every row is computed from the semilattice metadata, which calls `notify_all()`
+    when it changes, plus whatever the subclass notifies about. */
+    bool notifications_are_complete() { return true; }
+
     /* This will always be called on the home thread */
     virtual bool format_row(
             namespace_id_t table_id,
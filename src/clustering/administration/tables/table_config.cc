@@ -1,6 +1,8 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "clustering/administration/tables/table_config.hpp"
 
+#include <limits>
+
 #include "clustering/administration/datum_adapter.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "clustering/administration/tables/generate_config.hpp"
@@ -188,6 +190,126 @@ bool convert_durability_from_datum(
     return true;
 }
 
+bool convert_block_size_from_datum(
+        const ql::datum_t &datum,
+        uint32_t *block_size_out,
+        std::string *error_out) {
+    if (datum.get_type() != ql::datum_t::R_NUM) {
+        *error_out = "Expected a number, got: " + datum.print();
+        return false;
+    }
+    double block_size = datum.as_num();
+    if (block_size != static_cast<uint32_t>(block_size)
+            || block_size < MIN_BTREE_BLOCK_SIZE || block_size > MAX_BTREE_BLOCK_SIZE
+            || (static_cast<uint32_t>(block_size)
+                & (static_cast<uint32_t>(block_size) - 1)) != 0) {
+        *error_out = strprintf("The block size must be a power of two between %d and "
+            "%d, got: %s", MIN_BTREE_BLOCK_SIZE, MAX_BTREE_BLOCK_SIZE,
+            datum.print().c_str());
+        return false;
+    }
+    *block_size_out = static_cast<uint32_t>(block_size);
+    return true;
+}
+
+bool convert_cache_reservation_from_datum(
+        const ql::datum_t &datum,
+        uint64_t *cache_reservation_out,
+        std::string *error_out) {
+    if (datum.get_type() != ql::datum_t::R_NUM) {
+        *error_out = "Expected a number, got: " + datum.print();
+        return false;
+    }
+    double cache_reservation = datum.as_num();
+    if (cache_reservation < 0
+            || cache_reservation
+                > static_cast<double>(std::numeric_limits<int64_t>::max())
+            || cache_reservation != static_cast<uint64_t>(cache_reservation)) {
+        *error_out = "The cache reservation must be a non-negative integer number of "
+            "bytes, got: " + datum.print();
+        return false;
+    }
+    *cache_reservation_out = static_cast<uint64_t>(cache_reservation);
+    return true;
+}
+
+bool convert_cache_weight_from_datum(
+        const ql::datum_t &datum,
+        double *cache_weight_out,
+        std::string *error_out) {
+    if (datum.get_type() != ql::datum_t::R_NUM) {
+        *error_out = "Expected a number, got: " + datum.print();
+        return false;
+    }
+    double cache_weight = datum.as_num();
+    if (!(cache_weight > 0)) {
+        *error_out = "The cache weight must be a positive number, got: "
+            + datum.print();
+        return false;
+    }
+    *cache_weight_out = cache_weight;
+    return true;
+}
+
+bool convert_io_weight_from_datum(
+        const ql::datum_t &datum,
+        double *io_weight_out,
+        std::string *error_out) {
+    if (datum.get_type() != ql::datum_t::R_NUM) {
+        *error_out = "Expected a number, got: " + datum.print();
+        return false;
+    }
+    double io_weight = datum.as_num();
+    if (!(io_weight > 0)) {
+        *error_out = "The I/O weight must be a positive number, got: "
+            + datum.print();
+        return false;
+    }
+    *io_weight_out = io_weight;
+    return true;
+}
+
+bool convert_soft_flush_delay_from_datum(
+        const ql::datum_t &datum,
+        uint32_t *soft_flush_delay_out,
+        std::string *error_out) {
+    if (datum.get_type() != ql::datum_t::R_NUM) {
+        *error_out = "Expected a number, got: " + datum.print();
+        return false;
+    }
+    double soft_flush_delay = datum.as_num();
+    if (soft_flush_delay < 0 || soft_flush_delay > MAX_TABLE_SOFT_FLUSH_DELAY_MS
+            || soft_flush_delay != static_cast<uint32_t>(soft_flush_delay)) {
+        *error_out = strprintf("The soft flush delay must be an integer number of "
+            "milliseconds between 0 and %d, got: %s", MAX_TABLE_SOFT_FLUSH_DELAY_MS,
+            datum.print().c_str());
+        return false;
+    }
+    *soft_flush_delay_out = static_cast<uint32_t>(soft_flush_delay);
+    return true;
+}
+
+bool convert_index_build_rate_from_datum(
+        const ql::datum_t &datum,
+        uint64_t *index_build_rate_out,
+        std::string *error_out) {
+    if (datum.get_type() != ql::datum_t::R_NUM) {
+        *error_out = "Expected a number, got: " + datum.print();
+        return false;
+    }
+    double index_build_rate = datum.as_num();
+    if (index_build_rate < 0
+            || index_build_rate
+                > static_cast<double>(std::numeric_limits<int64_t>::max())
+            || index_build_rate != static_cast<uint64_t>(index_build_rate)) {
+        *error_out = "The index build rate must be a non-negative integer number of "
+            "documents per second (or 0 for no limit), got: " + datum.print();
+        return false;
+    }
+    *index_build_rate_out = static_cast<uint64_t>(index_build_rate);
+    return true;
+}
+
 ql::datum_t convert_table_config_shard_to_datum(
         const table_config_t::shard_t &shard,
         admin_identifier_format_t identifier_format,
@@ -297,6 +419,18 @@ ql::datum_t convert_table_config_to_datum(
             config.write_ack_config, identifier_format, server_config_client));
     builder.overwrite("durability",
         convert_durability_to_datum(config.durability));
+    builder.overwrite("block_size",
+        ql::datum_t(static_cast<double>(config.block_size)));
+    builder.overwrite("compress_blocks",
+        ql::datum_t::boolean(config.compress_blocks));
+    builder.overwrite("cache_reservation",
+        ql::datum_t(static_cast<double>(config.cache_reservation)));
+    builder.overwrite("cache_weight", ql::datum_t(config.cache_weight));
+    builder.overwrite("io_weight", ql::datum_t(config.io_weight));
+    builder.overwrite("soft_flush_delay",
+        ql::datum_t(static_cast<double>(config.soft_flush_delay)));
+    builder.overwrite("index_build_rate",
+        ql::datum_t(static_cast<double>(config.index_build_rate)));
     return std::move(builder).to_datum();
 }
 
@@ -441,6 +575,105 @@ bool convert_table_config_and_name_from_datum(
         config_out->durability = write_durability_t::HARD;
     }
 
+    if (existed_before || converter.has("block_size")) {
+        ql::datum_t block_size_datum;
+        if (!converter.get("block_size", &block_size_datum, error_out)) {
+            return false;
+        }
+        if (!convert_block_size_from_datum(block_size_datum, &config_out->block_size,
+                error_out)) {
+            *error_out = "In `block_size`: " + *error_out;
+            return false;
+        }
+    } else {
+        config_out->block_size = DEFAULT_BTREE_BLOCK_SIZE;
+    }
+
+    if (existed_before || converter.has("compress_blocks")) {
+        ql::datum_t compress_blocks_datum;
+        if (!converter.get("compress_blocks", &compress_blocks_datum, error_out)) {
+            return false;
+        }
+        if (compress_blocks_datum.get_type() != ql::datum_t::R_BOOL) {
+            *error_out = "In `compress_blocks`: Expected a boolean, got: "
+                + compress_blocks_datum.print();
+            return false;
+        }
+        config_out->compress_blocks = compress_blocks_datum.as_bool();
+    } else {
+        config_out->compress_blocks = DEFAULT_TABLE_COMPRESS_BLOCKS;
+    }
+
+    if (existed_before || converter.has("cache_reservation")) {
+        ql::datum_t cache_reservation_datum;
+        if (!converter.get("cache_reservation", &cache_reservation_datum, error_out)) {
+            return false;
+        }
+        if (!convert_cache_reservation_from_datum(cache_reservation_datum,
+                &config_out->cache_reservation, error_out)) {
+            *error_out = "In `cache_reservation`: " + *error_out;
+            return false;
+        }
+    } else {
+        config_out->cache_reservation = DEFAULT_TABLE_CACHE_RESERVATION;
+    }
+
+    if (existed_before || converter.has("cache_weight")) {
+        ql::datum_t cache_weight_datum;
+        if (!converter.get("cache_weight", &cache_weight_datum, error_out)) {
+            return false;
+        }
+        if (!convert_cache_weight_from_datum(cache_weight_datum,
+                &config_out->cache_weight, error_out)) {
+            *error_out = "In `cache_weight`: " + *error_out;
+            return false;
+        }
+    } else {
+        config_out->cache_weight = DEFAULT_TABLE_CACHE_WEIGHT;
+    }
+
+    if (existed_before || converter.has("io_weight")) {
+        ql::datum_t io_weight_datum;
+        if (!converter.get("io_weight", &io_weight_datum, error_out)) {
+            return false;
+        }
+        if (!convert_io_weight_from_datum(io_weight_datum,
+                &config_out->io_weight, error_out)) {
+            *error_out = "In `io_weight`: " + *error_out;
+            return false;
+        }
+    } else {
+        config_out->io_weight = DEFAULT_TABLE_IO_WEIGHT;
+    }
+
+    if (existed_before || converter.has("soft_flush_delay")) {
+        ql::datum_t soft_flush_delay_datum;
+        if (!converter.get("soft_flush_delay", &soft_flush_delay_datum, error_out)) {
+            return false;
+        }
+        if (!convert_soft_flush_delay_from_datum(soft_flush_delay_datum,
+                &config_out->soft_flush_delay, error_out)) {
+            *error_out = "In `soft_flush_delay`: " + *error_out;
+            return false;
+        }
+    } else {
+        config_out->soft_flush_delay = DEFAULT_TABLE_SOFT_FLUSH_DELAY_MS;
+    }
+
+    if (existed_before || converter.has("index_build_rate")) {
+        ql::datum_t index_build_rate_datum;
+        if (!converter.get("index_build_rate", &index_build_rate_datum, error_out)) {
+            return false;
+        }
+        if (!convert_index_build_rate_from_datum(index_build_rate_datum,
+                &config_out->index_build_rate, error_out)) {
+            *error_out = "In `index_build_rate`: " + *error_out;
+            return false;
+        }
+    } else {
+        config_out->index_build_rate = DEFAULT_TABLE_INDEX_BUILD_RATE;
+    }
+
     write_ack_config_checker_t ack_checker(*config_out, all_metadata.servers);
     for (const table_config_t::shard_t &shard : config_out->shards) {
         std::set<server_id_t> replicas;
@@ -557,6 +790,17 @@ bool table_config_artificial_table_backend_t::write_row(
                 *error_out = "It's illegal to change a table's primary key.";
                 return false;
             }
+            if (replication_info.config.block_size != it->second.get_ref()
+                    .replication_info.get_ref().config.block_size) {
+                *error_out = "It's illegal to change a table's block size.";
+                return false;
+            }
+            if (replication_info.config.compress_blocks != it->second.get_ref()
+                    .replication_info.get_ref().config.compress_blocks) {
+                *error_out = "It's illegal to change whether a table compresses its "
+                    "blocks.";
+                return false;
+            }
         }
 
         /* Decide on the sharding scheme for the table */
@@ -1,6 +1,10 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "clustering/administration/tables/table_metadata.hpp"
 
+#include "errors.hpp"
+#include <boost/make_shared.hpp>
+
+
 #include "clustering/administration/tables/database_metadata.hpp"
 #include "containers/archive/archive.hpp"
 #include "containers/archive/boost_types.hpp"
@@ -20,9 +24,14 @@ RDB_IMPL_SERIALIZABLE_2_SINCE_v1_16(table_config_t::shard_t,
 RDB_IMPL_EQUALITY_COMPARABLE_2(table_config_t::shard_t,
                                replicas, primary_replica);
 
-RDB_IMPL_SERIALIZABLE_3_SINCE_v1_16(table_config_t,
-                                    shards, write_ack_config, durability);
-RDB_IMPL_EQUALITY_COMPARABLE_3(table_config_t, shards, write_ack_config, durability);
+RDB_IMPL_SERIALIZABLE_10_SINCE_v1_16(table_config_t,
+                                     shards, write_ack_config, durability, block_size,
+                                     compress_blocks, cache_reservation, cache_weight,
+                                     io_weight, soft_flush_delay, index_build_rate);
+RDB_IMPL_EQUALITY_COMPARABLE_10(table_config_t,
+                                shards, write_ack_config, durability, block_size,
+                                compress_blocks, cache_reservation, cache_weight,
+                                io_weight, soft_flush_delay, index_build_rate);
 
 RDB_IMPL_SERIALIZABLE_1_SINCE_v1_16(table_shard_scheme_t, split_points);
 RDB_IMPL_EQUALITY_COMPARABLE_1(table_shard_scheme_t, split_points);
@@ -57,6 +66,7 @@ RDB_IMPL_EQUALITY_COMPARABLE_1(databases_semilattice_metadata_t, databases);
 write_ack_config_checker_t::write_ack_config_checker_t(
         const table_config_t &config,
         const servers_semilattice_metadata_t &servers) {
+    reqs_t new_reqs;
     if (config.write_ack_config.mode != write_ack_config_t::mode_t::complex) {
         std::set<server_id_t> all_replicas;
         for (const table_config_t::shard_t &shard : config.shards) {
@@ -82,7 +92,7 @@ write_ack_config_checker_t::write_ack_config_checker_t(
             }
             acks = (largest + 2) / 2;
         }
-        reqs.push_back(std::make_pair(all_replicas, acks));
+        new_reqs.push_back(std::make_pair(all_replicas, acks));
     } else {
         for (const write_ack_config_t::req_t &req :
                 config.write_ack_config.complex_reqs) {
@@ -102,13 +112,17 @@ write_ack_config_checker_t::write_ack_config_checker_t(
                 }
                 acks = (largest + 2) / 2;
             }
-            reqs.push_back(std::make_pair(req.replicas, acks));
+            new_reqs.push_back(std::make_pair(req.replicas, acks));
         }
     }
+    reqs = boost::make_shared<const reqs_t>(std::move(new_reqs));
 }
 
 bool write_ack_config_checker_t::check_acks(const std::set<server_id_t> &acks) const {
-    for (const std::pair<std::set<server_id_t>, size_t> &pair : reqs) {
+    if (!reqs) {
+        return true;
+    }
+    for (const std::pair<std::set<server_id_t>, size_t> &pair : *reqs) {
         size_t count = 0;
         for (const server_id_t &server : acks) {
             count += pair.first.count(server);
@@ -120,3 +134,32 @@ bool write_ack_config_checker_t::check_acks(const std::set<server_id_t> &acks) c
     return true;
 }
 
+write_ack_config_checker_t::counter_t::counter_t(
+        const write_ack_config_checker_t &checker)
+    : reqs(checker.reqs), unsatisfied(0) {
+    if (reqs) {
+        missing.reserve(reqs->size());
+        for (const std::pair<std::set<server_id_t>, size_t> &pair : *reqs) {
+            missing.push_back(pair.second);
+            if (pair.second > 0) {
+                ++unsatisfied;
+            }
+        }
+    }
+}
+
+bool write_ack_config_checker_t::counter_t::note_ack(const server_id_t &server) {
+    if (unsatisfied == 0) {
+        return true;
+    }
+    for (size_t i = 0; i < missing.size(); ++i) {
+        if (missing[i] > 0 && (*reqs)[i].first.count(server) == 1) {
+            --missing[i];
+            if (missing[i] == 0) {
+                --unsatisfied;
+            }
+        }
+    }
+    return unsatisfied == 0;
+}
+
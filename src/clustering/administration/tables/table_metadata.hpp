@@ -8,6 +8,9 @@
 #include <utility>
 #include <vector>
 
+#include "errors.hpp"
+#include <boost/shared_ptr.hpp>
+
 #include "clustering/administration/servers/server_metadata.hpp"
 #include "clustering/administration/tables/database_metadata.hpp"
 #include "clustering/generic/nonoverlapping_regions.hpp"
@@ -61,6 +64,28 @@ public:
     std::vector<shard_t> shards;
     write_ack_config_t write_ack_config;
     write_durability_t durability;
+    /* The size of the table's B-tree blocks. This only takes effect when a server
+    creates its files for the table; it can't be changed afterwards. */
+    uint32_t block_size;
+    /* Whether the servers' files for the table compress blocks on disk. Like
+    `block_size`, this is fixed once the files exist. */
+    bool compress_blocks;
+    /* How the cache on each server that hosts the table is shared with other tables.
+    The table is never left with fewer than `cache_reservation` bytes, and
+    `cache_weight` weighs its demand for more against other tables'. */
+    uint64_t cache_reservation;
+    double cache_weight;
+    /* How the table's disk I/O on each server is weighed against other tables' I/O on
+    the same server. */
+    double io_weight;
+    /* How many milliseconds the table's soft durability writes are kept in memory
+    before they start getting flushed, so that writes to the same blocks get flushed
+    together. */
+    uint32_t soft_flush_delay;
+    /* How many documents per second secondary index construction may read on each
+    server that hosts the table, so that it doesn't slow down queries too much. 0
+    means there is no limit. */
+    uint64_t index_build_rate;
 };
 
 RDB_DECLARE_SERIALIZABLE(table_config_t::shard_t);
@@ -155,7 +180,29 @@ may depend on how many replicas the shards have and on which servers have been
 permanently removed. The reason it's an object instead of a function is that it caches
 intermediate results for best performance. */
 class write_ack_config_checker_t {
+private:
+    typedef std::vector<std::pair<std::set<server_id_t>, size_t> > reqs_t;
+
 public:
+    /* `counter_t` counts the acks for a single write as they come in. Each ack only
+    costs a lookup per requirement, instead of `check_acks()` going over all of the
+    acks so far again, and once the requirements are met further acks cost nothing. It
+    shares the requirements with the checker it was made from, so it stays valid if
+    that checker is replaced or destroyed. */
+    class counter_t {
+    public:
+        explicit counter_t(const write_ack_config_checker_t &checker);
+        /* `server` must not have been noted before. Returns `true` if the acks noted
+        so far satisfy the requirements. */
+        bool note_ack(const server_id_t &server);
+    private:
+        boost::shared_ptr<const reqs_t> reqs;
+        /* How many more acks each requirement needs, and how many of them still need
+        any. */
+        std::vector<size_t> missing;
+        size_t unsatisfied;
+    };
+
     /* The default constructor results in a checker with undefined content. In the
     current implementation, calling `check_acks()` on a default-constructed checker will
     always return `true`; but don't rely on this behavior. */
@@ -164,7 +211,9 @@ public:
                                const servers_semilattice_metadata_t &servers);
     bool check_acks(const std::set<server_id_t> &acks) const;
 private:
-    std::vector<std::pair<std::set<server_id_t>, size_t> > reqs;
+    /* Shared, so that copying the checker to other threads or into a `counter_t` is
+    cheap. Empty for a default-constructed checker. */
+    boost::shared_ptr<const reqs_t> reqs;
 };
 
 #endif /* CLUSTERING_ADMINISTRATION_TABLES_TABLE_METADATA_HPP_ */
@@ -0,0 +1,35 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_GENERIC_REPLICA_READ_COST_HPP_
+#define CLUSTERING_GENERIC_REPLICA_READ_COST_HPP_
+
+#include <stdint.h>
+
+#include "config/args.hpp"
+#include "rpc/mailbox/mailbox.hpp"
+
+/* Returns the round-trip time to `peer` in microseconds, for comparing replicas with
+`estimate_replica_read_cost_us()`. Returns -1 if it isn't known. */
+inline int64_t get_peer_round_trip_time_us(mailbox_manager_t *mailbox_manager,
+                                           peer_id_t peer) {
+    connectivity_cluster_t *cluster = mailbox_manager->get_connectivity_cluster();
+    if (peer == cluster->get_me()) {
+        return 0;
+    }
+    auto_drainer_t::lock_t connection_keepalive;
+    connectivity_cluster_t::connection_t *connection =
+        cluster->get_connection(peer, &connection_keepalive);
+    return connection == NULL ? -1 : connection->get_round_trip_time_us();
+}
+
+/* Estimates how long a read would take on a replica, given the round-trip time to it
+(-1 if unknown) and how many of our reads it's already working on. Only meant for
+comparing replicas with each other. */
+inline int64_t estimate_replica_read_cost_us(int64_t round_trip_time_us,
+                                             int64_t reads_in_flight) {
+    const int64_t round_trip = round_trip_time_us == -1
+        ? REPLICA_READ_UNKNOWN_ROUND_TRIP_US
+        : round_trip_time_us;
+    return (round_trip + REPLICA_READ_SERVICE_TIME_US) * (1 + reads_in_flight);
+}
+
+#endif  // CLUSTERING_GENERIC_REPLICA_READ_COST_HPP_
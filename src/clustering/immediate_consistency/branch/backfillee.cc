@@ -2,6 +2,8 @@
 #include "clustering/immediate_consistency/branch/backfillee.hpp"
 
 #include <functional>
+#include <numeric>
+#include <vector>
 
 #include "errors.hpp"
 #include <boost/bind.hpp>
@@ -11,6 +13,7 @@
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/fifo_enforcer_queue.hpp"
 #include "concurrency/new_semaphore.hpp"
+#include "concurrency/pmap.hpp"
 #include "concurrency/promise.hpp"
 #include "concurrency/queue/unlimited_fifo.hpp"
 #include "containers/death_runner.hpp"
@@ -45,6 +48,29 @@ struct backfill_queue_entry_t {
     fifo_enforcer_write_token_t write_token;
 };
 
+/* Combines the progress fractions of the streams of a backfill into the one that
+`backfillee()` reports. */
+class backfill_progress_t {
+public:
+    backfill_progress_t(size_t num_streams, double *_progress_out)
+        : stream_progress(num_streams, 0.0), progress_out(_progress_out) { }
+
+    void set_stream_progress(size_t stream, double progress) {
+        if (progress_out != nullptr) {
+            stream_progress[stream] = progress;
+            *progress_out = std::accumulate(stream_progress.begin(),
+                                            stream_progress.end(), 0.0)
+                / stream_progress.size();
+        }
+    }
+
+private:
+    std::vector<double> stream_progress;
+    double *progress_out;
+
+    DISABLE_COPYING(backfill_progress_t);
+};
+
 /* Now that the metadata indicates that the backfill is happening, it's
    time to start actually performing backfill chunks */
 class chunk_callback_t : public coro_pool_callback_t<backfill_queue_entry_t>,
@@ -55,12 +81,14 @@ public:
             fifo_enforcer_queue_t<backfill_queue_entry_t> *_chunk_queue,
             mailbox_manager_t *_mbox_manager,
             mailbox_addr_t<void(int)> _allocation_mailbox,
-            double *_progress_out) :
+            backfill_progress_t *_progress,
+            size_t _stream) :
         svs(_svs),
         chunk_queue(_chunk_queue),
         mbox_manager(_mbox_manager),
         allocation_mailbox(_allocation_mailbox),
-        progress_out(_progress_out),
+        progress(_progress),
+        stream(_stream),
         unacked_chunks(0),
         done_message_arrived(false),
         num_outstanding_chunks(0)
@@ -89,9 +117,7 @@ public:
         /* Warning: This function is called with the chunks in the right order.
         No re-ordering must happen before apply_backfill_chunk is called. */
         try {
-            if (progress_out != nullptr) {
-                *progress_out = chunk.progress;
-            }
+            progress->set_stream_progress(stream, chunk.progress);
 
             if (chunk.is_not_last_backfill_chunk) {
                 /* This is an actual backfill chunk */
@@ -155,7 +181,8 @@ private:
     fifo_enforcer_queue_t<backfill_queue_entry_t> *chunk_queue;
     mailbox_manager_t *mbox_manager;
     mailbox_addr_t<void(int)> allocation_mailbox;
-    double *progress_out;
+    backfill_progress_t *progress;
+    size_t stream;
     int unacked_chunks;
     bool done_message_arrived;
     int num_outstanding_chunks;
@@ -163,19 +190,20 @@ private:
     DISABLE_COPYING(chunk_callback_t);
 };
 
-void backfillee(
+/* Backfills `region` over a single backfill session. */
+static void backfill_stream(
         mailbox_manager_t *mailbox_manager,
         branch_history_manager_t *branch_history_manager,
         store_view_t *svs,
         region_t region,
         clone_ptr_t<watchable_t<boost::optional<boost::optional<backfiller_business_card_t> > > > backfiller_metadata,
         signal_t *interruptor,
-        double *progress_out)
+        backfill_progress_t *progress,
+        size_t stream)
         THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t)
 {
     backfill_session_id_t backfill_session_id = generate_uuid();
 
-    rassert(region_is_superset(svs->get_region(), region));
     resource_access_t<backfiller_business_card_t> backfiller(backfiller_metadata);
 
     /* Read the metadata to determine where we're starting from */
@@ -197,6 +225,27 @@ void backfillee(
         branch_history_manager->export_branch_history(start_point, &start_point_associated_history);
     }
 
+    /* Digest our rows, so that the backfiller can skip the ranges where it has the
+    same ones.  Nothing writes to the region until the backfill is over. */
+    backfill_digests_t digests;
+    {
+        read_token_t digest_token;
+        svs->new_read_token(&digest_token);
+#ifndef NDEBUG
+        trivial_metainfo_checker_callback_t metainfo_checker_callback;
+        metainfo_checker_t metainfo_checker(&metainfo_checker_callback, region);
+#endif
+        read_response_t response;
+        svs->read(DEBUG_ONLY(metainfo_checker, )
+                  read_t(backfill_digest_read_t(region), profile_bool_t::DONT_PROFILE),
+                  &response,
+                  order_source.check_in("backfillee(digests)").with_read_mode(),
+                  &digest_token,
+                  interruptor);
+        digests = std::move(
+            boost::get<backfill_digest_read_response_t>(response.response).digests);
+    }
+
     /* The backfiller will send a message to `end_point_mailbox` before it sends
     any other messages; that message will tell us what the version will be when
     the backfill is over. */
@@ -255,7 +304,7 @@ void backfillee(
         send(mailbox_manager,
             backfiller.access().backfill_mailbox,
             backfill_session_id,
-            start_point, start_point_associated_history,
+            start_point, start_point_associated_history, digests,
             end_point_mailbox.get_address(),
             chunk_mailbox.get_address(),
             done_mailbox.get_address(),
@@ -358,7 +407,7 @@ void backfillee(
             interruptor);
 
         chunk_callback_t chunk_callback(
-            svs, &chunk_queue, mailbox_manager, allocation_mailbox, progress_out);
+            svs, &chunk_queue, mailbox_manager, allocation_mailbox, progress, stream);
 
         coro_pool_t<backfill_queue_entry_t> backfill_workers(CHUNK_PROCESSING_CONCURRENCY,
                                                              &chunk_queue, &chunk_callback);
@@ -390,6 +439,101 @@ void backfillee(
         interruptor);
 }
 
+/* Asks the backfiller for keys that split `region` into at most `max_parts` parts
+holding about the same amount of data. */
+static std::vector<region_t> split_region(
+        mailbox_manager_t *mailbox_manager,
+        const region_t &region,
+        int max_parts,
+        clone_ptr_t<watchable_t<boost::optional<boost::optional<backfiller_business_card_t> > > > backfiller_metadata,
+        signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t)
+{
+    resource_access_t<backfiller_business_card_t> backfiller(backfiller_metadata);
+
+    promise_t<std::vector<store_key_t> > split_points_promise;
+    mailbox_t<void(std::vector<store_key_t>)> split_points_mailbox(
+        mailbox_manager,
+        [&](signal_t *, const std::vector<store_key_t> &split_points) {
+            split_points_promise.pulse(split_points);
+        });
+    send(mailbox_manager, backfiller.access().split_points_mailbox,
+         region, max_parts, split_points_mailbox.get_address());
+
+    {
+        wait_any_t waiter(split_points_promise.get_ready_signal(),
+                          backfiller.get_failed_signal());
+        wait_interruptible(&waiter, interruptor);
+
+        /* Throw an exception if backfiller died */
+        backfiller.access();
+        guarantee(split_points_promise.get_ready_signal()->is_pulsed());
+    }
+
+    std::vector<region_t> parts;
+    region_t part = region;
+    for (const store_key_t &split_point : split_points_promise.wait()) {
+        guarantee(region_contains_key(part, split_point));
+        guarantee(part.inner.left < split_point);
+        region_t left_part = part;
+        left_part.inner.right = key_range_t::right_bound_t(split_point);
+        parts.push_back(left_part);
+        part.inner.left = split_point;
+    }
+    parts.push_back(part);
+    return parts;
+}
+
+void backfillee(
+        mailbox_manager_t *mailbox_manager,
+        branch_history_manager_t *branch_history_manager,
+        store_view_t *svs,
+        region_t region,
+        clone_ptr_t<watchable_t<boost::optional<boost::optional<backfiller_business_card_t> > > > backfiller_metadata,
+        int max_streams,
+        signal_t *interruptor,
+        double *progress_out)
+        THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t)
+{
+    rassert(region_is_superset(svs->get_region(), region));
+    guarantee(max_streams >= 1);
+
+    if (max_streams == 1) {
+        backfill_progress_t progress(1, progress_out);
+        backfill_stream(mailbox_manager, branch_history_manager, svs, region,
+                        backfiller_metadata, interruptor, &progress, 0);
+        return;
+    }
+
+    std::vector<region_t> parts = split_region(
+        mailbox_manager, region, max_streams, backfiller_metadata, interruptor);
+
+    /* Each part gets its own session, with its own end point and flow control. If
+    one of them fails, we stop the others and rethrow its exception. */
+    backfill_progress_t progress(parts.size(), progress_out);
+    cond_t stream_failed;
+    wait_any_t stream_interruptor(interruptor, &stream_failed);
+    bool backfiller_lost = false;
+    pmap(parts.size(), [&](int64_t i) {
+        try {
+            backfill_stream(mailbox_manager, branch_history_manager, svs, parts[i],
+                            backfiller_metadata, &stream_interruptor, &progress, i);
+        } catch (const interrupted_exc_t &) {
+            stream_failed.pulse_if_not_already_pulsed();
+        } catch (const resource_lost_exc_t &) {
+            backfiller_lost = true;
+            stream_failed.pulse_if_not_already_pulsed();
+        }
+    });
+
+    if (interruptor->is_pulsed()) {
+        throw interrupted_exc_t();
+    }
+    if (backfiller_lost) {
+        throw resource_lost_exc_t();
+    }
+}
+
 peer_id_t extract_backfiller_peer_id(
         const boost::optional<boost::optional<backfiller_business_card_t> >
         &backfiller_metadata) {
@@ -12,7 +12,13 @@ template <class> class clone_ptr_t;
 template <class> class watchable_t;
 
 /* `backfillee()` contacts the given backfiller and requests a backfill from it.
-It takes responsibility for updating the metainfo. */
+It takes responsibility for updating the metainfo.
+
+With `max_streams > 1`, the region gets split into up to that many key ranges with
+about the same amount of data, which are backfilled over separate sessions at the
+same time. The parts are read from different snapshots, so they may end up at
+different versions; only use this if no writes can reach the backfiller meanwhile,
+or if the caller doesn't need the whole region to be at one version. */
 
 void backfillee(
         mailbox_manager_t *mailbox_manager,
@@ -28,6 +34,9 @@ void backfillee(
         /* The backfiller to backfill from. */
         clone_ptr_t<watchable_t<boost::optional<boost::optional<backfiller_business_card_t> > > > backfiller_metadata,
 
+        /* The most backfill sessions to split the region over. */
+        int max_streams,
+
         signal_t *interruptor,
 
         /* If this is non-null, `backfillee()` will periodically update it with the
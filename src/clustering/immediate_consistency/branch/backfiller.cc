@@ -21,6 +21,10 @@
 // never finish.
 #define MAX_CHUNKS_OUT 64
 
+// The depth and size of the distribution that split points get computed from.
+#define SPLIT_POINTS_DISTRIBUTION_DEPTH 2
+#define SPLIT_POINTS_DISTRIBUTION_LIMIT 128
+
 inline state_timestamp_t get_earliest_timestamp_of_version_range(const version_range_t &vr) {
     return vr.earliest.timestamp;
 }
@@ -31,14 +35,17 @@ backfiller_t::backfiller_t(mailbox_manager_t *mm,
     : mailbox_manager(mm), branch_history_manager(bhm),
       svs(_svs),
       backfill_mailbox(mailbox_manager,
-                       std::bind(&backfiller_t::on_backfill, this, ph::_1, ph::_2, ph::_3, ph::_4, ph::_5, ph::_6, ph::_7, ph::_8)),
+                       std::bind(&backfiller_t::on_backfill, this, ph::_1, ph::_2, ph::_3, ph::_4, ph::_5, ph::_6, ph::_7, ph::_8, ph::_9)),
       cancel_backfill_mailbox(mailbox_manager,
-                              std::bind(&backfiller_t::on_cancel_backfill, this, ph::_1, ph::_2))
+                              std::bind(&backfiller_t::on_cancel_backfill, this, ph::_1, ph::_2)),
+      split_points_mailbox(mailbox_manager,
+                           std::bind(&backfiller_t::on_split_points, this, ph::_1, ph::_2, ph::_3, ph::_4))
       { }
 
 backfiller_business_card_t backfiller_t::get_business_card() {
     return backfiller_business_card_t(backfill_mailbox.get_address(),
-                                                  cancel_backfill_mailbox.get_address());
+                                      cancel_backfill_mailbox.get_address(),
+                                      split_points_mailbox.get_address());
 }
 
 bool backfiller_t::confirm_and_send_metainfo(region_map_t<binary_blob_t> metainfo,
@@ -95,6 +102,7 @@ class backfiller_send_backfill_callback_t : public send_backfill_callback_t {
 public:
     backfiller_send_backfill_callback_t(
             const region_map_t<version_range_t> *start_point,
+            const backfill_digests_t *digests,
             mailbox_addr_t<void(region_map_t<version_range_t>, branch_history_t)> end_point_cont,
             mailbox_manager_t *mailbox_manager,
             mailbox_addr_t<void(
@@ -106,6 +114,7 @@ public:
             co_semaphore_t *chunk_semaphore,
             backfiller_t *backfiller)
         : start_point_(start_point),
+          digests_(digests),
           end_point_cont_(end_point_cont),
           mailbox_manager_(mailbox_manager),
           chunk_cont_(chunk_cont),
@@ -119,6 +128,10 @@ public:
         return backfiller_->confirm_and_send_metainfo(metainfo, *start_point_, end_point_cont_);
     }
 
+    const backfill_digests_t *get_backfill_digests() {
+        return digests_;
+    }
+
     void send_chunk(const backfill_chunk_t &chunk, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
         chunk_semaphore_->co_lock_interruptible(interruptor);
         progress_completion_fraction_t frac = progress_combiner_.guess_completion();
@@ -132,6 +145,7 @@ public:
     }
 private:
     const region_map_t<version_range_t> *start_point_;
+    const backfill_digests_t *digests_;
     mailbox_addr_t<void(region_map_t<version_range_t>, branch_history_t)> end_point_cont_;
     mailbox_manager_t *mailbox_manager_;
     mailbox_addr_t<void(
@@ -151,6 +165,7 @@ void backfiller_t::on_backfill(
         backfill_session_id_t session_id,
         const region_map_t<version_range_t> &start_point,
         const branch_history_t &start_point_associated_branch_history,
+        const backfill_digests_t &digests,
         mailbox_addr_t<void(region_map_t<version_range_t>, branch_history_t)> end_point_cont,
         mailbox_addr_t<void(
             backfill_chunk_t,
@@ -195,7 +210,8 @@ void backfiller_t::on_backfill(
         svs->new_read_token(&send_backfill_token);
 
         backfiller_send_backfill_callback_t send_backfill_cb(
-            &start_point, end_point_cont, mailbox_manager, chunk_cont, &fifo_src,
+            &start_point, &digests, end_point_cont, mailbox_manager, chunk_cont,
+            &fifo_src,
             &chunk_semaphore, this);
 
         /* Actually perform the backfill */
@@ -239,3 +255,63 @@ void backfiller_t::on_cancel_backfill(
     }
 }
 
+
+void backfiller_t::on_split_points(
+        signal_t *interruptor,
+        const region_t &region,
+        int max_parts,
+        const mailbox_addr_t<void(std::vector<store_key_t>)> &cont) {
+
+    assert_thread();
+    guarantee(region_is_superset(svs->get_region(), region));
+
+    std::map<store_key_t, int64_t> key_counts;
+    try {
+        read_token_t token;
+        svs->new_read_token(&token);
+
+#ifndef NDEBUG
+        trivial_metainfo_checker_callback_t metainfo_checker_callback;
+        metainfo_checker_t metainfo_checker(&metainfo_checker_callback, region);
+#endif
+
+        distribution_read_t inner_read(SPLIT_POINTS_DISTRIBUTION_DEPTH,
+                                       SPLIT_POINTS_DISTRIBUTION_LIMIT);
+        inner_read.region = region;
+        read_response_t response;
+        svs->read(DEBUG_ONLY(metainfo_checker, )
+                  read_t(inner_read, profile_bool_t::DONT_PROFILE),
+                  &response,
+                  order_source.check_in("backfiller_t::on_split_points").with_read_mode(),
+                  &token,
+                  interruptor);
+        key_counts = std::move(
+            boost::get<distribution_read_response_t>(response.response).key_counts);
+    } catch (const interrupted_exc_t &) {
+        /* The backfillee will find out via the directory. */
+        return;
+    }
+
+    /* Each bucket of the distribution starts at its key, so a split point goes at
+    the start of the first bucket past each `1 / max_parts` of the data. */
+    int64_t total_count = 0;
+    for (auto const &pair : key_counts) {
+        total_count += pair.second;
+    }
+    std::vector<store_key_t> split_points;
+    int64_t count_so_far = 0;
+    for (auto const &pair : key_counts) {
+        if (static_cast<int>(split_points.size()) + 1 >= max_parts) {
+            break;
+        }
+        const int64_t next_split_count =
+            (static_cast<int64_t>(split_points.size()) + 1) * total_count / max_parts;
+        if (count_so_far > 0 && count_so_far >= next_split_count
+                && region.inner.left < pair.first) {
+            split_points.push_back(pair.first);
+        }
+        count_so_far += pair.second;
+    }
+
+    send(mailbox_manager, cont, split_points);
+}
@@ -4,6 +4,7 @@
 
 #include <map>
 #include <utility>
+#include <vector>
 
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "clustering/immediate_consistency/branch/metadata.hpp"
@@ -38,6 +39,7 @@ private:
             backfill_session_id_t session_id,
             const region_map_t<version_range_t> &start_point,
             const branch_history_t &start_point_associated_branch_history,
+            const backfill_digests_t &digests,
             mailbox_addr_t<void(region_map_t<version_range_t>, branch_history_t)> end_point_cont,
             mailbox_addr_t<void(
                 backfill_chunk_t,
@@ -49,6 +51,12 @@ private:
 
     void on_cancel_backfill(signal_t *interruptor, backfill_session_id_t session_id);
 
+    void on_split_points(
+            signal_t *interruptor,
+            const region_t &region,
+            int max_parts,
+            const mailbox_addr_t<void(std::vector<store_key_t>)> &cont);
+
     mailbox_manager_t *const mailbox_manager;
     branch_history_manager_t *const branch_history_manager;
 
@@ -56,8 +64,11 @@ private:
 
     std::map<backfill_session_id_t, cond_t *> local_interruptors;
 
+    order_source_t order_source;
+
     backfiller_business_card_t::backfill_mailbox_t backfill_mailbox;
     backfiller_business_card_t::cancel_backfill_mailbox_t cancel_backfill_mailbox;
+    backfiller_business_card_t::split_points_mailbox_t split_points_mailbox;
 
     DISABLE_COPYING(backfiller_t);
 };
@@ -2,6 +2,8 @@
 #include "clustering/immediate_consistency/branch/broadcaster.hpp"
 
 #include <functional>
+#include <list>
+#include <vector>
 
 #include "errors.hpp"
 #include <boost/make_shared.hpp>
@@ -12,6 +14,7 @@
 #include "concurrency/cross_thread_signal.hpp"
 #include "containers/death_runner.hpp"
 #include "containers/uuid.hpp"
+#include "clustering/generic/replica_read_cost.hpp"
 #include "clustering/immediate_consistency/branch/listener.hpp"
 #include "clustering/immediate_consistency/branch/multistore.hpp"
 #include "rpc/mailbox/typed.hpp"
@@ -20,9 +23,15 @@
 #include "logger.hpp"
 #include "store_view.hpp"
 
-/* Limits how many writes should be sent to a listener at once. */
+/* Limits how many writes, or batches of writes, should be sent to a listener at
+once. */
 const size_t DISPATCH_WRITES_CORO_POOL_SIZE = 64;
 
+/* Limits how many writes get sent to a remote listener in a single message. The
+listener acks a batch once all of its writes are done, so this also bounds how long
+a write's ack can wait for those of writes that came after it. */
+const size_t DISPATCH_WRITES_MAX_BATCH_SIZE = 64;
+
 broadcaster_t::broadcaster_t(
         mailbox_manager_t *mm,
         rdb_context_t *_rdb_context,
@@ -116,7 +125,21 @@ store_view_t *broadcaster_t::release_bootstrap_svs_for_listener() {
     return tmp;
 }
 
+class ack_set_counter_t : public ack_counter_t {
+public:
+    explicit ack_set_counter_t(const ack_checker_t *_checker) : checker(_checker) { }
+    bool note_ack(const server_id_t &server) {
+        acks.insert(server);
+        return checker->is_acceptable_ack_set(acks);
+    }
+private:
+    const ack_checker_t *checker;
+    std::set<server_id_t> acks;
+};
 
+scoped_ptr_t<ack_counter_t> ack_checker_t::make_ack_counter() const {
+    return scoped_ptr_t<ack_counter_t>(new ack_set_counter_t(this));
+}
 
 /* `incomplete_write_t` represents a write that has been sent to some nodes
    but not completed yet. */
@@ -127,7 +150,8 @@ public:
                        state_timestamp_t ts,
                        const ack_checker_t *ac,
                        write_callback_t *cb) :
-        write(w), timestamp(ts), ack_checker(ac), callback(cb), parent(p), incomplete_count(0) { }
+        write(w), timestamp(ts), ack_checker(ac), callback(cb),
+        ack_counter(ac->make_ack_counter()), parent(p), incomplete_count(0) { }
 
     const write_t write;
     const state_timestamp_t timestamp;
@@ -138,9 +162,9 @@ public:
     don't call it again. */
     write_callback_t *callback;
 
-    /* This is the set of listeners that have acknowledged the write so far. When it
-    satisfies the ack checker, then `callback->on_success()` will be called. */
-    std::set<server_id_t> ack_set;
+    /* This counts the listeners that have acknowledged the write so far. When they
+    satisfy the ack checker, then `callback->on_success()` will be called. */
+    scoped_ptr_t<ack_counter_t> ack_counter;
 
 private:
     friend class incomplete_write_ref_t;
@@ -197,6 +221,18 @@ private:
     boost::shared_ptr<incomplete_write_t> write;
 };
 
+/* Writes that are on their way to a remote listener in a single message. A batch
+only holds one kind of write, either plain writes or write-reads, because they go to
+different mailboxes. */
+class broadcaster_t::write_batch_t {
+public:
+    explicit write_batch_t(bool _writeread) : writeread(_writeread) { }
+
+    bool writeread;
+    std::vector<incomplete_write_ref_t> write_refs;
+    std::vector<listener_write_t> writes;
+};
+
 /* The `registrar_t` constructs a `dispatchee_t` for every mirror that
    connects to us. */
 
@@ -204,7 +240,7 @@ class broadcaster_t::dispatchee_t : public intrusive_list_node_t<dispatchee_t> {
 public:
     dispatchee_t(broadcaster_t *c, listener_business_card_t d) THROWS_NOTHING :
         write_mailbox(d.write_mailbox), is_readable(false), server_id(d.server_id),
-        local_listener(NULL), listener_id(generate_uuid()),
+        local_listener(NULL), reads_in_flight(0), listener_id(generate_uuid()),
         queue_count(),
         queue_count_membership(&c->broadcaster_collection, &queue_count,
                                uuid_to_str(d.write_mailbox.get_peer().get_uuid())
@@ -317,6 +353,9 @@ public:
     listener_t *local_listener;
     auto_drainer_t::lock_t local_listener_keepalive;
 
+    /* How many of our single reads this dispatchee is working on right now. */
+    int64_t reads_in_flight;
+
     /* This is used to enforce that operations are performed on the
        destination server in the same order that we send them, even if the
        network layer reorders the messages. */
@@ -336,6 +375,10 @@ public:
     unlimited_fifo_queue_t<std::function<void()> > background_write_queue;
     calling_callback_t background_write_caller;
 
+    /* Batches of writes that haven't been sent yet, oldest first. Each one has a
+    job of its own in `background_write_queue`. */
+    std::list<write_batch_t> pending_write_batches;
+
 private:
     coro_pool_t<std::function<void()> > background_write_workers;
     broadcaster_t *controller;
@@ -382,7 +425,9 @@ void broadcaster_t::listener_write(
             [&](signal_t *) { ack_cond.pulse(); });
 
         send(mailbox_manager, mirror->write_mailbox,
-             w, ts, order_token, token, ack_mailbox.get_address());
+             std::vector<listener_write_t>(1, listener_write_t(
+                 w, ts, order_token, token, write_durability_t::SOFT)),
+             ack_mailbox.get_address());
 
         wait_interruptible(&ack_cond, interruptor);
     }
@@ -405,7 +450,8 @@ void broadcaster_t::listener_read(
             [&](signal_t *, const read_response_t &resp) {
                 *response = resp;
                 resp_cond.pulse();
-            });
+            },
+            message_priority_t::HIGH);
 
         send(mailbox_manager, mirror->read_mailbox,
              r, ts, order_token, token, resp_mailbox.get_address());
@@ -500,14 +546,48 @@ void broadcaster_t::spawn_write(const write_t &write,
         that we don't check `interruptor` until the write is on its way
         to every dispatchee. */
         fifo_enforcer_write_token_t fifo_enforcer_token = it->first->fifo_source.enter_write();
-        if (it->first->is_readable) {
-            it->first->background_write_queue.push(boost::bind(&broadcaster_t::background_writeread, this,
-                it->first, it->second, write_ref, order_token, fifo_enforcer_token, durability));
+        enqueue_write(it->first, it->second, write_ref, order_token,
+                      fifo_enforcer_token, it->first->is_readable, durability);
+    }
+}
+
+void broadcaster_t::enqueue_write(
+        dispatchee_t *mirror, const auto_drainer_t::lock_t &mirror_lock,
+        const incomplete_write_ref_t &write_ref, order_token_t order_token,
+        fifo_enforcer_write_token_t token, bool writeread,
+        write_durability_t durability) THROWS_NOTHING {
+    ASSERT_NO_CORO_WAITING;
+    if (mirror->is_local()) {
+        if (writeread) {
+            mirror->background_write_queue.push(boost::bind(
+                &broadcaster_t::background_writeread, this,
+                mirror, mirror_lock, write_ref, order_token, token, durability));
         } else {
-            it->first->background_write_queue.push(boost::bind(&broadcaster_t::background_write, this,
-                it->first, it->second, write_ref, order_token, fifo_enforcer_token));
+            mirror->background_write_queue.push(boost::bind(
+                &broadcaster_t::background_write, this,
+                mirror, mirror_lock, write_ref, order_token, token));
         }
+        return;
     }
+
+    /* The listener puts the writes back in order using their fifo tokens, so batches
+    can be in flight concurrently just like individual writes. */
+    if (mirror->pending_write_batches.empty()
+            || mirror->pending_write_batches.back().writeread != writeread
+            || mirror->pending_write_batches.back().writes.size()
+                >= DISPATCH_WRITES_MAX_BATCH_SIZE) {
+        mirror->pending_write_batches.push_back(write_batch_t(writeread));
+        mirror->background_write_queue.push(boost::bind(
+            &broadcaster_t::background_write_batch, this, mirror, mirror_lock));
+    }
+    /* Non-write-reads are always performed with soft durability on the listener, and
+    `write_durability_t::INVALID` can't be serialized. */
+    incomplete_write_ref_t ref = write_ref;
+    write_batch_t *batch = &mirror->pending_write_batches.back();
+    batch->writes.push_back(listener_write_t(
+        ref.get()->write, ref.get()->timestamp, order_token, token,
+        writeread ? durability : write_durability_t::SOFT));
+    batch->write_refs.push_back(ref);
 }
 
 void broadcaster_t::pick_a_readable_dispatchee(
@@ -522,20 +602,25 @@ void broadcaster_t::pick_a_readable_dispatchee(
             "the primary replica mirror should be always readable.");
     }
 
-    /* Prefer a local dispatchee (at the moment there always should be exactly one) */
+    /* Pick the dispatchee that looks like it will answer soonest. The local one (at
+    the moment there always should be exactly one) is free to reach, so it wins unless
+    it's much busier with our reads than a nearby mirror, and it wins ties. */
     dispatchee_t *selected_dispatchee = NULL;
+    int64_t selected_cost = 0;
     for (dispatchee_t *d = readable_dispatchees.head();
          d != NULL;
          d = readable_dispatchees.next(d)) {
-        if (d->is_local()) {
+        const int64_t round_trip_time_us = d->is_local()
+            ? 0
+            : get_peer_round_trip_time_us(mailbox_manager, d->read_mailbox.get_peer());
+        const int64_t cost =
+            estimate_replica_read_cost_us(round_trip_time_us, d->reads_in_flight);
+        if (selected_dispatchee == NULL || cost < selected_cost ||
+                (cost == selected_cost && d->is_local())) {
             selected_dispatchee = d;
-            break;
+            selected_cost = cost;
         }
     }
-    if (selected_dispatchee == NULL) {
-        /* If we don't have a local one, just pick the first one we can get */
-        selected_dispatchee = readable_dispatchees.head();
-    }
 
     *dispatchee_out = selected_dispatchee;
     *lock_out = dispatchees[selected_dispatchee];
@@ -587,40 +672,89 @@ void broadcaster_t::background_writeread(
                     token, durability, mirror_lock.get_drain_signal());
         } else {
             cond_t response_cond;
-            mailbox_t<void(write_response_t)> response_mailbox(
+            mailbox_t<void(std::vector<write_response_t>)> response_mailbox(
                 mailbox_manager,
-                [&](signal_t *, const write_response_t &resp) {
-                    response = resp;
+                [&](signal_t *, const std::vector<write_response_t> &resps) {
+                    guarantee(resps.size() == 1);
+                    response = resps[0];
                     response_cond.pulse();
                 });
 
-            send(mailbox_manager, mirror->writeread_mailbox, write_ref.get()->write,
-                 write_ref.get()->timestamp, order_token, token,
-                 response_mailbox.get_address(), durability);
+            send(mailbox_manager, mirror->writeread_mailbox,
+                 std::vector<listener_write_t>(1, listener_write_t(
+                     write_ref.get()->write, write_ref.get()->timestamp, order_token,
+                     token, durability)),
+                 response_mailbox.get_address());
 
             wait_interruptible(&response_cond, mirror_lock.get_drain_signal());
         }
 
-        write_ref.get()->ack_set.insert(mirror->server_id);
-        if (write_ref.get()->ack_checker->is_acceptable_ack_set(write_ref.get()->ack_set)) {
-            /* We might get here multiple times, if `is_acceptable_ack_set()`
-            returns `true` before all of the acks have come back. To avoid
-            calling the callback multiple times, we set `callback` to `NULL`
-            after the first time. This also signals `end_write()` not to call
-            `on_failure()`. */
-            if (write_ref.get()->callback != NULL) {
-                guarantee(write_ref.get()->callback->write == write_ref.get().get());
-                write_ref.get()->callback->write = NULL;
-                write_ref.get()->callback->on_success(response);
-                write_ref.get()->callback = NULL;
+        on_writeread_ack(write_ref, mirror->server_id, response);
+    } catch (const interrupted_exc_t &) {
+        return;
+    }
+}
+
+void broadcaster_t::background_write_batch(
+        dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock) THROWS_NOTHING {
+    guarantee(!mirror->pending_write_batches.empty());
+    write_batch_t batch = std::move(mirror->pending_write_batches.front());
+    mirror->pending_write_batches.pop_front();
+
+    try {
+        if (batch.writeread) {
+            std::vector<write_response_t> responses;
+            cond_t responses_cond;
+            mailbox_t<void(std::vector<write_response_t>)> responses_mailbox(
+                mailbox_manager,
+                [&](signal_t *, const std::vector<write_response_t> &resps) {
+                    responses = resps;
+                    responses_cond.pulse();
+                });
+
+            send(mailbox_manager, mirror->writeread_mailbox, batch.writes,
+                 responses_mailbox.get_address());
+
+            wait_interruptible(&responses_cond, mirror_lock.get_drain_signal());
+
+            guarantee(responses.size() == batch.write_refs.size());
+            for (size_t i = 0; i < responses.size(); ++i) {
+                on_writeread_ack(batch.write_refs[i], mirror->server_id, responses[i]);
             }
-        }
+        } else {
+            cond_t ack_cond;
+            mailbox_t<void()> ack_mailbox(
+                mailbox_manager,
+                [&](signal_t *) { ack_cond.pulse(); });
+
+            send(mailbox_manager, mirror->write_mailbox, batch.writes,
+                 ack_mailbox.get_address());
 
+            wait_interruptible(&ack_cond, mirror_lock.get_drain_signal());
+        }
     } catch (const interrupted_exc_t &) {
         return;
     }
 }
 
+void broadcaster_t::on_writeread_ack(
+        incomplete_write_ref_t write_ref, const server_id_t &server_id,
+        const write_response_t &response) THROWS_NOTHING {
+    if (write_ref.get()->ack_counter->note_ack(server_id)) {
+        /* We might get here multiple times, if the ack counter returns
+        `true` before all of the acks have come back. To avoid
+        calling the callback multiple times, we set `callback` to `NULL`
+        after the first time. This also signals `end_write()` not to call
+        `on_failure()`. */
+        if (write_ref.get()->callback != NULL) {
+            guarantee(write_ref.get()->callback->write == write_ref.get().get());
+            write_ref.get()->callback->write = NULL;
+            write_ref.get()->callback->on_success(response);
+            write_ref.get()->callback = NULL;
+        }
+    }
+}
+
 void broadcaster_t::end_write(boost::shared_ptr<incomplete_write_t> write) THROWS_NOTHING {
     /* Acquire `mutex` so that anything that holds `mutex` sees a consistent
     view of `newest_complete_timestamp` and the front of `incomplete_writes`.
@@ -680,8 +814,11 @@ void broadcaster_t::single_read(
         /* This is safe even if `interruptor` gets pulsed because nothing
         checks `interruptor` until after we have sent the message. */
         enforcer_token = reader->fifo_source.enter_read();
+        ++reader->reads_in_flight;
     }
 
+    /* `reader_lock` keeps `reader` alive until this runs. */
+    death_runner_t read_done([reader]() { --reader->reads_in_flight; });
     try {
         wait_any_t interruptor2(reader_lock.get_drain_signal(), interruptor);
         listener_read(reader, read, response, timestamp, order_token, enforcer_token,
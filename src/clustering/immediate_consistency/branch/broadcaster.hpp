@@ -14,6 +14,7 @@
 #include "clustering/immediate_consistency/branch/history.hpp"
 #include "clustering/immediate_consistency/branch/metadata.hpp"
 #include "concurrency/queue/unlimited_fifo.hpp"
+#include "containers/scoped.hpp"
 #include "timestamps.hpp"
 
 class listener_t;
@@ -23,11 +24,26 @@ class mailbox_manager_t;
 class rdb_context_t;
 class uuid_u;
 
+/* `ack_counter_t` keeps track of the acks for a single write. */
+class ack_counter_t {
+public:
+    virtual ~ack_counter_t() { }
+    /* Records an ack from `server`, which must not have acked the write before, and
+    returns `true` if the acks so far are acceptable. */
+    virtual bool note_ack(const server_id_t &server) = 0;
+};
+
 class ack_checker_t : public home_thread_mixin_t {
 public:
     virtual bool is_acceptable_ack_set(const std::set<server_id_t> &acks) const = 0;
     virtual write_durability_t get_write_durability() const = 0;
 
+    /* Returns a counter for the acks of one write. The default one collects the acks
+    in a set and calls `is_acceptable_ack_set()` on it for every ack; checkers that can
+    count acks incrementally should override this, since it's called for every write
+    and the counter for every ack. The counter may refer to the `ack_checker_t`. */
+    virtual scoped_ptr_t<ack_counter_t> make_ack_counter() const;
+
     ack_checker_t() { }
 protected:
     virtual ~ack_checker_t() { }
@@ -120,6 +136,8 @@ private:
 
     class dispatchee_t;
 
+    class write_batch_t;
+
     /* Reads need to pick a single readable mirror to perform the operation.
     Writes need to choose a readable mirror to get the reply from. Both use
     `pick_a_readable_dispatchee()` to do the picking. You must hold
@@ -142,6 +160,21 @@ private:
         dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock,
         incomplete_write_ref_t write_ref, order_token_t order_token,
         fifo_enforcer_write_token_t token, write_durability_t durability) THROWS_NOTHING;
+
+    /* Writes to a local listener each get a `background_write()` or
+    `background_writeread()` of their own. Writes to a remote listener get added to
+    its newest pending batch instead, and `background_write_batch()` sends the
+    batch in a single message. */
+    void enqueue_write(
+        dispatchee_t *mirror, const auto_drainer_t::lock_t &mirror_lock,
+        const incomplete_write_ref_t &write_ref, order_token_t order_token,
+        fifo_enforcer_write_token_t token, bool writeread,
+        write_durability_t durability) THROWS_NOTHING;
+    void background_write_batch(
+        dispatchee_t *mirror, auto_drainer_t::lock_t mirror_lock) THROWS_NOTHING;
+    void on_writeread_ack(
+        incomplete_write_ref_t write_ref, const server_id_t &server_id,
+        const write_response_t &response) THROWS_NOTHING;
     void end_write(boost::shared_ptr<incomplete_write_t> write) THROWS_NOTHING;
 
     void single_read(
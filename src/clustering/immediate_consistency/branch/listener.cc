@@ -15,6 +15,7 @@
 #include "concurrency/cond_var.hpp"
 #include "concurrency/coro_pool.hpp"
 #include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/pmap.hpp"
 #include "concurrency/wait_any.hpp"
 #include "containers/archive/versioned.hpp"
 #include "rdb_protocol/protocol.hpp"
@@ -59,6 +60,21 @@ private:
 };
 #endif // NDEBUG
 
+/* Counts a write in `listener_t::writes_in_flight_` for as long as it exists. */
+class in_flight_write_t {
+public:
+    explicit in_flight_write_t(int *_count) : count(_count) {
+        ++*count;
+    }
+    ~in_flight_write_t() {
+        --*count;
+    }
+private:
+    int *const count;
+
+    DISABLE_COPYING(in_flight_write_t);
+};
+
 listener_t::listener_t(const base_path_t &base_path,
                        io_backender_t *io_backender,
                        mailbox_manager_t *mm,
@@ -80,6 +96,7 @@ listener_t::listener_t(const base_path_t &base_path,
     uuid_(generate_uuid()),
     perfmon_collection_(),
     perfmon_collection_membership_(backfill_stats_parent, &perfmon_collection_, "backfill-serialization-" + uuid_to_str(uuid_)),
+    writes_in_flight_(0),
     /* TODO: Put the file in the data directory, not here */
     write_queue_(io_backender,
                  serializer_filepath_t(base_path, "backfill-serialization-" + uuid_to_str(uuid_)),
@@ -87,11 +104,12 @@ listener_t::listener_t(const base_path_t &base_path,
     write_queue_semaphore_(SEMAPHORE_NO_LIMIT,
         WRITE_QUEUE_SEMAPHORE_TRICKLE_FRACTION),
     write_mailbox_(mailbox_manager_,
-        std::bind(&listener_t::on_write, this, ph::_1, ph::_2, ph::_3, ph::_4, ph::_5, ph::_6)),
+        std::bind(&listener_t::on_write, this, ph::_1, ph::_2, ph::_3)),
     writeread_mailbox_(mailbox_manager_,
-        std::bind(&listener_t::on_writeread, this, ph::_1, ph::_2, ph::_3, ph::_4, ph::_5, ph::_6, ph::_7)),
+        std::bind(&listener_t::on_writeread, this, ph::_1, ph::_2, ph::_3)),
     read_mailbox_(mailbox_manager_,
-        std::bind(&listener_t::on_read, this, ph::_1, ph::_2, ph::_3, ph::_4, ph::_5, ph::_6))
+        std::bind(&listener_t::on_read, this, ph::_1, ph::_2, ph::_3, ph::_4, ph::_5, ph::_6),
+        message_priority_t::HIGH)
 {
     boost::optional<boost::optional<broadcaster_business_card_t> > business_card =
         broadcaster_metadata->get();
@@ -178,6 +196,9 @@ listener_t::listener_t(const base_path_t &base_path,
                        svs_,
                        svs_->get_region(),
                        replier->subview(&listener_t::get_backfiller_from_replier_bcard),
+                       /* The backfill must be serialized with respect to the
+                       writes we queued up, so it can't be split. */
+                       1,
                        interruptor,
                        backfill_progress_out);
         } // Release throttler_lock
@@ -259,16 +280,18 @@ listener_t::listener_t(const base_path_t &base_path,
     uuid_(generate_uuid()),
     perfmon_collection_(),
     perfmon_collection_membership_(backfill_stats_parent, &perfmon_collection_, "backfill-serialization-" + uuid_to_str(uuid_)),
+    writes_in_flight_(0),
     /* TODO: Put the file in the data directory, not here */
     write_queue_(io_backender, serializer_filepath_t(base_path, "backfill-serialization-" + uuid_to_str(uuid_)), &perfmon_collection_),
     write_queue_semaphore_(WRITE_QUEUE_SEMAPHORE_LONG_TERM_CAPACITY,
         WRITE_QUEUE_SEMAPHORE_TRICKLE_FRACTION),
     write_mailbox_(mailbox_manager_,
-        std::bind(&listener_t::on_write, this, ph::_1, ph::_2, ph::_3, ph::_4, ph::_5, ph::_6)),
+        std::bind(&listener_t::on_write, this, ph::_1, ph::_2, ph::_3)),
     writeread_mailbox_(mailbox_manager_,
-        std::bind(&listener_t::on_writeread, this, ph::_1, ph::_2, ph::_3, ph::_4, ph::_5, ph::_6, ph::_7)),
+        std::bind(&listener_t::on_writeread, this, ph::_1, ph::_2, ph::_3)),
     read_mailbox_(mailbox_manager_,
-        std::bind(&listener_t::on_read, this, ph::_1, ph::_2, ph::_3, ph::_4, ph::_5, ph::_6))
+        std::bind(&listener_t::on_read, this, ph::_1, ph::_2, ph::_3, ph::_4, ph::_5, ph::_6),
+        message_priority_t::HIGH)
 {
     branch_birth_certificate_t this_branch_history;
     {
@@ -405,14 +428,16 @@ void listener_t::try_start_receiving_writes(
 
 void listener_t::on_write(
         signal_t *interruptor,
-        const write_t &write,
-        state_timestamp_t timestamp,
-        order_token_t order_token,
-        fifo_enforcer_write_token_t fifo_token,
+        const std::vector<listener_write_t> &writes,
         mailbox_addr_t<void()> ack_addr)
         THROWS_NOTHING {
     try {
-        local_write(write, timestamp, order_token, fifo_token, interruptor);
+        /* `local_write()` only waits for the write to be queued up, so there's
+        nothing to gain from running the batch's writes concurrently. */
+        for (const listener_write_t &w : writes) {
+            local_write(w.write, w.timestamp, w.order_token, w.fifo_token,
+                        interruptor);
+        }
         send(mailbox_manager_, ack_addr);
     } catch (const interrupted_exc_t &) {
         /* pass */
@@ -446,6 +471,13 @@ void listener_t::perform_enqueued_write(const write_queue_entry_t &qe,
         write_queue_has_drained_.pulse_if_not_already_pulsed();
     }
 
+    in_flight_write_t in_flight(&writes_in_flight_);
+    if (writes_in_flight_ > 1 && qe.timestamp > backfill_end_timestamp) {
+        /* The later writes can't enter the store before this one, but they can
+        prefetch concurrently with it. */
+        svs_->prefetch_for_write(qe.write);
+    }
+
     write_token_t write_token;
     {
         fifo_enforcer_sink_t::exit_write_t fifo_exit(&store_entrance_sink_, qe.fifo_token);
@@ -482,20 +514,26 @@ void listener_t::perform_enqueued_write(const write_queue_entry_t &qe,
 
 void listener_t::on_writeread(
         signal_t *interruptor,
-        const write_t &write,
-        state_timestamp_t timestamp,
-        order_token_t order_token,
-        fifo_enforcer_write_token_t fifo_token,
-        mailbox_addr_t<void(write_response_t)> ack_addr,
-        write_durability_t durability)
+        const std::vector<listener_write_t> &writes,
+        mailbox_addr_t<void(std::vector<write_response_t>)> ack_addr)
         THROWS_NOTHING {
-    try {
-        write_response_t response = local_writeread(write, timestamp,
-                                                    order_token, fifo_token,
-                                                    durability, interruptor);
-        send(mailbox_manager_, ack_addr, response);
-    } catch (const interrupted_exc_t &) {
-        /* pass */
+    /* The batch's writes enter the store in order, because `local_writeread()` waits
+    for each one's turn at `store_entrance_sink_`, but after that they run
+    concurrently. */
+    std::vector<write_response_t> responses(writes.size());
+    bool interrupted = false;
+    pmap(writes.size(), [&](size_t i) {
+        try {
+            responses[i] = local_writeread(writes[i].write, writes[i].timestamp,
+                                           writes[i].order_token,
+                                           writes[i].fifo_token,
+                                           writes[i].durability, interruptor);
+        } catch (const interrupted_exc_t &) {
+            interrupted = true;
+        }
+    });
+    if (!interrupted) {
+        send(mailbox_manager_, ack_addr, responses);
     }
 }
 
@@ -513,6 +551,7 @@ write_response_t listener_t::local_writeread(const write_t &write,
 
     auto_drainer_t::lock_t keepalive(&drainer_);
     wait_any_t combined_interruptor(keepalive.get_drain_signal(), interruptor);
+    in_flight_write_t in_flight(&writes_in_flight_);
     write_token_t write_token;
     {
         {
@@ -521,6 +560,10 @@ write_response_t listener_t::local_writeread(const write_t &write,
             fifo_enforcer_sink_t::exit_write_t fifo_exit_1(&write_queue_entrance_sink_, fifo_token);
         }
 
+        if (writes_in_flight_ > 1) {
+            svs_->prefetch_for_write(write);
+        }
+
         fifo_enforcer_sink_t::exit_write_t fifo_exit_2(&store_entrance_sink_, fifo_token);
         wait_interruptible(&fifo_exit_2, &combined_interruptor);
 
@@ -178,10 +178,7 @@ private:
 
     void on_write(
             signal_t *interruptor,
-            const write_t &write,
-            state_timestamp_t timestamp,
-            order_token_t order_token,
-            fifo_enforcer_write_token_t fifo_token,
+            const std::vector<listener_write_t> &writes,
             mailbox_addr_t<void()> ack_addr)
         THROWS_NOTHING;
 
@@ -193,12 +190,8 @@ private:
 
     void on_writeread(
             signal_t *interruptor,
-            const write_t &write,
-            state_timestamp_t timestamp,
-            order_token_t order_token,
-            fifo_enforcer_write_token_t fifo_token,
-            mailbox_addr_t<void(write_response_t)> ack_addr,
-            write_durability_t durability)
+            const std::vector<listener_write_t> &writes,
+            mailbox_addr_t<void(std::vector<write_response_t>)> ack_addr)
         THROWS_NOTHING;
 
     void on_read(
@@ -239,6 +232,12 @@ private:
     state_timestamp_t current_timestamp_;
     fifo_enforcer_sink_t store_entrance_sink_;
 
+    /* How many writes are waiting to enter the store or are running in it. When
+    there are some, a new write prefetches what it's going to touch before it gets
+    in line, so that writes to different keys wait for the disk concurrently rather
+    than one after another. */
+    int writes_in_flight_;
+
     // Used by the replier_t which needs to be able to tell
     // backfillees how up to date it is.
     std::multimap<state_timestamp_t, cond_t *> synchronize_waiters_;
@@ -1,6 +1,8 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "clustering/immediate_consistency/branch/metadata.hpp"
 
+RDB_IMPL_SERIALIZABLE_5_FOR_CLUSTER(
+        listener_write_t, write, timestamp, order_token, fifo_token, durability);
 
 RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(
         listener_business_card_t,
@@ -10,12 +12,14 @@ RDB_IMPL_SERIALIZABLE_4_SINCE_v1_13(
         listener_intro_t, broadcaster_begin_timestamp, upgrade_mailbox,
         downgrade_mailbox, listener_id);
 
-RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(
-        backfiller_business_card_t, backfill_mailbox, cancel_backfill_mailbox);
+RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(
+        backfiller_business_card_t, backfill_mailbox, cancel_backfill_mailbox,
+        split_points_mailbox);
 
-RDB_IMPL_EQUALITY_COMPARABLE_2(backfiller_business_card_t,
+RDB_IMPL_EQUALITY_COMPARABLE_3(backfiller_business_card_t,
                                backfill_mailbox,
-                               cancel_backfill_mailbox);
+                               cancel_backfill_mailbox,
+                               split_points_mailbox);
 
 RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(
         broadcaster_business_card_t, branch_id, branch_id_associated_branch_history,
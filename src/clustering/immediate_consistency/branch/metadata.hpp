@@ -4,6 +4,7 @@
 
 #include <map>
 #include <utility>
+#include <vector>
 
 #include "clustering/generic/registration_metadata.hpp"
 #include "clustering/immediate_consistency/branch/history.hpp"
@@ -12,6 +13,7 @@
 #include "concurrency/promise.hpp"
 #include "containers/uuid.hpp"
 #include "protocol_api.hpp"
+#include "rdb_protocol/protocol.hpp"
 #include "rpc/mailbox/typed.hpp"
 #include "rpc/semilattice/joins/macros.hpp"
 #include "rpc/semilattice/joins/map.hpp"
@@ -19,26 +21,42 @@
 
 class listener_intro_t;
 
+/* The master sends writes to the mirrors in batches of `listener_write_t`s, in the
+order the writes are to be performed in. */
+
+class listener_write_t {
+public:
+    listener_write_t() { }
+    listener_write_t(const write_t &w, state_timestamp_t ts, order_token_t ot,
+                     fifo_enforcer_write_token_t ft, write_durability_t d)
+        : write(w), timestamp(ts), order_token(ot), fifo_token(ft), durability(d) { }
+
+    write_t write;
+    state_timestamp_t timestamp;
+    order_token_t order_token;
+    fifo_enforcer_write_token_t fifo_token;
+    /* Only write-reads use this; the mirror applies plain writes with soft
+    durability. */
+    write_durability_t durability;
+};
+
+RDB_DECLARE_SERIALIZABLE(listener_write_t);
+
 /* Every `listener_t` constructs a `listener_business_card_t` and sends it to
 the `broadcaster_t`. */
 
 class listener_business_card_t {
 public:
     /* These are the types of mailboxes that the master uses to communicate with
-    the mirrors. */
+    the mirrors. A write-read batch gets one response per write, in the same
+    order. */
 
-    typedef mailbox_t<void(write_t,
-                           state_timestamp_t,
-                           order_token_t,
-                           fifo_enforcer_write_token_t,
+    typedef mailbox_t<void(std::vector<listener_write_t>,
                            mailbox_addr_t<void()> ack_addr)> write_mailbox_t;
 
-    typedef mailbox_t<void(write_t,
-                           state_timestamp_t,
-                           order_token_t,
-                           fifo_enforcer_write_token_t,
-                           mailbox_addr_t<void(write_response_t)>,
-                           write_durability_t)> writeread_mailbox_t;
+    typedef mailbox_t<void(std::vector<listener_write_t>,
+                           mailbox_addr_t<void(std::vector<write_response_t>)>
+                           )> writeread_mailbox_t;
 
     typedef mailbox_t<void(read_t,
                            state_timestamp_t,
@@ -97,10 +115,13 @@ backfills over the network. It appears in the directory. */
 
 struct backfiller_business_card_t {
 
+    /* The backfillee sends its start point along with digests of its rows, so that
+    the backfiller can skip the key ranges where they agree. */
     typedef mailbox_t< void(
         backfill_session_id_t,
         region_map_t<version_range_t>,
         branch_history_t,
+        backfill_digests_t,
         mailbox_addr_t< void(
             region_map_t<version_range_t>,
             branch_history_t
@@ -116,15 +137,26 @@ struct backfiller_business_card_t {
 
     typedef mailbox_t<void(backfill_session_id_t)> cancel_backfill_mailbox_t;
 
+    /* Replies with at most `max_parts - 1` keys that split the given region into
+    parts holding about the same amount of data, so that the backfillee can backfill
+    the parts over separate sessions at the same time. */
+    typedef mailbox_t<void(
+        region_t,
+        int,
+        mailbox_addr_t<void(std::vector<store_key_t>)>
+        )> split_points_mailbox_t;
+
     backfiller_business_card_t() { }
     backfiller_business_card_t(
             const backfill_mailbox_t::address_t &ba,
-            const cancel_backfill_mailbox_t::address_t &cba) :
-        backfill_mailbox(ba), cancel_backfill_mailbox(cba)
+            const cancel_backfill_mailbox_t::address_t &cba,
+            const split_points_mailbox_t::address_t &spa) :
+        backfill_mailbox(ba), cancel_backfill_mailbox(cba), split_points_mailbox(spa)
         { }
 
     backfill_mailbox_t::address_t backfill_mailbox;
     cancel_backfill_mailbox_t::address_t cancel_backfill_mailbox;
+    split_points_mailbox_t::address_t split_points_mailbox;
 };
 
 RDB_DECLARE_SERIALIZABLE(backfiller_business_card_t);
@@ -10,7 +10,8 @@ direct_reader_t::direct_reader_t(
     mailbox_manager(mm),
     svs(svs_),
     read_mailbox(mm, std::bind(&direct_reader_t::on_read, this,
-                               ph::_1, ph::_2, ph::_3))
+                               ph::_1, ph::_2, ph::_3),
+                 message_priority_t::HIGH)
     { }
 
 direct_reader_business_card_t direct_reader_t::get_business_card() {
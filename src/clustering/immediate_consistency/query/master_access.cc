@@ -55,7 +55,8 @@ void master_access_t::read(
             mailbox_manager,
             [&](signal_t *, const boost::variant<read_response_t, std::string> &res) {
                 result_or_failure.pulse(res);
-            });
+            },
+            message_priority_t::HIGH);
 
     wait_interruptible(token, interruptor);
     fifo_enforcer_read_token_t token_for_master = source_for_master.enter_read();
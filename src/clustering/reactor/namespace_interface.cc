@@ -1,17 +1,19 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "clustering/reactor/namespace_interface.hpp"
 
+#include <algorithm>
 #include <functional>
 
+#include "clustering/generic/replica_read_cost.hpp"
 #include "clustering/immediate_consistency/query/master_access.hpp"
 #include "concurrency/fifo_enforcer.hpp"
+#include "containers/death_runner.hpp"
 #include "concurrency/watchable.hpp"
 #include "rdb_protocol/env.hpp"
 
 cluster_namespace_interface_t::cluster_namespace_interface_t(
         mailbox_manager_t *mm,
-        const std::map<namespace_id_t, std::map<key_range_t, server_id_t> >
-            *region_to_primary_maps_,
+        read_mostly_t<region_to_primary_maps_t> *region_to_primary_maps_,
         watchable_map_t<peer_id_t, namespace_directory_metadata_t> *dv,
         const namespace_id_t &namespace_id_,
         rdb_context_t *_ctx)
@@ -20,6 +22,7 @@ cluster_namespace_interface_t::cluster_namespace_interface_t(
       directory_view(dv),
       namespace_id(namespace_id_),
       ctx(_ctx),
+      point_routes_valid(false),
       start_count(0),
       starting_up(true),
       subs(directory_view,
@@ -123,6 +126,39 @@ cluster_namespace_interface_t::get_sharding_scheme() THROWS_ONLY(cannot_perform_
     return std::set<region_t>(s.begin(), s.end());
 }
 
+const cluster_namespace_interface_t::point_route_t *
+cluster_namespace_interface_t::find_point_route(const store_key_t &key) {
+    if (!point_routes_valid) {
+        point_routes.clear();
+        for (auto it = relationships.begin(); it != relationships.end(); ++it) {
+            if (it->first.beg != 0 || it->first.end != HASH_REGION_HASH_SIZE) {
+                point_routes.clear();
+                break;
+            }
+            point_route_t route;
+            route.region = it->first;
+            route.relationships = it->second;
+            point_routes.push_back(std::move(route));
+        }
+        std::sort(point_routes.begin(), point_routes.end(),
+            [](const point_route_t &a, const point_route_t &b) {
+                return a.region.inner.left < b.region.inner.left;
+            });
+        point_routes_valid = true;
+    }
+
+    /* Find the last region whose left bound isn't after `key`. */
+    auto it = std::upper_bound(point_routes.begin(), point_routes.end(), key,
+        [](const store_key_t &k, const point_route_t &route) {
+            return k < route.region.inner.left;
+        });
+    if (it == point_routes.begin()) {
+        return NULL;
+    }
+    --it;
+    return it->region.inner.contains_key(key) ? &*it : NULL;
+}
+
 template<class op_type, class fifo_enforcer_token_type, class op_response_type>
 void cluster_namespace_interface_t::dispatch_immediate_op(
     /* `how_to_make_token` and `how_to_run_query` have type pointer-to-
@@ -148,47 +184,60 @@ void cluster_namespace_interface_t::dispatch_immediate_op(
         masters_to_contact;
     scoped_ptr_t<immediate_op_info_t<op_type, fifo_enforcer_token_type> >
         new_op_info(new immediate_op_info_t<op_type, fifo_enforcer_token_type>());
-    for (auto it = relationships.begin(); it != relationships.end(); ++it) {
-        if (op.shard(it->first, &new_op_info->sharded_op)) {
-            relationship_t *chosen_relationship = NULL;
-            const std::set<relationship_t *> *relationship_map = &it->second;
-            for (auto jt = relationship_map->begin();
-                 jt != relationship_map->end();
-                 ++jt) {
-                if ((*jt)->master_access) {
-                    if (chosen_relationship) {
-                        throw cannot_perform_query_exc_t(
-                            "Too many primary replicas available");
-                    }
-                    chosen_relationship = *jt;
+    auto contact_master = [&](const region_t &region,
+                              const std::set<relationship_t *> &relationship_map) {
+        relationship_t *chosen_relationship = NULL;
+        for (auto jt = relationship_map.begin(); jt != relationship_map.end(); ++jt) {
+            if ((*jt)->master_access) {
+                if (chosen_relationship) {
+                    throw cannot_perform_query_exc_t(
+                        "Too many primary replicas available");
                 }
+                chosen_relationship = *jt;
             }
-            if (!chosen_relationship) {
-                auto region_to_primary = region_to_primary_maps->find(namespace_id);
-                if (region_to_primary != region_to_primary_maps->end()) {
-                    auto primary = region_to_primary->second.find(it->first.inner);
-                    if (primary != region_to_primary->second.end()) {
-                        std::string mid = uuid_to_str(primary->second);
-                        // Throw a more specific error if possible
-                        throw cannot_perform_query_exc_t(
-                            strprintf("Primary replica for shard %s not available "
-                                      "(server %s is not ready)",
-                                      key_range_to_string(it->first.inner).c_str(),
-                                      mid.c_str()));
-                    }
+        }
+        if (!chosen_relationship) {
+            std::shared_ptr<const region_to_primary_maps_t> maps =
+                region_to_primary_maps->get();
+            auto region_to_primary = maps->find(namespace_id);
+            if (region_to_primary != maps->end()) {
+                auto primary = region_to_primary->second.find(region.inner);
+                if (primary != region_to_primary->second.end()) {
+                    std::string mid = uuid_to_str(primary->second);
+                    // Throw a more specific error if possible
+                    throw cannot_perform_query_exc_t(
+                        strprintf("Primary replica for shard %s not available "
+                                  "(server %s is not ready)",
+                                  key_range_to_string(region.inner).c_str(),
+                                  mid.c_str()));
                 }
-                throw cannot_perform_query_exc_t(
-                    strprintf("Primary replica for shard %s not available",
-                              key_range_to_string(it->first.inner).c_str()));
             }
-            new_op_info->master_access = chosen_relationship->master_access;
-            (new_op_info->master_access->*how_to_make_token)(
-                &new_op_info->enforcement_token);
-            new_op_info->keepalive = auto_drainer_t::lock_t(
-                &chosen_relationship->drainer);
-            masters_to_contact.push_back(std::move(new_op_info));
-            new_op_info.init(
-                new immediate_op_info_t<op_type, fifo_enforcer_token_type>());
+            throw cannot_perform_query_exc_t(
+                strprintf("Primary replica for shard %s not available",
+                          key_range_to_string(region.inner).c_str()));
+        }
+        new_op_info->master_access = chosen_relationship->master_access;
+        (new_op_info->master_access->*how_to_make_token)(
+            &new_op_info->enforcement_token);
+        new_op_info->keepalive = auto_drainer_t::lock_t(
+            &chosen_relationship->drainer);
+        masters_to_contact.push_back(std::move(new_op_info));
+        new_op_info.init(
+            new immediate_op_info_t<op_type, fifo_enforcer_token_type>());
+    };
+
+    const store_key_t *point_key = op.point_key();
+    const point_route_t *route =
+        point_key != NULL ? find_point_route(*point_key) : NULL;
+    if (route != NULL) {
+        DEBUG_VAR bool sharded = op.shard(route->region, &new_op_info->sharded_op);
+        rassert(sharded);
+        contact_master(route->region, route->relationships);
+    } else {
+        for (auto it = relationships.begin(); it != relationships.end(); ++it) {
+            if (op.shard(it->first, &new_op_info->sharded_op)) {
+                contact_master(it->first, it->second);
+            }
         }
     }
 
@@ -269,40 +318,61 @@ cluster_namespace_interface_t::dispatch_outdated_read(
     std::vector<scoped_ptr_t<outdated_read_info_t> > direct_readers_to_contact;
 
     scoped_ptr_t<outdated_read_info_t> new_op_info(new outdated_read_info_t());
-    for (auto it = relationships.begin(); it != relationships.end(); ++it) {
-        if (op.shard(it->first, &new_op_info->sharded_op)) {
-            std::vector<relationship_t *> potential_relationships;
-            relationship_t *chosen_relationship = NULL;
-
-            const std::set<relationship_t *> *relationship_map = &it->second;
-            for (auto jt = relationship_map->begin();
-                 jt != relationship_map->end();
-                 ++jt) {
-                if ((*jt)->direct_reader_access) {
-                    if ((*jt)->is_local) {
-                        chosen_relationship = *jt;
-                        break;
-                    } else {
-                        potential_relationships.push_back(*jt);
-                    }
+    auto contact_direct_reader = [&](
+            const std::set<relationship_t *> &relationship_map) {
+        /* We go to the direct reader that looks like it will answer soonest, going
+        by how far away it is and how many of our reads it has yet to answer. Ties
+        are broken at random, so that equally good replicas share the load. */
+        std::vector<relationship_t *> potential_relationships;
+        int64_t best_cost = 0;
+        for (auto jt = relationship_map.begin(); jt != relationship_map.end(); ++jt) {
+            if ((*jt)->direct_reader_access) {
+                const int64_t round_trip_time_us = (*jt)->is_local
+                    ? 0
+                    : get_peer_round_trip_time_us(mailbox_manager, (*jt)->peer_id);
+                const int64_t cost = estimate_replica_read_cost_us(
+                    round_trip_time_us, (*jt)->outdated_reads_in_flight);
+                if (potential_relationships.empty() || cost < best_cost) {
+                    potential_relationships.clear();
+                    best_cost = cost;
+                }
+                if (cost == best_cost) {
+                    potential_relationships.push_back(*jt);
                 }
             }
-            if (!chosen_relationship && !potential_relationships.empty()) {
-                chosen_relationship
-                    = potential_relationships[
-                        distributor_rng.randint(potential_relationships.size())];
-            }
-            if (!chosen_relationship) {
-                /* Don't bother looking for masters; if there are no direct
-                   readers, there won't be any masters either. */
-                throw cannot_perform_query_exc_t("No direct reader available");
+        }
+        relationship_t *chosen_relationship = NULL;
+        if (!potential_relationships.empty()) {
+            chosen_relationship
+                = potential_relationships[
+                    distributor_rng.randint(potential_relationships.size())];
+        }
+        if (!chosen_relationship) {
+            /* Don't bother looking for masters; if there are no direct
+               readers, there won't be any masters either. */
+            throw cannot_perform_query_exc_t("No direct reader available");
+        }
+        new_op_info->relationship = chosen_relationship;
+        new_op_info->direct_reader_access
+            = chosen_relationship->direct_reader_access;
+        new_op_info->keepalive = auto_drainer_t::lock_t(
+            &chosen_relationship->drainer);
+        direct_readers_to_contact.push_back(std::move(new_op_info));
+        new_op_info.init(new outdated_read_info_t());
+    };
+
+    const store_key_t *point_key = op.point_key();
+    const point_route_t *route =
+        point_key != NULL ? find_point_route(*point_key) : NULL;
+    if (route != NULL) {
+        DEBUG_VAR bool sharded = op.shard(route->region, &new_op_info->sharded_op);
+        rassert(sharded);
+        contact_direct_reader(route->relationships);
+    } else {
+        for (auto it = relationships.begin(); it != relationships.end(); ++it) {
+            if (op.shard(it->first, &new_op_info->sharded_op)) {
+                contact_direct_reader(it->second);
             }
-            new_op_info->direct_reader_access
-                = chosen_relationship->direct_reader_access;
-            new_op_info->keepalive = auto_drainer_t::lock_t(
-                &chosen_relationship->drainer);
-            direct_readers_to_contact.push_back(std::move(new_op_info));
-            new_op_info.init(new outdated_read_info_t());
         }
     }
 
@@ -330,13 +400,20 @@ void cluster_namespace_interface_t::perform_outdated_read(
         signal_t *interruptor) THROWS_NOTHING {
     outdated_read_info_t *direct_reader_to_contact = (*direct_readers_to_contact)[i].get();
 
+    /* `keepalive` keeps the relationship alive until this runs. */
+    relationship_t *relationship = direct_reader_to_contact->relationship;
+    ++relationship->outdated_reads_in_flight;
+    death_runner_t read_done([relationship]() {
+        --relationship->outdated_reads_in_flight;
+    });
     try {
         cond_t done;
         mailbox_t<void(read_response_t)> cont(mailbox_manager,
             [&](signal_t *, const read_response_t &res) {
                 results->at(i) = res;
                 done.pulse();
-            });
+            },
+            message_priority_t::HIGH);
 
         send(mailbox_manager, direct_reader_to_contact->direct_reader_access->access().read_mailbox, direct_reader_to_contact->sharded_op, cont.get_address());
         wait_any_t waiter(direct_reader_to_contact->direct_reader_access->get_failed_signal(), &done);
@@ -469,16 +546,20 @@ cluster_namespace_interface_t::extract_direct_reader_business_card_from_secondar
     return ret;
 }
 
+/* Sets `*map_valid` to false whenever it changes `*m`, so that the caches that are
+built from `*m` get rebuilt. */
 template <class value_t>
 class region_map_set_membership_t {
 public:
-    region_map_set_membership_t(region_map_t<std::set<value_t> > *m, const region_t &r, const value_t &v) :
-        map(m), region(r), value(v) {
+    region_map_set_membership_t(region_map_t<std::set<value_t> > *m, bool *_map_valid,
+                                const region_t &r, const value_t &v) :
+        map(m), map_valid(_map_valid), region(r), value(v) {
         region_map_t<std::set<value_t> > submap = map->mask(region);
         for (typename region_map_t<std::set<value_t> >::iterator it = submap.begin(); it != submap.end(); it++) {
             it->second.insert(value);
         }
         map->update(submap);
+        *map_valid = false;
     }
     ~region_map_set_membership_t() {
         region_map_t<std::set<value_t> > submap = map->mask(region);
@@ -486,9 +567,11 @@ public:
             it->second.erase(value);
         }
         map->update(submap);
+        *map_valid = false;
     }
 private:
     region_map_t<std::set<value_t> > *map;
+    bool *map_valid;
     region_t region;
     value_t value;
 };
@@ -526,11 +609,14 @@ void cluster_namespace_interface_t::relationship_coroutine(peer_id_t peer_id, re
         relationship_t relationship_record;
         relationship_record.is_local =
             (peer_id == mailbox_manager->get_connectivity_cluster()->get_me());
+        relationship_record.peer_id = peer_id;
         relationship_record.region = region;
         relationship_record.master_access = master_access.has() ? master_access.get() : NULL;
         relationship_record.direct_reader_access = direct_reader_access.has() ? direct_reader_access.get() : NULL;
+        relationship_record.outdated_reads_in_flight = 0;
 
         region_map_set_membership_t<relationship_t *> relationship_map_insertion(&relationships,
+                                                                                 &point_routes_valid,
                                                                                  region,
                                                                                  &relationship_record);
 
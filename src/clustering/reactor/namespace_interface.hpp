@@ -19,6 +19,7 @@
 #include "concurrency/fifo_enforcer.hpp"
 #include "concurrency/pmap.hpp"
 #include "concurrency/promise.hpp"
+#include "concurrency/read_mostly.hpp"
 #include "concurrency/watchable.hpp"
 #include "protocol_api.hpp"
 #include "rdb_protocol/protocol.hpp"
@@ -30,12 +31,16 @@ class resource_lost_exc_t;
 template <class> class watchable_t;
 template <class> class watchable_subscription_t;
 
+/* The primary replica of each shard of each table, as configured. It's only used to
+make the errors for unavailable shards more specific. */
+typedef std::map<namespace_id_t, std::map<key_range_t, server_id_t> >
+    region_to_primary_maps_t;
+
 class cluster_namespace_interface_t : public namespace_interface_t {
 public:
     cluster_namespace_interface_t(
             mailbox_manager_t *mm,
-            const std::map<namespace_id_t, std::map<key_range_t, server_id_t> >
-                *region_to_primary_maps_,
+            read_mostly_t<region_to_primary_maps_t> *region_to_primary_maps_,
             watchable_map_t<peer_id_t, namespace_directory_metadata_t> *dv,
             const namespace_id_t &namespace_id_,
             rdb_context_t *);
@@ -63,12 +68,29 @@ private:
     class relationship_t {
     public:
         bool is_local;
+        peer_id_t peer_id;
         region_t region;
         master_access_t *master_access;
         resource_access_t<direct_reader_business_card_t> *direct_reader_access;
+        /* How many of our outdated reads the direct reader is working on. */
+        int64_t outdated_reads_in_flight;
         auto_drainer_t drainer;
     };
 
+    /* Reads and writes of a single key are routed through `point_routes` instead of
+    being sharded against every region of `relationships`. It holds the regions of
+    `relationships` sorted by their left bounds, so finding a key's region is a binary
+    search. It's rebuilt by the first such operation after `relationships` changes. */
+    class point_route_t {
+    public:
+        region_t region;
+        std::set<relationship_t *> relationships;
+    };
+
+    /* Returns NULL if there's no route for `key`, which happens when `relationships`
+    has regions that don't cover every hash value. */
+    const point_route_t *find_point_route(const store_key_t &key);
+
     /* The code for handling immediate reads is 99% the same as the code for
     handling writes, so it's factored out into the `dispatch_immediate_op()`
     function. */
@@ -85,6 +107,7 @@ private:
     class outdated_read_info_t {
     public:
         read_t sharded_op;
+        relationship_t *relationship;
         resource_access_t<direct_reader_business_card_t> *direct_reader_access;
         auto_drainer_t::lock_t keepalive;
     };
@@ -151,8 +174,7 @@ private:
                                 auto_drainer_t::lock_t lock) THROWS_NOTHING;
 
     mailbox_manager_t *mailbox_manager;
-    const std::map<namespace_id_t, std::map<key_range_t, server_id_t> >
-        *region_to_primary_maps;
+    read_mostly_t<region_to_primary_maps_t> *region_to_primary_maps;
     watchable_map_t<peer_id_t, namespace_directory_metadata_t> *directory_view;
     namespace_id_t namespace_id;
     rdb_context_t *ctx;
@@ -162,6 +184,9 @@ private:
     std::set<reactor_activity_id_t> handled_activity_ids;
     region_map_t<std::set<relationship_t *> > relationships;
 
+    std::vector<point_route_t> point_routes;
+    bool point_routes_valid;
+
     /* `start_cond` will be pulsed when we have either successfully connected to
     or tried and failed to connect to every peer present when the constructor
     was called. `start_count` is the number of peers we're still waiting for.
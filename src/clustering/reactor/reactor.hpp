@@ -285,7 +285,8 @@ clone_ptr_t<watchable_t<boost::optional<boost::optional<activity_t> > > > reacto
 /* `run_until_satisfied_2` repeatedly calls the given function on the contents of the
 given `watchable_map_t` and `watchable_t` until the function returns `true` or the
 interruptor is pulsed. It's efficient because it only calls the function when the values
-of the watchables change. */
+of the watchables change, and it naps for `nap_before_retry_ms` before each retry but the
+first, like `watchable_t::run_until_satisfied()`. */
 template<class key_t, class value_t, class value2_t, class callable_t>
 void run_until_satisfied_2(
         watchable_map_t<key_t, value_t> *input1,
@@ -312,7 +313,7 @@ void run_until_satisfied_2(
         typename watchable_t<value2_t>::freeze_t freeze(input2);
         subs.reset(input2, &freeze);
     }
-    while (true) {
+    for (int attempt = 0; ; ++attempt) {
         cond_t cond;
         assignment_sentry_t<cond_t *> sentry(&notify, &cond);
         bool ok;
@@ -323,9 +324,11 @@ void run_until_satisfied_2(
         if (ok) {
             return;
         }
-        signal_timer_t timeout;
-        timeout.start(nap_before_retry_ms);
-        wait_interruptible(&timeout, interruptor);
+        if (nap_before_retry_ms > 0 && attempt > 0) {
+            signal_timer_t timeout;
+            timeout.start(nap_before_retry_ms);
+            wait_interruptible(&timeout, interruptor);
+        }
         wait_interruptible(&cond, interruptor);
     }
 }
@@ -311,6 +311,7 @@ void do_backfill(
                        svs,
                        region,
                        ct_backfiller_metadata.get_watchable(),
+                       BACKFILL_MAX_STREAMS,
                        &interruptor_on_svs_thread,
                        &progress_tracker_on_svs_thread->backfills.back().second);
 
@@ -46,6 +46,27 @@ public:
         DISABLE_COPYING(lock_t);
     };
 
+    // Like `lock_t`, but doesn't wait: `get_value()` is NULL if no element was
+    //  available
+    class try_lock_t {
+    public:
+        explicit try_lock_t(cross_thread_semaphore_t *_parent) :
+            parent(_parent), value(parent->try_lock()) { }
+
+        ~try_lock_t() {
+            if (value != NULL) {
+                parent->unlock(value);
+            }
+        }
+
+        value_t *get_value() { return value; }
+
+    private:
+        cross_thread_semaphore_t *parent;
+        value_t *value;
+        DISABLE_COPYING(try_lock_t);
+    };
+
 private:
     // Class used to queue up requests for items
     class request_node_t : public intrusive_list_node_t<request_node_t> {
@@ -93,6 +114,7 @@ private:
     };
 
     value_t *lock(signal_t *interruptor);
+    value_t *try_lock();
     void unlock(value_t *value);
 
     // Mutex to control access, since a lock may be constructed from any thread
@@ -152,6 +174,22 @@ value_t *cross_thread_semaphore_t<value_t>::lock(signal_t *interruptor) {
     return result;
 }
 
+template <class value_t>
+value_t *cross_thread_semaphore_t<value_t>::try_lock() {
+    system_mutex_t::lock_t lock(&mutex);
+
+    if (available_value_index == values.size()) {
+        return NULL;
+    }
+
+    value_t *result = values[available_value_index];
+    values[available_value_index] = NULL;
+    ++available_value_index;
+
+    guarantee(result != NULL);
+    return result;
+}
+
 template <class value_t>
 void cross_thread_semaphore_t<value_t>::unlock(value_t *value) {
     system_mutex_t::lock_t lock(&mutex);
@@ -2,6 +2,8 @@
 #ifndef CONCURRENCY_CROSS_THREAD_WATCHABLE_HPP_
 #define CONCURRENCY_CROSS_THREAD_WATCHABLE_HPP_
 
+#include <vector>
+
 #include "concurrency/watchable.hpp"
 #include "concurrency/watchable_map.hpp"
 #include "concurrency/auto_drainer.hpp"
@@ -40,7 +42,7 @@ public:
 private:
     friend class cross_thread_watcher_subscription_t;
     void on_value_changed();
-    void deliver(value_t new_value);
+    void deliver(bool changed);
 
     static void call(const std::function<void()> &f) {
         f();
@@ -108,9 +110,13 @@ private:
     `auto_drainer_t::lock_t`. */
     typename watchable_t<value_t>::subscription_t subs;
 
-    single_value_producer_t<value_t> value_producer;
-    std_function_callback_t<value_t> deliver_cb;
-    coro_pool_t<value_t> messanger_pool;
+    /* A change only sets a flag here; `deliver()` reads the value when it gets to
+    it. So however many changes arrive while a value is on its way to the other
+    thread, the next trip only carries the latest one, and the ones in between
+    aren't even copied. */
+    single_value_producer_t<bool> change_producer;
+    std_function_callback_t<bool> deliver_cb;
+    coro_pool_t<bool> messanger_pool;
 
     DISABLE_COPYING(cross_thread_watchable_variable_t);
 };
@@ -1,5 +1,6 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include <functional>
+#include <utility>
 
 #include "arch/runtime/runtime.hpp"
 
@@ -13,7 +14,7 @@ cross_thread_watchable_variable_t<value_t>::cross_thread_watchable_variable_t(co
     rethreader(this),
     subs(std::bind(&cross_thread_watchable_variable_t<value_t>::on_value_changed, this)),
     deliver_cb(std::bind(&cross_thread_watchable_variable_t<value_t>::deliver, this, ph::_1)),
-    messanger_pool(1, &value_producer, &deliver_cb) //Note it's very important that this coro_pool only have one worker it will be a race condition if it has more
+    messanger_pool(1, &change_producer, &deliver_cb) //Note it's very important that this coro_pool only have one worker it will be a race condition if it has more
 {
     rassert(original->get_rwi_lock_assertion()->home_thread() == watchable_thread);
     typename watchable_t<value_t>::freeze_t freeze(original);
@@ -23,13 +24,14 @@ cross_thread_watchable_variable_t<value_t>::cross_thread_watchable_variable_t(co
 
 template <class value_t>
 void cross_thread_watchable_variable_t<value_t>::on_value_changed() {
-    value_producer.give_value(original->get());
+    change_producer.give_value(true);
 }
 
 template <class value_t>
-void cross_thread_watchable_variable_t<value_t>::deliver(value_t new_value) {
+void cross_thread_watchable_variable_t<value_t>::deliver(UNUSED bool changed) {
+    value_t new_value = original->get();
     on_thread_t thread_switcher(dest_thread);
-    value = new_value;
+    value = std::move(new_value);
     publisher_controller.publish(&cross_thread_watchable_variable_t<value_t>::call);
 }
 
@@ -50,6 +50,14 @@ void fifo_enforcer_sink_t::exit_read_t::begin(fifo_enforcer_sink_t *p, fifo_enfo
 
     parent->assert_thread();
     mutex_assertion_t::acq_t acq(&parent->internal_lock);
+    if (!parent->in_pump
+            && token.timestamp == parent->finished_state.last_timestamp) {
+        /* Usually the token is the one the sink is waiting for, and then the queue
+        has nothing to do. (Anything else that could go would have gone already.) */
+        parent->popped_state.advance_by_read(token);
+        pulse();
+        return;
+    }
     parent->internal_read_queue.push(this);
     parent->internal_pump();
 }
@@ -112,6 +120,14 @@ void fifo_enforcer_sink_t::exit_write_t::begin(fifo_enforcer_sink_t *p, fifo_enf
 
     parent->assert_thread();
     mutex_assertion_t::acq_t acq(&parent->internal_lock);
+    if (!parent->in_pump
+            && token.timestamp == parent->finished_state.last_timestamp.next()
+            && token.num_preceding_reads == parent->finished_state.num_reads) {
+        /* See `exit_read_t::begin()`. */
+        parent->popped_state.advance_by_write(token);
+        pulse();
+        return;
+    }
     parent->internal_write_queue.push(this);
     parent->internal_pump();
 }
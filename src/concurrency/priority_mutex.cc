@@ -0,0 +1,38 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "concurrency/priority_mutex.hpp"
+
+#include "arch/runtime/coroutines.hpp"
+
+priority_mutex_t::acq_t::acq_t(priority_mutex_t *mutex, bool high_priority)
+    : mutex_(mutex) {
+    mutex_->lock(high_priority);
+}
+
+priority_mutex_t::acq_t::~acq_t() {
+    mutex_->unlock();
+}
+
+void priority_mutex_t::lock(bool high_priority) {
+    if (locked_) {
+        (high_priority ? high_priority_waiters_ : waiters_).push_back(coro_t::self());
+        /* `unlock()` hands the mutex over to us without unlocking it. */
+        coro_t::wait();
+        rassert(locked_);
+    } else {
+        locked_ = true;
+    }
+}
+
+void priority_mutex_t::unlock() {
+    rassert(locked_);
+    std::deque<coro_t *> *queue = !high_priority_waiters_.empty()
+        ? &high_priority_waiters_
+        : &waiters_;
+    if (queue->empty()) {
+        locked_ = false;
+    } else {
+        coro_t *next = queue->front();
+        queue->pop_front();
+        next->notify_sometime();
+    }
+}
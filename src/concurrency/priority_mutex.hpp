@@ -0,0 +1,45 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONCURRENCY_PRIORITY_MUTEX_HPP_
+#define CONCURRENCY_PRIORITY_MUTEX_HPP_
+
+#include <deque>
+
+#include "errors.hpp"
+
+class coro_t;
+
+/* `priority_mutex_t` is like `mutex_t`, except that acquirers can ask for high
+priority. When the mutex gets released, it goes to the coroutine that has been waiting
+longest among the high-priority ones, or if there are none, among the others. Low
+priority acquirers can wait indefinitely if high-priority ones keep coming, so only
+use high priority for things that are short and infrequent compared to the rest. */
+class priority_mutex_t {
+public:
+    class acq_t {
+    public:
+        acq_t(priority_mutex_t *mutex, bool high_priority);
+        ~acq_t();
+    private:
+        priority_mutex_t *mutex_;
+        DISABLE_COPYING(acq_t);
+    };
+
+    priority_mutex_t() : locked_(false) { }
+    ~priority_mutex_t() { rassert(!locked_); }
+
+    bool is_locked() const {
+        return locked_;
+    }
+
+private:
+    void lock(bool high_priority);
+    void unlock();
+
+    bool locked_;
+    std::deque<coro_t *> high_priority_waiters_;
+    std::deque<coro_t *> waiters_;
+
+    DISABLE_COPYING(priority_mutex_t);
+};
+
+#endif  // CONCURRENCY_PRIORITY_MUTEX_HPP_
@@ -2,6 +2,8 @@
 #ifndef CONCURRENCY_QUEUE_ACCOUNTING_HPP_
 #define CONCURRENCY_QUEUE_ACCOUNTING_HPP_
 
+#include <algorithm>
+
 #include "concurrency/queue/passive_producer.hpp"
 #include "containers/intrusive_list.hpp"
 
@@ -15,7 +17,16 @@ from a number of other `passive_producer_t`s. To associate the
 `account_t`s determines which `passive_producer_t`s the `accounting_queue_t`
 will `pop()` from when its own `pop()` method is called. When one of the sub-
 `passive_producer_t`s is not available, then it is ignored until it becomes
-available. */
+available.
+
+The queue does weighted fair queuing: each account has a virtual time, which
+advances by `1 / shares` whenever the queue pops from it, and the queue pops from
+the available account that is furthest behind. An account that becomes available
+starts out at the virtual time of the account popped from last, so it can't save up
+credit while it's idle, but it also doesn't have to wait for the other accounts to
+go through their shares before its first value gets popped. That keeps the latency
+of accounts with few values but many shares low even while other accounts keep the
+queue busy. */
 
 template<class value_t>
 class accounting_queue_t :
@@ -25,8 +36,9 @@ class accounting_queue_t :
 public:
     explicit accounting_queue_t(int _batch_factor) :
         passive_producer_t<value_t>(&available_control),
-        total_shares(0),
-        selector(0),
+        virtual_time(0),
+        batch_account(NULL),
+        batch_remaining(0),
         batch_factor(_batch_factor) {
 
         rassert(batch_factor > 0);
@@ -39,8 +51,9 @@ public:
 
     class account_t : private availability_callback_t, public intrusive_list_node_t<account_t> {
     public:
-        account_t(accounting_queue_t *p, passive_producer_t<value_t> *s, int _shares)
-            : parent(p), source(s), shares(_shares), active(false) {
+        account_t(accounting_queue_t *p, passive_producer_t<value_t> *s, double _shares)
+            : parent(p), source(s), shares(_shares), account_virtual_time(0),
+              active(false) {
             parent->assert_thread();
             rassert(shares > 0);
             if (source->available->get()) {
@@ -62,6 +75,13 @@ public:
             parent->available_control.set_available(!parent->active_accounts.empty());
         }
 
+        /* Takes effect from the next value popped from this account on. */
+        void set_shares(double _shares) {
+            parent->assert_thread();
+            rassert(_shares > 0);
+            shares = _shares;
+        }
+
     private:
         friend class accounting_queue_t;
 
@@ -79,18 +99,21 @@ public:
 
         void activate() {
             active = true;
+            account_virtual_time = std::max(account_virtual_time, parent->virtual_time);
             parent->active_accounts.push_back(this);
-            parent->total_shares += shares;
         }
         void deactivate() {
             active = false;
             parent->active_accounts.remove(this);
-            parent->total_shares -= shares;
+            if (parent->batch_account == this) {
+                parent->batch_account = NULL;
+            }
         }
 
         accounting_queue_t *parent;
         passive_producer_t<value_t> *source;
-        int shares;
+        double shares;
+        double account_virtual_time;
         bool active;
     };
 
@@ -99,31 +122,36 @@ private:
 
     intrusive_list_t<account_t> active_accounts, inactive_accounts;
 
-    int total_shares, selector, batch_factor;
+    /* The virtual time of the account that was popped from last. */
+    double virtual_time;
+
+    /* We pop up to `batch_factor` values in a row from the same account, which
+    keeps access patterns sequential. */
+    account_t *batch_account;
+    int batch_remaining;
+    int batch_factor;
 
     availability_control_t available_control;
     value_t produce_next_value() {
         assert_thread();
 
-        selector %= total_shares * batch_factor;
-        // TODO: Maybe that line should be like this instead?
-        // It would be very fair, but there might be some issues with that (like
-        // less sequential access patterns (<-- definitely a problem on rotational drives!),
-        // maybe other problems)
-        //selector = randint(total_shares);
-
-        int batch_selector = selector / batch_factor;
-
-        account_t *acct = active_accounts.head();
-        int count = 0;
-        for (;;) {
-            count += acct->shares;
-            if (count > batch_selector) {
-                break;
+        account_t *acct = batch_account;
+        if (acct == NULL || batch_remaining == 0) {
+            acct = active_accounts.head();
+            for (account_t *a = active_accounts.next(acct);
+                 a != NULL;
+                 a = active_accounts.next(a)) {
+                if (a->account_virtual_time < acct->account_virtual_time) {
+                    acct = a;
+                }
             }
-            acct = active_accounts.next(acct);
+            batch_account = acct;
+            batch_remaining = batch_factor;
         }
-        selector++;
+        --batch_remaining;
+
+        virtual_time = acct->account_virtual_time;
+        acct->account_virtual_time += 1.0 / acct->shares;
         return acct->source->pop();
     }
 };
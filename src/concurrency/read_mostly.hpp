@@ -0,0 +1,70 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef CONCURRENCY_READ_MOSTLY_HPP_
+#define CONCURRENCY_READ_MOSTLY_HPP_
+
+#include <stdint.h>
+
+#include <memory>
+
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/one_per_thread.hpp"
+#include "threading.hpp"
+
+/* `read_mostly_t` holds a value that's read on every thread but only changed now
+and then, on its home thread. Each version is built once and never changed; every
+thread keeps its own pointer to the latest version it has been given, so readers on
+different threads never touch the same memory, and a version is freed when the last
+thread (or caller of `get()`) lets go of it.
+
+Unlike `cross_thread_watchable_variable_t`, which keeps a copy of the value on its
+destination thread, `set()` doesn't copy the value for each thread. Readers can't
+wait for changes, though. */
+template <class value_t>
+class read_mostly_t : public home_thread_mixin_t {
+public:
+    read_mostly_t();
+    explicit read_mostly_t(value_t initial_value);
+
+    /* Makes `new_value` the current version. Each thread sees it soon after, and
+    threads never see versions out of order. Doesn't block. */
+    void set(value_t new_value);
+
+    /* Calls `read` with this thread's version. It must not block; use `get()` to
+    hold on to a version. */
+    template <class callable_t>
+    void apply_read(const callable_t &read) {
+        ASSERT_NO_CORO_WAITING;
+        const value_t *value = slots.get()->value.get();
+        read(value);
+    }
+
+    /* Returns this thread's version. Unlike `apply_read()` this touches a reference
+    count that all threads share, so it's for things that are rare anyway, like
+    error messages. */
+    std::shared_ptr<const value_t> get() {
+        return slots.get()->value;
+    }
+
+private:
+    struct slot_t {
+        explicit slot_t(const std::shared_ptr<const value_t> &_value)
+            : value(_value), version(0) { }
+        std::shared_ptr<const value_t> value;
+        uint64_t version;
+    };
+
+    void deliver(std::shared_ptr<const value_t> value, uint64_t version,
+                 threadnum_t thread, auto_drainer_t::lock_t keepalive);
+
+    uint64_t last_version;
+    one_per_thread_t<slot_t> slots;
+
+    // Destroyed before `slots`, so deliveries that are still underway finish first.
+    auto_drainer_t drainer;
+
+    DISABLE_COPYING(read_mostly_t);
+};
+
+#include "concurrency/read_mostly.tcc"
+
+#endif  // CONCURRENCY_READ_MOSTLY_HPP_
@@ -0,0 +1,45 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <functional>
+#include <utility>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/runtime.hpp"
+
+template <class value_t>
+read_mostly_t<value_t>::read_mostly_t()
+    : last_version(0),
+      slots(std::shared_ptr<const value_t>(std::make_shared<value_t>())) { }
+
+template <class value_t>
+read_mostly_t<value_t>::read_mostly_t(value_t initial_value)
+    : last_version(0),
+      slots(std::shared_ptr<const value_t>(
+          std::make_shared<value_t>(std::move(initial_value)))) { }
+
+template <class value_t>
+void read_mostly_t<value_t>::set(value_t new_value) {
+    assert_thread();
+    ASSERT_NO_CORO_WAITING;
+    std::shared_ptr<const value_t> value =
+        std::make_shared<value_t>(std::move(new_value));
+    const uint64_t version = ++last_version;
+    for (int thread = 0; thread < get_num_threads(); ++thread) {
+        coro_t::spawn_sometime(std::bind(&read_mostly_t<value_t>::deliver, this,
+                                         value, version, threadnum_t(thread),
+                                         drainer.lock()));
+    }
+}
+
+template <class value_t>
+void read_mostly_t<value_t>::deliver(std::shared_ptr<const value_t> value,
+                                     uint64_t version,
+                                     threadnum_t thread,
+                                     UNUSED auto_drainer_t::lock_t keepalive) {
+    on_thread_t thread_switcher(thread);
+    slot_t *slot = slots.get();
+    // A later version may have overtaken this one on the way.
+    if (slot->version < version) {
+        slot->value = std::move(value);
+        slot->version = version;
+    }
+}
@@ -5,13 +5,16 @@
 #include "arch/runtime/coroutines.hpp"
 
 
-throttled_committer_t::throttled_committer_t(const std::function<void()> &_commit_cb,
-                                             int _max_active_commits) :
+throttled_committer_t::throttled_committer_t(
+        const std::function<void()> &_commit_cb,
+        int _max_active_commits,
+        const std::function<bool()> &_may_commit_concurrently) :
     on_next_commit_complete(new counted_cond_t()),
     unhandled_commit_waiter_exists(false),
     num_active_commits(0),
     max_active_commits(_max_active_commits),
-    commit_cb(_commit_cb) { }
+    commit_cb(_commit_cb),
+    may_commit_concurrently(_may_commit_concurrently) { }
 
 throttled_committer_t::~throttled_committer_t() {
     assert_thread();
@@ -29,7 +32,9 @@ void throttled_committer_t::sync() {
     unhandled_commit_waiter_exists = true;
 
     // Check if we can initiate a new commit
-    if (num_active_commits < max_active_commits) {
+    if (num_active_commits == 0
+        || (num_active_commits < max_active_commits
+            && (!may_commit_concurrently || may_commit_concurrently()))) {
         ++num_active_commits;
         do_commit();
     }
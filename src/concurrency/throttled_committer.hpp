@@ -22,8 +22,14 @@
 class throttled_committer_t : public home_thread_mixin_debug_only_t {
 public:
     // Unless _max_active_commits == 1, _commit_cb must be reentrant safe.
+    // While a commit is active, further commits only get started concurrently if
+    // `_may_commit_concurrently` returns true.  Otherwise they wait until an active
+    // commit completes, so that more changes accumulate for them.  If it's empty,
+    // commits get started whenever fewer than `_max_active_commits` are active.
     throttled_committer_t(const std::function<void()> &_commit_cb,
-                          int _max_active_commits);
+                          int _max_active_commits,
+                          const std::function<bool()> &_may_commit_concurrently
+                              = std::function<bool()>());
     ~throttled_committer_t();
 
     // Waits until the first commit completes that has been started after
@@ -45,6 +51,7 @@ private:
     int max_active_commits;
 
     std::function<void()> commit_cb;
+    std::function<bool()> may_commit_concurrently;
 
     DISABLE_COPYING(throttled_committer_t);
 };
@@ -139,7 +139,9 @@ public:
 
     /* `run_until_satisfied()` repeatedly calls `fun` on the current value of
     `this` until either `fun` returns `true` or `interruptor` is pulsed. It's
-    efficient because it only retries `fun` when the value changes. */
+    efficient because it only retries `fun` when the value changes. If
+    `nap_before_retry_ms` is set, it waits at least that long before each retry
+    but the first. */
     template<class callable_type>
     void run_until_satisfied(const callable_type &fun, signal_t *interruptor,
             int64_t nap_before_retry_ms = 0) THROWS_ONLY(interrupted_exc_t);
@@ -194,7 +194,7 @@ void watchable_t<value_type>::run_until_satisfied(const callable_type &fun,
                         &is_done);
 
     clone_ptr_t<watchable_t<value_type> > clone_this(this->clone());
-    while (true) {
+    for (int attempt = 0; ; ++attempt) {
         cond_t changed;
         typename watchable_t<value_type>::subscription_t subs(std::bind(&cond_t::pulse_if_not_already_pulsed, &changed));
         {
@@ -208,8 +208,9 @@ void watchable_t<value_type>::run_until_satisfied(const callable_type &fun,
         }
         // Nap a little so changes to the watchables can accumulate.
         // This is purely a performance optimization to save CPU cycles,
-        // in case that applying `fun` is expensive.
-        if (nap_before_retry_ms > 0) {
+        // in case that applying `fun` is expensive.  The first change is often
+        // the one we're waiting for, so we don't nap before the first retry.
+        if (nap_before_retry_ms > 0 && attempt > 0) {
             nap(nap_before_retry_ms, interruptor);
         }
         wait_interruptible(&changed, interruptor);
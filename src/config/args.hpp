@@ -35,9 +35,22 @@
 
 // Defines the maximum size of the batch of IO events to process on
 // each loop iteration. A larger number will increase throughput but
-// decrease concurrency
+// decrease concurrency.  The epoll event queue uses this as the initial
+// batch size and adapts it between the two bounds below.
 #define MAX_IO_EVENT_PROCESSING_BATCH_SIZE        50
 
+// Bounds for the epoll event queue's adaptive batch size.  The batch size grows
+// while epoll keeps returning full batches, and shrinks whenever running the
+// callbacks for one batch takes longer than the latency target (so that the
+// message hub gets pumped often enough).
+#define MIN_ADAPTIVE_IO_EVENT_BATCH_SIZE          8
+#define MAX_ADAPTIVE_IO_EVENT_BATCH_SIZE          1024
+#define IO_EVENT_BATCH_LATENCY_TARGET_USECS       500
+
+// The `thread_activity` stat reports each thread's utilization, and its longest
+// message, over windows of this length.
+#define THREAD_ACTIVITY_WINDOW_MS                 5000
+
 // The io batch factor ensures a minimum number of i/o operations
 // which are picked from any specific i/o account consecutively.
 // A higher value might be advantageous for throughput if seek times
@@ -51,6 +64,76 @@
 // useful.
 #define DEFAULT_IO_BATCH_FACTOR                   1
 
+// Latency percentiles (of I/O, flushes, queries and cluster round trips) are
+// reported for the last complete interval of this length.
+#define LATENCY_HISTOGRAM_INTERVAL_SECS           60
+
+// Queries that take at least `--slow-query-threshold` milliseconds (0 turns it
+// off) go into the `rethinkdb.slow_queries` table.  Each server keeps the last
+// `SLOW_QUERY_HISTORY_SIZE` of them, and the query's term tree is cut off
+// after `SLOW_QUERY_MAX_QUERY_SIZE` bytes.  One in
+// `SLOW_QUERY_PROFILE_SAMPLE_RATE` queries gets an aggregate profile, so that
+// some of the slow ones come with a profile.
+#define DEFAULT_SLOW_QUERY_THRESHOLD_MS           1000
+#define SLOW_QUERY_HISTORY_SIZE                   100
+#define SLOW_QUERY_MAX_QUERY_SIZE                 1024
+#define SLOW_QUERY_PROFILE_SAMPLE_RATE            64
+
+// Point reads with `use_outdated` may be answered from the rows such reads
+// returned on the same thread at most this many milliseconds ago; 0 turns the
+// cache off.  Each thread keeps up to `OUTDATED_READ_CACHE_SIZE` rows.
+#define DEFAULT_OUTDATED_READ_CACHE_MS            0
+#define OUTDATED_READ_CACHE_SIZE                  1024
+
+// A server hands out the stats it last collected again to requests for the same
+// stats within this many milliseconds, and so does `rethinkdb.stats` to full reads
+// of the table.
+#define STATS_CACHE_TTL_MS                        500
+
+// Whether the serializer discards freed extents, and how many freed extents it
+// collects before it discards them.
+#define DEFAULT_DISCARD_FREED_EXTENTS             true
+#define EXTENT_DISCARD_BATCH_SIZE                 16
+
+// Writes that reach the disk backend back-to-back and cover adjacent ranges of the
+// same file are merged into a single vectored write of at most this many bytes.
+// Zero disables coalescing.
+#define IO_COALESCING_MAX_BYTES                   (4 * MEGABYTE)
+
+// Sequential btree scans prefetch upcoming sibling leaves once this many leaves in
+// a row have been traversed.  The read-ahead window (in blocks) starts at the
+// minimum and doubles on each refill up to the maximum.
+#define BTREE_READ_AHEAD_TRIGGER                  2
+#define BTREE_READ_AHEAD_MIN_WINDOW               4
+#define BTREE_READ_AHEAD_MAX_WINDOW               64
+
+// Aggregates like `count()` over a range whose order doesn't matter split it at the
+// root node into up to this many parts, which are traversed at the same time.
+#define MAX_PARALLEL_AGGREGATE_TRAVERSALS         8
+
+// Range traversals whose transformations can handle many rows in one go (such as a
+// `map` with an `r.js` function, which goes to a worker process) collect up to this
+// many rows before applying them.
+#define RGET_ROW_BATCH_SIZE                       100
+
+// Each store keeps a Bloom filter of its primary keys, so that point reads of keys
+// that don't exist can skip the B-tree.  It's sized for twice the keys the store has
+// when it's built, with this many bits per key, and for at least the minimum and at
+// most the maximum number of keys.  (At the maximum it takes 5 MB.)
+#define STORE_KEY_FILTER_BITS_PER_KEY             10
+#define STORE_KEY_FILTER_MIN_KEYS                 (64 * KILOBYTE)
+#define STORE_KEY_FILTER_MAX_KEYS                 (4 * MILLION)
+
+// Once about as many keys have been written to a store as it had after its last
+// compaction (and at least the minimum), it rewrites the nodes of its B-trees in key
+// order, this many leaves per transaction, so that range scans read the disk
+// sequentially again and the serializer can free the extents they were spread over.
+#define STORE_COMPACTION_MIN_KEYS_WRITTEN         (4 * MILLION)
+#define STORE_COMPACTION_LEAVES_PER_PASS          32
+// The cache priority of the reads of the nodes that a compaction rewrites, like
+// SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY below.
+#define STORE_COMPACTION_CACHE_PRIORITY           5
+
 // I/O priority of index writes in the log serializer
 #define INDEX_WRITE_IO_PRIORITY                   128
 
@@ -73,9 +156,49 @@
 // 0 = minimal priority
 #define SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY   5
 
+// Secondary index post construction sorts the new index entries before loading
+// them into the index.  Entries that don't fit into this many bytes (shared by all
+// indexes being constructed) are sorted in runs that are written to disk.
+#define SINDEX_POST_CONSTRUCTION_SORT_MEMORY      (64 * MEGABYTE)
+
+// How many sorted entries post construction writes to an index per transaction.
+#define SINDEX_POST_CONSTRUCTION_CHUNK_SIZE       1000
+
+// Post construction computes the index keys of the leaves it reads on all db threads.
+// This many leaves per db thread can wait for or be in key computation at a time,
+// which bounds how many documents it holds in memory.
+#define SINDEX_POST_CONSTRUCTION_LEAVES_PER_THREAD 4
+
+// How full post construction fills the nodes of a new secondary index.  Leaving
+// some room means that the first writes to the index don't split every node.
+#define SINDEX_BULK_LOAD_FILL_FACTOR              0.9
+
+// The same for backfilled values that get appended after the keys already in a
+// table, which are mostly those backfilled into a new replica.
+#define BACKFILL_BULK_LOAD_FILL_FACTOR            0.9
+
 // Size of the buffer used to perform IO operations (in bytes).
 #define IO_BUFFER_SIZE                            (4 * KILOBYTE)
 
+// TCP connections read into their read buffer in chunks that start at
+// IO_BUFFER_SIZE and grow up to this size (in bytes) while the peer keeps sending
+// more data than fits, and shrink again once it stops.
+#define TCP_CONN_MAX_READ_BUFFER_SIZE             (1 * MEGABYTE)
+
+// How many queries from a single client connection may run at the same time.
+// Further queries aren't read off the connection until one of them is done.
+#define MAX_CONCURRENT_QUERIES_PER_CONNECTION     32
+
+// The query server admits the queries that start on each thread (see
+// `query_admission_t`): at most this many run on the thread at a time, at most this
+// many of those from the same client address, and a client with this many already
+// waiting gets the next ones refused.  Low priority queries get this share of a
+// normal query's turn.
+#define MAX_RUNNING_QUERIES_PER_THREAD            256
+#define MAX_RUNNING_QUERIES_PER_CLIENT            64
+#define MAX_QUEUED_QUERIES_PER_CLIENT             1024
+#define LOW_PRIORITY_QUERY_ADMISSION_WEIGHT       0.25
+
 // Size of the device block size (in bytes)
 #define DEVICE_BLOCK_SIZE                         512
 
@@ -85,6 +208,36 @@
 // Size of each btree node (in bytes) on disk
 #define DEFAULT_BTREE_BLOCK_SIZE                  (4 * KILOBYTE)
 
+// The range of btree block sizes that `table_create` accepts.  Leaf and internal
+// nodes use 16-bit offsets, so blocks can't be larger than 64KB.
+#define MIN_BTREE_BLOCK_SIZE                      (4 * KILOBYTE)
+#define MAX_BTREE_BLOCK_SIZE                      (64 * KILOBYTE)
+
+// Whether `table_create` makes tables that compress their blocks on disk, unless
+// told otherwise.
+#define DEFAULT_TABLE_COMPRESS_BLOCKS             false
+
+// How much of each server's cache a table is guaranteed, and how its demand for more
+// is weighed against other tables', unless its `table_config` says otherwise.
+#define DEFAULT_TABLE_CACHE_RESERVATION           0
+#define DEFAULT_TABLE_CACHE_WEIGHT                1.0
+
+// How a table's disk I/O is weighed against other tables', unless its `table_config`
+// says otherwise.  The shares of the table's io accounts are their priorities (see
+// below) times this.
+#define DEFAULT_TABLE_IO_WEIGHT                   1.0
+
+// How many milliseconds a table's soft durability writes wait before they get
+// flushed, so that writes to the same blocks are flushed together.  The delay has to
+// stay well below the soft durability loss window in buffer_cache/alt.cc.
+#define DEFAULT_TABLE_SOFT_FLUSH_DELAY_MS         0
+#define MAX_TABLE_SOFT_FLUSH_DELAY_MS             50
+
+// How many documents per second secondary index construction may read on each server
+// that hosts a table, unless its `table_config` says otherwise.  0 means there is no
+// limit.
+#define DEFAULT_TABLE_INDEX_BUILD_RATE            0
+
 // Size of each extent (in bytes)
 // This should not be too small, or garbage collection will become
 // inefficient (especially on rotational drives).
@@ -100,7 +253,18 @@
 // together. This is favorable especially on rotational drives.
 // There is a theoretic chance of increased latencies on SSDs for
 // small values of this variable.
-#define MERGER_SERIALIZER_MAX_ACTIVE_WRITES       1
+#define MERGER_SERIALIZER_MAX_ACTIVE_WRITES       4
+
+// How many tables a server loads at once when it starts.  Loading a table reads its
+// serializer's LBA and its stores' superblocks, so on servers with thousands of tables
+// loading them all at once makes every one of them wait for the disk; the rest wait
+// in line and come online as the ones before them finish.
+#define MAX_CONCURRENT_TABLE_LOADS                16
+
+// While an index write is active in a merger serializer, the queued up index writes
+// only get started concurrently once the blocks they refer to add up to this many
+// bytes.  Smaller batches are cheaper to merge into the next index write.
+#define MERGER_SERIALIZER_CONCURRENT_WRITE_MIN_BYTES (4 * MEGABYTE)
 
 // I/O priority of block writes in the merger_serializer_t
 #define MERGER_BLOCK_WRITE_IO_PRIORITY            64
@@ -109,16 +273,12 @@
 // TODO: make this dynamic where possible
 #define MAX_THREADS                               128
 
-// Ticks (in milliseconds) the internal timed tasks are performed at
-#define TIMER_TICKS_IN_MS                         5
-
-// How many milliseconds to allow changes to sit in memory before flushing to disk
-#define DEFAULT_FLUSH_TIMER_MS                    1000
+// Highest NUMA node number we look for when reading the machine's topology
+#define MAX_NUMA_NODES                            64
 
-// If non-null disk_ack_signals are present, concurrent flushing can be used to reduce the
-// latency of each single flush. max_concurrent_flushes controls how many flushes can be active
-// on a specific slice at any given time.
-#define DEFAULT_MAX_CONCURRENT_FLUSHES            1
+// Ticks (in milliseconds) the internal timed tasks are performed at; this is the size of a
+// level 0 slot of the timer wheel in `timer_handler_t`
+#define TIMER_TICKS_IN_MS                         5
 
 // How many times the page replacement algorithm tries to find an eligible page before giving up.
 // Note that (MAX_UNSAVED_DATA_LIMIT_FRACTION ** PAGE_REPL_NUM_TRIES) is the probability that the
@@ -126,6 +286,33 @@
 // then the page replacement algorithm will on average be unable to evict pages from the cache.
 #define PAGE_REPL_NUM_TRIES                       10
 
+// With the two-queue eviction policy, pages that haven't been reloaded since they
+// were evicted get this fraction of the cache's memory limit to themselves, before
+// the evicter starts taking pages from the protected queue.
+#define TWO_QUEUE_PROBATIONARY_FRACTION           0.25
+
+// How many evicted block ids the two-queue eviction policy remembers, as a fraction
+// of how many blocks fit within the cache's memory limit.
+#define TWO_QUEUE_GHOST_FRACTION                  0.5
+
+// Evicted pages are kept compressed in memory, using up to this fraction of the
+// cache's memory limit, before they're dropped entirely.
+#define COMPRESSED_PAGE_TIER_FRACTION             0.5
+
+// Pages that don't compress to at most this fraction of their size are dropped
+// right away instead.
+#define COMPRESSED_PAGE_MAX_RATIO                 0.6
+
+// How often each cache tells its serializer which loaded blocks it has accessed most
+// recently, and at most how many, so that it can load them right away after a
+// restart.  The serializer forgets blocks that haven't been reported for two
+// intervals.
+#define HOT_BLOCK_LIST_INTERVAL_MS                (60 * THOUSAND)
+#define HOT_BLOCK_LIST_MAX_BLOCKS                 (16 * KILOBYTE)
+
+// How many hot blocks a cache reads from its serializer at a time while warming up.
+#define HOT_BLOCK_WARMUP_BATCH_SIZE               16
+
 // How large can the key be, in bytes?  This value needs to fit in a byte.
 #define MAX_KEY_SIZE                              250
 
@@ -147,6 +334,21 @@
 // How many block ids should the LBA garbage collector rewrite before yielding?
 #define LBA_GC_BATCH_SIZE                         (1024 * 8)
 
+// The garbage collectors back off while the average foreground block write takes
+// longer than this, or while more than GC_THROTTLE_MAX_OUTSTANDING_WRITES batches of
+// foreground writes are in flight.  They pause for between GC_THROTTLE_MIN_DELAY_MS
+// and GC_THROTTLE_MAX_DELAY_MS after each unit of work, doubling the pause for as
+// long as the writes keep struggling.
+#define GC_THROTTLE_TARGET_WRITE_LATENCY_MS       50
+#define GC_THROTTLE_MAX_OUTSTANDING_WRITES        8
+#define GC_THROTTLE_MIN_DELAY_MS                  1
+#define GC_THROTTLE_MAX_DELAY_MS                  500
+
+// After this long without foreground block writes, garbage collection runs at high
+// priority and with at least GC_IDLE_CONCURRENCY coroutines.
+#define GC_IDLE_TIME_MS                           1000
+#define GC_IDLE_CONCURRENCY                       4
+
 // How many LBA structures to have for each file
 #define LBA_SHARD_FACTOR                          4
 
@@ -168,17 +370,107 @@
 
 #define COROUTINE_STACK_SIZE                      131072
 
+// When a coroutine finishes, the part of its stack more than this many bytes below
+// the base is given back to the operating system if it was used. This way the
+// resident size of a thread's coroutines follows their actual stack usage, instead
+// of every recycled stack keeping the memory of its deepest call. 0 disables it.
+#define COROUTINE_STACK_RETAINED_SIZE             (16 * KILOBYTE)
+
 // How many unused coroutine stacks to keep around (maximally), before they are
 // freed. This value is per thread.
 #define COROUTINE_FREE_LIST_SIZE                  64
 
 #define MAX_COROS_PER_THREAD                      10000
 
+// When a coroutine wakes up another coroutine on the same thread with
+// `notify_sometime()` and then blocks, we switch straight to the woken coroutine
+// instead of going through the message queue. This bounds how many such handoffs
+// can happen in a row before control goes back to the message hub. 0 disables it.
+#define COROUTINE_MAX_DIRECT_HANDOFFS             16
+
+// Every this many coroutine notifications on a thread, the notified coroutine's
+// queueing delay and run time are sampled for the `coroutine_latency` stat.
+#define CORO_LATENCY_SAMPLE_INTERVAL              128
+
+
+// Messages to other servers that are at least this big get compressed, if the other
+// server accepts compressed messages and isn't on a loopback address.
+#define CLUSTER_MESSAGE_COMPRESSION_MIN_SIZE      KILOBYTE
+
+// A compressed cluster message whose uncompressed size is bigger than this is
+// considered invalid data, and gets its connection closed.
+#define CLUSTER_MESSAGE_MAX_UNCOMPRESSED_SIZE     GIGABYTE
+
+// Messages to other servers that are bigger than this get sent in fragments of this
+// size, so that smaller messages can go out in between them.
+#define CLUSTER_MESSAGE_FRAGMENT_SIZE             (64 * KILOBYTE)
+
+// Changed directory map values get sent as a delta against the last value sent on
+// the connection if that saves at least this many bytes over sending all of it.
+#define DIRECTORY_DELTA_MIN_BYTES_SAVED           256
+
+// When a server becomes primary, each of its backfills gets split into up to this
+// many key ranges with about the same amount of data, which are backfilled at once.
+#define BACKFILL_MAX_STREAMS                      4
+
+// A backfillee digests its rows in key ranges of this many rows, and the backfiller
+// only backfills the ranges whose digests differ from its own.
+#define BACKFILL_DIGEST_RANGE_ROWS                1024
+
+// Each store keeps a sample of this many of the keys its recent reads and writes
+// touched, taken over windows of this many milliseconds, so that distribution reads
+// can tell where the load on a table is.
+#define KEY_LOAD_SAMPLE_SIZE                      256
+#define KEY_LOAD_SAMPLE_WINDOW_MS                 (60 * THOUSAND)
+
+// With `--auto-rebalance`, tables get checked this often (in ms).  A table's shards
+// are rebalanced when the busiest one carries this many times the mean load, and a
+// server's primaries get moved when it carries this many times the mean load of the
+// table's primaries.  Tables that served fewer operations than this aren't touched.
+#define AUTO_REBALANCE_INTERVAL_MS                (5 * 60 * THOUSAND)
+#define AUTO_REBALANCE_IMBALANCE_RATIO            1.5
+#define AUTO_REBALANCE_MIN_OPS                    10000
+
+// The share of the load, rather than of the documents, in the weights that
+// automatically rebalanced split points divide evenly.
+#define AUTO_REBALANCE_LOAD_WEIGHT                0.75
+
+// Reads that can go to any of several replicas go to the one that looks like it will
+// answer soonest: its round-trip time plus this service time (in us), times one more
+// than the number of our reads it's working on.  Replicas whose round-trip time isn't
+// known yet count as this far away (in us).
+#define REPLICA_READ_SERVICE_TIME_US              200
+#define REPLICA_READ_UNKNOWN_ROUND_TRIP_US        1000
+
+// A changefeed server sends a client the changes that pile up while the coroutine
+// making them runs in one mailbox message, or sooner once there are this many.
+#define CHANGEFEED_MAX_BATCH_SIZE                 1000
+
+// The server side of an `order_by.limit` changefeed keeps this many times its
+// limit in rows, so that it rarely has to read more when rows leave the top.
+#define CHANGEFEED_LIMIT_BUFFER_MULTIPLE          4
+
+// A changefeed opened with `spill_to_disk` keeps this many unread changes in memory
+// and writes the rest to disk, up to the second limit; past that they're skipped.
+#define CHANGEFEED_SPILL_MEMORY_CHANGES           1000
+#define CHANGEFEED_MAX_SPILLED_CHANGES            (10 * MILLION)
+
+// Buffers of query results that can be written to disk, like the rows being sorted
+// by an unindexed `orderBy`, are once their query holds more than this many bytes
+// in them, or all of the queries on the server together hold more than the second.
+#define QUERY_MEMORY_BUDGET                       (256 * MEGABYTE)
+#define SERVER_QUERY_MEMORY_BUDGET                (1 * GIGABYTE)
+
+// Each changefeed server keeps its last this many changes, so that changefeeds
+// can resume where they left off.
+#define CHANGEFEED_LOG_SIZE                       10000
 
 // Minimal time we nap before re-checking if a goal is satisfied in the reactor (in ms).
 // This is an optimization to save CPU time. Checking for whether the goal is
 // satisfied can be an expensive operation. By napping we increase our chances
-// that the event we are waiting for has occurred in the meantime.
+// that the event we are waiting for has occurred in the meantime. The first retry
+// isn't delayed, so a table whose roles come up in one round (as they usually do
+// when a server restarts) doesn't pay for it.
 #define REACTOR_RUN_UNTIL_SATISFIED_NAP           100
 
 
@@ -219,6 +511,24 @@
 #define CORO_PRIORITY_REACTOR                   (-1)
 #define CORO_PRIORITY_DIRECTORY_CHANGES         (-2)
 #define CORO_PRIORITY_LBA_GC                    (-2)
+#define CORO_PRIORITY_LOW_PRIORITY_QUERY        (-1)
+#define CORO_PRIORITY_STORE_COMPACTION          (-2)
+
+// Eager ReQL streams evaluate `map` and `filter` on all db threads when the query
+// is run with `parallel_eval: true` and a batch has at least this many elements.
+#define PARALLEL_EVAL_MIN_BATCH_SIZE            1024
+
+// How many chunks per db thread such a batch is cut into. More chunks balance the
+// load better when elements differ in cost, fewer have less overhead.
+#define PARALLEL_EVAL_CHUNKS_PER_THREAD         4
+
+// How many of the streams of a `union` (or of a `getAll` with several keys) are
+// asked for their next batch at the same time.
+#define UNION_MAX_CONCURRENT_FETCHES            8
+
+// How many external (JavaScript) worker processes are kept running even when
+// they're idle, so that `r.js` doesn't pay for a fork after a quiet period.
+#define EXTPROC_MIN_WARM_WORKERS                2
 
 
 #endif  // CONFIG_ARGS_HPP_
@@ -5,8 +5,10 @@
 #include <netinet/in.h>
 
 #include <algorithm>
+#include <limits>
 
 #include "containers/archive/versioned.hpp"
+#include "containers/buffer_group.hpp"
 #include "containers/uuid.hpp"
 #include "rpc/serialize_macros.hpp"
 
@@ -60,14 +62,14 @@ write_message_t::~write_message_t() {
     }
 }
 
-void write_message_t::append(const void *p, int64_t n) {
+void write_message_t::append_to_new_buffers(const void *p, int64_t n) {
     while (n > 0) {
-        if (buffers_.empty() || buffers_.tail()->size == write_buffer_t::DATA_SIZE) {
+        if (buffers_.empty() || buffers_.tail()->size == buffers_.tail()->capacity) {
             buffers_.push_back(new write_buffer_t);
         }
 
         write_buffer_t *b = buffers_.tail();
-        int64_t k = std::min<int64_t>(n, write_buffer_t::DATA_SIZE - b->size);
+        int64_t k = std::min<int64_t>(n, b->capacity - b->size);
 
         memcpy(b->data + b->size, p, k);
         b->size += k;
@@ -76,6 +78,16 @@ void write_message_t::append(const void *p, int64_t n) {
     }
 }
 
+void write_message_t::reserve(int64_t n) {
+    write_buffer_t *b = buffers_.tail();
+    if (b != NULL && n <= b->capacity - b->size) {
+        return;
+    }
+    guarantee(n <= std::numeric_limits<int>::max());
+    buffers_.push_back(new write_buffer_t(
+        std::max<int>(static_cast<int>(n), write_buffer_t::DATA_SIZE)));
+}
+
 size_t write_message_t::size() const {
     size_t ret = 0;
     for (write_buffer_t *h = buffers_.head(); h != NULL; h = buffers_.next(h)) {
@@ -84,15 +96,33 @@ size_t write_message_t::size() const {
     return ret;
 }
 
-int send_write_message(write_stream_t *s, const write_message_t *wm) {
-    intrusive_list_t<write_buffer_t> *list = const_cast<write_message_t *>(wm)->unsafe_expose_buffers();
-    for (write_buffer_t *p = list->head(); p; p = list->next(p)) {
-        int64_t res = s->write(p->data, p->size);
+int64_t write_stream_t::write_buffers(const const_buffer_group_t *buffers) {
+    int64_t total = 0;
+    for (size_t i = 0; i < buffers->num_buffers(); ++i) {
+        const_buffer_group_t::buffer_t b = buffers->get_buffer(i);
+        int64_t res = write(b.data, b.size);
         if (res == -1) {
             return -1;
         }
-        rassert(res == p->size);
+        rassert(res == b.size);
+        total += res;
+    }
+    return total;
+}
+
+int send_write_message(write_stream_t *s, const write_message_t *wm) {
+    // Hand all buffers to the stream at once, so that streams such as
+    // `tcp_conn_stream_t` can send them without copying them together first.
+    intrusive_list_t<write_buffer_t> *list = const_cast<write_message_t *>(wm)->unsafe_expose_buffers();
+    const_buffer_group_t group;
+    for (write_buffer_t *p = list->head(); p; p = list->next(p)) {
+        group.add_buffer(p->size, p->data);
+    }
+    int64_t res = s->write_buffers(&group);
+    if (res == -1) {
+        return -1;
     }
+    rassert(res == static_cast<int64_t>(group.get_size()));
     return 0;
 }
 
@@ -3,6 +3,7 @@
 #define CONTAINERS_ARCHIVE_ARCHIVE_HPP_
 
 #include <stdint.h>
+#include <string.h>
 
 #include <string>
 #include <type_traits>
@@ -12,6 +13,7 @@
 #include "version.hpp"
 #include "valgrind.hpp"
 
+class const_buffer_group_t;
 class uuid_u;
 
 struct fake_archive_exc_t {
@@ -85,6 +87,10 @@ public:
     write_stream_t() { }
     // Returns n, or -1 upon error. Blocks until all bytes are written.
     virtual MUST_USE int64_t write(const void *p, int64_t n) = 0;
+    // Writes all of the buffers in order. Returns their total size, or -1 upon
+    // error. The default implementation calls `write()` for each of them; streams
+    // that can send several buffers at once should override it.
+    virtual MUST_USE int64_t write_buffers(const const_buffer_group_t *buffers);
 protected:
     virtual ~write_stream_t() { }
 private:
@@ -93,11 +99,17 @@ private:
 
 class write_buffer_t : public intrusive_list_node_t<write_buffer_t> {
 public:
-    write_buffer_t() : size(0) { }
-
+    // Buffers usually have room for `DATA_SIZE` bytes, but `write_message_t::reserve`
+    // makes bigger ones.
     static const int DATA_SIZE = 4096;
+
+    explicit write_buffer_t(int _capacity = DATA_SIZE)
+        : capacity(_capacity), size(0), data(new char[_capacity]) { }
+    ~write_buffer_t() { delete[] data; }
+
+    const int capacity;
     int size;
-    char data[DATA_SIZE];
+    char *const data;
 
 private:
     DISABLE_COPYING(write_buffer_t);
@@ -114,7 +126,22 @@ public:
     write_message_t() { }
     ~write_message_t();
 
-    void append(const void *p, int64_t n);
+    /* This is called for every field of every message, and most of the time the data
+    fits into the last buffer, so that case is inline. */
+    void append(const void *p, int64_t n) {
+        write_buffer_t *b = buffers_.tail();
+        if (b != NULL && n <= b->capacity - b->size) {
+            memcpy(b->data + b->size, p, n);
+            b->size += n;
+        } else {
+            append_to_new_buffers(p, n);
+        }
+    }
+
+    /* Makes sure that the next `n` bytes appended go into one buffer. When the size
+    of a big message is known in advance (like a datum's), this turns serializing it
+    into appends to a single buffer that can then be copied out in one go. */
+    void reserve(int64_t n);
 
     size_t size() const;
 
@@ -123,6 +150,8 @@ public:
 private:
     friend int send_write_message(write_stream_t *s, const write_message_t *wm);
 
+    void append_to_new_buffers(const void *p, int64_t n);
+
     intrusive_list_t<write_buffer_t> buffers_;
 
     DISABLE_COPYING(write_message_t);
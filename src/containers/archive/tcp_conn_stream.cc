@@ -2,6 +2,7 @@
 #include "containers/archive/tcp_conn_stream.hpp"
 
 #include "arch/io/network.hpp"
+#include "containers/buffer_group.hpp"
 
 tcp_conn_stream_t::tcp_conn_stream_t(const ip_address_t &host, int port, signal_t *interruptor, int local_port)
     : conn_(new tcp_conn_t(host, port, interruptor, local_port)) { }
@@ -39,6 +40,16 @@ int64_t tcp_conn_stream_t::write(const void *p, int64_t n) {
     }
 }
 
+int64_t tcp_conn_stream_t::write_buffers(const const_buffer_group_t *buffers) {
+    try {
+        cond_t non_closer;
+        conn_->write(buffers, &non_closer);
+        return buffers->get_size();
+    } catch (const tcp_conn_write_closed_exc_t &) {
+        return -1;
+    }
+}
+
 void tcp_conn_stream_t::rethread(threadnum_t new_thread) {
     conn_->rethread(new_thread);
 }
@@ -98,6 +109,14 @@ int64_t keepalive_tcp_conn_stream_t::write(const void *p, int64_t n) {
     return tcp_conn_stream_t::write(p, n);
 }
 
+int64_t keepalive_tcp_conn_stream_t::write_buffers(const const_buffer_group_t *buffers) {
+    if (keepalive_callback != NULL) {
+        keepalive_callback->keepalive_write();
+    }
+
+    return tcp_conn_stream_t::write_buffers(buffers);
+}
+
 rethread_tcp_conn_stream_t::rethread_tcp_conn_stream_t(tcp_conn_stream_t *conn, threadnum_t thread)
     : conn_(conn), old_thread_(conn->home_thread()), new_thread_(thread) {
     conn->rethread(thread);
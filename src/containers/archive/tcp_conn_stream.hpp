@@ -19,6 +19,7 @@ public:
 
     virtual MUST_USE int64_t read(void *p, int64_t n);
     virtual MUST_USE int64_t write(const void *p, int64_t n);
+    virtual MUST_USE int64_t write_buffers(const const_buffer_group_t *buffers);
 
     void rethread(threadnum_t new_thread);
 
@@ -58,6 +59,7 @@ public:
 
     virtual MUST_USE int64_t read(void *p, int64_t n);
     virtual MUST_USE int64_t write(const void *p, int64_t n);
+    virtual MUST_USE int64_t write_buffers(const const_buffer_group_t *buffers);
 
 private:
     keepalive_callback_t *keepalive_callback;
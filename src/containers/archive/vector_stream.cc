@@ -3,6 +3,10 @@
 
 #include <string.h>
 
+#include <algorithm>
+
+#include "containers/buffer_group.hpp"
+
 vector_stream_t::vector_stream_t() { }
 
 vector_stream_t::~vector_stream_t() { }
@@ -14,6 +18,21 @@ int64_t vector_stream_t::write(const void *p, int64_t n) {
     return n;
 }
 
+int64_t vector_stream_t::write_buffers(const const_buffer_group_t *buffers) {
+    /* Serialized messages come in many buffers, so we make room for all of them at
+    once instead of letting the vector grow as it goes. */
+    const size_t total = buffers->get_size();
+    if (vec_.size() + total > vec_.capacity()) {
+        vec_.reserve(std::max(vec_.size() + total, 2 * vec_.capacity()));
+    }
+    for (size_t i = 0; i < buffers->num_buffers(); ++i) {
+        const_buffer_group_t::buffer_t b = buffers->get_buffer(i);
+        const char *chp = static_cast<const char *>(b.data);
+        vec_.insert(vec_.end(), chp, chp + b.size);
+    }
+    return total;
+}
+
 void vector_stream_t::swap(std::vector<char> *other) {
     other->swap(vec_);
 }
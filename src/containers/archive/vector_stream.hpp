@@ -12,6 +12,7 @@ public:
     virtual ~vector_stream_t();
 
     virtual MUST_USE int64_t write(const void *p, int64_t n);
+    virtual MUST_USE int64_t write_buffers(const const_buffer_group_t *buffers);
 
     const std::vector<char> &vector() { return vec_; }
 
@@ -0,0 +1,60 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "containers/bloom_filter.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+
+// 64-bit FNV-1a.  We can't use `hash_region_hasher` for keys, because all the keys
+// in a store have hash values in the same part of its range.
+uint64_t bloom_filter_hash(const void *data, size_t size) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        h ^= bytes[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// The finalizer of MurmurHash3, which gives us a second hash that is independent
+// enough of the first one for double hashing.
+uint64_t bloom_filter_mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+bloom_filter_t::bloom_filter_t(size_t expected_elements, size_t bits_per_element)
+    : expected_elements_(std::max<size_t>(expected_elements, 1)),
+      bits_(expected_elements_ * std::max<size_t>(bits_per_element, 1)),
+      // The number of hash functions that minimizes false positives is
+      // `bits_per_element * ln 2`.
+      num_hashes_(std::max<int>(1, lround(bits_per_element * M_LN2))),
+      num_added_(0) { }
+
+void bloom_filter_t::add(const void *data, size_t size) {
+    const uint64_t h1 = bloom_filter_hash(data, size);
+    const uint64_t h2 = bloom_filter_mix(h1) | 1;
+    const size_t count_before = bits_.count();
+    for (int i = 0; i < num_hashes_; ++i) {
+        bits_.set((h1 + i * h2) % bits_.size());
+    }
+    if (bits_.count() != count_before) {
+        ++num_added_;
+    }
+}
+
+bool bloom_filter_t::may_contain(const void *data, size_t size) const {
+    const uint64_t h1 = bloom_filter_hash(data, size);
+    const uint64_t h2 = bloom_filter_mix(h1) | 1;
+    for (int i = 0; i < num_hashes_; ++i) {
+        if (!bits_.test((h1 + i * h2) % bits_.size())) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,40 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONTAINERS_BLOOM_FILTER_HPP_
+#define CONTAINERS_BLOOM_FILTER_HPP_
+
+#include <stdint.h>
+
+#include "containers/bitset.hpp"
+
+// The hash that `bloom_filter_t` uses.  Unlike `hash_region_hasher`, it spreads the
+// keys of a single store over the whole range.
+uint64_t bloom_filter_hash(const void *data, size_t size);
+
+/* A Bloom filter over byte strings.  `may_contain()` returns true for everything
+that has been added, and false for most of the rest.  With `bits_per_element` bits
+for each of `expected_elements`, about 1% of the strings that haven't been added
+get a false positive at 10 bits per element.  Adding more elements than expected
+still works, but the false positive rate goes up.  Elements can't be removed. */
+class bloom_filter_t {
+public:
+    bloom_filter_t(size_t expected_elements, size_t bits_per_element);
+
+    void add(const void *data, size_t size);
+    bool may_contain(const void *data, size_t size) const;
+
+    size_t expected_elements() const { return expected_elements_; }
+    // Approximately the number of distinct strings that have been added: adding a
+    // string that sets no new bits (such as one that was added before) isn't
+    // counted.
+    size_t num_added() const { return num_added_; }
+
+private:
+    const size_t expected_elements_;
+    bitset_t bits_;
+    int num_hashes_;
+    size_t num_added_;
+
+    DISABLE_COPYING(bloom_filter_t);
+};
+
+#endif  // CONTAINERS_BLOOM_FILTER_HPP_
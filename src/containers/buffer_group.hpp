@@ -30,6 +30,8 @@ public:
         return buffers_[i];
     }
 
+    void clear() { buffers_.clear(); }
+
     size_t get_size() const {
         size_t s = 0;
         for (size_t i = 0; i < buffers_.size(); ++i) {
@@ -109,12 +109,36 @@ void internal_disk_backed_queue_t::pop(buffer_group_viewer_t *viewer) {
     guarantee(size() != 0);
     mutex_t::acq_t mutex_acq(&mutex);
 
-    char buffer[DBQ_MAX_REF_SIZE];
     // No need for hard durability with an unlinked dbq file.
     txn_t txn(cache_conn.get(), write_durability_t::SOFT,
               repli_timestamp_t::distant_past, 2);
 
-    buf_lock_t _tail(buf_parent_t(&txn), tail_block_id, access_t::write);
+    pop_single(&txn, viewer);
+}
+
+size_t internal_disk_backed_queue_t::pop(buffer_group_viewer_t *viewer,
+                                         size_t max_count) {
+    guarantee(size() != 0);
+    guarantee(max_count != 0);
+    mutex_t::acq_t mutex_acq(&mutex);
+
+    // No need for hard durability with an unlinked dbq file.
+    txn_t txn(cache_conn.get(), write_durability_t::SOFT,
+              repli_timestamp_t::distant_past, 2);
+
+    size_t count = 0;
+    while (count < max_count && queue_size != 0) {
+        pop_single(&txn, viewer);
+        ++count;
+    }
+    return count;
+}
+
+void internal_disk_backed_queue_t::pop_single(txn_t *txn,
+                                              buffer_group_viewer_t *viewer) {
+    char buffer[DBQ_MAX_REF_SIZE];
+
+    buf_lock_t _tail(buf_parent_t(txn), tail_block_id, access_t::write);
 
     /* Grab the data from the blob and delete it. */
     {
@@ -161,7 +185,7 @@ void internal_disk_backed_queue_t::pop(buffer_group_viewer_t *viewer) {
 
     /* If that was the last blob in this block move on to the next one. */
     if (live_data_offset == data_size) {
-        remove_block_from_tail(&txn);
+        remove_block_from_tail(txn);
     }
 }
 
@@ -49,6 +49,10 @@ public:
     void push(const scoped_array_t<write_message_t> &values);
 
     void pop(buffer_group_viewer_t *viewer);
+    // Pops up to `max_count` values (at least one, so the queue mustn't be empty)
+    // in a single transaction, showing each to `viewer` in order.  Returns how
+    // many it popped.
+    size_t pop(buffer_group_viewer_t *viewer, size_t max_count);
 
     bool empty();
 
@@ -58,6 +62,7 @@ private:
     void add_block_to_head(txn_t *txn);
     void remove_block_from_tail(txn_t *txn);
     void push_single(txn_t *txn, const write_message_t &value);
+    void pop_single(txn_t *txn, buffer_group_viewer_t *viewer);
 
     mutex_t mutex;
 
@@ -101,6 +106,27 @@ private:
     DISABLE_COPYING(deserializing_viewer_t);
 };
 
+// Like `deserializing_viewer_t`, but appends every value it's shown to a vector,
+// for popping several values at once.
+template <class T>
+class deserializing_vector_viewer_t : public buffer_group_viewer_t {
+public:
+    explicit deserializing_vector_viewer_t(std::vector<T> *values_out)
+        : values_out_(values_out) { }
+    virtual ~deserializing_vector_viewer_t() { }
+
+    virtual void view_buffer_group(const const_buffer_group_t *group) {
+        values_out_->push_back(T());
+        deserialize_from_group<cluster_version_t::LATEST_OVERALL>(
+            group, &values_out_->back());
+    }
+
+private:
+    std::vector<T> *values_out_;
+
+    DISABLE_COPYING(deserializing_vector_viewer_t);
+};
+
 template <class T>
 class disk_backed_queue_t {
 public:
@@ -119,11 +145,26 @@ public:
         internal_.push(wm);
     }
 
+    // Pushes all of `ts`, in a single transaction.
+    void push(const std::vector<T> &ts) {
+        scoped_array_t<write_message_t> wms(ts.size());
+        for (size_t i = 0; i < ts.size(); ++i) {
+            serialize<cluster_version_t::LATEST_OVERALL>(&wms[i], ts[i]);
+        }
+        internal_.push(wms);
+    }
+
     void pop(T *out) {
         deserializing_viewer_t<T> viewer(out);
         internal_.pop(&viewer);
     }
 
+    // Appends up to `max_count` values to `out`, in a single transaction.
+    void pop(std::vector<T> *out, size_t max_count) {
+        deserializing_vector_viewer_t<T> viewer(out);
+        internal_.pop(&viewer, max_count);
+    }
+
     bool empty() {
         return internal_.empty();
     }
@@ -81,6 +81,16 @@ public:
             return cache_list_.end();
         }
     }
+    // Removes the entry for `key`, and returns whether there was one.
+    bool erase(const K &key) {
+        auto search = cache_map_.find(key);
+        if (search == cache_map_.end()) {
+            return false;
+        }
+        cache_list_.erase(search->second);
+        cache_map_.erase(search);
+        return true;
+    }
 private:
     V &insert(const K &key) {
         cache_list_.push_front(std::make_pair(key, V()));
@@ -0,0 +1,62 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "containers/object_freelist.hpp"
+
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "arch/runtime/runtime.hpp"
+#include "utils.hpp"
+
+object_freelist_t::object_freelist_t(size_t _block_size, size_t _max_cached)
+    : block_size(std::max(_block_size, sizeof(free_block_t))),
+      max_cached(_max_cached) { }
+
+object_freelist_t::~object_freelist_t() {
+    for (auto &padded : thread_lists) {
+        free_block_t *block = padded.value.head;
+        while (block != NULL) {
+            free_block_t *next = block->next;
+            ::free(block);
+            block = next;
+        }
+    }
+}
+
+object_freelist_t::thread_list_t *object_freelist_t::get_thread_list() {
+#ifdef VALGRIND
+    return NULL;
+#else
+    const int threadnum = get_thread_id().threadnum;
+    if (threadnum < 0 || threadnum >= MAX_THREADS) {
+        return NULL;
+    }
+    return &thread_lists[threadnum].value;
+#endif
+}
+
+void *object_freelist_t::allocate() {
+    thread_list_t *list = get_thread_list();
+    if (list != NULL && list->head != NULL) {
+        free_block_t *block = list->head;
+        list->head = block->next;
+        --list->count;
+        return block;
+    }
+    return rmalloc(block_size);
+}
+
+void object_freelist_t::deallocate(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    thread_list_t *list = get_thread_list();
+    if (list != NULL && list->count < max_cached) {
+        free_block_t *block = static_cast<free_block_t *>(ptr);
+        block->next = list->head;
+        list->head = block;
+        ++list->count;
+        return;
+    }
+    ::free(ptr);
+}
@@ -0,0 +1,53 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONTAINERS_OBJECT_FREELIST_HPP_
+#define CONTAINERS_OBJECT_FREELIST_HPP_
+
+#include <stddef.h>
+
+#include <array>
+
+#include "concurrency/cache_line_padded.hpp"
+#include "config/args.hpp"
+#include "errors.hpp"
+
+/* An `object_freelist_t` hands out blocks of a single size and keeps freed blocks
+around, one list per thread, for the next allocation on that thread.  It's meant
+for small objects that get created and destroyed in huge numbers, where going
+through `malloc` each time is expensive and makes the threads contend for the
+allocator.
+
+A block may be freed on a different thread than the one it was allocated on; it
+then goes on the list of the thread that freed it.  Each thread keeps at most
+`max_cached` blocks, so memory stays bounded.  Threads outside the thread pool
+always go through `malloc`, and so does everything when running under Valgrind,
+so that it still catches use-after-free errors. */
+class object_freelist_t {
+public:
+    object_freelist_t(size_t block_size, size_t max_cached);
+    ~object_freelist_t();
+
+    void *allocate();
+    void deallocate(void *ptr);
+
+private:
+    struct free_block_t {
+        free_block_t *next;
+    };
+
+    struct thread_list_t {
+        thread_list_t() : head(NULL), count(0) { }
+        free_block_t *head;
+        size_t count;
+    };
+
+    // Returns NULL if the calling thread isn't in the thread pool.
+    thread_list_t *get_thread_list();
+
+    const size_t block_size;
+    const size_t max_cached;
+    std::array<cache_line_padded_t<thread_list_t>, MAX_THREADS> thread_lists;
+
+    DISABLE_COPYING(object_freelist_t);
+};
+
+#endif  // CONTAINERS_OBJECT_FREELIST_HPP_
@@ -94,6 +94,17 @@ public:
             }
         }
     }
+
+    // The number of bytes of heap memory held by the array.
+    size_t memory_usage() const {
+        size_t ret = chunks.capacity() * sizeof(chunk_t *);
+        for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+            if (*it != NULL) {
+                ret += sizeof(chunk_t);
+            }
+        }
+        return ret;
+    }
 };
 
 #endif // CONTAINERS_TWO_LEVEL_ARRAY_HPP_
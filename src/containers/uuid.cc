@@ -73,24 +73,16 @@ TLS_with_init(bool, next_uuid_initialized, false);
 typedef std::array<uint8_t, uuid_u::kStaticSize> next_uuid_t;
 TLS(next_uuid_t, next_uuid);
 
-uuid_u get_and_increment_uuid() {
-    uuid_u result;
-
-    next_uuid_t next_uuid = TLS_get_next_uuid();
-
+void get_and_increment_uuid(next_uuid_t *next_uuid, uuid_u *result) {
     // Copy over the next_uuid buffer
-    uint8_t *result_buffer = result.data();
-    memcpy(result_buffer, next_uuid.data(), uuid_u::static_size());
+    memcpy(result->data(), next_uuid->data(), uuid_u::static_size());
 
     // Increment the next_uuid buffer
     bool carry = true;
     for (size_t i = uuid_u::static_size(); carry && i > 0; --i) {
-        next_uuid[i - 1] = next_uuid[i - 1] + 1;
-        carry = (next_uuid[i - 1] == 0);
+        (*next_uuid)[i - 1] = (*next_uuid)[i - 1] + 1;
+        carry = ((*next_uuid)[i - 1] == 0);
     }
-    TLS_set_next_uuid(next_uuid);
-
-    return result;
 }
 
 // TODO(sam):  Make sure this isn't messed up somehow.
@@ -115,13 +107,22 @@ void initialize_dev_random_uuid() {
 }
 
 uuid_u generate_uuid() {
+    uuid_u result;
+    generate_uuids(1, &result);
+    return result;
+}
+
+void generate_uuids(size_t count, uuid_u *out) {
     if (!TLS_get_next_uuid_initialized()) {
         initialize_dev_random_uuid();
         TLS_set_next_uuid_initialized(true);
     }
-    uuid_u result = get_and_increment_uuid();
-    hash_uuid(&result);
-    return result;
+    next_uuid_t next_uuid = TLS_get_next_uuid();
+    for (size_t i = 0; i < count; ++i) {
+        get_and_increment_uuid(&next_uuid, &out[i]);
+        hash_uuid(&out[i]);
+    }
+    TLS_set_next_uuid(next_uuid);
 }
 
 uuid_u nil_uuid() {
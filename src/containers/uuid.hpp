@@ -48,6 +48,10 @@ bool operator<(const uuid_u& x, const uuid_u& y);
 Valgrind won't complain about it. */
 uuid_u generate_uuid();
 
+/* Fills `out` with `count` UUIDs, each like one from `generate_uuid()`, touching the
+thread's generator state only once. */
+void generate_uuids(size_t count, uuid_u *out);
+
 // Returns boost::uuids::nil_generator()().
 uuid_u nil_uuid();
 
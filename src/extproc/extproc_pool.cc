@@ -1,16 +1,25 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
-#include "containers/object_buffer.hpp"
 #include "extproc/extproc_pool.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "containers/object_buffer.hpp"
 #include "extproc/extproc_spawner.hpp"
 
-extproc_pool_t::extproc_pool_t(size_t worker_count) :
+extproc_pool_t::extproc_pool_t(size_t worker_count, size_t min_warm_workers) :
     ct_interruptors(&interruptor),
     worker_cnt(0),
-    prev_worker_cnt(0),
+    peak_worker_cnt(0),
+    min_warm_cnt(std::min(min_warm_workers, worker_count)),
+    warm_cnt(min_warm_cnt),
     dealloc_timer(DEALLOC_TIMER_FREQ_MS, this),
     worker_semaphore(worker_count,
                      extproc_spawner_t::get_instance()),
-    dealloc_pool(1, &pool_queue, this) { }
+    dealloc_pool(1, &pool_queue, this) {
+    // Start the warm workers right away instead of on the first timer ring
+    pool_queue.give_value(extproc_pool_dummy_value_t());
+}
 
 extproc_pool_t::~extproc_pool_t() {
     // Can only be destructed on the same thread we were created on
@@ -35,22 +44,48 @@ void extproc_pool_t::on_ring() {
 void extproc_pool_t::coro_pool_callback(extproc_pool_dummy_value_t,
                                         signal_t *) {
     int cur_worker_cnt = worker_cnt;
-    int dealloc_cnt = (prev_worker_cnt - cur_worker_cnt) / 2;
-    prev_worker_cnt = cur_worker_cnt;
+    int peak_cnt = __sync_lock_test_and_set(&peak_worker_cnt, cur_worker_cnt);
+    warm_cnt = std::max(min_warm_cnt, std::max(peak_cnt, warm_cnt / 2));
 
-    for (int i = 0; i < dealloc_cnt; ++i) {
-        object_buffer_t<cross_thread_semaphore_t<extproc_worker_t>::lock_t> worker_lock;
-        worker_lock.create(get_worker_semaphore(), get_shutdown_signal());
+    // The semaphore hands out the most recently released workers first, so by
+    //  holding every idle worker at once we see them from most to least recently
+    //  used.  The first ones are the ones to keep running and the rest are stopped.
+    typedef cross_thread_semaphore_t<extproc_worker_t>::try_lock_t worker_lock_t;
+    std::vector<scoped_ptr_t<worker_lock_t> > idle_workers;
+    int keep_cnt = warm_cnt - cur_worker_cnt;
+    while (true) {
+        scoped_ptr_t<worker_lock_t> worker_lock(new worker_lock_t(&worker_semaphore));
+        extproc_worker_t *worker = worker_lock->get_value();
+        if (worker == NULL) {
+            break;
+        }
 
-        if (worker_lock.get()->get_value()->is_process_alive()) {
-            worker_lock.get()->get_value()->kill_process();
+        if (static_cast<int>(idle_workers.size()) < keep_cnt) {
+            worker->prespawn();
+        } else if (worker->is_process_alive()) {
+            worker->kill_process();
         }
+        idle_workers.push_back(std::move(worker_lock));
+    }
+
+    // Release them in reverse, so the semaphore keeps them in the same order
+    while (!idle_workers.empty()) {
+        idle_workers.pop_back();
     }
 }
 
 void extproc_pool_t::on_worker_acquired()
 {
-    __sync_add_and_fetch(&worker_cnt, 1);
+    int cur_worker_cnt = __sync_add_and_fetch(&worker_cnt, 1);
+    int peak_cnt = peak_worker_cnt;
+    while (cur_worker_cnt > peak_cnt) {
+        int prev_peak_cnt = __sync_val_compare_and_swap(&peak_worker_cnt,
+                                                        peak_cnt, cur_worker_cnt);
+        if (prev_peak_cnt == peak_cnt) {
+            break;
+        }
+        peak_cnt = prev_peak_cnt;
+    }
 }
 
 void extproc_pool_t::on_worker_released()
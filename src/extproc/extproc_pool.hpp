@@ -3,6 +3,7 @@
 #define EXTPROC_EXTPROC_POOL_HPP_
 
 #include "arch/timing.hpp"
+#include "config/args.hpp"
 #include "utils.hpp"
 #include "containers/scoped.hpp"
 #include "concurrency/cond_var.hpp"
@@ -20,7 +21,10 @@ class extproc_pool_t : public home_thread_mixin_t,
                        public coro_pool_callback_t<extproc_pool_dummy_value_t>,
                        public repeating_timer_callback_t {
 public:
-    explicit extproc_pool_t(size_t worker_count);
+    // At least `min_warm_workers` worker processes are kept running at all times,
+    //  and more than that while recent demand calls for them
+    explicit extproc_pool_t(size_t worker_count,
+                            size_t min_warm_workers = EXTPROC_MIN_WARM_WORKERS);
     ~extproc_pool_t();
 
     // Get the signal for the current thread that will indicate when this object is being
@@ -57,22 +61,28 @@ private:
         scoped_array_t<scoped_ptr_t<cross_thread_signal_t> > ct_signals;
     } ct_interruptors;
 
-    // Worker counters for the deallocation window.
-    int worker_cnt, prev_worker_cnt;
+    // Worker counters for the deallocation window: the number of workers acquired
+    //  right now, and the most acquired at once since the last window.
+    int worker_cnt, peak_worker_cnt;
+
+    // How many workers to keep running; it follows `peak_worker_cnt` up right away
+    //  and halves towards it every window, but never drops below `min_warm_cnt`.
+    const int min_warm_cnt;
+    int warm_cnt;
 
     // Acquire / Release worker notifications.
     void on_worker_acquired();
     void on_worker_released();
 
-    // Timer to trigger worker deallocation.
+    // Timer to trigger worker (pre)allocation and deallocation.
     repeating_timer_t dealloc_timer;
     static const int64_t DEALLOC_TIMER_FREQ_MS = 2000;
 
     // Worker deallocation timer callback.
     void on_ring();
 
-    // Callback that handles worker deallocations in a coro pool, so we don't block the
-    // timer callback or have multiple deallocations happening at once
+    // Callback that starts and stops idle workers in a coro pool, so we don't block
+    // the timer callback or have multiple deallocations happening at once
     void coro_pool_callback(extproc_pool_dummy_value_t,
                             UNUSED signal_t *interruptor);
 
@@ -122,6 +122,15 @@ void extproc_worker_t::released(bool user_error, signal_t *user_interruptor) {
     }
 }
 
+void extproc_worker_t::prespawn() {
+    guarantee(interruptor == NULL);
+    if (worker_pid == -1) {
+        socket.reset(spawner->spawn(&socket_stream, &worker_pid));
+        // `acquired` recreates the stream on whichever thread the job runs on
+        socket_stream.reset();
+    }
+}
+
 void extproc_worker_t::kill_process() {
     guarantee(worker_pid != -1);
 
@@ -28,6 +28,10 @@ public:
     read_stream_t *get_read_stream();
     write_stream_t *get_write_stream();
 
+    // Starts the worker process ahead of time, so the next job doesn't wait for it.
+    //  Must only be called by whoever holds the worker, outside of a job.
+    void prespawn();
+
     void kill_process();
     bool is_process_alive();
 
@@ -49,23 +49,20 @@ public:
     const std::string error_string;
 };
 
-class scoped_curl_handle_t {
-public:
-    scoped_curl_handle_t() :
-        curl_handle(curl_easy_init()) {
-    }
-
-    ~scoped_curl_handle_t() {
-        curl_easy_cleanup(curl_handle);
-    }
-
-    CURL *get() {
-        return curl_handle;
+// A worker process keeps one curl handle for all of the requests it performs.
+// Resetting it clears the options of the previous request but keeps libcurl's
+// connection, DNS and TLS session caches, so repeated requests to the same host
+// reuse a kept-alive connection instead of connecting and handshaking again.
+// Returns NULL if the handle could not be created.
+CURL *get_reset_curl_handle() {
+    static CURL *curl_handle = NULL;
+    if (curl_handle == NULL) {
+        curl_handle = curl_easy_init();
+    } else {
+        curl_easy_reset(curl_handle);
     }
-
-private:
-    CURL *curl_handle;
-};
+    return curl_handle;
+}
 
 // Used for adding headers, which cannot be freed until after the request is done
 class scoped_curl_slist_t {
@@ -526,6 +523,9 @@ void set_default_opts(CURL *curl_handle,
     // Enable cookies - needed for multiple requests like redirects or digest auth
     exc_setopt(curl_handle, CURLOPT_COOKIEFILE, "", "COOKIEFILE");
 
+    // The handle is reused, so drop any cookies left over from another request
+    exc_setopt(curl_handle, CURLOPT_COOKIELIST, "ALL", "COOKIELIST");
+
     // Use the proxy set when launched
     if (!proxy.empty()) {
         exc_setopt(curl_handle, CURLOPT_PROXY, proxy.c_str(), "PROXY");
@@ -534,22 +534,22 @@ void set_default_opts(CURL *curl_handle,
 
 // TODO: implement streaming API support
 void perform_http(http_opts_t *opts, http_result_t *res_out) {
-    scoped_curl_handle_t curl_handle;
+    CURL *curl_handle = get_reset_curl_handle();
     curl_data_t curl_data;
 
-    if (curl_handle.get() == NULL) {
+    if (curl_handle == NULL) {
         res_out->error.assign("initialization");
         return;
     }
 
-    set_default_opts(curl_handle.get(), opts->proxy, curl_data);
-    transfer_opts(opts, curl_handle.get(), &curl_data);
+    set_default_opts(curl_handle, opts->proxy, curl_data);
+    transfer_opts(opts, curl_handle, &curl_data);
 
     CURLcode curl_res = CURLE_OK;
     long response_code = 0; // NOLINT(runtime/int)
     for (uint64_t attempts = 0; attempts < opts->attempts; ++attempts) {
         // Do the HTTP operation, then check for errors
-        curl_res = curl_easy_perform(curl_handle.get());
+        curl_res = curl_easy_perform(curl_handle);
 
         if (curl_res == CURLE_SEND_ERROR ||
             curl_res == CURLE_RECV_ERROR ||
@@ -561,7 +561,7 @@ void perform_http(http_opts_t *opts, http_result_t *res_out) {
             return;
         }
 
-        curl_res = curl_easy_getinfo(curl_handle.get(),
+        curl_res = curl_easy_getinfo(curl_handle,
                                      CURLINFO_RESPONSE_CODE,
                                      &response_code);
 
@@ -602,7 +602,7 @@ void perform_http(http_opts_t *opts, http_result_t *res_out) {
         res_out->error = strprintf("status code %ld", response_code);
     } else {
         parse_header(header_data, res_out);
-        save_cookies(curl_handle.get(), res_out);
+        save_cookies(curl_handle, res_out);
 
         // If this was a HEAD request, we should not be handling data, just return R_NULL
         // so the user knows the request succeeded
@@ -618,7 +618,7 @@ void perform_http(http_opts_t *opts, http_result_t *res_out) {
             {
                 std::string content_type;
                 char *content_type_buffer = NULL;
-                curl_easy_getinfo(curl_handle.get(),
+                curl_easy_getinfo(curl_handle,
                                   CURLINFO_CONTENT_TYPE,
                                   &content_type_buffer);
 
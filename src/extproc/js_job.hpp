@@ -24,6 +24,10 @@ public:
 
     js_result_t eval(const std::string &source);
     js_result_t call(js_id_t id, const std::vector<ql::datum_t> &args);
+    // Calls the function once for each argument list, in a single round trip.  The
+    // results stop after the first error.
+    std::vector<js_result_t> call_batch(
+        js_id_t id, const std::vector<std::vector<ql::datum_t> > &args_batch);
     void release(js_id_t id);
     void exit();
 
@@ -3,6 +3,7 @@
 
 #include <inttypes.h>   // For PRIu64
 
+#include <algorithm>
 #include <map>
 
 #include "extproc/js_job.hpp"
@@ -219,6 +220,65 @@ js_result_t js_runner_t::call(const std::string &source,
     return result;
 }
 
+std::vector<js_result_t> js_runner_t::call_batch(
+        const std::string &source,
+        const std::vector<std::vector<ql::datum_t> > &args_batch,
+        const req_config_t &config) {
+    assert_thread();
+    guarantee(job_data.has());
+
+    // This will retrieve the function from the cache if it's there, or re-eval it
+    js_result_t fn = eval(source, config);
+    js_id_t *fn_id = boost::get<js_id_t>(&fn);
+    guarantee(fn_id != NULL);
+
+    const uint64_t timeout_ms = config.timeout_ms * std::max<size_t>(args_batch.size(), 1);
+    object_buffer_t<js_timeout_t::sentry_t> sentry;
+    sentry.create(&job_data->js_timeout, timeout_ms);
+
+    std::vector<js_result_t> results;
+    bool is_timeout = false;
+    try {
+        try {
+            results = job_data->js_job.call_batch(*fn_id, args_batch);
+        } catch (...) {
+            // See `call()`.
+            is_timeout = job_data->js_timeout.get_signal()->is_pulsed();
+            sentry.reset();
+            job_data->js_job.worker_error();
+            job_data.reset();
+
+            throw;
+        }
+    } catch (interrupted_exc_t const &e) {
+        if (is_timeout) {
+            results.assign(1, strprintf(
+                "JavaScript query `%s` timed out after %" PRIu64 ".%03" PRIu64 " seconds.",
+                source.c_str(), timeout_ms / 1000, timeout_ms % 1000));
+            return results;
+        } else {
+            throw;
+        }
+    }
+
+    // Functions returned by the calls can't be used by anything, since the source
+    // they would be cached under is already taken.
+    try {
+        for (auto it = results.begin(); it != results.end(); ++it) {
+            js_id_t *any_id = boost::get<js_id_t>(&*it);
+            if (any_id != NULL) {
+                release_id(*any_id);
+            }
+        }
+    } catch (...) {
+        job_data->js_job.worker_error();
+        job_data.reset();
+        throw;
+    }
+
+    return results;
+}
+
 void js_runner_t::cache_id(js_id_t id, const std::string &source) {
     guarantee(job_data.has());
     guarantee(id != INVALID_ID);
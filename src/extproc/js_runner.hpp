@@ -59,6 +59,14 @@ public:
                      const std::vector<ql::datum_t> &args,
                      const req_config_t &config);
 
+    // Calls a previously compiled function once for each argument list, with a
+    // single round trip to the worker.  The results stop after the first error.
+    // `config.timeout_ms` applies to each call, so the whole batch gets the sum.
+    std::vector<js_result_t> call_batch(
+        const std::string &source,
+        const std::vector<std::vector<ql::datum_t> > &args_batch,
+        const req_config_t &config);
+
 private:
     static const size_t CACHE_SIZE;
 
@@ -94,7 +94,29 @@ void file_http_app_t::handle(const http_req_t &req, http_res_t *result, signal_t
     result->add_header_line("Content-Type", mimetype);
 
     if (asset_dir.empty()) {
-        result->body.assign(resource_data.begin(), resource_data.end());
+        // The embedded assets only change with the binary, so a client that has the
+        // current one doesn't need it sent again.
+        auto etag = static_web_asset_etags.find(filename);
+        if (etag != static_web_asset_etags.end()) {
+            result->add_header_line("ETag", etag->second);
+            boost::optional<std::string> if_none_match =
+                req.find_header_line("If-None-Match");
+            if (if_none_match
+                && (if_none_match.get().find(etag->second) != std::string::npos
+                    || if_none_match.get() == "*")) {
+                result->code = HTTP_NOT_MODIFIED;
+                return;
+            }
+        }
+
+        auto gzipped = static_web_assets_gzipped.find(filename);
+        result->add_header_line("Vary", "Accept-Encoding");
+        if (gzipped != static_web_assets_gzipped.end() && accepts_gzip(req)) {
+            result->add_header_line("Content-Encoding", "gzip");
+            result->body.assign(gzipped->second.begin(), gzipped->second.end());
+        } else {
+            result->body.assign(resource_data.begin(), resource_data.end());
+        }
         result->code = 200;
     } else {
         thread_pool_t::run_in_blocker_pool(boost::bind(&file_http_app_t::handle_blocking, this, filename, result));
@@ -13,6 +13,8 @@
 #include <boost/algorithm/string.hpp>
 
 #include "arch/io/network.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/wait_any.hpp"
 #include "logger.hpp"
 #include "utils.hpp"
 
@@ -198,13 +200,7 @@ void http_res_t::set_body(const std::string& content_type, const std::string& co
     body = content;
 }
 
-bool maybe_gzip_response(const http_req_t &req, http_res_t *res) {
-    // Don't bother zipping anything less than 0.5k
-    size_t body_size = res->body.size();
-    if (body_size < 512) {
-        return false;
-    }
-
+bool accepts_gzip(const http_req_t &req) {
     // See the specification for the "Accept-Encoding" header line here:
     // http://www.w3.org/Protocols/rfc2616/rfc2616-sec14.html#sec14.3
     // We do not implement the entire standard, that is, we will always fallback to
@@ -292,6 +288,22 @@ bool maybe_gzip_response(const http_req_t &req, http_res_t *res) {
         return false;
     }
 
+    return true;
+}
+
+bool maybe_gzip_response(const http_req_t &req, http_res_t *res) {
+    // Don't bother zipping anything less than 0.5k, or anything the application
+    // already encoded (like the precompressed web assets).
+    size_t body_size = res->body.size();
+    if (body_size < 512
+        || res->header_lines.find("content-encoding") != res->header_lines.end()) {
+        return false;
+    }
+
+    if (!accepts_gzip(req)) {
+        return false;
+    }
+
     // Gzip is supported and preferred, gzip the body of the result
     scoped_array_t<char> out_buffer(body_size);
 
@@ -451,35 +463,93 @@ std::string human_readable_status(int code) {
 }
 
 void write_http_msg(tcp_conn_t *conn, const http_res_t &res, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
-    conn->writef(closer, "HTTP/%s %d %s\r\n", res.version.c_str(), res.code, human_readable_status(res.code).c_str());
+    // The status line and headers go out in one write rather than one per line.
+    std::string head = strprintf("HTTP/%s %d %s\r\n", res.version.c_str(), res.code,
+                                 human_readable_status(res.code).c_str());
     for (auto const &line: res.header_lines) {
-        conn->writef(closer, "%s: %s\r\n", line.first.c_str(), line.second.c_str());
+        head += strprintf("%s: %s\r\n", line.first.c_str(), line.second.c_str());
+    }
+    // The client needs the length to find the end of the body on a connection that
+    // stays open.  (204 and 304 responses never have one.)
+    if (res.code != HTTP_NO_CONTENT && res.code != HTTP_NOT_MODIFIED
+        && res.header_lines.find("content-length") == res.header_lines.end()) {
+        head += strprintf("content-length: %zu\r\n", res.body.size());
     }
-    conn->writef(closer, "\r\n");
-    conn->write(res.body.c_str(), res.body.size(), closer);
+    head += "\r\n";
+    conn->write(head.data(), head.size(), closer);
+    conn->write(res.body.data(), res.body.size(), closer);
 }
 
+// Whether the connection should stay open for another request after `req`'s.
+static bool wants_keep_alive(const http_req_t &req) {
+    // We don't leave out the body of responses to `HEAD`, so the client couldn't
+    // tell where the next response starts.
+    if (req.method == HEAD) {
+        return false;
+    }
+    boost::optional<std::string> connection = req.find_header_line("connection");
+    if (connection) {
+        std::string value = connection.get();
+        boost::to_lower(value);
+        if (value.find("close") != std::string::npos) {
+            return false;
+        } else if (value.find("keep-alive") != std::string::npos) {
+            return true;
+        }
+    }
+    // Connections persist by default from HTTP/1.1 on.
+    return req.version != "1.0" && req.version != "0.9";
+}
+
+// How long we wait for the next request on an idle connection.
+static const int64_t HTTP_KEEP_ALIVE_TIMEOUT_MS = 30 * THOUSAND;
+
 void http_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn, auto_drainer_t::lock_t keepalive) {
     scoped_ptr_t<tcp_conn_t> conn;
     nconn->make_overcomplicated(&conn);
 
-    http_req_t req;
-    tcp_http_msg_parser_t http_msg_parser;
+    ip_and_port_t peer;
+    if (!conn->getpeername(&peer)) {
+        return;
+    }
 
-    // Parse the request
     try {
-        http_res_t res;
-        if (conn->getpeername(&(req.peer)) &&
-            http_msg_parser.parse(conn.get(), &req, keepalive.get_drain_signal())) {
-            application->handle(req, &res, keepalive.get_drain_signal());
-            res.version = req.version;
-            maybe_gzip_response(req, &res);
-        } else {
-            res = http_res_t(HTTP_BAD_REQUEST);
+        // Serve requests until the client or `wants_keep_alive` says otherwise, so that
+        // loading the web UI doesn't take a new connection per asset.
+        bool keep_alive = true;
+        while (keep_alive) {
+            http_req_t req;
+            req.peer = peer;
+            tcp_http_msg_parser_t http_msg_parser;
+
+            // Parse the request
+            http_res_t res;
+            bool parsed;
+            {
+                signal_timer_t idle_timer;
+                idle_timer.start(HTTP_KEEP_ALIVE_TIMEOUT_MS);
+                wait_any_t interruptor(&idle_timer, keepalive.get_drain_signal());
+                parsed = http_msg_parser.parse(conn.get(), &req, &interruptor);
+            }
+            if (parsed) {
+                application->handle(req, &res, keepalive.get_drain_signal());
+                res.version = req.version;
+                maybe_gzip_response(req, &res);
+                keep_alive = wants_keep_alive(req);
+            } else {
+                res = http_res_t(HTTP_BAD_REQUEST);
+                keep_alive = false;
+            }
+            if (!keep_alive) {
+                res.add_header_line("Connection", "close");
+            } else if (req.version == "1.0") {
+                res.add_header_line("Connection", "keep-alive");
+            }
+            write_http_msg(conn.get(), res, keepalive.get_drain_signal());
         }
-        write_http_msg(conn.get(), res, keepalive.get_drain_signal());
     } catch (const interrupted_exc_t &) {
-        // The query was interrupted, no response since we are shutting down
+        // The query was interrupted, no response since we are shutting down (or the
+        // connection sat idle for too long)
     } catch (const tcp_conn_read_closed_exc_t &) {
         // Someone disconnected before sending us all the information we
         // needed... oh well.
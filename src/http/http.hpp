@@ -84,6 +84,7 @@ int content_length(const http_req_t&);
 enum http_status_code_t {
     HTTP_OK = 200,
     HTTP_NO_CONTENT = 204,
+    HTTP_NOT_MODIFIED = 304,
     HTTP_BAD_REQUEST = 400,
     HTTP_FORBIDDEN = 403,
     HTTP_NOT_FOUND = 404,
@@ -110,6 +111,9 @@ public:
     void add_last_modified(int);
 };
 
+// Whether the client's `Accept-Encoding` prefers gzip to sending the body as is.
+bool accepts_gzip(const http_req_t &req);
+
 bool maybe_gzip_response(const http_req_t &req, http_res_t *res);
 
 http_res_t http_error_res(const std::string &content,
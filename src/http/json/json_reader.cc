@@ -0,0 +1,339 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "http/json/json_reader.hpp"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+json_reader_t::json_reader_t(const char *data, size_t size)
+    : pos(data), begin(data), end(data + size), at_container_start(false) { }
+
+void json_reader_t::skip_whitespace() {
+    while (pos != end && static_cast<unsigned char>(*pos) <= 32
+           && *pos != '\0') {
+        ++pos;
+    }
+}
+
+void json_reader_t::expect(char c) {
+    skip_whitespace();
+    if (pos == end || *pos != c) {
+        throw json_reader_exc_t(pos - begin);
+    }
+    ++pos;
+}
+
+void json_reader_t::expect_literal(const char *literal, size_t size) {
+    if (static_cast<size_t>(end - pos) < size || memcmp(pos, literal, size) != 0) {
+        throw json_reader_exc_t(pos - begin);
+    }
+    pos += size;
+}
+
+json_value_type_t json_reader_t::peek() {
+    skip_whitespace();
+    if (pos == end) {
+        throw json_reader_exc_t(pos - begin);
+    }
+    switch (*pos) {
+    case 'n': return json_value_type_t::NUL;
+    case 't': // fallthru
+    case 'f': return json_value_type_t::BOOL;
+    case '"': return json_value_type_t::STRING;
+    case '[': return json_value_type_t::ARRAY;
+    case '{': return json_value_type_t::OBJECT;
+    case '-': // fallthru
+    case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+        return json_value_type_t::NUMBER;
+    default:
+        throw json_reader_exc_t(pos - begin);
+    }
+}
+
+void json_reader_t::read_null() {
+    skip_whitespace();
+    expect_literal("null", 4);
+}
+
+bool json_reader_t::read_bool() {
+    skip_whitespace();
+    if (pos != end && *pos == 't') {
+        expect_literal("true", 4);
+        return true;
+    } else {
+        expect_literal("false", 5);
+        return false;
+    }
+}
+
+inline bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+double json_reader_t::read_number() {
+    skip_whitespace();
+    const char *const start = pos;
+    bool negative = false;
+    if (pos != end && *pos == '-') {
+        negative = true;
+        ++pos;
+    }
+    // Integers of up to 15 digits are exactly representable, so we can convert
+    // them ourselves. Everything else goes to `strtod`.
+    uint64_t mantissa = 0;
+    const char *const digits_start = pos;
+    if (pos != end && *pos == '0') {
+        ++pos;
+    } else {
+        while (pos != end && is_digit(*pos)) {
+            mantissa = mantissa * 10 + (*pos - '0');
+            ++pos;
+        }
+    }
+    const size_t num_digits = pos - digits_start;
+    if (num_digits == 0) {
+        throw json_reader_exc_t(pos - begin);
+    }
+    bool simple = num_digits <= 15;
+    if (pos != end && *pos == '.') {
+        simple = false;
+        ++pos;
+        const char *const frac_start = pos;
+        while (pos != end && is_digit(*pos)) {
+            ++pos;
+        }
+        if (pos == frac_start) {
+            throw json_reader_exc_t(pos - begin);
+        }
+    }
+    if (pos != end && (*pos == 'e' || *pos == 'E')) {
+        simple = false;
+        ++pos;
+        if (pos != end && (*pos == '+' || *pos == '-')) {
+            ++pos;
+        }
+        const char *const exp_start = pos;
+        while (pos != end && is_digit(*pos)) {
+            ++pos;
+        }
+        if (pos == exp_start) {
+            throw json_reader_exc_t(pos - begin);
+        }
+    }
+
+    if (simple) {
+        const double value = static_cast<double>(mantissa);
+        return negative ? -value : value;
+    }
+    // `strtod` needs a NUL-terminated copy.
+    const size_t size = pos - start;
+    char buf[64];
+    if (size < sizeof(buf)) {
+        memcpy(buf, start, size);
+        buf[size] = '\0';
+        return strtod(buf, NULL);
+    } else {
+        const std::string copy(start, size);
+        return strtod(copy.c_str(), NULL);
+    }
+}
+
+unsigned json_reader_t::read_hex4() {
+    if (end - pos < 4) {
+        throw json_reader_exc_t(pos - begin);
+    }
+    unsigned value = 0;
+    for (int i = 0; i < 4; ++i, ++pos) {
+        const char c = *pos;
+        value <<= 4;
+        if (c >= '0' && c <= '9') {
+            value |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            value |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            value |= c - 'A' + 10;
+        } else {
+            throw json_reader_exc_t(pos - begin);
+        }
+    }
+    return value;
+}
+
+void json_reader_t::read_unicode_escape(std::string *out) {
+    // `pos` is right after the `\u`.
+    unsigned code_point = read_hex4();
+    if (code_point >= 0xDC00 && code_point <= 0xDFFF) {
+        throw json_reader_exc_t(pos - begin);
+    } else if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+        // A surrogate pair.
+        if (end - pos < 2 || pos[0] != '\\' || pos[1] != 'u') {
+            throw json_reader_exc_t(pos - begin);
+        }
+        pos += 2;
+        const unsigned low = read_hex4();
+        if (low < 0xDC00 || low > 0xDFFF) {
+            throw json_reader_exc_t(pos - begin);
+        }
+        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+    } else if (code_point == 0) {
+        throw json_reader_exc_t(pos - begin);
+    }
+
+    if (code_point < 0x80) {
+        out->push_back(static_cast<char>(code_point));
+    } else if (code_point < 0x800) {
+        out->push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+        out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else if (code_point < 0x10000) {
+        out->push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+        out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else {
+        out->push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+        out->push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+}
+
+// Returns the first byte in [p, e) that is a quote, a backslash or a NUL, or `e`.
+// This is where parsing spends most of its time for string-heavy documents, so
+// we look at 16 bytes at a time where we can.
+inline const char *find_string_special(const char *p, const char *e) {
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i nul = _mm_setzero_si128();
+    while (e - p >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const __m128i matches =
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                      _mm_cmpeq_epi8(chunk, backslash)),
+                         _mm_cmpeq_epi8(chunk, nul));
+        const int mask = _mm_movemask_epi8(matches);
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p != e && *p != '"' && *p != '\\' && *p != '\0') {
+        ++p;
+    }
+    return p;
+}
+
+void json_reader_t::read_string(std::string *out) {
+    out->clear();
+    expect('"');
+    for (;;) {
+        const char *const special = find_string_special(pos, end);
+        out->append(pos, special - pos);
+        pos = special;
+        if (pos == end || *pos == '\0') {
+            throw json_reader_exc_t(pos - begin);
+        }
+        if (*pos == '"') {
+            ++pos;
+            return;
+        }
+        // A backslash.
+        ++pos;
+        if (pos == end) {
+            throw json_reader_exc_t(pos - begin);
+        }
+        const char c = *pos;
+        ++pos;
+        switch (c) {
+        case '"': out->push_back('"'); break;
+        case '\\': out->push_back('\\'); break;
+        case '/': out->push_back('/'); break;
+        case 'b': out->push_back('\b'); break;
+        case 'f': out->push_back('\f'); break;
+        case 'n': out->push_back('\n'); break;
+        case 'r': out->push_back('\r'); break;
+        case 't': out->push_back('\t'); break;
+        case 'u': read_unicode_escape(out); break;
+        default:
+            throw json_reader_exc_t(pos - 1 - begin);
+        }
+    }
+}
+
+void json_reader_t::begin_array() {
+    expect('[');
+    at_container_start = true;
+}
+
+void json_reader_t::begin_object() {
+    expect('{');
+    at_container_start = true;
+}
+
+bool json_reader_t::next_in_container(char close) {
+    skip_whitespace();
+    if (pos == end) {
+        throw json_reader_exc_t(pos - begin);
+    }
+    const bool first = at_container_start;
+    at_container_start = false;
+    if (*pos == close) {
+        ++pos;
+        return false;
+    }
+    if (!first) {
+        expect(',');
+    }
+    return true;
+}
+
+bool json_reader_t::next_element() {
+    return next_in_container(']');
+}
+
+bool json_reader_t::next_member(std::string *key_out) {
+    if (!next_in_container('}')) {
+        return false;
+    }
+    read_string(key_out);
+    expect(':');
+    return true;
+}
+
+void json_reader_t::skip_value() {
+    switch (peek()) {
+    case json_value_type_t::NUL: read_null(); break;
+    case json_value_type_t::BOOL: read_bool(); break;
+    case json_value_type_t::NUMBER: read_number(); break;
+    case json_value_type_t::STRING: {
+        std::string tmp;
+        read_string(&tmp);
+    } break;
+    case json_value_type_t::ARRAY: {
+        begin_array();
+        while (next_element()) {
+            skip_value();
+        }
+    } break;
+    case json_value_type_t::OBJECT: {
+        begin_object();
+        std::string key;
+        while (next_member(&key)) {
+            skip_value();
+        }
+    } break;
+    default: unreachable();
+    }
+}
+
+void json_reader_t::finish() {
+    skip_whitespace();
+    if (pos != end) {
+        throw json_reader_exc_t(pos - begin);
+    }
+}
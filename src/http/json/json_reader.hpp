@@ -0,0 +1,87 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef HTTP_JSON_JSON_READER_HPP_
+#define HTTP_JSON_JSON_READER_HPP_
+
+#include <stddef.h>
+
+#include <exception>
+#include <string>
+
+#include "errors.hpp"
+
+class json_reader_exc_t : public std::exception {
+public:
+    explicit json_reader_exc_t(size_t _position) : position(_position) { }
+    const char *what() const throw () { return "Malformed JSON."; }
+    // Offset of the byte that couldn't be parsed.
+    const size_t position;
+};
+
+enum class json_value_type_t { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT };
+
+/* A pull parser that reads JSON values straight off a buffer, so that the
+consumer can build whatever it needs (datums, query protobufs) without going
+through a `cJSON` tree first. The buffer doesn't need to be NUL-terminated.
+
+Arrays and objects are read like this:
+
+    reader.begin_array();
+    while (reader.next_element()) {
+        ... read the element ...
+    }
+
+    reader.begin_object();
+    std::string key;
+    while (reader.next_member(&key)) {
+        ... read the value ...
+    }
+
+Every method throws `json_reader_exc_t` if the input doesn't have what it asks
+for. As in `cJSON`, all bytes up to 32 count as whitespace. Strings containing NUL
+characters are rejected, because `cJSON` would have silently truncated them. */
+class json_reader_t {
+public:
+    json_reader_t(const char *data, size_t size);
+
+    // Returns the type of the next value without consuming anything.
+    json_value_type_t peek();
+
+    void read_null();
+    bool read_bool();
+    double read_number();
+    // Replaces the contents of `out`.
+    void read_string(std::string *out);
+
+    void begin_array();
+    // Returns false (and consumes the closing bracket) once the array is over.
+    bool next_element();
+
+    void begin_object();
+    // Returns false (and consumes the closing brace) once the object is over.
+    bool next_member(std::string *key_out);
+
+    // Skips the next value, including everything nested in it.
+    void skip_value();
+
+    // Checks that nothing but whitespace is left.
+    void finish();
+
+private:
+    void skip_whitespace();
+    void expect(char c);
+    void expect_literal(const char *literal, size_t size);
+    void read_unicode_escape(std::string *out);
+    unsigned read_hex4();
+    MUST_USE bool next_in_container(char close);
+
+    const char *pos;
+    const char *const begin;
+    const char *const end;
+
+    // Whether the container we just began hasn't had an element yet.
+    bool at_container_start;
+
+    DISABLE_COPYING(json_reader_t);
+};
+
+#endif  // HTTP_JSON_JSON_READER_HPP_
@@ -9,4 +9,8 @@
 
 extern std::map<std::string, const std::string > static_web_assets;
 
+// The assets that compress well, gzipped, and a strong ETag for every asset.
+extern std::map<std::string, const std::string > static_web_assets_gzipped;
+extern std::map<std::string, const std::string > static_web_asset_etags;
+
 #endif /* HTTP_WEB_ASSETS_HPP_ */
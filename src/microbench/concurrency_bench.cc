@@ -0,0 +1,95 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/fifo_enforcer.hpp"
+#include "concurrency/new_mutex.hpp"
+#include "concurrency/new_semaphore.hpp"
+#include "concurrency/pmap.hpp"
+#include "concurrency/rwlock.hpp"
+#include "microbench/microbench.hpp"
+
+MICROBENCH(Semaphore, Uncontended) {
+    new_semaphore_t semaphore(1);
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        new_semaphore_acq_t acq(&semaphore, 1);
+        acq.acquisition_signal()->wait();
+    }
+}
+
+// Two coroutines taking turns, so that every release hands the semaphore to the
+// other one. This includes a yield per iteration.
+MICROBENCH(Semaphore, Handoff) {
+    new_semaphore_t semaphore(1);
+    const int64_t n = state->iterations();
+    pmap(2, [&](int64_t which) {
+        for (int64_t i = which; i < n; i += 2) {
+            new_semaphore_acq_t acq(&semaphore, 1);
+            acq.acquisition_signal()->wait();
+            coro_t::yield();
+        }
+    });
+}
+
+MICROBENCH(Mutex, Uncontended) {
+    new_mutex_t mutex;
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        new_mutex_in_line_t in_line(&mutex);
+        in_line.acq_signal()->wait();
+    }
+}
+
+// Like `Semaphore.Handoff`.
+MICROBENCH(Mutex, Handoff) {
+    new_mutex_t mutex;
+    const int64_t n = state->iterations();
+    pmap(2, [&](int64_t which) {
+        for (int64_t i = which; i < n; i += 2) {
+            new_mutex_in_line_t in_line(&mutex);
+            in_line.acq_signal()->wait();
+            coro_t::yield();
+        }
+    });
+}
+
+MICROBENCH(Rwlock, Read) {
+    rwlock_t lock;
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        rwlock_acq_t acq(&lock, access_t::read);
+    }
+}
+
+MICROBENCH(Rwlock, Write) {
+    rwlock_t lock;
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        rwlock_acq_t acq(&lock, access_t::write);
+    }
+}
+
+MICROBENCH(FifoEnforcer, Write) {
+    fifo_enforcer_source_t source;
+    fifo_enforcer_sink_t sink;
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        fifo_enforcer_sink_t::exit_write_t exit_write(&sink, source.enter_write());
+        exit_write.wait();
+    }
+}
+
+// Four reads and a write per iteration, each finishing before the next enters.
+MICROBENCH(FifoEnforcer, ReadsAndWrite) {
+    fifo_enforcer_source_t source;
+    fifo_enforcer_sink_t sink;
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        for (int j = 0; j < 4; ++j) {
+            fifo_enforcer_sink_t::exit_read_t exit_read(&sink, source.enter_read());
+            exit_read.wait();
+        }
+        fifo_enforcer_sink_t::exit_write_t exit_write(&sink, source.enter_write());
+        exit_write.wait();
+    }
+}
+
+// Spawning 16 coroutines and waiting for them.
+MICROBENCH(Pmap, FanOut16) {
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        pmap(16, [](int64_t) { });
+    }
+}
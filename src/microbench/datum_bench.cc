@@ -0,0 +1,86 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "microbench/microbench.hpp"
+#include "rdb_protocol/configured_limits.hpp"
+#include "rdb_protocol/datum.hpp"
+
+// The reference counts of arrays, objects and strings are atomic, because datums
+// are handed between threads (e.g. by the artificial table backends).  These
+// measure what a copy costs compared to a move, which is what the ReQL pipeline
+// saves wherever it moves a datum instead of copying it.
+
+static ql::datum_t make_row(int i) {
+    ql::datum_object_builder_t builder;
+    builder.overwrite("id", ql::datum_t(static_cast<double>(i)));
+    builder.overwrite("name", ql::datum_t(datum_string_t(std::string(32, 'a'))));
+    builder.overwrite("tags", ql::datum_t(std::vector<ql::datum_t>(
+        3, ql::datum_t(datum_string_t("tag"))), ql::configured_limits_t()));
+    return std::move(builder).to_datum();
+}
+
+static std::vector<ql::datum_t> make_batch() {
+    std::vector<ql::datum_t> batch;
+    for (int i = 0; i < 100; ++i) {
+        batch.push_back(make_row(i));
+    }
+    return batch;
+}
+
+// One atomic increment and one atomic decrement per iteration.
+MICROBENCH(Datum, Copy) {
+    ql::datum_t row = make_row(0);
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        ql::datum_t copy = row;
+        row = std::move(copy);
+    }
+}
+
+MICROBENCH(Datum, Move) {
+    ql::datum_t row = make_row(0);
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        ql::datum_t moved = std::move(row);
+        row = std::move(moved);
+    }
+}
+
+// Appending a batch of 100 rows to another, as `concatMap` does.
+MICROBENCH(Datum, AppendBatchCopy) {
+    const std::vector<ql::datum_t> batch = make_batch();
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        std::vector<ql::datum_t> v = batch;
+        std::vector<ql::datum_t> out;
+        out.insert(out.end(), v.begin(), v.end());
+    }
+}
+
+MICROBENCH(Datum, AppendBatchMove) {
+    const std::vector<ql::datum_t> batch = make_batch();
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        std::vector<ql::datum_t> v = batch;
+        std::vector<ql::datum_t> out;
+        out.insert(out.end(),
+                   std::make_move_iterator(v.begin()),
+                   std::make_move_iterator(v.end()));
+    }
+}
+
+MICROBENCH(Datum, GetField) {
+    ql::datum_t row = make_row(0);
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        ql::datum_t name = row.get_field("name");
+    }
+}
+
+MICROBENCH(Datum, Merge) {
+    ql::datum_t left = make_row(0);
+    ql::datum_object_builder_t builder;
+    builder.overwrite("count", ql::datum_t(1.0));
+    ql::datum_t right = std::move(builder).to_datum();
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        ql::datum_t merged = left.merge(right);
+    }
+}
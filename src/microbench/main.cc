@@ -0,0 +1,32 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <functional>
+#include <string>
+
+#include "arch/runtime/starter.hpp"
+#include "microbench/microbench.hpp"
+#include "utils.hpp"
+
+int main(int argc, char **argv) {
+    startup_shutdown_t startup_shutdown;
+
+    std::string filter;
+    int min_time_ms = 500;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--min-time-ms") == 0 && i + 1 < argc) {
+            min_time_ms = atoi(argv[++i]);
+        } else {
+            printf("Usage: %s [--filter SUBSTRING] [--min-time-ms MS]\n", argv[0]);
+            return strcmp(argv[i], "--help") == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    run_in_thread_pool(std::bind(&run_microbenchmarks, filter, min_time_ms),
+                       MICROBENCH_THREADS);
+    return EXIT_SUCCESS;
+}
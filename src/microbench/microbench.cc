@@ -0,0 +1,66 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "microbench/microbench.hpp"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "config/args.hpp"
+#include "time.hpp"
+
+namespace {
+
+typedef std::vector<std::pair<const char *, microbench_func_t> > microbenches_t;
+
+// A function-local static, so that it exists before the registrations run.
+microbenches_t *get_microbenches() {
+    static microbenches_t microbenches;
+    return &microbenches;
+}
+
+}  // namespace
+
+microbench_registration_t::microbench_registration_t(const char *name,
+                                                     microbench_func_t func) {
+    get_microbenches()->push_back(std::make_pair(name, func));
+}
+
+void run_microbenchmarks(const std::string &filter, int min_time_ms) {
+    microbenches_t microbenches = *get_microbenches();
+    std::sort(microbenches.begin(), microbenches.end(),
+              [](const std::pair<const char *, microbench_func_t> &a,
+                 const std::pair<const char *, microbench_func_t> &b) {
+                  return std::string(a.first) < std::string(b.first);
+              });
+
+    const ticks_t min_ticks = min_time_ms * MILLION;
+    printf("%-36s %14s %12s\n", "benchmark", "iterations", "ns/iteration");
+    for (const auto &microbench : microbenches) {
+        if (std::string(microbench.first).find(filter) == std::string::npos) {
+            continue;
+        }
+        int64_t iterations = 1;
+        ticks_t ticks;
+        for (;;) {
+            microbench_state_t state(iterations);
+            const ticks_t start = get_ticks();
+            microbench.second(&state);
+            ticks = get_ticks() - start;
+            if (ticks >= min_ticks || iterations >= (INT64_C(1) << 40)) {
+                break;
+            }
+            // Aim a little past the minimum time, but grow at most a hundredfold
+            // since the short runs are noisy.
+            const double factor = ticks == 0
+                ? 100
+                : std::min(100.0, std::max(2.0, 1.4 * min_ticks / ticks));
+            iterations = static_cast<int64_t>(iterations * factor);
+        }
+        printf("%-36s %14" PRIi64 " %12.1f\n", microbench.first, iterations,
+               static_cast<double>(ticks) / iterations);
+        fflush(stdout);
+    }
+}
@@ -0,0 +1,55 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef MICROBENCH_MICROBENCH_HPP_
+#define MICROBENCH_MICROBENCH_HPP_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "errors.hpp"
+
+/* A small harness for microbenchmarks of the runtime, in the style of Google
+Benchmark. A benchmark is a function that does what's being measured
+`state->iterations()` times:
+
+    MICROBENCH(Coro, Yield) {
+        for (int64_t i = 0; i < state->iterations(); ++i) {
+            coro_t::yield();
+        }
+    }
+
+The runner calls it with growing iteration counts until one run takes at least the
+minimum time, and reports the time per iteration of that run. Benchmarks run in a
+coroutine on thread 0 of a thread pool with `MICROBENCH_THREADS` threads. */
+
+#define MICROBENCH_THREADS 2
+
+class microbench_state_t {
+public:
+    explicit microbench_state_t(int64_t iterations) : iterations_(iterations) { }
+    int64_t iterations() const { return iterations_; }
+
+private:
+    const int64_t iterations_;
+
+    DISABLE_COPYING(microbench_state_t);
+};
+
+typedef void (*microbench_func_t)(microbench_state_t *state);
+
+class microbench_registration_t {
+public:
+    microbench_registration_t(const char *name, microbench_func_t func);
+};
+
+/* Runs the benchmarks whose names contain `filter`, each for at least
+`min_time_ms`, and prints the results. Must be called in a coroutine. */
+void run_microbenchmarks(const std::string &filter, int min_time_ms);
+
+#define MICROBENCH(group, name)                                                     \
+    void microbench_##group##_##name(microbench_state_t *state);                    \
+    static microbench_registration_t microbench_registration_##group##_##name(      \
+        #group "." #name, &microbench_##group##_##name);                            \
+    void microbench_##group##_##name(UNUSED microbench_state_t *state)
+
+#endif  // MICROBENCH_MICROBENCH_HPP_
@@ -0,0 +1,17 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <string>
+
+#include "microbench/microbench.hpp"
+#include "region/hash_region.hpp"
+
+// Every key a read or write touches is hashed to find its CPU shard, and range
+// deletes hash every key they visit.
+MICROBENCH(HashRegion, HashKey) {
+    const std::string key = "S4ae1b7fc-b2f5-4a4a-a3c7-c2d1b1f5a1e0";
+    uint64_t sum = 0;
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        sum += hash_region_hasher(reinterpret_cast<const uint8_t *>(key.data()),
+                                  key.size());
+    }
+    guarantee(sum != 1);
+}
@@ -0,0 +1,77 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "arch/runtime/context_switching.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/runtime.hpp"
+#include "concurrency/cond_var.hpp"
+#include "config/args.hpp"
+#include "microbench/microbench.hpp"
+
+// The contexts for `ContextSwitch`; `context_switch()` can't pass arguments along.
+static __thread coro_context_ref_t *main_context = NULL, *bouncer_context = NULL;
+
+static void bounce() {
+    for (;;) {
+        context_switch(bouncer_context, main_context);
+    }
+}
+
+// Two raw context switches per iteration, without any of the `coro_t` machinery.
+MICROBENCH(Coro, ContextSwitch) {
+    coro_context_ref_t context;
+    coro_stack_t stack(&bounce, 64 * KILOBYTE);
+    main_context = &context;
+    bouncer_context = &stack.context;
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        context_switch(main_context, bouncer_context);
+    }
+    main_context = NULL;
+    bouncer_context = NULL;
+}
+
+// Spawning and running a coroutine that does nothing.
+MICROBENCH(Coro, Spawn) {
+    int64_t remaining = state->iterations();
+    cond_t done;
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        coro_t::spawn_sometime([&]() {
+            if (--remaining == 0) {
+                done.pulse();
+            }
+        });
+    }
+    done.wait();
+}
+
+// A round trip through the message hub.
+MICROBENCH(Coro, Yield) {
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        coro_t::yield();
+    }
+}
+
+// Two coroutines waking each other up, once each per iteration. This mostly
+// measures direct handoffs; see `COROUTINE_MAX_DIRECT_HANDOFFS`.
+MICROBENCH(Coro, NotifyPingPong) {
+    const int64_t n = state->iterations();
+    coro_t *self = coro_t::self();
+    coro_t *partner = coro_t::spawn_sometime([&]() {
+        for (int64_t i = 0; i < n; ++i) {
+            self->notify_sometime();
+            coro_t::wait();
+        }
+        self->notify_sometime();
+    });
+    for (int64_t i = 0; i < n; ++i) {
+        coro_t::wait();
+        partner->notify_sometime();
+    }
+    coro_t::wait();
+}
+
+// Going to another thread and back with `on_thread_t`.
+MICROBENCH(Thread, OnThreadRoundTrip) {
+    guarantee(get_num_threads() >= 2);
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        on_thread_t thread_switcher((threadnum_t(1)));
+    }
+}
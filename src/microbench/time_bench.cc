@@ -0,0 +1,42 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <string>
+
+#include "microbench/microbench.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/error.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
+
+// `r.iso8601` and `toISO8601` on the usual forms, which don't go through boost,
+// and on an ordinal date, which still does.
+
+class bench_target_t : public ql::rcheckable_t {
+public:
+    void runtime_fail(ql::base_exc_t::type_t type,
+                      const char *test, const char *file, int line,
+                      std::string msg) const {
+        ql::runtime_fail(type, test, file, line, msg);
+    }
+};
+
+MICROBENCH(Time, ParseIso8601) {
+    bench_target_t target;
+    const std::string s = "2015-04-02T12:34:56.789-07:00";
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        ql::datum_t t = ql::pseudo::iso8601_to_time(s, "", &target);
+    }
+}
+
+MICROBENCH(Time, ParseIso8601OrdinalDate) {
+    bench_target_t target;
+    const std::string s = "2015-092T12:34:56.789-07:00";
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        ql::datum_t t = ql::pseudo::iso8601_to_time(s, "", &target);
+    }
+}
+
+MICROBENCH(Time, FormatIso8601) {
+    const ql::datum_t t = ql::pseudo::make_time(1428003296.789, "-07:00");
+    for (int64_t i = 0; i < state->iterations(); ++i) {
+        std::string s = ql::pseudo::time_to_iso8601(t);
+    }
+}
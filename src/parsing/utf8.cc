@@ -1,8 +1,13 @@
 #include "parsing/utf8.hpp"
 
-#include <string>
 #include <string.h>
 
+#include <string>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "rdb_protocol/datum_string.hpp"
 
 namespace utf8 {
@@ -50,6 +55,26 @@ inline unsigned int extract_and_shift(char c, unsigned int bits, unsigned int am
     return extract_bits(c, bits) << amount;
 }
 
+// Returns the first byte in [p, e) that isn't ASCII, or `e`.  Most strings are
+// mostly ASCII, so we look at 16 bytes at a time where we can.
+inline const char *skip_ascii(const char *p, const char *e) {
+#if defined(__SSE2__)
+    while (e - p >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        // The high bit of each byte.
+        const int mask = _mm_movemask_epi8(chunk);
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p != e && is_standalone(*p)) {
+        ++p;
+    }
+    return p;
+}
+
 template <class Iterator>
 inline bool check_continuation(const Iterator &p, const Iterator &end,
                                size_t position, reason_t *reason) {
@@ -66,15 +91,17 @@ inline bool check_continuation(const Iterator &p, const Iterator &end,
     return true;
 }
 
-template <class Iterator>
-inline bool is_valid_internal(const Iterator &begin, const Iterator &end,
+inline bool is_valid_internal(const char *begin, const char *end,
                               reason_t *reason) {
-    Iterator p = begin;
+    const char *p = begin;
     size_t position = 0;
     while (p != end) {
         if (is_standalone(*p)) {
             // 0xxxxxxx - ASCII character
-            // don't need to do anything
+            const char *next = skip_ascii(p, end);
+            position += next - p;
+            p = next;
+            continue;
         } else if (is_twobyte_start(*p)) {
             // 110xxxxx - two character multibyte
             unsigned int result = extract_and_shift(*p, HIGH_THREE_BITS, 6);
@@ -144,7 +171,7 @@ bool is_valid(const datum_string_t &str) {
 
 bool is_valid(const std::string &str) {
     reason_t reason;
-    return is_valid_internal(str.begin(), str.end(), &reason);
+    return is_valid_internal(str.data(), str.data() + str.size(), &reason);
 }
 
 bool is_valid(const char *start, const char *end) {
@@ -157,7 +184,7 @@ bool is_valid(const datum_string_t &str, reason_t *reason) {
 }
 
 bool is_valid(const std::string &str, reason_t *reason) {
-    return is_valid_internal(str.begin(), str.end(), reason);
+    return is_valid_internal(str.data(), str.data() + str.size(), reason);
 }
 
 bool is_valid(const char *start, const char *end, reason_t *reason) {
@@ -3,6 +3,7 @@
 #include <boost/bind.hpp>
 
 #include "perfmon/collect.hpp"
+#include "perfmon/filter.hpp"
 #include "concurrency/pmap.hpp"
 
 /* This is the function that actually gathers the stats. It is illegal to create or destroy
@@ -20,3 +21,10 @@ ql::datum_t perfmon_get_stats() {
     return get_global_perfmon_collection().end_stats(data);
 }
 
+ql::datum_t perfmon_get_stats(const perfmon_filter_t &filter) {
+    void *data = get_global_perfmon_collection().begin_filtered_stats(
+        &filter, 0, std::vector<bool>(filter.num_paths(), true));
+    pmap(get_num_threads(), boost::bind(&co_perfmon_visit, _1, data));
+    return filter.filter(get_global_perfmon_collection().end_stats(data));
+}
+
@@ -4,10 +4,16 @@
 
 #include "perfmon/core.hpp"
 
+class perfmon_filter_t;
+
 /* `perfmon_get_stats()` collects all the stats about the server and puts them
  * into the `ql::datum_t` object. It must be run in a coroutine and it
  * blocks until it is done.
  */
 ql::datum_t perfmon_get_stats();
 
+/* Collects only the stats that pass `filter`, without visiting the perfmons of
+ * collections that can't contain any. */
+ql::datum_t perfmon_get_stats(const perfmon_filter_t &filter);
+
 #endif  // PERFMON_COLLECT_HPP_
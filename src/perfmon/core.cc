@@ -6,6 +6,7 @@
 #include "containers/scoped_regex.hpp"
 #include "logger.hpp"
 #include "perfmon/core.hpp"
+#include "perfmon/filter.hpp"
 #include "utils.hpp"
 
 /* Constructor and destructor register and deregister the perfmon. */
@@ -15,18 +16,27 @@ perfmon_t::perfmon_t() {
 perfmon_t::~perfmon_t() {
 }
 
+void *perfmon_t::begin_filtered_stats(UNUSED const perfmon_filter_t *filter,
+                                      UNUSED size_t depth,
+                                      UNUSED const std::vector<bool> &active) {
+    return begin_stats();
+}
+
 struct stats_collection_context_t : public home_thread_mixin_t {
 private:
     // This could be a read lock ... if we used a read-write lock instead of a mutex.
     cross_thread_mutex_t::acq_t lock_sentry;
 public:
     scoped_array_t<void *> contexts;
+    // The constituents that are left out of a filtered collection.
+    std::vector<bool> skipped;
 
     stats_collection_context_t(cross_thread_mutex_t *constituents_lock,
                                const intrusive_list_t<perfmon_membership_t> &constituents) :
         lock_sentry(constituents_lock),
         contexts(new void *[constituents.size()](),
-                 constituents.size()) { }
+                 constituents.size()),
+        skipped(constituents.size(), false) { }
 
     ~stats_collection_context_t() { }
 };
@@ -45,11 +55,36 @@ void *perfmon_collection_t::begin_stats() {
     return ctx;
 }
 
+void *perfmon_collection_t::begin_filtered_stats(const perfmon_filter_t *filter,
+                                                 size_t depth,
+                                                 const std::vector<bool> &active) {
+    stats_collection_context_t *ctx =
+        new stats_collection_context_t(&constituents_access, constituents);
+
+    size_t i = 0;
+    for (perfmon_membership_t *p = constituents.head(); p != NULL; p = constituents.next(p), ++i) {
+        if (p->splice()) {
+            // The constituent's stats go into this collection, at the same depth.
+            ctx->contexts[i] = p->get()->begin_filtered_stats(filter, depth, active);
+            continue;
+        }
+        std::vector<bool> subactive = active;
+        if (!filter->matches(p->name, depth, &subactive)) {
+            ctx->skipped[i] = true;
+            continue;
+        }
+        ctx->contexts[i] = p->get()->begin_filtered_stats(filter, depth + 1, subactive);
+    }
+    return ctx;
+}
+
 void perfmon_collection_t::visit_stats(void *_context) {
     stats_collection_context_t *ctx = reinterpret_cast<stats_collection_context_t*>(_context);
     size_t i = 0;
     for (perfmon_membership_t *p = constituents.head(); p != NULL; p = constituents.next(p), ++i) {
-        p->get()->visit_stats(ctx->contexts[i]);
+        if (!ctx->skipped[i]) {
+            p->get()->visit_stats(ctx->contexts[i]);
+        }
     }
 }
 
@@ -60,6 +95,9 @@ ql::datum_t perfmon_collection_t::end_stats(void *_context) {
 
     size_t i = 0;
     for (perfmon_membership_t *p = constituents.head(); p != NULL; p = constituents.next(p), ++i) {
+        if (ctx->skipped[i]) {
+            continue;
+        }
         ql::datum_t stat = p->get()->end_stats(ctx->contexts[i]);
         if (p->splice()) {
             for (size_t j = 0; j < stat.obj_size(); ++j) {
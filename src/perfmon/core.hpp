@@ -15,6 +15,7 @@
 #include "threading.hpp"
 
 class perfmon_collection_t;
+class perfmon_filter_t;
 class scoped_regex_t;
 
 /* The perfmon (short for "PERFormance MONitor") is responsible for gathering
@@ -44,6 +45,12 @@ public:
     virtual void *begin_stats() = 0;
     virtual void visit_stats(void *ctx) = 0;
     virtual ql::datum_t end_stats(void *ctx) = 0;
+
+    /* Like `begin_stats()`, but the perfmon may leave out stats that can't pass
+     * `filter`, as seen from `depth` levels down with the filter's paths `active`.
+     * It's up to the caller to apply the filter to the result. */
+    virtual void *begin_filtered_stats(const perfmon_filter_t *filter, size_t depth,
+                                       const std::vector<bool> &active);
 };
 
 class perfmon_membership_t;
@@ -59,6 +66,11 @@ public:
     void visit_stats(void *_contexts);
     ql::datum_t end_stats(void *_contexts);
 
+    /* Only the constituents that can pass the filter are collected, so that a
+     * request for the stats of a few tables doesn't visit those of all of them. */
+    void *begin_filtered_stats(const perfmon_filter_t *filter, size_t depth,
+                               const std::vector<bool> &active);
+
 private:
     friend class perfmon_membership_t;
 
@@ -12,10 +12,15 @@
 /* Construct a filter from a set of paths.  Paths are of the form foo/bar/baz,
    where each of those can be a regular expression.  They act a lot like XPath
    expressions, but for perfmon_t objects.  */
-perfmon_filter_t::perfmon_filter_t(const std::set<std::vector<std::string> > &paths) {
-    for (auto const &path : paths) {
-        std::vector<scoped_ptr_t<scoped_regex_t> > compiled_path;
+perfmon_filter_t::perfmon_filter_t(const std::set<std::vector<std::string> > &_paths) {
+    for (auto const &path : _paths) {
+        std::vector<component_t> compiled_path;
         for (auto const &str : path) {
+            compiled_path.emplace_back();
+            if (str.find_first_of("\\^$.|?*+()[]{}") == std::string::npos) {
+                compiled_path.back().literal = str;
+                continue;
+            }
             scoped_ptr_t<scoped_regex_t> re(new scoped_regex_t());
             if (!re->compile("^" + str + "$")) {
                 logWRN("Error: regex %s failed to compile (%s), treating as empty.",
@@ -27,15 +32,35 @@ perfmon_filter_t::perfmon_filter_t(const std::set<std::vector<std::string> > &pa
                 }
             }
 
-            compiled_path.emplace_back(std::move(re));
+            compiled_path.back().regex = std::move(re);
         }
-        regexps.emplace_back(std::move(compiled_path));
+        paths.emplace_back(std::move(compiled_path));
     }
 }
 
 ql::datum_t perfmon_filter_t::filter(const ql::datum_t &stats) const {
     guarantee(stats.has(), "perfmon_filter_t::filter was passed an uninitialized datum");
-    return subfilter(stats, 0, std::vector<bool>(regexps.size(), true));
+    return subfilter(stats, 0, std::vector<bool>(paths.size(), true));
+}
+
+bool perfmon_filter_t::matches(const std::string &name, size_t depth,
+                               std::vector<bool> *active) const {
+    bool some_subpath = false;
+    for (size_t j = 0; j < paths.size(); ++j) {
+        if (!(*active)[j]) {
+            continue;
+        }
+        if (depth >= paths[j].size()) {
+            some_subpath = true;
+            continue;
+        }
+        const component_t &component = paths[j][depth];
+        (*active)[j] = component.regex.has()
+            ? component.regex->matches(name)
+            : component.literal == name;
+        some_subpath |= (*active)[j];
+    }
+    return some_subpath;
 }
 
 /* Filter a perfmon result.  [depth] is how deep we are in the paths that
@@ -52,21 +77,8 @@ ql::datum_t perfmon_filter_t::subfilter(const ql::datum_t &stats,
             std::vector<bool> subactive = active;
             std::pair<datum_string_t, ql::datum_t> pair = stats.get_pair(i);
 
-            bool some_subpath = false;
-            for (size_t j = 0; j < regexps.size(); ++j) {
-                if (!active[j]) {
-                    continue;
-                }
-                if (depth >= regexps[j].size()) {
-                    some_subpath = true;
-                    continue;
-                }
-                subactive[j] = regexps[j][depth]->matches(pair.first.to_std());
-                some_subpath |= subactive[j];
-            }
-
             // Only write the stats if there was a match somewhere down the tree
-            if (some_subpath) {
+            if (matches(pair.first.to_std(), depth, &subactive)) {
                 ql::datum_t sub_stats = subfilter(pair.second, depth + 1, subactive);
                 if (sub_stats.get_type() != ql::datum_t::R_OBJECT ||
                     sub_stats.obj_size() > 0) {
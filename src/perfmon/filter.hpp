@@ -8,19 +8,32 @@
 
 #include "errors.hpp"
 
+#include "containers/scoped.hpp"
 #include "containers/scoped_regex.hpp"
 #include "rdb_protocol/datum.hpp"
 
-template <class> class scoped_ptr_t;
-
 class perfmon_filter_t {
 public:
     explicit perfmon_filter_t(const std::set<std::vector<std::string> > &paths);
     ql::datum_t filter(const ql::datum_t &stats) const;
+
+    size_t num_paths() const { return paths.size(); }
+
+    /* Whether a stat called `name`, `depth` levels down, or anything under it can
+    pass the filter, given the paths that were still `active` above it.  `active` is
+    updated to the paths that are still active below it. */
+    bool matches(const std::string &name, size_t depth, std::vector<bool> *active) const;
 private:
+    /* A path component without any special characters is compared as a string,
+    since most of them are table ids and the like. */
+    struct component_t {
+        std::string literal;
+        scoped_ptr_t<scoped_regex_t> regex;
+    };
+
     ql::datum_t subfilter(const ql::datum_t &stats,
                           size_t depth, std::vector<bool> active) const;
-    std::vector<std::vector<scoped_ptr_t<scoped_regex_t> > > regexps; //regexps[PATH][DEPTH]
+    std::vector<std::vector<component_t> > paths; //paths[PATH][DEPTH]
     DISABLE_COPYING(perfmon_filter_t);
 };
 
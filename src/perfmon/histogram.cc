@@ -0,0 +1,155 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "perfmon/histogram.hpp"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "config/args.hpp"
+#include "utils.hpp"
+
+/* latency_histogram_t */
+
+latency_histogram_t::latency_histogram_t() : count_(0), max_us_(0) {
+    memset(buckets_, 0, sizeof(buckets_));
+}
+
+int latency_histogram_t::bucket_of_value(uint64_t value_us) {
+    value_us = std::min<uint64_t>(value_us,
+                                  (uint64_t(1) << LATENCY_HISTOGRAM_MAX_VALUE_BITS) - 1);
+    if (value_us < LATENCY_HISTOGRAM_SUB_BUCKETS) {
+        return value_us;
+    }
+    const int magnitude = 63 - __builtin_clzll(value_us);
+    const int shift = magnitude - LATENCY_HISTOGRAM_SUB_BUCKET_BITS;
+    return LATENCY_HISTOGRAM_SUB_BUCKETS + shift * LATENCY_HISTOGRAM_SUB_BUCKETS
+        + ((value_us >> shift) - LATENCY_HISTOGRAM_SUB_BUCKETS);
+}
+
+uint64_t latency_histogram_t::highest_value_of_bucket(int bucket) {
+    rassert(bucket >= 0 && bucket < num_buckets);
+    if (bucket < LATENCY_HISTOGRAM_SUB_BUCKETS) {
+        return bucket;
+    }
+    const int shift = (bucket - LATENCY_HISTOGRAM_SUB_BUCKETS)
+        / LATENCY_HISTOGRAM_SUB_BUCKETS;
+    const uint64_t sub_bucket = LATENCY_HISTOGRAM_SUB_BUCKETS
+        + (bucket - LATENCY_HISTOGRAM_SUB_BUCKETS) % LATENCY_HISTOGRAM_SUB_BUCKETS;
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+void latency_histogram_t::record(ticks_t duration) {
+    const uint64_t value_us = duration / THOUSAND;
+    ++buckets_[bucket_of_value(value_us)];
+    ++count_;
+    max_us_ = std::max(max_us_, value_us);
+}
+
+void latency_histogram_t::merge(const latency_histogram_t &other) {
+    for (int i = 0; i < num_buckets; ++i) {
+        buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    max_us_ = std::max(max_us_, other.max_us_);
+}
+
+double latency_histogram_t::percentile(double fraction) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    const uint64_t target = std::max<uint64_t>(1, ceil(fraction * count_));
+    uint64_t seen = 0;
+    for (int i = 0; i < num_buckets; ++i) {
+        seen += buckets_[i];
+        if (seen >= target) {
+            return std::min(highest_value_of_bucket(i), max_us_) / static_cast<double>(MILLION);
+        }
+    }
+    return max();
+}
+
+double latency_histogram_t::max() const {
+    return max_us_ / static_cast<double>(MILLION);
+}
+
+/* perfmon_latency_histogram_t */
+
+perfmon_latency_histogram_t::perfmon_latency_histogram_t(ticks_t _length)
+    : thread_data(new cache_line_padded_t<thread_info_t>[MAX_THREADS]), length(_length) {
+    for (int i = 0; i < MAX_THREADS; ++i) {
+        thread_data[i].value.current_interval = get_ticks() / length;
+    }
+}
+
+perfmon_latency_histogram_t::~perfmon_latency_histogram_t() {
+    delete[] thread_data;
+}
+
+void perfmon_latency_histogram_t::update(ticks_t now) {
+    const int64_t interval = now / length;
+    rassert(get_thread_id().threadnum >= 0);
+    thread_info_t *thread = &thread_data[get_thread_id().threadnum].value;
+
+    if (thread->current_interval == interval) {
+        /* We're up to date; nothing to do */
+    } else if (thread->current_interval + 1 == interval) {
+        /* We're one step behind */
+        thread->last.reset();
+        thread->last.swap(thread->current);
+        thread->current_interval++;
+    } else {
+        /* We're more than one step behind */
+        thread->last.reset();
+        thread->current.reset();
+        thread->current_interval = interval;
+    }
+}
+
+void perfmon_latency_histogram_t::record(ticks_t duration) {
+    update(get_ticks());
+    thread_info_t *thread = &thread_data[get_thread_id().threadnum].value;
+    if (!thread->current.has()) {
+        thread->current.init(new latency_histogram_t());
+    }
+    thread->current->record(duration);
+}
+
+void perfmon_latency_histogram_t::get_thread_stat(
+        scoped_ptr_t<latency_histogram_t> *stat) {
+    update(get_ticks());
+    /* Like `perfmon_sampler_t`, we report the last complete interval. */
+    const thread_info_t *thread = &thread_data[get_thread_id().threadnum].value;
+    if (thread->last.has()) {
+        stat->init(new latency_histogram_t(*thread->last));
+    }
+}
+
+latency_histogram_t perfmon_latency_histogram_t::combine_stats(
+        const scoped_ptr_t<latency_histogram_t> *stats) {
+    latency_histogram_t combined;
+    for (int i = 0; i < get_num_threads(); ++i) {
+        if (stats[i].has()) {
+            combined.merge(*stats[i]);
+        }
+    }
+    return combined;
+}
+
+ql::datum_t perfmon_latency_histogram_t::output_stat(
+        const latency_histogram_t &combined) {
+    ql::datum_object_builder_t builder;
+    builder.overwrite("count", ql::datum_t(static_cast<double>(combined.count())));
+    if (combined.count() > 0) {
+        builder.overwrite("p50", ql::datum_t(combined.percentile(0.5)));
+        builder.overwrite("p99", ql::datum_t(combined.percentile(0.99)));
+        builder.overwrite("p999", ql::datum_t(combined.percentile(0.999)));
+        builder.overwrite("max", ql::datum_t(combined.max()));
+    } else {
+        builder.overwrite("p50", ql::datum_t::null());
+        builder.overwrite("p99", ql::datum_t::null());
+        builder.overwrite("p999", ql::datum_t::null());
+        builder.overwrite("max", ql::datum_t::null());
+    }
+    return std::move(builder).to_datum();
+}
@@ -0,0 +1,83 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef PERFMON_HISTOGRAM_HPP_
+#define PERFMON_HISTOGRAM_HPP_
+
+#include <stdint.h>
+
+#include "concurrency/cache_line_padded.hpp"
+#include "containers/scoped.hpp"
+#include "perfmon/perfmon.hpp"
+#include "time.hpp"
+
+/* `latency_histogram_t` is a histogram of durations in the style of HdrHistogram.
+Durations are counted in microseconds.  Below LATENCY_HISTOGRAM_SUB_BUCKETS
+microseconds every value has its own bucket; above that, each power of two is split
+into LATENCY_HISTOGRAM_SUB_BUCKETS equal buckets.  So a percentile read off the
+histogram is within 1/LATENCY_HISTOGRAM_SUB_BUCKETS of the true value however long
+the durations are, and the histogram has a fixed size.  Durations of more than about
+19 hours count as 19 hours. */
+
+#define LATENCY_HISTOGRAM_SUB_BUCKET_BITS 4
+#define LATENCY_HISTOGRAM_SUB_BUCKETS (1 << LATENCY_HISTOGRAM_SUB_BUCKET_BITS)
+#define LATENCY_HISTOGRAM_MAX_VALUE_BITS 36
+
+class latency_histogram_t {
+public:
+    latency_histogram_t();
+
+    void record(ticks_t duration);
+    void merge(const latency_histogram_t &other);
+
+    uint64_t count() const { return count_; }
+    // Returns the duration, in seconds, that at least a `fraction` of the recorded
+    // durations are no longer than.  Returns 0 if nothing was recorded.
+    double percentile(double fraction) const;
+    // In seconds.
+    double max() const;
+
+    // Exposed for the unit tests.
+    static int bucket_of_value(uint64_t value_us);
+    static uint64_t highest_value_of_bucket(int bucket);
+
+    static const int num_buckets = LATENCY_HISTOGRAM_SUB_BUCKETS
+        * (LATENCY_HISTOGRAM_MAX_VALUE_BITS - LATENCY_HISTOGRAM_SUB_BUCKET_BITS + 1);
+
+private:
+    uint64_t buckets_[num_buckets];
+    uint64_t count_;
+    uint64_t max_us_;
+};
+
+/* `perfmon_latency_histogram_t` reports the median, 99th and 99.9th percentiles,
+and the maximum of the durations that were recorded during the last complete
+interval of `length` ticks, all in seconds.  Threads that never record anything
+don't get a histogram, and each thread's histograms are on their own cache lines so
+that recording doesn't contend with other threads. */
+class perfmon_latency_histogram_t
+    : public perfmon_perthread_t<scoped_ptr_t<latency_histogram_t>,
+                                 latency_histogram_t> {
+public:
+    explicit perfmon_latency_histogram_t(ticks_t length);
+    ~perfmon_latency_histogram_t();
+
+    void record(ticks_t duration);
+
+private:
+    struct thread_info_t {
+        scoped_ptr_t<latency_histogram_t> current, last;
+        int64_t current_interval;
+    };
+
+    void update(ticks_t now);
+
+    void get_thread_stat(scoped_ptr_t<latency_histogram_t> *);
+    latency_histogram_t combine_stats(const scoped_ptr_t<latency_histogram_t> *);
+    ql::datum_t output_stat(const latency_histogram_t &);
+
+    cache_line_padded_t<thread_info_t> *thread_data;
+    ticks_t length;
+
+    DISABLE_COPYING(perfmon_latency_histogram_t);
+};
+
+#endif  // PERFMON_HISTOGRAM_HPP_
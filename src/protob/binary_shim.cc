@@ -0,0 +1,103 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "protob/binary_shim.hpp"
+
+#include <stdint.h>
+
+#include "containers/buffer_group.hpp"
+#include "rdb_protocol/configured_limits.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
+
+#include "rdb_protocol/ql2.pb.h"
+
+namespace binary_shim {
+
+template <class T>
+void append_le(T value, std::string *out) {
+    // The wire protocol is little-endian, like the machines we run on.
+    out->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void write_binary_pb_pieces(const Response &r,
+                            std::deque<std::string> *storage_out,
+                            const_buffer_group_t *pieces_out) THROWS_NOTHING {
+    // The pieces we generate ourselves are accumulated in `pending` and only
+    // turned into a buffer once we get to a datum we can reference in `r`.
+    std::string pending;
+    auto flush_pending = [&]() {
+        if (!pending.empty()) {
+            storage_out->push_back(std::move(pending));
+            pieces_out->add_buffer(storage_out->back().size(),
+                                   storage_out->back().data());
+            pending.clear();
+        }
+    };
+    // Errors and the profile aren't in serialized form, so we serialize them here.
+    auto append_datum = [&](const Datum *d) {
+        if (d->type() == Datum::R_SERIALIZED) {
+            flush_pending();
+            pieces_out->add_buffer(d->r_str().size(), d->r_str().data());
+        } else if (d->type() == Datum::R_STR) {
+            ql::datum_serialize_onto_string(
+                ql::datum_t(datum_string_t(d->r_str())), &pending);
+        } else {
+            ql::datum_serialize_onto_string(
+                ql::to_datum(d, ql::configured_limits_t::unlimited,
+                             reql_version_t::LATEST),
+                &pending);
+        }
+    };
+    rassert(storage_out->empty() && pieces_out->num_buffers() == 0);
+
+    try {
+        append_le<int32_t>(r.type(), &pending);
+        append_le<uint32_t>(r.response_size(), &pending);
+        for (int i = 0; i < r.response_size(); ++i) {
+            append_datum(&r.response(i));
+        }
+
+        append_le<uint8_t>(r.has_backtrace() ? 1 : 0, &pending);
+        if (r.has_backtrace()) {
+            const Backtrace *bt = &r.backtrace();
+            ql::datum_array_builder_t frames(ql::configured_limits_t::unlimited);
+            for (int i = 0; i < bt->frames_size(); ++i) {
+                const Frame *f = &bt->frames(i);
+                switch (f->type()) {
+                case Frame::POS:
+                    frames.add(ql::datum_t(static_cast<double>(f->pos())));
+                    break;
+                case Frame::OPT:
+                    frames.add(ql::datum_t(datum_string_t(f->opt())));
+                    break;
+                default:
+                    unreachable();
+                }
+            }
+            ql::datum_serialize_onto_string(std::move(frames).to_datum(), &pending);
+        }
+
+        append_le<uint8_t>(r.has_profile() ? 1 : 0, &pending);
+        if (r.has_profile()) {
+            append_datum(&r.profile());
+        }
+        flush_pending();
+    } catch (...) {
+#ifndef NDEBUG
+        throw;
+#else
+        pieces_out->clear();
+        storage_out->clear();
+        pending.clear();
+        append_le<int32_t>(Response::RUNTIME_ERROR, &pending);
+        append_le<uint32_t>(1, &pending);
+        ql::datum_serialize_onto_string(
+            ql::datum_t("Internal error in `write_binary_pb`, please report this."),
+            &pending);
+        append_le<uint8_t>(0, &pending);
+        append_le<uint8_t>(0, &pending);
+        flush_pending();
+#endif  // NDEBUG
+    }
+}
+
+}  // namespace binary_shim
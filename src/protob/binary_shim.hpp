@@ -0,0 +1,24 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef PROTOB_BINARY_SHIM_HPP_
+#define PROTOB_BINARY_SHIM_HPP_
+
+#include <deque>
+#include <string>
+
+#include "utils.hpp"
+
+class Response;
+class const_buffer_group_t;
+
+namespace binary_shim {
+/* Encodes `r` for the `BINARY` wire protocol (the layout is described in
+`ql2.proto`). Like `json_shim::write_json_pb_pieces()`, it puts the pieces of the
+encoding into `pieces_out`, which must be empty. The datums that are already
+serialized are referenced in `r`; everything else is kept in `storage_out`. Both
+`r` and `storage_out` must outlive `pieces_out`. */
+void write_binary_pb_pieces(const Response &r,
+                            std::deque<std::string> *storage_out,
+                            const_buffer_group_t *pieces_out) THROWS_NOTHING;
+}  // namespace binary_shim
+
+#endif  // PROTOB_BINARY_SHIM_HPP_
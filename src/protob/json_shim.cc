@@ -2,8 +2,10 @@
 
 #include <inttypes.h>
 
+#include "containers/buffer_group.hpp"
 #include "debug.hpp"
 #include "http/json.hpp"
+#include "http/json/json_reader.hpp"
 #include "rdb_protocol/ql2.pb.h"
 #include "utils.hpp"
 
@@ -18,124 +20,144 @@ public:
     const char *what() const throw () { return "json_shim::exc_t"; }
 };
 
+/* Queries are read straight off the JSON text with a `json_reader_t`. The
+`extract` functions each read one value into the corresponding protobuf. */
+
 template<class T>
 typename std::enable_if<!((std::is_enum<T>::value || std::is_fundamental<T>::value)
                           && !std::is_same<T, bool>::value)>::type
-extract(cJSON *, T *);
+extract(json_reader_t *, T *);
 
 template<class T>
 typename std::enable_if<(std::is_enum<T>::value || std::is_fundamental<T>::value)
                         && !std::is_same<T, bool>::value>::type
-extract(cJSON *field, T *dest) {
-    if (field->type != cJSON_Number) throw exc_t();
-    T t = static_cast<T>(field->valuedouble);
-    if (static_cast<double>(t) != field->valuedouble) throw exc_t();
+extract(json_reader_t *json, T *dest) {
+    if (json->peek() != json_value_type_t::NUMBER) throw exc_t();
+    const double d = json->read_number();
+    T t = static_cast<T>(d);
+    if (static_cast<double>(t) != d) throw exc_t();
     *dest = t;
 }
 
-template<class T>
-void safe_extract(cJSON *json, T *t) {
-    if (json != NULL && t != NULL) {
-        extract(json, t);
-    }
-}
-
 template<class T, class U>
-void transfer(cJSON *json, T *dest, void (T::*setter)(U)) {
+void transfer(json_reader_t *json, T *dest, void (T::*setter)(U)) {
     U tmp;
-    if (json != NULL) {
-        safe_extract(json, &tmp);
-        (dest->*setter)(std::move(tmp));
-    }
+    extract(json, &tmp);
+    (dest->*setter)(std::move(tmp));
 }
 
 template<class T, class U>
-void transfer(cJSON *json, T *dest, U *(T::*mut)()) {
-    if (json != NULL) {
-        safe_extract(json, (dest->*mut)());
-    }
+void transfer(json_reader_t *json, T *dest, U *(T::*mut)()) {
+    extract(json, (dest->*mut)());
+}
+
+// Items of arrays that are given as a JSON object get the member's key, and items
+// given as a JSON array don't get one.
+template<class T>
+void extract_item(json_reader_t *json, const std::string *, T *dest) {
+    extract(json, dest);
+}
+
+template<class T>
+void extract_pair(json_reader_t *json, const std::string *key, T *ap) {
+    if (key == NULL) throw exc_t();
+    ap->set_key(*key);
+    extract(json, ap->mutable_val());
+}
+
+void extract_item(json_reader_t *json, const std::string *key, Query::AssocPair *ap) {
+    extract_pair(json, key, ap);
+}
+
+void extract_item(json_reader_t *json, const std::string *key, Term::AssocPair *ap) {
+    extract_pair(json, key, ap);
+}
+
+void extract_item(json_reader_t *json, const std::string *key, Datum::AssocPair *ap) {
+    extract_pair(json, key, ap);
 }
 
 template<class T, class U>
-void transfer_arr(cJSON *arr, T *dest, U *(T::*adder)()) {
-    if (arr != NULL) {
-        if (arr->type != cJSON_Object && arr->type != cJSON_Array) throw exc_t();
-        for (cJSON *item = arr->head; item != NULL; item = item->next) {
-            safe_extract(item, (dest->*adder)());
+void transfer_arr(json_reader_t *json, T *dest, U *(T::*adder)()) {
+    switch (json->peek()) {
+    case json_value_type_t::ARRAY: {
+        json->begin_array();
+        while (json->next_element()) {
+            extract_item(json, NULL, (dest->*adder)());
+        }
+    } break;
+    case json_value_type_t::OBJECT: {
+        std::string key;
+        json->begin_object();
+        while (json->next_member(&key)) {
+            extract_item(json, &key, (dest->*adder)());
         }
+    } break;
+    case json_value_type_t::NUL: // fallthru
+    case json_value_type_t::BOOL: // fallthru
+    case json_value_type_t::NUMBER: // fallthru
+    case json_value_type_t::STRING:
+        throw exc_t();
+    default:
+        unreachable();
     }
 }
 
-template<>
-void extract(cJSON *field, std::string *s) {
-    if (field->type != cJSON_String) throw exc_t();
-    *s = field->valuestring;
+// Skips whatever is left of the array we're in, like the elements of a term array
+// after the optargs, which we ignore.
+void skip_rest_of_array(json_reader_t *json) {
+    while (json->next_element()) {
+        json->skip_value();
+    }
 }
 
 template<>
-void extract(cJSON *field, bool *dest) {
-    if (field->type == cJSON_False) {
-        *dest = false;
-    } else if (field->type == cJSON_True) {
-        *dest = true;
-    } else {
-        throw exc_t();
-    }
+void extract(json_reader_t *json, std::string *s) {
+    if (json->peek() != json_value_type_t::STRING) throw exc_t();
+    json->read_string(s);
 }
 
 template<>
-void extract(cJSON *json, Term *t) {
-    if (json->type == cJSON_Array) {
-        // It's ok to use the slow functions here, because the indexes are small
-        transfer(cJSON_slow_GetArrayItem(json, 0), t, &Term::set_type);
-        transfer_arr(cJSON_slow_GetArrayItem(json, 1), t, &Term::add_args);
-        transfer_arr(cJSON_slow_GetArrayItem(json, 2), t, &Term::add_optargs);
-    } else if (json->type == cJSON_Object) {
-        t->set_type(Term::MAKE_OBJ);
-        transfer_arr(json, t, &Term::add_optargs);
-    } else {
-        t->set_type(Term::DATUM);
-        transfer(json, t, &Term::mutable_datum);
-    }
+void extract(json_reader_t *json, bool *dest) {
+    if (json->peek() != json_value_type_t::BOOL) throw exc_t();
+    *dest = json->read_bool();
 }
 
 template<>
-void extract(cJSON *json, Datum *d) {
-    switch (json->type) {
-    case cJSON_False:
+void extract(json_reader_t *json, Datum *d) {
+    switch (json->peek()) {
+    case json_value_type_t::BOOL:
         d->set_type(Datum::R_BOOL);
-        d->set_r_bool(false);
+        d->set_r_bool(json->read_bool());
         break;
-    case cJSON_True:
-        d->set_type(Datum::R_BOOL);
-        d->set_r_bool(true);
-        break;
-    case cJSON_NULL:
+    case json_value_type_t::NUL:
+        json->read_null();
         d->set_type(Datum::R_NULL);
         break;
-    case cJSON_Number:
+    case json_value_type_t::NUMBER:
         d->set_type(Datum::R_NUM);
-        d->set_r_num(json->valuedouble);
+        d->set_r_num(json->read_number());
         break;
-    case cJSON_String:
+    case json_value_type_t::STRING:
         d->set_type(Datum::R_STR);
-        d->set_r_str(json->valuestring);
+        json->read_string(d->mutable_r_str());
         break;
-    case cJSON_Array:
+    case json_value_type_t::ARRAY:
         {
             d->set_type(Datum::R_ARRAY);
-            for (cJSON *item = json->head; item != NULL; item = item->next) {
-                extract(item, d->add_r_array());
+            json->begin_array();
+            while (json->next_element()) {
+                extract(json, d->add_r_array());
             }
         }
         break;
-    case cJSON_Object:
+    case json_value_type_t::OBJECT:
         {
             d->set_type(Datum::R_OBJECT);
-            for (cJSON *item = json->head; item != NULL; item = item->next) {
-                Datum::AssocPair *ap = d->add_r_object();
-                ap->set_key(item->string);
-                extract(item, ap->mutable_val());
+            std::string key;
+            json->begin_object();
+            while (json->next_member(&key)) {
+                extract_item(json, &key, d->add_r_object());
             }
         }
         break;
@@ -145,44 +167,64 @@ void extract(cJSON *json, Datum *d) {
 }
 
 template<>
-void extract(cJSON *json, Query::AssocPair *ap) {
-    if (json->string == NULL) throw exc_t();
-    ap->set_key(json->string);
-    extract(json, ap->mutable_val());
-}
-
-template<>
-void extract(cJSON *json, Term::AssocPair *ap) {
-    if (json->string == NULL) throw exc_t();
-    ap->set_key(json->string);
-    extract(json, ap->mutable_val());
-}
-
-template<>
-void extract(cJSON *json, Datum::AssocPair *ap) {
-    if (json->string == NULL) throw exc_t();
-    ap->set_key(json->string);
-    extract(json, ap->mutable_val());
+void extract(json_reader_t *json, Term *t) {
+    switch (json->peek()) {
+    case json_value_type_t::ARRAY:
+        json->begin_array();
+        if (json->next_element()) {
+            transfer(json, t, &Term::set_type);
+            if (json->next_element()) {
+                transfer_arr(json, t, &Term::add_args);
+                if (json->next_element()) {
+                    transfer_arr(json, t, &Term::add_optargs);
+                    skip_rest_of_array(json);
+                }
+            }
+        }
+        break;
+    case json_value_type_t::OBJECT:
+        t->set_type(Term::MAKE_OBJ);
+        transfer_arr(json, t, &Term::add_optargs);
+        break;
+    case json_value_type_t::NUL: // fallthru
+    case json_value_type_t::BOOL: // fallthru
+    case json_value_type_t::NUMBER: // fallthru
+    case json_value_type_t::STRING:
+        t->set_type(Term::DATUM);
+        transfer(json, t, &Term::mutable_datum);
+        break;
+    default:
+        unreachable();
+    }
 }
 
 template<>
-void extract(cJSON *json, Query *q) {
-    // It's ok to use the slow functions here, because the indexes are small
-    transfer(cJSON_slow_GetArrayItem(json, 0), q, &Query::set_type);
-    transfer(cJSON_slow_GetArrayItem(json, 1), q, &Query::mutable_query);
+void extract(json_reader_t *json, Query *q) {
+    if (json->peek() != json_value_type_t::ARRAY) throw exc_t();
+    json->begin_array();
+    if (json->next_element()) {
+        transfer(json, q, &Query::set_type);
+        if (json->next_element()) {
+            transfer(json, q, &Query::mutable_query);
+            if (json->next_element()) {
+                transfer_arr(json, q, &Query::add_global_optargs);
+                skip_rest_of_array(json);
+            }
+        }
+    }
     q->set_accepts_r_json(true);
-    transfer_arr(cJSON_slow_GetArrayItem(json, 2), q, &Query::add_global_optargs);
 }
 
-bool parse_json_pb(Query *q, int64_t token, const char *str) THROWS_NOTHING {
+bool parse_json_pb(Query *q, int64_t token, const char *str, size_t size) THROWS_NOTHING {
     try {
         q->Clear();
         q->set_token(token);
-        scoped_cJSON_t json_holder(cJSON_Parse(str));
-        cJSON *json = json_holder.get();
-        if (json == NULL) return false;
-        extract(json, q);
+        json_reader_t json(str, size);
+        extract(&json, q);
+        json.finish();
         return true;
+    } catch (const json_reader_exc_t &) {
+        return false;
     } catch (const exc_t &) {
         // This happens if the user provides bad JSON.  TODO: Give the user a
         // more specific error than "malformed query".
@@ -203,24 +245,50 @@ bool parse_json_pb(Query *q, int64_t token, const char *str) THROWS_NOTHING {
 }
 
 void write_json_pb(const Response &r, std::string *s) THROWS_NOTHING {
+    std::deque<std::string> storage;
+    const_buffer_group_t pieces;
+    write_json_pb_pieces(r, &storage, &pieces);
+    s->reserve(s->size() + pieces.get_size());
+    for (size_t i = 0; i < pieces.num_buffers(); ++i) {
+        const_buffer_group_t::buffer_t b = pieces.get_buffer(i);
+        s->append(static_cast<const char *>(b.data), b.size);
+    }
+}
+
+void write_json_pb_pieces(const Response &r,
+                          std::deque<std::string> *storage_out,
+                          const_buffer_group_t *pieces_out) THROWS_NOTHING {
+    // Adds a piece that we have to keep around ourselves.
+    auto add_owned = [&](std::string &&str) {
+        storage_out->push_back(std::move(str));
+        pieces_out->add_buffer(storage_out->back().size(), storage_out->back().data());
+    };
+    // Adds a piece that lives in `r` (or is a literal).
+    auto add_ref = [&](const char *data, size_t size) {
+        pieces_out->add_buffer(size, data);
+    };
+    rassert(storage_out->empty() && pieces_out->num_buffers() == 0);
+
     try {
-        *s += strprintf("{\"t\":%d,\"r\":[", r.type());
+        add_owned(strprintf("{\"t\":%d,\"r\":[", r.type()));
         for (int i = 0; i < r.response_size(); ++i) {
-            *s += (i == 0) ? "" : ",";
+            if (i != 0) {
+                add_ref(",", 1);
+            }
             const Datum *d = &r.response(i);
             if (d->type() == Datum::R_JSON) {
-                *s += d->r_str();
+                add_ref(d->r_str().data(), d->r_str().size());
             } else if (d->type() == Datum::R_STR) {
                 scoped_cJSON_t tmp(cJSON_CreateString(d->r_str().c_str()));
-                *s += tmp.PrintUnformatted();
+                add_owned(tmp.PrintUnformatted());
             } else {
                 unreachable();
             }
         }
-        *s += "]";
+        add_ref("]", 1);
 
         if (r.has_backtrace()) {
-            *s += ",\"b\":";
+            add_ref(",\"b\":", 5);
             const Backtrace *bt = &r.backtrace();
             scoped_cJSON_t arr(cJSON_CreateArray());
             for (int i = 0; i < bt->frames_size(); ++i) {
@@ -236,24 +304,26 @@ void write_json_pb(const Response &r, std::string *s) THROWS_NOTHING {
                     unreachable();
                 }
             }
-            *s += arr.PrintUnformatted();
+            add_owned(arr.PrintUnformatted());
         }
 
         if (r.has_profile()) {
-            *s += ",\"p\":";
+            add_ref(",\"p\":", 5);
             const Datum *d = &r.profile();
             guarantee(d->type() == Datum::R_JSON);
-            *s += d->r_str();
+            add_ref(d->r_str().data(), d->r_str().size());
         }
 
-        *s += "}";
+        add_ref("}", 1);
     } catch (...) {
 #ifndef NDEBUG
         throw;
 #else
-        *s = strprintf("{\"t\":%d,\"r\":[\"%s\"]}",
-                       Response::RUNTIME_ERROR,
-                       "Internal error in `write_json_pb`, please report this.");
+        pieces_out->clear();
+        storage_out->clear();
+        add_owned(strprintf("{\"t\":%d,\"r\":[\"%s\"]}",
+                            Response::RUNTIME_ERROR,
+                            "Internal error in `write_json_pb`, please report this."));
 #endif // NDEBUG
     }
 }
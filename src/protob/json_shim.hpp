@@ -1,18 +1,31 @@
 #ifndef PROTOB_JSON_SHIM_HPP_
 #define PROTOB_JSON_SHIM_HPP_
 
+#include <deque>
 #include <string>
 
 #include "utils.hpp"
 
 class Query;
 class Response;
+class const_buffer_group_t;
 template<class T>
 class scoped_array_t;
 
 namespace json_shim {
-MUST_USE bool parse_json_pb(Query *q, int64_t token, const char *str) THROWS_NOTHING;
+// Parses the `size` bytes of JSON at `str`, which don't need to be NUL-terminated.
+MUST_USE bool parse_json_pb(Query *q, int64_t token, const char *str,
+                            size_t size) THROWS_NOTHING;
 void write_json_pb(const Response &r, std::string *out) THROWS_NOTHING;
+
+/* Like `write_json_pb()`, but instead of building one string, puts the pieces of
+the encoding into `pieces_out`, which must be empty, so that they can be sent without copying them
+together first. Most of the pieces point into `r`; the strings that have to be
+generated are kept in `storage_out`. Both `r` and `storage_out` must outlive
+`pieces_out`. */
+void write_json_pb_pieces(const Response &r,
+                          std::deque<std::string> *storage_out,
+                          const_buffer_group_t *pieces_out) THROWS_NOTHING;
 }  // namespace json_shim
 
 #endif // PROTOB_JSON_SHIM_HPP_
@@ -1,8 +1,13 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "protob/protob.hpp"
 
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 #include <google/protobuf/stubs/common.h>
 
+#include <deque>
+#include <exception>
+#include <map>
 #include <set>
 #include <string>
 #include <limits>
@@ -14,8 +19,13 @@
 #include "arch/io/network.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/new_mutex.hpp"
+#include "concurrency/new_semaphore.hpp"
+#include "concurrency/interruptor.hpp"
 #include "containers/auth_key.hpp"
+#include "containers/buffer_group.hpp"
 #include "perfmon/perfmon.hpp"
+#include "protob/binary_shim.hpp"
 #include "protob/json_shim.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rpc/semilattice/view.hpp"
@@ -36,11 +46,36 @@ private:
 const uint32_t MAX_QUERY_SIZE = 64 * MEGABYTE;
 const size_t MAX_RESPONSE_SIZE = std::numeric_limits<uint32_t>::max();
 
-class json_protocol_t {
+/* The JSON and the binary protocol both take queries in JSON, they only differ in
+how the responses are encoded. */
+struct json_response_encoding_t {
+    static void prepare_query(UNUSED Query *query) { }
+    static void write_pieces(const Response &response,
+                             std::deque<std::string> *storage_out,
+                             const_buffer_group_t *pieces_out) {
+        json_shim::write_json_pb_pieces(response, storage_out, pieces_out);
+    }
+};
+
+struct binary_response_encoding_t {
+    // Makes the query's results come back already serialized.
+    static void prepare_query(Query *query) {
+        query->set_accepts_r_serialized(true);
+    }
+    static void write_pieces(const Response &response,
+                             std::deque<std::string> *storage_out,
+                             const_buffer_group_t *pieces_out) {
+        binary_shim::write_binary_pb_pieces(response, storage_out, pieces_out);
+    }
+};
+
+template <class response_encoding_t>
+class json_query_protocol_t {
 public:
     static bool parse_query(tcp_conn_t *conn,
                             signal_t *interruptor,
                             query_handler_t *handler,
+                            new_mutex_t *send_mutex,
                             ql::protob_t<Query> *query_out) {
         int64_t token;
         uint32_t size;
@@ -52,20 +87,20 @@ public:
             handler->unparseable_query(token, &error_response,
                                        strprintf("Payload size (%" PRIu32 ") greater than maximum (%" PRIu32 ").",
                                                  size, MAX_QUERY_SIZE));
-            send_response(error_response, handler, conn, interruptor);
+            send_response(error_response, handler, conn, send_mutex, interruptor);
             throw tcp_conn_read_closed_exc_t();
         } else {
-            scoped_array_t<char> data(size + 1);
+            scoped_array_t<char> data(size);
             conn->read(data.data(), size, interruptor);
-            data[size] = 0; // Null terminate the string, which the json parser requires
 
-            if (!json_shim::parse_json_pb(query_out->get(), token, data.data())) {
+            if (!json_shim::parse_json_pb(query_out->get(), token, data.data(), size)) {
                 Response error_response;
                 handler->unparseable_query(token, &error_response,
                                            "Client is buggy (failed to deserialize query).");
-                send_response(error_response, handler, conn, interruptor);
+                send_response(error_response, handler, conn, send_mutex, interruptor);
                 return false;
             }
+            response_encoding_t::prepare_query(query_out->get());
         }
         return true;
     }
@@ -73,26 +108,79 @@ public:
     static void send_response(const Response &response,
                               query_handler_t *handler,
                               tcp_conn_t *conn,
+                              new_mutex_t *send_mutex,
                               signal_t *interruptor) {
+        // Several queries on the connection may be done at the same time, so
+        // `send_mutex` keeps their responses from getting interleaved.
+        new_mutex_in_line_t send_in_line(send_mutex);
+        send_in_line.acq_signal()->wait();
+        write_response(response, handler, conn, interruptor);
+    }
+
+private:
+    static void write_response(const Response &response,
+                               query_handler_t *handler,
+                               tcp_conn_t *conn,
+                               signal_t *interruptor) {
         int64_t token = response.token();
         uint32_t size;
-        std::string str;
 
-        json_shim::write_json_pb(response, &str);
-        if (str.size() > MAX_RESPONSE_SIZE) {
+        /* The datums are already serialized in `response`, so instead of copying
+        them into one string, we send the pieces of the encoding with a single
+        vectored write. */
+        std::deque<std::string> storage;
+        const_buffer_group_t pieces;
+        response_encoding_t::write_pieces(response, &storage, &pieces);
+        if (pieces.get_size() > MAX_RESPONSE_SIZE) {
             Response error_response;
             handler->unparseable_query(token, &error_response,
                 strprintf("Response size (%zu) is greater than maximum (%zu).",
-                          str.size(), MAX_RESPONSE_SIZE));
-            send_response(error_response, handler, conn, interruptor);
+                          pieces.get_size(), MAX_RESPONSE_SIZE));
+            write_response(error_response, handler, conn, interruptor);
             return;
         }
-        size = str.size();
+        size = pieces.get_size();
+
+        const_buffer_group_t message;
+        message.add_buffer(sizeof(token), &token);
+        message.add_buffer(sizeof(size), &size);
+        for (size_t i = 0; i < pieces.num_buffers(); ++i) {
+            const_buffer_group_t::buffer_t b = pieces.get_buffer(i);
+            message.add_buffer(b.size, b.data);
+        }
+        conn->write(&message, interruptor);
+    }
+};
 
-        conn->write(&token, sizeof(token), interruptor);
-        conn->write(&size, sizeof(size), interruptor);
-        conn->write(str.data(), size, interruptor);
+typedef json_query_protocol_t<json_response_encoding_t> json_protocol_t;
+typedef json_query_protocol_t<binary_response_encoding_t> binary_protocol_t;
+
+/* Feeds the output of protobuf serialization into the connection's write buffers,
+which block once enough data is queued up for the socket. */
+class tcp_conn_output_stream_t : public google::protobuf::io::CopyingOutputStream {
+public:
+    tcp_conn_output_stream_t(tcp_conn_t *_conn, signal_t *_interruptor)
+        : conn(_conn), interruptor(_interruptor), write_closed(false) { }
+
+    bool Write(const void *buffer, int size) {
+        // We don't let exceptions unwind through protobuf.
+        try {
+            conn->write_buffered(buffer, size, interruptor);
+            return true;
+        } catch (const tcp_conn_write_closed_exc_t &) {
+            write_closed = true;
+            return false;
+        }
     }
+
+    bool is_write_closed() const { return write_closed; }
+
+private:
+    tcp_conn_t *conn;
+    signal_t *interruptor;
+    bool write_closed;
+
+    DISABLE_COPYING(tcp_conn_output_stream_t);
 };
 
 class protobuf_protocol_t {
@@ -100,6 +188,7 @@ public:
     static bool parse_query(tcp_conn_t *conn,
                             signal_t *interruptor,
                             query_handler_t *handler,
+                            new_mutex_t *send_mutex,
                             ql::protob_t<Query> *query_out) {
         uint32_t size;
         conn->read(&size, sizeof(size), interruptor);
@@ -109,7 +198,7 @@ public:
             handler->unparseable_query(0, &error_response,
                                        strprintf("Payload size (%" PRIu32 ") greater than maximum (%" PRIu32 ").",
                                                  size, MAX_QUERY_SIZE));
-            send_response(error_response, handler, conn, interruptor);
+            send_response(error_response, handler, conn, send_mutex, interruptor);
             return false;
         } else {
             scoped_array_t<char> data(size);
@@ -120,7 +209,7 @@ public:
                 int64_t token = query_out->get()->has_token() ? query_out->get()->token() : 0;
                 handler->unparseable_query(token, &error_response,
                                            "Client is buggy (failed to deserialize query).");
-                send_response(error_response, handler, conn, interruptor);
+                send_response(error_response, handler, conn, send_mutex, interruptor);
                 return false;
             }
         }
@@ -130,9 +219,18 @@ public:
     static void send_response(const Response &response,
                               query_handler_t *handler,
                               tcp_conn_t *conn,
+                              new_mutex_t *send_mutex,
                               signal_t *interruptor) {
-        scoped_array_t<char> scoped_array;
-        const char *data;
+        new_mutex_in_line_t send_in_line(send_mutex);
+        send_in_line.acq_signal()->wait();
+        write_response(response, handler, conn, interruptor);
+    }
+
+private:
+    static void write_response(const Response &response,
+                               query_handler_t *handler,
+                               tcp_conn_t *conn,
+                               signal_t *interruptor) {
         uint32_t size;
 
         if (static_cast<uint64_t>(response.ByteSize()) > MAX_RESPONSE_SIZE) {
@@ -140,21 +238,35 @@ public:
             handler->unparseable_query(response.token(), &error_response,
                 strprintf("Response size (%d) is greater than maximum (%zu).",
                           response.ByteSize(), MAX_RESPONSE_SIZE));
-            send_response(error_response, handler, conn, interruptor);
+            write_response(error_response, handler, conn, interruptor);
             return;
         }
         size = response.ByteSize();
-        scoped_array.init(size);
-        response.SerializeToArray(scoped_array.data(), size);
-        data = scoped_array.data();
-        conn->write(&size, sizeof(size), interruptor);
-        conn->write(data, size, interruptor);
+        conn->write_buffered(&size, sizeof(size), interruptor);
+
+        /* Serialize straight into the connection's write buffers instead of
+        building the whole message in memory first. `ByteSize()` above has cached
+        the sizes of all submessages. */
+        tcp_conn_output_stream_t stream(conn, interruptor);
+        {
+            google::protobuf::io::CopyingOutputStreamAdaptor adaptor(&stream);
+            {
+                google::protobuf::io::CodedOutputStream coded(&adaptor);
+                response.SerializeWithCachedSizes(&coded);
+            }
+            adaptor.Flush();
+        }
+        if (stream.is_write_closed()) {
+            throw tcp_conn_write_closed_exc_t();
+        }
+        conn->flush_buffer(interruptor);
     }
 };
 
 query_server_t::query_server_t(rdb_context_t *_rdb_ctx,
                                const std::set<ip_address_t> &local_addresses,
                                int port,
+                               accept_sharding_t accept_sharding,
                                query_handler_t *_handler,
                                boost::shared_ptr<semilattice_readwrite_view_t<auth_semilattice_metadata_t> > _auth_metadata) :
         rdb_ctx(_rdb_ctx),
@@ -174,7 +286,8 @@ query_server_t::query_server_t(rdb_context_t *_rdb_ctx,
     try {
         tcp_listener.init(new tcp_listener_t(local_addresses, port,
             std::bind(&query_server_t::handle_conn,
-                      this, ph::_1, auto_drainer_t::lock_t(&auto_drainer))));
+                      this, ph::_1, auto_drainer_t::lock_t(&auto_drainer)),
+            accept_sharding));
     } catch (const address_in_use_exc_t &ex) {
         throw address_in_use_exc_t(strprintf("Could not bind to RDB protocol port: %s", ex.what()));
     }
@@ -275,6 +388,8 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
 
         if (wire_protocol == VersionDummy::JSON) {
             connection_loop<json_protocol_t>(conn.get(), &client_ctx);
+        } else if (wire_protocol == VersionDummy::BINARY) {
+            connection_loop<binary_protocol_t>(conn.get(), &client_ctx);
         } else if (wire_protocol == VersionDummy::PROTOBUF) {
             connection_loop<protobuf_protocol_t>(conn.get(), &client_ctx);
         } else {
@@ -300,6 +415,54 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
     }
 }
 
+/* Per-connection state for running the queries that come in over one connection
+concurrently. Responses are sent as soon as their query is done, so they can go out
+in a different order than the queries came in; clients match them up by token. */
+class query_pipeline_t {
+public:
+    query_pipeline_t()
+        : concurrent_queries(MAX_CONCURRENT_QUERIES_PER_CONNECTION),
+          write_closed(false) { }
+
+    // Queries on the same token (a `START` and the `CONTINUE`s or the `STOP` for
+    // it) still run one after the other, in the order they came in, because they
+    // share the token's entry in the stream cache.
+    struct token_queue_t {
+        token_queue_t() : num_queries(0) { }
+        new_mutex_t mutex;
+        int64_t num_queries;
+    };
+
+    token_queue_t *enter_token(int64_t token) {
+        scoped_ptr_t<token_queue_t> *queue = &tokens[token];
+        if (!queue->has()) {
+            queue->init(new token_queue_t);
+        }
+        ++(*queue)->num_queries;
+        return queue->get();
+    }
+
+    void exit_token(int64_t token, token_queue_t *queue) {
+        rassert(tokens[token].get() == queue);
+        if (--queue->num_queries == 0) {
+            tokens.erase(token);
+        }
+    }
+
+    new_semaphore_t concurrent_queries;
+    new_mutex_t send_mutex;
+    std::map<int64_t, scoped_ptr_t<token_queue_t> > tokens;
+
+    // Set when sending a response failed, so the reading loop can stop.
+    bool write_closed;
+
+    // Destroyed first, so no query is still running when the rest goes away.
+    auto_drainer_t drainer;
+
+private:
+    DISABLE_COPYING(query_pipeline_t);
+};
+
 template <class protocol_t>
 void query_server_t::connection_loop(tcp_conn_t *conn,
                                      client_context_t *client_ctx) {
@@ -307,17 +470,82 @@ void query_server_t::connection_loop(tcp_conn_t *conn,
 
     ip_and_port_t peer;
     if (conn->getpeername(&peer)) {
-        for (;;) {
-            ql::protob_t<Query> query(ql::make_counted_query());
-
-            if (protocol_t::parse_query(conn, client_ctx->interruptor, handler, &query)) {
-                Response response;
-                if (handler->run_query(query, &response, client_ctx, peer)) {
-                    protocol_t::send_response(
-                        response, handler, conn, client_ctx->interruptor);
+        std::exception_ptr exc;
+        {
+            query_pipeline_t pipeline;
+            try {
+                for (;;) {
+                    ql::protob_t<Query> query(ql::make_counted_query());
+
+                    if (protocol_t::parse_query(conn, client_ctx->interruptor, handler,
+                                                &pipeline.send_mutex, &query)) {
+                        // `NOREPLY_WAIT` must only be answered once all the queries
+                        // that came in before it are done, so it takes up the whole
+                        // pipeline. The semaphore is FIFO, which also holds back the
+                        // queries that come in after it.
+                        new_semaphore_acq_t acq(
+                            &pipeline.concurrent_queries,
+                            query->type() == Query::NOREPLY_WAIT
+                                ? MAX_CONCURRENT_QUERIES_PER_CONNECTION
+                                : 1);
+                        wait_interruptible(acq.acquisition_signal(),
+                                           client_ctx->interruptor);
+                        if (pipeline.write_closed) {
+                            throw tcp_conn_write_closed_exc_t();
+                        }
+                        // Takes over `acq` before it returns.
+                        coro_t::spawn_now_dangerously(std::bind(
+                            &query_server_t::run_pipelined_query<protocol_t>, this,
+                            &pipeline, query, &acq, conn, client_ctx, peer,
+                            auto_drainer_t::lock_t(&pipeline.drainer)));
+                    }
                 }
+            } catch (const tcp_conn_read_closed_exc_t &) {
+                exc = std::current_exception();
+            } catch (const tcp_conn_write_closed_exc_t &) {
+                exc = std::current_exception();
+            } catch (const interrupted_exc_t &) {
+                // This is what `conn->read()` would have thrown.
+                exc = std::make_exception_ptr(tcp_conn_read_closed_exc_t());
             }
+            // We can't wait for the running queries in the `catch` statement, since
+            // that switches coroutines.
         }
+        std::rethrow_exception(exc);
+    }
+}
+
+template <class protocol_t>
+void query_server_t::run_pipelined_query(query_pipeline_t *pipeline,
+                                         const ql::protob_t<Query> &query,
+                                         new_semaphore_acq_t *pipeline_acq,
+                                         tcp_conn_t *conn,
+                                         client_context_t *client_ctx,
+                                         const ip_and_port_t &peer,
+                                         auto_drainer_t::lock_t) {
+    new_semaphore_acq_t acq(std::move(*pipeline_acq));
+    const int64_t token = query->token();
+    query_pipeline_t::token_queue_t *queue = pipeline->enter_token(token);
+    try {
+        new_mutex_in_line_t token_in_line(&queue->mutex);
+        wait_interruptible(token_in_line.acq_signal(), client_ctx->interruptor);
+
+        Response response;
+        if (handler->run_query(query, &response, client_ctx, peer)) {
+            protocol_t::send_response(response, handler, conn, &pipeline->send_mutex,
+                                      client_ctx->interruptor);
+        }
+    } catch (const interrupted_exc_t &) {
+        // The connection is going away.
+    } catch (const tcp_conn_write_closed_exc_t &) {
+        pipeline->write_closed = true;
+    }
+    pipeline->exit_token(token, queue);
+
+    if (pipeline->write_closed && conn->is_read_open()) {
+        // Wakes up the reading loop, which is otherwise still waiting for the
+        // client's next query.
+        conn->shutdown_read();
     }
 }
 
@@ -413,7 +641,8 @@ void query_server_t::handle(const http_req_t &req,
     data += sizeof(token);
 
     const bool parse_succeeded =
-        json_shim::parse_json_pb(query.get(), token, data);
+        json_shim::parse_json_pb(query.get(), token, data,
+                                 req.body.size() - sizeof(token));
 
     if (!parse_succeeded) {
         handler->unparseable_query(token, &response,
@@ -19,11 +19,14 @@
 #include "containers/archive/archive.hpp"
 #include "http/http.hpp"
 
+#include "rdb_protocol/prepared_queries.hpp"
 #include "rdb_protocol/stream_cache.hpp"
 #include "rdb_protocol/counted_term.hpp"
 
 class auth_key_t;
 class auth_semilattice_metadata_t;
+class new_semaphore_acq_t;
+class query_pipeline_t;
 template <class> class semilattice_readwrite_view_t;
 
 class client_context_t {
@@ -36,6 +39,7 @@ public:
     // Holy shit, this field gets MODIFIED!
     signal_t *interruptor;
     ql::stream_cache_t stream_cache;
+    ql::prepared_queries_t prepared_queries;
 };
 
 class http_conn_cache_t : public repeating_timer_callback_t {
@@ -147,6 +151,7 @@ public:
     query_server_t(rdb_context_t *rdb_ctx,
                    const std::set<ip_address_t> &local_addresses,
                    int port,
+                   accept_sharding_t accept_sharding,
                    query_handler_t *_handler,
                    boost::shared_ptr<semilattice_readwrite_view_t<auth_semilattice_metadata_t> > _auth_metadata);
     ~query_server_t();
@@ -169,6 +174,17 @@ private:
     void connection_loop(tcp_conn_t *conn,
                          client_context_t *client_ctx);
 
+    // Runs one of the queries that `connection_loop` read off the connection and
+    // sends the response. Several of these can run at the same time.
+    template<class protocol_t>
+    void run_pipelined_query(query_pipeline_t *pipeline,
+                             const ql::protob_t<Query> &query,
+                             new_semaphore_acq_t *pipeline_acq,
+                             tcp_conn_t *conn,
+                             client_context_t *client_ctx,
+                             const ip_and_port_t &peer,
+                             auto_drainer_t::lock_t);
+
     // For HTTP server
     void handle(const http_req_t &request,
                 http_res_t *result,
@@ -24,6 +24,7 @@
 #include "version.hpp"
 
 struct backfill_chunk_t;
+struct backfill_digests_t;
 struct read_t;
 struct read_response_t;
 class store_t;
@@ -153,6 +154,10 @@ public:
         return should_backfill_impl(metainfo);
     }
 
+    /* The backfillee's digests of its rows, if it sent any.  The ranges whose
+    digests match the backfiller's don't get backfilled. */
+    virtual const backfill_digests_t *get_backfill_digests() { return NULL; }
+
 protected:
     virtual bool should_backfill_impl(const region_map_t<binary_blob_t> &metainfo) = 0;
 
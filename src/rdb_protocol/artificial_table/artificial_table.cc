@@ -55,6 +55,16 @@ ql::datum_t artificial_table_t::read_row(ql::env_t *env,
     return row;
 }
 
+std::vector<ql::datum_t> artificial_table_t::read_rows(ql::env_t *env,
+        const std::vector<ql::datum_t> &pvals, bool use_outdated) {
+    std::vector<ql::datum_t> rows;
+    rows.reserve(pvals.size());
+    for (const ql::datum_t &pval : pvals) {
+        rows.push_back(read_row(env, pval, use_outdated));
+    }
+    return rows;
+}
+
 counted_t<ql::datum_stream_t> artificial_table_t::read_all(
         ql::env_t *env,
         const std::string &get_all_sindex_id,
@@ -81,9 +91,13 @@ counted_t<ql::datum_stream_t> artificial_table_t::read_all(
 counted_t<ql::datum_stream_t> artificial_table_t::read_changes(
         ql::env_t *env,
         const ql::datum_t &,
+        bool,
+        const ql::datum_t &resume_from,
         ql::changefeed::keyspec_t::spec_t &&spec,
         const ql::protob_t<const Backtrace> &bt,
         UNUSED const std::string &table_name) {
+    rcheck_datum(!resume_from.has(), ql::base_exc_t::GENERIC,
+                 "Cannot resume changefeeds on system tables.");
     counted_t<ql::datum_stream_t> stream;
     std::string error;
     if (!backend->read_changes(bt, std::move(spec), env->interruptor, &stream, &error)) {
@@ -203,10 +217,18 @@ bool artificial_table_t::write_sync_depending_on_durability(
         "Artificial tables don't support `sync()`.");
 }
 
+bool artificial_table_t::write_truncate(
+        UNUSED ql::env_t *env,
+        UNUSED durability_requirement_t durability) {
+    rfail_datum(ql::base_exc_t::GENERIC,
+        "Artificial tables don't support `truncate()`.");
+}
+
 bool artificial_table_t::sindex_create(
         UNUSED ql::env_t *env, UNUSED const std::string &id,
         UNUSED counted_t<const ql::func_t> index_func, UNUSED sindex_multi_bool_t multi,
-        UNUSED sindex_geo_bool_t geo) {
+        UNUSED sindex_geo_bool_t geo, UNUSED const std::vector<std::string> &covering,
+        UNUSED counted_t<const ql::func_t> filter) {
     rfail_datum(ql::base_exc_t::GENERIC,
         "Can't create a secondary index on an artificial table.");
 }
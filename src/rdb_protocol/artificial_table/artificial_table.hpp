@@ -27,6 +27,8 @@ public:
 
     ql::datum_t read_row(ql::env_t *env,
         ql::datum_t pval, bool use_outdated);
+    std::vector<ql::datum_t> read_rows(ql::env_t *env,
+        const std::vector<ql::datum_t> &pvals, bool use_outdated);
     counted_t<ql::datum_stream_t> read_all(
         ql::env_t *env,
         const std::string &get_all_sindex_id,
@@ -38,6 +40,8 @@ public:
     counted_t<ql::datum_stream_t> read_changes(
         ql::env_t *env,
         const ql::datum_t &, // TODO: implement squash
+        bool, // Artificial tables' changefeeds don't spill to disk.
+        const ql::datum_t &resume_from,
         ql::changefeed::keyspec_t::spec_t &&spec,
         const ql::protob_t<const Backtrace> &bt,
         const std::string &table_name);
@@ -71,10 +75,12 @@ public:
         durability_requirement_t durability);
     bool write_sync_depending_on_durability(ql::env_t *env,
         durability_requirement_t durability);
+    bool write_truncate(ql::env_t *env, durability_requirement_t durability);
 
     bool sindex_create(ql::env_t *env, const std::string &id,
         counted_t<const ql::func_t> index_func, sindex_multi_bool_t multi,
-        sindex_geo_bool_t geo);
+        sindex_geo_bool_t geo, const std::vector<std::string> &covering,
+        counted_t<const ql::func_t> filter);
     bool sindex_drop(ql::env_t *env, const std::string &id);
     sindex_rename_result_t sindex_rename(ql::env_t *env,
         const std::string &old_name, const std::string &new_name, bool overwrite);
@@ -15,7 +15,16 @@ bool artificial_table_backend_t::read_all_rows_as_stream(
     if (!read_all_rows_as_vector(interruptor, &rows, error_out)) {
         return false;
     }
+    rows_to_stream(bt, range, sorting, std::move(rows), rows_out);
+    return true;
+}
 
+void artificial_table_backend_t::rows_to_stream(
+        const ql::protob_t<const Backtrace> &bt,
+        const ql::datum_range_t &range,
+        sorting_t sorting,
+        std::vector<ql::datum_t> &&rows,
+        counted_t<ql::datum_stream_t> *rows_out) {
     std::string primary_key = get_primary_key_name();
 
     /* Apply range filter */
@@ -63,7 +72,6 @@ bool artificial_table_backend_t::read_all_rows_as_stream(
 
     *rows_out = make_counted<ql::vector_datum_stream_t>(
         bt, std::move(rows), std::move(keyspec));
-    return true;
 }
 
 bool artificial_table_backend_t::read_all_rows_as_vector(
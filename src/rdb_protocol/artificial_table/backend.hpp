@@ -82,6 +82,15 @@ public:
 
 protected:
     virtual ~artificial_table_backend_t() { }
+
+    /* Does the filtering and sorting for the default `read_all_rows_as_stream()`, and
+    wraps the result in a stream. */
+    void rows_to_stream(
+        const ql::protob_t<const Backtrace> &bt,
+        const ql::datum_range_t &range,
+        sorting_t sorting,
+        std::vector<ql::datum_t> &&rows,
+        counted_t<ql::datum_stream_t> *rows_out);
 };
 
 #endif /* RDB_PROTOCOL_ARTIFICIAL_TABLE_BACKEND_HPP_ */
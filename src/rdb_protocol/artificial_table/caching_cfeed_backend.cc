@@ -1,11 +1,57 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/artificial_table/caching_cfeed_backend.hpp"
 
+#include "concurrency/cross_thread_signal.hpp"
 #include "rdb_protocol/env.hpp"
 
+/* While reads are served from the machinery, it reloads the whole table at least this
+often, in case a notification was missed. */
+static const int cached_read_max_age_secs = 10;
+
 caching_cfeed_artificial_table_backend_t::caching_cfeed_artificial_table_backend_t() :
     caching_machinery(nullptr) { }
 
+bool caching_cfeed_artificial_table_backend_t::read_all_rows_as_stream(
+        const ql::protob_t<const Backtrace> &bt,
+        const ql::datum_range_t &range,
+        sorting_t sorting,
+        signal_t *interruptor,
+        counted_t<ql::datum_stream_t> *rows_out,
+        std::string *error_out) {
+    if (notifications_are_complete()) {
+        std::vector<ql::datum_t> rows;
+        if (read_all_rows_from_cache(interruptor, &rows)) {
+            rows_to_stream(bt, range, sorting, std::move(rows), rows_out);
+            return true;
+        }
+    }
+    return cfeed_artificial_table_backend_t::read_all_rows_as_stream(
+        bt, range, sorting, interruptor, rows_out, error_out);
+}
+
+bool caching_cfeed_artificial_table_backend_t::read_all_rows_from_cache(
+        signal_t *interruptor,
+        std::vector<ql::datum_t> *rows_out) {
+    cross_thread_signal_t interruptor2(interruptor, home_thread());
+    on_thread_t thread_switcher(home_thread());
+    /* The first read only starts the machinery; the reads after it are served from
+    the machinery once it's loaded the table. */
+    keep_changefeed_machinery();
+    if (caching_machinery == nullptr || !caching_machinery->is_up_to_date()) {
+        return false;
+    }
+    if (caching_machinery->last_full_load + cached_read_max_age_secs * MILLION <
+            current_microtime()) {
+        notify_all();
+        return false;
+    }
+    rows_out->reserve(caching_machinery->old_values.size());
+    for (const auto &pair : caching_machinery->old_values) {
+        rows_out->push_back(pair.second);
+    }
+    return true;
+}
+
 void caching_cfeed_artificial_table_backend_t::notify_row(const ql::datum_t &pkey) {
     ASSERT_FINITE_CORO_WAITING;
     if (caching_machinery != nullptr) {
@@ -50,6 +96,8 @@ void caching_cfeed_artificial_table_backend_t::notify_break() {
 caching_cfeed_artificial_table_backend_t::caching_machinery_t::caching_machinery_t(
             caching_cfeed_artificial_table_backend_t *_parent) :
         parent(_parent),
+        processing(false),
+        last_full_load(0),
         /* Set `dirtiness` to force us to load initial values. Either `dirtiness_t::all`
         or `dirtiness_t::all_stop` would work equally well here since we don't have any
         subscribers yet, but `all_stop` saves us a few CPU cycles by not diffing the old
@@ -75,6 +123,7 @@ void caching_cfeed_artificial_table_backend_t::caching_machinery_t::run(
             /* Copy the dirtiness flags into local variables and reset them. Resetting
             them now is important because it means that notifications that arrive while
             we're processing the current batch will be queued up instead of ignored. */
+            processing = true;
             std::set<ql::datum_t, latest_version_optional_datum_less_t> local_dirty_keys;
             dirtiness_t local_dirtiness = dirtiness_t::none_or_some;
             std::swap(dirty_keys, local_dirty_keys);
@@ -101,6 +150,7 @@ void caching_cfeed_artificial_table_backend_t::caching_machinery_t::run(
                 }
             }
 
+            processing = false;
             if (error) {
                 /* Kick off any subscribers since we got an error. */
                 send_all_stop();
@@ -194,6 +244,7 @@ bool caching_cfeed_artificial_table_backend_t::caching_machinery_t::diff_all(
         }
     }
     old_values = std::move(new_values);
+    last_full_load = current_microtime();
     return true;
 }
 
@@ -202,7 +253,9 @@ bool caching_cfeed_artificial_table_backend_t::caching_machinery_t::get_values(
     out->clear();
     std::string error;
     counted_t<ql::datum_stream_t> stream;
-    if (!parent->read_all_rows_as_stream(
+    /* This skips our own `read_all_rows_as_stream()`, which would try to answer from
+    `old_values`. */
+    if (!parent->cfeed_artificial_table_backend_t::read_all_rows_as_stream(
             ql::protob_t<const Backtrace>(),
             ql::datum_range_t::universe(),
             sorting_t::UNORDERED,
@@ -233,12 +286,24 @@ bool caching_cfeed_artificial_table_backend_t::caching_machinery_t::get_values(
     return true;
 }
 
+void caching_cfeed_artificial_table_backend_t::caching_machinery_t::wait_until_ready(
+        signal_t *interruptor) {
+    wait_interruptible(&ready, interruptor);
+}
+
+bool caching_cfeed_artificial_table_backend_t::caching_machinery_t::is_up_to_date()
+        const {
+    return ready.is_pulsed() && !processing
+        && dirtiness == dirtiness_t::none_or_some && dirty_keys.empty();
+}
+
 scoped_ptr_t<cfeed_artificial_table_backend_t::machinery_t>
         caching_cfeed_artificial_table_backend_t::
-            construct_changefeed_machinery(signal_t *interruptor) {
-    scoped_ptr_t<caching_machinery_t> m(new caching_machinery_t(this));
-    wait_interruptible(&m->ready, interruptor);
-    return scoped_ptr_t<cfeed_artificial_table_backend_t::machinery_t>(m.release());
+            construct_changefeed_machinery(UNUSED signal_t *interruptor) {
+    /* `read_changes()` waits for the initial values through `wait_until_ready()`, so
+    that `keep_changefeed_machinery()` can construct us without waiting. */
+    return scoped_ptr_t<cfeed_artificial_table_backend_t::machinery_t>(
+        new caching_machinery_t(this));
 }
 
 void timer_cfeed_artificial_table_backend_t::set_notifications(bool notify) {
@@ -7,13 +7,33 @@
 /* `caching_cfeed_artificial_table_backend_t` is a mixin for artificial table backends
 that implements change-feeds by storing a copy of all the rows in the table. It relies on
 its subclass to notify it when a row has changed; then it fetches the new value of the
-row, compares it to the old value, and sends a notification if necessary. */
+row, compares it to the old value, and sends a notification if necessary.
+
+Subclasses can also have full-table reads answered from that copy of the table; see
+`notifications_are_complete()`. */
 
 class caching_cfeed_artificial_table_backend_t :
     public cfeed_artificial_table_backend_t {
+public:
+    bool read_all_rows_as_stream(
+        const ql::protob_t<const Backtrace> &bt,
+        const ql::datum_range_t &range,
+        sorting_t sorting,
+        signal_t *interruptor,
+        counted_t<ql::datum_stream_t> *rows_out,
+        std::string *error_out);
+
 protected:
     caching_cfeed_artificial_table_backend_t();
 
+    /* Subclasses whose rows never change without a call to `notify_*()` can return
+    `true`. Reads of the whole table then keep the changefeed machinery running even
+    if there are no changefeeds, and are answered from its copy of the table while
+    nothing is dirty, instead of computing every row again. To limit the damage if a
+    notification is missed anyway, the copy is reloaded every
+    `cached_read_max_age_secs` while reads are using it. */
+    virtual bool notifications_are_complete() { return false; }
+
     /* The `caching_cfeed_artificial_table_backend_t` calls `set_notifications()` to tell
     the subclass whether it needs notifications or not. The default is no; it will call
     `set_notifications(true)` when the first changefeed is connected, and
@@ -52,12 +72,24 @@ private:
         bool diff_one(const ql::datum_t &key, signal_t *interruptor);
         bool diff_all(bool is_break, signal_t *interruptor);
         bool get_values(signal_t *interruptor, std::map<store_key_t, ql::datum_t> *out);
+        void wait_until_ready(signal_t *interruptor);
+
+        /* Whether `old_values` is the current contents of the table: the initial
+        values have been loaded, and nothing is dirty or being processed. */
+        bool is_up_to_date() const;
 
         caching_cfeed_artificial_table_backend_t *parent;
 
         /* Pulsed when all of the initial values have been fetched. */
         cond_t ready;
 
+        /* True while `run()` is processing notifications, during which `old_values`
+        may be out of date even though nothing is marked as dirty. */
+        bool processing;
+
+        /* When `diff_all()` last loaded the entire table. */
+        microtime_t last_full_load;
+
         /* `old_values` stores the last known value of every key. This is used to fill in
         the `old_val` field on changefeed changes. */
         std::map<store_key_t, ql::datum_t> old_values;
@@ -83,6 +115,11 @@ private:
     scoped_ptr_t<cfeed_artificial_table_backend_t::machinery_t>
         construct_changefeed_machinery(signal_t *interruptor);
 
+    /* Copies the rows from the machinery if it's up to date. Returns `false` if the
+    rows have to be read from the subclass instead. */
+    bool read_all_rows_from_cache(signal_t *interruptor,
+                                  std::vector<ql::datum_t> *rows_out);
+
     caching_machinery_t *caching_machinery;
 };
 
@@ -6,6 +6,9 @@
 /* We destroy the machinery if there have been no changefeeds for this many seconds */
 static const int machinery_expiration_secs = 60;
 
+cfeed_artificial_table_backend_t::machinery_t::machinery_t() :
+    last_subscriber_time(current_microtime()) { }
+
 void cfeed_artificial_table_backend_t::machinery_t::send_all_change(
         const store_key_t &key,
         const ql::datum_t &old_val,
@@ -14,6 +17,7 @@ void cfeed_artificial_table_backend_t::machinery_t::send_all_change(
     change.pkey = key;
     change.old_val = old_val;
     change.new_val = new_val;
+    change.log_position = 0;
     send_all(ql::changefeed::msg_t(change));
 }
 
@@ -30,6 +34,7 @@ void cfeed_artificial_table_backend_t::machinery_t::maybe_remove() {
 
 cfeed_artificial_table_backend_t::cfeed_artificial_table_backend_t() :
     begin_destruction_was_called(false),
+    machinery_requested(false),
     remove_machinery_timer(
         machinery_expiration_secs * THOUSAND,
         [this]() { maybe_remove_machinery(); })
@@ -74,6 +79,7 @@ bool cfeed_artificial_table_backend_t::read_changes(
     if (!machinery.has()) {
         machinery = construct_changefeed_machinery(&interruptor2);
     }
+    machinery->wait_until_ready(&interruptor2);
     /* We construct two `on_thread_t`s for a total of four thread switches. This is
     necessary because we have to call `subscribe()` on the client thread, but we don't
     want to release the lock on the home thread until `subscribe()` returns. */
@@ -94,6 +100,32 @@ void cfeed_artificial_table_backend_t::begin_changefeed_destruction() {
     begin_destruction_was_called = true;
 }
 
+void cfeed_artificial_table_backend_t::keep_changefeed_machinery() {
+    assert_thread();
+    guarantee(!begin_destruction_was_called);
+    if (machinery.has()) {
+        machinery->last_subscriber_time = current_microtime();
+        return;
+    }
+    if (machinery_requested) {
+        return;
+    }
+    machinery_requested = true;
+    auto_drainer_t::lock_t keepalive(&drainer);
+    coro_t::spawn_sometime([this, keepalive   /* important to capture */]() {
+        try {
+            new_mutex_in_line_t mutex_lock(&mutex);
+            wait_interruptible(mutex_lock.acq_signal(), keepalive.get_drain_signal());
+            if (!machinery.has() && !begin_destruction_was_called) {
+                machinery = construct_changefeed_machinery(keepalive.get_drain_signal());
+            }
+        } catch (const interrupted_exc_t &) {
+            /* We're shutting down. */
+        }
+        machinery_requested = false;
+    });
+}
+
 void cfeed_artificial_table_backend_t::maybe_remove_machinery() {
     /* This is called periodically by a repeating timer */
     assert_thread();
@@ -29,8 +29,14 @@ public:
 protected:
     class machinery_t : private ql::changefeed::artificial_t {
     public:
+        machinery_t();
         virtual ~machinery_t() { }
 
+        /* `read_changes()` calls this before subscribing a changefeed. Subclasses
+        whose machinery needs time to start up after it's constructed should wait
+        here. */
+        virtual void wait_until_ready(UNUSED signal_t *interruptor) { }
+
     protected:
         /* Subclasses can use these to send notifications */
         void send_all_change(const store_key_t &key,
@@ -43,8 +49,9 @@ protected:
         /* `ql::changefeed::artificial_t` calls this when the last subscriber
         disconnects. */
         void maybe_remove();
-        /* If we don't have any subscribers, this is the time the last one disconnected.
-        */
+        /* If we don't have any subscribers, this is the time the last one disconnected,
+        the machinery was constructed, or `keep_changefeed_machinery()` was called,
+        whichever is latest. */
         microtime_t last_subscriber_time;
     };
 
@@ -64,11 +71,20 @@ protected:
     because the machinery will probably access subclass-specific member variables. */
     void begin_changefeed_destruction();
 
+    /* Makes sure that the machinery exists and won't be destroyed for another
+    `machinery_expiration_secs`, as if a changefeed had just disconnected. If there is no
+    machinery, this starts constructing it in the background. It doesn't block, and
+    must be called on the home thread. Subclasses use this to keep using the machinery
+    while there are no changefeeds. */
+    void keep_changefeed_machinery();
+
 private:
     void maybe_remove_machinery();
     scoped_ptr_t<machinery_t> machinery;
     new_mutex_t mutex;
     bool begin_destruction_was_called;
+    /* True while `keep_changefeed_machinery()` is constructing the machinery. */
+    bool machinery_requested;
     auto_drainer_t drainer;
     repeating_timer_t remove_machinery_timer;
 };
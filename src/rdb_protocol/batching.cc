@@ -25,6 +25,13 @@ static const int64_t SCALE_CONSTANT = 0;
 #else
 static const int64_t SCALE_CONSTANT = 32;
 #endif // NDEBUG
+// `batch_tuner_t` aims for batches that take this many times as long as the
+// client's turnaround, so that at most a fifth of the time goes to round trips,
+// but it doesn't raise the size limit past `TUNED_MAX_SIZE` for that.
+static const int64_t TUNED_TURNAROUND_FACTOR = 4;
+static const int64_t TUNED_MAX_SIZE = 8 * MEGABYTE;
+// The weight of the newest batch in `batch_tuner_t`'s moving averages.
+static const double TUNED_NEW_WEIGHT = 0.25;
 
 RDB_IMPL_SERIALIZABLE_7_FOR_CLUSTER(batchspec_t,
                                     batch_type,
@@ -126,6 +133,15 @@ batchspec_t batchspec_t::user(batch_type_t batch_type, env_t *env) {
                        current_microtime());
 }
 
+bool batchspec_t::user_set_limits(env_t *env) {
+    datum_t d;
+    return set_if_present("min_batch_rows", env, &d)
+        || set_if_present("max_batch_rows", env, &d)
+        || set_if_present("max_batch_bytes", env, &d)
+        || set_if_present("max_batch_seconds", env, &d)
+        || set_if_present("first_batch_scaledown_factor", env, &d);
+}
+
 batchspec_t batchspec_t::with_new_batch_type(batch_type_t new_batch_type) const {
     return batchspec_t(new_batch_type, min_els, max_els, max_size,
                        first_scaledown_factor, max_dur, start_time);
@@ -217,6 +233,59 @@ batcher_t batchspec_t::to_batcher() const {
     return batcher_t(batch_type, real_min_els, real_max_els, real_max_size, end_time);
 }
 
+batch_tuner_t::batch_tuner_t()
+    : has_rows(false), has_gap(false), row_size(0), row_duration(0), gap(0),
+      last_end(0) { }
+
+batchspec_t batch_tuner_t::tune(const batchspec_t &bs) const {
+    if (!has_rows || row_size <= 0) {
+        return bs;
+    }
+    int64_t min_els = bs.min_els;
+    int64_t max_size = bs.max_size;
+    if (has_gap && row_duration > 0) {
+        // If the size limit would end the batch well before it took long enough to
+        // make up for the round trip, we raise it.
+        const double target_duration = std::min<double>(
+            bs.max_dur, gap * TUNED_TURNAROUND_FACTOR);
+        const double target_size = row_size * target_duration / row_duration;
+        if (target_size > max_size) {
+            max_size = std::max<int64_t>(
+                max_size,
+                static_cast<int64_t>(std::min<double>(TUNED_MAX_SIZE, target_size)));
+        }
+    }
+    // `min_els` rows count even when they're over the size limit, which is too
+    // much when the rows are huge.
+    if (row_size * min_els > max_size) {
+        min_els = std::max<int64_t>(1, static_cast<int64_t>(max_size / row_size));
+    }
+    return batchspec_t(bs.batch_type, min_els, bs.max_els, max_size,
+                       bs.first_scaledown_factor, bs.max_dur, bs.start_time);
+}
+
+static double moving_average(bool has_average, double average, double sample) {
+    return has_average
+        ? (1 - TUNED_NEW_WEIGHT) * average + TUNED_NEW_WEIGHT * sample
+        : sample;
+}
+
+void batch_tuner_t::note_batch(microtime_t requested, microtime_t start,
+                               microtime_t end, size_t els, int64_t size) {
+    if (last_end != 0 && requested > last_end) {
+        gap = moving_average(has_gap, gap, requested - last_end);
+        has_gap = true;
+    }
+    if (els > 0) {
+        const double duration = end > start ? end - start : 0;
+        row_duration = moving_average(has_rows, row_duration, duration / els);
+        row_size = moving_average(has_rows, row_size,
+                                  static_cast<double>(size) / els);
+        has_rows = true;
+    }
+    last_end = std::max(requested, end);
+}
+
 bool batcher_t::should_send_batch() const {
     // We ignore `size_left` as long as we have not got at least
     // `min_wanted_els` documents.
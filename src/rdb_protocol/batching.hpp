@@ -73,6 +73,8 @@ private:
 class batchspec_t {
 public:
     static batchspec_t user(batch_type_t batch_type, env_t *env);
+    // Whether the query set any of the optargs `user` reads.
+    static bool user_set_limits(env_t *env);
     static batchspec_t all(); // Gimme everything.
     static batchspec_t empty() { return batchspec_t(); }
     static batchspec_t default_for(batch_type_t batch_type);
@@ -84,6 +86,7 @@ public:
     batcher_t to_batcher() const;
 
 private:
+    friend class batch_tuner_t;
     template<cluster_version_t W>
     friend void serialize(write_message_t *, const batchspec_t &);
     template<cluster_version_t W>
@@ -101,6 +104,31 @@ private:
 };
 RDB_DECLARE_SERIALIZABLE(batchspec_t);
 
+// Tunes the batches of a cursor to how its previous batches went: the size limit
+// is raised when it would cut batches of small, cheap rows short of taking a few
+// times as long as the client takes to ask for the next one, and `min_els` is
+// lowered when that many rows would be well over the size limit.  The shards'
+// shares of a batch are still left to `scale_down`.
+class batch_tuner_t {
+public:
+    batch_tuner_t();
+    // Returns `bs` with its limits adjusted; `bs` itself if there's nothing to go on
+    // yet.
+    batchspec_t tune(const batchspec_t &bs) const;
+    // Records a batch of `els` rows and `size` bytes in all, that the client asked
+    // for at `requested` and that was read from `start` to `end` (which may be
+    // before `requested` if the batch was read ahead).
+    void note_batch(microtime_t requested, microtime_t start, microtime_t end,
+                    size_t els, int64_t size);
+
+private:
+    // Moving averages, in bytes and microseconds.
+    bool has_rows, has_gap;
+    double row_size, row_duration, gap;
+    // When the last batch was sent, or 0 if there wasn't one yet.
+    microtime_t last_end;
+};
+
 } // namespace ql
 
 #endif // RDB_PROTOCOL_BATCHING_HPP_
@@ -1,8 +1,10 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/btree.hpp"
 
+#include <algorithm>
 #include <functional>
 #include <iterator>
+#include <map>
 #include <set>
 #include <string>
 #include <vector>
@@ -11,28 +13,37 @@
 #include <boost/optional.hpp>
 
 #include "btree/backfill.hpp"
+#include "btree/bulk_load.hpp"
 #include "btree/concurrent_traversal.hpp"
 #include "btree/get_distribution.hpp"
 #include "btree/operations.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "btree/slice.hpp"
 #include "buffer_cache/serialize_onto_blob.hpp"
+#include "concurrency/auto_drainer.hpp"
 #include "concurrency/coro_pool.hpp"
+#include "concurrency/new_semaphore.hpp"
 #include "concurrency/queue/unlimited_fifo.hpp"
 #include "containers/archive/boost_types.hpp"
 #include "containers/archive/buffer_group_stream.hpp"
 #include "containers/archive/buffer_stream.hpp"
+#include "containers/archive/string_stream.hpp"
+#include "containers/disk_backed_queue.hpp"
 #include "containers/scoped.hpp"
+#include "containers/uuid.hpp"
 #include "rdb_protocol/geo/exceptions.hpp"
 #include "rdb_protocol/geo/indexing.hpp"
 #include "rdb_protocol/blob_wrapper.hpp"
+#include "rdb_protocol/filter_kernel.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/geo_traversal.hpp"
+#include "rdb_protocol/index_key_extractor.hpp"
 #include "rdb_protocol/lazy_json.hpp"
 #include "rdb_protocol/pseudo_geometry.hpp"
 #include "rdb_protocol/serialize_datum_onto_blob.hpp"
 #include "rdb_protocol/shards.hpp"
 #include "rdb_protocol/table_common.hpp"
+#include "threading.hpp"
 
 #include "debug.hpp"
 
@@ -105,6 +116,52 @@ void rdb_get(const store_key_t &store_key, btree_slice_t *slice,
     }
 }
 
+bool rdb_get_optimistically(const store_key_t &store_key, btree_slice_t *slice,
+                            cache_t *cache, point_read_response_t *response) {
+    rdb_value_sizer_t sizer(cache->max_block_size());
+    scoped_malloc_t<void> value;
+    if (!find_keyvalue_optimistically(&sizer, cache, store_key.btree_key(), &value)) {
+        return false;
+    }
+
+    if (!value.has()) {
+        response->data = ql::datum_t::null();
+    } else if (!get_inline_data(static_cast<rdb_value_t *>(value.get()),
+                                cache->max_block_size(), &response->data)) {
+        return false;
+    }
+    slice->stats.pm_keys_read.record();
+    slice->stats.pm_total_keys_read += 1;
+    return true;
+}
+
+class batched_get_callback_t : public found_keyvalue_callback_t {
+public:
+    batched_get_callback_t(const std::vector<store_key_t> *_keys,
+                           batched_point_read_response_t *_response)
+        : keys(_keys), response(_response) { }
+
+    void on_keyvalue(size_t key_index, const void *value, buf_parent_t leaf) {
+        // The keys are sorted, so this is always at the end.
+        response->rows.insert(
+            response->rows.end(),
+            std::make_pair((*keys)[key_index],
+                           get_data(static_cast<const rdb_value_t *>(value), leaf)));
+    }
+
+private:
+    const std::vector<store_key_t> *const keys;
+    batched_point_read_response_t *const response;
+};
+
+void rdb_batched_get(const std::vector<store_key_t> &keys, btree_slice_t *slice,
+                     superblock_t *superblock, batched_point_read_response_t *response,
+                     profile::trace_t *trace) {
+    rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
+    batched_get_callback_t cb(&keys, response);
+    find_keyvalues_for_read(&sizer, superblock, keys, &cb, &slice->stats, trace);
+}
+
 void kv_location_delete(keyvalue_location_t *kv_location,
                         const store_key_t &key,
                         repli_timestamp_t timestamp,
@@ -136,24 +193,15 @@ void kv_location_delete(keyvalue_location_t *kv_location,
             deletion_context->balancing_detacher(), &null_cb);
 }
 
-MUST_USE ql::serialization_result_t
-kv_location_set(keyvalue_location_t *kv_location,
-                const store_key_t &key,
-                ql::datum_t data,
-                repli_timestamp_t timestamp,
-                const deletion_context_t *deletion_context,
-                rdb_modification_info_t *mod_info_out) THROWS_NOTHING {
-    scoped_malloc_t<rdb_value_t> new_value(blob::btree_maxreflen);
-    memset(new_value.get(), 0, blob::btree_maxreflen);
-
+// Replaces the value at `kv_location` with `new_value`, whose blob has been written.
+static void kv_location_set_value(keyvalue_location_t *kv_location,
+                                  const store_key_t &key,
+                                  scoped_malloc_t<rdb_value_t> &&new_value,
+                                  repli_timestamp_t timestamp,
+                                  const deletion_context_t *deletion_context,
+                                  rdb_modification_info_t *mod_info_out)
+        THROWS_NOTHING {
     const max_block_size_t block_size = kv_location->buf.cache()->max_block_size();
-    {
-        blob_t blob(block_size, new_value->value_ref(), blob::btree_maxreflen);
-        ql::serialization_result_t res
-            = datum_serialize_onto_blob(buf_parent_t(&kv_location->buf),
-                                        &blob, data);
-        if (bad(res)) return res;
-    }
 
     if (mod_info_out) {
         guarantee(mod_info_out->added.second.empty());
@@ -180,9 +228,114 @@ kv_location_set(keyvalue_location_t *kv_location,
     apply_keyvalue_change(&sizer, kv_location, key.btree_key(),
                           timestamp,
                           deletion_context->balancing_detacher(), &null_cb);
+}
+
+MUST_USE ql::serialization_result_t
+kv_location_set(keyvalue_location_t *kv_location,
+                const store_key_t &key,
+                ql::datum_t data,
+                repli_timestamp_t timestamp,
+                const deletion_context_t *deletion_context,
+                rdb_modification_info_t *mod_info_out) THROWS_NOTHING {
+    scoped_malloc_t<rdb_value_t> new_value(blob::btree_maxreflen);
+    memset(new_value.get(), 0, blob::btree_maxreflen);
+
+    const max_block_size_t block_size = kv_location->buf.cache()->max_block_size();
+    {
+        blob_t blob(block_size, new_value->value_ref(), blob::btree_maxreflen);
+        ql::serialization_result_t res
+            = datum_serialize_onto_blob(buf_parent_t(&kv_location->buf),
+                                        &blob, data);
+        if (bad(res)) return res;
+    }
+
+    kv_location_set_value(kv_location, key, std::move(new_value), timestamp,
+                          deletion_context, mod_info_out);
     return ql::serialization_result_t::SUCCESS;
 }
 
+// Overwrites the value at `kv_location` with `data` in place, if the serialization of
+// `data` is exactly as long as the blob that's there: the blob keeps its blocks and
+// its ref, and only the blocks whose bytes change get written.  Returns false without
+// changing anything if the sizes differ, if the blob is small enough to live in the
+// leaf (so there are no blocks to save), or if `data` can't be written to disk.
+//
+// The old value is gone afterwards, so this can't be used when anything still has to
+// read it through `rdb_modification_info_t`, like secondary index updates.
+static bool kv_location_patch(keyvalue_location_t *kv_location,
+                              const store_key_t &key,
+                              const ql::datum_t &data,
+                              repli_timestamp_t timestamp,
+                              const deletion_context_t *deletion_context)
+        THROWS_NOTHING {
+    guarantee(kv_location->value.has());
+    const max_block_size_t block_size = kv_location->buf.cache()->max_block_size();
+    char *ref = kv_location->value_as<rdb_value_t>()->value_ref();
+    if (blob::ref_info(block_size, ref, blob::btree_maxreflen).levels == 0) {
+        return false;
+    }
+    blob_t blob(block_size, ref, blob::btree_maxreflen);
+    std::string new_data;
+    if (bad(datum_serialize_onto_string(
+                data, ql::check_datum_serialization_errors_t::YES, &new_data))
+        || static_cast<int64_t>(new_data.size()) != blob.valuesize()) {
+        return false;
+    }
+
+    // The `(offset, size)` ranges of the blob that change, a leaf block at a time.
+    const buf_parent_t parent(&kv_location->buf);
+    std::vector<std::pair<int64_t, int64_t> > changed;
+    {
+        buffer_group_t group;
+        blob_acq_t acq;
+        blob.expose_all(parent, access_t::read, &group, &acq);
+        int64_t offset = 0;
+        for (size_t i = 0; i < group.num_buffers(); ++i) {
+            const buffer_group_t::buffer_t buffer = group.get_buffer(i);
+            if (memcmp(buffer.data, new_data.data() + offset, buffer.size) != 0) {
+                if (!changed.empty()
+                    && changed.back().first + changed.back().second == offset) {
+                    changed.back().second += buffer.size;
+                } else {
+                    changed.push_back(std::make_pair(offset, buffer.size));
+                }
+            }
+            offset += buffer.size;
+        }
+        guarantee(offset == blob.valuesize());
+    }
+    for (const auto &range : changed) {
+        blob.write_from_string(new_data.substr(range.first, range.second),
+                               parent, range.first);
+    }
+
+    // The ref is the same, but the leaf still gets the new timestamp.
+    null_key_modification_callback_t null_cb;
+    rdb_value_sizer_t sizer(block_size);
+    apply_keyvalue_change(&sizer, kv_location, key.btree_key(), timestamp,
+                          deletion_context->balancing_detacher(), &null_cb);
+    return true;
+}
+
+// Writes a datum that's already serialized into a new value.
+static scoped_malloc_t<rdb_value_t> make_serialized_value(
+        buf_parent_t parent, max_block_size_t block_size, const std::string &data) {
+    scoped_malloc_t<rdb_value_t> new_value(blob::btree_maxreflen);
+    memset(new_value.get(), 0, blob::btree_maxreflen);
+    blob_t blob(block_size, new_value->value_ref(), blob::btree_maxreflen);
+    blob.append_region(parent, data.size());
+    blob.write_from_string(data, parent, 0);
+    return new_value;
+}
+
+static ql::datum_t deserialize_serialized_value(const std::string &data) {
+    buffer_read_stream_t stream(data.data(), data.size());
+    ql::datum_t datum;
+    archive_result_t res = datum_deserialize(&stream, &datum);
+    guarantee_deserialization(res, "serialized rdb value");
+    return datum;
+}
+
 MUST_USE ql::serialization_result_t
 kv_location_set(keyvalue_location_t *kv_location,
                 const store_key_t &key,
@@ -208,37 +361,29 @@ kv_location_set(keyvalue_location_t *kv_location,
     return ql::serialization_result_t::SUCCESS;
 }
 
-batched_replace_response_t rdb_replace_and_return_superblock(
-    const btree_loc_info_t &info,
+// Replaces the row with key `key`, which `kv_location` has been found for.  The
+// values only go into `*mod_info_out` if `report_values` is true.
+batched_replace_response_t rdb_replace_at_location(
+    const btree_info_t *btree,
+    const store_key_t &key,
+    keyvalue_location_t *kv_location,
     const btree_point_replacer_t *replacer,
     const deletion_context_t *deletion_context,
-    promise_t<superblock_t *> *superblock_promise,
-    rdb_modification_info_t *mod_info_out,
-    profile::trace_t *trace)
+    bool report_values,
+    rdb_modification_info_t *mod_info_out)
 {
     const return_changes_t return_changes = replacer->should_return_changes();
-    const datum_string_t &primary_key = info.btree->primary_key;
-    const store_key_t &key = *info.key;
+    const datum_string_t &primary_key = btree->primary_key;
 
     try {
-        keyvalue_location_t kv_location;
-        rdb_value_sizer_t sizer(info.superblock->cache()->max_block_size());
-        find_keyvalue_location_for_write(&sizer, info.superblock,
-                                         info.key->btree_key(),
-                                         deletion_context->balancing_detacher(),
-                                         &kv_location,
-                                         &info.btree->slice->stats,
-                                         trace,
-                                         superblock_promise);
-
         ql::datum_t old_val;
-        if (!kv_location.value.has()) {
+        if (!kv_location->value.has()) {
             // If there's no entry with this key, pass NULL to the function.
             old_val = ql::datum_t::null();
         } else {
             // Otherwise pass the entry with this key to the function.
-            old_val = get_data(kv_location.value_as<rdb_value_t>(),
-                               buf_parent_t(&kv_location.buf));
+            old_val = get_data(kv_location->value_as<rdb_value_t>(),
+                               buf_parent_t(&kv_location->buf));
             guarantee(old_val.get_field(primary_key, ql::NOTHROW).has());
         }
         guarantee(old_val.has());
@@ -260,15 +405,23 @@ batched_replace_response_t rdb_replace_and_return_superblock(
             }
 
             /* Now that the change has passed validation, write it to disk */
+            rdb_modification_info_t *values_out = report_values ? mod_info_out : NULL;
             if (new_val.get_type() == ql::datum_t::R_NULL) {
-                kv_location_delete(&kv_location, *info.key, info.btree->timestamp,
-                                   deletion_context, mod_info_out);
+                kv_location_delete(kv_location, key, btree->timestamp,
+                                   deletion_context, values_out);
             } else {
                 r_sanity_check(new_val.get_field(primary_key, ql::NOTHROW).has());
-                ql::serialization_result_t res =
-                    kv_location_set(&kv_location, *info.key, new_val,
-                                    info.btree->timestamp, deletion_context,
-                                    mod_info_out);
+                // Nothing needs the old value's blob if we aren't reporting it, so we
+                // can try to write over it.
+                const bool patched = values_out == NULL
+                    && kv_location->value.has()
+                    && kv_location_patch(kv_location, key, new_val, btree->timestamp,
+                                         deletion_context);
+                ql::serialization_result_t res = patched
+                    ? ql::serialization_result_t::SUCCESS
+                    : kv_location_set(kv_location, key, new_val,
+                                      btree->timestamp, deletion_context,
+                                      values_out);
                 switch (res) {
                     case ql::serialization_result_t::ARRAY_TOO_BIG:
                         rfail_typed_target(&new_val, "Array too large for disk writes"
@@ -283,13 +436,13 @@ batched_replace_response_t rdb_replace_and_return_superblock(
 
             /* Report the changes for sindex and change-feed purposes */
             if (old_val.get_type() != ql::datum_t::R_NULL) {
-                guarantee(!mod_info_out->deleted.second.empty());
+                guarantee(mod_info_out->deleted.second.empty() == !report_values);
                 mod_info_out->deleted.first = old_val;
             } else {
                 guarantee(mod_info_out->deleted.second.empty());
             }
             if (new_val.get_type() != ql::datum_t::R_NULL) {
-                guarantee(!mod_info_out->added.second.empty());
+                guarantee(mod_info_out->added.second.empty() == !report_values);
                 mod_info_out->added.first = new_val;
             } else {
                 guarantee(mod_info_out->added.second.empty());
@@ -312,7 +465,6 @@ batched_replace_response_t rdb_replace_and_return_superblock(
     }
 }
 
-
 class one_replace_t : public btree_point_replacer_t {
 public:
     one_replace_t(const btree_batched_replacer_t *_replacer, size_t _index)
@@ -327,14 +479,22 @@ private:
     const size_t index;
 };
 
-void do_a_replace_from_batched_replace(
+// Applies the replaces of `keys[order[begin]]` and of as many of the keys after it
+// in `order` as are in the same leaf or its siblings, and pulses `end_promise` with
+// the position in `order` of the first one it didn't apply.
+void do_replaces_from_batched_replace(
     auto_drainer_t::lock_t,
     fifo_enforcer_sink_t *batched_replaces_fifo_sink,
     const fifo_enforcer_write_token_t &batched_replaces_fifo_token,
-    const btree_loc_info_t &info,
-    const one_replace_t one_replace,
+    const btree_info_t *btree,
+    superblock_t *superblock,
+    const std::vector<store_key_t> *keys,
+    const std::vector<size_t> *order,
+    size_t begin,
+    const btree_batched_replacer_t *replacer,
     const ql::configured_limits_t &limits,
     promise_t<superblock_t *> *superblock_promise,
+    promise_t<size_t> *end_promise,
     rdb_modification_report_cb_t *sindex_cb,
     bool update_pkey_cfeeds,
     batched_replace_response_t *stats_out,
@@ -345,18 +505,41 @@ void do_a_replace_from_batched_replace(
         batched_replaces_fifo_sink, batched_replaces_fifo_token);
 
     rdb_live_deletion_context_t deletion_context;
-    rdb_modification_report_t mod_report(*info.key);
-    ql::datum_t res = rdb_replace_and_return_superblock(
-        info, &one_replace, &deletion_context, superblock_promise, &mod_report.info,
-        trace);
-    *stats_out = (*stats_out).merge(res, ql::stats_merge, limits, conditions);
-
-    // We wait to make sure we acquire `acq` in the same order we were
-    // originally called.
+    const bool report_values = sindex_cb->has_sindexes();
+    std::vector<rdb_modification_report_t> mod_reports;
+    size_t end = begin;
+    {
+        keyvalue_location_t kv_location;
+        rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
+        find_keyvalue_location_for_write(&sizer, superblock,
+                                         (*keys)[(*order)[begin]].btree_key(),
+                                         deletion_context.balancing_detacher(),
+                                         &kv_location,
+                                         &btree->slice->stats,
+                                         trace,
+                                         superblock_promise);
+        do {
+            const size_t i = (*order)[end];
+            mod_reports.push_back(rdb_modification_report_t((*keys)[i]));
+            one_replace_t one_replace(replacer, i);
+            ql::datum_t res = rdb_replace_at_location(
+                btree, (*keys)[i], &kv_location, &one_replace, &deletion_context,
+                report_values, &mod_reports.back().info);
+            *stats_out = (*stats_out).merge(res, ql::stats_merge, limits, conditions);
+            ++end;
+        } while (end < order->size()
+                 && move_keyvalue_location_for_write(
+                     &sizer, (*keys)[(*order)[end]].btree_key(), &kv_location));
+    }
+    end_promise->pulse(end);
+
+    // We wait to make sure we update the secondary indexes in the same order we
+    // were originally called.
     exiter.wait();
-    scoped_ptr_t<new_mutex_in_line_t> acq = sindex_cb->get_in_line();
 
-    sindex_cb->on_mod_report(mod_report, update_pkey_cfeeds, acq.get());
+    for (const auto &mod_report : mod_reports) {
+        sindex_cb->on_mod_report(mod_report, update_pkey_cfeeds);
+    }
 }
 
 batched_replace_response_t rdb_batched_replace(
@@ -375,6 +558,19 @@ batched_replace_response_t rdb_batched_replace(
 
     std::set<std::string> conditions;
 
+    // We apply the replaces in key order.  The replaces are pipelined down the tree
+    // behind the superblock, and each coroutine applies a run of keys that are in
+    // the same leaf (or its siblings) while it holds the leaf, so each leaf gets
+    // loaded, locked and dirtied once for all of them instead of once per key.  The
+    // sort is stable so that replaces of the same key still happen in their
+    // original order.
+    std::vector<size_t> order(keys.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+
     // We have to drain write operations before destructing everything above us,
     // because the coroutines being drained use them.
     {
@@ -393,24 +589,35 @@ batched_replace_response_t rdb_batched_replace(
         bool update_pkey_cfeeds = sindex_cb->has_pkey_cfeeds();
         {
             auto_drainer_t drainer;
-            for (size_t i = 0; i < keys.size(); ++i) {
+            size_t begin = 0;
+            while (begin < order.size()) {
                 promise_t<superblock_t *> superblock_promise;
+                promise_t<size_t> end_promise;
                 coro_queue.push(
                     std::bind(
-                        &do_a_replace_from_batched_replace,
+                        &do_replaces_from_batched_replace,
                         auto_drainer_t::lock_t(&drainer),
                         &sink,
                         source.enter_write(),
-                        btree_loc_info_t(&info, current_superblock.release(), &keys[i]),
-                        one_replace_t(replacer, i),
+                        &info,
+                        current_superblock.release(),
+                        &keys,
+                        &order,
+                        begin,
+                        replacer,
                         limits,
                         &superblock_promise,
+                        &end_promise,
                         sindex_cb,
                         update_pkey_cfeeds,
                         &stats,
                         trace,
                         &conditions));
                 current_superblock.init(superblock_promise.wait());
+                // The next run starts wherever this one stops, which we only know
+                // once it's done with its leaf.  Until then the next run's descent
+                // would mostly have to wait for the same leaf's parent anyway.
+                begin = end_promise.wait();
             }
             if (!update_pkey_cfeeds) {
                 current_superblock.reset(); // Release the superblock early if
@@ -477,6 +684,75 @@ void rdb_set(const store_key_t &key,
         (had_value ? point_write_result_t::DUPLICATE : point_write_result_t::STORED);
 }
 
+void rdb_set_serialized(const store_key_t &key,
+                        const std::string &data,
+                        btree_slice_t *slice,
+                        repli_timestamp_t timestamp,
+                        superblock_t *superblock,
+                        const deletion_context_t *deletion_context,
+                        rdb_modification_info_t *mod_info,
+                        promise_t<superblock_t *> *pass_back_superblock) {
+    keyvalue_location_t kv_location;
+    const max_block_size_t block_size = superblock->cache()->max_block_size();
+    rdb_value_sizer_t sizer(block_size);
+    find_keyvalue_location_for_write(&sizer, superblock, key.btree_key(),
+                                     deletion_context->balancing_detacher(),
+                                     &kv_location, &slice->stats, NULL,
+                                     pass_back_superblock);
+
+    if (mod_info != NULL) {
+        if (kv_location.value.has()) {
+            mod_info->deleted.first = get_data(kv_location.value_as<rdb_value_t>(),
+                                               buf_parent_t(&kv_location.buf));
+        }
+        mod_info->added.first = deserialize_serialized_value(data);
+    }
+
+    scoped_malloc_t<rdb_value_t> new_value
+        = make_serialized_value(buf_parent_t(&kv_location.buf), block_size, data);
+    kv_location_set_value(&kv_location, key, std::move(new_value), timestamp,
+                          deletion_context, mod_info);
+}
+
+bool rdb_append_serialized(btree_slice_t *slice,
+                           const std::vector<backfill_atom_t> &atoms,
+                           superblock_t *superblock,
+                           std::vector<rdb_modification_report_t> *mod_reports_out) {
+    guarantee(!atoms.empty());
+    for (size_t i = 1; i < atoms.size(); ++i) {
+        if (!(atoms[i - 1].key < atoms[i].key)) {
+            return false;
+        }
+    }
+
+    const max_block_size_t block_size = superblock->cache()->max_block_size();
+    rdb_value_sizer_t sizer(block_size);
+    btree_bulk_loader_t loader(&sizer, BACKFILL_BULK_LOAD_FILL_FACTOR);
+    if (!loader.start_after_existing_keys(superblock, atoms[0].key.btree_key())) {
+        return false;
+    }
+
+    // The loader decides which leaf a value goes into, so the blocks of big values
+    // can't be created under their leaf. They're new, so no one else is waiting for
+    // them anyway.
+    const buf_parent_t value_parent(superblock->expose_buf().txn());
+    for (const backfill_atom_t &atom : atoms) {
+        scoped_malloc_t<rdb_value_t> value
+            = make_serialized_value(value_parent, block_size, atom.value);
+        loader.append(superblock, atom.key.btree_key(), value.get(), atom.recency,
+                      &slice->stats);
+        if (mod_reports_out != NULL) {
+            rdb_modification_report_t mod_report(atom.key);
+            mod_report.info.added.first = deserialize_serialized_value(atom.value);
+            mod_report.info.added.second.assign(
+                value->value_ref(), value->value_ref() + value->inline_size(block_size));
+            mod_reports_out->push_back(std::move(mod_report));
+        }
+    }
+    loader.release();
+    return true;
+}
+
 class agnostic_rdb_backfill_callback_t : public agnostic_backfill_callback_t {
 public:
     agnostic_rdb_backfill_callback_t(rdb_backfill_callback_t *cb,
@@ -508,13 +784,12 @@ public:
             rassert(kr_.contains_key(keys[i]->contents, keys[i]->size));
             const rdb_value_t *value = static_cast<const rdb_value_t *>(vals[i]);
 
-            backfill_atom_t atom;
-            atom.key.assign(keys[i]->size, keys[i]->contents);
-            atom.value = get_data(value, leaf_node);
-            atom.recency = recencies[i];
-            chunk_atoms.push_back(atom);
+            backfill_atom_t atom(store_key_t(keys[i]->size, keys[i]->contents),
+                                 get_serialized_data(value, leaf_node),
+                                 recencies[i]);
             current_chunk_size += static_cast<size_t>(atom.key.size())
-                + serialized_size<cluster_version_t::CLUSTER>(atom.value);
+                + atom.value.size();
+            chunk_atoms.push_back(std::move(atom));
 
             if (current_chunk_size >= BACKFILL_MAX_KVPAIRS_SIZE) {
                 // To avoid flooding the receiving node with overly large chunks
@@ -558,6 +833,14 @@ void rdb_backfill(btree_slice_t *slice, const key_range_t& key_range,
                                superblock, sindex_block, p, interruptor);
 }
 
+void rdb_backfill_sindexes(btree_slice_t *slice, rdb_backfill_callback_t *callback,
+                           buf_lock_t *sindex_block, signal_t *interruptor)
+    THROWS_ONLY(interrupted_exc_t) {
+    agnostic_rdb_backfill_callback_t agnostic_cb(
+        callback, key_range_t::universe(), slice);
+    do_agnostic_btree_backfill_sindexes(sindex_block, &agnostic_cb, interruptor);
+}
+
 void rdb_delete(const store_key_t &key, btree_slice_t *slice,
                 repli_timestamp_t timestamp,
                 superblock_t *superblock,
@@ -600,10 +883,11 @@ class rget_sindex_data_t {
 public:
     rget_sindex_data_t(const key_range_t &_pkey_range, const ql::datum_range_t &_range,
                        reql_version_t wire_func_reql_version,
-                       ql::map_wire_func_t wire_func, sindex_multi_bool_t _multi)
+                       ql::map_wire_func_t wire_func, sindex_multi_bool_t _multi,
+                       const std::vector<std::string> &_covering)
         : pkey_range(_pkey_range), range(_range),
           func_reql_version(wire_func_reql_version),
-          func(wire_func.compile_wire_func()), multi(_multi) { }
+          func(wire_func.compile_wire_func()), multi(_multi), covering(_covering) { }
 private:
     friend class rget_cb_t;
     const key_range_t pkey_range;
@@ -611,6 +895,7 @@ private:
     const reql_version_t func_reql_version;
     const counted_t<const ql::func_t> func;
     const sindex_multi_bool_t multi;
+    const std::vector<std::string> covering;
 };
 
 class job_data_t {
@@ -669,9 +954,30 @@ public:
         THROWS_ONLY(interrupted_exc_t);
     void finish() THROWS_ONLY(interrupted_exc_t);
 private:
+    struct pending_row_t {
+        store_key_t key;
+        ql::datum_t sindex_val;  // NULL if no sindex
+        ql::datum_t val;
+    };
+
+    void advance_last_key(const store_key_t &key);
+    // Applies the transformations to the pending rows together, and accumulates
+    // them one by one.
+    done_traversing_t flush_pending_rows() THROWS_ONLY(interrupted_exc_t);
+
     const rget_io_data_t io; // How do get data in/out.
     job_data_t job; // What to do next (stateful).
     const boost::optional<rget_sindex_data_t> sindex; // Optional sindex information.
+    // Whether the transformations and the accumulator look at the rows (`count`
+    // and indexed `distinct` don't).
+    const bool uses_val;
+    // Whether rows are collected in `pending_rows`, up to `RGET_ROW_BATCH_SIZE`,
+    // because some transformation handles many rows at once much faster.
+    const bool batch_rows;
+    std::vector<pending_row_t> pending_rows;
+    // The last key we skipped while there were pending rows.  `last_key` can only
+    // move past it once the pending rows have been accumulated.
+    boost::optional<store_key_t> pending_last_key;
 
     // State for internal bookkeeping.
     bool bad_init;
@@ -679,6 +985,15 @@ private:
     scoped_ptr_t<profile::sampler_t> sampler;
 };
 
+bool any_op_batches_rows(const std::vector<scoped_ptr_t<ql::op_t> > &ops) {
+    for (auto it = ops.begin(); it != ops.end(); ++it) {
+        if ((*it)->batches_rows()) {
+            return true;
+        }
+    }
+    return false;
+}
+
 rget_cb_t::rget_cb_t(rget_io_data_t &&_io,
                      job_data_t &&_job,
                      boost::optional<rget_sindex_data_t> &&_sindex,
@@ -686,6 +1001,10 @@ rget_cb_t::rget_cb_t(rget_io_data_t &&_io,
     : io(std::move(_io)),
       job(std::move(_job)),
       sindex(std::move(_sindex)),
+      uses_val(job.transformers.empty()
+               ? job.accumulator->uses_val()
+               : job.transformers[0]->uses_val()),
+      batch_rows(any_op_batches_rows(job.transformers)),
       bad_init(false) {
     io.response->last_key = !reversed(job.sorting)
         ? range.left
@@ -696,12 +1015,72 @@ rget_cb_t::rget_cb_t(rget_io_data_t &&_io,
 }
 
 void rget_cb_t::finish() THROWS_ONLY(interrupted_exc_t) {
+    flush_pending_rows();
     job.accumulator->finish(&io.response->result);
     if (job.accumulator->should_send_batch()) {
         io.response->truncated = true;
     }
 }
 
+void rget_cb_t::advance_last_key(const store_key_t &key) {
+    if ((io.response->last_key < key && !reversed(job.sorting)) ||
+        (io.response->last_key > key && reversed(job.sorting))) {
+        io.response->last_key = key;
+    }
+}
+
+done_traversing_t rget_cb_t::flush_pending_rows() THROWS_ONLY(interrupted_exc_t) {
+    std::vector<pending_row_t> rows_to_flush;
+    rows_to_flush.swap(pending_rows);
+    boost::optional<store_key_t> skipped_key;
+    skipped_key.swap(pending_last_key);
+    if (rows_to_flush.empty() || boost::get<ql::exc_t>(&io.response->result) != NULL) {
+        return done_traversing_t::NO;
+    }
+
+    try {
+        std::vector<ql::groups_t> rows;
+        std::vector<ql::datum_t> sindex_vals;
+        rows.reserve(rows_to_flush.size());
+        sindex_vals.reserve(rows_to_flush.size());
+        for (auto it = rows_to_flush.begin(); it != rows_to_flush.end(); ++it) {
+            rows.push_back(ql::groups_t(optional_datum_less_t(job.env->reql_version())));
+            rows.back() = {{ql::datum_t(), ql::datums_t{std::move(it->val)}}};
+            sindex_vals.push_back(it->sindex_val);
+        }
+        for (auto it = job.transformers.begin(); it != job.transformers.end(); ++it) {
+            (*it)->apply_to_rows(job.env, &rows, sindex_vals);
+        }
+        // If the accumulator stops us, the rows after that one get read again by the
+        // next batch, so `last_key` mustn't move past them.
+        for (size_t i = 0; i < rows_to_flush.size(); ++i) {
+            advance_last_key(rows_to_flush[i].key);
+            done_traversing_t done = (*job.accumulator)(
+                job.env,
+                &rows[i],
+                std::move(rows_to_flush[i].key),
+                std::move(rows_to_flush[i].sindex_val));
+            if (done == done_traversing_t::YES) {
+                return done;
+            }
+        }
+        if (skipped_key) {
+            advance_last_key(*skipped_key);
+        }
+        return done_traversing_t::NO;
+    } catch (const ql::exc_t &e) {
+        io.response->result = e;
+        return done_traversing_t::YES;
+    } catch (const ql::datum_exc_t &e) {
+#ifndef NDEBUG
+        unreachable();
+#else
+        io.response->result = ql::exc_t(e, NULL);
+        return done_traversing_t::YES;
+#endif // NDEBUG
+    }
+}
+
 // Handle a keyvalue pair.  Returns whether or not we're done early.
 done_traversing_t rget_cb_t::handle_pair(
     scoped_key_value_t &&keyvalue,
@@ -719,11 +1098,19 @@ done_traversing_t rget_cb_t::handle_pair(
         return done_traversing_t::NO;
     }
 
+    // If neither the row nor the index function is needed, the index value comes
+    // from the key, and we don't have to load the row at all.
+    ql::datum_t key_sindex_val;
+    if (sindex && !uses_val) {
+        key_sindex_val = ql::datum_t::extract_secondary_value(
+            key, sindex->func_reql_version);
+    }
+
     lazy_json_t row(static_cast<const rdb_value_t *>(keyvalue.value()),
                     keyvalue.expose_buf());
     ql::datum_t val;
     // We only load the value if we actually use it (`count` does not).
-    if (job.accumulator->uses_val() || job.transformers.size() != 0 || sindex) {
+    if (uses_val || (sindex && !key_sindex_val.has())) {
         val = row.get();
         io.slice->stats.pm_keys_read.record();
         io.slice->stats.pm_total_keys_read += 1;
@@ -735,15 +1122,30 @@ done_traversing_t rget_cb_t::handle_pair(
     waiter.wait_interruptible();
 
     try {
-        // Update the last considered key.
-        if ((io.response->last_key < key && !reversed(job.sorting)) ||
-            (io.response->last_key > key && reversed(job.sorting))) {
-            io.response->last_key = key;
+        // Update the last considered key.  While there are pending rows, that has
+        // to wait until they've been accumulated.
+        if (pending_rows.empty()) {
+            advance_last_key(key);
+        } else {
+            pending_last_key = key;
         }
 
         // Check whether we're out of sindex range.
         ql::datum_t sindex_val; // NULL if no sindex.
-        if (sindex) {
+        if (key_sindex_val.has()) {
+            sindex_val = key_sindex_val;
+            if (!sindex->range.contains(sindex->func_reql_version, sindex_val)) {
+                return done_traversing_t::NO;
+            }
+        } else if (sindex && !sindex->covering.empty()
+                   && val.get_type() == ql::datum_t::R_ARRAY) {
+            // A covering entry `[index_value, projection]`, see `sindex_value_ref`.
+            sindex_val = val.get(0);
+            val = val.get(1);
+            if (!sindex->range.contains(sindex->func_reql_version, sindex_val)) {
+                return done_traversing_t::NO;
+            }
+        } else if (sindex) {
             // Secondary index functions are deterministic (so no need for an
             // rdb_context_t) and evaluated in a pristine environment (without global
             // optargs).
@@ -759,6 +1161,16 @@ done_traversing_t rget_cb_t::handle_pair(
             if (!sindex->range.contains(sindex->func_reql_version, sindex_val)) {
                 return done_traversing_t::NO;
             }
+            if (!sindex->covering.empty()) {
+                val = project_covered_fields(sindex->covering, val);
+            }
+        }
+
+        if (batch_rows) {
+            pending_rows.push_back(pending_row_t{std::move(key), sindex_val, val});
+            return pending_rows.size() >= RGET_ROW_BATCH_SIZE
+                ? flush_pending_rows()
+                : done_traversing_t::NO;
         }
 
         ql::groups_t data(optional_datum_less_t(job.env->reql_version()));
@@ -787,6 +1199,89 @@ done_traversing_t rget_cb_t::handle_pair(
     }
 }
 
+// Whether the terminal's result can be computed from parts of the range that are
+// traversed in parallel and unsharded afterwards.  The functions of `sum` and `avg`
+// have to be deterministic, so that they don't block while sharing `ql_env`.
+bool terminal_can_traverse_in_parallel(const terminal_variant_t &terminal) {
+    if (boost::get<ql::count_wire_func_t>(&terminal) != NULL) {
+        return true;
+    }
+    const ql::maybe_wire_func_t *f = boost::get<ql::sum_wire_func_t>(&terminal);
+    if (f == NULL) {
+        f = boost::get<ql::avg_wire_func_t>(&terminal);
+    }
+    if (f == NULL) {
+        return false;
+    }
+    counted_t<const ql::func_t> func = f->compile_wire_func_or_null();
+    return !func.has() || func->is_deterministic();
+}
+
+void rdb_rget_slice_in_parallel(
+        btree_slice_t *slice,
+        const key_range_t &range,
+        superblock_t *superblock,
+        ql::env_t *ql_env,
+        const ql::batchspec_t &batchspec,
+        const terminal_variant_t &terminal,
+        rget_read_response_t *response,
+        release_superblock_t release_superblock) {
+    response->last_key = range.left;
+    std::vector<rget_read_response_t> part_responses(MAX_PARALLEL_AGGREGATE_TRAVERSALS);
+    std::vector<scoped_ptr_t<rget_cb_t> > callbacks;
+    std::vector<concurrent_traversal_callback_t *> callback_ptrs;
+    for (size_t i = 0; i < part_responses.size(); ++i) {
+        callbacks.push_back(make_scoped<rget_cb_t>(
+            rget_io_data_t(&part_responses[i], slice),
+            job_data_t(ql_env, batchspec, std::vector<transform_variant_t>(),
+                       terminal, sorting_t::UNORDERED),
+            boost::optional<rget_sindex_data_t>(),
+            range));
+        callback_ptrs.push_back(callbacks.back().get());
+    }
+    btree_parallel_concurrent_traversal(
+        superblock, range, callback_ptrs, release_superblock);
+
+    std::vector<ql::result_t *> results;
+    for (size_t i = 0; i < part_responses.size(); ++i) {
+        callbacks[i]->finish();
+        if (auto e = boost::get<ql::exc_t>(&part_responses[i].result)) {
+            response->result = *e;
+            return;
+        }
+        results.push_back(&part_responses[i].result);
+        response->last_key = std::max(response->last_key, part_responses[i].last_key);
+    }
+    scoped_ptr_t<ql::accumulator_t> accumulator = ql::make_terminal(terminal);
+    accumulator->unshard(ql_env, response->last_key, results);
+    accumulator->finish(&response->result);
+}
+
+// Answers `count()` over the whole primary index with the population in the stat
+// block, which every insert and delete keeps up to date, instead of traversing the
+// tree.  Returns false if the tree has no stat block.
+bool rdb_count_from_stat_block(superblock_t *superblock,
+                               rget_read_response_t *response,
+                               release_superblock_t release_superblock) {
+    int64_t population;
+    if (!get_btree_population(superblock, &population)) {
+        return false;
+    }
+    if (release_superblock == release_superblock_t::RELEASE) {
+        superblock->release();
+    }
+    guarantee(population >= 0);
+
+    // This is what the `count` terminal's accumulator would have produced.
+    ql::grouped_t<uint64_t> counts;
+    if (population != 0) {
+        counts[ql::datum_t()] = population;
+    }
+    response->result = std::move(counts);
+    response->last_key = store_key_t::max();
+    return true;
+}
+
 // TODO: Having two functions which are 99% the same sucks.
 void rdb_rget_slice(
         btree_slice_t *slice,
@@ -802,6 +1297,21 @@ void rdb_rget_slice(
 
     r_sanity_check(boost::get<ql::exc_t>(&response->result) == NULL);
     profile::starter_t starter("Do range scan on primary index.", ql_env->trace);
+    if (terminal && transforms.empty()
+        && boost::get<ql::count_wire_func_t>(&*terminal) != NULL
+        && range == key_range_t::universe()
+        && rdb_count_from_stat_block(superblock, response, release_superblock)) {
+        return;
+    }
+    // Terminals like `count()` over a whole range don't care about the order of the
+    // rows, so the range can be split up and traversed in parallel.  (Profiling
+    // keeps one traversal, because the samplers assume they aren't interleaved.)
+    if (terminal && transforms.empty() && sorting == sorting_t::UNORDERED
+        && ql_env->trace == NULL && terminal_can_traverse_in_parallel(*terminal)) {
+        rdb_rget_slice_in_parallel(slice, range, superblock, ql_env, batchspec,
+                                   *terminal, response, release_superblock);
+        return;
+    }
     rget_cb_t callback(
         rget_io_data_t(response, slice),
         job_data_t(ql_env, batchspec, transforms, terminal, sorting),
@@ -838,7 +1348,8 @@ void rdb_rget_secondary_slice(
         rget_io_data_t(response, slice),
         job_data_t(ql_env, batchspec, transforms, terminal, sorting),
         rget_sindex_data_t(pk_range, sindex_range, sindex_func_reql_version,
-                           sindex_info.mapping, sindex_info.multi),
+                           sindex_info.mapping, sindex_info.multi,
+                           sindex_info.covering),
         sindex_region.inner);
     btree_concurrent_traversal(
         superblock,
@@ -963,6 +1474,105 @@ void rdb_distribution_get(int max_depth,
     }
 }
 
+// The digest of a range is FNV-1a over the sizes and contents of its keys and
+// serialized values, in order.
+static const uint64_t EMPTY_BACKFILL_DIGEST = 14695981039346656037ULL;
+
+static uint64_t add_to_backfill_digest(uint64_t digest, const void *data, size_t size) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; ++i) {
+        digest ^= bytes[i];
+        digest *= 1099511628211ULL;
+    }
+    return digest;
+}
+
+class backfill_digest_callback_t : public depth_first_traversal_callback_t {
+public:
+    // Splits off the ranges itself if `_split_ranges` is true, and otherwise
+    // digests the ranges of `out->splits`.
+    backfill_digest_callback_t(bool _split_ranges, backfill_digests_t *_out)
+        : split_ranges(_split_ranges), out(_out), next_split(0), rows_in_range(0),
+          rows(0) {
+        out->digests.assign(1, EMPTY_BACKFILL_DIGEST);
+    }
+
+    done_traversing_t handle_pair(scoped_key_value_t &&keyvalue) {
+        const store_key_t key(keyvalue.key());
+        if (!region_contains_key(out->region, key)) {
+            return done_traversing_t::NO;
+        }
+        if (split_ranges) {
+            if (rows_in_range == BACKFILL_DIGEST_RANGE_ROWS) {
+                out->splits.push_back(key);
+                out->digests.push_back(EMPTY_BACKFILL_DIGEST);
+                rows_in_range = 0;
+            }
+        } else {
+            while (next_split < out->splits.size() && !(key < out->splits[next_split])) {
+                out->digests.push_back(EMPTY_BACKFILL_DIGEST);
+                ++next_split;
+            }
+        }
+        ++rows_in_range;
+        ++rows;
+
+        const std::string value = get_serialized_data(
+            static_cast<const rdb_value_t *>(keyvalue.value()), keyvalue.expose_buf());
+        const uint64_t key_size = key.size();
+        const uint64_t value_size = value.size();
+        uint64_t *digest = &out->digests.back();
+        *digest = add_to_backfill_digest(*digest, &key_size, sizeof(key_size));
+        *digest = add_to_backfill_digest(*digest, key.contents(), key.size());
+        *digest = add_to_backfill_digest(*digest, &value_size, sizeof(value_size));
+        *digest = add_to_backfill_digest(*digest, value.data(), value.size());
+        return done_traversing_t::NO;
+    }
+
+    void finish() {
+        if (split_ranges) {
+            if (rows == 0) {
+                out->digests.clear();
+            }
+        } else {
+            out->digests.resize(out->splits.size() + 1, EMPTY_BACKFILL_DIGEST);
+        }
+    }
+
+private:
+    const bool split_ranges;
+    backfill_digests_t *const out;
+    size_t next_split;
+    int64_t rows_in_range;
+    int64_t rows;
+
+    DISABLE_COPYING(backfill_digest_callback_t);
+};
+
+void rdb_backfill_digests(superblock_t *superblock,
+                          const region_t &region,
+                          release_superblock_t release_superblock,
+                          backfill_digests_t *digests_out) {
+    digests_out->region = region;
+    digests_out->splits.clear();
+    backfill_digest_callback_t callback(true, digests_out);
+    btree_depth_first_traversal(superblock, region.inner, &callback, FORWARD,
+                                release_superblock);
+    callback.finish();
+}
+
+void rdb_backfill_digests_of_ranges(superblock_t *superblock,
+                                    const backfill_digests_t &ranges,
+                                    release_superblock_t release_superblock,
+                                    backfill_digests_t *digests_out) {
+    digests_out->region = ranges.region;
+    digests_out->splits = ranges.splits;
+    backfill_digest_callback_t callback(false, digests_out);
+    btree_depth_first_traversal(superblock, ranges.region.inner, &callback, FORWARD,
+                                release_superblock);
+    callback.finish();
+}
+
 static const int8_t HAS_VALUE = 0;
 static const int8_t HAS_NO_VALUE = 1;
 
@@ -1015,10 +1625,14 @@ rdb_modification_report_cb_t::rdb_modification_report_cb_t(
         store_t *store,
         buf_lock_t *sindex_block,
         auto_drainer_t::lock_t lock)
-    : lock_(lock), store_(store),
-      sindex_block_(sindex_block) {
+    : lock_(lock), store_(store), txn_(sindex_block->txn()) {
     store_->acquire_post_constructed_sindex_superblocks_for_write(
-            sindex_block_, &sindexes_);
+            sindex_block, &sindexes_, &has_sindexes_);
+    // Like in `store_t::update_sindexes`, we get in line for the sindex queue before
+    // releasing the sindex block, so that mod reports are still pushed in the order
+    // in which transactions held it.
+    sindex_queue_spot_ = store_->get_in_line_for_sindex_queue(sindex_block);
+    sindex_block->reset_buf_lock();
 }
 
 rdb_modification_report_cb_t::~rdb_modification_report_cb_t() { }
@@ -1045,29 +1659,30 @@ void rdb_modification_report_cb_t::finish(
         });
 }
 
-scoped_ptr_t<new_mutex_in_line_t> rdb_modification_report_cb_t::get_in_line() {
-    return store_->get_in_line_for_sindex_queue(sindex_block_);
-}
-
 void rdb_modification_report_cb_t::on_mod_report(
     const rdb_modification_report_t &report,
-    bool update_pkey_cfeeds,
-    new_mutex_in_line_t *spot) {
+    bool update_pkey_cfeeds) {
     if (report.info.deleted.first.has() || report.info.added.first.has()) {
         // We spawn the sindex update in its own coroutine because we don't want to
         // hold the sindex update for the changefeed update or vice-versa.
         cond_t sindexes_updated_cond, keys_available_cond;
         std::map<std::string, std::vector<ql::datum_t> > old_keys, new_keys;
-        spot->acq_signal()->wait_lazily_unordered();
-        coro_t::spawn_now_dangerously(
-            std::bind(&rdb_modification_report_cb_t::on_mod_report_sub,
-                      this,
-                      report,
-                      spot,
-                      &keys_available_cond,
-                      &sindexes_updated_cond,
-                      &old_keys,
-                      &new_keys));
+        sindex_queue_spot_->acq_signal()->wait_lazily_unordered();
+        if (has_sindexes_) {
+            coro_t::spawn_now_dangerously(
+                std::bind(&rdb_modification_report_cb_t::on_mod_report_sub,
+                          this,
+                          report,
+                          sindex_queue_spot_.get(),
+                          &keys_available_cond,
+                          &sindexes_updated_cond,
+                          &old_keys,
+                          &new_keys));
+        } else {
+            // There are no sindexes to update and no sindex queues to push to.
+            keys_available_cond.pulse();
+            sindexes_updated_cond.pulse();
+        }
         guarantee(store_->changefeed_server.has());
         if (update_pkey_cfeeds) {
             store_->changefeed_server->foreach_limit(
@@ -1101,7 +1716,8 @@ void rdb_modification_report_cb_t::on_mod_report(
                     new_keys,
                     report.primary_key,
                     report.info.deleted.first,
-                    report.info.added.first}),
+                    report.info.added.first,
+                    0}),
             report.primary_key);
         sindexes_updated_cond.wait_lazily_unordered();
     }
@@ -1119,7 +1735,7 @@ void rdb_modification_report_cb_t::on_mod_report_sub(
     rdb_update_sindexes(store_,
                         sindexes_,
                         &mod_report,
-                        sindex_block_->txn(),
+                        txn_,
                         &deletion_context,
                         keys_available_cond,
                         old_keys_out,
@@ -1168,6 +1784,23 @@ std::vector<std::string> expand_geo_key(
     }
 }
 
+// Whether `doc` belongs in a partial index with the given filter.  Throws the
+// errors other than non-existence errors that the filter raises.
+bool passes_index_filter(const ql::map_wire_func_t &filter,
+                         reql_version_t reql_version,
+                         const ql::datum_t &doc) {
+    const counted_t<const ql::func_t> f = filter.compile_wire_func();
+    scoped_ptr_t<ql::filter_kernel_t> kernel =
+        ql::filter_kernel_t::compile(f.get(), reql_version);
+    bool result;
+    if (kernel.has() && kernel->eval(doc, &result)) {
+        return result;
+    }
+    cond_t non_interruptor;
+    ql::env_t filter_env(&non_interruptor, reql_version);
+    return f->filter_call(&filter_env, doc, counted_t<const ql::func_t>());
+}
+
 void compute_keys(const store_key_t &primary_key,
                   ql::datum_t doc,
                   const sindex_disk_info_t &index_info,
@@ -1177,13 +1810,23 @@ void compute_keys(const store_key_t &primary_key,
     const reql_version_t reql_version =
         index_info.mapping_version_info.latest_compatible_reql_version;
 
-    // Secondary index functions are deterministic (so no need for an rdb_context_t)
-    // and evaluated in a pristine environment (without global optargs).
-    cond_t non_interruptor;
-    ql::env_t sindex_env(&non_interruptor, reql_version);
+    if (index_info.filter
+        && !passes_index_filter(*index_info.filter, reql_version, doc)) {
+        return;
+    }
 
-    ql::datum_t index =
-        index_info.mapping.compile_wire_func()->call(&sindex_env, doc)->as_datum();
+    const counted_t<const ql::func_t> mapping = index_info.mapping.compile_wire_func();
+    ql::datum_t index;
+    scoped_ptr_t<ql::index_key_extractor_t> extractor =
+        ql::index_key_extractor_t::compile(mapping.get());
+    if (!extractor.has() || !extractor->extract(doc, &index)) {
+        // Secondary index functions are deterministic (so no need for an
+        // rdb_context_t) and evaluated in a pristine environment (without global
+        // optargs).
+        cond_t non_interruptor;
+        ql::env_t sindex_env(&non_interruptor, reql_version);
+        index = mapping->call(&sindex_env, doc)->as_datum();
+    }
 
     if (index_info.multi == sindex_multi_bool_t::MULTI
         && index.get_type() == ql::datum_t::R_ARRAY) {
@@ -1239,6 +1882,14 @@ void serialize_sindex_info(write_message_t *wm,
     serialize<cluster_version_t::LATEST_DISK>(wm, info.mapping);
     serialize<cluster_version_t::LATEST_DISK>(wm, info.multi);
     serialize<cluster_version_t::LATEST_DISK>(wm, info.geo);
+    // The covered fields and the filter come last and are left out when they're
+    // unset, so the descriptions of other indexes don't change.
+    if (!info.covering.empty() || info.filter) {
+        serialize<cluster_version_t::LATEST_DISK>(wm, info.covering);
+    }
+    if (info.filter) {
+        serialize<cluster_version_t::LATEST_DISK>(wm, *info.filter);
+    }
 }
 
 void deserialize_sindex_info(const std::vector<char> &data,
@@ -1299,10 +1950,66 @@ void deserialize_sindex_info(const std::vector<char> &data,
         throw_if_bad_deserialization(success, "sindex description");
     }
 
+    info_out->covering.clear();
+    if (static_cast<size_t>(read_stream.tell()) < data.size()) {
+        success = deserialize_for_version(
+            cluster_version, &read_stream, &info_out->covering);
+        throw_if_bad_deserialization(success, "sindex description");
+    }
+    info_out->filter = boost::none;
+    if (static_cast<size_t>(read_stream.tell()) < data.size()) {
+        ql::map_wire_func_t filter;
+        success = deserialize_for_version(cluster_version, &read_stream, &filter);
+        throw_if_bad_deserialization(success, "sindex description");
+        info_out->filter = filter;
+    }
+
     guarantee(static_cast<size_t>(read_stream.tell()) == data.size(),
               "An sindex description was incompletely deserialized.");
 }
 
+ql::datum_t project_covered_fields(const std::vector<std::string> &covering,
+                                   const ql::datum_t &doc) {
+    if (doc.get_type() != ql::datum_t::R_OBJECT) {
+        return doc;
+    }
+    ql::datum_object_builder_t builder;
+    for (const std::string &field : covering) {
+        ql::datum_t value = doc.get_field(field.c_str(), ql::NOTHROW);
+        if (value.has()) {
+            builder.overwrite(field.c_str(), value);
+        }
+    }
+    return std::move(builder).to_datum();
+}
+
+std::vector<char> sindex_value_ref(const sindex_disk_info_t &info,
+                                   const ql::datum_t &index_value,
+                                   const ql::datum_t &doc,
+                                   const std::vector<char> &row_value_ref) {
+    if (info.covering.empty()) {
+        return row_value_ref;
+    }
+    // Rows are objects, so the array tells reads that this is a covering entry.
+    std::vector<ql::datum_t> pair;
+    pair.push_back(index_value);
+    pair.push_back(project_covered_fields(info.covering, doc));
+    ql::datum_t entry(std::move(pair), ql::configured_limits_t::unlimited);
+    write_message_t wm;
+    if (bad(datum_serialize(&wm, entry, ql::check_datum_serialization_errors_t::NO))) {
+        return row_value_ref;
+    }
+    string_stream_t stream;
+    int res = send_write_message(&stream, &wm);
+    guarantee(res == 0);
+    std::vector<char> ref;
+    if (!blob::make_small_ref(stream.str(), blob::btree_maxreflen, &ref)) {
+        // It doesn't fit, so reads will have to project the row itself.
+        return row_value_ref;
+    }
+    return ref;
+}
+
 /* Used below by rdb_update_sindexes. */
 void rdb_update_single_sindex(
         store_t *store,
@@ -1338,6 +2045,28 @@ void rdb_update_single_sindex(
     ql::changefeed::server_t *server =
         store->changefeed_server.has() ? store->changefeed_server.get() : NULL;
 
+    // If the secondary index is being deleted, we don't add any new values to
+    // the sindex tree.
+    // This is so we don't race against any sindex erase about who is faster
+    // (we with inserting new entries, or the erase with removing them).
+    const bool sindex_is_being_deleted = sindex->sindex.being_deleted;
+
+    // The new keys are computed before the old entries are deleted, so that the
+    // entries that the write leaves exactly as they were can be left alone.
+    std::vector<std::pair<store_key_t, ql::datum_t> > added_keys;
+    bool added_to_index = false;
+    if (!sindex_is_being_deleted && modification->info.added.first.has()) {
+        try {
+            compute_keys(modification->primary_key, modification->info.added.first,
+                         sindex_info, &added_keys);
+            added_to_index = true;
+        } catch (const ql::base_exc_t &) {
+            // We just drop the row from the index.
+            added_keys.clear();
+        }
+    }
+    std::set<store_key_t> unchanged_keys;
+
     if (modification->info.deleted.first.has()) {
         guarantee(!modification->info.deleted.second.empty());
         try {
@@ -1365,7 +2094,28 @@ void rdb_update_single_sindex(
                         }
                     });
             }
+            if (added_to_index) {
+                // An entry stays the same if its key does and it stores the same
+                // value.  Entries that store the row's value ref change whenever
+                // the row does, but covering entries often don't.
+                std::map<store_key_t, ql::datum_t> added_values(added_keys.begin(),
+                                                               added_keys.end());
+                for (const auto &pair : keys) {
+                    auto added_it = added_values.find(pair.first);
+                    if (added_it != added_values.end()
+                        && sindex_value_ref(sindex_info, pair.second, deleted,
+                                            modification->info.deleted.second)
+                           == sindex_value_ref(sindex_info, added_it->second,
+                                               modification->info.added.first,
+                                               modification->info.added.second)) {
+                        unchanged_keys.insert(pair.first);
+                    }
+                }
+            }
             for (auto it = keys.begin(); it != keys.end(); ++it) {
+                if (unchanged_keys.count(it->first) != 0) {
+                    continue;
+                }
                 promise_t<superblock_t *> return_superblock_local;
                 {
                     keyvalue_location_t kv_location;
@@ -1395,98 +2145,76 @@ void rdb_update_single_sindex(
             }
         } catch (const ql::base_exc_t &) {
             // Do nothing (it wasn't actually in the index).
-
-            // See comment in `catch` below.
             guarantee(old_keys_out == NULL || old_keys_out->size() == 0);
         }
     }
 
-    // If the secondary index is being deleted, we don't add any new values to
-    // the sindex tree.
-    // This is so we don't race against any sindex erase about who is faster
-    // (we with inserting new entries, or the erase with removing them).
-    const bool sindex_is_being_deleted = sindex->sindex.being_deleted;
-    if (!sindex_is_being_deleted && modification->info.added.first.has()) {
-        bool decremented_updates_left = false;
-        try {
-            ql::datum_t added = modification->info.added.first;
-
-            std::vector<std::pair<store_key_t, ql::datum_t> > keys;
-
-            compute_keys(modification->primary_key, added, sindex_info, &keys);
-            if (new_keys_out != NULL) {
-                guarantee(keys_available_cond != NULL);
-                for (const auto &pair : keys) {
-                    new_keys_out->push_back(pair.second);
-                }
-                guarantee(*updates_left > 0);
-                decremented_updates_left = true;
-                if (--*updates_left == 0) {
-                    keys_available_cond->pulse();
-                }
+    if (added_to_index) {
+        ql::datum_t added = modification->info.added.first;
+        if (new_keys_out != NULL) {
+            guarantee(keys_available_cond != NULL);
+            for (const auto &pair : added_keys) {
+                new_keys_out->push_back(pair.second);
             }
-            if (server != NULL) {
-                server->foreach_limit(
-                    sindex->name.name,
-                    &modification->primary_key,
-                    [&](rwlock_in_line_t *clients_spot,
-                        rwlock_in_line_t *limit_clients_spot,
-                        rwlock_in_line_t *lm_spot,
-                        ql::changefeed::limit_manager_t *lm) {
-                        guarantee(clients_spot->read_signal()->is_pulsed());
-                        guarantee(limit_clients_spot->read_signal()->is_pulsed());
-                        for (const auto &pair :keys) {
-                            lm->add(lm_spot, pair.first, is_primary_t::NO,
-                                    pair.second, added);
-                        }
-                    });
+            guarantee(*updates_left > 0);
+            if (--*updates_left == 0) {
+                keys_available_cond->pulse();
             }
-            for (auto it = keys.begin(); it != keys.end(); ++it) {
-                promise_t<superblock_t *> return_superblock_local;
-                {
-                    keyvalue_location_t kv_location;
-
-                    rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
-                    find_keyvalue_location_for_write(
-                        &sizer,
-                        superblock,
-                        it->first.btree_key(),
-                        deletion_context->balancing_detacher(),
-                        &kv_location,
-                        &sindex->btree->stats,
-                        trace,
-                        &return_superblock_local);
-
-                    ql::serialization_result_t res =
-                        kv_location_set(&kv_location, it->first,
-                                        modification->info.added.second,
-                                        repli_timestamp_t::distant_past,
-                                        deletion_context);
-                    // this particular context cannot fail AT THE MOMENT.
-                    guarantee(!bad(res));
-                    // The keyvalue location gets destroyed here.
-                }
-                superblock = return_superblock_local.wait();
+        }
+        if (server != NULL) {
+            server->foreach_limit(
+                sindex->name.name,
+                &modification->primary_key,
+                [&](rwlock_in_line_t *clients_spot,
+                    rwlock_in_line_t *limit_clients_spot,
+                    rwlock_in_line_t *lm_spot,
+                    ql::changefeed::limit_manager_t *lm) {
+                    guarantee(clients_spot->read_signal()->is_pulsed());
+                    guarantee(limit_clients_spot->read_signal()->is_pulsed());
+                    ql::datum_t row = sindex_info.covering.empty()
+                        ? added
+                        : project_covered_fields(sindex_info.covering, added);
+                    for (const auto &pair : added_keys) {
+                        lm->add(lm_spot, pair.first, is_primary_t::NO,
+                                pair.second, row);
+                    }
+                });
+        }
+        for (auto it = added_keys.begin(); it != added_keys.end(); ++it) {
+            if (unchanged_keys.count(it->first) != 0) {
+                continue;
             }
-        } catch (const ql::base_exc_t &) {
-            // Do nothing (we just drop the row from the index).
-
-            // If we've decremented `updates_left` already, that means we might
-            // have sent a change with new values for this key even though we're
-            // actually dropping the row.  I *believe* that this catch statement
-            // can only be triggered by an exception thrown from `compute_keys`
-            // (which begs the question of why so many other statements are
-            // inside of it), so this guarantee should never trip.
-            if (keys_available_cond != NULL) {
-                guarantee(!decremented_updates_left);
-                guarantee(new_keys_out->size() == 0);
-                guarantee(*updates_left > 0);
-                if (--*updates_left == 0) {
-                    keys_available_cond->pulse();
-                }
+            promise_t<superblock_t *> return_superblock_local;
+            {
+                keyvalue_location_t kv_location;
+
+                rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
+                find_keyvalue_location_for_write(
+                    &sizer,
+                    superblock,
+                    it->first.btree_key(),
+                    deletion_context->balancing_detacher(),
+                    &kv_location,
+                    &sindex->btree->stats,
+                    trace,
+                    &return_superblock_local);
+
+                ql::serialization_result_t res =
+                    kv_location_set(&kv_location, it->first,
+                                    sindex_value_ref(
+                                        sindex_info, it->second, added,
+                                        modification->info.added.second),
+                                    repli_timestamp_t::distant_past,
+                                    deletion_context);
+                // this particular context cannot fail AT THE MOMENT.
+                guarantee(!bad(res));
+                // The keyvalue location gets destroyed here.
             }
+            superblock = return_superblock_local.wait();
         }
     } else {
+        // Either there's no new row, or it's dropped from the index because its
+        // keys couldn't be computed.
         if (keys_available_cond != NULL) {
             guarantee(*updates_left > 0);
             if (--*updates_left == 0) {
@@ -1555,123 +2283,181 @@ void rdb_update_sindexes(
     }
 }
 
-class post_construct_traversal_helper_t : public btree_traversal_helper_t {
+/* Collects the entries for a secondary index that's being post constructed, and
+hands them back in key order.  Entries are kept in memory until they take up
+`max_run_size` bytes, at which point they're sorted and written to disk as a run.
+Once all entries are in, the runs are merged. */
+class sindex_entry_sorter_t {
 public:
-    post_construct_traversal_helper_t(
-            store_t *store,
-            const std::set<uuid_u> &sindexes_to_post_construct,
-            cond_t *interrupt_myself,
-            signal_t *interruptor
-            )
-        : store_(store),
-          sindexes_to_post_construct_(sindexes_to_post_construct),
-          interrupt_myself_(interrupt_myself), interruptor_(interruptor)
-    { }
+    typedef std::pair<store_key_t, std::vector<char> > entry_t;
+
+    sindex_entry_sorter_t(store_t *_store, size_t _max_run_size)
+        : store(_store), max_run_size(_max_run_size), entries_size(0),
+          next_entry(0) { }
+
+    // Can block, and can be called by several coroutines at once.
+    void push(entry_t &&entry) {
+        entries_size += entry_size(entry);
+        entries.push_back(std::move(entry));
+        if (entries_size >= max_run_size) {
+            spill_run();
+        }
+    }
 
-    void process_a_leaf(buf_lock_t *leaf_node_buf,
-                        const btree_key_t *, const btree_key_t *,
-                        signal_t *, int *) THROWS_ONLY(interrupted_exc_t) {
+    // Must be called after the last `push()` and before the first `pop()`.
+    void finish() {
+        if (runs.empty()) {
+            std::sort(entries.begin(), entries.end(), &entry_lt);
+        } else {
+            spill_run();
+            for (size_t run = 0; run < runs.size(); ++run) {
+                pop_run(run);
+            }
+        }
+    }
 
-        scoped_ptr_t<txn_t> wtxn;
-        store_t::sindex_access_vector_t sindexes;
+    // Returns false once there are no entries left.  Can block.
+    bool pop(entry_t *entry_out) {
+        if (runs.empty()) {
+            if (next_entry == entries.size()) {
+                return false;
+            }
+            *entry_out = std::move(entries[next_entry]);
+            ++next_entry;
+            return true;
+        }
+        if (merge_heap.empty()) {
+            return false;
+        }
+        std::pop_heap(merge_heap.begin(), merge_heap.end(), &merge_gt);
+        *entry_out = std::move(merge_heap.back().first);
+        const size_t run = merge_heap.back().second;
+        merge_heap.pop_back();
+        pop_run(run);
+        return true;
+    }
 
-        buf_read_t leaf_read(leaf_node_buf);
-        const leaf_node_t *leaf_node
-            = static_cast<const leaf_node_t *>(leaf_read.get_data_read());
-
-        // Number of key/value pairs we process before yielding
-        const int MAX_CHUNK_SIZE = 10;
-        int current_chunk_size = 0;
-        const rdb_post_construction_deletion_context_t deletion_context;
-        for (auto it = leaf::begin(*leaf_node); it != leaf::end(*leaf_node); ++it) {
-            if (current_chunk_size == 0) {
-                // Start a write transaction and acquire the secondary index
-                // at the beginning of each chunk. We reset the transaction
-                // after each chunk because large write transactions can cause
-                // the cache to go into throttling, and that would interfere
-                // with other transactions on this table.
-                try {
-                    write_token_t token;
-                    store_->new_write_token(&token);
-
-                    scoped_ptr_t<real_superblock_t> superblock;
-
-                    // We use HARD durability because we want post construction
-                    // to be throttled if we insert data faster than it can
-                    // be written to disk. Otherwise we might exhaust the cache's
-                    // dirty page limit and bring down the whole table.
-                    // Other than that, the hard durability guarantee is not actually
-                    // needed here.
-                    store_->acquire_superblock_for_write(
-                            repli_timestamp_t::distant_past,
-                            2 + MAX_CHUNK_SIZE,
-                            write_durability_t::HARD,
-                            &token,
-                            &wtxn,
-                            &superblock,
-                            interruptor_);
+private:
+    static size_t entry_size(const entry_t &entry) {
+        return sizeof(entry_t) + entry.second.size();
+    }
 
-                    // Acquire the sindex block.
-                    const block_id_t sindex_block_id = superblock->get_sindex_block_id();
+    static bool entry_lt(const entry_t &a, const entry_t &b) {
+        return a.first < b.first;
+    }
 
-                    buf_lock_t sindex_block(superblock->expose_buf(), sindex_block_id,
-                                            access_t::write);
+    // The ordering of `merge_heap`, which keeps the least key on top.
+    static bool merge_gt(const std::pair<entry_t, size_t> &a,
+                         const std::pair<entry_t, size_t> &b) {
+        return b.first.first < a.first.first;
+    }
 
-                    superblock.reset();
+    void spill_run() {
+        // Other coroutines can push while we're writing the run.
+        std::vector<entry_t> run_entries;
+        run_entries.swap(entries);
+        entries_size = 0;
+        std::sort(run_entries.begin(), run_entries.end(), &entry_lt);
+
+        disk_backed_queue_t<entry_t> *run = new disk_backed_queue_t<entry_t>(
+            store->io_backender_,
+            serializer_filepath_t(store->base_path_,
+                                  "post_construction_" + uuid_to_str(generate_uuid())),
+            &runs_stats);
+        runs.push_back(scoped_ptr_t<disk_backed_queue_t<entry_t> >(run));
+        // Each push is a transaction on the run's cache, so we keep them small.
+        for (size_t i = 0; i < run_entries.size();
+             i += SINDEX_POST_CONSTRUCTION_CHUNK_SIZE) {
+            const size_t end = std::min<size_t>(
+                i + SINDEX_POST_CONSTRUCTION_CHUNK_SIZE, run_entries.size());
+            run->push(std::vector<entry_t>(
+                std::make_move_iterator(run_entries.begin() + i),
+                std::make_move_iterator(run_entries.begin() + end)));
+        }
+    }
 
-                    store_->acquire_sindex_superblocks_for_write(
-                            sindexes_to_post_construct_,
-                            &sindex_block,
-                            &sindexes);
+    // Moves the next entry of `run` onto `merge_heap`, if there is one.
+    void pop_run(size_t run) {
+        if (runs[run]->empty()) {
+            return;
+        }
+        entry_t entry;
+        runs[run]->pop(&entry);
+        merge_heap.push_back(std::make_pair(std::move(entry), run));
+        std::push_heap(merge_heap.begin(), merge_heap.end(), &merge_gt);
+    }
 
-                    if (sindexes.empty()) {
-                        interrupt_myself_->pulse_if_not_already_pulsed();
-                        return;
-                    }
-                } catch (const interrupted_exc_t &e) {
-                    return;
-                }
-            }
+    store_t *const store;
+    const size_t max_run_size;
 
-            store_->btree->stats.pm_keys_read.record();
-            store_->btree->stats.pm_total_keys_read += 1;
-
-            /* Grab relevant values from the leaf node. */
-            const btree_key_t *key = (*it).first;
-            const void *value = (*it).second;
-            guarantee(key);
-
-            const store_key_t pk(key);
-            rdb_modification_report_t mod_report(pk);
-            const rdb_value_t *rdb_value = static_cast<const rdb_value_t *>(value);
-            const max_block_size_t block_size = leaf_node_buf->cache()->max_block_size();
-            mod_report.info.added
-                = std::make_pair(
-                    get_data(rdb_value, buf_parent_t(leaf_node_buf)),
-                    std::vector<char>(rdb_value->value_ref(),
-                        rdb_value->value_ref() + rdb_value->inline_size(block_size)));
-
-            rdb_update_sindexes(store_,
-                                sindexes,
-                                &mod_report,
-                                wtxn.get(),
-                                &deletion_context,
-                                NULL,
-                                NULL,
-                                NULL);
-            store_->btree->stats.pm_keys_set.record();
-            store_->btree->stats.pm_total_keys_set += 1;
-
-            ++current_chunk_size;
-            if (current_chunk_size >= MAX_CHUNK_SIZE) {
-                current_chunk_size = 0;
-                // Release the write transaction and yield.
-                // We continue later where we have left off.
-                sindexes.clear();
-                wtxn.reset();
-                coro_t::yield();
+    std::vector<entry_t> entries;
+    size_t entries_size;
+    // Where `pop()` is in `entries`, if nothing was written to disk.
+    size_t next_entry;
+
+    perfmon_collection_t runs_stats;
+    std::vector<scoped_ptr_t<disk_backed_queue_t<entry_t> > > runs;
+    std::vector<std::pair<entry_t, size_t> > merge_heap;
+
+    DISABLE_COPYING(sindex_entry_sorter_t);
+};
+
+class post_construct_traversal_helper_t : public btree_traversal_helper_t {
+public:
+    post_construct_traversal_helper_t(
+            store_t *store,
+            const std::vector<sindex_disk_info_t> *sindex_infos,
+            const std::vector<scoped_ptr_t<sindex_entry_sorter_t> > *sorters)
+        : store_(store), sindex_infos_(sindex_infos), sorters_(sorters),
+          leaves_in_flight_(SINDEX_POST_CONSTRUCTION_LEAVES_PER_THREAD
+                            * get_num_db_threads()),
+          next_thread_(0)
+    { }
+
+    void process_a_leaf(buf_lock_t *leaf_node_buf,
+                        const btree_key_t *, const btree_key_t *,
+                        signal_t *interruptor, int *) THROWS_ONLY(interrupted_exc_t) {
+        scoped_ptr_t<new_semaphore_acq_t> slot(
+            new new_semaphore_acq_t(&leaves_in_flight_, 1));
+        wait_interruptible(slot->acquisition_signal(), interruptor);
+
+        // We only copy the rows out of the leaf here.  Their index keys get computed
+        // on the other db threads while we go on with the traversal.
+        scoped_ptr_t<std::vector<row_t> > rows(new std::vector<row_t>());
+        {
+            buf_read_t leaf_read(leaf_node_buf);
+            const leaf_node_t *leaf_node
+                = static_cast<const leaf_node_t *>(leaf_read.get_data_read());
+            const max_block_size_t block_size
+                = leaf_node_buf->cache()->max_block_size();
+
+            for (auto it = leaf::begin(*leaf_node); it != leaf::end(*leaf_node); ++it) {
+                store_->btree->stats.pm_keys_read.record();
+                store_->btree->stats.pm_total_keys_read += 1;
+
+                /* Grab relevant values from the leaf node. */
+                const btree_key_t *key = (*it).first;
+                const void *value = (*it).second;
+                guarantee(key);
+
+                const rdb_value_t *rdb_value = static_cast<const rdb_value_t *>(value);
+                row_t row;
+                row.primary_key = store_key_t(key);
+                row.serialized_doc
+                    = get_serialized_data(rdb_value, buf_parent_t(leaf_node_buf));
+                // The index entries point at the same value as the row does.
+                row.value_ref.assign(
+                    rdb_value->value_ref(),
+                    rdb_value->value_ref() + rdb_value->inline_size(block_size));
+                rows->push_back(std::move(row));
             }
         }
+
+        store_->throttle_index_build(rows->size(), interruptor);
+
+        coro_t::spawn_sometime(std::bind(
+            &post_construct_traversal_helper_t::compute_entries, this,
+            rows.release(), slot.release(), drainer_.lock()));
     }
 
     void postprocess_internal_node(buf_lock_t *) { }
@@ -1688,29 +2474,169 @@ public:
     access_t btree_superblock_mode() { return access_t::read; }
     access_t btree_node_mode() { return access_t::read; }
 
+private:
+    struct row_t {
+        store_key_t primary_key;
+        std::string serialized_doc;
+        std::vector<char> value_ref;
+    };
+
+    // Computes the index entries of `rows` on the next db thread in turn, and hands
+    // them to the sorters.  Takes ownership of `_rows` and `_slot`.
+    void compute_entries(std::vector<row_t> *_rows,
+                         new_semaphore_acq_t *_slot,
+                         auto_drainer_t::lock_t) {
+        scoped_ptr_t<std::vector<row_t> > rows(_rows);
+        scoped_ptr_t<new_semaphore_acq_t> slot(_slot);
+
+        // Pushing the entries can block, so we collect them first.
+        std::vector<std::vector<sindex_entry_sorter_t::entry_t> >
+            entries(sorters_->size());
+        {
+            // Secondary index functions are deterministic, and datums and compiled
+            // functions are atomically reference-counted, so any thread can do this.
+            on_thread_t thread_switcher(
+                threadnum_t(next_thread_++ % get_num_db_threads()));
+            for (auto &&row : *rows) {
+                ql::datum_t doc;
+                string_read_stream_t read_stream(std::move(row.serialized_doc), 0);
+                archive_result_t res = datum_deserialize(&read_stream, &doc);
+                guarantee_deserialization(res, "rdb value");
+
+                for (size_t i = 0; i < sindex_infos_->size(); ++i) {
+                    std::vector<std::pair<store_key_t, ql::datum_t> > keys;
+                    try {
+                        compute_keys(row.primary_key, doc, (*sindex_infos_)[i], &keys);
+                    } catch (const ql::base_exc_t &) {
+                        // Like `rdb_update_single_sindex()`, we drop the row from
+                        // the index.
+                        continue;
+                    }
+                    for (auto &&pair : keys) {
+                        entries[i].push_back(std::make_pair(
+                            std::move(pair.first),
+                            sindex_value_ref((*sindex_infos_)[i], pair.second, doc,
+                                             row.value_ref)));
+                    }
+                }
+            }
+            rows.reset();
+        }
+
+        for (size_t i = 0; i < entries.size(); ++i) {
+            for (auto &&entry : entries[i]) {
+                (*sorters_)[i]->push(std::move(entry));
+            }
+        }
+    }
+
     store_t *store_;
-    const std::set<uuid_u> &sindexes_to_post_construct_;
-    cond_t *interrupt_myself_;
-    signal_t *interruptor_;
+    const std::vector<sindex_disk_info_t> *sindex_infos_;
+    const std::vector<scoped_ptr_t<sindex_entry_sorter_t> > *sorters_;
+
+    // Bounds how many leaves' rows we hold on to while their keys are computed.
+    new_semaphore_t leaves_in_flight_;
+    size_t next_thread_;
+
+    // `compute_entries()` holds a lock on this.
+    auto_drainer_t drainer_;
 };
 
+/* Writes the sorted entries of `sorter` into the secondary index `sindex_id`.  The
+index was created empty, and nothing else writes to it until post construction
+is done (writes to the table are queued up in the meantime), so we can build the
+tree bottom-up instead of inserting the entries one by one. */
+void bulk_load_sindex(store_t *store, uuid_u sindex_id,
+                      sindex_entry_sorter_t *sorter, signal_t *interruptor)
+    THROWS_ONLY(interrupted_exc_t) {
+    rdb_value_sizer_t sizer(store->cache->max_block_size());
+    btree_bulk_loader_t loader(&sizer, SINDEX_BULK_LOAD_FILL_FACTOR);
+    const std::set<uuid_u> sindex_ids = { sindex_id };
+
+    bool has_last_key = false;
+    store_key_t last_key;
+    for (;;) {
+        // Read the next chunk before we start the write transaction, since reading
+        // from disk can block.
+        std::vector<sindex_entry_sorter_t::entry_t> chunk;
+        sindex_entry_sorter_t::entry_t entry;
+        while (chunk.size() < SINDEX_POST_CONSTRUCTION_CHUNK_SIZE
+               && sorter->pop(&entry)) {
+            // Index keys end in the primary key, so there shouldn't be any
+            // duplicates.  But the tree can't take them, so we make sure.
+            if (has_last_key && entry.first == last_key) {
+                continue;
+            }
+            last_key = entry.first;
+            has_last_key = true;
+            chunk.push_back(std::move(entry));
+        }
+        if (chunk.empty()) {
+            return;
+        }
+
+        write_token_t token;
+        store->new_write_token(&token);
+
+        scoped_ptr_t<txn_t> wtxn;
+        scoped_ptr_t<real_superblock_t> superblock;
+
+        // We use HARD durability because we want post construction
+        // to be throttled if we insert data faster than it can
+        // be written to disk. Otherwise we might exhaust the cache's
+        // dirty page limit and bring down the whole table.
+        // Other than that, the hard durability guarantee is not actually
+        // needed here.
+        store->acquire_superblock_for_write(
+                repli_timestamp_t::distant_past,
+                2 + chunk.size(),
+                write_durability_t::HARD,
+                &token,
+                &wtxn,
+                &superblock,
+                interruptor);
+
+        store_t::sindex_access_vector_t sindexes;
+        {
+            buf_lock_t sindex_block(superblock->expose_buf(),
+                                    superblock->get_sindex_block_id(),
+                                    access_t::write);
+            superblock.reset();
+            store->acquire_sindex_superblocks_for_write(
+                    sindex_ids, &sindex_block, &sindexes);
+        }
+        // Once the index is being deleted, its tree gets cleared.
+        if (sindexes.empty() || sindexes[0]->sindex.being_deleted) {
+            return;
+        }
+
+        for (const auto &chunk_entry : chunk) {
+            loader.append(sindexes[0]->superblock.get(),
+                          chunk_entry.first.btree_key(),
+                          chunk_entry.second.data(),
+                          repli_timestamp_t::distant_past,
+                          &sindexes[0]->btree->stats);
+        }
+        loader.release();
+
+        // Release the write transaction and yield, so that we don't get in the way
+        // of other transactions on this table.
+        sindexes.clear();
+        wtxn.reset();
+        coro_t::yield();
+    }
+}
+
 void post_construct_secondary_indexes(
         store_t *store,
         const std::set<uuid_u> &sindexes_to_post_construct,
         signal_t *interruptor)
     THROWS_ONLY(interrupted_exc_t) {
-    cond_t local_interruptor;
-
-    wait_any_t wait_any(&local_interruptor, interruptor);
-
-    post_construct_traversal_helper_t helper(store,
-            sindexes_to_post_construct, &local_interruptor, interruptor);
     /* Notice the ordering of progress_tracker and insertion_sentries matters.
      * insertion_sentries puts pointers in the progress tracker map. Once
      * insertion_sentries is destructed nothing has a reference to
      * progress_tracker so we know it's safe to destruct it. */
     parallel_traversal_progress_t progress_tracker;
-    helper.progress = &progress_tracker;
 
     std::vector<map_insertion_sentry_t<uuid_u, const parallel_traversal_progress_t *> >
         insertion_sentries(sindexes_to_post_construct.size());
@@ -1720,29 +2646,76 @@ void post_construct_secondary_indexes(
         store->add_progress_tracker(&*sentry, *it, &progress_tracker);
     }
 
-    read_token_t read_token;
-    store->new_read_token(&read_token);
-
-    // Mind the destructor ordering.
-    // The superblock must be released before txn (`btree_parallel_traversal`
-    // usually already takes care of that).
-    // The txn must be destructed before the cache_account.
-    cache_account_t cache_account;
-    scoped_ptr_t<txn_t> txn;
-    scoped_ptr_t<real_superblock_t> superblock;
+    std::vector<uuid_u> sindex_ids;
+    std::vector<sindex_disk_info_t> sindex_infos;
+    std::vector<scoped_ptr_t<sindex_entry_sorter_t> > sorters;
+    {
+        read_token_t read_token;
+        store->new_read_token(&read_token);
+
+        // Mind the destructor ordering.
+        // The superblock must be released before txn (`btree_parallel_traversal`
+        // usually already takes care of that).
+        // The txn must be destructed before the cache_account.
+        cache_account_t cache_account;
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+
+        store->acquire_superblock_for_read(
+            &read_token,
+            &txn,
+            &superblock,
+            interruptor,
+            true /* USE_SNAPSHOT */);
+
+        cache_account
+            = txn->cache()->create_cache_account(SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY);
+        txn->set_account(&cache_account);
 
-    store->acquire_superblock_for_read(
-        &read_token,
-        &txn,
-        &superblock,
-        interruptor,
-        true /* USE_SNAPSHOT */);
+        {
+            buf_lock_t sindex_block(superblock->expose_buf(),
+                                    superblock->get_sindex_block_id(),
+                                    access_t::read);
+            std::map<sindex_name_t, secondary_index_t> sindexes;
+            get_secondary_indexes(&sindex_block, &sindexes);
+            for (const auto &pair : sindexes) {
+                if (sindexes_to_post_construct.count(pair.second.id) == 0
+                    || pair.second.being_deleted) {
+                    continue;
+                }
+                sindex_disk_info_t info;
+                try {
+                    deserialize_sindex_info(pair.second.opaque_definition, &info);
+                } catch (const archive_exc_t &e) {
+                    crash("%s", e.what());
+                }
+                sindex_ids.push_back(pair.second.id);
+                sindex_infos.push_back(std::move(info));
+            }
+        }
+        if (sindex_ids.empty()) {
+            return;
+        }
+        for (size_t i = 0; i < sindex_ids.size(); ++i) {
+            sorters.push_back(make_scoped<sindex_entry_sorter_t>(
+                store, SINDEX_POST_CONSTRUCTION_SORT_MEMORY / sindex_ids.size()));
+        }
 
-    cache_account
-        = txn->cache()->create_cache_account(SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY);
-    txn->set_account(&cache_account);
+        post_construct_traversal_helper_t helper(store, &sindex_infos, &sorters);
+        helper.progress = &progress_tracker;
+        btree_parallel_traversal(superblock.get(), &helper, interruptor);
+    }
+    // The traversal stops early when we're interrupted, and we mustn't load a
+    // partial index.
+    if (interruptor->is_pulsed()) {
+        throw interrupted_exc_t();
+    }
 
-    btree_parallel_traversal(superblock.get(), &helper, &wait_any);
+    for (size_t i = 0; i < sindex_ids.size(); ++i) {
+        sorters[i]->finish();
+        bulk_load_sindex(store, sindex_ids[i], sorters[i].get(), interruptor);
+        sorters[i].reset();
+    }
 }
 
 void noop_value_deleter_t::delete_value(buf_parent_t, const void *) const { }
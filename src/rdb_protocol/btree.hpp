@@ -64,6 +64,23 @@ void rdb_get(
     point_read_response_t *response,
     profile::trace_t *trace);
 
+/* Like `rdb_get`, but without acquiring the superblock (see
+`find_keyvalue_optimistically`).  Returns false if that isn't possible, or if the
+value is too big to be stored in the leaf node. */
+bool rdb_get_optimistically(
+    const store_key_t &key,
+    btree_slice_t *slice,
+    cache_t *cache,
+    point_read_response_t *response);
+
+// `keys` have to be sorted.
+void rdb_batched_get(
+    const std::vector<store_key_t> &keys,
+    btree_slice_t *slice,
+    superblock_t *superblock,
+    batched_point_read_response_t *response,
+    profile::trace_t *trace);
+
 struct btree_info_t {
     btree_info_t(btree_slice_t *_slice,
                  repli_timestamp_t _timestamp,
@@ -123,6 +140,26 @@ void rdb_set(const store_key_t &key, ql::datum_t data,
              profile::trace_t *trace,
              promise_t<superblock_t *> *pass_back_superblock = NULL);
 
+/* Like `rdb_set`, but for a datum that's already serialized the way it's stored in
+the B-tree. `mod_info` may be NULL if no one needs the modification report. */
+void rdb_set_serialized(const store_key_t &key,
+                        const std::string &data,
+                        btree_slice_t *slice,
+                        repli_timestamp_t timestamp,
+                        superblock_t *superblock,
+                        const deletion_context_t *deletion_context,
+                        rdb_modification_info_t *mod_info,
+                        promise_t<superblock_t *> *pass_back_superblock);
+
+/* If the keys of `atoms` are increasing and greater than all the keys in the tree,
+appends them with a `btree_bulk_loader_t` instead of inserting them one by one, and
+returns true.  Otherwise returns false without changing anything.  The superblock
+isn't released.  `mod_reports_out` may be NULL if no one needs them. */
+bool rdb_append_serialized(btree_slice_t *slice,
+                           const std::vector<backfill_atom_t> &atoms,
+                           superblock_t *superblock,
+                           std::vector<rdb_modification_report_t> *mod_reports_out);
+
 class rdb_backfill_callback_t {
 public:
     virtual void on_delete_range(
@@ -150,6 +187,11 @@ void rdb_backfill(btree_slice_t *slice, const key_range_t& key_range,
                   parallel_traversal_progress_t *p, signal_t *interruptor)
     THROWS_ONLY(interrupted_exc_t);
 
+/* Only sends the secondary indexes, for a backfill that has no rows to send. */
+void rdb_backfill_sindexes(btree_slice_t *slice, rdb_backfill_callback_t *callback,
+                           buf_lock_t *sindex_block, signal_t *interruptor)
+    THROWS_ONLY(interrupted_exc_t);
+
 
 void rdb_delete(const store_key_t &key, btree_slice_t *slice, repli_timestamp_t
                 timestamp, superblock_t *superblock,
@@ -215,8 +257,24 @@ void rdb_distribution_get(int max_depth,
                           superblock_t *superblock,
                           distribution_read_response_t *response);
 
+/* Digests the rows of `region`, splitting off a new range every
+`BACKFILL_DIGEST_RANGE_ROWS` rows.  If the region has no rows, there are no
+digests. */
+void rdb_backfill_digests(superblock_t *superblock,
+                          const region_t &region,
+                          release_superblock_t release_superblock,
+                          backfill_digests_t *digests_out);
+
+/* Digests the rows of the same ranges as `ranges`. */
+void rdb_backfill_digests_of_ranges(superblock_t *superblock,
+                                    const backfill_digests_t &ranges,
+                                    release_superblock_t release_superblock,
+                                    backfill_digests_t *digests_out);
+
 /* Secondary Indexes */
 
+// The old and new rows, and their values in the leaf.  Only updating the sindexes
+// needs the values, so batched replaces leave them out when there are no sindexes.
 struct rdb_modification_info_t {
     typedef std::pair<ql::datum_t,
                       std::vector<char> > data_pair_t;
@@ -275,15 +333,39 @@ struct sindex_disk_info_t {
     sindex_disk_info_t(const ql::map_wire_func_t &_mapping,
                        const sindex_reql_version_info_t &_mapping_version_info,
                        sindex_multi_bool_t _multi,
-                       sindex_geo_bool_t _geo) :
+                       sindex_geo_bool_t _geo,
+                       const std::vector<std::string> &_covering
+                           = std::vector<std::string>(),
+                       const boost::optional<ql::map_wire_func_t> &_filter
+                           = boost::none) :
         mapping(_mapping), mapping_version_info(_mapping_version_info),
-        multi(_multi), geo(_geo) { }
+        multi(_multi), geo(_geo), covering(_covering), filter(_filter) { }
     ql::map_wire_func_t mapping;
     sindex_reql_version_info_t mapping_version_info;
     sindex_multi_bool_t multi;
     sindex_geo_bool_t geo;
+    /* The top-level fields a covering index stores with its entries, including the
+    primary key, or empty if the index isn't covering.  Reads through a covering
+    index return only these fields of each row. */
+    std::vector<std::string> covering;
+    /* Set for partial indexes, which leave out the rows that this predicate is
+    false for or raises an error on, the way `filter` would. */
+    boost::optional<ql::map_wire_func_t> filter;
 };
 
+/* Returns the value the secondary index entry with index value `index_value` stores
+for the row `doc` whose value is `row_value_ref`.  That's `row_value_ref` itself,
+except for covering indexes, whose entries hold `[index_value, projection]` inline
+in the index's leaves as long as it fits. */
+std::vector<char> sindex_value_ref(const sindex_disk_info_t &info,
+                                   const ql::datum_t &index_value,
+                                   const ql::datum_t &doc,
+                                   const std::vector<char> &row_value_ref);
+
+// The fields of `doc` that are in `covering`.
+ql::datum_t project_covered_fields(const std::vector<std::string> &covering,
+                                   const ql::datum_t &doc);
+
 void serialize_sindex_info(write_message_t *wm,
                            const sindex_disk_info_t &info);
 // Note that this will throw an exception if there's an error rather than just
@@ -293,7 +375,13 @@ void deserialize_sindex_info(const std::vector<char> &data,
     THROWS_ONLY(archive_exc_t);
 
 /* An rdb_modification_cb_t is passed to BTree operations and allows them to
- * modify the secondary while they perform an operation. */
+ * modify the secondary while they perform an operation.
+ *
+ * The constructor acquires the secondary index superblocks and a place in line for
+ * the sindex queue, and then releases `sindex_block`.  Otherwise the next write
+ * would wait for the sindex block while still holding the superblock, and so every
+ * write would be kept out of the primary B-tree until the one before it had
+ * finished. */
 class superblock_queue_t;
 class rdb_modification_report_cb_t {
 public:
@@ -302,11 +390,14 @@ public:
             buf_lock_t *sindex_block,
             auto_drainer_t::lock_t lock);
 
-    scoped_ptr_t<new_mutex_in_line_t> get_in_line();
+    // Must be called in the order the modifications are to be applied to the
+    // secondary indexes.
     void on_mod_report(const rdb_modification_report_t &mod_report,
-                       bool update_pkey_cfeeds,
-                       new_mutex_in_line_t *spot);
+                       bool update_pkey_cfeeds);
     bool has_pkey_cfeeds();
+    // If there are no sindexes, the mod reports only need the datums, not the
+    // values (see `rdb_modification_info_t`).
+    bool has_sindexes() const { return has_sindexes_; }
     void finish(btree_slice_t *btree, superblock_t *superblock);
 
     ~rdb_modification_report_cb_t();
@@ -323,10 +414,10 @@ private:
     /* Fields initialized by the constructor. */
     auto_drainer_t::lock_t lock_;
     store_t *store_;
-    buf_lock_t *sindex_block_;
-
-    /* Fields initialized by calls to on_mod_report */
+    txn_t *txn_;
     store_t::sindex_access_vector_t sindexes_;
+    bool has_sindexes_;
+    scoped_ptr_t<new_mutex_in_line_t> sindex_queue_spot_;
 };
 
 void rdb_update_sindexes(
@@ -1,10 +1,14 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/store.hpp"  // NOLINT(build/include_order)
 
+#include <algorithm>  // NOLINT(build/include_order)
 #include <functional>  // NOLINT(build/include_order)
 
 #include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "btree/compaction.hpp"
 #include "btree/depth_first_traversal.hpp"
+#include "btree/leaf_node.hpp"
 #include "btree/node.hpp"
 #include "btree/operations.hpp"
 #include "btree/secondary_operations.hpp"
@@ -12,9 +16,12 @@
 #include "buffer_cache/alt.hpp"
 #include "buffer_cache/cache_balancer.hpp"
 #include "concurrency/wait_any.hpp"
+#include "config/args.hpp"
+#include "containers/archive/boost_types.hpp"
 #include "containers/archive/buffer_stream.hpp"
 #include "containers/archive/vector_stream.hpp"
 #include "containers/archive/versioned.hpp"
+#include "containers/bloom_filter.hpp"
 #include "containers/disk_backed_queue.hpp"
 #include "containers/scoped.hpp"
 #include "logger.hpp"
@@ -78,9 +85,18 @@ store_t::store_t(serializer_t *serializer,
                         ? NULL
                         : new ql::changefeed::server_t(ctx->manager)),
       index_report(_index_report),
-      table_id(_table_id)
+      table_id(_table_id),
+      building_key_filter(false),
+      keys_written_since_compaction(0),
+      keys_written_before_compaction(STORE_COMPACTION_MIN_KEYS_WRITTEN),
+      compaction_start_time(0),
+      index_build_rate(DEFAULT_TABLE_INDEX_BUILD_RATE),
+      index_build_next_time(0)
 {
-    cache.init(new cache_t(serializer, balancer, &perfmon_collection));
+    // Tables serve point reads alongside scans and backfills, which would
+    // otherwise flush their working set out of the cache.
+    cache.init(new cache_t(serializer, balancer, &perfmon_collection,
+                           eviction_policy_t::TWO_QUEUE));
     general_cache_conn.init(new cache_conn_t(cache.get()));
 
     if (create) {
@@ -149,9 +165,19 @@ store_t::store_t(serializer_t *serializer,
         }
 
         update_outdated_sindex_list(&sindex_block);
+
+        int64_t population;
+        if (get_btree_population(superblock.get(), &population)) {
+            keys_written_before_compaction = std::max<uint64_t>(
+                keys_written_before_compaction, population);
+        }
     }
 
     help_construct_bring_sindexes_up_to_date();
+
+    building_key_filter = true;
+    coro_t::spawn_sometime(std::bind(&store_t::build_key_filter, this,
+                                     drainer.lock()));
 }
 
 store_t::~store_t() {
@@ -163,6 +189,200 @@ store_t::~store_t() {
     }
 }
 
+class key_filter_traversal_cb_t : public depth_first_traversal_callback_t {
+public:
+    key_filter_traversal_cb_t(bloom_filter_t *_filter, signal_t *_interruptor)
+        : filter(_filter), interruptor(_interruptor) { }
+
+    done_traversing_t handle_pair(scoped_key_value_t &&keyvalue) {
+        const btree_key_t *key = keyvalue.key();
+        filter->add(key->contents, key->size);
+        return interruptor->is_pulsed() ? done_traversing_t::YES : done_traversing_t::NO;
+    }
+
+private:
+    bloom_filter_t *const filter;
+    signal_t *const interruptor;
+};
+
+void store_t::build_key_filter(auto_drainer_t::lock_t store_keepalive)
+    THROWS_NOTHING {
+    assert_thread();
+    guarantee(building_key_filter && !next_key_filter.has());
+    try {
+        int64_t population = 0;
+        {
+            read_token_t token;
+            new_read_token(&token);
+            scoped_ptr_t<txn_t> txn;
+            scoped_ptr_t<real_superblock_t> superblock;
+            acquire_superblock_for_read(&token, &txn, &superblock,
+                                        store_keepalive.get_drain_signal(), false);
+            get_btree_population(superblock.get(), &population);
+        }
+        const int64_t expected_keys =
+            std::min<int64_t>(std::max<int64_t>(2 * population,
+                                                STORE_KEY_FILTER_MIN_KEYS),
+                              STORE_KEY_FILTER_MAX_KEYS);
+        next_key_filter.init(new bloom_filter_t(expected_keys,
+                                                STORE_KEY_FILTER_BITS_PER_KEY));
+
+        // From here on, writes add their keys to `next_key_filter`.  Writes that
+        // added their keys before are ordered before our snapshot, which we enter the
+        // line for without blocking, so the traversal sees their keys.
+        read_token_t token;
+        new_read_token(&token);
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        acquire_superblock_for_read(&token, &txn, &superblock,
+                                    store_keepalive.get_drain_signal(), true);
+        key_filter_traversal_cb_t callback(next_key_filter.get(),
+                                           store_keepalive.get_drain_signal());
+        if (btree_depth_first_traversal(superblock.get(), key_range_t::universe(),
+                                        &callback, FORWARD,
+                                        release_superblock_t::RELEASE)) {
+            key_filter = std::move(next_key_filter);
+        }
+    } catch (const interrupted_exc_t &) {
+        // The store is shutting down.
+    }
+    next_key_filter.reset();
+    building_key_filter = false;
+}
+
+void store_t::add_to_key_filter(const store_key_t &key) {
+    assert_thread();
+    if (key_filter.has()) {
+        key_filter->add(key.contents(), key.size());
+    }
+    if (next_key_filter.has()) {
+        next_key_filter->add(key.contents(), key.size());
+    }
+    // Every key that gets written comes through here, so this is also where we count
+    // them towards the next compaction.
+    ++keys_written_since_compaction;
+    if (compaction_start_time == 0
+        && keys_written_since_compaction > keys_written_before_compaction) {
+        keys_written_since_compaction = 0;
+        compaction_start_time = current_microtime();
+        coro_t::spawn_sometime(std::bind(&store_t::compact, this, drainer.lock()));
+    }
+    if (!building_key_filter && key_filter.has()
+        && key_filter->num_added() > key_filter->expected_elements()
+        && key_filter->expected_elements() < STORE_KEY_FILTER_MAX_KEYS) {
+        // Too many false positives from here on, so we build a bigger filter.  This
+        // also gets rid of the keys that have been deleted since the last one.
+        building_key_filter = true;
+        coro_t::spawn_sometime(std::bind(&store_t::build_key_filter, this,
+                                         drainer.lock()));
+    }
+}
+
+void store_t::compact(auto_drainer_t::lock_t store_keepalive) THROWS_NOTHING {
+    assert_thread();
+    guarantee(compaction_start_time != 0);
+    with_priority_t p(CORO_PRIORITY_STORE_COMPACTION);
+    signal_t *interruptor = store_keepalive.get_drain_signal();
+    try {
+        // The txns must be destroyed before the cache account.
+        cache_account_t cache_account
+            = cache->create_cache_account(STORE_COMPACTION_CACHE_PRIORITY);
+
+        int64_t population = 0;
+        compact_btree(boost::none, &cache_account, &population, interruptor);
+
+        std::set<uuid_u> sindex_ids;
+        {
+            read_token_t token;
+            new_read_token(&token);
+            scoped_ptr_t<txn_t> txn;
+            scoped_ptr_t<real_superblock_t> superblock;
+            acquire_superblock_for_read(&token, &txn, &superblock, interruptor,
+                                        false);
+            buf_lock_t sindex_block(superblock->expose_buf(),
+                                    superblock->get_sindex_block_id(),
+                                    access_t::read);
+            superblock->release();
+            std::map<sindex_name_t, secondary_index_t> sindexes;
+            get_secondary_indexes(&sindex_block, &sindexes);
+            for (const auto &pair : sindexes) {
+                if (!pair.first.being_deleted) {
+                    sindex_ids.insert(pair.second.id);
+                }
+            }
+        }
+        for (const uuid_u &id : sindex_ids) {
+            compact_btree(id, &cache_account, NULL, interruptor);
+        }
+
+        keys_written_before_compaction = std::max<uint64_t>(
+            STORE_COMPACTION_MIN_KEYS_WRITTEN, population);
+    } catch (const interrupted_exc_t &) {
+        // The store is shutting down.
+    }
+    compaction_start_time = 0;
+}
+
+void store_t::compact_btree(const boost::optional<uuid_u> &sindex_id,
+                            cache_account_t *cache_account,
+                            int64_t *population_out,
+                            signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t) {
+    store_key_t start = store_key_t::min();
+    for (done_traversing_t done = done_traversing_t::NO;
+         done == done_traversing_t::NO;) {
+        if (interruptor->is_pulsed()) {
+            throw interrupted_exc_t();
+        }
+        // Each pass holds up the writes behind it, so it only rewrites a few leaves
+        // and then gets back in line.  The cache flushes the passes together.
+        write_token_t token;
+        new_write_token(&token);
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        acquire_superblock_for_write(repli_timestamp_t::distant_past,
+                                     2 + STORE_COMPACTION_LEAVES_PER_PASS,
+                                     write_durability_t::SOFT,
+                                     &token,
+                                     &txn,
+                                     &superblock,
+                                     interruptor);
+        txn->set_account(cache_account);
+
+        if (!static_cast<bool>(sindex_id)) {
+            if (population_out != NULL) {
+                get_btree_population(superblock.get(), population_out);
+            }
+            done = btree_compact_nodes(superblock.get(),
+                                       STORE_COMPACTION_LEAVES_PER_PASS,
+                                       &start);
+            continue;
+        }
+
+        buf_lock_t sindex_block(superblock->expose_buf(),
+                                superblock->get_sindex_block_id(),
+                                access_t::write);
+        superblock->release();
+        sindex_access_vector_t sindex_sbs;
+        if (!acquire_sindex_superblocks_for_write(
+                boost::make_optional(std::set<uuid_u>{*sindex_id}),
+                &sindex_block,
+                &sindex_sbs)) {
+            // The index has been dropped.
+            return;
+        }
+        sindex_block.reset_buf_lock();
+        done = btree_compact_nodes(sindex_sbs[0]->superblock.get(),
+                                   STORE_COMPACTION_LEAVES_PER_PASS,
+                                   &start);
+    }
+}
+
+bool store_t::key_filter_excludes(const store_key_t &key) const {
+    assert_thread();
+    return key_filter.has() && !key_filter->may_contain(key.contents(), key.size());
+}
+
 void store_t::read(
         DEBUG_ONLY(const metainfo_checker_t& metainfo_checker, )
         const read_t &read,
@@ -172,18 +392,46 @@ void store_t::read(
         signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t) {
     assert_thread();
+    // The shard evaluates a low-priority read at the query's priority, like the
+    // parsing server does.
+    scoped_ptr_t<with_priority_t> coro_priority;
+    if (read.priority == query_priority_t::LOW) {
+        coro_priority.init(new with_priority_t(CORO_PRIORITY_LOW_PRIORITY_QUERY));
+    }
     scoped_ptr_t<txn_t> txn;
     scoped_ptr_t<real_superblock_t> superblock;
 
-    acquire_superblock_for_read(token, &txn, &superblock,
-                                interruptor,
-                                read.use_snapshot());
+    {
+        object_buffer_t<fifo_enforcer_sink_t::exit_read_t>::destruction_sentinel_t
+            destroyer(&token->main_read_token);
+        wait_interruptible(token->main_read_token.get(), interruptor);
+
+        // Point reads first try not to acquire the superblock at all, so that they
+        // don't wait in line behind writes.  (That skips the metainfo check, which
+        // needs the superblock.)
+        if (protocol_read_optimistically(read, response)) {
+            return;
+        }
+
+        cache_snapshotted_t cache_snapshotted =
+            read.use_snapshot() ? CACHE_SNAPSHOTTED_YES : CACHE_SNAPSHOTTED_NO;
+        get_btree_superblock_and_txn_for_reading(
+            general_cache_conn.get(), cache_snapshotted, &superblock, &txn);
+    }
+    if (read.priority == query_priority_t::LOW) {
+        txn->set_account(btree->get_low_priority_query_account());
+    }
 
     DEBUG_ONLY(check_metainfo(DEBUG_ONLY(metainfo_checker, ) superblock.get());)
 
     protocol_read(read, response, superblock.get(), interruptor);
 }
 
+void store_t::prefetch_for_write(const write_t &write) {
+    assert_thread();
+    protocol_prefetch_for_write(write);
+}
+
 void store_t::write(
         DEBUG_ONLY(const metainfo_checker_t& metainfo_checker, )
         const region_map_t<binary_blob_t>& new_metainfo,
@@ -197,12 +445,21 @@ void store_t::write(
         THROWS_ONLY(interrupted_exc_t) {
     assert_thread();
 
+    // The key filter has to have our keys before reads that come after us check it,
+    // and they can do that as soon as we're in line for the superblock.
+    protocol_add_to_key_filter(write);
+
     scoped_ptr_t<txn_t> txn;
     scoped_ptr_t<real_superblock_t> real_superblock;
     const int expected_change_count = 2; // FIXME: this is incorrect, but will do for now
     acquire_superblock_for_write(timestamp.to_repli_timestamp(),
                                  expected_change_count, durability, token,
                                  &txn, &real_superblock, interruptor);
+    // Writes keep their coroutine priority, since the ones behind them in line for
+    // the superblock would wait too, but load their blocks at the lower priority.
+    if (write.priority == query_priority_t::LOW) {
+        txn->set_account(btree->get_low_priority_query_account());
+    }
 
     check_and_update_metainfo(DEBUG_ONLY(metainfo_checker, ) new_metainfo,
                               real_superblock.get());
@@ -231,7 +488,9 @@ bool store_t::send_backfill(
     get_metainfo_internal(superblock->get(), &unmasked_metainfo);
     region_map_t<binary_blob_t> metainfo = unmasked_metainfo.mask(start_point.get_domain());
     if (send_backfill_cb->should_backfill(metainfo)) {
-        protocol_send_backfill(start_point, send_backfill_cb, superblock.get(), &sindex_block, progress, interruptor);
+        protocol_send_backfill(start_point, send_backfill_cb->get_backfill_digests(),
+                               send_backfill_cb, superblock.get(), &sindex_block,
+                               progress, interruptor);
         return true;
     }
     return false;
@@ -285,6 +544,14 @@ void store_t::receive_backfill(
     assert_thread();
     with_priority_t p(CORO_PRIORITY_BACKFILL_RECEIVER);
 
+    if (const backfill_chunk_t::key_value_pairs_t *kv
+            = boost::get<backfill_chunk_t::key_value_pairs_t>(&chunk.val)) {
+        // Like in `write()`, before we get in line for the superblock.
+        for (auto it = kv->backfill_atoms.begin(); it != kv->backfill_atoms.end(); ++it) {
+            add_to_key_filter(it->key);
+        }
+    }
+
     scoped_ptr_t<txn_t> txn;
     scoped_ptr_t<real_superblock_t> real_superblock;
     const int expected_change_count = 1; // TODO: this is not correct
@@ -368,9 +635,11 @@ void store_t::reset_data(
     // for any ranges.
     maybe_drop_all_sindexes(zero_metainfo, durability, interruptor);
 
-    // Erase the data in small chunks
+    // Erase the data in small chunks.  When the data in `subregion` is all there is and
+    // there are no secondary indexes to update, whole leaves are freed at a time.
     always_true_key_tester_t key_tester;
     const uint64_t max_erased_per_pass = 100;
+    const size_t max_leaves_erased_per_pass = 16;
     for (done_traversing_t done_erasing = done_traversing_t::NO;
          done_erasing == done_traversing_t::NO;) {
         scoped_ptr_t<txn_t> txn;
@@ -395,18 +664,30 @@ void store_t::reset_data(
         an inconsistent state. */
         cond_t non_interruptor;
 
+        std::map<sindex_name_t, secondary_index_t> sindexes;
+        ::get_secondary_indexes(&sindex_block, &sindexes);
+
         rdb_live_deletion_context_t deletion_context;
         std::vector<rdb_modification_report_t> mod_reports;
         key_range_t deleted_range;
-        done_erasing = rdb_erase_small_range(btree.get(),
-                                             &key_tester,
-                                             subregion.inner,
-                                             superblock.get(),
-                                             &deletion_context,
-                                             &non_interruptor,
-                                             max_erased_per_pass,
-                                             &mod_reports,
-                                             &deleted_range);
+        if (sindexes.empty()
+            && btree_keys_are_within(superblock.get(), subregion.inner)) {
+            done_erasing = rdb_erase_subtrees(subregion.inner,
+                                              superblock.get(),
+                                              &deletion_context,
+                                              max_leaves_erased_per_pass,
+                                              &deleted_range);
+        } else {
+            done_erasing = rdb_erase_small_range(btree.get(),
+                                                 &key_tester,
+                                                 subregion.inner,
+                                                 superblock.get(),
+                                                 &deletion_context,
+                                                 &non_interruptor,
+                                                 max_erased_per_pass,
+                                                 &mod_reports,
+                                                 &deleted_range);
+        }
 
         region_map_t<binary_blob_t> old_metainfo;
         get_metainfo_internal(superblock->get(), &old_metainfo);
@@ -567,6 +848,27 @@ progress_completion_fraction_t store_t::get_progress(uuid_u id) {
     }
 }
 
+void store_t::set_index_build_rate(uint64_t docs_per_sec) {
+    assert_thread();
+    index_build_rate = docs_per_sec;
+}
+
+void store_t::throttle_index_build(size_t num_docs, signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t) {
+    assert_thread();
+    const microtime_t now = current_microtime();
+    if (index_build_rate == 0) {
+        index_build_next_time = now;
+        return;
+    }
+    // We don't let post construction save up for a burst while it's idle.
+    const microtime_t start = std::max(now, index_build_next_time);
+    index_build_next_time = start + num_docs * MILLION / index_build_rate;
+    if (start > now) {
+        nap((start - now) / THOUSAND, interruptor);
+    }
+}
+
 bool store_t::add_sindex(
         const sindex_name_t &name,
         const std::vector<char> &opaque_definition,
@@ -805,15 +1107,18 @@ bool secondary_indexes_are_equivalent(const std::vector<char> &left,
 
     if (sindex_info_left.multi == sindex_info_right.multi &&
         sindex_info_left.geo == sindex_info_right.geo &&
+        sindex_info_left.covering == sindex_info_right.covering &&
         sindex_info_left.mapping_version_info.original_reql_version ==
             sindex_info_right.mapping_version_info.original_reql_version) {
-        // Need to determine if the mapping function is the same, re-serialize them
-        // and compare the vectors
+        // Need to determine if the mapping and filter functions are the same,
+        // re-serialize them and compare the vectors
         bool res;
         write_message_t wm_left;
         vector_stream_t stream_left;
         serialize_for_version(cluster_version_t::CLUSTER, &wm_left,
                               sindex_info_left.mapping);
+        serialize_for_version(cluster_version_t::CLUSTER, &wm_left,
+                              sindex_info_left.filter);
         res = send_write_message(&stream_left, &wm_left);
         guarantee(res == 0);
 
@@ -821,6 +1126,8 @@ bool secondary_indexes_are_equivalent(const std::vector<char> &left,
         vector_stream_t stream_right;
         serialize_for_version(cluster_version_t::CLUSTER, &wm_right,
                               sindex_info_right.mapping);
+        serialize_for_version(cluster_version_t::CLUSTER, &wm_right,
+                              sindex_info_right.filter);
         res = send_write_message(&stream_right, &wm_right);
         guarantee(res == 0);
 
@@ -957,6 +1264,153 @@ MUST_USE bool store_t::drop_sindex(
     return true;
 }
 
+void store_t::truncate_data(
+        superblock_t *superblock,
+        buf_lock_t *sindex_block)
+        THROWS_NOTHING {
+    assert_thread();
+
+    /* Replace each secondary index with an empty one that has the same definition.
+    There's nothing to post construct the new one from. */
+    std::map<sindex_name_t, secondary_index_t> sindexes;
+    ::get_secondary_indexes(sindex_block, &sindexes);
+    for (auto it = sindexes.begin(); it != sindexes.end(); ++it) {
+        if (it->first.being_deleted) {
+            continue;
+        }
+        bool success = mark_secondary_index_deleted(sindex_block, it->first);
+        guarantee(success);
+        coro_t::spawn_sometime(std::bind(&store_t::delayed_clear_sindex,
+                                         this,
+                                         it->second,
+                                         drainer.lock()));
+        success = add_sindex(it->first, it->second.opaque_definition, sindex_block);
+        guarantee(success);
+        success = mark_index_up_to_date(it->first, sindex_block);
+        guarantee(success);
+    }
+
+    /* The old primary B-tree is kept under a new virtual superblock until
+    `delayed_clear_truncated_data()` has freed it.  It's listed as a secondary index
+    that's being deleted, so queries and backfills ignore it, and as one that isn't
+    post constructed, so writes don't update it.  Its empty definition tells it apart
+    from the secondary indexes, also when the store is next started up. */
+    const block_id_t old_root = superblock->get_root_block_id();
+    if (old_root != NULL_BLOCK_ID) {
+        secondary_index_t truncated;
+        {
+            buf_lock_t truncated_superblock(sindex_block, alt_create_t::create);
+            btree_slice_t::init_superblock(&truncated_superblock,
+                                           std::vector<char>(),
+                                           binary_blob_t());
+            truncated.superblock = truncated_superblock.block_id();
+            real_superblock_t(std::move(truncated_superblock))
+                .set_root_block_id(old_root);
+        }
+        truncated.post_construction_complete = false;
+        truncated.being_deleted = true;
+        const sindex_name_t truncated_name = compute_sindex_deletion_name(truncated.id);
+        ::set_secondary_index(sindex_block, truncated_name, truncated);
+        secondary_index_slices.insert(
+                std::make_pair(truncated.id,
+                               make_scoped<btree_slice_t>(cache.get(),
+                                                          nullptr,
+                                                          truncated_name.name,
+                                                          index_type_t::SECONDARY)));
+
+        // Readers with a snapshot of the superblock keep seeing the old tree.
+        superblock->expose_buf().detach_child(old_root);
+        coro_t::spawn_sometime(std::bind(&store_t::delayed_clear_truncated_data,
+                                         this,
+                                         truncated,
+                                         drainer.lock()));
+    }
+
+    /* The new root is an empty leaf, rather than no root at all, so that it has the
+    truncation's timestamp as its recency.  A backfill from before the truncation
+    then finds that the leaf lost its deletions, and deletes the whole range on the
+    other side. */
+    {
+        rdb_value_sizer_t sizer(cache->max_block_size());
+        buf_lock_t root(superblock->expose_buf(), alt_create_t::create);
+        buf_write_t write(&root);
+        leaf::init(&sizer, static_cast<leaf_node_t *>(write.get_data_write()));
+        superblock->set_root_block_id(root.block_id());
+    }
+
+    const block_id_t stat_block_id = superblock->get_stat_block_id();
+    if (stat_block_id != NULL_BLOCK_ID) {
+        buf_lock_t stat_block(buf_parent_t(superblock->expose_buf().txn()),
+                              stat_block_id, access_t::write);
+        buf_write_t write(&stat_block);
+        static_cast<btree_statblock_t *>(write.get_data_write(BTREE_STATBLOCK_SIZE))
+            ->population = 0;
+    }
+
+    // The changefeeds can't tell their clients which documents went away.  Keys in
+    // the key filter that aren't in the tree anymore only cost it some precision.
+    if (changefeed_server.has()) {
+        changefeed_server->stop_all();
+    }
+}
+
+void store_t::delayed_clear_truncated_data(
+        secondary_index_t truncated,
+        auto_drainer_t::lock_t store_keepalive)
+        THROWS_NOTHING {
+    try {
+        /* Free the tree a few leaves at a time.  Unlike a secondary index it owns
+        its values, so they're deleted too. */
+        rdb_live_deletion_context_t deletion_context;
+        const size_t max_leaves_erased_per_pass = 16;
+        for (done_traversing_t done_erasing = done_traversing_t::NO;
+             done_erasing == done_traversing_t::NO;) {
+            write_token_t token;
+            new_write_token(&token);
+            scoped_ptr_t<txn_t> txn;
+            scoped_ptr_t<real_superblock_t> superblock;
+            acquire_superblock_for_write(
+                repli_timestamp_t::distant_past,
+                2 + max_leaves_erased_per_pass,
+                write_durability_t::SOFT,
+                &token,
+                &txn,
+                &superblock,
+                store_keepalive.get_drain_signal());
+
+            buf_lock_t sindex_block(superblock->expose_buf(),
+                                    superblock->get_sindex_block_id(),
+                                    access_t::write);
+            superblock->release();
+
+            buf_lock_t truncated_superblock_lock(buf_parent_t(&sindex_block),
+                                                 truncated.superblock,
+                                                 access_t::write);
+            sindex_block.reset_buf_lock();
+            real_superblock_t truncated_superblock(
+                std::move(truncated_superblock_lock));
+
+            key_range_t deleted_range;
+            done_erasing = rdb_erase_subtrees(key_range_t::universe(),
+                                              &truncated_superblock,
+                                              &deletion_context,
+                                              max_leaves_erased_per_pass,
+                                              &deleted_range);
+        }
+
+        /* The tree is empty now, so this only frees its superblock and removes it
+        from the sindex block. */
+        rdb_value_sizer_t sizer(cache->max_block_size());
+        clear_sindex(truncated,
+                     &sizer,
+                     &deletion_context,
+                     store_keepalive.get_drain_signal());
+    } catch (const interrupted_exc_t &e) {
+        /* Ignore. The rest of the tree is freed when the store is next started
+        up. */
+    }
+}
+
 MUST_USE bool store_t::mark_secondary_index_deleted(
         buf_lock_t *sindex_block,
         const sindex_name_t &name) {
@@ -1094,12 +1548,16 @@ void store_t::acquire_all_sindex_superblocks_for_write(
 
 void store_t::acquire_post_constructed_sindex_superblocks_for_write(
         buf_lock_t *sindex_block,
-        sindex_access_vector_t *sindex_sbs_out)
+        sindex_access_vector_t *sindex_sbs_out,
+        bool *has_sindexes_out)
     THROWS_NOTHING {
     assert_thread();
     std::set<sindex_name_t> sindexes_to_acquire;
     std::map<sindex_name_t, secondary_index_t> sindexes;
     ::get_secondary_indexes(sindex_block, &sindexes);
+    if (has_sindexes_out != NULL) {
+        *has_sindexes_out = !sindexes.empty();
+    }
 
     for (auto it = sindexes.begin(); it != sindexes.end(); ++it) {
         /* Note that this can include indexes currently being deleted.
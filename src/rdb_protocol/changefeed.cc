@@ -6,6 +6,9 @@
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/interruptor.hpp"
 #include "containers/archive/boost_types.hpp"
+#include "containers/archive/stl_types.hpp"
+#include "containers/archive/vector_stream.hpp"
+#include "containers/disk_backed_queue.hpp"
 #include "rdb_protocol/btree.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/protocol.hpp"
@@ -46,29 +49,56 @@ std::string print(const msg_t::limit_change_t &change) {
 }
 } // namespace debug
 
+// A change waiting in a subscription's queue.
+struct queued_change_t {
+    queued_change_t() { }
+    queued_change_t(datum_t _old_val, datum_t _new_val, datum_t _resume_token)
+        : old_val(std::move(_old_val)),
+          new_val(std::move(_new_val)),
+          resume_token(std::move(_resume_token)) { }
+    datum_t old_val, new_val;
+    // Empty unless the subscription hands out resume tokens.
+    datum_t resume_token;
+};
+RDB_MAKE_SERIALIZABLE_3(queued_change_t, old_val, new_val, resume_token);
+
 enum class pop_type_t { RANGE, POINT };
 class maybe_squashing_queue_t {
 public:
     virtual ~maybe_squashing_queue_t() { }
-    virtual void add(store_key_t key, datum_t old_val, datum_t new_val) = 0;
+    virtual void add(store_key_t key, datum_t old_val, datum_t new_val,
+                     datum_t resume_token) = 0;
     virtual size_t size() const = 0;
+    // Whether `pop` can be called; a queue may hold changes it can't hand out yet.
+    virtual bool can_pop() const { return size() != 0; }
+    // Once `size` exceeds this the subscription skips the queued changes.
+    virtual size_t capacity(const configured_limits_t &limits) const {
+        return limits.array_size_limit();
+    }
     virtual void clear() = 0;
     virtual datum_t pop(pop_type_t pop_type) {
-        std::pair<datum_t, datum_t> pair = pop_impl();
+        queued_change_t change = pop_impl();
         switch (pop_type) {
-        case pop_type_t::RANGE: return datum_t(std::map<datum_string_t, datum_t>{
-            {datum_string_t("old_val"), pair.first},
-            {datum_string_t("new_val"), pair.second}});
-        case pop_type_t::POINT: return pair.second;
+        case pop_type_t::RANGE: {
+            std::map<datum_string_t, datum_t> m{
+                {datum_string_t("old_val"), std::move(change.old_val)},
+                {datum_string_t("new_val"), std::move(change.new_val)}};
+            if (change.resume_token.has()) {
+                m[datum_string_t("resume_token")] = std::move(change.resume_token);
+            }
+            return datum_t(std::move(m));
+        }
+        case pop_type_t::POINT: return change.new_val;
         default: unreachable();
         }
     }
 private:
-    virtual std::pair<datum_t, datum_t> pop_impl() = 0;
+    virtual queued_change_t pop_impl() = 0;
 };
 
 class squashing_queue_t : public maybe_squashing_queue_t {
-    virtual void add(store_key_t key, datum_t old_val, datum_t new_val) {
+    // Squashed changes don't get resume tokens, since they're out of order.
+    virtual void add(store_key_t key, datum_t old_val, datum_t new_val, datum_t) {
         auto it = queue.find(key);
         if (it == queue.end()) {
             auto pair = std::make_pair(std::move(key),
@@ -94,10 +124,11 @@ class squashing_queue_t : public maybe_squashing_queue_t {
     virtual void clear() {
         queue.clear();
     }
-    virtual std::pair<datum_t, datum_t> pop_impl() {
+    virtual queued_change_t pop_impl() {
         guarantee(size() != 0);
         auto it = queue.begin();
-        auto ret = std::move(it->second);
+        queued_change_t ret(std::move(it->second.first), std::move(it->second.second),
+                            datum_t());
         queue.erase(it);
         return ret;
     }
@@ -105,8 +136,10 @@ class squashing_queue_t : public maybe_squashing_queue_t {
 };
 
 class nonsquashing_queue_t : public maybe_squashing_queue_t {
-    virtual void add(store_key_t, datum_t old_val, datum_t new_val) {
-        queue.emplace_back(std::move(old_val), std::move(new_val));
+    virtual void add(store_key_t, datum_t old_val, datum_t new_val,
+                     datum_t resume_token) {
+        queue.emplace_back(
+            std::move(old_val), std::move(new_val), std::move(resume_token));
     }
     virtual size_t size() const {
         return queue.size();
@@ -114,19 +147,155 @@ class nonsquashing_queue_t : public maybe_squashing_queue_t {
     virtual void clear() {
         queue.clear();
     }
-    virtual std::pair<datum_t, datum_t> pop_impl() {
+    virtual queued_change_t pop_impl() {
         guarantee(size() != 0);
         auto ret = std::move(queue.front());
         queue.pop_front();
         return ret;
     }
-    std::deque<std::pair<datum_t, datum_t> > queue;
+    std::deque<queued_change_t> queue;
+};
+
+// A non-squashing queue for slow readers that keeps at most
+// CHANGEFEED_SPILL_MEMORY_CHANGES changes in memory and spills the rest to a
+// `disk_backed_queue_t`, created the first time it's needed.  A coroutine writes
+// changes out and reads them back in, so `add` and `pop` never block; `on_ready` is
+// called when changes it read back can be popped.
+class spilling_queue_t : public maybe_squashing_queue_t {
+public:
+    spilling_queue_t(rdb_context_t *_ctx, std::function<void()> _on_ready)
+        : ctx(_ctx),
+          on_ready(std::move(_on_ready)),
+          num_writing(0),
+          num_on_disk(0),
+          num_to_discard(0),
+          pumping(false) {
+        guarantee(ctx != NULL && ctx->io_backender != NULL);
+    }
+    virtual void add(store_key_t, datum_t old_val, datum_t new_val,
+                     datum_t resume_token) {
+        queued_change_t change(
+            std::move(old_val), std::move(new_val), std::move(resume_token));
+        if (pending.empty() && num_writing == 0 && num_on_disk == 0
+            && mem.size() < CHANGEFEED_SPILL_MEMORY_CHANGES) {
+            mem.push_back(std::move(change));
+        } else {
+            pending.push_back(std::move(change));
+            maybe_pump();
+        }
+    }
+    virtual size_t size() const {
+        return mem.size() + pending.size()
+            + num_writing + num_on_disk - num_to_discard;
+    }
+    virtual bool can_pop() const { return !mem.empty(); }
+    virtual size_t capacity(const configured_limits_t &) const {
+        return CHANGEFEED_MAX_SPILLED_CHANGES;
+    }
+    virtual void clear() {
+        mem.clear();
+        pending.clear();
+        // We can't drop the changes that are on disk without reading them.
+        num_to_discard = num_writing + num_on_disk;
+    }
+    virtual queued_change_t pop_impl() {
+        guarantee(!mem.empty());
+        auto ret = std::move(mem.front());
+        mem.pop_front();
+        if (mem.size() < CHANGEFEED_SPILL_MEMORY_CHANGES / 2) {
+            maybe_pump();
+        }
+        return ret;
+    }
+
+private:
+    void maybe_pump() {
+        if (!pumping) {
+            pumping = true;
+            coro_t::spawn_sometime(
+                std::bind(&spilling_queue_t::pump, this, drainer.lock()));
+        }
+    }
+
+    // Changes are in `mem`, then on disk, then in `pending`, oldest first.
+    void pump(auto_drainer_t::lock_t keepalive) {
+        while (!keepalive.get_drain_signal()->is_pulsed()) {
+            bool readied = false;
+            if (num_writing == 0 && num_on_disk == 0) {
+                while (!pending.empty()
+                       && mem.size() < CHANGEFEED_SPILL_MEMORY_CHANGES) {
+                    mem.push_back(std::move(pending.front()));
+                    pending.pop_front();
+                    readied = true;
+                }
+            }
+            if (!pending.empty()) {
+                if (!disk.has()) {
+                    disk.init(new disk_backed_queue_t<queued_change_t>(
+                        ctx->io_backender,
+                        serializer_filepath_t(
+                            ctx->base_path,
+                            "changefeed_" + uuid_to_str(generate_uuid())),
+                        &disk_stats));
+                }
+                std::vector<queued_change_t> batch(
+                    std::make_move_iterator(pending.begin()),
+                    std::make_move_iterator(pending.end()));
+                pending.clear();
+                num_writing = batch.size();
+                disk->push(batch);
+                num_on_disk += num_writing;
+                num_writing = 0;
+            } else if (num_on_disk != 0
+                       && mem.size() < CHANGEFEED_SPILL_MEMORY_CHANGES) {
+                // Refill the memory buffer with one transaction rather than one
+                // per change.
+                std::vector<queued_change_t> changes;
+                disk->pop(&changes, CHANGEFEED_SPILL_MEMORY_CHANGES - mem.size());
+                num_on_disk -= changes.size();
+                for (auto &change : changes) {
+                    if (num_to_discard != 0) {
+                        --num_to_discard;
+                    } else {
+                        mem.push_back(std::move(change));
+                        readied = true;
+                    }
+                }
+            } else if (!readied) {
+                break;
+            }
+            if (readied) {
+                on_ready();
+            }
+        }
+        pumping = false;
+    }
+
+    rdb_context_t *const ctx;
+    const std::function<void()> on_ready;
+    std::deque<queued_change_t> mem;
+    std::deque<queued_change_t> pending;
+    size_t num_writing;
+    size_t num_on_disk;
+    // How many of the oldest changes on disk were cleared.
+    size_t num_to_discard;
+    bool pumping;
+    perfmon_collection_t disk_stats;
+    scoped_ptr_t<disk_backed_queue_t<queued_change_t> > disk;
+    auto_drainer_t drainer;
 };
 
-scoped_ptr_t<maybe_squashing_queue_t> make_maybe_squashing_queue(bool squash) {
-    return squash
-        ? scoped_ptr_t<maybe_squashing_queue_t>(new squashing_queue_t())
-        : scoped_ptr_t<maybe_squashing_queue_t>(new nonsquashing_queue_t());
+// `spill_ctx` is NULL unless the queue should spill to disk.
+scoped_ptr_t<maybe_squashing_queue_t> make_maybe_squashing_queue(
+    bool squash, rdb_context_t *spill_ctx, std::function<void()> on_ready) {
+    if (squash) {
+        return scoped_ptr_t<maybe_squashing_queue_t>(new squashing_queue_t());
+    } else if (spill_ctx != NULL) {
+        return scoped_ptr_t<maybe_squashing_queue_t>(
+            new spilling_queue_t(spill_ctx, std::move(on_ready)));
+    } else {
+        return scoped_ptr_t<maybe_squashing_queue_t>(new nonsquashing_queue_t());
+    }
 }
 
 boost::optional<datum_t> apply_ops(
@@ -161,13 +330,106 @@ boost::optional<datum_t> apply_ops(
     }
 }
 
+// Range subscriptions with the same key see the same changes, and see them the
+// same way.
+std::vector<char> range_spec_key(const keyspec_t::range_t &spec) {
+    write_message_t wm;
+    serialize<cluster_version_t::CLUSTER>(&wm, spec);
+    vector_stream_t stream;
+    stream.reserve(wm.size());
+    int res = send_write_message(&stream, &wm);
+    guarantee(res == 0);
+    std::vector<char> ret;
+    stream.swap(&ret);
+    return ret;
+}
+
+// Used by a `server_t` to apply a range subscription's spec to the changes before
+// sending them, so that the ones the subscription would drop don't get sent.
+class change_filter_t {
+public:
+    change_filter_t(rdb_context_t *ctx, keyspec_t::range_t _spec)
+        : spec(std::move(_spec)) {
+        // The final `NULL` argument means we don't profile any work done with this
+        // `env`.  The transforms are deterministic, so they don't need the
+        // subscriber's optargs.
+        env = make_scoped<env_t>(ctx, drainer.get_drain_signal(),
+                                 std::map<std::string, wire_func_t>(), nullptr);
+        for (const auto &transform : spec.transforms) {
+            ops.push_back(make_op(transform));
+        }
+    }
+
+    // Returns false if the subscription wouldn't see `change`.  Otherwise `*out`
+    // gets `change` with the transforms applied to its values.
+    bool apply(const msg_t::change_t &change, msg_t::change_t *out) THROWS_NOTHING {
+        if (spec.sindex) {
+            if (!has_index_in_range(change.old_indexes)
+                && !has_index_in_range(change.new_indexes)) {
+                return false;
+            }
+        } else if (!spec.range.to_primary_keyrange().contains_key(change.pkey)) {
+            return false;
+        }
+
+        // This mirrors what the `real_feed_t` does with the changes it gets from
+        // us when it applies the transforms itself.
+        auto_drainer_t::lock_t lock(&drainer);
+        datum_t null = datum_t::null();
+        datum_t old_val = null, new_val = null;
+        if (change.old_val.has()) {
+            if (boost::optional<datum_t> d =
+                    apply_ops(change.old_val, ops, env.get(), datum_t())) {
+                old_val = *d;
+            }
+        }
+        if (change.new_val.has()) {
+            if (boost::optional<datum_t> d =
+                    apply_ops(change.new_val, ops, env.get(), datum_t())) {
+                new_val = *d;
+            }
+        }
+        if (old_val == new_val) {
+            return false;
+        }
+        out->old_indexes = change.old_indexes;
+        out->new_indexes = change.new_indexes;
+        out->pkey = change.pkey;
+        out->old_val = std::move(old_val);
+        out->new_val = std::move(new_val);
+        return true;
+    }
+
+private:
+    bool has_index_in_range(
+            const std::map<std::string, std::vector<datum_t> > &indexes) const {
+        auto it = indexes.find(*spec.sindex);
+        if (it == indexes.end()) {
+            return false;
+        }
+        return std::any_of(it->second.begin(), it->second.end(),
+                           [this](const datum_t &idx) {
+                               return spec.range.contains(reql_version_t::LATEST, idx);
+                           });
+    }
+
+    keyspec_t::range_t spec;
+    std::vector<scoped_ptr_t<op_t> > ops;
+    scoped_ptr_t<env_t> env;
+    auto_drainer_t drainer;
+
+    DISABLE_COPYING(change_filter_t);
+};
+
 server_t::client_info_t::client_info_t()
-    : limit_clients(&opt_lt<std::string>),
+    : flush_spawned(false),
+      limit_clients(&opt_lt<std::string>),
       limit_clients_lock(new rwlock_t()) { }
 
 server_t::server_t(mailbox_manager_t *_manager)
     : uuid(generate_uuid()),
       manager(_manager),
+      last_log_position(0),
       stop_mailbox(manager,
                    std::bind(&server_t::stop_mailbox_cb, this, ph::_1, ph::_2)),
       limit_stop_mailbox(manager, std::bind(&server_t::limit_stop_mailbox_cb,
@@ -236,7 +498,10 @@ void server_t::limit_stop_mailbox_cb(signal_t *,
     }
 }
 
-void server_t::add_client(const client_t::addr_t &addr, region_t region) {
+void server_t::add_client(const client_t::addr_t &addr,
+                          region_t region,
+                          rdb_context_t *ctx,
+                          const boost::optional<keyspec_t::range_t> &spec) {
     auto_drainer_t::lock_t lock(&drainer);
     rwlock_in_line_t spot(&clients_lock, access_t::write);
     spot.write_signal()->wait_lazily_unordered();
@@ -247,6 +512,9 @@ void server_t::add_client(const client_t::addr_t &addr, region_t region) {
     // oversharded.  This will have to become smarter once you can unsubscribe
     // at finer granularity (i.e. when we support changefeeds on selections).
     info->regions.push_back(std::move(region));
+    if (spec && !info->filter.has()) {
+        info->filter.init(new change_filter_t(ctx, *spec));
+    }
 
     // The entry might already exist if we have multiple shards per btree, but
     // that's fine.
@@ -321,17 +589,6 @@ void server_t::add_client_cb(signal_t *stopped, client_t::addr_t addr) {
     guarantee(erased == 1);
 }
 
-struct stamped_msg_t {
-    stamped_msg_t() { }
-    stamped_msg_t(uuid_u _server_uuid, uint64_t _stamp, msg_t _submsg)
-        : server_uuid(std::move(_server_uuid)),
-          stamp(_stamp),
-          submsg(std::move(_submsg)) { }
-    uuid_u server_uuid;
-    uint64_t stamp;
-    msg_t submsg;
-};
-
 RDB_MAKE_SERIALIZABLE_3(stamped_msg_t, server_uuid, stamp, submsg);
 
 // This function takes a `lock_t` to make sure you have one.  (We can't just
@@ -339,30 +596,124 @@ RDB_MAKE_SERIALIZABLE_3(stamped_msg_t, server_uuid, stamp, submsg);
 // `stop_t` during destruction, and you can't acquire a drain lock on a draining
 // `auto_drainer_t`.)
 void server_t::send_one_with_lock(
-    const auto_drainer_t::lock_t &,
+    const auto_drainer_t::lock_t &lock,
     std::pair<const client_t::addr_t, client_info_t> *client,
     msg_t msg) {
-    uint64_t stamp;
-    {
-        // We don't need a write lock as long as we make sure the coroutine
-        // doesn't block between reading and updating the stamp.
-        ASSERT_NO_CORO_WAITING;
-        stamp = client->second.stamp++;
+    if (queue_with_lock(lock, client, std::move(msg))) {
+        flush_with_lock(lock, client);
+    }
+}
+
+bool server_t::queue_with_lock(
+    const auto_drainer_t::lock_t &lock,
+    std::pair<const client_t::addr_t, client_info_t> *client,
+    msg_t msg) {
+    // We don't need a write lock as long as we make sure the coroutine doesn't
+    // block between reading and updating the stamp.
+    ASSERT_NO_CORO_WAITING;
+    client_info_t *info = &client->second;
+    const uint64_t stamp = info->stamp++;
+    // A `stop_t` is the last message the client gets from us, and we might be
+    // shutting down, so it goes out right away.
+    const bool is_stop = boost::get<msg_t::stop_t>(&msg.op) != NULL;
+    info->batch.push_back(stamped_msg_t(uuid, stamp, std::move(msg)));
+    if (is_stop || info->batch.size() >= CHANGEFEED_MAX_BATCH_SIZE) {
+        return true;
+    } else if (!info->flush_spawned) {
+        info->flush_spawned = true;
+        coro_t::spawn_sometime(
+            std::bind(&server_t::flush_cb, this, client->first, lock));
+    }
+    return false;
+}
+
+bool server_t::change_for_client(const client_info_t &info,
+                                 const msg_t::change_t &change,
+                                 msg_t *out) {
+    if (!std::any_of(info.regions.begin(),
+                     info.regions.end(),
+                     std::bind(&region_contains_key, ph::_1, std::cref(change.pkey)))) {
+        return false;
+    }
+    if (info.filter.has()) {
+        msg_t::change_t filtered;
+        if (!info.filter->apply(change, &filtered)) {
+            return false;
+        }
+        filtered.log_position = change.log_position;
+        *out = msg_t(std::move(filtered));
+    } else {
+        *out = msg_t(change);
+    }
+    return true;
+}
+
+void server_t::flush_with_lock(
+    const auto_drainer_t::lock_t &,
+    std::pair<const client_t::addr_t, client_info_t> *client) {
+    if (!client->second.batch.empty()) {
+        std::vector<stamped_msg_t> batch;
+        batch.swap(client->second.batch);
+        send(manager, client->first, batch);
+    }
+}
+
+void server_t::flush_cb(client_t::addr_t addr, auto_drainer_t::lock_t lock) {
+    rwlock_in_line_t spot(&clients_lock, access_t::read);
+    spot.read_signal()->wait_lazily_unordered();
+    auto it = clients.find(addr);
+    // The client might have been removed, in which case its `stop_t` flushed the
+    // batch.
+    if (it != clients.end()) {
+        it->second.flush_spawned = false;
+        flush_with_lock(lock, &*it);
     }
-    send(manager, client->first, stamped_msg_t(uuid, stamp, std::move(msg)));
 }
 
 void server_t::send_all(const msg_t &msg, const store_key_t &key) {
     auto_drainer_t::lock_t lock(&drainer);
     rwlock_in_line_t spot(&clients_lock, access_t::read);
     spot.read_signal()->wait_lazily_unordered();
-    for (auto it = clients.begin(); it != clients.end(); ++it) {
-        if (std::any_of(it->second.regions.begin(),
-                        it->second.regions.end(),
-                        std::bind(&region_contains_key, ph::_1, std::cref(key)))) {
-            send_one_with_lock(lock, &*it, msg);
+    std::vector<std::pair<const client_t::addr_t, client_info_t> *> to_flush;
+    {
+        // Logging a change and queueing it for every client happen together, so
+        // that each client gets the changes in log order (which is what makes
+        // resuming from a log position work).  Sending can block, so it waits
+        // until every client has its copy.
+        ASSERT_NO_CORO_WAITING;
+        const msg_t::change_t *change = boost::get<msg_t::change_t>(&msg.op);
+        if (change != NULL) {
+            change_log.push_back(std::make_pair(++last_log_position, *change));
+            change_log.back().second.log_position = last_log_position;
+            if (change_log.size() > CHANGEFEED_LOG_SIZE) {
+                change_log.pop_front();
+            }
+            change = &change_log.back().second;
+        }
+        for (auto it = clients.begin(); it != clients.end(); ++it) {
+            bool needs_flush;
+            if (change != NULL) {
+                msg_t client_msg;
+                if (!change_for_client(it->second, *change, &client_msg)) {
+                    continue;
+                }
+                needs_flush = queue_with_lock(lock, &*it, std::move(client_msg));
+            } else if (std::any_of(it->second.regions.begin(),
+                                   it->second.regions.end(),
+                                   std::bind(&region_contains_key,
+                                             ph::_1, std::cref(key)))) {
+                needs_flush = queue_with_lock(lock, &*it, msg);
+            } else {
+                continue;
+            }
+            if (needs_flush) {
+                to_flush.push_back(&*it);
+            }
         }
     }
+    for (auto *client : to_flush) {
+        flush_with_lock(lock, client);
+    }
 }
 
 void server_t::stop_all() {
@@ -382,10 +733,14 @@ server_t::limit_addr_t server_t::get_limit_stop_addr() {
     return limit_stop_mailbox.get_address();
 }
 
-uint64_t server_t::get_stamp(const client_t::addr_t &addr) {
+uint64_t server_t::get_stamp(const client_t::addr_t &addr,
+                             uint64_t *log_position_out) {
     auto_drainer_t::lock_t lock(&drainer);
     rwlock_in_line_t spot(&clients_lock, access_t::read);
     spot.read_signal()->wait_lazily_unordered();
+    if (log_position_out != NULL) {
+        *log_position_out = last_log_position;
+    }
     auto it = clients.find(addr);
     if (it == clients.end()) {
         // The client was removed, so no future messages are coming.
@@ -395,6 +750,53 @@ uint64_t server_t::get_stamp(const client_t::addr_t &addr) {
     }
 }
 
+bool server_t::resume(const client_t::addr_t &addr,
+                      uint64_t log_position,
+                      uint64_t *stamp_out) {
+    auto_drainer_t::lock_t lock(&drainer);
+    rwlock_in_line_t spot(&clients_lock, access_t::read);
+    spot.read_signal()->wait_lazily_unordered();
+    auto it = clients.find(addr);
+    if (it == clients.end()) {
+        // The client was removed, so no future messages are coming.
+        *stamp_out = std::numeric_limits<uint64_t>::max();
+        return true;
+    }
+    client_info_t *info = &it->second;
+    if (info->resume_stamp) {
+        *stamp_out = *info->resume_stamp;
+        return true;
+    }
+    bool needs_flush = false;
+    {
+        // Nothing else may be queued for the client while we replay the log.
+        ASSERT_NO_CORO_WAITING;
+        if (log_position > last_log_position
+            || (log_position < last_log_position
+                && (change_log.empty()
+                    || change_log.front().first > log_position + 1))) {
+            return false;
+        }
+        *stamp_out = info->stamp;
+        info->resume_stamp = info->stamp;
+        // Log positions are consecutive.
+        auto log_it = change_log.begin();
+        if (!change_log.empty() && log_position >= change_log.front().first) {
+            log_it += log_position - change_log.front().first + 1;
+        }
+        for (; log_it != change_log.end(); ++log_it) {
+            msg_t client_msg;
+            if (change_for_client(*info, log_it->second, &client_msg)) {
+                needs_flush |= queue_with_lock(lock, &*it, std::move(client_msg));
+            }
+        }
+    }
+    if (needs_flush) {
+        flush_with_lock(lock, &*it);
+    }
+    return true;
+}
+
 uuid_u server_t::get_uuid() {
     return uuid;
 }
@@ -655,6 +1057,8 @@ limit_manager_t::limit_manager_t(
       spec(std::move(_spec)),
       gt(std::move(_gt)),
       item_queue(gt),
+      buffer(gt),
+      buffer_complete(false),
       aborted(false) {
     guarantee(clients_lock->read_signal()->is_pulsed());
 
@@ -845,10 +1249,17 @@ void limit_manager_t::commit(
         if (data_deleted) {
             bool inserted = real_deleted.insert(std::move(id)).second;
             guarantee(inserted);
+        } else {
+            UNUSED bool buffer_deleted = buffer.del_id(id);
         }
     }
     deleted.clear();
     for (auto &&pair : added) {
+        // A buffered row that changed gets placed again below.
+        auto buffer_it = buffer.find_id(pair.first);
+        if (buffer_it != buffer.end()) {
+            buffer.erase(buffer_it);
+        }
         auto it = item_queue.find_id(pair.first);
         if (it != item_queue.end()) {
             // We can enter this branch if we're doing a batched update and the
@@ -865,17 +1276,43 @@ void limit_manager_t::commit(
     }
     added.clear();
 
-    std::vector<std::string> truncated = item_queue.truncate_top(spec.limit);
-    for (auto &&id : truncated) {
-        auto it = real_added.find_id(id);
+    // Rows that fall out of the window go to the buffer if it covers them.
+    while (item_queue.size() > spec.limit) {
+        auto top_it = item_queue.begin();
+        item_t item = **top_it;
+        item_queue.erase(top_it);
+        auto it = real_added.find_id(item.first);
         if (it != real_added.end()) {
             real_added.erase(it);
         } else {
-            bool inserted = real_deleted.insert(std::move(id)).second;
+            bool inserted = real_deleted.insert(item.first).second;
             guarantee(inserted);
         }
+        maybe_buffer(std::move(item));
     }
-    if (item_queue.size() < spec.limit) {
+
+    // Fills the window with the best buffered rows.
+    auto refill_from_buffer = [&]() {
+        while (item_queue.size() < spec.limit && buffer.size() != 0) {
+            auto best_it = std::prev(buffer.end());
+            item_t item = **best_it;
+            buffer.erase(best_it);
+            bool ins = item_queue.insert(item).second;
+            guarantee(ins);
+            size_t erased = real_deleted.erase(item.first);
+            if (erased == 0) {
+                ins = real_added.insert(std::move(item)).second;
+                guarantee(ins);
+            }
+        }
+    };
+    refill_from_buffer();
+
+    // We only have to go to the btree if the buffer ran out before the window was
+    // full, and there might be more rows than the buffer had.  Then we read enough
+    // to fill the buffer again too.
+    if (item_queue.size() < spec.limit && !buffer_complete) {
+        guarantee(buffer.size() == 0);
         auto data_it = item_queue.begin();
         datum_t begin = (data_it == item_queue.end())
             ? datum_t()
@@ -884,6 +1321,7 @@ void limit_manager_t::commit(
         if (data_it != item_queue.end()) {
             start = data_it;
         }
+        const size_t n = spec.limit - item_queue.size() + buffer_capacity();
         item_vec_t s;
         boost::optional<exc_t> exc;
         try {
@@ -891,7 +1329,7 @@ void limit_manager_t::commit(
                 sindex_ref,
                 spec.range.sorting,
                 start,
-                spec.limit - item_queue.size());
+                n);
         } catch (const exc_t &e) {
             exc = e;
         }
@@ -901,16 +1339,13 @@ void limit_manager_t::commit(
             abort(*exc);
             return;
         }
-        guarantee(s.size() <= spec.limit - item_queue.size());
+        guarantee(s.size() <= n);
+        buffer_complete = s.size() < n;
         for (auto &&pair : s) {
-            bool ins = item_queue.insert(pair).second;
+            bool ins = buffer.insert(std::move(pair)).second;
             guarantee(ins);
-            size_t erased = real_deleted.erase(pair.first);
-            if (erased == 0) {
-                ins = real_added.insert(pair).second;
-                guarantee(ins);
-            }
         }
+        refill_from_buffer();
     }
     std::set<std::string> remaining_deleted;
     for (auto &&id : real_deleted) {
@@ -949,6 +1384,25 @@ void limit_manager_t::commit(
     real_added.clear();
 }
 
+size_t limit_manager_t::buffer_capacity() const {
+    return spec.limit * (CHANGEFEED_LIMIT_BUFFER_MULTIPLE - 1);
+}
+
+void limit_manager_t::maybe_buffer(item_t &&item) {
+    // Unless the buffer holds every row after the window, rows after its last one
+    // might be missing from it, so it can't take rows from there.
+    if (!buffer_complete
+        && (buffer.size() == 0 || !gt(item_t(**buffer.begin()), item))) {
+        return;
+    }
+    bool inserted = buffer.insert(std::move(item)).second;
+    guarantee(inserted);
+    if (buffer.size() > buffer_capacity()) {
+        buffer.truncate_top(buffer_capacity());
+        buffer_complete = false;
+    }
+}
+
 void limit_manager_t::abort(exc_t e) {
     aborted = true;
     send(msg_t(msg_t::limit_stop_t{uuid, std::move(e)}));
@@ -961,9 +1415,9 @@ RDB_IMPL_SERIALIZABLE_3(msg_t::limit_change_t, sub, old_key, new_val);
 INSTANTIATE_SERIALIZABLE_FOR_CLUSTER(msg_t::limit_change_t);
 RDB_IMPL_SERIALIZABLE_2(msg_t::limit_stop_t, sub, exc);
 INSTANTIATE_SERIALIZABLE_FOR_CLUSTER(msg_t::limit_stop_t);
-RDB_IMPL_SERIALIZABLE_5(
+RDB_IMPL_SERIALIZABLE_6(
     msg_t::change_t,
-    old_indexes, new_indexes, pkey, old_val, new_val);
+    old_indexes, new_indexes, pkey, old_val, new_val, log_position);
 INSTANTIATE_SERIALIZABLE_FOR_CLUSTER(msg_t::change_t);
 RDB_IMPL_SERIALIZABLE_0_SINCE_v1_13(msg_t::stop_t);
 
@@ -1011,20 +1465,25 @@ private:
 
 class flat_sub_t : public subscription_t {
 public:
-    template<class... Args>
-    explicit flat_sub_t(Args &&... args)
-        : subscription_t(std::forward<Args>(args)...),
-          queue(make_maybe_squashing_queue(squash)) { }
+    // `spill_ctx` is NULL unless changes that pile up should be spilled to disk.
+    flat_sub_t(feed_t *_feed, const datum_t &_squash, rdb_context_t *spill_ctx)
+        : subscription_t(_feed, _squash),
+          queue(make_maybe_squashing_queue(
+                    squash, spill_ctx, [this]() { maybe_signal_cond(); })) { }
+    // `log_position` is the change's position in the change log of the server
+    // `uuid` names.
     virtual void add_el(
         const uuid_u &uuid,
         uint64_t stamp,
+        uint64_t log_position,
         const store_key_t &key,
         datum_t old_val,
         datum_t new_val,
         const configured_limits_t &limits) {
         if (update_stamp(uuid, stamp)) {
-            queue->add(key, std::move(old_val), std::move(new_val));
-            if (queue->size() > limits.array_size_limit()) {
+            queue->add(key, std::move(old_val), std::move(new_val),
+                       note_log_position(uuid, log_position));
+            if (queue->size() > queue->capacity(limits)) {
                 skipped += queue->size();
                 queue->clear();
             }
@@ -1035,9 +1494,12 @@ protected:
     // The queue of changes we've accumulated since the last time we were read from.
     const scoped_ptr_t<maybe_squashing_queue_t> queue;
 private:
-    virtual bool has_el() { return queue->size() != 0; }
+    virtual bool has_el() { return queue->can_pop(); }
     virtual void note_data_wait() { }
     virtual bool update_stamp(const uuid_u &uuid, uint64_t new_stamp) = 0;
+    // Returns the resume token to hand out with the change at `log_position`, or
+    // an empty datum if we don't hand them out.
+    virtual datum_t note_log_position(const uuid_u &, uint64_t) { return datum_t(); }
 };
 
 class range_sub_t;
@@ -1060,9 +1522,13 @@ public:
 
     void each_range_sub(const auto_drainer_t::lock_t &lock,
                         const std::function<void(range_sub_t *)> &f) THROWS_NOTHING;
-    void each_active_range_sub(
+    // Calls `f` once per group of active range subscriptions with identical specs
+    // on each thread, so that work that only depends on the spec (like applying
+    // the transforms) can be done once for the whole group.
+    void each_active_range_sub_group(
         const auto_drainer_t::lock_t &lock,
-        const std::function<void(range_sub_t *)> &f) THROWS_NOTHING;
+        const std::function<void(const std::vector<range_sub_t *> &)> &f)
+        THROWS_NOTHING;
     void each_point_sub(const std::function<void(point_sub_t *)> &f) THROWS_NOTHING;
     void each_sub(const auto_drainer_t::lock_t &lock,
                   const std::function<void(flat_sub_t *)> &f) THROWS_NOTHING;
@@ -1076,6 +1542,9 @@ public:
         const std::function<void(limit_sub_t *)> &f) THROWS_NOTHING;
 
     bool can_be_removed();
+    // True if the feed's changes come with the transforms of its range
+    // subscriptions already applied.
+    virtual bool applies_transforms() const { return false; }
 
     const std::string pkey;
 protected:
@@ -1103,10 +1572,20 @@ private:
                             const std::vector<int> &sub_threads,
                             int i);
     void each_point_sub_cb(const std::function<void(point_sub_t *)> &f, int i);
+    void each_range_sub_group(
+        const auto_drainer_t::lock_t &lock,
+        const std::function<void(const std::set<range_sub_t *> &)> &f)
+        THROWS_NOTHING;
+    void each_range_sub_group_cb(
+        const std::function<void(const std::set<range_sub_t *> &)> &f,
+        const std::vector<int> &sub_threads,
+        int i);
 
     std::map<store_key_t, std::vector<std::set<point_sub_t *> > > point_subs;
     rwlock_t point_subs_lock;
-    std::vector<std::set<range_sub_t *> > range_subs;
+    // Range subscriptions on each thread, grouped by the spec they were created
+    // with (serialized, see `range_sub_t::get_spec_key`).
+    std::vector<std::map<std::vector<char>, std::set<range_sub_t *> > > range_subs;
     rwlock_t range_subs_lock;
     std::map<uuid_u, std::vector<std::set<limit_sub_t *> > > limit_subs;
     rwlock_t limit_subs_lock;
@@ -1114,26 +1593,31 @@ private:
 
 class real_feed_t : public feed_t {
 public:
+    // If `filter` is set, the servers only send the changes it covers, with its
+    // transforms applied, and only range subscriptions with that spec may use us.
     real_feed_t(client_t *client,
                 mailbox_manager_t *_manager,
                 namespace_interface_t *ns_if,
-                uuid_u uuid,
+                client_t::feed_key_t key,
+                const boost::optional<keyspec_t::range_t> &filter,
                 signal_t *interruptor);
     ~real_feed_t();
 
     client_t::addr_t get_addr() const;
+    virtual bool applies_transforms() const { return filtered; }
 private:
     virtual auto_drainer_t::lock_t get_drainer_lock() { return drainer.lock(); }
-    virtual void maybe_remove_feed() { client->maybe_remove_feed(uuid); }
+    virtual void maybe_remove_feed() { client->maybe_remove_feed(key); }
     virtual void stop_limit_sub(limit_sub_t *sub);
 
-    void mailbox_cb(signal_t *interruptor, stamped_msg_t msg);
+    void mailbox_cb(signal_t *interruptor, std::vector<stamped_msg_t> msgs);
     void constructor_cb();
 
     client_t *client;
-    uuid_u uuid;
+    client_t::feed_key_t key;
+    bool filtered;
     mailbox_manager_t *manager;
-    mailbox_t<void(stamped_msg_t)> mailbox;
+    mailbox_t<void(std::vector<stamped_msg_t>)> mailbox;
     std::vector<server_t::addr_t> stop_addrs;
     std::vector<scoped_ptr_t<disconnect_watcher_t> > disconnect_watchers;
 
@@ -1159,14 +1643,16 @@ private:
 real_feed_t::real_feed_t(client_t *_client,
                          mailbox_manager_t *_manager,
                          namespace_interface_t *ns_if,
-                         uuid_u _uuid,
+                         client_t::feed_key_t _key,
+                         const boost::optional<keyspec_t::range_t> &filter,
                          signal_t *interruptor)
     : client(_client),
-      uuid(_uuid),
+      key(std::move(_key)),
+      filtered(static_cast<bool>(filter)),
       manager(_manager),
       mailbox(manager, std::bind(&real_feed_t::mailbox_cb, this, ph::_1, ph::_2)) {
     try {
-        read_t read(changefeed_subscribe_t(mailbox.get_address()),
+        read_t read(changefeed_subscribe_t(mailbox.get_address(), filter),
                     profile_bool_t::DONT_PROFILE);
         read_response_t read_resp;
         ns_if->read(read, &read_resp, order_token_t::ignore, interruptor);
@@ -1242,7 +1728,7 @@ void real_feed_t::constructor_cb() {
     // longer than necessary.
     disconnect_watchers.clear();
     if (!detached) {
-        scoped_ptr_t<feed_t> self = client->detach_feed(uuid);
+        scoped_ptr_t<feed_t> self = client->detach_feed(key);
         detached = true;
         if (self.has()) {
             const char *msg = "Disconnected from peer.";
@@ -1267,8 +1753,12 @@ void real_feed_t::constructor_cb() {
 class point_sub_t : public flat_sub_t {
 public:
     // Throws QL exceptions.
-    point_sub_t(feed_t *feed, const datum_t &squash, store_key_t _key)
-        : flat_sub_t(feed, squash), key(std::move(_key)), stamp(0), started(false) {
+    point_sub_t(feed_t *feed, const datum_t &squash, rdb_context_t *spill_ctx,
+                store_key_t _key)
+        : flat_sub_t(feed, squash, spill_ctx),
+          key(std::move(_key)),
+          stamp(0),
+          started(false) {
         feed->add_point_sub(this, key);
     }
     virtual ~point_sub_t() {
@@ -1324,11 +1814,22 @@ private:
 class range_sub_t : public flat_sub_t {
 public:
     // Throws QL exceptions.
-    range_sub_t(feed_t *feed, const datum_t &squash, keyspec_t::range_t _spec)
-        : flat_sub_t(feed, squash), spec(std::move(_spec)) {
-        for (const auto &transform : spec.transforms) {
-            ops.push_back(make_op(transform));
+    // If `_resume_from` is set, the subscription starts with the changes after
+    // those log positions.
+    range_sub_t(feed_t *feed, const datum_t &squash, rdb_context_t *spill_ctx,
+                keyspec_t::range_t _spec,
+                boost::optional<std::map<uuid_u, uint64_t> > _resume_from)
+        : flat_sub_t(feed, squash, spill_ctx),
+          spec(std::move(_spec)),
+          resume_from(std::move(_resume_from)),
+          hands_out_tokens(false) {
+        // If the feed's servers apply our transforms, we mustn't apply them again.
+        if (!feed->applies_transforms()) {
+            for (const auto &transform : spec.transforms) {
+                ops.push_back(make_op(transform));
+            }
         }
+        spec_key = range_spec_key(spec);
         feed->add_range_sub(this);
     }
     virtual ~range_sub_t() {
@@ -1352,13 +1853,25 @@ public:
         read_response_t read_resp;
         // Note that we use the `outer_env`'s interruptor for the read.
         nif->read(
-            read_t(changefeed_stamp_t(*addr), profile_bool_t::DONT_PROFILE),
+            read_t(changefeed_stamp_t(*addr, resume_from),
+                   profile_bool_t::DONT_PROFILE),
             &read_resp, order_token_t::ignore, outer_env->interruptor);
         auto resp = boost::get<changefeed_stamp_response_t>(&read_resp.response);
         guarantee(resp != NULL);
+        if (resp->resume_error) {
+            rfail_datum(base_exc_t::GENERIC, "Cannot resume the changefeed: %s.",
+                        resp->resume_error->c_str());
+        }
+        // Squashing reorders changes, so a position wouldn't cover the ones
+        // before it.
+        hands_out_tokens = !squash;
+        log_positions = std::move(resp->log_positions);
         start_stamps = std::move(resp->stamps);
         guarantee(start_stamps.size() != 0);
     }
+    // Subscriptions with the same spec key see the same changes, and see them
+    // the same way.
+    const std::vector<char> &get_spec_key() const { return spec_key; }
     boost::optional<std::string> sindex() const { return spec.sindex; }
     bool contains(const datum_t &sindex_key) const {
         guarantee(spec.sindex);
@@ -1406,6 +1919,22 @@ public:
 private:
     virtual datum_t pop_el() { return queue->pop(pop_type_t::RANGE); }
 
+    // The token is the log position of the last change we've queued from each
+    // server, which is where `changes(resume_from=token)` picks up.
+    virtual datum_t note_log_position(const uuid_u &uuid, uint64_t log_position) {
+        if (!hands_out_tokens) {
+            return datum_t();
+        }
+        log_positions[uuid] = log_position;
+        datum_object_builder_t token;
+        for (const auto &pair : log_positions) {
+            bool dup = token.add(datum_string_t(uuid_to_str(pair.first)),
+                                 datum_t(static_cast<double>(pair.second)));
+            guarantee(!dup);
+        }
+        return std::move(token).to_datum();
+    }
+
     scoped_ptr_t<env_t> env;
     std::vector<scoped_ptr_t<op_t> > ops;
 
@@ -1414,6 +1943,11 @@ private:
     // our subscription.
     std::map<uuid_u, uint64_t> start_stamps;
     keyspec_t::range_t spec;
+    std::vector<char> spec_key;
+    const boost::optional<std::map<uuid_u, uint64_t> > resume_from;
+    // The log position of the last change we've queued from each server.
+    std::map<uuid_u, uint64_t> log_positions;
+    bool hands_out_tokens;
     auto_drainer_t drainer;
 };
 
@@ -1732,7 +2266,11 @@ public:
         configured_limits_t default_limits;
         datum_t null = datum_t::null();
 
-        feed->each_active_range_sub(*lock, [&](range_sub_t *sub) {
+        // The subscriptions in a group have the same spec, so we only have to work
+        // out once what the change looks like to them.
+        feed->each_active_range_sub_group(*lock, [&](
+                const std::vector<range_sub_t *> &subs) {
+            range_sub_t *sub = subs[0];
             datum_t new_val = null, old_val = null;
             if (sub->has_ops()) {
                 if (change.new_val.has()) {
@@ -1779,28 +2317,27 @@ public:
                         }
                     }
                 }
-                while (new_vals > 0 && old_vals > 0) {
-                    sub->add_el(server_uuid, stamp, change.pkey,
-                                old_val, new_val, default_limits);
-                    --new_vals;
-                    --old_vals;
-                }
-                while (old_vals > 0) {
-                    guarantee(new_vals == 0);
-                    sub->add_el(server_uuid, stamp, change.pkey,
-                                old_val, null, default_limits);
-                    --old_vals;
-                }
-                while (new_vals > 0) {
-                    guarantee(old_vals == 0);
-                    sub->add_el(server_uuid, stamp, change.pkey,
-                                null, new_val, default_limits);
-                    --new_vals;
+                for (range_sub_t *group_sub : subs) {
+                    size_t changes = std::min(old_vals, new_vals);
+                    for (size_t i = 0; i < changes; ++i) {
+                        group_sub->add_el(server_uuid, stamp, change.log_position,
+                                          change.pkey, old_val, new_val, default_limits);
+                    }
+                    for (size_t i = changes; i < old_vals; ++i) {
+                        group_sub->add_el(server_uuid, stamp, change.log_position,
+                                          change.pkey, old_val, null, default_limits);
+                    }
+                    for (size_t i = changes; i < new_vals; ++i) {
+                        group_sub->add_el(server_uuid, stamp, change.log_position,
+                                          change.pkey, null, new_val, default_limits);
+                    }
                 }
             } else {
                 if (sub->contains(change.pkey)) {
-                    sub->add_el(server_uuid, stamp, change.pkey,
-                                old_val, new_val, default_limits);
+                    for (range_sub_t *group_sub : subs) {
+                        group_sub->add_el(server_uuid, stamp, change.log_position,
+                                          change.pkey, old_val, new_val, default_limits);
+                    }
                 }
             }
         });
@@ -1811,6 +2348,7 @@ public:
                       ph::_1,
                       std::cref(server_uuid),
                       stamp,
+                      change.log_position,
                       change.pkey,
                       change.old_val.has() ? change.old_val : null,
                       change.new_val.has() ? change.new_val : null,
@@ -1832,7 +2370,7 @@ private:
     uint64_t stamp;
 };
 
-void real_feed_t::mailbox_cb(signal_t *, stamped_msg_t msg) {
+void real_feed_t::mailbox_cb(signal_t *, std::vector<stamped_msg_t> msgs) {
     // We stop receiving messages when detached (we're only receiving
     // messages because we haven't managed to get a message to the
     // stop mailboxes for some of the primary replicas yet).  This also stops
@@ -1845,10 +2383,12 @@ void real_feed_t::mailbox_cb(signal_t *, stamped_msg_t msg) {
         // We wait for the write to complete and the queues to be ready.
         wait_any_t wait_any(&queues_ready, lock.get_drain_signal());
         wait_any.wait_lazily_unordered();
-        if (!lock.get_drain_signal()->is_pulsed()) {
-            // We don't need a lock for this because the set of `uuid_u`s never
-            // changes after it's initialized.
-            auto it = queues.find(msg.server_uuid);
+        if (!lock.get_drain_signal()->is_pulsed() && !msgs.empty()) {
+            // A batch only holds messages from one server.  We don't need a lock
+            // for this because the set of `uuid_u`s never changes after it's
+            // initialized.
+            const uuid_u server_uuid = msgs[0].server_uuid;
+            auto it = queues.find(server_uuid);
             guarantee(it != queues.end());
             queue_t *queue = it->second.get();
             guarantee(queue != NULL);
@@ -1857,8 +2397,11 @@ void real_feed_t::mailbox_cb(signal_t *, stamped_msg_t msg) {
             spot.write_signal()->wait_lazily_unordered();
 
             // Add us to the queue.
-            guarantee(msg.stamp >= queue->next);
-            queue->map.push(std::move(msg));
+            for (auto &&msg : msgs) {
+                guarantee(msg.server_uuid == server_uuid);
+                guarantee(msg.stamp >= queue->next);
+                queue->map.push(std::move(msg));
+            }
 
             // Read as much as we can from the queue (this enforces ordering.)
             while (queue->map.size() != 0 && queue->map.top().stamp == queue->next) {
@@ -2103,17 +2646,31 @@ void feed_t::del_point_sub(point_sub_t *sub, const store_key_t &key) THROWS_NOTH
         });
 }
 
+size_t map_del_range_sub(
+    std::map<std::vector<char>, std::set<range_sub_t *> > *map,
+    const std::vector<char> &spec_key,
+    range_sub_t *sub) THROWS_NOTHING {
+    auto it = map->find(spec_key);
+    guarantee(it != map->end());
+    size_t erased = it->second.erase(sub);
+    if (it->second.empty()) {
+        map->erase(it);
+    }
+    return erased;
+}
+
 // If this throws we might leak the increment to `num_subs`.
 void feed_t::add_range_sub(range_sub_t *sub) THROWS_NOTHING {
     add_sub_with_lock(&range_subs_lock, [this, sub]() {
-            range_subs[sub->home_thread().threadnum].insert(sub);
+            range_subs[sub->home_thread().threadnum][sub->get_spec_key()].insert(sub);
         });
 }
 
 // Can't throw because it's called in a destructor.
 void feed_t::del_range_sub(range_sub_t *sub) THROWS_NOTHING {
     del_sub_with_lock(&range_subs_lock, [this, sub]() {
-            return range_subs[sub->home_thread().threadnum].erase(sub);
+            return map_del_range_sub(
+                &range_subs[sub->home_thread().threadnum], sub->get_spec_key(), sub);
         });
 }
 
@@ -2169,24 +2726,66 @@ void feed_t::each_sub_in_vec_cb(const std::function<void(Sub *)> &f,
     }
 }
 
-void feed_t::each_range_sub(
+void feed_t::each_range_sub_group(
     const auto_drainer_t::lock_t &lock,
-    const std::function<void(range_sub_t *)> &f) THROWS_NOTHING {
+    const std::function<void(const std::set<range_sub_t *> &)> &f) THROWS_NOTHING {
     assert_thread();
+    guarantee(lock.has_lock());
     rwlock_in_line_t spot(&range_subs_lock, access_t::read);
-    each_sub_in_vec(range_subs, &spot, lock, f);
+    spot.read_signal()->wait_lazily_unordered();
+
+    std::vector<int> subscription_threads;
+    for (int i = 0; i < get_num_threads(); ++i) {
+        if (range_subs[i].size() != 0) {
+            subscription_threads.push_back(i);
+        }
+    }
+    pmap(subscription_threads.size(),
+         std::bind(&feed_t::each_range_sub_group_cb,
+                   this,
+                   std::cref(f),
+                   std::cref(subscription_threads),
+                   ph::_1));
+}
+
+void feed_t::each_range_sub_group_cb(
+    const std::function<void(const std::set<range_sub_t *> &)> &f,
+    const std::vector<int> &subscription_threads,
+    int i) {
+    guarantee(range_subs[subscription_threads[i]].size() != 0);
+    on_thread_t th((threadnum_t(subscription_threads[i])));
+    for (const auto &pair : range_subs[subscription_threads[i]]) {
+        f(pair.second);
+    }
 }
 
-void feed_t::each_active_range_sub(
+void feed_t::each_range_sub(
     const auto_drainer_t::lock_t &lock,
     const std::function<void(range_sub_t *)> &f) THROWS_NOTHING {
-    each_range_sub(lock, [&f](range_sub_t *sub) {
-        if (sub->active()) {
+    each_range_sub_group(lock, [&f](const std::set<range_sub_t *> &subs) {
+        for (range_sub_t *sub : subs) {
             f(sub);
         }
     });
 }
 
+void feed_t::each_active_range_sub_group(
+    const auto_drainer_t::lock_t &lock,
+    const std::function<void(const std::vector<range_sub_t *> &)> &f)
+    THROWS_NOTHING {
+    each_range_sub_group(lock, [&f](const std::set<range_sub_t *> &subs) {
+        std::vector<range_sub_t *> active_subs;
+        for (range_sub_t *sub : subs) {
+            if (sub->active()) {
+                active_subs.push_back(sub);
+            }
+        }
+        if (!active_subs.empty()) {
+            f(active_subs);
+        }
+    });
+}
+
 void feed_t::each_point_sub(
     const std::function<void(point_sub_t *)> &f) THROWS_NOTHING {
     assert_thread();
@@ -2270,29 +2869,58 @@ client_t::client_t(
 client_t::~client_t() { }
 
 scoped_ptr_t<subscription_t> new_sub(
-    feed_t *feed, const datum_t &squash, const keyspec_t::spec_t &spec) {
+    feed_t *feed, const datum_t &squash, rdb_context_t *spill_ctx,
+    const boost::optional<std::map<uuid_u, uint64_t> > &resume_from,
+    const keyspec_t::spec_t &spec) {
     struct spec_visitor_t : public boost::static_visitor<subscription_t *> {
-        explicit spec_visitor_t(feed_t *_feed, const datum_t *_squash)
-            : feed(_feed), squash(_squash) { }
+        spec_visitor_t(feed_t *_feed, const datum_t *_squash, rdb_context_t *_spill_ctx,
+                       const boost::optional<std::map<uuid_u, uint64_t> > *_resume_from)
+            : feed(_feed), squash(_squash), spill_ctx(_spill_ctx),
+              resume_from(_resume_from) { }
         subscription_t *operator()(const keyspec_t::range_t &range) const {
-            return new range_sub_t(feed, *squash, range);
+            return new range_sub_t(feed, *squash, spill_ctx, range, *resume_from);
         }
         subscription_t *operator()(const keyspec_t::limit_t &limit) const {
+            // Limit changefeeds keep their changes in memory.
             return new limit_sub_t(feed, *squash, limit);
         }
         subscription_t *operator()(const keyspec_t::point_t &point) const {
-            return new point_sub_t(feed, *squash, point.key);
+            return new point_sub_t(feed, *squash, spill_ctx, point.key);
         }
         feed_t *feed;
         const datum_t *squash;
+        rdb_context_t *spill_ctx;
+        const boost::optional<std::map<uuid_u, uint64_t> > *resume_from;
     };
     return scoped_ptr_t<subscription_t>(
-        boost::apply_visitor(spec_visitor_t(feed, &squash), spec));
+        boost::apply_visitor(
+            spec_visitor_t(feed, &squash, spill_ctx, &resume_from), spec));
+}
+
+// Resume tokens map the servers' uuids to log positions (see `server_t::resume`).
+std::map<uuid_u, uint64_t> parse_resume_token(const datum_t &token) {
+    const char *const bad_token = "Invalid resume token `%s`.";
+    rcheck_datum(token.get_type() == datum_t::R_OBJECT, base_exc_t::GENERIC,
+                 strprintf(bad_token, token.print().c_str()));
+    std::map<uuid_u, uint64_t> ret;
+    for (size_t i = 0; i < token.obj_size(); ++i) {
+        std::pair<datum_string_t, datum_t> pair = token.get_pair(i);
+        uuid_u uuid;
+        rcheck_datum(str_to_uuid(pair.first.to_std(), &uuid)
+                     && pair.second.get_type() == datum_t::R_NUM
+                     && pair.second.as_num() >= 0,
+                     base_exc_t::GENERIC,
+                     strprintf(bad_token, token.print().c_str()));
+        ret[uuid] = pair.second.as_int();
+    }
+    return ret;
 }
 
 counted_t<datum_stream_t> client_t::new_stream(
     env_t *env,
     const datum_t &squash,
+    bool spill_to_disk,
+    const datum_t &resume_from,
     const namespace_id_t &uuid,
     const protob_t<const Backtrace> &bt,
     const std::string &table_name,
@@ -2301,6 +2929,27 @@ counted_t<datum_stream_t> client_t::new_stream(
         scoped_ptr_t<subscription_t> sub;
         boost::variant<scoped_ptr_t<range_sub_t>, scoped_ptr_t<point_sub_t> > presub;
         addr_t addr;
+
+        // Range subscriptions with transforms have the shards apply them.
+        feed_key_t key(uuid, std::vector<char>());
+        boost::optional<keyspec_t::range_t> filter;
+        const keyspec_t::range_t *range = boost::get<keyspec_t::range_t>(&spec);
+        if (range != NULL && range->transforms.size() != 0) {
+            key.second = range_spec_key(*range);
+            filter = *range;
+        }
+        // A server replays its log to a whole feed, so a resumed subscription
+        // gets a feed of its own.
+        boost::optional<std::map<uuid_u, uint64_t> > resume_positions;
+        if (resume_from.has()) {
+            guarantee(range != NULL);
+            resume_positions = parse_resume_token(resume_from);
+            key.second = range_spec_key(*range);
+            const uuid_u feed_uuid = generate_uuid();
+            key.second.insert(key.second.end(), feed_uuid.data(),
+                              feed_uuid.data() + uuid_u::static_size());
+            filter = *range;
+        }
         {
             threadnum_t old_thread = get_thread_id();
             cross_thread_signal_t interruptor(env->interruptor, home_thread());
@@ -2308,7 +2957,7 @@ counted_t<datum_stream_t> client_t::new_stream(
             auto_drainer_t::lock_t lock(&drainer);
             rwlock_in_line_t spot(&feeds_lock, access_t::write);
             spot.read_signal()->wait_lazily_unordered();
-            auto feed_it = feeds.find(uuid);
+            auto feed_it = feeds.find(key);
             if (feed_it == feeds.end()) {
                 spot.write_signal()->wait_lazily_unordered();
                 namespace_interface_access_t access =
@@ -2318,8 +2967,8 @@ counted_t<datum_stream_t> client_t::new_stream(
                 // only be run for the first one.  Rather than mess
                 // about, just use the defaults.
                 auto val = make_scoped<real_feed_t>(
-                    this, manager, access.get(), uuid, &interruptor);
-                feed_it = feeds.insert(std::make_pair(uuid, std::move(val))).first;
+                    this, manager, access.get(), key, filter, &interruptor);
+                feed_it = feeds.insert(std::make_pair(key, std::move(val))).first;
             }
 
             // We need to do this while holding `feeds_lock` to make sure the
@@ -2327,7 +2976,8 @@ counted_t<datum_stream_t> client_t::new_stream(
             on_thread_t th2(old_thread);
             real_feed_t *feed = feed_it->second.get();
             addr = feed->get_addr();
-            sub = new_sub(feed, squash, spec);
+            sub = new_sub(feed, squash, spill_to_disk ? env->get_rdb_ctx() : NULL,
+                          resume_positions, spec);
         }
         namespace_interface_access_t access = namespace_source(uuid, env->interruptor);
         sub->start_real(env, table_name, access.get(), &addr);
@@ -2339,13 +2989,13 @@ counted_t<datum_stream_t> client_t::new_stream(
     }
 }
 
-void client_t::maybe_remove_feed(const uuid_u &uuid) {
+void client_t::maybe_remove_feed(const feed_key_t &key) {
     assert_thread();
     scoped_ptr_t<real_feed_t> destroy;
     auto_drainer_t::lock_t lock(&drainer);
     rwlock_in_line_t spot(&feeds_lock, access_t::write);
     spot.write_signal()->wait_lazily_unordered();
-    auto feed_it = feeds.find(uuid);
+    auto feed_it = feeds.find(key);
     // The feed might have disappeared because it may have been detached while
     // we held the lock, in which case we don't need to do anything.  The feed
     // might also have gotten a new subscriber, in which case we don't want to
@@ -2358,7 +3008,7 @@ void client_t::maybe_remove_feed(const uuid_u &uuid) {
     }
 }
 
-scoped_ptr_t<real_feed_t> client_t::detach_feed(const uuid_u &uuid) {
+scoped_ptr_t<real_feed_t> client_t::detach_feed(const feed_key_t &key) {
     assert_thread();
     scoped_ptr_t<real_feed_t> ret;
     auto_drainer_t::lock_t lock(&drainer);
@@ -2366,7 +3016,7 @@ scoped_ptr_t<real_feed_t> client_t::detach_feed(const uuid_u &uuid) {
     spot.write_signal()->wait_lazily_unordered();
     // The feed might have been removed in `maybe_remove_feed`, in which case
     // there's nothing to detach.
-    auto feed_it = feeds.find(uuid);
+    auto feed_it = feeds.find(key);
     if (feed_it != feeds.end()) {
         ret.swap(feed_it->second);
         feeds.erase(feed_it);
@@ -2402,7 +3052,7 @@ counted_t<datum_stream_t> artificial_t::subscribe(
     // on the thread you want to use them on.
     guarantee(feed.has());
     scoped_ptr_t<subscription_t> sub = new_sub(
-        feed.get(), datum_t::boolean(false), spec);
+        feed.get(), datum_t::boolean(false), NULL, boost::none, spec);
     sub->start_artificial(uuid);
     return make_counted<stream_t>(std::move(sub), bt);
 }
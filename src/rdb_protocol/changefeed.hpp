@@ -89,6 +89,9 @@ struct msg_t {
         /* For a newly-created row, `old_val` is an empty `datum_t`. For a deleted row,
         `new_val` is an empty `datum_t`. */
         datum_t old_val, new_val;
+        // The change's position in its `server_t`'s change log, which
+        // `server_t::send_all` fills in.
+        uint64_t log_position;
         RDB_DECLARE_ME_SERIALIZABLE(change_t);
     };
     struct stop_t {
@@ -117,9 +120,20 @@ struct msg_t {
 RDB_DECLARE_SERIALIZABLE(msg_t);
 
 class real_feed_t;
-struct stamped_msg_t;
 
-typedef mailbox_addr_t<void(stamped_msg_t)> client_addr_t;
+struct stamped_msg_t {
+    stamped_msg_t() { }
+    stamped_msg_t(uuid_u _server_uuid, uint64_t _stamp, msg_t _submsg)
+        : server_uuid(std::move(_server_uuid)),
+          stamp(_stamp),
+          submsg(std::move(_submsg)) { }
+    uuid_u server_uuid;
+    uint64_t stamp;
+    msg_t submsg;
+};
+
+// Servers send the messages for a client in batches.
+typedef mailbox_addr_t<void(std::vector<stamped_msg_t>)> client_addr_t;
 
 struct keyspec_t {
     struct range_t {
@@ -191,12 +205,19 @@ public:
     counted_t<datum_stream_t> new_stream(
         env_t *env,
         const datum_t &squash,
+        bool spill_to_disk,
+        const datum_t &resume_from, // Empty unless resuming a range changefeed.
         const namespace_id_t &table,
         const protob_t<const Backtrace> &bt,
         const std::string &table_name,
         const keyspec_t::spec_t &spec);
-    void maybe_remove_feed(const namespace_id_t &uuid);
-    scoped_ptr_t<real_feed_t> detach_feed(const namespace_id_t &uuid);
+    // A table's subscriptions share one feed, except that range subscriptions
+    // with transforms get a feed per distinct spec, so that the shards can apply
+    // the transforms and only send the changes that are left.  The second half of
+    // a feed's key is its serialized spec, or empty for the shared feed.
+    typedef std::pair<namespace_id_t, std::vector<char> > feed_key_t;
+    void maybe_remove_feed(const feed_key_t &key);
+    scoped_ptr_t<real_feed_t> detach_feed(const feed_key_t &key);
 private:
     friend class subscription_t;
     mailbox_manager_t *const manager;
@@ -205,7 +226,7 @@ private:
             const namespace_id_t &,
             signal_t *)
         > const namespace_source;
-    std::map<namespace_id_t, scoped_ptr_t<real_feed_t> > feeds;
+    std::map<feed_key_t, scoped_ptr_t<real_feed_t> > feeds;
     // This lock manages access to the `feeds` map.  The `feeds` map needs to be
     // read whenever `new_stream` is called, and needs to be written to whenever
     // `new_stream` is called with a table not already in the `feeds` map, or
@@ -346,6 +367,7 @@ struct sindex_ref_t {
 };
 
 class server_t;
+class change_filter_t;
 class limit_manager_t {
 public:
     // Make sure you have a lock in the `server_t` (e.g. the lock provided by
@@ -389,6 +411,9 @@ private:
                          const boost::optional<item_queue_t::iterator> &start,
                          size_t n);
     void send(msg_t &&msg);
+    size_t buffer_capacity() const;
+    // Adds a row after the window to `buffer`, if `buffer` covers it.
+    void maybe_buffer(item_t &&item);
 
     scoped_ptr_t<env_t> env;
 
@@ -400,6 +425,12 @@ private:
 
     limit_order_t gt;
     item_queue_t item_queue;
+    // The rows right after the ones in `item_queue`, kept so that rows leaving
+    // `item_queue` can usually be replaced without reading the btree.  It holds
+    // every row between the last one in `item_queue` and its own last one, and
+    // if `buffer_complete` is true, every row after that as well.
+    item_queue_t buffer;
+    bool buffer_complete;
 
     std::vector<std::pair<std::string, std::pair<datum_t, datum_t> > > added;
     std::vector<std::string> deleted;
@@ -420,7 +451,12 @@ public:
         limit_addr_t;
     explicit server_t(mailbox_manager_t *_manager);
     ~server_t();
-    void add_client(const client_t::addr_t &addr, region_t region);
+    // If `spec` is set, the client only gets the changes that `spec` covers, with
+    // its transforms already applied.
+    void add_client(const client_t::addr_t &addr,
+                    region_t region,
+                    rdb_context_t *ctx,
+                    const boost::optional<keyspec_t::range_t> &spec);
     void add_limit_client(
         const client_t::addr_t &addr,
         const region_t &region,
@@ -436,7 +472,18 @@ public:
     void stop_all();
     addr_t get_stop_addr();
     limit_addr_t get_limit_stop_addr();
-    uint64_t get_stamp(const client_t::addr_t &addr);
+    // If `log_position_out` isn't NULL it gets the log position of the last change
+    // sent before the returned stamp.
+    uint64_t get_stamp(const client_t::addr_t &addr,
+                       uint64_t *log_position_out = NULL);
+    // Like `get_stamp`, but first queues the changes after `log_position` in the
+    // change log for `addr`, so that they get the stamps starting at the returned
+    // one.  Returns false if the log doesn't have all of them anymore.  Only the
+    // first call for a client replays anything; later ones (e.g. for the other
+    // shards of an oversharded store) return the same stamp.
+    MUST_USE bool resume(const client_t::addr_t &addr,
+                         uint64_t log_position,
+                         uint64_t *stamp_out);
     uuid_u get_uuid();
     // `f` will be called with a read lock on `clients` and a write lock on the
     // limit manager.
@@ -467,6 +514,13 @@ private:
         scoped_ptr_t<cond_t> cond;
         uint64_t stamp;
         std::vector<region_t> regions;
+        scoped_ptr_t<change_filter_t> filter;
+        // Messages that haven't been sent yet, and whether a coroutine to send
+        // them has been spawned.
+        std::vector<stamped_msg_t> batch;
+        bool flush_spawned;
+        // Set once `resume` has replayed the change log for this client.
+        boost::optional<uint64_t> resume_stamp;
         std::map<boost::optional<std::string>,
                  std::vector<scoped_ptr_t<limit_manager_t> >,
                  // Be careful not to remove this, since optionals are
@@ -488,6 +542,20 @@ private:
     void send_one_with_lock(const auto_drainer_t::lock_t &lock,
                             std::pair<const client_t::addr_t, client_info_t> *client,
                             msg_t msg);
+    // Stamps `msg` and adds it to the client's batch without blocking, and returns
+    // whether the batch should be sent right away.
+    MUST_USE bool queue_with_lock(
+        const auto_drainer_t::lock_t &lock,
+        std::pair<const client_t::addr_t, client_info_t> *client,
+        msg_t msg);
+    // Returns false if the client doesn't see `change`; otherwise `*out` is the
+    // message the client should get for it.
+    bool change_for_client(const client_info_t &info,
+                           const msg_t::change_t &change,
+                           msg_t *out);
+    void flush_with_lock(const auto_drainer_t::lock_t &lock,
+                         std::pair<const client_t::addr_t, client_info_t> *client);
+    void flush_cb(client_t::addr_t addr, auto_drainer_t::lock_t lock);
 
     // Controls access to `clients`.  A `server_t` needs to read `clients` when:
     // * `send_all` is called
@@ -501,6 +569,13 @@ private:
     // change under it.
     rwlock_t clients_lock;
 
+    // The last CHANGEFEED_LOG_SIZE changes sent to our clients, by log position,
+    // so that a client that lost its changefeed can `resume` it.  The log lives as
+    // long as `uuid` does, since the tokens that refer to it name the server by it.
+    std::deque<std::pair<uint64_t, msg_t::change_t> > change_log;
+    // The log position of the last change, or 0 if there hasn't been one.
+    uint64_t last_log_position;
+
     auto_drainer_t drainer;
     // Clients send a message to this mailbox with their address when they want
     // to unsubscribe.  The callback of this mailbox acquires the drainer, so it
@@ -0,0 +1,282 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/changefeed_reduction.hpp"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "rdb_protocol/batching.hpp"
+#include "rdb_protocol/datum_stream.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/rdb_protocol_json.hpp"
+#include "rdb_protocol/val.hpp"
+
+namespace ql {
+namespace changefeed {
+
+namespace {
+
+// Orders the rows of a group by value for `min` and `max`, with the primary key
+// breaking ties.
+struct value_key_less_t {
+    bool operator()(const std::pair<datum_t, datum_t> &a,
+                    const std::pair<datum_t, datum_t> &b) const {
+        int c = a.first.cmp(reql_version_t::LATEST, b.first);
+        return c != 0 ? c < 0 : a.second.compare_lt(reql_version_t::LATEST, b.second);
+    }
+};
+
+class reduction_stream_t : public eager_datum_stream_t {
+public:
+    reduction_stream_t(reduction_t _reduction,
+                       counted_t<const func_t> _group_func,
+                       counted_t<const func_t> _value_func,
+                       std::string _pkey,
+                       counted_t<datum_stream_t> _initial,
+                       counted_t<datum_stream_t> _changes,
+                       const protob_t<const Backtrace> &bt)
+        : eager_datum_stream_t(bt),
+          reduction(_reduction),
+          group_func(std::move(_group_func)),
+          value_func(std::move(_value_func)),
+          pkey(std::move(_pkey)),
+          initial(std::move(_initial)),
+          changes(std::move(_changes)),
+          rows(optional_datum_less_t(reql_version_t::LATEST)),
+          groups(optional_datum_less_t(reql_version_t::LATEST)) { }
+
+    virtual bool is_array() const { return false; }
+    virtual bool is_exhausted() const { return false; }
+    virtual bool is_cfeed() const { return true; }
+    virtual bool is_infinite() const { return true; }
+
+    virtual std::vector<datum_t>
+    next_raw_batch(env_t *env, const batchspec_t &bs) {
+        rcheck(bs.get_batch_type() == batch_type_t::NORMAL
+               || bs.get_batch_type() == batch_type_t::NORMAL_FIRST,
+               base_exc_t::GENERIC,
+               "Cannot call a terminal (`reduce`, `count`, etc.) on an "
+               "infinite stream (such as a changefeed).");
+        std::vector<datum_t> ret;
+        if (initial.has()) {
+            batchspec_t initial_bs = batchspec_t::user(batch_type_t::NORMAL, env);
+            std::vector<datum_t> batch;
+            while (batch = initial->next_batch(env, initial_bs), !batch.empty()) {
+                for (const auto &row : batch) {
+                    set_row(env, row.get_field(pkey.c_str()), row);
+                }
+            }
+            initial.reset();
+
+            if (group_func.has()) {
+                for (const auto &pair : groups) {
+                    ret.push_back(make_change(pair.first, datum_t(),
+                                              value_of(pair.first)));
+                }
+            } else {
+                ret.push_back(make_change(datum_t(), datum_t(),
+                                          value_of(datum_t::null())));
+            }
+            return ret;
+        }
+
+        // The value each group had before this batch, for the groups it touches.
+        std::map<datum_t, datum_t, optional_datum_less_t>
+            old_values(optional_datum_less_t(reql_version_t::LATEST));
+        for (const auto &change : changes->next_batch(env, bs)) {
+            datum_t old_val = change.get_field("old_val", NOTHROW);
+            datum_t new_val = change.get_field("new_val", NOTHROW);
+            bool has_new = new_val.has() && new_val.get_type() != datum_t::R_NULL;
+            const datum_t &row = has_new ? new_val : old_val;
+            if (!row.has() || row.get_type() != datum_t::R_OBJECT) {
+                continue;
+            }
+            datum_t key = row.get_field(pkey.c_str());
+            auto it = rows.find(key);
+            if (it != rows.end()) {
+                old_values.insert(std::make_pair(it->second.group,
+                                                 value_of(it->second.group)));
+            }
+            datum_t group = has_new ? group_of(env, new_val) : datum_t();
+            if (has_new && group.has()) {
+                old_values.insert(std::make_pair(group, value_of(group)));
+            }
+            set_row(env, key, has_new ? new_val : datum_t());
+        }
+
+        for (const auto &pair : old_values) {
+            datum_t new_value = value_of(pair.first);
+            if (!(pair.second == new_value)) {
+                ret.push_back(make_change(pair.first, pair.second, new_value));
+            }
+        }
+        return ret;
+    }
+
+private:
+    struct row_t {
+        datum_t group;
+        // Empty if the row doesn't count toward the group's `sum`, `avg`, `min` or
+        // `max` (e.g. because the field is missing).
+        datum_t value;
+    };
+    struct group_t {
+        group_t() : count(0), num_values(0), sum(0) { }
+        size_t count;
+        size_t num_values;
+        double sum;
+        // Only used for `min` and `max`.
+        std::map<std::pair<datum_t, datum_t>, datum_t, value_key_less_t> by_value;
+    };
+
+    // Returns an empty datum if the row is left out of the reduction because its
+    // group can't be computed.
+    datum_t group_of(env_t *env, const datum_t &row) const {
+        if (!group_func.has()) {
+            return datum_t::null();
+        }
+        try {
+            return group_func->call(env, row)->as_datum();
+        } catch (const base_exc_t &) {
+            return datum_t();
+        }
+    }
+
+    datum_t value_field_of(env_t *env, const datum_t &row) const {
+        if (reduction == reduction_t::COUNT) {
+            return datum_t();
+        }
+        datum_t value;
+        try {
+            value = value_func.has() ? value_func->call(env, row)->as_datum() : row;
+        } catch (const base_exc_t &) {
+            return datum_t();
+        }
+        if ((reduction == reduction_t::SUM || reduction == reduction_t::AVG)
+            && value.get_type() != datum_t::R_NUM) {
+            return datum_t();
+        }
+        return value;
+    }
+
+    // Replaces the row with primary key `key` with `row`, or removes it if `row` is
+    // empty.
+    void set_row(env_t *env, const datum_t &key, const datum_t &row) {
+        auto it = rows.find(key);
+        if (it != rows.end()) {
+            auto group_it = groups.find(it->second.group);
+            guarantee(group_it != groups.end());
+            group_t *g = &group_it->second;
+            --g->count;
+            if (it->second.value.has()) {
+                --g->num_values;
+                if (reduction == reduction_t::SUM || reduction == reduction_t::AVG) {
+                    g->sum -= it->second.value.as_num();
+                } else {
+                    g->by_value.erase(std::make_pair(it->second.value, key));
+                }
+            }
+            if (g->count == 0) {
+                groups.erase(group_it);
+            }
+            rows.erase(it);
+        }
+
+        if (!row.has()) {
+            return;
+        }
+        row_t r;
+        r.group = group_of(env, row);
+        if (!r.group.has()) {
+            return;
+        }
+        r.value = value_field_of(env, row);
+        group_t *g = &groups[r.group];
+        ++g->count;
+        if (r.value.has()) {
+            ++g->num_values;
+            if (reduction == reduction_t::SUM || reduction == reduction_t::AVG) {
+                g->sum += r.value.as_num();
+            } else {
+                g->by_value[std::make_pair(r.value, key)] = row;
+            }
+        }
+        rows.insert(std::make_pair(key, std::move(r)));
+    }
+
+    // Returns `null` for groups without any rows, except that an ungrouped `count`
+    // or `sum` of no rows is 0.
+    datum_t value_of(const datum_t &group) const {
+        auto it = groups.find(group);
+        if (it == groups.end()) {
+            if (!group_func.has()
+                && (reduction == reduction_t::COUNT || reduction == reduction_t::SUM)) {
+                return datum_t(0.0);
+            }
+            return datum_t::null();
+        }
+        const group_t &g = it->second;
+        switch (reduction) {
+        case reduction_t::COUNT:
+            return datum_t(static_cast<double>(g.count));
+        case reduction_t::SUM:
+            return datum_t(g.sum);
+        case reduction_t::AVG:
+            return g.num_values == 0
+                ? datum_t::null()
+                : datum_t(g.sum / static_cast<double>(g.num_values));
+        case reduction_t::MIN:
+            return g.by_value.empty() ? datum_t::null() : g.by_value.begin()->second;
+        case reduction_t::MAX:
+            return g.by_value.empty() ? datum_t::null() : g.by_value.rbegin()->second;
+        default: unreachable();
+        }
+    }
+
+    datum_t make_change(const datum_t &group,
+                        const datum_t &old_val,
+                        const datum_t &new_val) const {
+        datum_object_builder_t builder;
+        if (group_func.has()) {
+            bool dup = builder.add("group", group);
+            guarantee(!dup);
+        }
+        if (old_val.has()) {
+            bool dup = builder.add("old_val", old_val);
+            guarantee(!dup);
+        }
+        bool dup = builder.add("new_val", new_val);
+        guarantee(!dup);
+        return std::move(builder).to_datum();
+    }
+
+    const reduction_t reduction;
+    const counted_t<const func_t> group_func;
+    const counted_t<const func_t> value_func;
+    const std::string pkey;
+    // Reset once the initial values have been sent.
+    counted_t<datum_stream_t> initial;
+    const counted_t<datum_stream_t> changes;
+
+    std::map<datum_t, row_t, optional_datum_less_t> rows;
+    std::map<datum_t, group_t, optional_datum_less_t> groups;
+};
+
+}  // namespace
+
+counted_t<datum_stream_t> make_reduction_stream(
+    reduction_t reduction,
+    counted_t<const func_t> group_func,
+    counted_t<const func_t> value_func,
+    std::string pkey,
+    counted_t<datum_stream_t> initial,
+    counted_t<datum_stream_t> changes,
+    const protob_t<const Backtrace> &bt) {
+    return make_counted<reduction_stream_t>(
+        reduction, std::move(group_func), std::move(value_func), std::move(pkey),
+        std::move(initial), std::move(changes), bt);
+}
+
+}  // namespace changefeed
+}  // namespace ql
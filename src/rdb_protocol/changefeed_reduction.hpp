@@ -0,0 +1,39 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_CHANGEFEED_REDUCTION_HPP_
+#define RDB_PROTOCOL_CHANGEFEED_REDUCTION_HPP_
+
+#include <string>
+
+#include "containers/counted.hpp"
+#include "rdb_protocol/counted_term.hpp"
+
+namespace ql {
+
+class datum_stream_t;
+class func_t;
+
+namespace changefeed {
+
+enum class reduction_t { COUNT, SUM, AVG, MIN, MAX };
+
+// Returns the changes to `seq.count()` (or `sum`, `avg`, `min` or `max` of
+// `value_func`), grouped by `group_func` if it's set.  `initial` must be `seq`
+// itself and `changes` must be `seq.changes()`, opened before `initial` is read.
+// The first batch holds the current value of each group as `{new_val}` (ungrouped)
+// or `{group, new_val}`; after that each change to a group's value comes as
+// `{old_val, new_val}`, with a `new_val` of `null` when the last row leaves a group.
+// The state is kept per row, by primary key `pkey`, so rows the initial read and
+// the changefeed both see are only counted once.
+counted_t<datum_stream_t> make_reduction_stream(
+    reduction_t reduction,
+    counted_t<const func_t> group_func,
+    counted_t<const func_t> value_func,
+    std::string pkey,
+    counted_t<datum_stream_t> initial,
+    counted_t<datum_stream_t> changes,
+    const protob_t<const Backtrace> &bt);
+
+}  // namespace changefeed
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_CHANGEFEED_REDUCTION_HPP_
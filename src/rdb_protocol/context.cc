@@ -17,13 +17,25 @@ rdb_context_t::stats_t::stats_t(perfmon_collection_t *global_stats)
       queries_per_sec_membership(&qe_stats_collection,
                                  &queries_per_sec, "queries_per_sec"),
       queries_total_membership(&qe_stats_collection,
-                               &queries_total, "queries_total") { }
+                               &queries_total, "queries_total"),
+      queries_queued_membership(&qe_stats_collection,
+                                &queries_queued, "queries_queued"),
+      queries_refused_total_membership(&qe_stats_collection,
+                                       &queries_refused_total,
+                                       "queries_refused_total"),
+      query_latency(secs_to_ticks(LATENCY_HISTOGRAM_INTERVAL_SECS)),
+      query_latency_membership(&qe_stats_collection,
+                               &query_latency, "query_latency") { }
 
 rdb_context_t::rdb_context_t()
     : extproc_pool(nullptr),
       cluster_interface(nullptr),
+      io_backender(nullptr),
+      base_path(""),
       manager(nullptr),
       reql_http_proxy(),
+      slow_query_threshold_ms(0),
+      outdated_read_cache_ms(0),
       stats(&get_global_perfmon_collection()) { }
 
 rdb_context_t::rdb_context_t(
@@ -31,8 +43,12 @@ rdb_context_t::rdb_context_t(
         reql_cluster_interface_t *_cluster_interface)
     : extproc_pool(_extproc_pool),
       cluster_interface(_cluster_interface),
+      io_backender(nullptr),
+      base_path(""),
       manager(nullptr),
       reql_http_proxy(),
+      slow_query_threshold_ms(0),
+      outdated_read_cache_ms(0),
       stats(&get_global_perfmon_collection()) { }
 
 rdb_context_t::rdb_context_t(
@@ -42,12 +58,20 @@ rdb_context_t::rdb_context_t(
         boost::shared_ptr< semilattice_readwrite_view_t<auth_semilattice_metadata_t> >
             _auth_metadata,
         perfmon_collection_t *global_stats,
-        const std::string &_reql_http_proxy)
+        const std::string &_reql_http_proxy,
+        int _slow_query_threshold_ms,
+        int _outdated_read_cache_ms,
+        io_backender_t *_io_backender,
+        const base_path_t &_base_path)
     : extproc_pool(_extproc_pool),
       cluster_interface(_cluster_interface),
+      io_backender(_io_backender),
+      base_path(_base_path),
       auth_metadata(_auth_metadata),
       manager(_mailbox_manager),
       reql_http_proxy(_reql_http_proxy),
+      slow_query_threshold_ms(_slow_query_threshold_ms),
+      outdated_read_cache_ms(_outdated_read_cache_ms),
       stats(global_stats)
 { }
 
@@ -56,3 +80,19 @@ rdb_context_t::~rdb_context_t() { }
 rdb_context_t::query_jobs_t * rdb_context_t::get_query_jobs_for_this_thread() {
     return query_jobs.get();
 }
+
+const rdb_context_t::slow_queries_t &rdb_context_t::get_slow_queries_for_this_thread() {
+    return *slow_queries.get();
+}
+
+void rdb_context_t::record_slow_query(slow_query_t &&slow_query) {
+    slow_queries_t *history = slow_queries.get();
+    if (history->size() >= SLOW_QUERY_HISTORY_SIZE) {
+        history->pop_front();
+    }
+    history->push_back(std::move(slow_query));
+}
+
+ql::outdated_read_cache_t *rdb_context_t::get_outdated_read_cache_for_this_thread() {
+    return outdated_read_caches.get();
+}
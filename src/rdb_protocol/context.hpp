@@ -2,6 +2,7 @@
 #ifndef RDB_PROTOCOL_CONTEXT_HPP_
 #define RDB_PROTOCOL_CONTEXT_HPP_
 
+#include <deque>
 #include <map>
 #include <set>
 #include <string>
@@ -17,14 +18,17 @@
 #include "containers/name_string.hpp"
 #include "containers/scoped.hpp"
 #include "containers/uuid.hpp"
+#include "perfmon/histogram.hpp"
 #include "perfmon/perfmon.hpp"
 #include "protocol_api.hpp"
 #include "rdb_protocol/changefeed.hpp"
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/geo/distances.hpp"
 #include "rdb_protocol/geo/lon_lat_types.hpp"
+#include "rdb_protocol/outdated_read_cache.hpp"
 #include "rdb_protocol/shards.hpp"
 #include "rdb_protocol/wire_func.hpp"
+#include "utils.hpp"
 
 enum class return_changes_t {
     NO = 0,
@@ -37,6 +41,7 @@ ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
 class auth_semilattice_metadata_t;
 class ellipsoid_spec_t;
 class extproc_pool_t;
+class io_backender_t;
 class name_string_t;
 class namespace_interface_t;
 template <class> class semilattice_readwrite_view_t;
@@ -84,6 +89,10 @@ public:
 
     virtual ql::datum_t read_row(ql::env_t *env,
         ql::datum_t pval, bool use_outdated) = 0;
+    /* Returns the rows for `pvals`, in the same order.  Keys without a row get
+    `null`. */
+    virtual std::vector<ql::datum_t> read_rows(ql::env_t *env,
+        const std::vector<ql::datum_t> &pvals, bool use_outdated) = 0;
     virtual counted_t<ql::datum_stream_t> read_all(
         ql::env_t *env,
         const std::string &sindex,
@@ -95,6 +104,8 @@ public:
     virtual counted_t<ql::datum_stream_t> read_changes(
         ql::env_t *env,
         const ql::datum_t &squash,
+        bool spill_to_disk,
+        const ql::datum_t &resume_from,
         ql::changefeed::keyspec_t::spec_t &&spec,
         const ql::protob_t<const Backtrace> &bt,
         const std::string &table_name) = 0;
@@ -128,10 +139,13 @@ public:
         durability_requirement_t durability) = 0;
     virtual bool write_sync_depending_on_durability(ql::env_t *env,
         durability_requirement_t durability) = 0;
+    virtual bool write_truncate(ql::env_t *env,
+        durability_requirement_t durability) = 0;
 
     virtual bool sindex_create(ql::env_t *env, const std::string &id,
         counted_t<const ql::func_t> index_func, sindex_multi_bool_t multi,
-        sindex_geo_bool_t geo) = 0;
+        sindex_geo_bool_t geo, const std::vector<std::string> &covering,
+        counted_t<const ql::func_t> filter) = 0;
     virtual bool sindex_drop(ql::env_t *env, const std::string &id) = 0;
     virtual sindex_rename_result_t sindex_rename(ql::env_t *env,
         const std::string &old_name, const std::string &new_name, bool overwrite) = 0;
@@ -178,7 +192,7 @@ public:
     /* `table_create()` won't return until the table is ready for reading */
     virtual bool table_create(const name_string_t &name, counted_t<const ql::db_t> db,
             const table_generate_config_params_t &config_params,
-            const std::string &primary_key,
+            const std::string &primary_key, uint32_t block_size, bool compress_blocks,
             signal_t *interruptor, ql::datum_t *result_out, std::string *error_out) = 0;
     virtual bool table_drop(const name_string_t &name, counted_t<const ql::db_t> db,
             signal_t *interruptor, ql::datum_t *result_out, std::string *error_out) = 0;
@@ -258,6 +272,7 @@ protected:
 
 class mailbox_manager_t;
 class query_job_t;
+class slow_query_t;
 
 class rdb_context_t {
 public:
@@ -275,13 +290,23 @@ public:
                     semilattice_readwrite_view_t<
                         auth_semilattice_metadata_t> > _auth_metadata,
                   perfmon_collection_t *global_stats,
-                  const std::string &_reql_http_proxy);
+                  const std::string &_reql_http_proxy,
+                  int _slow_query_threshold_ms,
+                  int _outdated_read_cache_ms,
+                  io_backender_t *_io_backender,
+                  const base_path_t &_base_path);
 
     ~rdb_context_t();
 
     extproc_pool_t *extproc_pool;
     reql_cluster_interface_t *cluster_interface;
 
+    // Used for temporary files, e.g. when sorting more data than fits in memory.
+    // `io_backender` is NULL if we have no place for them (in proxies and in unit
+    // tests).
+    io_backender_t *io_backender;
+    const base_path_t base_path;
+
     boost::shared_ptr< semilattice_readwrite_view_t<auth_semilattice_metadata_t> >
         auth_metadata;
 
@@ -289,6 +314,15 @@ public:
 
     const std::string reql_http_proxy;
 
+    // Queries that take at least this long are recorded with `record_slow_query`;
+    // zero means none are.
+    const int slow_query_threshold_ms;
+
+    // Point reads with `use_outdated` may be answered from
+    // `get_outdated_read_cache_for_this_thread` with rows read at most this long
+    // ago; zero means they never are.
+    const int outdated_read_cache_ms;
+
     class stats_t {
     public:
         explicit stats_t(perfmon_collection_t *global_stats);
@@ -303,6 +337,15 @@ public:
         perfmon_membership_t queries_per_sec_membership;
         perfmon_counter_t queries_total;
         perfmon_membership_t queries_total_membership;
+        // Queries waiting to be admitted (see `query_admission_t`), and the ones that
+        // got refused.
+        perfmon_counter_t queries_queued;
+        perfmon_membership_t queries_queued_membership;
+        perfmon_counter_t queries_refused_total;
+        perfmon_membership_t queries_refused_total_membership;
+        // From when a query arrives until its response (or first batch) is ready.
+        perfmon_latency_histogram_t query_latency;
+        perfmon_membership_t query_latency_membership;
     private:
         DISABLE_COPYING(stats_t);
     } stats;
@@ -310,8 +353,18 @@ public:
     typedef std::map<uuid_u, query_job_t> query_jobs_t;
     query_jobs_t * get_query_jobs_for_this_thread();
 
+    // The last `SLOW_QUERY_HISTORY_SIZE` slow queries run on this thread, oldest
+    // first.
+    typedef std::deque<slow_query_t> slow_queries_t;
+    const slow_queries_t &get_slow_queries_for_this_thread();
+    void record_slow_query(slow_query_t &&slow_query);
+
+    ql::outdated_read_cache_t *get_outdated_read_cache_for_this_thread();
+
 private:
     one_per_thread_t<query_jobs_t> query_jobs;
+    one_per_thread_t<slow_queries_t> slow_queries;
+    one_per_thread_t<ql::outdated_read_cache_t> outdated_read_caches;
 
 private:
     DISABLE_COPYING(rdb_context_t);
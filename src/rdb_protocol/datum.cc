@@ -14,6 +14,7 @@
 
 #include "containers/archive/stl_types.hpp"
 #include "containers/scoped.hpp"
+#include "http/json/json_reader.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/pseudo_binary.hpp"
@@ -465,6 +466,50 @@ datum_t to_datum(cJSON *json, const configured_limits_t &limits,
     }
 }
 
+datum_t to_datum(json_reader_t *json, const configured_limits_t &limits,
+                 reql_version_t reql_version) {
+    switch (json->peek()) {
+    case json_value_type_t::NUL: {
+        json->read_null();
+        return datum_t::null();
+    } break;
+    case json_value_type_t::BOOL: {
+        return datum_t::boolean(json->read_bool());
+    } break;
+    case json_value_type_t::NUMBER: {
+        return datum_t(json->read_number());
+    } break;
+    case json_value_type_t::STRING: {
+        std::string str;
+        json->read_string(&str);
+        fail_if_invalid(reql_version, str);
+        return datum_t(datum_string_t(str));
+    } break;
+    case json_value_type_t::ARRAY: {
+        std::vector<datum_t> array;
+        json->begin_array();
+        while (json->next_element()) {
+            array.push_back(to_datum(json, limits, reql_version));
+        }
+        return datum_t(std::move(array), limits);
+    } break;
+    case json_value_type_t::OBJECT: {
+        datum_object_builder_t builder;
+        std::string key;
+        json->begin_object();
+        while (json->next_member(&key)) {
+            fail_if_invalid(reql_version, key);
+            bool dup = builder.add(intern_field_name(key),
+                                   to_datum(json, limits, reql_version));
+            rcheck_datum(!dup, base_exc_t::GENERIC,
+                         strprintf("Duplicate key `%s` in JSON.", key.c_str()));
+        }
+        const std::set<std::string> pts = { pseudo::literal_string };
+        return std::move(builder).to_datum(pts);
+    } break;
+    default: unreachable();
+    }
+}
 
 void check_str_validity(const char *bytes, size_t count) {
     const char *pos = static_cast<const char *>(memchr(bytes, 0, count));
@@ -1036,6 +1081,64 @@ std::string datum_t::extract_secondary(const std::string &secondary) {
     return components.secondary;
 }
 
+datum_t datum_t::extract_secondary_value(const store_key_t &key,
+                                         reql_version_t reql_version) {
+    switch (reql_version) {
+    case reql_version_t::v1_13:
+        // There's no terminator, so we can't tell where strings end.
+        return datum_t();
+    case reql_version_t::v1_14: // v1_15 is the same as v1_14
+    case reql_version_t::v1_16_is_latest:
+        break;
+    default:
+        unreachable();
+    }
+    if (key_is_truncated(key)) {
+        return datum_t();
+    }
+    std::string secondary = extract_secondary(key_to_unescaped_str(key));
+    if (secondary.size() < 2 || secondary[secondary.size() - 1] != '\x00') {
+        return datum_t();
+    }
+    secondary.erase(secondary.size() - 1);
+
+    if (secondary[0] == 'S') {
+        return datum_t(datum_string_t(secondary.size() - 1, secondary.data() + 1));
+    } else if (secondary == "Bt" || secondary == "Bf") {
+        return datum_t::boolean(secondary[1] == 't');
+    } else if (secondary[0] == 'N') {
+        // The inverse of `num_to_str_key`.
+        const size_t hex_digits = sizeof(double) * 2;
+        if (secondary.size() < hex_digits + 2 || secondary[hex_digits + 1] != '#') {
+            return datum_t();
+        }
+        union {
+            double d;
+            uint64_t u;
+        } packed;
+        packed.u = 0;
+        for (size_t i = 1; i <= hex_digits; ++i) {
+            const char c = secondary[i];
+            uint64_t digit;
+            if (c >= '0' && c <= '9') {
+                digit = c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                digit = c - 'a' + 10;
+            } else {
+                return datum_t();
+            }
+            packed.u = (packed.u << 4) | digit;
+        }
+        if (packed.u & (1ULL << 63)) {
+            packed.u ^= (1ULL << 63);
+        } else {
+            packed.u = ~packed.u;
+        }
+        return datum_t(packed.d);
+    }
+    return datum_t();
+}
+
 boost::optional<uint64_t> datum_t::extract_tag(const std::string &secondary) {
     components_t components;
     parse_secondary(secondary, &components);
@@ -1214,23 +1317,32 @@ std::pair<datum_string_t, datum_t> datum_t::unchecked_get_pair(size_t index) con
 }
 
 datum_t datum_t::get_field(const datum_string_t &key, throw_bool_t throw_bool) const {
-    // Use binary search on top of unchecked_get_pair()
-    size_t range_beg = 0;
-    // The obj_size() also makes sure that this has the right type (R_OBJECT)
-    size_t range_end = obj_size();
-    while (range_beg < range_end) {
-        const size_t center = range_beg + ((range_end - range_beg) / 2);
-        auto center_pair = unchecked_get_pair(center);
-        const int cmp = key.compare(center_pair.first);
-        if (cmp == 0) {
-            // Found it
-            return center_pair.second;
-        } else if (cmp < 0) {
-            range_end = center;
-        } else {
-            range_beg = center + 1;
+    if (data.get_internal_type() == internal_type_t::BUF_R_OBJECT) {
+        // Search the serialized keys directly, so that we only deserialize the
+        // value we're looking for.
+        size_t value_offset;
+        if (datum_find_field_offset(data.buf_ref, key, &value_offset)) {
+            return datum_deserialize_from_buf(data.buf_ref, value_offset);
+        }
+    } else {
+        // Use binary search on top of unchecked_get_pair()
+        size_t range_beg = 0;
+        // The obj_size() also makes sure that this has the right type (R_OBJECT)
+        size_t range_end = obj_size();
+        while (range_beg < range_end) {
+            const size_t center = range_beg + ((range_end - range_beg) / 2);
+            auto center_pair = unchecked_get_pair(center);
+            const int cmp = key.compare(center_pair.first);
+            if (cmp == 0) {
+                // Found it
+                return center_pair.second;
+            } else if (cmp < 0) {
+                range_end = center;
+            } else {
+                range_beg = center + 1;
+            }
+            rassert(range_beg <= range_end);
         }
-        rassert(range_beg <= range_end);
     }
 
     // Didn't find it
@@ -1280,6 +1392,129 @@ scoped_cJSON_t datum_t::as_json() const {
     return scoped_cJSON_t(as_json_raw());
 }
 
+// Escapes strings the same way `cJSON` does.
+void write_json_string(const char *data, size_t size, std::string *out) {
+    out->push_back('"');
+    const char *const end = data + size;
+    while (data != end) {
+        // Copy runs of characters that don't need escaping in one go.
+        const char *run_end = data;
+        while (run_end != end && static_cast<unsigned char>(*run_end) > 31
+               && *run_end != '"' && *run_end != '\\') {
+            ++run_end;
+        }
+        out->append(data, run_end - data);
+        data = run_end;
+        if (data == end) {
+            break;
+        }
+        const unsigned char c = *data++;
+        switch (c) {
+        case '\\': out->append("\\\\", 2); break;
+        case '"': out->append("\\\"", 2); break;
+        case '\b': out->append("\\b", 2); break;
+        case '\f': out->append("\\f", 2); break;
+        case '\n': out->append("\\n", 2); break;
+        case '\r': out->append("\\r", 2); break;
+        case '\t': out->append("\\t", 2); break;
+        default: {
+            char buf[7];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out->append(buf, 6);
+        } break;
+        }
+    }
+    out->push_back('"');
+}
+
+// Formats numbers the same way `cJSON` does (`%.20g`), but integers, which make
+// up most numbers in practice, don't go through `snprintf`.
+void write_json_number(double d, std::string *out) {
+    // so we can use `isfinite` in a GCC 4.4.3-compatible way
+    using namespace std;  // NOLINT(build/namespaces)
+    guarantee(isfinite(d));
+    if (d == floor(d) && fabs(d) < 1e15 && !(d == 0 && signbit(d))) {
+        int64_t i = static_cast<int64_t>(d);
+        char buf[20];
+        char *p = buf + sizeof(buf);
+        const bool negative = i < 0;
+        uint64_t u = negative ? -static_cast<uint64_t>(i) : static_cast<uint64_t>(i);
+        do {
+            *--p = '0' + (u % 10);
+            u /= 10;
+        } while (u != 0);
+        if (negative) {
+            *--p = '-';
+        }
+        out->append(p, buf + sizeof(buf) - p);
+    } else {
+        char buf[64];
+        const int size = snprintf(buf, sizeof(buf), "%.20g", d);
+        guarantee(size > 0 && static_cast<size_t>(size) < sizeof(buf));
+        out->append(buf, size);
+    }
+}
+
+void datum_t::write_json(std::string *out) const {
+    switch (get_type()) {
+    case R_NULL: out->append("null", 4); break;
+    case R_BINARY: {
+        out->append("{", 1);
+        write_json_string(reql_type_string.data(), reql_type_string.size(), out);
+        out->append(":", 1);
+        write_json_string(pseudo::binary_string, strlen(pseudo::binary_string), out);
+        out->append(",", 1);
+        write_json_string(pseudo::data_key, strlen(pseudo::data_key), out);
+        out->append(":", 1);
+        // Base64 only needs its line breaks escaped, so it's written to `out`
+        // directly.
+        out->push_back('"');
+        pseudo::append_base64(as_binary(), "\\r\\n", out);
+        out->push_back('"');
+        out->append("}", 1);
+    } break;
+    case R_BOOL: {
+        if (as_bool()) {
+            out->append("true", 4);
+        } else {
+            out->append("false", 5);
+        }
+    } break;
+    case R_NUM: write_json_number(as_num(), out); break;
+    case R_STR: {
+        const datum_string_t &str = as_str();
+        write_json_string(str.data(), str.size(), out);
+    } break;
+    case R_ARRAY: {
+        out->push_back('[');
+        const size_t sz = arr_size();
+        for (size_t i = 0; i < sz; ++i) {
+            if (i != 0) {
+                out->push_back(',');
+            }
+            unchecked_get(i).write_json(out);
+        }
+        out->push_back(']');
+    } break;
+    case R_OBJECT: {
+        out->push_back('{');
+        const size_t sz = obj_size();
+        for (size_t i = 0; i < sz; ++i) {
+            if (i != 0) {
+                out->push_back(',');
+            }
+            auto pair = get_pair(i);
+            write_json_string(pair.first.data(), pair.first.size(), out);
+            out->push_back(':');
+            pair.second.write_json(out);
+        }
+        out->push_back('}');
+    } break;
+    case UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
 // TODO: make BINARY, STR, and OBJECT convertible to sequence?
 counted_t<datum_stream_t>
 datum_t::as_datum_stream(const protob_t<const Backtrace> &backtrace) const {
@@ -1347,7 +1582,7 @@ datum_t datum_t::merge(const datum_t &rhs) const {
                 r_sanity_check(!encountered_literal || !is_literal);
             }
             if (val.has()) {
-                d.overwrite(pair.first, val);
+                d.overwrite(pair.first, std::move(val));
             } else {
                 r_sanity_check(is_literal);
                 UNUSED bool b = d.delete_field(pair.first);
@@ -1567,7 +1802,7 @@ datum_t to_datum(const Datum *d, const configured_limits_t &limits,
         const int count = d->r_object_size();
         for (int i = 0; i < count; ++i) {
             const Datum_AssocPair *ap = &d->r_object(i);
-            datum_string_t key(ap->key());
+            datum_string_t key = intern_field_name(ap->key());
             datum_t::check_str_validity(key);
             fail_if_invalid(reql_version, ap->key());
             auto res = map.insert(std::make_pair(key,
@@ -1651,7 +1886,11 @@ void datum_t::write_to_protobuf(Datum *d, use_json_t use_json) const {
     } break;
     case use_json_t::YES: {
         d->set_type(Datum::R_JSON);
-        d->set_r_str(as_json().PrintUnformatted());
+        write_json(d->mutable_r_str());
+    } break;
+    case use_json_t::SERIALIZED: {
+        d->set_type(Datum::R_SERIALIZED);
+        datum_serialize_onto_string(*this, d->mutable_r_str());
     } break;
     default: unreachable();
     }
@@ -1721,7 +1960,7 @@ bool datum_object_builder_t::add(const datum_string_t &key, datum_t val) {
 }
 
 bool datum_object_builder_t::add(const char *key, datum_t val) {
-    return add(datum_string_t(key), val);
+    return add(datum_string_t(key), std::move(val));
 }
 
 void datum_object_builder_t::overwrite(const datum_string_t &key,
@@ -1733,7 +1972,7 @@ void datum_object_builder_t::overwrite(const datum_string_t &key,
 
 void datum_object_builder_t::overwrite(const char *key,
                                        datum_t val) {
-    return overwrite(datum_string_t(key), val);
+    return overwrite(datum_string_t(key), std::move(val));
 }
 
 void datum_object_builder_t::add_warning(const char *msg, const configured_limits_t &limits) {
@@ -29,6 +29,7 @@
 #define PR_RECONSTRUCTABLE_DOUBLE ".20g"
 
 class Datum;
+class json_reader_t;
 
 RDB_DECLARE_SERIALIZABLE(Datum);
 
@@ -66,7 +67,10 @@ enum throw_bool_t { NOTHROW = 0, THROW = 1 };
 // CLOBBER: Overwrite existing values.
 enum clobber_bool_t { NOCLOBBER = 0, CLOBBER = 1 };
 
-enum class use_json_t { NO = 0, YES = 1 };
+// How `datum_t::write_to_protobuf` encodes datums for the client: as a tree of
+// `Datum` protobufs (NO), as JSON text (YES), or in their serialized form
+// (SERIALIZED, for clients that use the binary wire protocol).
+enum class use_json_t { NO = 0, YES = 1, SERIALIZED = 2 };
 
 void debug_print(printf_buffer_t *, const datum_t &);
 
@@ -210,6 +214,11 @@ public:
             const std::string &secondary_and_primary);
     static boost::optional<uint64_t> extract_tag(const store_key_t &key);
     static components_t extract_all(const std::string &secondary_and_primary);
+    /* Returns the index value that `print_secondary` encoded into `key`, or an
+    empty datum if the key doesn't tell.  Only numbers, strings and bools in keys
+    that weren't truncated are decoded. */
+    static datum_t extract_secondary_value(const store_key_t &key,
+                                           reql_version_t reql_version);
     store_key_t truncated_secondary() const;
     void check_type(type_t desired, const char *msg = NULL) const;
     void type_error(const std::string &msg) const NORETURN;
@@ -254,6 +263,9 @@ public:
 
     cJSON *as_json_raw() const;
     scoped_cJSON_t as_json() const;
+    // Appends the same unformatted JSON that `as_json().PrintUnformatted()` would
+    // produce to `out`, without building a `cJSON` tree first.
+    void write_json(std::string *out) const;
     counted_t<datum_stream_t> as_datum_stream(
             const protob_t<const Backtrace> &backtrace) const;
 
@@ -422,6 +434,9 @@ private:
 
 datum_t to_datum(const Datum *d, const configured_limits_t &, reql_version_t);
 datum_t to_datum(cJSON *json, const configured_limits_t &, reql_version_t);
+// Reads the next value from `json`. Throws `json_reader_exc_t` if it isn't valid
+// JSON and the usual datum errors if it isn't a valid datum.
+datum_t to_datum(json_reader_t *json, const configured_limits_t &, reql_version_t);
 
 // This should only be used to send responses to the client.
 datum_t to_datum_for_client_serialization(grouped_data_t &&gd,
@@ -1,12 +1,20 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/datum_stream.hpp"
 
+#include <exception>
 #include <map>
 
 #include "boost_utils.hpp"
+#include "concurrency/pmap.hpp"
+#include "containers/disk_backed_queue.hpp"
+#include "containers/uuid.hpp"
 #include "rdb_protocol/batching.hpp"
+#include "rdb_protocol/context.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
+#include "rdb_protocol/parallel_eval.hpp"
+#include "rdb_protocol/pseudo_geometry.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
 #include "rdb_protocol/term.hpp"
 #include "rdb_protocol/val.hpp"
 #include "utils.hpp"
@@ -180,7 +188,10 @@ std::vector<rget_item_t> rget_reader_t::do_range_read(
 
     // groups_to_batch asserts that underlying_map has 0 or 1 elements, so it is
     // correct to declare that the order doesn't matter.
-    return groups_to_batch(gs->get_underlying_map(grouped::order_doesnt_matter_t()));
+    std::vector<rget_item_t> batch
+        = groups_to_batch(gs->get_underlying_map(grouped::order_doesnt_matter_t()));
+    env->charge_rows_read(batch.size());
+    return batch;
 }
 
 bool rget_reader_t::load_items(env_t *env, const batchspec_t &batchspec) {
@@ -296,7 +307,10 @@ std::vector<rget_item_t> intersecting_reader_t::do_intersecting_read(
 
     // groups_to_batch asserts that underlying_map has 0 or 1 elements, so it is
     // correct to declare that the order doesn't matter.
-    return groups_to_batch(gs->get_underlying_map(grouped::order_doesnt_matter_t()));
+    std::vector<rget_item_t> batch
+        = groups_to_batch(gs->get_underlying_map(grouped::order_doesnt_matter_t()));
+    env->charge_rows_read(batch.size());
+    return batch;
 }
 
 readgen_t::readgen_t(
@@ -476,7 +490,13 @@ void sindex_readgen_t::sindex_sort(std::vector<rget_item_t> *vec) const {
         return;
     }
     if (sorting != sorting_t::UNORDERED) {
-        std::stable_sort(vec->begin(), vec->end(), sindex_compare_t(sorting));
+        // The shards' results come merged by their keys already, and those are only
+        // out of order if the sindex values got truncated, so this is usually just
+        // one pass.
+        sindex_compare_t compare(sorting);
+        if (!std::is_sorted(vec->begin(), vec->end(), compare)) {
+            std::stable_sort(vec->begin(), vec->end(), compare);
+        }
     }
 }
 
@@ -734,6 +754,12 @@ eager_datum_stream_t::done_t eager_datum_stream_t::next_grouped_batch(
         if (v.size() == 0) {
             return done_t::YES;
         }
+        if (maybe_apply_transforms_in_parallel(env, transforms, &v)) {
+            if (v.size() != 0) {
+                (*out)[datum_t()] = std::move(v);
+            }
+            continue;
+        }
         (*out)[datum_t()] = std::move(v);
         for (auto it = ops.begin(); it != ops.end(); ++it) {
             (**it)(env, out, datum_t());
@@ -782,7 +808,7 @@ datum_t eager_datum_stream_t::as_array(env_t *env) {
         profile::sampler_t sampler("Evaluating stream eagerly.", env->trace);
         datum_t d;
         while (d = next(env, batchspec), d.has()) {
-            arr.add(d);
+            arr.add(std::move(d));
             sampler.new_sample();
         }
     }
@@ -875,11 +901,8 @@ bool array_datum_stream_t::is_array() const {
 // INDEXED_SORT_DATUM_STREAM_T
 indexed_sort_datum_stream_t::indexed_sort_datum_stream_t(
     counted_t<datum_stream_t> stream,
-    std::function<bool(env_t *,  // NOLINT(readability/casting)
-                       profile::sampler_t *,
-                       const datum_t &,
-                       const datum_t &)> _lt_cmp)
-    : wrapper_datum_stream_t(stream), lt_cmp(_lt_cmp), index(0) { }
+    sort_order_t _sort_order)
+    : wrapper_datum_stream_t(stream), sort_order(std::move(_sort_order)), index(0) { }
 
 std::vector<datum_t>
 indexed_sort_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batchspec) {
@@ -901,8 +924,7 @@ indexed_sort_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batch
             if (index >= data.size()) {
                 return ret;
             }
-            std::stable_sort(data.begin(), data.end(),
-                             std::bind(lt_cmp, env, &sampler, ph::_1, ph::_2));
+            sort_order.sort(env, &sampler, &data);
         }
         for (; index < data.size() && !batcher.should_send_batch(); ++index) {
             batcher.note_el(data[index]);
@@ -912,6 +934,405 @@ indexed_sort_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batch
     return ret;
 }
 
+// UNINDEXED_SORT_DATUM_STREAM_T
+unindexed_sort_datum_stream_t::unindexed_sort_datum_stream_t(
+    counted_t<datum_stream_t> stream,
+    sort_order_t _sort_order,
+    const protob_t<const Backtrace> &bt)
+    : wrapper_datum_stream_t(stream), sort_order(std::move(_sort_order)),
+      has_limit(false), limit_n(0), sorted(false), index(0) {
+    update_bt(bt);
+}
+
+unindexed_sort_datum_stream_t::~unindexed_sort_datum_stream_t() { }
+
+void unindexed_sort_datum_stream_t::limit(size_t n) {
+    if (sorted || ops_to_do() || is_grouped()) {
+        return;
+    }
+    if (!has_limit || n < limit_n) {
+        has_limit = true;
+        limit_n = n;
+    }
+}
+
+datum_t unindexed_sort_datum_stream_t::as_array(env_t *env) {
+    if (is_grouped()) {
+        return datum_t();
+    }
+    if (!sorted) {
+        sort_source(env);
+    }
+    // If we spilled to disk the result is too big to be an array.
+    return runs.empty() ? eager_datum_stream_t::as_array(env) : datum_t();
+}
+
+bool unindexed_sort_datum_stream_t::is_exhausted() const {
+    if (!sorted) {
+        return false;
+    }
+    return index >= data.size() && merge_heap.empty() && batch_cache_exhausted();
+}
+
+void unindexed_sort_datum_stream_t::sort_source(env_t *env) {
+    r_sanity_check(!sorted);
+    profile::sampler_t sampler("Sorting in-memory.", env->trace);
+    if (has_limit) {
+        sort_source_with_limit(env, &sampler);
+        sorted = true;
+        return;
+    }
+
+    batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+    rdb_context_t *ctx = env->get_rdb_ctx();
+    const bool can_spill = ctx != NULL && ctx->io_backender != NULL;
+    data_memory.init(new query_memory_t::reservation_t(env->get_query_memory()));
+    for (;;) {
+        std::vector<datum_t> batch = source->next_batch(env, batchspec);
+        if (batch.size() == 0) {
+            break;
+        }
+        size_t batch_bytes = 0;
+        for (const auto &d : batch) {
+            batch_bytes += datum_serialized_size(
+                d, check_datum_serialization_errors_t::NO);
+        }
+        data_memory->add(batch_bytes);
+        std::move(batch.begin(), batch.end(), std::back_inserter(data));
+        // We spill once the rows wouldn't fit in an array, or once they take up
+        // more memory than the query (or the server) should spend on them.
+        if (can_spill && (data.size() >= env->limits().array_size_limit()
+                          || data_memory->is_over_budget())) {
+            spill_run(env, &sampler);
+        }
+        rcheck_array_size(data, env->limits(), base_exc_t::GENERIC);
+    }
+    if (runs.empty()) {
+        sort_order.sort(env, &sampler, &data);
+    } else {
+        spill_run(env, &sampler);
+        for (size_t run = 0; run < runs.size(); ++run) {
+            pop_run(env, run);
+        }
+    }
+    sorted = true;
+}
+
+void unindexed_sort_datum_stream_t::sort_source_with_limit(
+    env_t *env, profile::sampler_t *sampler) {
+    batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+    // A max-heap of the first `limit_n` elements seen so far, by sort order.  Ties
+    // are broken by position in the source, so that we end up with the same
+    // elements in the same order as `std::stable_sort` would.
+    struct heap_el_t {
+        sort_key_t key;
+        datum_t row;
+        uint64_t position;
+    };
+    auto heap_lt = [&](const heap_el_t &a, const heap_el_t &b) {
+        if (sort_order.lt(env, a.key, b.key)) {
+            return true;
+        } else if (sort_order.lt(env, b.key, a.key)) {
+            return false;
+        }
+        return a.position < b.position;
+    };
+    std::vector<heap_el_t> heap;
+    uint64_t position = 0;
+    for (;;) {
+        std::vector<datum_t> batch = source->next_batch(env, batchspec);
+        if (batch.size() == 0) {
+            break;
+        }
+        for (auto &&el : batch) {
+            sampler->new_sample();
+            heap_el_t heap_el{sort_order.key(env, el), std::move(el), position++};
+            if (heap.size() < limit_n) {
+                heap.push_back(std::move(heap_el));
+                std::push_heap(heap.begin(), heap.end(), heap_lt);
+            } else if (limit_n != 0 && heap_lt(heap_el, heap.front())) {
+                std::pop_heap(heap.begin(), heap.end(), heap_lt);
+                heap.back() = std::move(heap_el);
+                std::push_heap(heap.begin(), heap.end(), heap_lt);
+            }
+        }
+    }
+    std::sort_heap(heap.begin(), heap.end(), heap_lt);
+    data.reserve(heap.size());
+    for (auto &&heap_el : heap) {
+        data.push_back(std::move(heap_el.row));
+    }
+}
+
+void unindexed_sort_datum_stream_t::spill_run(env_t *env,
+                                              profile::sampler_t *sampler) {
+    sort_order.sort(env, sampler, &data);
+    rdb_context_t *ctx = env->get_rdb_ctx();
+    r_sanity_check(ctx != NULL && ctx->io_backender != NULL);
+    scoped_ptr_t<disk_backed_queue_t<datum_t> > run(
+        new disk_backed_queue_t<datum_t>(
+            ctx->io_backender,
+            serializer_filepath_t(ctx->base_path,
+                                  "sort_" + uuid_to_str(generate_uuid())),
+            &runs_stats));
+    run->push(data);
+    runs.push_back(std::move(run));
+    data.clear();
+    data_memory->clear();
+}
+
+bool unindexed_sort_datum_stream_t::pop_run(env_t *env, size_t run) {
+    if (runs[run]->empty()) {
+        return false;
+    }
+    datum_t el;
+    runs[run]->pop(&el);
+    sort_key_t key = sort_order.key(env, el);
+    merge_heap.push_back(merge_el_t{std::move(key), std::move(el), run});
+    std::push_heap(merge_heap.begin(), merge_heap.end(),
+                   std::bind(&unindexed_sort_datum_stream_t::merge_gt,
+                             this, env, ph::_1, ph::_2));
+    return true;
+}
+
+bool unindexed_sort_datum_stream_t::merge_gt(env_t *env,
+                                             const merge_el_t &a,
+                                             const merge_el_t &b) {
+    if (sort_order.lt(env, b.key, a.key)) {
+        return true;
+    } else if (sort_order.lt(env, a.key, b.key)) {
+        return false;
+    }
+    // Ties go to the earlier run, which keeps the sort stable since each run is a
+    // contiguous part of the source.
+    return a.run > b.run;
+}
+
+std::vector<datum_t>
+unindexed_sort_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batchspec) {
+    if (!sorted) {
+        sort_source(env);
+    }
+    std::vector<datum_t> ret;
+    batcher_t batcher = batchspec.to_batcher();
+    if (runs.empty()) {
+        for (; index < data.size() && !batcher.should_send_batch(); ++index) {
+            batcher.note_el(data[index]);
+            ret.push_back(std::move(data[index]));
+        }
+        return ret;
+    }
+
+    profile::sampler_t sampler("Merging sorted runs.", env->trace);
+    auto gt = std::bind(&unindexed_sort_datum_stream_t::merge_gt,
+                        this, env, ph::_1, ph::_2);
+    while (!merge_heap.empty() && !batcher.should_send_batch()) {
+        std::pop_heap(merge_heap.begin(), merge_heap.end(), gt);
+        const size_t run = merge_heap.back().run;
+        batcher.note_el(merge_heap.back().row);
+        ret.push_back(std::move(merge_heap.back().row));
+        merge_heap.pop_back();
+        sampler.new_sample();
+        pop_run(env, run);
+    }
+    return ret;
+}
+
+// HASH_JOIN_DATUM_STREAM_T
+namespace {
+// The value at `path` in `row`, if it's a scalar.  `eq` compares those exactly like
+// `datum_t::cmp` orders them, so that the index finds the same matches as calling
+// the function.  Returns an empty datum for anything else.
+datum_t hash_join_key(const datum_t &row, const std::vector<datum_string_t> &path) {
+    datum_t value = row;
+    for (const datum_string_t &key : path) {
+        if (value.get_type() != datum_t::R_OBJECT || value.is_ptype()) {
+            return datum_t();
+        }
+        value = value.get_field(key, NOTHROW);
+        if (!value.has()) {
+            return datum_t();
+        }
+    }
+    switch (value.get_type()) {
+    case datum_t::R_NULL: // fallthru
+    case datum_t::R_BOOL: // fallthru
+    case datum_t::R_NUM: // fallthru
+    case datum_t::R_STR:
+        return value;
+    case datum_t::R_ARRAY: // fallthru
+    case datum_t::R_BINARY: // fallthru
+    case datum_t::R_OBJECT: // fallthru
+    case datum_t::UNINITIALIZED: // fallthru
+    default:
+        return datum_t();
+    }
+}
+
+datum_t make_join_row(const datum_t &left, const datum_t &right) {
+    std::map<datum_string_t, datum_t> obj;
+    obj[datum_string_t("left")] = left;
+    if (right.has()) {
+        obj[datum_string_t("right")] = right;
+    }
+    return datum_t(std::move(obj));
+}
+}  // namespace
+
+hash_join_datum_stream_t::hash_join_datum_stream_t(
+    counted_t<datum_stream_t> left,
+    counted_t<datum_stream_t> _right,
+    counted_t<const func_t> _func,
+    std::vector<datum_string_t> _left_path,
+    std::vector<datum_string_t> _right_path,
+    bool _outer,
+    const protob_t<const Backtrace> &bt)
+    : wrapper_datum_stream_t(left), right(_right), func(_func),
+      left_path(std::move(_left_path)), right_path(std::move(_right_path)),
+      outer(_outer), built(false),
+      index(optional_datum_less_t(reql_version_t::LATEST)) {
+    update_bt(bt);
+}
+
+void hash_join_datum_stream_t::build(env_t *env) {
+    profile::sampler_t sampler("Indexing the right side of a join.", env->trace);
+    batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+    for (;;) {
+        std::vector<datum_t> batch = right->next_batch(env, batchspec);
+        if (batch.size() == 0) {
+            break;
+        }
+        for (auto &&row : batch) {
+            datum_t key = hash_join_key(row, right_path);
+            if (key.has()) {
+                index[key].push_back(right_rows.size());
+            } else {
+                unindexed.push_back(right_rows.size());
+            }
+            right_rows.push_back(std::move(row));
+            sampler.new_sample();
+        }
+        rcheck_array_size(right_rows, env->limits(), base_exc_t::GENERIC);
+    }
+    // We don't need the stream anymore, and it might hold on to a lot.
+    right.reset();
+    built = true;
+}
+
+void hash_join_datum_stream_t::probe(env_t *env, const datum_t &row,
+                                     std::vector<datum_t> *out) {
+    const size_t old_size = out->size();
+    datum_t key = hash_join_key(row, left_path);
+    if (!key.has()) {
+        for (const datum_t &r : right_rows) {
+            if (func->call(env, row, r)->as_bool()) {
+                out->push_back(make_join_row(row, r));
+            }
+        }
+    } else {
+        static const std::vector<size_t> no_matches;
+        auto it = index.find(key);
+        const std::vector<size_t> &matches = it == index.end() ? no_matches : it->second;
+        // Merges the indexed matches with those of the unindexed rows, by position.
+        auto match = matches.begin();
+        for (size_t i : unindexed) {
+            for (; match != matches.end() && *match < i; ++match) {
+                out->push_back(make_join_row(row, right_rows[*match]));
+            }
+            if (func->call(env, row, right_rows[i])->as_bool()) {
+                out->push_back(make_join_row(row, right_rows[i]));
+            }
+        }
+        for (; match != matches.end(); ++match) {
+            out->push_back(make_join_row(row, right_rows[*match]));
+        }
+    }
+    if (outer && out->size() == old_size) {
+        out->push_back(make_join_row(row, datum_t()));
+    }
+}
+
+std::vector<datum_t>
+hash_join_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batchspec) {
+    std::vector<datum_t> ret;
+    while (ret.size() == 0) {
+        std::vector<datum_t> v = source->next_batch(env, batchspec);
+        if (v.size() == 0) {
+            break;
+        }
+        // Like the `concat_map`s, we don't read the right side until there's a left
+        // row to join it to.
+        if (!built) {
+            build(env);
+        }
+        profile::sampler_t sampler("Joining rows.", env->trace);
+        for (const datum_t &row : v) {
+            probe(env, row, &ret);
+            sampler.new_sample();
+        }
+    }
+    return ret;
+}
+
+// EQ_JOIN_DATUM_STREAM_T
+eq_join_datum_stream_t::eq_join_datum_stream_t(
+    counted_t<datum_stream_t> left,
+    counted_t<table_t> _table,
+    counted_t<const func_t> _left_attr,
+    const protob_t<const Backtrace> &bt)
+    : wrapper_datum_stream_t(left), table(_table), left_attr(_left_attr) {
+    update_bt(bt);
+}
+
+eq_join_datum_stream_t::~eq_join_datum_stream_t() { }
+
+std::vector<datum_t>
+eq_join_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batchspec) {
+    std::vector<datum_t> ret;
+    while (ret.size() == 0) {
+        std::vector<datum_t> v = source->next_batch(env, batchspec);
+        if (v.size() == 0) {
+            break;
+        }
+        // The rewritten `eq_join` skips null rows, and wraps each `get_all` in a
+        // `default([])`, which skips rows whose key is missing.
+        std::vector<datum_t> keys;
+        std::vector<size_t> key_rows;
+        for (size_t i = 0; i < v.size(); ++i) {
+            if (v[i].get_type() == datum_t::R_NULL) {
+                continue;
+            }
+            datum_t key;
+            try {
+                key = left_attr->call(env, v[i])->as_datum();
+            } catch (const base_exc_t &e) {
+                if (e.get_type() != base_exc_t::NON_EXISTENCE) {
+                    throw;
+                }
+                continue;
+            }
+            rcheck(!key.is_ptype(pseudo::geometry_string),
+                   base_exc_t::GENERIC,
+                   "Cannot use a geospatial index with `get_all`. "
+                   "Use `get_intersecting` instead.");
+            keys.push_back(std::move(key));
+            key_rows.push_back(i);
+        }
+        if (keys.empty()) {
+            continue;
+        }
+
+        std::vector<datum_t> rows = table->get_rows(env, keys);
+        r_sanity_check(rows.size() == keys.size());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (rows[i].get_type() != datum_t::R_NULL) {
+                ret.push_back(make_join_row(v[key_rows[i]], rows[i]));
+            }
+        }
+    }
+    return ret;
+}
+
 // ORDERED_DISTINCT_DATUM_STREAM_T
 ordered_distinct_datum_stream_t::ordered_distinct_datum_stream_t(
     counted_t<datum_stream_t> _source) : wrapper_datum_stream_t(_source) { }
@@ -1092,7 +1513,7 @@ datum_t union_datum_stream_t::as_array(env_t *env) {
         profile::sampler_t sampler("Evaluating stream eagerly.", env->trace);
         datum_t d;
         while (d = next(env, batchspec), d.has()) {
-            arr.add(d);
+            arr.add(std::move(d));
             sampler.new_sample();
         }
     }
@@ -1105,7 +1526,7 @@ bool union_datum_stream_t::is_exhausted() const {
             return false;
         }
     }
-    return batch_cache_exhausted();
+    return fetched_batches.empty() && batch_cache_exhausted();
 }
 bool union_datum_stream_t::is_cfeed() const {
     return is_cfeed_union;
@@ -1114,8 +1535,59 @@ bool union_datum_stream_t::is_infinite() const {
     return is_infinite_union;
 }
 
+void union_datum_stream_t::fetch_concurrently(env_t *env,
+                                              const batchspec_t &batchspec) {
+    const size_t n = std::min<size_t>(active_streams.size(),
+                                      UNION_MAX_CONCURRENT_FETCHES);
+    std::vector<bool> finished(n, false);
+    std::exception_ptr error;
+    pmap(static_cast<int64_t>(n), [&](int64_t i) {
+        try {
+            std::vector<datum_t> batch
+                = streams[active_streams[i]]->next_batch(env, batchspec);
+            if (batch.empty()) {
+                finished[i] = true;
+            } else {
+                fetched_batches.push_back(std::move(batch));
+            }
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    // The streams that were just read go to the back, so that the next round
+    // reads the others if there are more than we read at once.
+    std::vector<size_t> still_active(active_streams.begin() + n,
+                                     active_streams.end());
+    for (size_t i = 0; i < n; ++i) {
+        if (!finished[i]) {
+            still_active.push_back(active_streams[i]);
+        }
+    }
+    active_streams.swap(still_active);
+}
+
 std::vector<datum_t>
 union_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &batchspec) {
+    // Changefeeds block until they have changes, so those keep being read one at a
+    // time, and so do profiled queries, whose trace can only follow one task.
+    if (!is_cfeed_union && env->profile() == profile_bool_t::DONT_PROFILE) {
+        while (fetched_batches.empty() && !active_streams.empty()) {
+            fetch_concurrently(env, batchspec);
+        }
+        if (fetched_batches.empty()) {
+            return std::vector<datum_t>();
+        }
+        std::vector<datum_t> batch = std::move(fetched_batches.front());
+        fetched_batches.pop_front();
+        return batch;
+    }
+
     for (; streams_index < streams.size(); ++streams_index) {
         std::vector<datum_t> batch
             = streams[streams_index]->next_batch(env, batchspec);
@@ -1148,6 +1620,10 @@ range_datum_stream_t::next_raw_batch(env_t *, const batchspec_t &batchspec) {
     // 500 is picked out of a hat for latency, primarily in the Data Explorer. If you
     // think strongly it should be something else you're probably right.
     batcher_t batcher = batchspec.with_at_most(500).to_batcher();
+    batch.reserve(!is_infinite_range && start < stop
+                      && static_cast<uint64_t>(stop) - static_cast<uint64_t>(start) < 500
+                  ? static_cast<uint64_t>(stop) - static_cast<uint64_t>(start)
+                  : 500);
 
     while (!is_exhausted()) {
         double next = safe_to_double(start++);
@@ -1159,8 +1635,8 @@ range_datum_stream_t::next_raw_batch(env_t *, const batchspec_t &batchspec) {
                "`range` out of safe double bounds.");
 
         batch.emplace_back(next);
-        batcher.note_el(batch.back());
-        if (batcher.should_send_batch()) {
+        // `note_el` already checks whether to send the batch, which reads the clock.
+        if (batcher.note_el(batch.back())) {
             break;
         }
     }
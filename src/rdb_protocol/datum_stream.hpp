@@ -19,14 +19,19 @@
 //#include "rdb_protocol/func.hpp"
 #include "rdb_protocol/math_utils.hpp"
 #include "rdb_protocol/protocol.hpp"
+#include "rdb_protocol/query_memory.hpp"
 #include "rdb_protocol/real_table.hpp"
 #include "rdb_protocol/shards.hpp"
+#include "rdb_protocol/sort_key.hpp"
+
+template <class T> class disk_backed_queue_t;
 
 namespace ql {
 
 class env_t;
 class scope_env_t;
 class func_t;
+class table_t;
 
 class datum_stream_t : public single_threaded_countable_t<datum_stream_t>,
                        public pb_rcheckable_t {
@@ -201,22 +206,136 @@ class indexed_sort_datum_stream_t : public wrapper_datum_stream_t {
 public:
     indexed_sort_datum_stream_t(
         counted_t<datum_stream_t> stream, // Must be a table with a sorting applied.
-        std::function<bool(env_t *,  // NOLINT(readability/casting)
-                           profile::sampler_t *,
-                           const datum_t &,
-                           const datum_t &)> lt_cmp);
+        sort_order_t sort_order);
 private:
 virtual std::vector<datum_t>
 next_raw_batch(env_t *env, const batchspec_t &batchspec);
 
-std::function<bool(env_t *,  // NOLINT(readability/casting)
-                   profile::sampler_t *,
-                   const datum_t &,
-                   const datum_t &)> lt_cmp;
+sort_order_t sort_order;
 size_t index;
 std::vector<datum_t> data;
 };
 
+// The result of an `orderBy` without an index.  Reads and sorts all of `source`
+// when it's first read from.  If `limit` is called first, it only keeps the first
+// `n` elements (on a bounded heap) instead of holding on to the whole sequence.
+//
+// If the sequence is bigger than the array size limit, and the server has a place
+// for temporary files, it sorts runs of up to that many elements, writes them to
+// disk and then merges them as it's read.  (It then isn't an array anymore, and
+// `as_array` returns an empty datum.)
+class unindexed_sort_datum_stream_t : public wrapper_datum_stream_t {
+public:
+    unindexed_sort_datum_stream_t(
+        counted_t<datum_stream_t> stream,
+        sort_order_t sort_order,
+        const protob_t<const Backtrace> &bt);
+    ~unindexed_sort_datum_stream_t();
+
+    // Does nothing if the stream was already read from, or if transformations were
+    // added to it, which have to see the whole sequence.
+    void limit(size_t n);
+
+private:
+    virtual bool is_array() const { return true; }
+    virtual datum_t as_array(env_t *env);
+    virtual bool is_exhausted() const;
+    virtual bool is_cfeed() const { return false; }
+    virtual bool is_infinite() const { return false; }
+    virtual std::vector<datum_t>
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+    void sort_source(env_t *env);
+    void sort_source_with_limit(env_t *env, profile::sampler_t *sampler);
+    // Sorts `data` and moves it to a new run on disk.
+    void spill_run(env_t *env, profile::sampler_t *sampler);
+    // Pushes the next element of `run` onto `merge_heap`.  Returns false if the run
+    // is empty.
+    bool pop_run(env_t *env, size_t run);
+    struct merge_el_t {
+        sort_key_t key;
+        datum_t row;
+        size_t run;
+    };
+    // The ordering of `merge_heap`, which keeps the least element on top.
+    bool merge_gt(env_t *env, const merge_el_t &a, const merge_el_t &b);
+
+    sort_order_t sort_order;
+    bool has_limit;
+    size_t limit_n;
+    bool sorted;
+    size_t index;
+    std::vector<datum_t> data;
+    // What `data` is charged to, set when sorting starts.
+    scoped_ptr_t<query_memory_t::reservation_t> data_memory;
+
+    // Only used once we've spilled to disk.  `merge_heap` holds the first element
+    // of each run that has any left, along with the run's index.
+    std::vector<scoped_ptr_t<disk_backed_queue_t<datum_t> > > runs;
+    std::vector<merge_el_t> merge_heap;
+    perfmon_collection_t runs_stats;
+};
+
+/* `inner_join` and `outer_join` with a function like `l('a').eq(r('b'))`, which only
+compares a field of the left row to a field of the right row.  Rather than calling
+the function for every pair of rows, this reads the right sequence once, indexes
+it by the field, and looks each left row up in the index.  The output is the same,
+and in the same order, as the nested `concat_map`s the joins are otherwise
+rewritten into.
+
+Only scalar fields of objects are indexed.  For rows where the field is missing,
+isn't a scalar or isn't in an object, the function is called the usual way, so
+that they match (or raise errors) exactly as before. */
+class hash_join_datum_stream_t : public wrapper_datum_stream_t {
+public:
+    hash_join_datum_stream_t(counted_t<datum_stream_t> left,
+                             counted_t<datum_stream_t> _right,
+                             counted_t<const func_t> _func,
+                             std::vector<datum_string_t> _left_path,
+                             std::vector<datum_string_t> _right_path,
+                             bool _outer,
+                             const protob_t<const Backtrace> &bt);
+
+private:
+    virtual std::vector<datum_t>
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+    void build(env_t *env);
+    // Appends the matches for `row` to `out`.
+    void probe(env_t *env, const datum_t &row, std::vector<datum_t> *out);
+
+    counted_t<datum_stream_t> right;
+    const counted_t<const func_t> func;
+    const std::vector<datum_string_t> left_path;
+    const std::vector<datum_string_t> right_path;
+    const bool outer;
+
+    bool built;
+    std::vector<datum_t> right_rows;
+    // Indices into `right_rows`, in order.
+    std::map<datum_t, std::vector<size_t>, optional_datum_less_t> index;
+    std::vector<size_t> unindexed;
+};
+
+/* `eq_join` on the primary key, which is otherwise rewritten into a `get_all` for
+every left row, one after the other.  This reads the rows for a whole batch of the
+left sequence with one batched read instead. */
+class eq_join_datum_stream_t : public wrapper_datum_stream_t {
+public:
+    eq_join_datum_stream_t(counted_t<datum_stream_t> left,
+                           counted_t<table_t> _table,
+                           counted_t<const func_t> _left_attr,
+                           const protob_t<const Backtrace> &bt);
+    ~eq_join_datum_stream_t();
+
+private:
+    virtual std::vector<datum_t>
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+    const counted_t<table_t> table;
+    const counted_t<const func_t> left_attr;
+};
+
 class union_datum_stream_t : public datum_stream_t {
 public:
     union_datum_stream_t(std::vector<counted_t<datum_stream_t> > &&_streams,
@@ -224,9 +343,10 @@ public:
         : datum_stream_t(bt_src), streams(_streams), streams_index(0),
           is_cfeed_union(false),
           is_infinite_union(false) {
-        for (auto const &stream : streams) {
-            is_cfeed_union |= stream->is_cfeed();
-            is_infinite_union |= stream->is_infinite();
+        for (size_t i = 0; i < streams.size(); ++i) {
+            is_cfeed_union |= streams[i]->is_cfeed();
+            is_infinite_union |= streams[i]->is_infinite();
+            active_streams.push_back(i);
         }
     }
 
@@ -248,9 +368,19 @@ private:
     std::vector<datum_t >
     next_batch_impl(env_t *env, const batchspec_t &batchspec);
 
+    // Asks up to `UNION_MAX_CONCURRENT_FETCHES` of the unfinished streams for a
+    // batch at once, and queues the batches in the order they arrive.
+    void fetch_concurrently(env_t *env, const batchspec_t &batchspec);
+
     std::vector<counted_t<datum_stream_t> > streams;
     size_t streams_index;
     bool is_cfeed_union, is_infinite_union;
+
+    // Used instead of `streams_index` when the streams are read concurrently: the
+    // indices of the streams that haven't returned an empty batch yet, and batches
+    // that were fetched but not returned yet.
+    std::vector<size_t> active_streams;
+    std::deque<std::vector<datum_t> > fetched_batches;
 };
 
 class range_datum_stream_t : public eager_datum_stream_t {
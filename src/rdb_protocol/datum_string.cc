@@ -6,12 +6,14 @@
 #include <string.h>
 
 #include <limits>
+#include <map>
 
 #include "containers/archive/archive.hpp"
 #include "containers/archive/buffer_stream.hpp"
 #include "containers/archive/varint.hpp"
 #include "containers/scoped.hpp"
 #include "debug.hpp"
+#include "thread_local.hpp"
 #include "utils.hpp"
 
 datum_string_t::datum_string_t() {
@@ -36,6 +38,14 @@ datum_string_t::datum_string_t(const std::string &str) {
     init(str.size(), str.data());
 }
 
+datum_string_t datum_string_t::make_uninitialized(size_t _size, char **data_out) {
+    const size_t str_offset = varint_uint64_serialized_size(_size);
+    counted_t<shared_buf_t> data = shared_buf_t::create(str_offset + _size);
+    serialize_varint_uint64_into_buf(_size, reinterpret_cast<uint8_t *>(data->data()));
+    *data_out = data->data() + str_offset;
+    return datum_string_t(shared_buf_ref_t<char>(std::move(data), 0));
+}
+
 void datum_string_t::init(size_t _size, const char *_data) {
     const size_t str_offset = varint_uint64_serialized_size(_size);
     counted_t<shared_buf_t> data = shared_buf_t::create(str_offset + _size);
@@ -66,6 +76,10 @@ bool datum_string_t::empty() const {
 }
 
 int datum_string_t::compare(const datum_string_t &other) const {
+    if (data_.get() == other.data_.get()) {
+        // The same buffer, e.g. because both are the same interned field name.
+        return 0;
+    }
     return compare(other.size(), other.data());
 }
 
@@ -96,6 +110,9 @@ bool datum_string_t::operator!=(const char *other) const {
 }
 
 bool datum_string_t::operator==(const datum_string_t &other) const {
+    if (data_.get() == other.data_.get()) {
+        return true;
+    }
     if (size() != other.size()) {
         return false;
     }
@@ -134,6 +151,36 @@ datum_string_t concat(const datum_string_t &a, const datum_string_t &b) {
     return datum_string_t(shared_buf_ref_t<char>(std::move(buf), 0));
 }
 
+// Longer strings are rarely field names, and would make the table expensive.
+const size_t MAX_INTERNED_FIELD_NAME_SIZE = 64;
+// When the table reaches this many entries we start over, so that a workload with
+// many distinct keys can't make it grow without bounds.
+const size_t MAX_INTERNED_FIELD_NAMES = 4096;
+
+typedef std::map<std::string, datum_string_t> field_name_table_t;
+TLS_with_init(field_name_table_t *, field_name_table, NULL);
+
+datum_string_t intern_field_name(const std::string &str) {
+    if (str.size() > MAX_INTERNED_FIELD_NAME_SIZE) {
+        return datum_string_t(str);
+    }
+    field_name_table_t *table = TLS_get_field_name_table();
+    if (table == NULL) {
+        // Never freed, like the other per-thread caches.
+        table = new field_name_table_t();
+        TLS_set_field_name_table(table);
+    }
+    auto it = table->find(str);
+    if (it != table->end()) {
+        return it->second;
+    }
+    if (table->size() >= MAX_INTERNED_FIELD_NAMES) {
+        table->clear();
+    }
+    datum_string_t interned(str);
+    table->insert(std::make_pair(str, interned));
+    return interned;
+}
 
 void debug_print(printf_buffer_t *buf, const datum_string_t &s) {
     debug_print_quoted_string(buf, reinterpret_cast<const uint8_t *>(s.data()),
@@ -35,6 +35,11 @@ public:
     explicit datum_string_t(const shared_buf_ref_t<char> &_ref);
     explicit datum_string_t(shared_buf_ref_t<char> &&_ref);
 
+    // Creates a datum_string_t of `_size` bytes and sets `*data_out` to its
+    // content, which the caller must fill in before using or copying the string.
+    // This builds strings without a temporary copy.
+    static datum_string_t make_uninitialized(size_t _size, char **data_out);
+
     // The result of data() is not automatically null terminated. Do not use
     // as a C string.
     const char *data() const;
@@ -66,6 +71,14 @@ private:
 
 datum_string_t concat(const datum_string_t &a, const datum_string_t &b);
 
+/* Returns a `datum_string_t` with the content of `str`, sharing its buffer with
+ * earlier results for the same content on the same thread.  Documents tend to
+ * repeat the same few field names, so using this for object keys that come from
+ * outside (JSON, protobuf) saves an allocation per key, and comparing two keys
+ * that share a buffer doesn't have to look at their contents.  Only short
+ * strings are interned, and the table is bounded. */
+datum_string_t intern_field_name(const std::string &str);
+
 void debug_print(printf_buffer_t *buf, const datum_string_t &s);
 
 #endif  // RDB_PROTOCOL_DATUM_STRING_HPP_
@@ -4,6 +4,7 @@
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
+#include "clustering/administration/jobs/report.hpp"
 #include "concurrency/cross_thread_watchable.hpp"
 #include "extproc/js_runner.hpp"
 #include "rdb_protocol/counted_term.hpp"
@@ -13,12 +14,6 @@
 
 #include "debug.hpp"
 
-// This is a totally arbitrary constant limiting the size of the regex cache.  1000
-// was chosen out of a hat; if you have a good argument for it being something else
-// (apart from cache line concerns, which are irrelevant due to the implementation)
-// you're probably right.
-const size_t LRU_CACHE_SIZE = 1000;
-
 namespace ql {
 
 datum_t static_optarg(const std::string &key, protob_t<Query> q) {
@@ -100,6 +95,16 @@ void env_t::set_eval_callback(eval_callback_t *callback) {
     eval_callback_ = callback;
 }
 
+void env_t::set_query_resources(query_resources_t *resources) {
+    query_resources_ = resources;
+}
+
+void env_t::charge_rows_read(size_t count) {
+    if (query_resources_ != NULL) {
+        query_resources_->rows_read.fetch_add(count);
+    }
+}
+
 void env_t::do_eval_callback() {
     if (eval_callback_ != NULL) {
         eval_callback_->eval_callback();
@@ -107,7 +112,10 @@ void env_t::do_eval_callback() {
 }
 
 profile_bool_t env_t::profile() const {
-    return trace != nullptr ? profile_bool_t::PROFILE : profile_bool_t::DONT_PROFILE;
+    if (trace == nullptr) {
+        return profile_bool_t::DONT_PROFILE;
+    }
+    return trace->is_aggregate() ? profile_bool_t::AGGREGATE : profile_bool_t::PROFILE;
 }
 
 reql_cluster_interface_t *env_t::reql_cluster_interface() {
@@ -137,9 +145,30 @@ js_runner_t *env_t::get_js_runner() {
 }
 
 scoped_ptr_t<profile::trace_t> maybe_make_profile_trace(profile_bool_t profile) {
-    return profile == profile_bool_t::PROFILE
-        ? make_scoped<profile::trace_t>()
-        : scoped_ptr_t<profile::trace_t>();
+    return profile == profile_bool_t::DONT_PROFILE
+        ? scoped_ptr_t<profile::trace_t>()
+        : make_scoped<profile::trace_t>(profile == profile_bool_t::AGGREGATE);
+}
+
+query_priority_t query_priority_from_optargs(rdb_context_t *ctx,
+                                             signal_t *interruptor,
+                                             global_optargs_t *arguments) {
+    if (!arguments->has_optarg("priority")) {
+        return query_priority_t::NORMAL;
+    }
+    // Fake an environment with no arguments, like `from_optargs` does for the
+    // array limit.
+    env_t env(ctx, interruptor, std::map<std::string, wire_func_t>(), nullptr);
+    const datum_string_t priority = arguments->get_optarg(&env, "priority")->as_str();
+    if (priority == "normal") {
+        return query_priority_t::NORMAL;
+    } else if (priority == "low") {
+        return query_priority_t::LOW;
+    } else {
+        rfail_datum(base_exc_t::GENERIC,
+                    "Priority `%s` unrecognized (options are \"normal\" and \"low\").",
+                    priority.to_std().c_str());
+    }
 }
 
 env_t::env_t(rdb_context_t *ctx,
@@ -149,14 +178,20 @@ env_t::env_t(rdb_context_t *ctx,
     : global_optargs_(std::move(optargs)),
       limits_(from_optargs(ctx, _interruptor, &global_optargs_)),
       reql_version_(reql_version_t::LATEST),
-      cache_(LRU_CACHE_SIZE),
+      query_priority_(query_priority_from_optargs(ctx, _interruptor, &global_optargs_)),
       interruptor(_interruptor),
       trace(_trace),
       evals_since_yield_(0),
       rdb_ctx_(ctx),
-      eval_callback_(NULL) {
+      eval_callback_(NULL),
+      query_resources_(NULL),
+      query_memory_(make_counted<query_memory_t>()),
+      result_cache_recording_(NULL) {
     rassert(ctx != NULL);
     rassert(interruptor != NULL);
+    if (query_priority_ == query_priority_t::LOW) {
+        coro_priority_.init(new with_priority_t(CORO_PRIORITY_LOW_PRIORITY_QUERY));
+    }
 }
 
 
@@ -164,12 +199,15 @@ env_t::env_t(rdb_context_t *ctx,
 env_t::env_t(signal_t *_interruptor, reql_version_t reql_version)
     : global_optargs_(),
       reql_version_(reql_version),
-      cache_(LRU_CACHE_SIZE),
+      query_priority_(query_priority_t::NORMAL),
       interruptor(_interruptor),
       trace(NULL),
       evals_since_yield_(0),
       rdb_ctx_(NULL),
-      eval_callback_(NULL) {
+      eval_callback_(NULL),
+      query_resources_(NULL),
+      query_memory_(make_counted<query_memory_t>()),
+      result_cache_recording_(NULL) {
     rassert(interruptor != NULL);
 }
 
@@ -179,6 +217,9 @@ profile_bool_t profile_bool_optarg(const protob_t<Query> &query) {
     if (profile_arg.has() && profile_arg.get_type() == datum_t::type_t::R_BOOL &&
         profile_arg.as_bool()) {
         return profile_bool_t::PROFILE;
+    } else if (profile_arg.has() && profile_arg.get_type() == datum_t::type_t::R_STR &&
+               profile_arg.as_str() == "aggregate") {
+        return profile_bool_t::AGGREGATE;
     } else {
         return profile_bool_t::DONT_PROFILE;
     }
@@ -10,20 +10,18 @@
 
 #include "concurrency/one_per_thread.hpp"
 #include "containers/counted.hpp"
-#include "containers/lru_cache.hpp"
 #include "extproc/js_runner.hpp"
 #include "rdb_protocol/configured_limits.hpp"
 #include "rdb_protocol/context.hpp"
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/protocol.hpp"
+#include "rdb_protocol/query_memory.hpp"
+#include "rdb_protocol/result_cache.hpp"
 #include "rdb_protocol/val.hpp"
 
 class extproc_pool_t;
-
-namespace re2 {
-class RE2;
-}
+class query_resources_t;
 
 namespace ql {
 class datum_t;
@@ -52,11 +50,6 @@ profile_bool_t profile_bool_optarg(const protob_t<Query> &query);
 
 scoped_ptr_t<profile::trace_t> maybe_make_profile_trace(profile_bool_t profile);
 
-struct query_cache_t {
-    explicit query_cache_t(size_t cache_size) : regex_cache(cache_size) {}
-    lru_cache_t<std::string, std::shared_ptr<re2::RE2> > regex_cache;
-};
-
 class env_t : public home_thread_mixin_t {
 public:
     // This is _not_ to be used for secondary index function evaluation -- it doesn't
@@ -96,6 +89,24 @@ public:
     void set_eval_callback(eval_callback_t *callback);
     void do_eval_callback();
 
+    // What the query is charged with; `NULL` outside of a client's query.
+    void set_query_resources(query_resources_t *resources);
+    query_resources_t *get_query_resources() { return query_resources_; }
+    // Called with the number of rows each table read returns.
+    void charge_rows_read(size_t count);
+
+    // The memory held by the query's buffers that can spill to disk.
+    const counted_t<query_memory_t> &get_query_memory() { return query_memory_; }
+
+    // Notes the tables read by a query whose result might be cached; `NULL` if
+    // the result won't be.
+    void set_result_cache_recording(result_cache_t::recording_t *recording) {
+        result_cache_recording_ = recording;
+    }
+    result_cache_t::recording_t *get_result_cache_recording() {
+        return result_cache_recording_;
+    }
+
 
     const std::map<std::string, wire_func_t> &get_all_optargs() const {
         return global_optargs_.get_all_optargs();
@@ -107,10 +118,11 @@ public:
 
     configured_limits_t limits() const { return limits_; }
 
-    query_cache_t &query_cache() { return cache_; }
-
     reql_version_t reql_version() const { return reql_version_; }
 
+    // Set with the `priority` optarg; sent along with the query's reads and writes.
+    query_priority_t query_priority() const { return query_priority_; }
+
 private:
     // The global optargs values passed to .run(...) in the Python, Ruby, and JS
     // drivers.
@@ -124,8 +136,7 @@ private:
     // earlier value.
     const reql_version_t reql_version_;
 
-    // query specific cache parameters; for example match regexes.
-    query_cache_t cache_;
+    const query_priority_t query_priority_;
 
 public:
     // The interruptor signal while a query evaluates.
@@ -147,6 +158,16 @@ private:
 
     eval_callback_t *eval_callback_;
 
+    query_resources_t *query_resources_;
+
+    counted_t<query_memory_t> query_memory_;
+
+    result_cache_t::recording_t *result_cache_recording_;
+
+    // Lowers the priority of the query's coroutine, and so of the ones it spawns,
+    // while a low-priority query evaluates.
+    scoped_ptr_t<with_priority_t> coro_priority_;
+
     DISABLE_COPYING(env_t);
 };
 
@@ -1,7 +1,12 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/erase_range.hpp"
 
+#include <algorithm>
+#include <vector>
+
 #include "buffer_cache/alt.hpp"
+#include "btree/depth_first_traversal.hpp"
+#include "btree/internal_node.hpp"
 #include "btree/leaf_node.hpp"
 #include "btree/node.hpp"
 #include "btree/operations.hpp"
@@ -168,3 +173,147 @@ done_traversing_t rdb_erase_small_range(
     return key_collector.get_aborted() ? done_traversing_t::NO : done_traversing_t::YES;
 }
 
+
+class first_key_helper_t : public depth_first_traversal_callback_t {
+public:
+    first_key_helper_t() : found(false) { }
+
+    done_traversing_t handle_pair(scoped_key_value_t &&keyvalue) {
+        found = true;
+        key.assign(keyvalue.key());
+        return done_traversing_t::YES;
+    }
+
+    bool found;
+    store_key_t key;
+};
+
+bool btree_keys_are_within(superblock_t *superblock, const key_range_t &keys) {
+    for (direction_t direction : { direction_t::FORWARD, direction_t::BACKWARD }) {
+        first_key_helper_t helper;
+        btree_depth_first_traversal(superblock, key_range_t::universe(), &helper,
+                                    direction, release_superblock_t::KEEP);
+        if (!helper.found) {
+            return true;
+        }
+        if (!keys.contains_key(helper.key)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+done_traversing_t rdb_erase_subtrees(
+        const key_range_t &keys,
+        superblock_t *superblock,
+        const deletion_context_t *deletion_context,
+        size_t max_leaves_to_erase,
+        key_range_t *deleted_out) {
+    rassert(deleted_out != nullptr);
+    *deleted_out = key_range_t::empty();
+    const block_size_t block_size
+        = rdb_value_sizer_t(superblock->cache()->max_block_size()).block_size();
+
+    for (size_t i = 0; i < max_leaves_to_erase; ++i) {
+        const block_id_t root_id = superblock->get_root_block_id();
+        if (root_id == NULL_BLOCK_ID) {
+            break;
+        }
+
+        /* Step 1: Go down the right edge of the tree to its last leaf. */
+        std::vector<buf_lock_t> path;
+        path.push_back(buf_lock_t(superblock->expose_buf(), root_id, access_t::write));
+        for (;;) {
+            block_id_t child_id;
+            {
+                buf_read_t read(&path.back());
+                const node_t *node = static_cast<const node_t *>(read.get_data_read());
+                if (node::is_leaf(node)) {
+                    break;
+                }
+                const internal_node_t *internal
+                    = reinterpret_cast<const internal_node_t *>(node);
+                // Only the root can be an internal node without children.
+                if (internal->npairs == 0) {
+                    break;
+                }
+                child_id = internal_node::get_pair_by_index(
+                    internal, internal->npairs - 1)->lnode;
+            }
+            path.push_back(buf_lock_t(buf_parent_t(&path.back()), child_id,
+                                      access_t::write));
+        }
+        if (i == 0 && path.size() >= 2) {
+            // Start loading the other leaves that this call is going to free.
+            std::vector<block_id_t> leaf_ids;
+            {
+                buf_read_t read(&path[path.size() - 2]);
+                const internal_node_t *parent
+                    = static_cast<const internal_node_t *>(read.get_data_read());
+                const int first = std::max<int>(
+                    0, parent->npairs - static_cast<int>(max_leaves_to_erase));
+                for (int j = first; j < parent->npairs - 1; ++j) {
+                    leaf_ids.push_back(
+                        internal_node::get_pair_by_index(parent, j)->lnode);
+                }
+            }
+            path[path.size() - 2].prefetch_children(leaf_ids);
+        }
+
+        /* Step 2: Delete the leaf's values. */
+        {
+            buf_lock_t *leaf_buf = &path.back();
+            buf_read_t read(leaf_buf);
+            const node_t *node = static_cast<const node_t *>(read.get_data_read());
+            if (node::is_leaf(node)) {
+                const leaf_node_t *leaf = reinterpret_cast<const leaf_node_t *>(node);
+                for (auto it = leaf::begin(*leaf); it != leaf::end(*leaf); ++it) {
+                    deletion_context->in_tree_deleter()->delete_value(
+                        buf_parent_t(leaf_buf), (*it).second);
+                    deletion_context->post_deleter()->delete_value(
+                        buf_parent_t(leaf_buf->txn()), (*it).second);
+                }
+            }
+        }
+
+        /* Step 3: Free the leaf, and each internal node above it that it was the only
+        child of.  The first node above those has other children; it loses its last
+        pair, and the key of the pair before that is where the erased keys start. */
+        bool tree_is_empty = true;
+        store_key_t erased_after;
+        for (size_t level = path.size() - 1; level > 0; --level) {
+            buf_lock_t *parent = &path[level - 1];
+            parent->detach_child(path[level].block_id());
+            path[level].write_acq_signal()->wait_lazily_unordered();
+            path[level].mark_deleted();
+
+            buf_write_t write(parent);
+            internal_node_t *parent_node
+                = static_cast<internal_node_t *>(write.get_data_write());
+            if (parent_node->npairs > 1) {
+                erased_after.assign(&internal_node::get_pair_by_index(
+                    parent_node, parent_node->npairs - 2)->key);
+                // Every key is less than `max()`, so this removes the last pair.
+                internal_node::remove(block_size, parent_node,
+                                      store_key_t::max().btree_key());
+                tree_is_empty = false;
+                break;
+            }
+        }
+        if (tree_is_empty) {
+            superblock->expose_buf().detach_child(root_id);
+            path[0].write_acq_signal()->wait_lazily_unordered();
+            path[0].mark_deleted();
+            superblock->set_root_block_id(NULL_BLOCK_ID);
+            break;
+        }
+        *deleted_out = key_range_t(key_range_t::open, erased_after,
+                                   key_range_t::none, store_key_t()).intersection(keys);
+    }
+
+    if (superblock->get_root_block_id() == NULL_BLOCK_ID) {
+        *deleted_out = keys;
+        return done_traversing_t::YES;
+    }
+    return done_traversing_t::NO;
+}
@@ -51,4 +51,24 @@ done_traversing_t rdb_erase_small_range(
     std::vector<rdb_modification_report_t> *mod_reports_out,
     key_range_t *deleted_out);
 
+/* Returns true if all of the keys in the btree are in `keys`, which is the case for an
+empty btree too.  This only looks at the first and the last key. */
+bool btree_keys_are_within(superblock_t *superblock, const key_range_t &keys);
+
+/* `rdb_erase_subtrees` is a much faster alternative to `rdb_erase_small_range` for
+ * erasing a whole btree.  Each of the keys in the btree must be in `keys` (see
+ * `btree_keys_are_within()`), and there mustn't be any secondary indexes, because it
+ * doesn't create modification reports.  Instead of removing the keys one at a time it
+ * frees whole leaves from the right end of the tree, with their values, along with the
+ * internal nodes that they empty; it takes O(log n) per leaf instead of per key and
+ * never rebalances the tree.  It frees at most `max_leaves_to_erase` leaves, and it
+ * sets `*deleted_out` to the part of `keys` that it erased, which is at the right end of
+ * `keys`.  It returns `done_traversing_t::YES` once the btree is empty. */
+done_traversing_t rdb_erase_subtrees(
+    const key_range_t &keys,
+    superblock_t *superblock,
+    const deletion_context_t *deletion_context,
+    size_t max_leaves_to_erase,
+    key_range_t *deleted_out);
+
 #endif  // RDB_PROTOCOL_ERASE_RANGE_HPP_
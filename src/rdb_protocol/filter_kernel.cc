@@ -0,0 +1,263 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/filter_kernel.hpp"
+
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/ql2.pb.h"
+
+namespace ql {
+
+class filter_kernel_func_visitor_t : public func_visitor_t {
+public:
+    filter_kernel_func_visitor_t() : reql_func(NULL) { }
+    void on_reql_func(const reql_func_t *_reql_func) { reql_func = _reql_func; }
+    void on_js_func(const js_func_t *) { }
+    const reql_func_t *reql_func;
+};
+
+scoped_ptr_t<filter_kernel_t> filter_kernel_t::compile(const func_t *f,
+                                                       reql_version_t reql_version) {
+    filter_kernel_func_visitor_t visitor;
+    f->visit(&visitor);
+    if (visitor.reql_func == NULL || visitor.reql_func->get_arg_names().size() != 1) {
+        return scoped_ptr_t<filter_kernel_t>();
+    }
+    const std::vector<sym_t> &arg_names = visitor.reql_func->get_arg_names();
+    scoped_ptr_t<filter_kernel_t> kernel(
+        new filter_kernel_t(arg_names[0].value,
+                            function_emits_implicit_variable(arg_names),
+                            reql_version));
+    const protob_t<const Term> body = visitor.reql_func->get_body_source();
+    if (!kernel->compile_bool(body.get(), &kernel->root)) {
+        return scoped_ptr_t<filter_kernel_t>();
+    }
+    return kernel;
+}
+
+filter_kernel_t::filter_kernel_t(int64_t _var, bool _implicit_var_ok,
+                                 reql_version_t _reql_version)
+    : var(_var), implicit_var_ok(_implicit_var_ok), reql_version(_reql_version),
+      root(0) { }
+
+bool filter_kernel_t::compile_bool(const Term *term, size_t *index_out) {
+    if (term->optargs_size() != 0) {
+        return false;
+    }
+    node_type_t type;
+    size_t min_args;
+    // We only handle a few term types, so we switch on an `int` to avoid listing
+    // every other one.
+    const int term_type = term->type();
+    switch (term_type) {
+    case Term::EQ: type = node_type_t::EQ; min_args = 2; break;
+    case Term::NE: type = node_type_t::NE; min_args = 2; break;
+    case Term::LT: type = node_type_t::LT; min_args = 2; break;
+    case Term::LE: type = node_type_t::LE; min_args = 2; break;
+    case Term::GT: type = node_type_t::GT; min_args = 2; break;
+    case Term::GE: type = node_type_t::GE; min_args = 2; break;
+    case Term::ALL: type = node_type_t::ALL; min_args = 1; break;
+    case Term::ANY: type = node_type_t::ANY; min_args = 1; break;
+    case Term::NOT:
+        if (term->args_size() != 1) {
+            return false;
+        }
+        type = node_type_t::NOT;
+        min_args = 1;
+        break;
+    default:
+        return false;
+    }
+    if (static_cast<size_t>(term->args_size()) < min_args) {
+        return false;
+    }
+
+    const bool bool_children = type == node_type_t::ALL
+        || type == node_type_t::ANY
+        || type == node_type_t::NOT;
+    std::vector<size_t> children;
+    for (int i = 0; i < term->args_size(); ++i) {
+        size_t child;
+        if (bool_children
+            ? !compile_bool(&term->args(i), &child)
+            : !compile_operand(&term->args(i), &child)) {
+            return false;
+        }
+        children.push_back(child);
+    }
+
+    node_t node;
+    node.type = type;
+    node.children = std::move(children);
+    nodes.push_back(std::move(node));
+    *index_out = nodes.size() - 1;
+    return true;
+}
+
+bool filter_kernel_t::compile_operand(const Term *term, size_t *index_out) {
+    node_t node;
+    if (term->type() == Term::DATUM) {
+        // Only scalars, which compare without ever raising an error.
+        const Datum &d = term->datum();
+        if (d.type() != Datum::R_NULL
+            && d.type() != Datum::R_BOOL
+            && d.type() != Datum::R_NUM
+            && d.type() != Datum::R_STR) {
+            return false;
+        }
+        node.type = node_type_t::CONSTANT;
+        // The same conversion as `compile_term` uses for `datum_term_t`.
+        node.constant = to_datum(&d, configured_limits_t::unlimited,
+                                 reql_version_t::LATEST);
+    } else {
+        node.type = node_type_t::FIELD;
+        if (!compile_path(term, &node.path) || node.path.empty()) {
+            return false;
+        }
+    }
+    nodes.push_back(std::move(node));
+    *index_out = nodes.size() - 1;
+    return true;
+}
+
+bool filter_kernel_t::compile_path(const Term *term,
+                                   std::vector<datum_string_t> *path_out) {
+    if (term->optargs_size() != 0) {
+        return false;
+    }
+    const int term_type = term->type();
+    switch (term_type) {
+    case Term::VAR: {
+        return term->args_size() == 1
+            && term->args(0).type() == Term::DATUM
+            && term->args(0).datum().type() == Datum::R_NUM
+            && static_cast<int64_t>(term->args(0).datum().r_num()) == var;
+    }
+    case Term::IMPLICIT_VAR: {
+        return implicit_var_ok && term->args_size() == 0;
+    }
+    case Term::GET_FIELD: // fallthru
+    case Term::BRACKET: {
+        if (term->args_size() != 2
+            || term->args(1).type() != Term::DATUM
+            || term->args(1).datum().type() != Datum::R_STR
+            || !compile_path(&term->args(0), path_out)) {
+            return false;
+        }
+        path_out->push_back(datum_string_t(term->args(1).datum().r_str()));
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+bool filter_kernel_t::eval(const datum_t &row, bool *result_out) const {
+    return eval_bool(root, row, result_out);
+}
+
+bool filter_kernel_t::eval_bool(size_t index, const datum_t &row,
+                                bool *result_out) const {
+    const node_t &node = nodes[index];
+    switch (node.type) {
+    case node_type_t::ALL: // fallthru
+    case node_type_t::ANY: {
+        // Short-circuits the same way `all_term_t` and `any_term_t` do.
+        const bool short_circuit_on = node.type == node_type_t::ANY;
+        for (size_t child : node.children) {
+            bool child_result;
+            if (!eval_bool(child, row, &child_result)) {
+                return false;
+            }
+            if (child_result == short_circuit_on) {
+                *result_out = short_circuit_on;
+                return true;
+            }
+        }
+        *result_out = !short_circuit_on;
+        return true;
+    }
+    case node_type_t::NOT: {
+        bool child_result;
+        if (!eval_bool(node.children[0], row, &child_result)) {
+            return false;
+        }
+        *result_out = !child_result;
+        return true;
+    }
+    case node_type_t::EQ: // fallthru
+    case node_type_t::NE: // fallthru
+    case node_type_t::LT: // fallthru
+    case node_type_t::LE: // fallthru
+    case node_type_t::GT: // fallthru
+    case node_type_t::GE: {
+        // Compares each operand to the next one, like `predicate_term_t`.
+        const bool invert = node.type == node_type_t::NE;
+        datum_t lhs;
+        if (!eval_operand(node.children[0], row, &lhs)) {
+            return false;
+        }
+        for (size_t i = 1; i < node.children.size(); ++i) {
+            datum_t rhs;
+            if (!eval_operand(node.children[i], row, &rhs)) {
+                return false;
+            }
+            bool holds;
+            switch (node.type) {
+            case node_type_t::EQ: // fallthru
+            case node_type_t::NE: holds = lhs == rhs; break;
+            case node_type_t::LT: holds = lhs.cmp(reql_version, rhs) < 0; break;
+            case node_type_t::LE: holds = lhs.cmp(reql_version, rhs) <= 0; break;
+            case node_type_t::GT: holds = lhs.cmp(reql_version, rhs) > 0; break;
+            case node_type_t::GE: holds = lhs.cmp(reql_version, rhs) >= 0; break;
+            case node_type_t::FIELD: // fallthru
+            case node_type_t::CONSTANT: // fallthru
+            case node_type_t::ALL: // fallthru
+            case node_type_t::ANY: // fallthru
+            case node_type_t::NOT: // fallthru
+            default: unreachable();
+            }
+            if (!holds) {
+                *result_out = invert;
+                return true;
+            }
+            lhs = std::move(rhs);
+        }
+        *result_out = !invert;
+        return true;
+    }
+    case node_type_t::FIELD: // fallthru
+    case node_type_t::CONSTANT: // fallthru
+    default:
+        unreachable();
+    }
+}
+
+bool filter_kernel_t::eval_operand(size_t index, const datum_t &row,
+                                   datum_t *value_out) const {
+    const node_t &node = nodes[index];
+    if (node.type == node_type_t::CONSTANT) {
+        *value_out = node.constant;
+        return true;
+    }
+    r_sanity_check(node.type == node_type_t::FIELD);
+    datum_t value = row;
+    for (const datum_string_t &key : node.path) {
+        // Pseudotypes and arrays get special treatment from `bracket`, and missing
+        // fields are errors.  We leave all of these to the interpreter.
+        if (value.get_type() != datum_t::R_OBJECT || value.is_ptype()) {
+            return false;
+        }
+        value = value.get_field(key, NOTHROW);
+        if (!value.has()) {
+            return false;
+        }
+    }
+    // Comparing objects or arrays could involve pseudotypes, so we only handle
+    // scalars.
+    if (value.get_type() == datum_t::R_OBJECT || value.get_type() == datum_t::R_ARRAY) {
+        return false;
+    }
+    *value_out = std::move(value);
+    return true;
+}
+
+}  // namespace ql
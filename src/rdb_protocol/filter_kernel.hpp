@@ -0,0 +1,80 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_FILTER_KERNEL_HPP_
+#define RDB_PROTOCOL_FILTER_KERNEL_HPP_
+
+#include <vector>
+
+#include "containers/scoped.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/datum_string.hpp"
+#include "version.hpp"
+
+class Term;
+
+namespace ql {
+
+class func_t;
+
+/* Most `filter` functions are simple comparisons of fields of the row against
+constants, like `r.row('status').eq('x').and(r.row('ts').gt(n))`.  Evaluating
+those through `func_t::call` sets up a scope and walks the term tree for every
+row.  A `filter_kernel_t` is such a function compiled into a small expression
+tree that is evaluated directly on the row.
+
+The supported shapes are `eq`, `ne`, `lt`, `le`, `gt` and `ge` over constants and
+(nested) fields of the row, and `and`, `or` and `not` over those.  Anything in a row
+that could produce an error or that the kernel doesn't handle exactly like the
+term would (missing fields, non-objects, pseudotypes, arrays or objects in
+comparisons) makes `eval` give up on that row, and the caller has to evaluate the
+function the usual way. */
+class filter_kernel_t {
+public:
+    // Returns an empty pointer if `f` isn't one of the supported shapes.
+    static scoped_ptr_t<filter_kernel_t> compile(const func_t *f,
+                                                 reql_version_t reql_version);
+
+    // Returns false if the function has to be evaluated the usual way for `row`.
+    // Otherwise, sets `*result_out` to whether `row` passes the filter.
+    MUST_USE bool eval(const datum_t &row, bool *result_out) const;
+
+private:
+    enum class node_type_t { FIELD, CONSTANT, EQ, NE, LT, LE, GT, GE, ALL, ANY, NOT };
+
+    struct node_t {
+        node_type_t type;
+        // For `FIELD`, the path from the row to the field.
+        std::vector<datum_string_t> path;
+        // For `CONSTANT`.
+        datum_t constant;
+        // Indices into `nodes`, for all the other types.
+        std::vector<size_t> children;
+    };
+
+    filter_kernel_t(int64_t _var, bool _implicit_var_ok, reql_version_t _reql_version);
+
+    // The `compile_*` functions return false if `term` isn't supported.  Otherwise
+    // they append the nodes for `term` to `nodes` and set `*index_out` to the index
+    // of its root.
+    MUST_USE bool compile_bool(const Term *term, size_t *index_out);
+    MUST_USE bool compile_operand(const Term *term, size_t *index_out);
+    MUST_USE bool compile_path(const Term *term, std::vector<datum_string_t> *path_out);
+
+    MUST_USE bool eval_bool(size_t index, const datum_t &row, bool *result_out) const;
+    MUST_USE bool eval_operand(size_t index, const datum_t &row,
+                               datum_t *value_out) const;
+
+    // The variable the function binds the row to.
+    const int64_t var;
+    // Whether `r.row` refers to the row too.
+    const bool implicit_var_ok;
+    const reql_version_t reql_version;
+
+    std::vector<node_t> nodes;
+    size_t root;
+
+    DISABLE_COPYING(filter_kernel_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_FILTER_KERNEL_HPP_
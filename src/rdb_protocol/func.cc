@@ -32,6 +32,12 @@ scoped_ptr_t<val_t> func_t::call(env_t *env,
     return call(env, make_vector(arg1, arg2), eval_flags);
 }
 
+void func_t::call_on_each(env_t *env, std::vector<datum_t> *args_inout) const {
+    for (auto it = args_inout->begin(); it != args_inout->end(); ++it) {
+        *it = call(env, *it)->as_datum();
+    }
+}
+
 void func_t::assert_deterministic(const char *extra_msg) const {
     rcheck(is_deterministic(),
            base_exc_t::GENERIC,
@@ -124,6 +130,50 @@ scoped_ptr_t<val_t> js_func_t::call(
     }
 }
 
+void js_func_t::call_on_each(env_t *env, std::vector<datum_t> *args_inout) const {
+    if (args_inout->size() <= 1) {
+        func_t::call_on_each(env, args_inout);
+        return;
+    }
+    try {
+        js_runner_t::req_config_t config;
+        config.timeout_ms = js_timeout_ms;
+
+        r_sanity_check(!js_source.empty());
+        std::vector<std::vector<datum_t> > args_batch;
+        args_batch.reserve(args_inout->size());
+        for (auto it = args_inout->begin(); it != args_inout->end(); ++it) {
+            args_batch.push_back(make_vector(*it));
+        }
+        std::vector<js_result_t> results;
+
+        try {
+            results = env->get_js_runner()->call_batch(js_source, args_batch, config);
+        } catch (const extproc_worker_exc_t &e) {
+            rfail(base_exc_t::GENERIC,
+                  "Javascript query `%s` caused a crash in a worker process.",
+                  js_source.c_str());
+        } catch (const interrupted_exc_t &e) {
+            const uint64_t timeout_ms = js_timeout_ms * args_inout->size();
+            rfail(base_exc_t::GENERIC,
+                  "JavaScript query `%s` timed out after "
+                  "%" PRIu64 ".%03" PRIu64 " seconds.",
+                  js_source.c_str(), timeout_ms / 1000, timeout_ms % 1000);
+        }
+
+        // The results only stop early on an error, which the visitor throws.
+        for (size_t i = 0; i < results.size(); ++i) {
+            scoped_ptr_t<val_t> v(boost::apply_visitor(
+                js_result_visitor_t(js_source, js_timeout_ms, this), results[i]));
+            (*args_inout)[i] = v->as_datum();
+        }
+        r_sanity_check(results.size() == args_inout->size());
+    } catch (const datum_exc_t &e) {
+        rfail(e.get_type(), "%s", e.what());
+        unreachable();
+    }
+}
+
 boost::optional<size_t> js_func_t::arity() const {
     return boost::none;
 }
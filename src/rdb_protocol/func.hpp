@@ -49,6 +49,13 @@ public:
                      datum_t arg,
                      counted_t<const func_t> default_filter_val) const;
 
+    // Replaces each of `args_inout` with the result of calling the function on it.
+    // This stops at the first error, like calling it on each of them in turn would.
+    virtual void call_on_each(env_t *env, std::vector<datum_t> *args_inout) const;
+    // True if `call_on_each()` is cheaper than calling the function on each
+    // argument in turn.
+    virtual bool batches_calls() const { return false; }
+
     // These are simple, they call the vector version of call.
     scoped_ptr_t<val_t> call(env_t *env, eval_flags_t eval_flags = NO_FLAGS) const;
     scoped_ptr_t<val_t> call(env_t *env,
@@ -89,6 +96,9 @@ public:
 
     void visit(func_visitor_t *visitor) const;
 
+    const std::vector<sym_t> &get_arg_names() const { return arg_names; }
+    protob_t<const Term> get_body_source() const { return body->get_src(); }
+
 private:
     template <cluster_version_t> friend class wire_func_serialization_visitor_t;
     bool filter_helper(env_t *env, datum_t arg) const;
@@ -118,6 +128,11 @@ public:
                              const std::vector<datum_t> &args,
                              eval_flags_t eval_flags) const;
 
+    // Makes one round trip to the worker process for all of the arguments, rather
+    // than one for each.
+    void call_on_each(env_t *env, std::vector<datum_t> *args_inout) const;
+    bool batches_calls() const { return true; }
+
     boost::optional<size_t> arity() const;
 
     bool is_deterministic() const;
@@ -0,0 +1,455 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/func_bytecode.hpp"
+
+#include <algorithm>
+#include <map>
+#include <string>
+
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "utils.hpp"
+
+namespace ql {
+
+class func_bytecode_visitor_t : public func_visitor_t {
+public:
+    func_bytecode_visitor_t() : reql_func(NULL) { }
+    void on_reql_func(const reql_func_t *_reql_func) { reql_func = _reql_func; }
+    void on_js_func(const js_func_t *) { }
+    const reql_func_t *reql_func;
+};
+
+scoped_ptr_t<func_bytecode_t> func_bytecode_t::compile(const func_t *f) {
+    func_bytecode_visitor_t visitor;
+    f->visit(&visitor);
+    // Evaluating the program may evaluate parts of the function that the term tree
+    // wouldn't have, which is only fine if they're deterministic.
+    if (visitor.reql_func == NULL
+        || !visitor.reql_func->is_deterministic()
+        || visitor.reql_func->get_arg_names().empty()) {
+        return scoped_ptr_t<func_bytecode_t>();
+    }
+    scoped_ptr_t<func_bytecode_t> bytecode(
+        new func_bytecode_t(visitor.reql_func->get_arg_names()));
+    const protob_t<const Term> body = visitor.reql_func->get_body_source();
+    if (!bytecode->compile_term(body.get())) {
+        return scoped_ptr_t<func_bytecode_t>();
+    }
+    r_sanity_check(bytecode->depth == 1);
+    bytecode->stack.reserve(bytecode->max_depth);
+    return bytecode;
+}
+
+func_bytecode_t::func_bytecode_t(std::vector<sym_t> _arg_names)
+    : arg_names(std::move(_arg_names)),
+      implicit_var_ok(function_emits_implicit_variable(arg_names)),
+      depth(0), max_depth(0) { }
+
+void func_bytecode_t::emit(opcode_t opcode, uint32_t operand) {
+    instruction_t instruction;
+    instruction.opcode = opcode;
+    instruction.operand = operand;
+    program.push_back(instruction);
+}
+
+void func_bytecode_t::emit(opcode_t opcode, uint32_t operand,
+                           size_t num_popped, size_t num_pushed) {
+    emit(opcode, operand);
+    r_sanity_check(depth >= num_popped);
+    depth = depth - num_popped + num_pushed;
+    max_depth = std::max(max_depth, depth);
+}
+
+void func_bytecode_t::patch_jump(size_t from) {
+    program[from].operand = program.size();
+}
+
+bool func_bytecode_t::compile_args(const Term *term, int first_arg) {
+    for (int i = first_arg; i < term->args_size(); ++i) {
+        if (!compile_term(&term->args(i))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool func_bytecode_t::compile_term(const Term *term) {
+    // We only handle a few term types, so we switch on an `int` to avoid listing
+    // every other one.
+    const int term_type = term->type();
+    if (term_type != Term::MAKE_OBJ && term->optargs_size() != 0) {
+        return false;
+    }
+    const size_t num_args = term->args_size();
+    switch (term_type) {
+    case Term::DATUM: {
+        // The same conversion as `ql::compile_term` uses for `datum_term_t`.
+        constants.push_back(to_datum(&term->datum(), configured_limits_t::unlimited,
+                                     reql_version_t::LATEST));
+        emit(opcode_t::PUSH_CONSTANT, constants.size() - 1, 0, 1);
+        return true;
+    }
+    case Term::VAR: {
+        if (num_args != 1
+            || term->args(0).type() != Term::DATUM
+            || term->args(0).datum().type() != Datum::R_NUM) {
+            return false;
+        }
+        const int64_t var = term->args(0).datum().r_num();
+        for (size_t i = 0; i < arg_names.size(); ++i) {
+            if (arg_names[i].value == var) {
+                emit(opcode_t::PUSH_ARG, i, 0, 1);
+                return true;
+            }
+        }
+        // A variable captured from an enclosing scope.
+        return false;
+    }
+    case Term::IMPLICIT_VAR: {
+        if (!implicit_var_ok || num_args != 0) {
+            return false;
+        }
+        emit(opcode_t::PUSH_ARG, 0, 0, 1);
+        return true;
+    }
+    case Term::GET_FIELD: // fallthru
+    case Term::BRACKET: {
+        if (num_args != 2 || !compile_args(term, 0)) {
+            return false;
+        }
+        emit(opcode_t::GET_FIELD, 0, 2, 1);
+        return true;
+    }
+    case Term::EQ: // fallthru
+    case Term::NE: // fallthru
+    case Term::LT: // fallthru
+    case Term::LE: // fallthru
+    case Term::GT: // fallthru
+    case Term::GE: // fallthru
+    case Term::ADD: // fallthru
+    case Term::SUB: // fallthru
+    case Term::MUL: // fallthru
+    case Term::DIV: {
+        const bool comparison = term_type != Term::ADD && term_type != Term::SUB
+            && term_type != Term::MUL && term_type != Term::DIV;
+        if (num_args < (comparison ? 2 : 1) || !compile_args(term, 0)) {
+            return false;
+        }
+        opcode_t opcode;
+        switch (term_type) {
+        case Term::EQ: opcode = opcode_t::EQ; break;
+        case Term::NE: opcode = opcode_t::NE; break;
+        case Term::LT: opcode = opcode_t::LT; break;
+        case Term::LE: opcode = opcode_t::LE; break;
+        case Term::GT: opcode = opcode_t::GT; break;
+        case Term::GE: opcode = opcode_t::GE; break;
+        case Term::ADD: opcode = opcode_t::ADD; break;
+        case Term::SUB: opcode = opcode_t::SUB; break;
+        case Term::MUL: opcode = opcode_t::MUL; break;
+        case Term::DIV: opcode = opcode_t::DIV; break;
+        default: unreachable();
+        }
+        emit(opcode, num_args, num_args, 1);
+        return true;
+    }
+    case Term::MAKE_ARRAY: {
+        if (!compile_args(term, 0)) {
+            return false;
+        }
+        emit(opcode_t::MAKE_ARRAY, num_args, num_args, 1);
+        return true;
+    }
+    case Term::MAKE_OBJ: {
+        if (num_args != 0) {
+            return false;
+        }
+        // `make_obj_term_t` evaluates the values in the order of their keys.
+        std::map<std::string, const Term *> values;
+        for (int i = 0; i < term->optargs_size(); ++i) {
+            const Term_AssocPair &pair = term->optargs(i);
+            if (!values.insert(std::make_pair(pair.key(), &pair.val())).second) {
+                return false;
+            }
+        }
+        std::vector<datum_string_t> keys;
+        for (auto it = values.begin(); it != values.end(); ++it) {
+            if (!compile_term(it->second)) {
+                return false;
+            }
+            keys.push_back(datum_string_t(it->first));
+        }
+        object_keys.push_back(std::move(keys));
+        emit(opcode_t::MAKE_OBJ, object_keys.size() - 1, values.size(), 1);
+        return true;
+    }
+    case Term::NOT: {
+        if (num_args != 1 || !compile_args(term, 0)) {
+            return false;
+        }
+        emit(opcode_t::NOT, 0, 1, 1);
+        return true;
+    }
+    case Term::ALL: // fallthru
+    case Term::ANY: {
+        if (num_args < 1) {
+            return false;
+        }
+        // Like `all_term_t` and `any_term_t`, these evaluate to the value that
+        // decided the result.
+        const bool all = term_type == Term::ALL;
+        std::vector<size_t> jumps;
+        for (size_t i = 0; i < num_args; ++i) {
+            if (!compile_term(&term->args(i))) {
+                return false;
+            }
+            if (!all || i + 1 < num_args) {
+                jumps.push_back(program.size());
+                emit(all ? opcode_t::JUMP_IF_FALSE_OR_POP : opcode_t::JUMP_IF_TRUE_OR_POP,
+                     0, 1, 0);
+            }
+        }
+        if (!all) {
+            constants.push_back(datum_t::boolean(false));
+            emit(opcode_t::PUSH_CONSTANT, constants.size() - 1, 0, 1);
+        }
+        for (size_t jump : jumps) {
+            patch_jump(jump);
+        }
+        return true;
+    }
+    case Term::BRANCH: {
+        if (num_args != 3 || !compile_term(&term->args(0))) {
+            return false;
+        }
+        const size_t to_false_branch = program.size();
+        emit(opcode_t::POP_JUMP_IF_FALSE, 0, 1, 0);
+        if (!compile_term(&term->args(1))) {
+            return false;
+        }
+        const size_t to_end = program.size();
+        emit(opcode_t::JUMP, 0, 1, 0);
+        patch_jump(to_false_branch);
+        if (!compile_term(&term->args(2))) {
+            return false;
+        }
+        patch_jump(to_end);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+bool func_bytecode_t::call(env_t *env, const datum_t &arg, datum_t *result_out) const {
+    return run(env, &arg, 1, result_out);
+}
+
+bool func_bytecode_t::call(env_t *env, const datum_t &arg1, const datum_t &arg2,
+                           datum_t *result_out) const {
+    const datum_t args[2] = { arg1, arg2 };
+    return run(env, args, 2, result_out);
+}
+
+bool func_bytecode_t::run(env_t *env, const datum_t *args, size_t num_args,
+                          datum_t *result_out) const {
+    if (num_args != arg_names.size()) {
+        // `reql_func_t::call` reports this.
+        return false;
+    }
+    r_sanity_check(stack.empty());
+    bool success;
+    try {
+        success = run_instructions(env, args);
+    } catch (const base_exc_t &) {
+        // The term would have raised an error here, or maybe it wouldn't have (if
+        // this is in a branch it wouldn't have evaluated).  Either way, the caller
+        // will find out by calling the function.
+        success = false;
+    }
+    if (success) {
+        r_sanity_check(stack.size() == 1);
+        *result_out = std::move(stack.back());
+    }
+    stack.clear();
+    return success;
+}
+
+bool func_bytecode_t::run_instructions(env_t *env, const datum_t *args) const {
+    const reql_version_t reql_version = env->reql_version();
+    size_t pc = 0;
+    while (pc < program.size()) {
+        const instruction_t &instruction = program[pc];
+        ++pc;
+        switch (instruction.opcode) {
+        case opcode_t::PUSH_ARG: {
+            stack.push_back(args[instruction.operand]);
+        } break;
+        case opcode_t::PUSH_CONSTANT: {
+            stack.push_back(constants[instruction.operand]);
+        } break;
+        case opcode_t::GET_FIELD: {
+            const datum_t key = std::move(stack.back());
+            stack.pop_back();
+            datum_t *const obj = &stack.back();
+            // `bracket` does `nth` for numbers and maps over sequences, and
+            // pseudotypes get special treatment.
+            if (key.get_type() != datum_t::R_STR
+                || obj->get_type() != datum_t::R_OBJECT
+                || obj->is_ptype()) {
+                return false;
+            }
+            datum_t field = obj->get_field(key.as_str(), NOTHROW);
+            if (!field.has()) {
+                return false;
+            }
+            *obj = std::move(field);
+        } break;
+        case opcode_t::EQ: // fallthru
+        case opcode_t::NE: // fallthru
+        case opcode_t::LT: // fallthru
+        case opcode_t::LE: // fallthru
+        case opcode_t::GT: // fallthru
+        case opcode_t::GE: {
+            // Compares each operand to the next one, like `predicate_term_t`.
+            const size_t base = stack.size() - instruction.operand;
+            bool holds = true;
+            for (size_t i = base + 1; holds && i < stack.size(); ++i) {
+                const datum_t &lhs = stack[i - 1];
+                const datum_t &rhs = stack[i];
+                switch (instruction.opcode) {
+                case opcode_t::EQ: // fallthru
+                case opcode_t::NE: holds = lhs == rhs; break;
+                case opcode_t::LT: holds = lhs.cmp(reql_version, rhs) < 0; break;
+                case opcode_t::LE: holds = lhs.cmp(reql_version, rhs) <= 0; break;
+                case opcode_t::GT: holds = lhs.cmp(reql_version, rhs) > 0; break;
+                case opcode_t::GE: holds = lhs.cmp(reql_version, rhs) >= 0; break;
+                case opcode_t::PUSH_ARG: // fallthru
+                case opcode_t::PUSH_CONSTANT: // fallthru
+                case opcode_t::GET_FIELD: // fallthru
+                case opcode_t::ADD: // fallthru
+                case opcode_t::SUB: // fallthru
+                case opcode_t::MUL: // fallthru
+                case opcode_t::DIV: // fallthru
+                case opcode_t::MAKE_ARRAY: // fallthru
+                case opcode_t::MAKE_OBJ: // fallthru
+                case opcode_t::NOT: // fallthru
+                case opcode_t::JUMP: // fallthru
+                case opcode_t::JUMP_IF_FALSE_OR_POP: // fallthru
+                case opcode_t::JUMP_IF_TRUE_OR_POP: // fallthru
+                case opcode_t::POP_JUMP_IF_FALSE: // fallthru
+                default: unreachable();
+                }
+            }
+            stack.resize(base);
+            stack.push_back(
+                datum_t::boolean(holds != (instruction.opcode == opcode_t::NE)));
+        } break;
+        case opcode_t::ADD: // fallthru
+        case opcode_t::SUB: // fallthru
+        case opcode_t::MUL: // fallthru
+        case opcode_t::DIV: {
+            // Only numbers.  Times, strings and arrays are left to `arith_term_t`.
+            const size_t base = stack.size() - instruction.operand;
+            for (size_t i = base; i < stack.size(); ++i) {
+                if (stack[i].get_type() != datum_t::R_NUM) {
+                    return false;
+                }
+            }
+            double acc = stack[base].as_num();
+            for (size_t i = base + 1; i < stack.size(); ++i) {
+                const double rhs = stack[i].as_num();
+                switch (instruction.opcode) {
+                case opcode_t::ADD: acc += rhs; break;
+                case opcode_t::SUB: acc -= rhs; break;
+                case opcode_t::MUL: acc *= rhs; break;
+                case opcode_t::DIV:
+                    if (rhs == 0) {
+                        return false;
+                    }
+                    acc /= rhs;
+                    break;
+                case opcode_t::PUSH_ARG: // fallthru
+                case opcode_t::PUSH_CONSTANT: // fallthru
+                case opcode_t::GET_FIELD: // fallthru
+                case opcode_t::EQ: // fallthru
+                case opcode_t::NE: // fallthru
+                case opcode_t::LT: // fallthru
+                case opcode_t::LE: // fallthru
+                case opcode_t::GT: // fallthru
+                case opcode_t::GE: // fallthru
+                case opcode_t::MAKE_ARRAY: // fallthru
+                case opcode_t::MAKE_OBJ: // fallthru
+                case opcode_t::NOT: // fallthru
+                case opcode_t::JUMP: // fallthru
+                case opcode_t::JUMP_IF_FALSE_OR_POP: // fallthru
+                case opcode_t::JUMP_IF_TRUE_OR_POP: // fallthru
+                case opcode_t::POP_JUMP_IF_FALSE: // fallthru
+                default: unreachable();
+                }
+                // The term turns every intermediate result into a datum, which
+                // fails for non-finite numbers.
+                if (!risfinite(acc)) {
+                    return false;
+                }
+            }
+            stack.resize(base);
+            stack.push_back(datum_t(acc));
+        } break;
+        case opcode_t::MAKE_ARRAY: {
+            const size_t base = stack.size() - instruction.operand;
+            datum_array_builder_t builder(env->limits());
+            builder.reserve(instruction.operand);
+            for (size_t i = base; i < stack.size(); ++i) {
+                builder.add(std::move(stack[i]));
+            }
+            stack.resize(base);
+            stack.push_back(std::move(builder).to_datum());
+        } break;
+        case opcode_t::MAKE_OBJ: {
+            const std::vector<datum_string_t> &keys = object_keys[instruction.operand];
+            const size_t base = stack.size() - keys.size();
+            datum_object_builder_t builder;
+            for (size_t i = 0; i < keys.size(); ++i) {
+                if (builder.add(keys[i], std::move(stack[base + i]))) {
+                    return false;
+                }
+            }
+            stack.resize(base);
+            stack.push_back(std::move(builder).to_datum());
+        } break;
+        case opcode_t::NOT: {
+            stack.back() = datum_t::boolean(!stack.back().as_bool());
+        } break;
+        case opcode_t::JUMP: {
+            pc = instruction.operand;
+        } break;
+        case opcode_t::JUMP_IF_FALSE_OR_POP: {
+            if (!stack.back().as_bool()) {
+                pc = instruction.operand;
+            } else {
+                stack.pop_back();
+            }
+        } break;
+        case opcode_t::JUMP_IF_TRUE_OR_POP: {
+            if (stack.back().as_bool()) {
+                pc = instruction.operand;
+            } else {
+                stack.pop_back();
+            }
+        } break;
+        case opcode_t::POP_JUMP_IF_FALSE: {
+            const bool condition = stack.back().as_bool();
+            stack.pop_back();
+            if (!condition) {
+                pc = instruction.operand;
+            }
+        } break;
+        default:
+            unreachable();
+        }
+    }
+    return true;
+}
+
+}  // namespace ql
@@ -0,0 +1,109 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_FUNC_BYTECODE_HPP_
+#define RDB_PROTOCOL_FUNC_BYTECODE_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "containers/scoped.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/datum_string.hpp"
+#include "rdb_protocol/sym.hpp"
+
+class Term;
+
+namespace ql {
+
+class env_t;
+class func_t;
+
+/* Calling a `reql_func_t` walks its term tree, allocating a `val_t` at every node.
+For functions that get called on every row of a table (`map`, `reduce`) that's
+most of the work.  A `func_bytecode_t` is a deterministic function compiled into a
+flat program for a small stack machine that works on `datum_t`s directly.
+
+Only a subset of terms is supported: constants, the function's arguments, field
+access, comparisons, arithmetic on numbers, `and`, `or`, `not`, `branch`, and
+building arrays and objects.  Functions using anything else aren't compiled.  When
+the program runs into anything that the term would have handled differently or
+raised an error for, `call` returns false, and the caller has to call the
+function the usual way, which then produces the same result or error as
+always. */
+class func_bytecode_t {
+public:
+    // Returns an empty pointer if `f` can't be compiled.
+    static scoped_ptr_t<func_bytecode_t> compile(const func_t *f);
+
+    // Returns false if the function has to be called the usual way.  Otherwise sets
+    // `*result_out` to the result.
+    MUST_USE bool call(env_t *env, const datum_t &arg, datum_t *result_out) const;
+    MUST_USE bool call(env_t *env, const datum_t &arg1, const datum_t &arg2,
+                       datum_t *result_out) const;
+
+private:
+    enum class opcode_t : uint8_t {
+        // Pushes argument `operand`.
+        PUSH_ARG,
+        // Pushes `constants[operand]`.
+        PUSH_CONSTANT,
+        // Replaces an object and a key with the key's value.
+        GET_FIELD,
+        // Replace the top `operand` values with the result.
+        EQ, NE, LT, LE, GT, GE,
+        ADD, SUB, MUL, DIV,
+        MAKE_ARRAY,
+        // Replaces the top values with an object, using `object_keys[operand]` as
+        // its keys.
+        MAKE_OBJ,
+        NOT,
+        // These jump to instruction `operand`.
+        JUMP,
+        // Leaves the top value if it's falsy (or truthy) and jumps, pops it
+        // otherwise.
+        JUMP_IF_FALSE_OR_POP,
+        JUMP_IF_TRUE_OR_POP,
+        // Pops the top value, and jumps if it's falsy.
+        POP_JUMP_IF_FALSE
+    };
+
+    struct instruction_t {
+        opcode_t opcode;
+        uint32_t operand;
+    };
+
+    explicit func_bytecode_t(std::vector<sym_t> _arg_names);
+
+    // Return false if `term` can't be compiled.
+    MUST_USE bool compile_term(const Term *term);
+    MUST_USE bool compile_args(const Term *term, int first_arg);
+
+    void emit(opcode_t opcode, uint32_t operand);
+    void emit(opcode_t opcode, uint32_t operand, size_t num_popped, size_t num_pushed);
+    // Points the jump at `from` to the next instruction.
+    void patch_jump(size_t from);
+
+    MUST_USE bool run(env_t *env, const datum_t *args, size_t num_args,
+                      datum_t *result_out) const;
+    MUST_USE bool run_instructions(env_t *env, const datum_t *args) const;
+
+    const std::vector<sym_t> arg_names;
+    const bool implicit_var_ok;
+
+    std::vector<instruction_t> program;
+    std::vector<datum_t> constants;
+    std::vector<std::vector<datum_string_t> > object_keys;
+
+    size_t depth;
+    size_t max_depth;
+
+    // Reused by every call, so that running the program doesn't allocate.  A call
+    // never blocks, so two calls can't overlap.
+    mutable std::vector<datum_t> stack;
+
+    DISABLE_COPYING(func_bytecode_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_FUNC_BYTECODE_HPP_
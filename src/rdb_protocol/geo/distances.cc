@@ -1,83 +1,143 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/geo/distances.hpp"
 
+#include <math.h>
+
+#include <limits>
+
 #include "rdb_protocol/geo/ellipsoid.hpp"
 #include "rdb_protocol/geo/exceptions.hpp"
 #include "rdb_protocol/geo/geojson.hpp"
 #include "rdb_protocol/geo/geo_visitor.hpp"
-#include "rdb_protocol/geo/karney/geodesic.h"
 #include "rdb_protocol/geo/s2/s2.h"
 #include "rdb_protocol/geo/s2/s2latlng.h"
 #include "rdb_protocol/geo/s2/s2polygon.h"
 #include "rdb_protocol/geo/s2/s2polyline.h"
 
-double geodesic_distance(const lon_lat_point_t &p1,
-                         const lon_lat_point_t &p2,
-                         const ellipsoid_spec_t &e) {
+// Converts geodetic coordinates on an ellipsoid with the given equator radius and
+// squared eccentricity to earth-centered Cartesian coordinates.
+void lon_lat_to_ecef(const lon_lat_point_t &p, double equator_radius, double e2,
+                     double *x_out, double *y_out, double *z_out) {
+    const double lat = p.latitude * (M_PI / 180.0);
+    const double lon = p.longitude * (M_PI / 180.0);
+    const double sin_lat = sin(lat);
+    const double cos_lat = cos(lat);
+    // The prime vertical radius of curvature
+    const double n = equator_radius / sqrt(1.0 - e2 * sin_lat * sin_lat);
+    *x_out = n * cos_lat * cos(lon);
+    *y_out = n * cos_lat * sin(lon);
+    *z_out = n * (1.0 - e2) * sin_lat;
+}
+
+lon_lat_point_t s2point_to_lon_lat(const geo::S2Point &p) {
+    return lon_lat_point_t(geo::S2LatLng::Longitude(p).degrees(),
+                           geo::S2LatLng::Latitude(p).degrees());
+}
+
+geodesic_distance_calculator_t::geodesic_distance_calculator_t(
+        const geo::S2Point &ref, const ellipsoid_spec_t &e)
+    : ref_(s2point_to_lon_lat(ref)),
+      ref_s2_(ref),
+      equator_radius_(e.equator_radius()),
+      e2_(e.flattening() * (2.0 - e.flattening())) {
+    lon_lat_to_ecef(ref_, equator_radius_, e2_, &ref_x_, &ref_y_, &ref_z_);
     // Use Karney's algorithm
-    struct geod_geodesic g;
-    geod_init(&g, e.equator_radius(), e.flattening());
+    geod_init(&geod_, e.equator_radius(), e.flattening());
+}
 
+double geodesic_distance_calculator_t::distance_to(const lon_lat_point_t &p) const {
     double dist;
-    geod_inverse(&g, p1.latitude, p1.longitude, p2.latitude, p2.longitude, &dist, NULL, NULL);
-
+    geod_inverse(&geod_, ref_.latitude, ref_.longitude, p.latitude, p.longitude,
+                 &dist, NULL, NULL);
     return dist;
 }
 
-double geodesic_distance(const geo::S2Point &p,
-                         const ql::datum_t &g,
-                         const ellipsoid_spec_t &e) {
+double geodesic_distance_calculator_t::distance_to(const ql::datum_t &g) const {
+    return distance_to(g, std::numeric_limits<double>::infinity());
+}
+
+double geodesic_distance_calculator_t::distance_to_at_most(
+        const ql::datum_t &g, double max_dist) const {
+    return distance_to(g, max_dist);
+}
+
+double geodesic_distance_calculator_t::chord_length_to(
+        const lon_lat_point_t &p) const {
+    double x, y, z;
+    lon_lat_to_ecef(p, equator_radius_, e2_, &x, &y, &z);
+    const double dx = x - ref_x_;
+    const double dy = y - ref_y_;
+    const double dz = z - ref_z_;
+    return sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+double geodesic_distance_calculator_t::distance_to(
+        const ql::datum_t &g, double max_dist) const {
     class distance_estimator_t : public s2_geo_visitor_t<double> {
     public:
-        distance_estimator_t(
-                lon_lat_point_t r, const geo::S2Point &r_s2, const ellipsoid_spec_t &_e)
-            : ref_(r), ref_s2_(r_s2), e_(_e) { }
+        distance_estimator_t(const geodesic_distance_calculator_t *_parent,
+                             double _max_dist)
+            : parent_(_parent), max_dist_(_max_dist) { }
         double on_point(const geo::S2Point &point) {
-            lon_lat_point_t llpoint =
-                lon_lat_point_t(geo::S2LatLng::Longitude(point).degrees(),
-                                geo::S2LatLng::Latitude(point).degrees());
-            return geodesic_distance(ref_, llpoint, e_);
+            lon_lat_point_t llpoint = s2point_to_lon_lat(point);
+            // The straight line through the ellipsoid is never longer than the
+            // geodesic.  The small margin keeps rounding errors from rejecting a
+            // point that's right at `max_dist`.
+            const double lower_bound = parent_->chord_length_to(llpoint);
+            if (lower_bound > max_dist_ * (1.0 + 1e-9)) {
+                return lower_bound;
+            }
+            return parent_->distance_to(llpoint);
         }
         double on_line(const geo::S2Polyline &line) {
             // This sometimes over-estimates large distances, because the
             // projection assumes spherical rather than ellipsoid geometry.
             int next_vertex;
-            geo::S2Point prj = line.Project(ref_s2_, &next_vertex);
-            if (prj == ref_s2_) {
+            geo::S2Point prj = line.Project(parent_->ref_s2_, &next_vertex);
+            if (prj == parent_->ref_s2_) {
                 // ref_ is on the line
                 return 0.0;
             } else {
-                lon_lat_point_t llprj =
-                    lon_lat_point_t(geo::S2LatLng::Longitude(prj).degrees(),
-                                    geo::S2LatLng::Latitude(prj).degrees());
-                return geodesic_distance(ref_, llprj, e_);
+                return parent_->distance_to(s2point_to_lon_lat(prj));
             }
         }
         double on_polygon(const geo::S2Polygon &polygon) {
             // This sometimes over-estimates large distances, because the
             // projection assumes spherical rather than ellipsoid geometry.
-            geo::S2Point prj = polygon.Project(ref_s2_);
-            if (prj == ref_s2_) {
+            geo::S2Point prj = polygon.Project(parent_->ref_s2_);
+            if (prj == parent_->ref_s2_) {
                 // ref_ is inside/on the polygon
                 return 0.0;
             } else {
-                lon_lat_point_t llprj =
-                    lon_lat_point_t(geo::S2LatLng::Longitude(prj).degrees(),
-                                    geo::S2LatLng::Latitude(prj).degrees());
-                return geodesic_distance(ref_, llprj, e_);
+                return parent_->distance_to(s2point_to_lon_lat(prj));
             }
         }
-        lon_lat_point_t ref_;
-        const geo::S2Point &ref_s2_;
-        const ellipsoid_spec_t &e_;
+        const geodesic_distance_calculator_t *parent_;
+        double max_dist_;
     };
-    distance_estimator_t estimator(
-            lon_lat_point_t(geo::S2LatLng::Longitude(p).degrees(),
-                            geo::S2LatLng::Latitude(p).degrees()),
-        p, e);
+    distance_estimator_t estimator(this, max_dist);
     return visit_geojson(&estimator, g);
 }
 
+double geodesic_distance(const lon_lat_point_t &p1,
+                         const lon_lat_point_t &p2,
+                         const ellipsoid_spec_t &e) {
+    // Use Karney's algorithm
+    struct geod_geodesic g;
+    geod_init(&g, e.equator_radius(), e.flattening());
+
+    double dist;
+    geod_inverse(&g, p1.latitude, p1.longitude, p2.latitude, p2.longitude, &dist, NULL, NULL);
+
+    return dist;
+}
+
+double geodesic_distance(const geo::S2Point &p,
+                         const ql::datum_t &g,
+                         const ellipsoid_spec_t &e) {
+    return geodesic_distance_calculator_t(p, e).distance_to(g);
+}
+
 lon_lat_point_t geodesic_point_at_dist(const lon_lat_point_t &p,
                                        double dist,
                                        double azimuth,
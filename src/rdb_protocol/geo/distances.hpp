@@ -6,6 +6,7 @@
 #include <utility>
 
 #include "containers/counted.hpp"
+#include "rdb_protocol/geo/karney/geodesic.h"
 #include "rdb_protocol/geo/lon_lat_types.hpp"
 #include "rdb_protocol/geo/s2/util/math/vector3.h"
 
@@ -27,6 +28,37 @@ double geodesic_distance(const geo::S2Point &p,
                          const ql::datum_t &g,
                          const ellipsoid_spec_t &e);
 
+/* Computes the distances from a fixed reference point on an ellipsoid.  Setting up
+the ellipsoid for Karney's algorithm is not cheap, so code that computes many
+distances from the same point (such as a get_nearest traversal) should keep one of
+these around rather than calling `geodesic_distance()` for each of them. */
+class geodesic_distance_calculator_t {
+public:
+    geodesic_distance_calculator_t(const geo::S2Point &ref, const ellipsoid_spec_t &e);
+
+    double distance_to(const lon_lat_point_t &p) const;
+    double distance_to(const ql::datum_t &g) const;
+
+    // Returns the same as `distance_to(g)` if that is at most `max_dist`, and some
+    // value greater than `max_dist` otherwise.  Points that are certainly too far
+    // away are rejected without solving the inverse geodesic problem.
+    double distance_to_at_most(const ql::datum_t &g, double max_dist) const;
+
+private:
+    double distance_to(const ql::datum_t &g, double max_dist) const;
+    // A lower bound on the distance to `p` that is much cheaper to compute.
+    double chord_length_to(const lon_lat_point_t &p) const;
+
+    lon_lat_point_t ref_;
+    geo::S2Point ref_s2_;
+    // `ref_` in earth-centered Cartesian coordinates.
+    double ref_x_, ref_y_, ref_z_;
+    const double equator_radius_;
+    // The squared eccentricity
+    const double e2_;
+    struct geod_geodesic geod_;
+};
+
 // Returns a point at distance `dist` (in meters) of `p` in direction `azimuth`
 // (in degrees between -180 and 180)
 // (solves the direct geodesic problem)
@@ -1,7 +1,9 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/geo/indexing.hpp"
 
+#include <algorithm>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "btree/keys.hpp"
@@ -103,6 +105,31 @@ std::vector<std::string> compute_index_grid_keys(
     return result;
 }
 
+std::vector<std::pair<S2CellId, S2CellId> > merge_cells_into_ranges(
+        const std::vector<S2CellId> &cells) {
+    std::vector<std::pair<S2CellId, S2CellId> > ranges;
+    ranges.reserve(cells.size());
+    for (const S2CellId &cell : cells) {
+        ranges.push_back(std::make_pair(cell.range_min(), cell.range_max()));
+    }
+    std::sort(ranges.begin(), ranges.end());
+
+    // Leaf cells are consecutive on the Hilbert curve, so a range that starts at
+    // the leaf after the end of the previous one continues it.
+    size_t merged = 0;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        if (merged > 0 && ranges[i].first <= ranges[merged - 1].second.next()) {
+            ranges[merged - 1].second =
+                std::max(ranges[merged - 1].second, ranges[i].second);
+        } else {
+            ranges[merged] = ranges[i];
+            ++merged;
+        }
+    }
+    ranges.resize(merged);
+    return ranges;
+}
+
 geo_index_traversal_helper_t::geo_index_traversal_helper_t(const signal_t *interruptor)
     : is_initialized_(false), interruptor_(interruptor) { }
 
@@ -116,11 +143,13 @@ geo_index_traversal_helper_t::geo_index_traversal_helper_t(
 void geo_index_traversal_helper_t::init_query(
         const std::vector<std::string> &query_grid_keys) {
     guarantee(!is_initialized_);
-    rassert(query_cells_.empty());
-    query_cells_.reserve(query_grid_keys.size());
+    rassert(query_ranges_.empty());
+    std::vector<S2CellId> query_cells;
+    query_cells.reserve(query_grid_keys.size());
     for (size_t i = 0; i < query_grid_keys.size(); ++i) {
-        query_cells_.push_back(key_to_s2cellid(query_grid_keys[i]));
+        query_cells.push_back(key_to_s2cellid(query_grid_keys[i]));
     }
+    query_ranges_ = merge_cells_into_ranges(query_cells);
     is_initialized_ = true;
 }
 
@@ -190,17 +219,12 @@ bool geo_index_traversal_helper_t::any_query_cell_intersects(
 
 bool geo_index_traversal_helper_t::any_query_cell_intersects(
         const S2CellId left_min, const S2CellId right_max) {
-    // Check if any of the query cells intersects with the given range
-    for (size_t j = 0; j < query_cells_.size(); ++j) {
-        if (cell_intersects_with_range(query_cells_[j], left_min, right_max)) {
-            return true;
-        }
-    }
-    return false;
-}
-
-bool geo_index_traversal_helper_t::cell_intersects_with_range(
-        const S2CellId c,
-        const S2CellId left_min, const S2CellId right_max) {
-    return left_min <= c.range_max() && right_max >= c.range_min();
+    // The query ranges are sorted and disjoint, so the only one that can intersect
+    // with the given range is the first one that doesn't end before it.
+    auto it = std::lower_bound(
+        query_ranges_.begin(), query_ranges_.end(), left_min,
+        [](const std::pair<S2CellId, S2CellId> &range, const S2CellId &cell) {
+            return range.second < cell;
+        });
+    return it != query_ranges_.end() && it->first <= right_max;
 }
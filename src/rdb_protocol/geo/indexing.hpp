@@ -3,6 +3,7 @@
 #define RDB_PROTOCOL_GEO_INDEXING_HPP_
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "btree/concurrent_traversal.hpp"
@@ -29,6 +30,13 @@ std::vector<std::string> compute_index_grid_keys(
         const ql::datum_t &key,
         int goal_cells);
 
+/* Turns a set of cells into the sorted, disjoint ranges of leaf cells that they
+cover.  Cells that overlap or that are next to each other on the Hilbert curve end
+up in the same range, so a covering usually turns into fewer ranges than it has
+cells. */
+std::vector<std::pair<geo::S2CellId, geo::S2CellId> > merge_cells_into_ranges(
+        const std::vector<geo::S2CellId> &cells);
+
 // TODO (daniel): Support compound indexes somehow.
 class geo_index_traversal_helper_t : public concurrent_traversal_callback_t {
 public:
@@ -57,15 +65,13 @@ public:
             const btree_key_t *right_incl_or_null);
 
 private:
-    static bool cell_intersects_with_range(const geo::S2CellId c,
-                                           const geo::S2CellId left_min,
-                                           const geo::S2CellId right_max);
     bool any_query_cell_intersects(const btree_key_t *left_incl_or_null,
                                    const btree_key_t *right_incl_or_null);
     bool any_query_cell_intersects(const geo::S2CellId left_min,
                                    const geo::S2CellId right_max);
 
-    std::vector<geo::S2CellId> query_cells_;
+    // The query cells, merged by `merge_cells_into_ranges()`.
+    std::vector<std::pair<geo::S2CellId, geo::S2CellId> > query_ranges_;
     bool is_initialized_;
     const signal_t *interruptor_;
 };
@@ -1,11 +1,13 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/geo_traversal.hpp"
 
+#include <algorithm>
 #include <cmath>
 
 #include "errors.hpp"
 #include <boost/variant/get.hpp>
 
+#include "containers/bloom_filter.hpp"
 #include "rdb_protocol/batching.hpp"
 #include "rdb_protocol/configured_limits.hpp"
 #include "rdb_protocol/datum.hpp"
@@ -33,7 +35,13 @@ const size_t MAX_PROCESSED_SET_SIZE = 10000;
 // It typically makes sense to use more grid cells (i.e. finer covering) here
 // than it does for inserting data into a geo index, since there is no disk
 // overhead involved here and a finer grid avoids unnecessary post-filtering.
-const int QUERYING_GOAL_GRID_CELLS = GEO_INDEX_GOAL_GRID_CELLS * 2;
+// Neighbouring cells get merged into one range before the traversal, and it only
+// has to binary search those ranges, so a fine covering is cheap.
+const int QUERYING_GOAL_GRID_CELLS = GEO_INDEX_GOAL_GRID_CELLS * 4;
+
+// The smallest bitmap `geo_key_set_t` uses, and how many bits it keeps per key.
+const size_t GEO_KEY_SET_MIN_BITS = 1024;
+const size_t BITS_PER_KEY = 8;
 
 // The radius used for the first batch of a get_nearest traversal.
 // As a fraction of the equator's radius.
@@ -43,7 +51,7 @@ const double NEAREST_INITIAL_RADIUS_FRACTION = 10.0 / 6378137.0;
 // By which factor to increase the radius between nearest batches (at maximum)
 const double NEAREST_MAX_GROWTH_FACTOR = 2.0;
 
-// The desired result size of each nearest batch
+// The desired result size of each nearest batch (unless fewer results are missing)
 const double NEAREST_GOAL_BATCH_SIZE = 100.0;
 
 // Number of vertices used in get_nearest traversal for approximating the
@@ -65,12 +73,45 @@ geo_job_data_t::geo_job_data_t(ql::env_t *_env, const ql::batchspec_t &batchspec
     guarantee(transformers.size() == _transforms.size());
 }
 
+/* ----------- geo_key_set_t -----------*/
+geo_key_set_t::geo_key_set_t()
+    : bitmap_(GEO_KEY_SET_MIN_BITS / 64, 0) { }
+
+bool geo_key_set_t::contains(const store_key_t &key) const {
+    const uint64_t hash = bloom_filter_hash(key.contents(), key.size());
+    const size_t bit = hash & (bitmap_.size() * 64 - 1);
+    if ((bitmap_[bit / 64] & (uint64_t(1) << (bit % 64))) == 0) {
+        return false;
+    }
+    return keys_.count(key_to_unescaped_str(key)) > 0;
+}
+
+void geo_key_set_t::insert(const store_key_t &key) {
+    if (!keys_.insert(key_to_unescaped_str(key)).second) {
+        return;
+    }
+    if (keys_.size() * BITS_PER_KEY > bitmap_.size() * 64) {
+        // Double the bitmap and set the bits of all the keys again.
+        bitmap_.assign(bitmap_.size() * 2, 0);
+        for (const std::string &k : keys_) {
+            set_bit(bloom_filter_hash(k.data(), k.size()));
+        }
+    } else {
+        set_bit(bloom_filter_hash(key.contents(), key.size()));
+    }
+}
+
+void geo_key_set_t::set_bit(uint64_t hash) {
+    const size_t bit = hash & (bitmap_.size() * 64 - 1);
+    bitmap_[bit / 64] |= uint64_t(1) << (bit % 64);
+}
+
 /* ----------- geo_intersecting_cb_t -----------*/
 geo_intersecting_cb_t::geo_intersecting_cb_t(
         btree_slice_t *_slice,
         geo_sindex_data_t &&_sindex,
         ql::env_t *_env,
-        std::set<store_key_t> *_distinct_emitted_in_out)
+        geo_key_set_t *_distinct_emitted_in_out)
     : geo_index_traversal_helper_t(_env->interruptor),
       slice(_slice),
       sindex(std::move(_sindex)),
@@ -102,11 +143,11 @@ done_traversing_t geo_intersecting_cb_t::on_candidate(scoped_key_value_t &&keyva
     }
 
     // Check if this document has already been processed (lower bound).
-    if (already_processed.count(primary_key) > 0) {
+    if (already_processed.contains(primary_key)) {
         return done_traversing_t::NO;
     }
     // Check if this document has already been emitted.
-    if (distinct_emitted->count(primary_key) > 0) {
+    if (distinct_emitted->contains(primary_key)) {
         return done_traversing_t::NO;
     }
 
@@ -124,7 +165,7 @@ done_traversing_t geo_intersecting_cb_t::on_candidate(scoped_key_value_t &&keyva
     // row.get() or waiter.wait_interruptible() might have blocked, and another
     // coroutine could have found the document in the meantime. Re-check distinct_emitted,
     // so we don't emit the same document twice.
-    if (distinct_emitted->count(primary_key) > 0) {
+    if (distinct_emitted->contains(primary_key)) {
         return done_traversing_t::NO;
     }
 
@@ -246,7 +287,10 @@ nearest_traversal_state_t::nearest_traversal_state_t(
     center(_center),
     max_results(_max_results),
     max_radius(_max_radius),
-    reference_ellipsoid(_reference_ellipsoid) { }
+    reference_ellipsoid(_reference_ellipsoid),
+    distance_calculator(
+        S2LatLng::FromDegrees(_center.latitude, _center.longitude).ToPoint(),
+        _reference_ellipsoid) { }
 
 done_traversing_t nearest_traversal_state_t::proceed_to_next_batch() {
     // Estimate the result density based on the previous batch
@@ -259,13 +303,22 @@ done_traversing_t nearest_traversal_state_t::proceed_to_next_batch() {
     processed_inradius = current_inradius;
     previous_size = distinct_emitted.size();
 
+    // There's no point in making the next batch larger than the number of results
+    // that are still missing, so with a small `max_results` we search a smaller
+    // area.
+    const double goal_batch_size =
+        previous_size >= max_results
+        ? 1.0
+        : std::min(NEAREST_GOAL_BATCH_SIZE,
+                   static_cast<double>(max_results - previous_size));
+
     // Adapt the radius based on the density of the previous batch.
-    // Solve for current_inradius: NEAREST_GOAL_BATCH_SIZE =
+    // Solve for current_inradius: goal_batch_size =
     //   M_PI * (current_inradius^2 - processed_inradius^2) * previous_density
     // <=> current_inradius^2 =
-    //   NEAREST_GOAL_BATCH_SIZE / M_PI / previous_density + processed_inradius^2
+    //   goal_batch_size / M_PI / previous_density + processed_inradius^2
     if (previous_density != 0.0) {
-        current_inradius = sqrt((NEAREST_GOAL_BATCH_SIZE / M_PI / previous_density)
+        current_inradius = sqrt((goal_batch_size / M_PI / previous_density)
                                 + (processed_inradius * processed_inradius));
     } else {
         current_inradius = processed_inradius * NEAREST_MAX_GROWTH_FACTOR;
@@ -291,7 +344,12 @@ nearest_traversal_cb_t::nearest_traversal_cb_t(
         ql::env_t *_env,
         nearest_traversal_state_t *_state) :
     geo_intersecting_cb_t(_slice, std::move(_sindex), _env, &_state->distinct_emitted),
+    max_batch_results(_state->max_results - _state->distinct_emitted.size()),
+    candidate_dist(0.0),
     state(_state) {
+    // Earlier batches have emitted everything that's nearer than this batch's
+    // results, so we only need the nearest of the ones that are still missing.
+    guarantee(_state->distinct_emitted.size() < _state->max_results);
     init_query_geometry();
 }
 
@@ -351,24 +409,41 @@ bool nearest_traversal_cb_t::post_filter(
         UNUSED const ql::datum_t &val)
         THROWS_ONLY(interrupted_exc_t, ql::base_exc_t, geo_exception_t) {
 
-    // Filter out results that are outside of the current inradius
-    const S2Point s2center =
-        S2LatLng::FromDegrees(state->center.latitude, state->center.longitude).ToPoint();
-    const double dist = geodesic_distance(s2center, sindex_val, state->reference_ellipsoid);
-    return dist <= state->current_inradius;
+    // Filter out results that are outside of the current inradius, or that are
+    // further away than all the results we're keeping.
+    const bool result_acc_full = result_acc.size() >= max_batch_results;
+    const double max_dist =
+        result_acc_full
+        ? std::min(state->current_inradius, result_acc.front().first)
+        : state->current_inradius;
+    candidate_dist =
+        state->distance_calculator.distance_to_at_most(sindex_val, max_dist);
+    if (result_acc_full
+        && candidate_dist >= result_acc.front().first) {
+        return false;
+    }
+    return candidate_dist <= state->current_inradius;
+}
+
+bool nearest_pairs_less(
+        const std::pair<double, ql::datum_t> &p1,
+        const std::pair<double, ql::datum_t> &p2) {
+    // We only care about the distance, don't compare the actual data.
+    return p1.first < p2.first;
 }
 
 done_traversing_t nearest_traversal_cb_t::emit_result(
-        ql::datum_t &&sindex_val,
+        UNUSED ql::datum_t &&sindex_val,
         UNUSED store_key_t &&key,
         ql::datum_t &&val)
         THROWS_ONLY(interrupted_exc_t, ql::base_exc_t, geo_exception_t) {
-    // TODO (daniel): Could we avoid re-computing the distance? We have already
-    //   done it in post_filter().
-    const S2Point s2center =
-        S2LatLng::FromDegrees(state->center.latitude, state->center.longitude).ToPoint();
-    const double dist = geodesic_distance(s2center, sindex_val, state->reference_ellipsoid);
-    result_acc.push_back(std::make_pair(dist, std::move(val)));
+    // `post_filter()` has just computed the distance of this document.
+    result_acc.push_back(std::make_pair(candidate_dist, std::move(val)));
+    std::push_heap(result_acc.begin(), result_acc.end(), &nearest_pairs_less);
+    if (result_acc.size() > max_batch_results) {
+        std::pop_heap(result_acc.begin(), result_acc.end(), &nearest_pairs_less);
+        result_acc.pop_back();
+    }
 
     return done_traversing_t::NO;
 }
@@ -379,20 +454,13 @@ void nearest_traversal_cb_t::emit_error(
     error = _error;
 }
 
-bool nearest_pairs_less(
-        const std::pair<double, ql::datum_t> &p1,
-        const std::pair<double, ql::datum_t> &p2) {
-    // We only care about the distance, don't compare the actual data.
-    return p1.first < p2.first;
-}
-
 void nearest_traversal_cb_t::finish(
         nearest_geo_read_response_t *resp_out) {
     guarantee(resp_out != NULL);
     if (error) {
         resp_out->results_or_error = error.get();
     } else {
-        std::sort(result_acc.begin(), result_acc.end(), &nearest_pairs_less);
+        std::sort_heap(result_acc.begin(), result_acc.end(), &nearest_pairs_less);
         resp_out->results_or_error = std::move(result_acc);
     }
 }
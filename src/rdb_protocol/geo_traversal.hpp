@@ -2,7 +2,8 @@
 #ifndef RDB_PROTOCOL_GEO_TRAVERSAL_HPP_
 #define RDB_PROTOCOL_GEO_TRAVERSAL_HPP_
 
-#include <set>
+#include <string>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -16,6 +17,7 @@
 #include "containers/counted.hpp"
 #include "containers/scoped.hpp"
 #include "rdb_protocol/batching.hpp"
+#include "rdb_protocol/geo/distances.hpp"
 #include "rdb_protocol/geo/ellipsoid.hpp"
 #include "rdb_protocol/geo/exceptions.hpp"
 #include "rdb_protocol/geo/indexing.hpp"
@@ -54,6 +56,25 @@ private:
     scoped_ptr_t<ql::accumulator_t> accumulator;
 };
 
+/* A set of primary keys, for remembering which documents a traversal has seen.  A
+bitmap of key hashes sits in front of the keys, so checking for a key that isn't in
+the set (by far the most common case) is usually one hash and one bit test. */
+class geo_key_set_t {
+public:
+    geo_key_set_t();
+
+    bool contains(const store_key_t &key) const;
+    void insert(const store_key_t &key);
+    size_t size() const { return keys_.size(); }
+
+private:
+    void set_bit(uint64_t hash);
+
+    // Has a power of two number of bits, at least `BITS_PER_KEY` for every key.
+    std::vector<uint64_t> bitmap_;
+    std::unordered_set<std::string> keys_;
+};
+
 class geo_sindex_data_t {
 public:
     geo_sindex_data_t(
@@ -81,7 +102,7 @@ public:
             btree_slice_t *_slice,
             geo_sindex_data_t &&_sindex,
             ql::env_t *_env,
-            std::set<store_key_t> *_distinct_emitted_in_out);
+            geo_key_set_t *_distinct_emitted_in_out);
     virtual ~geo_intersecting_cb_t() { }
 
     void init_query(const ql::datum_t &_query_geometry);
@@ -115,10 +136,10 @@ private:
 
     // Stores the primary key of previously processed documents, up to some limit
     // (this is an optimization for small query ranges, trading memory for efficiency)
-    std::set<store_key_t> already_processed;
+    geo_key_set_t already_processed;
     // In contrast to `already_processed`, this set is critical to avoid emitting
     // duplicates. It's not just an optimization.
-    std::set<store_key_t> *distinct_emitted;
+    geo_key_set_t *distinct_emitted;
 
     // State for profiling.
     scoped_ptr_t<profile::disabler_t> disabler;
@@ -159,7 +180,7 @@ private:
     geo_job_data_t job;
     rget_read_response_t *response;
 
-    std::set<store_key_t> distinct_emitted;
+    geo_key_set_t distinct_emitted;
 };
 
 
@@ -178,7 +199,7 @@ private:
     friend class nearest_traversal_cb_t;
 
     /* State that changes over time */
-    std::set<store_key_t> distinct_emitted;
+    geo_key_set_t distinct_emitted;
     size_t previous_size;
     // Which radius around `center` has been previously processed?
     double processed_inradius;
@@ -189,9 +210,11 @@ private:
     const uint64_t max_results;
     const double max_radius;
     const ellipsoid_spec_t reference_ellipsoid;
+    const geodesic_distance_calculator_t distance_calculator;
 };
 
-// Generates a batch of results, sorted by increasing distance.
+// Generates a batch of results, sorted by increasing distance.  A batch only keeps
+// the results that can still make it into the `max_results` nearest ones.
 class nearest_traversal_cb_t : public geo_intersecting_cb_t {
 public:
     nearest_traversal_cb_t(
@@ -221,8 +244,13 @@ protected:
 private:
     void init_query_geometry();
 
-    // Accumulate results for the current batch until finish() is called
+    // Accumulate results for the current batch until finish() is called.  This is
+    // a max-heap on the distance, with at most `max_batch_results` entries.
     std::vector<std::pair<double, ql::datum_t> > result_acc;
+    const size_t max_batch_results;
+    // The distance `post_filter()` computed for the document that gets passed to
+    // `emit_result()` next.
+    double candidate_dist;
     boost::optional<ql::exc_t> error;
 
     nearest_traversal_state_t *state;
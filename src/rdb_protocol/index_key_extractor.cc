@@ -0,0 +1,118 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/index_key_extractor.hpp"
+
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/ql2.pb.h"
+
+namespace ql {
+
+class index_key_extractor_func_visitor_t : public func_visitor_t {
+public:
+    index_key_extractor_func_visitor_t() : reql_func(NULL) { }
+    void on_reql_func(const reql_func_t *_reql_func) { reql_func = _reql_func; }
+    void on_js_func(const js_func_t *) { }
+    const reql_func_t *reql_func;
+};
+
+scoped_ptr_t<index_key_extractor_t> index_key_extractor_t::compile(const func_t *f) {
+    index_key_extractor_func_visitor_t visitor;
+    f->visit(&visitor);
+    if (visitor.reql_func == NULL || visitor.reql_func->get_arg_names().size() != 1) {
+        return scoped_ptr_t<index_key_extractor_t>();
+    }
+    const std::vector<sym_t> &arg_names = visitor.reql_func->get_arg_names();
+    scoped_ptr_t<index_key_extractor_t> extractor(
+        new index_key_extractor_t(arg_names[0].value,
+                                  function_emits_implicit_variable(arg_names)));
+    const protob_t<const Term> body = visitor.reql_func->get_body_source();
+    if (body->type() == Term::MAKE_ARRAY && body->optargs_size() == 0) {
+        extractor->is_array = true;
+        for (int i = 0; i < body->args_size(); ++i) {
+            std::vector<datum_string_t> path;
+            if (!extractor->compile_path(&body->args(i), &path) || path.empty()) {
+                return scoped_ptr_t<index_key_extractor_t>();
+            }
+            extractor->paths.push_back(std::move(path));
+        }
+    } else {
+        std::vector<datum_string_t> path;
+        if (!extractor->compile_path(body.get(), &path) || path.empty()) {
+            return scoped_ptr_t<index_key_extractor_t>();
+        }
+        extractor->paths.push_back(std::move(path));
+    }
+    return extractor;
+}
+
+index_key_extractor_t::index_key_extractor_t(int64_t _var, bool _implicit_var_ok)
+    : var(_var), implicit_var_ok(_implicit_var_ok), is_array(false) { }
+
+bool index_key_extractor_t::compile_path(const Term *term,
+                                         std::vector<datum_string_t> *path_out) {
+    if (term->optargs_size() != 0) {
+        return false;
+    }
+    const int term_type = term->type();
+    switch (term_type) {
+    case Term::VAR: {
+        return term->args_size() == 1
+            && term->args(0).type() == Term::DATUM
+            && term->args(0).datum().type() == Datum::R_NUM
+            && static_cast<int64_t>(term->args(0).datum().r_num()) == var;
+    }
+    case Term::IMPLICIT_VAR: {
+        return implicit_var_ok && term->args_size() == 0;
+    }
+    case Term::GET_FIELD: // fallthru
+    case Term::BRACKET: {
+        if (term->args_size() != 2
+            || term->args(1).type() != Term::DATUM
+            || term->args(1).datum().type() != Datum::R_STR
+            || !compile_path(&term->args(0), path_out)) {
+            return false;
+        }
+        path_out->push_back(datum_string_t(term->args(1).datum().r_str()));
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+bool index_key_extractor_t::extract_path(const std::vector<datum_string_t> &path,
+                                         const datum_t &row,
+                                         datum_t *value_out) const {
+    datum_t value = row;
+    for (const datum_string_t &field : path) {
+        // `bracket` does something else for arrays and pseudotypes, and fails for
+        // the other types.
+        if (value.get_type() != datum_t::R_OBJECT || value.is_ptype()) {
+            return false;
+        }
+        value = value.get_field(field, NOTHROW);
+        if (!value.has()) {
+            return false;
+        }
+    }
+    *value_out = std::move(value);
+    return true;
+}
+
+bool index_key_extractor_t::extract(const datum_t &row, datum_t *value_out) const {
+    if (!is_array) {
+        return extract_path(paths[0], row, value_out);
+    }
+    std::vector<datum_t> values;
+    values.reserve(paths.size());
+    for (const auto &path : paths) {
+        datum_t value;
+        if (!extract_path(path, row, &value)) {
+            return false;
+        }
+        values.push_back(std::move(value));
+    }
+    *value_out = datum_t(std::move(values), configured_limits_t::unlimited);
+    return true;
+}
+
+}  // namespace ql
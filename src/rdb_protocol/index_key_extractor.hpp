@@ -0,0 +1,57 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_INDEX_KEY_EXTRACTOR_HPP_
+#define RDB_PROTOCOL_INDEX_KEY_EXTRACTOR_HPP_
+
+#include <vector>
+
+#include "containers/scoped.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/datum_string.hpp"
+
+class Term;
+
+namespace ql {
+
+class func_t;
+
+/* Most secondary index functions just pick a (nested) field of the row, like
+`r.row('a')('b')`, or an array of such fields for compound indexes.  Calling them
+through `func_t::call` sets up an environment and walks the term tree for every
+row that gets written.  An `index_key_extractor_t` reads those fields straight
+from the row instead, which for rows that were read from disk only deserializes
+the fields it needs.
+
+Missing fields and fields of values that aren't objects make `extract` give up on
+that row, and the caller has to call the function the usual way, which produces
+the same error as always. */
+class index_key_extractor_t {
+public:
+    // Returns an empty pointer if `f` isn't a field path or an array of them.
+    static scoped_ptr_t<index_key_extractor_t> compile(const func_t *f);
+
+    // Returns false if the function has to be called the usual way for `row`.
+    // Otherwise, sets `*value_out` to what the function returns.
+    MUST_USE bool extract(const datum_t &row, datum_t *value_out) const;
+
+private:
+    index_key_extractor_t(int64_t _var, bool _implicit_var_ok);
+
+    MUST_USE bool compile_path(const Term *term, std::vector<datum_string_t> *path_out);
+    MUST_USE bool extract_path(const std::vector<datum_string_t> &path,
+                               const datum_t &row, datum_t *value_out) const;
+
+    // The variable the function binds the row to.
+    const int64_t var;
+    // Whether `r.row` refers to the row too.
+    const bool implicit_var_ok;
+
+    std::vector<std::vector<datum_string_t> > paths;
+    // Whether the function returns an array of `paths`, rather than the only one.
+    bool is_array;
+
+    DISABLE_COPYING(index_key_extractor_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_INDEX_KEY_EXTRACTOR_HPP_
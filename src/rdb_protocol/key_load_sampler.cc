@@ -0,0 +1,69 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/key_load_sampler.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include "config/args.hpp"
+
+key_load_sampler_t::key_load_sampler_t()
+    : current_start(current_microtime()) {
+    current.samples.reserve(KEY_LOAD_SAMPLE_SIZE);
+}
+
+void key_load_sampler_t::record(const store_key_t &key) {
+    // Looking at the clock on every operation would cost more than the sampling.
+    if (current.ops % KEY_LOAD_SAMPLE_SIZE == 0) {
+        rotate_if_old();
+    }
+    ++current.ops;
+    if (current.samples.size() < KEY_LOAD_SAMPLE_SIZE) {
+        current.samples.push_back(key);
+    } else {
+        // Reservoir sampling keeps every operation of the window equally likely to
+        // be in the sample.
+        const uint64_t slot = rng.randuint64(current.ops);
+        if (slot < KEY_LOAD_SAMPLE_SIZE) {
+            current.samples[slot] = key;
+        }
+    }
+}
+
+void key_load_sampler_t::get_load(const key_range_t &range,
+                                  std::map<store_key_t, int64_t> *load_out) const {
+    // `record` only rotates the windows when there are operations, so a store that
+    // went idle has to leave its old windows out here.
+    const microtime_t age = current_microtime() - current_start;
+    if (age >= 2 * KEY_LOAD_SAMPLE_WINDOW_MS * THOUSAND) {
+        return;
+    }
+    const bool previous_is_recent = age < KEY_LOAD_SAMPLE_WINDOW_MS * THOUSAND;
+    for (const window_t *window : { &previous, &current }) {
+        if (window->samples.empty() || (window == &previous && !previous_is_recent)) {
+            continue;
+        }
+        const int64_t weight = std::max<int64_t>(
+            1, window->ops / window->samples.size());
+        for (const store_key_t &key : window->samples) {
+            if (range.contains_key(key)) {
+                (*load_out)[key] += weight;
+            }
+        }
+    }
+}
+
+void key_load_sampler_t::rotate_if_old() {
+    const microtime_t now = current_microtime();
+    if (now - current_start < KEY_LOAD_SAMPLE_WINDOW_MS * THOUSAND) {
+        return;
+    }
+    // A window that ended long ago says nothing about the load now.
+    if (now - current_start < 2 * KEY_LOAD_SAMPLE_WINDOW_MS * THOUSAND) {
+        std::swap(previous, current);
+    } else {
+        previous = window_t();
+    }
+    current.samples.clear();
+    current.ops = 0;
+    current_start = now;
+}
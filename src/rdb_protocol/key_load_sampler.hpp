@@ -0,0 +1,48 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_KEY_LOAD_SAMPLER_HPP_
+#define RDB_PROTOCOL_KEY_LOAD_SAMPLER_HPP_
+
+#include <stdint.h>
+
+#include <map>
+#include <vector>
+
+#include "btree/keys.hpp"
+#include "time.hpp"
+#include "utils.hpp"
+
+/* `key_load_sampler_t` keeps a uniform sample of the keys that a store's reads and
+writes touched recently, so that `distribution_read_t` can tell where in the key space
+the load on a table is, and not only where its documents are. Each window of
+`KEY_LOAD_SAMPLE_WINDOW_MS` gets its own reservoir of `KEY_LOAD_SAMPLE_SIZE` keys; the
+sample covers the last complete window and the current one. It's only used on the
+store's home thread. */
+class key_load_sampler_t {
+public:
+    key_load_sampler_t();
+
+    void record(const store_key_t &key);
+
+    /* Adds to `load_out` an estimate of how many operations touched each sampled key
+    in `range`. Every sampled key stands for the same number of operations in its
+    window. */
+    void get_load(const key_range_t &range,
+                  std::map<store_key_t, int64_t> *load_out) const;
+
+private:
+    struct window_t {
+        window_t() : ops(0) { }
+        std::vector<store_key_t> samples;
+        int64_t ops;
+    };
+
+    void rotate_if_old();
+
+    window_t previous, current;
+    microtime_t current_start;
+    rng_t rng;
+
+    DISABLE_COPYING(key_load_sampler_t);
+};
+
+#endif  // RDB_PROTOCOL_KEY_LOAD_SAMPLER_HPP_
@@ -6,17 +6,10 @@
 #include "rdb_protocol/blob_wrapper.hpp"
 
 ql::datum_t get_data(const rdb_value_t *value, buf_parent_t parent) {
-    // TODO: Just use deserialize_from_blob?
-    rdb_blob_wrapper_t blob(parent.cache()->max_block_size(),
-                            const_cast<rdb_value_t *>(value)->value_ref(),
-                            blob::btree_maxreflen);
-
     ql::datum_t data;
 
-    blob_acq_t acq_group;
-    buffer_group_t buffer_group;
-    blob.expose_all(parent, access_t::read, &buffer_group, &acq_group);
-    buffer_group_read_stream_t read_stream(const_view(&buffer_group));
+    // Large values get deserialized while their later blocks are still loading.
+    blob_read_stream_t read_stream(parent, value->value_ref(), blob::btree_maxreflen);
     archive_result_t res
         = datum_deserialize(&read_stream, &data);
     guarantee_deserialization(res, "rdb value");
@@ -24,6 +17,34 @@ ql::datum_t get_data(const rdb_value_t *value, buf_parent_t parent) {
     return data;
 }
 
+std::string get_serialized_data(const rdb_value_t *value, buf_parent_t parent) {
+    std::string data(value->value_size(), '\0');
+    blob_read_stream_t read_stream(parent, value->value_ref(), blob::btree_maxreflen);
+    int64_t res = force_read(&read_stream, &data[0], data.size());
+    guarantee(res == static_cast<int64_t>(data.size()), "Could not read rdb value.");
+    return data;
+}
+
+bool get_inline_data(const rdb_value_t *value, max_block_size_t block_size,
+                     ql::datum_t *data_out) {
+    if (blob::ref_info(block_size, value->value_ref(),
+                       blob::btree_maxreflen).levels != 0) {
+        return false;
+    }
+    rdb_blob_wrapper_t blob(block_size,
+                            const_cast<rdb_value_t *>(value)->value_ref(),
+                            blob::btree_maxreflen);
+
+    // An inline blob doesn't use the parent.
+    blob_acq_t acq_group;
+    buffer_group_t buffer_group;
+    blob.expose_all(buf_parent_t(), access_t::read, &buffer_group, &acq_group);
+    buffer_group_read_stream_t read_stream(const_view(&buffer_group));
+    archive_result_t res = datum_deserialize(&read_stream, data_out);
+    guarantee_deserialization(res, "rdb value");
+    return true;
+}
+
 const ql::datum_t &lazy_json_t::get() const {
     guarantee(pointee.has());
     if (!pointee->ptr.has()) {
@@ -2,6 +2,8 @@
 #ifndef RDB_PROTOCOL_LAZY_JSON_HPP_
 #define RDB_PROTOCOL_LAZY_JSON_HPP_
 
+#include <string>
+
 #include "buffer_cache/alt.hpp"
 #include "buffer_cache/blob.hpp"
 #include "rdb_protocol/datum.hpp"
@@ -30,6 +32,14 @@ public:
 ql::datum_t get_data(const rdb_value_t *value,
                                       buf_parent_t parent);
 
+/* Like `get_data`, but returns the datum the way it's serialized in the blob. */
+std::string get_serialized_data(const rdb_value_t *value, buf_parent_t parent);
+
+/* Like `get_data`, but only for values that are stored in the leaf node itself,
+so that no blocks need to be acquired.  Returns false for other values. */
+bool get_inline_data(const rdb_value_t *value, max_block_size_t block_size,
+                     ql::datum_t *data_out);
+
 class lazy_json_pointee_t : public single_threaded_countable_t<lazy_json_pointee_t> {
     lazy_json_pointee_t(const rdb_value_t *_rdb_value, buf_parent_t _parent)
         : rdb_value(_rdb_value), parent(_parent) {
@@ -282,6 +282,40 @@ bool op_term_t::is_deterministic() const {
     return all_are_deterministic(optargs);
 }
 
+bool op_term_t::args_after_first_are_deterministic() const {
+    const std::vector<counted_t<const term_t> > &original_args
+        = arg_terms->get_original_args();
+    // An `r.args` in first position could provide some of the other arguments.
+    if (original_args.empty() || original_args[0]->get_src()->type() == Term::ARGS) {
+        return false;
+    }
+    for (size_t i = 1; i < original_args.size(); ++i) {
+        if (!original_args[i]->is_deterministic()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+datum_t op_term_t::literal_arg(size_t i) const {
+    const std::vector<counted_t<const term_t> > &original_args
+        = arg_terms->get_original_args();
+    if (i >= original_args.size()) {
+        return datum_t();
+    }
+    for (const auto &arg : original_args) {
+        if (arg->get_src()->type() == Term::ARGS) {
+            return datum_t();
+        }
+    }
+    const protob_t<const Term> &src = original_args[i]->get_src();
+    if (src->type() != Term::DATUM) {
+        return datum_t();
+    }
+    return to_datum(&src->datum(), configured_limits_t::unlimited,
+                    reql_version_t::LATEST);
+}
+
 void op_term_t::maybe_grouped_data(scope_env_t *env,
                                    argvec_t *argv,
                                    eval_flags_t flags,
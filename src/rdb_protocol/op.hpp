@@ -128,6 +128,15 @@ protected:
     // a subclass).
     virtual void accumulate_captures(var_captures_t *captures) const;
 
+    // Whether the arguments after the first one are all deterministic, so that
+    // they can be evaluated once instead of for every element of the first one.
+    bool args_after_first_are_deterministic() const;
+
+    // If argument `i` is a literal datum, and `r.args` can't change how many
+    // arguments there are, returns it; otherwise returns an empty `datum_t`.  Terms
+    // use this to pick faster evaluations at compile time.
+    datum_t literal_arg(size_t i) const;
+
 private:
     friend class args_t;
     // Tries to get an optional argument, returns `scoped_ptr_t<val_t>()` if not found.
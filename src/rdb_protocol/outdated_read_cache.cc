@@ -0,0 +1,59 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/outdated_read_cache.hpp"
+
+#include <vector>
+
+#include "config/args.hpp"
+
+namespace ql {
+
+outdated_read_cache_t::outdated_read_cache_t()
+    : entries(OUTDATED_READ_CACHE_SIZE) { }
+
+datum_t outdated_read_cache_t::get(const std::string &table_id,
+                                   const datum_t &pkey,
+                                   int max_age_ms) {
+    assert_thread();
+    const key_t key(table_id, pkey.print());
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        return datum_t();
+    }
+    const microtime_t now = current_microtime();
+    const microtime_t read_time = it->second.read_time;
+    if (read_time > now
+        || now - read_time > static_cast<microtime_t>(max_age_ms) * THOUSAND) {
+        entries.erase(key);
+        return datum_t();
+    }
+    return it->second.row;
+}
+
+void outdated_read_cache_t::put(const std::string &table_id,
+                                const datum_t &pkey,
+                                datum_t row) {
+    assert_thread();
+    entry_t *entry = &entries[key_t(table_id, pkey.print())];
+    entry->row = std::move(row);
+    entry->read_time = current_microtime();
+}
+
+void outdated_read_cache_t::drop(const std::string &table_id, const datum_t &pkey) {
+    assert_thread();
+    entries.erase(key_t(table_id, pkey.print()));
+}
+
+void outdated_read_cache_t::drop_table(const std::string &table_id) {
+    assert_thread();
+    std::vector<key_t> keys;
+    for (const auto &pair : entries) {
+        if (pair.first.first == table_id) {
+            keys.push_back(pair.first);
+        }
+    }
+    for (const key_t &key : keys) {
+        entries.erase(key);
+    }
+}
+
+}  // namespace ql
@@ -0,0 +1,46 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_OUTDATED_READ_CACHE_HPP_
+#define RDB_PROTOCOL_OUTDATED_READ_CACHE_HPP_
+
+#include <string>
+#include <utility>
+
+#include "containers/lru_cache.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "threading.hpp"
+#include "time.hpp"
+
+namespace ql {
+
+/* The rows that point reads with `use_outdated` returned recently on this thread,
+so that a hot key doesn't have to go to a replica over the network every time.
+Outdated reads can already be behind the primary, so a row that was read at most
+`--outdated-read-cache` milliseconds ago is as good an answer.  Writes made from
+this thread drop the rows they write, so outdated reads that come after them on
+the same thread see them. */
+class outdated_read_cache_t : public home_thread_mixin_t {
+public:
+    outdated_read_cache_t();
+
+    // Returns an empty `datum_t` if there's no row for `pkey`, or if it was read
+    // more than `max_age_ms` ago.  Rows that don't exist are cached as `null`.
+    datum_t get(const std::string &table_id, const datum_t &pkey, int max_age_ms);
+    void put(const std::string &table_id, const datum_t &pkey, datum_t row);
+
+    void drop(const std::string &table_id, const datum_t &pkey);
+    void drop_table(const std::string &table_id);
+
+private:
+    typedef std::pair<std::string, std::string> key_t;
+    struct entry_t {
+        datum_t row;
+        microtime_t read_time;
+    };
+    lru_cache_t<key_t, entry_t> entries;
+
+    DISABLE_COPYING(outdated_read_cache_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_OUTDATED_READ_CACHE_HPP_
@@ -0,0 +1,153 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/parallel_eval.hpp"
+
+#include <exception>
+#include <map>
+#include <string>
+
+#include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/pmap.hpp"
+#include "config/args.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/val.hpp"
+#include "threading.hpp"
+
+namespace ql {
+
+static bool is_deterministic_func(const wire_func_t &f) {
+    return f.compile_wire_func()->is_deterministic();
+}
+
+static bool can_run_in_parallel(const transform_variant_t &tv) {
+    if (const map_wire_func_t *map = boost::get<map_wire_func_t>(&tv)) {
+        return is_deterministic_func(*map);
+    } else if (const filter_wire_func_t *filter = boost::get<filter_wire_func_t>(&tv)) {
+        return is_deterministic_func(filter->filter_func)
+            && (!filter->default_filter_val
+                || is_deterministic_func(*filter->default_filter_val));
+    } else {
+        return false;
+    }
+}
+
+class parallel_eval_t {
+public:
+    parallel_eval_t(env_t *env,
+                    const std::vector<transform_variant_t> *_transforms,
+                    const std::vector<datum_t> *_input,
+                    int num_workers)
+        : ctx(env->get_rdb_ctx()),
+          interruptor(env->interruptor),
+          optargs(env->get_all_optargs()),
+          transforms(_transforms),
+          input(_input),
+          num_chunks(std::min(input->size(),
+                              static_cast<size_t>(num_workers)
+                              * PARALLEL_EVAL_CHUNKS_PER_THREAD)),
+          results(num_chunks),
+          errors(num_chunks),
+          next_chunk(0),
+          failed(false),
+          home_thread(get_thread_id()) { }
+
+    void run_worker(int worker) {
+        const threadnum_t thread((home_thread.threadnum + worker) % get_num_db_threads());
+        cross_thread_signal_t ct_interruptor(interruptor, thread);
+        on_thread_t th(thread);
+
+        env_t local_env(ctx, &ct_interruptor, optargs, NULL);
+        std::vector<scoped_ptr_t<op_t> > ops;
+        for (auto it = transforms->begin(); it != transforms->end(); ++it) {
+            ops.push_back(make_op(*it));
+        }
+
+        for (;;) {
+            const size_t chunk = __sync_fetch_and_add(&next_chunk, 1);
+            if (chunk >= num_chunks || failed) {
+                break;
+            }
+            groups_t groups(optional_datum_less_t(local_env.reql_version()));
+            std::vector<datum_t> *lst = &groups[datum_t()];
+            lst->assign(input->begin() + chunk_begin(chunk),
+                        input->begin() + chunk_begin(chunk + 1));
+            try {
+                for (auto it = ops.begin(); it != ops.end(); ++it) {
+                    (**it)(&local_env, &groups, datum_t());
+                }
+            } catch (...) {
+                errors[chunk] = std::current_exception();
+                failed = true;
+                break;
+            }
+            if (!groups.empty()) {
+                results[chunk] = std::move(groups.begin()->second);
+            }
+        }
+    }
+
+    void collect_results(std::vector<datum_t> *out) {
+        for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+            if (errors[chunk]) {
+                std::rethrow_exception(errors[chunk]);
+            }
+        }
+        out->clear();
+        for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+            out->insert(out->end(), results[chunk].begin(), results[chunk].end());
+        }
+    }
+
+private:
+    size_t chunk_begin(size_t chunk) const {
+        return chunk * input->size() / num_chunks;
+    }
+
+    rdb_context_t *const ctx;
+    signal_t *const interruptor;
+    const std::map<std::string, wire_func_t> optargs;
+    const std::vector<transform_variant_t> *const transforms;
+    const std::vector<datum_t> *const input;
+    const size_t num_chunks;
+
+    // Each chunk's results and error are only written by the worker that claimed it.
+    std::vector<std::vector<datum_t> > results;
+    std::vector<std::exception_ptr> errors;
+
+    size_t next_chunk;
+    volatile bool failed;
+    const threadnum_t home_thread;
+
+    DISABLE_COPYING(parallel_eval_t);
+};
+
+bool maybe_apply_transforms_in_parallel(
+        env_t *env,
+        const std::vector<transform_variant_t> &transforms,
+        std::vector<datum_t> *batch) {
+    const int num_workers = get_num_db_threads();
+    if (transforms.empty()
+        || batch->size() < PARALLEL_EVAL_MIN_BATCH_SIZE
+        || num_workers < 2
+        || env->get_rdb_ctx() == NULL
+        || env->profile() != profile_bool_t::DONT_PROFILE) {
+        return false;
+    }
+    for (auto it = transforms.begin(); it != transforms.end(); ++it) {
+        if (!can_run_in_parallel(*it)) {
+            return false;
+        }
+    }
+    scoped_ptr_t<val_t> enabled = env->get_optarg(env, "parallel_eval");
+    if (!enabled.has() || !enabled->as_bool()) {
+        return false;
+    }
+
+    parallel_eval_t eval(env, &transforms, batch, num_workers);
+    pmap(num_workers, std::bind(&parallel_eval_t::run_worker, &eval,
+                                std::placeholders::_1));
+    eval.collect_results(batch);
+    return true;
+}
+
+}  // namespace ql
@@ -0,0 +1,37 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_PARALLEL_EVAL_HPP_
+#define RDB_PROTOCOL_PARALLEL_EVAL_HPP_
+
+#include <vector>
+
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/shards.hpp"
+
+namespace ql {
+
+class env_t;
+
+/* Applies `transforms` to `batch` using all of the server's db threads, if the query
+was run with the `parallel_eval` optarg and the work qualifies. Only `map` and
+`filter` transforms with deterministic functions qualify, since those don't touch
+anything but their arguments; and only if the batch has at least
+`PARALLEL_EVAL_MIN_BATCH_SIZE` elements and the query isn't being profiled.
+
+The batch is cut into chunks, and one worker per db thread keeps claiming the next
+unprocessed chunk until there are none left, so a thread that gets cheap elements
+takes over work from the others. Every worker evaluates in its own `env_t` on its own
+thread; datums and compiled functions are atomically reference-counted, so they
+can be shared between the threads. The results come back in their original order,
+and if evaluation fails, the error of the earliest failing chunk is rethrown, just
+as if the batch had been processed sequentially.
+
+Returns false without touching `batch` if the transforms have to be applied on the
+current thread instead. */
+bool maybe_apply_transforms_in_parallel(
+    env_t *env,
+    const std::vector<transform_variant_t> &transforms,
+    std::vector<datum_t> *batch);
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_PARALLEL_EVAL_HPP_
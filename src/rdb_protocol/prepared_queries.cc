@@ -0,0 +1,39 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/prepared_queries.hpp"
+
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/error.hpp"
+#include "rdb_protocol/ql2.pb.h"
+
+namespace ql {
+
+const size_t prepared_queries_t::MAX_PREPARED_QUERIES;
+
+int64_t prepared_queries_t::prepare(const protob_t<const Term> &func_term) {
+    r_sanity_check(func_term->type() == Term::FUNC);
+    std::string serialized = func_term->SerializeAsString();
+    auto it = ids_by_term.find(serialized);
+    if (it != ids_by_term.end()) {
+        return it->second;
+    }
+    rcheck_toplevel(funcs.size() < MAX_PREPARED_QUERIES, base_exc_t::GENERIC,
+                    strprintf("Cannot prepare more than %zu queries on one "
+                              "connection.", MAX_PREPARED_QUERIES));
+
+    compile_env_t empty_compile_env((var_visibility_t()));
+    counted_t<func_term_t> compiled
+        = make_counted<func_term_t>(&empty_compile_env, func_term);
+    counted_t<const func_t> func = compiled->eval_to_func(var_scope_t());
+
+    const int64_t id = next_id++;
+    funcs.insert(std::make_pair(id, std::move(func)));
+    ids_by_term.insert(std::make_pair(std::move(serialized), id));
+    return id;
+}
+
+counted_t<const func_t> prepared_queries_t::get(int64_t id) const {
+    auto it = funcs.find(id);
+    return it != funcs.end() ? it->second : counted_t<const func_t>();
+}
+
+}  // namespace ql
@@ -0,0 +1,49 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_PREPARED_QUERIES_HPP_
+#define RDB_PROTOCOL_PREPARED_QUERIES_HPP_
+
+#include <map>
+#include <string>
+#include <unordered_map>
+
+#include "containers/counted.hpp"
+#include "rdb_protocol/counted_term.hpp"
+#include "rdb_protocol/func.hpp"
+
+class Term;
+
+namespace ql {
+
+/* The functions a connection compiled with `PREPARE` queries, for its `EXECUTE`
+queries to call, so that those only have to parse and compile their arguments.
+Functions are looked up by the serialization of their term, so preparing the same
+one again returns the same id without compiling it again.
+
+The compiled terms' reference counts aren't atomic, so this must only be used on
+the connection's thread. */
+class prepared_queries_t {
+public:
+    prepared_queries_t() : next_id(1) { }
+
+    // Compiles `func_term`, which must be a `FUNC` term with its backtraces already
+    // filled in, and returns its id.
+    int64_t prepare(const protob_t<const Term> &func_term);
+
+    // Returns an empty `counted_t` if there's no function with that id.
+    counted_t<const func_t> get(int64_t id) const;
+
+    size_t size() const { return funcs.size(); }
+
+private:
+    static const size_t MAX_PREPARED_QUERIES = 1024;
+
+    std::unordered_map<std::string, int64_t> ids_by_term;
+    std::map<int64_t, counted_t<const func_t> > funcs;
+    int64_t next_id;
+
+    DISABLE_COPYING(prepared_queries_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_PREPARED_QUERIES_HPP_
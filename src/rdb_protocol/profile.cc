@@ -2,6 +2,7 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
 #include <limits>
 
 #include "errors.hpp"
@@ -288,10 +289,13 @@ void disabler_t::init(trace_t *parent) {
     }
 }
 
-trace_t::trace_t()
-    : redirected_event_log_(NULL), disabled_ref_count_(0) { }
+trace_t::trace_t(bool aggregate)
+    : redirected_event_log_(NULL), disabled_ref_count_(0), aggregate_(aggregate) { }
 
 ql::datum_t trace_t::as_datum() const {
+    if (aggregate_) {
+        return totals_as_datum();
+    }
     guarantee(!redirected_event_log_);
     event_log_t::const_iterator begin = event_log_.begin();
     // Again, use defaults, as there's no predicting where this could
@@ -305,23 +309,81 @@ event_log_t trace_t::extract_event_log() RVALUE_THIS {
     // state (which is valid, thereby acceptable for an RVALUE_THIS function).
     guarantee(redirected_event_log_ == NULL);
     guarantee(disabled_ref_count_ == 0);
+    if (aggregate_) {
+        guarantee(open_tasks_.empty());
+        event_log_t event_log;
+        for (const auto &pair : totals_) {
+            event_log.push_back(sample_t(pair.first,
+                                         pair.second.total_duration / pair.second.n_tasks,
+                                         pair.second.n_tasks));
+        }
+        totals_.clear();
+        return event_log;
+    }
     return std::move(event_log_);
 }
 
+void trace_t::add_to_totals(const std::string &description, ticks_t total_duration,
+                            size_t n_tasks) {
+    totals_t *totals = &totals_[description];
+    totals->n_tasks += n_tasks;
+    totals->total_duration += total_duration;
+}
+
+ql::datum_t trace_t::totals_as_datum() const {
+    // The most expensive tasks come first.  A task's duration includes the tasks
+    // it started, so nested terms are counted in their parents' totals as well.
+    std::vector<std::map<std::string, totals_t>::const_iterator> order;
+    for (auto it = totals_.begin(); it != totals_.end(); ++it) {
+        order.push_back(it);
+    }
+    std::sort(order.begin(), order.end(),
+        [](const std::map<std::string, totals_t>::const_iterator &a,
+           const std::map<std::string, totals_t>::const_iterator &b) {
+            return a->second.total_duration > b->second.total_duration;
+        });
+
+    std::vector<ql::datum_t> res;
+    for (const auto &it : order) {
+        std::map<datum_string_t, ql::datum_t> task;
+        double total_duration = safe_to_double(it->second.total_duration) / MILLION;
+        double n_tasks = safe_to_double(it->second.n_tasks);
+        task[datum_string_t("description")] =
+            ql::datum_t(datum_string_t(it->first));
+        task[datum_string_t("n_samples")] = ql::datum_t(n_tasks);
+        task[datum_string_t("total_duration(ms)")] = ql::datum_t(total_duration);
+        task[datum_string_t("mean_duration(ms)")] =
+            ql::datum_t(total_duration / n_tasks);
+        res.push_back(ql::datum_t(std::move(task)));
+    }
+    return ql::datum_t(std::move(res), ql::configured_limits_t());
+}
+
 void trace_t::start(const std::string &description) {
     if (disabled()) { return; }
     //debugf("Start %s %p.\n", description.c_str(), this);
+    if (aggregate_) {
+        open_tasks_.push_back(start_t(description));
+        return;
+    }
     event_log_target()->push_back(start_t(description));
 }
 
 void trace_t::stop() {
     if (disabled()) { return; }
     //debugf("Stop %p.\n", this);
+    if (aggregate_) {
+        guarantee(!open_tasks_.empty());
+        const start_t &start = open_tasks_.back();
+        add_to_totals(start.description_, get_ticks() - start.when_, 1);
+        open_tasks_.pop_back();
+        return;
+    }
     event_log_target()->push_back(stop_t());
 }
 
 void trace_t::start_split() {
-    if (disabled()) { return; }
+    if (disabled() || aggregate_) { return; }
     //debugf("Start split %p.\n", this);
     event_log_target()->push_back(split_t());
 }
@@ -329,6 +391,18 @@ void trace_t::start_split() {
 void trace_t::stop_split(size_t n_parallel_jobs_, const event_log_t &par_event_log) {
     if (disabled()) { return; }
     //debugf("Stop split %zu, %p.\n", n_parallel_jobs_, this);
+    if (aggregate_) {
+        // The parallel tasks' event logs are their totals, and the `stop_t`s that
+        // end them.
+        for (const auto &event : par_event_log) {
+            if (const sample_t *sample = boost::get<sample_t>(&event)) {
+                add_to_totals(sample->description_,
+                              sample->mean_duration_ * sample->n_samples_,
+                              sample->n_samples_);
+            }
+        }
+        return;
+    }
     auto split = boost::get<split_t>(&event_log_target()->back());
     guarantee(split);
     split->n_parallel_jobs_ = n_parallel_jobs_;
@@ -336,7 +410,7 @@ void trace_t::stop_split(size_t n_parallel_jobs_, const event_log_t &par_event_l
 }
 
 void trace_t::start_sample(event_log_t *event_log) {
-    if (disabled()) { return; }
+    if (disabled() || aggregate_) { return; }
     //debugf("Start sample %p.\n", this);
     /* This is a tad hacky. We currently don't  allow samples within samples.
      * And if someone tries to do it the inner sample winds up just being a
@@ -349,7 +423,7 @@ void trace_t::start_sample(event_log_t *event_log) {
 
 void trace_t::stop_sample(const std::string &description,
         ticks_t mean_duration, size_t n_samples, event_log_t *event_log) {
-    if (disabled()) { return; }
+    if (disabled() || aggregate_) { return; }
     //debugf("Stop sample %s, %p.\n", description.c_str(), this);
     /* Don't reset the redirected_event_log_ if the sampler_t wasn't
      * actually being redirected to. The predicate fails when the
@@ -361,7 +435,7 @@ void trace_t::stop_sample(const std::string &description,
 }
 
 void trace_t::stop_sample(event_log_t *event_log) {
-    if (disabled()) { return; }
+    if (disabled() || aggregate_) { return; }
     //debugf("Stop sample %p.\n", this);
     /* Don't reset the redirected_event_log_ if the sampler_t wasn't
      * actually being redirected to. The predicate fails when the
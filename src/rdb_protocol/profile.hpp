@@ -2,6 +2,7 @@
 #ifndef RDB_PROTOCOL_PROFILE_HPP_
 #define RDB_PROTOCOL_PROFILE_HPP_
 
+#include <map>
 #include <string>
 #include <vector>
 
@@ -60,10 +61,17 @@ typedef boost::variant<start_t, split_t, sample_t, stop_t> event_t;
 typedef std::vector<event_t> event_log_t;
 
 /* A trace_t contains an event_log_t and provides private methods for adding
- * events to it. These methods are leveraged by the instruments. */
+ * events to it. These methods are leveraged by the instruments.
+ *
+ * An aggregate trace_t doesn't log every task. It only keeps the count and the
+ * total duration of the tasks with each description, which costs much less on
+ * queries that evaluate terms for many rows. Its event log is a sample_t per
+ * description, which is how shards send back their totals to be merged. Samplers
+ * are ignored, the tasks inside them are counted like any others. */
 class trace_t {
 public:
-    trace_t();
+    explicit trace_t(bool aggregate = false);
+    bool is_aggregate() const { return aggregate_; }
     ql::datum_t as_datum() const;
     event_log_t extract_event_log() RVALUE_THIS;
 private:
@@ -91,6 +99,20 @@ private:
     size_t disabled_ref_count_;
     bool disabled();
 
+    struct totals_t {
+        totals_t() : n_tasks(0), total_duration(0) { }
+        size_t n_tasks;
+        ticks_t total_duration;
+    };
+    void add_to_totals(const std::string &description, ticks_t total_duration,
+                       size_t n_tasks);
+    ql::datum_t totals_as_datum() const;
+
+    const bool aggregate_;
+    /* Only for aggregate traces, the tasks that have started but not stopped. */
+    std::vector<start_t> open_tasks_;
+    std::map<std::string, totals_t> totals_;
+
     DISABLE_COPYING(trace_t);
 };
 
@@ -51,7 +51,7 @@ RDB_IMPL_PROTOB_SERIALIZABLE(Term);
 RDB_IMPL_PROTOB_SERIALIZABLE(Datum);
 RDB_IMPL_PROTOB_SERIALIZABLE(Backtrace);
 
-RDB_IMPL_SERIALIZABLE_3_SINCE_v1_13(backfill_atom_t, key, value, recency);
+RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(backfill_atom_t, key, value, recency);
 
 namespace rdb_protocol {
 
@@ -211,24 +211,26 @@ void post_construct_and_drain_queue(
             // earlier than we do now, ideally before we wait for the acq signal?
             acq->acq_signal()->wait_lazily_unordered();
 
-            const int MAX_CHUNK_SIZE = 10;
-            int current_chunk_size = 0;
-            while (current_chunk_size < MAX_CHUNK_SIZE && mod_queue->size() > 0) {
-                rdb_modification_report_t mod_report;
-                // This involves a disk backed queue so there are no versioning issues.
-                deserializing_viewer_t<rdb_modification_report_t>
-                    viewer(&mod_report);
-                mod_queue->pop(&viewer);
-                rdb_post_construction_deletion_context_t deletion_context;
-                rdb_update_sindexes(store,
-                                    sindexes,
-                                    &mod_report,
-                                    queue_txn.get(),
-                                    &deletion_context,
-                                    NULL,
-                                    NULL,
-                                    NULL);
-                ++current_chunk_size;
+            const size_t MAX_CHUNK_SIZE = 10;
+            if (mod_queue->size() > 0) {
+                // The whole chunk is popped in one queue transaction.  This involves
+                // a disk backed queue so there are no versioning issues.
+                std::vector<rdb_modification_report_t> mod_reports;
+                mod_reports.reserve(MAX_CHUNK_SIZE);
+                deserializing_vector_viewer_t<rdb_modification_report_t>
+                    viewer(&mod_reports);
+                mod_queue->pop(&viewer, MAX_CHUNK_SIZE);
+                for (auto &mod_report : mod_reports) {
+                    rdb_post_construction_deletion_context_t deletion_context;
+                    rdb_update_sindexes(store,
+                                        sindexes,
+                                        &mod_report,
+                                        queue_txn.get(),
+                                        &deletion_context,
+                                        NULL,
+                                        NULL,
+                                        NULL);
+                }
             }
 
             if (mod_queue->size() == 0) {
@@ -297,6 +299,8 @@ void add_status(const single_sindex_status_t &new_status,
     status_out->func = new_status.func; // All shards have the same function.
     status_out->geo = new_status.geo; // All shards have the same geoness.
     status_out->multi = new_status.multi; // All shards have the same multiness.
+    status_out->covering = new_status.covering; // All shards cover the same fields.
+    status_out->partial = new_status.partial; // All shards have the same filter.
     status_out->outdated = new_status.outdated; // All shards have the same datedness.
 }
 
@@ -352,12 +356,54 @@ store_key_t sindex_list_region_key() {
     return store_key_t();
 }
 
+// TODO: This entire type is suspect, given the performance for
+// batched_replaces_t.  Is it used in anything other than assertions?
+region_t region_from_keys(const std::vector<store_key_t> &keys) {
+    // It shouldn't be empty, but we let the places that would break use a
+    // guarantee.
+    rassert(!keys.empty());
+    if (keys.empty()) {
+        return hash_region_t<key_range_t>();
+    }
+
+    store_key_t min_key = store_key_t::max();
+    store_key_t max_key = store_key_t::min();
+    uint64_t min_hash_value = HASH_REGION_HASH_SIZE - 1;
+    uint64_t max_hash_value = 0;
+
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        const store_key_t &key = *it;
+        if (key < min_key) {
+            min_key = key;
+        }
+        if (key > max_key) {
+            max_key = key;
+        }
+
+        const uint64_t hash_value = hash_region_hasher(key.contents(), key.size());
+        if (hash_value < min_hash_value) {
+            min_hash_value = hash_value;
+        }
+        if (hash_value > max_hash_value) {
+            max_hash_value = hash_value;
+        }
+    }
+
+    return hash_region_t<key_range_t>(
+        min_hash_value, max_hash_value + 1,
+        key_range_t(key_range_t::closed, min_key, key_range_t::closed, max_key));
+}
+
 /* read_t::get_region implementation */
 struct rdb_r_get_region_visitor : public boost::static_visitor<region_t> {
     region_t operator()(const point_read_t &pr) const {
         return rdb_protocol::monokey_region(pr.key);
     }
 
+    region_t operator()(const batched_point_read_t &bpr) const {
+        return region_from_keys(bpr.keys);
+    }
+
     region_t operator()(const rget_read_t &rg) const {
         return rg.region;
     }
@@ -374,6 +420,10 @@ struct rdb_r_get_region_visitor : public boost::static_visitor<region_t> {
         return dg.region;
     }
 
+    region_t operator()(const backfill_digest_read_t &bd) const {
+        return bd.region;
+    }
+
     region_t operator()(UNUSED const sindex_list_t &sl) const {
         return rdb_protocol::monokey_region(sindex_list_region_key());
     }
@@ -407,6 +457,18 @@ region_t read_t::get_region() const THROWS_NOTHING {
     return boost::apply_visitor(rdb_r_get_region_visitor(), read);
 }
 
+const store_key_t *read_t::point_key() const THROWS_NOTHING {
+    if (const point_read_t *pr = boost::get<point_read_t>(&read)) {
+        return &pr->key;
+    }
+    if (const batched_point_read_t *bpr = boost::get<batched_point_read_t>(&read)) {
+        if (bpr->keys.size() == 1) {
+            return &bpr->keys[0];
+        }
+    }
+    return NULL;
+}
+
 struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
     explicit rdb_r_shard_visitor_t(const hash_region_t<key_range_t> *_region,
                                    read_t::variant_t *_payload_out)
@@ -427,6 +489,21 @@ struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
         return keyed_read(pr, pr.key);
     }
 
+    bool operator()(const batched_point_read_t &bpr) const {
+        std::vector<store_key_t> shard_keys;
+        for (auto it = bpr.keys.begin(); it != bpr.keys.end(); ++it) {
+            if (region_contains_key(*region, *it)) {
+                shard_keys.push_back(*it);
+            }
+        }
+        if (!shard_keys.empty()) {
+            *payload_out = batched_point_read_t(std::move(shard_keys));
+            return true;
+        } else {
+            return false;
+        }
+    }
+
     template <class T>
     bool rangey_read(const T &arg) const {
         const hash_region_t<key_range_t> intersection
@@ -478,6 +555,10 @@ struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
         return rangey_read(dg);
     }
 
+    bool operator()(const backfill_digest_read_t &bd) const {
+        return rangey_read(bd);
+    }
+
     bool operator()(const sindex_list_t &sl) const {
         return keyed_read(sl, sindex_list_region_key());
     }
@@ -499,6 +580,7 @@ bool read_t::shard(const hash_region_t<key_range_t> &region,
     read_t::variant_t payload;
     bool result = boost::apply_visitor(rdb_r_shard_visitor_t(&region, &payload), read);
     *read_out = read_t(payload, profile);
+    read_out->priority = priority;
     return result;
 }
 
@@ -533,6 +615,19 @@ void scale_down_distribution(size_t result_limit, std::map<store_key_t, int64_t>
     }
 }
 
+key_range_t backfill_digests_t::range(size_t i) const {
+    guarantee(i < digests.size());
+    guarantee(splits.size() + 1 == digests.size());
+    key_range_t r = region.inner;
+    if (i > 0) {
+        r.left = splits[i - 1];
+    }
+    if (i < splits.size()) {
+        r.right = key_range_t::right_bound_t(splits[i]);
+    }
+    return r;
+}
+
 class rdb_r_unshard_visitor_t : public boost::static_visitor<void> {
 public:
     rdb_r_unshard_visitor_t(profile_bool_t _profile,
@@ -546,11 +641,13 @@ public:
           ctx(_ctx), interruptor(_interruptor) { }
 
     void operator()(const point_read_t &);
+    void operator()(const batched_point_read_t &);
 
     void operator()(const rget_read_t &rg);
     void operator()(const intersecting_geo_read_t &gr);
     void operator()(const nearest_geo_read_t &gr);
     void operator()(const distribution_read_t &rg);
+    void operator()(const backfill_digest_read_t &bd);
     void operator()(const sindex_list_t &rg);
     void operator()(const sindex_status_t &rg);
     void operator()(const changefeed_subscribe_t &);
@@ -621,6 +718,14 @@ void rdb_r_unshard_visitor_t::operator()(const changefeed_stamp_t &) {
                 it_out->second = std::max(it->second, it_out->second);
             }
         }
+        // Positions only grow along with stamps, so we keep the largest too.
+        for (const auto &pair : res->log_positions) {
+            uint64_t *pos = &out->log_positions[pair.first];
+            *pos = std::max(*pos, pair.second);
+        }
+        if (res->resume_error && !out->resume_error) {
+            out->resume_error = res->resume_error;
+        }
     }
 }
 
@@ -636,6 +741,21 @@ void rdb_r_unshard_visitor_t::operator()(const point_read_t &) {
     *response_out = responses[0];
 }
 
+void rdb_r_unshard_visitor_t::operator()(const batched_point_read_t &) {
+    response_out->response = batched_point_read_response_t();
+    auto out = boost::get<batched_point_read_response_t>(&response_out->response);
+    for (size_t i = 0; i < count; ++i) {
+        auto res = boost::get<batched_point_read_response_t>(&responses[i].response);
+        guarantee(res != NULL);
+        // The shards' keys don't overlap, so the maps don't either.
+        if (out->rows.empty()) {
+            out->rows = std::move(res->rows);
+        } else {
+            out->rows.insert(res->rows.begin(), res->rows.end());
+        }
+    }
+}
+
 void rdb_r_unshard_visitor_t::operator()(const intersecting_geo_read_t &query) {
     unshard_range_batch<rget_read_response_t>(query, sorting_t::UNORDERED);
 }
@@ -761,6 +881,13 @@ void rdb_r_unshard_visitor_t::operator()(const distribution_read_t &dg) {
     std::sort(results.begin(), results.end(), distribution_read_response_less_t());
 
     distribution_read_response_t res;
+    // Unlike their documents, the hash shards of a key range split up its load, so
+    // their loads get added up.
+    for (const distribution_read_response_t &result : results) {
+        for (const auto &pair : result.key_loads) {
+            res.key_loads[pair.first] += pair.second;
+        }
+    }
     size_t i = 0;
     while (i < results.size()) {
         // Find the largest hash shard for this key range
@@ -837,6 +964,13 @@ void rdb_r_unshard_visitor_t::operator()(const dummy_read_t &) {
     *response_out = responses[0];
 }
 
+void rdb_r_unshard_visitor_t::operator()(const backfill_digest_read_t &) {
+    // The digests of different shards wouldn't be of the same ranges, but these
+    // reads only go to a single store.
+    guarantee(count == 1);
+    *response_out = responses[0];
+}
+
 void read_t::unshard(read_response_t *responses, size_t count,
                      read_response_t *response_out, rdb_context_t *ctx,
                      signal_t *interruptor) const
@@ -852,7 +986,7 @@ void read_t::unshard(read_response_t *responses, size_t count,
      * we set them here. */
     response_out->n_shards = 0;
     response_out->event_log.clear();
-    if (profile == profile_bool_t::PROFILE) {
+    if (profile != profile_bool_t::DONT_PROFILE) {
         for (size_t i = 0; i < count; ++i) {
             response_out->event_log.insert(
                 response_out->event_log.end(),
@@ -865,6 +999,7 @@ void read_t::unshard(read_response_t *responses, size_t count,
 
 struct use_snapshot_visitor_t : public boost::static_visitor<bool> {
     bool operator()(const point_read_t &) const {                 return false; }
+    bool operator()(const batched_point_read_t &) const {         return false; }
     bool operator()(const dummy_read_t &) const {                 return false; }
     bool operator()(const rget_read_t &) const {                  return true;  }
     bool operator()(const intersecting_geo_read_t &) const {      return true;  }
@@ -874,6 +1009,7 @@ struct use_snapshot_visitor_t : public boost::static_visitor<bool> {
     bool operator()(const changefeed_stamp_t &) const {           return false; }
     bool operator()(const changefeed_point_stamp_t &) const {     return false; }
     bool operator()(const distribution_read_t &) const {          return true;  }
+    bool operator()(const backfill_digest_read_t &) const {       return true;  }
     bool operator()(const sindex_list_t &) const {                return false; }
     bool operator()(const sindex_status_t &) const {              return false; }
 };
@@ -887,44 +1023,6 @@ bool read_t::use_snapshot() const THROWS_NOTHING {
 
 /* write_t::get_region() implementation */
 
-// TODO: This entire type is suspect, given the performance for
-// batched_replaces_t.  Is it used in anything other than assertions?
-region_t region_from_keys(const std::vector<store_key_t> &keys) {
-    // It shouldn't be empty, but we let the places that would break use a
-    // guarantee.
-    rassert(!keys.empty());
-    if (keys.empty()) {
-        return hash_region_t<key_range_t>();
-    }
-
-    store_key_t min_key = store_key_t::max();
-    store_key_t max_key = store_key_t::min();
-    uint64_t min_hash_value = HASH_REGION_HASH_SIZE - 1;
-    uint64_t max_hash_value = 0;
-
-    for (auto it = keys.begin(); it != keys.end(); ++it) {
-        const store_key_t &key = *it;
-        if (key < min_key) {
-            min_key = key;
-        }
-        if (key > max_key) {
-            max_key = key;
-        }
-
-        const uint64_t hash_value = hash_region_hasher(key.contents(), key.size());
-        if (hash_value < min_hash_value) {
-            min_hash_value = hash_value;
-        }
-        if (hash_value > max_hash_value) {
-            max_hash_value = hash_value;
-        }
-    }
-
-    return hash_region_t<key_range_t>(
-        min_hash_value, max_hash_value + 1,
-        key_range_t(key_range_t::closed, min_key, key_range_t::closed, max_key));
-}
-
 struct rdb_w_get_region_visitor : public boost::static_visitor<region_t> {
     region_t operator()(const batched_replace_t &br) const {
         return region_from_keys(br.keys);
@@ -977,6 +1075,10 @@ struct rdb_w_get_region_visitor : public boost::static_visitor<region_t> {
     region_t operator()(const dummy_write_t &d) const {
         return d.region;
     }
+
+    region_t operator()(const truncate_t &t) const {
+        return t.region;
+    }
 };
 
 #ifndef NDEBUG
@@ -986,6 +1088,21 @@ region_t write_t::get_region() const THROWS_NOTHING {
 }
 #endif // NDEBUG
 
+const store_key_t *write_t::point_key() const THROWS_NOTHING {
+    if (const point_write_t *pw = boost::get<point_write_t>(&write)) {
+        return &pw->key;
+    }
+    if (const point_delete_t *pd = boost::get<point_delete_t>(&write)) {
+        return &pd->key;
+    }
+    if (const batched_replace_t *br = boost::get<batched_replace_t>(&write)) {
+        if (br->keys.size() == 1) {
+            return &br->keys[0];
+        }
+    }
+    return NULL;
+}
+
 /* write_t::shard implementation */
 
 struct rdb_w_shard_visitor_t : public boost::static_visitor<bool> {
@@ -1079,6 +1196,10 @@ struct rdb_w_shard_visitor_t : public boost::static_visitor<bool> {
         return rangey_write(d);
     }
 
+    bool operator()(const truncate_t &t) const {
+        return rangey_write(t);
+    }
+
     const region_t *region;
     write_t::variant_t *payload_out;
 };
@@ -1089,6 +1210,7 @@ bool write_t::shard(const region_t &region,
     const rdb_w_shard_visitor_t v(&region, &payload);
     bool result = boost::apply_visitor(v, write);
     *write_out = write_t(payload, durability_requirement, profile, limits);
+    write_out->priority = priority;
     return result;
 }
 
@@ -1146,6 +1268,10 @@ struct rdb_w_unshard_visitor_t : public boost::static_visitor<void> {
         *response_out = responses[0];
     }
 
+    void operator()(const truncate_t &) const {
+        *response_out = responses[0];
+    }
+
     rdb_w_unshard_visitor_t(const write_response_t *_responses, size_t _count,
                             write_response_t *_response_out,
                             const ql::configured_limits_t *_limits)
@@ -1181,7 +1307,7 @@ void write_t::unshard(write_response_t *responses, size_t count,
      * we set them here. */
     response_out->n_shards = 0;
     response_out->event_log.clear();
-    if (profile == profile_bool_t::PROFILE) {
+    if (profile != profile_bool_t::DONT_PROFILE) {
         for (size_t i = 0; i < count; ++i) {
             response_out->event_log.insert(
                 response_out->event_log.end(),
@@ -1193,7 +1319,7 @@ void write_t::unshard(write_response_t *responses, size_t count,
 }
 
 
-RDB_IMPL_SERIALIZABLE_7_FOR_CLUSTER(
+RDB_IMPL_SERIALIZABLE_9_FOR_CLUSTER(
         rdb_protocol::single_sindex_status_t,
         blocks_total,
         blocks_processed,
@@ -1201,25 +1327,33 @@ RDB_IMPL_SERIALIZABLE_7_FOR_CLUSTER(
         func,
         geo,
         multi,
+        covering,
+        partial,
         outdated);
 
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(point_read_response_t, data);
+RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(batched_point_read_response_t, rows);
 RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(rget_read_response_t, result, truncated, last_key);
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(nearest_geo_read_response_t, results_or_error);
-RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(distribution_read_response_t, region, key_counts);
+RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(distribution_read_response_t,
+                                    region, key_counts, key_loads);
+RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(backfill_digests_t, region, splits, digests);
+RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(backfill_digest_read_response_t, digests);
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(sindex_list_response_t, sindexes);
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(sindex_status_response_t, statuses);
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(
     changefeed_subscribe_response_t, server_uuids, addrs);
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(
     changefeed_limit_subscribe_response_t, shards, limit_addrs);
-RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(changefeed_stamp_response_t, stamps);
+RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(changefeed_stamp_response_t,
+                                    stamps, log_positions, resume_error);
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(
     changefeed_point_stamp_response_t, stamp, initial_val);
 RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(read_response_t, response, event_log, n_shards);
 RDB_IMPL_SERIALIZABLE_0_FOR_CLUSTER(dummy_read_response_t);
 
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(point_read_t, key);
+RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(batched_point_read_t, keys);
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(dummy_read_t, region);
 RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(sindex_rangespec_t, id, region, original_range);
 
@@ -1238,16 +1372,17 @@ RDB_IMPL_SERIALIZABLE_8_FOR_CLUSTER(
 
 RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(
         distribution_read_t, max_depth, result_limit, region);
+RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(backfill_digest_read_t, region);
 RDB_IMPL_SERIALIZABLE_0_FOR_CLUSTER(sindex_list_t);
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(sindex_status_t, sindexes, region);
 
-RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(changefeed_subscribe_t, addr, region);
+RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(changefeed_subscribe_t, addr, spec, region);
 RDB_IMPL_SERIALIZABLE_5_FOR_CLUSTER(
     changefeed_limit_subscribe_t, addr, uuid, spec, table, region);
-RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(changefeed_stamp_t, addr, region);
+RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(changefeed_stamp_t, addr, resume_from, region);
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(changefeed_point_stamp_t, addr, key);
 
-RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(read_t, read, profile);
+RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(read_t, read, profile, priority);
 
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(point_write_response_t, result);
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(point_delete_response_t, result);
@@ -1255,6 +1390,7 @@ RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(sindex_create_response_t, success);
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(sindex_drop_response_t, success);
 RDB_IMPL_SERIALIZABLE_0_FOR_CLUSTER(sync_response_t);
 RDB_IMPL_SERIALIZABLE_0_FOR_CLUSTER(dummy_write_response_t);
+RDB_IMPL_SERIALIZABLE_0_FOR_CLUSTER(truncate_response_t);
 
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(sindex_rename_response_t, result);
 
@@ -1269,18 +1405,20 @@ RDB_IMPL_SERIALIZABLE_5_FOR_CLUSTER(
 
 RDB_IMPL_SERIALIZABLE_3_SINCE_v1_13(point_write_t, key, data, overwrite);
 RDB_IMPL_SERIALIZABLE_1_SINCE_v1_13(point_delete_t, key);
-RDB_IMPL_SERIALIZABLE_5_FOR_CLUSTER(sindex_create_t, id, mapping, region, multi, geo);
+RDB_IMPL_SERIALIZABLE_7_FOR_CLUSTER(sindex_create_t,
+                                    id, mapping, region, multi, geo, covering, filter);
 RDB_IMPL_SERIALIZABLE_2_SINCE_v1_13(sindex_drop_t, id, region);
 RDB_IMPL_SERIALIZABLE_1_SINCE_v1_13(sync_t, region);
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(dummy_write_t, region);
+RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(truncate_t, region);
 
 RDB_IMPL_SERIALIZABLE_4_FOR_CLUSTER(sindex_rename_t, region,
                                     old_name, new_name, overwrite);
 
 // Serialization format changed in 1.14.0. We only support the latest version,
 // since this is a cluster-only type.
-RDB_IMPL_SERIALIZABLE_4_FOR_CLUSTER(
-    write_t, write, durability_requirement, profile, limits);
+RDB_IMPL_SERIALIZABLE_5_FOR_CLUSTER(
+    write_t, write, durability_requirement, profile, limits, priority);
 
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(backfill_chunk_t::delete_key_t, key, recency);
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(backfill_chunk_t::delete_range_t, range);
@@ -47,13 +47,26 @@ class Backtrace;
 
 namespace unittest { struct make_sindex_read_t; }
 
+/* `AGGREGATE` is a cheaper kind of profile, see `profile::trace_t`. */
 enum class profile_bool_t {
     PROFILE,
-    DONT_PROFILE
+    DONT_PROFILE,
+    AGGREGATE
 };
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
         profile_bool_t, int8_t,
-        profile_bool_t::PROFILE, profile_bool_t::DONT_PROFILE);
+        profile_bool_t::PROFILE, profile_bool_t::AGGREGATE);
+
+/* Queries run with `priority: "low"` are for batch jobs, which shouldn't hold up
+interactive queries. Their reads run at a lower coroutine priority, and their reads
+and writes load blocks through a cache account with a smaller share of the disk. */
+enum class query_priority_t {
+    NORMAL,
+    LOW
+};
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
+        query_priority_t, int8_t,
+        query_priority_t::NORMAL, query_priority_t::LOW);
 
 enum class point_write_result_t {
     STORED,
@@ -110,19 +123,21 @@ class intersecting_readgen_t;
 
 struct backfill_atom_t {
     store_key_t key;
-    ql::datum_t value;
+    // The value the way it's serialized in the B-tree, so that it can go from one
+    // B-tree to the other without being deserialized and serialized again.
+    std::string value;
     repli_timestamp_t recency;
 
     backfill_atom_t() { }
     backfill_atom_t(const store_key_t &_key,
-                    const ql::datum_t &_value,
+                    std::string &&_value,
                     const repli_timestamp_t &_recency) :
         key(_key),
-        value(_value),
+        value(std::move(_value)),
         recency(_recency)
     { }
 };
-RDB_DECLARE_SERIALIZABLE(backfill_atom_t);
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(backfill_atom_t);
 
 enum class sindex_multi_bool_t { SINGLE = 0, MULTI = 1};
 enum class sindex_geo_bool_t { REGULAR = 0, GEO = 1};
@@ -144,7 +159,8 @@ struct single_sindex_status_t {
     single_sindex_status_t()
         : blocks_processed(0),
           blocks_total(0), ready(true), outdated(false),
-          geo(sindex_geo_bool_t::REGULAR), multi(sindex_multi_bool_t::SINGLE)
+          geo(sindex_geo_bool_t::REGULAR), multi(sindex_multi_bool_t::SINGLE),
+          partial(false)
     { }
     single_sindex_status_t(size_t _blocks_processed, size_t _blocks_total, bool _ready)
         : blocks_processed(_blocks_processed),
@@ -154,6 +170,8 @@ struct single_sindex_status_t {
     bool outdated;
     sindex_geo_bool_t geo;
     sindex_multi_bool_t multi;
+    std::vector<std::string> covering;
+    bool partial;
     std::string func;
 };
 
@@ -169,6 +187,12 @@ struct point_read_response_t {
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(point_read_response_t);
 
+struct batched_point_read_response_t {
+    // The rows that were found.  Keys without a row aren't in the map.
+    std::map<store_key_t, ql::datum_t> rows;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(batched_point_read_response_t);
+
 struct rget_read_response_t {
     ql::result_t result;
     bool truncated;
@@ -219,9 +243,33 @@ struct distribution_read_response_t {
     // key_counts[kn] = the number of keys in [kn, right_key)
     region_t region;
     std::map<store_key_t, int64_t> key_counts;
+    // Keys that recent reads and writes touched, each with an estimate of how many
+    // reads and writes it stands for. See `key_load_sampler_t`.
+    std::map<store_key_t, int64_t> key_loads;
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(distribution_read_response_t);
 
+/* Digests of the rows of consecutive key ranges that cover `region`.  A backfillee
+sends its digests along with its backfill request, and the backfiller only backfills
+the ranges where the digests of the snapshot it backfills from differ. */
+struct backfill_digests_t {
+    // The ranges start at `region.inner.left` and at each of `splits`, and end at
+    // the next split or at the end of the region, so there's a digest for each
+    // split and one more.  No digests means nothing to compare with.
+    region_t region;
+    std::vector<store_key_t> splits;
+    std::vector<uint64_t> digests;
+
+    bool empty() const { return digests.empty(); }
+    key_range_t range(size_t i) const;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(backfill_digests_t);
+
+struct backfill_digest_read_response_t {
+    backfill_digests_t digests;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(backfill_digest_read_response_t);
+
 struct sindex_list_response_t {
     sindex_list_response_t() { }
     std::vector<std::string> sindexes;
@@ -248,6 +296,10 @@ struct changefeed_stamp_response_t {
     // different timestamps for each `server_t` because they're on different
     // servers and don't synchronize with each other.)
     std::map<uuid_u, uint64_t> stamps;
+    // The change log position (see `server_t::resume`) each `server_t` was at.
+    std::map<uuid_u, uint64_t> log_positions;
+    // Set if the read asked to resume and a `server_t` couldn't.
+    boost::optional<std::string> resume_error;
 };
 
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(changefeed_stamp_response_t);
@@ -291,7 +343,9 @@ struct read_response_t {
                            distribution_read_response_t,
                            sindex_list_response_t,
                            sindex_status_response_t,
-                           dummy_read_response_t> variant_t;
+                           dummy_read_response_t,
+                           batched_point_read_response_t,
+                           backfill_digest_read_response_t> variant_t;
     variant_t response;
     profile::event_log_t event_log;
     size_t n_shards;
@@ -311,6 +365,19 @@ public:
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(point_read_t);
 
+// Reads the rows for several primary keys at once.  Each shard gets the keys in its
+// region, and looks them all up in one descent of the btree.
+class batched_point_read_t {
+public:
+    batched_point_read_t() { }
+    // `_keys` have to be sorted, and not contain duplicates.
+    explicit batched_point_read_t(std::vector<store_key_t> &&_keys)
+        : keys(std::move(_keys)) { }
+
+    std::vector<store_key_t> keys;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(batched_point_read_t);
+
 // `dummy_read_t` can be used to poll for table readiness - it will go through all
 // the clustering and reactor layers, but is a no-op in the protocol layer.
 class dummy_read_t {
@@ -457,6 +524,17 @@ public:
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(distribution_read_t);
 
+// Digests the rows of a store for a backfill; see `backfill_digests_t`.  It's only
+// sent to a store directly, never to a table.
+class backfill_digest_read_t {
+public:
+    backfill_digest_read_t() : region(region_t::universe()) { }
+    explicit backfill_digest_read_t(const region_t &_region) : region(_region) { }
+
+    region_t region;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(backfill_digest_read_t);
+
 struct sindex_list_t {
     sindex_list_t() { }
 };
@@ -474,9 +552,13 @@ RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(sindex_status_t);
 
 struct changefeed_subscribe_t {
     changefeed_subscribe_t() { }
-    explicit changefeed_subscribe_t(ql::changefeed::client_t::addr_t _addr)
-        : addr(_addr), region(region_t::universe()) { }
+    changefeed_subscribe_t(
+        ql::changefeed::client_t::addr_t _addr,
+        boost::optional<ql::changefeed::keyspec_t::range_t> _spec)
+        : addr(_addr), spec(std::move(_spec)), region(region_t::universe()) { }
     ql::changefeed::client_t::addr_t addr;
+    // If this is set, the shards filter and transform the changes they send.
+    boost::optional<ql::changefeed::keyspec_t::range_t> spec;
     region_t region;
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(changefeed_subscribe_t);
@@ -508,10 +590,15 @@ RDB_DECLARE_SERIALIZABLE(changefeed_limit_subscribe_t);
 struct changefeed_stamp_t {
     changefeed_stamp_t() : region(region_t::universe()) { }
     explicit changefeed_stamp_t(
-        ql::changefeed::client_t::addr_t _addr)
+        ql::changefeed::client_t::addr_t _addr,
+        boost::optional<std::map<uuid_u, uint64_t> > _resume_from = boost::none)
         : addr(std::move(_addr)),
+          resume_from(std::move(_resume_from)),
           region(region_t::universe()) { }
     ql::changefeed::client_t::addr_t addr;
+    // If set, each `server_t` first replays its logged changes after the position
+    // given for it here.
+    boost::optional<std::map<uuid_u, uint64_t> > resume_from;
     region_t region;
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(changefeed_stamp_t);
@@ -535,11 +622,18 @@ struct read_t {
                            distribution_read_t,
                            sindex_list_t,
                            sindex_status_t,
-                           dummy_read_t> variant_t;
+                           dummy_read_t,
+                           batched_point_read_t,
+                           backfill_digest_read_t> variant_t;
     variant_t read;
     profile_bool_t profile;
+    query_priority_t priority;
 
     region_t get_region() const THROWS_NOTHING;
+    // Returns the key if the read only reads one key of the primary index, and
+    // NULL otherwise.  Such reads can be routed without sharding them against every
+    // region.
+    const store_key_t *point_key() const THROWS_NOTHING;
     // Returns true if the read has any operation for this region.  Returns
     // false if read_out has not been touched.
     bool shard(const region_t &region,
@@ -550,10 +644,11 @@ struct read_t {
                  signal_t *interruptor) const
         THROWS_ONLY(interrupted_exc_t);
 
-    read_t() { }
+    read_t() : priority(query_priority_t::NORMAL) { }
     template<class T>
     read_t(T &&_read, profile_bool_t _profile)
-        : read(std::forward<T>(_read)), profile(_profile) { }
+        : read(std::forward<T>(_read)), profile(_profile),
+          priority(query_priority_t::NORMAL) { }
 
     // We use snapshotting for queries that acquire-and-hold large portions of the
     // table, so that they don't block writes.
@@ -606,6 +701,11 @@ struct sync_response_t {
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(sync_response_t);
 
+struct truncate_response_t {
+    // truncate always succeeds
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(truncate_response_t);
+
 struct dummy_write_response_t {
     // dummy write always succeeds
 };
@@ -623,7 +723,8 @@ struct write_response_t {
                    sindex_drop_response_t,
                    sindex_rename_response_t,
                    sync_response_t,
-                   dummy_write_response_t> response;
+                   dummy_write_response_t,
+                   truncate_response_t> response;
 
     profile::event_log_t event_log;
     size_t n_shards;
@@ -719,9 +820,12 @@ class sindex_create_t {
 public:
     sindex_create_t() { }
     sindex_create_t(const std::string &_id, const ql::map_wire_func_t &_mapping,
-                    sindex_multi_bool_t _multi, sindex_geo_bool_t _geo)
+                    sindex_multi_bool_t _multi, sindex_geo_bool_t _geo,
+                    const std::vector<std::string> &_covering
+                        = std::vector<std::string>(),
+                    const boost::optional<ql::map_wire_func_t> &_filter = boost::none)
         : id(_id), mapping(_mapping), region(region_t::universe()),
-          multi(_multi), geo(_geo)
+          multi(_multi), geo(_geo), covering(_covering), filter(_filter)
     { }
 
     std::string id;
@@ -729,6 +833,9 @@ public:
     region_t region;
     sindex_multi_bool_t multi;
     sindex_geo_bool_t geo;
+    // See `sindex_disk_info_t::covering` and `sindex_disk_info_t::filter`.
+    std::vector<std::string> covering;
+    boost::optional<ql::map_wire_func_t> filter;
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(sindex_create_t);
 
@@ -781,6 +888,16 @@ public:
 };
 RDB_DECLARE_SERIALIZABLE(dummy_write_t);
 
+// `truncate_t` deletes all of a table's documents.  Each store swaps in an empty
+// primary B-tree and empty secondary indexes and frees the old ones' blocks in the
+// background, so it takes the same time however big the table is.
+class truncate_t {
+public:
+    truncate_t() : region(region_t::universe()) { }
+    region_t region;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(truncate_t);
+
 struct write_t {
     typedef boost::variant<batched_replace_t,
                            batched_insert_t,
@@ -790,14 +907,18 @@ struct write_t {
                            sindex_drop_t,
                            sindex_rename_t,
                            sync_t,
-                           dummy_write_t> variant_t;
+                           dummy_write_t,
+                           truncate_t> variant_t;
     variant_t write;
 
     durability_requirement_t durability_requirement;
     profile_bool_t profile;
     ql::configured_limits_t limits;
+    query_priority_t priority;
 
     region_t get_region() const THROWS_NOTHING;
+    // Like `read_t::point_key()`.
+    const store_key_t *point_key() const THROWS_NOTHING;
     // Returns true if the write had any side effects applicable to the
     // region, and a non-empty write was written to write_out.
     bool shard(const region_t &region,
@@ -808,7 +929,9 @@ struct write_t {
 
     durability_requirement_t durability() const { return durability_requirement; }
 
-    write_t() : durability_requirement(DURABILITY_REQUIREMENT_DEFAULT), limits() {}
+    write_t()
+        : durability_requirement(DURABILITY_REQUIREMENT_DEFAULT), limits(),
+          priority(query_priority_t::NORMAL) { }
     /*  Note that for durability != DURABILITY_REQUIREMENT_HARD, sync might
      *  not have the desired effect (of writing unsaved data to disk).
      *  However there are cases where we use sync internally (such as when
@@ -822,14 +945,14 @@ struct write_t {
             const ql::configured_limits_t &_limits)
         : write(std::forward<T>(t)),
           durability_requirement(durability), profile(_profile),
-          limits(_limits) { }
+          limits(_limits), priority(query_priority_t::NORMAL) { }
     template<class T>
     write_t(T &&t, profile_bool_t _profile,
             const ql::configured_limits_t &_limits)
         : write(std::forward<T>(t)),
           durability_requirement(DURABILITY_REQUIREMENT_DEFAULT),
           profile(_profile),
-          limits(_limits) { }
+          limits(_limits), priority(query_priority_t::NORMAL) { }
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(write_t);
 
@@ -1,6 +1,8 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/pseudo_binary.hpp"
 
+#include <string.h>
+
 #include "errors.hpp"
 
 #include "utils.hpp"
@@ -25,26 +27,31 @@ void binary_to_base64_chunk(const char *in, char *out) {
     out[3] = base64_map[in[2] & 0x3F];
 }
 
-std::string encode_base64(const datum_string_t &data) {
+void append_base64(const datum_string_t &data, const char *line_break,
+                   std::string *out) {
     size_t remaining_bytes = data.size();
 
     if (remaining_bytes == 0) {
-        return std::string();
+        return;
     }
 
-    std::string res;
-    // Scale output size for base64 encoding and account for a CRLF every 76 characters
-    res.reserve(((remaining_bytes * 52) + 39) / 38);
+    // Four characters for every three bytes, and a line break every 76 characters
+    const size_t line_break_size = strlen(line_break);
+    const size_t encoded_size = ((remaining_bytes + 2) / 3) * 4;
+    out->reserve(out->size() + encoded_size + (encoded_size / 76) * line_break_size);
 
     char encoded_chunk[4];
     const char *chunk = data.data();
+    size_t line_size = 0;
 
     for (; remaining_bytes > 3;
          remaining_bytes -= 3) {
         binary_to_base64_chunk(chunk, encoded_chunk);
-        res.append(encoded_chunk, 4);
-        if (res.size() % 78 == 76) {
-            res.append("\r\n");
+        out->append(encoded_chunk, 4);
+        line_size += 4;
+        if (line_size == 76) {
+            out->append(line_break, line_break_size);
+            line_size = 0;
         }
         chunk += 3;
     }
@@ -58,7 +65,12 @@ std::string encode_base64(const datum_string_t &data) {
     for (size_t i = remaining_bytes + 1; i < 4; ++i) {
         encoded_chunk[i] = '=';
     }
-    res.append(encoded_chunk, 4);
+    out->append(encoded_chunk, 4);
+}
+
+std::string encode_base64(const datum_string_t &data) {
+    std::string res;
+    append_base64(data, "\r\n", &res);
     return res;
 }
 
@@ -101,17 +113,33 @@ const char* fill_chunk_values(const char *in, const char *in_end, char *out,
     return in;
 }
 
+// The number of bytes that `decode_base64()` produces for the characters from `in` to
+// `in_end`, if they are valid.
+size_t decoded_base64_size(const char *in, const char *in_end) {
+    size_t chars = 0;
+    for (; in != in_end && *in != '='; ++in) {
+        if (*in != '\r' && *in != '\n' && *in != ' ' && *in != '\t') {
+            ++chars;
+        }
+    }
+    return (chars / 4) * 3 + (chars % 4 > 1 ? chars % 4 - 1 : 0);
+}
+
 datum_string_t decode_base64(const datum_string_t &data) {
-    // This assumes no whitespace in the input, so we may be overallocating a bit
-    std::string res;
-    res.reserve((data.size() / 4) * 3);
+    const char *current_data = data.data();
+    const char *data_end = data.data() + data.size();
+
+    // Decode straight into the result, rather than into a buffer that would then
+    // have to be copied.
+    const size_t res_size = decoded_base64_size(current_data, data_end);
+    char *res_data;
+    datum_string_t res = datum_string_t::make_uninitialized(res_size, &res_data);
+    char *const res_end = res_data + res_size;
 
     bool done = false;
     size_t chars_filled;
     char chunk_values[4];
     char decoded_chunk[3];
-    const char *current_data = data.data();
-    const char *data_end = data.data() + data.size();
 
     while (!done) {
         current_data = fill_chunk_values(current_data, data_end, chunk_values,
@@ -123,7 +151,9 @@ datum_string_t decode_base64(const datum_string_t &data) {
                         "Invalid base64 length: 1 character remaining, "
                         "cannot decode a full byte.");
         } else if (chars_filled != 0) {
-            res.append(decoded_chunk, chars_filled - 1);
+            guarantee(res_data + (chars_filled - 1) <= res_end);
+            memcpy(res_data, decoded_chunk, chars_filled - 1);
+            res_data += chars_filled - 1;
         }
     }
 
@@ -136,7 +166,8 @@ datum_string_t decode_base64(const datum_string_t &data) {
         }
     }
 
-    return datum_string_t(res.size(), res.data());
+    guarantee(res_data == res_end);
+    return res;
 }
 
 // Given a raw data string, encodes it into a `r.binary` pseudotype with base64 encoding
@@ -180,12 +211,13 @@ void write_binary_to_protobuf(Datum *d, const datum_string_t &data) {
     ap->mutable_val()->set_type(Datum::R_STR);
     ap->mutable_val()->set_r_str(binary_string);
 
-    // Add 'data' field with base64-encoded data
-    std::string encoded_data(encode_base64(data));
+    // Add 'data' field with base64-encoded data, encoded right into the message
     ap = d->add_r_object();
     ap->set_key(data_key);
     ap->mutable_val()->set_type(Datum::R_STR);
-    ap->mutable_val()->set_r_str(encoded_data.data(), encoded_data.size());
+    std::string *encoded_data = ap->mutable_val()->mutable_r_str();
+    encoded_data->clear();
+    append_base64(data, "\r\n", encoded_data);
 }
 
 } // namespace pseudo
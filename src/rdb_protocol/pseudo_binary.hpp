@@ -2,6 +2,7 @@
 #ifndef RDB_PROTOCOL_PSEUDO_BINARY_HPP_
 #define RDB_PROTOCOL_PSEUDO_BINARY_HPP_
 
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -14,6 +15,12 @@ namespace pseudo {
 extern const char *const binary_string;
 extern const char *const data_key;
 
+std::string encode_base64(const datum_string_t &data);
+// Appends the base64 encoding of `data` to `out`, with `line_break` after every 76
+// characters (`encode_base64()` uses a CRLF, as MIME requires).
+void append_base64(const datum_string_t &data, const char *line_break,
+                   std::string *out);
+
 // Given a raw data string, encodes it into a `r.binary` pseudotype with base64 encoding
 scoped_cJSON_t encode_base64_ptype(const datum_string_t &data);
 void write_binary_to_protobuf(Datum *d, const datum_string_t &data);
@@ -1,8 +1,9 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/pseudo_time.hpp"
 
-#include <time.h>
 #include <math.h>
+#include <string.h>
+#include <time.h>
 
 #include "errors.hpp"
 #include <boost/date_time.hpp>
@@ -294,6 +295,241 @@ std::string iso8601(const std::string &s, const std::string &default_tz, date_fo
 
 } // namespace sanitize
 
+// A fast path for the usual forms of ISO 8601 strings, `YYYY-MM-DD` optionally
+// followed by `THH[:MM[:SS[.fff]]]` and a timezone, and for formatting times
+// with a timezone.  It works on the characters directly instead of going through
+// boost's streams and zone objects.  It only accepts what boost handles without
+// an error, and computes the same results boost does; anything else returns false
+// and takes the boost path above, which reports the error.
+namespace fast {
+
+// The years boost's calendar supports, minus one on each side so that the
+// timezone can't push a date out of range.
+const int min_year = 1401;
+const int max_year = 9998;
+// The offsets boost's zones support.
+const int min_offset_minutes = -12 * 60;
+const int max_offset_minutes = 14 * 60;
+
+bool digits(const char *p, size_t n, int *out) {
+    int res = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (p[i] < '0' || p[i] > '9') {
+            return false;
+        }
+        res = res * 10 + (p[i] - '0');
+    }
+    *out = res;
+    return true;
+}
+
+// Parses `Z`, `+HH`, `+HHMM` or `+HH:MM` (or with `-`), and writes it as
+// `+HH:MM` to `canonical_out`, like `sanitize::tz`.
+bool tz(const char *s, size_t size, int *offset_minutes_out, char *canonical_out) {
+    int hours = 0, minutes = 0;
+    if (size == 1 && s[0] == 'Z') {
+        memcpy(canonical_out, "+00:00", 6);
+        *offset_minutes_out = 0;
+        return true;
+    }
+    if (size < 3 || (s[0] != '+' && s[0] != '-') || !digits(s + 1, 2, &hours)) {
+        return false;
+    }
+    if (size == 5) {
+        if (!digits(s + 3, 2, &minutes)) {
+            return false;
+        }
+    } else if (size == 6) {
+        if (s[3] != ':' || !digits(s + 4, 2, &minutes)) {
+            return false;
+        }
+    } else if (size != 3) {
+        return false;
+    }
+    const int sign = s[0] == '-' ? -1 : 1;
+    const int offset = sign * (hours * 60 + minutes);
+    if (minutes > 59 || offset < min_offset_minutes || offset > max_offset_minutes
+        || (sign == -1 && offset == 0)) {
+        return false;
+    }
+    canonical_out[0] = s[0];
+    canonical_out[1] = '0' + hours / 10;
+    canonical_out[2] = '0' + hours % 10;
+    canonical_out[3] = ':';
+    canonical_out[4] = '0' + minutes / 10;
+    canonical_out[5] = '0' + minutes % 10;
+    *offset_minutes_out = offset;
+    return true;
+}
+
+bool is_leap_year(int year) {
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+int days_in_month(int year, int month) {
+    static const int days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    return month == 2 && is_leap_year(year) ? 29 : days[month - 1];
+}
+
+// The number of days from 1970-01-01 to the given proleptic Gregorian date, and
+// back.  These count in 400-year eras, which all have the same number of days.
+int64_t days_from_civil(int year, int month, int day) {
+    const int y = year - (month <= 2 ? 1 : 0);
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const int year_of_era = y - era * 400;
+    const int day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int day_of_era =
+        year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return static_cast<int64_t>(era) * 146097 + day_of_era - 719468;
+}
+
+void civil_from_days(int64_t days, int *year_out, int *month_out, int *day_out) {
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const int day_of_era = days - era * 146097;
+    const int year_of_era =
+        (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096)
+        / 365;
+    const int day_of_year =
+        day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    const int mp = (5 * day_of_year + 2) / 153;
+    const int month = mp + (mp < 10 ? 3 : -9);
+    *year_out = year_of_era + era * 400 + (month <= 2 ? 1 : 0);
+    *month_out = month;
+    *day_out = day_of_year - (153 * mp + 2) / 5 + 1;
+}
+
+bool iso8601_to_time(const std::string &str, const std::string &default_tz,
+                     double *epoch_time_out, char *tz_out) {
+    const char *s = str.data();
+    const size_t size = str.size();
+    int year, month, day;
+    if (size < 10 || s[4] != '-' || s[7] != '-'
+        || !digits(s, 4, &year) || !digits(s + 5, 2, &month)
+        || !digits(s + 8, 2, &day)) {
+        return false;
+    }
+    if (year < min_year || year > max_year || month < 1 || month > 12
+        || day < 1 || day > days_in_month(year, month)) {
+        return false;
+    }
+    // Boost carries hours, minutes and seconds that are out of range over into
+    // the next field, so they aren't checked here either.
+    int hours = 0, minutes = 0, seconds = 0, millis = 0;
+    size_t at = 10;
+    bool has_tz = false;
+    if (at < size) {
+        if (s[at] != 'T' || !digits(s + at + 1, 2, &hours)) {
+            return false;
+        }
+        at += 3;
+        if (at < size && s[at] == ':') {
+            if (!digits(s + at + 1, 2, &minutes)) {
+                return false;
+            }
+            at += 3;
+            if (at < size && s[at] == ':') {
+                if (!digits(s + at + 1, 2, &seconds)) {
+                    return false;
+                }
+                at += 3;
+                if (at < size && s[at] == '.') {
+                    ++at;
+                    // Digits after the first three are ignored, not rounded.
+                    size_t n = 0;
+                    for (; at < size && s[at] >= '0' && s[at] <= '9'; ++at, ++n) {
+                        if (n < 3) {
+                            millis = millis * 10 + (s[at] - '0');
+                        }
+                    }
+                    if (n == 0) {
+                        return false;
+                    }
+                    for (; n < 3; ++n) {
+                        millis *= 10;
+                    }
+                }
+            }
+        }
+        has_tz = at < size;
+    }
+    int offset_minutes;
+    if (has_tz) {
+        if (!tz(s + at, size - at, &offset_minutes, tz_out)) {
+            return false;
+        }
+    } else if (default_tz.size() != 6
+               || !tz(default_tz.data(), default_tz.size(), &offset_minutes, tz_out)
+               || memcmp(default_tz.data(), tz_out, 6) != 0) {
+        return false;
+    }
+    const int64_t local_seconds = days_from_civil(year, month, day) * 86400
+        + hours * 3600 + minutes * 60 + seconds;
+    const int64_t micros =
+        (local_seconds - offset_minutes * 60) * 1000000 + millis * 1000;
+    *epoch_time_out = micros / 1000000.0;
+    return true;
+}
+
+void append_digits(int value, int n, std::string *out) {
+    char buf[4];
+    for (int i = n - 1; i >= 0; --i) {
+        buf[i] = '0' + value % 10;
+        value /= 10;
+    }
+    out->append(buf, n);
+}
+
+bool time_to_iso8601(double epoch_time, const datum_string_t &tz_str,
+                     std::string *out) {
+    int offset_minutes;
+    char tz_canonical[6];
+    if (!(epoch_time > -1e12 && epoch_time < 1e12)
+        || !tz(tz_str.data(), tz_str.size(), &offset_minutes, tz_canonical)) {
+        return false;
+    }
+    // The same arithmetic as `add_seconds_to_ptime`.
+    const int64_t sec = epoch_time;
+    const int64_t microsec = (epoch_time * 1000000.0) - (sec * 1000000);
+    const int64_t micros = sec * 1000000 + microsec
+        + static_cast<int64_t>(offset_minutes) * 60 * 1000000;
+    const int64_t micros_per_day = static_cast<int64_t>(86400) * 1000000;
+    int64_t days = micros / micros_per_day;
+    int64_t micros_of_day = micros % micros_per_day;
+    if (micros_of_day < 0) {
+        micros_of_day += micros_per_day;
+        days -= 1;
+    }
+    int year, month, day;
+    civil_from_days(days, &year, &month, &day);
+    if (year < min_year || year > max_year) {
+        return false;
+    }
+    const int seconds_of_day = micros_of_day / 1000000;
+    const int fraction = micros_of_day % 1000000;
+    out->reserve(29);
+    append_digits(year, 4, out);
+    out->push_back('-');
+    append_digits(month, 2, out);
+    out->push_back('-');
+    append_digits(day, 2, out);
+    out->push_back('T');
+    append_digits(seconds_of_day / 3600, 2, out);
+    out->push_back(':');
+    append_digits(seconds_of_day / 60 % 60, 2, out);
+    out->push_back(':');
+    append_digits(seconds_of_day % 60, 2, out);
+    // Like boost's `%F`, which we cut down to milliseconds.
+    if (fraction != 0) {
+        out->push_back('.');
+        append_digits(fraction / 1000, 3, out);
+    }
+    out->append(tz_canonical, 6);
+    return true;
+}
+
+} // namespace fast
+
 bool tz_valid(const std::string &tz, std::string *tz_out = NULL) {
     try {
         std::string s = sanitize::tz(tz);
@@ -313,6 +549,10 @@ std::string sanitize_boost_tz(std::string tz, const rcheckable_t *target) {
     size_t colpos = tz.find(':');
     if (colpos != std::string::npos && (colpos + 1) < tz.size() && tz[colpos+1] == '-') {
         tz = tz.substr(0, colpos + 1) + tz.substr(colpos + 2, std::string::npos);
+        // Boost writes -04:04 as `-04:-4`.
+        if (tz.size() == colpos + 2) {
+            tz.insert(colpos + 1, "0");
+        }
     }
     rcheck_target(target,
                   tz != "UTC+00" && tz != "",
@@ -341,6 +581,11 @@ datum_t boost_to_time(time_t t, const rcheckable_t *target) {
 
 datum_t iso8601_to_time(
     const std::string &s, const std::string &default_tz, const rcheckable_t *target) {
+    double epoch_time;
+    char tz[6];
+    if (fast::iso8601_to_time(s, default_tz, &epoch_time, tz)) {
+        return make_time(epoch_time, std::string(tz, sizeof(tz)));
+    }
     try {
         date_format_t df = UNSET;
         std::string sanitized;
@@ -417,6 +662,14 @@ const std::locale tz_format =
 const std::locale no_tz_format =
     std::locale(std::locale::classic(), new output_timefmt_t("%Y-%m-%dT%H:%M:%S%F"));
 std::string time_to_iso8601(datum_t d) {
+    const datum_t tz = d.get_field(timezone_key, NOTHROW);
+    if (tz.has() && tz.get_type() == datum_t::R_STR) {
+        std::string s;
+        if (fast::time_to_iso8601(d.get_field(epoch_time_key).as_num(), tz.as_str(),
+                                  &s)) {
+            return s;
+        }
+    }
     try {
         time_t t = time_to_boost(d);
         int year = t.date().year();
@@ -427,7 +680,6 @@ std::string time_to_iso8601(datum_t d) {
                                year));
         std::ostringstream ss;
         ss.exceptions(std::ios_base::failbit);
-        const datum_t tz = d.get_field(timezone_key, NOTHROW);
         if (tz.has()) {
             ss.imbue(tz_format);
         } else {
@@ -545,7 +797,16 @@ datum_t time_tz(datum_t time) {
 datum_t time_in_tz(datum_t t, datum_t tz) {
     r_sanity_check(t.is_ptype(time_string));
     datum_object_builder_t t2(t);
-    std::string raw_new_tzs = tz.as_str().to_std();
+    const datum_string_t &raw_tz = tz.as_str();
+    int offset_minutes;
+    char canonical[6];
+    if (fast::tz(raw_tz.data(), raw_tz.size(), &offset_minutes, canonical)
+        && raw_tz.size() == sizeof(canonical)
+        && memcmp(raw_tz.data(), canonical, sizeof(canonical)) == 0) {
+        t2.overwrite(timezone_key, tz);
+        return std::move(t2).to_datum();
+    }
+    std::string raw_new_tzs = raw_tz.to_std();
     std::string new_tzs = sanitize::tz(raw_new_tzs);
     if (raw_new_tzs == new_tzs) {
         t2.overwrite(timezone_key, tz);
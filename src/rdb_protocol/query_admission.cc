@@ -0,0 +1,129 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/query_admission.hpp"
+
+#include <algorithm>
+
+#include "config/args.hpp"
+#include "perfmon/perfmon.hpp"
+
+query_admission_t::limits_t::limits_t()
+    : max_running(MAX_RUNNING_QUERIES_PER_THREAD),
+      max_running_per_client(MAX_RUNNING_QUERIES_PER_CLIENT),
+      max_queued_per_client(MAX_QUEUED_QUERIES_PER_CLIENT) { }
+
+query_admission_t::query_admission_t(const limits_t &_limits,
+                                     rdb_context_t::stats_t *_stats)
+    : limits(_limits),
+      stats(_stats),
+      running(0),
+      virtual_time(0) {
+    guarantee(limits.max_running > 0 && limits.max_running_per_client > 0);
+}
+
+query_admission_t::~query_admission_t() {
+    assert_thread();
+    guarantee(running == 0);
+    guarantee(clients.empty());
+}
+
+query_admission_t::ticket_t::ticket_t(query_admission_t *admission,
+                                      const ip_address_t &client_address,
+                                      query_priority_t priority)
+    : parent(admission), client(NULL), start_tag(0), refused(false) {
+    parent->assert_thread();
+    scoped_ptr_t<client_t> *entry = &parent->clients[client_address];
+    if (!entry->has()) {
+        entry->init(new client_t(client_address));
+    }
+    client = entry->get();
+
+    if (client->queued.size() >= parent->limits.max_queued_per_client) {
+        refused = true;
+        ++parent->stats->queries_refused_total;
+        parent->maybe_forget_client(client);
+        client = NULL;
+        return;
+    }
+
+    const double weight = priority == query_priority_t::LOW
+        ? LOW_PRIORITY_QUERY_ADMISSION_WEIGHT
+        : 1.0;
+    start_tag = std::max(parent->virtual_time, client->finish_tag);
+    client->finish_tag = start_tag + 1.0 / weight;
+
+    // A client's queries are admitted in the order they came in, so one that
+    // already has some waiting can't skip ahead of them.
+    if (client->queued.empty()
+        && parent->running < parent->limits.max_running
+        && client->running < parent->limits.max_running_per_client) {
+        parent->admit(this);
+    } else {
+        client->queued.push_back(this);
+        parent->waiting_clients.insert(client);
+        ++parent->stats->queries_queued;
+    }
+}
+
+query_admission_t::ticket_t::~ticket_t() {
+    parent->assert_thread();
+    if (refused) {
+        return;
+    }
+    if (admitted.is_pulsed()) {
+        parent->release(this);
+    } else {
+        // The query was interrupted while it was waiting.
+        client->queued.remove(this);
+        --parent->stats->queries_queued;
+        if (client->queued.empty()) {
+            parent->waiting_clients.erase(client);
+        }
+        parent->maybe_forget_client(client);
+    }
+}
+
+void query_admission_t::admit(ticket_t *ticket) {
+    ++running;
+    ++ticket->client->running;
+    virtual_time = std::max(virtual_time, ticket->start_tag);
+    ticket->admitted.pulse();
+}
+
+void query_admission_t::release(ticket_t *ticket) {
+    --running;
+    --ticket->client->running;
+
+    while (running < limits.max_running) {
+        // The waiting query with the lowest start tag among the clients that are
+        // below their limit goes next.  There are very few waiting clients unless
+        // the server is overloaded, so it's fine to look at each of them.
+        ticket_t *next = NULL;
+        for (client_t *waiting : waiting_clients) {
+            if (waiting->running < limits.max_running_per_client) {
+                ticket_t *head = waiting->queued.head();
+                if (next == NULL || head->start_tag < next->start_tag) {
+                    next = head;
+                }
+            }
+        }
+        if (next == NULL) {
+            break;
+        }
+        next->client->queued.pop_front();
+        --stats->queries_queued;
+        if (next->client->queued.empty()) {
+            waiting_clients.erase(next->client);
+        }
+        admit(next);
+    }
+
+    maybe_forget_client(ticket->client);
+}
+
+void query_admission_t::maybe_forget_client(client_t *client) {
+    if (client->running == 0 && client->queued.empty()) {
+        // Destroys `client`, so the key has to be copied first.
+        const ip_address_t address = client->address;
+        clients.erase(address);
+    }
+}
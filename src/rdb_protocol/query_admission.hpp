@@ -0,0 +1,109 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_QUERY_ADMISSION_HPP_
+#define RDB_PROTOCOL_QUERY_ADMISSION_HPP_
+
+#include <map>
+#include <set>
+
+#include "arch/address.hpp"
+#include "concurrency/cond_var.hpp"
+#include "containers/intrusive_list.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/context.hpp"
+#include "rdb_protocol/protocol.hpp"
+#include "threading.hpp"
+
+/* Admission control for the queries that the query server starts on one thread.  At
+most `max_running` of them run at a time, and at most `max_running_per_client` of
+those come from the same client, which is the address the query came from (there
+are no users, so that's as close as we get to one).  The others wait in a weighted fair queue: each client has its own line, and the next
+query to run is the one that would have started first if every client with waiting
+queries got an even share of the thread, where a query counts as `1 / weight` of a
+share and low priority queries weigh less.  A client that already has
+`max_queued_per_client` queries waiting gets any more refused, so that a client
+flooding the server is shed instead of delaying everyone else.
+
+`CONTINUE`s, `STOP`s and `NOREPLY_WAIT`s aren't admitted this way, since they
+belong to queries that already got in, and a changefeed's `CONTINUE` can wait for a
+long time without doing any work. */
+class query_admission_t : public home_thread_mixin_t {
+public:
+    struct limits_t {
+        // The query server's limits, from `config/args.hpp`.
+        limits_t();
+        limits_t(int _max_running, int _max_running_per_client,
+                 size_t _max_queued_per_client)
+            : max_running(_max_running),
+              max_running_per_client(_max_running_per_client),
+              max_queued_per_client(_max_queued_per_client) { }
+
+        int max_running;
+        int max_running_per_client;
+        size_t max_queued_per_client;
+    };
+
+    // Counts the waiting and the refused queries in `stats`.
+    query_admission_t(const limits_t &limits, rdb_context_t::stats_t *stats);
+    ~query_admission_t();
+
+    class client_t;
+
+    /* Gets in line for `admission`.  The query may run once `admitted_signal()` is
+    pulsed, unless `is_refused()`, and until the ticket is destroyed. */
+    class ticket_t : public intrusive_list_node_t<ticket_t> {
+    public:
+        ticket_t(query_admission_t *admission,
+                 const ip_address_t &client_address,
+                 query_priority_t priority);
+        ~ticket_t();
+
+        bool is_refused() const { return refused; }
+        signal_t *admitted_signal() { return &admitted; }
+
+    private:
+        friend class query_admission_t;
+
+        query_admission_t *parent;
+        client_t *client;
+        // When the query starts, in the virtual time of the fair queue.
+        double start_tag;
+        bool refused;
+        cond_t admitted;
+
+        DISABLE_COPYING(ticket_t);
+    };
+
+    class client_t {
+    public:
+        explicit client_t(const ip_address_t &_address)
+            : address(_address), running(0), finish_tag(0) { }
+
+        const ip_address_t address;
+        int running;
+        intrusive_list_t<ticket_t> queued;
+        // When the client's last query to get in line finishes, in virtual time.
+        double finish_tag;
+
+    private:
+        DISABLE_COPYING(client_t);
+    };
+
+private:
+    void admit(ticket_t *ticket);
+    void release(ticket_t *ticket);
+    void maybe_forget_client(client_t *client);
+
+    const limits_t limits;
+    rdb_context_t::stats_t *const stats;
+
+    int running;
+    // The start tag of the last query that was admitted.
+    double virtual_time;
+    std::map<ip_address_t, scoped_ptr_t<client_t> > clients;
+    // The clients that have queries waiting.
+    std::set<client_t *> waiting_clients;
+
+    DISABLE_COPYING(query_admission_t);
+};
+
+#endif  // RDB_PROTOCOL_QUERY_ADMISSION_HPP_
@@ -0,0 +1,45 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/query_memory.hpp"
+
+#include <atomic>
+
+#include "config/args.hpp"
+#include "errors.hpp"
+
+namespace ql {
+
+// Queries run on all threads, so this is updated atomically.
+static std::atomic<int64_t> server_query_bytes(0);
+
+query_memory_t::reservation_t::reservation_t(counted_t<query_memory_t> memory)
+    : memory_(std::move(memory)), bytes_(0) {
+    guarantee(memory_.has());
+}
+
+query_memory_t::reservation_t::~reservation_t() {
+    clear();
+}
+
+void query_memory_t::reservation_t::add(size_t bytes) {
+    bytes_ += bytes;
+    memory_->bytes_ += bytes;
+    server_query_bytes.fetch_add(static_cast<int64_t>(bytes));
+}
+
+void query_memory_t::reservation_t::clear() {
+    guarantee(memory_->bytes_ >= bytes_);
+    memory_->bytes_ -= bytes_;
+    server_query_bytes.fetch_sub(static_cast<int64_t>(bytes_));
+    bytes_ = 0;
+}
+
+bool query_memory_t::is_over_budget() const {
+    return bytes_ > static_cast<size_t>(QUERY_MEMORY_BUDGET)
+        || server_bytes() > SERVER_QUERY_MEMORY_BUDGET;
+}
+
+int64_t query_memory_t::server_bytes() {
+    return server_query_bytes.load();
+}
+
+}  // namespace ql
@@ -0,0 +1,56 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_QUERY_MEMORY_HPP_
+#define RDB_PROTOCOL_QUERY_MEMORY_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "containers/counted.hpp"
+
+namespace ql {
+
+/* `query_memory_t` counts the bytes a query is holding in buffers that could be
+written to disk instead, like the rows an unindexed `orderBy` is sorting. Buffers
+check `is_over_budget()` as they grow, and spill what they have once the query is
+over `QUERY_MEMORY_BUDGET` bytes or all of the queries on the server together are
+over `SERVER_QUERY_MEMORY_BUDGET`, so that big intermediate results go to disk
+rather than driving the server into swap. Each `env_t` has one. */
+class query_memory_t : public single_threaded_countable_t<query_memory_t> {
+public:
+    /* A buffer's share of its query's memory. It keeps the `query_memory_t` alive,
+    because buffers can outlive the `env_t` they were filled in. */
+    class reservation_t {
+    public:
+        explicit reservation_t(counted_t<query_memory_t> memory);
+        ~reservation_t();
+
+        void add(size_t bytes);
+        // Called when the buffer is emptied, e.g. because it was spilled.
+        void clear();
+
+        bool is_over_budget() const { return memory_->is_over_budget(); }
+
+    private:
+        counted_t<query_memory_t> memory_;
+        size_t bytes_;
+
+        DISABLE_COPYING(reservation_t);
+    };
+
+    query_memory_t() : bytes_(0) { }
+
+    bool is_over_budget() const;
+
+    size_t bytes() const { return bytes_; }
+    // The bytes charged to all of the queries on the server.
+    static int64_t server_bytes();
+
+private:
+    size_t bytes_;
+
+    DISABLE_COPYING(query_memory_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_QUERY_MEMORY_HPP_
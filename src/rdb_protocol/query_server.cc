@@ -2,6 +2,7 @@
 #include "rdb_protocol/query_server.hpp"
 
 #include "concurrency/cross_thread_watchable.hpp"
+#include "concurrency/interruptor.hpp"
 #include "concurrency/watchable.hpp"
 #include "perfmon/perfmon.hpp"
 #include "rdb_protocol/counted_term.hpp"
@@ -12,8 +13,12 @@
 
 rdb_query_server_t::rdb_query_server_t(const std::set<ip_address_t> &local_addresses,
                                        int port,
+                                       accept_sharding_t accept_sharding,
                                        rdb_context_t *_rdb_ctx) :
-    server(_rdb_ctx, local_addresses, port, this, _rdb_ctx->auth_metadata),
+    result_caches(_rdb_ctx),
+    admissions(query_admission_t::limits_t(), &_rdb_ctx->stats),
+    server(_rdb_ctx, local_addresses, port, accept_sharding, this,
+           _rdb_ctx->auth_metadata),
     rdb_ctx(_rdb_ctx),
     thread_counters(0)
 {
@@ -34,15 +39,29 @@ namespace ql {
              rdb_context_t *ctx,
              signal_t *interruptor,
              stream_cache_t *stream_cache,
+             prepared_queries_t *prepared_queries,
+             result_cache_t *result_cache,
              ip_and_port_t const &peer,
              Response *response_out);
 }
 
+// Only matters for the weight of the query in its client's line, so anything other
+// than "low" (including values that `ql::run` rejects) counts as normal.
+static query_priority_t query_admission_priority(const ql::protob_t<Query> &query) {
+    ql::datum_t priority = static_optarg("priority", query);
+    return priority.has()
+        && priority.get_type() == ql::datum_t::R_STR
+        && priority.as_str() == "low"
+        ? query_priority_t::LOW
+        : query_priority_t::NORMAL;
+}
+
 bool rdb_query_server_t::run_query(const ql::protob_t<Query> &query,
                                    Response *response_out,
                                    client_context_t *client_ctx,
                                    ip_and_port_t const &peer) {
     guarantee(client_ctx->interruptor != NULL);
+    const ticks_t start_time = get_ticks();
     response_out->set_token(query->token());
 
     ql::datum_t noreply = static_optarg("noreply", query);
@@ -52,13 +71,30 @@ bool rdb_query_server_t::run_query(const ql::protob_t<Query> &query,
     try {
         scoped_perfmon_counter_t client_active(&rdb_ctx->stats.clients_active);
         guarantee(rdb_ctx->cluster_interface);
-        // `ql::run` will set the status code
-        ql::run(query,
-                rdb_ctx,
-                client_ctx->interruptor,
-                &client_ctx->stream_cache,
-                peer,
-                response_out);
+        // Only new queries have to be admitted, see `query_admission_t`.
+        scoped_ptr_t<query_admission_t::ticket_t> ticket;
+        if (query->type() == Query::START) {
+            ticket.init(new query_admission_t::ticket_t(
+                admissions.get(), peer.ip(), query_admission_priority(query)));
+        }
+        if (ticket.has() && ticket->is_refused()) {
+            ql::fill_error(response_out, Response::RUNTIME_ERROR,
+                           "Too many queries from this client are waiting to run.  "
+                           "Try again later.");
+        } else {
+            if (ticket.has()) {
+                wait_interruptible(ticket->admitted_signal(), client_ctx->interruptor);
+            }
+            // `ql::run` will set the status code
+            ql::run(query,
+                    rdb_ctx,
+                    client_ctx->interruptor,
+                    &client_ctx->stream_cache,
+                    &client_ctx->prepared_queries,
+                    result_caches.get(),
+                    peer,
+                    response_out);
+        }
     } catch (const ql::exc_t &e) {
         fill_error(response_out, Response::COMPILE_ERROR, e.what(), e.backtrace());
     } catch (const ql::datum_exc_t &e) {
@@ -75,6 +111,7 @@ bool rdb_query_server_t::run_query(const ql::protob_t<Query> &query,
 
     rdb_ctx->stats.queries_per_sec.record();
     ++rdb_ctx->stats.queries_total;
+    rdb_ctx->stats.query_latency.record(get_ticks() - start_time);
     return response_needed;
 }
 
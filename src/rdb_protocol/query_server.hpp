@@ -9,6 +9,8 @@
 #include "protob/protob.hpp"
 #include "concurrency/one_per_thread.hpp"
 #include "rdb_protocol/ql2.pb.h"
+#include "rdb_protocol/query_admission.hpp"
+#include "rdb_protocol/result_cache.hpp"
 #include "rdb_protocol/stream_cache.hpp"
 
 namespace ql { template <class> class protob_t; }
@@ -21,6 +23,7 @@ Query *underlying_protob_value(ql::protob_t<Query> *request);
 class rdb_query_server_t : public query_handler_t {
 public:
     rdb_query_server_t(const std::set<ip_address_t> &local_addresses, int port,
+                       accept_sharding_t accept_sharding,
                        rdb_context_t *_rdb_ctx);
 
     http_app_t *get_http_app();
@@ -35,6 +38,9 @@ public:
                            Response *response_out,
                            const std::string &info);
 public:
+    // Before `server`, so that no query is using them when they're destroyed.
+    one_per_thread_t<ql::result_cache_t> result_caches;
+    one_per_thread_t<query_admission_t> admissions;
     query_server_t server;
     rdb_context_t *rdb_ctx;
     one_per_thread_t<int> thread_counters;
@@ -1,6 +1,8 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved
 #include "rdb_protocol/real_table.hpp"
 
+#include <algorithm>
+
 #include "rdb_protocol/geo/ellipsoid.hpp"
 #include "rdb_protocol/geo/distances.hpp"
 #include "rdb_protocol/context.hpp"
@@ -78,9 +80,41 @@ ql::datum_t real_table_t::read_row(ql::env_t *env,
     read_with_profile(env, read, &res, use_outdated);
     point_read_response_t *p_res = boost::get<point_read_response_t>(&res.response);
     r_sanity_check(p_res);
+    env->charge_rows_read(1);
     return p_res->data;
 }
 
+std::vector<ql::datum_t> real_table_t::read_rows(ql::env_t *env,
+        const std::vector<ql::datum_t> &pvals, bool use_outdated) {
+    std::vector<store_key_t> pval_keys;
+    pval_keys.reserve(pvals.size());
+    for (const ql::datum_t &pval : pvals) {
+        pval_keys.push_back(store_key_t(pval.print_primary()));
+    }
+    std::vector<store_key_t> keys = pval_keys;
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    std::vector<ql::datum_t> rows(pvals.size(), ql::datum_t::null());
+    if (keys.empty()) {
+        return rows;
+    }
+    read_t read(batched_point_read_t(std::move(keys)), env->profile());
+    read_response_t res;
+    read_with_profile(env, read, &res, use_outdated);
+    batched_point_read_response_t *bp_res
+        = boost::get<batched_point_read_response_t>(&res.response);
+    r_sanity_check(bp_res);
+    env->charge_rows_read(bp_res->rows.size());
+    for (size_t i = 0; i < pval_keys.size(); ++i) {
+        auto it = bp_res->rows.find(pval_keys[i]);
+        if (it != bp_res->rows.end()) {
+            rows[i] = it->second;
+        }
+    }
+    return rows;
+}
+
 counted_t<ql::datum_stream_t> real_table_t::read_all(
         ql::env_t *env,
         const std::string &sindex,
@@ -110,11 +144,13 @@ counted_t<ql::datum_stream_t> real_table_t::read_all(
 counted_t<ql::datum_stream_t> real_table_t::read_changes(
     ql::env_t *env,
     const ql::datum_t &squash,
+    bool spill_to_disk,
+    const ql::datum_t &resume_from,
     ql::changefeed::keyspec_t::spec_t &&spec,
     const ql::protob_t<const Backtrace> &bt,
     const std::string &table_name) {
     return changefeed_client->new_stream(
-        env, squash, uuid, bt, table_name, std::move(spec));
+        env, squash, spill_to_disk, resume_from, uuid, bt, table_name, std::move(spec));
 }
 
 counted_t<ql::datum_stream_t> real_table_t::read_intersecting(
@@ -236,12 +272,27 @@ bool real_table_t::write_sync_depending_on_durability(ql::env_t *env,
     return true; // With our current implementation, a sync can never fail.
 }
 
+bool real_table_t::write_truncate(ql::env_t *env,
+        durability_requirement_t durability) {
+    write_t write(truncate_t(), durability, env->profile(), env->limits());
+    write_response_t res;
+    write_with_profile(env, &write, &res);
+    truncate_response_t *response = boost::get<truncate_response_t>(&res.response);
+    r_sanity_check(response);
+    return true;
+}
+
 bool real_table_t::sindex_create(ql::env_t *env, const std::string &id,
         counted_t<const ql::func_t> index_func, sindex_multi_bool_t multi,
-        sindex_geo_bool_t geo) {
+        sindex_geo_bool_t geo, const std::vector<std::string> &covering,
+        counted_t<const ql::func_t> filter) {
     ql::map_wire_func_t wire_func(index_func);
-    write_t write(sindex_create_t(id, wire_func, multi, geo), env->profile(),
-                  env->limits());
+    boost::optional<ql::map_wire_func_t> wire_filter;
+    if (filter.has()) {
+        wire_filter = ql::map_wire_func_t(filter);
+    }
+    write_t write(sindex_create_t(id, wire_func, multi, geo, covering, wire_filter),
+                  env->profile(), env->limits());
     write_response_t res;
     write_with_profile(env, &write, &res);
     sindex_create_response_t *response =
@@ -315,6 +366,13 @@ real_table_t::sindex_status(ql::env_t *env, const std::set<std::string> &sindexe
             ql::datum_t::boolean(pair.second.multi == sindex_multi_bool_t::MULTI);
         status[datum_string_t("geo")] =
             ql::datum_t::boolean(pair.second.geo == sindex_geo_bool_t::GEO);
+        std::vector<ql::datum_t> covering;
+        for (const std::string &field : pair.second.covering) {
+            covering.push_back(ql::datum_t(datum_string_t(field)));
+        }
+        status[datum_string_t("covering")] =
+            ql::datum_t(std::move(covering), ql::configured_limits_t::unlimited);
+        status[datum_string_t("partial")] = ql::datum_t::boolean(pair.second.partial);
         statuses.insert(std::make_pair(
             pair.first,
             ql::datum_t(std::move(status))));
@@ -331,13 +389,23 @@ void real_table_t::read_with_profile(ql::env_t *env, const read_t &read,
     profile::splitter_t splitter(env->trace);
     /* propagate whether or not we're doing profiles */
     r_sanity_check(read.profile == env->profile());
+    /* Reads are built with the normal priority, so only low-priority queries pay
+    for a copy. */
+    read_t prioritized_read;
+    const read_t *to_send = &read;
+    if (read.priority != env->query_priority()) {
+        prioritized_read = read;
+        prioritized_read.priority = env->query_priority();
+        to_send = &prioritized_read;
+    }
     /* Do the actual read. */
     try {
         if (!outdated) {
-            namespace_access.get()->read(read, response, order_token_t::ignore,
+            namespace_access.get()->read(*to_send, response, order_token_t::ignore,
                 env->interruptor);
         } else {
-            namespace_access.get()->read_outdated(read, response, env->interruptor);
+            namespace_access.get()->read_outdated(*to_send, response,
+                                                  env->interruptor);
         }
     } catch (const cannot_perform_query_exc_t &e) {
         rfail_datum(ql::base_exc_t::GENERIC, "Cannot perform read: %s", e.what());
@@ -352,6 +420,7 @@ void real_table_t::write_with_profile(ql::env_t *env, write_t *write,
     profile::splitter_t splitter(env->trace);
     /* propagate whether or not we're doing profiles */
     write->profile = env->profile();
+    write->priority = env->query_priority();
     /* Do the actual write. */
     try {
         namespace_access.get()->write(*write, response, order_token_t::ignore,
@@ -0,0 +1,250 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/result_cache.hpp"
+
+#include <functional>
+
+#include "arch/runtime/coroutines.hpp"
+#include "rdb_protocol/changefeed.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "rdb_protocol/serialize_datum.hpp"
+#include "rdb_protocol/val.hpp"
+
+namespace ql {
+
+const size_t result_cache_t::MAX_ENTRIES;
+const size_t result_cache_t::MAX_TOTAL_SIZE = 32 * MEGABYTE;
+const size_t result_cache_t::MAX_ENTRY_SIZE = MEGABYTE;
+
+namespace {
+
+const char *const RESULT_CACHE_OPTARG = "result_cache";
+
+// Whether the result of `t` only depends on the tables it reads.  Writes, admin
+// terms and terms with their own nondeterminism can't be cached.
+bool term_is_cacheable(const Term &t) {
+    switch (t.type()) {
+    case Term::JAVASCRIPT: // fallthru
+    case Term::UUID: // fallthru
+    case Term::HTTP: // fallthru
+    case Term::UPDATE: // fallthru
+    case Term::DELETE: // fallthru
+    case Term::REPLACE: // fallthru
+    case Term::INSERT: // fallthru
+    case Term::DB_CREATE: // fallthru
+    case Term::DB_DROP: // fallthru
+    case Term::DB_LIST: // fallthru
+    case Term::TABLE_CREATE: // fallthru
+    case Term::TABLE_DROP: // fallthru
+    case Term::TABLE_LIST: // fallthru
+    case Term::CONFIG: // fallthru
+    case Term::STATUS: // fallthru
+    case Term::WAIT: // fallthru
+    case Term::RECONFIGURE: // fallthru
+    case Term::REBALANCE: // fallthru
+    case Term::SYNC: // fallthru
+    case Term::TRUNCATE: // fallthru
+    case Term::INDEX_CREATE: // fallthru
+    case Term::INDEX_DROP: // fallthru
+    case Term::INDEX_LIST: // fallthru
+    case Term::INDEX_STATUS: // fallthru
+    case Term::INDEX_WAIT: // fallthru
+    case Term::INDEX_RENAME: // fallthru
+    case Term::FOR_EACH: // fallthru
+    case Term::INFO: // fallthru
+    case Term::SAMPLE: // fallthru
+    case Term::NOW: // fallthru
+    case Term::RANDOM: // fallthru
+    case Term::CHANGES:
+        return false;
+    default:
+        break;
+    }
+    for (int i = 0; i < t.args_size(); ++i) {
+        if (!term_is_cacheable(t.args(i))) {
+            return false;
+        }
+    }
+    for (int i = 0; i < t.optargs_size(); ++i) {
+        if (!term_is_cacheable(t.optargs(i).val())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+result_cache_t::result_cache_t(rdb_context_t *_ctx)
+    : ctx(_ctx), entries(MAX_ENTRIES), total_size(0) { }
+
+result_cache_t::~result_cache_t() {
+    assert_thread();
+}
+
+bool result_cache_t::get_key(const Query &q, std::string *key_out) {
+    bool requested = false;
+    Query normalized;
+    for (int i = 0; i < q.global_optargs_size(); ++i) {
+        const Query::AssocPair &ap = q.global_optargs(i);
+        if (ap.key() == RESULT_CACHE_OPTARG) {
+            requested = ap.val().type() == Term::DATUM
+                && ap.val().datum().type() == Datum::R_BOOL
+                && ap.val().datum().r_bool();
+        } else if (ap.key() != "noreply" && ap.key() != "profile") {
+            // Everything else, like `db` and `use_outdated`, can change the result.
+            *normalized.add_global_optargs() = ap;
+        }
+    }
+    if (!requested || !term_is_cacheable(q.query())) {
+        return false;
+    }
+    *normalized.mutable_query() = q.query();
+    normalized.SerializeToString(key_out);
+    return true;
+}
+
+datum_t result_cache_t::get(const std::string &key) {
+    assert_thread();
+    auto it = entries.find(key);
+    return it != entries.end() ? it->second.result : datum_t();
+}
+
+result_cache_t::recording_t::recording_t(result_cache_t *_parent)
+    : parent(_parent), cacheable(true) { }
+
+void result_cache_t::recording_t::note_table(env_t *env,
+                                             const counted_t<table_t> &table) {
+    parent->assert_thread();
+    if (!cacheable) {
+        return;
+    }
+    const std::string table_id = table->get_id().print();
+    auto it = parent->watches.find(table_id);
+    if (it != parent->watches.end()) {
+        if (it->second->ready) {
+            versions[table_id] = it->second->version;
+        } else {
+            cacheable = false;
+        }
+        return;
+    }
+
+    watch_t *watch = new watch_t;
+    parent->watches[table_id].init(watch);
+    counted_t<datum_stream_t> changes;
+    std::exception_ptr interrupted;
+    try {
+        changes = table->tbl->read_changes(
+            env, datum_t::boolean(false), false, datum_t(),
+            changefeed::keyspec_t::spec_t(table_slice_t(table).get_change_spec()),
+            table->backtrace(), table->name);
+    } catch (const base_exc_t &) {
+        // Some tables, like system tables, might not support changefeeds.
+    } catch (const interrupted_exc_t &) {
+        interrupted = std::current_exception();
+    }
+    if (!changes.has()) {
+        parent->watches.erase(table_id);
+        cacheable = false;
+        if (interrupted) {
+            std::rethrow_exception(interrupted);
+        }
+        return;
+    }
+    watch->ready = true;
+    versions[table_id] = watch->version;
+    coro_t::spawn_sometime(std::bind(&result_cache_t::watch_changes, parent,
+                                     table_id, changes,
+                                     auto_drainer_t::lock_t(&parent->drainer)));
+}
+
+void result_cache_t::insert(const std::string &key, const recording_t &recording,
+                            const datum_t &result) {
+    assert_thread();
+    // A query that reads no tables isn't worth caching.
+    if (!recording.cacheable || recording.versions.empty()) {
+        return;
+    }
+    for (const auto &pair : recording.versions) {
+        auto it = watches.find(pair.first);
+        if (it == watches.end() || it->second->version != pair.second) {
+            return;
+        }
+    }
+    const size_t size = key.size()
+        + datum_serialized_size(result, check_datum_serialization_errors_t::NO);
+    if (size > MAX_ENTRY_SIZE) {
+        return;
+    }
+
+    remove(key);
+    while (!entries.empty()
+           && (entries.size() >= MAX_ENTRIES || total_size + size > MAX_TOTAL_SIZE)) {
+        const std::string oldest = entries.rbegin()->first;
+        remove(oldest);
+    }
+
+    entry_t *entry = &entries[key];
+    entry->result = result;
+    entry->size = size;
+    for (const auto &pair : recording.versions) {
+        entry->tables.push_back(pair.first);
+        watches[pair.first]->keys.insert(key);
+    }
+    total_size += size;
+}
+
+void result_cache_t::watch_changes(std::string table_id,
+                                   counted_t<datum_stream_t> changes,
+                                   auto_drainer_t::lock_t keepalive) {
+    try {
+        env_t env(ctx, keepalive.get_drain_signal(),
+                  std::map<std::string, wire_func_t>(), nullptr);
+        while (!changes->is_exhausted()) {
+            std::vector<datum_t> batch = changes->next_batch(
+                &env, batchspec_t::default_for(batch_type_t::NORMAL));
+            if (!batch.empty()) {
+                invalidate(table_id);
+            }
+        }
+    } catch (const interrupted_exc_t &) {
+        // The cache is going away.
+        return;
+    } catch (const base_exc_t &) {
+        // The changefeed failed, for example because the table was dropped.
+    }
+    // The next query that reads the table watches it again.
+    invalidate(table_id);
+    watches.erase(table_id);
+}
+
+void result_cache_t::invalidate(const std::string &table_id) {
+    auto it = watches.find(table_id);
+    if (it == watches.end()) {
+        return;
+    }
+    ++it->second->version;
+    std::set<std::string> keys;
+    keys.swap(it->second->keys);
+    for (const std::string &key : keys) {
+        remove(key);
+    }
+}
+
+void result_cache_t::remove(const std::string &key) {
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        return;
+    }
+    for (const std::string &table_id : it->second.tables) {
+        auto watch = watches.find(table_id);
+        if (watch != watches.end()) {
+            watch->second->keys.erase(key);
+        }
+    }
+    total_size -= it->second.size;
+    entries.erase(key);
+}
+
+}  // namespace ql
@@ -0,0 +1,112 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_RESULT_CACHE_HPP_
+#define RDB_PROTOCOL_RESULT_CACHE_HPP_
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "concurrency/auto_drainer.hpp"
+#include "containers/counted.hpp"
+#include "containers/lru_cache.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "threading.hpp"
+
+class Query;
+class rdb_context_t;
+
+namespace ql {
+
+class datum_stream_t;
+class env_t;
+class table_t;
+
+/* The results of read queries that were run with the `result_cache` global optarg,
+so that running the same query again on tables that haven't changed since then
+doesn't read them again.  Each thread of the query server has one.
+
+A query's result is only kept if it's an atom, and the query only reads tables
+and has no other source of nondeterminism.  Each table it read is watched with a
+changefeed, and the results that read it are dropped whenever it changes.  Those
+changes are seen a little after the writes are acknowledged, so a query run right
+after a write can still get the result from before it. */
+class result_cache_t : public home_thread_mixin_t {
+public:
+    explicit result_cache_t(rdb_context_t *ctx);
+    ~result_cache_t();
+
+    // Returns false if `q` didn't ask for the cache or can't use it, and otherwise
+    // sets `*key_out` to what its result is cached under.
+    static bool get_key(const Query &q, std::string *key_out);
+
+    // Returns an empty `datum_t` if there's no result for `key`.
+    datum_t get(const std::string &key);
+
+    // Notes the tables a query reads, and their versions, so that `insert` can
+    // tell if its result is still up to date.
+    class recording_t {
+    public:
+        explicit recording_t(result_cache_t *parent);
+        // Called when the query gets `table`.  Starts watching it if it isn't
+        // watched yet; if that fails, the query's result isn't cached.
+        void note_table(env_t *env, const counted_t<table_t> &table);
+    private:
+        friend class result_cache_t;
+        result_cache_t *const parent;
+        bool cacheable;
+        std::map<std::string, uint64_t> versions;
+
+        DISABLE_COPYING(recording_t);
+    };
+
+    // Caches `result` under `key`, unless one of the tables recorded in `recording`
+    // changed while the query ran.
+    void insert(const std::string &key, const recording_t &recording,
+                const datum_t &result);
+
+private:
+    static const size_t MAX_ENTRIES = 1000;
+    static const size_t MAX_TOTAL_SIZE;
+    static const size_t MAX_ENTRY_SIZE;
+
+    struct watch_t {
+        watch_t() : ready(false), version(0) { }
+        // Set once the changefeed is running.  Until then the table's results
+        // can't be cached, since a change could be missed.
+        bool ready;
+        // Incremented whenever the table changes.
+        uint64_t version;
+        // The keys of the results that read the table.
+        std::set<std::string> keys;
+    };
+
+    struct entry_t {
+        datum_t result;
+        // The ids of the tables the query read.
+        std::vector<std::string> tables;
+        size_t size;
+    };
+
+    void watch_changes(std::string table_id, counted_t<datum_stream_t> changes,
+                       auto_drainer_t::lock_t keepalive);
+    void invalidate(const std::string &table_id);
+    void remove(const std::string &key);
+
+    rdb_context_t *const ctx;
+
+    lru_cache_t<std::string, entry_t> entries;
+    size_t total_size;
+
+    // Keyed by table id.
+    std::map<std::string, scoped_ptr_t<watch_t> > watches;
+
+    auto_drainer_t drainer;
+
+    DISABLE_COPYING(result_cache_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_RESULT_CACHE_HPP_
@@ -14,6 +14,7 @@
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/error.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
 
 namespace ql {
 
@@ -30,7 +31,8 @@ enum class datum_serialized_type_t {
     R_BINARY = 9,
     BUF_R_ARRAY = 10,
     BUF_R_OBJECT = 11,
-    UNINITIALIZED = 12
+    UNINITIALIZED = 12,
+    R_TIME = 13
 };
 
 // Objects and arrays use different word sizes for storing offsets,
@@ -53,7 +55,7 @@ struct size_tree_node_t {
 
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(datum_serialized_type_t, int8_t,
                                       datum_serialized_type_t::R_ARRAY,
-                                      datum_serialized_type_t::UNINITIALIZED);
+                                      datum_serialized_type_t::R_TIME);
 
 serialization_result_t datum_serialize(write_message_t *wm,
                                        datum_serialized_type_t type) {
@@ -75,6 +77,69 @@ serialization_result_t datum_serialize(
         const datum_t &datum,
         check_datum_serialization_errors_t check_errors,
         const size_tree_node_t &precomputed_size);
+bool serialized_has_too_big_array(const shared_buf_ref_t<char> &buf, bool is_object);
+
+// Arrays with more elements than this get `ARRAY_TOO_BIG`, so they're never written
+// to disk.
+const size_t MAX_STORED_ARRAY_SIZE = 100000;
+
+/* Times are common in rows, and written as objects they'd spend most of their bytes
+on the keys.  So objects that are exactly `{$reql_type$: "TIME", epoch_time: <number>,
+timezone: <string>}` are written as `R_TIME`, an epoch time and a timezone (about 16
+bytes instead of about 60), and deserialize to the same object. */
+bool is_serializable_as_time(const datum_t &datum) {
+    if (datum.obj_size() != 3) {
+        return false;
+    }
+    const datum_t type = datum.get_field(datum_t::reql_type_string, NOTHROW);
+    if (!type.has() || type.get_type() != datum_t::R_STR
+        || !(type.as_str() == pseudo::time_string)) {
+        return false;
+    }
+    const datum_t epoch_time = datum.get_field(pseudo::epoch_time_key, NOTHROW);
+    const datum_t timezone = datum.get_field(pseudo::timezone_key, NOTHROW);
+    return epoch_time.has() && epoch_time.get_type() == datum_t::R_NUM
+        && timezone.has() && timezone.get_type() == datum_t::R_STR;
+}
+
+size_t time_serialized_size(const datum_t &time) {
+    return serialize_universal_size_t<double>::value
+        + datum_serialized_size(time.get_field(pseudo::timezone_key).as_str());
+}
+
+void time_serialize(write_message_t *wm, const datum_t &time) {
+    const double epoch_time = time.get_field(pseudo::epoch_time_key).as_num();
+    serialize_universal(wm, epoch_time);
+    datum_serialize(wm, time.get_field(pseudo::timezone_key).as_str());
+}
+
+MUST_USE archive_result_t time_deserialize(read_stream_t *s, datum_t *time_out) {
+    double epoch_time;
+    archive_result_t res = deserialize_universal(s, &epoch_time);
+    if (bad(res)) {
+        return res;
+    }
+    datum_string_t timezone;
+    res = datum_deserialize(s, &timezone);
+    if (bad(res)) {
+        return res;
+    }
+    // The keys are already in sorted order.
+    static const datum_string_t time_value(pseudo::time_string);
+    static const datum_string_t epoch_time_key(pseudo::epoch_time_key);
+    static const datum_string_t timezone_key(pseudo::timezone_key);
+    std::vector<std::pair<datum_string_t, datum_t> > pairs;
+    pairs.reserve(3);
+    try {
+        pairs.push_back(std::make_pair(datum_t::reql_type_string, datum_t(time_value)));
+        pairs.push_back(std::make_pair(epoch_time_key, datum_t(epoch_time)));
+        pairs.push_back(std::make_pair(timezone_key, datum_t(std::move(timezone))));
+        *time_out = datum_t(std::move(pairs));
+    } catch (const base_exc_t &) {
+        return archive_result_t::RANGE_ERROR;
+    }
+    return archive_result_t::SUCCESS;
+}
 
 // Some of the following looks like it duplicates code of other deserialization
 // functions.  It does. Keeping this separate means that we don't have to worry
@@ -230,9 +295,7 @@ size_t datum_array_serialized_size(const datum_t &datum,
 
     // Can we use an existing serialization?
     const shared_buf_ref_t<char> *existing_buf_ref = datum.get_buf_ref();
-    if (existing_buf_ref != NULL
-        && check_errors == check_datum_serialization_errors_t::NO) {
-
+    if (existing_buf_ref != NULL) {
         // We don't initialize element_sizes_out, but that's ok. We don't need it
         // if there already is a serialization.
         sz += read_inner_serialized_size_from_buf(*existing_buf_ref);
@@ -272,12 +335,15 @@ serialization_result_t datum_array_serialize(
 
     // Can we use an existing serialization?
     const shared_buf_ref_t<char> *existing_buf_ref = datum.get_buf_ref();
-    if (existing_buf_ref != NULL
-        && check_errors == check_datum_serialization_errors_t::NO) {
-
+    if (existing_buf_ref != NULL) {
         // Subtract 1 for the type byte, which we don't have to rewrite
         wm->append(existing_buf_ref->get(), precomputed_sizes.size - 1);
-        return serialization_result_t::SUCCESS;
+        // The serialization is copied either way; checking for errors only has to
+        // look at the sizes of the arrays in it.
+        return check_errors == check_datum_serialization_errors_t::YES
+            && serialized_has_too_big_array(*existing_buf_ref, false)
+            ? serialization_result_t::ARRAY_TOO_BIG
+            : serialization_result_t::SUCCESS;
     }
 
     // The inner serialized size
@@ -331,9 +397,7 @@ size_t datum_object_serialized_size(const datum_t &datum,
 
     // Can we use an existing serialization?
     const shared_buf_ref_t<char> *existing_buf_ref = datum.get_buf_ref();
-    if (existing_buf_ref != NULL
-        && check_errors == check_datum_serialization_errors_t::NO) {
-
+    if (existing_buf_ref != NULL) {
         // We don't initialize element_sizes_out, but that's ok. We don't need it
         // if there already is a serialization.
         sz += read_inner_serialized_size_from_buf(*existing_buf_ref);
@@ -376,12 +440,15 @@ serialization_result_t datum_object_serialize(
 
     // Can we use an existing serialization?
     const shared_buf_ref_t<char> *existing_buf_ref = datum.get_buf_ref();
-    if (existing_buf_ref != NULL
-        && check_errors == check_datum_serialization_errors_t::NO) {
-
+    if (existing_buf_ref != NULL) {
         // Subtract 1 for the type byte, which we don't have to rewrite
         wm->append(existing_buf_ref->get(), precomputed_sizes.size - 1);
-        return serialization_result_t::SUCCESS;
+        // The serialization is copied either way; checking for errors only has to
+        // look at the sizes of the arrays in it.
+        return check_errors == check_datum_serialization_errors_t::YES
+            && serialized_has_too_big_array(*existing_buf_ref, true)
+            ? serialization_result_t::ARRAY_TOO_BIG
+            : serialization_result_t::SUCCESS;
     }
 
     // The inner serialized size
@@ -468,7 +535,11 @@ size_t datum_serialized_size(const datum_t &datum,
         }
     } break;
     case datum_t::R_OBJECT: {
-        sz += datum_object_serialized_size(datum, check_errors, child_sizes_out);
+        if (is_serializable_as_time(datum)) {
+            sz += time_serialized_size(datum);
+        } else {
+            sz += datum_object_serialized_size(datum, check_errors, child_sizes_out);
+        }
     } break;
     case datum_t::R_STR: {
         sz += datum_serialized_size(datum.as_str());
@@ -493,7 +564,7 @@ serialization_result_t datum_serialize(
     switch (datum.get_type()) {
     case datum_t::R_ARRAY: {
         res = res | datum_serialize(wm, datum_serialized_type_t::BUF_R_ARRAY);
-        if (datum.arr_size() > 100000)
+        if (datum.arr_size() > MAX_STORED_ARRAY_SIZE)
             res = res | serialization_result_t::ARRAY_TOO_BIG;
         res = res | datum_array_serialize(wm, datum, check_errors, precomputed_size);
     } break;
@@ -531,8 +602,14 @@ serialization_result_t datum_serialize(
         }
     } break;
     case datum_t::R_OBJECT: {
-        res = res | datum_serialize(wm, datum_serialized_type_t::BUF_R_OBJECT);
-        res = res | datum_object_serialize(wm, datum, check_errors, precomputed_size);
+        if (is_serializable_as_time(datum)) {
+            res = res | datum_serialize(wm, datum_serialized_type_t::R_TIME);
+            time_serialize(wm, datum);
+        } else {
+            res = res | datum_serialize(wm, datum_serialized_type_t::BUF_R_OBJECT);
+            res = res | datum_object_serialize(wm, datum, check_errors,
+                                               precomputed_size);
+        }
     } break;
     case datum_t::R_STR: {
         res = res | datum_serialize(wm, datum_serialized_type_t::R_STR);
@@ -558,9 +635,28 @@ serialization_result_t datum_serialize(
     size_tree_node_t size;
     size.size = datum_serialized_size(datum, check_errors, &size.child_sizes);
 
+    wm->reserve(size.size);
     return datum_serialize(wm, datum, check_errors, size);
 }
 
+void datum_serialize_onto_string(const datum_t &datum, std::string *out) {
+    datum_serialize_onto_string(datum, check_datum_serialization_errors_t::NO, out);
+}
+
+serialization_result_t datum_serialize_onto_string(
+        const datum_t &datum,
+        check_datum_serialization_errors_t check_errors,
+        std::string *out) {
+    write_message_t wm;
+    serialization_result_t res = datum_serialize(&wm, datum, check_errors);
+    out->reserve(out->size() + wm.size());
+    intrusive_list_t<write_buffer_t> *buffers = wm.unsafe_expose_buffers();
+    for (write_buffer_t *p = buffers->head(); p != NULL; p = buffers->next(p)) {
+        out->append(p->data, p->size);
+    }
+    return res;
+}
+
 archive_result_t datum_deserialize(read_stream_t *s, datum_t *datum) {
     // Datums on disk should always be read no matter how stupid big
     // they are; there's no way to fix the problem otherwise.
@@ -711,6 +807,12 @@ archive_result_t datum_deserialize(read_stream_t *s, datum_t *datum) {
             return archive_result_t::RANGE_ERROR;
         }
     } break;
+    case datum_serialized_type_t::R_TIME: {
+        res = time_deserialize(s, datum);
+        if (bad(res)) {
+            return res;
+        }
+    } break;
     case datum_serialized_type_t::UNINITIALIZED: {
         *datum = datum_t();
     } break;
@@ -758,6 +860,7 @@ datum_t datum_deserialize_from_buf(const shared_buf_ref_t<char> &buf, size_t at_
     case datum_serialized_type_t::R_OBJECT: // fallthru
     case datum_serialized_type_t::INT_NEGATIVE: // fallthru
     case datum_serialized_type_t::INT_POSITIVE: // fallthru
+    case datum_serialized_type_t::R_TIME: // fallthru
     case datum_serialized_type_t::UNINITIALIZED: {
         buffer_read_stream_t data_read_stream(buf.get() + at_offset,
                                               buf.get_safety_boundary() - at_offset);
@@ -805,22 +908,32 @@ size_t datum_get_array_size(const shared_buf_ref_t<char> &array) {
      varint num_elements
      uint*_t offsets[num_elements - 1] // counted from `data`, first element omitted
      T data[num_elements] */
-size_t datum_get_element_offset(const shared_buf_ref_t<char> &array, size_t index) {
+struct datum_array_layout_t {
+    size_t num_elements;
+    datum_offset_size_t offset_size;
+    size_t serialized_offset_size;
+    // Where the offset table starts
+    size_t offsets_offset;
+    // Where the first element starts
+    size_t data_offset;
+};
+
+datum_array_layout_t datum_get_array_layout(const shared_buf_ref_t<char> &array) {
+    datum_array_layout_t layout;
     buffer_read_stream_t sz_read_stream(array.get(), array.get_safety_boundary());
     uint64_t ser_size = 0;
     guarantee_deserialization(deserialize_varint_uint64(&sz_read_stream, &ser_size),
                               "datum decode array");
-    const datum_offset_size_t offset_size = get_offset_size_from_inner_size(ser_size);
-    size_t serialized_offset_size;
-    switch (offset_size) {
+    layout.offset_size = get_offset_size_from_inner_size(ser_size);
+    switch (layout.offset_size) {
     case datum_offset_size_t::U8BIT:
-        serialized_offset_size = serialize_universal_size_t<uint8_t>::value; break;
+        layout.serialized_offset_size = serialize_universal_size_t<uint8_t>::value; break;
     case datum_offset_size_t::U16BIT:
-        serialized_offset_size = serialize_universal_size_t<uint16_t>::value; break;
+        layout.serialized_offset_size = serialize_universal_size_t<uint16_t>::value; break;
     case datum_offset_size_t::U32BIT:
-        serialized_offset_size = serialize_universal_size_t<uint32_t>::value; break;
+        layout.serialized_offset_size = serialize_universal_size_t<uint32_t>::value; break;
     case datum_offset_size_t::U64BIT:
-        serialized_offset_size = serialize_universal_size_t<uint64_t>::value; break;
+        layout.serialized_offset_size = serialize_universal_size_t<uint64_t>::value; break;
     default:
         unreachable();
     }
@@ -829,21 +942,26 @@ size_t datum_get_element_offset(const shared_buf_ref_t<char> &array, size_t inde
     guarantee_deserialization(deserialize_varint_uint64(&sz_read_stream, &num_elements),
                               "datum decode array");
     guarantee(num_elements <= std::numeric_limits<size_t>::max());
-    const size_t sz = static_cast<size_t>(num_elements);
-
-    guarantee(index < sz);
+    layout.num_elements = static_cast<size_t>(num_elements);
+
+    layout.offsets_offset = static_cast<size_t>(sz_read_stream.tell());
+    layout.data_offset = layout.num_elements == 0
+        ? layout.offsets_offset
+        : layout.offsets_offset
+          + (layout.num_elements - 1) * layout.serialized_offset_size;
+    return layout;
+}
 
-    rassert(sz > 0);
-    const size_t data_offset =
-        static_cast<size_t>(sz_read_stream.tell())
-        + (num_elements - 1) * serialized_offset_size;
+size_t datum_get_element_offset(const shared_buf_ref_t<char> &array,
+                                const datum_array_layout_t &layout,
+                                size_t index) {
+    guarantee(index < layout.num_elements);
 
     if (index == 0) {
-        return data_offset;
+        return layout.data_offset;
     } else {
         const size_t element_offset_offset =
-            static_cast<size_t>(sz_read_stream.tell())
-            + (index - 1) * serialized_offset_size;
+            layout.offsets_offset + (index - 1) * layout.serialized_offset_size;
 
         array.guarantee_in_boundary(element_offset_offset);
         buffer_read_stream_t read_stream(
@@ -851,7 +969,7 @@ size_t datum_get_element_offset(const shared_buf_ref_t<char> &array, size_t inde
             array.get_safety_boundary() - element_offset_offset);
 
         uint64_t element_offset;
-        switch (offset_size) {
+        switch (layout.offset_size) {
         case datum_offset_size_t::U8BIT: {
             uint8_t off;
             guarantee_deserialization(deserialize_universal(&read_stream, &off),
@@ -876,12 +994,79 @@ size_t datum_get_element_offset(const shared_buf_ref_t<char> &array, size_t inde
                                       "datum decode array offset");
             element_offset = off;
         } break;
+        default:
+            unreachable();
         }
         guarantee(element_offset <= std::numeric_limits<size_t>::max(),
                   "Datum too large for this architecture.");
 
-        return data_offset + static_cast<size_t>(element_offset);
+        return layout.data_offset + static_cast<size_t>(element_offset);
+    }
+}
+
+size_t datum_get_element_offset(const shared_buf_ref_t<char> &array, size_t index) {
+    return datum_get_element_offset(array, datum_get_array_layout(array), index);
+}
+
+bool datum_find_field_offset(const shared_buf_ref_t<char> &object,
+                             const datum_string_t &key,
+                             size_t *value_offset_out) {
+    const datum_array_layout_t layout = datum_get_array_layout(object);
+    // The pairs are sorted by key, so we can use binary search. We compare against
+    // the serialized keys in place, and never deserialize any of the values.
+    size_t range_beg = 0;
+    size_t range_end = layout.num_elements;
+    while (range_beg < range_end) {
+        const size_t center = range_beg + ((range_end - range_beg) / 2);
+        const size_t key_offset = datum_get_element_offset(object, layout, center);
+        // This shares the buffer, so it doesn't copy the key.
+        const datum_string_t center_key(object.make_child(key_offset));
+        const int cmp = key.compare(center_key);
+        if (cmp == 0) {
+            *value_offset_out = key_offset + datum_serialized_size(center_key);
+            return true;
+        } else if (cmp < 0) {
+            range_end = center;
+        } else {
+            range_beg = center + 1;
+        }
+    }
+    return false;
+}
+
+// Whether the serialized array or object in `buf` is, or has anywhere inside it, an
+// array with more than `MAX_STORED_ARRAY_SIZE` elements.  This only reads offset
+// tables and type bytes, without deserializing any values.
+bool serialized_has_too_big_array(const shared_buf_ref_t<char> &buf, bool is_object) {
+    const datum_array_layout_t layout = datum_get_array_layout(buf);
+    if (!is_object && layout.num_elements > MAX_STORED_ARRAY_SIZE) {
+        return true;
+    }
+    for (size_t i = 0; i < layout.num_elements; ++i) {
+        size_t offset = datum_get_element_offset(buf, layout, i);
+        if (is_object) {
+            // Skip the key.
+            offset += datum_serialized_size(datum_string_t(buf.make_child(offset)));
+        }
+        buf.guarantee_in_boundary(offset);
+        buffer_read_stream_t read_stream(buf.get() + offset,
+                                         buf.get_safety_boundary() - offset);
+        datum_serialized_type_t type = datum_serialized_type_t::R_NULL;
+        guarantee_deserialization(datum_deserialize(&read_stream, &type),
+                                  "datum type from buf");
+        // The legacy `R_ARRAY` and `R_OBJECT` are never written inside a
+        // `BUF_R_ARRAY` or `BUF_R_OBJECT`, so we only have to look into these.
+        if (type == datum_serialized_type_t::BUF_R_ARRAY
+            || type == datum_serialized_type_t::BUF_R_OBJECT) {
+            const size_t data_offset = offset + static_cast<size_t>(read_stream.tell());
+            if (serialized_has_too_big_array(
+                    buf.make_child(data_offset),
+                    type == datum_serialized_type_t::BUF_R_OBJECT)) {
+                return true;
+            }
+        }
     }
+    return false;
 }
 
 size_t datum_serialized_size(const datum_string_t &s) {
@@ -1,6 +1,7 @@
 #ifndef RDB_PROTOCOL_SERIALIZE_DATUM_HPP_
 #define RDB_PROTOCOL_SERIALIZE_DATUM_HPP_
 
+#include <string>
 #include <utility>
 
 #include "containers/archive/archive.hpp"
@@ -55,6 +56,15 @@ serialization_result_t datum_serialize(write_message_t *wm, const datum_t &datum
                                        check_datum_serialization_errors_t check_errors);
 archive_result_t datum_deserialize(read_stream_t *s, datum_t *datum);
 
+// Appends the serialization of `datum` to `out`.  Used to send datums to clients
+// in their serialized form.
+void datum_serialize_onto_string(const datum_t &datum, std::string *out);
+// The same, but with error checking, like for writes to disk.
+serialization_result_t datum_serialize_onto_string(
+        const datum_t &datum,
+        check_datum_serialization_errors_t check_errors,
+        std::string *out);
+
 datum_t datum_deserialize_from_buf(const shared_buf_ref_t<char> &buf, size_t at_offset);
 std::pair<datum_string_t, datum_t> datum_deserialize_pair_from_buf(
         const shared_buf_ref_t<char> &buf, size_t at_offset);
@@ -64,6 +74,13 @@ size_t datum_get_element_offset(const shared_buf_ref_t<char> &array, size_t inde
 // Reads the number of elements in the array stored in the buffer
 size_t datum_get_array_size(const shared_buf_ref_t<char> &array);
 
+// Looks up `key` in the object stored in the buffer, without deserializing any of
+// its other keys or values.  On success, `value_offset_out` is set to the offset of
+// the value in the buffer.
+MUST_USE bool datum_find_field_offset(const shared_buf_ref_t<char> &object,
+                                      const datum_string_t &key,
+                                      size_t *value_offset_out);
+
 size_t datum_serialized_size(const datum_string_t &s);
 serialization_result_t datum_serialize(write_message_t *wm, const datum_string_t &s);
 
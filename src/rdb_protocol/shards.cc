@@ -1,15 +1,21 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/shards.hpp"
 
+#include <algorithm>
+#include <iterator>
 #include <utility>
 
 #include "errors.hpp"
 #include <boost/variant.hpp>
 
 #include "debug.hpp"
+#include "rdb_protocol/filter_kernel.hpp"
 #include "rdb_protocol/func.hpp"
+#include "rdb_protocol/func_bytecode.hpp"
+#include "rdb_protocol/pathspec.hpp"
 #include "rdb_protocol/profile.hpp"
 #include "rdb_protocol/protocol.hpp"
+#include "rdb_protocol/sort_key.hpp"
 
 bool reversed(sorting_t sorting) { return sorting == sorting_t::DESCENDING; }
 
@@ -104,15 +110,21 @@ private:
             grouped_t<T> *gres = boost::get<grouped_t<T> >(*res);
             guarantee(gres);
             // `gres`'s ordering doesn't affect things here because we're putting the
-            // values into a parallel map.
+            // values into a parallel map.  (It usually is the same ordering, in which
+            // case the hint makes each insertion take constant time.)
+            auto hint = vecs.begin();
             for (auto kv = gres->begin(grouped::order_doesnt_matter_t());
                  kv != gres->end(grouped::order_doesnt_matter_t());
                  ++kv) {
-                vecs[kv->first].push_back(&kv->second);
+                hint = vecs.insert(hint, std::make_pair(kv->first,
+                                                        std::vector<T *>()));
+                hint->second.push_back(&kv->second);
+                ++hint;
             }
         }
         for (auto kv = vecs.begin(); kv != vecs.end(); ++kv) {
-            auto t_it = acc.insert(std::make_pair(kv->first, default_val)).first;
+            auto t_it = acc.insert(acc.end(grouped::order_doesnt_matter_t()),
+                                   std::make_pair(kv->first, default_val));
             unshard_impl(env, &t_it->second, last_key, kv->second);
         }
     }
@@ -177,24 +189,42 @@ protected:
                 }
             }
         } else {
-            // We do a merge sort to preserve sorting.
+            // We do a merge sort to preserve sorting.  The streams whose next item
+            // goes first are kept in a heap, so that merging the results of many
+            // shards doesn't take a pass over all of them for every item.
             std::vector<std::pair<stream_t::iterator, stream_t::iterator> > v;
             v.reserve(streams.size());
+            std::vector<size_t> heap;
+            heap.reserve(streams.size());
             for (auto it = streams.begin(); it != streams.end(); ++it) {
+                if (!(*it)->empty()) {
+                    heap.push_back(v.size());
+                }
                 v.push_back(std::make_pair((*it)->begin(), (*it)->end()));
             }
-            for (;;) {
-                stream_t::iterator *best = NULL;
-                for (auto it = v.begin(); it != v.end(); ++it) {
-                    if (it->first != it->second) {
-                        if (best == NULL || key_le.is_le(it->first->key, (*best)->key)) {
-                            best = &it->first;
-                        }
-                    }
+            // Whether the next item of stream `a` goes after that of stream `b`.
+            // The keys of different shards never tie, but if they did, the earlier
+            // stream would go first.
+            auto goes_after = [this, &v](size_t a, size_t b) {
+                const store_key_t &a_key = v[a].first->key;
+                const store_key_t &b_key = v[b].first->key;
+                if (!key_le.is_le(a_key, b_key)) {
+                    return true;
+                }
+                return key_le.is_le(b_key, a_key) && a > b;
+            };
+            std::make_heap(heap.begin(), heap.end(), goes_after);
+            while (!heap.empty()) {
+                std::pop_heap(heap.begin(), heap.end(), goes_after);
+                const size_t best = heap.back();
+                if (!key_le.is_le(v[best].first->key, last_key)) break;
+                out->push_back(std::move(*v[best].first));
+                ++v[best].first;
+                if (v[best].first != v[best].second) {
+                    std::push_heap(heap.begin(), heap.end(), goes_after);
+                } else {
+                    heap.pop_back();
                 }
-                if (best == NULL || !key_le.is_le((*best)->key, last_key)) break;
-                out->push_back(std::move(**best));
-                ++(*best);
             }
         }
     }
@@ -466,11 +496,15 @@ private:
         } else {
             // Order in fact does NOT matter here.  The reason is, each `kv->first`
             // value is different, which means each operation works on a different
-            // key/value pair of `acc`.
+            // key/value pair of `acc`.  Both maps are sorted the same way though, so
+            // we walk them in step and most insertions take constant time.
+            auto hint = acc->begin(grouped::order_doesnt_matter_t());
             for (auto kv = gres->begin(grouped::order_doesnt_matter_t());
                  kv != gres->end(grouped::order_doesnt_matter_t()); ++kv) {
-                auto t_it = acc->insert(std::make_pair(kv->first, *default_val)).first;
+                auto t_it = acc->insert(hint, std::make_pair(kv->first, *default_val));
                 unshard_impl(env, &t_it->second, &kv->second);
+                hint = t_it;
+                ++hint;
             }
         }
     }
@@ -515,14 +549,187 @@ private:
     }
 };
 
+class sample_terminal_t : public terminal_t<reservoir_t> {
+public:
+    explicit sample_terminal_t(const sample_wire_func_t &f)
+        : terminal_t<reservoir_t>(reservoir_t()), n(f.n) { }
+private:
+    virtual bool accumulate(env_t *,
+                            const datum_t &el,
+                            reservoir_t *out) {
+        out->seen += 1;
+        if (out->rows.size() < n) {
+            out->rows.push_back(el);
+        } else {
+            uint64_t index = randuint64(out->seen);
+            if (index < n) {
+                out->rows[index] = el;
+            }
+        }
+        return true;
+    }
+    virtual datum_t unpack(reservoir_t *r) {
+        std::random_shuffle(r->rows.begin(), r->rows.end());
+        // `sample` checks the size against the query's limits itself.
+        return datum_t(std::move(r->rows), configured_limits_t::unlimited);
+    }
+    // Picks `min(n, out->seen + el->seen)` of the rows of both, each time taking
+    // one from `out` or `el` in proportion to how many of their rows have not been
+    // picked yet, which makes each of the rows they were given equally likely to be
+    // picked.
+    virtual void unshard_impl(env_t *, reservoir_t *out, reservoir_t *el) {
+        uint64_t left[2] = { out->seen, el->seen };
+        std::vector<datum_t> *rows[2] = { &out->rows, &el->rows };
+        size_t taken[2] = { 0, 0 };
+        const uint64_t total = left[0] + left[1];
+        std::vector<datum_t> merged;
+        merged.reserve(std::min<uint64_t>(n, total));
+        while (merged.size() < n && left[0] + left[1] > 0) {
+            const int side = randuint64(left[0] + left[1]) < left[0] ? 0 : 1;
+            guarantee(taken[side] < rows[side]->size());
+            // Each reservoir is a uniform sample of its rows, so a random row of it
+            // stands in for a random one of the rows it was given.
+            size_t index = taken[side] + randsize(rows[side]->size() - taken[side]);
+            std::swap((*rows[side])[taken[side]], (*rows[side])[index]);
+            merged.push_back(std::move((*rows[side])[taken[side]]));
+            ++taken[side];
+            --left[side];
+        }
+        out->seen = total;
+        out->rows = std::move(merged);
+    }
+
+    const uint64_t n;
+};
+
+class unindexed_distinct_terminal_t : public terminal_t<distinct_set_t> {
+public:
+    explicit unindexed_distinct_terminal_t(const unindexed_distinct_wire_func_t &f)
+        : terminal_t<distinct_set_t>(distinct_set_t()),
+          bt(f.bt.get_bt()),
+          reql_version(reql_version_t::LATEST) { }
+private:
+    virtual bool accumulate(env_t *env,
+                            const datum_t &el,
+                            distinct_set_t *out) {
+        reql_version = env->reql_version();
+        key.clear();
+        if (encode_sort_key(reql_version, el, &key)) {
+            out->encoded.insert(std::make_pair(key, el));
+        } else {
+            out->others.push_back(el);
+            maybe_sort_others(out);
+        }
+        check_size(env->limits(), out);
+        return true;
+    }
+    virtual datum_t unpack(distinct_set_t *s) {
+        sort_others(s);
+        // In ascending order, like sorting them all would have put them.
+        std::vector<std::pair<std::string, datum_t> > sorted;
+        sorted.reserve(s->encoded.size());
+        for (auto &&pair : s->encoded) {
+            sorted.push_back(std::make_pair(pair.first, std::move(pair.second)));
+        }
+        std::sort(sorted.begin(), sorted.end(),
+                  [](const std::pair<std::string, datum_t> &a,
+                     const std::pair<std::string, datum_t> &b) {
+                      return a.first < b.first;
+                  });
+        std::vector<datum_t> toret;
+        toret.reserve(sorted.size() + s->others.size());
+        auto it = sorted.begin();
+        auto jt = s->others.begin();
+        while (it != sorted.end() || jt != s->others.end()) {
+            if (jt == s->others.end()
+                || (it != sorted.end() && it->second.compare_lt(reql_version, *jt))) {
+                toret.push_back(std::move(it->second));
+                ++it;
+            } else {
+                toret.push_back(std::move(*jt));
+                ++jt;
+            }
+        }
+        // `distinct` checks the size against the query's limits itself.
+        return datum_t(std::move(toret), configured_limits_t::unlimited);
+    }
+    virtual void unshard_impl(env_t *env, distinct_set_t *out, distinct_set_t *el) {
+        reql_version = env->reql_version();
+        if (out->encoded.size() < el->encoded.size()) {
+            out->encoded.swap(el->encoded);
+        }
+        for (auto &&pair : el->encoded) {
+            out->encoded.insert(std::move(pair));
+        }
+        out->others.insert(out->others.end(),
+                           std::make_move_iterator(el->others.begin()),
+                           std::make_move_iterator(el->others.end()));
+        maybe_sort_others(out);
+        check_size(env->limits(), out);
+    }
+
+    // Sorts the values without a sort key once the unsorted ones are as many as the
+    // sorted ones, so that repeats of them take up at most about twice the space.
+    void maybe_sort_others(distinct_set_t *s) {
+        const size_t unsorted = s->others.size() - s->others_sorted;
+        if (unsorted >= std::max<size_t>(64, s->others_sorted)) {
+            sort_others(s);
+        }
+    }
+    void sort_others(distinct_set_t *s) {
+        const reql_version_t version = reql_version;
+        auto lt = [version](const datum_t &a, const datum_t &b) {
+            return a.compare_lt(version, b);
+        };
+        auto mid = s->others.begin() + s->others_sorted;
+        std::sort(mid, s->others.end(), lt);
+        std::inplace_merge(s->others.begin(), mid, s->others.end(), lt);
+        s->others.erase(
+            std::unique(s->others.begin(), s->others.end(),
+                        [version](const datum_t &a, const datum_t &b) {
+                            return a.cmp(version, b) == 0;
+                        }),
+            s->others.end());
+        s->others_sorted = s->others.size();
+    }
+    // The values found so far are at least these many, so there's no use going on
+    // once they're too many for the result.
+    void check_size(const configured_limits_t &limits, const distinct_set_t *s) {
+        const size_t limit = limits.array_size_limit();
+        if (s->encoded.size() + s->others_sorted > limit) {
+            throw exc_t(base_exc_t::GENERIC,
+                        strprintf("Array over size limit `%zu`.", limit), bt.get());
+        }
+    }
+
+    protob_t<const Backtrace> bt;
+    reql_version_t reql_version;
+    std::string key;
+};
+
 class acc_func_t {
 public:
-    explicit acc_func_t(const counted_t<const func_t> &_f) : f(_f) { }
+    explicit acc_func_t(const counted_t<const func_t> &_f)
+        : f(_f),
+          bytecode(f.has()
+                   ? func_bytecode_t::compile(f.get())
+                   : scoped_ptr_t<func_bytecode_t>()) { }
     datum_t operator()(env_t *env, const datum_t &el) const {
-        return f.has() ? f->call(env, el)->as_datum() : el;
+        if (!f.has()) {
+            return el;
+        }
+        // Field names passed to `sum`, `avg`, `min` and `max` become functions that
+        // compile to bytecode, so this is the common case.
+        datum_t res;
+        if (bytecode.has() && env->trace == NULL && bytecode->call(env, el, &res)) {
+            return res;
+        }
+        return f->call(env, el)->as_datum();
     }
 private:
     counted_t<const func_t> f;
+    // Empty if `f` is empty or can't be compiled.
+    scoped_ptr_t<func_bytecode_t> bytecode;
 };
 
 template<class T>
@@ -689,13 +896,24 @@ class reduce_terminal_t : public terminal_t<datum_t> {
 public:
     explicit reduce_terminal_t(const reduce_wire_func_t &_f)
         : terminal_t<datum_t>(datum_t()),
-          f(_f.compile_wire_func()) { }
+          f(_f.compile_wire_func()),
+          bytecode(func_bytecode_t::compile(f.get())) { }
 private:
     virtual bool accumulate(env_t *env,
                             const datum_t &el,
                             datum_t *out) {
         try {
-            *out = out->has() ? f->call(env, *out, el)->as_datum() : el;
+            if (!out->has()) {
+                *out = el;
+                return true;
+            }
+            datum_t res;
+            if (bytecode.has() && env->trace == NULL
+                && bytecode->call(env, *out, el, &res)) {
+                *out = std::move(res);
+            } else {
+                *out = f->call(env, *out, el)->as_datum();
+            }
             return true;
         } catch (const datum_exc_t &e) {
             throw exc_t(e, f->backtrace().get(), 1);
@@ -712,6 +930,8 @@ private:
     }
 
     counted_t<const func_t> f;
+    // Empty if `f` can't be compiled.
+    scoped_ptr_t<func_bytecode_t> bytecode;
 };
 
 template<class T>
@@ -720,6 +940,9 @@ public:
     T *operator()(const count_wire_func_t &f) const {
         return new count_terminal_t(f);
     }
+    T *operator()(const sample_wire_func_t &f) const {
+        return new sample_terminal_t(f);
+    }
     T *operator()(const sum_wire_func_t &f) const {
         return new sum_terminal_t(f);
     }
@@ -735,6 +958,9 @@ public:
     T *operator()(const reduce_wire_func_t &f) const {
         return new reduce_terminal_t(f);
     }
+    T *operator()(const unindexed_distinct_wire_func_t &f) const {
+        return new unindexed_distinct_terminal_t(f);
+    }
     T *operator()(const limit_read_t &lr) const {
         return new limit_append_t(
             lr.is_primary, lr.n, lr.sorting, lr.ops);
@@ -751,6 +977,40 @@ scoped_ptr_t<eager_acc_t> make_eager_terminal(const terminal_variant_t &t) {
             boost::apply_visitor(terminal_visitor_t<eager_acc_t>(), t));
 }
 
+void op_t::apply_to_rows(env_t *env,
+                         std::vector<groups_t> *rows,
+                         const std::vector<datum_t> &sindex_vals) {
+    r_sanity_check(rows->size() == sindex_vals.size());
+    for (size_t i = 0; i < rows->size(); ++i) {
+        (*this)(env, &(*rows)[i], sindex_vals[i]);
+    }
+}
+
+// Concatenates the values of all the groups of all the rows, in order.
+datums_t gather_rows(const std::vector<groups_t> &rows) {
+    datums_t all;
+    for (auto row = rows.begin(); row != rows.end(); ++row) {
+        for (auto it = row->begin(); it != row->end(); ++it) {
+            all.insert(all.end(), it->second.begin(), it->second.end());
+        }
+    }
+    return all;
+}
+
+// Like `gather_rows`, but moves the rows out of `rows`, for callers that are going
+// to overwrite them anyway.
+datums_t take_rows(std::vector<groups_t> *rows) {
+    datums_t all;
+    for (auto row = rows->begin(); row != rows->end(); ++row) {
+        for (auto it = row->begin(); it != row->end(); ++it) {
+            all.insert(all.end(),
+                       std::make_move_iterator(it->second.begin()),
+                       std::make_move_iterator(it->second.end()));
+        }
+    }
+    return all;
+}
+
 class ungrouped_op_t : public op_t {
 protected:
 private:
@@ -816,7 +1076,7 @@ private:
                 std::vector<std::vector<datum_t> > perms(arr.size());
                 for (size_t i = 0; i < arr.size(); ++i) {
                     if (arr[i].get_type() != datum_t::R_ARRAY) {
-                        perms[i].push_back(arr[i]);
+                        perms[i].push_back(std::move(arr[i]));
                     } else {
                         perms[i].reserve(arr[i].arr_size());
                         for (size_t j = 0; j < arr[i].arr_size(); ++j) {
@@ -848,7 +1108,7 @@ private:
             ? std::move(arr[0])
             : datum_t(std::move(arr), limits);
         r_sanity_check(group.has());
-        (*groups)[group].push_back(el);
+        (*groups)[std::move(group)].push_back(el);
     }
 
     void add_perms(groups_t *groups,
@@ -862,10 +1122,10 @@ private:
             r_sanity_check(instance->size() == arr->size());
             add(groups, std::vector<datum_t>(*instance), el, limits);
         } else {
-            auto vec = (*arr)[index];
+            const std::vector<datum_t> &vec = (*arr)[index];
             if (vec.size() != 0) {
                 for (auto it = vec.begin(); it != vec.end(); ++it) {
-                    instance->push_back(std::move(*it));
+                    instance->push_back(*it);
                     add_perms(groups, instance, arr, index + 1, el, limits);
                     instance->pop_back();
                 }
@@ -885,19 +1145,56 @@ private:
 class map_trans_t : public ungrouped_op_t {
 public:
     explicit map_trans_t(const map_wire_func_t &_f)
-        : f(_f.compile_wire_func()) { }
+        : f(_f.compile_wire_func()),
+          bytecode(func_bytecode_t::compile(f.get())) { }
 private:
     virtual void lst_transform(
         env_t *env, datums_t *lst, const datum_t &) {
+        // The bytecode doesn't produce profiling events, so we don't use it when
+        // profiling.
+        const func_bytecode_t *const bc = env->trace == NULL ? bytecode.get() : NULL;
         try {
+            if (bc == NULL) {
+                f->call_on_each(env, lst);
+                return;
+            }
             for (auto it = lst->begin(); it != lst->end(); ++it) {
-                *it = f->call(env, *it)->as_datum();
+                datum_t res;
+                if (bc->call(env, *it, &res)) {
+                    *it = std::move(res);
+                } else {
+                    *it = f->call(env, *it)->as_datum();
+                }
             }
         } catch (const datum_exc_t &e) {
             throw exc_t(e, f->backtrace().get(), 1);
         }
     }
+    virtual bool batches_rows() {
+        return !bytecode.has() && f->batches_calls();
+    }
+    virtual void apply_to_rows(env_t *env,
+                               std::vector<groups_t> *rows,
+                               const std::vector<datum_t> &) {
+        datums_t all = take_rows(rows);
+        try {
+            f->call_on_each(env, &all);
+        } catch (const datum_exc_t &e) {
+            throw exc_t(e, f->backtrace().get(), 1);
+        }
+        auto res = all.begin();
+        for (auto row = rows->begin(); row != rows->end(); ++row) {
+            for (auto it = row->begin(); it != row->end(); ++it) {
+                for (auto el = it->second.begin(); el != it->second.end(); ++el) {
+                    *el = std::move(*res++);
+                }
+            }
+        }
+        r_sanity_check(res == all.end());
+    }
     counted_t<const func_t> f;
+    // Empty if `f` can't be compiled.
+    scoped_ptr_t<func_bytecode_t> bytecode;
 };
 
 // Note: this removes duplicates ONLY TO SAVE NETWORK TRAFFIC.  It's possible
@@ -907,6 +1204,8 @@ private:
 class distinct_trans_t : public ungrouped_op_t {
 public:
     explicit distinct_trans_t(const distinct_wire_func_t &f) : use_index(f.use_index) { }
+    // With an index, the values are replaced by the index values.
+    virtual bool uses_val() { return !use_index; }
 private:
     // sindex_val may be NULL
     virtual void lst_transform(
@@ -937,15 +1236,31 @@ public:
         : f(_f.filter_func.compile_wire_func()),
           default_val(_f.default_filter_val
                       ? _f.default_filter_val->compile_wire_func()
-                      : counted_t<const func_t>()) { }
+                      : counted_t<const func_t>()),
+          tried_kernel(false) { }
 private:
     virtual void lst_transform(
         env_t *env, datums_t *lst, const datum_t &) {
+        if (!tried_kernel) {
+            kernel = filter_kernel_t::compile(f.get(), env->reql_version());
+            tried_kernel = true;
+        }
+        // The kernel doesn't produce profiling events, so we don't use it when
+        // profiling.
+        const filter_kernel_t *const k = env->trace == NULL ? kernel.get() : NULL;
+        if (k == NULL && f->batches_calls() && lst->size() > 1
+            && filter_in_one_batch(env, lst)) {
+            return;
+        }
         auto it = lst->begin();
         auto loc = it;
         try {
             for (it = lst->begin(); it != lst->end(); ++it) {
-                if (f->filter_call(env, *it, default_val)) {
+                bool keep;
+                if (k == NULL || !k->eval(*it, &keep)) {
+                    keep = f->filter_call(env, *it, default_val);
+                }
+                if (keep) {
                     std::swap(*loc, *it);
                     ++loc;
                 }
@@ -955,7 +1270,72 @@ private:
         }
         lst->erase(loc, lst->end());
     }
+    virtual bool batches_rows() { return f->batches_calls(); }
+    virtual void apply_to_rows(env_t *env,
+                               std::vector<groups_t> *rows,
+                               const std::vector<datum_t> &sindex_vals) {
+        datums_t results;
+        if (!call_in_one_batch(env, gather_rows(*rows), &results)) {
+            op_t::apply_to_rows(env, rows, sindex_vals);
+            return;
+        }
+        auto res = results.begin();
+        for (auto row = rows->begin(); row != rows->end(); ++row) {
+            for (auto it = row->begin(); it != row->end();) {
+                auto loc = it->second.begin();
+                for (auto el = it->second.begin(); el != it->second.end(); ++el) {
+                    if ((res++)->as_bool()) {
+                        std::swap(*loc, *el);
+                        ++loc;
+                    }
+                }
+                it->second.erase(loc, it->second.end());
+                if (it->second.size() == 0) {
+                    row->erase(it++);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        r_sanity_check(res == results.end());
+    }
+    // Calls `f` on the whole batch at once.  Returns false without touching `lst`
+    // if that fails, so errors and `default_val` can be handled the usual way.
+    bool filter_in_one_batch(env_t *env, datums_t *lst) {
+        datums_t results;
+        if (!call_in_one_batch(env, *lst, &results)) {
+            return false;
+        }
+        auto loc = lst->begin();
+        for (size_t i = 0; i < results.size(); ++i) {
+            if (results[i].as_bool()) {
+                std::swap(*loc, (*lst)[i]);
+                ++loc;
+            }
+        }
+        lst->erase(loc, lst->end());
+        return true;
+    }
+    // Stores the results of calling `f` on each of `args`, or returns false if
+    // that fails.
+    bool call_in_one_batch(env_t *env, datums_t args, datums_t *results_out) {
+        bool failed = false;
+        try {
+            f->call_on_each(env, &args);
+        } catch (const base_exc_t &) {
+            failed = true;
+        }
+        if (failed) {
+            return false;
+        }
+        *results_out = std::move(args);
+        return true;
+    }
     counted_t<const func_t> f, default_val;
+    // Set up on the first batch, since we need the ReQL version.  Empty if `f`
+    // can't be compiled to a kernel.
+    bool tried_kernel;
+    scoped_ptr_t<filter_kernel_t> kernel;
 };
 
 class concatmap_trans_t : public ungrouped_op_t {
@@ -975,7 +1355,9 @@ private:
                     auto v = ds->next_batch(env, bs);
                     if (v.size() == 0) break;
                     new_lst.reserve(new_lst.size() + v.size());
-                    new_lst.insert(new_lst.end(), v.begin(), v.end());
+                    new_lst.insert(new_lst.end(),
+                                   std::make_move_iterator(v.begin()),
+                                   std::make_move_iterator(v.end()));
                     sampler.new_sample();
                 }
             }
@@ -1003,6 +1385,42 @@ private:
     }
 };
 
+class project_trans_t : public ungrouped_op_t {
+public:
+    explicit project_trans_t(const project_wire_func_t &f)
+        : type(f.type),
+          // The paths were checked when the transformation was created, so the
+          // pathspec doesn't need a term to report errors against.
+          pathspec(f.paths, NULL),
+          fallback(f.fallback.compile_wire_func()) { }
+private:
+    virtual void lst_transform(
+        env_t *env, datums_t *lst, const datum_t &) {
+        try {
+            for (auto it = lst->begin(); it != lst->end(); ++it) {
+                if (it->get_type() != datum_t::R_OBJECT || it->is_ptype()) {
+                    *it = fallback->call(env, *it)->as_datum();
+                    continue;
+                }
+                switch (type) {
+                case project_type_t::PLUCK:
+                    *it = project(*it, pathspec, DONT_RECURSE, env->limits());
+                    break;
+                case project_type_t::WITHOUT:
+                    *it = unproject(*it, pathspec, DONT_RECURSE, env->limits());
+                    break;
+                default: unreachable();
+                }
+            }
+        } catch (const datum_exc_t &e) {
+            throw exc_t(e, fallback->backtrace().get(), 1);
+        }
+    }
+    project_type_t type;
+    pathspec_t pathspec;
+    counted_t<const func_t> fallback;
+};
+
 class transform_visitor_t : public boost::static_visitor<op_t *> {
 public:
     transform_visitor_t() { }
@@ -1024,6 +1442,9 @@ public:
     op_t *operator()(const zip_wire_func_t &f) const {
         return new zip_trans_t(f);
     }
+    op_t *operator()(const project_wire_func_t &f) const {
+        return new project_trans_t(f);
+    }
 };
 
 scoped_ptr_t<op_t> make_op(const transform_variant_t &tv) {
@@ -5,6 +5,8 @@
 #include <algorithm>
 #include <limits>
 #include <map>
+#include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -71,6 +73,74 @@ public:
     datum_t row, val;
 };
 
+// The rows `sample` has picked so far out of the `seen` rows it was given: as many
+// as it was asked for (or all of them, if there were fewer), each of the `seen`
+// rows as likely as any other to be among them.
+class reservoir_t {
+public:
+    reservoir_t() : seen(0) { }
+    uint64_t seen;
+    std::vector<datum_t> rows;
+};
+
+template <cluster_version_t W>
+void serialize_grouped(write_message_t *wm, const reservoir_t &r) {
+    serialize_varint_uint64(wm, r.seen);
+    serialize<W>(wm, r.rows);
+}
+template <cluster_version_t W>
+archive_result_t deserialize_grouped(read_stream_t *s, reservoir_t *r) {
+    archive_result_t res = deserialize_varint_uint64(s, &r->seen);
+    if (bad(res)) { return res; }
+    return deserialize<W>(s, &r->rows);
+}
+
+// The distinct values `distinct` has found so far.  Those with a sort key (see
+// `encode_sort_key`) are kept by it.  The others are kept sorted, except for the
+// last ones added since they were sorted, which may repeat.
+class distinct_set_t {
+public:
+    distinct_set_t() : others_sorted(0) { }
+    std::unordered_map<std::string, datum_t> encoded;
+    std::vector<datum_t> others;
+    size_t others_sorted;
+};
+
+template <cluster_version_t W>
+void serialize_grouped(write_message_t *wm, const distinct_set_t &s) {
+    serialize_varint_uint64(wm, s.encoded.size());
+    for (const auto &pair : s.encoded) {
+        serialize<W>(wm, pair.first);
+        serialize<W>(wm, pair.second);
+    }
+    serialize<W>(wm, s.others);
+    serialize_varint_uint64(wm, s.others_sorted);
+}
+template <cluster_version_t W>
+archive_result_t deserialize_grouped(read_stream_t *s, distinct_set_t *out) {
+    uint64_t num_encoded;
+    archive_result_t res = deserialize_varint_uint64(s, &num_encoded);
+    if (bad(res)) { return res; }
+    for (uint64_t i = 0; i < num_encoded; ++i) {
+        std::pair<std::string, datum_t> pair;
+        res = deserialize<W>(s, &pair.first);
+        if (bad(res)) { return res; }
+        res = deserialize<W>(s, &pair.second);
+        if (bad(res)) { return res; }
+        out->encoded.insert(std::move(pair));
+    }
+    res = deserialize<W>(s, &out->others);
+    if (bad(res)) { return res; }
+    uint64_t others_sorted;
+    res = deserialize_varint_uint64(s, &others_sorted);
+    if (bad(res)) { return res; }
+    if (others_sorted > out->others.size()) {
+        return archive_result_t::RANGE_ERROR;
+    }
+    out->others_sorted = others_sorted;
+    return archive_result_t::SUCCESS;
+}
+
 template <cluster_version_t W>
 void serialize_grouped(write_message_t *wm, const optimizer_t &o) {
     serialize<W>(wm, o.row.has());
@@ -230,6 +300,14 @@ public:
     insert(std::pair<datum_t, T> &&val) {
         return m.insert(std::move(val));
     }
+    // Like `std::map::insert` with a hint: if `val.first` is already there, returns
+    // the existing element.  Takes constant time if `val` belongs right before
+    // `hint`, so it's good for inserting keys in ascending order.
+    typename std::map<datum_t, T, optional_datum_less_t>::iterator
+    insert(typename std::map<datum_t, T, optional_datum_less_t>::iterator hint,
+           std::pair<datum_t, T> &&val) {
+        return m.insert(hint, std::move(val));
+    }
     void
     erase(typename std::map<datum_t, T, optional_datum_less_t>::iterator pos) {
         m.erase(pos);
@@ -322,6 +400,8 @@ typedef boost::variant<
     grouped_t<std::pair<double, uint64_t> >, // Avg.
     grouped_t<ql::datum_t>, // Reduce (may be NULL)
     grouped_t<optimizer_t>, // min, max
+    grouped_t<reservoir_t>, // Sample.
+    grouped_t<distinct_set_t>, // Unindexed distinct.
     grouped_t<stream_t>, // No terminal.
     exc_t // Don't re-order (we don't want this to initialize to an error.)
     > result_t;
@@ -331,17 +411,28 @@ typedef boost::variant<map_wire_func_t,
                        filter_wire_func_t,
                        concatmap_wire_func_t,
                        distinct_wire_func_t,
-                       zip_wire_func_t
+                       zip_wire_func_t,
+                       project_wire_func_t
                        > transform_variant_t;
 
 class op_t {
 public:
     op_t() { }
     virtual ~op_t() { }
+    // Whether the op looks at the values it's given.  Ops that don't replace them
+    // with values of their own, so the ops after them never see the rows either.
+    virtual bool uses_val() { return true; }
     virtual void operator()(env_t *env,
                             groups_t *groups,
                             // sindex_val may be NULL
                             const datum_t &sindex_val) = 0;
+    // Whether `apply_to_rows()` is cheaper than applying the op to each row in turn.
+    virtual bool batches_rows() { return false; }
+    // Applies the op to the data of several rows, where `sindex_vals[i]` goes with
+    // `(*rows)[i]`.
+    virtual void apply_to_rows(env_t *env,
+                               std::vector<groups_t> *rows,
+                               const std::vector<datum_t> &sindex_vals);
 };
 
 struct limit_read_t {
@@ -355,11 +446,13 @@ struct limit_read_t {
 RDB_DECLARE_SERIALIZABLE(limit_read_t);
 
 typedef boost::variant<count_wire_func_t,
+                       sample_wire_func_t,
                        sum_wire_func_t,
                        avg_wire_func_t,
                        min_wire_func_t,
                        max_wire_func_t,
                        reduce_wire_func_t,
+                       unindexed_distinct_wire_func_t,
                        limit_read_t
                        > terminal_variant_t;
 
@@ -0,0 +1,175 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/sort_key.hpp"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "rdb_protocol/error.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/profile.hpp"
+#include "rdb_protocol/val.hpp"
+
+namespace ql {
+
+namespace {
+
+// Every value starts with its type, so values of different types are ordered by
+// type like `datum_t::modern_cmp` does.  The types are all nonzero, which leaves
+// 0 to end arrays (and strings) with, so that a prefix sorts first.
+const char END_MARKER = 0;
+// A 0 byte inside a string is followed by this, so that it sorts after the end.
+const char ZERO_ESCAPE = static_cast<char>(0xff);
+
+bool encode_value(const datum_t &d, std::string *out) {
+    const datum_t::type_t type = d.get_type();
+    switch (type) {
+    case datum_t::R_NULL:
+        out->push_back(static_cast<char>(type));
+        return true;
+    case datum_t::R_BOOL:
+        out->push_back(static_cast<char>(type));
+        out->push_back(d.as_bool() ? 1 : 0);
+        return true;
+    case datum_t::R_NUM: {
+        out->push_back(static_cast<char>(type));
+        // -0.0 == 0.0, so they need the same encoding.
+        double num = d.as_num() == 0 ? 0.0 : d.as_num();
+        uint64_t bits;
+        static_assert(sizeof(bits) == sizeof(num), "doubles aren't 64 bits");
+        memcpy(&bits, &num, sizeof(bits));
+        // Flipping the sign bit of positive numbers, and all the bits of negative
+        // ones, makes the bits compare as unsigned integers like the numbers do.
+        // (Datums can't be NaN.)
+        bits = (bits & (uint64_t(1) << 63)) != 0 ? ~bits : bits | (uint64_t(1) << 63);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out->push_back(static_cast<char>((bits >> shift) & 0xff));
+        }
+        return true;
+    }
+    case datum_t::R_STR: {
+        out->push_back(static_cast<char>(type));
+        const datum_string_t &str = d.as_str();
+        const char *data = str.data();
+        const size_t size = str.size();
+        for (size_t i = 0; i < size; ++i) {
+            out->push_back(data[i]);
+            if (data[i] == END_MARKER) {
+                out->push_back(ZERO_ESCAPE);
+            }
+        }
+        out->push_back(END_MARKER);
+        out->push_back(END_MARKER);
+        return true;
+    }
+    case datum_t::R_ARRAY: {
+        out->push_back(static_cast<char>(type));
+        const size_t size = d.arr_size();
+        for (size_t i = 0; i < size; ++i) {
+            if (!encode_value(d.get(i), out)) {
+                return false;
+            }
+        }
+        out->push_back(END_MARKER);
+        return true;
+    }
+    case datum_t::R_BINARY: // fallthru
+    case datum_t::R_OBJECT:
+        // Objects and pseudotypes (including binary) have orderings of their own.
+        return false;
+    case datum_t::UNINITIALIZED: // fallthru
+    default:
+        unreachable();
+    }
+}
+
+}  // namespace
+
+bool encode_sort_key(reql_version_t reql_version, const datum_t &d, std::string *out) {
+    switch (reql_version) {
+    case reql_version_t::v1_13:
+        return false;
+    case reql_version_t::v1_14: // v1_15 is the same as v1_14
+    case reql_version_t::v1_16_is_latest:
+        return encode_value(d, out);
+    default:
+        unreachable();
+    }
+}
+
+sort_order_t::sort_order_t(
+    std::vector<std::pair<sort_direction_t, counted_t<const func_t> > > _comparisons)
+    : comparisons(std::move(_comparisons)) { }
+
+sort_key_t sort_order_t::key(env_t *env, const datum_t &row) const {
+    sort_key_t ret;
+    ret.fields.resize(comparisons.size());
+    for (size_t i = 0; i < comparisons.size(); ++i) {
+        sort_key_t::field_t *field = &ret.fields[i];
+        try {
+            field->value = comparisons[i].second->call(env, row)->as_datum();
+        } catch (const base_exc_t &e) {
+            if (e.get_type() != base_exc_t::NON_EXISTENCE) {
+                field->error = std::current_exception();
+            }
+        }
+        field->is_encoded = field->value.has()
+            && encode_sort_key(env->reql_version(), field->value, &field->encoded);
+    }
+    return ret;
+}
+
+bool sort_order_t::lt(env_t *env, const sort_key_t &l, const sort_key_t &r) const {
+    for (size_t i = 0; i < comparisons.size(); ++i) {
+        const sort_key_t::field_t &lfield = l.fields[i];
+        const sort_key_t::field_t &rfield = r.fields[i];
+        if (lfield.error) {
+            std::rethrow_exception(lfield.error);
+        }
+        if (rfield.error) {
+            std::rethrow_exception(rfield.error);
+        }
+        const bool desc = comparisons[i].first == sort_direction_t::DESC;
+        if (!lfield.value.has() && !rfield.value.has()) {
+            continue;
+        }
+        if (!lfield.value.has()) {
+            return !desc;
+        }
+        if (!rfield.value.has()) {
+            return desc;
+        }
+        const int cmp_res = lfield.is_encoded && rfield.is_encoded
+            ? lfield.encoded.compare(rfield.encoded)
+            : lfield.value.cmp(env->reql_version(), rfield.value);
+        if (cmp_res == 0) {
+            continue;
+        }
+        return (cmp_res < 0) != desc;
+    }
+    return false;
+}
+
+void sort_order_t::sort(env_t *env, profile::sampler_t *sampler,
+                        std::vector<datum_t> *rows) const {
+    std::vector<std::pair<sort_key_t, size_t> > keys;
+    keys.reserve(rows->size());
+    for (size_t i = 0; i < rows->size(); ++i) {
+        sampler->new_sample();
+        keys.push_back(std::make_pair(key(env, (*rows)[i]), i));
+    }
+    std::stable_sort(keys.begin(), keys.end(),
+                     [&](const std::pair<sort_key_t, size_t> &a,
+                         const std::pair<sort_key_t, size_t> &b) {
+                         return lt(env, a.first, b.first);
+                     });
+    std::vector<datum_t> sorted;
+    sorted.reserve(rows->size());
+    for (const auto &pair : keys) {
+        sorted.push_back(std::move((*rows)[pair.second]));
+    }
+    rows->swap(sorted);
+}
+
+}  // namespace ql
@@ -0,0 +1,81 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_SORT_KEY_HPP_
+#define RDB_PROTOCOL_SORT_KEY_HPP_
+
+#include <exception>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "containers/counted.hpp"
+#include "rdb_protocol/datum.hpp"
+
+namespace profile { class sampler_t; }
+
+namespace ql {
+
+class env_t;
+class func_t;
+
+/* Appends to `out` a byte string for `d` such that, for any two datums that have
+one, comparing the byte strings (as unsigned chars, like `memcmp` and
+`std::string::compare` do) orders them like `datum_t::cmp(reql_version, ...)`,
+and equal datums get equal strings.  So the strings can also be hashed for hash-
+based operators.
+
+Only null, booleans, numbers, strings and arrays of those have one, and none do
+under `reql_version_t::v1_13`, whose ordering is different.  Returns false for
+anything else, leaving `out` in an unspecified state; callers then fall back to
+`datum_t::cmp`. */
+bool encode_sort_key(reql_version_t reql_version, const datum_t &d, std::string *out);
+
+enum class sort_direction_t { ASC, DESC };
+
+/* The values a row is ordered by, each computed once and encoded with
+`encode_sort_key` if it can be. */
+class sort_key_t {
+public:
+    sort_key_t() { }
+    sort_key_t(sort_key_t &&) = default;
+    sort_key_t &operator=(sort_key_t &&) = default;
+
+private:
+    friend class sort_order_t;
+    struct field_t {
+        // Empty if the function threw a non-existence error, or if it threw anything
+        // else, in which case `error` is set.  The error is only rethrown if it
+        // matters for a comparison, like it would be if the function were called
+        // from the comparison.
+        datum_t value;
+        std::exception_ptr error;
+        bool is_encoded;
+        std::string encoded;
+    };
+    std::vector<field_t> fields;
+
+    DISABLE_COPYING(sort_key_t);
+};
+
+/* The ordering of `orderBy`.  `key` calls the functions on a row, so sorts can
+compute each row's key once and then compare keys, usually as byte strings, rather
+than calling the functions twice per comparison. */
+class sort_order_t {
+public:
+    explicit sort_order_t(
+        std::vector<std::pair<sort_direction_t, counted_t<const func_t> > >
+            comparisons);
+
+    sort_key_t key(env_t *env, const datum_t &row) const;
+    bool lt(env_t *env, const sort_key_t &l, const sort_key_t &r) const;
+
+    // Sorts `rows` stably.
+    void sort(env_t *env, profile::sampler_t *sampler,
+              std::vector<datum_t> *rows) const;
+
+private:
+    std::vector<std::pair<sort_direction_t, counted_t<const func_t> > > comparisons;
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_SORT_KEY_HPP_
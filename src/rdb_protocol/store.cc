@@ -1,6 +1,8 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/store.hpp"
 
+#include <algorithm>
+
 #include "btree/slice.hpp"
 #include "btree/superblock.hpp"
 #include "concurrency/cross_thread_signal.hpp"
@@ -143,7 +145,12 @@ void store_t::help_construct_bring_sindexes_up_to_date() {
         std::map<sindex_name_t, secondary_index_t> sindexes;
         get_secondary_indexes(&sindex_block, &sindexes);
         for (auto it = sindexes.begin(); it != sindexes.end(); ++it) {
-            if (it->second.being_deleted) {
+            if (it->second.being_deleted && it->second.opaque_definition.empty()) {
+                // This is a primary B-tree that `truncate_data()` replaced.  Its
+                // values have to be deleted for real, so it has its own clearer.
+                coro_t::spawn_sometime(std::bind(&store_t::delayed_clear_truncated_data,
+                                                 this, it->second, drainer.lock()));
+            } else if (it->second.being_deleted) {
                 coro_t::spawn_sometime(std::bind(&sindex_clearer_t::clear,
                                                  this, it->second, drainer.lock()));
             }
@@ -254,7 +261,7 @@ void do_read(ql::env_t *env,
 struct rdb_read_visitor_t : public boost::static_visitor<void> {
     void operator()(const changefeed_subscribe_t &s) {
         guarantee(store->changefeed_server.has());
-        store->changefeed_server->add_client(s.addr, s.region);
+        store->changefeed_server->add_client(s.addr, s.region, ctx, s.spec);
         response->response = changefeed_subscribe_response_t();
         auto res = boost::get<changefeed_subscribe_response_t>(&response->response);
         guarantee(res != NULL);
@@ -333,8 +340,27 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         guarantee(store->changefeed_server.has());
         response->response = changefeed_stamp_response_t();
         auto res = boost::get<changefeed_stamp_response_t>(&response->response);
-        res->stamps[store->changefeed_server->get_uuid()]
-            = store->changefeed_server->get_stamp(s.addr);
+        ql::changefeed::server_t *server = store->changefeed_server.get();
+        const uuid_u uuid = server->get_uuid();
+        uint64_t stamp, log_position;
+        if (s.resume_from) {
+            auto it = s.resume_from->find(uuid);
+            if (it == s.resume_from->end()) {
+                res->resume_error = "the resume token is from before a server "
+                    "restarted or the table was resharded";
+                return;
+            }
+            log_position = it->second;
+            if (!server->resume(s.addr, log_position, &stamp)) {
+                res->resume_error = "the changes since the resume token are no "
+                    "longer in the change log";
+                return;
+            }
+        } else {
+            stamp = server->get_stamp(s.addr, &log_position);
+        }
+        res->stamps[uuid] = stamp;
+        res->log_positions[uuid] = log_position;
     }
 
     void operator()(const changefeed_point_stamp_t &s) {
@@ -356,6 +382,13 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         rdb_get(get.key, btree, superblock, res, trace);
     }
 
+    void operator()(const batched_point_read_t &get) {
+        response->response = batched_point_read_response_t();
+        batched_point_read_response_t *res =
+            boost::get<batched_point_read_response_t>(&response->response);
+        rdb_batched_get(get.keys, btree, superblock, res, trace);
+    }
+
     void operator()(const intersecting_geo_read_t &geo_read) {
         ql::env_t ql_env(ctx, interruptor, geo_read.optargs, trace);
 
@@ -487,6 +520,7 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
             scale_down_distribution(dg.result_limit, &res->key_counts);
         }
 
+        store->get_key_load(dg.region.inner, &res->key_loads);
         res->region = dg.region;
     }
 
@@ -555,6 +589,8 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
 
                     s->geo = sindex_info.geo;
                     s->multi = sindex_info.multi;
+                    s->covering = sindex_info.covering;
+                    s->partial = static_cast<bool>(sindex_info.filter);
                     s->outdated =
                         (sindex_info.mapping_version_info.latest_compatible_reql_version
                             != reql_version_t::LATEST);
@@ -567,6 +603,14 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         response->response = dummy_read_response_t();
     }
 
+    void operator()(const backfill_digest_read_t &bd) {
+        response->response = backfill_digest_read_response_t();
+        backfill_digest_read_response_t *res =
+            boost::get<backfill_digest_read_response_t>(&response->response);
+        rdb_backfill_digests(superblock, bd.region, release_superblock_t::RELEASE,
+                             &res->digests);
+    }
+
     rdb_read_visitor_t(btree_slice_t *_btree,
                        store_t *_store,
                        superblock_t *_superblock,
@@ -595,10 +639,36 @@ private:
     DISABLE_COPYING(rdb_read_visitor_t);
 };
 
+struct record_read_load_visitor_t : public boost::static_visitor<void> {
+    explicit record_read_load_visitor_t(key_load_sampler_t *_sampler)
+        : sampler(_sampler) { }
+
+    void operator()(const point_read_t &get) const {
+        sampler->record(get.key);
+    }
+    void operator()(const batched_point_read_t &get) const {
+        for (const store_key_t &key : get.keys) {
+            sampler->record(key);
+        }
+    }
+    void operator()(const rget_read_t &rget) const {
+        // The region of an sindex read says nothing about which documents it reads.
+        if (!rget.sindex) {
+            sampler->record(rget.region.inner.left);
+        }
+    }
+    // The other reads are either sindex reads or not requested by users.
+    template <class T>
+    void operator()(const T &) const { }
+
+    key_load_sampler_t *const sampler;
+};
+
 void store_t::protocol_read(const read_t &read,
                             read_response_t *response,
                             superblock_t *superblock,
                             signal_t *interruptor) {
+    boost::apply_visitor(record_read_load_visitor_t(&load_sampler), read.read);
     scoped_ptr_t<profile::trace_t> trace = ql::maybe_make_profile_trace(read.profile);
 
     {
@@ -620,6 +690,115 @@ void store_t::protocol_read(const read_t &read,
     response->event_log.push_back(profile::stop_t());
 }
 
+bool store_t::protocol_read_optimistically(const read_t &read,
+                                           read_response_t *response) {
+    // Profiled reads want to see the whole read in their trace.
+    const point_read_t *get = boost::get<point_read_t>(&read.read);
+    if (get == NULL || read.profile != profile_bool_t::DONT_PROFILE) {
+        return false;
+    }
+
+    load_sampler.record(get->key);
+    point_read_response_t res;
+    if (key_filter_excludes(get->key)) {
+        res.data = ql::datum_t::null();
+    } else if (!rdb_get_optimistically(get->key, btree.get(),
+                                       general_cache_conn->cache(), &res)) {
+        return false;
+    }
+    response->response = res;
+    response->n_shards = 1;
+    response->event_log.push_back(profile::stop_t());
+    return true;
+}
+
+struct add_to_key_filter_visitor_t : public boost::static_visitor<void> {
+    explicit add_to_key_filter_visitor_t(store_t *_store) : store(_store) { }
+
+    void operator()(const batched_replace_t &br) const {
+        for (auto it = br.keys.begin(); it != br.keys.end(); ++it) {
+            store->add_to_key_filter(*it);
+        }
+    }
+    void operator()(const batched_insert_t &bi) const {
+        for (auto it = bi.inserts.begin(); it != bi.inserts.end(); ++it) {
+            store->add_to_key_filter(
+                store_key_t(it->get_field(datum_string_t(bi.pkey)).print_primary()));
+        }
+    }
+    void operator()(const point_write_t &w) const {
+        store->add_to_key_filter(w.key);
+    }
+    // The other writes don't insert any keys into the primary B-tree.
+    template <class T>
+    void operator()(const T &) const { }
+
+    store_t *const store;
+};
+
+void store_t::protocol_add_to_key_filter(const write_t &write) {
+    boost::apply_visitor(add_to_key_filter_visitor_t(this), write.write);
+}
+
+// Calls `on_key` with each of the keys that a write touches.
+template <class callable_t>
+struct write_keys_visitor_t : public boost::static_visitor<void> {
+    explicit write_keys_visitor_t(callable_t *_on_key) : on_key(_on_key) { }
+
+    void operator()(const batched_replace_t &br) const {
+        for (auto it = br.keys.begin(); it != br.keys.end(); ++it) {
+            (*on_key)(*it);
+        }
+    }
+    void operator()(const batched_insert_t &bi) const {
+        for (auto it = bi.inserts.begin(); it != bi.inserts.end(); ++it) {
+            (*on_key)(
+                store_key_t(it->get_field(datum_string_t(bi.pkey)).print_primary()));
+        }
+    }
+    void operator()(const point_write_t &w) const {
+        (*on_key)(w.key);
+    }
+    void operator()(const point_delete_t &d) const {
+        (*on_key)(d.key);
+    }
+    // The other writes either touch ranges of keys or no keys at all.
+    template <class T>
+    void operator()(const T &) const { }
+
+    callable_t *const on_key;
+};
+
+template <class callable_t>
+void for_each_write_key(const write_t &write, callable_t *on_key) {
+    boost::apply_visitor(write_keys_visitor_t<callable_t>(on_key), write.write);
+}
+
+class null_found_keyvalue_callback_t : public found_keyvalue_callback_t {
+public:
+    void on_keyvalue(size_t, const void *, buf_parent_t) { }
+};
+
+void store_t::protocol_prefetch_for_write(const write_t &write) {
+    std::vector<store_key_t> keys;
+    auto add_key = [&](const store_key_t &key) { keys.push_back(key); };
+    for_each_write_key(write, &add_key);
+    if (keys.empty()) {
+        return;
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    // A snapshotted read doesn't hold up the writes that come after it.
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    get_btree_superblock_and_txn_for_reading(
+        general_cache_conn.get(), CACHE_SNAPSHOTTED_YES, &superblock, &txn);
+    rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
+    null_found_keyvalue_callback_t cb;
+    find_keyvalues_for_read(&sizer, superblock.get(), keys, &cb, &btree->stats,
+                            NULL);
+}
 
 class func_replacer_t : public btree_batched_replacer_t {
 public:
@@ -725,7 +904,7 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
 
         write_message_t wm;
         sindex_disk_info_t info(c.mapping, sindex_reql_version_info_t::LATEST(),
-                                c.multi, c.geo);
+                                c.multi, c.geo, c.covering, c.filter);
         serialize_sindex_info(&wm, info);
 
         vector_stream_t stream;
@@ -802,6 +981,11 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
         response->response = dummy_write_response_t();
     }
 
+    void operator()(const truncate_t &) {
+        store->truncate_data(superblock->get(), &sindex_block);
+        response->response = truncate_response_t();
+    }
+
     rdb_write_visitor_t(btree_slice_t *_btree,
                         store_t *_store,
                         txn_t *_txn,
@@ -855,6 +1039,8 @@ void store_t::protocol_write(const write_t &write,
                              state_timestamp_t timestamp,
                              scoped_ptr_t<superblock_t> *superblock,
                              signal_t *interruptor) {
+    auto record_load = [&](const store_key_t &key) { load_sampler.record(key); };
+    for_each_write_key(write, &record_load);
     scoped_ptr_t<profile::trace_t> trace = ql::maybe_make_profile_trace(write.profile);
 
     {
@@ -922,27 +1108,55 @@ private:
     DISABLE_COPYING(rdb_backfill_callback_impl_t);
 };
 
+// Backfills the key ranges of `ranges[i]` one after another.
 void call_rdb_backfill(int i, btree_slice_t *btree,
-                       const std::vector<std::pair<region_t, state_timestamp_t> > &regions,
+                       const std::vector<std::pair<std::vector<key_range_t>,
+                                                   state_timestamp_t> > &ranges,
                        rdb_backfill_callback_t *callback,
                        superblock_t *superblock,
                        buf_lock_t *sindex_block,
                        traversal_progress_combiner_t *progress,
                        signal_t *interruptor) THROWS_NOTHING {
-    parallel_traversal_progress_t *p = new parallel_traversal_progress_t;
-    scoped_ptr_t<traversal_progress_t> p_owned(p);
-    progress->add_constituent(&p_owned);
-    repli_timestamp_t timestamp = regions[i].second.to_repli_timestamp();
+    repli_timestamp_t timestamp = ranges[i].second.to_repli_timestamp();
     try {
-        rdb_backfill(btree, regions[i].first.inner, timestamp, callback,
-                     superblock, sindex_block, p, interruptor);
+        for (const key_range_t &range : ranges[i].first) {
+            parallel_traversal_progress_t *p = new parallel_traversal_progress_t;
+            scoped_ptr_t<traversal_progress_t> p_owned(p);
+            progress->add_constituent(&p_owned);
+            rdb_backfill(btree, range, timestamp, callback,
+                         superblock, sindex_block, p, interruptor);
+        }
     } catch (const interrupted_exc_t &) {
         /* do nothing; `protocol_send_backfill()` will notice that interruptor
         has been pulsed */
     }
 }
 
+/* The ranges of `digests` where the backfiller's rows differ, with neighbors
+merged. */
+static std::vector<key_range_t> differing_backfill_ranges(
+        superblock_t *superblock, const backfill_digests_t &digests) {
+    backfill_digests_t own;
+    rdb_backfill_digests_of_ranges(superblock, digests, release_superblock_t::KEEP,
+                                   &own);
+    std::vector<key_range_t> differing;
+    for (size_t i = 0; i < digests.digests.size(); ++i) {
+        if (own.digests[i] == digests.digests[i]) {
+            continue;
+        }
+        const key_range_t range = digests.range(i);
+        if (!differing.empty() && !differing.back().right.unbounded
+                && differing.back().right.key == range.left) {
+            differing.back().right = range.right;
+        } else {
+            differing.push_back(range);
+        }
+    }
+    return differing;
+}
+
 void store_t::protocol_send_backfill(const region_map_t<state_timestamp_t> &start_point,
+                                     const backfill_digests_t *digests,
                                      chunk_fun_callback_t *chunk_fun_cb,
                                      superblock_t *superblock,
                                      buf_lock_t *sindex_block,
@@ -951,12 +1165,47 @@ void store_t::protocol_send_backfill(const region_map_t<state_timestamp_t> &star
     THROWS_ONLY(interrupted_exc_t) {
     with_priority_t p(CORO_PRIORITY_BACKFILL_SENDER);
     rdb_backfill_callback_impl_t callback(chunk_fun_cb);
-    std::vector<std::pair<region_t, state_timestamp_t> > regions(start_point.begin(), start_point.end());
-    refcount_superblock_t refcount_wrapper(superblock, regions.size());
-    pmap(regions.size(), std::bind(&call_rdb_backfill, ph::_1,
-                                   btree.get(), regions, &callback,
-                                   &refcount_wrapper, sindex_block, progress,
-                                   interruptor));
+
+    /* If the backfillee sent digests of the region, only the ranges where our
+    snapshot differs get backfilled.  They're read from the same snapshot the
+    backfill is, so the ranges that match were already equal at the end point. */
+    boost::optional<std::vector<key_range_t> > differing;
+    if (digests != NULL && !digests->empty()
+            && digests->region == start_point.get_domain()) {
+        differing = differing_backfill_ranges(superblock, *digests);
+    }
+
+    std::vector<std::pair<std::vector<key_range_t>, state_timestamp_t> > ranges;
+    size_t num_ranges = 0;
+    for (const auto &pair : start_point) {
+        std::vector<key_range_t> region_ranges;
+        if (!differing) {
+            region_ranges.push_back(pair.first.inner);
+        } else {
+            for (const key_range_t &range : *differing) {
+                key_range_t ixn = range.intersection(pair.first.inner);
+                if (!ixn.is_empty()) {
+                    region_ranges.push_back(ixn);
+                }
+            }
+        }
+        num_ranges += region_ranges.size();
+        ranges.push_back(std::make_pair(std::move(region_ranges), pair.second));
+    }
+
+    if (num_ranges == 0) {
+        /* Every row matched, but the backfillee still needs our secondary
+        indexes. */
+        rdb_backfill_sindexes(btree.get(), &callback, sindex_block, interruptor);
+        return;
+    }
+
+    // Each range's traversal releases the superblock once.
+    refcount_superblock_t refcount_wrapper(superblock, num_ranges);
+    pmap(ranges.size(), std::bind(&call_rdb_backfill, ph::_1,
+                                  btree.get(), ranges, &callback,
+                                  &refcount_wrapper, sindex_block, progress,
+                                  interruptor));
 
     /* If interruptor was pulsed, `call_rdb_backfill()` exited silently, so we
     have to check directly. */
@@ -970,13 +1219,14 @@ void backfill_chunk_single_rdb_set(const backfill_atom_t &bf_atom,
                                    UNUSED auto_drainer_t::lock_t drainer_acq,
                                    rdb_modification_report_t *mod_report_out,
                                    promise_t<superblock_t *> *superblock_promise_out) {
-    mod_report_out->primary_key = bf_atom.key;
-    point_write_response_t response;
+    if (mod_report_out != NULL) {
+        mod_report_out->primary_key = bf_atom.key;
+    }
     rdb_live_deletion_context_t deletion_context;
-    rdb_set(bf_atom.key, bf_atom.value, true,
-            btree, bf_atom.recency, superblock, &deletion_context, &response,
-            &mod_report_out->info, static_cast<profile::trace_t *>(NULL),
-            superblock_promise_out);
+    rdb_set_serialized(bf_atom.key, bf_atom.value,
+                       btree, bf_atom.recency, superblock, &deletion_context,
+                       mod_report_out == NULL ? NULL : &mod_report_out->info,
+                       superblock_promise_out);
 }
 
 struct rdb_receive_backfill_visitor_t : public boost::static_visitor<void> {
@@ -1024,8 +1274,20 @@ struct rdb_receive_backfill_visitor_t : public boost::static_visitor<void> {
     }
 
     void operator()(const backfill_chunk_t::key_value_pairs_t &kv) {
-        std::vector<rdb_modification_report_t> mod_reports(kv.backfill_atoms.size());
-        {
+        // Only secondary indexes need the values themselves, so without any the
+        // values go into the tree the way they came.
+        std::map<sindex_name_t, secondary_index_t> sindexes;
+        get_secondary_indexes(&sindex_block, &sindexes);
+        const bool has_sindexes = !sindexes.empty();
+
+        std::vector<rdb_modification_report_t> mod_reports;
+        if (rdb_append_serialized(btree, kv.backfill_atoms, superblock.get(),
+                                  has_sindexes ? &mod_reports : NULL)) {
+            superblock.reset();
+        } else {
+            if (has_sindexes) {
+                mod_reports.resize(kv.backfill_atoms.size());
+            }
             auto_drainer_t drainer;
             for (size_t i = 0; i < kv.backfill_atoms.size(); ++i) {
                 promise_t<superblock_t *> superblock_promise;
@@ -1035,13 +1297,19 @@ struct rdb_receive_backfill_visitor_t : public boost::static_visitor<void> {
                                                         kv.backfill_atoms[i], btree,
                                                         superblock.release(),
                                                         auto_drainer_t::lock_t(&drainer),
-                                                        &mod_reports[i],
+                                                        has_sindexes
+                                                            ? &mod_reports[i]
+                                                            : NULL,
                                                         &superblock_promise));
                 superblock.init(superblock_promise.wait());
             }
             superblock.reset();
         }
-        update_sindexes(mod_reports);
+        if (has_sindexes) {
+            update_sindexes(mod_reports);
+        } else {
+            sindex_block.reset_buf_lock();
+        }
     }
 
     void operator()(const backfill_chunk_t::sindexes_t &s) {
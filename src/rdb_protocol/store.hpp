@@ -23,13 +23,17 @@
 #include "perfmon/perfmon.hpp"
 #include "protocol_api.hpp"
 #include "rdb_protocol/changefeed.hpp"
+#include "rdb_protocol/key_load_sampler.hpp"
 #include "rdb_protocol/protocol.hpp"
 #include "rpc/mailbox/typed.hpp"
 #include "store_view.hpp"
+#include "time.hpp"
 #include "utils.hpp"
 
 class store_t;
+class bloom_filter_t;
 class btree_slice_t;
+class cache_account_t;
 class cache_conn_t;
 class cache_t;
 class internal_disk_backed_queue_t;
@@ -129,6 +133,8 @@ public:
             signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t);
 
+    void prefetch_for_write(const write_t &write);
+
     void write(
             DEBUG_ONLY(const metainfo_checker_t& metainfo_checker, )
             const region_map_t<binary_blob_t>& new_metainfo,
@@ -201,6 +207,15 @@ public:
 
     progress_completion_fraction_t get_progress(uuid_u id);
 
+    /* Limits how many documents per second secondary index post construction reads
+    from this store. 0 means there is no limit. */
+    void set_index_build_rate(uint64_t docs_per_sec);
+
+    // Blocks until post construction may read `num_docs` more documents.  Callers
+    // are let through in the order they call this.
+    void throttle_index_build(size_t num_docs, signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t);
+
     MUST_USE bool add_sindex(
         const sindex_name_t &name,
         const std::vector<char> &opaque_definition,
@@ -233,6 +248,14 @@ public:
         buf_lock_t *sindex_block)
     THROWS_ONLY(interrupted_exc_t);
 
+    /* Replaces the primary B-tree and each of the secondary indexes with an empty
+    one, as part of the write transaction that `superblock` and `sindex_block` belong
+    to.  The old trees' blocks are freed in the background. */
+    void truncate_data(
+        superblock_t *superblock,
+        buf_lock_t *sindex_block)
+    THROWS_NOTHING;
+
     void update_outdated_sindex_list(buf_lock_t *sindex_block);
 
     MUST_USE bool acquire_sindex_superblock_for_read(
@@ -278,9 +301,13 @@ public:
             sindex_access_vector_t *sindex_sbs_out)
         THROWS_ONLY(sindex_not_ready_exc_t);
 
+    // If `has_sindexes_out` isn't NULL, it's set to whether there are any sindexes
+    // at all, including ones that are still being post constructed (and so get the
+    // mod reports through the sindex queue).
     void acquire_post_constructed_sindex_superblocks_for_write(
             buf_lock_t *sindex_block,
-            sindex_access_vector_t *sindex_sbs_out)
+            sindex_access_vector_t *sindex_sbs_out,
+            bool *has_sindexes_out = NULL)
     THROWS_NOTHING;
 
     bool acquire_sindex_superblocks_for_write(
@@ -304,6 +331,19 @@ public:
                        superblock_t *superblock,
                        signal_t *interruptor);
 
+    // Does `read` without acquiring the superblock if it's a point read for which
+    // that's possible (see `rdb_get_optimistically`), or for a key that the key
+    // filter excludes.  Returns false otherwise.
+    bool protocol_read_optimistically(const read_t &read,
+                                      read_response_t *response);
+
+    // Adds the primary keys that `write` might insert to the key filter.
+    void protocol_add_to_key_filter(const write_t &write);
+
+    // Loads the leaves that `write`'s primary keys are in, and the internal nodes on
+    // the way to them, into the cache.
+    void protocol_prefetch_for_write(const write_t &write);
+
     void protocol_write(const write_t &write,
                         write_response_t *response,
                         state_timestamp_t timestamp,
@@ -311,6 +351,7 @@ public:
                         signal_t *interruptor);
 
     void protocol_send_backfill(const region_map_t<state_timestamp_t> &start_point,
+                                const backfill_digests_t *digests,
                                 chunk_fun_callback_t *chunk_fun_cb,
                                 superblock_t *superblock,
                                 buf_lock_t *sindex_block,
@@ -363,7 +404,14 @@ private:
             secondary_index_t sindex,
             auto_drainer_t::lock_t store_keepalive)
             THROWS_NOTHING;
-    // Internally called by `delayed_clear_sindex()`
+    // Frees the blocks of a primary B-tree that `truncate_data()` replaced.  To be
+    // run in a coroutine.
+    void delayed_clear_truncated_data(
+            secondary_index_t truncated,
+            auto_drainer_t::lock_t store_keepalive)
+            THROWS_NOTHING;
+    // Internally called by `delayed_clear_sindex()` and
+    // `delayed_clear_truncated_data()`
     void clear_sindex(
             secondary_index_t sindex,
             value_sizer_t *sizer,
@@ -373,11 +421,43 @@ private:
 
     void help_construct_bring_sindexes_up_to_date();
 
+    // Builds a new key filter out of the keys in the primary B-tree, and then
+    // replaces `key_filter` with it.  To be run in a coroutine.
+    void build_key_filter(auto_drainer_t::lock_t store_keepalive) THROWS_NOTHING;
+
+    // Rewrites the nodes of the primary B-tree and then of each secondary index in
+    // key order (see `btree_compact_nodes`), a few leaves per write transaction.  To
+    // be run in a coroutine.
+    void compact(auto_drainer_t::lock_t store_keepalive) THROWS_NOTHING;
+    // Compacts the primary B-tree if `sindex_id` is empty, and sets
+    // `*population_out` to its number of keys.
+    void compact_btree(const boost::optional<uuid_u> &sindex_id,
+                       cache_account_t *cache_account,
+                       int64_t *population_out,
+                       signal_t *interruptor)
+            THROWS_ONLY(interrupted_exc_t);
+
     MUST_USE bool mark_secondary_index_deleted(
             buf_lock_t *sindex_block,
             const sindex_name_t &name);
 
 public:
+    // The key filter is a Bloom filter of the keys in the primary B-tree, so that
+    // point reads can tell that a key doesn't exist without descending the tree.
+    // Writes add their keys to it before they're ordered against the reads that come
+    // after them.  Keys that were deleted stay in it, so it's rebuilt once the
+    // number of keys added to it exceeds what it was sized for.
+    void add_to_key_filter(const store_key_t &key);
+    // True if `key` definitely isn't in the primary B-tree.
+    bool key_filter_excludes(const store_key_t &key) const;
+
+    // Point reads and writes, and the first keys of range reads, get sampled so that
+    // distribution reads can report the load on each part of the key space.
+    void get_key_load(const key_range_t &range,
+                      std::map<store_key_t, int64_t> *load_out) const {
+        load_sampler.get_load(range, load_out);
+    }
+
     void check_and_update_metainfo(
         DEBUG_ONLY(const metainfo_checker_t &metainfo_checker, )
         const region_map_t<binary_blob_t> &new_metainfo,
@@ -398,6 +478,9 @@ public:
     typedef std::map<uuid_u, std::pair<microtime_t, std::string> > sindex_jobs_t;
     sindex_jobs_t *get_sindex_jobs();
 
+    // When the running compaction started, or 0 if there isn't one.
+    microtime_t get_compaction_start_time() const { return compaction_start_time; }
+
     fifo_enforcer_source_t main_token_source, sindex_token_source;
     fifo_enforcer_sink_t main_token_sink, sindex_token_sink;
 
@@ -429,6 +512,26 @@ private:
 
     sindex_jobs_t sindex_jobs;
 
+    // Empty until the first one has been built.
+    scoped_ptr_t<bloom_filter_t> key_filter;
+    // The next key filter, while `build_key_filter` is building it.
+    scoped_ptr_t<bloom_filter_t> next_key_filter;
+    // Whether `build_key_filter` has been spawned and hasn't finished yet.
+    bool building_key_filter;
+
+    // The keys written since the last compaction was started, and how many it takes
+    // to start the next one.
+    uint64_t keys_written_since_compaction;
+    uint64_t keys_written_before_compaction;
+    microtime_t compaction_start_time;
+
+    key_load_sampler_t load_sampler;
+
+    uint64_t index_build_rate;
+    // When the documents post construction has been let through so far will have
+    // been read, at `index_build_rate`.
+    microtime_t index_build_next_time;
+
 public:
     // This lock is used to pause backfills while secondary indexes are being
     // post constructed. Secondary index post construction gets in line for a write
@@ -1,6 +1,8 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/stream_cache.hpp"
 
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/interruptor.hpp"
 #include "rdb_protocol/env.hpp"
 
 #include "debug.hpp"
@@ -32,7 +34,8 @@ void stream_cache_t::erase(int64_t key) {
     guarantee(num_erased == 1);
 }
 
-bool stream_cache_t::serve(int64_t key, Response *res, signal_t *interruptor) {
+bool stream_cache_t::serve(int64_t key, Response *res, signal_t *interruptor,
+                           query_resources_t *resources) {
     std::map<int64_t, scoped_ptr_t<entry_t> >::iterator it = streams.find(key);
     if (it == streams.end()) {
         return false;
@@ -45,18 +48,40 @@ bool stream_cache_t::serve(int64_t key, Response *res, signal_t *interruptor) {
         scoped_ptr_t<profile::trace_t> trace = maybe_make_profile_trace(entry->profile);
 
         env_t env(rdb_ctx, interruptor, entry->global_optargs, trace.get_or_null());
-
-        batch_type_t batch_type = entry->has_sent_batch
-                                      ? batch_type_t::NORMAL
-                                      : batch_type_t::NORMAL_FIRST;
-        std::vector<datum_t> ds
-            = entry->stream->next_batch(
-                &env,
-                batchspec_t::user(batch_type, &env));
+        env.set_query_resources(resources);
+
+        const microtime_t requested_time = current_microtime();
+        microtime_t start_time, end_time;
+        std::vector<datum_t> ds;
+        if (entry->prefetch_done.has()) {
+            wait_interruptible(entry->prefetch_done.get(), interruptor);
+            entry->prefetch_done.reset();
+            if (entry->prefetch_exc) {
+                std::rethrow_exception(entry->prefetch_exc);
+            }
+            ds = std::move(entry->prefetched);
+            entry->prefetched.clear();
+            start_time = entry->prefetch_start;
+            end_time = entry->prefetch_end;
+        } else {
+            batch_type_t batch_type = entry->has_sent_batch
+                                          ? batch_type_t::NORMAL
+                                          : batch_type_t::NORMAL_FIRST;
+            batchspec_t batchspec = batchspec_t::user(batch_type, &env);
+            // We leave the limits alone if the user picked them.
+            if (!batchspec_t::user_set_limits(&env)) {
+                batchspec = entry->batch_tuner.tune(batchspec);
+            }
+            start_time = requested_time;
+            ds = entry->stream->next_batch(&env, batchspec);
+            end_time = current_microtime();
+        }
         entry->has_sent_batch = true;
         for (auto d = ds.begin(); d != ds.end(); ++d) {
             d->write_to_protobuf(res->add_response(), entry->use_json);
         }
+        entry->batch_tuner.note_batch(requested_time, start_time, end_time,
+                                      ds.size(), res->ByteSize());
         if (trace.has()) {
             trace->as_datum().write_to_protobuf(
                 res->mutable_profile(), entry->use_json);
@@ -82,10 +107,50 @@ bool stream_cache_t::serve(int64_t key, Response *res, signal_t *interruptor) {
         res->set_type(Response::SUCCESS_SEQUENCE);
     } else {
         res->set_type(cfeed ? Response::SUCCESS_FEED : Response::SUCCESS_PARTIAL);
+        // Reading a changefeed ahead would only wait for changes the client may
+        // never ask for, and a profile is only for the batch it comes with.
+        if (!cfeed && entry->profile == profile_bool_t::DONT_PROFILE) {
+            start_prefetch(entry);
+        }
     }
     return true;
 }
 
+void stream_cache_t::start_prefetch(entry_t *entry) {
+    guarantee(!entry->prefetch_done.has());
+    // We build the batchspec here rather than in the coroutine, which doesn't have
+    // the caller's environment.  Only one batch gets read ahead, so the memory it
+    // takes is bounded by the batch size limit.
+    batchspec_t batchspec = batchspec_t::empty();
+    {
+        env_t env(rdb_ctx, entry->drainer.get_drain_signal(), entry->global_optargs,
+                  nullptr);
+        batchspec = batchspec_t::user(batch_type_t::NORMAL, &env);
+        if (!batchspec_t::user_set_limits(&env)) {
+            batchspec = entry->batch_tuner.tune(batchspec);
+        }
+    }
+    entry->prefetch_done.init(new cond_t());
+    entry->prefetch_exc = std::exception_ptr();
+    coro_t::spawn_sometime(std::bind(&stream_cache_t::do_prefetch, rdb_ctx, entry,
+                                     batchspec, auto_drainer_t::lock_t(
+                                         &entry->drainer)));
+}
+
+void stream_cache_t::do_prefetch(rdb_context_t *rdb_ctx, entry_t *entry,
+                                 batchspec_t batchspec,
+                                 auto_drainer_t::lock_t lock) {
+    entry->prefetch_start = current_microtime();
+    try {
+        env_t env(rdb_ctx, lock.get_drain_signal(), entry->global_optargs, nullptr);
+        entry->prefetched = entry->stream->next_batch(&env, batchspec);
+    } catch (const std::exception &) {
+        entry->prefetch_exc = std::current_exception();
+    }
+    entry->prefetch_end = current_microtime();
+    entry->prefetch_done->pulse();
+}
+
 void stream_cache_t::maybe_evict() {
     // We never evict right now.
 }
@@ -101,7 +166,9 @@ stream_cache_t::entry_t::entry_t(time_t _last_activity,
       profile(_profile),
       stream(_stream),
       max_age(DEFAULT_MAX_AGE),
-      has_sent_batch(false) { }
+      has_sent_batch(false),
+      prefetch_start(0),
+      prefetch_end(0) { }
 
 stream_cache_t::entry_t::~entry_t() { }
 
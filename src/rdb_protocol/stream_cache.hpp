@@ -4,14 +4,21 @@
 
 #include <time.h>
 
+#include <exception>
 #include <map>
 #include <string>
+#include <vector>
 
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
 #include "concurrency/signal.hpp"
 #include "containers/scoped.hpp"
+#include "rdb_protocol/batching.hpp"
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/ql2.pb.h"
 
+class query_resources_t;
+
 namespace ql {
 class env_t;
 }
@@ -34,9 +41,18 @@ public:
                 profile_bool_t profile_requested,
                 counted_t<datum_stream_t> val_stream);
     void erase(int64_t key);
-    MUST_USE bool serve(int64_t key, Response *res, signal_t *interruptor);
+    // The rows read for the batch are charged to `resources`, which may be `NULL`.
+    MUST_USE bool serve(int64_t key, Response *res, signal_t *interruptor,
+                        query_resources_t *resources);
 private:
+    struct entry_t;
+
     void maybe_evict();
+    // Starts reading the next batch of `entry`'s stream, for `serve` to send when
+    // the client asks for it.
+    void start_prefetch(entry_t *entry);
+    static void do_prefetch(rdb_context_t *rdb_ctx, entry_t *entry,
+                            batchspec_t batchspec, auto_drainer_t::lock_t lock);
 
     struct entry_t {
         ~entry_t();
@@ -53,6 +69,16 @@ private:
         counted_t<datum_stream_t> stream;
         time_t max_age;
         bool has_sent_batch;
+        batch_tuner_t batch_tuner;
+
+        // Set while there's a batch being read ahead, and pulsed once it's been
+        // read (into `prefetched`) or failed (with `prefetch_exc`).
+        scoped_ptr_t<cond_t> prefetch_done;
+        std::vector<datum_t> prefetched;
+        std::exception_ptr prefetch_exc;
+        microtime_t prefetch_start, prefetch_end;
+        // Interrupts the read ahead, and waits for it, when the entry goes away.
+        auto_drainer_t drainer;
     private:
         DISABLE_COPYING(entry_t);
     };
@@ -9,6 +9,8 @@
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/prepared_queries.hpp"
+#include "rdb_protocol/result_cache.hpp"
 #include "rdb_protocol/stream_cache.hpp"
 #include "rdb_protocol/term_walker.hpp"
 #include "rdb_protocol/validate.hpp"
@@ -115,6 +117,7 @@ counted_t<const term_t> compile_term(compile_env_t *env, protob_t<const Term> t)
     case Term::RECONFIGURE:        return make_reconfigure_term(env, t);
     case Term::REBALANCE:          return make_rebalance_term(env, t);
     case Term::SYNC:               return make_sync_term(env, t);
+    case Term::TRUNCATE:           return make_truncate_term(env, t);
     case Term::INDEX_CREATE:       return make_sindex_create_term(env, t);
     case Term::INDEX_DROP:         return make_sindex_drop_term(env, t);
     case Term::INDEX_LIST:         return make_sindex_list_term(env, t);
@@ -200,10 +203,106 @@ counted_t<const term_t> compile_term(compile_env_t *env, protob_t<const Term> t)
     unreachable();
 }
 
+namespace {
+
+// Appends a compact rendering of `t` for `rethinkdb.slow_queries` to `out`, in the
+// `[TYPE, [args...], {optargs...}]` form that the drivers send but with the term
+// types spelled out. It stops descending once `out` is long enough to be cut off.
+void print_term_for_slow_query_log(const Term &t, std::string *out) {
+    if (out->size() >= SLOW_QUERY_MAX_QUERY_SIZE) {
+        return;
+    }
+    if (t.type() == Term::DATUM) {
+        try {
+            out->append(to_datum(&t.datum(), configured_limits_t::unlimited,
+                                 reql_version_t::LATEST).print());
+        } catch (const base_exc_t &) {
+            out->append("DATUM");
+        }
+        return;
+    }
+    out->append("[" + Term::TermType_Name(t.type()));
+    if (t.args_size() != 0 || t.optargs_size() != 0) {
+        out->append(", [");
+        for (int i = 0; i < t.args_size(); ++i) {
+            out->append(i == 0 ? "" : ", ");
+            print_term_for_slow_query_log(t.args(i), out);
+        }
+        out->append("]");
+    }
+    if (t.optargs_size() != 0) {
+        out->append(", {");
+        for (int i = 0; i < t.optargs_size(); ++i) {
+            out->append(i == 0 ? "\"" : ", \"");
+            out->append(t.optargs(i).key() + "\": ");
+            print_term_for_slow_query_log(t.optargs(i).val(), out);
+        }
+        out->append("}");
+    }
+    out->append("]");
+}
+
+/* Records the query in the slow query history of `rdb_context_t` when it goes out
+of scope, if it took at least `--slow-query-threshold`. */
+class slow_query_sentry_t {
+public:
+    slow_query_sentry_t(rdb_context_t *_ctx,
+                        const uuid_u &_id,
+                        microtime_t _start_time,
+                        const ip_and_port_t &_client_addr_port,
+                        const query_resources_t *_resources,
+                        const Term *_term,
+                        const profile::trace_t *_trace)
+        : ctx(_ctx), id(_id), start_time(_start_time),
+          client_addr_port(_client_addr_port), resources(_resources),
+          term(_term), trace(_trace) { }
+
+    ~slow_query_sentry_t() {
+        const microtime_t now = current_microtime();
+        const microtime_t duration = now - std::min(start_time, now);
+        if (ctx->slow_query_threshold_ms == 0
+            || duration < static_cast<microtime_t>(ctx->slow_query_threshold_ms)
+                          * THOUSAND) {
+            return;
+        }
+
+        std::string query;
+        print_term_for_slow_query_log(*term, &query);
+        if (query.size() > SLOW_QUERY_MAX_QUERY_SIZE) {
+            query.resize(SLOW_QUERY_MAX_QUERY_SIZE);
+            query.append("...");
+        }
+        ctx->record_slow_query(slow_query_t(
+            id,
+            start_time,
+            duration,
+            client_addr_port,
+            resources->run_ticks.load() / static_cast<double>(THOUSAND),
+            static_cast<double>(resources->rows_read.load()),
+            query,
+            trace != nullptr ? trace->as_datum() : datum_t()));
+    }
+
+private:
+    rdb_context_t *ctx;
+    uuid_u id;
+    microtime_t start_time;
+    ip_and_port_t client_addr_port;
+    const query_resources_t *resources;
+    const Term *term;
+    const profile::trace_t *trace;
+
+    DISABLE_COPYING(slow_query_sentry_t);
+};
+
+}  // namespace
+
 void run(protob_t<Query> q,
          rdb_context_t *ctx,
          signal_t *interruptor,
          stream_cache_t *stream_cache,
+         prepared_queries_t *prepared_queries,
+         result_cache_t *result_cache,
          ip_and_port_t const &peer,
          Response *res) {
     try {
@@ -224,21 +323,58 @@ void run(protob_t<Query> q,
 #endif // INSTRUMENT
 
     cond_t job_interruptor;
+    query_resources_t resources;
+    scoped_coro_run_time_account_t run_time_account(&resources.run_ticks);
+    const uuid_u job_id = generate_uuid();
+    const microtime_t start_time = current_microtime();
     map_insertion_sentry_t<uuid_u, query_job_t> job_sentry(
         ctx->get_query_jobs_for_this_thread(),
-        generate_uuid(),
-        query_job_t(current_microtime(), peer, &job_interruptor));
+        job_id,
+        query_job_t(start_time, peer, &resources, &job_interruptor));
 
     int64_t token = q->token();
-    use_json_t use_json = q->accepts_r_json() ? use_json_t::YES : use_json_t::NO;
+    use_json_t use_json = q->accepts_r_serialized()
+        ? use_json_t::SERIALIZED
+        : (q->accepts_r_json() ? use_json_t::YES : use_json_t::NO);
 
     wait_any_t combined_interruptor(interruptor, &job_interruptor);
 
     switch (q->type()) {
-    case Query_QueryType_START: {
+    case Query_QueryType_START: // fallthru
+    case Query_QueryType_EXECUTE: {
         const profile_bool_t profile = profile_bool_optarg(q);
-        const scoped_ptr_t<profile::trace_t> trace = maybe_make_profile_trace(profile);
+        // Some queries get an aggregate profile even though the client didn't ask
+        // for it, so that the slow query log has profiles to show. Their profile
+        // isn't sent.
+        const bool sample_profile = profile == profile_bool_t::DONT_PROFILE
+            && ctx->slow_query_threshold_ms != 0
+            && randint(SLOW_QUERY_PROFILE_SAMPLE_RATE) == 0;
+        const scoped_ptr_t<profile::trace_t> trace = maybe_make_profile_trace(
+            sample_profile ? profile_bool_t::AGGREGATE : profile);
+        const bool send_profile = profile != profile_bool_t::DONT_PROFILE;
         env_t env(ctx, &combined_interruptor, global_optargs(q), trace.get_or_null());
+        env.set_query_resources(&resources);
+        slow_query_sentry_t slow_query_sentry(ctx, job_id, start_time, peer,
+                                              &resources, &q->query(),
+                                              trace.get_or_null());
+
+        // Profiled queries are always run, so that the profile is real.
+        std::string cache_key;
+        const bool use_result_cache = q->type() == Query_QueryType_START
+            && trace.get_or_null() == nullptr
+            && result_cache_t::get_key(*q, &cache_key);
+        if (use_result_cache && !stream_cache->contains(token)) {
+            datum_t cached = result_cache->get(cache_key);
+            if (cached.has()) {
+                res->set_type(Response::SUCCESS_ATOM);
+                cached.write_to_protobuf(res->add_response(), use_json);
+                return;
+            }
+        }
+        result_cache_t::recording_t cache_recording(result_cache);
+        if (use_result_cache) {
+            env.set_result_cache_recording(&cache_recording);
+        }
 
         counted_t<const term_t> root_term;
         try {
@@ -253,10 +389,23 @@ void run(protob_t<Query> q,
             return;
         }
 
+        // For an `EXECUTE` query, `root_term` is the array of the prepared query's
+        // id and the arguments to call it with.
+        counted_t<const func_t> prepared_func;
         try {
             rcheck_toplevel(!stream_cache->contains(token),
                             base_exc_t::GENERIC,
                             strprintf("ERROR: duplicate token %" PRIi64, token));
+            if (q->type() == Query_QueryType_EXECUTE) {
+                const double id = q->query().args(0).datum().r_num();
+                if (id >= 1 && id <= static_cast<double>(INT32_MAX)
+                    && id == static_cast<double>(static_cast<int64_t>(id))) {
+                    prepared_func = prepared_queries->get(static_cast<int64_t>(id));
+                }
+                rcheck_toplevel(prepared_func.has(), base_exc_t::GENERIC,
+                                strprintf("No prepared query with id %g on this "
+                                          "connection.", id));
+            }
         } catch (const exc_t &e) {
             fill_error(res, Response::CLIENT_ERROR, e.what(), e.backtrace());
             return;
@@ -267,12 +416,26 @@ void run(protob_t<Query> q,
 
         try {
             scope_env_t scope_env(&env, var_scope_t());
-            scoped_ptr_t<val_t> val = root_term->eval(&scope_env);
+            scoped_ptr_t<val_t> val;
+            if (prepared_func.has()) {
+                const datum_t args = root_term->eval(&scope_env)->as_datum();
+                std::vector<datum_t> func_args;
+                func_args.reserve(args.arr_size() - 1);
+                for (size_t i = 1; i < args.arr_size(); ++i) {
+                    func_args.push_back(args.get(i));
+                }
+                val = prepared_func->call(&env, func_args);
+            } else {
+                val = root_term->eval(&scope_env);
+            }
             if (val->get_type().is_convertible(val_t::type_t::DATUM)) {
                 res->set_type(Response::SUCCESS_ATOM);
                 datum_t d = val->as_datum();
                 d.write_to_protobuf(res->add_response(), use_json);
-                if (trace.has()) {
+                if (use_result_cache) {
+                    result_cache->insert(cache_key, cache_recording, d);
+                }
+                if (send_profile) {
                     trace->as_datum().write_to_protobuf(
                         res->mutable_profile(), use_json);
                 }
@@ -283,7 +446,10 @@ void run(protob_t<Query> q,
                                                               env.reql_version(),
                                                               env.limits());
                 d.write_to_protobuf(res->add_response(), use_json);
-                if (env.trace != nullptr) {
+                if (use_result_cache) {
+                    result_cache->insert(cache_key, cache_recording, d);
+                }
+                if (send_profile) {
                     env.trace->as_datum().write_to_protobuf(
                         res->mutable_profile(), use_json);
                 }
@@ -293,7 +459,10 @@ void run(protob_t<Query> q,
                 if (arr.has()) {
                     res->set_type(Response::SUCCESS_ATOM);
                     arr.write_to_protobuf(res->add_response(), use_json);
-                    if (trace.has()) {
+                    if (use_result_cache) {
+                        result_cache->insert(cache_key, cache_recording, arr);
+                    }
+                    if (send_profile) {
                         trace->as_datum().write_to_protobuf(
                             res->mutable_profile(), use_json);
                     }
@@ -303,7 +472,8 @@ void run(protob_t<Query> q,
                                          env.get_all_optargs(),
                                          profile,
                                          seq);
-                    bool b = stream_cache->serve(token, res, &combined_interruptor);
+                    bool b = stream_cache->serve(token, res, &combined_interruptor,
+                                                 &resources);
                     r_sanity_check(b);
                 }
             } else {
@@ -327,7 +497,8 @@ void run(protob_t<Query> q,
     } break;
     case Query_QueryType_CONTINUE: {
         try {
-            bool b = stream_cache->serve(token, res, &combined_interruptor);
+            bool b = stream_cache->serve(token, res, &combined_interruptor,
+                                         &resources);
             if (!b) {
                 auto err = strprintf("Token %" PRIi64 " not in stream cache.", token);
                 fill_error(res, Response::CLIENT_ERROR, err, backtrace_t());
@@ -356,6 +527,22 @@ void run(protob_t<Query> q,
             return;
         }
     } break;
+    case Query_QueryType_PREPARE: {
+        try {
+            Term *t = q->mutable_query();
+            preprocess_term(t);
+            const int64_t id = prepared_queries->prepare(q.make_child(t));
+            res->set_type(Response::SUCCESS_ATOM);
+            datum_t(static_cast<double>(id)).write_to_protobuf(res->add_response(),
+                                                               use_json);
+        } catch (const exc_t &e) {
+            fill_error(res, Response::COMPILE_ERROR, e.what(), e.backtrace());
+            return;
+        } catch (const datum_exc_t &e) {
+            fill_error(res, Response::COMPILE_ERROR, e.what(), backtrace_t());
+            return;
+        }
+    } break;
     case Query_QueryType_NOREPLY_WAIT: {
         try {
             rcheck_toplevel(!stream_cache->contains(token),
@@ -370,9 +557,10 @@ void run(protob_t<Query> q,
         }
 
         // NOREPLY_WAIT is just a no-op.
-        // This works because we only evaluate one Query at a time
-        // on the connection level. Once we get to the NOREPLY_WAIT Query
-        // we know that all previous Queries have completed processing.
+        // This works because the connection doesn't run a NOREPLY_WAIT Query
+        // alongside any other Query (see `query_pipeline_t`). Once we get to
+        // the NOREPLY_WAIT Query we know that all previous Queries have
+        // completed processing.
 
         // Send back a WAIT_COMPLETE response.
         res->set_type(Response::WAIT_COMPLETE);
@@ -419,7 +607,9 @@ void term_t::prop_bt(Term *t) const {
 
 scoped_ptr_t<val_t> runtime_term_t::eval(scope_env_t *env, eval_flags_t eval_flags) const {
     // This is basically a hook for unit tests to change things mid-query
-    profile::starter_t starter(strprintf("Evaluating %s.", name()), env->env->trace);
+    profile::starter_t starter(
+        env->env->trace != nullptr ? strprintf("Evaluating %s.", name()) : std::string(),
+        env->env->trace);
     DEBUG_ONLY_CODE(env->env->do_eval_callback());
     DBG("EVALUATING %s (%d):\n", name(), is_deterministic());
     if (env->env->interruptor->is_pulsed()) {
@@ -112,6 +112,7 @@ private:
         case Term::RECONFIGURE:
         case Term::REBALANCE:
         case Term::SYNC:
+        case Term::TRUNCATE:
         case Term::INDEX_CREATE:
         case Term::INDEX_DROP:
         case Term::INDEX_WAIT:
@@ -383,6 +384,7 @@ private:
         case Term::RECONFIGURE:
         case Term::REBALANCE:
         case Term::SYNC:
+        case Term::TRUNCATE:
         case Term::INDEX_CREATE:
         case Term::INDEX_DROP:
         case Term::INDEX_LIST:
@@ -9,10 +9,22 @@
 
 namespace ql {
 
+template <Term_TermType type>
+double num_op(double lhs, double rhs);
+template <>
+double num_op<Term::ADD>(double lhs, double rhs) { return lhs + rhs; }
+template <>
+double num_op<Term::SUB>(double lhs, double rhs) { return lhs - rhs; }
+template <>
+double num_op<Term::MUL>(double lhs, double rhs) { return lhs * rhs; }
+template <>
+double num_op<Term::DIV>(double lhs, double rhs) { return lhs / rhs; }
+
 class arith_term_t : public op_term_t {
 public:
     arith_term_t(compile_env_t *env, const protob_t<const Term> &term)
-        : op_term_t(env, term, argspec_t(1, -1)), namestr(0), op(0) {
+        : op_term_t(env, term, argspec_t(1, -1)), namestr(0), op(0),
+          literal_num_op(nullptr) {
         int arithtype = term->type();
         switch (arithtype) {
         case Term_TermType_ADD: namestr = "ADD"; op = &arith_term_t::add; break;
@@ -22,9 +34,42 @@ public:
         default: unreachable();
         }
         guarantee(namestr && op);
+
+        // Something like `row('n').add(1)`, in a function called on each row.
+        if (term->args_size() == 2) {
+            datum_t literal = literal_arg(1);
+            if (literal.has() && literal.get_type() == datum_t::R_NUM
+                && !(arithtype == Term_TermType_DIV && literal.as_num() == 0)) {
+                rhs_literal = literal;
+                switch (arithtype) {
+                case Term_TermType_ADD: literal_num_op = &num_op<Term::ADD>; break;
+                case Term_TermType_SUB: literal_num_op = &num_op<Term::SUB>; break;
+                case Term_TermType_MUL: literal_num_op = &num_op<Term::MUL>; break;
+                case Term_TermType_DIV: literal_num_op = &num_op<Term::DIV>; break;
+                default: unreachable();
+                }
+            } else if (literal.has() && literal.get_type() == datum_t::R_STR
+                       && arithtype == Term_TermType_ADD) {
+                rhs_literal = literal;
+            }
+        }
     }
 
     virtual scoped_ptr_t<val_t> eval_impl(scope_env_t *env, args_t *args, eval_flags_t) const {
+        if (rhs_literal.has()) {
+            // The literal isn't evaluated, and if the other argument has the same
+            // type, neither are the checks for all the other types.
+            datum_t lhs = args->arg(env, 0)->as_datum();
+            if (lhs.get_type() != rhs_literal.get_type()) {
+                return new_val((this->*op)(lhs, rhs_literal, env->env->limits()));
+            } else if (literal_num_op != nullptr) {
+                // throws on non-finite values
+                return new_val(datum_t(literal_num_op(lhs.as_num(),
+                                                      rhs_literal.as_num())));
+            } else {
+                return new_val(datum_t(concat(lhs.as_str(), rhs_literal.as_str())));
+            }
+        }
         datum_t acc = args->arg(env, 0)->as_datum();
         for (size_t i = 1; i < args->num_args(); ++i) {
             acc = (this->*op)(acc, args->arg(env, i)->as_datum(), env->env->limits());
@@ -117,6 +162,11 @@ private:
     datum_t (arith_term_t::*op)(datum_t lhs,
                                 datum_t rhs,
                                 const configured_limits_t &limits) const;
+
+    // Set if there are two arguments and the second one is a number literal (or,
+    // for `ADD`, a string literal).  `literal_num_op` is set if it's a number.
+    datum_t rhs_literal;
+    double (*literal_num_op)(double lhs, double rhs);
 };
 
 class mod_term_t : public op_term_t {
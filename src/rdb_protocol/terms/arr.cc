@@ -333,6 +333,10 @@ private:
         int32_t r = args->arg(env, 1)->as_int<int32_t>();
         rcheck(r >= 0, base_exc_t::GENERIC,
                strprintf("LIMIT takes a non-negative argument (got %d)", r));
+        // An in-memory `orderBy` only has to keep the first `r` elements.
+        if (auto sort_ds = dynamic_cast<unindexed_sort_datum_stream_t *>(ds.get())) {
+            sort_ds->limit(r);
+        }
         counted_t<datum_stream_t> new_ds = ds->slice(0, r);
         return t.has()
             ? new_val(make_counted<selection_t>(t, new_ds))
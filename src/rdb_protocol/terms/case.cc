@@ -1,35 +1,66 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/terms/terms.hpp"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/op.hpp"
 
 namespace ql {
 
+// The server runs in the "C" locale (see `utils.cc`), where `toupper` and
+// `tolower` only change ASCII letters, so that's all these do.  Bytes of non-ASCII
+// characters don't fall in either range and are copied unchanged.
+void change_case(const char *in, size_t size, char lo, char hi, char *out) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    // Bytes of 0x80 and above are negative as signed chars, so they never match.
+    const __m128i below = _mm_set1_epi8(lo - 1);
+    const __m128i above = _mm_set1_epi8(hi + 1);
+    const __m128i flip = _mm_set1_epi8(0x20);
+    for (; i + 16 <= size; i += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        const __m128i in_range = _mm_and_si128(_mm_cmpgt_epi8(chunk, below),
+                                               _mm_cmplt_epi8(chunk, above));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                         _mm_xor_si128(chunk, _mm_and_si128(in_range, flip)));
+    }
+#endif
+    for (; i < size; ++i) {
+        const char c = in[i];
+        out[i] = (c >= lo && c <= hi) ? (c ^ 0x20) : c;
+    }
+}
+
 class case_term_t : public op_term_t {
 public:
+    // Letters from `_lo` to `_hi` have their case changed.
     case_term_t(compile_env_t *env, const protob_t<const Term> &term,
-                const char *name, int (*_f)(int))
-        : op_term_t(env, term, argspec_t(1)), name_(name), f(_f) { }
+                const char *name, char _lo, char _hi)
+        : op_term_t(env, term, argspec_t(1)), name_(name), lo(_lo), hi(_hi) { }
 private:
     virtual scoped_ptr_t<val_t> eval_impl(scope_env_t *env, args_t *args, eval_flags_t) const {
-        std::string s = args->arg(env, 0)->as_str().to_std();
-        std::transform(s.begin(), s.end(), s.begin(), f);
-        return new_val(datum_t(datum_string_t(s)));
+        const datum_string_t s = args->arg(env, 0)->as_str();
+        std::string res(s.size(), '\0');
+        change_case(s.data(), s.size(), lo, hi, &res[0]);
+        return new_val(datum_t(datum_string_t(res)));
     }
     virtual const char *name() const { return name_; }
 
     const char *const name_;
-    int (*const f)(int);
+    const char lo;
+    const char hi;
 };
 
 counted_t<term_t> make_upcase_term(compile_env_t *env,
                                    const protob_t<const Term> &term) {
-    return make_counted<case_term_t>(env, term, "upcase", ::toupper);
+    return make_counted<case_term_t>(env, term, "upcase", 'a', 'z');
 }
 counted_t<term_t> make_downcase_term(compile_env_t *env,
                                      const protob_t<const Term> &term) {
-    return make_counted<case_term_t>(env, term, "downcase", ::tolower);
+    return make_counted<case_term_t>(env, term, "downcase", 'A', 'Z');
 }
 
 }  // namespace ql
@@ -123,7 +123,8 @@ class table_create_term_t : public meta_op_term_t {
 public:
     table_create_term_t(compile_env_t *env, const protob_t<const Term> &term) :
         meta_op_term_t(env, term, argspec_t(1, 2),
-            optargspec_t({"primary_key", "shards", "replicas", "primary_replica_tag"})) { }
+            optargspec_t({"primary_key", "shards", "replicas", "primary_replica_tag",
+                          "block_size", "compress_blocks"})) { }
 private:
     virtual scoped_ptr_t<val_t> eval_impl(
             scope_env_t *env, args_t *args, eval_flags_t) const {
@@ -148,6 +149,24 @@ private:
             primary_key = v->as_str().to_std();
         }
 
+        // Parse the 'block_size' optarg
+        uint32_t block_size = DEFAULT_BTREE_BLOCK_SIZE;
+        if (scoped_ptr_t<val_t> v = args->optarg(env, "block_size")) {
+            block_size = v->as_int<uint32_t>();
+            rcheck_target(v, block_size >= MIN_BTREE_BLOCK_SIZE
+                          && block_size <= MAX_BTREE_BLOCK_SIZE
+                          && (block_size & (block_size - 1)) == 0,
+                          base_exc_t::GENERIC,
+                          strprintf("`block_size` must be a power of two between "
+                                    "%d and %d.",
+                                    MIN_BTREE_BLOCK_SIZE, MAX_BTREE_BLOCK_SIZE));
+        }
+
+        bool compress_blocks = DEFAULT_TABLE_COMPRESS_BLOCKS;
+        if (scoped_ptr_t<val_t> v = args->optarg(env, "compress_blocks")) {
+            compress_blocks = v->as_bool();
+        }
+
         counted_t<const db_t> db;
         name_string_t tbl_name;
         if (args->num_args() == 1) {
@@ -164,7 +183,8 @@ private:
         std::string error;
         ql::datum_t result;
         if (!env->env->reql_cluster_interface()->table_create(tbl_name, db,
-                config_params, primary_key, env->env->interruptor, &result, &error)) {
+                config_params, primary_key, block_size, compress_blocks,
+                env->env->interruptor, &result, &error)) {
             rfail(base_exc_t::GENERIC, "%s", error.c_str());
         }
         return new_val(result);
@@ -549,6 +569,26 @@ private:
     virtual const char *name() const { return "sync"; }
 };
 
+class truncate_term_t : public meta_op_term_t {
+public:
+    truncate_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : meta_op_term_t(env, term, argspec_t(1), optargspec_t({"durability"})) { }
+
+private:
+    virtual scoped_ptr_t<val_t> eval_impl(
+            scope_env_t *env, args_t *args, eval_flags_t) const {
+        counted_t<table_t> t = args->arg(env, 0)->as_table();
+        const durability_requirement_t durability_requirement
+            = parse_durability_optarg(args->optarg(env, "durability"), this);
+        bool success = t->truncate(env->env, durability_requirement);
+        r_sanity_check(success);
+        ql::datum_object_builder_t result;
+        result.overwrite("truncated", ql::datum_t(1.0));
+        return new_val(std::move(result).to_datum());
+    }
+    virtual const char *name() const { return "truncate"; }
+};
+
 class table_term_t : public op_term_t {
 public:
     table_term_t(compile_env_t *env, const protob_t<const Term> &term)
@@ -592,8 +632,13 @@ private:
                 identifier_format, env->env->interruptor, &table, &error)) {
             rfail(base_exc_t::GENERIC, "%s", error.c_str());
         }
-        return new_val(make_counted<table_t>(
-            std::move(table), db, name.str(), use_outdated, backtrace()));
+        counted_t<table_t> tbl = make_counted<table_t>(
+            std::move(table), db, name.str(), use_outdated, backtrace());
+        if (result_cache_t::recording_t *recording
+                = env->env->get_result_cache_recording()) {
+            recording->note_table(env->env, tbl);
+        }
+        return new_val(std::move(tbl));
     }
     virtual bool is_deterministic() const { return false; }
     virtual const char *name() const { return "table"; }
@@ -646,10 +691,13 @@ private:
                 = make_counted<union_datum_stream_t>(std::move(streams), backtrace());
             return new_val(make_counted<selection_t>(table, stream));
         } else {
-            datum_array_builder_t arr(env->env->limits());
+            std::vector<datum_t> keys;
+            keys.reserve(args->num_args() - 1);
             for (size_t i = 1; i < args->num_args(); ++i) {
-                datum_t key = get_key_arg(args->arg(env, i));
-                datum_t row = table->get_row(env->env, key);
+                keys.push_back(get_key_arg(args->arg(env, i)));
+            }
+            datum_array_builder_t arr(env->env->limits());
+            for (const datum_t &row : table->get_rows(env->env, keys)) {
                 if (row.get_type() != datum_t::R_NULL) {
                     arr.add(row);
                 }
@@ -727,6 +775,10 @@ counted_t<term_t> make_sync_term(compile_env_t *env, const protob_t<const Term>
     return make_counted<sync_term_t>(env, term);
 }
 
+counted_t<term_t> make_truncate_term(compile_env_t *env, const protob_t<const Term> &term) {
+    return make_counted<truncate_term_t>(env, term);
+}
+
 
 
 } // namespace ql
@@ -1,4 +1,5 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "http/json/json_reader.hpp"
 #include "rdb_protocol/op.hpp"
 #include "rdb_protocol/term.hpp"
 #include "rdb_protocol/terms/terms.hpp"
@@ -11,19 +12,19 @@ public:
 
     scoped_ptr_t<val_t> eval_impl(scope_env_t *env, args_t *args, eval_flags_t) const {
         const datum_string_t &data = args->arg(env, 0)->as_str();
-        // TODO (daniel): This causes copying, which might reduce performance and
-        // wastes memory. Change the cJSON interface to take a length.
-        // Or maybe store datum_string_ts with a null byte appended, though that
-        // would suck.
-        const std::string std_data = data.to_std();
-        scoped_cJSON_t cjson(cJSON_Parse(std_data.c_str()));
-        rcheck(cjson.get() != NULL, base_exc_t::GENERIC,
-               strprintf("Failed to parse \"%s\" as JSON.",
-                 (data.size() > 40
-                  ? (std_data.substr(0, 37) + "...").c_str()
-                  : std_data.c_str())));
-        return new_val(to_datum(cjson.get(), env->env->limits(),
-                                env->env->reql_version()));
+        json_reader_t reader(data.data(), data.size());
+        datum_t result;
+        try {
+            result = to_datum(&reader, env->env->limits(), env->env->reql_version());
+            reader.finish();
+        } catch (const json_reader_exc_t &) {
+            rfail(base_exc_t::GENERIC,
+                  "Failed to parse \"%s\" as JSON.",
+                  (data.size() > 40
+                   ? (std::string(data.data(), 37) + "...").c_str()
+                   : data.to_std().c_str()));
+        }
+        return new_val(result);
     }
 
     virtual const char *name() const { return "json"; }
@@ -38,8 +39,9 @@ public:
         scoped_ptr_t<val_t> v = args->arg(env, 0);
         datum_t d = v->as_datum();
         r_sanity_check(d.has());
-        scoped_cJSON_t json = d.as_json();
-        return new_val(datum_t(datum_string_t(json.PrintUnformatted())));
+        std::string json;
+        d.write_json(&json);
+        return new_val(datum_t(datum_string_t(json)));
     }
 
     virtual const char *name() const { return "to_json_string"; }
@@ -48,7 +48,9 @@ obj_or_seq_op_impl_t::obj_or_seq_op_impl_t(
 scoped_ptr_t<val_t> obj_or_seq_op_impl_t::eval_impl_dereferenced(
         const term_t *target, scope_env_t *env, args_t *args,
         const scoped_ptr_t<val_t> &v0,
-        std::function<scoped_ptr_t<val_t>()> helper) const {
+        std::function<scoped_ptr_t<val_t>()> helper,
+        std::function<transform_variant_t(const counted_t<const func_t> &)>
+            map_transform) const {
     datum_t d;
 
     if (v0->get_type().is_convertible(val_t::type_t::DATUM)) {
@@ -93,7 +95,10 @@ scoped_ptr_t<val_t> obj_or_seq_op_impl_t::eval_impl_dereferenced(
         counted_t<datum_stream_t> stream = v0->as_seq(env->env);
         switch (poly_type) {
         case MAP:
-            stream->add_transformation(map_wire_func_t(f), target->backtrace());
+            stream->add_transformation(map_transform
+                                           ? map_transform(f)
+                                           : transform_variant_t(map_wire_func_t(f)),
+                                       target->backtrace());
             break;
         case FILTER:
             stream->add_transformation(filter_wire_func_t(f, boost::none),
@@ -131,8 +136,28 @@ obj_or_seq_op_term_t::obj_or_seq_op_term_t(compile_env_t *env, protob_t<const Te
 scoped_ptr_t<val_t> obj_or_seq_op_term_t::eval_impl(scope_env_t *env, args_t *args,
                                                     eval_flags_t) const {
     scoped_ptr_t<val_t> v0 = args->arg(env, 0);
-    return impl.eval_impl_dereferenced(this, env, args, v0,
-                                       [&]{ return this->obj_eval(env, args, v0); });
+    return impl.eval_impl_dereferenced(
+        this, env, args, v0,
+        [&]{ return this->obj_eval(env, args, v0); },
+        [&](const counted_t<const func_t> &f) {
+            return this->map_transform(env, args, f);
+        });
+}
+
+transform_variant_t obj_or_seq_op_term_t::map_transform(
+        scope_env_t *, args_t *, const counted_t<const func_t> &f) const {
+    return map_wire_func_t(f);
+}
+
+// The paths passed to `pluck` or `without`.
+datum_t eval_paths(scope_env_t *env, args_t *args) {
+    const size_t n = args->num_args();
+    std::vector<datum_t> paths;
+    paths.reserve(n - 1);
+    for (size_t i = 1; i < n; ++i) {
+        paths.push_back(args->arg(env, i)->as_datum());
+    }
+    return datum_t(std::move(paths), env->env->limits());
 }
 
 class pluck_term_t : public obj_or_seq_op_term_t {
@@ -145,15 +170,20 @@ private:
         datum_t obj = v0->as_datum();
         r_sanity_check(obj.get_type() == datum_t::R_OBJECT);
 
-        const size_t n = args->num_args();
-        std::vector<datum_t> paths;
-        paths.reserve(n - 1);
-        for (size_t i = 1; i < n; ++i) {
-            paths.push_back(args->arg(env, i)->as_datum());
-        }
-        pathspec_t pathspec(datum_t(std::move(paths), env->env->limits()), this);
+        pathspec_t pathspec(eval_paths(env, args), this);
         return new_val(project(obj, pathspec, DONT_RECURSE, env->env->limits()));
     }
+    virtual transform_variant_t map_transform(
+        scope_env_t *env, args_t *args, const counted_t<const func_t> &f) const {
+        if (!args_after_first_are_deterministic()) {
+            return map_wire_func_t(f);
+        }
+        datum_t paths = eval_paths(env, args);
+        // Check the paths here, where we can report errors against this term.
+        pathspec_t pathspec(paths, this);
+        return project_wire_func_t(project_type_t::PLUCK, std::move(paths),
+                                   map_wire_func_t(f));
+    }
     virtual const char *name() const { return "pluck"; }
 };
 
@@ -167,15 +197,20 @@ private:
         datum_t obj = v0->as_datum();
         r_sanity_check(obj.get_type() == datum_t::R_OBJECT);
 
-        std::vector<datum_t> paths;
-        const size_t n = args->num_args();
-        paths.reserve(n - 1);
-        for (size_t i = 1; i < n; ++i) {
-            paths.push_back(args->arg(env, i)->as_datum());
-        }
-        pathspec_t pathspec(datum_t(std::move(paths), env->env->limits()), this);
+        pathspec_t pathspec(eval_paths(env, args), this);
         return new_val(unproject(obj, pathspec, DONT_RECURSE, env->env->limits()));
     }
+    virtual transform_variant_t map_transform(
+        scope_env_t *env, args_t *args, const counted_t<const func_t> &f) const {
+        if (!args_after_first_are_deterministic()) {
+            return map_wire_func_t(f);
+        }
+        datum_t paths = eval_paths(env, args);
+        // Check the paths here, where we can report errors against this term.
+        pathspec_t pathspec(paths, this);
+        return project_wire_func_t(project_type_t::WITHOUT, std::move(paths),
+                                   map_wire_func_t(f));
+    }
     virtual const char *name() const { return "without"; }
 };
 
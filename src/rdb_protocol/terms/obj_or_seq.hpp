@@ -9,6 +9,7 @@
 #include "rdb_protocol/op.hpp"
 #include "rdb_protocol/pb_utils.hpp"
 #include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/shards.hpp"
 #include "utils.hpp"
 
 namespace ql {
@@ -26,10 +27,15 @@ public:
                          protob_t<const Term> term,
                          std::set<std::string> &&_acceptable_ptypes);
 
-    scoped_ptr_t<val_t> eval_impl_dereferenced(const term_t *target, scope_env_t *env,
-                                               args_t *args,
-                                               const scoped_ptr_t<val_t> &v0,
-                                               std::function<scoped_ptr_t<val_t>()> helper) const;
+    // If `map_transform` is set, `MAP` terms use it to turn the function that
+    // evaluates the term on one element into the transformation for a sequence.
+    scoped_ptr_t<val_t> eval_impl_dereferenced(
+        const term_t *target, scope_env_t *env,
+        args_t *args,
+        const scoped_ptr_t<val_t> &v0,
+        std::function<scoped_ptr_t<val_t>()> helper,
+        std::function<transform_variant_t(const counted_t<const func_t> &)>
+            map_transform = nullptr) const;
 
 private:
     poly_type_t poly_type;
@@ -51,6 +57,14 @@ public:
                          poly_type_t _poly_type, argspec_t argspec,
                          std::set<std::string> &&ptypes);
 
+protected:
+    // Returns the transformation that applies a `MAP` term to every element of a
+    // sequence, given `f` which evaluates the term on one element.  The default is
+    // to map `f`.
+    virtual transform_variant_t map_transform(scope_env_t *env,
+                                              args_t *args,
+                                              const counted_t<const func_t> &f) const;
+
 private:
     virtual scoped_ptr_t<val_t> obj_eval(scope_env_t *env,
                                          args_t *args,
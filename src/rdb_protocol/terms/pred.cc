@@ -1,6 +1,8 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/terms/terms.hpp"
 
+#include <functional>
+
 #include "rdb_protocol/op.hpp"
 
 namespace ql {
@@ -28,10 +30,46 @@ bool datum_ge(reql_version_t v, const datum_t &lhs, const datum_t &rhs) {
     return lhs.cmp(v, rhs) >= 0;
 }
 
+// Compares two datums that are both of type `type` like `datum_t::cmp` does, under
+// every reql version, without its dispatch on their types.
+template <datum_t::type_t type>
+int typed_cmp(const datum_t &lhs, const datum_t &rhs);
+template <>
+int typed_cmp<datum_t::R_NUM>(const datum_t &lhs, const datum_t &rhs) {
+    const double l = lhs.as_num();
+    const double r = rhs.as_num();
+    return l < r ? -1 : (l > r ? 1 : 0);
+}
+template <>
+int typed_cmp<datum_t::R_STR>(const datum_t &lhs, const datum_t &rhs) {
+    return lhs.as_str().compare(rhs.as_str());
+}
+
+template <datum_t::type_t type, class cmp_t>
+bool typed_pred(const datum_t &lhs, const datum_t &rhs) {
+    return cmp_t()(typed_cmp<type>(lhs, rhs), 0);
+}
+
+typedef bool (*typed_pred_t)(const datum_t &lhs, const datum_t &rhs);
+
+template <datum_t::type_t type>
+typed_pred_t typed_pred_for(int predtype) {
+    switch (predtype) {
+    case Term_TermType_EQ: // fallthru
+    case Term_TermType_NE: return &typed_pred<type, std::equal_to<int> >;
+    case Term_TermType_LT: return &typed_pred<type, std::less<int> >;
+    case Term_TermType_LE: return &typed_pred<type, std::less_equal<int> >;
+    case Term_TermType_GT: return &typed_pred<type, std::greater<int> >;
+    case Term_TermType_GE: return &typed_pred<type, std::greater_equal<int> >;
+    default: unreachable();
+    }
+}
+
 class predicate_term_t : public op_term_t {
 public:
     predicate_term_t(compile_env_t *env, const protob_t<const Term> &term)
-        : op_term_t(env, term, argspec_t(2, -1)), namestr(0), invert(false), pred(0) {
+        : op_term_t(env, term, argspec_t(2, -1)), namestr(0), invert(false), pred(0),
+          literal_pred(nullptr) {
         int predtype = term->type();
         switch (predtype) {
         case Term_TermType_EQ: {
@@ -62,9 +100,30 @@ public:
         default: unreachable();
         }
         guarantee(namestr && pred);
+
+        // Something like `row('n').gt(10)`, in a function called on each row.
+        if (term->args_size() == 2) {
+            datum_t literal = literal_arg(1);
+            if (literal.has() && literal.get_type() == datum_t::R_NUM) {
+                rhs_literal = literal;
+                literal_pred = typed_pred_for<datum_t::R_NUM>(predtype);
+            } else if (literal.has() && literal.get_type() == datum_t::R_STR) {
+                rhs_literal = literal;
+                literal_pred = typed_pred_for<datum_t::R_STR>(predtype);
+            }
+        }
     }
 private:
     virtual scoped_ptr_t<val_t> eval_impl(scope_env_t *env, args_t *args, eval_flags_t) const {
+        if (literal_pred != nullptr) {
+            // The literal isn't evaluated, and if the other argument has the same
+            // type it's compared without `datum_t::cmp`.
+            datum_t lhs = args->arg(env, 0)->as_datum();
+            const bool res = lhs.get_type() == rhs_literal.get_type()
+                ? literal_pred(lhs, rhs_literal)
+                : pred(env->env->reql_version(), lhs, rhs_literal);
+            return new_val_bool(static_cast<bool>(res ^ invert));
+        }
         datum_t lhs = args->arg(env, 0)->as_datum();
         for (size_t i = 1; i < args->num_args(); ++i) {
             datum_t rhs = args->arg(env, i)->as_datum();
@@ -79,6 +138,11 @@ private:
     virtual const char *name() const { return namestr; }
     bool invert;
     bool (*pred)(reql_version_t, const datum_t &lhs, const datum_t &rhs);
+
+    // Set if there are two arguments and the second one is a number or string
+    // literal, to compare it with values of the same type.
+    datum_t rhs_literal;
+    typed_pred_t literal_pred;
 };
 
 class not_term_t : public op_term_t {
@@ -35,34 +35,20 @@ public:
             seq = v->as_seq(env->env);
         }
 
-        std::vector<datum_t> result;
-        result.reserve(num);
-        size_t element_number = 0;
-        batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
-        {
-            profile::sampler_t sampler("Sampling elements.", env->env->trace);
-            datum_t row;
-            while (row = seq->next(env->env, batchspec), row.has()) {
-                element_number++;
-                if (result.size() < num) {
-                    result.push_back(row);
-                } else {
-                    /* We have a limitation on the size of arrays that makes
-                     * sure they are less than the size of an integer. */
-                    size_t new_index = randint(element_number);
-                    if (new_index < num) {
-                        result[new_index] = row;
-                    }
-                }
-                sampler.new_sample();
-            }
-        }
-
-        std::random_shuffle(result.begin(), result.end());
+        rcheck(!seq->is_grouped(), base_exc_t::GENERIC,
+               "Cannot treat the output of `group` as a stream "
+               "(did you mean to `ungroup`?).");
+        // Table reads have each shard sample its own rows, so only the samples come
+        // back to be merged.
+        datum_t result = seq->run_terminal(env->env, sample_wire_func_t(num))
+                             ->as_datum();
+        rcheck(result.arr_size() <= env->env->limits().array_size_limit(),
+               base_exc_t::GENERIC,
+               strprintf("Array over size limit `%zu`.",
+                         env->env->limits().array_size_limit()).c_str());
 
         counted_t<datum_stream_t> new_ds(
-            new array_datum_stream_t(datum_t(std::move(result), env->env->limits()),
-                                     backtrace()));
+            new array_datum_stream_t(std::move(result), backtrace()));
 
         return t.has()
             ? new_val(make_counted<selection_t>(t, new_ds))
@@ -2,9 +2,12 @@
 #include "rdb_protocol/terms/terms.hpp"
 
 #include <string>
+#include <vector>
 
+#include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/op.hpp"
 #include "rdb_protocol/error.hpp"
+#include "rdb_protocol/func.hpp"
 #include "rdb_protocol/pb_utils.hpp"
 #include "rdb_protocol/minidriver.hpp"
 
@@ -29,6 +32,11 @@ public:
         real = compile_term(env, out);
     }
 
+protected:
+    virtual scoped_ptr_t<val_t> term_eval(scope_env_t *env, eval_flags_t) const {
+        return real->eval(env);
+    }
+
 private:
     virtual void accumulate_captures(var_captures_t *captures) const {
         return real->accumulate_captures(captures);
@@ -37,20 +45,198 @@ private:
         return real->is_deterministic();
     }
 
-    virtual scoped_ptr_t<val_t> term_eval(scope_env_t *env, eval_flags_t) const {
-        return real->eval(env);
-    }
-
     protob_t<const Term> in;
     protob_t<Term> out;
 
     counted_t<const term_t> real;
 };
 
-class inner_join_term_t : public rewrite_term_t {
+class join_func_visitor_t : public func_visitor_t {
+public:
+    join_func_visitor_t() : reql_func(NULL) { }
+    void on_reql_func(const reql_func_t *_reql_func) { reql_func = _reql_func; }
+    void on_js_func(const js_func_t *) { }
+    const reql_func_t *reql_func;
+};
+
+// If `term` is a chain of field accesses on a variable, like `x('a')('b')`, sets
+// `*var_out` to the variable and appends the fields to `*path_out`.
+bool compile_join_path(const Term *term, int64_t *var_out,
+                       std::vector<datum_string_t> *path_out) {
+    if (term->optargs_size() != 0) {
+        return false;
+    }
+    // We only handle a few term types, so we switch on an `int` to avoid listing
+    // every other one.
+    const int term_type = term->type();
+    switch (term_type) {
+    case Term::VAR: {
+        if (term->args_size() != 1
+            || term->args(0).type() != Term::DATUM
+            || term->args(0).datum().type() != Datum::R_NUM) {
+            return false;
+        }
+        *var_out = static_cast<int64_t>(term->args(0).datum().r_num());
+        return true;
+    }
+    case Term::GET_FIELD: // fallthru
+    case Term::BRACKET: {
+        if (term->args_size() != 2
+            || term->args(1).type() != Term::DATUM
+            || term->args(1).datum().type() != Datum::R_STR
+            || !compile_join_path(&term->args(0), var_out, path_out)) {
+            return false;
+        }
+        path_out->push_back(datum_string_t(term->args(1).datum().r_str()));
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+// Returns true if `f` is of the form `l('a').eq(r('b'))` (in either order), and
+// sets the paths of the compared fields.
+bool compile_join_func(const func_t *f,
+                       std::vector<datum_string_t> *left_path_out,
+                       std::vector<datum_string_t> *right_path_out) {
+    join_func_visitor_t visitor;
+    f->visit(&visitor);
+    if (visitor.reql_func == NULL || visitor.reql_func->get_arg_names().size() != 2) {
+        return false;
+    }
+    const std::vector<sym_t> &arg_names = visitor.reql_func->get_arg_names();
+    const protob_t<const Term> body = visitor.reql_func->get_body_source();
+    if (body->type() != Term::EQ
+        || body->optargs_size() != 0
+        || body->args_size() != 2) {
+        return false;
+    }
+    int64_t vars[2];
+    std::vector<datum_string_t> paths[2];
+    for (int i = 0; i < 2; ++i) {
+        if (!compile_join_path(&body->args(i), &vars[i], &paths[i])
+            || paths[i].empty()) {
+            return false;
+        }
+    }
+    if (vars[0] == arg_names[0].value && vars[1] == arg_names[1].value) {
+        *left_path_out = std::move(paths[0]);
+        *right_path_out = std::move(paths[1]);
+        return true;
+    } else if (vars[0] == arg_names[1].value && vars[1] == arg_names[0].value) {
+        *left_path_out = std::move(paths[1]);
+        *right_path_out = std::move(paths[0]);
+        return true;
+    }
+    return false;
+}
+
+// Whether evaluating `term` can only read, so that evaluating it once rather than
+// several times only could make a difference if the tables were written to
+// meanwhile.  `is_deterministic` is too strict for this, since it's false for
+// `table`.
+bool is_read_only(const Term *term) {
+    // We only list the terms with effects or random results, so we switch on an
+    // `int` to avoid listing every other one.
+    const int term_type = term->type();
+    switch (term_type) {
+    case Term::JAVASCRIPT: // fallthru
+    case Term::UUID: // fallthru
+    case Term::HTTP: // fallthru
+    case Term::RANDOM: // fallthru
+    case Term::SAMPLE: // fallthru
+    case Term::CHANGES: // fallthru
+    case Term::INSERT: // fallthru
+    case Term::UPDATE: // fallthru
+    case Term::REPLACE: // fallthru
+    case Term::DELETE: // fallthru
+    case Term::FOR_EACH: // fallthru
+    case Term::DB_CREATE: // fallthru
+    case Term::DB_DROP: // fallthru
+    case Term::TABLE_CREATE: // fallthru
+    case Term::TABLE_DROP: // fallthru
+    case Term::INDEX_CREATE: // fallthru
+    case Term::INDEX_DROP: // fallthru
+    case Term::INDEX_RENAME: // fallthru
+    case Term::INDEX_WAIT: // fallthru
+    case Term::WAIT: // fallthru
+    case Term::RECONFIGURE: // fallthru
+    case Term::REBALANCE: // fallthru
+    case Term::SYNC: // fallthru
+    case Term::TRUNCATE:
+        return false;
+    default:
+        break;
+    }
+    for (int i = 0; i < term->args_size(); ++i) {
+        if (!is_read_only(&term->args(i))) {
+            return false;
+        }
+    }
+    for (int i = 0; i < term->optargs_size(); ++i) {
+        if (!is_read_only(&term->optargs(i).val())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// `inner_join` and `outer_join` are rewritten into nested `concat_map`s, which call
+// the function for every pair of rows.  When the function just compares a field of
+// each row, we use a `hash_join_datum_stream_t` instead.
+class join_term_t : public rewrite_term_t {
+protected:
+    join_term_t(compile_env_t *env, const protob_t<const Term> &term, bool _outer,
+                r::reql_t (*rewrite)(protob_t<const Term> in,
+                                     const pb_rcheckable_t *bt_src,
+                                     protob_t<const Term> optargs_in))
+        : rewrite_term_t(env, term, argspec_t(3), rewrite), outer(_outer) {
+        // The `concat_map`s evaluate the right side once per left row, so we can
+        // only read it once if that gives the same result.  We also evaluate the
+        // left side again if it turns out to be grouped.  Evaluating a literal
+        // function has no effects either way.
+        if (term->optargs_size() == 0
+            && is_read_only(&term->args(0))
+            && is_read_only(&term->args(1))
+            && term->args(2).type() == Term::FUNC) {
+            left = compile_term(env, term.make_child(&term->args(0)));
+            right = compile_term(env, term.make_child(&term->args(1)));
+            func = compile_term(env, term.make_child(&term->args(2)));
+        }
+    }
+
+private:
+    virtual scoped_ptr_t<val_t> term_eval(scope_env_t *env, eval_flags_t flags) const {
+        if (func.has() && func->is_deterministic()) {
+            counted_t<const func_t> f = func->eval(env)->as_func();
+            std::vector<datum_string_t> left_path, right_path;
+            if (compile_join_func(f.get(), &left_path, &right_path)) {
+                counted_t<datum_stream_t> left_seq = left->eval(env)->as_seq(env->env);
+                if (!left_seq->is_grouped()) {
+                    counted_t<datum_stream_t> right_seq
+                        = right->eval(env)->as_seq(env->env);
+                    return new_val(
+                        env->env,
+                        make_counted<hash_join_datum_stream_t>(
+                            left_seq, right_seq, f, std::move(left_path),
+                            std::move(right_path), outer, backtrace()));
+                }
+            }
+        }
+        return rewrite_term_t::term_eval(env, flags);
+    }
+
+    const bool outer;
+    counted_t<const term_t> left;
+    counted_t<const term_t> right;
+    counted_t<const term_t> func;
+};
+
+class inner_join_term_t : public join_term_t {
 public:
     inner_join_term_t(compile_env_t *env, const protob_t<const Term> &term)
-        : rewrite_term_t(env, term, argspec_t(3), rewrite) { }
+        : join_term_t(env, term, false, rewrite) { }
 
     static r::reql_t rewrite(protob_t<const Term> in,
                              UNUSED const pb_rcheckable_t *bt_src,
@@ -79,10 +265,10 @@ public:
     virtual const char *name() const { return "inner_join"; }
 };
 
-class outer_join_term_t : public rewrite_term_t {
+class outer_join_term_t : public join_term_t {
 public:
     outer_join_term_t(compile_env_t *env, const protob_t<const Term> &term) :
-        rewrite_term_t(env, term, argspec_t(3), rewrite) { }
+        join_term_t(env, term, true, rewrite) { }
 
     static r::reql_t rewrite(protob_t<const Term> in,
                              UNUSED const pb_rcheckable_t *bt_src,
@@ -118,11 +304,54 @@ public:
     virtual const char *name() const { return "outer_join"; }
 };
 
+// `eq_join` is rewritten into a `concat_map` with a `get_all` for each row.  On the
+// primary key we use an `eq_join_datum_stream_t` instead, which reads a batch of
+// rows at once.
 class eq_join_term_t : public rewrite_term_t {
 public:
     eq_join_term_t(compile_env_t *env, const protob_t<const Term> &term) :
-        rewrite_term_t(env, term, argspec_t(3), rewrite) { }
+        rewrite_term_t(env, term, argspec_t(3), rewrite) {
+        // Like with `join_term_t`, we only evaluate the right side once, and the left
+        // side again if it's grouped.
+        const Term &left_attr_term = term->args(1);
+        if (is_read_only(&term->args(0))
+            && is_read_only(&term->args(2))
+            && (left_attr_term.type() == Term::FUNC
+                || (left_attr_term.type() == Term::DATUM
+                    && left_attr_term.datum().type() == Datum::R_STR))) {
+            if (term->optargs_size() == 1
+                && term->optargs(0).key() == "index"
+                && term->optargs(0).val().type() == Term::DATUM
+                && term->optargs(0).val().datum().type() == Datum::R_STR) {
+                index = term->optargs(0).val().datum().r_str();
+            } else if (term->optargs_size() != 0) {
+                return;
+            }
+            left = compile_term(env, term.make_child(&term->args(0)));
+            left_attr = compile_term(env, term.make_child(&left_attr_term));
+            right = compile_term(env, term.make_child(&term->args(2)));
+        }
+    }
 private:
+    virtual scoped_ptr_t<val_t> term_eval(scope_env_t *env, eval_flags_t flags) const {
+        if (left.has()) {
+            counted_t<datum_stream_t> left_seq = left->eval(env)->as_seq(env->env);
+            scoped_ptr_t<val_t> right_val = right->eval(env);
+            if (!left_seq->is_grouped()
+                && right_val->get_type().is_convertible(val_t::type_t::TABLE)) {
+                counted_t<table_t> table = right_val->as_table();
+                if (!index || *index == table->get_pkey()) {
+                    return new_val(
+                        env->env,
+                        make_counted<eq_join_datum_stream_t>(
+                            left_seq, table,
+                            left_attr->eval(env)->as_func(GET_FIELD_SHORTCUT),
+                            backtrace()));
+                }
+            }
+        }
+        return rewrite_term_t::term_eval(env, flags);
+    }
 
     static r::reql_t rewrite(protob_t<const Term> in,
                              UNUSED const pb_rcheckable_t *bt_src,
@@ -149,6 +378,11 @@ private:
 
     }
     virtual const char *name() const { return "eq_join"; }
+
+    boost::optional<std::string> index;
+    counted_t<const term_t> left;
+    counted_t<const term_t> left_attr;
+    counted_t<const term_t> right;
 };
 
 class delete_term_t : public rewrite_term_t {
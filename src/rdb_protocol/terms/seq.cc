@@ -5,6 +5,7 @@
 #include <utility>
 #include <vector>
 
+#include "rdb_protocol/changefeed_reduction.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/op.hpp"
@@ -347,6 +348,9 @@ struct rcheck_transform_visitor_t : public pb_rcheckable_t,
     NORETURN void operator()(const zip_wire_func_t &) const {
         rfail(base_exc_t::GENERIC, "Cannot call `changes` after `zip`.");
     }
+    void operator()(const project_wire_func_t &f) const {
+        check_f(f.fallback);
+    }
 };
 
 struct rcheck_spec_visitor_t : public pb_rcheckable_t,
@@ -374,37 +378,156 @@ struct rcheck_spec_visitor_t : public pb_rcheckable_t,
 class changes_term_t : public op_term_t {
 public:
     changes_term_t(compile_env_t *env, const protob_t<const Term> &term)
-        : op_term_t(env, term, argspec_t(1), optargspec_t({"squash"})) { }
+        : op_term_t(env, term, argspec_t(1),
+                    optargspec_t({"squash", "spill_to_disk", "resume_from"})),
+          reduction(changefeed::reduction_t::COUNT) {
+        // `.changes()` on `count`, `sum`, `avg`, `min` or `max` (optionally after a
+        // `group`) gets the changes to the reduction's value.  We compile the parts
+        // of the reduction ourselves, since we evaluate the sequence twice: once to
+        // subscribe to its changes and once to read its current rows.
+        protob_t<const Term> reduction_term = term.make_child(&term->args(0));
+        int max_args;
+        switch (reduction_term->type()) {
+        case Term::COUNT:
+            reduction = changefeed::reduction_t::COUNT; max_args = 1; break;
+        case Term::SUM: reduction = changefeed::reduction_t::SUM; max_args = 2; break;
+        case Term::AVG: reduction = changefeed::reduction_t::AVG; max_args = 2; break;
+        case Term::MIN: reduction = changefeed::reduction_t::MIN; max_args = 2; break;
+        case Term::MAX: reduction = changefeed::reduction_t::MAX; max_args = 2; break;
+        default: return;
+        }
+        if (reduction_term->args_size() < 1 || reduction_term->args_size() > max_args
+            || reduction_term->optargs_size() != 0) {
+            return;
+        }
+        if (reduction_term->args_size() == 2) {
+            reduction_value = compile_term(
+                env, reduction_term.make_child(&reduction_term->args(1)));
+        }
+        protob_t<const Term> seq_term
+            = reduction_term.make_child(&reduction_term->args(0));
+        if (seq_term->type() == Term::GROUP) {
+            if (seq_term->args_size() != 2 || seq_term->optargs_size() != 0) {
+                reduction_value.reset();
+                return;
+            }
+            reduction_group = compile_term(env, seq_term.make_child(&seq_term->args(1)));
+            seq_term = seq_term.make_child(&seq_term->args(0));
+        }
+        reduction_seq = compile_term(env, seq_term);
+    }
 private:
+    scoped_ptr_t<val_t> eval_reduction(scope_env_t *env, const datum_t &squash,
+                                       bool spill_to_disk) const {
+        counted_t<const func_t> group_func;
+        if (reduction_group.has()) {
+            group_func = reduction_group->eval(env)->as_func(GET_FIELD_SHORTCUT);
+        }
+        counted_t<const func_t> value_func;
+        if (reduction_value.has()) {
+            value_func = reduction_value->eval(env)->as_func(GET_FIELD_SHORTCUT);
+        }
+
+        counted_t<datum_stream_t> seq = reduction_seq->eval(env)->as_seq(env->env);
+        changefeed::keyspec_t keyspec = seq->get_change_spec();
+        auto range = boost::get<changefeed::keyspec_t::range_t>(&keyspec.spec);
+        rcheck(range != NULL && !static_cast<bool>(range->sindex),
+               base_exc_t::GENERIC,
+               "Cannot call `changes` on a reduction of anything but a table, "
+               "a `between` on the primary key, or a `filter` of those.");
+        for (const auto &t : range->transforms) {
+            rcheck(boost::get<filter_wire_func_t>(&t) != NULL, base_exc_t::GENERIC,
+                   "Cannot call `changes` on a reduction after anything but "
+                   "`filter`.");
+        }
+        boost::apply_visitor(rcheck_spec_visitor_t(env->env, backtrace()),
+                             keyspec.spec);
+        std::string pkey = keyspec.table->get_pkey();
+
+        // We subscribe before reading the initial values, so we don't miss any
+        // changes in between.
+        counted_t<datum_stream_t> changes = keyspec.table->read_changes(
+            env->env, squash, spill_to_disk, datum_t(), std::move(keyspec.spec),
+            backtrace(), keyspec.table_name);
+        counted_t<datum_stream_t> initial
+            = reduction_seq->eval(env)->as_seq(env->env);
+        return new_val(
+            env->env,
+            changefeed::make_reduction_stream(
+                reduction, group_func, value_func, std::move(pkey),
+                std::move(initial), std::move(changes), backtrace()));
+    }
+
     virtual scoped_ptr_t<val_t> eval_impl(
         scope_env_t *env, args_t *args, eval_flags_t) const {
 
         scoped_ptr_t<val_t> sval = args->optarg(env, "squash");
         datum_t squash = sval.has() ? sval->as_datum() : datum_t::boolean(false);
 
+        // Changes a slow reader hasn't read yet are spilled to disk rather than
+        // skipped once there are more than the array size limit.
+        scoped_ptr_t<val_t> spill_val = args->optarg(env, "spill_to_disk");
+        bool spill_to_disk = spill_val.has() ? spill_val->as_bool() : false;
+        if (spill_to_disk) {
+            rcheck(!squash.as_bool(), base_exc_t::GENERIC,
+                   "Cannot use `spill_to_disk` with `squash`.");
+            rdb_context_t *ctx = env->env->get_rdb_ctx();
+            rcheck(ctx != NULL && ctx->io_backender != NULL, base_exc_t::GENERIC,
+                   "`spill_to_disk` isn't available on this server.");
+        }
+
+        // A resume token from an earlier range changefeed's change makes this one
+        // start with the changes after it.
+        scoped_ptr_t<val_t> resume_val = args->optarg(env, "resume_from");
+        datum_t resume_from = resume_val.has() ? resume_val->as_datum() : datum_t();
+        if (resume_from.has()) {
+            rcheck(!squash.as_bool(), base_exc_t::GENERIC,
+                   "Cannot use `resume_from` with `squash`.");
+        }
+
+        if (reduction_seq.has()) {
+            rcheck(!resume_from.has(), base_exc_t::GENERIC,
+                   "Cannot resume changefeeds on reductions.");
+            return eval_reduction(env, squash, spill_to_disk);
+        }
+
         scoped_ptr_t<val_t> v = args->arg(env, 0);
         if (v->get_type().is_convertible(val_t::type_t::SEQUENCE)) {
             counted_t<datum_stream_t> seq = v->as_seq(env->env);
             changefeed::keyspec_t keyspec = seq->get_change_spec();
             boost::apply_visitor(rcheck_spec_visitor_t(env->env, backtrace()),
                                  keyspec.spec);
+            rcheck(!resume_from.has()
+                   || boost::get<changefeed::keyspec_t::range_t>(&keyspec.spec) != NULL,
+                   base_exc_t::GENERIC,
+                   "Cannot resume changefeeds on `limit`s.");
             return new_val(
                 env->env,
                 keyspec.table->read_changes(
                     env->env,
                     squash,
+                    spill_to_disk,
+                    resume_from,
                     std::move(keyspec.spec),
                     backtrace(),
                     keyspec.table_name));
         } else if (v->get_type().is_convertible(val_t::type_t::SINGLE_SELECTION)) {
+            rcheck(!resume_from.has(), base_exc_t::GENERIC,
+                   "Cannot resume changefeeds on single documents.");
             return new_val(
-                env->env, v->as_single_selection()->read_changes(squash));
+                env->env, v->as_single_selection()->read_changes(squash, spill_to_disk));
         }
         auto selection = v->as_selection(env->env);
         rfail(base_exc_t::GENERIC,
               ".changes() not yet supported on range selections");
     }
     virtual const char *name() const { return "changes"; }
+
+    // Only set when the argument is a reduction we can follow the changes of.
+    changefeed::reduction_t reduction;
+    counted_t<const term_t> reduction_seq;
+    counted_t<const term_t> reduction_group;
+    counted_t<const term_t> reduction_value;
 };
 
 class between_term_t : public bounded_op_term_t {
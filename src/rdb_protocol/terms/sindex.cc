@@ -1,7 +1,9 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/terms/terms.hpp"
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include "rdb_protocol/real_table.hpp"
 #include "rdb_protocol/btree.hpp"
@@ -18,7 +20,8 @@ namespace ql {
 class sindex_create_term_t : public op_term_t {
 public:
     sindex_create_term_t(compile_env_t *env, const protob_t<const Term> &term)
-        : op_term_t(env, term, argspec_t(2, 3), optargspec_t({"multi", "geo"})) { }
+        : op_term_t(env, term, argspec_t(2, 3),
+                    optargspec_t({"multi", "geo", "covering", "filter"})) { }
 
     virtual scoped_ptr_t<val_t> eval_impl(scope_env_t *env, args_t *args, eval_flags_t) const {
         counted_t<table_t> table = args->arg(env, 0)->as_table();
@@ -32,6 +35,8 @@ public:
         /* Check if we're doing a multi index or a normal index. */
         sindex_multi_bool_t multi = sindex_multi_bool_t::SINGLE;
         sindex_geo_bool_t geo = sindex_geo_bool_t::REGULAR;
+        std::vector<std::string> covering;
+        counted_t<const func_t> filter_func;
         counted_t<const func_t> index_func;
         if (args->num_args() == 3) {
             scoped_ptr_t<val_t> v = args->arg(env, 2);
@@ -55,6 +60,10 @@ public:
                         deserialize_sindex_info(vec, &sindex_info);
                         multi = sindex_info.multi;
                         geo = sindex_info.geo;
+                        covering = sindex_info.covering;
+                        if (sindex_info.filter) {
+                            filter_func = sindex_info.filter->compile_wire_func();
+                        }
                     } catch (const archive_exc_t &e) {
                         rfail(base_exc_t::GENERIC,
                               "Binary blob passed to index create could not "
@@ -98,8 +107,37 @@ public:
                 ? sindex_geo_bool_t::GEO
                 : sindex_geo_bool_t::REGULAR;
         }
+        /* Which fields does the index keep with its entries? */
+        if (scoped_ptr_t<val_t> covering_val = args->optarg(env, "covering")) {
+            datum_t fields = covering_val->as_datum();
+            rcheck_target(covering_val.get(),
+                          fields.get_type() == datum_t::R_ARRAY, base_exc_t::GENERIC,
+                          "`covering` must be an array of field names.");
+            covering.clear();
+            for (size_t i = 0; i < fields.arr_size(); ++i) {
+                std::string field = fields.get(i).as_str().to_std();
+                if (std::find(covering.begin(), covering.end(), field)
+                    == covering.end()) {
+                    covering.push_back(std::move(field));
+                }
+            }
+        }
+        /* Is it a partial index? */
+        if (scoped_ptr_t<val_t> filter_val = args->optarg(env, "filter")) {
+            filter_func = filter_val->as_func();
+        }
+        if (!covering.empty()) {
+            rcheck(geo == sindex_geo_bool_t::REGULAR, base_exc_t::GENERIC,
+                   "Geospatial indexes can't be covering.");
+            // Rows read through the index still need their primary key.
+            const std::string &pkey = table->get_pkey();
+            if (std::find(covering.begin(), covering.end(), pkey) == covering.end()) {
+                covering.push_back(pkey);
+            }
+        }
 
-        bool success = table->sindex_create(env->env, name, index_func, multi, geo);
+        bool success = table->sindex_create(env->env, name, index_func, multi, geo,
+                                            covering, filter_func);
 
         if (success) {
             datum_object_builder_t res;
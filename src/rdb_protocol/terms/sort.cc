@@ -1,18 +1,17 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/terms/terms.hpp"
 
+#include <algorithm>
 #include <string>
 #include <utility>
 
-#include "errors.hpp"
-#include <boost/bind.hpp>
-
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/op.hpp"
 #include "rdb_protocol/pb_utils.hpp"
+#include "rdb_protocol/sort_key.hpp"
 #include "rdb_protocol/term_walker.hpp"
 
 namespace ql {
@@ -53,77 +52,24 @@ public:
         : op_term_t(env, term, argspec_t(1, -1),
           optargspec_t({"index"})), src_term(term) { }
 private:
-    enum order_direction_t { ASC, DESC };
-    class lt_cmp_t {
-    public:
-        typedef bool result_type;
-        explicit lt_cmp_t(
-            std::vector<std::pair<order_direction_t, counted_t<const func_t> > > _comparisons)
-            : comparisons(std::move(_comparisons)) { }
-
-        bool operator()(env_t *env,
-                        profile::sampler_t *sampler,
-                        datum_t l,
-                        datum_t r) const {
-            sampler->new_sample();
-            for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
-                datum_t lval;
-                datum_t rval;
-                try {
-                    lval = it->second->call(env, l)->as_datum();
-                } catch (const base_exc_t &e) {
-                    if (e.get_type() != base_exc_t::NON_EXISTENCE) {
-                        throw;
-                    }
-                }
-
-                try {
-                    rval = it->second->call(env, r)->as_datum();
-                } catch (const base_exc_t &e) {
-                    if (e.get_type() != base_exc_t::NON_EXISTENCE) {
-                        throw;
-                    }
-                }
-
-                if (!lval.has() && !rval.has()) {
-                    continue;
-                }
-                if (!lval.has()) {
-                    return true != (it->first == DESC);
-                }
-                if (!rval.has()) {
-                    return false != (it->first == DESC);
-                }
-                int cmp_res = lval.cmp(env->reql_version(), rval);
-                if (cmp_res == 0) {
-                    continue;
-                }
-                return (cmp_res < 0) != (it->first == DESC);
-            }
-
-            return false;
-        }
-
-    private:
-        const std::vector<std::pair<order_direction_t, counted_t<const func_t> > >
-            comparisons;
-    };
-
     virtual scoped_ptr_t<val_t>
     eval_impl(scope_env_t *env, args_t *args, eval_flags_t) const {
-        std::vector<std::pair<order_direction_t, counted_t<const func_t> > > comparisons;
+        std::vector<std::pair<sort_direction_t, counted_t<const func_t> > > comparisons;
         for (size_t i = 1; i < args->num_args(); ++i) {
             if (get_src()->args(i).type() == Term::DESC) {
                 comparisons.push_back(
                     std::make_pair(
-                        DESC, args->arg(env, i)->as_func(GET_FIELD_SHORTCUT)));
+                        sort_direction_t::DESC,
+                        args->arg(env, i)->as_func(GET_FIELD_SHORTCUT)));
             } else {
                 comparisons.push_back(
                     std::make_pair(
-                        ASC, args->arg(env, i)->as_func(GET_FIELD_SHORTCUT)));
+                        sort_direction_t::ASC,
+                        args->arg(env, i)->as_func(GET_FIELD_SHORTCUT)));
             }
         }
-        lt_cmp_t lt_cmp(comparisons);
+        const bool has_comparisons = !comparisons.empty();
+        sort_order_t sort_order(std::move(comparisons));
 
         counted_t<table_slice_t> tbl_slice;
         counted_t<datum_stream_t> seq;
@@ -142,7 +88,7 @@ private:
         if (seq.has() && seq->is_exhausted()){
             /* Do nothing for empty sequence */
             if (!index.has()) {
-                rcheck(!comparisons.empty(), base_exc_t::GENERIC,
+                rcheck(has_comparisons, base_exc_t::GENERIC,
                        "Must specify something to order by.");
             }
         /* Add a sorting to the table if we're doing indexed sorting. */
@@ -164,9 +110,9 @@ private:
             r_sanity_check(sorting != sorting_t::UNORDERED);
             std::string index_str = index->as_str().to_std();
             tbl_slice = tbl_slice->with_sorting(index_str, sorting);
-            if (!comparisons.empty()) {
+            if (has_comparisons) {
                 seq = make_counted<indexed_sort_datum_stream_t>(
-                    tbl_slice->as_seq(env->env, backtrace()), lt_cmp);
+                    tbl_slice->as_seq(env->env, backtrace()), sort_order);
             } else {
                 return new_val(tbl_slice);
             }
@@ -174,25 +120,12 @@ private:
             if (!seq.has()) {
                 seq = tbl_slice->as_seq(env->env, backtrace());
             }
-            rcheck(!comparisons.empty(), base_exc_t::GENERIC,
+            rcheck(has_comparisons, base_exc_t::GENERIC,
                    "Must specify something to order by.");
-            std::vector<datum_t> to_sort;
-            batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
-            for (;;) {
-                std::vector<datum_t> data
-                    = seq->next_batch(env->env, batchspec);
-                if (data.size() == 0) {
-                    break;
-                }
-                std::move(data.begin(), data.end(), std::back_inserter(to_sort));
-                rcheck_array_size(to_sort, env->env->limits(), base_exc_t::GENERIC);
-            }
-            profile::sampler_t sampler("Sorting in-memory.", env->env->trace);
-            auto fn = boost::bind(lt_cmp, env->env, &sampler, _1, _2);
-            std::stable_sort(to_sort.begin(), to_sort.end(), fn);
-            seq = make_counted<array_datum_stream_t>(
-                datum_t(std::move(to_sort), env->env->limits()),
-                backtrace());
+            // This sorts when it's first read, so that a `limit` right after us
+            // can tell it to only keep the first few elements.
+            seq = make_counted<unindexed_sort_datum_stream_t>(
+                seq, sort_order, backtrace());
         }
         return tbl_slice.has()
             ? new_val(make_counted<selection_t>(tbl_slice->get_tbl(), seq))
@@ -243,24 +176,18 @@ private:
         rcheck(!idx, base_exc_t::GENERIC,
                "Can only perform an indexed distinct on a TABLE.");
         counted_t<datum_stream_t> s = v->as_seq(env->env);
-        // The reql_version matters here, because we copy `results` into `toret`
-        // in ascending order.
-        std::set<datum_t, optional_datum_less_t>
-            results(optional_datum_less_t(env->env->reql_version()));
-        batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
-        {
-            profile::sampler_t sampler("Evaluating elements in distinct.",
-                                       env->env->trace);
-            datum_t d;
-            while (d = s->next(env->env, batchspec), d.has()) {
-                results.insert(std::move(d));
-                rcheck_array_size(results, env->env->limits(), base_exc_t::GENERIC);
-                sampler.new_sample();
-            }
-        }
-        std::vector<datum_t> toret;
-        std::move(results.begin(), results.end(), std::back_inserter(toret));
-        return new_val(datum_t(std::move(toret), env->env->limits()));
+        rcheck(!s->is_grouped(), base_exc_t::GENERIC,
+               "Cannot treat the output of `group` as a stream "
+               "(did you mean to `ungroup`?).");
+        // Table reads have each shard find its distinct rows, so only those come
+        // back to be merged.  They're returned in ascending order.
+        datum_t result
+            = s->run_terminal(env->env, unindexed_distinct_wire_func_t(backtrace()))
+                  ->as_datum();
+        const size_t limit = env->env->limits().array_size_limit();
+        rcheck(result.arr_size() <= limit, base_exc_t::GENERIC,
+               strprintf("Array over size limit `%zu`.", limit).c_str());
+        return new_val(std::move(result));
     }
 
     virtual const char *name() const { return "distinct"; }
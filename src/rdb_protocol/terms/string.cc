@@ -1,13 +1,58 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/terms/terms.hpp"
 
+#include <string.h>
+
+#include <algorithm>
+
 #include <re2/re2.h>
 
+#include "containers/lru_cache.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/op.hpp"
+#include "thread_local.hpp"
 
 namespace ql {
 
+// This is a totally arbitrary constant limiting the size of the regex cache.  1000
+// was chosen out of a hat; if you have a good argument for it being something else
+// (apart from cache line concerns, which are irrelevant due to the implementation)
+// you're probably right.
+const size_t MAX_CACHED_REGEXES = 1000;
+
+// Compiled regexes are kept per thread rather than per query, so that a pattern
+// used by many queries (or by every row of a `filter`) is compiled once per thread.
+// The options are always the same, so the pattern alone is the key; flags like
+// `(?i)` are part of it.
+typedef lru_cache_t<std::string, std::shared_ptr<re2::RE2> > regex_cache_t;
+TLS_with_init(regex_cache_t *, regex_cache, NULL);
+
+// Returns NULL and sets `*error_out` if `pattern` doesn't compile.  Those aren't
+// cached.
+std::shared_ptr<re2::RE2> get_regex(const std::string &pattern,
+                                    std::string *error_out) {
+    regex_cache_t *cache = TLS_get_regex_cache();
+    if (cache == NULL) {
+        // Never freed, like the other per-thread caches.
+        cache = new regex_cache_t(MAX_CACHED_REGEXES);
+        TLS_set_regex_cache(cache);
+    }
+    auto search = cache->find(pattern);
+    if (search != cache->end()) {
+        return search->second;
+    }
+    std::shared_ptr<re2::RE2> regexp(new re2::RE2(pattern, re2::RE2::Quiet));
+    if (!regexp->ok()) {
+        *error_out = strprintf("Error in regexp `%s` (portion `%s`): %s",
+                               regexp->pattern().c_str(),
+                               regexp->error_arg().c_str(),
+                               regexp->error().c_str());
+        return std::shared_ptr<re2::RE2>();
+    }
+    (*cache)[pattern] = regexp;
+    return regexp;
+}
+
 class match_term_t : public op_term_t {
 public:
     match_term_t(compile_env_t *env, const protob_t<const Term> &term)
@@ -16,23 +61,11 @@ private:
     virtual scoped_ptr_t<val_t> eval_impl(scope_env_t *env, args_t *args, eval_flags_t) const {
         std::string str = args->arg(env, 0)->as_str().to_std();
         std::string re = args->arg(env, 1)->as_str().to_std();
-        std::shared_ptr<re2::RE2> regexp;
-        query_cache_t & cache = env->env->query_cache();
-        auto search = cache.regex_cache.find(re);
-        if (search == cache.regex_cache.end()) {
-            regexp.reset(new re2::RE2(re, re2::RE2::Quiet));
-            if (!regexp->ok()) {
-                rfail(base_exc_t::GENERIC,
-                      "Error in regexp `%s` (portion `%s`): %s",
-                      regexp->pattern().c_str(),
-                      regexp->error_arg().c_str(),
-                      regexp->error().c_str());
-            }
-            cache.regex_cache[re] = regexp;
-        } else {
-            regexp = search->second;
+        std::string error;
+        std::shared_ptr<re2::RE2> regexp = get_regex(re, &error);
+        if (!regexp) {
+            rfail(base_exc_t::GENERIC, "%s", error.c_str());
         }
-        r_sanity_check(static_cast<bool>(regexp));
         // We add 1 to account for $0.
         int ngroups = regexp->NumberOfCapturingGroups() + 1;
         scoped_array_t<re2::StringPiece> groups(ngroups);
@@ -80,6 +113,31 @@ private:
 
 const char *const splitchars = " \t\n\r\x0B\x0C";
 
+// `std::string::find_first_of` does a `memchr` of `splitchars` for every byte, so
+// whitespace splitting looks bytes up in a table instead.
+class splitchar_table_t {
+public:
+    splitchar_table_t() {
+        memset(is_splitchar, 0, sizeof(is_splitchar));
+        for (const char *c = splitchars; *c != '\0'; ++c) {
+            is_splitchar[static_cast<unsigned char>(*c)] = true;
+        }
+    }
+    size_t find_first(const std::string &s, size_t pos, bool splitchar) const {
+        const size_t size = s.size();
+        for (; pos < size; ++pos) {
+            if (is_splitchar[static_cast<unsigned char>(s[pos])] == splitchar) {
+                return pos;
+            }
+        }
+        return std::string::npos;
+    }
+private:
+    bool is_splitchar[256];
+};
+
+const splitchar_table_t splitchar_table;
+
 class split_term_t : public op_term_t {
 public:
     split_term_t(compile_env_t *env, const protob_t<const Term> &term)
@@ -115,16 +173,19 @@ private:
                 ? std::string::npos
                 : (delim
                    ? (delim->size() == 0 ? last + 1 : s.find(*delim, last))
-                   : s.find_first_of(splitchars, last));
-            std::string tmp;
+                   : splitchar_table.find_first(s, last, true));
+            // The piece is [start, start + size).
+            size_t start = last;
+            size_t size = 0;
             if (next == std::string::npos) {
-                size_t start = delim ? last : s.find_first_not_of(splitchars, last);
-                tmp = start == std::string::npos ? "" : s.substr(start);
+                start = delim ? last : splitchar_table.find_first(s, last, false);
+                size = start == std::string::npos ? 0 : s.size() - start;
             } else {
-                tmp = s.substr(last, next - last);
+                // `next` is past the end when splitting "" on "".
+                size = std::min(next, s.size()) - last;
             }
-            if ((delim && delim->size() != 0) || tmp.size() != 0) {
-                res.push_back(datum_t(datum_string_t(tmp)));
+            if ((delim && delim->size() != 0) || size != 0) {
+                res.push_back(datum_t(datum_string_t(size, s.data() + start)));
             }
             last = (next == std::string::npos || next >= s.size())
                 ? std::string::npos
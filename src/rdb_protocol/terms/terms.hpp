@@ -118,6 +118,8 @@ counted_t<term_t> make_rebalance_term(
     compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_sync_term(
     compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_truncate_term(
+    compile_env_t *env, const protob_t<const Term> &term);
 
 // error.cc
 counted_t<term_t> make_error_term(
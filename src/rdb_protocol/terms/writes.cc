@@ -64,40 +64,68 @@ public:
                     optargspec_t({"conflict", "durability", "return_vals", "return_changes"})) { }
 
 private:
-    static void maybe_generate_key(counted_t<table_t> tbl,
-                                   const configured_limits_t &limits,
-                                   std::vector<std::string> *generated_keys_out,
-                                   size_t *keys_skipped_out,
-                                   datum_t *datum_out,
-                                   bool *pkey_was_autogenerated_out) {
-        if (!(*datum_out).get_field(datum_string_t(tbl->get_pkey()), NOTHROW).has()) {
-            std::string key = uuid_to_str(generate_uuid());
-            datum_t keyd((datum_string_t(key)));
-            {
-                datum_object_builder_t d;
-                bool conflict = d.add(datum_string_t(tbl->get_pkey()), keyd);
-                r_sanity_check(!conflict);
-                std::set<std::string> conditions;
-                *datum_out = (*datum_out).merge(std::move(d).to_datum(), pure_merge,
-                                                 limits, &conditions);
-                // we happen to know that pure_merge cannot ever generate warning
-                // conditions, because it shouldn't ever be run.
-                r_sanity_check(conditions.size() == 0);
+    static void add_generated_key(const datum_string_t &pkey,
+                                  const configured_limits_t &limits,
+                                  const uuid_u &uuid,
+                                  std::vector<datum_t> *generated_keys_out,
+                                  size_t *keys_skipped_out,
+                                  datum_t *datum_out) {
+        datum_t keyd((datum_string_t(uuid_to_str(uuid))));
+        {
+            datum_object_builder_t d;
+            bool conflict = d.add(pkey, keyd);
+            r_sanity_check(!conflict);
+            std::set<std::string> conditions;
+            *datum_out = (*datum_out).merge(std::move(d).to_datum(), pure_merge,
+                                             limits, &conditions);
+            // we happen to know that pure_merge cannot ever generate warning
+            // conditions, because it shouldn't ever be run.
+            r_sanity_check(conditions.size() == 0);
+        }
+        if (generated_keys_out->size() < limits.array_size_limit()) {
+            generated_keys_out->push_back(std::move(keyd));
+        } else {
+            *keys_skipped_out += 1;
+        }
+    }
+
+    // Generates keys for the rows of a batch that don't have one, all of the UUIDs
+    // at once, and returns which rows got one.  Rows that aren't objects are left
+    // for `replace` to complain about.
+    static std::vector<bool> generate_keys(counted_t<table_t> tbl,
+                                           const configured_limits_t &limits,
+                                           std::vector<datum_t> *generated_keys_out,
+                                           size_t *keys_skipped_out,
+                                           std::vector<datum_t> *datums) {
+        const datum_string_t pkey(tbl->get_pkey());
+        std::vector<bool> pkey_was_autogenerated(datums->size());
+        size_t num_missing = 0;
+        for (size_t i = 0; i < datums->size(); ++i) {
+            const datum_t &d = (*datums)[i];
+            if (d.get_type() == datum_t::R_OBJECT && !d.get_field(pkey, NOTHROW).has()) {
+                /* NOTE: If we ever support other pkey autogeneration schemes, it's
+                important that this be set to `true` only if a regular UUID is
+                generated, and not for any other pkey autogeneration scheme. This is
+                because the artificial tables will assume that if this is set to
+                `true`, then the pkey is a newly-generated UUID. */
+                pkey_was_autogenerated[i] = true;
+                ++num_missing;
             }
-            if (generated_keys_out->size() < limits.array_size_limit()) {
-                generated_keys_out->push_back(key);
-            } else {
-                *keys_skipped_out += 1;
+        }
+        if (num_missing == 0) {
+            return pkey_was_autogenerated;
+        }
+
+        std::vector<uuid_u> uuids(num_missing);
+        generate_uuids(num_missing, uuids.data());
+        size_t next_uuid = 0;
+        for (size_t i = 0; i < datums->size(); ++i) {
+            if (pkey_was_autogenerated[i]) {
+                add_generated_key(pkey, limits, uuids[next_uuid++],
+                                  generated_keys_out, keys_skipped_out, &(*datums)[i]);
             }
-            /* NOTE: If we ever support other pkey autogeneration schemes, it's important
-            that this be set to `true` only if a regular UUID is generated, and not for
-            any other pkey autogeneration scheme. This is because the artificial tables
-            will assume that if this is set to `true`, then the pkey is a newly-generated
-            UUID. */
-            *pkey_was_autogenerated_out = true;
-        } else {
-            *pkey_was_autogenerated_out = false;
         }
+        return pkey_was_autogenerated;
     }
 
     virtual scoped_ptr_t<val_t> eval_impl(scope_env_t *env, args_t *args, eval_flags_t) const {
@@ -117,25 +145,17 @@ private:
 
         bool done = false;
         datum_t stats = new_stats_object();
-        std::vector<std::string> generated_keys;
+        std::vector<datum_t> generated_keys;
         std::set<std::string> conditions;
         size_t keys_skipped = 0;
         scoped_ptr_t<val_t> v1 = args->arg(env, 1);
         if (v1->get_type().is_convertible(val_t::type_t::DATUM)) {
             std::vector<datum_t> datums;
-            std::vector<bool> pkey_was_autogenerated(1);
             datums.push_back(v1->as_datum());
             if (datums[0].get_type() == datum_t::R_OBJECT) {
-                try {
-                    bool was_autogenerated;
-                    maybe_generate_key(t, env->env->limits(), &generated_keys,
-                                       &keys_skipped, &datums[0],
-                                       &was_autogenerated);
-                    pkey_was_autogenerated[0] = was_autogenerated;
-                } catch (const base_exc_t &) {
-                    // We just ignore it, the same error will be handled in `replace`.
-                    // TODO: that solution sucks.
-                }
+                std::vector<bool> pkey_was_autogenerated
+                    = generate_keys(t, env->env->limits(), &generated_keys,
+                                    &keys_skipped, &datums);
                 datum_t replace_stats = t->batched_insert(
                     env->env, std::move(datums), std::move(pkey_was_autogenerated),
                     conflict_behavior, durability_requirement, return_changes);
@@ -154,20 +174,9 @@ private:
                 if (datums.empty()) {
                     break;
                 }
-                std::vector<bool> pkey_was_autogenerated(datums.size());
-
-                for (size_t i = 0; i < datums.size(); ++i) {
-                    try {
-                        bool was_autogenerated;
-                        maybe_generate_key(t, env->env->limits(), &generated_keys,
-                                           &keys_skipped, &datums[i],
-                                           &was_autogenerated);
-                        pkey_was_autogenerated[i] = was_autogenerated;
-                    } catch (const base_exc_t &) {
-                        // We just ignore it, the same error will be handled in
-                        // `replace`.  TODO: that solution sucks.
-                    }
-                }
+                std::vector<bool> pkey_was_autogenerated
+                    = generate_keys(t, env->env->limits(), &generated_keys,
+                                    &keys_skipped, &datums);
 
                 datum_t replace_stats = t->batched_insert(
                     env->env, std::move(datums), std::move(pkey_was_autogenerated),
@@ -176,15 +185,11 @@ private:
             }
         }
 
-        if (generated_keys.size() > 0) {
-            std::vector<datum_t> genkeys;
-            genkeys.reserve(generated_keys.size());
-            for (size_t i = 0; i < generated_keys.size(); ++i) {
-                genkeys.push_back(datum_t(datum_string_t(generated_keys[i])));
-            }
+        const size_t num_generated_keys = generated_keys.size();
+        if (num_generated_keys > 0) {
             datum_object_builder_t d;
             UNUSED bool b = d.add("generated_keys",
-                                  datum_t(std::move(genkeys),
+                                  datum_t(std::move(generated_keys),
                                                         env->env->limits()));
             stats = stats.merge(std::move(d).to_datum(), pure_merge,
                                 env->env->limits(), &conditions);
@@ -194,8 +199,8 @@ private:
         obj.add_warnings(conditions, env->env->limits());
         if (keys_skipped > 0) {
             obj.add_warning(strprintf("Too many generated keys (%zu), array truncated to %zu.",
-                                      keys_skipped + generated_keys.size(),
-                                      generated_keys.size()).c_str(), env->env->limits());
+                                      keys_skipped + num_generated_keys,
+                                      num_generated_keys).c_str(), env->env->limits());
         }
 
         return new_val(std::move(obj).to_datum());
@@ -2,6 +2,7 @@
 #include "rdb_protocol/val.hpp"
 
 #include "containers/name_string.hpp"
+#include "containers/object_freelist.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/math_utils.hpp"
@@ -30,10 +31,13 @@ public:
         }
         return row;
     }
-    virtual counted_t<datum_stream_t> read_changes(const datum_t &squash) {
+    virtual counted_t<datum_stream_t> read_changes(const datum_t &squash,
+                                                   bool spill_to_disk) {
         return tbl->tbl->read_changes(
             env,
             squash,
+            spill_to_disk,
+            datum_t(),
             changefeed::keyspec_t::point_t{store_key_t(key.print_primary())},
             bt,
             tbl->display_name());
@@ -93,11 +97,12 @@ public:
         }
         return row;
     }
-    virtual counted_t<datum_stream_t> read_changes(const datum_t &squash) {
+    virtual counted_t<datum_stream_t> read_changes(const datum_t &squash,
+                                                   bool spill_to_disk) {
         changefeed::keyspec_t::spec_t spec =
             ql::changefeed::keyspec_t::limit_t{slice->get_change_spec(), 1};
         auto s = slice->get_tbl()->tbl->read_changes(
-            env, squash, std::move(spec), bt, slice->get_tbl()->display_name());
+            env, squash, spill_to_disk, datum_t(), std::move(spec), bt, slice->get_tbl()->display_name());
         s->add_transformation(transform_variant_t(es_helper::map_wire_func()), bt);
         return s;
     }
@@ -259,9 +264,11 @@ datum_t table_t::batched_replace(
         result.add_warnings(conditions, env->limits());
         return std::move(result).to_datum();
     } else {
-        return tbl->write_batched_replace(
+        datum_t res = tbl->write_batched_replace(
             env, keys, replacement_generator, return_changes,
             durability_requirement);
+        drop_cached_rows(env, keys);
+        return res;
     }
 }
 
@@ -276,6 +283,8 @@ datum_t table_t::batched_insert(
     datum_object_builder_t stats;
     std::vector<datum_t> valid_inserts;
     valid_inserts.reserve(insert_datums.size());
+    std::vector<datum_t> valid_pkeys;
+    valid_pkeys.reserve(insert_datums.size());
     for (auto it = insert_datums.begin(); it != insert_datums.end(); ++it) {
         try {
             datum_string_t pkey_w(get_pkey());
@@ -284,6 +293,7 @@ datum_t table_t::batched_insert(
                                      pkey_w);
             const ql::datum_t &keyval = (*it).get_field(pkey_w);
             keyval.print_primary(); // does error checking
+            valid_pkeys.push_back(keyval);
             valid_inserts.push_back(std::move(*it));
         } catch (const base_exc_t &e) {
             stats.add_error(e.what());
@@ -298,6 +308,7 @@ datum_t table_t::batched_insert(
         tbl->write_batched_insert(
             env, std::move(valid_inserts), std::move(pkey_was_autogenerated),
             conflict_behavior, return_changes, durability_requirement);
+    drop_cached_rows(env, valid_pkeys);
     std::set<std::string> conditions;
     datum_t merged
         = std::move(stats).to_datum().merge(insert_stats, stats_merge,
@@ -311,9 +322,14 @@ MUST_USE bool table_t::sindex_create(env_t *env,
                                      const std::string &id,
                                      counted_t<const func_t> index_func,
                                      sindex_multi_bool_t multi,
-                                     sindex_geo_bool_t geo) {
+                                     sindex_geo_bool_t geo,
+                                     const std::vector<std::string> &covering,
+                                     counted_t<const func_t> filter) {
     index_func->assert_deterministic("Index functions must be deterministic.");
-    return tbl->sindex_create(env, id, index_func, multi, geo);
+    if (filter.has()) {
+        filter->assert_deterministic("Index filters must be deterministic.");
+    }
+    return tbl->sindex_create(env, id, index_func, multi, geo, covering, filter);
 }
 
 MUST_USE bool table_t::sindex_drop(env_t *env, const std::string &id) {
@@ -369,6 +385,15 @@ MUST_USE bool table_t::sync_depending_on_durability(env_t *env,
         env, durability_requirement);
 }
 
+MUST_USE bool table_t::truncate(env_t *env,
+                                durability_requirement_t durability_requirement) {
+    std::string table_id;
+    if (outdated_read_cache_t *cache = outdated_read_cache(env, &table_id)) {
+        cache->drop_table(table_id);
+    }
+    return tbl->write_truncate(env, durability_requirement);
+}
+
 ql::datum_t table_t::get_id() const {
     return tbl->get_id();
 }
@@ -377,8 +402,75 @@ const std::string &table_t::get_pkey() const {
     return tbl->get_pkey();
 }
 
+outdated_read_cache_t *table_t::outdated_read_cache(env_t *env,
+                                                    std::string *table_id_out) {
+    rdb_context_t *ctx = env->get_rdb_ctx();
+    if (ctx == NULL || ctx->outdated_read_cache_ms == 0) {
+        return NULL;
+    }
+    datum_t id = tbl->get_id();
+    if (id.get_type() != datum_t::R_STR) {
+        return NULL;
+    }
+    *table_id_out = id.as_str().to_std();
+    return ctx->get_outdated_read_cache_for_this_thread();
+}
+
+void table_t::drop_cached_rows(env_t *env, const std::vector<datum_t> &pkeys) {
+    std::string table_id;
+    if (outdated_read_cache_t *cache = outdated_read_cache(env, &table_id)) {
+        for (const datum_t &pkey : pkeys) {
+            cache->drop(table_id, pkey);
+        }
+    }
+}
+
 datum_t table_t::get_row(env_t *env, datum_t pval) {
-    return tbl->read_row(env, pval, use_outdated);
+    std::string table_id;
+    outdated_read_cache_t *cache
+        = use_outdated ? outdated_read_cache(env, &table_id) : NULL;
+    if (cache == NULL) {
+        return tbl->read_row(env, pval, use_outdated);
+    }
+    const int max_age_ms = env->get_rdb_ctx()->outdated_read_cache_ms;
+    datum_t row = cache->get(table_id, pval, max_age_ms);
+    if (!row.has()) {
+        row = tbl->read_row(env, pval, use_outdated);
+        cache->put(table_id, pval, row);
+    }
+    return row;
+}
+
+std::vector<datum_t> table_t::get_rows(env_t *env,
+                                       const std::vector<datum_t> &pvals) {
+    std::string table_id;
+    outdated_read_cache_t *cache
+        = use_outdated ? outdated_read_cache(env, &table_id) : NULL;
+    if (cache == NULL) {
+        return tbl->read_rows(env, pvals, use_outdated);
+    }
+    // Only the keys that aren't cached are read, in one batch.
+    const int max_age_ms = env->get_rdb_ctx()->outdated_read_cache_ms;
+    std::vector<datum_t> rows;
+    rows.reserve(pvals.size());
+    std::vector<size_t> missing;
+    std::vector<datum_t> missing_pvals;
+    for (size_t i = 0; i < pvals.size(); ++i) {
+        rows.push_back(cache->get(table_id, pvals[i], max_age_ms));
+        if (!rows.back().has()) {
+            missing.push_back(i);
+            missing_pvals.push_back(pvals[i]);
+        }
+    }
+    if (!missing.empty()) {
+        std::vector<datum_t> read = tbl->read_rows(env, missing_pvals, use_outdated);
+        r_sanity_check(read.size() == missing.size());
+        for (size_t i = 0; i < missing.size(); ++i) {
+            cache->put(table_id, missing_pvals[i], read[i]);
+            rows[missing[i]] = std::move(read[i]);
+        }
+    }
+    return rows;
 }
 
 counted_t<datum_stream_t> table_t::get_all(
@@ -551,6 +643,19 @@ val_t::val_t(counted_t<const func_t> _func, protob_t<const Backtrace> backtrace)
 
 val_t::~val_t() { }
 
+// Enough to cover the `val_t`s of a deeply nested query on every thread, without
+// holding on to much memory.
+object_freelist_t val_freelist(sizeof(val_t), 1024);
+
+void *val_t::operator new(size_t size) {
+    guarantee(size == sizeof(val_t));
+    return val_freelist.allocate();
+}
+
+void val_t::operator delete(void *ptr) {
+    val_freelist.deallocate(ptr);
+}
+
 val_t::type_t val_t::get_type() const { return type; }
 const char * val_t::get_type_name() const { return get_type().name(); }
 
@@ -23,6 +23,7 @@ namespace ql {
 class datum_t;
 class env_t;
 template <class> class protob_t;
+class outdated_read_cache_t;
 class scope_env_t;
 class stream_cache_t;
 class term_t;
@@ -38,6 +39,8 @@ public:
     ql::datum_t get_id() const;
     const std::string &get_pkey() const;
     datum_t get_row(env_t *env, datum_t pval);
+    // Reads all of the rows at once.  See `base_table_t::read_rows`.
+    std::vector<datum_t> get_rows(env_t *env, const std::vector<datum_t> &pvals);
     counted_t<datum_stream_t> get_all(
             env_t *env,
             datum_t value,
@@ -80,7 +83,8 @@ public:
     MUST_USE bool sindex_create(
         env_t *env, const std::string &name,
         counted_t<const func_t> index_func, sindex_multi_bool_t multi,
-        sindex_geo_bool_t geo);
+        sindex_geo_bool_t geo, const std::vector<std::string> &covering,
+        counted_t<const func_t> filter);
     MUST_USE bool sindex_drop(env_t *env, const std::string &name);
     MUST_USE sindex_rename_result_t sindex_rename(
         env_t *env, const std::string &old_name,
@@ -89,6 +93,7 @@ public:
     datum_t sindex_status(env_t *env,
         std::set<std::string> sindex);
     MUST_USE bool sync(env_t *env);
+    MUST_USE bool truncate(env_t *env, durability_requirement_t durability_requirement);
 
     /* `db` and `name` are mostly for display purposes, but some things like the
     `reconfigure()` logic use them. */
@@ -118,6 +123,10 @@ private:
     MUST_USE bool sync_depending_on_durability(
         env_t *env, durability_requirement_t durability_requirement);
 
+    // Returns NULL if `--outdated-read-cache` is off or the table isn't a real one.
+    outdated_read_cache_t *outdated_read_cache(env_t *env, std::string *table_id_out);
+    void drop_cached_rows(env_t *env, const std::vector<datum_t> &pkeys);
+
     bool use_outdated;
 };
 
@@ -164,7 +173,8 @@ public:
     virtual ~single_selection_t() { }
 
     virtual datum_t get() = 0;
-    virtual counted_t<datum_stream_t> read_changes(const datum_t &squash) = 0;
+    virtual counted_t<datum_stream_t> read_changes(const datum_t &squash,
+                                                   bool spill_to_disk) = 0;
     virtual datum_t replace(
         counted_t<const func_t> f, bool nondet_ok,
         durability_requirement_t dur_req, return_changes_t return_changes) = 0;
@@ -232,6 +242,11 @@ public:
     val_t(counted_t<const func_t> _func, protob_t<const Backtrace> bt);
     ~val_t();
 
+    // Evaluating a query creates and destroys a `val_t` for nearly every term it
+    // evaluates, so we get their memory from a per-thread free list.
+    static void *operator new(size_t size);
+    static void operator delete(void *ptr);
+
     counted_t<const db_t> as_db() const;
     counted_t<table_t> as_table();
     counted_t<table_t> get_underlying_table() const;
@@ -49,9 +49,24 @@
 
 void validate_pb(const Query &q) {
     check_type(Query, q);
-    if (q.type() == Query::START) {
+    if (q.type() == Query::START
+        || q.type() == Query::PREPARE
+        || q.type() == Query::EXECUTE) {
         check_has(q, has_query, "query");
         validate_pb(q.query());
+        if (q.type() == Query::PREPARE) {
+            rcheck_toplevel(q.query().type() == Term::FUNC,
+                            ql::base_exc_t::GENERIC,
+                            "MALFORMED PROTOBUF (PREPARE query must be a FUNC).");
+        } else if (q.type() == Query::EXECUTE) {
+            rcheck_toplevel(q.query().type() == Term::MAKE_ARRAY
+                            && q.query().args_size() >= 1
+                            && q.query().args(0).type() == Term::DATUM
+                            && q.query().args(0).datum().type() == Datum::R_NUM,
+                            ql::base_exc_t::GENERIC,
+                            "MALFORMED PROTOBUF (EXECUTE query must be an array "
+                            "starting with the prepared query's id).");
+        }
     } else {
         check_not_has(q, has_query, "query");
     }
@@ -99,6 +114,9 @@ void validate_pb(const Response &r) {
 
 void validate_pb(const Datum &d) {
     check_type(Datum, d);
+    rcheck_toplevel(d.type() != Datum::R_SERIALIZED,
+                    ql::base_exc_t::GENERIC,
+                    "MALFORMED PROTOBUF (R_SERIALIZED is only used in responses).");
     if (d.type() == Datum::R_BOOL) {
         check_has(d, has_r_bool, "r_bool");
     } else {
@@ -192,6 +210,7 @@ static std::set<std::string> acceptable_keys = {
     "base",
     "binary_format",
     "conflict",
+    "covering",
     "data",
     "db",
     "default",
@@ -199,6 +218,7 @@ static std::set<std::string> acceptable_keys = {
     "dry_run",
     "durability",
     "fill",
+    "filter",
     "first_batch_scaledown_factor",
     "float",
     "geo",
@@ -221,16 +241,21 @@ static std::set<std::string> acceptable_keys = {
     "overwrite",
     "page",
     "page_limit",
+    "parallel_eval",
     "params",
     "primary_key",
     "primary_replica_tag",
+    "priority",
     "profile",
     "redirects",
     "replicas",
     "result_format",
+    "result_cache",
+    "resume_from",
     "return_changes",
     "return_vals",
     "shards",
+    "spill_to_disk",
     "squash",
     "time_format",
     "timeout",
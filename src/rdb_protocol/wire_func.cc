@@ -208,12 +208,16 @@ RDB_IMPL_SERIALIZABLE_4_SINCE_v1_13(group_wire_func_t, funcs, append_index, mult
 
 RDB_IMPL_SERIALIZABLE_0_SINCE_v1_13(count_wire_func_t);
 
+RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(sample_wire_func_t, n);
+
 RDB_IMPL_SERIALIZABLE_0_FOR_CLUSTER(zip_wire_func_t);
 
 RDB_IMPL_SERIALIZABLE_2_SINCE_v1_13(filter_wire_func_t, filter_func, default_filter_val);
 
 RDB_MAKE_SERIALIZABLE_1_FOR_CLUSTER(distinct_wire_func_t, use_index);
 
+RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(project_wire_func_t, type, paths, fallback);
+
 template <cluster_version_t W>
 void serialize(write_message_t *wm, const bt_wire_func_t &btwf) {
     serialize_protobuf(wm, *btwf.bt);
@@ -230,4 +234,6 @@ archive_result_t deserialize(read_stream_t *s, bt_wire_func_t *btwf) {
 
 INSTANTIATE_SERIALIZABLE_SINCE_v1_13(bt_wire_func_t);
 
+RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(unindexed_distinct_wire_func_t, bt);
+
 }  // namespace ql
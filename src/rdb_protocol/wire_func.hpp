@@ -9,6 +9,7 @@
 
 #include "containers/uuid.hpp"
 #include "rdb_protocol/counted_term.hpp"
+#include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/pb_utils.hpp"
 #include "rdb_protocol/sym.hpp"
 #include "rdb_protocol/var_types.hpp"
@@ -115,10 +116,43 @@ struct count_wire_func_t {
 };
 RDB_DECLARE_SERIALIZABLE(count_wire_func_t);
 
+// `sample`: each shard picks up to `n` of its rows, and the picks are then merged.
+class sample_wire_func_t {
+public:
+    sample_wire_func_t() : n(0) { }
+    explicit sample_wire_func_t(uint64_t _n) : n(_n) { }
+    uint64_t n;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(sample_wire_func_t);
+
 class zip_wire_func_t {
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(zip_wire_func_t);
 
+enum class project_type_t { PLUCK, WITHOUT };
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
+        project_type_t, int8_t,
+        project_type_t::PLUCK, project_type_t::WITHOUT);
+
+// `pluck` or `without` on a sequence, when the paths don't depend on the row.  This
+// lets the shards project rows directly instead of evaluating a function on each of
+// them.  `fallback` is the function the term would have been mapped as otherwise; it
+// is still used for rows that aren't plain objects, so that they produce the same
+// errors as before.
+class project_wire_func_t {
+public:
+    project_wire_func_t() : type(project_type_t::PLUCK) { }
+    project_wire_func_t(project_type_t _type, datum_t _paths,
+                        const map_wire_func_t &_fallback)
+        : type(_type), paths(std::move(_paths)), fallback(_fallback) { }
+
+    project_type_t type;
+    // Already checked to be a valid `pathspec_t`.
+    datum_t paths;
+    map_wire_func_t fallback;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(project_wire_func_t);
+
 class bt_wire_func_t {
 public:
     bt_wire_func_t() : bt(make_counted_backtrace()) { }
@@ -194,6 +228,17 @@ public:
     explicit max_wire_func_t(Args... args) : skip_wire_func_t(args...) { }
 };
 
+// `distinct` without an index: each shard finds its distinct rows, and those are
+// then merged.  `bt` is for the error when there are too many of them.
+class unindexed_distinct_wire_func_t {
+public:
+    unindexed_distinct_wire_func_t() { }
+    explicit unindexed_distinct_wire_func_t(const protob_t<const Backtrace> &_bt)
+        : bt(_bt) { }
+    bt_wire_func_t bt;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(unindexed_distinct_wire_func_t);
+
 }  // namespace ql
 
 #endif  // RDB_PROTOCOL_WIRE_FUNC_HPP_
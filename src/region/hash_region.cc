@@ -13,19 +13,32 @@
 // distributed beteween 0 and UINT64_MAX / 2, so that splitting
 // [0,UINT64_MAX/2] into equal intervals of size ((UINT64_MAX / 2 + 1)
 // / n) will uniformly distribute keys.
+//
+// The hash decides which CPU shard's store a key lives in, so it must never change.
+// Every key a read or write touches gets hashed, so it looks up each byte's spread
+// bits in a table instead of computing them with three multiplications.
+class hash_region_byte_table_t {
+public:
+    hash_region_byte_table_t() {
+        for (uint64_t ch = 0; ch < 256; ++ch) {
+            // By the power of magic, the 62nd, 61st, ..., 55th bits of d
+            // are equal to the 0th, 1st, 2nd, ..., 7th bits of ch.  This
+            // helps us meet the criterion specified above.
+            table[ch] = (((ch * 0x80200802ULL) & 0x0884422110ULL) * 0x0101010101ULL) << 23;
+        }
+    }
+    uint64_t table[256];
+};
+
 uint64_t hash_region_hasher(const uint8_t *s, ssize_t len) {
     rassert(len >= 0);
 
+    static const hash_region_byte_table_t byte_table;
+    const uint64_t *table = byte_table.table;
+
     uint64_t h = 0x47a59e381fb2dc06ULL;
     for (ssize_t i = 0; i < len; ++i) {
-        uint8_t ch = s[i];
-
-        // By the power of magic, the 62nd, 61st, ..., 55th bits of d
-        // are equal to the 0th, 1st, 2nd, ..., 7th bits of ch.  This
-        // helps us meet the criterion specified above.
-        uint64_t d = (((ch * 0x80200802ULL) & 0x0884422110ULL) * 0x0101010101ULL) << 23;
-
-        h += d;
+        h += table[s[i]];
         h = h ^ (h >> 11) ^ (h << 21);
     }
 
@@ -2,6 +2,7 @@
 #define REGION_REGION_MAP_HPP_
 
 #include <algorithm>
+#include <type_traits>
 #include <vector>
 #include <utility>
 
@@ -9,7 +10,29 @@
 #include "region/region.hpp"
 #include "rpc/serialize_macros.hpp"
 
-/* Regions contained in region_map_t must never intersect. */
+namespace region_map_details {
+
+/* Whether `value_t`s can be compared with `==`, so that `region_map_t` can merge
+neighboring regions with the same value. */
+template <class value_t>
+class is_equality_comparable_t {
+private:
+    template <class T>
+    static auto test(int) -> decltype(
+        static_cast<bool>(std::declval<const T &>() == std::declval<const T &>()),
+        std::true_type());
+    template <class T>
+    static std::false_type test(...);
+public:
+    static const bool value = decltype(test<value_t>(0))::value;
+};
+
+}  // namespace region_map_details
+
+/* Regions contained in region_map_t must never intersect.  After an `update()`,
+neighboring regions with equal values are merged (if values can be compared), so
+that maps that get set piece by piece, like version maps during a backfill, stay
+small. */
 template <class value_t>
 class region_map_t {
 private:
@@ -89,9 +112,22 @@ public:
         }
 
         internal_vec_t updated_pairs;
-        for (const_iterator i = begin(); i != end(); ++i) {
-            region_t old = i->first;
-            std::vector<region_t> old_subregions = region_subtract_many(old, overlay_regions);
+        updated_pairs.reserve(regions_and_values.size() + new_values.size());
+        std::vector<region_t> overlapping;
+        for (iterator i = begin(); i != end(); ++i) {
+            // Most old regions don't overlap any of the new ones, and those we can
+            // keep as they are without working out the difference.
+            overlapping.clear();
+            for (const region_t &overlay : overlay_regions) {
+                if (region_overlaps(i->first, overlay)) {
+                    overlapping.push_back(overlay);
+                }
+            }
+            if (overlapping.empty()) {
+                updated_pairs.push_back(std::move(*i));
+                continue;
+            }
+            std::vector<region_t> old_subregions = region_subtract_many(i->first, overlapping);
 
             // Insert the unchanged parts of the old region into updated_pairs with the old value
             for (typename std::vector<region_t>::const_iterator j = old_subregions.begin(); j != old_subregions.end(); ++j) {
@@ -100,7 +136,9 @@ public:
         }
         std::copy(new_values.begin(), new_values.end(), std::back_inserter(updated_pairs));
 
-        regions_and_values = updated_pairs;
+        regions_and_values.swap(updated_pairs);
+        coalesce(std::integral_constant<bool,
+            region_map_details::is_equality_comparable_t<value_t>::value>());
     }
 
     void set(const region_t &r, const value_t &v) {
@@ -121,6 +159,69 @@ public:
     RDB_MAKE_ME_SERIALIZABLE_1(region_map_t, regions_and_values);
 
 private:
+    void coalesce(std::false_type) { }
+
+    /* Merges regions with equal values that have the same hash range and adjoining
+    key ranges, and then ones that have the same key range and adjoining hash
+    ranges.  That catches what piecewise updates along either dimension leave
+    behind. */
+    void coalesce(std::true_type) {
+        if (regions_and_values.size() < 2) {
+            return;
+        }
+        typedef std::pair<region_t, value_t> pair_t;
+        std::sort(regions_and_values.begin(), regions_and_values.end(),
+                  [](const pair_t &a, const pair_t &b) {
+                      if (a.first.beg != b.first.beg) {
+                          return a.first.beg < b.first.beg;
+                      }
+                      if (a.first.end != b.first.end) {
+                          return a.first.end < b.first.end;
+                      }
+                      return a.first.inner.left < b.first.inner.left;
+                  });
+        merge_neighbors([](const region_t &a, const region_t &b) {
+            return a.beg == b.beg && a.end == b.end
+                && !a.inner.right.unbounded && a.inner.right.key == b.inner.left;
+        }, [](region_t *a, const region_t &b) {
+            a->inner.right = b.inner.right;
+        });
+
+        if (regions_and_values.size() < 2) {
+            return;
+        }
+        std::sort(regions_and_values.begin(), regions_and_values.end(),
+                  [](const pair_t &a, const pair_t &b) {
+                      if (a.first.inner != b.first.inner) {
+                          return a.first.inner < b.first.inner;
+                      }
+                      return a.first.beg < b.first.beg;
+                  });
+        merge_neighbors([](const region_t &a, const region_t &b) {
+            return a.inner == b.inner && a.end == b.beg;
+        }, [](region_t *a, const region_t &b) {
+            a->end = b.end;
+        });
+    }
+
+    template <class adjoin_t, class join_t>
+    void merge_neighbors(const adjoin_t &adjoin, const join_t &join) {
+        size_t out = 0;
+        for (size_t i = 1; i < regions_and_values.size(); ++i) {
+            std::pair<region_t, value_t> *last = &regions_and_values[out];
+            if (adjoin(last->first, regions_and_values[i].first)
+                && last->second == regions_and_values[i].second) {
+                join(&last->first, regions_and_values[i].first);
+            } else {
+                ++out;
+                if (out != i) {
+                    regions_and_values[out] = std::move(regions_and_values[i]);
+                }
+            }
+        }
+        regions_and_values.resize(out + 1);
+    }
+
     internal_vec_t regions_and_values;
 };
 
@@ -2,6 +2,7 @@
 #include "rpc/connectivity/cluster.hpp"
 
 #include <netinet/in.h>
+#include <zlib.h>
 
 #include <algorithm>
 #include <functional>
@@ -128,13 +129,19 @@ void connectivity_cluster_t::connection_t::kill_connection() {
 connectivity_cluster_t::connection_t::connection_t(run_t *p,
                                               peer_id_t id,
                                               keepalive_tcp_conn_stream_t *c,
-                                              const peer_address_t &a) THROWS_NOTHING :
+                                              const peer_address_t &a,
+                                              bool cm) THROWS_NOTHING :
     conn(c), peer_address(a),
+    compress_messages(cm),
+    round_trip_time_us(-1),
     pm_collection(),
     pm_bytes_sent(secs_to_ticks(1), true),
+    pm_round_trip_time(secs_to_ticks(LATENCY_HISTOGRAM_INTERVAL_SECS)),
     pm_collection_membership(&p->parent->connectivity_collection, &pm_collection,
         uuid_to_str(id.get_uuid())),
     pm_bytes_sent_membership(&pm_collection, &pm_bytes_sent, "bytes_sent"),
+    pm_round_trip_time_membership(&pm_collection, &pm_round_trip_time,
+        "round_trip_time"),
     parent(p), peer_id(id),
     drainers()
 {
@@ -239,7 +246,7 @@ connectivity_cluster_t::run_t::run_t(connectivity_cluster_t *p,
     `connection_map` on each thread and notifying any listeners that we're now
     connected to ourself. The destructor will remove us from the
     `connection_map` and again notify any listeners. */
-    connection_to_ourself(this, parent->me, NULL, routing_table[parent->me]),
+    connection_to_ourself(this, parent->me, NULL, routing_table[parent->me], false),
 
     listener(new tcp_listener_t(
         cluster_listener_socket.get(),
@@ -392,14 +399,39 @@ private:
     DISABLE_COPYING(cluster_conn_closing_subscription_t);
 };
 
+/* A heartbeat is either a request, which carries the time at which it was sent, or
+the reply to one, which carries the same time back. */
+class heartbeat_writer_t : public cluster_send_message_write_callback_t {
+public:
+    /* A request gets the time at which it's written. */
+    static heartbeat_writer_t request() {
+        return heartbeat_writer_t(false, 0);
+    }
+    static heartbeat_writer_t reply(microtime_t request_time) {
+        return heartbeat_writer_t(true, request_time);
+    }
+    void write(write_stream_t *stream) {
+        write_message_t wm;
+        serialize_universal(&wm, is_reply);
+        serialize_universal(&wm, is_reply ? time : current_microtime());
+        int res = send_write_message(stream, &wm);
+        if (res) { throw fake_archive_exc_t(); }
+    }
+private:
+    heartbeat_writer_t(bool _is_reply, microtime_t _time)
+        : is_reply(_is_reply), time(_time) { }
+    bool is_reply;
+    microtime_t time;
+};
+
 /* `heartbeat_manager_t` is responsible for sending heartbeats over a single connection
-and making sure that heartbeats have arrived on time.
+and making sure that heartbeats have arrived on time. The other server answers each
+heartbeat, and the answers give the connection's round-trip time.
 `connectivity_cluster_t::run_t::handle()` constructs one after constructing the
 `connection_t`. */
 class connectivity_cluster_t::heartbeat_manager_t :
     public keepalive_tcp_conn_stream_t::keepalive_callback_t,
-    private repeating_timer_callback_t,
-    private cluster_send_message_write_callback_t
+    private repeating_timer_callback_t
 {
 public:
     static const int64_t HEARTBEAT_INTERVAL_MS = 2000;
@@ -411,7 +443,7 @@ public:
             std::string peer_str_) :
         connection(connection_),
         connection_keepalive(connection_keepalive_),
-        read_done(false), write_done(false),
+        read_done(false),
         intervals_since_last_read_done(0),
         peer_str(peer_str_),
         timer(HEARTBEAT_INTERVAL_MS, this)
@@ -428,7 +460,7 @@ public:
         read_done = true;
     }
     void keepalive_write() {
-        write_done = true;
+        /* Heartbeats get sent whether or not we wrote anything else. */
     }
     void on_ring() {
         ASSERT_FINITE_CORO_WAITING;
@@ -441,20 +473,9 @@ public:
             connection->kill_connection();
             return;
         }
-        if (write_done) {
-            write_done = false;
-        } else {
-            /* The purpose of `heartbeat_manager_keepalive` is to ensure that we don't
-            shut down while the heartbeat sending coroutine is still active */
-            auto_drainer_t::lock_t this_keepalive(&drainer);
-            coro_t::spawn_later_ordered(
-                [this, this_keepalive /* important to capture */] {
-                    /* This might block, so we have to run it in a sub-coroutine. */
-                    connection->parent->parent->send_message(
-                        connection, connection_keepalive,
-                        connectivity_cluster_t::heartbeat_tag, this);
-                });
-        }
+        /* We send a heartbeat even if we wrote something else since the last one,
+        so that the round-trip time stays up to date. */
+        send_heartbeat(heartbeat_writer_t::request());
         if (read_done) {
             intervals_since_last_read_done = 0;
             read_done = false;
@@ -462,13 +483,55 @@ public:
             intervals_since_last_read_done++;
         }
     }
-    void write(write_stream_t *) {
-        /* Do nothing. The cluster will end up sending just the tag 'H' with no message
-        attached, which will trigger `keepalive_read()` on the remote server. */
+
+    /* Called by `handle()` for each heartbeat that arrives. Returns false if the
+    heartbeat is invalid. */
+    MUST_USE bool on_heartbeat(read_stream_t *stream) {
+        bool is_reply;
+        microtime_t time;
+        if (bad(deserialize_universal(stream, &is_reply)) ||
+            bad(deserialize_universal(stream, &time))) {
+            return false;
+        }
+        if (!is_reply) {
+            send_heartbeat(heartbeat_writer_t::reply(time));
+            return true;
+        }
+        const microtime_t now = current_microtime();
+        /* The clock might have been set back since the request was sent. */
+        if (now >= time) {
+            const int64_t sample = now - time;
+            connection->pm_round_trip_time.record(sample * THOUSAND);
+            const int64_t average = connection->round_trip_time_us.load();
+            connection->round_trip_time_us.store(average == -1
+                ? sample
+                : average + (sample - average) / HEARTBEAT_ROUND_TRIP_AVERAGE_WEIGHT);
+        }
+        return true;
     }
+
+private:
+    /* Round-trip times get averaged with weights that fall by this factor with each
+    newer sample. */
+    static const int64_t HEARTBEAT_ROUND_TRIP_AVERAGE_WEIGHT = 4;
+
+    void send_heartbeat(heartbeat_writer_t writer) {
+        /* The purpose of `this_keepalive` is to ensure that we don't shut down while
+        the heartbeat sending coroutine is still active */
+        auto_drainer_t::lock_t this_keepalive(&drainer);
+        coro_t::spawn_later_ordered(
+            [this, this_keepalive /* important to capture */, writer]() mutable {
+                /* This might block, so we have to run it in a sub-coroutine. */
+                connection->parent->parent->send_message(
+                    connection, connection_keepalive,
+                    connectivity_cluster_t::heartbeat_tag, &writer,
+                    message_priority_t::HIGH);
+            });
+    }
+
     connectivity_cluster_t::connection_t *connection;
     auto_drainer_t::lock_t connection_keepalive;
-    bool read_done, write_done;
+    bool read_done;
     int intervals_since_last_read_done;
     std::string peer_str;
 
@@ -716,6 +779,96 @@ archive_result_t deserialize_universal(read_stream_t *s, handshake_result_t *out
     return res;
 }
 
+/* A compressed message is `compressed_tag`, followed by the tag of the message, its
+uncompressed size, its compressed size and its zlib-compressed contents. Returns
+false (leaving `compressed_out` untouched) if compressing `data` wouldn't make it
+smaller. */
+bool compress_message(const std::vector<char> &data,
+                      std::vector<char> *compressed_out) {
+    // `compress2` fails if the data doesn't fit, so there's no need to allocate the
+    // whole `compressBound(data.size())`.
+    std::vector<char> compressed(data.size());
+    uLongf compressed_size = compressed.size();
+    const int res = compress2(reinterpret_cast<Bytef *>(compressed.data()),
+                              &compressed_size,
+                              reinterpret_cast<const Bytef *>(data.data()),
+                              data.size(), Z_BEST_SPEED);
+    if (res == Z_BUF_ERROR || compressed_size >= data.size()) {
+        return false;
+    }
+    guarantee(res == Z_OK, "compress2 failed with %d", res);
+    compressed.resize(compressed_size);
+    *compressed_out = std::move(compressed);
+    return true;
+}
+
+/* Reads the rest of a message tagged `compressed_tag`. Returns false if the
+connection fails or the message is invalid. */
+bool read_compressed_message(read_stream_t *conn,
+                             connectivity_cluster_t::message_tag_t *tag_out,
+                             std::vector<char> *data_out) {
+    connectivity_cluster_t::message_tag_t tag;
+    uint64_t uncompressed_size, compressed_size;
+    if (bad(deserialize_universal(conn, &tag)) ||
+        bad(deserialize_universal(conn, &uncompressed_size)) ||
+        bad(deserialize_universal(conn, &compressed_size))) {
+        return false;
+    }
+    if (tag == connectivity_cluster_t::heartbeat_tag ||
+        tag == connectivity_cluster_t::compressed_tag ||
+        tag == connectivity_cluster_t::fragment_tag ||
+        uncompressed_size > CLUSTER_MESSAGE_MAX_UNCOMPRESSED_SIZE ||
+        compressed_size >= uncompressed_size) {
+        return false;
+    }
+
+    std::vector<char> compressed(compressed_size);
+    if (force_read(conn, compressed.data(), compressed_size)
+            != static_cast<int64_t>(compressed_size)) {
+        return false;
+    }
+    std::vector<char> data(uncompressed_size);
+    uLongf size = uncompressed_size;
+    const int res = uncompress(reinterpret_cast<Bytef *>(data.data()), &size,
+                               reinterpret_cast<const Bytef *>(compressed.data()),
+                               compressed_size);
+    if (res != Z_OK || size != uncompressed_size) {
+        return false;
+    }
+    *tag_out = tag;
+    *data_out = std::move(data);
+    return true;
+}
+
+/* Reads the rest of a message tagged `fragment_tag`, and appends the fragment to
+`message`. `message_size` is the size of the whole message, or 0 if `message` is
+empty. Returns false if the connection fails or the fragment is invalid. */
+bool read_message_fragment(keepalive_tcp_conn_stream_t *conn,
+                           std::vector<char> *message,
+                           uint64_t *message_size) {
+    uint64_t total_size, fragment_size;
+    if (bad(deserialize_universal(conn, &total_size)) ||
+        bad(deserialize_universal(conn, &fragment_size))) {
+        return false;
+    }
+    if (message->empty()) {
+        if (total_size > CLUSTER_MESSAGE_MAX_UNCOMPRESSED_SIZE) {
+            return false;
+        }
+        *message_size = total_size;
+    }
+    if (total_size != *message_size ||
+        fragment_size == 0 ||
+        fragment_size > CLUSTER_MESSAGE_FRAGMENT_SIZE ||
+        fragment_size > total_size - message->size()) {
+        return false;
+    }
+    const size_t offset = message->size();
+    message->resize(offset + fragment_size);
+    return force_read(conn, message->data() + offset, fragment_size)
+        == static_cast<int64_t>(fragment_size);
+}
+
 void fail_handshake(keepalive_tcp_conn_stream_t *conn,
                     const char *peername,
                     const handshake_result_t &reason,
@@ -787,6 +940,8 @@ void connectivity_cluster_t::run_t::handle(
         wm.append(cluster_build_mode.data(), cluster_build_mode.length());
         serialize_universal(&wm, parent->me);
         serialize_universal(&wm, routing_table[parent->me].hosts());
+        // We accept compressed messages.
+        serialize_universal(&wm, true);
         if (send_write_message(conn, &wm)) {
             return; // network error.
         }
@@ -880,11 +1035,13 @@ void connectivity_cluster_t::run_t::handle(
         }
     }
 
-    // Receive id, host/ports.
+    // Receive id, host/ports, and whether the other side accepts compressed messages.
     peer_id_t other_id;
     std::set<host_and_port_t> other_peer_addr_hosts;
+    bool other_accepts_compression;
     if (deserialize_universal_and_check(conn, &other_id, peername) ||
-        deserialize_universal_and_check(conn, &other_peer_addr_hosts, peername)) {
+        deserialize_universal_and_check(conn, &other_peer_addr_hosts, peername) ||
+        deserialize_universal_and_check(conn, &other_accepts_compression, peername)) {
         return;
     }
 
@@ -1091,7 +1248,10 @@ void connectivity_cluster_t::run_t::handle(
         /* `connection_t` is the public interface of this coroutine. Its
         constructor registers it in the `connectivity_cluster_t`'s connection
         map. */
-        connection_t conn_structure(this, other_id, conn, *other_peer_addr.get());
+        /* Compressing messages to a server on the same machine would only cost us
+        CPU time. */
+        connection_t conn_structure(this, other_id, conn, *other_peer_addr.get(),
+            other_accepts_compression && !peer_addr.ip().is_loopback());
 
         /* `heartbeat_manager` will periodically send a heartbeat message to
         other servers, and it will also close the connection if we don't
@@ -1105,28 +1265,76 @@ void connectivity_cluster_t::run_t::handle(
         it's closed, which may be due to network events, or the other end
         shutting down, or us shutting down. */
         try {
+            /* Handles a message that has been read up to and including `tag`. */
+            auto handle_message = [&](message_tag_t tag, read_stream_t *stream) {
+                /* The `keepalive_tcp_conn_stream_t` will have already notified the
+                `heartbeat_manager_t` that something arrived; this lets it answer
+                heartbeats and time the answers. */
+                if (tag == heartbeat_tag) {
+                    if (!heartbeat_manager.on_heartbeat(stream)) {
+                        throw fake_archive_exc_t();
+                    }
+                    return;
+                }
+
+                /* A compressed message carries the real tag, so we have to
+                uncompress it before we can find its handler. */
+                const bool compressed = tag == compressed_tag;
+                std::vector<char> uncompressed;
+                if (compressed &&
+                    !read_compressed_message(stream, &tag, &uncompressed)) {
+                    throw fake_archive_exc_t();
+                }
+
+                cluster_message_handler_t *handler = parent->message_handlers[tag];
+                guarantee(handler != NULL, "Got a message for an unfamiliar tag. "
+                    "Apparently we aren't compatible with the cluster on the other "
+                    "end.");
+
+                /* If you really want to support old cluster versions, the
+                resolved_version should be passed into the on_message() handler. */
+                guarantee(resolved_version == cluster_version_t::CLUSTER);
+                if (compressed) {
+                    vector_read_stream_t uncompressed_stream(std::move(uncompressed));
+                    handler->on_message(
+                        &conn_structure,
+                        auto_drainer_t::lock_t(conn_structure.drainers.get()),
+                        &uncompressed_stream); // might raise fake_archive_exc_t
+                } else {
+                    handler->on_message(
+                        &conn_structure,
+                        auto_drainer_t::lock_t(conn_structure.drainers.get()),
+                        stream); // might raise fake_archive_exc_t
+                }
+            };
+
+            /* The message that we're getting in fragments, so far. */
+            std::vector<char> fragmented_message;
+            uint64_t fragmented_message_size = 0;
+
             int messages_handled_since_yield = 0;
             while (true) {
                 message_tag_t tag;
                 archive_result_t res = deserialize_universal(conn, &tag);
                 if (bad(res)) { throw fake_archive_exc_t(); }
 
-                /* Ignore messages tagged with the heartbeat tag. The
-                `keepalive_tcp_conn_stream_t` will have already notified the
-                `heartbeat_manager_t` as soon as the heartbeat arrived. */
-                if (tag != heartbeat_tag) {
-                    cluster_message_handler_t *handler = parent->message_handlers[tag];
-                    guarantee(handler != NULL, "Got a message for an unfamiliar tag. "
-                        "Apparently we aren't compatible with the cluster on the other "
-                        "end.");
-
-                    /* If you really want to support old cluster versions, the
-                    resolved_version should be passed into the on_message() handler. */
-                    guarantee(resolved_version == cluster_version_t::CLUSTER);
-                    handler->on_message(
-                        &conn_structure,
-                        auto_drainer_t::lock_t(conn_structure.drainers.get()),
-                        conn); // might raise fake_archive_exc_t
+                if (tag == fragment_tag) {
+                    if (!read_message_fragment(conn, &fragmented_message,
+                                               &fragmented_message_size)) {
+                        throw fake_archive_exc_t();
+                    }
+                    if (fragmented_message.size() == fragmented_message_size) {
+                        vector_read_stream_t stream(std::move(fragmented_message));
+                        fragmented_message.clear();
+                        message_tag_t inner_tag;
+                        res = deserialize_universal(&stream, &inner_tag);
+                        if (bad(res) || inner_tag == fragment_tag) {
+                            throw fake_archive_exc_t();
+                        }
+                        handle_message(inner_tag, &stream);
+                    }
+                } else {
+                    handle_message(tag, conn);
                 }
 
                 ++messages_handled_since_yield;
@@ -1196,8 +1404,10 @@ connectivity_cluster_t::connection_t *connectivity_cluster_t::get_connection(
 void connectivity_cluster_t::send_message(connection_t *connection,
                                      auto_drainer_t::lock_t connection_keepalive,
                                      message_tag_t tag,
-                                     cluster_send_message_write_callback_t *callback) {
+                                     cluster_send_message_write_callback_t *callback,
+                                     message_priority_t priority) {
     // We could be on _any_ thread.
+    const bool high_priority = priority == message_priority_t::HIGH;
 
     /* We currently write the message to a vector_stream_t, then
        serialize that as a string. It's horribly inefficient, of course. */
@@ -1235,6 +1445,17 @@ void connectivity_cluster_t::send_message(connection_t *connection,
 
     size_t bytes_sent = buffer.vector().size();
 
+    /* We compress before switching to the connection's thread, so that messages to
+    the same server get compressed in parallel. */
+    std::vector<char> compressed;
+    const bool send_compressed = connection->compress_messages &&
+        buffer.vector().size() >= CLUSTER_MESSAGE_COMPRESSION_MIN_SIZE &&
+        compress_message(buffer.vector(), &compressed);
+    if (send_compressed) {
+        bytes_sent = compressed.size();
+    }
+    const std::vector<char> &data = send_compressed ? compressed : buffer.vector();
+
     if (connection->is_loopback()) {
         // We could be on any thread here! Oh no!
         std::vector<char> buffer_data;
@@ -1243,13 +1464,9 @@ void connectivity_cluster_t::send_message(connection_t *connection,
         message_handlers[tag]->on_local_message(connection, connection_keepalive,
             std::move(buffer_data));
     } else {
-        on_thread_t threader(connection->conn->home_thread());
-
-        /* Acquire the send-mutex so we don't collide with other things trying
-        to send on the same connection. */
-        mutex_t::acq_t acq(&connection->send_mutex);
-
-        /* Write the tag to the network */
+        /* The header is the tag, and for a compressed message, what
+        `read_compressed_message()` reads before the compressed contents. */
+        vector_stream_t header;
         {
             // All cluster versions use a uint8_t tag here.
             write_message_t wm;
@@ -1258,20 +1475,29 @@ void connectivity_cluster_t::send_message(connection_t *connection,
                           "changed, the cluster communication format has changed and "
                           "you need to ask yourself whether live cluster upgrades work."
                           );
-            serialize_universal(&wm, tag);
-            int res = send_write_message(connection->conn, &wm);
-            if (res == -1) {
-                if (connection->conn->is_read_open()) {
-                    connection->conn->shutdown_read();
-                }
-                return;
+            if (send_compressed) {
+                serialize_universal(&wm, compressed_tag);
+                serialize_universal(&wm, tag);
+                serialize_universal(&wm, static_cast<uint64_t>(buffer.vector().size()));
+                serialize_universal(&wm, static_cast<uint64_t>(compressed.size()));
+            } else {
+                serialize_universal(&wm, tag);
             }
+            int res = send_write_message(&header, &wm);
+            guarantee(res == 0);
         }
 
-        /* Write the message itself to the network */
-        {
-            int64_t res = connection->conn->write(buffer.vector().data(),
-                                                  buffer.vector().size());
+        on_thread_t threader(connection->conn->home_thread());
+
+        /* Writes `prefix` and `size` bytes of `data` to the network. Returns false
+        if the connection failed. */
+        auto write_to_connection = [&](const write_message_t &prefix,
+                                       const char *bytes, size_t size) -> bool {
+            int64_t res = send_write_message(connection->conn, &prefix);
+            if (res != -1 && size > 0) {
+                res = connection->conn->write(bytes, size);
+                guarantee(res == -1 || res == static_cast<int64_t>(size));
+            }
             if (res == -1) {
                 /* Close the other half of the connection to make sure that
                    `connectivity_cluster_t::run_t::handle()` notices that something is
@@ -1279,9 +1505,52 @@ void connectivity_cluster_t::send_message(connection_t *connection,
                 if (connection->conn->is_read_open()) {
                     connection->conn->shutdown_read();
                 }
+                return false;
+            }
+            return true;
+        };
+
+        if (data.size() <= CLUSTER_MESSAGE_FRAGMENT_SIZE) {
+            /* Acquire the send-mutex so we don't collide with other things trying
+            to send on the same connection. */
+            priority_mutex_t::acq_t acq(&connection->send_mutex, high_priority);
+
+            write_message_t wm;
+            wm.append(header.vector().data(), header.vector().size());
+            if (!write_to_connection(wm, data.data(), data.size())) {
                 return;
-            } else {
-                guarantee(res == static_cast<int64_t>(buffer.vector().size()));
+            }
+        } else {
+            /* We send a big message in fragments, and release the send-mutex after
+            each one, so that the messages that are waiting behind it, like heartbeats
+            and small writes, go out in between instead of waiting for all of it. The
+            other server only puts together one fragmented message at a time. */
+            priority_mutex_t::acq_t fragments_acq(&connection->fragmented_send_mutex,
+                                                  high_priority);
+
+            const uint64_t total_size = header.vector().size() + data.size();
+            size_t data_offset = 0;
+            bool first = true;
+            while (data_offset < data.size()) {
+                const size_t header_part = first ? header.vector().size() : 0;
+                const size_t data_part = std::min<size_t>(
+                    CLUSTER_MESSAGE_FRAGMENT_SIZE - header_part,
+                    data.size() - data_offset);
+
+                write_message_t wm;
+                serialize_universal(&wm, fragment_tag);
+                serialize_universal(&wm, total_size);
+                serialize_universal(&wm, static_cast<uint64_t>(header_part + data_part));
+                if (first) {
+                    wm.append(header.vector().data(), header.vector().size());
+                }
+
+                priority_mutex_t::acq_t acq(&connection->send_mutex, high_priority);
+                if (!write_to_connection(wm, data.data() + data_offset, data_part)) {
+                    return;
+                }
+                data_offset += data_part;
+                first = false;
             }
         }
     }
@@ -1298,6 +1567,12 @@ cluster_message_handler_t::cluster_message_handler_t(
     rassert(tag != connectivity_cluster_t::heartbeat_tag,
         "Tag %" PRIu8 " is reserved for heartbeat messages.",
         connectivity_cluster_t::heartbeat_tag);
+    rassert(tag != connectivity_cluster_t::compressed_tag,
+        "Tag %" PRIu8 " is reserved for compressed messages.",
+        connectivity_cluster_t::compressed_tag);
+    rassert(tag != connectivity_cluster_t::fragment_tag,
+        "Tag %" PRIu8 " is reserved for message fragments.",
+        connectivity_cluster_t::fragment_tag);
     rassert(connectivity_cluster->message_handlers[tag] == NULL);
     connectivity_cluster->message_handlers[tag] = this;
 }
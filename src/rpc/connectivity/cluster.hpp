@@ -2,6 +2,7 @@
 #ifndef RPC_CONNECTIVITY_CLUSTER_HPP_
 #define RPC_CONNECTIVITY_CLUSTER_HPP_
 
+#include <atomic>
 #include <map>
 #include <set>
 #include <string>
@@ -12,9 +13,11 @@
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/mutex.hpp"
 #include "concurrency/one_per_thread.hpp"
+#include "concurrency/priority_mutex.hpp"
 #include "concurrency/watchable.hpp"
 #include "containers/archive/tcp_conn_stream.hpp"
 #include "containers/map_sentries.hpp"
+#include "perfmon/histogram.hpp"
 #include "perfmon/perfmon.hpp"
 #include "rpc/connectivity/peer_id.hpp"
 #include "utils.hpp"
@@ -27,6 +30,16 @@ class co_semaphore_t;
 
 class cluster_message_handler_t;
 
+/* Messages of `HIGH` priority go out ahead of the `NORMAL` ones that are waiting to be
+sent on the same connection, including the remaining fragments of big messages. Use it
+for small, latency-sensitive messages such as query reads and heartbeats, not for bulk
+data. */
+enum class message_priority_t : int8_t { NORMAL = 0, HIGH = 1 };
+
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(message_priority_t, int8_t,
+                                      message_priority_t::NORMAL,
+                                      message_priority_t::HIGH);
+
 class cluster_send_message_write_callback_t {
 public:
     virtual ~cluster_send_message_write_callback_t() { }
@@ -73,6 +86,13 @@ public:
     /* This tag is reserved exclusively for heartbeat messages. */
     static const message_tag_t heartbeat_tag = 'H';
 
+    /* This tag is reserved for compressed messages, which carry the tag of the
+    message inside them. */
+    static const message_tag_t compressed_tag = 'Z';
+
+    /* This tag is reserved for the fragments that big messages get sent in. */
+    static const message_tag_t fragment_tag = 'F';
+
     class run_t;
 
     /* `connection_t` represents an open connection to another server. If we lose
@@ -104,6 +124,15 @@ public:
             return conn == NULL;
         }
 
+        /* Returns a moving average of the round-trip times of the heartbeats to the
+        other server, in microseconds. Returns 0 for the loopback connection, and -1 if
+        no heartbeat has come back yet. Since heartbeats wait behind the messages that
+        were sent before them, this includes the time the other server takes to get to
+        them. */
+        int64_t get_round_trip_time_us() {
+            return is_loopback() ? 0 : round_trip_time_us.load();
+        }
+
         /* Drops the connection. */
         void kill_connection();
 
@@ -113,7 +142,7 @@ public:
         /* The constructor registers us in every thread's `connections` map, thereby
         notifying event subscribers. */
         connection_t(run_t *, peer_id_t, keepalive_tcp_conn_stream_t *,
-                const peer_address_t &peer) THROWS_NOTHING;
+                const peer_address_t &peer, bool compress_messages) THROWS_NOTHING;
         ~connection_t() THROWS_NOTHING;
 
         /* NULL for the loopback connection (i.e. our "connection" to ourself) */
@@ -125,11 +154,27 @@ public:
         peer_address_t peer_address;
 
         /* Unused for our connection to ourself */
-        mutex_t send_mutex;
+        priority_mutex_t send_mutex;
+
+        /* Held while sending a message in fragments, since the other server only
+        puts together one fragmented message at a time. Acquired before
+        `send_mutex`. */
+        priority_mutex_t fragmented_send_mutex;
+
+        /* Whether messages of at least CLUSTER_MESSAGE_COMPRESSION_MIN_SIZE bytes
+        get compressed. Both servers have to accept compressed messages for this, and
+        it's never the case for our connection to ourself. */
+        const bool compress_messages;
+
+        /* Written by the `heartbeat_manager_t` on the connection's thread. */
+        std::atomic<int64_t> round_trip_time_us;
 
         perfmon_collection_t pm_collection;
         perfmon_sampler_t pm_bytes_sent;
-        perfmon_membership_t pm_collection_membership, pm_bytes_sent_membership;
+        /* The heartbeats' round-trip times, as opposed to their moving average. */
+        perfmon_latency_histogram_t pm_round_trip_time;
+        perfmon_membership_t pm_collection_membership, pm_bytes_sent_membership,
+            pm_round_trip_time_membership;
 
         /* We only hold this information so we can deregister ourself */
         run_t *parent;
@@ -280,11 +325,12 @@ public:
 
     /* Sends a message to the other server. The message is associated with a "tag",
     which determines which message handler on the other server will receive the message.
-    */
+    Messages of the same priority arrive in the order they were sent in. */
     void send_message(connection_t *connection,
                       auto_drainer_t::lock_t connection_keepalive,
                       message_tag_t tag,
-                      cluster_send_message_write_callback_t *callback);
+                      cluster_send_message_write_callback_t *callback,
+                      message_priority_t priority = message_priority_t::NORMAL);
 
 private:
     friend class cluster_message_handler_t;
@@ -6,6 +6,7 @@
 #include "concurrency/one_per_thread.hpp"
 #include "concurrency/watchable_map.hpp"
 #include "rpc/connectivity/cluster.hpp"
+#include "rpc/directory/value_delta.hpp"
 
 template<class key_t, class value_t>
 class directory_map_read_manager_t :
@@ -35,9 +36,18 @@ private:
             const key_t &key,
             const boost::optional<value_t> &value);
 
+    /* Returns the serialized values that deltas from `connection` apply to, which are
+    kept on the connection's thread. */
+    std::map<key_t, std::vector<char> > *get_delta_bases(
+            connectivity_cluster_t::connection_t *connection,
+            auto_drainer_t::lock_t connection_keepalive);
+
     watchable_map_var_t<std::pair<peer_id_t, key_t>, value_t> map_var;
     std::map<peer_id_t, std::map<key_t, uint64_t> > timestamps;
 
+    one_per_thread_t<std::map<connectivity_cluster_t::connection_t *,
+                              std::map<key_t, std::vector<char> > > > delta_bases;
+
     /* Instances of `do_update()` hold a lock on one of these drainers. */
     one_per_thread_t<auto_drainer_t> per_thread_drainers;
 };
@@ -8,6 +8,7 @@
 #include <boost/bind.hpp>
 
 #include "containers/archive/boost_types.hpp"
+#include "containers/archive/vector_stream.hpp"
 
 template<class key_t, class value_t>
 directory_map_read_manager_t<key_t, value_t>::directory_map_read_manager_t(
@@ -40,11 +41,52 @@ void directory_map_read_manager_t<key_t, value_t>::on_message(
     if (res != archive_result_t::SUCCESS) {
         throw fake_archive_exc_t();
     }
-    boost::optional<value_t> value;
-    res = deserialize<cluster_version_t::CLUSTER>(s, &value);
+    uint8_t code;
+    res = deserialize_universal(s, &code);
     if (res != archive_result_t::SUCCESS) {
         throw fake_archive_exc_t();
     }
+
+    /* See `directory_map_write_manager_t::update_writer_t` for the format. */
+    std::map<key_t, std::vector<char> > *bases = connection->is_loopback()
+        ? nullptr
+        : get_delta_bases(connection, connection_keepalive);
+    boost::optional<value_t> value;
+    if (code == 'N') {
+        if (bases != nullptr) {
+            bases->erase(key);
+        }
+    } else {
+        std::vector<char> serialized;
+        if (code == 'F') {
+            res = deserialize_value_bytes(s, &serialized);
+            if (res != archive_result_t::SUCCESS) {
+                throw fake_archive_exc_t();
+            }
+        } else if (code == 'D') {
+            value_delta_t delta;
+            res = deserialize_value_delta(s, &delta);
+            if (res != archive_result_t::SUCCESS || bases == nullptr) {
+                throw fake_archive_exc_t();
+            }
+            auto it = bases->find(key);
+            if (it == bases->end() || !delta.apply(it->second, &serialized)) {
+                throw fake_archive_exc_t();
+            }
+        } else {
+            throw fake_archive_exc_t();
+        }
+        value = value_t();
+        vector_read_stream_t value_stream(
+            bases != nullptr ? std::vector<char>(serialized) : std::move(serialized));
+        res = deserialize<cluster_version_t::CLUSTER>(&value_stream, &*value);
+        if (res != archive_result_t::SUCCESS) {
+            throw fake_archive_exc_t();
+        }
+        if (bases != nullptr) {
+            (*bases)[key] = std::move(serialized);
+        }
+    }
     auto_drainer_t::lock_t this_keepalive(per_thread_drainers.get());
     coro_t::spawn_sometime(boost::bind(
         &directory_map_read_manager_t::do_update, this,
@@ -52,6 +94,29 @@ void directory_map_read_manager_t<key_t, value_t>::on_message(
         timestamp, key, value));
 }
 
+template<class key_t, class value_t>
+std::map<key_t, std::vector<char> > *
+directory_map_read_manager_t<key_t, value_t>::get_delta_bases(
+        connectivity_cluster_t::connection_t *connection,
+        auto_drainer_t::lock_t connection_keepalive) {
+    auto pair = delta_bases.get()->insert(
+        std::make_pair(connection, std::map<key_t, std::vector<char> >()));
+    if (pair.second) {
+        /* Forget about the connection's values once it goes away, which is before
+        another connection can get the same address. */
+        auto_drainer_t::lock_t this_keepalive(per_thread_drainers.get());
+        coro_t::spawn_sometime(
+            [this, connection, connection_keepalive, this_keepalive]() {
+                wait_any_t waiter(
+                    connection_keepalive.get_drain_signal(),
+                    this_keepalive.get_drain_signal());
+                waiter.wait_lazily_unordered();
+                delta_bases.get()->erase(connection);
+            });
+    }
+    return &pair.first->second;
+}
+
 template<class key_t, class value_t>
 void directory_map_read_manager_t<key_t, value_t>::do_update(
         peer_id_t peer_id,
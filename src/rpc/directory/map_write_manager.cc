@@ -1,7 +1,12 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rpc/directory/map_write_manager.tcc"
 
+#include <string>
+
+#include "containers/archive/stl_types.hpp"
+
 template class directory_map_write_manager_t<int, int>;
+template class directory_map_write_manager_t<int, std::string>;
 
 #include "clustering/administration/tables/table_metadata.hpp"
 #include "containers/archive/cow_ptr_type.hpp"
@@ -6,6 +6,7 @@
 #include "concurrency/new_semaphore.hpp"
 #include "concurrency/watchable_map.hpp"
 #include "rpc/connectivity/cluster.hpp"
+#include "rpc/directory/value_delta.hpp"
 
 template<class key_t, class value_t>
 class directory_map_write_manager_t {
@@ -21,7 +22,8 @@ private:
     for creating the `conn_info_t` and spawning the coroutine; the coroutine is
     responsible for stopping itself and removing the `conn_info_t`. The coroutine's job
     is to check for keys marked as dirty in `dirty_keys` and send those key-value pairs
-    over the network. */
+    over the network. Once a value has been sent on a connection, changes to it go out
+    as a `value_delta_t` against what was sent last. */
 
     class update_writer_t;
 
@@ -32,6 +34,10 @@ private:
         and `pulse_on_dirty` will be pulsed if it is non-null. */
         std::set<key_t> dirty_keys;
         cond_t *pulse_on_dirty;
+        /* The serialized value we last sent for each key, which the other server will
+        apply the next delta for that key to. Not used for our connection to
+        ourself. */
+        std::map<key_t, std::vector<char> > sent_values;
     };
 
     void on_connections_change();
@@ -7,7 +7,9 @@
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
+#include "config/args.hpp"
 #include "containers/archive/boost_types.hpp"
+#include "containers/archive/vector_stream.hpp"
 
 template<class key_t, class value_t>
 directory_map_write_manager_t<key_t, value_t>::directory_map_write_manager_t(
@@ -41,19 +43,35 @@ directory_map_write_manager_t<key_t, value_t>::directory_map_write_manager_t(
     on_connections_change();
 }
 
+/* The message is the timestamp, the key and one of these:
+ - 'N' for a deleted key
+ - 'F' and the serialized value
+ - 'D' and a `value_delta_t` against the serialized value sent before it */
 template<class key_t, class value_t>
 class directory_map_write_manager_t<key_t, value_t>::update_writer_t :
     public cluster_send_message_write_callback_t
 {
 public:
-    update_writer_t(
-            uint64_t _timestamp, const key_t &_key, boost::optional<value_t> &&_value) :
-        timestamp(_timestamp), key(_key), value(std::move(_value)) { }
+    update_writer_t(uint64_t _timestamp, const key_t &_key) :
+        timestamp(_timestamp), key(_key), code('N'), value(nullptr) { }
+    void set_value(const std::vector<char> *_value) {
+        code = 'F';
+        value = _value;
+    }
+    void set_delta(value_delta_t &&_delta) {
+        code = 'D';
+        delta = std::move(_delta);
+    }
     void write(write_stream_t *s) {
         write_message_t wm;
         serialize<cluster_version_t::CLUSTER>(&wm, timestamp);
         serialize<cluster_version_t::CLUSTER>(&wm, key);
-        serialize<cluster_version_t::CLUSTER>(&wm, value);
+        serialize_universal(&wm, code);
+        if (code == 'F') {
+            serialize_value_bytes(&wm, *value);
+        } else if (code == 'D') {
+            serialize_value_delta(&wm, delta);
+        }
         int res = send_write_message(s, &wm);
         if (res) {
             throw fake_archive_exc_t();
@@ -62,7 +80,9 @@ public:
 private:
     uint64_t timestamp;
     key_t key;
-    boost::optional<value_t> value;
+    uint8_t code;
+    const std::vector<char> *value;
+    value_delta_t delta;
 };
 
 template<class key_t, class value_t>
@@ -115,9 +135,39 @@ void directory_map_write_manager_t<key_t, value_t>::stream_to_conn(
                 time as we copied `dirty_keys`. So it's OK to remove the key from
                 `dirty_keys` to prevent sending a redundant message. */
                 conns_entry->second.dirty_keys.erase(key);
-                update_writer_t writer(timestamp, key, value->get_key(key));
+                update_writer_t writer(timestamp, key);
+                std::map<key_t, std::vector<char> > *sent_values =
+                    &conns_entry->second.sent_values;
+                boost::optional<value_t> new_value = value->get_key(key);
+                std::vector<char> serialized;
+                if (static_cast<bool>(new_value)) {
+                    write_message_t wm;
+                    serialize<cluster_version_t::CLUSTER>(&wm, *new_value);
+                    vector_stream_t stream;
+                    stream.reserve(wm.size());
+                    int res = send_write_message(&stream, &wm);
+                    guarantee(res == 0);
+                    stream.swap(&serialized);
+
+                    auto it = sent_values->find(key);
+                    if (it != sent_values->end()) {
+                        value_delta_t delta = value_delta_t::make(it->second, serialized);
+                        if (delta.bytes_saved() >= DIRECTORY_DELTA_MIN_BYTES_SAVED) {
+                            writer.set_delta(std::move(delta));
+                        } else {
+                            writer.set_value(&serialized);
+                        }
+                    } else {
+                        writer.set_value(&serialized);
+                    }
+                }
                 connectivity_cluster->send_message(
                     connection, connection_keepalive, message_tag, &writer);
+                if (!static_cast<bool>(new_value)) {
+                    sent_values->erase(key);
+                } else if (!connection->is_loopback()) {
+                    (*sent_values)[key] = std::move(serialized);
+                }
             }
         }
     } catch (const interrupted_exc_t &) {
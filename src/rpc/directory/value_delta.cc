@@ -0,0 +1,73 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rpc/directory/value_delta.hpp"
+
+#include <algorithm>
+
+#include "config/args.hpp"
+
+value_delta_t value_delta_t::make(const std::vector<char> &from,
+                                  const std::vector<char> &to) {
+    value_delta_t delta;
+    const size_t max_common = std::min(from.size(), to.size());
+    size_t prefix = 0;
+    while (prefix < max_common && from[prefix] == to[prefix]) {
+        ++prefix;
+    }
+    /* The suffix can't overlap the prefix in either of the values. */
+    size_t suffix = 0;
+    while (suffix < max_common - prefix
+           && from[from.size() - 1 - suffix] == to[to.size() - 1 - suffix]) {
+        ++suffix;
+    }
+    delta.prefix_size = prefix;
+    delta.suffix_size = suffix;
+    delta.middle.assign(to.begin() + prefix, to.end() - suffix);
+    return delta;
+}
+
+bool value_delta_t::apply(const std::vector<char> &from,
+                          std::vector<char> *to_out) const {
+    if (prefix_size > from.size() || suffix_size > from.size() - prefix_size) {
+        return false;
+    }
+    to_out->clear();
+    to_out->reserve(prefix_size + middle.size() + suffix_size);
+    to_out->insert(to_out->end(), from.begin(), from.begin() + prefix_size);
+    to_out->insert(to_out->end(), middle.begin(), middle.end());
+    to_out->insert(to_out->end(), from.end() - suffix_size, from.end());
+    return true;
+}
+
+/* The `std::vector` serialization goes element by element, which is slow for bytes. */
+void serialize_value_bytes(write_message_t *wm, const std::vector<char> &bytes) {
+    serialize_universal(wm, static_cast<uint64_t>(bytes.size()));
+    wm->append(bytes.data(), bytes.size());
+}
+
+archive_result_t deserialize_value_bytes(read_stream_t *s, std::vector<char> *bytes_out) {
+    uint64_t size;
+    archive_result_t res = deserialize_universal(s, &size);
+    if (bad(res)) { return res; }
+    if (size > CLUSTER_MESSAGE_MAX_UNCOMPRESSED_SIZE) {
+        return archive_result_t::RANGE_ERROR;
+    }
+    bytes_out->resize(size);
+    int64_t num_read = force_read(s, bytes_out->data(), size);
+    if (num_read == -1) { return archive_result_t::SOCK_ERROR; }
+    if (num_read < static_cast<int64_t>(size)) { return archive_result_t::SOCK_EOF; }
+    return archive_result_t::SUCCESS;
+}
+
+void serialize_value_delta(write_message_t *wm, const value_delta_t &delta) {
+    serialize_universal(wm, delta.prefix_size);
+    serialize_universal(wm, delta.suffix_size);
+    serialize_value_bytes(wm, delta.middle);
+}
+
+archive_result_t deserialize_value_delta(read_stream_t *s, value_delta_t *delta_out) {
+    archive_result_t res = deserialize_universal(s, &delta_out->prefix_size);
+    if (bad(res)) { return res; }
+    res = deserialize_universal(s, &delta_out->suffix_size);
+    if (bad(res)) { return res; }
+    return deserialize_value_bytes(s, &delta_out->middle);
+}
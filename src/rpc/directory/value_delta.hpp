@@ -0,0 +1,48 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RPC_DIRECTORY_VALUE_DELTA_HPP_
+#define RPC_DIRECTORY_VALUE_DELTA_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "containers/archive/archive.hpp"
+
+/* `directory_map_write_manager_t` sends a changed value as a `value_delta_t` against
+the serialized value it last sent on the same connection, which the other side keeps
+around. Big values such as reactor business cards usually change in one place, and the
+delta only holds the bytes between the parts that stayed the same at the beginning and
+at the end. */
+class value_delta_t {
+public:
+    value_delta_t() : prefix_size(0), suffix_size(0) { }
+
+    /* Returns a delta that turns `from` into `to`. */
+    static value_delta_t make(const std::vector<char> &from,
+                              const std::vector<char> &to);
+
+    /* Returns false if the delta can't have been made from `from`, which is a sign of
+    corrupt or out-of-order messages. */
+    MUST_USE bool apply(const std::vector<char> &from,
+                        std::vector<char> *to_out) const;
+
+    /* How much smaller this is than sending all of the new value's bytes. */
+    size_t bytes_saved() const {
+        return prefix_size + suffix_size;
+    }
+
+    uint64_t prefix_size;
+    uint64_t suffix_size;
+    std::vector<char> middle;
+};
+
+/* Serialize raw bytes, such as a serialized value. */
+void serialize_value_bytes(write_message_t *wm, const std::vector<char> &bytes);
+MUST_USE archive_result_t deserialize_value_bytes(read_stream_t *s,
+                                                  std::vector<char> *bytes_out);
+
+void serialize_value_delta(write_message_t *wm, const value_delta_t &delta);
+MUST_USE archive_result_t deserialize_value_delta(read_stream_t *s,
+                                                  value_delta_t *delta_out);
+
+#endif  // RPC_DIRECTORY_VALUE_DELTA_HPP_
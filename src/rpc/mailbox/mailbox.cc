@@ -15,10 +15,11 @@
 /* raw_mailbox_t */
 
 raw_mailbox_t::address_t::address_t() :
-    peer(peer_id_t()), thread(-1), mailbox_id(0) { }
+    peer(peer_id_t()), thread(-1), mailbox_id(0),
+    priority(message_priority_t::NORMAL) { }
 
 raw_mailbox_t::address_t::address_t(const address_t &a) :
-    peer(a.peer), thread(a.thread), mailbox_id(a.mailbox_id) { }
+    peer(a.peer), thread(a.thread), mailbox_id(a.mailbox_id), priority(a.priority) { }
 
 bool raw_mailbox_t::address_t::is_nil() const {
     return peer.is_nil();
@@ -33,9 +34,11 @@ std::string raw_mailbox_t::address_t::human_readable() const {
     return strprintf("%s:%d:%" PRIu64, uuid_to_str(peer.get_uuid()).c_str(), thread, mailbox_id);
 }
 
-raw_mailbox_t::raw_mailbox_t(mailbox_manager_t *m, mailbox_read_callback_t *_callback) :
+raw_mailbox_t::raw_mailbox_t(mailbox_manager_t *m, mailbox_read_callback_t *_callback,
+                             message_priority_t _priority) :
     manager(m),
     mailbox_id(manager->register_mailbox(this)),
+    priority(_priority),
     callback(_callback) {
     guarantee(callback != nullptr);
 }
@@ -60,6 +63,7 @@ raw_mailbox_t::address_t raw_mailbox_t::get_address() const {
     a.peer = manager->get_connectivity_cluster()->get_me();
     a.thread = home_thread().threadnum;
     a.mailbox_id = mailbox_id;
+    a.priority = priority;
     return a;
 }
 
@@ -109,7 +113,10 @@ void send(mailbox_manager_t *src, raw_mailbox_t::address_t dest,
         mailbox_write_callback_t *callback) {
     guarantee(src);
     guarantee(!dest.is_nil());
-    new_semaphore_acq_t acq(src->semaphores.get(), 1);
+    new_semaphore_acq_t acq(dest.priority == message_priority_t::HIGH
+                                ? src->high_priority_semaphores.get()
+                                : src->semaphores.get(),
+                            1);
     acq.acquisition_signal()->wait();
     connectivity_cluster_t::connection_t *connection;
     auto_drainer_t::lock_t connection_keepalive;
@@ -119,7 +126,7 @@ void send(mailbox_manager_t *src, raw_mailbox_t::address_t dest,
     }
     raw_mailbox_writer_t writer(dest.thread, dest.mailbox_id, callback);
     src->get_connectivity_cluster()->send_message(connection, connection_keepalive,
-        src->get_message_tag(), &writer);
+        src->get_message_tag(), &writer, dest.priority);
 }
 
 static const int MAX_OUTSTANDING_MAILBOX_WRITES_PER_THREAD = 4;
@@ -127,7 +134,8 @@ static const int MAX_OUTSTANDING_MAILBOX_WRITES_PER_THREAD = 4;
 mailbox_manager_t::mailbox_manager_t(connectivity_cluster_t *connectivity_cluster,
         connectivity_cluster_t::message_tag_t message_tag) :
     cluster_message_handler_t(connectivity_cluster, message_tag),
-    semaphores(MAX_OUTSTANDING_MAILBOX_WRITES_PER_THREAD)
+    semaphores(MAX_OUTSTANDING_MAILBOX_WRITES_PER_THREAD),
+    high_priority_semaphores(MAX_OUTSTANDING_MAILBOX_WRITES_PER_THREAD)
     { }
 
 mailbox_manager_t::mailbox_table_t::mailbox_table_t() {
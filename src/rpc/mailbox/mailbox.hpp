@@ -17,7 +17,12 @@ class mailbox_manager_t;
 
 /* `mailbox_t` is a receiver of messages. Construct it with a callback function
 to handle messages it receives. To send messages to the mailbox, call the
-`get_address()` method and then call `send()` on the address it returns. */
+`get_address()` method and then call `send()` on the address it returns.
+
+A mailbox can also be given a `message_priority_t`, which its address carries along,
+so that everything sent to it goes through that priority's lane. Query reads and their
+replies use `message_priority_t::HIGH`, so that they don't queue up behind backfills
+and other bulk traffic. */
 
 class mailbox_write_callback_t {
 public:
@@ -56,6 +61,8 @@ private:
 
     const id_t mailbox_id;
 
+    const message_priority_t priority;
+
     /* `callback` will be set to `nullptr` after `begin_shutdown()` is called. This is
     both a way of ensuring that no new callbacks are spawned and of making sure that
     the destructor won't call `begin_shutdown()` again. */
@@ -92,7 +99,7 @@ public:
 
         RDB_MAKE_ME_EQUALITY_COMPARABLE_3(raw_mailbox_t::address_t, peer, thread, mailbox_id);
 
-        RDB_MAKE_ME_SERIALIZABLE_3(address_t, peer, thread, mailbox_id);
+        RDB_MAKE_ME_SERIALIZABLE_4(address_t, peer, thread, mailbox_id, priority);
 
     private:
         friend void send(mailbox_manager_t *, raw_mailbox_t::address_t, mailbox_write_callback_t *callback);
@@ -107,9 +114,13 @@ public:
 
         /* The ID of the mailbox */
         id_t mailbox_id;
+
+        /* The priority that messages to the mailbox get sent with */
+        message_priority_t priority;
     };
 
-    raw_mailbox_t(mailbox_manager_t *, mailbox_read_callback_t *callback);
+    raw_mailbox_t(mailbox_manager_t *, mailbox_read_callback_t *callback,
+                  message_priority_t priority = message_priority_t::NORMAL);
 
     /* Note that `~raw_mailbox_t()` will block until all of the callbacks have finished
     running. */
@@ -154,8 +165,10 @@ private:
 
     /* We must acquire one of these semaphores whenever we want to send a message over a
     mailbox. This prevents mailbox messages from starving directory and semilattice
-    messages. */
+    messages. High-priority messages have their own, so that they don't wait for the
+    slots that bulk messages are holding. */
     one_per_thread_t<new_semaphore_t> semaphores;
+    one_per_thread_t<new_semaphore_t> high_priority_semaphores;
 
     raw_mailbox_t::id_t generate_mailbox_id();
 
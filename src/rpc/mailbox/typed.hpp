@@ -102,8 +102,9 @@ public:
     typedef mailbox_addr_t< void() > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const std::function< void(signal_t *)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const std::function< void(signal_t *)> &f,
+              message_priority_t priority = message_priority_t::NORMAL) :
+        reader(this), fun(f), mailbox(manager, &reader, priority)
         { }
 
     void begin_shutdown() {
@@ -165,8 +166,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const std::function< void(signal_t *, arg0_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const std::function< void(signal_t *, arg0_t)> &f,
+              message_priority_t priority = message_priority_t::NORMAL) :
+        reader(this), fun(f), mailbox(manager, &reader, priority)
         { }
 
     void begin_shutdown() {
@@ -235,8 +237,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const std::function< void(signal_t *, arg0_t, arg1_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const std::function< void(signal_t *, arg0_t, arg1_t)> &f,
+              message_priority_t priority = message_priority_t::NORMAL) :
+        reader(this), fun(f), mailbox(manager, &reader, priority)
         { }
 
     void begin_shutdown() {
@@ -310,8 +313,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t)> &f,
+              message_priority_t priority = message_priority_t::NORMAL) :
+        reader(this), fun(f), mailbox(manager, &reader, priority)
         { }
 
     void begin_shutdown() {
@@ -390,8 +394,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t)> &f,
+              message_priority_t priority = message_priority_t::NORMAL) :
+        reader(this), fun(f), mailbox(manager, &reader, priority)
         { }
 
     void begin_shutdown() {
@@ -475,8 +480,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t, arg4_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t, arg4_t)> &f,
+              message_priority_t priority = message_priority_t::NORMAL) :
+        reader(this), fun(f), mailbox(manager, &reader, priority)
         { }
 
     void begin_shutdown() {
@@ -565,8 +571,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t)> &f,
+              message_priority_t priority = message_priority_t::NORMAL) :
+        reader(this), fun(f), mailbox(manager, &reader, priority)
         { }
 
     void begin_shutdown() {
@@ -660,8 +667,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t)> &f,
+              message_priority_t priority = message_priority_t::NORMAL) :
+        reader(this), fun(f), mailbox(manager, &reader, priority)
         { }
 
     void begin_shutdown() {
@@ -760,8 +768,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t)> &f,
+              message_priority_t priority = message_priority_t::NORMAL) :
+        reader(this), fun(f), mailbox(manager, &reader, priority)
         { }
 
     void begin_shutdown() {
@@ -865,8 +874,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t)> &f,
+              message_priority_t priority = message_priority_t::NORMAL) :
+        reader(this), fun(f), mailbox(manager, &reader, priority)
         { }
 
     void begin_shutdown() {
@@ -975,8 +985,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t)> &f,
+              message_priority_t priority = message_priority_t::NORMAL) :
+        reader(this), fun(f), mailbox(manager, &reader, priority)
         { }
 
     void begin_shutdown() {
@@ -1090,8 +1101,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t)> &f,
+              message_priority_t priority = message_priority_t::NORMAL) :
+        reader(this), fun(f), mailbox(manager, &reader, priority)
         { }
 
     void begin_shutdown() {
@@ -1210,8 +1222,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t, arg11_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t, arg11_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t, arg11_t)> &f,
+              message_priority_t priority = message_priority_t::NORMAL) :
+        reader(this), fun(f), mailbox(manager, &reader, priority)
         { }
 
     void begin_shutdown() {
@@ -1335,8 +1348,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t, arg11_t, arg12_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t, arg11_t, arg12_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t, arg11_t, arg12_t)> &f,
+              message_priority_t priority = message_priority_t::NORMAL) :
+        reader(this), fun(f), mailbox(manager, &reader, priority)
         { }
 
     void begin_shutdown() {
@@ -1465,8 +1479,9 @@ public:
     typedef mailbox_addr_t< void(arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t, arg11_t, arg12_t, arg13_t) > address_t;
 
     mailbox_t(mailbox_manager_t *manager,
-              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t, arg11_t, arg12_t, arg13_t)> &f) :
-        reader(this), fun(f), mailbox(manager, &reader)
+              const std::function< void(signal_t *, arg0_t, arg1_t, arg2_t, arg3_t, arg4_t, arg5_t, arg6_t, arg7_t, arg8_t, arg9_t, arg10_t, arg11_t, arg12_t, arg13_t)> &f,
+              message_priority_t priority = message_priority_t::NORMAL) :
+        reader(this), fun(f), mailbox(manager, &reader, priority)
         { }
 
     void begin_shutdown() {
@@ -21,6 +21,22 @@ void semilattice_join(std::map<key_t, value_t> *a, const std::map<key_t, value_t
     }
 }
 
+/* Sets `*changes_out` to the entries of `b` that aren't the same in `a`. Joining them
+into anything that already includes `a` gives the same result as joining all of `b`,
+which `semilattice_manager_t` relies on to only send what changed. */
+template<class key_t, class value_t>
+void semilattice_changes(const std::map<key_t, value_t> &a,
+                         const std::map<key_t, value_t> &b,
+                         std::map<key_t, value_t> *changes_out) {
+    changes_out->clear();
+    for (auto it = b.begin(); it != b.end(); ++it) {
+        auto it2 = a.find(it->first);
+        if (it2 == a.end() || !(it2->second == it->second)) {
+            changes_out->insert(changes_out->end(), *it);
+        }
+    }
+}
+
 }   /* namespace std */
 
 #endif /* RPC_SEMILATTICE_JOINS_MAP_HPP_ */
@@ -29,9 +29,27 @@ constraints:
     such that `metadata_t` is a semilattice and `semilattice_join(a, b)` sets
     `*a` to the semilattice-join of `*a` and `b`.
 
+4. Optionally, there can be a function:
+
+        void semilattice_changes(const metadata_t &a, const metadata_t &b,
+                                 metadata_t *changes_out);
+
+    that sets `*changes_out` to a value that has the same effect as `b` when joined
+    into anything that already includes `a`, but that is smaller because it leaves
+    out the parts of `b` that are already in `a`. When a peer already has our
+    metadata, we only send it these changes; it only gets all of the metadata when it
+    connects. Without this function, we send the whole value that was joined.
+
 Currently it's not thread-safe at all; all accesses to the metadata must be on
 the home thread of the `semilattice_manager_t`. */
 
+/* The default for types that don't have a `semilattice_changes()` of their own. */
+template<class metadata_t>
+void semilattice_changes(UNUSED const metadata_t &a, const metadata_t &b,
+                         metadata_t *changes_out) {
+    *changes_out = b;
+}
+
 template<class metadata_t>
 class semilattice_manager_t :
     public home_thread_mixin_t,
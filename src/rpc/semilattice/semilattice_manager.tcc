@@ -69,6 +69,11 @@ void semilattice_manager_t<metadata_t>::root_view_t::join(const metadata_t &adde
     guarantee(parent, "accessing `semilattice_manager_t` root view when cluster no longer exists");
     parent->assert_thread();
 
+    /* Our peers already have our metadata, or will get all of it when they connect,
+    so we only send them the parts of `added_metadata` that change it. */
+    metadata_t changes;
+    semilattice_changes(parent->metadata, added_metadata, &changes);
+
     metadata_version_t new_version = ++parent->metadata_version;
     parent->join_metadata_locally(added_metadata);
 
@@ -86,8 +91,8 @@ void semilattice_manager_t<metadata_t>::root_view_t::join(const metadata_t &adde
         coro_t::spawn_sometime(
             [this, parent_keepalive /* important to capture */,
              connection, connection_keepalive /* important to capture */,
-             new_version, added_metadata]() {
-                metadata_writer_t writer(added_metadata, new_version);
+             new_version, changes]() {
+                metadata_writer_t writer(changes, new_version);
                 new_semaphore_acq_t acq(&parent->semaphore, 1);
                 acq.acquisition_signal()->wait();
                 parent->get_connectivity_cluster()->send_message(connection,
@@ -6,10 +6,11 @@
 #include "containers/scoped.hpp"
 #include "errors.hpp"
 #include "math.hpp"
+#include "serializer/ser_buffer_allocator.hpp"
 #include "serializer/types.hpp"
 
-// Memory-aligned bufs.  This type also keeps the unused part of the buf (up to the
-// DEVICE_BLOCK_SIZE multiple) zeroed out.
+// Memory-aligned bufs, from alloc_ser_buffer.  This type also keeps the unused part
+// of the buf (up to the DEVICE_BLOCK_SIZE multiple) zeroed out.
 
 // Note: This wastes 4 bytes of space on a 64-bit system.  (Arguably, it wastes more
 // than that given that block sizes could be 16 bits and pointers are really 48
@@ -25,7 +26,7 @@ public:
     }
 
     buf_ptr_t(block_size_t size,
-            scoped_malloc_t<ser_buffer_t> ser_buffer)
+            scoped_ser_buffer_t ser_buffer)
         : block_size_(size),
           ser_buffer_(std::move(ser_buffer)) {
         guarantee(block_size_.ser_value() != 0);
@@ -81,7 +82,7 @@ public:
     }
 
     void release(block_size_t *block_size_out,
-                 scoped_malloc_t<ser_buffer_t> *ser_buffer_out) {
+                 scoped_ser_buffer_t *ser_buffer_out) {
         buf_ptr_t tmp(std::move(*this));
         *block_size_out = tmp.block_size_;
         *ser_buffer_out = std::move(tmp.ser_buffer_);
@@ -114,7 +115,7 @@ private:
     // more efficiently write the buffer to disk.
     block_size_t block_size_;
     // The buffer, or empty if this buf_ptr_t is empty.
-    scoped_malloc_t<ser_buffer_t> ser_buffer_;
+    scoped_ser_buffer_t ser_buffer_;
 
     DISABLE_COPYING(buf_ptr_t);
 };
@@ -15,6 +15,7 @@ struct log_serializer_dynamic_config_t {
     log_serializer_dynamic_config_t() {
         read_ahead = true;
         io_batch_factor = DEFAULT_IO_BATCH_FACTOR;
+        discard_freed_extents = DEFAULT_DISCARD_FREED_EXTENTS;
     }
 
     /* The (minimal) batch size of i/o requests being taken from a single i/o account.
@@ -24,6 +25,10 @@ struct log_serializer_dynamic_config_t {
 
     /* Enable reading more data than requested to let the cache warmup more quickly esp. on rotational drives */
     bool read_ahead;
+
+    /* Tell the file system or SSD about extents that garbage collection has freed up,
+    so that it can reclaim the space. */
+    bool discard_freed_extents;
 };
 
 /* This is equivalent to log_serializer_static_config_t below, but is an on-disk
@@ -31,6 +36,9 @@ structure. Changes to this change the on-disk database format! */
 struct log_serializer_on_disk_static_config_t {
     uint64_t block_size_;
     uint64_t extent_size_;
+    // Nonzero if blocks get compressed before they're written.  The static header is
+    // zero-filled, so files from before this existed read as uncompressed.
+    uint64_t compress_blocks_;
 
     // Some helpers
     uint64_t blocks_per_extent() const { return extent_size_ / block_size_; }
@@ -39,6 +47,7 @@ struct log_serializer_on_disk_static_config_t {
     // Minimize calls to these.
     max_block_size_t max_block_size() const { return max_block_size_t::unsafe_make(block_size_); }
     uint64_t extent_size() const { return extent_size_; }
+    bool compress_blocks() const { return compress_blocks_ != 0; }
 };
 
 /* Configuration for the serializer that is set when the database is created */
@@ -46,11 +55,18 @@ struct log_serializer_static_config_t : public log_serializer_on_disk_static_con
     log_serializer_static_config_t() {
         extent_size_ = DEFAULT_EXTENT_SIZE;
         block_size_ = DEFAULT_BTREE_BLOCK_SIZE;
+        compress_blocks_ = 0;
+    }
+    log_serializer_static_config_t(uint64_t block_size, bool compress_blocks) {
+        rassert(DEFAULT_EXTENT_SIZE % block_size == 0);
+        extent_size_ = DEFAULT_EXTENT_SIZE;
+        block_size_ = block_size;
+        compress_blocks_ = compress_blocks ? 1 : 0;
     }
 };
 
-RDB_MAKE_SERIALIZABLE_2(log_serializer_static_config_t,
-                        block_size_, extent_size_);
+RDB_MAKE_SERIALIZABLE_3(log_serializer_static_config_t,
+                        block_size_, extent_size_, compress_blocks_);
 
 #endif /* SERIALIZER_LOG_CONFIG_HPP_ */
 
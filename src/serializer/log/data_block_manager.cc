@@ -3,11 +3,13 @@
 
 #include <inttypes.h>
 #include <sys/uio.h>
+#include <zlib.h>
 
 #include <functional>
 
 #include "arch/arch.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
 #include "concurrency/mutex.hpp"
 #include "concurrency/new_mutex.hpp"
 #include "errors.hpp"
@@ -398,8 +400,10 @@ void data_block_manager_t::prepare_initial_metablock(data_block_manager::metablo
     mb->active_extent = NULL_OFFSET;
 }
 
-void data_block_manager_t::start_reconstruct() {
+void data_block_manager_t::start_reconstruct(file_t *file) {
     guarantee(state == state_unstarted);
+    dbfile = file;
+    state = state_reconstructing;
 }
 
 // Marks the block at the given offset as alive, in the appropriate
@@ -410,7 +414,7 @@ void data_block_manager_t::mark_live(int64_t offset, block_size_t ser_block_size
     uint64_t extent_id = static_config->extent_index(offset);
 
     if (entries.get(extent_id) == NULL) {
-        guarantee(state == state_unstarted); // This is called at startup.
+        guarantee(state == state_reconstructing); // This is called at startup.
 
         gc_entry_t *entry = new gc_entry_t(this, extent_id * extent_manager->extent_size);
         reconstructed_extents.push_back(entry);
@@ -421,13 +425,13 @@ void data_block_manager_t::mark_live(int64_t offset, block_size_t ser_block_size
 }
 
 void data_block_manager_t::end_reconstruct() {
-    guarantee(state == state_unstarted);
+    guarantee(state == state_reconstructing);
 }
 
 void data_block_manager_t::start_existing(file_t *file,
                                           data_block_manager::metablock_mixin_t *last_metablock) {
-    guarantee(state == state_unstarted);
-    dbfile = file;
+    guarantee(state == state_reconstructing);
+    guarantee(dbfile == file);
     gc_io_account_nice.init(new file_account_t(file, GC_IO_PRIORITY_NICE));
     gc_io_account_high.init(new file_account_t(file, GC_IO_PRIORITY_HIGH));
 
@@ -455,6 +459,10 @@ void data_block_manager_t::start_existing(file_t *file,
         active_extent = NULL;
     }
 
+    /* The GC's active extent isn't in the metablock, so if it had live blocks it
+    becomes an old extent below, like any other. */
+    gc_active_extent = NULL;
+
     /* Convert any extents that we found live blocks in, but that are not active
     extents, into old extents */
     while (gc_entry_t *entry = reconstructed_extents.head()) {
@@ -470,6 +478,15 @@ void data_block_manager_t::start_existing(file_t *file,
     }
 
     state = state_ready;
+
+    /* Catch up on the tokens that were handed out for reads while we were still
+    reconstructing.  There haven't been any writes yet, so the blocks they point to
+    are all still live in the index. */
+    for (auto it = serializer->offset_tokens.begin();
+         it != serializer->offset_tokens.end();
+         it = serializer->offset_tokens.upper_bound(it->first)) {
+        mark_live_tokenwise_with_offset(it->first);
+    }
 }
 
 // Computes an offset and end offset for the purposes of readahead.  Returns an interval
@@ -560,6 +577,64 @@ void read_ahead_offset_and_size(int64_t off_in,
     *size_out = end_offset - offset;
 }
 
+// A compressed block keeps its `ls_buf_data_t` header as it is, followed by the
+// zlib-compressed cache data.  Whether a block is compressed, and its size before
+// compression, is recorded in the LBA and in block tokens.  Returns false (leaving
+// the outputs untouched) if compressing the block wouldn't save any space on disk.
+bool compress_block(const ser_buffer_t *buf, block_size_t block_size,
+                    scoped_malloc_t<ser_buffer_t> *compressed_out,
+                    block_size_t *compressed_size_out) {
+    // Blocks take up whole device blocks on disk, so the compressed block has to fit
+    // in at least one fewer of them to be worth reading back.
+    const uint32_t aligned_size = ceil_aligned(block_size.ser_value(), DEVICE_BLOCK_SIZE);
+    if (aligned_size <= DEVICE_BLOCK_SIZE) {
+        return false;
+    }
+    const uint32_t max_aligned_size = aligned_size - DEVICE_BLOCK_SIZE;
+
+    scoped_malloc_t<ser_buffer_t> compressed(
+        malloc_aligned(max_aligned_size, DEVICE_BLOCK_SIZE));
+    // `compress2` fails if the data doesn't fit, so there's no need to allocate the
+    // whole `compressBound(size)`.
+    uLongf compressed_size = max_aligned_size - sizeof(ls_buf_data_t);
+    const int res = compress2(reinterpret_cast<Bytef *>(compressed->cache_data),
+                              &compressed_size,
+                              reinterpret_cast<const Bytef *>(buf->cache_data),
+                              block_size.value(),
+                              Z_BEST_SPEED);
+    if (res != Z_OK) {
+        return false;
+    }
+
+    compressed->ser_header = buf->ser_header;
+    const uint32_t ser_size = sizeof(ls_buf_data_t) + compressed_size;
+    // The padding gets written to disk along with the block.
+    memset(reinterpret_cast<char *>(compressed.get()) + ser_size, 0,
+           ceil_aligned(ser_size, DEVICE_BLOCK_SIZE) - ser_size);
+
+    *compressed_out = std::move(compressed);
+    *compressed_size_out = block_size_t::unsafe_make(ser_size);
+    return true;
+}
+
+buf_ptr_t decompress_block(const ser_buffer_t *compressed,
+                           block_size_t compressed_size,
+                           block_size_t block_size) {
+    rassert(compressed_size.ser_value() < block_size.ser_value());
+    buf_ptr_t ret = buf_ptr_t::alloc_uninitialized(block_size);
+    ret.ser_buffer()->ser_header = compressed->ser_header;
+    uLongf size = block_size.value();
+    const int res = uncompress(reinterpret_cast<Bytef *>(ret.ser_buffer()->cache_data),
+                               &size,
+                               reinterpret_cast<const Bytef *>(compressed->cache_data),
+                               compressed_size.value());
+    guarantee(res == Z_OK && size == block_size.value(),
+              "Could not decompress block %" PR_BLOCK_ID " (zlib error %d).",
+              compressed->ser_header.block_id, res);
+    ret.fill_padding_zero();
+    return ret;
+}
+
 class dbm_read_ahead_t {
 public:
     static std::vector<uint32_t> get_boundaries(data_block_manager_t *parent,
@@ -638,15 +713,26 @@ public:
                     continue;
                 }
 
-                const block_size_t block_size = block_size_t::unsafe_make(info.ser_block_size);
-                buf_ptr_t buf = buf_ptr_t::alloc_uninitialized(block_size);
-                memcpy(buf.ser_buffer(), current_buf, info.ser_block_size);
-                buf.fill_padding_zero();
                 guarantee(info.ser_block_size <= *(lower_it + 1) - *lower_it);
+                const block_size_t block_size_on_disk
+                    = block_size_t::unsafe_make(info.ser_block_size);
+                const block_size_t block_size
+                    = block_size_t::unsafe_make(info.block_size_before_compression());
+                buf_ptr_t buf;
+                if (info.uncompressed_ser_block_size != 0) {
+                    buf = decompress_block(
+                        reinterpret_cast<const ser_buffer_t *>(current_buf),
+                        block_size_on_disk, block_size);
+                } else {
+                    buf = buf_ptr_t::alloc_uninitialized(block_size);
+                    memcpy(buf.ser_buffer(), current_buf, info.ser_block_size);
+                    buf.fill_padding_zero();
+                }
 
                 counted_t<ls_block_token_pointee_t> ls_token
                     = parent->serializer->generate_block_token(current_offset,
-                                                               block_size);
+                                                               block_size,
+                                                               block_size_on_disk);
 
                 counted_t<standard_block_token_t> token
                     = to_standard_block_token(block_id, std::move(ls_token));
@@ -663,6 +749,11 @@ public:
 };
 
 bool data_block_manager_t::should_perform_read_ahead(int64_t offset) {
+    // While we're reconstructing, we don't know yet what else is in the extent.
+    if (state != state_ready) {
+        return false;
+    }
+
     uint64_t extent_id = static_config->extent_index(offset);
 
     gc_entry_t *entry = entries.get(extent_id);
@@ -674,8 +765,18 @@ bool data_block_manager_t::should_perform_read_ahead(int64_t offset) {
 }
 
 buf_ptr_t data_block_manager_t::read(int64_t off_in, block_size_t block_size,
-                                   file_account_t *io_account) {
-    guarantee(state == state_ready);
+                                     block_size_t block_size_on_disk,
+                                     file_account_t *io_account) {
+    guarantee(state == state_ready || state == state_reconstructing);
+    buf_ptr_t ret = read_from_disk(off_in, block_size_on_disk, io_account);
+    if (block_size_on_disk.ser_value() != block_size.ser_value()) {
+        return decompress_block(ret.ser_buffer(), block_size_on_disk, block_size);
+    }
+    return ret;
+}
+
+buf_ptr_t data_block_manager_t::read_from_disk(int64_t off_in, block_size_t block_size,
+                                               file_account_t *io_account) {
     if (should_perform_read_ahead(off_in)) {
         buf_ptr_t ret = buf_ptr_t::alloc_uninitialized(block_size);
         dbm_read_ahead_t::perform_read_ahead(this, off_in, block_size.ser_value(),
@@ -718,15 +819,77 @@ std::vector<counted_t<ls_block_token_pointee_t> >
 data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
                                   file_account_t *io_account,
                                   iocallback_t *cb) {
-    // These tokens are grouped by extent.  You can do a contiguous write in each
-    // extent.
-    std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > token_groups
-        = gimme_some_new_offsets(writes);
-
     for (auto it = writes.begin(); it != writes.end(); ++it) {
         it->buf->ser_header.block_id = it->block_id;
     }
 
+    std::vector<block_size_t> block_sizes;
+    block_sizes.reserve(writes.size());
+    for (auto it = writes.begin(); it != writes.end(); ++it) {
+        block_sizes.push_back(it->block_size);
+    }
+
+    // Times the writes for the GC rate controller, and holds on to any compressed
+    // copies of the buffers until they've been written.
+    struct foreground_writes_cb_t : public iocallback_t {
+        virtual void on_io_complete() {
+            iocallback_t *local_cb = cb;
+            parent->on_foreground_writes_finished(start_time);
+            delete this;
+            local_cb->on_io_complete();
+        }
+
+        data_block_manager_t *parent;
+        ticks_t start_time;
+        std::vector<scoped_malloc_t<ser_buffer_t> > compressed_bufs;
+        iocallback_t *cb;
+    };
+
+    foreground_writes_cb_t *const writes_cb = new foreground_writes_cb_t;
+    writes_cb->parent = this;
+    writes_cb->start_time = get_ticks();
+    writes_cb->cb = cb;
+    serializer->gc_rate_controller.on_writes_started();
+
+    if (!static_config->compress_blocks()) {
+        return write_blocks(writes, block_sizes, false, io_account, writes_cb);
+    }
+
+    std::vector<buf_write_info_t> disk_writes;
+    disk_writes.reserve(writes.size());
+    for (auto it = writes.begin(); it != writes.end(); ++it) {
+        scoped_malloc_t<ser_buffer_t> compressed;
+        block_size_t compressed_size = block_size_t::undefined();
+        if (compress_block(it->buf, it->block_size, &compressed, &compressed_size)) {
+            disk_writes.push_back(buf_write_info_t(compressed.get(), compressed_size,
+                                                   it->block_id));
+            writes_cb->compressed_bufs.push_back(std::move(compressed));
+        } else {
+            disk_writes.push_back(*it);
+        }
+    }
+
+    return write_blocks(disk_writes, block_sizes, false, io_account, writes_cb);
+}
+
+void data_block_manager_t::on_foreground_writes_finished(ticks_t start_time) {
+    const ticks_t now = get_ticks();
+    serializer->gc_rate_controller.on_writes_finished(start_time, now);
+    stats->pm_serializer_foreground_write_latency.record(
+        ticks_to_secs(now - start_time));
+}
+
+std::vector<counted_t<ls_block_token_pointee_t> >
+data_block_manager_t::write_blocks(const std::vector<buf_write_info_t> &writes,
+                                   const std::vector<block_size_t> &block_sizes,
+                                   bool gc_writes,
+                                   file_account_t *io_account,
+                                   iocallback_t *cb) {
+    // These tokens are grouped by extent.  You can do a contiguous write in each
+    // extent.
+    std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > token_groups
+        = gimme_some_new_offsets(writes, block_sizes, gc_writes);
+
     struct intermediate_cb_t : public iocallback_t {
         virtual void on_io_complete() {
             --ops_remaining;
@@ -752,7 +915,7 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
 
         const int64_t front_offset = token_groups[i].front()->offset();
         const int64_t back_offset = token_groups[i].back()->offset()
-            + gc_entry_t::aligned_value(token_groups[i].back()->block_size());
+            + gc_entry_t::aligned_value(token_groups[i].back()->block_size_on_disk());
 
         guarantee(divides(DEVICE_BLOCK_SIZE, front_offset));
 
@@ -765,7 +928,7 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
 
         for (size_t j = 0; j < token_groups[i].size(); ++j) {
             const int64_t j_offset = token_groups[i][j]->offset();
-            const block_size_t j_block_size = token_groups[i][j]->block_size();
+            const block_size_t j_block_size = token_groups[i][j]->block_size_on_disk();
             guarantee(j_offset == last_written_offset);
             const size_t j_aligned_size = gc_entry_t::aligned_value(j_block_size);
             total_aligned_size += j_aligned_size;
@@ -884,10 +1047,11 @@ size_t data_block_manager_t::compute_gc_concurrency() const {
     CT_ASSERT(GC_START_RATIO > GC_STOP_RATIO);
 
     const double gc_ratio = garbage_ratio();
+    size_t concurrency;
     if (gc_ratio < GC_START_RATIO) {
-        return 1;
+        concurrency = 1;
     } else if (gc_ratio >= GC_HIGH_RATIO) {
-        return MAX_CONCURRENT_GCS;
+        concurrency = MAX_CONCURRENT_GCS;
     } else {
         rassert(gc_ratio >= GC_START_RATIO);
         rassert(gc_ratio < GC_HIGH_RATIO);
@@ -897,7 +1061,20 @@ size_t data_block_manager_t::compute_gc_concurrency() const {
         size_t total_concurrency =
             1 + static_cast<size_t>(linear_factor * MAX_CONCURRENT_GCS);
         // std::min to avoid rounding errors leading to illegal return values
-        return std::min(total_concurrency, MAX_CONCURRENT_GCS);
+        concurrency = std::min(total_concurrency, MAX_CONCURRENT_GCS);
+    }
+
+    // Foreground writes get to slow us down, but not to the point where the
+    // database grows without bound.  If nobody is writing, the disk is ours.
+    switch (serializer->gc_rate_controller.mode(get_ticks())) {
+    case gc_rate_controller_t::mode_t::throttled:
+        return gc_ratio >= GC_HIGH_RATIO ? concurrency : 1;
+    case gc_rate_controller_t::mode_t::normal:
+        return concurrency;
+    case gc_rate_controller_t::mode_t::idle:
+        return std::max<size_t>(concurrency, GC_IDLE_CONCURRENCY);
+    default:
+        unreachable();
     }
 }
 
@@ -911,7 +1088,11 @@ file_account_t *data_block_manager_t::choose_gc_io_account() {
 
     // Note that this means that we can end up oscillating between both accounts,
     // which is fine.
-    if (garbage_ratio() > GC_HIGH_RATIO) {
+    // We also use the high priority account while there are no foreground writes
+    // that it could get in the way of.
+    if (garbage_ratio() > GC_HIGH_RATIO
+        || serializer->gc_rate_controller.mode(get_ticks())
+           == gc_rate_controller_t::mode_t::idle) {
         return gc_io_account_high.get();
     } else {
         return gc_io_account_nice.get();
@@ -940,6 +1121,10 @@ void data_block_manager_t::mark_garbage(int64_t offset, extent_transaction_t *tx
 }
 
 void data_block_manager_t::mark_live_tokenwise_with_offset(int64_t offset) {
+    if (state == state_reconstructing) {
+        // `start_existing()` takes care of it.
+        return;
+    }
     uint64_t extent_id = static_config->extent_index(offset);
     gc_entry_t *entry = entries.get(extent_id);
     rassert(entry != NULL);
@@ -949,6 +1134,10 @@ void data_block_manager_t::mark_live_tokenwise_with_offset(int64_t offset) {
 }
 
 void data_block_manager_t::mark_garbage_tokenwise_with_offset(int64_t offset) {
+    if (state == state_reconstructing) {
+        // The token never got counted.
+        return;
+    }
     uint64_t extent_id = static_config->extent_index(offset);
     gc_entry_t *entry = entries.get(extent_id);
 
@@ -997,20 +1186,32 @@ void data_block_manager_t::run_gc(gc_state_t *gc_state) {
     while (!gc_pq.empty()
            && should_we_keep_gcing()
            && !should_terminate_one_gc_thread()) {
+        if (serializer->gc_rate_controller.mode(get_ticks())
+            == gc_rate_controller_t::mode_t::idle) {
+            ++stats->pm_serializer_gc_idle_extents;
+        }
         gc_one_extent(gc_state);
-
         if (state == state_shutting_down) {
-            active_gcs.remove(gc_state);
-            delete gc_state;
-            if (active_gcs.empty()) {
-                actually_shutdown();
+            break;
+        }
+
+        // Give foreground writes some room if they're struggling, unless we're
+        // falling so far behind that the database would grow without bound.
+        const int64_t delay_ms = serializer->gc_rate_controller.gc_delay_ms();
+        if (delay_ms > 0 && garbage_ratio() <= GC_HIGH_RATIO) {
+            ++stats->pm_serializer_gc_throttle_pauses;
+            nap(delay_ms);
+            if (state == state_shutting_down) {
+                break;
             }
-            return;
         }
     }
 
     active_gcs.remove(gc_state);
     delete gc_state;
+    if (state == state_shutting_down && active_gcs.empty()) {
+        actually_shutdown();
+    }
 }
 
 void data_block_manager_t::gc_one_extent(gc_state_t *gc_state) {
@@ -1201,17 +1402,33 @@ void data_block_manager_t::write_gcs(const std::vector<gc_write_t> &writes,
 
         std::vector<buf_write_info_t> the_writes;
         the_writes.reserve(writes.size());
+        std::vector<block_size_t> block_sizes;
+        block_sizes.reserve(writes.size());
         for (size_t i = 0; i < writes.size(); ++i) {
+            const block_id_t block_id = writes[i].buf->ser_header.block_id;
+
+            // The blocks are copied as they are, so compressed blocks stay
+            // compressed.  What size they have before compression is only known for
+            // the blocks the index points at, but those are the only ones whose new
+            // tokens we use (for the index ops below).
+            block_size_t block_size = writes[i].block_size;
+            const index_block_info_t info = serializer->lba_index->get_block_info(block_id);
+            if (info.offset.has_value() && info.offset.get_value() == writes[i].old_offset) {
+                block_size = block_size_t::unsafe_make(info.block_size_before_compression());
+            }
+
             old_block_tokens.push_back(serializer->generate_block_token(writes[i].old_offset,
+                                                                        block_size,
                                                                         writes[i].block_size));
 
             the_writes.push_back(buf_write_info_t(writes[i].buf,
                                                   writes[i].block_size,
-                                                  writes[i].buf->ser_header.block_id));
+                                                  block_id));
+            block_sizes.push_back(block_size);
         }
 
-        new_block_tokens = many_writes(the_writes, choose_gc_io_account(),
-                                       &block_write_cond);
+        new_block_tokens = write_blocks(the_writes, block_sizes, true,
+                                        choose_gc_io_account(), &block_write_cond);
 
         guarantee(new_block_tokens.size() == writes.size());
     }
@@ -1314,6 +1531,12 @@ void data_block_manager_t::actually_shutdown() {
         active_extent = NULL;
     }
 
+    if (gc_active_extent != NULL) {
+        UNUSED int64_t extent = gc_active_extent->extent_ref.release();
+        delete gc_active_extent;
+        gc_active_extent = NULL;
+    }
+
     while (gc_entry_t *entry = young_extent_queue.head()) {
         young_extent_queue.remove(entry);
         UNUSED int64_t extent = entry->extent_ref.release();
@@ -1332,17 +1555,22 @@ void data_block_manager_t::actually_shutdown() {
 }
 
 std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
-data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes) {
+data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes,
+                                             const std::vector<block_size_t> &block_sizes,
+                                             bool gc_writes) {
     ASSERT_NO_CORO_WAITING;
+    guarantee(block_sizes.size() == writes.size());
+
+    gc_entry_t *&extent = gc_writes ? gc_active_extent : active_extent;
 
     // Start a new extent if necessary.
-    if (active_extent == NULL) {
-        active_extent = new gc_entry_t(this);
+    if (extent == NULL) {
+        extent = new gc_entry_t(this);
         ++stats->pm_serializer_data_extents_allocated;
     }
 
 
-    guarantee(active_extent->state == gc_entry_t::state_active);
+    guarantee(extent->state == gc_entry_t::state_active);
 
     std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > ret;
 
@@ -1350,25 +1578,25 @@ data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t>
     for (auto it = writes.begin(); it != writes.end(); ++it) {
         uint32_t relative_offset = valgrind_undefined<uint32_t>(UINT32_MAX);
         unsigned int block_index = valgrind_undefined<unsigned int>(UINT_MAX);
-        if (!active_extent->new_offset(it->block_size,
-                                       &relative_offset, &block_index)) {
-            // Move the active_extent gc_entry_t to the young extent queue (if it's
-            // not already empty), and make a new gc_entry_t.
-            if (active_extent->num_live_blocks() == 0) {
-                gc_entry_t *old_active_extent = active_extent;
-                active_extent = new gc_entry_t(this);
-                destroy_entry(old_active_extent);
+        if (!extent->new_offset(it->block_size,
+                                &relative_offset, &block_index)) {
+            // Move the active extent's gc_entry_t to the young extent queue (if
+            // it's not already empty), and make a new gc_entry_t.
+            if (extent->num_live_blocks() == 0) {
+                gc_entry_t *old_extent = extent;
+                extent = new gc_entry_t(this);
+                destroy_entry(old_extent);
             } else {
-                active_extent->state = gc_entry_t::state_young;
-                young_extent_queue.push_back(active_extent);
+                extent->state = gc_entry_t::state_young;
+                young_extent_queue.push_back(extent);
                 mark_unyoung_entries();
-                active_extent = new gc_entry_t(this);
+                extent = new gc_entry_t(this);
             }
 
             ++stats->pm_serializer_data_extents_allocated;
-            const bool succeeded = active_extent->new_offset(it->block_size,
-                                                             &relative_offset,
-                                                             &block_index);
+            const bool succeeded = extent->new_offset(it->block_size,
+                                                      &relative_offset,
+                                                      &block_index);
             guarantee(succeeded);
 
             // Push the current group of tokens, if it's nonempty, onto the return vector.
@@ -1378,11 +1606,12 @@ data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t>
             }
         }
 
-        const int64_t offset = active_extent->extent_ref.offset() + relative_offset;
-        active_extent->was_written = true;
-        active_extent->mark_live_tokenwise(block_index);
+        const int64_t offset = extent->extent_ref.offset() + relative_offset;
+        extent->was_written = true;
+        extent->mark_live_tokenwise(block_index);
 
-        tokens.push_back(serializer->generate_block_token(offset, it->block_size));
+        tokens.push_back(serializer->generate_block_token(
+            offset, block_sizes[it - writes.begin()], it->block_size));
     }
 
     if (!tokens.empty()) {
@@ -46,15 +46,19 @@ public:
     static void prepare_initial_metablock(data_block_manager::metablock_mixin_t *mb);
     void start_existing(file_t *dbfile, data_block_manager::metablock_mixin_t *last_metablock);
 
+    // `block_size_on_disk` is smaller than `block_size` if the block is compressed,
+    // in which case the returned buffer has been decompressed.
     buf_ptr_t read(int64_t off_in, block_size_t block_size,
-                 file_account_t *io_account);
+                   block_size_t block_size_on_disk, file_account_t *io_account);
 
     /* exposed gc api */
     /* mark a buffer as garbage */
     void mark_garbage(int64_t offset, extent_transaction_t *txn);  // Takes a real int64_t.
 
-    /* r{start,end}_reconstruct functions for safety */
-    void start_reconstruct();
+    /* r{start,end}_reconstruct functions for safety.  Reads are allowed from
+    start_reconstruct() onwards; tokens only start counting once start_existing() has
+    been called. */
+    void start_reconstruct(file_t *file);
     void mark_live(int64_t offset, block_size_t block_size);
     void end_reconstruct();
 
@@ -76,19 +80,39 @@ public:
     // ratio of garbage to blocks in the system
     double garbage_ratio() const;
 
+    // Compresses the blocks on the way to disk if the serializer was created with
+    // `compress_blocks()` set.
     std::vector<counted_t<ls_block_token_pointee_t> >
     many_writes(const std::vector<buf_write_info_t> &writes,
                 file_account_t *io_account,
                 iocallback_t *cb);
 
+    // `writes` are the blocks as they go to disk, and `block_sizes` are the sizes
+    // that the returned tokens report.  They differ for compressed blocks.
+    // `gc_writes` says whether the blocks are being copied by the GC, which puts
+    // them in a different active extent than new blocks.
     std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
-    gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes);
+    gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes,
+                           const std::vector<block_size_t> &block_sizes,
+                           bool gc_writes);
 
     bool is_gc_active() const;
 
 private:
     void actually_shutdown();
 
+    buf_ptr_t read_from_disk(int64_t off_in, block_size_t block_size_on_disk,
+                             file_account_t *io_account);
+
+    // Writes the buffers as they are, without compressing them.  See
+    // `gimme_some_new_offsets` for what `block_sizes` is.
+    std::vector<counted_t<ls_block_token_pointee_t> >
+    write_blocks(const std::vector<buf_write_info_t> &writes,
+                 const std::vector<block_size_t> &block_sizes,
+                 bool gc_writes,
+                 file_account_t *io_account,
+                 iocallback_t *cb);
+
     struct gc_state_t : public intrusive_list_node_t<gc_state_t>{
     public:
         // The entry we're currently GCing.
@@ -115,6 +139,9 @@ private:
     we should keep GCing. */
     void run_gc(gc_state_t *gc_state);
 
+    // Reports a finished batch of foreground writes to the GC rate controller.
+    void on_foreground_writes_finished(ticks_t start_time);
+
     void gc_one_extent(gc_state_t *gc_state);
 
     void write_gcs(const std::vector<gc_write_t> &writes, gc_state_t *gc_state);
@@ -155,6 +182,7 @@ private:
 
     enum state_t {
         state_unstarted,
+        state_reconstructing,
         state_ready,
         state_shutting_down,
         state_shut_down
@@ -178,8 +206,13 @@ private:
     /* Contains every extent in the gc_entry_t::state_reconstructing state */
     intrusive_list_t<gc_entry_t> reconstructed_extents;
 
-    /* Contains the extent in the gc_entry_t::state_active state. */
+    /* Contains the extents in the gc_entry_t::state_active state.  Blocks that the
+    GC copies have survived at least one GC, so they're likely to stay live much
+    longer than newly written ones.  They go to `gc_active_extent`, which keeps
+    them from being mixed into extents with hot blocks and then copied again each
+    time those extents get collected. */
     gc_entry_t *active_extent;
+    gc_entry_t *gc_active_extent;
 
     /* Contains every extent in the gc_entry_t::state_young state */
     intrusive_list_t<gc_entry_t> young_extent_queue;
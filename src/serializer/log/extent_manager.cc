@@ -2,6 +2,7 @@
 #include "serializer/log/extent_manager.hpp"
 
 #include <queue>
+#include <set>
 
 #include "arch/arch.hpp"
 #include "logger.hpp"
@@ -69,13 +70,25 @@ class extent_zone_t {
     // The number of free extents in the file.
     size_t held_extents_;
 
+    const bool discard_freed_extents;
+
+    // Free extents that we haven't discarded yet, so that we can discard them in
+    // batches.  Extents that get reused or cut off the end of the file in the
+    // meantime are taken out again.
+    std::set<size_t> undiscarded_extents;
+
 public:
     size_t held_extents() const {
         return held_extents_;
     }
 
-    extent_zone_t(file_t *_dbfile, uint64_t _extent_size)
-        : extent_size(_extent_size), dbfile(_dbfile), held_extents_(0) {
+    size_t undiscarded_extent_count() const {
+        return undiscarded_extents.size();
+    }
+
+    extent_zone_t(file_t *_dbfile, uint64_t _extent_size, bool _discard_freed_extents)
+        : extent_size(_extent_size), dbfile(_dbfile), held_extents_(0),
+          discard_freed_extents(_discard_freed_extents) {
         // (Avoid a bunch of reallocations by resize calls (avoiding O(n log n)
         // work on average).)
         extents.reserve(dbfile->get_file_size() / extent_size);
@@ -120,6 +133,7 @@ public:
             extents.push_back(extent_info_t());
         } else {
             extent = free_queue.top() * extent_size;
+            undiscarded_extents.erase(free_queue.top());
             free_queue.pop();
             --held_extents_;
         }
@@ -154,6 +168,8 @@ public:
 
         if (shrink_file) {
             dbfile->set_file_size(extents.size() * extent_size);
+            undiscarded_extents.erase(undiscarded_extents.lower_bound(extents.size()),
+                                      undiscarded_extents.end());
 
             // Prevent the existence of a relatively large free queue after the file
             // size shrinks.
@@ -187,19 +203,40 @@ public:
             info->set_state(extent_info_t::state_free);
             free_queue.push(offset_to_id(extent));
             ++held_extents_;
+            if (discard_freed_extents) {
+                undiscarded_extents.insert(offset_to_id(extent));
+            }
             try_shrink_file();
         }
     }
+
+    // Discards all undiscarded extents, merging neighboring extents into a single
+    // range.  Returns how many extents were discarded.
+    size_t discard_extents() {
+        const size_t count = undiscarded_extents.size();
+        auto it = undiscarded_extents.begin();
+        while (it != undiscarded_extents.end()) {
+            const size_t first = *it;
+            size_t end = first + 1;
+            for (++it; it != undiscarded_extents.end() && *it == end; ++it) {
+                ++end;
+            }
+            dbfile->discard(first * extent_size, (end - first) * extent_size);
+        }
+        undiscarded_extents.clear();
+        return count;
+    }
 };
 
 extent_manager_t::extent_manager_t(file_t *file,
                                    const log_serializer_on_disk_static_config_t *static_config,
+                                   bool discard_freed_extents,
                                    log_serializer_stats_t *_stats)
     : stats(_stats), extent_size(static_config->extent_size()),
       state(state_reserving_extents) {
     guarantee(divides(DEVICE_BLOCK_SIZE, extent_size));
 
-    zone.init(new extent_zone_t(file, extent_size));
+    zone.init(new extent_zone_t(file, extent_size, discard_freed_extents));
 }
 
 extent_manager_t::~extent_manager_t() {
@@ -237,6 +274,7 @@ void extent_manager_t::shutdown() {
     assert_thread();
     rassert(state == state_running);
     rassert(!current_transaction);
+    stats->pm_serializer_extents_discarded += zone->discard_extents();
     state = state_shut_down;
 }
 
@@ -271,6 +309,7 @@ void extent_manager_t::release_extent_into_transaction(extent_reference_t &&exte
 void extent_manager_t::release_extent(extent_reference_t &&extent_ref) {
     release_extent_preliminaries();
     zone->release_extent(std::move(extent_ref));
+    maybe_discard_extents();
 }
 
 void extent_manager_t::release_extent_preliminaries() {
@@ -295,6 +334,13 @@ void extent_manager_t::commit_transaction(extent_transaction_t *t) {
     for (auto it = extents.begin(); it != extents.end(); ++it) {
         zone->release_extent(std::move(*it));
     }
+    maybe_discard_extents();
+}
+
+void extent_manager_t::maybe_discard_extents() {
+    if (zone->undiscarded_extent_count() >= EXTENT_DISCARD_BATCH_SIZE) {
+        stats->pm_serializer_extents_discarded += zone->discard_extents();
+    }
 }
 
 size_t extent_manager_t::held_extents() {
@@ -96,8 +96,11 @@ public:
         int64_t padding;
     };
 
+    /* If `discard_freed_extents` is true, extents that become free are discarded
+    in batches of EXTENT_DISCARD_BATCH_SIZE, to let SSDs reclaim the space. */
     extent_manager_t(file_t *file,
                      const log_serializer_on_disk_static_config_t *static_config,
+                     bool discard_freed_extents,
                      log_serializer_stats_t *);
     ~extent_manager_t();
 
@@ -138,6 +141,7 @@ public:
 
 private:
     void release_extent_preliminaries();
+    void maybe_discard_extents();
 
     scoped_ptr_t<extent_zone_t> zone;
 
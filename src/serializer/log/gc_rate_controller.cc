@@ -0,0 +1,60 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "serializer/log/gc_rate_controller.hpp"
+
+#include <algorithm>
+
+#include "config/args.hpp"
+
+// How much weight the latest batch of writes gets in the moving average.
+const double GC_THROTTLE_LATENCY_WEIGHT = 0.2;
+
+static ticks_t ms_to_ticks(int64_t ms) {
+    return secs_to_ticks(1) / 1000 * ms;
+}
+
+gc_rate_controller_t::gc_rate_controller_t(ticks_t now)
+    : outstanding(0),
+      average_latency(0.0),
+      delay_ms(0),
+      last_write_time(now) { }
+
+void gc_rate_controller_t::on_writes_started() {
+    ++outstanding;
+}
+
+void gc_rate_controller_t::on_writes_finished(ticks_t start_time, ticks_t now) {
+    guarantee(outstanding > 0);
+    --outstanding;
+    last_write_time = now;
+
+    const ticks_t latency = now >= start_time ? now - start_time : 0;
+    average_latency = (1.0 - GC_THROTTLE_LATENCY_WEIGHT) * average_latency
+        + GC_THROTTLE_LATENCY_WEIGHT * static_cast<double>(latency);
+
+    const bool struggling =
+        average_latency > static_cast<double>(
+            ms_to_ticks(GC_THROTTLE_TARGET_WRITE_LATENCY_MS))
+        || outstanding > GC_THROTTLE_MAX_OUTSTANDING_WRITES;
+    if (struggling) {
+        delay_ms = std::min<int64_t>(std::max<int64_t>(delay_ms * 2,
+                                                       GC_THROTTLE_MIN_DELAY_MS),
+                                     GC_THROTTLE_MAX_DELAY_MS);
+    } else {
+        delay_ms /= 2;
+        if (delay_ms < GC_THROTTLE_MIN_DELAY_MS) {
+            delay_ms = 0;
+        }
+    }
+}
+
+gc_rate_controller_t::mode_t gc_rate_controller_t::mode(ticks_t now) const {
+    if (delay_ms > 0) {
+        return mode_t::throttled;
+    } else if (outstanding == 0
+               && now >= last_write_time
+               && now - last_write_time >= ms_to_ticks(GC_IDLE_TIME_MS)) {
+        return mode_t::idle;
+    } else {
+        return mode_t::normal;
+    }
+}
@@ -0,0 +1,55 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_LOG_GC_RATE_CONTROLLER_HPP_
+#define SERIALIZER_LOG_GC_RATE_CONTROLLER_HPP_
+
+#include <stdint.h>
+
+#include "errors.hpp"
+#include "time.hpp"
+
+/* `gc_rate_controller_t` decides how hard the data block GC and the LBA GC should
+push, based on how foreground block writes are doing.  When writes get slow or start
+to queue up, it asks the GC to pause between units of work, backing off
+exponentially for as long as the writes keep struggling.  When no foreground writes
+have come in for a while, it tells the GC that it may use the disk freely.
+
+It doesn't do any timing of its own; callers pass in the current time, which keeps
+it easy to test. */
+class gc_rate_controller_t {
+public:
+    enum class mode_t {
+        // Foreground writes are struggling, so the GC should pause between units of
+        // work.
+        throttled,
+        normal,
+        // There haven't been any foreground writes for a while.
+        idle
+    };
+
+    explicit gc_rate_controller_t(ticks_t now);
+
+    // Called around every batch of foreground block writes.
+    void on_writes_started();
+    void on_writes_finished(ticks_t start_time, ticks_t now);
+
+    mode_t mode(ticks_t now) const;
+
+    // How long the GC should wait after each unit of work.  Zero unless throttled.
+    int64_t gc_delay_ms() const { return delay_ms; }
+
+    int64_t outstanding_writes() const { return outstanding; }
+    // A moving average of the foreground write latency.
+    ticks_t average_write_latency() const {
+        return static_cast<ticks_t>(average_latency);
+    }
+
+private:
+    int64_t outstanding;
+    double average_latency;
+    int64_t delay_ms;
+    ticks_t last_write_time;
+
+    DISABLE_COPYING(gc_rate_controller_t);
+};
+
+#endif  // SERIALIZER_LOG_GC_RATE_CONTROLLER_HPP_
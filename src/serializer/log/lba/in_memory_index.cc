@@ -5,23 +5,132 @@
 
 #include "serializer/log/lba/disk_format.hpp"
 
-in_memory_index_t::in_memory_index_t() : end_block_id_(0) { }
+namespace {
+
+// Both words keep a size in the low bits and something else above it.
+const int SIZE_BITS = 24;
+const uint64_t SIZE_MASK = (uint64_t(1) << SIZE_BITS) - 1;
+const uint64_t MAX_HIGH_VALUE = (uint64_t(1) << (64 - SIZE_BITS)) - 1;
+
+// A location word with this value means the entry is in `overflow_`.  The packed
+// encoding never produces it because packed sizes are less than SIZE_MASK.
+const uint64_t OVERFLOW_LOCATION = UINT64_MAX;
+
+}  // namespace
+
+in_memory_index_t::in_memory_index_t() : end_block_id_(0), num_entries_(0) { }
 
 block_id_t in_memory_index_t::end_block_id() {
     return end_block_id_;
 }
 
+bool in_memory_index_t::pack(const index_block_info_t &info,
+                             location_t *location_out, recency_t *recency_out) {
+    if (info.ser_block_size >= SIZE_MASK
+        || info.uncompressed_ser_block_size >= SIZE_MASK) {
+        return false;
+    }
+
+    // Offset units are stored plus one, so that zero means unused.
+    uint64_t offset_units;
+    if (info.offset == flagged_off64_t::unused()) {
+        offset_units = 0;
+    } else if (info.offset.has_value()
+               && info.offset.get_value() % DEVICE_BLOCK_SIZE == 0
+               && static_cast<uint64_t>(info.offset.get_value() / DEVICE_BLOCK_SIZE)
+                  < MAX_HIGH_VALUE) {
+        offset_units = info.offset.get_value() / DEVICE_BLOCK_SIZE + 1;
+    } else {
+        return false;
+    }
+
+    // Likewise, recencies are stored plus one so that zero means invalid.
+    uint64_t recency_plus_one;
+    if (info.recency == repli_timestamp_t::invalid) {
+        recency_plus_one = 0;
+    } else if (info.recency.longtime < MAX_HIGH_VALUE) {
+        recency_plus_one = info.recency.longtime + 1;
+    } else {
+        return false;
+    }
+
+    *location_out = location_t((offset_units << SIZE_BITS) | info.ser_block_size);
+    *recency_out = recency_t((recency_plus_one << SIZE_BITS)
+                             | info.uncompressed_ser_block_size);
+    return true;
+}
+
+index_block_info_t in_memory_index_t::unpack(location_t location, recency_t recency) {
+    const uint64_t offset_units = location.word >> SIZE_BITS;
+    const uint64_t recency_plus_one = recency.word >> SIZE_BITS;
+
+    repli_timestamp_t r;
+    if (recency_plus_one == 0) {
+        r = repli_timestamp_t::invalid;
+    } else {
+        r.longtime = recency_plus_one - 1;
+    }
+
+    return index_block_info_t(
+        offset_units == 0
+            ? flagged_off64_t::unused()
+            : flagged_off64_t::make((offset_units - 1) * DEVICE_BLOCK_SIZE),
+        r,
+        location.word & SIZE_MASK,
+        recency.word & SIZE_MASK);
+}
+
 index_block_info_t in_memory_index_t::get_block_info(block_id_t id) {
-    return infos_.get(id);
+    const location_t location = locations_.get(id);
+    if (location.word == OVERFLOW_LOCATION) {
+        auto it = overflow_.find(id);
+        guarantee(it != overflow_.end());
+        return it->second;
+    }
+    return unpack(location, recencies_.get(id));
 }
 
 void in_memory_index_t::set_block_info(block_id_t id, repli_timestamp_t recency,
-                                       flagged_off64_t offset, uint32_t ser_block_size) {
+                                       flagged_off64_t offset, uint32_t ser_block_size,
+                                       uint32_t uncompressed_ser_block_size) {
     if (id >= end_block_id_) {
         end_block_id_ = id + 1;
     }
 
-    index_block_info_t info(offset, recency, ser_block_size);
-    infos_.set(id, info);
+    const location_t old_location = locations_.get(id);
+    if (old_location.word == OVERFLOW_LOCATION) {
+        overflow_.erase(id);
+    }
+    if (!(old_location == location_t()) || !(recencies_.get(id) == recency_t())) {
+        --num_entries_;
+    }
+
+    index_block_info_t info(offset, recency, ser_block_size,
+                            uncompressed_ser_block_size);
+    location_t location;
+    recency_t packed_recency;
+    if (!pack(info, &location, &packed_recency)) {
+        overflow_.insert(std::make_pair(id, info));
+        location = location_t(OVERFLOW_LOCATION);
+        packed_recency = recency_t();
+    }
+    locations_.set(id, location);
+    recencies_.set(id, packed_recency);
+    if (!(location == location_t()) || !(packed_recency == recency_t())) {
+        ++num_entries_;
+    }
 }
 
+size_t in_memory_index_t::memory_usage() const {
+    // Each std::map node carries three pointers and a color besides its value.
+    const size_t overflow_node_size =
+        sizeof(std::pair<const block_id_t, index_block_info_t>) + 4 * sizeof(void *);
+    return locations_.memory_usage() + recencies_.memory_usage()
+        + overflow_.size() * overflow_node_size;
+}
+
+double in_memory_index_t::bytes_per_block() const {
+    return num_entries_ == 0
+        ? 0.0
+        : static_cast<double>(memory_usage()) / num_entries_;
+}
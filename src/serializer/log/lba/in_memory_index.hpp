@@ -2,6 +2,8 @@
 #ifndef SERIALIZER_LOG_LBA_IN_MEMORY_INDEX_HPP_
 #define SERIALIZER_LOG_LBA_IN_MEMORY_INDEX_HPP_
 
+#include <map>
+
 #include "containers/two_level_array.hpp"
 #include "config/args.hpp"
 #include "serializer/serializer.hpp"
@@ -11,33 +13,51 @@ struct index_block_info_t {
     index_block_info_t()
         : offset(flagged_off64_t::unused()),
           recency(repli_timestamp_t::invalid),
-          ser_block_size(0) { }
+          ser_block_size(0),
+          uncompressed_ser_block_size(0) { }
 
     index_block_info_t(flagged_off64_t _offset,
                        repli_timestamp_t _recency,
-                       uint32_t _ser_block_size)
+                       uint32_t _ser_block_size,
+                       uint32_t _uncompressed_ser_block_size)
         : offset(_offset),
           recency(_recency),
-          ser_block_size(_ser_block_size) { }
+          ser_block_size(_ser_block_size),
+          uncompressed_ser_block_size(_uncompressed_ser_block_size) { }
 
     // For two_level_array_t.
     bool operator==(const index_block_info_t &other) const {
         return offset == other.offset &&
             recency == other.recency &&
-            ser_block_size == other.ser_block_size;
+            ser_block_size == other.ser_block_size &&
+            uncompressed_ser_block_size == other.uncompressed_ser_block_size;
+    }
+
+    // The size of the block that is passed to the cache.  For compressed blocks this
+    // is bigger than the `ser_block_size` they take up on disk.
+    uint32_t block_size_before_compression() const {
+        return uncompressed_ser_block_size != 0
+            ? uncompressed_ser_block_size
+            : ser_block_size;
     }
 
     flagged_off64_t offset;
     repli_timestamp_t recency;
+    // The size of the block on disk.
     uint32_t ser_block_size;
+    // Zero unless the block is compressed on disk.
+    uint32_t uncompressed_ser_block_size;
 } __attribute__((__packed__));
 
 
 
+/* in_memory_index_t keeps one entry for every block ID, so it is kept compact.  An
+entry is two 64-bit words in separate arrays: the location word packs the offset (in
+units of DEVICE_BLOCK_SIZE) with the on-disk size, and the recency word packs the
+recency with the uncompressed size.  Reads only touch the locations and backfills only
+touch the recencies.  Entries that don't fit the packed encoding (unaligned or huge
+offsets, huge sizes, far-future recencies) are kept whole in `overflow_`. */
 class in_memory_index_t {
-    two_level_array_t<index_block_info_t> infos_;
-    block_id_t end_block_id_;
-
 public:
     in_memory_index_t();
 
@@ -46,8 +66,38 @@ public:
 
     index_block_info_t get_block_info(block_id_t id);
     void set_block_info(block_id_t id, repli_timestamp_t recency,
-                        flagged_off64_t offset, uint32_t ser_block_size);
+                        flagged_off64_t offset, uint32_t ser_block_size,
+                        uint32_t uncompressed_ser_block_size);
 
+    // The number of heap bytes used by the index, and that divided by the number of
+    // block IDs that have an entry.
+    size_t memory_usage() const;
+    double bytes_per_block() const;
+
+private:
+    struct location_t {
+        location_t() : word(0) { }
+        explicit location_t(uint64_t _word) : word(_word) { }
+        bool operator==(location_t other) const { return word == other.word; }
+        uint64_t word;
+    };
+    struct recency_t {
+        recency_t() : word(0) { }
+        explicit recency_t(uint64_t _word) : word(_word) { }
+        bool operator==(recency_t other) const { return word == other.word; }
+        uint64_t word;
+    };
+
+    static bool pack(const index_block_info_t &info,
+                     location_t *location_out, recency_t *recency_out);
+    static index_block_info_t unpack(location_t location, recency_t recency);
+
+    two_level_array_t<location_t> locations_;
+    two_level_array_t<recency_t> recencies_;
+    std::map<block_id_t, index_block_info_t> overflow_;
+    block_id_t end_block_id_;
+    // The number of block IDs whose entry differs from index_block_info_t().
+    size_t num_entries_;
 };
 
 #endif  // SERIALIZER_LOG_LBA_IN_MEMORY_INDEX_HPP_
@@ -4,16 +4,20 @@
 #include "utils.hpp"
 #include "serializer/log/lba/disk_format.hpp"
 #include "arch/arch.hpp"
+#include "arch/timing.hpp"
 #include "perfmon/perfmon.hpp"
+#include "serializer/log/gc_rate_controller.hpp"
 #include "serializer/log/stats.hpp"
 #include "arch/runtime/coroutines.hpp"
 
 // TODO: Some of the code in this file is bullshit disgusting shit.
 
 lba_list_t::lba_list_t(extent_manager_t *em,
-        const lba_list_t::write_metablock_fun_t &_write_metablock_fun)
+        const lba_list_t::write_metablock_fun_t &_write_metablock_fun,
+        const gc_rate_controller_t *_gc_rate_controller)
     : gc_drainer(new auto_drainer_t), write_metablock_fun(_write_metablock_fun),
-      extent_manager(em), state(state_unstarted), inline_lba_entries_count(0)
+      extent_manager(em), gc_rate_controller(_gc_rate_controller),
+      state(state_unstarted), inline_lba_entries_count(0)
 {
     for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
         gc_active[i] = false;
@@ -105,7 +109,8 @@ public:
                         e->block_id,
                         e->recency,
                         e->offset,
-                        e->ser_block_size);
+                        e->ser_block_size,
+                        e->uncompressed_ser_block_size);
             }
 
             owner->state = lba_list_t::state_ready;
@@ -180,10 +185,12 @@ segmented_vector_t<repli_timestamp_t> lba_list_t::get_block_recencies(block_id_t
 
 void lba_list_t::set_block_info(block_id_t block, repli_timestamp_t recency,
                                 flagged_off64_t offset, uint32_t ser_block_size,
+                                uint32_t uncompressed_ser_block_size,
                                 file_account_t *io_account, extent_transaction_t *txn) {
     rassert(state == state_ready || state == state_gc_shutting_down);
 
-    in_memory_index.set_block_info(block, recency, offset, ser_block_size);
+    in_memory_index.set_block_info(block, recency, offset, ser_block_size,
+                                   uncompressed_ser_block_size);
 
     // If the inline LBA is full, free it up first by moving its entries to
     // the LBA extents
@@ -192,7 +199,8 @@ void lba_list_t::set_block_info(block_id_t block, repli_timestamp_t recency,
         rassert(!check_inline_lba_full());
     }
     // Then store the entry inline
-    add_inline_entry(block, recency, offset, ser_block_size);
+    add_inline_entry(block, recency, offset, ser_block_size,
+                     uncompressed_ser_block_size);
 }
 
 bool lba_list_t::check_inline_lba_full() const {
@@ -230,6 +238,7 @@ void lba_list_t::move_inline_entries_to_extents(file_account_t *io_account, exte
                 e.recency,
                 e.offset,
                 e.ser_block_size,
+                e.uncompressed_ser_block_size,
                 io_account,
                 txn);
     }
@@ -238,11 +247,13 @@ void lba_list_t::move_inline_entries_to_extents(file_account_t *io_account, exte
 }
 
 void lba_list_t::add_inline_entry(block_id_t block, repli_timestamp_t recency,
-                                flagged_off64_t offset, uint32_t ser_block_size) {
+                                flagged_off64_t offset, uint32_t ser_block_size,
+                                uint32_t uncompressed_ser_block_size) {
 
     rassert(!check_inline_lba_full());
     inline_lba_entries[inline_lba_entries_count++] =
-            lba_entry_t::make(block, recency, offset, ser_block_size);
+            lba_entry_t::make(block, recency, offset, ser_block_size,
+                              uncompressed_ser_block_size);
 }
 
 class lba_syncer_t :
@@ -316,13 +327,13 @@ void lba_list_t::gc(int lba_shard, auto_drainer_t::lock_t) {
     bool aborted = false;
     const block_id_t end_id = end_block_id();
     for (block_id_t id = lba_shard; id < end_id; id += LBA_SHARD_FACTOR) {
-        flagged_off64_t off = get_block_offset(id);
-        if (off.has_value()) {
-            uint32_t ser_block_size = get_ser_block_size(id);
+        const index_block_info_t info = get_block_info(id);
+        if (info.offset.has_value()) {
             disk_structures[lba_shard]->add_entry(id,
-                                                  get_block_recency(id),
-                                                  off,
-                                                  ser_block_size,
+                                                  info.recency,
+                                                  info.offset,
+                                                  info.ser_block_size,
+                                                  info.uncompressed_ser_block_size,
                                                   gc_io_account.get(),
                                                   txns.back().get());
         }
@@ -347,6 +358,13 @@ void lba_list_t::gc(int lba_shard, auto_drainer_t::lock_t) {
 
             on_lba_sync.wait();
 
+            // Give foreground writes some room if they're struggling.
+            const int64_t delay_ms = gc_rate_controller->gc_delay_ms();
+            if (delay_ms > 0) {
+                ++extent_manager->stats->pm_serializer_gc_throttle_pauses;
+                nap(delay_ms);
+            }
+
             // Start a new transaction for the next batch of entries
             txns.push_back(make_scoped<extent_transaction_t>());
             extent_manager->begin_transaction(txns.back().get());
@@ -13,6 +13,7 @@
 #include "serializer/log/lba/in_memory_index.hpp"
 #include "serializer/log/lba/disk_structure.hpp"
 
+class gc_rate_controller_t;
 class lba_start_fsm_t;
 class lba_syncer_t;
 
@@ -26,8 +27,9 @@ class lba_list_t
 public:
     typedef lba_metablock_mixin_t metablock_mixin_t;
 
-    explicit lba_list_t(extent_manager_t *em,
-                        const write_metablock_fun_t &_write_metablock_fun);
+    lba_list_t(extent_manager_t *em,
+               const write_metablock_fun_t &_write_metablock_fun,
+               const gc_rate_controller_t *_gc_rate_controller);
     ~lba_list_t();
 
     static void prepare_initial_metablock(metablock_mixin_t *mb_out);
@@ -62,6 +64,7 @@ public:
 
     void set_block_info(block_id_t block, repli_timestamp_t recency,
                         flagged_off64_t offset, uint32_t ser_block_size,
+                        uint32_t uncompressed_ser_block_size,
                         file_account_t *io_account,
                         extent_transaction_t *txn);
 
@@ -93,6 +96,8 @@ private:
     write_metablock_fun_t write_metablock_fun;
 
     extent_manager_t *const extent_manager;
+    // Tells the GC to back off while foreground writes are struggling.
+    const gc_rate_controller_t *const gc_rate_controller;
 
     enum state_t {
         state_unstarted,
@@ -116,7 +121,8 @@ private:
     bool check_inline_lba_full() const;
     void move_inline_entries_to_extents(file_account_t *io_account, extent_transaction_t *txn);
     void add_inline_entry(block_id_t block, repli_timestamp_t recency,
-                                flagged_off64_t offset, uint32_t ser_block_size);
+                                flagged_off64_t offset, uint32_t ser_block_size,
+                                uint32_t uncompressed_ser_block_size);
 
     lba_disk_structure_t *disk_structures[LBA_SHARD_FACTOR];
 
@@ -6,13 +6,19 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <functional>
 
 #include "arch/io/disk.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/thread_pool.hpp"
 #include "buffer_cache/types.hpp"
 #include "concurrency/new_mutex.hpp"
+#include "containers/archive/buffer_stream.hpp"
+#include "containers/archive/stl_types.hpp"
+#include "containers/archive/string_stream.hpp"
+#include "containers/archive/versioned.hpp"
 #include "logger.hpp"
 #include "perfmon/perfmon.hpp"
 #include "serializer/buf_ptr.hpp"
@@ -97,6 +103,13 @@ void filepath_file_opener_t::unlink_serializer_file() {
     guarantee_err(res == 0, "unlink() failed");
 }
 
+std::string filepath_file_opener_t::hot_block_list_file_name() const {
+    // A file that's still being created (or that is about to be unlinked, like
+    // disk_backed_queue_t's) doesn't get a hot block list, so that we never leave
+    // one behind.  A new table gets one once it has been reopened.
+    return opened_temporary_ ? std::string() : filepath_.hot_block_list_path();
+}
+
 #ifdef SEMANTIC_SERIALIZER_CHECK
 void filepath_file_opener_t::open_semantic_checking_file(scoped_ptr_t<semantic_checking_file_t> *file_out) {
     const std::string semantic_filepath = filepath_.permanent_path() + "_semantic";
@@ -122,6 +135,7 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
       pm_serializer_index_reads(),
       pm_serializer_block_writes(),
       pm_serializer_index_writes(secs_to_ticks(1)),
+      pm_serializer_index_write_latency(secs_to_ticks(LATENCY_HISTOGRAM_INTERVAL_SECS)),
       pm_serializer_index_writes_size(secs_to_ticks(1), false),
       pm_serializer_read_bytes_per_sec(secs_to_ticks(1)),
       pm_serializer_read_bytes_total(),
@@ -135,13 +149,19 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
       pm_serializer_data_extents_gced(),
       pm_serializer_old_garbage_block_bytes(),
       pm_serializer_old_total_block_bytes(),
+      pm_serializer_foreground_write_latency(secs_to_ticks(1), false),
+      pm_serializer_gc_throttle_pauses(),
+      pm_serializer_gc_idle_extents(),
       pm_serializer_lba_gcs(),
+      pm_serializer_extents_discarded(),
+      pm_serializer_disk_latency(),
       parent_collection_membership(parent, &serializer_collection, "serializer"),
       stats_membership(&serializer_collection,
           &pm_serializer_block_reads, "serializer_block_reads",
           &pm_serializer_index_reads, "serializer_index_reads",
           &pm_serializer_block_writes, "serializer_block_writes",
           &pm_serializer_index_writes, "serializer_index_writes",
+          &pm_serializer_index_write_latency, "serializer_index_write_latency",
           &pm_serializer_index_writes_size, "serializer_index_writes_size",
           &pm_serializer_read_bytes_per_sec, "serializer_read_bytes_per_sec",
           &pm_serializer_read_bytes_total, "serializer_read_bytes_total",
@@ -155,7 +175,14 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
           &pm_serializer_data_extents_gced, "serializer_data_extents_gced",
           &pm_serializer_old_garbage_block_bytes, "serializer_old_garbage_block_bytes",
           &pm_serializer_old_total_block_bytes, "serializer_old_total_block_bytes",
-          &pm_serializer_lba_gcs, "serializer_lba_gcs")
+          &pm_serializer_foreground_write_latency, "serializer_foreground_write_latency",
+          &pm_serializer_gc_throttle_pauses, "serializer_gc_throttle_pauses",
+          &pm_serializer_gc_idle_extents, "serializer_gc_idle_extents",
+          &pm_serializer_lba_gcs, "serializer_lba_gcs",
+          &pm_serializer_extents_discarded, "serializer_extents_discarded",
+          &pm_serializer_disk_latency.read, "serializer_disk_read_latency",
+          &pm_serializer_disk_latency.write, "serializer_disk_write_latency",
+          &pm_serializer_disk_latency.datasync, "serializer_disk_datasync_latency")
 { }
 
 void log_serializer_stats_t::bytes_read(size_t count) {
@@ -214,6 +241,7 @@ struct ls_start_existing_fsm_t :
         scoped_ptr_t<file_t> dbfile;
         file_opener->open_serializer_file_existing(&dbfile);
         ser->dbfile = dbfile.release();
+        ser->dbfile->set_latency_stats(&ser->stats->pm_serializer_disk_latency);
         ser->index_writes_io_account.init(
             new file_account_t(ser->dbfile, INDEX_WRITE_IO_PRIORITY));
 
@@ -250,6 +278,7 @@ struct ls_start_existing_fsm_t :
         if (start_existing_state == state_find_metablock) {
             // STATE D
             ser->extent_manager = new extent_manager_t(ser->dbfile, &ser->static_config,
+                                                       ser->dynamic_config.discard_freed_extents,
                                                        ser->stats.get());
             {
                 // We never end up releasing the static header extent reference.  Nobody says we
@@ -262,7 +291,8 @@ struct ls_start_existing_fsm_t :
             ser->metablock_manager = new mb_manager_t(ser->extent_manager);
             ser->lba_index = new lba_list_t(ser->extent_manager,
                     std::bind(&log_serializer_t::write_metablock_sans_pipelining,
-                              ser, ph::_1, ph::_2));
+                              ser, ph::_1, ph::_2),
+                    &ser->gc_rate_controller);
             ser->data_block_manager
                 = new data_block_manager_t(ser->extent_manager, ser,
                                            &ser->static_config, ser->stats.get());
@@ -295,9 +325,20 @@ struct ls_start_existing_fsm_t :
         }
 
         if (start_existing_state == state_reconstruct) {
-            ser->data_block_manager->start_reconstruct();
+            ser->data_block_manager->start_reconstruct(ser->dbfile);
             start_existing_state = state_reconstruct_ongoing;
             num_blocks_reconstructed = 0;
+
+            // The LBA is all we need for serving reads.  Rebuilding the data block
+            // manager's garbage bookkeeping can take minutes on large files, so we
+            // let our user get going now and finish it in the background.  Writes
+            // wait for `data_block_manager_reconstructed`.
+            rassert(ser->state == log_serializer_t::state_starting_up);
+            ser->state = log_serializer_t::state_ready;
+            if (to_signal_when_done) {
+                to_signal_when_done->pulse();
+                to_signal_when_done = NULL;
+            }
             // Fall through into state_reconstruct_ongoing
         }
 
@@ -325,10 +366,8 @@ struct ls_start_existing_fsm_t :
 
         if (start_existing_state == state_finish) {
             start_existing_state = state_done;
-            rassert(ser->state == log_serializer_t::state_starting_up);
-            ser->state = log_serializer_t::state_ready;
-
-            if (to_signal_when_done) to_signal_when_done->pulse();
+            rassert(ser->state == log_serializer_t::state_ready);
+            ser->data_block_manager_reconstructed.pulse();
 
             delete this;
             return true;
@@ -408,16 +447,25 @@ log_serializer_t::log_serializer_t(dynamic_config_t _dynamic_config, serializer_
       metablock_manager(NULL),
       lba_index(NULL),
       data_block_manager(NULL),
-      active_write_count(0) {
+      gc_rate_controller(get_ticks()),
+      active_write_count(0),
+      hot_block_list_path(file_opener->hot_block_list_file_name()),
+      hot_block_list_write_active(false),
+      hot_block_list_write_pending(false) {
     // STATE A
     /* This is because the serializer is not completely converted to coroutines yet. */
     ls_start_existing_fsm_t *s = new ls_start_existing_fsm_t(this);
     cond_t cond;
     if (!s->run(&cond, file_opener)) cond.wait();
+
+    if (!hot_block_list_path.empty()) {
+        read_hot_block_list();
+    }
 }
 
 log_serializer_t::~log_serializer_t() {
     assert_thread();
+    data_block_manager_reconstructed.wait();
     cond_t cond;
     if (!shutdown(&cond)) cond.wait();
 
@@ -432,6 +480,12 @@ file_account_t *log_serializer_t::make_io_account(int priority, int outstanding_
     return new file_account_t(dbfile, priority, outstanding_requests_limit);
 }
 
+void log_serializer_t::set_io_weight(double weight) {
+    assert_thread();
+    rassert(dbfile);
+    dbfile->set_io_weight(weight);
+}
+
 buf_ptr_t log_serializer_t::block_read(const counted_t<ls_block_token_pointee_t> &token,
                                      file_account_t *io_account) {
     assert_thread();
@@ -442,7 +496,7 @@ buf_ptr_t log_serializer_t::block_read(const counted_t<ls_block_token_pointee_t>
     stats->pm_serializer_block_reads.begin(&pm_time);
 
     buf_ptr_t ret = data_block_manager->read(token->offset_, token->block_size(),
-                                           io_account);
+                                             token->block_size_on_disk(), io_account);
 
     stats->pm_serializer_block_reads.end(&pm_time);
     return ret;
@@ -470,6 +524,8 @@ void log_serializer_t::index_write(new_mutex_in_line_t *mutex_acq,
                                    const std::vector<index_write_op_t> &write_ops) {
     assert_thread();
     ticks_t pm_time;
+    data_block_manager_reconstructed.wait();
+    const ticks_t start_time = get_ticks();
     stats->pm_serializer_index_writes.begin(&pm_time);
     stats->pm_serializer_index_writes_size.record(write_ops.size());
 
@@ -488,6 +544,8 @@ void log_serializer_t::index_write(new_mutex_in_line_t *mutex_acq,
             const index_write_op_t &op = *write_op_it;
             flagged_off64_t offset = lba_index->get_block_offset(op.block_id);
             uint32_t ser_block_size = lba_index->get_ser_block_size(op.block_id);
+            uint32_t uncompressed_ser_block_size
+                = lba_index->get_block_info(op.block_id).uncompressed_ser_block_size;
 
             if (op.token) {
                 // Update the offset pointed to, and mark garbage/liveness as necessary.
@@ -502,13 +560,18 @@ void log_serializer_t::index_write(new_mutex_in_line_t *mutex_acq,
                 // Write new token to index, or remove from index as appropriate.
                 if (token.has()) {
                     offset = flagged_off64_t::make(token->offset_);
-                    ser_block_size = token->block_size().ser_value();
+                    ser_block_size = token->block_size_on_disk().ser_value();
+                    uncompressed_ser_block_size = token->is_compressed()
+                        ? token->block_size().ser_value()
+                        : 0;
 
                     /* mark the life */
-                    data_block_manager->mark_live(offset.get_value(), token->block_size());
+                    data_block_manager->mark_live(offset.get_value(),
+                                                  token->block_size_on_disk());
                 } else {
                     offset = flagged_off64_t::unused();
                     ser_block_size = 0;
+                    uncompressed_ser_block_size = 0;
                 }
             }
 
@@ -517,6 +580,7 @@ void log_serializer_t::index_write(new_mutex_in_line_t *mutex_acq,
 
             lba_index->set_block_info(op.block_id, recency,
                                       offset, ser_block_size,
+                                      uncompressed_ser_block_size,
                                       index_writes_io_account.get(), &txn);
         }
     }
@@ -524,6 +588,7 @@ void log_serializer_t::index_write(new_mutex_in_line_t *mutex_acq,
     index_write_finish(mutex_acq, &txn, index_writes_io_account.get());
 
     stats->pm_serializer_index_writes.end(&pm_time);
+    stats->pm_serializer_index_write_latency.record(get_ticks() - start_time);
 }
 
 void log_serializer_t::index_write_prepare(extent_transaction_t *txn) {
@@ -624,9 +689,11 @@ void log_serializer_t::write_metablock_sans_pipelining(const signal_t *safe_to_w
 }
 
 counted_t<ls_block_token_pointee_t>
-log_serializer_t::generate_block_token(int64_t offset, block_size_t block_size) {
+log_serializer_t::generate_block_token(int64_t offset, block_size_t block_size,
+                                       block_size_t block_size_on_disk) {
     assert_thread();
-    counted_t<ls_block_token_pointee_t> ret(new ls_block_token_pointee_t(this, offset, block_size));
+    counted_t<ls_block_token_pointee_t> ret(
+        new ls_block_token_pointee_t(this, offset, block_size, block_size_on_disk));
     return ret;
 }
 
@@ -634,6 +701,7 @@ std::vector<counted_t<ls_block_token_pointee_t> >
 log_serializer_t::block_writes(const std::vector<buf_write_info_t> &write_infos,
                                file_account_t *io_account, iocallback_t *cb) {
     assert_thread();
+    data_block_manager_reconstructed.wait();
     stats->pm_serializer_block_writes += write_infos.size();
 
     std::vector<counted_t<ls_block_token_pointee_t> > result
@@ -763,7 +831,10 @@ counted_t<ls_block_token_pointee_t> log_serializer_t::index_read(block_id_t bloc
 
     index_block_info_t info = lba_index->get_block_info(block_id);
     if (info.offset.has_value()) {
-        return generate_block_token(info.offset.get_value(), block_size_t::unsafe_make(info.ser_block_size));
+        return generate_block_token(
+            info.offset.get_value(),
+            block_size_t::unsafe_make(info.block_size_before_compression()),
+            block_size_t::unsafe_make(info.ser_block_size));
     } else {
         return counted_t<ls_block_token_pointee_t>();
     }
@@ -950,11 +1021,172 @@ bool log_serializer_t::should_perform_read_ahead() {
     return dynamic_config.read_ahead && !read_ahead_callbacks.empty();
 }
 
+// Returns 0, or the errno value of whatever failed.  We write a temporary file and
+// rename it into place, so that a crash leaves either the old list or the new one.
+// We don't bother syncing, since losing the list is harmless.
+int blocking_write_hot_block_list(const std::string &path, const std::string &data) {
+    const std::string temporary_path = path + ".tmp";
+    scoped_fd_t fd;
+    {
+        int res;
+        do {
+            res = open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        } while (res == -1 && get_errno() == EINTR);
+        if (res == -1) {
+            return get_errno();
+        }
+        fd.reset(res);
+    }
+
+    int errsv = 0;
+    size_t written = 0;
+    while (written < data.size()) {
+        const ssize_t res = ::write(fd.get(), data.data() + written,
+                                    data.size() - written);
+        if (res == -1) {
+            if (get_errno() == EINTR) {
+                continue;
+            }
+            errsv = get_errno();
+            break;
+        }
+        written += res;
+    }
+    fd.reset();
+
+    if (errsv == 0 && ::rename(temporary_path.c_str(), path.c_str()) != 0) {
+        errsv = get_errno();
+    }
+    if (errsv != 0) {
+        ::unlink(temporary_path.c_str());
+    }
+    return errsv;
+}
+
+void log_serializer_t::set_hot_block_ids(const std::vector<block_id_t> &block_ids) {
+    assert_thread();
+
+    const ticks_t now = get_ticks();
+    for (auto it = block_ids.begin(); it != block_ids.end(); ++it) {
+        hot_blocks[*it] = now;
+    }
+    const ticks_t max_age = secs_to_ticks(2 * HOT_BLOCK_LIST_INTERVAL_MS / THOUSAND);
+    for (auto it = hot_blocks.begin(); it != hot_blocks.end();) {
+        if (now - it->second > max_age) {
+            hot_blocks.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+
+    if (hot_block_list_path.empty()) {
+        return;
+    }
+    hot_block_list_write_pending = true;
+    if (!hot_block_list_write_active) {
+        hot_block_list_write_active = true;
+        coro_t::spawn_sometime(std::bind(&log_serializer_t::write_hot_block_list,
+                                         this, hot_block_list_drainer.lock()));
+    }
+}
+
+std::vector<block_id_t> log_serializer_t::hot_block_ids() {
+    assert_thread();
+    rassert(state == state_ready);
+
+    // Blocks may have moved (or been deleted) since the list was written, so we
+    // only sort them by offset now.
+    std::vector<std::pair<int64_t, block_id_t> > offsets;
+    for (auto it = startup_hot_block_ids.begin();
+         it != startup_hot_block_ids.end();
+         ++it) {
+        if (*it >= lba_index->end_block_id()) {
+            continue;
+        }
+        const flagged_off64_t offset = lba_index->get_block_offset(*it);
+        if (offset.has_value()) {
+            offsets.push_back(std::make_pair(offset.get_value(), *it));
+        }
+    }
+    std::sort(offsets.begin(), offsets.end());
+
+    std::vector<block_id_t> ret;
+    ret.reserve(offsets.size());
+    for (auto it = offsets.begin(); it != offsets.end(); ++it) {
+        ret.push_back(it->second);
+    }
+    return ret;
+}
+
+void log_serializer_t::read_hot_block_list() {
+    assert_thread();
+
+    std::string contents;
+    bool found;
+    thread_pool_t::run_in_blocker_pool([&]() {
+        found = blocking_read_file(hot_block_list_path.c_str(), &contents);
+    });
+    if (!found) {
+        return;
+    }
+
+    buffer_read_stream_t stream(contents.data(), contents.size());
+    cluster_version_t version;
+    std::vector<block_id_t> block_ids;
+    archive_result_t res = deserialize_cluster_version(&stream, &version);
+    if (!bad(res)) {
+        res = deserialize_for_version(version, &stream, &block_ids);
+    }
+    if (bad(res)) {
+        // The list only makes startup faster, so we can do without it.
+        logWRN("Ignoring the unreadable hot block list \"%s\" (%s).",
+               hot_block_list_path.c_str(), archive_result_as_str(res));
+        return;
+    }
+    startup_hot_block_ids = std::move(block_ids);
+}
+
+void log_serializer_t::write_hot_block_list(UNUSED auto_drainer_t::lock_t lock) {
+    assert_thread();
+
+    // We don't stop when `lock` gets drained, so that the latest list gets written
+    // before we shut down.
+    while (hot_block_list_write_pending) {
+        hot_block_list_write_pending = false;
+
+        std::vector<block_id_t> block_ids;
+        block_ids.reserve(hot_blocks.size());
+        for (auto it = hot_blocks.begin(); it != hot_blocks.end(); ++it) {
+            block_ids.push_back(it->first);
+        }
+        write_message_t wm;
+        serialize_cluster_version(&wm, cluster_version_t::LATEST_DISK);
+        serialize<cluster_version_t::LATEST_DISK>(&wm, block_ids);
+        string_stream_t stream;
+        DEBUG_VAR int send_res = send_write_message(&stream, &wm);
+        rassert(send_res == 0);
+
+        int errsv;
+        thread_pool_t::run_in_blocker_pool([&]() {
+            errsv = blocking_write_hot_block_list(hot_block_list_path, stream.str());
+        });
+        if (errsv != 0) {
+            logWRN("Could not write the hot block list \"%s\" (%s).",
+                   hot_block_list_path.c_str(), errno_string(errsv).c_str());
+        }
+    }
+    hot_block_list_write_active = false;
+}
+
 ls_block_token_pointee_t::ls_block_token_pointee_t(log_serializer_t *serializer,
                                                    int64_t initial_offset,
-                                                   block_size_t initial_block_size)
+                                                   block_size_t initial_block_size,
+                                                   block_size_t initial_block_size_on_disk)
     : serializer_(serializer), ref_count_(0),
-      block_size_(initial_block_size), offset_(initial_offset) {
+      block_size_(initial_block_size),
+      block_size_on_disk_(initial_block_size_on_disk),
+      offset_(initial_offset) {
+    rassert(block_size_on_disk_.ser_value() <= block_size_.ser_value());
     serializer_->assert_thread();
     serializer_->register_block_token(this, initial_offset);
 }
@@ -969,8 +1201,9 @@ void ls_block_token_pointee_t::do_destroy() {
 void debug_print(printf_buffer_t *buf,
                  const counted_t<ls_block_token_pointee_t> &token) {
     if (token.has()) {
-        buf->appendf("ls_block_token{%" PRIi64 ", +%" PRIu32 "}",
-                     token->offset(), token->block_size().ser_value());
+        buf->appendf("ls_block_token{%" PRIi64 ", +%" PRIu32 " (%" PRIu32 " on disk)}",
+                     token->offset(), token->block_size().ser_value(),
+                     token->block_size_on_disk().ser_value());
     } else {
         buf->appendf("nil");
     }
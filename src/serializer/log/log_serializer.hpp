@@ -11,6 +11,7 @@
 #include "serializer/serializer.hpp"
 #include "serializer/log/config.hpp"
 #include "utils.hpp"
+#include "concurrency/auto_drainer.hpp"
 #include "concurrency/mutex.hpp"
 #include "concurrency/mutex_assertion.hpp"
 #include "concurrency/signal.hpp"
@@ -19,6 +20,7 @@
 
 #include "serializer/log/metablock_manager.hpp"
 #include "serializer/log/extent_manager.hpp"
+#include "serializer/log/gc_rate_controller.hpp"
 #include "serializer/log/lba/lba_list.hpp"
 #include "serializer/log/stats.hpp"
 
@@ -73,6 +75,7 @@ public:
 #ifdef SEMANTIC_SERIALIZER_CHECK
     void open_semantic_checking_file(scoped_ptr_t<semantic_checking_file_t> *file_out);
 #endif
+    std::string hot_block_list_file_name() const;
 
 private:
     void open_serializer_file(const std::string &path, int extra_flags, scoped_ptr_t<file_t> *file_out);
@@ -142,6 +145,9 @@ public:
 
     void register_read_ahead_cb(serializer_read_ahead_callback_t *cb);
     void unregister_read_ahead_cb(serializer_read_ahead_callback_t *cb);
+    void set_hot_block_ids(const std::vector<block_id_t> &block_ids);
+    std::vector<block_id_t> hot_block_ids();
+    void set_io_weight(double weight);
     block_id_t max_block_id();
     segmented_vector_t<repli_timestamp_t> get_all_recencies(block_id_t first,
                                                             block_id_t step);
@@ -169,8 +175,9 @@ private:
     bool tokens_exist_for_offset(int64_t off);
     void unregister_block_token(ls_block_token_pointee_t *token);
     void remap_block_to_new_offset(int64_t current_offset, int64_t new_offset);
-    counted_t<ls_block_token_pointee_t> generate_block_token(int64_t offset,
-                                                             block_size_t block_size);
+    // `block_size_on_disk` is smaller than `block_size` for compressed blocks.
+    counted_t<ls_block_token_pointee_t> generate_block_token(
+            int64_t offset, block_size_t block_size, block_size_t block_size_on_disk);
 
     void offer_buf_to_read_ahead_callbacks(
             block_id_t block_id,
@@ -178,6 +185,11 @@ private:
             const counted_t<standard_block_token_t> &token);
     bool should_perform_read_ahead();
 
+    void read_hot_block_list();
+    // Writes `hot_blocks` to the hot block list file until there's nothing new to
+    // write.  `lock` keeps the serializer from being destroyed in the meantime.
+    void write_hot_block_list(auto_drainer_t::lock_t lock);
+
     /* Starts a new transaction, updates perfmons etc. */
     void index_write_prepare(extent_transaction_t *txn);
     /* Finishes a write transaction.  Resets `*mutex_acq` once it's okay to send
@@ -217,6 +229,9 @@ private:
     void consider_start_gc();
 
     std::multimap<int64_t, ls_block_token_pointee_t *> offset_tokens;
+    // Pulsed once the data block manager knows which blocks are garbage.  Until
+    // then, we can serve reads but not writes.
+    cond_t data_block_manager_reconstructed;
     scoped_ptr_t<log_serializer_stats_t> stats;
     perfmon_collection_t disk_stats_collection;
     perfmon_membership_t disk_stats_membership;
@@ -259,6 +274,9 @@ private:
     lba_list_t *lba_index;
     data_block_manager_t *data_block_manager;
 
+    // Paces the data block and LBA garbage collectors by foreground write latency.
+    gc_rate_controller_t gc_rate_controller;
+
     /* The running index writes organize themselves into a list so that they can be sure to
     write their metablocks in the correct order. The first element in the list
     is the oldest transaction that started but did not finish. */
@@ -266,6 +284,18 @@ private:
 
     int active_write_count;
 
+    // Where the hot block list is kept, or empty if we don't keep one.
+    std::string hot_block_list_path;
+    // What the hot block list file had when we started.
+    std::vector<block_id_t> startup_hot_block_ids;
+    // Every block that a cache reported as hot lately, and when it last did.  Each
+    // cache on a multiplexed file only reports its own blocks, so one report can't
+    // replace the others.
+    std::map<block_id_t, ticks_t> hot_blocks;
+    bool hot_block_list_write_active;
+    bool hot_block_list_write_pending;
+    auto_drainer_t hot_block_list_drainer;
+
     DISABLE_COPYING(log_serializer_t);
 };
 
@@ -280,8 +280,13 @@ void metablock_manager_t<metablock_t>::co_write_metablock(metablock_t *mb, file_
     mb_buffer_in_use = true;
 
     state = state_writing;
+    // The datasyncs go through the file rather than wrapping the write, so that
+    // serializers on the same file system that write their metablocks at the same
+    // time share their barriers.
+    co_datasync(dbfile);
     co_write(dbfile, head.offset(), METABLOCK_SIZE, mb_buffer, io_account,
-             file_t::WRAP_IN_DATASYNCS);
+             file_t::NO_DATASYNCS);
+    co_datasync(dbfile);
 
     ++head;
 
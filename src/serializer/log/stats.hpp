@@ -2,6 +2,7 @@
 #ifndef SERIALIZER_LOG_STATS_HPP_
 #define SERIALIZER_LOG_STATS_HPP_
 
+#include "arch/io/disk/latency_stats.hpp"
 #include "perfmon/perfmon.hpp"
 
 struct log_serializer_stats_t {
@@ -15,6 +16,8 @@ struct log_serializer_stats_t {
     perfmon_counter_t pm_serializer_index_reads;
     perfmon_counter_t pm_serializer_block_writes;
     perfmon_duration_sampler_t pm_serializer_index_writes;
+    /* How long index writes take, which is how long flushes wait for the disk */
+    perfmon_latency_histogram_t pm_serializer_index_write_latency;
     perfmon_sampler_t pm_serializer_index_writes_size;
 
     perfmon_rate_monitor_t pm_serializer_read_bytes_per_sec;
@@ -35,10 +38,19 @@ struct log_serializer_stats_t {
     perfmon_counter_t pm_serializer_data_extents_gced;
     perfmon_counter_t pm_serializer_old_garbage_block_bytes;
     perfmon_counter_t pm_serializer_old_total_block_bytes;
+    perfmon_sampler_t pm_serializer_foreground_write_latency;
+    perfmon_counter_t pm_serializer_gc_throttle_pauses;
+    perfmon_counter_t pm_serializer_gc_idle_extents;
 
     /* used in serializer/log/lba/lba_list.cc */
     perfmon_counter_t pm_serializer_lba_gcs;
 
+    /* used in serializer/log/extent_manager.cc */
+    perfmon_counter_t pm_serializer_extents_discarded;
+
+    /* recorded by the serializer's file */
+    file_latency_stats_t pm_serializer_disk_latency;
+
     perfmon_membership_t parent_collection_membership;
     perfmon_multi_membership_t stats_membership;
 };
@@ -15,8 +15,10 @@ merger_serializer_t::merger_serializer_t(scoped_ptr_t<serializer_t> _inner,
                                          int _max_active_writes) :
     inner(std::move(_inner)),
     block_writes_io_account(make_io_account(MERGER_BLOCK_WRITE_IO_PRIORITY)),
+    outstanding_index_write_bytes(0),
     write_committer(std::bind(&merger_serializer_t::do_index_write, this),
-                    _max_active_writes) { }
+                    _max_active_writes,
+                    std::bind(&merger_serializer_t::may_write_concurrently, this)) { }
 
 merger_serializer_t::~merger_serializer_t() {
     assert_thread();
@@ -56,11 +58,20 @@ void merger_serializer_t::do_index_write() {
             write_ops.push_back(op_pair->second);
         }
         outstanding_index_write_ops.clear();
+        outstanding_index_write_bytes = 0;
     }
 
+    // Getting in line for both mutexes before waiting for anything keeps concurrent
+    // merged writes in the order they were started.
     new_mutex_in_line_t mutex_acq(&inner_index_write_mutex);
+    new_mutex_in_line_t completion_acq(&index_write_completion_mutex);
     mutex_acq.acq_signal()->wait();
     inner->index_write(&mutex_acq, write_ops);
+    completion_acq.acq_signal()->wait();
+}
+
+bool merger_serializer_t::may_write_concurrently() const {
+    return outstanding_index_write_bytes >= MERGER_SERIALIZER_CONCURRENT_WRITE_MIN_BYTES;
 }
 
 void merger_serializer_t::merge_index_write_op(const index_write_op_t &to_be_merged,
@@ -83,5 +94,8 @@ void merger_serializer_t::push_index_write_op(const index_write_op_t &op) {
         // new op could not be inserted because it already exists. Merge instead.
         merge_index_write_op(op, &existing_pair.first->second);
     }
+    if (op.token.is_initialized() && op.token->has()) {
+        outstanding_index_write_bytes += (*op.token)->block_size_on_disk().ser_value();
+    }
 }
 
@@ -22,6 +22,13 @@
  * hash shards) can be merged together, improving efficiency and significantly
  * reducing the number of disk seeks on rotational drives.
  *
+ * Queued up index writes only get a merged write of their own while another one is
+ * active once the blocks they refer to add up to at least
+ * `MERGER_SERIALIZER_CONCURRENT_WRITE_MIN_BYTES`.  Smaller batches wait for an active
+ * write to complete, so that they get merged with more.  The inner serializer
+ * applies the merged writes in the order they're started, and `index_write` doesn't
+ * return before the merged writes started ahead of its own have completed too.
+ *
  * As an additional optimization, merger_serializer_t uses a common file account
  * for all block_writes, so reduce the amount of random disk seeks that can
  * occur when writes from multiple different accounts get interleaved (see
@@ -53,6 +60,17 @@ public:
         inner->unregister_read_ahead_cb(cb);
     }
 
+    void set_hot_block_ids(const std::vector<block_id_t> &block_ids) {
+        inner->set_hot_block_ids(block_ids);
+    }
+    std::vector<block_id_t> hot_block_ids() {
+        return inner->hot_block_ids();
+    }
+
+    void set_io_weight(double weight) {
+        inner->set_io_weight(weight);
+    }
+
     // Reading a block from the serializer.  Reads a block, blocks the coroutine.
     buf_ptr_t block_read(const counted_t<standard_block_token_t> &token,
                        file_account_t *io_account) {
@@ -123,6 +141,7 @@ private:
                               index_write_op_t *into_out) const;
 
     void do_index_write();
+    bool may_write_concurrently() const;
 
     const scoped_ptr_t<serializer_t> inner;
     const scoped_ptr_t<file_account_t> block_writes_io_account;
@@ -131,8 +150,16 @@ private:
     // simultaneous racing index_write calls.
     new_mutex_t inner_index_write_mutex;
 
+    // Merged index writes get in line for this when they start, and get it once the
+    // ones started before them have completed.
+    new_mutex_t index_write_completion_mutex;
+
     // A map of outstanding index write operations, indexed by block id
     std::map<block_id_t, index_write_op_t> outstanding_index_write_ops;
+    // The on-disk size of the blocks that `outstanding_index_write_ops` refer to.
+    // Roughly: blocks that got written again before an index write are counted
+    // twice.
+    int64_t outstanding_index_write_bytes;
 
     throttled_committer_t write_committer;
 
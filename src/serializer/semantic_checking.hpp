@@ -75,6 +75,11 @@ public:
 
     void register_read_ahead_cb(UNUSED serializer_read_ahead_callback_t *cb);
     void unregister_read_ahead_cb(UNUSED serializer_read_ahead_callback_t *cb);
+
+    void set_hot_block_ids(const std::vector<block_id_t> &block_ids);
+    std::vector<block_id_t> hot_block_ids();
+
+    void set_io_weight(double weight);
 };
 
 #endif /* SERIALIZER_SEMANTIC_CHECKING_HPP_ */
@@ -232,3 +232,21 @@ register_read_ahead_cb(UNUSED serializer_read_ahead_callback_t *cb) {
 template<class inner_serializer_t>
 void semantic_checking_serializer_t<inner_serializer_t>::
 unregister_read_ahead_cb(UNUSED serializer_read_ahead_callback_t *cb) { }
+
+template<class inner_serializer_t>
+void semantic_checking_serializer_t<inner_serializer_t>::
+set_hot_block_ids(const std::vector<block_id_t> &block_ids) {
+    inner_serializer.set_hot_block_ids(block_ids);
+}
+
+template<class inner_serializer_t>
+std::vector<block_id_t> semantic_checking_serializer_t<inner_serializer_t>::
+hot_block_ids() {
+    return inner_serializer.hot_block_ids();
+}
+
+template<class inner_serializer_t>
+void semantic_checking_serializer_t<inner_serializer_t>::
+set_io_weight(double weight) {
+    inner_serializer.set_io_weight(weight);
+}
@@ -0,0 +1,223 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "serializer/ser_buffer_allocator.hpp"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include <array>
+#include <atomic>
+
+#include "arch/runtime/runtime.hpp"
+#include "arch/spinlock.hpp"
+#include "concurrency/cache_line_padded.hpp"
+#include "config/args.hpp"
+#include "math.hpp"
+#include "utils.hpp"
+
+namespace {
+
+const size_t SLAB_CHUNK_SIZE = 2 * MEGABYTE;
+
+// How much address space gets reserved for chunks.  Reserving it costs nothing
+// but address space; once it's used up, buffers come from malloc_aligned.
+const size_t SLAB_ARENA_SIZE = 256 * GIGABYTE;
+const size_t NUM_SLAB_CHUNKS = SLAB_ARENA_SIZE / SLAB_CHUNK_SIZE;
+
+const int NUM_SIZE_CLASSES = 5;
+static_assert((MIN_BTREE_BLOCK_SIZE << (NUM_SIZE_CLASSES - 1)) == MAX_BTREE_BLOCK_SIZE,
+              "NUM_SIZE_CLASSES doesn't match the range of block sizes.");
+static_assert(SLAB_CHUNK_SIZE % MAX_BTREE_BLOCK_SIZE == 0,
+              "Chunks must hold a whole number of buffers.");
+
+// Returns -1 for sizes that don't have a size class.
+int size_class_of_size(size_t size) {
+    int size_class = 0;
+    for (size_t s = MIN_BTREE_BLOCK_SIZE; s <= MAX_BTREE_BLOCK_SIZE; s *= 2) {
+        if (s == size) {
+            return size_class;
+        }
+        ++size_class;
+    }
+    return -1;
+}
+
+size_t size_of_size_class(int size_class) {
+    return static_cast<size_t>(MIN_BTREE_BLOCK_SIZE) << size_class;
+}
+
+struct free_buffer_t {
+    free_buffer_t *next;
+};
+
+// The address space that chunks come from, and which size class each chunk has.
+class slab_arena_t {
+public:
+    slab_arena_t() : base_(NULL), next_chunk_(0) {
+#ifndef VALGRIND
+        // We reserve an extra chunk so that we can align the chunks.
+        void *res = mmap(NULL, SLAB_ARENA_SIZE + SLAB_CHUNK_SIZE, PROT_NONE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (res != MAP_FAILED) {
+            base_ = reinterpret_cast<char *>(
+                ceil_aligned(reinterpret_cast<uintptr_t>(res), SLAB_CHUNK_SIZE));
+        }
+#endif
+    }
+
+    // Returns a new writable chunk for the given size class, or NULL if there is
+    // no more room.
+    char *new_chunk(int size_class) {
+        if (base_ == NULL) {
+            return NULL;
+        }
+        const size_t index = next_chunk_.fetch_add(1);
+        if (index >= NUM_SLAB_CHUNKS) {
+            return NULL;
+        }
+        char *chunk = base_ + index * SLAB_CHUNK_SIZE;
+
+        // We use explicit huge pages if the system has some reserved, and ask for
+        // transparent ones otherwise.
+        void *res = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        res = mmap(chunk, SLAB_CHUNK_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0);
+#endif
+        if (res == MAP_FAILED) {
+            res = mmap(chunk, SLAB_CHUNK_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+            if (res == MAP_FAILED) {
+                return NULL;
+            }
+#ifdef MADV_HUGEPAGE
+            madvise(chunk, SLAB_CHUNK_SIZE, MADV_HUGEPAGE);
+#endif
+        }
+
+        chunk_size_classes_[index] = size_class;
+        return chunk;
+    }
+
+    // Returns the size class of the chunk that `ptr` is in, or -1 if `ptr` isn't in
+    // the arena.
+    int size_class_of_ptr(const void *ptr) const {
+        const char *p = static_cast<const char *>(ptr);
+        if (base_ == NULL || p < base_ || p >= base_ + SLAB_ARENA_SIZE) {
+            return -1;
+        }
+        return chunk_size_classes_[(p - base_) / SLAB_CHUNK_SIZE];
+    }
+
+private:
+    char *base_;
+    std::atomic<size_t> next_chunk_;
+    // A chunk's entry is set before any of its buffers get handed out, and buffers
+    // only reach other threads through something that synchronizes.
+    std::array<int8_t, NUM_SLAB_CHUNKS> chunk_size_classes_;
+
+    DISABLE_COPYING(slab_arena_t);
+};
+
+slab_arena_t *get_slab_arena() {
+    static slab_arena_t arena;
+    return &arena;
+}
+
+struct thread_slabs_t {
+    thread_slabs_t() {
+        for (int i = 0; i < NUM_SIZE_CLASSES; ++i) {
+            free_lists[i] = NULL;
+            chunk_next[i] = NULL;
+            chunk_end[i] = NULL;
+        }
+    }
+    free_buffer_t *free_lists[NUM_SIZE_CLASSES];
+    // The unused part of the chunk this thread is carving buffers from.
+    char *chunk_next[NUM_SIZE_CLASSES];
+    char *chunk_end[NUM_SIZE_CLASSES];
+};
+
+std::array<cache_line_padded_t<thread_slabs_t>, MAX_THREADS> thread_slabs;
+
+// Buffers freed by threads outside the thread pool go here, for the pool's threads
+// to pick up.
+spinlock_t orphaned_buffers_lock;
+free_buffer_t *orphaned_buffers[NUM_SIZE_CLASSES];
+
+// Returns NULL if the calling thread isn't in the thread pool.
+thread_slabs_t *get_thread_slabs() {
+#ifdef VALGRIND
+    return NULL;
+#else
+    const int threadnum = get_thread_id().threadnum;
+    if (threadnum < 0 || threadnum >= MAX_THREADS) {
+        return NULL;
+    }
+    return &thread_slabs[threadnum].value;
+#endif
+}
+
+free_buffer_t *take_orphaned_buffer(int size_class) {
+    spinlock_acq_t acq(&orphaned_buffers_lock);
+    free_buffer_t *buffer = orphaned_buffers[size_class];
+    if (buffer != NULL) {
+        orphaned_buffers[size_class] = buffer->next;
+    }
+    return buffer;
+}
+
+}  // namespace
+
+void *alloc_ser_buffer(size_t size) {
+    thread_slabs_t *slabs = get_thread_slabs();
+    const int size_class = slabs == NULL ? -1 : size_class_of_size(size);
+    if (size_class == -1) {
+        return malloc_aligned(size, DEVICE_BLOCK_SIZE);
+    }
+
+    free_buffer_t *buffer = slabs->free_lists[size_class];
+    if (buffer != NULL) {
+        slabs->free_lists[size_class] = buffer->next;
+        return buffer;
+    }
+
+    if (slabs->chunk_next[size_class] == slabs->chunk_end[size_class]) {
+        buffer = take_orphaned_buffer(size_class);
+        if (buffer != NULL) {
+            return buffer;
+        }
+        char *chunk = get_slab_arena()->new_chunk(size_class);
+        if (chunk == NULL) {
+            return malloc_aligned(size, DEVICE_BLOCK_SIZE);
+        }
+        slabs->chunk_next[size_class] = chunk;
+        slabs->chunk_end[size_class] = chunk + SLAB_CHUNK_SIZE;
+    }
+
+    char *ret = slabs->chunk_next[size_class];
+    slabs->chunk_next[size_class] += size_of_size_class(size_class);
+    return ret;
+}
+
+void free_ser_buffer(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    const int size_class = get_slab_arena()->size_class_of_ptr(ptr);
+    if (size_class == -1) {
+        ::free(ptr);
+        return;
+    }
+
+    free_buffer_t *buffer = static_cast<free_buffer_t *>(ptr);
+    thread_slabs_t *slabs = get_thread_slabs();
+    if (slabs != NULL) {
+        buffer->next = slabs->free_lists[size_class];
+        slabs->free_lists[size_class] = buffer;
+    } else {
+        spinlock_acq_t acq(&orphaned_buffers_lock);
+        buffer->next = orphaned_buffers[size_class];
+        orphaned_buffers[size_class] = buffer;
+    }
+}
@@ -0,0 +1,75 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_SER_BUFFER_ALLOCATOR_HPP_
+#define SERIALIZER_SER_BUFFER_ALLOCATOR_HPP_
+
+#include <stddef.h>
+
+#include <utility>
+
+#include "errors.hpp"
+#include "serializer/types.hpp"
+
+/* The buffers behind `buf_ptr_t`s are what the page cache is made of, so a big cache
+has millions of them.  Buffers of the sizes a table's blocks can have (powers of two
+from MIN_BTREE_BLOCK_SIZE to MAX_BTREE_BLOCK_SIZE) are carved out of 2MB chunks
+backed by huge pages, which spares the TLB and keeps the heap from fragmenting.
+Each chunk only holds buffers of one size, and each thread carves its own chunks
+and keeps the buffers it frees for its next allocations of that size.  Since a
+thread is the first to touch its chunks, they end up on its NUMA node.
+
+Freed buffers are kept for reuse rather than given back to the system; the cache
+balancer bounds how many of them the caches can hold at once.  Other sizes, threads
+outside the thread pool and Valgrind builds go through `malloc_aligned` instead. */
+
+// Returns DEVICE_BLOCK_SIZE-aligned memory.
+void *alloc_ser_buffer(size_t size);
+// Frees memory from `alloc_ser_buffer`, on any thread.  Does nothing if `ptr` is
+// NULL.
+void free_ser_buffer(void *ptr);
+
+// Like scoped_malloc_t<ser_buffer_t>, but for memory from `alloc_ser_buffer`.
+class scoped_ser_buffer_t {
+public:
+    scoped_ser_buffer_t() : ptr_(NULL) { }
+    explicit scoped_ser_buffer_t(size_t size)
+        : ptr_(static_cast<ser_buffer_t *>(alloc_ser_buffer(size))) { }
+    // Takes ownership of `ptr`, which must have come from `alloc_ser_buffer`.
+    explicit scoped_ser_buffer_t(ser_buffer_t *ptr) : ptr_(ptr) { }
+    scoped_ser_buffer_t(scoped_ser_buffer_t &&movee) noexcept : ptr_(movee.ptr_) {
+        movee.ptr_ = NULL;
+    }
+
+    ~scoped_ser_buffer_t() {
+        free_ser_buffer(ptr_);
+    }
+
+    void operator=(scoped_ser_buffer_t &&movee) noexcept {
+        scoped_ser_buffer_t tmp(std::move(movee));
+        std::swap(ptr_, tmp.ptr_);
+    }
+
+    ser_buffer_t *get() const { return ptr_; }
+    ser_buffer_t *operator->() const { return ptr_; }
+
+    ser_buffer_t *release() {
+        ser_buffer_t *tmp = ptr_;
+        ptr_ = NULL;
+        return tmp;
+    }
+
+    void reset() {
+        scoped_ser_buffer_t tmp;
+        std::swap(ptr_, tmp.ptr_);
+    }
+
+    bool has() const {
+        return ptr_ != NULL;
+    }
+
+private:
+    ser_buffer_t *ptr_;
+
+    DISABLE_COPYING(scoped_ser_buffer_t);
+};
+
+#endif  // SERIALIZER_SER_BUFFER_ALLOCATOR_HPP_
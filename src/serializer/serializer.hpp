@@ -60,6 +60,19 @@ public:
     virtual void register_read_ahead_cb(serializer_read_ahead_callback_t *cb) = 0;
     virtual void unregister_read_ahead_cb(serializer_read_ahead_callback_t *cb) = 0;
 
+    /* Hot block lists let a cache warm up quickly after a restart.  Every so often
+    the cache reports the blocks it has been using most, and the serializer
+    remembers them across restarts (if it can).  hot_block_ids() returns the blocks
+    that were remembered when the serializer started, in the order they are laid out
+    on disk, so that the cache can read them in one sweep. */
+    virtual void set_hot_block_ids(const std::vector<block_id_t> &block_ids) = 0;
+    virtual std::vector<block_id_t> hot_block_ids() = 0;
+
+    /* Weighs the I/O of all of the serializer's io accounts against the I/O of other
+    serializers' (see `file_t::set_io_weight`).  Serializers that share a file share
+    its weight. */
+    virtual void set_io_weight(double weight) = 0;
+
     // Reading a block from the serializer.  Reads a block, blocks the coroutine.
     virtual buf_ptr_t block_read(const counted_t<standard_block_token_t> &token,
                                file_account_t *io_account) = 0;
@@ -330,6 +330,35 @@ void translator_serializer_t::offer_read_ahead_buf(
     }
 }
 
+void translator_serializer_t::set_hot_block_ids(
+        const std::vector<block_id_t> &block_ids) {
+    std::vector<block_id_t> inner_block_ids;
+    inner_block_ids.reserve(block_ids.size());
+    for (auto it = block_ids.begin(); it != block_ids.end(); ++it) {
+        inner_block_ids.push_back(translate_block_id(*it));
+    }
+    inner->set_hot_block_ids(inner_block_ids);
+}
+
+std::vector<block_id_t> translator_serializer_t::hot_block_ids() {
+    // The inner serializer's list has the blocks of every shard.  We keep only ours,
+    // in the same order.
+    std::vector<block_id_t> inner_block_ids = inner->hot_block_ids();
+    std::vector<block_id_t> ret;
+    for (auto it = inner_block_ids.begin(); it != inner_block_ids.end(); ++it) {
+        if (*it <= CONFIG_BLOCK_ID.ser_id
+            || untranslate_block_id_to_mod_id(*it, mod_count, cfgid) != mod_id) {
+            continue;
+        }
+        ret.push_back(untranslate_block_id_to_id(*it, mod_count, mod_id, cfgid));
+    }
+    return ret;
+}
+
+void translator_serializer_t::set_io_weight(double weight) {
+    inner->set_io_weight(weight);
+}
+
 void translator_serializer_t::register_read_ahead_cb(serializer_read_ahead_callback_t *cb) {
     assert_thread();
 
@@ -121,6 +121,10 @@ class ls_block_token_pointee_t {
 public:
     int64_t offset() const { return offset_; }
     block_size_t block_size() const { return block_size_; }
+    block_size_t block_size_on_disk() const { return block_size_on_disk_; }
+    bool is_compressed() const {
+        return block_size_on_disk_.ser_value() != block_size_.ser_value();
+    }
 
 private:
     friend class log_serializer_t;
@@ -131,14 +135,19 @@ private:
 
     ls_block_token_pointee_t(log_serializer_t *serializer,
                              int64_t initial_offset,
-                             block_size_t initial_ser_block_size);
+                             block_size_t initial_ser_block_size,
+                             block_size_t initial_ser_block_size_on_disk);
 
     log_serializer_t *serializer_;
     intptr_t ref_count_;
 
-    // The block's size.
+    // The block's size, as seen by the serializer's users.
     block_size_t block_size_;
 
+    // The size the block takes up on disk, which is smaller than `block_size_` if
+    // the block is compressed.
+    block_size_t block_size_on_disk_;
+
     // The block's offset on disk.
     int64_t offset_;
 
@@ -176,6 +185,10 @@ public:
 #ifdef SEMANTIC_SERIALIZER_CHECK
     virtual void open_semantic_checking_file(scoped_ptr_t<semantic_checking_file_t> *file_out) = 0;
 #endif
+
+    // Where the serializer keeps its hot block list (see serializer_t), or the empty
+    // string if it shouldn't keep one.
+    virtual std::string hot_block_list_file_name() const = 0;
 };
 
 #ifdef SEMANTIC_SERIALIZER_CHECK
@@ -99,6 +99,11 @@ public:
         store_view->read(DEBUG_ONLY(metainfo_checker, ) read, response, order_token, token, interruptor);
     }
 
+    void prefetch_for_write(const write_t &write) {
+        home_thread_mixin_t::assert_thread();
+        store_view->prefetch_for_write(write);
+    }
+
     void write(
             DEBUG_ONLY(const metainfo_checker_t& metainfo_checker, )
             const region_map_t<binary_blob_t>& new_metainfo,
@@ -58,6 +58,12 @@ public:
             THROWS_ONLY(interrupted_exc_t) = 0;
 
 
+    /* Loads the parts of the store that `write` is going to touch, so that it
+    doesn't have to wait for the disk while it holds up the writes behind it. It
+    doesn't take a token; it can run at any time, concurrently with anything.
+    [May block] */
+    virtual void prefetch_for_write(const write_t &write) = 0;
+
     /* Performs a write.
     [Precondition] region_is_superset(view->get_region(), expected_metainfo.get_domain())
     [Precondition] new_metainfo.get_domain() == expected_metainfo.get_domain()
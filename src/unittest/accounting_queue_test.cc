@@ -0,0 +1,65 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "concurrency/queue/accounting.hpp"
+#include "concurrency/queue/unlimited_fifo.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+typedef accounting_queue_t<int> test_accounting_queue_t;
+
+TEST(AccountingQueueTest, SharesRatio) {
+    test_accounting_queue_t queue(1);
+    unlimited_fifo_queue_t<int> a, b;
+    for (int i = 0; i < 100; ++i) {
+        a.push(0);
+        b.push(1);
+    }
+    test_accounting_queue_t::account_t account_a(&queue, &a, 1);
+    test_accounting_queue_t::account_t account_b(&queue, &b, 4);
+
+    // Out of every five values, one comes from `a` and four come from `b`.
+    int from_a = 0;
+    for (int i = 0; i < 40; ++i) {
+        ASSERT_TRUE(queue.available->get());
+        from_a += queue.pop() == 0 ? 1 : 0;
+    }
+    EXPECT_EQ(8, from_a);
+
+    account_b.set_shares(1);
+    from_a = 0;
+    for (int i = 0; i < 40; ++i) {
+        from_a += queue.pop() == 0 ? 1 : 0;
+    }
+    EXPECT_EQ(20, from_a);
+}
+
+TEST(AccountingQueueTest, NewlyAvailableAccountGoesFirst) {
+    test_accounting_queue_t queue(1);
+    unlimited_fifo_queue_t<int> busy, idle;
+    for (int i = 0; i < 1000; ++i) {
+        busy.push(0);
+    }
+    test_accounting_queue_t::account_t busy_account(&queue, &busy, 100);
+    test_accounting_queue_t::account_t idle_account(&queue, &idle, 100);
+
+    for (int i = 0; i < 500; ++i) {
+        ASSERT_EQ(0, queue.pop());
+    }
+
+    // The idle account didn't save up credit while it was idle, but it doesn't have
+    // to wait behind the busy account either.
+    idle.push(1);
+    idle.push(1);
+    EXPECT_EQ(1, queue.pop());
+    EXPECT_EQ(0, queue.pop());
+    EXPECT_EQ(1, queue.pop());
+    EXPECT_EQ(0, queue.pop());
+    EXPECT_FALSE(idle.available->get());
+
+    while (busy.available->get()) {
+        queue.pop();
+    }
+    EXPECT_FALSE(queue.available->get());
+}
+
+}  // namespace unittest
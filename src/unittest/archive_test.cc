@@ -5,6 +5,7 @@
 
 #include "containers/archive/boost_types.hpp"
 #include "containers/archive/stl_types.hpp"
+#include "containers/archive/vector_stream.hpp"
 
 namespace unittest {
 
@@ -34,6 +35,41 @@ TEST(WriteMessageTest, Variant) {
     ASSERT_EQ(15u, s.size());
 }
 
+TEST(WriteMessageTest, ManyBuffersToVectorStream) {
+    // Enough small and large appends to span several buffers, and to have some of
+    // them straddle buffer boundaries.
+    write_message_t wm;
+    std::string expected;
+    for (int i = 0; i < 3000; ++i) {
+        std::string s(i % 7 == 0 ? 1000 : 3, static_cast<char>(i));
+        wm.append(s.data(), s.size());
+        expected += s;
+    }
+    ASSERT_EQ(expected.size(), wm.size());
+
+    vector_stream_t stream;
+    stream.reserve(10);
+    ASSERT_EQ(0, send_write_message(&stream, &wm));
+    ASSERT_EQ(0, send_write_message(&stream, &wm));
+    ASSERT_EQ(expected + expected,
+              std::string(stream.vector().begin(), stream.vector().end()));
+}
+
+TEST(WriteMessageTest, Reserve) {
+    write_message_t wm;
+    wm.append("ab", 2);
+    const std::string big(3 * write_buffer_t::DATA_SIZE, 'x');
+    wm.reserve(big.size() + 2);
+    wm.append(big.data(), big.size());
+    wm.append("cd", 2);
+
+    intrusive_list_t<write_buffer_t> *buffers = wm.unsafe_expose_buffers();
+    ASSERT_EQ(2u, buffers->size());
+    ASSERT_EQ(static_cast<int>(big.size()) + 2, buffers->tail()->size);
 
+    std::string s;
+    dump_to_string(&wm, &s);
+    ASSERT_EQ("ab" + big + "cd", s);
+}
 
 }  // namespace unittest
@@ -0,0 +1,117 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <string>
+#include <vector>
+
+#include "arch/timing.hpp"
+#include "concurrency/cond_var.hpp"
+#include "rdb_protocol/artificial_table/caching_cfeed_backend.hpp"
+#include "rdb_protocol/datum_stream.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+/* A one-row table that counts how often all of its rows are computed. */
+class counting_backend_t : public caching_cfeed_artificial_table_backend_t {
+public:
+    explicit counting_backend_t(bool _complete) :
+        complete(_complete), value(0), full_reads(0) { }
+    ~counting_backend_t() {
+        begin_changefeed_destruction();
+    }
+
+    std::string get_primary_key_name() {
+        return "id";
+    }
+
+    bool read_all_rows_as_vector(
+            UNUSED signal_t *interruptor,
+            std::vector<ql::datum_t> *rows_out,
+            UNUSED std::string *error_out) {
+        ++full_reads;
+        rows_out->clear();
+        rows_out->push_back(make_row());
+        return true;
+    }
+
+    bool read_row(
+            UNUSED ql::datum_t primary_key,
+            UNUSED signal_t *interruptor,
+            ql::datum_t *row_out,
+            UNUSED std::string *error_out) {
+        *row_out = make_row();
+        return true;
+    }
+
+    bool write_row(
+            UNUSED ql::datum_t primary_key,
+            UNUSED bool pkey_was_autogenerated,
+            UNUSED ql::datum_t *new_value_inout,
+            UNUSED signal_t *interruptor,
+            std::string *error_out) {
+        *error_out = "read-only";
+        return false;
+    }
+
+    void set_value(int v) {
+        value = v;
+        notify_all();
+    }
+
+    int read_all() {
+        cond_t non_interruptor;
+        counted_t<ql::datum_stream_t> stream;
+        std::string error;
+        EXPECT_TRUE(read_all_rows_as_stream(
+            ql::protob_t<const Backtrace>(), ql::datum_range_t::universe(),
+            sorting_t::UNORDERED, &non_interruptor, &stream, &error));
+        return full_reads;
+    }
+
+    int full_reads_so_far() const { return full_reads; }
+
+private:
+    bool notifications_are_complete() { return complete; }
+
+    ql::datum_t make_row() {
+        ql::datum_object_builder_t builder;
+        builder.overwrite("id", ql::datum_t(0.0));
+        builder.overwrite("value", ql::datum_t(static_cast<double>(value)));
+        return std::move(builder).to_datum();
+    }
+
+    const bool complete;
+    int value;
+    int full_reads;
+};
+
+TPTEST(ArtificialTableCache, ServesReadsFromMachinery) {
+    counting_backend_t backend(true);
+    // The first read computes the rows and starts the machinery, which loads them
+    // again.
+    ASSERT_EQ(1, backend.read_all());
+    nap(100);
+    const int loaded = backend.full_reads_so_far();
+    ASSERT_EQ(2, loaded);
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_EQ(loaded, backend.read_all());
+    }
+
+    // A change is read directly until the machinery has caught up with it.
+    backend.set_value(1);
+    ASSERT_EQ(loaded + 1, backend.read_all());
+    nap(100);
+    const int reloaded = backend.full_reads_so_far();
+    ASSERT_EQ(loaded + 2, reloaded);
+    ASSERT_EQ(reloaded, backend.read_all());
+}
+
+TPTEST(ArtificialTableCache, IncompleteNotificationsAreNotCached) {
+    counting_backend_t backend(false);
+    for (int i = 1; i <= 5; ++i) {
+        ASSERT_EQ(i, backend.read_all());
+        nap(10);
+    }
+}
+
+}  // namespace unittest
@@ -0,0 +1,107 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "clustering/administration/tables/auto_rebalancer.hpp"
+#include "clustering/administration/tables/split_points.hpp"
+#include "clustering/administration/tables/table_metadata.hpp"
+#include "config/args.hpp"
+#include "rdb_protocol/key_load_sampler.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+store_key_t load_test_key(int i) {
+    return store_key_t(strprintf("%06d", i));
+}
+
+TEST(AutoRebalancerTest, SamplerWeighsKeysByLoad) {
+    key_load_sampler_t sampler;
+    const int num_ops = 100 * KEY_LOAD_SAMPLE_SIZE;
+    for (int i = 0; i < num_ops; ++i) {
+        // Three out of four operations go to the first hundred keys.
+        sampler.record(load_test_key(i % 4 == 0 ? 100 + i % 900 : i % 100));
+    }
+    std::map<store_key_t, int64_t> loads;
+    sampler.get_load(key_range_t::universe(), &loads);
+    int64_t total = 0, hot = 0;
+    for (const auto &pair : loads) {
+        total += pair.second;
+        if (pair.first < load_test_key(100)) {
+            hot += pair.second;
+        }
+    }
+    EXPECT_EQ(num_ops, total);
+    EXPECT_GT(hot, total / 2);
+    EXPECT_LT(hot, total * 9 / 10);
+
+    std::map<store_key_t, int64_t> cold_loads;
+    sampler.get_load(
+        key_range_t(key_range_t::closed, load_test_key(100),
+                    key_range_t::none, store_key_t()),
+        &cold_loads);
+    int64_t cold = 0;
+    for (const auto &pair : cold_loads) {
+        EXPECT_GE(pair.first, load_test_key(100));
+        cold += pair.second;
+    }
+    EXPECT_EQ(total - hot, cold);
+}
+
+TEST(AutoRebalancerTest, SplitPointsFollowLoad) {
+    // A thousand documents spread evenly, with all of the load on the first tenth.
+    std::map<store_key_t, int64_t> counts, loads;
+    for (int i = 0; i < 1000; i += 10) {
+        counts[load_test_key(i)] = 10;
+    }
+    for (int i = 0; i < 100; ++i) {
+        loads[load_test_key(i)] = 50;
+    }
+
+    table_shard_scheme_t by_count, by_load;
+    std::string error;
+    ASSERT_TRUE(calculate_split_points_with_load(
+        counts, loads, 0, 2, &by_count, &error));
+    ASSERT_TRUE(calculate_split_points_with_load(
+        counts, loads, 1, 2, &by_load, &error));
+    ASSERT_EQ(1u, by_count.split_points.size());
+    ASSERT_EQ(1u, by_load.split_points.size());
+    EXPECT_GE(by_count.split_points[0], load_test_key(490));
+    EXPECT_LE(by_count.split_points[0], load_test_key(510));
+    EXPECT_GE(by_load.split_points[0], load_test_key(45));
+    EXPECT_LE(by_load.split_points[0], load_test_key(55));
+
+    std::vector<int64_t> shard_loads = calculate_shard_loads(by_load, loads);
+    ASSERT_EQ(2u, shard_loads.size());
+    EXPECT_NEAR(shard_loads[0], shard_loads[1], 2 * 50);
+}
+
+TEST(AutoRebalancerTest, BalancePrimaries) {
+    const server_id_t a = generate_uuid(), b = generate_uuid(), c = generate_uuid();
+    table_config_t config;
+    for (int i = 0; i < 3; ++i) {
+        table_config_t::shard_t shard;
+        shard.replicas = { a, b, c };
+        shard.primary_replica = a;
+        config.shards.push_back(shard);
+    }
+
+    std::vector<int64_t> shard_loads = { 100, 100, 100 };
+    EXPECT_TRUE(balance_primaries(shard_loads, &config));
+    std::set<server_id_t> primaries;
+    for (const table_config_t::shard_t &shard : config.shards) {
+        primaries.insert(shard.primary_replica);
+    }
+    EXPECT_EQ(3u, primaries.size());
+
+    // Once the servers share the load evenly, there's nothing left to move.
+    EXPECT_FALSE(balance_primaries(shard_loads, &config));
+
+    // A shard that has no other replicas keeps its primary.
+    table_config_t lonely_config;
+    lonely_config.shards.resize(2);
+    lonely_config.shards[0].replicas = { a };
+    lonely_config.shards[0].primary_replica = a;
+    lonely_config.shards[1].replicas = { a, b };
+    lonely_config.shards[1].primary_replica = b;
+    EXPECT_FALSE(balance_primaries({ 1000, 1 }, &lonely_config));
+}
+
+}  // namespace unittest
@@ -0,0 +1,55 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <string>
+
+#include "rdb_protocol/batching.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/datum_string.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+// Returns how many copies of `row` go into a batch of `bs`, up to `limit`.
+int rows_per_batch(const ql::batchspec_t &bs, const ql::datum_t &row, int limit) {
+    ql::batcher_t batcher = bs.to_batcher();
+    for (int i = 1; i < limit; ++i) {
+        if (batcher.note_el(row)) {
+            return i;
+        }
+    }
+    return limit;
+}
+
+TEST(BatchTunerTest, NoHistory) {
+    ql::batch_tuner_t tuner;
+    ql::batchspec_t bs = ql::batchspec_t::default_for(ql::batch_type_t::NORMAL);
+    ql::datum_t row(datum_string_t(std::string(100 * KILOBYTE, 'a')));
+    EXPECT_EQ(rows_per_batch(bs, row, 1000),
+              rows_per_batch(tuner.tune(bs), row, 1000));
+}
+
+TEST(BatchTunerTest, HugeRows) {
+    ql::batch_tuner_t tuner;
+    tuner.note_batch(0, 0, 1000, 8, 8 * 4 * MEGABYTE);
+    ql::batchspec_t bs = ql::batchspec_t::default_for(ql::batch_type_t::NORMAL);
+    ql::datum_t row(datum_string_t(std::string(2 * MEGABYTE, 'a')));
+    // Without tuning the batch would get `min_els` of them, way over the size limit.
+    EXPECT_LT(1, rows_per_batch(bs, row, 100));
+    EXPECT_EQ(1, rows_per_batch(tuner.tune(bs), row, 100));
+}
+
+TEST(BatchTunerTest, SmallCheapRows) {
+    ql::batch_tuner_t tuner;
+    ql::batchspec_t bs = ql::batchspec_t::default_for(ql::batch_type_t::NORMAL);
+    ql::datum_t row(datum_string_t(std::string(20 * KILOBYTE, 'a')));
+    // Batches that filled up the size limit in a millisecond, and a client that took
+    // as long to ask for the next one.
+    tuner.note_batch(0, 0, 1000, 50, MEGABYTE);
+    EXPECT_EQ(rows_per_batch(bs, row, 1000),
+              rows_per_batch(tuner.tune(bs), row, 1000));
+    tuner.note_batch(2000, 2000, 3000, 50, MEGABYTE);
+    const int untuned = rows_per_batch(bs, row, 1000);
+    EXPECT_GT(100, untuned);
+    EXPECT_LT(2 * untuned, rows_per_batch(tuner.tune(bs), row, 1000));
+}
+
+}  // namespace unittest
@@ -0,0 +1,84 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <stdint.h>
+#include <string.h>
+
+#include <deque>
+#include <string>
+
+#include "containers/archive/string_stream.hpp"
+#include "containers/buffer_group.hpp"
+#include "protob/binary_shim.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+template <class T>
+T read_le(string_read_stream_t *s) {
+    T value;
+    EXPECT_EQ(static_cast<int64_t>(sizeof(value)), force_read(s, &value, sizeof(value)));
+    return value;
+}
+
+ql::datum_t read_datum(string_read_stream_t *s) {
+    ql::datum_t datum;
+    EXPECT_EQ(archive_result_t::SUCCESS, ql::datum_deserialize(s, &datum));
+    return datum;
+}
+
+TEST(BinaryShim, WriteResponsePieces) {
+    ql::datum_object_builder_t builder;
+    builder.overwrite("a", ql::datum_t(1.5));
+    builder.overwrite("bin", ql::datum_t::binary(datum_string_t(std::string("\0\1", 2))));
+    const ql::datum_t object = std::move(builder).to_datum();
+
+    Response response;
+    response.set_token(1);
+    response.set_type(Response::RUNTIME_ERROR);
+    object.write_to_protobuf(response.add_response(), ql::use_json_t::SERIALIZED);
+    Datum *d = response.add_response();
+    d->set_type(Datum::R_STR);
+    d->set_r_str("error");
+    Frame *f = response.mutable_backtrace()->add_frames();
+    f->set_type(Frame::POS);
+    f->set_pos(2);
+    f = response.mutable_backtrace()->add_frames();
+    f->set_type(Frame::OPT);
+    f->set_opt("index");
+
+    std::deque<std::string> storage;
+    const_buffer_group_t pieces;
+    binary_shim::write_binary_pb_pieces(response, &storage, &pieces);
+
+    // The datum that already is serialized is referenced, not copied.
+    std::string str;
+    bool found_datum = false;
+    for (size_t i = 0; i < pieces.num_buffers(); ++i) {
+        const_buffer_group_t::buffer_t b = pieces.get_buffer(i);
+        if (b.data == response.response(0).r_str().data()) {
+            found_datum = true;
+        }
+        str.append(static_cast<const char *>(b.data), b.size);
+    }
+    EXPECT_TRUE(found_datum);
+
+    string_read_stream_t s(std::move(str), 0);
+    EXPECT_EQ(static_cast<int32_t>(Response::RUNTIME_ERROR), read_le<int32_t>(&s));
+    ASSERT_EQ(2u, read_le<uint32_t>(&s));
+    EXPECT_EQ(object, read_datum(&s));
+    EXPECT_EQ(ql::datum_t("error"), read_datum(&s));
+
+    ASSERT_EQ(1, read_le<uint8_t>(&s));
+    ql::datum_t frames = read_datum(&s);
+    ASSERT_EQ(2u, frames.arr_size());
+    EXPECT_EQ(ql::datum_t(2.0), frames.get(0));
+    EXPECT_EQ(ql::datum_t("index"), frames.get(1));
+
+    EXPECT_EQ(0, read_le<uint8_t>(&s));
+    char extra;
+    EXPECT_EQ(0, force_read(&s, &extra, 1));
+}
+
+}  // namespace unittest
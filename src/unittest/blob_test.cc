@@ -81,8 +81,28 @@ public:
         }
     }
 
+    void check_stream(txn_t *txn) {
+        SCOPED_TRACE("check_stream");
+        blob_read_stream_t stream(buf_parent_t(txn), buf_.data(), buf_.size());
+
+        // An odd read size, so that reads span leaf blocks.
+        const int64_t chunk_size = 1000;
+        std::string actual;
+        std::vector<char> chunk(chunk_size);
+        for (;;) {
+            int64_t res = stream.read(chunk.data(), chunk_size);
+            ASSERT_LE(0, res);
+            if (res == 0) {
+                break;
+            }
+            actual.append(chunk.data(), res);
+        }
+        ASSERT_EQ(expected_, actual);
+    }
+
     void check(txn_t *txn) {
         check_region(txn, 0, expected_.size());
+        check_stream(txn);
         check_normalization(txn);
     }
 
@@ -0,0 +1,56 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include <string>
+
+#include "containers/bloom_filter.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+TEST(BloomFilterTest, NoFalseNegatives) {
+    bloom_filter_t filter(1000, 10);
+    for (int i = 0; i < 2000; i += 2) {
+        std::string s = strprintf("key%d", i);
+        filter.add(s.data(), s.size());
+    }
+    EXPECT_GE(1000u, filter.num_added());
+    EXPECT_LT(950u, filter.num_added());
+    // Adding the same strings again doesn't count.
+    const size_t num_added = filter.num_added();
+    for (int i = 0; i < 2000; i += 2) {
+        std::string s = strprintf("key%d", i);
+        filter.add(s.data(), s.size());
+    }
+    EXPECT_EQ(num_added, filter.num_added());
+    for (int i = 0; i < 2000; i += 2) {
+        std::string s = strprintf("key%d", i);
+        ASSERT_TRUE(filter.may_contain(s.data(), s.size()));
+    }
+}
+
+TEST(BloomFilterTest, FewFalsePositives) {
+    bloom_filter_t filter(1000, 10);
+    for (int i = 0; i < 1000; ++i) {
+        std::string s = strprintf("key%d", i);
+        filter.add(s.data(), s.size());
+    }
+    int false_positives = 0;
+    for (int i = 1000; i < 11000; ++i) {
+        std::string s = strprintf("key%d", i);
+        if (filter.may_contain(s.data(), s.size())) {
+            ++false_positives;
+        }
+    }
+    // About 1% is expected.
+    EXPECT_GT(500, false_positives);
+}
+
+TEST(BloomFilterTest, Empty) {
+    bloom_filter_t filter(0, 10);
+    EXPECT_FALSE(filter.may_contain("", 0));
+    filter.add("", 0);
+    EXPECT_TRUE(filter.may_contain("", 0));
+}
+
+}  // namespace unittest
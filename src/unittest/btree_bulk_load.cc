@@ -0,0 +1,477 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "arch/io/disk.hpp"
+#include "btree/bulk_load.hpp"
+#include "btree/depth_first_traversal.hpp"
+#include "btree/internal_node.hpp"
+#include "btree/operations.hpp"
+#include "btree/slice.hpp"
+#include "buffer_cache/cache_balancer.hpp"
+#include "containers/binary_blob.hpp"
+#include "rdb_protocol/btree.hpp"
+#include "unittest/unittest_utils.hpp"
+#include "serializer/config.hpp"
+
+namespace unittest {
+
+// Values are a length byte followed by that many bytes.
+class bulk_load_value_sizer_t : public value_sizer_t {
+public:
+    explicit bulk_load_value_sizer_t(max_block_size_t bs) : block_size_(bs) { }
+
+    int size(const void *value) const {
+        return 1 + *static_cast<const uint8_t *>(value);
+    }
+
+    bool fits(const void *value, int length_available) const {
+        return length_available > 0 && size(value) <= length_available;
+    }
+
+    int max_possible_size() const {
+        return 256;
+    }
+
+    block_magic_t btree_leaf_magic() const {
+        block_magic_t magic = { { 'b', 'l', 'L', 'F' } };
+        return magic;
+    }
+
+    max_block_size_t block_size() const { return block_size_; }
+
+private:
+    max_block_size_t block_size_;
+
+    DISABLE_COPYING(bulk_load_value_sizer_t);
+};
+
+// Like secondary index keys, these share a long prefix, so the separators in the
+// internal nodes stay long and the tree gets several levels.
+store_key_t bulk_load_key(int i) {
+    return store_key_t(std::string(200, 'k') + strprintf("%06d", i));
+}
+
+struct bulk_load_tree_info_t {
+    bulk_load_tree_info_t() : leaf_depth(-1), num_leaves(0) { }
+    int leaf_depth;
+    int num_leaves;
+    std::vector<store_key_t> keys;
+};
+
+void check_bulk_loaded_subtree(value_sizer_t *sizer, buf_parent_t parent,
+                               block_id_t block_id, int depth,
+                               const btree_key_t *left_exclusive_or_null,
+                               const btree_key_t *right_inclusive_or_null,
+                               bulk_load_tree_info_t *info) {
+    buf_lock_t lock(parent, block_id, access_t::read);
+    buf_read_t read(&lock);
+    const node_t *node = static_cast<const node_t *>(read.get_data_read());
+    if (node::is_leaf(node)) {
+        const leaf_node_t *leaf = reinterpret_cast<const leaf_node_t *>(node);
+        if (info->leaf_depth == -1) {
+            info->leaf_depth = depth;
+        }
+        EXPECT_EQ(info->leaf_depth, depth);
+        ++info->num_leaves;
+        for (auto it = leaf::begin(*leaf); it != leaf::end(*leaf); ++it) {
+            const btree_key_t *key = (*it).first;
+            if (left_exclusive_or_null != NULL) {
+                EXPECT_LT(0, btree_key_cmp(key, left_exclusive_or_null));
+            }
+            if (right_inclusive_or_null != NULL) {
+                EXPECT_GE(0, btree_key_cmp(key, right_inclusive_or_null));
+            }
+            info->keys.push_back(store_key_t(key));
+        }
+    } else {
+        const internal_node_t *internal
+            = reinterpret_cast<const internal_node_t *>(node);
+        ASSERT_LE(2, internal->npairs);
+        const btree_key_t *left = left_exclusive_or_null;
+        for (int i = 0; i < internal->npairs; ++i) {
+            const btree_internal_pair *pair
+                = internal_node::get_pair_by_index(internal, i);
+            const btree_key_t *right = i == internal->npairs - 1
+                ? right_inclusive_or_null
+                : &pair->key;
+            check_bulk_loaded_subtree(sizer, buf_parent_t(&lock), pair->lnode,
+                                      depth + 1, left, right, info);
+            left = &pair->key;
+        }
+    }
+}
+
+TPTEST(BtreeBulkLoad, AppendInOrder) {
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    dummy_cache_balancer_t balancer(GIGABYTE);
+    cache_t cache(&serializer, &balancer, &get_global_perfmon_collection());
+    cache_conn_t cache_conn(&cache);
+
+    {
+        txn_t txn(&cache_conn, write_durability_t::HARD,
+                  repli_timestamp_t::distant_past, 1);
+        buf_lock_t sb_lock(&txn, SUPERBLOCK_ID, alt_create_t::create);
+        btree_slice_t::init_superblock(&sb_lock,
+                                       std::vector<char>(), binary_blob_t());
+        real_superblock_t superblock(std::move(sb_lock));
+        create_stat_block(&superblock);
+    }
+
+    bulk_load_value_sizer_t sizer(cache.max_block_size());
+    btree_stats_t stats(NULL, "", index_type_t::SECONDARY);
+    btree_bulk_loader_t loader(&sizer, 0.9);
+
+    // Several transactions, like post construction uses.
+    const int num_keys = 20000;
+    const int keys_per_txn = 1000;
+    for (int i = 0; i < num_keys; i += keys_per_txn) {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        for (int j = i; j < i + keys_per_txn; ++j) {
+            const uint8_t value[2] = { 1, static_cast<uint8_t>(j) };
+            loader.append(superblock.get(), bulk_load_key(j).btree_key(), value,
+                          repli_timestamp_t::distant_past, &stats);
+        }
+        loader.release();
+    }
+
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    get_btree_superblock_and_txn_for_reading(&cache_conn, CACHE_SNAPSHOTTED_NO,
+                                             &superblock, &txn);
+
+    bulk_load_tree_info_t info;
+    check_bulk_loaded_subtree(&sizer, superblock->expose_buf(),
+                              superblock->get_root_block_id(), 0, NULL, NULL,
+                              &info);
+    ASSERT_EQ(static_cast<size_t>(num_keys), info.keys.size());
+    for (int i = 0; i < num_keys; ++i) {
+        ASSERT_EQ(bulk_load_key(i), info.keys[i]);
+    }
+    // The root, at least one level of internal nodes, and the leaves.
+    EXPECT_LE(2, info.leaf_depth);
+
+    // Leaves are filled to the fill factor, rather than half full.
+    const int entry_size = sizeof(uint16_t) + sizeof(repli_timestamp_t)
+        + bulk_load_key(0).btree_key()->full_size() + 2;
+    EXPECT_LT(info.num_leaves * sizer.block_size().value() * 3 / 4,
+              num_keys * entry_size);
+
+    {
+        buf_lock_t stat_block(buf_parent_t(txn.get()),
+                              superblock->get_stat_block_id(), access_t::read);
+        buf_read_t read(&stat_block);
+        EXPECT_EQ(num_keys, static_cast<const btree_statblock_t *>(
+                      read.get_data_read())->population);
+    }
+}
+
+TPTEST(BtreeBulkLoad, AppendAfterExistingKeys) {
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    dummy_cache_balancer_t balancer(GIGABYTE);
+    cache_t cache(&serializer, &balancer, &get_global_perfmon_collection());
+    cache_conn_t cache_conn(&cache);
+
+    {
+        txn_t txn(&cache_conn, write_durability_t::HARD,
+                  repli_timestamp_t::distant_past, 1);
+        buf_lock_t sb_lock(&txn, SUPERBLOCK_ID, alt_create_t::create);
+        btree_slice_t::init_superblock(&sb_lock,
+                                       std::vector<char>(), binary_blob_t());
+        real_superblock_t superblock(std::move(sb_lock));
+        create_stat_block(&superblock);
+    }
+
+    bulk_load_value_sizer_t sizer(cache.max_block_size());
+    btree_stats_t stats(NULL, "", index_type_t::SECONDARY);
+
+    // Each batch gets a loader of its own, like backfill chunks do.
+    const int num_keys = 12000;
+    const int keys_per_batch = 3000;
+    for (int i = 0; i < num_keys; i += keys_per_batch) {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                     repli_timestamp_t::distant_past,
+                                     write_durability_t::SOFT,
+                                     &superblock, &txn);
+        btree_bulk_loader_t loader(&sizer, 0.9);
+        if (i > 0) {
+            // Keys that aren't after the existing ones can't be appended.
+            ASSERT_FALSE(loader.start_after_existing_keys(
+                superblock.get(), bulk_load_key(i - 1).btree_key()));
+            ASSERT_FALSE(loader.start_after_existing_keys(
+                superblock.get(), bulk_load_key(i / 2).btree_key()));
+        }
+        ASSERT_TRUE(loader.start_after_existing_keys(
+            superblock.get(), bulk_load_key(i).btree_key()));
+        for (int j = i; j < i + keys_per_batch; ++j) {
+            const uint8_t value[2] = { 1, static_cast<uint8_t>(j) };
+            loader.append(superblock.get(), bulk_load_key(j).btree_key(), value,
+                          repli_timestamp_t::distant_past, &stats);
+        }
+        loader.release();
+    }
+
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    get_btree_superblock_and_txn_for_reading(&cache_conn, CACHE_SNAPSHOTTED_NO,
+                                             &superblock, &txn);
+
+    bulk_load_tree_info_t info;
+    check_bulk_loaded_subtree(&sizer, superblock->expose_buf(),
+                              superblock->get_root_block_id(), 0, NULL, NULL,
+                              &info);
+    ASSERT_EQ(static_cast<size_t>(num_keys), info.keys.size());
+    for (int i = 0; i < num_keys; ++i) {
+        ASSERT_EQ(bulk_load_key(i), info.keys[i]);
+    }
+
+    {
+        buf_lock_t stat_block(buf_parent_t(txn.get()),
+                              superblock->get_stat_block_id(), access_t::read);
+        buf_read_t read(&stat_block);
+        EXPECT_EQ(num_keys, static_cast<const btree_statblock_t *>(
+                      read.get_data_read())->population);
+    }
+}
+
+class collect_keys_callback_t : public depth_first_traversal_callback_t {
+public:
+    done_traversing_t handle_pair(scoped_key_value_t &&keyvalue) {
+        keys.push_back(store_key_t(keyvalue.key()));
+        return done_traversing_t::NO;
+    }
+    std::vector<store_key_t> keys;
+};
+
+TPTEST(BtreeBulkLoad, ParallelTraversal) {
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    dummy_cache_balancer_t balancer(GIGABYTE);
+    cache_t cache(&serializer, &balancer, &get_global_perfmon_collection());
+    cache_conn_t cache_conn(&cache);
+
+    const int num_keys = 5000;
+    {
+        txn_t txn(&cache_conn, write_durability_t::HARD,
+                  repli_timestamp_t::distant_past, 1);
+        buf_lock_t sb_lock(&txn, SUPERBLOCK_ID, alt_create_t::create);
+        btree_slice_t::init_superblock(&sb_lock,
+                                       std::vector<char>(), binary_blob_t());
+        real_superblock_t superblock(std::move(sb_lock));
+        create_stat_block(&superblock);
+
+        bulk_load_value_sizer_t sizer(cache.max_block_size());
+        btree_stats_t stats(NULL, "", index_type_t::SECONDARY);
+        btree_bulk_loader_t loader(&sizer, 0.9);
+        for (int i = 0; i < num_keys; ++i) {
+            const uint8_t value[2] = { 1, static_cast<uint8_t>(i) };
+            loader.append(&superblock, bulk_load_key(i).btree_key(), value,
+                          repli_timestamp_t::distant_past, &stats);
+        }
+        loader.release();
+    }
+
+    // The parts have to cover the range between them, in order and without
+    // overlapping.
+    const key_range_t range(key_range_t::closed, bulk_load_key(123),
+                            key_range_t::open, bulk_load_key(4321));
+    std::vector<collect_keys_callback_t> callbacks(4);
+    std::vector<depth_first_traversal_callback_t *> callback_ptrs;
+    for (auto it = callbacks.begin(); it != callbacks.end(); ++it) {
+        callback_ptrs.push_back(&*it);
+    }
+    {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn_for_reading(&cache_conn, CACHE_SNAPSHOTTED_NO,
+                                                 &superblock, &txn);
+        ASSERT_TRUE(btree_parallel_depth_first_traversal(
+            superblock.get(), range, callback_ptrs, release_superblock_t::RELEASE));
+    }
+
+    std::vector<store_key_t> keys;
+    int non_empty_parts = 0;
+    for (auto it = callbacks.begin(); it != callbacks.end(); ++it) {
+        if (!it->keys.empty()) {
+            ++non_empty_parts;
+        }
+        keys.insert(keys.end(), it->keys.begin(), it->keys.end());
+    }
+    EXPECT_LT(1, non_empty_parts);
+    ASSERT_EQ(static_cast<size_t>(4321 - 123), keys.size());
+    for (int i = 123; i < 4321; ++i) {
+        ASSERT_EQ(bulk_load_key(i), keys[i - 123]);
+    }
+}
+
+// Sets or (if `value` is null) deletes `keys` in order, going down the tree only
+// when the location can't be moved along from the previous key.  Returns how many
+// times it had to go down the tree.
+int write_in_order(value_sizer_t *sizer, superblock_t *superblock,
+                   const std::vector<store_key_t> &keys, const uint8_t *value,
+                   btree_stats_t *stats) {
+    noop_value_deleter_t detacher;
+    null_key_modification_callback_t null_cb;
+    int descents = 0;
+    size_t i = 0;
+    while (i < keys.size()) {
+        // The superblock comes back to us for the next descent.
+        promise_t<superblock_t *> pass_back_superblock;
+        {
+            keyvalue_location_t kv_location;
+            find_keyvalue_location_for_write(sizer, superblock, keys[i].btree_key(),
+                                             &detacher, &kv_location, stats, NULL,
+                                             &pass_back_superblock);
+            ++descents;
+            do {
+                if (value != NULL) {
+                    scoped_malloc_t<void> tmp(sizer->max_possible_size());
+                    memcpy(tmp.get(), value, sizer->size(value));
+                    kv_location.value = std::move(tmp);
+                } else {
+                    kv_location.value.reset();
+                }
+                apply_keyvalue_change(sizer, &kv_location, keys[i].btree_key(),
+                                      repli_timestamp_t::distant_past, &detacher,
+                                      &null_cb);
+                ++i;
+            } while (i < keys.size()
+                     && move_keyvalue_location_for_write(sizer, keys[i].btree_key(),
+                                                         &kv_location));
+        }
+        superblock = pass_back_superblock.wait();
+    }
+    return descents;
+}
+
+TPTEST(BtreeBulkLoad, MoveKeyvalueLocation) {
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    dummy_cache_balancer_t balancer(GIGABYTE);
+    cache_t cache(&serializer, &balancer, &get_global_perfmon_collection());
+    cache_conn_t cache_conn(&cache);
+
+    {
+        txn_t txn(&cache_conn, write_durability_t::HARD,
+                  repli_timestamp_t::distant_past, 1);
+        buf_lock_t sb_lock(&txn, SUPERBLOCK_ID, alt_create_t::create);
+        btree_slice_t::init_superblock(&sb_lock,
+                                       std::vector<char>(), binary_blob_t());
+        real_superblock_t superblock(std::move(sb_lock));
+        create_stat_block(&superblock);
+    }
+
+    bulk_load_value_sizer_t sizer(cache.max_block_size());
+    btree_stats_t stats(NULL, "", index_type_t::SECONDARY);
+
+    // Writes the keys for which `include(i)` is true, in batches like the ones a
+    // batched replace gets.
+    const int num_keys = 6000;
+    const int keys_per_batch = 500;
+    auto write_batches = [&](bool (*include)(int), const uint8_t *value) -> int {
+        int descents = 0;
+        for (int i = 0; i < num_keys; i += keys_per_batch) {
+            std::vector<store_key_t> keys;
+            for (int j = i; j < i + keys_per_batch; ++j) {
+                if (include(j)) {
+                    keys.push_back(bulk_load_key(j));
+                }
+            }
+            scoped_ptr_t<txn_t> txn;
+            scoped_ptr_t<real_superblock_t> superblock;
+            get_btree_superblock_and_txn(&cache_conn, write_access_t::write, 1,
+                                         repli_timestamp_t::distant_past,
+                                         write_durability_t::SOFT,
+                                         &superblock, &txn);
+            descents += write_in_order(&sizer, superblock.get(), keys, value, &stats);
+        }
+        return descents;
+    };
+
+    // Filling the tree from empty makes it split its root and its internal nodes,
+    // and then deleting most keys makes it merge them again.
+    const uint8_t value[2] = { 1, 42 };
+    const int insert_descents = write_batches([](int) { return true; }, value);
+    EXPECT_GT(num_keys / 10, insert_descents);
+    write_batches([](int i) { return i % 10 != 0; }, NULL);
+
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    get_btree_superblock_and_txn_for_reading(&cache_conn, CACHE_SNAPSHOTTED_NO,
+                                             &superblock, &txn);
+
+    bulk_load_tree_info_t info;
+    check_bulk_loaded_subtree(&sizer, superblock->expose_buf(),
+                              superblock->get_root_block_id(), 0, NULL, NULL,
+                              &info);
+    ASSERT_EQ(static_cast<size_t>(num_keys / 10), info.keys.size());
+    for (int i = 0; i < num_keys / 10; ++i) {
+        ASSERT_EQ(bulk_load_key(i * 10), info.keys[i]);
+    }
+
+    {
+        buf_lock_t stat_block(buf_parent_t(txn.get()),
+                              superblock->get_stat_block_id(), access_t::read);
+        buf_read_t read(&stat_block);
+        EXPECT_EQ(num_keys / 10, static_cast<const btree_statblock_t *>(
+                      read.get_data_read())->population);
+    }
+}
+
+}  // namespace unittest
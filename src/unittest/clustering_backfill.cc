@@ -20,7 +20,7 @@ boost::optional<boost::optional<backfiller_business_card_t> > wrap_in_optional(
 
 }   /* anonymous namespace */
 
-TPTEST(ClusteringBackfill, BackfillTest) {
+void run_backfill_test(int max_streams) {
     order_source_t order_source;
 
     /* Set up two stores */
@@ -115,6 +115,7 @@ TPTEST(ClusteringBackfill, BackfillTest) {
         &backfillee_store,
         backfillee_store.get_region(),
         pseudo_directory.get_watchable()->subview(&wrap_in_optional),
+        max_streams,
         &interruptor,
         nullptr);
 
@@ -155,4 +156,12 @@ TPTEST(ClusteringBackfill, BackfillTest) {
     //EXPECT_EQ(timestamp, backfillee_metadata[0].second.earliest.timestamp);
 }
 
+TPTEST(ClusteringBackfill, BackfillTest) {
+    run_backfill_test(1);
+}
+
+TPTEST(ClusteringBackfill, MultiStreamBackfillTest) {
+    run_backfill_test(4);
+}
+
 }   /* namespace unittest */
@@ -3,6 +3,7 @@
 
 #include <stdexcept>
 
+#include "config/args.hpp"
 #include "containers/scoped.hpp"
 #include "unittest/gtest.hpp"
 
@@ -89,6 +90,51 @@ TEST(ContextSwitchingTest, SwitchBetweenContexts) {
     original_context = NULL;
 }
 
+static __thread coro_stack_t *deep_stack = NULL;
+
+// Uses about `depth` pages of stack and returns a checksum that depends on all of it.
+static int fill_stack(int depth) {
+    volatile char page[4096];
+    for (size_t i = 0; i < sizeof(page); ++i) {
+        page[i] = static_cast<char>(depth + i);
+    }
+    int sum = depth > 0 ? fill_stack(depth - 1) : 0;
+    for (size_t i = 0; i < sizeof(page); i += 512) {
+        sum += page[i];
+    }
+    return sum;
+}
+
+static void release_unused_pages_test(void) {
+    while (true) {
+        test_int = fill_stack(64);
+        deep_stack->release_unused_pages(16 * KILOBYTE);
+        context_switch(artificial_stack_1_context, original_context);
+    }
+}
+
+TEST(ContextSwitchingTest, ReleaseUnusedPages) {
+    scoped_ptr_t<coro_context_ref_t> orig_context_local(new coro_context_ref_t);
+    original_context = orig_context_local.get();
+    {
+        coro_stack_t a(&release_unused_pages_test, 1024*1024);
+        deep_stack = &a;
+        artificial_stack_1_context = &a.context;
+
+        // The released pages must come back zeroed but usable, and the second run
+        // must compute the same thing as the first.
+        test_int = 0;
+        context_switch(original_context, artificial_stack_1_context);
+        const int first_result = test_int;
+        test_int = 0;
+        context_switch(original_context, artificial_stack_1_context);
+        EXPECT_EQ(first_result, test_int);
+        EXPECT_EQ(fill_stack(64), test_int);
+    }
+    deep_stack = NULL;
+    original_context = NULL;
+}
+
 __attribute__((noreturn)) static void throw_an_exception() {
     throw std::runtime_error("This is a test exception");
 }
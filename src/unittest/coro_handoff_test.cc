@@ -0,0 +1,77 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <vector>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/cond_var.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// Two coroutines take turns through `cond_t`s, which wake each other up with
+// `notify_sometime()` and so go through the direct handoff path.
+TPTEST(CoroHandoff, PingPong) {
+    const int rounds = 1000;
+    std::vector<int> order;
+    scoped_ptr_t<cond_t> ping(new cond_t), pong(new cond_t);
+    cond_t done;
+
+    coro_t::spawn_sometime([&]() {
+        for (int i = 0; i < rounds; ++i) {
+            ping->wait();
+            ping.init(new cond_t);
+            order.push_back(2 * i + 1);
+            pong->pulse();
+        }
+        done.pulse();
+    });
+
+    for (int i = 0; i < rounds; ++i) {
+        order.push_back(2 * i);
+        ping->pulse();
+        pong->wait();
+        pong.init(new cond_t);
+    }
+    done.wait();
+
+    ASSERT_EQ(2u * rounds, order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        ASSERT_EQ(static_cast<int>(i), order[i]);
+    }
+}
+
+// A coroutine that keeps handing off to others must still let the message hub run
+// other messages, such as this timer's.
+TPTEST(CoroHandoff, DoesNotStarveMessageHub) {
+    bool stop = false;
+    int handoffs = 0;
+    scoped_ptr_t<cond_t> ping(new cond_t), pong(new cond_t);
+    cond_t done;
+
+    coro_t::spawn_sometime([&]() {
+        while (!stop) {
+            ping->wait();
+            ping.init(new cond_t);
+            pong->pulse();
+        }
+        done.pulse();
+    });
+
+    coro_t::spawn_sometime([&]() {
+        nap(10);
+        stop = true;
+    });
+
+    while (!stop) {
+        ++handoffs;
+        ping->pulse();
+        pong->wait();
+        pong.init(new cond_t);
+    }
+    ping->pulse();
+    done.wait();
+    EXPECT_LT(0, handoffs);
+}
+
+}  // namespace unittest
@@ -0,0 +1,60 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/runtime/coro_latency.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "config/args.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+TEST(CoroLatency, HistogramBuckets) {
+    coro_latency_histogram_t histogram;
+    histogram.add(0);
+    histogram.add(999);
+    histogram.add(1 * THOUSAND);
+    histogram.add(3 * THOUSAND);
+    histogram.add(4 * THOUSAND);
+    histogram.add(1000 * BILLION);
+    EXPECT_EQ(2u, histogram.buckets[0]);
+    EXPECT_EQ(1u, histogram.buckets[1]);
+    EXPECT_EQ(1u, histogram.buckets[2]);
+    EXPECT_EQ(1u, histogram.buckets[3]);
+    EXPECT_EQ(1u, histogram.buckets[CORO_LATENCY_HISTOGRAM_BUCKETS - 1]);
+
+    coro_latency_histogram_t other;
+    other.add(0);
+    histogram.merge(other);
+    EXPECT_EQ(3u, histogram.buckets[0]);
+}
+
+TEST(CoroLatency, DescribeSpawnSite) {
+    EXPECT_EQ("std::_Bind<void (*(int))(int)>",
+              describe_coro_spawn_site(
+                  "static coro_t* coro_t::get_and_init_coro(Callable&&) "
+                  "[with Callable = std::_Bind<void (*(int))(int)>]"));
+    EXPECT_EQ("something else", describe_coro_spawn_site("something else"));
+}
+
+TPTEST(CoroLatency, RunTimeAccount) {
+    std::atomic<ticks_t> account(0);
+    ticks_t busy_ticks;
+    {
+        scoped_coro_run_time_account_t run_time_account(&account);
+        const ticks_t start = get_ticks();
+        while (get_ticks() - start < 20 * MILLION) { }
+        busy_ticks = get_ticks() - start;
+
+        // Time spent waiting isn't charged.
+        nap(200);
+    }
+    EXPECT_GE(account.load(), busy_ticks);
+    EXPECT_LT(account.load(), 190 * MILLION);
+
+    // Nor is anything after the account goes away.
+    const ticks_t charged = account.load();
+    coro_t::yield();
+    EXPECT_EQ(charged, account.load());
+}
+
+}  // namespace unittest
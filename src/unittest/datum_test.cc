@@ -4,6 +4,8 @@
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/datum_string.hpp"
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
 #include "unittest/gtest.hpp"
 
 
@@ -205,4 +207,189 @@ TEST(DatumTest, OffsetScaling) {
     }
 }
 
+TEST(DatumTest, GetFieldFromBuffer) {
+    // Long enough values that the offset table needs 16 bit offsets.
+    std::map<datum_string_t, ql::datum_t> fields;
+    for (int i = 0; i < 100; ++i) {
+        fields.insert(std::make_pair(datum_string_t(strprintf("k%d", i)),
+                                     ql::datum_t(datum_string_t(std::string(i, 'v')))));
+    }
+    ql::datum_t test_object(std::move(fields));
+
+    string_stream_t write_stream;
+    write_message_t wm;
+    serialize<cluster_version_t::LATEST_OVERALL>(&wm, test_object);
+    ASSERT_EQ(0, send_write_message(&write_stream, &wm));
+    string_read_stream_t read_stream(std::move(write_stream.str()), 0);
+    ql::datum_t deserialized_object;
+    ASSERT_EQ(archive_result_t::SUCCESS,
+              deserialize<cluster_version_t::LATEST_OVERALL>(&read_stream,
+                                                             &deserialized_object));
+
+    for (int i = 0; i < 100; ++i) {
+        ql::datum_t val = deserialized_object.get_field(strprintf("k%d", i).c_str(),
+                                                        ql::NOTHROW);
+        ASSERT_TRUE(val.has());
+        ASSERT_EQ(std::string(i, 'v'), val.as_str().to_std());
+    }
+    ASSERT_FALSE(deserialized_object.get_field("", ql::NOTHROW).has());
+    ASSERT_FALSE(deserialized_object.get_field("k", ql::NOTHROW).has());
+    ASSERT_FALSE(deserialized_object.get_field("k100", ql::NOTHROW).has());
+    ASSERT_FALSE(deserialized_object.get_field("k9a", ql::NOTHROW).has());
+    ASSERT_FALSE(deserialized_object.get_field("z", ql::NOTHROW).has());
+
+    ql::datum_t empty_object((std::map<datum_string_t, ql::datum_t>()));
+    test_datum_serialization(empty_object);
+    ASSERT_FALSE(empty_object.get_field("k", ql::NOTHROW).has());
+}
+
+// Serializes `datum` with `datum_serialize`, checking for errors if `check_errors`
+// is set, and deserializes it again.
+ql::serialization_result_t checked_round_trip(
+        const ql::datum_t &datum,
+        ql::check_datum_serialization_errors_t check_errors,
+        ql::datum_t *out) {
+    write_message_t wm;
+    ql::serialization_result_t res = datum_serialize(&wm, datum, check_errors);
+    string_stream_t write_stream;
+    EXPECT_EQ(0, send_write_message(&write_stream, &wm));
+    string_read_stream_t read_stream(std::move(write_stream.str()), 0);
+    EXPECT_EQ(archive_result_t::SUCCESS, datum_deserialize(&read_stream, out));
+    return res;
+}
+
+TEST(DatumTest, CheckedSerializationFromBuffer) {
+    const ql::configured_limits_t &unlimited = ql::configured_limits_t::unlimited;
+    for (size_t array_size : {size_t(10), size_t(100001)}) {
+        ql::datum_object_builder_t inner;
+        ASSERT_FALSE(inner.add("big", ql::datum_t(
+            std::vector<ql::datum_t>(array_size, ql::datum_t::null()), unlimited)));
+        ql::datum_object_builder_t outer;
+        ASSERT_FALSE(outer.add("inner", std::move(inner).to_datum()));
+        ASSERT_FALSE(outer.add("name", ql::datum_t("x")));
+        ql::datum_t original = std::move(outer).to_datum();
+        const ql::serialization_result_t expected = array_size > 100000
+            ? ql::serialization_result_t::ARRAY_TOO_BIG
+            : ql::serialization_result_t::SUCCESS;
+
+        ql::datum_t from_buffer;
+        checked_round_trip(original, ql::check_datum_serialization_errors_t::NO,
+                           &from_buffer);
+        ASSERT_TRUE(from_buffer.get_buf_ref() != NULL);
+
+        // Copying the buffer still finds the nested array.
+        ql::datum_t copied;
+        ASSERT_EQ(expected,
+                  checked_round_trip(from_buffer,
+                                     ql::check_datum_serialization_errors_t::YES,
+                                     &copied));
+        ASSERT_EQ(original, copied);
+
+        // And so does serializing an update of another field, which copies the
+        // serialization of the unchanged `inner`.
+        ql::datum_object_builder_t patch;
+        ASSERT_FALSE(patch.add("name", ql::datum_t("y")));
+        ql::datum_t updated = from_buffer.merge(std::move(patch).to_datum());
+        ql::datum_t updated_copy;
+        ASSERT_EQ(expected,
+                  checked_round_trip(updated,
+                                     ql::check_datum_serialization_errors_t::YES,
+                                     &updated_copy));
+        ASSERT_EQ(updated, updated_copy);
+        ASSERT_EQ("y", updated_copy.get_field("name").as_str().to_std());
+    }
+}
+
+TEST(DatumTest, BinaryJsonRoundTrip) {
+    for (size_t size = 0; size < 120; ++size) {
+        std::string data;
+        for (size_t i = 0; i < size; ++i) {
+            data.push_back(static_cast<char>(i * 37));
+        }
+        ql::datum_t binary = ql::datum_t::binary(datum_string_t(data));
+        scoped_cJSON_t json = binary.as_json();
+        ql::datum_t parsed = ql::to_datum(json.get(),
+                                          ql::configured_limits_t::unlimited,
+                                          reql_version_t::LATEST);
+        ASSERT_EQ(ql::datum_t::R_BINARY, parsed.get_type());
+        EXPECT_EQ(data, parsed.as_binary().to_std());
+    }
+}
+
+void test_write_json(const ql::datum_t &datum) {
+    std::string json;
+    datum.write_json(&json);
+    EXPECT_EQ(datum.as_json().PrintUnformatted(), json);
+}
+
+TEST(DatumTest, WriteJson) {
+    double nums[] = { 0.0, -0.0, 1.0, -17.0, 0.1, 1.5e300, -2.5e-300,
+                      123456789012345.0, 1e15, 1e20, 4503599627370497.0 };
+    for (size_t i = 0; i < sizeof(nums) / sizeof(nums[0]); ++i) {
+        test_write_json(ql::datum_t(nums[i]));
+    }
+    test_write_json(ql::datum_t::null());
+    test_write_json(ql::datum_t::boolean(true));
+    test_write_json(ql::datum_t::boolean(false));
+    test_write_json(ql::datum_t("plain"));
+    test_write_json(ql::datum_t("quote \" backslash \\ newline \n tab \t \x01 \x1f caf\xc3\xa9"));
+    test_write_json(ql::datum_t::binary(datum_string_t(std::string("\x00\xff\x10", 3))));
+    // Long enough for line breaks in the base64.
+    test_write_json(ql::datum_t::binary(datum_string_t(std::string(200, '\x7f'))));
+
+    ql::datum_object_builder_t inner;
+    ASSERT_FALSE(inner.add("k\"ey", ql::datum_t(2.5)));
+    ASSERT_FALSE(inner.add("empty", ql::datum_t(std::vector<ql::datum_t>(),
+                                                ql::configured_limits_t::unlimited)));
+    ql::datum_t array(
+        std::vector<ql::datum_t>{ql::datum_t("a"), std::move(inner).to_datum(),
+                                 ql::datum_t::null()},
+        ql::configured_limits_t::unlimited);
+    test_write_json(array);
+}
+
+TEST(DatumTest, InternFieldName) {
+    const datum_string_t a = intern_field_name("name");
+    const datum_string_t b = intern_field_name("name");
+    // Both share the same buffer.
+    ASSERT_EQ(a.data(), b.data());
+    ASSERT_EQ(a, b);
+    ASSERT_EQ(a, datum_string_t("name"));
+    ASSERT_NE(a, intern_field_name("other"));
+
+    const std::string long_name(100, 'x');
+    ASSERT_EQ(datum_string_t(long_name), intern_field_name(long_name));
+}
+
+TEST(DatumTest, TimeSerialization) {
+    const ql::datum_t time = ql::pseudo::make_time(1428000000.123, "-07:00");
+    test_datum_serialization(time);
+    {
+        write_message_t wm;
+        serialize<cluster_version_t::LATEST_OVERALL>(&wm, time);
+        string_stream_t write_stream;
+        ASSERT_EQ(0, send_write_message(&write_stream, &wm));
+        // The tag, the epoch time and the timezone, instead of a three-field object.
+        ASSERT_GE(20u, write_stream.str().size());
+    }
+
+    // Times nested in objects and arrays, which are read from a shared buffer.
+    ql::datum_t array(
+        std::vector<ql::datum_t>{time, ql::pseudo::make_time(0, "+00:00")},
+        ql::configured_limits_t::unlimited);
+    test_datum_serialization(array);
+    ql::datum_object_builder_t builder;
+    builder.overwrite("t", time);
+    builder.overwrite("arr", array);
+    test_datum_serialization(std::move(builder).to_datum());
+
+    // Objects that merely look like times are still serialized as objects.
+    ql::datum_object_builder_t extra;
+    extra.overwrite(ql::datum_t::reql_type_string, ql::datum_t("TIME"));
+    extra.overwrite(ql::pseudo::epoch_time_key, ql::datum_t(1.0));
+    extra.overwrite(ql::pseudo::timezone_key, ql::datum_t("+00:00"));
+    extra.overwrite("other", ql::datum_t::null());
+    test_datum_serialization(std::move(extra).to_datum());
+}
+
 }  // namespace unittest
@@ -1,4 +1,5 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <algorithm>
 #include <queue>
 
 #include "arch/io/disk.hpp"
@@ -74,6 +75,60 @@ TEST(DiskBackedQueue, BigVals) {
     unittest::run_in_thread_pool(&run_big_values_test, 2);
 }
 
+void run_push_vector_test() {
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    const serializer_filepath_t serializer_path = dbq_serializer_path();
+
+    disk_backed_queue_t<int> queue(&io_backender, serializer_path, &get_global_perfmon_collection());
+    std::vector<int> values;
+    for (int i = 0; i < 1000; ++i) {
+        values.push_back(i);
+    }
+    queue.push(values);
+    queue.push(std::vector<int>());
+    EXPECT_EQ(1000, queue.size());
+
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_FALSE(queue.empty());
+        int x;
+        queue.pop(&x);
+        EXPECT_EQ(i, x);
+    }
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(DiskBackedQueue, PushVector) {
+    unittest::run_in_thread_pool(&run_push_vector_test, 2);
+}
+
+void run_pop_vector_test() {
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    const serializer_filepath_t serializer_path = dbq_serializer_path();
+
+    disk_backed_queue_t<int> queue(&io_backender, serializer_path, &get_global_perfmon_collection());
+    // Enough values to span several queue blocks.
+    for (int i = 0; i < 1000; ++i) {
+        queue.push(i);
+    }
+
+    std::vector<int> values;
+    while (!queue.empty()) {
+        const size_t before = values.size();
+        queue.pop(&values, 300);
+        EXPECT_EQ(std::min<size_t>(300, 1000 - before), values.size() - before);
+    }
+    ASSERT_EQ(1000u, values.size());
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(i, values[i]);
+    }
+}
+
+TEST(DiskBackedQueue, PopVector) {
+    unittest::run_in_thread_pool(&run_pop_vector_test, 2);
+}
+
 static void randomly_delay(int, signal_t *) {
     nap(randint(100));
 }
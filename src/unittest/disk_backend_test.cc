@@ -0,0 +1,126 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include "arch/io/disk.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/cond_var.hpp"
+#include "containers/scoped.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+struct disk_backend_test_callback_t : public iocallback_t, public cond_t {
+    void on_io_complete() {
+        pulse();
+    }
+};
+
+void run_write_then_read(io_backend_mode_t io_backend) {
+    const int64_t chunk_size = 16 * DEVICE_BLOCK_SIZE;
+    const int num_chunks = 64;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired,
+                                DEFAULT_MAX_CONCURRENT_IO_REQUESTS, io_backend);
+    temp_file_t temp_file;
+
+    scoped_ptr_t<file_t> file;
+    file_open_result_t res = open_file(temp_file.name().permanent_path().c_str(),
+                                       linux_file_t::mode_read
+                                       | linux_file_t::mode_write
+                                       | linux_file_t::mode_create,
+                                       &io_backender, &file);
+    ASSERT_NE(file_open_result_t::ERROR, res.outcome);
+    file->set_file_size_at_least(chunk_size * num_chunks);
+    file_account_t account(file.get(), 1);
+
+    scoped_malloc_t<char> out_buf(malloc_aligned(chunk_size * num_chunks,
+                                                 DEVICE_BLOCK_SIZE));
+    for (int i = 0; i < num_chunks; ++i) {
+        memset(out_buf.get() + i * chunk_size, 'a' + (i % 26), chunk_size);
+    }
+
+    // Submit all writes at once so the backend gets to batch them. The writes are
+    // adjacent, so they also get merged by the coalescing layer.
+    {
+        disk_backend_test_callback_t callbacks[num_chunks];
+        for (int i = 0; i < num_chunks; ++i) {
+            file->write_async(i * chunk_size, chunk_size, out_buf.get() + i * chunk_size,
+                              &account, &callbacks[i], file_t::NO_DATASYNCS);
+        }
+        for (int i = 0; i < num_chunks; ++i) {
+            callbacks[i].wait();
+        }
+    }
+
+    scoped_malloc_t<char> in_buf(malloc_aligned(chunk_size * num_chunks,
+                                                DEVICE_BLOCK_SIZE));
+    {
+        disk_backend_test_callback_t callbacks[num_chunks];
+        for (int i = 0; i < num_chunks; ++i) {
+            file->read_async(i * chunk_size, chunk_size, in_buf.get() + i * chunk_size,
+                             &account, &callbacks[i]);
+        }
+        for (int i = 0; i < num_chunks; ++i) {
+            callbacks[i].wait();
+        }
+    }
+
+    ASSERT_EQ(0, memcmp(out_buf.get(), in_buf.get(), chunk_size * num_chunks));
+}
+
+TPTEST(DiskBackend, PoolWriteThenRead) {
+    run_write_then_read(io_backend_mode_t::pool);
+}
+
+TPTEST(DiskBackend, IoUringWriteThenRead) {
+    // Falls back to kernel AIO or the pool if io_uring isn't available.
+    run_write_then_read(io_backend_mode_t::io_uring);
+}
+
+TPTEST(DiskBackend, AioWriteThenRead) {
+    run_write_then_read(io_backend_mode_t::aio);
+}
+
+// Files on the same file system that datasync at the same time share barriers, but
+// every datasync must still complete.
+TPTEST(DiskBackend, ConcurrentDatasyncs) {
+    const int num_files = 8;
+    const int rounds = 4;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    temp_file_t temp_files[num_files];
+    scoped_ptr_t<file_t> files[num_files];
+    for (int i = 0; i < num_files; ++i) {
+        file_open_result_t res = open_file(temp_files[i].name().permanent_path().c_str(),
+                                           linux_file_t::mode_read
+                                           | linux_file_t::mode_write
+                                           | linux_file_t::mode_create,
+                                           &io_backender, &files[i]);
+        ASSERT_NE(file_open_result_t::ERROR, res.outcome);
+        files[i]->set_file_size_at_least(DEVICE_BLOCK_SIZE);
+    }
+
+    scoped_malloc_t<char> buf(malloc_aligned(DEVICE_BLOCK_SIZE, DEVICE_BLOCK_SIZE));
+    memset(buf.get(), 'x', DEVICE_BLOCK_SIZE);
+    for (int round = 0; round < rounds; ++round) {
+        disk_backend_test_callback_t write_callbacks[num_files];
+        for (int i = 0; i < num_files; ++i) {
+            files[i]->write_async(0, DEVICE_BLOCK_SIZE, buf.get(), DEFAULT_DISK_ACCOUNT,
+                                  &write_callbacks[i], file_t::NO_DATASYNCS);
+        }
+        for (int i = 0; i < num_files; ++i) {
+            write_callbacks[i].wait();
+        }
+
+        disk_backend_test_callback_t sync_callbacks[num_files];
+        for (int i = 0; i < num_files; ++i) {
+            files[i]->datasync_async(&sync_callbacks[i]);
+        }
+        for (int i = 0; i < num_files; ++i) {
+            sync_callbacks[i].wait();
+        }
+    }
+}
+
+}  // namespace unittest
@@ -108,6 +108,8 @@ struct test_driver_t {
             a->get_bufs(&a_vecs, &a_size);
             iovec dest_vecs[1] = { { data.data() + a->get_offset(), a->get_count() } };
             fill_bufs_from_source(dest_vecs, 1, a_vecs, a_size, 0);
+        } else if (a->get_is_discard()) {
+            memset(data.data() + a->get_offset(), 0, a->get_count());
         }
 
         conflict_resolver.done(a);
@@ -212,6 +214,34 @@ struct resize_test_t {
     }
 };
 
+struct discard_test_t {
+
+    discard_test_t(test_driver_t *_driver, int64_t o, size_t count)
+        : driver(_driver),
+          action(driver->make_action()) {
+        action->make_discard(IRRELEVANT_DEFAULT_FD, o, count);
+        driver->submit(action);
+    }
+
+    test_driver_t *driver;
+    test_driver_t::action_t *action;
+
+    bool was_sent() {
+        return driver->action_is_done(action) || driver->action_has_begun(action);
+    }
+    bool was_completed() {
+        return driver->action_is_done(action);
+    }
+    void go() {
+        ASSERT_TRUE(was_sent());
+        driver->permit(action);
+        ASSERT_TRUE(was_completed());
+    }
+    ~discard_test_t() {
+        EXPECT_TRUE(was_completed());
+    }
+};
+
 /* WriteWriteConflict verifies that if two writes are sent, they will be run in the correct
 order. */
 
@@ -302,6 +332,34 @@ TEST(DiskConflictTest, WriteReadSuperrange) {
     r.go();
 }
 
+/* DiscardReadConflict verifies that a read waits for a previous discard, and that it
+doesn't try to get its data from the discard. */
+
+TEST(DiskConflictTest, DiscardReadConflict) {
+    test_driver_t d;
+    write_test_t initial_write(&d, 0, "abcdef");
+    initial_write.go();
+    discard_test_t discard(&d, 0, DEVICE_BLOCK_SIZE);
+    read_test_t r(&d, 0, std::string(6, '\0'));
+    ASSERT_TRUE(discard.was_sent());
+    ASSERT_FALSE(r.was_sent());
+    discard.go();
+    r.go();
+}
+
+/* DiscardWriteConflict verifies that a write waits for a previous discard */
+
+TEST(DiskConflictTest, DiscardWriteConflict) {
+    test_driver_t d;
+    discard_test_t discard(&d, 0, DEVICE_BLOCK_SIZE);
+    write_test_t w(&d, 0, "foo");
+    read_test_t verifier(&d, 0, "foo");
+    ASSERT_FALSE(w.was_sent());
+    discard.go();
+    w.go();
+    verifier.go();
+}
+
 /* ResizeResizeConflict verifies that a resize operation waits for a previous resize */
 
 TEST(DiskConflictTest, ResizeResizeConflict) {
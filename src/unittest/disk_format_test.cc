@@ -55,7 +55,7 @@ TEST(DiskFormatTest, LbaMetablockMixinT) {
 }
 
 TEST(DiskFormatTest, LbaEntryT) {
-    EXPECT_EQ(0u, offsetof(lba_entry_t, zero_reserved));
+    EXPECT_EQ(0u, offsetof(lba_entry_t, uncompressed_ser_block_size));
     EXPECT_EQ(4u, offsetof(lba_entry_t, ser_block_size));
     EXPECT_EQ(8u, offsetof(lba_entry_t, block_id));
     EXPECT_EQ(16u, offsetof(lba_entry_t, recency));
@@ -68,11 +68,14 @@ TEST(DiskFormatTest, LbaEntryT) {
     ASSERT_TRUE(lba_entry_t::is_padding(&ent));
     flagged_off64_t real = flagged_off64_t::unused();
     real = flagged_off64_t::make(1);
-    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, real, 1234);
+    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, real, 1234, 0);
     ASSERT_FALSE(lba_entry_t::is_padding(&ent));
+    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, real, 1234, 4104);
+    ASSERT_FALSE(lba_entry_t::is_padding(&ent));
+    EXPECT_EQ(4104u, ent.uncompressed_ser_block_size);
     flagged_off64_t deleteblock = flagged_off64_t::unused();
     deleteblock = flagged_off64_t::make(1);
-    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, deleteblock, 1234);
+    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, deleteblock, 1234, 0);
     ASSERT_FALSE(lba_entry_t::is_padding(&ent));
 }
 
@@ -127,7 +130,8 @@ TEST(DiskFormatTest, LogSerializerMetablockT) {
 TEST(DiskFormatTest, LogSerializerStaticConfigT) {
     EXPECT_EQ(0u, offsetof(log_serializer_on_disk_static_config_t, block_size_));
     EXPECT_EQ(8u, offsetof(log_serializer_on_disk_static_config_t, extent_size_));
-    EXPECT_EQ(16u, sizeof(log_serializer_on_disk_static_config_t));
+    EXPECT_EQ(16u, offsetof(log_serializer_on_disk_static_config_t, compress_blocks_));
+    EXPECT_EQ(24u, sizeof(log_serializer_on_disk_static_config_t));
 }
 
 }  // namespace unittest
@@ -0,0 +1,88 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "arch/io/disk.hpp"
+#include "buffer_cache/alt.hpp"
+#include "buffer_cache/cache_balancer.hpp"
+#include "unittest/unittest_utils.hpp"
+#include "serializer/config.hpp"
+
+namespace unittest {
+
+void fill_evicter_test_block(buf_lock_t *lock, char value) {
+    buf_write_t write(lock);
+    void *data = write.get_data_write();
+    memset(data, value, lock->cache()->max_block_size().value());
+}
+
+void check_evicter_test_block(txn_t *txn, block_id_t block_id, char value) {
+    buf_lock_t lock(buf_parent_t(txn), block_id, access_t::read);
+    buf_read_t read(&lock);
+    uint32_t size;
+    const char *data = static_cast<const char *>(read.get_data_read(&size));
+    for (uint32_t i = 0; i < size; ++i) {
+        ASSERT_EQ(value, data[i]);
+    }
+}
+
+// Blocks that compress well go through the compressed tier when the cache is much
+// smaller than them.  They must come back out unchanged, and must not come back out
+// once they've been changed.
+TPTEST(EvicterTest, CompressedTier) {
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    // Room for four uncompressed blocks.
+    dummy_cache_balancer_t balancer(4 * serializer.max_block_size().value());
+    cache_t cache(&serializer, &balancer, &get_global_perfmon_collection());
+    cache_conn_t cache_conn(&cache);
+
+    const int num_blocks = 100;
+    std::vector<block_id_t> block_ids;
+    for (int i = 0; i < num_blocks; i += 10) {
+        txn_t txn(&cache_conn, write_durability_t::HARD,
+                  repli_timestamp_t::distant_past, 10);
+        for (int j = i; j < i + 10; ++j) {
+            buf_lock_t lock(buf_parent_t(&txn), alt_create_t::create);
+            fill_evicter_test_block(&lock, static_cast<char>(j));
+            block_ids.push_back(lock.block_id());
+        }
+    }
+
+    for (int round = 0; round < 2; ++round) {
+        txn_t txn(&cache_conn, write_durability_t::HARD,
+                  repli_timestamp_t::distant_past, 0);
+        for (int i = 0; i < num_blocks; ++i) {
+            check_evicter_test_block(&txn, block_ids[i], static_cast<char>(i));
+        }
+    }
+
+    {
+        txn_t txn(&cache_conn, write_durability_t::HARD,
+                  repli_timestamp_t::distant_past, 10);
+        for (int i = 0; i < 10; ++i) {
+            buf_lock_t lock(buf_parent_t(&txn), block_ids[i], access_t::write);
+            fill_evicter_test_block(&lock, static_cast<char>(i + 1));
+        }
+    }
+
+    txn_t txn(&cache_conn, write_durability_t::HARD,
+              repli_timestamp_t::distant_past, 0);
+    for (int i = 0; i < num_blocks; ++i) {
+        check_evicter_test_block(&txn, block_ids[i],
+                                 static_cast<char>(i < 10 ? i + 1 : i));
+    }
+}
+
+}  // namespace unittest
@@ -173,6 +173,28 @@ SPAWNER_TEST(ExtProc, TalkativeJob) {
     } while (n != 1);
 }
 
+SPAWNER_TEST(ExtProc, PrespawnedWorker) {
+    extproc_pool_t pool(2, 0);
+    typedef cross_thread_semaphore_t<extproc_worker_t>::try_lock_t worker_lock_t;
+    {
+        worker_lock_t first(pool.get_worker_semaphore());
+        worker_lock_t second(pool.get_worker_semaphore());
+        worker_lock_t third(pool.get_worker_semaphore());
+        ASSERT_TRUE(first.get_value() != NULL);
+        ASSERT_TRUE(second.get_value() != NULL);
+        ASSERT_TRUE(third.get_value() == NULL);
+
+        first.get_value()->prespawn();
+        ASSERT_TRUE(first.get_value()->is_process_alive());
+    }
+
+    // Jobs run fine on a worker that was started ahead of time
+    for (size_t i = 0; i < 10; ++i) {
+        fib_job_t job(10, &pool, NULL);
+        ASSERT_EQ(fib(10), job.run());
+    }
+}
+
 void run_single_job(extproc_pool_t *pool, size_t *counter, cond_t *done) {
     fib_job_t job(10, pool, NULL);
 
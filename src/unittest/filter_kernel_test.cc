@@ -0,0 +1,83 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/filter_kernel.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/term_walker.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+const ql::pb::dummy_var_t row_var = ql::pb::dummy_var_t::IGNORED;
+
+scoped_ptr_t<ql::filter_kernel_t> compile_filter_kernel(ql::r::reql_t &&body) {
+    ql::protob_t<Term> twrap =
+        ql::r::fun(row_var, std::move(body)).release_counted();
+    ql::protob_t<Backtrace> bt = ql::make_counted_backtrace();
+    ql::propagate_backtrace(twrap.get(), bt.get());
+    ql::compile_env_t compile_env((ql::var_visibility_t()));
+    counted_t<ql::func_term_t> func_term =
+        make_counted<ql::func_term_t>(&compile_env, twrap);
+    counted_t<const ql::func_t> f = func_term->eval_to_func(ql::var_scope_t());
+    return ql::filter_kernel_t::compile(f.get(), reql_version_t::LATEST);
+}
+
+ql::datum_t make_row(const std::string &status, double ts) {
+    std::map<datum_string_t, ql::datum_t> nested;
+    nested[datum_string_t("ts")] = ql::datum_t(ts);
+    std::map<datum_string_t, ql::datum_t> row;
+    row[datum_string_t("status")] = ql::datum_t(datum_string_t(status));
+    row[datum_string_t("nested")] = ql::datum_t(std::move(nested));
+    return ql::datum_t(std::move(row));
+}
+
+TEST(FilterKernelTest, Comparisons) {
+    scoped_ptr_t<ql::filter_kernel_t> kernel = compile_filter_kernel(
+        ql::r::var(row_var)["status"] == ql::r::expr(std::string("x"))
+        && ql::r::var(row_var)["nested"]["ts"] > ql::r::expr(10.0));
+    ASSERT_TRUE(kernel.has());
+
+    bool result;
+    ASSERT_TRUE(kernel->eval(make_row("x", 11), &result));
+    ASSERT_TRUE(result);
+    ASSERT_TRUE(kernel->eval(make_row("x", 10), &result));
+    ASSERT_FALSE(result);
+    ASSERT_TRUE(kernel->eval(make_row("y", 11), &result));
+    ASSERT_FALSE(result);
+
+    kernel = compile_filter_kernel(
+        !(ql::r::var(row_var)["nested"]["ts"] <= ql::r::expr(10.0)));
+    ASSERT_TRUE(kernel.has());
+    ASSERT_TRUE(kernel->eval(make_row("x", 11), &result));
+    ASSERT_TRUE(result);
+}
+
+TEST(FilterKernelTest, FallsBack) {
+    scoped_ptr_t<ql::filter_kernel_t> kernel = compile_filter_kernel(
+        ql::r::var(row_var)["missing"] == ql::r::expr(1.0));
+    ASSERT_TRUE(kernel.has());
+    bool result;
+    // Missing fields are errors, which the kernel leaves to the interpreter.
+    ASSERT_FALSE(kernel->eval(make_row("x", 1), &result));
+    ASSERT_FALSE(kernel->eval(ql::datum_t(1.0), &result));
+
+    // Comparing a field that's an object isn't handled either.
+    kernel = compile_filter_kernel(
+        ql::r::var(row_var)["nested"] == ql::r::expr(1.0));
+    ASSERT_TRUE(kernel.has());
+    ASSERT_FALSE(kernel->eval(make_row("x", 1), &result));
+}
+
+TEST(FilterKernelTest, Unsupported) {
+    // Arithmetic isn't supported.
+    ASSERT_FALSE(compile_filter_kernel(
+        ql::r::var(row_var)["nested"]["ts"] + ql::r::expr(1.0)
+        == ql::r::expr(2.0)).has());
+    // Neither are non-scalar constants.
+    ASSERT_FALSE(compile_filter_kernel(
+        ql::r::var(row_var)["status"]
+        == ql::r::array(ql::r::expr(1.0), ql::r::expr(2.0))).has());
+    // The function has to return a boolean.
+    ASSERT_FALSE(compile_filter_kernel(ql::r::var(row_var)["status"]).has());
+}
+
+}  // namespace unittest
@@ -0,0 +1,126 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "concurrency/cond_var.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/func_bytecode.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/term_walker.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+const ql::pb::dummy_var_t var_a = ql::pb::dummy_var_t::GROUPBY_REDUCE_A;
+const ql::pb::dummy_var_t var_b = ql::pb::dummy_var_t::GROUPBY_REDUCE_B;
+
+scoped_ptr_t<ql::func_bytecode_t> compile_bytecode(ql::r::reql_t &&fun) {
+    ql::protob_t<Term> twrap = fun.release_counted();
+    ql::protob_t<Backtrace> bt = ql::make_counted_backtrace();
+    ql::propagate_backtrace(twrap.get(), bt.get());
+    ql::compile_env_t compile_env((ql::var_visibility_t()));
+    counted_t<ql::func_term_t> func_term =
+        make_counted<ql::func_term_t>(&compile_env, twrap);
+    counted_t<const ql::func_t> f = func_term->eval_to_func(ql::var_scope_t());
+    return ql::func_bytecode_t::compile(f.get());
+}
+
+ql::datum_t make_doc(double x, double y) {
+    std::map<datum_string_t, ql::datum_t> doc;
+    doc[datum_string_t("x")] = ql::datum_t(x);
+    doc[datum_string_t("y")] = ql::datum_t(y);
+    return ql::datum_t(std::move(doc));
+}
+
+TEST(FuncBytecodeTest, Map) {
+    cond_t interruptor;
+    ql::env_t env(&interruptor, reql_version_t::LATEST);
+
+    scoped_ptr_t<ql::func_bytecode_t> bytecode = compile_bytecode(
+        ql::r::fun(var_a, ql::r::object(
+            ql::r::optarg("sum", ql::r::var(var_a)["x"] + ql::r::var(var_a)["y"]),
+            ql::r::optarg("big", ql::r::var(var_a)["x"] > ql::r::expr(10.0)),
+            ql::r::optarg("pair", ql::r::array(ql::r::var(var_a)["y"],
+                                               ql::r::expr(1.0))))));
+    ASSERT_TRUE(bytecode.has());
+
+    ql::datum_t result;
+    ASSERT_TRUE(bytecode->call(&env, make_doc(11, 2), &result));
+    ASSERT_EQ(ql::datum_t(13.0), result.get_field("sum"));
+    ASSERT_EQ(ql::datum_t::boolean(true), result.get_field("big"));
+    ASSERT_EQ(2u, result.get_field("pair").arr_size());
+    ASSERT_EQ(ql::datum_t(2.0), result.get_field("pair").get(0));
+
+    bytecode = compile_bytecode(
+        ql::r::fun(var_a, ql::r::branch(ql::r::var(var_a)["x"] < ql::r::expr(5.0),
+                                        ql::r::var(var_a)["y"],
+                                        ql::r::var(var_a)["x"] / ql::r::expr(2.0))));
+    ASSERT_TRUE(bytecode.has());
+    ASSERT_TRUE(bytecode->call(&env, make_doc(1, 7), &result));
+    ASSERT_EQ(ql::datum_t(7.0), result);
+    ASSERT_TRUE(bytecode->call(&env, make_doc(8, 7), &result));
+    ASSERT_EQ(ql::datum_t(4.0), result);
+}
+
+TEST(FuncBytecodeTest, Reduce) {
+    cond_t interruptor;
+    ql::env_t env(&interruptor, reql_version_t::LATEST);
+
+    scoped_ptr_t<ql::func_bytecode_t> bytecode = compile_bytecode(
+        ql::r::fun(var_a, var_b, ql::r::var(var_a) + ql::r::var(var_b)));
+    ASSERT_TRUE(bytecode.has());
+
+    ql::datum_t result;
+    ASSERT_TRUE(bytecode->call(&env, ql::datum_t(1.0), ql::datum_t(2.0), &result));
+    ASSERT_EQ(ql::datum_t(3.0), result);
+    // Strings are left to the interpreter.
+    ASSERT_FALSE(bytecode->call(&env, ql::datum_t(datum_string_t("a")),
+                                ql::datum_t(datum_string_t("b")), &result));
+    // So is the wrong number of arguments.
+    ASSERT_FALSE(bytecode->call(&env, ql::datum_t(1.0), &result));
+}
+
+TEST(FuncBytecodeTest, FallsBack) {
+    cond_t interruptor;
+    ql::env_t env(&interruptor, reql_version_t::LATEST);
+
+    scoped_ptr_t<ql::func_bytecode_t> bytecode = compile_bytecode(
+        ql::r::fun(var_a, ql::r::var(var_a)["x"] / ql::r::var(var_a)["y"]));
+    ASSERT_TRUE(bytecode.has());
+
+    ql::datum_t result;
+    // Errors are left to the interpreter: division by zero, missing fields and
+    // non-objects.
+    ASSERT_FALSE(bytecode->call(&env, make_doc(1, 0), &result));
+    ASSERT_FALSE(bytecode->call(&env, ql::datum_t(std::map<datum_string_t,
+                                                           ql::datum_t>()),
+                                &result));
+    ASSERT_FALSE(bytecode->call(&env, ql::datum_t(1.0), &result));
+    ASSERT_TRUE(bytecode->call(&env, make_doc(1, 4), &result));
+    ASSERT_EQ(ql::datum_t(0.25), result);
+}
+
+TEST(FuncBytecodeTest, GetFieldFunc) {
+    cond_t interruptor;
+    ql::env_t env(&interruptor, reql_version_t::LATEST);
+
+    // `sum('x')` and friends use these.
+    counted_t<const ql::func_t> f = ql::new_get_field_func(
+        ql::datum_t(datum_string_t("x")), ql::make_counted_backtrace());
+    scoped_ptr_t<ql::func_bytecode_t> bytecode = ql::func_bytecode_t::compile(f.get());
+    ASSERT_TRUE(bytecode.has());
+
+    ql::datum_t result;
+    ASSERT_TRUE(bytecode->call(&env, make_doc(3, 4), &result));
+    ASSERT_EQ(ql::datum_t(3.0), result);
+}
+
+TEST(FuncBytecodeTest, Unsupported) {
+    // Unsupported terms.
+    ASSERT_FALSE(compile_bytecode(
+        ql::r::fun(var_a, ql::r::var(var_a).count())).has());
+    // Non-deterministic functions.
+    ASSERT_FALSE(compile_bytecode(
+        ql::r::fun(var_a, ql::r::var(var_a)["x"]
+                   + ql::r::reql_t(Term::RANDOM))).has());
+}
+
+}  // namespace unittest
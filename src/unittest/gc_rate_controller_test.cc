@@ -0,0 +1,67 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "config/args.hpp"
+#include "serializer/log/gc_rate_controller.hpp"
+
+namespace unittest {
+
+const ticks_t ms = secs_to_ticks(1) / 1000;
+
+TEST(GcRateControllerTest, ThrottlesOnSlowWrites) {
+    ticks_t now = 1000 * ms;
+    gc_rate_controller_t controller(now);
+    EXPECT_EQ(gc_rate_controller_t::mode_t::normal, controller.mode(now));
+    EXPECT_EQ(0, controller.gc_delay_ms());
+
+    // Writes that are much slower than the target back the GC off, more and more
+    // but never past the maximum.
+    int64_t last_delay = 0;
+    for (int i = 0; i < 20; ++i) {
+        controller.on_writes_started();
+        ticks_t start = now;
+        now += 10 * GC_THROTTLE_TARGET_WRITE_LATENCY_MS * ms;
+        controller.on_writes_finished(start, now);
+        EXPECT_EQ(gc_rate_controller_t::mode_t::throttled, controller.mode(now));
+        EXPECT_GE(controller.gc_delay_ms(), last_delay);
+        last_delay = controller.gc_delay_ms();
+    }
+    EXPECT_EQ(GC_THROTTLE_MAX_DELAY_MS, controller.gc_delay_ms());
+
+    // Fast writes let it recover.
+    for (int i = 0; i < 100; ++i) {
+        controller.on_writes_started();
+        controller.on_writes_finished(now, now);
+    }
+    EXPECT_EQ(0, controller.gc_delay_ms());
+    EXPECT_EQ(gc_rate_controller_t::mode_t::normal, controller.mode(now));
+}
+
+TEST(GcRateControllerTest, ThrottlesOnQueueDepth) {
+    ticks_t now = 1000 * ms;
+    gc_rate_controller_t controller(now);
+    for (int i = 0; i < GC_THROTTLE_MAX_OUTSTANDING_WRITES + 2; ++i) {
+        controller.on_writes_started();
+    }
+    controller.on_writes_finished(now, now);
+    EXPECT_EQ(GC_THROTTLE_MAX_OUTSTANDING_WRITES + 1, controller.outstanding_writes());
+    EXPECT_EQ(gc_rate_controller_t::mode_t::throttled, controller.mode(now));
+}
+
+TEST(GcRateControllerTest, IdleWithoutWrites) {
+    ticks_t now = 1000 * ms;
+    gc_rate_controller_t controller(now);
+    now += GC_IDLE_TIME_MS * ms;
+    EXPECT_EQ(gc_rate_controller_t::mode_t::idle, controller.mode(now));
+
+    // An outstanding write means we're not idle, however long it takes.
+    controller.on_writes_started();
+    now += GC_IDLE_TIME_MS * ms;
+    EXPECT_NE(gc_rate_controller_t::mode_t::idle, controller.mode(now));
+    controller.on_writes_finished(now, now);
+    EXPECT_EQ(gc_rate_controller_t::mode_t::normal, controller.mode(now));
+    now += GC_IDLE_TIME_MS * ms;
+    EXPECT_EQ(gc_rate_controller_t::mode_t::idle, controller.mode(now));
+}
+
+}  // namespace unittest
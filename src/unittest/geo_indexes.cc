@@ -9,13 +9,17 @@
 #include "rdb_protocol/configured_limits.hpp"
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/error.hpp"
+#include "rdb_protocol/func.hpp"
 #include "rdb_protocol/geo/distances.hpp"
 #include "rdb_protocol/geo/ellipsoid.hpp"
 #include "rdb_protocol/geo/exceptions.hpp"
 #include "rdb_protocol/geo/geojson.hpp"
+#include "rdb_protocol/geo/indexing.hpp"
 #include "rdb_protocol/geo/lon_lat_types.hpp"
 #include "rdb_protocol/geo/intersection.hpp"
 #include "rdb_protocol/geo/primitives.hpp"
+#include "rdb_protocol/geo/s2/s2cellid.h"
+#include "rdb_protocol/geo_traversal.hpp"
 #include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/protocol.hpp"
 #include "rdb_protocol/shards.hpp"
@@ -25,6 +29,7 @@
 #include "unittest/gtest.hpp"
 #include "utils.hpp"
 
+using geo::S2CellId;
 using geo::S2Point;
 using ql::datum_t;
 
@@ -429,6 +434,36 @@ TPTEST(GeoIndexes, GetIntersecting) {
     run_with_namespace_interface(&run_get_intersecting_test);
 }
 
+TEST(GeoIndexes, MergeCellsIntoRanges) {
+    const S2CellId face0 = S2CellId::FromFacePosLevel(0, 0, 0);
+    const S2CellId face1 = S2CellId::FromFacePosLevel(1, 0, 0);
+    const S2CellId face3 = S2CellId::FromFacePosLevel(3, 0, 0);
+    // The first child of face 3 lies inside of face 3, and faces 0 and 1 are next to
+    // each other on the curve.
+    std::vector<S2CellId> cells = {face3, face1, face3.child_begin(), face0};
+    std::vector<std::pair<S2CellId, S2CellId> > ranges = merge_cells_into_ranges(cells);
+    ASSERT_EQ(2u, ranges.size());
+    EXPECT_EQ(face0.range_min(), ranges[0].first);
+    EXPECT_EQ(face1.range_max(), ranges[0].second);
+    EXPECT_EQ(face3.range_min(), ranges[1].first);
+    EXPECT_EQ(face3.range_max(), ranges[1].second);
+
+    EXPECT_TRUE(merge_cells_into_ranges(std::vector<S2CellId>()).empty());
+}
+
+TEST(GeoIndexes, KeySet) {
+    geo_key_set_t set;
+    // Enough keys to make the bitmap grow a few times.
+    for (int i = 0; i < 2000; i += 2) {
+        set.insert(store_key_t(strprintf("key%d", i)));
+    }
+    set.insert(store_key_t("key0"));
+    EXPECT_EQ(1000u, set.size());
+    for (int i = 0; i < 2000; ++i) {
+        EXPECT_EQ(i % 2 == 0, set.contains(store_key_t(strprintf("key%d", i))));
+    }
+}
+
 } /* namespace unittest */
 
 
@@ -106,5 +106,31 @@ TPTEST(GeoPrimitives, InExRadiusTest) {
     }
 }
 
+void test_distance_calculator(const ellipsoid_spec_t &e, rng_t *rng) {
+    for (int i = 0; i < 100; ++i) {
+        const lon_lat_point_t ref(rng->randdouble() * 360.0 - 180.0,
+                                  rng->randdouble() * 180.0 - 90.0);
+        const lon_lat_point_t p(rng->randdouble() * 360.0 - 180.0,
+                                rng->randdouble() * 180.0 - 90.0);
+        const geodesic_distance_calculator_t calculator(
+            S2LatLng::FromDegrees(ref.latitude, ref.longitude).ToPoint(), e);
+        const datum_t point = construct_geo_point(p, ql::configured_limits_t());
+
+        const double dist = calculator.distance_to(point);
+        EXPECT_NEAR(geodesic_distance(ref, p, e), dist, 1e-6 * e.equator_radius());
+        // Exact below the bound, and on the far side of it above.
+        EXPECT_EQ(dist, calculator.distance_to_at_most(point, dist));
+        EXPECT_EQ(dist, calculator.distance_to_at_most(point, dist * 2.0));
+        EXPECT_GT(calculator.distance_to_at_most(point, dist * 0.5), dist * 0.5);
+    }
+}
+
+TPTEST(GeoPrimitives, DistanceCalculatorTest) {
+    rng_t rng(randint(INT_MAX));
+    test_distance_calculator(UNIT_SPHERE, &rng);
+    test_distance_calculator(WGS84_ELLIPSOID, &rng);
+    test_distance_calculator(ellipsoid_spec_t(1.0, 0.4), &rng);
+}
+
 }   /* namespace unittest */
 
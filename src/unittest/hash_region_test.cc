@@ -18,6 +18,32 @@ void assert_empty(const hash_region_t<key_range_t>& r) {
     assert_equal(key_range_t::empty(), r.inner);
 }
 
+// What `hash_region_hasher` computed before it used a table.  Keys are assigned to
+// CPU shards by their hash, so it can never change.
+uint64_t reference_hash(const uint8_t *s, ssize_t len) {
+    uint64_t h = 0x47a59e381fb2dc06ULL;
+    for (ssize_t i = 0; i < len; ++i) {
+        uint64_t d = (((s[i] * 0x80200802ULL) & 0x0884422110ULL) * 0x0101010101ULL) << 23;
+        h += d;
+        h = h ^ (h >> 11) ^ (h << 21);
+    }
+    return h & 0x7fffffffffffffffULL;
+}
+
+TEST(HashRegionTest, HasherIsStable) {
+    for (int ch = 0; ch < 256; ++ch) {
+        const uint8_t s[2] = { static_cast<uint8_t>(ch), 'x' };
+        ASSERT_EQ(reference_hash(s, 2), hash_region_hasher(s, 2));
+    }
+    const uint8_t *alpha = reinterpret_cast<const uint8_t *>("Alpha");
+    EXPECT_EQ(0x47a59e381fb2dc06ULL & 0x7fffffffffffffffULL,
+              hash_region_hasher(alpha, 0));
+    EXPECT_EQ(0x6dfa347078712a5dULL, hash_region_hasher(alpha + 4, 1));
+    EXPECT_EQ(0x059fba3a08d63fc5ULL, hash_region_hasher(alpha, 5));
+    const uint8_t bytes[8] = { 0xff, 0x00, 0x80, ' ', 'k', 'e', 'y', 0 };
+    EXPECT_EQ(0x5163824f51d75e32ULL, hash_region_hasher(bytes, 8));
+}
+
 TEST(HashRegionTest, RegionJoinHashwise) {
 
     key_range_t kr(key_range_t::closed, store_key_t("Alpha"), key_range_t::open, store_key_t("Beta"));
@@ -88,6 +88,15 @@ TEST(Http, Encodings) {
     test_encoding("g_zip", false);
 }
 
+TEST(Http, AlreadyEncoded) {
+    http_req_t req = http_req_encoding("gzip");
+    http_res_t res(HTTP_OK);
+    res.set_body("application/text", std::string(2048, 'a'));
+    res.add_header_line("Content-Encoding", "gzip");
+    EXPECT_FALSE(maybe_gzip_response(req, &res));
+    EXPECT_EQ(std::string(2048, 'a'), res.body);
+}
+
 class dummy_http_app_t : public http_app_t {
 public:
     signal_t *get_handle_signal() {
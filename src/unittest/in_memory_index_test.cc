@@ -0,0 +1,80 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "serializer/log/lba/in_memory_index.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+void check_block_info(const index_block_info_t &expected,
+                      const index_block_info_t &actual) {
+    EXPECT_EQ(expected.offset.the_value_, actual.offset.the_value_);
+    EXPECT_EQ(expected.recency, actual.recency);
+    EXPECT_EQ(expected.ser_block_size, actual.ser_block_size);
+    EXPECT_EQ(expected.uncompressed_ser_block_size,
+              actual.uncompressed_ser_block_size);
+}
+
+void set_and_check(in_memory_index_t *index, block_id_t id,
+                   const index_block_info_t &info) {
+    index->set_block_info(id, info.recency, info.offset, info.ser_block_size,
+                          info.uncompressed_ser_block_size);
+    check_block_info(info, index->get_block_info(id));
+}
+
+repli_timestamp_t make_recency(uint64_t longtime) {
+    repli_timestamp_t ret;
+    ret.longtime = longtime;
+    return ret;
+}
+
+TEST(InMemoryIndexTest, RoundTrip) {
+    in_memory_index_t index;
+    check_block_info(index_block_info_t(), index.get_block_info(5));
+
+    set_and_check(&index, 0, index_block_info_t(
+        flagged_off64_t::make(0), repli_timestamp_t::distant_past, 4096, 0));
+    set_and_check(&index, 1, index_block_info_t(
+        flagged_off64_t::make(DEVICE_BLOCK_SIZE * 12345), make_recency(77),
+        1500, 4096));
+    set_and_check(&index, 2, index_block_info_t(
+        flagged_off64_t::unused(), repli_timestamp_t::invalid, 0, 0));
+    EXPECT_EQ(3u, index.end_block_id());
+
+    // Values that don't fit the packed encoding.
+    set_and_check(&index, 3, index_block_info_t(
+        flagged_off64_t::make(DEVICE_BLOCK_SIZE + 7), make_recency(1), 4096, 0));
+    set_and_check(&index, 4, index_block_info_t(
+        flagged_off64_t::make(int64_t(1) << 61), make_recency(1), 4096, 0));
+    set_and_check(&index, 5, index_block_info_t(
+        flagged_off64_t::make(0), make_recency(UINT64_MAX - 1), 4096, 0));
+    set_and_check(&index, 6, index_block_info_t(
+        flagged_off64_t::make(0), make_recency(1), UINT32_MAX, UINT32_MAX));
+
+    // Overflowed entries can go back to being packed, and vice versa.
+    set_and_check(&index, 3, index_block_info_t(
+        flagged_off64_t::make(DEVICE_BLOCK_SIZE), make_recency(2), 4096, 0));
+    set_and_check(&index, 1, index_block_info_t(
+        flagged_off64_t::make(3), make_recency(78), 1500, 4096));
+}
+
+TEST(InMemoryIndexTest, BytesPerBlock) {
+    in_memory_index_t index;
+    EXPECT_EQ(0.0, index.bytes_per_block());
+
+    const block_id_t num_blocks = 1000000;
+    for (block_id_t i = 0; i < num_blocks; ++i) {
+        index.set_block_info(i, make_recency(i),
+                             flagged_off64_t::make(i * 4608), 4608, 0);
+    }
+    // Two packed words per block, plus a little slack for the chunk table.
+    EXPECT_LE(index.bytes_per_block(), 16.5);
+    EXPECT_LT(index.bytes_per_block() + 7, sizeof(index_block_info_t));
+
+    for (block_id_t i = 0; i < num_blocks; ++i) {
+        index.set_block_info(i, repli_timestamp_t::invalid,
+                             flagged_off64_t::unused(), 0, 0);
+    }
+    EXPECT_EQ(0.0, index.bytes_per_block());
+    EXPECT_LE(index.memory_usage(), 1024u * 1024u);
+}
+
+}  // namespace unittest
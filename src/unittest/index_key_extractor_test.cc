@@ -0,0 +1,73 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/index_key_extractor.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/term_walker.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+const ql::pb::dummy_var_t index_row_var = ql::pb::dummy_var_t::IGNORED;
+
+scoped_ptr_t<ql::index_key_extractor_t> compile_index_key_extractor(
+        ql::r::reql_t &&body) {
+    ql::protob_t<Term> twrap =
+        ql::r::fun(index_row_var, std::move(body)).release_counted();
+    ql::protob_t<Backtrace> bt = ql::make_counted_backtrace();
+    ql::propagate_backtrace(twrap.get(), bt.get());
+    ql::compile_env_t compile_env((ql::var_visibility_t()));
+    counted_t<ql::func_term_t> func_term =
+        make_counted<ql::func_term_t>(&compile_env, twrap);
+    counted_t<const ql::func_t> f = func_term->eval_to_func(ql::var_scope_t());
+    return ql::index_key_extractor_t::compile(f.get());
+}
+
+ql::datum_t make_index_row(double a, double b) {
+    std::map<datum_string_t, ql::datum_t> nested;
+    nested[datum_string_t("b")] = ql::datum_t(b);
+    std::map<datum_string_t, ql::datum_t> row;
+    row[datum_string_t("a")] = ql::datum_t(a);
+    row[datum_string_t("nested")] = ql::datum_t(std::move(nested));
+    return ql::datum_t(std::move(row));
+}
+
+TEST(IndexKeyExtractorTest, Paths) {
+    scoped_ptr_t<ql::index_key_extractor_t> extractor =
+        compile_index_key_extractor(ql::r::var(index_row_var)["nested"]["b"]);
+    ASSERT_TRUE(extractor.has());
+    ql::datum_t value;
+    ASSERT_TRUE(extractor->extract(make_index_row(1, 2), &value));
+    EXPECT_EQ(ql::datum_t(2.0), value);
+
+    extractor = compile_index_key_extractor(
+        ql::r::array(ql::r::var(index_row_var)["a"],
+                     ql::r::var(index_row_var)["nested"]["b"]));
+    ASSERT_TRUE(extractor.has());
+    ASSERT_TRUE(extractor->extract(make_index_row(1, 2), &value));
+    ASSERT_EQ(ql::datum_t::R_ARRAY, value.get_type());
+    ASSERT_EQ(2u, value.arr_size());
+    EXPECT_EQ(ql::datum_t(1.0), value.get(0));
+    EXPECT_EQ(ql::datum_t(2.0), value.get(1));
+}
+
+TEST(IndexKeyExtractorTest, FallsBack) {
+    scoped_ptr_t<ql::index_key_extractor_t> extractor =
+        compile_index_key_extractor(ql::r::var(index_row_var)["a"]["b"]);
+    ASSERT_TRUE(extractor.has());
+    ql::datum_t value;
+    // `a` isn't an object, and `missing` doesn't exist, so the function has to
+    // raise the error.
+    ASSERT_FALSE(extractor->extract(make_index_row(1, 2), &value));
+    extractor = compile_index_key_extractor(ql::r::var(index_row_var)["missing"]);
+    ASSERT_TRUE(extractor.has());
+    ASSERT_FALSE(extractor->extract(make_index_row(1, 2), &value));
+}
+
+TEST(IndexKeyExtractorTest, Unsupported) {
+    ASSERT_FALSE(compile_index_key_extractor(
+        ql::r::var(index_row_var)["a"] + ql::r::expr(1.0)).has());
+    ASSERT_FALSE(compile_index_key_extractor(ql::r::var(index_row_var)).has());
+    ASSERT_FALSE(compile_index_key_extractor(ql::r::expr(1.0)).has());
+}
+
+}  // namespace unittest
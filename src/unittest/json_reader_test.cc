@@ -0,0 +1,79 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string>
+
+#include "http/json.hpp"
+#include "http/json/json_reader.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+ql::datum_t parse_with_reader(const std::string &json) {
+    json_reader_t reader(json.data(), json.size());
+    ql::datum_t res = ql::to_datum(&reader, ql::configured_limits_t::unlimited,
+                                   reql_version_t::LATEST);
+    reader.finish();
+    return res;
+}
+
+ql::datum_t parse_with_cjson(const std::string &json) {
+    scoped_cJSON_t cjson(cJSON_Parse(json.c_str()));
+    guarantee(cjson.get() != NULL);
+    return ql::to_datum(cjson.get(), ql::configured_limits_t::unlimited,
+                        reql_version_t::LATEST);
+}
+
+TEST(JsonReader, SameAsCJSON) {
+    const char *inputs[] = {
+        "null", "true", "false", "0", "-0", "17", "-42", "123456789012345",
+        "1234567890123456789", "3.25", "-1e3", "2.5E-3", "1e+2",
+        "\"\"", "\"abc\"", "\"a\\\"b\\\\c\\/d\\b\\f\\n\\r\\t\"",
+        "\"\\u00e9\\u4e2d\\ud83d\\ude00\"", "\"longer than sixteen bytes, with a \\\" in it\"",
+        "[]", "[1,2,[3,[]]]", "{}", " { \"a\" : [ 1 , { \"b\" : null } ] , \"c\" : \"d\" } ",
+        "{\"$reql_type$\":\"TIME\",\"epoch_time\":1,\"timezone\":\"+00:00\"}"
+    };
+    for (const char *input : inputs) {
+        EXPECT_EQ(parse_with_cjson(input), parse_with_reader(input)) << input;
+    }
+}
+
+TEST(JsonReader, RejectsMalformed) {
+    const char *inputs[] = {
+        "", "nul", "tru", "-", "01", "1.", "1e", ".5", "+1", "\"abc", "\"\\x\"",
+        "\"\\u12\"", "\"\\ud83d\"", "\"\\u0000\"", "[1,]", "[,1]", "[1 2]",
+        "{\"a\"}", "{\"a\":1,}", "{1:2}", "[1]]", "[1] x"
+    };
+    for (const char *input : inputs) {
+        EXPECT_THROW(parse_with_reader(input), json_reader_exc_t) << input;
+    }
+    EXPECT_THROW(parse_with_reader(std::string("\"a\0b\"", 5)), json_reader_exc_t);
+}
+
+TEST(JsonReader, NotNulTerminated) {
+    const std::string json = "[123, \"abc\"]trailing";
+    json_reader_t reader(json.data(), json.size() - 8);
+    ql::datum_t res = ql::to_datum(&reader, ql::configured_limits_t::unlimited,
+                                   reql_version_t::LATEST);
+    reader.finish();
+    EXPECT_EQ(parse_with_cjson("[123, \"abc\"]"), res);
+
+    // A number at the very end of the buffer.
+    const std::string number = "12.5e1x";
+    json_reader_t number_reader(number.data(), number.size() - 1);
+    EXPECT_EQ(125.0, number_reader.read_number());
+    number_reader.finish();
+}
+
+TEST(JsonReader, SkipValue) {
+    const std::string json = "[{\"a\":[1,\"]\",{}]},2]";
+    json_reader_t reader(json.data(), json.size());
+    reader.begin_array();
+    ASSERT_TRUE(reader.next_element());
+    reader.skip_value();
+    ASSERT_TRUE(reader.next_element());
+    EXPECT_EQ(2.0, reader.read_number());
+    EXPECT_FALSE(reader.next_element());
+    reader.finish();
+}
+
+}  // namespace unittest
@@ -0,0 +1,45 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <deque>
+#include <string>
+
+#include "containers/buffer_group.hpp"
+#include "protob/json_shim.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(JsonShim, WriteResponsePieces) {
+    Response response;
+    response.set_token(1);
+    response.set_type(Response::SUCCESS_SEQUENCE);
+    Datum *d = response.add_response();
+    d->set_type(Datum::R_JSON);
+    d->set_r_str("{\"a\":1}");
+    d = response.add_response();
+    d->set_type(Datum::R_STR);
+    d->set_r_str("b\"c");
+
+    const std::string expected =
+        strprintf("{\"t\":%d,\"r\":[{\"a\":1},\"b\\\"c\"]}",
+                  Response::SUCCESS_SEQUENCE);
+
+    std::string str;
+    json_shim::write_json_pb(response, &str);
+    EXPECT_EQ(expected, str);
+
+    // The datum that already is JSON is referenced, not copied.
+    std::deque<std::string> storage;
+    const_buffer_group_t pieces;
+    json_shim::write_json_pb_pieces(response, &storage, &pieces);
+    ASSERT_EQ(expected.size(), pieces.get_size());
+    bool found_datum = false;
+    for (size_t i = 0; i < pieces.num_buffers(); ++i) {
+        if (pieces.get_buffer(i).data == response.response(0).r_str().data()) {
+            found_datum = true;
+        }
+    }
+    EXPECT_TRUE(found_datum);
+}
+
+}  // namespace unittest
@@ -1,5 +1,6 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include <map>
+#include <vector>
 
 #include "btree/leaf_node.hpp"
 #include "btree/node.hpp"
@@ -156,21 +157,21 @@ public:
         if (can_level) {
             ASSERT_TRUE(!sibling->kv_.empty());
             if (nodecmp_value < 0) {
-                // Copy keys from front of sibling until and including replacement key.
+                // Copy keys from front of sibling up to the replacement key, which
+                // separates them from the rest.
 
+                ASSERT_TRUE(sibling->kv_.begin()->first <= replacement);
                 std::map<store_key_t, std::string>::iterator p = sibling->kv_.begin();
-                while (p != sibling->kv_.end() && p->first < replacement) {
+                while (p != sibling->kv_.end() && p->first <= replacement) {
                     kv_[p->first] = p->second;
                     std::map<store_key_t, std::string>::iterator prev = p;
                     ++p;
                     sibling->kv_.erase(prev);
                 }
                 ASSERT_TRUE(p != sibling->kv_.end());
-                ASSERT_EQ(key_to_unescaped_str(p->first), key_to_unescaped_str(replacement));
-                kv_[p->first] = p->second;
-                sibling->kv_.erase(p);
             } else {
-                // Copy keys from end of sibling until but not including replacement key.
+                // Copy keys from end of sibling after the replacement key, which
+                // separates them from the rest.
 
                 std::map<store_key_t, std::string>::iterator p = sibling->kv_.end();
                 --p;
@@ -181,7 +182,7 @@ public:
                     sibling->kv_.erase(prev);
                 }
 
-                ASSERT_EQ(key_to_unescaped_str(p->first), key_to_unescaped_str(replacement));
+                ASSERT_TRUE(p->first <= replacement);
             }
         }
 
@@ -191,7 +192,7 @@ public:
         sibling->Verify();
     }
 
-    void Split(LeafNodeTracker *right) {
+    void Split(LeafNodeTracker *right, store_key_t *median_out) {
         ASSERT_EQ(bs_.ser_value(), right->bs_.ser_value());
 
         ASSERT_TRUE(leaf::is_empty(right->node()));
@@ -208,7 +209,14 @@ public:
             kv_.erase(prev);
         }
 
-        ASSERT_EQ(key_to_unescaped_str(p->first), key_to_unescaped_str(median));
+        // The median separates the two nodes.
+        ASSERT_TRUE(p->first <= median);
+        ASSERT_TRUE(!right->kv_.empty());
+        ASSERT_TRUE(right->kv_.begin()->first > median);
+        *median_out = median;
+
+        Verify();
+        right->Verify();
     }
 
     bool IsFull(const store_key_t& key, const std::string& value) {
@@ -605,7 +613,50 @@ TEST(LeafNodeTest, Splitting) {
 
     LeafNodeTracker right;
 
-    left.Split(&right);
+    store_key_t median;
+    left.Split(&right, &median);
+}
+
+TEST(LeafNodeTest, SplittingShortensMedian) {
+    // Keys with a long common prefix, like secondary index keys.
+    const std::string prefix(100, 'p');
+    LeafNodeTracker left;
+    for (int i = 0; i < 30; ++i) {
+        left.Insert(store_key_t(strprintf("%s%03d", prefix.c_str(), i)),
+                    std::string(90, 'v'));
+    }
+
+    LeafNodeTracker right;
+
+    store_key_t median;
+    left.Split(&right, &median);
+    // The median only has to reach the first digit that sets the nodes apart.
+    ASSERT_GE(median.size(), static_cast<int>(prefix.size()) + 1);
+    ASSERT_LE(median.size(), static_cast<int>(prefix.size()) + 3);
+}
+
+TEST(LeafNodeTest, FindKeyWithCommonPrefixes) {
+    // Keys that share prefixes of different lengths, so that the search skips
+    // different numbers of bytes.
+    LeafNodeTracker tracker;
+    std::vector<store_key_t> keys;
+    for (int i = 0; i < 6; ++i) {
+        for (int j = 0; j < 6; ++j) {
+            keys.push_back(store_key_t(strprintf("%s%d%s%d", std::string(i * 7, 'k').c_str(), i,
+                                                 std::string(9, 'x').c_str(), j)));
+        }
+    }
+    for (size_t i = 0; i < keys.size(); ++i) {
+        ASSERT_TRUE(tracker.Insert(keys[i], "v"));
+    }
+    for (size_t i = 0; i < keys.size(); ++i) {
+        int index;
+        ASSERT_TRUE(leaf::find_key(tracker.node(), keys[i].btree_key(), &index));
+
+        store_key_t missing = keys[i];
+        missing.increment();
+        ASSERT_FALSE(leaf::find_key(tracker.node(), missing.btree_key(), &index));
+    }
 }
 
 TEST(LeafNodeTest, Fullness) {
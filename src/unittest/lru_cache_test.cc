@@ -65,4 +65,22 @@ TEST(LRUCacheTest, Find) {
     EXPECT_EQ(10, cache.rbegin()->first);
 }
 
+TEST(LRUCacheTest, Erase) {
+    lru_cache_t<int, int> cache(10);
+    for (int i = 0; i < 10; i++) cache[i] = i;
+    EXPECT_TRUE(cache.erase(9));
+    EXPECT_FALSE(cache.erase(9));
+    EXPECT_TRUE(cache.erase(0));
+    EXPECT_EQ(8u, cache.size());
+    EXPECT_EQ(8, cache.begin()->first);
+    EXPECT_EQ(1, cache.rbegin()->first);
+    EXPECT_EQ(cache.end(), cache.find(9));
+    // There's room for two more before anything gets evicted.
+    cache[10] = 10;
+    cache[11] = 11;
+    EXPECT_EQ(1, cache.rbegin()->first);
+    cache[12] = 12;
+    EXPECT_EQ(2, cache.rbegin()->first);
+}
+
 } // namespace unittest
@@ -2,6 +2,8 @@
 #include "unittest/mock_file.hpp"
 
 #include <sys/uio.h>
+
+#include <algorithm>
 #include <functional>
 
 #include "arch/io/disk.hpp"
@@ -71,6 +73,21 @@ void mock_file_t::writev_async(int64_t offset, size_t length, scoped_array_t<iov
     write_async(offset, length, buf.get(), account, cb, NO_DATASYNCS);
 }
 
+void mock_file_t::datasync_async(linux_iocallback_t *cb) {
+    // Everything is durable as soon as it has been written.
+    coro_t::spawn_sometime(std::bind(&linux_iocallback_t::on_io_complete, cb));
+}
+
+void mock_file_t::discard(int64_t offset, int64_t length) {
+    guarantee(mode_ & mode_write);
+    guarantee(offset >= 0 && length >= 0);
+    // Like a punched hole, the discarded range reads back as zeroes.  Discards past
+    // the end of the file are fine, since the file might have been shrunk since.
+    const uint64_t begin = std::min<uint64_t>(offset, data_->size());
+    const uint64_t end = std::min<uint64_t>(offset + length, data_->size());
+    memset(data_->data() + begin, 0, end - begin);
+}
+
 bool mock_file_t::coop_lock_and_check() {
     // We don't actually implement the locking behavior.
     return true;
@@ -124,4 +141,9 @@ void mock_file_opener_t::open_semantic_checking_file(scoped_ptr_t<semantic_check
 }
 #endif
 
+std::string mock_file_opener_t::hot_block_list_file_name() const {
+    // Mock files don't keep a hot block list.
+    return std::string();
+}
+
 }  // namespace unittest
@@ -32,6 +32,9 @@ public:
     void writev_async(int64_t offset, size_t length, scoped_array_t<iovec> &&bufs,
                       file_account_t *account, linux_iocallback_t *cb);
 
+    void datasync_async(linux_iocallback_t *cb);
+    void discard(int64_t offset, int64_t length);
+
     void *create_account(UNUSED int priority, UNUSED int outstanding_requests_limit) {
         // We don't care about accounts.  Return an arbitrary non-null pointer.
         return this;
@@ -41,6 +44,14 @@ public:
         /* do nothing */
     }
 
+    void set_io_weight(UNUSED double weight) {
+        /* do nothing */
+    }
+
+    void set_latency_stats(UNUSED file_latency_stats_t *stats) {
+        /* do nothing */
+    }
+
     bool coop_lock_and_check();
 
 private:
@@ -79,6 +90,7 @@ public:
 #ifdef SEMANTIC_SERIALIZER_CHECK
     void open_semantic_checking_file(scoped_ptr_t<semantic_checking_file_t> *file_out);
 #endif
+    std::string hot_block_list_file_name() const;
 
 private:
     enum existence_state_t { no_file, temporary_file, permanent_file, unlinked_file };
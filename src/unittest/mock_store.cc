@@ -1,6 +1,8 @@
 #include "unittest/mock_store.hpp"
 
 #include "arch/timing.hpp"
+#include "containers/archive/string_stream.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
 #include "rdb_protocol/store.hpp"
 
 namespace unittest {
@@ -22,6 +24,24 @@ read_t mock_read(std::string key) {
     return read_t(pr, profile_bool_t::DONT_PROFILE);
 }
 
+// Backfill atoms carry their values serialized like in the B-tree.
+static std::string serialize_mock_value(const ql::datum_t &value) {
+    write_message_t wm;
+    datum_serialize(&wm, value, ql::check_datum_serialization_errors_t::NO);
+    string_stream_t stream;
+    int res = send_write_message(&stream, &wm);
+    guarantee(res == 0);
+    return std::move(stream.str());
+}
+
+static ql::datum_t deserialize_mock_value(const std::string &data) {
+    string_read_stream_t stream(std::string(data), 0);
+    ql::datum_t value;
+    archive_result_t res = datum_deserialize(&stream, &value);
+    guarantee_deserialization(res, "mock value");
+    return value;
+}
+
 std::string mock_parse_read_response(const read_response_t &rr) {
     const point_read_response_t *prr
         = boost::get<point_read_response_t>(&rr.response);
@@ -136,10 +156,36 @@ void mock_store_t::read(
             nap(rng_.randint(10), interruptor);
         }
 
+        response->n_shards = 1;
+
+        /* Every key counts as a bucket of its own. */
+        const distribution_read_t *distribution_read
+            = boost::get<distribution_read_t>(&read.read);
+        if (distribution_read != NULL) {
+            distribution_read_response_t res;
+            res.region = distribution_read->region;
+            for (auto it = table_.lower_bound(res.region.inner.left);
+                 it != table_.end() && res.region.inner.contains_key(it->first);
+                 ++it) {
+                res.key_counts[it->first] = 1;
+            }
+            response->response = res;
+            return;
+        }
+
+        /* No digests, so the backfiller backfills everything. */
+        const backfill_digest_read_t *digest_read
+            = boost::get<backfill_digest_read_t>(&read.read);
+        if (digest_read != NULL) {
+            backfill_digest_read_response_t res;
+            res.digests.region = digest_read->region;
+            response->response = res;
+            return;
+        }
+
         const point_read_t *point_read = boost::get<point_read_t>(&read.read);
         guarantee(point_read != NULL);
 
-        response->n_shards = 1;
         response->response = point_read_response_t();
         point_read_response_t *res = boost::get<point_read_response_t>(&response->response);
 
@@ -258,8 +304,8 @@ bool mock_store_t::send_backfill(
                         chunk_t::key_value_pairs_t pairs;
                         pairs.backfill_atoms.push_back(
                                 backfill_atom_t(it->first,
-                                                                      it->second.second,
-                                                                      it->second.first));
+                                                serialize_mock_value(it->second.second),
+                                                it->second.first));
                         chunk_t chunk(pairs);
                         send_backfill_cb->send_chunk(chunk, interruptor);
                     }
@@ -295,7 +341,7 @@ void mock_store_t::receive_backfill(
         nap(rng_.randint(10), interruptor);
     }
 
-    table_[atom.key] = std::make_pair(atom.recency, atom.value);
+    table_[atom.key] = std::make_pair(atom.recency, deserialize_mock_value(atom.value));
 
     if (rng_.randint(2) == 0) {
         nap(rng_.randint(10), interruptor);
@@ -47,6 +47,8 @@ public:
             signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t);
 
+    void prefetch_for_write(const write_t &) { }
+
     void write(
             DEBUG_ONLY(const metainfo_checker_t &metainfo_checker, )
             const region_map_t<binary_blob_t> &new_metainfo,
@@ -0,0 +1,28 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <set>
+
+#include "arch/runtime/numa.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(NumaTest, TopologyCoversEveryCpuOnce) {
+    numa_topology_t topology;
+    ASSERT_LE(1, topology.num_nodes());
+
+    std::set<int> seen;
+    size_t total = 0;
+    for (int node = 0; node < topology.num_nodes(); ++node) {
+        const std::vector<int> &cpus = topology.cpus_on_node(node);
+        ASSERT_FALSE(cpus.empty());
+        for (auto it = cpus.begin(); it != cpus.end(); ++it) {
+            ASSERT_TRUE(seen.insert(*it).second);
+            ASSERT_EQ(topology.all_cpus()[total], *it);
+            ASSERT_EQ(node, topology.node_of_cpu_index(total));
+            ++total;
+        }
+    }
+    ASSERT_EQ(total, topology.all_cpus().size());
+}
+
+}  // namespace unittest
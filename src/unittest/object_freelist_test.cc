@@ -0,0 +1,46 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include <set>
+
+#include "containers/object_freelist.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+TPTEST(ObjectFreelistTest, ReusesBlocks) {
+    object_freelist_t freelist(64, 2);
+    void *a = freelist.allocate();
+    void *b = freelist.allocate();
+    void *c = freelist.allocate();
+    ASSERT_TRUE(a != NULL && b != NULL && c != NULL);
+    memset(a, 0, 64);
+
+    freelist.deallocate(a);
+    freelist.deallocate(b);
+    // Only two blocks are kept, so this one goes back to `malloc`.
+    freelist.deallocate(c);
+
+#ifndef VALGRIND
+    std::set<void *> reused;
+    reused.insert(freelist.allocate());
+    reused.insert(freelist.allocate());
+    ASSERT_EQ(1u, reused.count(a));
+    ASSERT_EQ(1u, reused.count(b));
+    for (void *ptr : reused) {
+        freelist.deallocate(ptr);
+    }
+#endif
+}
+
+TEST(ObjectFreelistTest, OutsideThreadPool) {
+    // Outside the thread pool, every block comes from `malloc`.
+    object_freelist_t freelist(16, 10);
+    void *a = freelist.allocate();
+    ASSERT_TRUE(a != NULL);
+    freelist.deallocate(a);
+    freelist.deallocate(NULL);
+}
+
+}  // namespace unittest
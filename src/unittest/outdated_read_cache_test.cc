@@ -0,0 +1,41 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <string>
+
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/datum_string.hpp"
+#include "rdb_protocol/outdated_read_cache.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+const int MAX_AGE_MS = 60 * 1000;
+
+ql::datum_t make_key(const std::string &str) {
+    return ql::datum_t(datum_string_t(str));
+}
+
+TPTEST(OutdatedReadCacheTest, GetPut) {
+    ql::outdated_read_cache_t cache;
+    EXPECT_FALSE(cache.get("t1", make_key("a"), MAX_AGE_MS).has());
+    cache.put("t1", make_key("a"), ql::datum_t(1.0));
+    cache.put("t1", make_key("b"), ql::datum_t::null());
+    EXPECT_EQ(ql::datum_t(1.0), cache.get("t1", make_key("a"), MAX_AGE_MS));
+    EXPECT_EQ(ql::datum_t::null(), cache.get("t1", make_key("b"), MAX_AGE_MS));
+    EXPECT_FALSE(cache.get("t2", make_key("a"), MAX_AGE_MS).has());
+}
+
+TPTEST(OutdatedReadCacheTest, Drop) {
+    ql::outdated_read_cache_t cache;
+    cache.put("t1", make_key("a"), ql::datum_t(1.0));
+    cache.put("t1", make_key("b"), ql::datum_t(2.0));
+    cache.put("t2", make_key("a"), ql::datum_t(3.0));
+    cache.drop("t1", make_key("a"));
+    EXPECT_FALSE(cache.get("t1", make_key("a"), MAX_AGE_MS).has());
+    EXPECT_EQ(ql::datum_t(2.0), cache.get("t1", make_key("b"), MAX_AGE_MS));
+    cache.drop_table("t1");
+    EXPECT_FALSE(cache.get("t1", make_key("b"), MAX_AGE_MS).has());
+    EXPECT_EQ(ql::datum_t(3.0), cache.get("t2", make_key("a"), MAX_AGE_MS));
+}
+
+}  // namespace unittest
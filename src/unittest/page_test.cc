@@ -6,6 +6,7 @@
 #include "buffer_cache/cache_balancer.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/pmap.hpp"
+#include "config/args.hpp"
 #include "containers/scoped.hpp"
 #include "serializer/config.hpp"
 #include "unittest/gtest.hpp"
@@ -46,6 +47,11 @@ void reset_throttler_acq(alt::throttler_acq_t *acq) {
     alt::throttler_acq_t movee(std::move(*acq));
 }
 
+void reset_throttler_acq_and_pulse(cond_t *flushed, alt::throttler_acq_t *acq) {
+    reset_throttler_acq(acq);
+    flushed->pulse();
+}
+
 class test_txn_t;
 
 class test_cache_t : public page_cache_t {
@@ -60,6 +66,14 @@ public:
         flush_and_destroy_txn(std::move(txn), &reset_throttler_acq);
     }
 
+    void flush(scoped_ptr_t<test_txn_t> txn, alt::flush_delay_t flush_delay,
+               cond_t *flushed) {
+        flush_and_destroy_txn(std::move(txn),
+                              std::bind(&reset_throttler_acq_and_pulse, flushed,
+                                        ph::_1),
+                              flush_delay);
+    }
+
     alt::throttler_acq_t make_throttler_acq() {
         // KSI: We could make these tests better by varying the expected change
         // count.
@@ -269,6 +283,56 @@ TPTEST(PageTest, ReadAfterWrite, 4) {
     pmap(2, std::bind(&ReadAfterWrite_cases, &s, &page_cache, ph::_1));
 }
 
+TPTEST(PageTest, PeekPage, 4) {
+    mock_ser_t mock;
+    dummy_cache_balancer_t balancer(GIGABYTE);
+    test_cache_t page_cache(mock.ser.get(), &balancer, mock.throttler.get());
+
+    block_id_t block_id;
+    uint64_t created_version;
+    {
+        auto txn = make_scoped<test_txn_t>(&page_cache);
+        {
+            current_test_acq_t acq(txn.get(), alt_create_t::create);
+            block_id = acq.block_id();
+            test_acq_t page_acq;
+            page_acq.init(acq.current_page_for_write(), &page_cache);
+            memset(page_acq.get_buf_write(), 'a', 10);
+
+            // The creator is still modifying the page.
+            ASSERT_TRUE(page_cache.peek_page(block_id, &created_version) != NULL);
+            ASSERT_EQ(1u, created_version % 2);
+        }
+        page_cache.flush(std::move(txn));
+    }
+
+    uint64_t version;
+    const void *buf = page_cache.peek_page(block_id, &version);
+    ASSERT_TRUE(buf != NULL);
+    ASSERT_EQ(0u, version % 2);
+    ASSERT_EQ('a', static_cast<const char *>(buf)[9]);
+    ASSERT_FALSE(page_cache.peeked_page_is_unchanged(block_id, created_version));
+
+    auto txn = make_scoped<test_txn_t>(&page_cache);
+    {
+        current_test_acq_t acq(txn.get(), block_id, access_t::write);
+        acq.write_acq_signal()->wait();
+        // Holding the page doesn't change it, only modifying it does.
+        ASSERT_TRUE(page_cache.peeked_page_is_unchanged(block_id, version));
+
+        test_acq_t page_acq;
+        page_acq.init(acq.current_page_for_write(), &page_cache);
+        memset(page_acq.get_buf_write(), 'b', 10);
+        ASSERT_FALSE(page_cache.peeked_page_is_unchanged(block_id, version));
+    }
+    page_cache.flush(std::move(txn));
+
+    buf = page_cache.peek_page(block_id, &version);
+    ASSERT_TRUE(buf != NULL);
+    ASSERT_EQ(0u, version % 2);
+    ASSERT_EQ('b', static_cast<const char *>(buf)[9]);
+}
+
 struct WriteWaitForFlush_state_t {
     block_id_t block_id;
     cond_t coro_1_begin;
@@ -315,6 +379,70 @@ TPTEST(PageTest, WriteWaitForFlush, 4) {
     pmap(2, std::bind(&WriteWaitForFlush_cases, &s, &page_cache, ph::_1));
 }
 
+void write_to_block(test_txn_t *txn, page_cache_t *cache, block_id_t block_id,
+                    char value) {
+    current_test_acq_t acq(txn, block_id, access_t::write);
+    test_acq_t page_acq;
+    page_acq.init(acq.current_page_for_write(), cache);
+    page_acq.buf_ready_signal()->wait();
+    static_cast<char *>(page_acq.get_buf_write())[0] = value;
+}
+
+TPTEST(PageTest, DelayedSoftFlush, 4) {
+    mock_ser_t mock;
+    dummy_cache_balancer_t balancer(GIGABYTE);
+    block_id_t block_id;
+    cond_t flushed1, flushed2, flushed3, flushed4, flushed6;
+    {
+        test_cache_t page_cache(mock.ser.get(), &balancer, mock.throttler.get());
+        page_cache.set_soft_flush_delay(MAX_TABLE_SOFT_FLUSH_DELAY_MS);
+        {
+            auto txn = make_scoped<test_txn_t>(&page_cache);
+            {
+                current_test_acq_t acq(txn.get(), alt_create_t::create);
+                block_id = acq.block_id();
+            }
+            page_cache.flush(std::move(txn));
+        }
+
+        // Both soft txns change the block, and get flushed together after the delay.
+        auto txn1 = make_scoped<test_txn_t>(&page_cache);
+        write_to_block(txn1.get(), &page_cache, block_id, 1);
+        page_cache.flush(std::move(txn1), alt::flush_delay_t::soft, &flushed1);
+        auto txn2 = make_scoped<test_txn_t>(&page_cache);
+        write_to_block(txn2.get(), &page_cache, block_id, 2);
+        page_cache.flush(std::move(txn2), alt::flush_delay_t::soft, &flushed2);
+        flushed2.wait();
+        ASSERT_TRUE(flushed1.is_pulsed());
+
+        // An urgent txn that comes after a delayed one doesn't wait for the delay.
+        auto txn3 = make_scoped<test_txn_t>(&page_cache);
+        write_to_block(txn3.get(), &page_cache, block_id, 3);
+        page_cache.flush(std::move(txn3), alt::flush_delay_t::soft, &flushed3);
+        auto txn4 = make_scoped<test_txn_t>(&page_cache);
+        write_to_block(txn4.get(), &page_cache, block_id, 4);
+        page_cache.flush(std::move(txn4), alt::flush_delay_t::urgent, &flushed4);
+        flushed4.wait();
+        ASSERT_TRUE(flushed3.is_pulsed());
+
+        // Destroying the cache ends the delay.
+        auto txn5 = make_scoped<test_txn_t>(&page_cache);
+        write_to_block(txn5.get(), &page_cache, block_id, 5);
+        page_cache.flush(std::move(txn5));
+        auto txn6 = make_scoped<test_txn_t>(&page_cache);
+        write_to_block(txn6.get(), &page_cache, block_id, 6);
+        page_cache.flush(std::move(txn6), alt::flush_delay_t::soft, &flushed6);
+    }
+    ASSERT_TRUE(flushed6.is_pulsed());
+
+    test_cache_t page_cache(mock.ser.get(), &balancer, mock.throttler.get());
+    current_test_acq_t acq(&page_cache, block_id, read_access_t::read);
+    test_acq_t page_acq;
+    page_acq.init(acq.current_page_for_read(), &page_cache);
+    page_acq.buf_ready_signal()->wait();
+    ASSERT_EQ(6, static_cast<const char *>(page_acq.get_buf_read())[0]);
+}
+
 class bigger_test_t {
 public:
     explicit bigger_test_t(uint64_t _memory_limit)
@@ -1182,4 +1310,17 @@ TPTEST(PageTest, BiggerTestNoMemory, 4) {
     test.run();
 }
 
+TEST(PageTest, BackpressureDelay) {
+    // No delay until the unwritten changes are halfway to the limit, then a delay
+    // that grows with them up to a bound.
+    EXPECT_EQ(0, alt_txn_throttler_t::backpressure_delay_ms(0, 4000));
+    EXPECT_EQ(0, alt_txn_throttler_t::backpressure_delay_ms(2000, 4000));
+    const int64_t quarter = alt_txn_throttler_t::backpressure_delay_ms(2500, 4000);
+    const int64_t full = alt_txn_throttler_t::backpressure_delay_ms(4000, 4000);
+    EXPECT_LT(0, quarter);
+    EXPECT_LT(quarter, full);
+    EXPECT_EQ(full, alt_txn_throttler_t::backpressure_delay_ms(9000, 4000));
+    EXPECT_EQ(0, alt_txn_throttler_t::backpressure_delay_ms(10, 0));
+}
+
 }  // namespace unittest
@@ -5,8 +5,11 @@
 
 #include <cmath>  // for std::isnan -- read the comment below.
 
+#include "perfmon/filter.hpp"
+#include "perfmon/histogram.hpp"
 #include "perfmon/perfmon.hpp"
 #include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
 
 namespace unittest {
 
@@ -57,4 +60,79 @@ TEST(PerfmonTest, StddevComputation) {
     }
 }
 
+TEST(PerfmonTest, LatencyHistogramBuckets) {
+    // Buckets cover the values without gaps or overlaps.
+    int bucket = 0;
+    for (uint64_t value = 0; value < 100000; ++value) {
+        int b = latency_histogram_t::bucket_of_value(value);
+        if (b != bucket) {
+            ASSERT_EQ(bucket + 1, b);
+            ASSERT_EQ(value - 1, latency_histogram_t::highest_value_of_bucket(bucket));
+            bucket = b;
+        }
+    }
+    // Every bucket is within 1/LATENCY_HISTOGRAM_SUB_BUCKETS of its values.
+    for (int b = LATENCY_HISTOGRAM_SUB_BUCKETS; b < latency_histogram_t::num_buckets;
+         ++b) {
+        uint64_t lowest = latency_histogram_t::highest_value_of_bucket(b - 1) + 1;
+        uint64_t highest = latency_histogram_t::highest_value_of_bucket(b);
+        ASSERT_EQ(b, latency_histogram_t::bucket_of_value(lowest));
+        ASSERT_EQ(b, latency_histogram_t::bucket_of_value(highest));
+        ASSERT_LE((highest - lowest + 1) * LATENCY_HISTOGRAM_SUB_BUCKETS, lowest);
+    }
+    // Values that are too big go in the last bucket.
+    EXPECT_EQ(latency_histogram_t::num_buckets - 1,
+              latency_histogram_t::bucket_of_value(UINT64_MAX));
+}
+
+TEST(PerfmonTest, LatencyHistogramPercentiles) {
+    latency_histogram_t histogram;
+    EXPECT_EQ(0.0, histogram.percentile(0.5));
+
+    // 1us, 2us, ..., 10000us
+    for (uint64_t us = 1; us <= 10000; ++us) {
+        histogram.record(us * 1000);
+    }
+    EXPECT_EQ(10000u, histogram.count());
+    const double tolerance = 1.0 / LATENCY_HISTOGRAM_SUB_BUCKETS;
+    EXPECT_NEAR(0.005, histogram.percentile(0.5), 0.005 * tolerance);
+    EXPECT_NEAR(0.0099, histogram.percentile(0.99), 0.0099 * tolerance);
+    EXPECT_NEAR(0.00999, histogram.percentile(0.999), 0.00999 * tolerance);
+    EXPECT_EQ(0.01, histogram.percentile(1));
+    EXPECT_EQ(0.01, histogram.max());
+
+    // Merging in a slow outlier moves the tail, but not the median.
+    latency_histogram_t other;
+    other.record(secs_to_ticks(2));
+    histogram.merge(other);
+    EXPECT_EQ(2.0, histogram.max());
+    EXPECT_NEAR(0.005, histogram.percentile(0.5), 0.005 * tolerance);
+    EXPECT_EQ(2.0, histogram.percentile(1));
+}
+
+TPTEST(PerfmonTest, FilteredCollection) {
+    perfmon_collection_t root;
+    perfmon_collection_t table_a, table_b;
+    perfmon_membership_t table_a_membership(&root, &table_a, "table_a");
+    perfmon_membership_t table_b_membership(&root, &table_b, "table_b");
+    perfmon_counter_t reads_a, writes_a, reads_b;
+    perfmon_membership_t reads_a_membership(&table_a, &reads_a, "reads");
+    perfmon_membership_t writes_a_membership(&table_a, &writes_a, "writes");
+    perfmon_membership_t reads_b_membership(&table_b, &reads_b, "reads");
+    ++reads_a;
+
+    // Only `table_a`'s reads are collected, and a regex still matches.
+    perfmon_filter_t filter(std::set<std::vector<std::string> >(
+        { { "table_a", "re.*" } }));
+    void *data = root.begin_filtered_stats(
+        &filter, 0, std::vector<bool>(filter.num_paths(), true));
+    root.visit_stats(data);
+    ql::datum_t stats = filter.filter(root.end_stats(data));
+
+    ASSERT_EQ(1u, stats.obj_size());
+    ql::datum_t table_a_stats = stats.get_field("table_a");
+    ASSERT_EQ(1u, table_a_stats.obj_size());
+    EXPECT_EQ(1, table_a_stats.get_field("reads").as_num());
+}
+
 }  // namespace unittest
@@ -275,6 +275,17 @@ TEST(PreV116Metadata, Migrate) {
         EXPECT_TRUE(post_repli_info.config.write_ack_config.mode ==
             write_ack_config_t::mode_t::single);
         EXPECT_EQ(write_durability_t::HARD, post_repli_info.config.durability);
+        EXPECT_EQ(static_cast<uint32_t>(DEFAULT_BTREE_BLOCK_SIZE),
+                  post_repli_info.config.block_size);
+        EXPECT_FALSE(post_repli_info.config.compress_blocks);
+        EXPECT_EQ(static_cast<uint64_t>(DEFAULT_TABLE_CACHE_RESERVATION),
+                  post_repli_info.config.cache_reservation);
+        EXPECT_EQ(DEFAULT_TABLE_CACHE_WEIGHT, post_repli_info.config.cache_weight);
+        EXPECT_EQ(DEFAULT_TABLE_IO_WEIGHT, post_repli_info.config.io_weight);
+        EXPECT_EQ(static_cast<uint32_t>(DEFAULT_TABLE_SOFT_FLUSH_DELAY_MS),
+                  post_repli_info.config.soft_flush_delay);
+        EXPECT_EQ(static_cast<uint64_t>(DEFAULT_TABLE_INDEX_BUILD_RATE),
+                  post_repli_info.config.index_build_rate);
     }
 
     {
@@ -0,0 +1,31 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/prepared_queries.hpp"
+#include "rdb_protocol/term_walker.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+ql::protob_t<const Term> make_func(ql::r::reql_t &&body) {
+    ql::protob_t<Term> term
+        = ql::r::fun(ql::pb::dummy_var_t::IGNORED, std::move(body)).release_counted();
+    ql::preprocess_term(term.get());
+    return term;
+}
+
+TEST(PreparedQueriesTest, SameTermSameId) {
+    ql::prepared_queries_t prepared;
+    const int64_t id = prepared.prepare(make_func(ql::r::expr(1.0)));
+    EXPECT_EQ(id, prepared.prepare(make_func(ql::r::expr(1.0))));
+    EXPECT_EQ(1u, prepared.size());
+
+    const int64_t other_id = prepared.prepare(make_func(ql::r::expr(2.0)));
+    EXPECT_NE(id, other_id);
+    EXPECT_EQ(2u, prepared.size());
+
+    ASSERT_TRUE(prepared.get(id).has());
+    EXPECT_EQ(boost::optional<size_t>(1), prepared.get(id)->arity());
+    EXPECT_FALSE(prepared.get(other_id + 1).has());
+}
+
+}  // namespace unittest
@@ -1,4 +1,6 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <string.h>
+
 #include "unittest/gtest.hpp"
 #include "rdb_protocol/datum.hpp"
 
@@ -28,4 +30,37 @@ TEST(PrintSecondary, Mangle) {
                 "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb");
 }
 
+ql::datum_t secondary_value_round_trip(const ql::datum_t &value,
+                                       reql_version_t reql_version
+                                           = reql_version_t::LATEST) {
+    store_key_t key(value.print_secondary(reql_version, store_key_t("pkey"), 3));
+    return ql::datum_t::extract_secondary_value(key, reql_version);
+}
+
+TEST(PrintSecondary, ExtractValue) {
+    const double nums[] = { 0.0, -0.0, 1.5, -1.5, 1e300, -1e-300 };
+    for (double num : nums) {
+        ql::datum_t value = secondary_value_round_trip(ql::datum_t(num));
+        ASSERT_TRUE(value.has());
+        ASSERT_EQ(ql::datum_t::R_NUM, value.get_type());
+        // Bit for bit, so that -0.0 stays negative.
+        const double got = value.as_num();
+        ASSERT_EQ(0, memcmp(&num, &got, sizeof(num)));
+    }
+    ql::datum_t str(datum_string_t(std::string("a\0b", 3)));
+    ASSERT_EQ(str, secondary_value_round_trip(str));
+    ASSERT_EQ(ql::datum_t::boolean(false),
+              secondary_value_round_trip(ql::datum_t::boolean(false)));
+
+    // Arrays and truncated keys aren't decoded, and neither are keys without the
+    // terminating NULL byte.
+    std::vector<ql::datum_t> arr;
+    arr.push_back(ql::datum_t(1.0));
+    ASSERT_FALSE(secondary_value_round_trip(
+        ql::datum_t(std::move(arr), ql::configured_limits_t::unlimited)).has());
+    ql::datum_t long_str(datum_string_t(std::string(1000, 'x')));
+    ASSERT_FALSE(secondary_value_round_trip(long_str).has());
+    ASSERT_FALSE(secondary_value_round_trip(str, reql_version_t::v1_13).has());
+}
+
 }  // namespace unittest
@@ -0,0 +1,37 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <vector>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/cond_var.hpp"
+#include "concurrency/priority_mutex.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+TPTEST(PriorityMutexTest, HighPriorityGoesFirst) {
+    priority_mutex_t mutex;
+    std::vector<int> order;
+    cond_t done;
+    int remaining = 4;
+    {
+        priority_mutex_t::acq_t acq(&mutex, false);
+        // Normal waiters 0 and 1 get in line before high-priority waiters 2 and 3.
+        for (int i = 0; i < 4; ++i) {
+            coro_t::spawn_now_dangerously([&, i]() {
+                priority_mutex_t::acq_t waiter_acq(&mutex, i >= 2);
+                order.push_back(i);
+                coro_t::yield();
+                if (--remaining == 0) {
+                    done.pulse();
+                }
+            });
+        }
+        EXPECT_TRUE(order.empty());
+    }
+    done.wait();
+    EXPECT_EQ((std::vector<int>{2, 3, 0, 1}), order);
+    EXPECT_FALSE(mutex.is_locked());
+}
+
+}  // namespace unittest
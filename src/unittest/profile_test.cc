@@ -0,0 +1,62 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/profile.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+// Returns the `n_samples` of the task with the given description in an aggregate
+// profile, or 0 if it isn't there.
+double n_samples_of(const ql::datum_t &profile, const char *description) {
+    for (size_t i = 0; i < profile.arr_size(); ++i) {
+        ql::datum_t task = profile.get(i);
+        if (task.get_field("description").as_str() == description) {
+            return task.get_field("n_samples").as_num();
+        }
+    }
+    return 0;
+}
+
+TEST(ProfileTest, AggregateCountsTasks) {
+    profile::trace_t trace(true);
+    {
+        profile::starter_t outer("Outer.", &trace);
+        profile::sampler_t sampler("Rows.", &trace);
+        for (int i = 0; i < 10; ++i) {
+            profile::starter_t inner("Inner.", &trace);
+            sampler.new_sample();
+        }
+    }
+
+    ql::datum_t profile = trace.as_datum();
+    ASSERT_EQ(2u, profile.arr_size());
+    // The outer task includes the inner ones, so it comes first.
+    EXPECT_EQ("Outer.", profile.get(0).get_field("description").as_str().to_std());
+    EXPECT_EQ(1, n_samples_of(profile, "Outer."));
+    EXPECT_EQ(10, n_samples_of(profile, "Inner."));
+    EXPECT_EQ(0, n_samples_of(profile, "Rows."));
+}
+
+TEST(ProfileTest, AggregateMergesSplits) {
+    profile::event_log_t shard_logs;
+    for (int shard = 0; shard < 2; ++shard) {
+        profile::trace_t shard_trace(true);
+        for (int i = 0; i < 3; ++i) {
+            profile::starter_t read("Read.", &shard_trace);
+        }
+        profile::event_log_t log = std::move(shard_trace).extract_event_log();
+        // One total for the shard, which is all it sends back.
+        EXPECT_EQ(1u, log.size());
+        shard_logs.insert(shard_logs.end(), log.begin(), log.end());
+        shard_logs.push_back(profile::stop_t());
+    }
+
+    profile::trace_t trace(true);
+    {
+        profile::splitter_t splitter(&trace);
+        splitter.give_splits(2, shard_logs);
+    }
+    EXPECT_EQ(6, n_samples_of(trace.as_datum(), "Read."));
+}
+
+}  // namespace unittest
@@ -0,0 +1,74 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <string>
+
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/error.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+class test_target_t : public ql::rcheckable_t {
+public:
+    void runtime_fail(ql::base_exc_t::type_t type,
+                      const char *test, const char *file, int line,
+                      std::string msg) const {
+        ql::runtime_fail(type, test, file, line, msg);
+    }
+};
+
+ql::datum_t parse_iso8601(const std::string &s, const std::string &default_tz = "") {
+    test_target_t target;
+    return ql::pseudo::iso8601_to_time(s, default_tz, &target);
+}
+
+double epoch_time(const ql::datum_t &time) {
+    return ql::pseudo::time_to_epoch_time(time);
+}
+
+std::string time_tz(const ql::datum_t &time) {
+    return ql::pseudo::time_tz(time).as_str().to_std();
+}
+
+TEST(PseudoTimeTest, ParseIso8601) {
+    ql::datum_t t = parse_iso8601("2015-04-02T12:34:56.789-07:00");
+    EXPECT_EQ(1428003296.789, epoch_time(t));
+    EXPECT_EQ("-07:00", time_tz(t));
+
+    EXPECT_EQ(1427932800.0, epoch_time(parse_iso8601("2015-04-02T00:00:00Z")));
+    EXPECT_EQ("+00:00", time_tz(parse_iso8601("2015-04-02T00:00:00Z")));
+    EXPECT_EQ(-0.001, epoch_time(parse_iso8601("1969-12-31T23:59:59.999+00:00")));
+    // Digits after milliseconds are dropped, not rounded.
+    EXPECT_EQ(0.123, epoch_time(parse_iso8601("1970-01-01T00:00:00.123999Z")));
+    EXPECT_EQ("+05:30", time_tz(parse_iso8601("2015-04-02T12+0530")));
+
+    // These forms are parsed by boost rather than directly, and must agree.
+    EXPECT_EQ(epoch_time(t), epoch_time(parse_iso8601("2015-092T12:34:56.789-07:00")));
+    EXPECT_EQ(epoch_time(t), epoch_time(parse_iso8601("20150402T123456.789-0700")));
+    EXPECT_EQ("-04:04", time_tz(parse_iso8601("20150402T1234-0404")));
+    EXPECT_EQ("-04:04", time_tz(parse_iso8601("2015-04-02T12:34-04:04")));
+
+    EXPECT_EQ(1427932800.0, epoch_time(parse_iso8601("2015-04-02", "+00:00")));
+    EXPECT_THROW(parse_iso8601("2015-04-02"), ql::base_exc_t);
+    EXPECT_THROW(parse_iso8601("2015-02-29T00:00:00Z"), ql::base_exc_t);
+    EXPECT_THROW(parse_iso8601("2015-04-02T00:00:00-00:00"), ql::base_exc_t);
+}
+
+TEST(PseudoTimeTest, FormatIso8601) {
+    EXPECT_EQ("2015-04-02T11:40:00.123-07:00",
+              ql::pseudo::time_to_iso8601(
+                  ql::pseudo::make_time(1428000000.123, "-07:00")));
+    EXPECT_EQ("2015-04-03T00:10:00+05:30",
+              ql::pseudo::time_to_iso8601(ql::pseudo::make_time(1428000000, "+05:30")));
+    EXPECT_EQ("1969-12-31T18:29:58.500-05:30",
+              ql::pseudo::time_to_iso8601(ql::pseudo::make_time(-1.5, "-05:30")));
+    // Boost includes the fraction if there are any microseconds at all.
+    EXPECT_EQ("2015-04-02T18:40:00.000+00:00",
+              ql::pseudo::time_to_iso8601(
+                  ql::pseudo::make_time(1428000000.0004, "+00:00")));
+
+    const std::string s = "1653-02-10T06:13:20.250+14:00";
+    EXPECT_EQ(s, ql::pseudo::time_to_iso8601(parse_iso8601(s)));
+}
+
+}  // namespace unittest
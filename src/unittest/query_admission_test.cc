@@ -0,0 +1,110 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "perfmon/perfmon.hpp"
+#include "rdb_protocol/query_admission.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+typedef query_admission_t::ticket_t ticket_t;
+
+TPTEST(QueryAdmissionTest, WaitsForRunningQueries) {
+    perfmon_collection_t collection;
+    rdb_context_t::stats_t stats(&collection);
+    query_admission_t admission(query_admission_t::limits_t(2, 2, 10), &stats);
+    const ip_address_t client("127.0.0.1");
+
+    scoped_ptr_t<ticket_t> first(
+        new ticket_t(&admission, client, query_priority_t::NORMAL));
+    ticket_t second(&admission, client, query_priority_t::NORMAL);
+    ticket_t third(&admission, client, query_priority_t::NORMAL);
+    EXPECT_TRUE(first->admitted_signal()->is_pulsed());
+    EXPECT_TRUE(second.admitted_signal()->is_pulsed());
+    EXPECT_FALSE(third.admitted_signal()->is_pulsed());
+    EXPECT_FALSE(third.is_refused());
+
+    first.reset();
+    EXPECT_TRUE(third.admitted_signal()->is_pulsed());
+}
+
+TPTEST(QueryAdmissionTest, LimitsEachClient) {
+    perfmon_collection_t collection;
+    rdb_context_t::stats_t stats(&collection);
+    query_admission_t admission(query_admission_t::limits_t(10, 1, 10), &stats);
+
+    ticket_t a1(&admission, ip_address_t("10.0.0.1"), query_priority_t::NORMAL);
+    ticket_t a2(&admission, ip_address_t("10.0.0.1"), query_priority_t::NORMAL);
+    ticket_t b1(&admission, ip_address_t("10.0.0.2"), query_priority_t::NORMAL);
+    EXPECT_TRUE(a1.admitted_signal()->is_pulsed());
+    EXPECT_FALSE(a2.admitted_signal()->is_pulsed());
+    EXPECT_TRUE(b1.admitted_signal()->is_pulsed());
+}
+
+TPTEST(QueryAdmissionTest, QuietClientGoesFirst) {
+    perfmon_collection_t collection;
+    rdb_context_t::stats_t stats(&collection);
+    query_admission_t admission(query_admission_t::limits_t(2, 2, 10), &stats);
+    const ip_address_t noisy("10.0.0.1");
+    const ip_address_t quiet("10.0.0.2");
+
+    scoped_ptr_t<ticket_t> running(
+        new ticket_t(&admission, noisy, query_priority_t::NORMAL));
+    ticket_t running2(&admission, noisy, query_priority_t::NORMAL);
+    ticket_t noisy_waiting(&admission, noisy, query_priority_t::NORMAL);
+    ticket_t noisy_waiting2(&admission, noisy, query_priority_t::NORMAL);
+    ticket_t quiet_waiting(&admission, quiet, query_priority_t::NORMAL);
+    EXPECT_FALSE(quiet_waiting.admitted_signal()->is_pulsed());
+
+    // The quiet client came in last, but hasn't had a turn yet.
+    running.reset();
+    EXPECT_TRUE(quiet_waiting.admitted_signal()->is_pulsed());
+    EXPECT_FALSE(noisy_waiting.admitted_signal()->is_pulsed());
+    EXPECT_FALSE(noisy_waiting2.admitted_signal()->is_pulsed());
+}
+
+TPTEST(QueryAdmissionTest, LowPriorityWaitsLonger) {
+    perfmon_collection_t collection;
+    rdb_context_t::stats_t stats(&collection);
+    query_admission_t admission(query_admission_t::limits_t(1, 1, 10), &stats);
+    const ip_address_t low("10.0.0.1");
+    const ip_address_t normal("10.0.0.2");
+
+    scoped_ptr_t<ticket_t> running(
+        new ticket_t(&admission, normal, query_priority_t::NORMAL));
+    scoped_ptr_t<ticket_t> low_waiting(
+        new ticket_t(&admission, low, query_priority_t::LOW));
+    ticket_t low_waiting2(&admission, low, query_priority_t::LOW);
+    scoped_ptr_t<ticket_t> normal_waiting(
+        new ticket_t(&admission, normal, query_priority_t::NORMAL));
+
+    running.reset();
+    EXPECT_TRUE(low_waiting->admitted_signal()->is_pulsed());
+    // A low priority query takes up four turns, so the normal client's query goes
+    // before the low priority client's second one.
+    low_waiting.reset();
+    EXPECT_TRUE(normal_waiting->admitted_signal()->is_pulsed());
+    EXPECT_FALSE(low_waiting2.admitted_signal()->is_pulsed());
+    normal_waiting.reset();
+    EXPECT_TRUE(low_waiting2.admitted_signal()->is_pulsed());
+}
+
+TPTEST(QueryAdmissionTest, RefusesFloodingClient) {
+    perfmon_collection_t collection;
+    rdb_context_t::stats_t stats(&collection);
+    query_admission_t admission(query_admission_t::limits_t(1, 1, 1), &stats);
+    const ip_address_t client("127.0.0.1");
+
+    ticket_t running(&admission, client, query_priority_t::NORMAL);
+    scoped_ptr_t<ticket_t> waiting(
+        new ticket_t(&admission, client, query_priority_t::NORMAL));
+    ticket_t refused(&admission, client, query_priority_t::NORMAL);
+    EXPECT_FALSE(waiting->is_refused());
+    EXPECT_TRUE(refused.is_refused());
+
+    // A waiting query can give up its place.
+    waiting.reset();
+    ticket_t next(&admission, client, query_priority_t::NORMAL);
+    EXPECT_FALSE(next.is_refused());
+}
+
+}  // namespace unittest
@@ -0,0 +1,38 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "config/args.hpp"
+#include "rdb_protocol/query_memory.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+TPTEST(QueryMemory, ReservationsAddUp) {
+    counted_t<ql::query_memory_t> memory = make_counted<ql::query_memory_t>();
+    const int64_t server_bytes = ql::query_memory_t::server_bytes();
+    {
+        ql::query_memory_t::reservation_t a(memory);
+        ql::query_memory_t::reservation_t b(memory);
+        a.add(100);
+        b.add(50);
+        EXPECT_EQ(150u, memory->bytes());
+        EXPECT_EQ(server_bytes + 150, ql::query_memory_t::server_bytes());
+        a.clear();
+        EXPECT_EQ(50u, memory->bytes());
+        EXPECT_FALSE(b.is_over_budget());
+    }
+    EXPECT_EQ(0u, memory->bytes());
+    EXPECT_EQ(server_bytes, ql::query_memory_t::server_bytes());
+}
+
+TPTEST(QueryMemory, OverBudget) {
+    counted_t<ql::query_memory_t> memory = make_counted<ql::query_memory_t>();
+    ql::query_memory_t::reservation_t reservation(memory);
+    reservation.add(QUERY_MEMORY_BUDGET);
+    EXPECT_FALSE(memory->is_over_budget());
+    reservation.add(1);
+    EXPECT_TRUE(memory->is_over_budget());
+    reservation.clear();
+    EXPECT_FALSE(memory->is_over_budget());
+}
+
+}  // namespace unittest
@@ -4,6 +4,7 @@
 #include "arch/io/disk.hpp"
 #include "arch/runtime/coroutines.hpp"
 #include "arch/timing.hpp"
+#include "btree/compaction.hpp"
 #include "btree/operations.hpp"
 #include "buffer_cache/cache_balancer.hpp"
 #include "containers/archive/boost_types.hpp"
@@ -555,4 +556,274 @@ TPTEST(RDBBtree, SindexInterruptionViaStoreDelete) {
     store.reset();
 }
 
+class count_keys_cb_t : public depth_first_traversal_callback_t {
+public:
+    count_keys_cb_t() : count(0) { }
+    done_traversing_t handle_pair(scoped_key_value_t &&) {
+        ++count;
+        return done_traversing_t::NO;
+    }
+    int count;
+};
+
+TPTEST(RDBBtree, EraseSubtrees) {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    dummy_cache_balancer_t balancer(GIGABYTE);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    store_t store(
+            &serializer,
+            &balancer,
+            "unit_test_store",
+            true,
+            &get_global_perfmon_collection(),
+            NULL,
+            &io_backender,
+            base_path_t("."),
+            NULL,
+            generate_uuid());
+
+    insert_rows(0, TOTAL_KEYS_TO_INSERT, &store);
+
+    cond_t dummy_interruptor;
+    key_range_t remaining = key_range_t::universe();
+    for (done_traversing_t done = done_traversing_t::NO;
+         done == done_traversing_t::NO;) {
+        write_token_t token;
+        store.new_write_token(&token);
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        store.acquire_superblock_for_write(repli_timestamp_t::distant_past,
+                                           1,
+                                           write_durability_t::SOFT,
+                                           &token,
+                                           &txn,
+                                           &superblock,
+                                           &dummy_interruptor);
+
+        ASSERT_TRUE(btree_keys_are_within(superblock.get(), key_range_t::universe()));
+        count_keys_cb_t before;
+        btree_depth_first_traversal(superblock.get(), key_range_t::universe(), &before,
+                                    direction_t::FORWARD, release_superblock_t::KEEP);
+        ASSERT_GT(before.count, 0);
+
+        rdb_live_deletion_context_t deletion_context;
+        key_range_t deleted_range;
+        done = rdb_erase_subtrees(key_range_t::universe(), superblock.get(),
+                                  &deletion_context, 2, &deleted_range);
+
+        // Each pass erases some keys from the right end of what's left.
+        ASSERT_FALSE(deleted_range.is_empty());
+        ASSERT_EQ(remaining.right, deleted_range.right);
+        ASSERT_TRUE(remaining.is_superset(deleted_range));
+        remaining.right = key_range_t::right_bound_t(deleted_range.left);
+
+        count_keys_cb_t after;
+        btree_depth_first_traversal(superblock.get(), key_range_t::universe(), &after,
+                                    direction_t::FORWARD, release_superblock_t::KEEP);
+        ASSERT_LT(after.count, before.count);
+        if (done == done_traversing_t::YES) {
+            ASSERT_EQ(0, after.count);
+            ASSERT_EQ(NULL_BLOCK_ID, superblock->get_root_block_id());
+            ASSERT_EQ(key_range_t::universe(), deleted_range);
+        } else {
+            // `deleted_range` is exactly what went away.
+            count_keys_cb_t in_deleted_range;
+            btree_depth_first_traversal(superblock.get(), deleted_range,
+                                        &in_deleted_range, direction_t::FORWARD,
+                                        release_superblock_t::KEEP);
+            ASSERT_EQ(0, in_deleted_range.count);
+            ASSERT_FALSE(btree_keys_are_within(superblock.get(), deleted_range));
+        }
+    }
+
+    // The btree can be used again afterwards.
+    insert_rows(0, 10, &store);
+}
+
+TPTEST(RDBBtree, CompactNodes) {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    dummy_cache_balancer_t balancer(GIGABYTE);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    store_t store(
+            &serializer,
+            &balancer,
+            "unit_test_store",
+            true,
+            &get_global_perfmon_collection(),
+            NULL,
+            &io_backender,
+            base_path_t("."),
+            NULL,
+            generate_uuid());
+
+    insert_rows(0, TOTAL_KEYS_TO_INSERT, &store);
+
+    cond_t dummy_interruptor;
+    store_key_t start = store_key_t::min();
+    int passes = 0;
+    for (done_traversing_t done = done_traversing_t::NO;
+         done == done_traversing_t::NO;) {
+        write_token_t token;
+        store.new_write_token(&token);
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        store.acquire_superblock_for_write(repli_timestamp_t::distant_past,
+                                           1,
+                                           write_durability_t::SOFT,
+                                           &token,
+                                           &txn,
+                                           &superblock,
+                                           &dummy_interruptor);
+
+        const store_key_t previous_start = start;
+        done = btree_compact_nodes(superblock.get(), 1, &start);
+        ++passes;
+        if (done == done_traversing_t::NO) {
+            // Each pass rewrites one leaf and starts the next pass after it.
+            ASSERT_LT(previous_start, start);
+        }
+
+        // Rewriting the nodes doesn't change which keys are in the btree.
+        count_keys_cb_t after;
+        btree_depth_first_traversal(superblock.get(), key_range_t::universe(), &after,
+                                    direction_t::FORWARD, release_superblock_t::KEEP);
+        ASSERT_EQ(TOTAL_KEYS_TO_INSERT, after.count);
+    }
+    ASSERT_LT(1, passes);
+
+    // The btree can be used again afterwards.
+    insert_rows(TOTAL_KEYS_TO_INSERT, TOTAL_KEYS_TO_INSERT + 10, &store);
+}
+
+void truncate_store(store_t *store) {
+    cond_t dummy_interruptor;
+    write_token_t token;
+    store->new_write_token(&token);
+
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> super_block;
+    store->acquire_superblock_for_write(repli_timestamp_t::distant_past,
+                                        1, write_durability_t::SOFT,
+                                        &token, &txn, &super_block, &dummy_interruptor);
+
+    buf_lock_t sindex_block(super_block->expose_buf(),
+                            super_block->get_sindex_block_id(),
+                            access_t::write);
+    store->truncate_data(super_block.get(), &sindex_block);
+}
+
+std::map<sindex_name_t, secondary_index_t> get_sindexes(store_t *store) {
+    cond_t dummy_interruptor;
+    read_token_t token;
+    store->new_read_token(&token);
+
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> super_block;
+    store->acquire_superblock_for_read(&token, &txn, &super_block,
+                                       &dummy_interruptor, false);
+
+    buf_lock_t sindex_block(super_block->expose_buf(),
+                            super_block->get_sindex_block_id(),
+                            access_t::read);
+    std::map<sindex_name_t, secondary_index_t> sindexes;
+    get_secondary_indexes(&sindex_block, &sindexes);
+    return sindexes;
+}
+
+TPTEST(RDBBtree, Truncate) {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    dummy_cache_balancer_t balancer(GIGABYTE);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    store_t store(
+            &serializer,
+            &balancer,
+            "unit_test_store",
+            true,
+            &get_global_perfmon_collection(),
+            NULL,
+            &io_backender,
+            base_path_t("."),
+            NULL,
+            generate_uuid());
+
+    insert_rows(0, TOTAL_KEYS_TO_INSERT, &store);
+    sindex_name_t sindex_name = create_sindex(&store);
+    bring_sindexes_up_to_date(&store, sindex_name);
+    check_keys_are_present(&store, sindex_name);
+
+    truncate_store(&store);
+
+    {
+        cond_t dummy_interruptor;
+        read_token_t token;
+        store.new_read_token(&token);
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        store.acquire_superblock_for_read(&token, &txn, &superblock,
+                                          &dummy_interruptor, false);
+
+        count_keys_cb_t keys;
+        btree_depth_first_traversal(superblock.get(), key_range_t::universe(), &keys,
+                                    direction_t::FORWARD, release_superblock_t::KEEP);
+        ASSERT_EQ(0, keys.count);
+        int64_t population;
+        ASSERT_TRUE(get_btree_population(superblock.get(), &population));
+        ASSERT_EQ(0, population);
+    }
+
+    // The secondary index is still there, empty and ready to use.
+    std::map<sindex_name_t, secondary_index_t> sindexes = get_sindexes(&store);
+    ASSERT_EQ(1, sindexes.count(sindex_name));
+    ASSERT_TRUE(sindexes[sindex_name].is_ready());
+    check_keys_are_NOT_present(&store, sindex_name);
+
+    // The old trees get freed in the background.
+    for (int i = 0; i < 100 && get_sindexes(&store).size() > 1; ++i) {
+        nap(100);
+    }
+    ASSERT_EQ(1, get_sindexes(&store).size());
+
+    insert_rows(0, TOTAL_KEYS_TO_INSERT, &store);
+    check_keys_are_present(&store, sindex_name);
+}
+
 } //namespace unittest
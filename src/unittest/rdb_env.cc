@@ -74,6 +74,21 @@ void mock_namespace_interface_t::read_visitor_t::operator()(const point_read_t &
     }
 }
 
+void mock_namespace_interface_t::read_visitor_t::operator()(
+        const batched_point_read_t &get) {
+    ql::configured_limits_t limits;
+    response->response = batched_point_read_response_t();
+    batched_point_read_response_t &res
+        = boost::get<batched_point_read_response_t>(response->response);
+
+    for (auto it = get.keys.begin(); it != get.keys.end(); ++it) {
+        if (data->find(*it) != data->end()) {
+            res.rows[*it] = ql::to_datum(data->at(*it)->get(), limits,
+                                         reql_version_t::LATEST);
+        }
+    }
+}
+
 void mock_namespace_interface_t::read_visitor_t::operator()(const dummy_read_t &) {
     response->response = dummy_read_response_t();
 }
@@ -118,6 +133,11 @@ void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(
     throw cannot_perform_query_exc_t("unimplemented");
 }
 
+void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(
+        UNUSED const backfill_digest_read_t &bd) {
+    throw cannot_perform_query_exc_t("unimplemented");
+}
+
 void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(
         UNUSED const sindex_list_t &sinner) {
     throw cannot_perform_query_exc_t("unimplemented");
@@ -260,6 +280,10 @@ void NORETURN mock_namespace_interface_t::write_visitor_t::operator()(const sync
     throw cannot_perform_query_exc_t("unimplemented");
 }
 
+void NORETURN mock_namespace_interface_t::write_visitor_t::operator()(const truncate_t &) {
+    throw cannot_perform_query_exc_t("unimplemented");
+}
+
 mock_namespace_interface_t::write_visitor_t::write_visitor_t(std::map<store_key_t, scoped_cJSON_t*> *_data,
                                                              ql::env_t *_env,
                                                              write_response_t *_response) :
@@ -403,6 +427,8 @@ bool test_rdb_env_t::instance_t::table_create(UNUSED const name_string_t &name,
         UNUSED counted_t<const ql::db_t> db,
         UNUSED const table_generate_config_params_t &config_params,
         UNUSED const std::string &primary_key,
+        UNUSED uint32_t block_size,
+        UNUSED bool compress_blocks,
         UNUSED signal_t *local_interruptor,
         UNUSED ql::datum_t *result_out,
         std::string *error_out) {
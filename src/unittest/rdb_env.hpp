@@ -68,6 +68,7 @@ private:
 
     struct read_visitor_t : public boost::static_visitor<void> {
         void operator()(const point_read_t &get);
+        void operator()(const batched_point_read_t &get);
         void operator()(const dummy_read_t &d);
         void NORETURN operator()(const changefeed_subscribe_t &);
         void NORETURN operator()(const changefeed_limit_subscribe_t &);
@@ -77,6 +78,7 @@ private:
         void NORETURN operator()(UNUSED const intersecting_geo_read_t &gr);
         void NORETURN operator()(UNUSED const nearest_geo_read_t &gr);
         void NORETURN operator()(UNUSED const distribution_read_t &dg);
+        void NORETURN operator()(UNUSED const backfill_digest_read_t &bd);
         void NORETURN operator()(UNUSED const sindex_list_t &sl);
         void NORETURN operator()(UNUSED const sindex_status_t &ss);
 
@@ -96,6 +98,7 @@ private:
         void NORETURN operator()(UNUSED const sindex_drop_t &s);
         void NORETURN operator()(UNUSED const sindex_rename_t &s);
         void NORETURN operator()(UNUSED const sync_t &s);
+        void NORETURN operator()(UNUSED const truncate_t &t);
 
         write_visitor_t(std::map<store_key_t, scoped_cJSON_t *> *_data, ql::env_t *_env, write_response_t *_response);
 
@@ -169,8 +172,9 @@ public:
 
         bool table_create(const name_string_t &name, counted_t<const ql::db_t> db,
                 const table_generate_config_params_t &config_params,
-                const std::string &primary_key, signal_t *interruptor,
-                ql::datum_t *result_out, std::string *error_out);
+                const std::string &primary_key, uint32_t block_size,
+                bool compress_blocks, signal_t *interruptor, ql::datum_t *result_out,
+                std::string *error_out);
         bool table_drop(const name_string_t &name, counted_t<const ql::db_t> db,
                 signal_t *interruptor, ql::datum_t *result_out, std::string *error_out);
         bool table_list(counted_t<const ql::db_t> db,
@@ -176,6 +176,52 @@ TEST(RDBProtocol, OvershardedGetSet) {
     run_in_thread_pool_with_namespace_interface(&run_get_set_test, true);
 }
 
+/* `BatchedGet` reads keys from both shards with a single `batched_point_read_t` */
+void run_batched_get_test(namespace_interface_t *nsi, order_source_t *osource) {
+    const std::vector<std::string> stored = { "a", "m", "q" };
+    for (size_t i = 0; i < stored.size(); ++i) {
+        write_t write(
+                point_write_t(store_key_t(stored[i]),
+                              ql::datum_t(static_cast<double>(i))),
+                DURABILITY_REQUIREMENT_DEFAULT,
+                profile_bool_t::PROFILE,
+                ql::configured_limits_t());
+        write_response_t response;
+
+        cond_t interruptor;
+        nsi->write(write, &response, osource->check_in("unittest::run_batched_get_test(rdb_protocol.cc-A)"), &interruptor);
+    }
+
+    std::vector<store_key_t> keys = {
+        store_key_t("a"), store_key_t("b"), store_key_t("m"), store_key_t("q") };
+    read_t read(batched_point_read_t(std::move(keys)), profile_bool_t::PROFILE);
+    read_response_t response;
+
+    cond_t interruptor;
+    nsi->read(read, &response, osource->check_in("unittest::run_batched_get_test(rdb_protocol.cc-B)"), &interruptor);
+
+    if (batched_point_read_response_t *maybe_batched_response = boost::get<batched_point_read_response_t>(&response.response)) {
+        const std::map<store_key_t, ql::datum_t> &rows = maybe_batched_response->rows;
+        ASSERT_EQ(stored.size(), rows.size());
+        for (size_t i = 0; i < stored.size(); ++i) {
+            auto it = rows.find(store_key_t(stored[i]));
+            ASSERT_TRUE(it != rows.end());
+            ASSERT_EQ(ql::datum_t(static_cast<double>(i)), it->second);
+        }
+        ASSERT_TRUE(rows.find(store_key_t("b")) == rows.end());
+    } else {
+        ADD_FAILURE() << "got wrong result back";
+    }
+}
+
+TEST(RDBProtocol, BatchedGet) {
+    run_in_thread_pool_with_namespace_interface(&run_batched_get_test, false);
+}
+
+TEST(RDBProtocol, OvershardedBatchedGet) {
+    run_in_thread_pool_with_namespace_interface(&run_batched_get_test, true);
+}
+
 std::string create_sindex(namespace_interface_t *nsi,
                           order_source_t *osource) {
     std::string id = uuid_to_str(generate_uuid());
@@ -808,7 +854,8 @@ TPTEST(RDBProtocol, ArtificialChangefeeds) {
                     std::map<std::string, std::vector<ql::datum_t> >(),
                     store_key_t(ql::datum_t(static_cast<double>(i)).print_primary()),
                     ql::datum_t(-static_cast<double>(i)),
-                    ql::datum_t(static_cast<double>(i))}));
+                    ql::datum_t(static_cast<double>(i)),
+                    0}));
     }
     cond_t interruptor;
     ql::env_t env(&interruptor, reql_version_t::LATEST);
@@ -0,0 +1,43 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "arch/runtime/runtime.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/read_mostly.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+int read_int(read_mostly_t<int> *rm) {
+    int ret = -1;
+    rm->apply_read([&](const int *value) { ret = *value; });
+    return ret;
+}
+
+TPTEST_MULTITHREAD(ReadMostlyTest, Initial, 4) {
+    read_mostly_t<int> rm(1);
+    for (int thread = 0; thread < get_num_threads(); ++thread) {
+        on_thread_t thread_switcher((threadnum_t(thread)));
+        EXPECT_EQ(1, read_int(&rm));
+        EXPECT_EQ(1, *rm.get());
+    }
+}
+
+TPTEST_MULTITHREAD(ReadMostlyTest, SetReachesEveryThread, 4) {
+    read_mostly_t<int> rm(0);
+    for (int i = 1; i <= 10; ++i) {
+        rm.set(i);
+    }
+    for (int thread = 0; thread < get_num_threads(); ++thread) {
+        on_thread_t thread_switcher((threadnum_t(thread)));
+        int last = read_int(&rm);
+        while (last != 10) {
+            nap(1);
+            const int value = read_int(&rm);
+            // Versions never go backwards.
+            EXPECT_LE(last, value);
+            last = value;
+        }
+    }
+}
+
+}  // namespace unittest
@@ -49,4 +49,16 @@ TEST(RegionMap, Mask) {
     }
 }
 
+TEST(RegionMap, Coalesce) {
+    region_map_t<int> rmap(make_region("a", "z"), 0);
+    rmap.set(make_region("a", "g"), 1);
+    rmap.set(make_region("g", "n"), 1);
+    rmap.set(make_region("n", "z"), 2);
+    ASSERT_EQ(2u, rmap.size());
+    rmap.set(make_region("n", "z"), 1);
+    ASSERT_EQ(1u, rmap.size());
+    EXPECT_TRUE(rmap.get_nth(0).first == make_region("a", "z"));
+    EXPECT_EQ(1, rmap.get_nth(0).second);
+}
+
 }  //namespace unittest
@@ -3,6 +3,7 @@
 
 #include "arch/runtime/thread_pool.hpp"
 #include "arch/timing.hpp"
+#include "concurrency/pmap.hpp"
 #include "containers/scoped.hpp"
 #include "containers/archive/socket_stream.hpp"
 #include "unittest/clustering_utils.hpp"
@@ -453,6 +454,82 @@ TPTEST_MULTITHREAD(RPCConnectivityTest, BinaryData, 3) {
     EXPECT_TRUE(a2.got_spectrum);
 }
 
+/* `BigMessage` makes sure that messages that get sent in fragments arrive whole,
+even with other messages going out in between their fragments. */
+
+class string_test_application_t :
+    public home_thread_mixin_t,
+    public cluster_message_handler_t
+{
+public:
+    explicit string_test_application_t(connectivity_cluster_t *cm) :
+        cluster_message_handler_t(cm, 'G')
+        { }
+    void send(const std::string &message, peer_id_t peer) {
+        class writer_t : public cluster_send_message_write_callback_t {
+        public:
+            explicit writer_t(const std::string *_data) : data(_data) { }
+            virtual ~writer_t() { }
+            void write(write_stream_t *stream) {
+                write_message_t wm;
+                serialize<cluster_version_t::CLUSTER>(&wm, *data);
+                int res = send_write_message(stream, &wm);
+                if (res) { throw fake_archive_exc_t(); }
+            }
+            const std::string *data;
+        } writer(&message);
+        auto_drainer_t::lock_t connection_keepalive;
+        connectivity_cluster_t::connection_t *connection =
+            get_connectivity_cluster()->get_connection(peer, &connection_keepalive);
+        ASSERT_TRUE(connection != NULL);
+        get_connectivity_cluster()->send_message(connection, connection_keepalive,
+                                                 get_message_tag(), &writer);
+    }
+    void on_message(connectivity_cluster_t::connection_t *,
+                    auto_drainer_t::lock_t,
+                    read_stream_t *stream) {
+        std::string message;
+        archive_result_t res
+            = deserialize<cluster_version_t::CLUSTER>(stream, &message);
+        if (bad(res)) { throw fake_archive_exc_t(); }
+        on_thread_t th(home_thread());
+        received.insert(message);
+    }
+    std::set<std::string> received;
+};
+
+TPTEST_MULTITHREAD(RPCConnectivityTest, BigMessage, 3) {
+    connectivity_cluster_t c1, c2;
+    string_test_application_t a1(&c1), a2(&c2);
+    connectivity_cluster_t::run_t cr1(&c1, get_unittest_addresses(), peer_address_t(),
+        ANY_PORT, 0);
+    connectivity_cluster_t::run_t cr2(&c2, get_unittest_addresses(), peer_address_t(),
+        ANY_PORT, 0);
+    cr1.join(get_cluster_local_address(&c2));
+
+    let_stuff_happen();
+
+    // Several fragments' worth of data that doesn't compress.
+    rng_t rng;
+    std::string big;
+    for (size_t i = 0; i < 10 * CLUSTER_MESSAGE_FRAGMENT_SIZE + 1; ++i) {
+        big.push_back(static_cast<char>(rng.randint(256)));
+    }
+    const std::string big_compressible(10 * CLUSTER_MESSAGE_FRAGMENT_SIZE, 'x');
+    std::vector<std::string> messages = { big, big_compressible };
+    for (int i = 0; i < 20; ++i) {
+        messages.push_back(strprintf("small %d", i));
+    }
+
+    pmap(messages.size(), [&](size_t i) {
+        a1.send(messages[i], c2.get_me());
+    });
+
+    let_stuff_happen();
+
+    EXPECT_EQ(std::set<std::string>(messages.begin(), messages.end()), a2.received);
+}
+
 /* `PeerIDSemantics` makes sure that `peer_id_t::is_nil()` works as expected. */
 TPTEST_MULTITHREAD(RPCConnectivityTest, PeerIDSemantics, 3) {
     peer_id_t nil_peer;
@@ -131,6 +131,52 @@ TPTEST(RPCDirectoryTest, MapUpdate) {
         rm2.get_root_view()->get_key(std::make_pair(c1.get_me(), 102)));
 }
 
+/* `MapDelta` tests that big values get through when they're sent as deltas against
+the previous value, including after the key has been deleted and recreated. */
+TPTEST(RPCDirectoryTest, MapDelta) {
+    connectivity_cluster_t c1, c2;
+    directory_map_read_manager_t<int, std::string> rm1(&c1, 'D'), rm2(&c2, 'D');
+    watchable_map_var_t<int, std::string> w1, w2;
+    std::string value(10000, 'a');
+    w1.set_key(101, value);
+    directory_map_write_manager_t<int, std::string>
+        wm1(&c1, 'D', &w1), wm2(&c2, 'D', &w2);
+    connectivity_cluster_t::run_t cr1(&c1, get_unittest_addresses(), peer_address_t(),
+        ANY_PORT, 0);
+    connectivity_cluster_t::run_t cr2(&c2, get_unittest_addresses(), peer_address_t(),
+        ANY_PORT, 0);
+    cr2.join(get_cluster_local_address(&c1));
+    let_stuff_happen();
+    ASSERT_TRUE(boost::optional<std::string>(value) ==
+        rm2.get_root_view()->get_key(std::make_pair(c1.get_me(), 101)));
+
+    value[5000] = 'b';
+    value.insert(7000, "inserted");
+    w1.set_key(101, value);
+    let_stuff_happen();
+    ASSERT_TRUE(boost::optional<std::string>(value) ==
+        rm2.get_root_view()->get_key(std::make_pair(c1.get_me(), 101)));
+
+    value.resize(3000);
+    w1.set_key(101, value);
+    let_stuff_happen();
+    ASSERT_TRUE(boost::optional<std::string>(value) ==
+        rm2.get_root_view()->get_key(std::make_pair(c1.get_me(), 101)));
+
+    w1.delete_key(101);
+    let_stuff_happen();
+    ASSERT_TRUE(boost::optional<std::string>() ==
+        rm2.get_root_view()->get_key(std::make_pair(c1.get_me(), 101)));
+
+    value = std::string(5000, 'c');
+    w1.set_key(101, value);
+    let_stuff_happen();
+    ASSERT_TRUE(boost::optional<std::string>(value) ==
+        rm2.get_root_view()->get_key(std::make_pair(c1.get_me(), 101)));
+    ASSERT_TRUE(boost::optional<std::string>(value) ==
+        rm1.get_root_view()->get_key(std::make_pair(c1.get_me(), 101)));
+}
+
 /* `DestructorRace` tests a nasty race condition that we had at some point. */
 TPTEST(RPCDirectoryTest, DestructorRace) {
     connectivity_cluster_t c;
@@ -222,6 +222,23 @@ TPTEST_MULTITHREAD(RPCSemilatticeTest, MemberView, 3) {
     EXPECT_EQ(9u, foo_view->get().i);
 }
 
+/* `MapChanges` checks that only the entries that differ get sent for maps. */
+TEST(RPCSemilatticeTest, MapChanges) {
+    std::map<std::string, uint64_t> a, b, changes;
+    a["same"] = 1;
+    a["changed"] = 2;
+    a["only_in_a"] = 3;
+    b["same"] = 1;
+    b["changed"] = 4;
+    b["only_in_b"] = 5;
+    changes["stale"] = 6;
+    semilattice_changes(a, b, &changes);
+    std::map<std::string, uint64_t> expected;
+    expected["changed"] = 4;
+    expected["only_in_b"] = 5;
+    EXPECT_TRUE(expected == changes);
+}
+
 }   /* namespace unittest */
 
 #include "rpc/semilattice/semilattice_manager.tcc"
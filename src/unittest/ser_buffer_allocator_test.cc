@@ -0,0 +1,74 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <stdint.h>
+#include <string.h>
+
+#include <set>
+#include <vector>
+
+#include "config/args.hpp"
+#include "serializer/ser_buffer_allocator.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+bool is_device_block_aligned(void *ptr) {
+    return reinterpret_cast<uintptr_t>(ptr) % DEVICE_BLOCK_SIZE == 0;
+}
+
+TPTEST(SerBufferAllocatorTest, BlockSizes) {
+    for (size_t size = MIN_BTREE_BLOCK_SIZE; size <= MAX_BTREE_BLOCK_SIZE; size *= 2) {
+        // Enough buffers to need more than one chunk.
+        const size_t num_buffers = 4 * MEGABYTE / size;
+        std::vector<void *> buffers;
+        for (size_t i = 0; i < num_buffers; ++i) {
+            void *buffer = alloc_ser_buffer(size);
+            ASSERT_TRUE(is_device_block_aligned(buffer));
+            memset(buffer, static_cast<int>(i), size);
+            buffers.push_back(buffer);
+        }
+        // No two buffers overlap.
+        for (size_t i = 0; i < num_buffers; ++i) {
+            const char *buffer = static_cast<const char *>(buffers[i]);
+            for (size_t j = 0; j < size; j += DEVICE_BLOCK_SIZE) {
+                ASSERT_EQ(static_cast<char>(i), buffer[j]);
+            }
+        }
+
+        std::set<void *> freed(buffers.begin(), buffers.end());
+        for (void *buffer : buffers) {
+            free_ser_buffer(buffer);
+        }
+#ifndef VALGRIND
+        // The same thread gets the freed buffers back.
+        for (size_t i = 0; i < num_buffers; ++i) {
+            void *buffer = alloc_ser_buffer(size);
+            ASSERT_EQ(1u, freed.count(buffer));
+            buffers[i] = buffer;
+        }
+#endif
+        for (void *buffer : buffers) {
+            free_ser_buffer(buffer);
+        }
+    }
+}
+
+TPTEST(SerBufferAllocatorTest, OtherSizes) {
+    // Sizes without a size class, like those of compressed blocks, still work.
+    const size_t sizes[] = { DEVICE_BLOCK_SIZE, 3 * DEVICE_BLOCK_SIZE,
+                             MAX_BTREE_BLOCK_SIZE + DEVICE_BLOCK_SIZE };
+    for (size_t size : sizes) {
+        scoped_ser_buffer_t buffer(size);
+        ASSERT_TRUE(is_device_block_aligned(buffer.get()));
+        memset(buffer.get(), 0, size);
+    }
+    free_ser_buffer(NULL);
+}
+
+TEST(SerBufferAllocatorTest, OutsideThreadPool) {
+    scoped_ser_buffer_t buffer(MIN_BTREE_BLOCK_SIZE);
+    ASSERT_TRUE(is_device_block_aligned(buffer.get()));
+    memset(buffer.get(), 0, MIN_BTREE_BLOCK_SIZE);
+}
+
+}  // namespace unittest
@@ -1,5 +1,6 @@
 #include <functional>
 
+#include "arch/io/disk.hpp"
 #include "arch/runtime/starter.hpp"
 #include "concurrency/new_mutex.hpp"
 #include "serializer/buf_ptr.hpp"
@@ -90,5 +91,186 @@ TEST(SerializerTest, AddDeleteRepeatedlyWithIndex) {
     run_in_thread_pool(std::bind(run_AddDeleteRepeatedly, true), 4);
 }
 
+TPTEST(SerializerTest, CompressedBlocks) {
+    mock_file_opener_t file_opener;
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t(DEFAULT_BTREE_BLOCK_SIZE, true));
+
+    const block_id_t block_id = 0;
+    buf_ptr_t buf;
+    {
+        standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                                  &file_opener,
+                                  &get_global_perfmon_collection());
+
+        buf = buf_ptr_t::alloc_zeroed(ser.max_block_size());
+        char *data = static_cast<char *>(buf.cache_data());
+        for (uint32_t i = 0; i < buf.block_size().value(); ++i) {
+            data[i] = 'a' + i % 7;
+        }
+
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+        std::vector<buf_write_info_t> infos;
+        infos.push_back(buf_write_info_t(buf.ser_buffer(), buf.block_size(), block_id));
+
+        struct : public iocallback_t, public cond_t {
+            void on_io_complete() {
+                pulse();
+            }
+        } cb;
+
+        std::vector<counted_t<standard_block_token_t> > tokens
+            = ser.block_writes(infos, account.get(), &cb);
+        cb.wait();
+
+        // The cache sees the block's size before compression.
+        ASSERT_EQ(buf.block_size().ser_value(), tokens[0]->block_size().ser_value());
+
+        std::vector<index_write_op_t> write_ops;
+        write_ops.push_back(index_write_op_t(block_id, tokens[0],
+                                             repli_timestamp_t::distant_past));
+        new_mutex_in_line_t dummy_acq;
+        ser.index_write(&dummy_acq, write_ops);
+    }
+
+    // Read the block back through the LBA of a new serializer.
+    standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                              &file_opener,
+                              &get_global_perfmon_collection());
+    scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+    counted_t<standard_block_token_t> token = ser.index_read(block_id);
+    ASSERT_TRUE(token.has());
+    ASSERT_EQ(buf.block_size().ser_value(), token->block_size().ser_value());
+
+    buf_ptr_t read_buf = ser.block_read(token, account.get());
+    ASSERT_EQ(buf.block_size().ser_value(), read_buf.block_size().ser_value());
+    ASSERT_EQ(0, memcmp(buf.ser_buffer(), read_buf.ser_buffer(),
+                        buf.block_size().ser_value()));
+}
+
+// The serializer serves reads while it's still rebuilding its garbage bookkeeping,
+// and writes wait for that to finish.  Blocks that were read in the meantime must
+// not get garbage collected.
+TPTEST(SerializerTest, ReadsDuringReconstruction) {
+    mock_file_opener_t file_opener;
+    standard_serializer_t::create(&file_opener, standard_serializer_t::static_config_t());
+
+    // Enough blocks to take several reconstruction batches.
+    const block_id_t num_blocks = 3 * LBA_RECONSTRUCTION_BATCH_SIZE;
+    {
+        standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                                  &file_opener,
+                                  &get_global_perfmon_collection());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+
+        std::vector<buf_ptr_t> bufs;
+        std::vector<buf_write_info_t> infos;
+        for (block_id_t i = 0; i < num_blocks; ++i) {
+            bufs.push_back(buf_ptr_t::alloc_zeroed(ser.max_block_size()));
+            *static_cast<block_id_t *>(bufs.back().cache_data()) = i;
+            infos.push_back(buf_write_info_t(bufs.back().ser_buffer(),
+                                             bufs.back().block_size(), i));
+        }
+
+        struct : public iocallback_t, public cond_t {
+            void on_io_complete() {
+                pulse();
+            }
+        } cb;
+        std::vector<counted_t<standard_block_token_t> > tokens
+            = ser.block_writes(infos, account.get(), &cb);
+        cb.wait();
+
+        std::vector<index_write_op_t> write_ops;
+        for (block_id_t i = 0; i < num_blocks; ++i) {
+            write_ops.push_back(index_write_op_t(i, tokens[i],
+                                                 repli_timestamp_t::distant_past));
+        }
+        new_mutex_in_line_t dummy_acq;
+        ser.index_write(&dummy_acq, write_ops);
+    }
+
+    standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                              &file_opener,
+                              &get_global_perfmon_collection());
+    scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+
+    counted_t<standard_block_token_t> token = ser.index_read(num_blocks - 1);
+    ASSERT_TRUE(token.has());
+    {
+        buf_ptr_t buf = ser.block_read(token, account.get());
+        ASSERT_EQ(num_blocks - 1, *static_cast<const block_id_t *>(buf.cache_data()));
+    }
+
+    // Deleting every block waits for the reconstruction, and must leave the one we
+    // still hold a token for readable.
+    std::vector<index_write_op_t> write_ops;
+    for (block_id_t i = 0; i < num_blocks; ++i) {
+        write_ops.push_back(index_write_op_t(i, counted_t<standard_block_token_t>()));
+    }
+    new_mutex_in_line_t dummy_acq;
+    ser.index_write(&dummy_acq, write_ops);
+
+    buf_ptr_t buf = ser.block_read(token, account.get());
+    ASSERT_EQ(num_blocks - 1, *static_cast<const block_id_t *>(buf.cache_data()));
+}
+
+// The blocks reported as hot come back from the next serializer on the same file,
+// in the order they're laid out on disk, without the ones that were deleted.
+TPTEST(SerializerTest, HotBlockList) {
+    temp_file_t temp_file;
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(&file_opener, standard_serializer_t::static_config_t());
+    file_opener.move_serializer_file_to_permanent_location();
+
+    const block_id_t num_blocks = 10;
+    {
+        standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                                  &file_opener,
+                                  &get_global_perfmon_collection());
+        ASSERT_TRUE(ser.hot_block_ids().empty());
+
+        buf_ptr_t buf = buf_ptr_t::alloc_zeroed(ser.max_block_size());
+        scoped_ptr_t<file_account_t> account(ser.make_io_account(1));
+
+        // The blocks get written in the opposite order of their ids.
+        std::vector<buf_write_info_t> infos;
+        for (block_id_t i = 0; i < num_blocks; ++i) {
+            infos.push_back(buf_write_info_t(buf.ser_buffer(), buf.block_size(),
+                                             num_blocks - 1 - i));
+        }
+        struct : public iocallback_t, public cond_t {
+            void on_io_complete() {
+                pulse();
+            }
+        } cb;
+        std::vector<counted_t<standard_block_token_t> > tokens
+            = ser.block_writes(infos, account.get(), &cb);
+        cb.wait();
+
+        std::vector<index_write_op_t> write_ops;
+        for (block_id_t i = 0; i < num_blocks; ++i) {
+            write_ops.push_back(index_write_op_t(num_blocks - 1 - i, tokens[i],
+                                                 repli_timestamp_t::distant_past));
+        }
+        new_mutex_in_line_t dummy_acq;
+        ser.index_write(&dummy_acq, write_ops);
+
+        // Block 2 gets deleted after it had been reported.
+        ser.set_hot_block_ids(std::vector<block_id_t>{2, 5, 7});
+        ser.set_hot_block_ids(std::vector<block_id_t>{3});
+        write_ops.clear();
+        write_ops.push_back(index_write_op_t(2, counted_t<standard_block_token_t>()));
+        new_mutex_in_line_t dummy_acq2;
+        ser.index_write(&dummy_acq2, write_ops);
+    }
+
+    standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                              &file_opener,
+                              &get_global_perfmon_collection());
+    ASSERT_EQ((std::vector<block_id_t>{7, 5, 3}), ser.hot_block_ids());
+}
 
 }  // namespace unittest
@@ -0,0 +1,79 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <string>
+#include <vector>
+
+#include "rdb_protocol/configured_limits.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/datum_string.hpp"
+#include "rdb_protocol/sort_key.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+ql::datum_t make_str(const std::string &str) {
+    return ql::datum_t(datum_string_t(str));
+}
+
+ql::datum_t make_arr(std::vector<ql::datum_t> &&arr) {
+    return ql::datum_t(std::move(arr), ql::configured_limits_t());
+}
+
+int cmp_sign(int x) {
+    return x < 0 ? -1 : (x > 0 ? 1 : 0);
+}
+
+TEST(SortKeyTest, OrdersLikeCmp) {
+    std::vector<ql::datum_t> datums = {
+        ql::datum_t::null(),
+        ql::datum_t::boolean(false),
+        ql::datum_t::boolean(true),
+        ql::datum_t(-1e300),
+        ql::datum_t(-1.0),
+        ql::datum_t(-0.0),
+        ql::datum_t(0.0),
+        ql::datum_t(0.5),
+        ql::datum_t(1.0),
+        ql::datum_t(1e300),
+        make_str(""),
+        make_str("a"),
+        make_str(std::string("a\0", 2)),
+        make_str(std::string("a\0b", 3)),
+        make_str("a\x01"),
+        make_str("ab"),
+        make_str("\xff"),
+        ql::datum_t::empty_array(),
+        make_arr({ql::datum_t(1.0)}),
+        make_arr({ql::datum_t(1.0), ql::datum_t(2.0)}),
+        make_arr({ql::datum_t(2.0)}),
+        make_arr({ql::datum_t::empty_array()}),
+        make_arr({make_str("a")}),
+        make_arr({make_str("a"), ql::datum_t::null()}),
+        make_arr({ql::datum_t::null()})
+    };
+    std::vector<std::string> keys;
+    for (const auto &d : datums) {
+        std::string key;
+        ASSERT_TRUE(encode_sort_key(reql_version_t::LATEST, d, &key));
+        keys.push_back(key);
+    }
+    for (size_t i = 0; i < datums.size(); ++i) {
+        for (size_t j = 0; j < datums.size(); ++j) {
+            EXPECT_EQ(cmp_sign(datums[i].cmp(reql_version_t::LATEST, datums[j])),
+                      cmp_sign(keys[i].compare(keys[j])))
+                << datums[i].print() << " vs. " << datums[j].print();
+        }
+    }
+}
+
+TEST(SortKeyTest, NoKey) {
+    std::string key;
+    EXPECT_FALSE(encode_sort_key(reql_version_t::LATEST,
+                                 ql::datum_t::empty_object(), &key));
+    key.clear();
+    EXPECT_FALSE(encode_sort_key(reql_version_t::LATEST,
+                                 make_arr({ql::datum_t::empty_object()}), &key));
+    key.clear();
+    EXPECT_FALSE(encode_sort_key(reql_version_t::v1_13, ql::datum_t(1.0), &key));
+}
+
+}  // namespace unittest
@@ -0,0 +1,131 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <set>
+#include <string>
+#include <vector>
+
+#include "arch/io/network.hpp"
+#include "concurrency/cond_var.hpp"
+#include "containers/buffer_group.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// Sends many small buffers and a large one, so that `writev()` has to deal with
+// several calls and partial writes.
+TPTEST(TcpConn, WriteBufferGroup) {
+    std::vector<std::string> chunks;
+    for (int i = 0; i < 2000; ++i) {
+        chunks.push_back(std::string(i % 7, 'a' + (i % 26)));
+    }
+    chunks.push_back(std::string(4 * MEGABYTE, 'z'));
+    std::string expected;
+    const_buffer_group_t group;
+    for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+        expected += *it;
+        group.add_buffer(it->size(), it->data());
+    }
+
+    std::string received;
+    cond_t received_all;
+    std::set<ip_address_t> loopback_set;
+    loopback_set.insert(ip_address_t("127.0.0.1"));
+    tcp_listener_t listener(loopback_set, 0,
+        [&](scoped_ptr_t<tcp_conn_descriptor_t> &nconn) {
+            scoped_ptr_t<tcp_conn_t> conn;
+            nconn->make_overcomplicated(&conn);
+            cond_t non_interruptor;
+            std::vector<char> buf(expected.size());
+            conn->read(buf.data(), buf.size(), &non_interruptor);
+            received.assign(buf.data(), buf.size());
+            received_all.pulse();
+        });
+
+    cond_t non_interruptor;
+    tcp_conn_t conn(ip_address_t("127.0.0.1"), listener.get_port(),
+                    &non_interruptor);
+    conn.write(&group, &non_interruptor);
+    received_all.wait();
+
+    ASSERT_EQ(expected.size(), received.size());
+    ASSERT_TRUE(expected == received);
+}
+
+// Reads a stream of length-prefixed messages of growing size, the way the client
+// protocol does, so that reads are served partly from the read buffer and partly
+// straight from the socket.
+TPTEST(TcpConn, ReadMixedSizes) {
+    std::vector<uint32_t> sizes;
+    for (uint32_t size = 1; size <= 2 * MEGABYTE; size = size * 3 + 1) {
+        sizes.push_back(size);
+        sizes.push_back(7);
+    }
+
+    std::vector<std::string> received;
+    cond_t received_all;
+    std::set<ip_address_t> loopback_set;
+    loopback_set.insert(ip_address_t("127.0.0.1"));
+    tcp_listener_t listener(loopback_set, 0,
+        [&](scoped_ptr_t<tcp_conn_descriptor_t> &nconn) {
+            scoped_ptr_t<tcp_conn_t> conn;
+            nconn->make_overcomplicated(&conn);
+            cond_t non_interruptor;
+            for (size_t i = 0; i < sizes.size(); ++i) {
+                uint32_t size;
+                conn->read(&size, sizeof(size), &non_interruptor);
+                std::vector<char> buf(size);
+                conn->read(buf.data(), size, &non_interruptor);
+                received.push_back(std::string(buf.data(), size));
+            }
+            received_all.pulse();
+        });
+
+    cond_t non_interruptor;
+    tcp_conn_t conn(ip_address_t("127.0.0.1"), listener.get_port(),
+                    &non_interruptor);
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        std::string message(sizes[i], 'a' + (i % 26));
+        conn.write_buffered(&sizes[i], sizeof(sizes[i]), &non_interruptor);
+        conn.write_buffered(message.data(), message.size(), &non_interruptor);
+    }
+    conn.flush_buffer(&non_interruptor);
+    received_all.wait();
+
+    ASSERT_EQ(sizes.size(), received.size());
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        ASSERT_TRUE(std::string(sizes[i], 'a' + (i % 26)) == received[i]);
+    }
+}
+
+// Connections accepted by the listeners on the other threads still reach the
+// callback on the listener's own thread.
+TPTEST_MULTITHREAD(TcpConn, ReuseportListener, 4) {
+    const int num_conns = 64;
+    const threadnum_t listener_thread = get_thread_id();
+    int accepted = 0;
+    cond_t accepted_all;
+    std::set<ip_address_t> loopback_set;
+    loopback_set.insert(ip_address_t("127.0.0.1"));
+    tcp_listener_t listener(loopback_set, 0,
+        [&](scoped_ptr_t<tcp_conn_descriptor_t> &nconn) {
+            ASSERT_EQ(listener_thread, get_thread_id());
+            scoped_ptr_t<tcp_conn_t> conn;
+            nconn->make_overcomplicated(&conn);
+            if (++accepted == num_conns) {
+                accepted_all.pulse();
+            }
+        },
+        accept_sharding_t::per_thread);
+
+    cond_t non_interruptor;
+    std::vector<scoped_ptr_t<tcp_conn_t> > conns;
+    for (int i = 0; i < num_conns; ++i) {
+        conns.push_back(make_scoped<tcp_conn_t>(ip_address_t("127.0.0.1"),
+                                                listener.get_port(),
+                                                &non_interruptor));
+    }
+    accepted_all.wait();
+    ASSERT_EQ(num_conns, accepted);
+}
+
+}  // namespace unittest
@@ -243,7 +243,6 @@ void test_cluster_group_t::set_all_blueprints(const blueprint_t &bp) {
 
 scoped_ptr_t<cluster_namespace_interface_t>
 test_cluster_group_t::make_namespace_interface(int i) {
-    std::map<namespace_id_t, std::map<key_range_t, server_id_t> > region_to_primary_maps;
     auto ret = make_scoped<cluster_namespace_interface_t>(
             &test_clusters[i]->mailbox_manager,
             &region_to_primary_maps,
@@ -14,6 +14,7 @@
 #include "containers/scoped.hpp"
 #include "clustering/administration/tables/table_metadata.hpp"
 #include "clustering/reactor/directory_echo.hpp"
+#include "clustering/reactor/namespace_interface.hpp"
 #include "buffer_cache/cache_balancer.hpp"
 #include "rdb_protocol/protocol.hpp"
 #include "rpc/directory/read_manager.hpp"
@@ -53,6 +54,9 @@ public:
 
     rdb_context_t ctx;
 
+    // For the namespace interfaces from `make_namespace_interface()`.
+    read_mostly_t<region_to_primary_maps_t> region_to_primary_maps;
+
     explicit test_cluster_group_t(int n_servers);
     ~test_cluster_group_t();
 
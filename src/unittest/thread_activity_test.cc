@@ -0,0 +1,38 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/runtime/thread_activity.hpp"
+#include "config/args.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(ThreadActivityTest, Windows) {
+    const ticks_t window = THREAD_ACTIVITY_WINDOW_MS * MILLION;
+    thread_activity_stats_t stats;
+    const ticks_t start = stats.window_start;
+
+    stats.record_message(10, NULL);
+    stats.record_message(30, "site");
+    stats.record_message(20, NULL);
+    stats.record_wakeup(start, start + 50, start + 100);
+    EXPECT_EQ(100u, stats.busy_ticks);
+    EXPECT_EQ(50u, stats.callback_ticks);
+    EXPECT_EQ(30u, stats.current_window.longest_message_ticks);
+    EXPECT_STREQ("site", stats.current_window.longest_message_site);
+    EXPECT_EQ(0u, stats.last_window.busy_ticks);
+
+    // The window ends with the next wakeup after it's over.
+    stats.record_wakeup(start + window, start + window, start + window + 5);
+    EXPECT_EQ(105u, stats.last_window.busy_ticks);
+    EXPECT_EQ(30u, stats.last_window.longest_message_ticks);
+    EXPECT_EQ(0u, stats.current_window.busy_ticks);
+    EXPECT_EQ(105u, stats.busy_ticks);
+
+    // A window that was over long ago doesn't describe the last window.
+    stats.record_message(40, NULL);
+    stats.maybe_rotate_window(stats.window_start + 3 * window);
+    EXPECT_EQ(0u, stats.last_window.busy_ticks);
+    EXPECT_EQ(0u, stats.last_window.longest_message_ticks);
+    EXPECT_EQ(0u, stats.current_window.longest_message_ticks);
+}
+
+}  // namespace unittest
@@ -1,7 +1,11 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "unittest/gtest.hpp"
 
+#include <vector>
+
+#include "arch/timer.hpp"
 #include "arch/timing.hpp"
+#include "concurrency/cond_var.hpp"
 #include "concurrency/pmap.hpp"
 #include "unittest/unittest_utils.hpp"
 #include "utils.hpp"
@@ -28,5 +32,67 @@ TPTEST(TimerTest, TestApproximateWaitTimes) {
     pmap(2, walk_wait_times);
 }
 
+class recording_timer_callback_t : public timer_callback_t {
+public:
+    recording_timer_callback_t() : fired_at(-1), remaining(NULL), done(NULL) { }
+    void on_timer() {
+        ASSERT_EQ(-1, fired_at);
+        fired_at = get_ticks();
+        if (--*remaining == 0) {
+            done->pulse();
+        }
+    }
+    int64_t fired_at;
+    int *remaining;
+    cond_t *done;
+};
+
+// The timers in the same tick, in different ticks and in higher levels of the timer wheel,
+// including ones that get canceled, all fire on time.
+TPTEST(TimerTest, WheelFiresOnTime) {
+    const int num_timers = 200;
+    std::vector<int64_t> delays;
+    for (int i = 0; i < num_timers; ++i) {
+        // Up to a bit over 1.3 seconds, which is past the first level of the wheel.
+        delays.push_back(1 + (i * 37) % 1300);
+    }
+    std::vector<recording_timer_callback_t> callbacks(num_timers);
+    std::vector<timer_token_t *> tokens(num_timers);
+    int remaining = num_timers - num_timers / 4;
+    cond_t done;
+    const ticks_t start = get_ticks();
+    for (int i = 0; i < num_timers; ++i) {
+        callbacks[i].remaining = &remaining;
+        callbacks[i].done = &done;
+        tokens[i] = fire_timer_once(delays[i], &callbacks[i]);
+    }
+    for (int i = 0; i < num_timers; i += 4) {
+        cancel_timer(tokens[i]);
+    }
+    done.wait();
+
+    for (int i = 0; i < num_timers; ++i) {
+        if (i % 4 == 0) {
+            EXPECT_EQ(-1, callbacks[i].fired_at);
+        } else {
+            const int64_t diff = callbacks[i].fired_at - static_cast<int64_t>(start);
+            EXPECT_GE(diff, delays[i] * MILLION);
+            EXPECT_LT(diff, (delays[i] + 20) * MILLION);
+        }
+    }
+}
+
+TPTEST(TimerTest, RepeatingTimerCanBeCanceled) {
+    int rings = 0;
+    {
+        repeating_timer_t timer(3, [&]() { ++rings; });
+        nap(50);
+    }
+    EXPECT_GE(rings, 10);
+    EXPECT_LE(rings, 17);
+    const int rings_before = rings;
+    nap(20);
+    EXPECT_EQ(rings_before, rings);
+}
 
 }  // namespace unittest
@@ -85,6 +85,8 @@ temp_file_t::~temp_file_t() {
     EXPECT_TRUE(res1 == 0 || get_errno() == ENOENT);
     const int res2 = ::unlink(name().permanent_path().c_str());
     EXPECT_TRUE(res2 == 0 || get_errno() == ENOENT);
+    const int res3 = ::unlink(name().hot_block_list_path().c_str());
+    EXPECT_TRUE(res3 == 0 || get_errno() == ENOENT);
 }
 
 serializer_filepath_t temp_file_t::name() const {
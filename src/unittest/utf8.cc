@@ -191,4 +191,18 @@ TEST(UTF8ValidationStressTest, OverlongSequences) {
     ASSERT_FALSE(utf8::is_valid("\xf8\x80\x80\x80\x80"));
 }
 
+TEST(UTF8ValidationStressTest, LongAsciiRuns) {
+    // Long enough that the ASCII runs are skipped in blocks.
+    const std::string ascii(40, 'a');
+    ASSERT_TRUE(utf8::is_valid(ascii));
+    ASSERT_TRUE(utf8::is_valid(ascii + "\xc2\xa2" + ascii + "\xe2\x82\xac" + ascii));
+
+    utf8::reason_t reason;
+    ASSERT_FALSE(utf8::is_valid(ascii + "\xff" + ascii, &reason));
+    ASSERT_EQ(40u, reason.position);
+    ASSERT_FALSE(utf8::is_valid(ascii + "\xc2\xa2" + ascii + "\xc2", &reason));
+    ASSERT_EQ(83u, reason.position);
+    ASSERT_STREQ("Expected continuation byte, saw end of string", reason.explanation);
+}
+
 } // namespace unittest
@@ -1,6 +1,9 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include <arpa/inet.h>
 
+#include <set>
+#include <vector>
+
 #include "containers/uuid.hpp"
 #include "unittest/gtest.hpp"
 
@@ -88,5 +91,18 @@ TEST(UuidTest, Sha1) {
     check_sha(empty, empty_expected);
 }
 
+TEST(UuidTest, GenerateUuids) {
+    std::vector<uuid_u> uuids(1000);
+    generate_uuids(uuids.size() - 1, uuids.data());
+    uuids.back() = generate_uuid();
+    std::set<uuid_u> distinct(uuids.begin(), uuids.end());
+    EXPECT_EQ(uuids.size(), distinct.size());
+    for (const uuid_u &uuid : uuids) {
+        // Version 4, RFC 4122 variant.
+        EXPECT_EQ(0x40, uuid.data()[6] & 0xf0);
+        EXPECT_EQ(0x80, uuid.data()[8] & 0xc0);
+    }
+}
+
 
 }  // namespace unittest
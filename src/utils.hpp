@@ -193,6 +193,10 @@ public:
     std::string permanent_path() const { return permanent_path_; }
     std::string temporary_path() const { return temporary_path_; }
 
+    // The serializer keeps a list of the blocks that are worth loading first after a
+    // restart in this file.  It's fine for it to be lost.
+    std::string hot_block_list_path() const { return permanent_path_ + "_hot"; }
+
 private:
     friend serializer_filepath_t unittest::manual_serializer_filepath(const std::string& permanent_path,
                                                                       const std::string& temporary_path);
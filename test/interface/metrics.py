@@ -0,0 +1,71 @@
+#!/usr/bin/env python
+# Copyright 2010-2015 RethinkDB, all rights reserved.
+
+from __future__ import print_function
+
+import os, sys, time
+
+try:
+    from urllib.request import urlopen, Request
+except ImportError:
+    from urllib2 import urlopen, Request
+
+startTime = time.time()
+
+sys.path.append(os.path.abspath(os.path.join(os.path.dirname(__file__), os.path.pardir, 'common')))
+import driver, scenario_common, utils, vcoptparse
+
+# --
+
+op = vcoptparse.OptParser()
+scenario_common.prepare_option_parser_mode_flags(op)
+_, command_prefix, serve_options = scenario_common.parse_mode_flags(op.parse(sys.argv))
+
+r = utils.import_python_driver()
+
+# --
+
+print("Starting a server (%.2fs)" % (time.time() - startTime))
+with driver.Process(files="the_server", output_folder='.', command_prefix=command_prefix, extra_options=serve_options) as server:
+    
+    server.check()
+    conn = r.connect(host=server.host, port=server.driver_port)
+    
+    print("Creating a table (%.2fs)" % (time.time() - startTime))
+    
+    r.db_create("test").run(conn)
+    res = r.db("test").table_create("foo").run(conn)
+    table_id = res["config_changes"][0]["new_val"]["id"]
+    r.db("test").table("foo").wait().run(conn)
+    r.db("test").table("foo").insert([{"id": i} for i in range(10)]).run(conn)
+    
+    url = "http://%s:%d/metrics" % (server.host, server.http_port)
+    
+    print("Fetching metrics in the text format (%.2fs)" % (time.time() - startTime))
+    
+    res = urlopen(url)
+    assert res.info()["Content-Type"].startswith("text/plain"), res.info()
+    text = res.read().decode("utf-8")
+    lines = text.splitlines()
+    assert any(line.startswith("# TYPE ") for line in lines), text
+    assert any('table="%s"' % table_id in line for line in lines), text
+    assert not any(line == "# EOF" for line in lines), text
+    
+    # Every sample has to belong to the family declared before it.
+    family = None
+    for line in lines:
+        if line.startswith("# TYPE "):
+            family = line.split(" ")[2]
+        else:
+            assert family is not None and line.startswith(family), (family, line)
+            float(line.rsplit(" ", 1)[1])
+    
+    print("Fetching metrics in the OpenMetrics format (%.2fs)" % (time.time() - startTime))
+    
+    res = urlopen(Request(url, headers={"Accept": "application/openmetrics-text"}))
+    assert res.info()["Content-Type"].startswith("application/openmetrics-text"), res.info()
+    lines = res.read().decode("utf-8").splitlines()
+    assert lines[-1] == "# EOF", lines[-1]
+    
+    print("Cleaning up (%.2fs)" % (time.time() - startTime))
+print("Done (%.2fs)" % (time.time() - startTime))
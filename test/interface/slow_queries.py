@@ -0,0 +1,58 @@
+#!/usr/bin/env python
+# Copyright 2010-2015 RethinkDB, all rights reserved.
+
+from __future__ import print_function
+
+import pprint, os, sys, time
+
+startTime = time.time()
+
+sys.path.append(os.path.abspath(os.path.join(os.path.dirname(__file__), os.path.pardir, 'common')))
+import driver, scenario_common, utils, vcoptparse
+
+# --
+
+op = vcoptparse.OptParser()
+scenario_common.prepare_option_parser_mode_flags(op)
+_, command_prefix, serve_options = scenario_common.parse_mode_flags(op.parse(sys.argv))
+
+r = utils.import_python_driver()
+
+# --
+
+print("Starting a server (%.2fs)" % (time.time() - startTime))
+with driver.Process(files="the_server", output_folder='.', command_prefix=command_prefix, extra_options=serve_options + ["--slow-query-threshold", "200"]) as server:
+    
+    server.check()
+    conn = r.connect(host=server.host, port=server.driver_port)
+    
+    print("Running a fast and a slow query (%.2fs)" % (time.time() - startTime))
+    
+    assert r.expr("fast").run(conn) == "fast"
+    res = r.js("var start = Date.now(); while (Date.now() - start < 500) { } 'slow'").run(conn)
+    assert res == "slow", res
+    
+    print("Verifying the slow query log (%.2fs)" % (time.time() - startTime))
+    
+    entries = list(r.db("rethinkdb").table("slow_queries").run(conn))
+    pprint.pprint(entries)
+    assert len(entries) == 1, entries
+    
+    entry = entries[0]
+    assert "JAVASCRIPT" in entry["query"]
+    assert entry["server"] == "the_server"
+    assert entry["duration_sec"] >= 0.5
+    assert 0 <= entry["cpu_time_sec"] <= entry["duration_sec"]
+    assert entry["client_address"] is not None
+    
+    print("Verifying that point gets work (%.2fs)" % (time.time() - startTime))
+    
+    assert r.db("rethinkdb").table("slow_queries").get(entry["id"]).run(conn) == entry
+    
+    print("Verifying that the table is read-only (%.2fs)" % (time.time() - startTime))
+    
+    res = r.db("rethinkdb").table("slow_queries").delete().run(conn)
+    assert res["errors"] == 1, res
+    
+    print("Cleaning up (%.2fs)" % (time.time() - startTime))
+print("Done (%.2fs)" % (time.time() - startTime))
@@ -182,6 +182,10 @@ def compare_global_and_individual_stats(global_stats, individual_stats, expected
             assert a['query_engine']['queries_total'] <= b['query_engine']['queries_total']
             assert a['query_engine']['read_docs_total'] <= b['query_engine']['read_docs_total']
             assert a['query_engine']['written_docs_total'] <= b['query_engine']['written_docs_total']
+            for row in [a, b]:
+                latency = row['query_engine']['query_latency']
+                if latency['p50'] is not None:
+                    assert 0 <= latency['p50'] <= latency['p99'] <= latency['p999']
         elif a['id'][0] == 'table':
             assert a['db'] == b['db']
             assert a['table'] == b['table']
@@ -218,6 +222,12 @@ def compare_global_and_individual_stats(global_stats, individual_stats, expected
             assert a['storage_engine']['disk']['space_usage']['metadata_bytes'] >= 0
             assert b['storage_engine']['disk']['space_usage']['data_bytes'] >= 0
             assert b['storage_engine']['disk']['space_usage']['metadata_bytes'] >= 0
+            # latency percentiles cover the last complete interval, so they may be missing
+            for row in [a, b]:
+                for kind in ['read_latency', 'write_latency', 'datasync_latency', 'flush_latency']:
+                    latency = row['storage_engine']['disk'][kind]
+                    if latency['p50'] is not None:
+                        assert 0 <= latency['p50'] <= latency['p99'] <= latency['p999']
         else:
             assert False, "Unrecognized stats row id: %s" % repr(a['id'])
 
@@ -24,7 +24,10 @@ def load_files(file1, file2):
     previous_results = json.loads(f.read())
     f.close()
 
-    compare(results, previous_results)
+    # Exits with 1 if some query got significantly slower, so that this can gate
+    # a release.
+    if compare(results, previous_results):
+        exit(1)
 
 
 if __name__ == "__main__":
@@ -0,0 +1,46 @@
+#!/usr/bin/env python
+# Copyright 2010-2015 RethinkDB, all rights reserved.
+
+'''Compares two result files of `workload.py`:
+    python compare_workloads.py <previous results> <new results>'''
+
+from __future__ import print_function
+
+import json, sys
+
+def change(previous, new):
+    if previous is None or new is None:
+        return '%10s' % '-'
+    if previous == 0:
+        return '%10s' % ('n/a' if new != 0 else '+0.0%')
+    return '%+9.1f%%' % (100.0 * (new - previous) / previous)
+
+def print_row(name, previous, new, key, fmt):
+    p = previous.get(key) if previous is not None else None
+    n = new.get(key) if new is not None else None
+    print('%-28s %12s %12s %s' % (name, fmt % p if p is not None else '-', fmt % n if n is not None else '-', change(p, n)))
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    with open(sys.argv[1]) as f:
+        previous = json.load(f)
+    with open(sys.argv[2]) as f:
+        new = json.load(f)
+    if previous.get('profile') != new.get('profile'):
+        print('Warning: comparing different profiles (%s and %s)' % (previous.get('profile'), new.get('profile')), file=sys.stderr)
+
+    print('%-28s %12s %12s %10s' % ('', 'previous', 'new', 'change'))
+    print_row('throughput (ops/s)', previous, new, 'throughput', '%.1f')
+    print_row('server CPU (us/op)', previous, new, 'server_cpu_us_per_op', '%.1f')
+    sections = [('ops', name) for name in sorted(set(previous['ops']) | set(new['ops']))]
+    if 'changefeed' in previous or 'changefeed' in new:
+        sections.append((None, 'changefeed'))
+    for parent, name in sections:
+        p = (previous[parent] if parent else previous).get(name)
+        n = (new[parent] if parent else new).get(name)
+        for key in ['throughput', 'p50_ms', 'p99_ms', 'p999_ms', 'max_ms']:
+            print_row('%s %s' % (name, key), p, n, key, '%.3f')
+
+if __name__ == '__main__':
+    main()
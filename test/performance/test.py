@@ -1,16 +1,29 @@
 #!/usr/bin/python
 # Copyright 2010-2014 RethinkDB, all rights reserved.
 
+'''Times every query of `queries.py` against a release build and compares the
+results with the previous run in results/.
+
+Each query first runs `--warmup` times untimed, then is timed for up to
+`--time-per-query` seconds or `--executions` runs.  The results are saved as JSON
+with `RESULTS_FORMAT_VERSION`; along with each query's timings they hold the
+server's stats from `rethinkdb.stats` at the end of each phase.  The exit status
+is 1 if a query got significantly slower than in the previous run (see
+`compare` in util.py).
+
+Usage:
+    python test.py [options] [data_dir]'''
+
 from __future__ import print_function
 
 import sys
 import time
 import json
+import optparse
 import os
-import math
 import subprocess
 
-from util import gen_doc, gen_num_docs, compare
+from util import gen_doc, gen_num_docs, compare, summarize, RESULTS_FORMAT_VERSION, xrange
 from queries import constant_queries, table_queries, write_queries, delete_queries
 
 sys.path.append(os.path.abspath(os.path.join(os.path.dirname(__file__), os.path.pardir, 'common')))
@@ -43,12 +56,17 @@ tables = [
     }
 ]
 
-# We execute each query for 60 seconds or 1000 times, whatever comes first
+# By default we execute each query for 60 seconds or 1000 times, whatever comes
+# first, after 10 untimed executions.  These are set from the command line.
 time_per_query = 60 # 1 minute max per query
 executions_per_query = 1000 # 1000 executions max per query
+warmup_executions = 10
+# Multiplies the number of documents `gen_num_docs` inserts into each table.
+dataset_scale = 1.0
 
 # Global variables -- so we don't have to pass them around
 results = {} # Save the time per query (average, min, max etc.)
+resources = {} # The server's stats at the end of each phase
 connection = None
 
 def run_tests(build=None, data_dir='./'):
@@ -66,7 +84,7 @@ def run_tests(build=None, data_dir='./'):
     else:
         print('Testing: %s' % executable_path)
     
-    for settings in servers_settings:
+    for server_index, settings in enumerate(servers_settings):
 
         print("Starting server with cache_size " + str(settings["cache_size"]) + " MB...", end=' ')
         sys.stdout.flush()
@@ -86,10 +104,10 @@ def run_tests(build=None, data_dir='./'):
             # Tests
             execute_read_write_queries(settings["name"])
 
-            if i == 0:
+            if server_index == 0:
                 execute_constant_queries()
 
-    save_compare_results()
+    return save_compare_results()
 
 def init_tables(connection):
     """Create the tables we are going to use"""
@@ -126,11 +144,11 @@ def execute_read_write_queries(suffix):
     sys.stdout.flush()
     for table in tables:
         docs = []
-        num_writes = gen_num_docs(table["size_doc"])
+        num_writes = int(gen_num_docs(table["size_doc"]) * dataset_scale)
         for i in xrange(num_writes):
             docs.append(gen_doc(table["size_doc"], i))
 
-        
+        # The inserts aren't warmed up: each one adds a document to the dataset.
         i = 0
 
         durations = []
@@ -144,14 +162,7 @@ def execute_read_write_queries(suffix):
                 table["ids"].append(result["generated_keys"][0])
             i += 1
 
-        durations.sort()
-        results["single-inserts-" + table["name"] + "-" + suffix] = {
-            "average": (time.time() - start) / i,
-            "min": durations[0],
-            "max": durations[len(durations) - 1],
-            "first_centile": durations[int(math.floor(len(durations) / 100. * 1))],
-            "last_centile": durations[int(math.floor(len(durations) / 100. * 99))]
-        }
+        results["single-inserts-" + table["name"] + "-" + suffix] = summarize(durations, (time.time() - start) / i)
 
         # Save it to know how many batch inserts we did
         single_inserts = i
@@ -176,17 +187,12 @@ def execute_read_write_queries(suffix):
                 result = r.db('test').table(table['name']).insert(docs[i:len(docs)]).run(connection)
                 table["ids"] += result["generated_keys"]
         
-        if num_writes - single_inserts != 0:
-            results["batch-inserts-" + table["name"] + "-" + suffix] = {
-                "average": (end - start) / (count_batch_insert * size_batch),
-                "min": durations[0],
-                "max": durations[len(durations) - 1],
-                "first_centile": durations[int(math.floor(len(durations) / 100. * 1))],
-                "last_centile": durations[int(math.floor(len(durations) / 100. * 99))]
-            }
-        
+        if count_batch_insert != 0:
+            results["batch-inserts-" + table["name"] + "-" + suffix] = summarize(durations, (end - start) / (count_batch_insert * size_batch))
+
         table["ids"].sort()
-    
+
+    resources["inserts-" + suffix] = sample_server_stats(connection)
     print(" Done.")
     sys.stdout.flush()
 
@@ -197,10 +203,13 @@ def execute_read_write_queries(suffix):
     for table in tables:
         for p in xrange(len(write_queries)):
             docs = []
-            num_writes = gen_num_docs(table["size_doc"])
+            num_writes = int(gen_num_docs(table["size_doc"]) * dataset_scale)
             for i in xrange(num_writes):
                 docs.append(gen_doc(table["size_doc"], i))
 
+            for i in xrange(min(warmup_executions, len(table["ids"]))):
+                eval(write_queries[p]["query"]).run(connection)
+
             i = 0
 
             durations = []
@@ -211,19 +220,13 @@ def execute_read_write_queries(suffix):
                 durations.append(time.time() - start_query)
                 i += 1
 
-            durations.sort()
-            results[write_queries[p]["tag"] + "-" + table["name"] + "-" + suffix] = {
-                "average": (time.time() - start) / i,
-                "min": durations[0],
-                "max": durations[len(durations) - 1],
-                "first_centile": durations[int(math.floor(len(durations) / 100. * 1))],
-                "last_centile": durations[int(math.floor(len(durations) / 100. * 99))]
-            }
+            results[write_queries[p]["tag"] + "-" + table["name"] + "-" + suffix] = summarize(durations, (time.time() - start) / i)
 
             i -= 1 # We need i in write_queries[p]["clean"] (to revert only the document we updated)
             # Clean the update
             eval(write_queries[p]["clean"]).run(connection)
 
+    resources["updates-" + suffix] = sample_server_stats(connection)
     print(" Done.")
     sys.stdout.flush()
 
@@ -240,6 +243,10 @@ def execute_read_write_queries(suffix):
             else:
                 max_i = 1
 
+            for i in xrange(warmup_executions):
+                run_to_completion(eval(table_queries[p]["query"]))
+            i = 0
+
             durations = []
             start = time.time()
             while time.time() - start < time_per_query and count < executions_per_query:
@@ -256,22 +263,16 @@ def execute_read_write_queries(suffix):
                         i += 1
                 except:
                     print("Query failed")
-                    print(constant_queries[p])
+                    print(table_queries[p])
                     sys.stdout.flush()
                     break
                 durations.append(time.time() - start_query)
                 count += 1
 
-            durations.sort()
-            results[table_queries[p]["tag"] + "-" + table["name"] + "-" + suffix] = {
-                "average": (time.time() - start) / count,
-                "min": durations[0],
-                "max": durations[len(durations) - 1],
-                "first_centile": durations[int(math.floor(len(durations) / 100. * 1))],
-                "last_centile": durations[int(math.floor(len(durations) / 100. * 99))]
-            }
-
+            if count != 0:
+                results[table_queries[p]["tag"] + "-" + table["name"] + "-" + suffix] = summarize(durations, (time.time() - start) / count)
 
+    resources["reads-" + suffix] = sample_server_stats(connection)
     print(" Done.")
     sys.stdout.flush()
 
@@ -294,19 +295,23 @@ def execute_read_write_queries(suffix):
 
                 i += 1
 
-            durations.sort()
-            results[delete_queries[p]["tag"] + "-" + table["name"] + "-" + suffix] = {
-                "average": (time.time() - start) / i,
-                "min": durations[0],
-                "max": durations[len(durations) - 1],
-                "first_centile": durations[int(math.floor(len(durations) / 100. * 1))],
-                "last_centile": durations[int(math.floor(len(durations) / 100. * 99))]
-            }
-
+            results[delete_queries[p]["tag"] + "-" + table["name"] + "-" + suffix] = summarize(durations, (time.time() - start) / i)
 
+    resources["deletes-" + suffix] = sample_server_stats(connection)
     print(" Done.")
     sys.stdout.flush()
 
+def sample_server_stats(connection):
+    """The `rethinkdb.stats` rows of the server and of its tables, to see what the
+    server was doing at the end of a phase."""
+    return list(r.db('rethinkdb').table('stats').filter(lambda row: r.expr(['server', 'table_server']).contains(row['id'][0])).run(connection))
+
+def run_to_completion(query):
+    cursor = query.run(connection)
+    if isinstance(cursor, r.net.Cursor):
+        list(cursor)
+        cursor.close()
+
 def execute_constant_queries():
     global results
 
@@ -314,48 +319,38 @@ def execute_constant_queries():
     print("Running constant queries...", end=' ')
     sys.stdout.flush()
     for p in xrange(len(constant_queries)):
+        if type(constant_queries[p]) == type(""):
+            query, tag = constant_queries[p], constant_queries[p]
+        else:
+            query, tag = constant_queries[p]["query"], constant_queries[p]["tag"]
+
+        try:
+            for i in xrange(warmup_executions):
+                run_to_completion(eval(query))
+        except:
+            print("Query failed")
+            print(query)
+            sys.stdout.flush()
+            continue
+
         count = 0
         durations = []
         start = time.time()
         while time.time() - start < time_per_query and count < executions_per_query:
             start_query = time.time()
-            if type(constant_queries[p]) == type(""):
-                try:
-                    cursor = eval(constant_queries[p]).run(connection)
-                    if isinstance(cursor, r.net.Cursor):
-                        list(cursor)
-                        cursor.close()
-                except:
-                    print("Query failed")
-                    print(constant_queries[p])
-                    sys.stdout.flush()
-            else:
-                cursor = eval(constant_queries[p]["query"]).run(connection)
-                if isinstance(cursor, r.net.Cursor):
-                    list(cursor)
-                    cursor.close()
+            try:
+                run_to_completion(eval(query))
+            except:
+                print("Query failed")
+                print(query)
+                sys.stdout.flush()
             durations.append(time.time() - start_query)
-            
+
             count += 1
-        
-        durations.sort()
-        if type(constant_queries[p]) == type(""):
-            results[constant_queries[p]] = {
-                "average": (time.time() - start) / count,
-                "min": durations[0],
-                "max": durations[len(durations) - 1],
-                "first_centile": durations[int(math.floor(len(durations) / 100. * 1))],
-                "last_centile": durations[int(math.floor(len(durations) / 100. * 99))]
-            }
-        else:
-            results[constant_queries[p]["tag"]] = {
-                "average": (time.time() - start) / count,
-                "min": durations[0],
-                "max": durations[len(durations) - 1],
-                "first_centile": durations[int(math.floor(len(durations) / 100. * 1))],
-                "last_centile": durations[int(math.floor(len(durations) / 100. * 99))]
-            }
 
+        results[tag] = summarize(durations, (time.time() - start) / count)
+
+    resources["constant"] = sample_server_stats(connection)
     print(" Done.")
     sys.stdout.flush()
 
@@ -369,20 +364,36 @@ def check_driver():
         sys.exit("Please install the C++ backend for the tests.")
 
 def save_compare_results():
-    """Save the current results, and if previous results are available, generate an HTML page with the differences"""
-    global results, str_date
+    """Save the current results, and if previous results are available, generate an HTML page with the differences.
+    Returns the queries that got slower."""
+    global results, resources, str_date
 
-    commit = out = subprocess.Popen(['git', 'log', '-n 1', '--pretty=format:"%H"'], stdout=subprocess.PIPE).communicate()[0]
-    results["hash"] = commit
+    commit = subprocess.Popen(['git', 'log', '-n 1', '--pretty=format:%H'], stdout=subprocess.PIPE).communicate()[0]
+    if not isinstance(commit, str):
+        commit = commit.decode('utf-8')
+    str_date = time.strftime("%y.%m.%d-%H:%M:%S")
+
+    run = {
+        "format_version": RESULTS_FORMAT_VERSION,
+        "hash": commit,
+        "date": str_date,
+        "settings": {
+            "time_per_query": time_per_query,
+            "executions_per_query": executions_per_query,
+            "warmup_executions": warmup_executions,
+            "dataset_scale": dataset_scale
+        },
+        "results": results,
+        "resources": resources
+    }
 
     # Save results
     if not os.path.exists("results"):
         os.makedirs("results")
 
-    str_date = time.strftime("%y.%m.%d-%H:%M:%S")
     f = open("results/result_" + str_date + ".txt", "w")
 
-    str_res = json.dumps(results, indent=2)
+    str_res = json.dumps(run, indent=2, sort_keys=True)
     f.write(str_res)
     f.close()
 
@@ -400,21 +411,38 @@ def save_compare_results():
         last_file = file_paths[-2] # The last file is the one we just saved
 
         f = open(last_file, "r")
-        previous_results = json.loads(f.read())
+        previous_run = json.loads(f.read())
         f.close()
     else:
-        previous_results = {}
+        previous_run = {}
 
-    compare(results, previous_results)
+    return compare(run, previous_run)
 
 
-def main(data_dir):
+def main():
     """Main method"""
+    global time_per_query, executions_per_query, warmup_executions, dataset_scale
+
+    parser = optparse.OptionParser(usage=__doc__)
+    parser.add_option('--build', help='build directory of the server to test')
+    parser.add_option('--time-per-query', type='float', default=time_per_query, help='seconds to time each query for at most (default %default)')
+    parser.add_option('--executions', type='int', default=executions_per_query, help='timed executions of each query at most (default %default)')
+    parser.add_option('--warmup', type='int', default=warmup_executions, help='untimed executions of each query first (default %default)')
+    parser.add_option('--scale', type='float', default=dataset_scale, help='multiplies the number of documents in each table (default %default)')
+    opts, args = parser.parse_args()
+    if len(args) > 1 or opts.time_per_query <= 0 or opts.executions <= 0 or opts.warmup < 0 or opts.scale <= 0:
+        parser.error('invalid arguments')
+
+    time_per_query = opts.time_per_query
+    executions_per_query = opts.executions
+    warmup_executions = opts.warmup
+    dataset_scale = opts.scale
+
     check_driver()
-    run_tests(data_dir=data_dir)
+    regressions = run_tests(build=opts.build, data_dir=args[0] if args else './')
+    if regressions:
+        print("Slower than the previous run: " + ", ".join(sorted(regressions)))
+        sys.exit(1)
 
 if __name__ == "__main__":
-    data_dir = './'
-    if len(sys.argv) > 1:
-        data_dir = sys.argv[1]
-    main(data_dir)
+    main()
@@ -1,5 +1,6 @@
 from __future__ import print_function
 
+import math
 import os
 import random
 import time
@@ -48,8 +49,64 @@ def gen_num_docs(size_doc):
         # 58000 fits in memory for the table with the big cache
         return 30000
 
-def compare(new_results, previous_results):
+# The version of the format `test.py` saves its results in.  Version 1 is
+#   {"format_version": 1, "hash": <commit>, "date": ..., "settings": {...},
+#    "results": {<query>: <summary>}, "resources": {<phase>: <stats rows>}}
+# where each summary is what `summarize` returns.  Files without a
+# "format_version" are from before, and are just {"hash": ..., <query>: <summary>}.
+RESULTS_FORMAT_VERSION = 1
+
+# How many of each query's durations are saved, for `compare`'s significance test.
+MAX_SAVED_SAMPLES = 1000
+
+def summarize(durations, average):
+    """The summary of a query's timed executions; `average` is the time per
+    operation, which isn't the mean duration for batched operations."""
+    durations = sorted(durations)
+    step = max(1, len(durations) // MAX_SAVED_SAMPLES)
+    return {
+        "count": len(durations),
+        "average": average,
+        "min": durations[0],
+        "max": durations[-1],
+        "first_centile": durations[int(math.floor(len(durations) / 100. * 1))],
+        "last_centile": durations[int(math.floor(len(durations) / 100. * 99))],
+        "samples": durations[::step]
+    }
+
+def run_results(run):
+    """The summaries of either version of the results files."""
+    if "format_version" in run:
+        return run["results"]
+    return dict((key, value) for key, value in run.items() if key != "hash")
+
+def welch_p_value(a, b):
+    """The two-sided p-value of Welch's t-test of whether `a` and `b` have the same
+    mean.  It uses the normal approximation of the t distribution, which is close
+    for the hundreds of samples the test usually has."""
+    if len(a) < 2 or len(b) < 2:
+        return None
+    mean_a = sum(a) / float(len(a))
+    mean_b = sum(b) / float(len(b))
+    var_a = sum((x - mean_a) ** 2 for x in a) / (len(a) - 1)
+    var_b = sum((x - mean_b) ** 2 for x in b) / (len(b) - 1)
+    standard_error = math.sqrt(var_a / len(a) + var_b / len(b))
+    if standard_error == 0:
+        return 1.0 if mean_a == mean_b else 0.0
+    t = abs(mean_a - mean_b) / standard_error
+    return math.erfc(t / math.sqrt(2))
+
+# A query regressed if it got this much slower, and the difference is significant.
+REGRESSION_THRESHOLD = 0.2
+SIGNIFICANCE_LEVEL = 0.05
+
+def compare(new_run, previous_run):
+    """Writes an HTML page comparing two runs, and returns the queries that got
+    significantly slower."""
     str_date = time.strftime("%y.%m.%d-%H:%M:%S")
+    new_results = run_results(new_run)
+    previous_results = run_results(previous_run)
+    regressions = []
     
     if not os.path.exists('comparisons'):
         os.mkdir('comparisons')
@@ -82,45 +139,53 @@ def compare(new_results, previous_results):
 			<th>Previous 99 centile q/s</th>
 			<th>99 centile q/s</th>
 			<th>Diff</th>
+			<th>p-value</th>
 			<th>Status</th>
 		</tr></thead>
 		<tbody>
 ''' % {
-        'previous_hash': "Previous hash: " + previous_results["hash"] + "<br/>" if "hash" in previous_results else '',
-        'current_hash': new_results["hash"]
+        'previous_hash': "Previous hash: " + previous_run["hash"] + "<br/>" if "hash" in previous_run else '',
+        'current_hash': new_run["hash"]
     })
 
-    for key in new_results:
-        if key != "hash":
-            
-            reportValues = {
-                'key50': str(key)[:50], 'status_color':'gray', 'status': 'Unknown', 'diff': 'undefined',
-                'inverse_prev_average': 'Unknown',       'inverse_new_average': "%.2f" % (1 / new_results[key]["average"]),
-                'inverse_prev_first_centile': 'Unknown', 'inverse_new_first_centile': "%.2f" % (1 / new_results[key]["first_centile"]),
-                'inverse_prev_last_centile': 'Unknown',  'inverse_new_last_centile': "%.2f" % (1 / new_results[key]["last_centile"])
-            }
-            
-            if key in previous_results:
-                if new_results[key]["average"] > 0:
-                    reportValues['diff'] = 1.0 * (1 / previous_results[key]["average"] - 1 / new_results[key]["average"]) / (1 / new_results[key]["average"])
-                    print(reportValues['diff'], type(reportValues['diff']))
-                    if type(reportValues['diff']) == type(0.):
-                        if(reportValues['diff'] < 0.2):
-                            reportValues['status'] = "Success"
-                            reportValues['status_color'] = "green"
-                        else:
-                            reportValues['status'] = "Fail"
-                            reportValues['status_color'] = "red"
-                        reportValues['diff'] = "%.4f" % reportValues['diff']
+    for key in sorted(new_results):
+
+        reportValues = {
+            'key50': str(key)[:50], 'status_color':'gray', 'status': 'Unknown', 'diff': 'undefined', 'p_value': '-',
+            'inverse_prev_average': 'Unknown',       'inverse_new_average': "%.2f" % (1 / new_results[key]["average"]),
+            'inverse_prev_first_centile': 'Unknown', 'inverse_new_first_centile': "%.2f" % (1 / new_results[key]["first_centile"]),
+            'inverse_prev_last_centile': 'Unknown',  'inverse_new_last_centile': "%.2f" % (1 / new_results[key]["last_centile"])
+        }
+        
+        if key in previous_results:
+            if new_results[key]["average"] > 0:
+                reportValues['diff'] = 1.0 * (1 / previous_results[key]["average"] - 1 / new_results[key]["average"]) / (1 / new_results[key]["average"])
+                # Results from before the samples were saved can only be compared
+                # by the threshold.
+                p_value = welch_p_value(new_results[key].get("samples", []), previous_results[key].get("samples", []))
+                if p_value is not None:
+                    reportValues['p_value'] = "%.4f" % p_value
+                if type(reportValues['diff']) == type(0.):
+                    if reportValues['diff'] < REGRESSION_THRESHOLD:
+                        reportValues['status'] = "Success"
+                        reportValues['status_color'] = "green"
+                    elif p_value is not None and p_value >= SIGNIFICANCE_LEVEL:
+                        reportValues['status'] = "Noise"
+                        reportValues['status_color'] = "yellow"
                     else:
-                        reportValues['status'] = "Bug"
-                    
-                    reportValues['inverse_prev_average'] = "%.2f" % (1 / previous_results[key]["average"])
-                    reportValues['inverse_prev_first_centile'] =  "%.2f" % (1 / previous_results[key]["first_centile"])
-                    reportValues['inverse_prev_last_centile'] = "%.2f" % (1 / previous_results[key]["last_centile"])
-            
-            try:
-                f.write('''			<tr>
+                        reportValues['status'] = "Fail"
+                        reportValues['status_color'] = "red"
+                        regressions.append(key)
+                    reportValues['diff'] = "%.4f" % reportValues['diff']
+                else:
+                    reportValues['status'] = "Bug"
+                
+                reportValues['inverse_prev_average'] = "%.2f" % (1 / previous_results[key]["average"])
+                reportValues['inverse_prev_first_centile'] =  "%.2f" % (1 / previous_results[key]["first_centile"])
+                reportValues['inverse_prev_last_centile'] = "%.2f" % (1 / previous_results[key]["last_centile"])
+        
+        try:
+            f.write('''			<tr>
 				<td>%(key50)s</td>
 				<td>%(inverse_prev_average)s</td>
 				<td>%(inverse_new_average)s</td>
@@ -129,11 +194,12 @@ def compare(new_results, previous_results):
 				<td>%(inverse_prev_last_centile)s</td>
 				<td>%(inverse_new_last_centile)s</td>
 				<td>%(diff)s</td>
+				<td>%(p_value)s</td>
 				<td style='background: %(status_color)s'>%(status)s</td>
 			</tr>
 ''' % reportValues)
-            except Exception as e:
-                print(key, str(e))
+        except Exception as e:
+            print(key, str(e))
 
     f.write('''		</tbody>
 	</table>
@@ -143,3 +209,4 @@ def compare(new_results, previous_results):
     f.close()
 
     print("HTML file saved in comparisons/comparison_" + str_date + ".html")
+    return regressions
@@ -0,0 +1,287 @@
+#!/usr/bin/env python
+# Copyright 2010-2015 RethinkDB, all rights reserved.
+
+'''Runs a ReQL workload at a fixed offered load and reports the latencies as JSON.
+
+Requests are scheduled at fixed intervals, and each request's latency is measured
+from when it was scheduled to be sent rather than from when it actually was, so
+that a server that stalls gets charged for the requests that queued up behind the
+stall (the "coordinated omission" correction). The server's CPU time per operation
+is reported too when the server was started by this script.
+
+Examples:
+    python workload.py --profile ycsb-a --rate 2000 --duration 60
+    python workload.py --profile changefeed --host localhost --port 28015
+    python workload.py --list-profiles
+
+Use `compare_workloads.py` to compare two result files.'''
+
+from __future__ import print_function
+
+import json, optparse, os, random, sys, threading, time
+
+sys.path.append(os.path.abspath(os.path.join(os.path.dirname(__file__), os.path.pardir, 'common')))
+import driver, utils
+
+r = utils.import_python_driver()
+
+db_name = 'workload'
+table_name = 'usertable'
+
+# -- operations
+
+def op_read(conn, rng, opts):
+    r.db(db_name).table(table_name).get(pick_key(rng, opts)).run(conn)
+
+def op_update(conn, rng, opts):
+    r.db(db_name).table(table_name).get(pick_key(rng, opts)).update({'field0': random_value(rng, opts), 'ts': time.time()}).run(conn, durability=opts.durability)
+
+def op_insert(conn, rng, opts):
+    r.db(db_name).table(table_name).insert(make_doc(rng.randint(opts.keys, 2 * opts.keys), rng, opts), conflict='replace').run(conn, durability=opts.durability)
+
+def op_read_modify_write(conn, rng, opts):
+    key = pick_key(rng, opts)
+    r.db(db_name).table(table_name).get(key).run(conn)
+    r.db(db_name).table(table_name).get(key).update({'field0': random_value(rng, opts), 'ts': time.time()}).run(conn, durability=opts.durability)
+
+def op_scan(conn, rng, opts):
+    start = pick_key(rng, opts)
+    list(r.db(db_name).table(table_name).between(start, start + opts.scan_length).run(conn))
+
+def op_group(conn, rng, opts):
+    r.db(db_name).table(table_name).group('bucket').count().run(conn)
+
+# Each profile maps operations to their share of the requests. YCSB workload D's
+# "read latest" distribution is left out; its reads and inserts are uniform here.
+profiles = {
+    'ycsb-a': {op_read: 50, op_update: 50},
+    'ycsb-b': {op_read: 95, op_update: 5},
+    'ycsb-c': {op_read: 100},
+    'ycsb-d': {op_read: 95, op_insert: 5},
+    'ycsb-e': {op_scan: 95, op_insert: 5},
+    'ycsb-f': {op_read: 50, op_read_modify_write: 50},
+    'scan': {op_scan: 90, op_update: 10},
+    'group': {op_group: 10, op_read: 60, op_update: 30},
+    # The updates are timed like any other request, and the `changefeed` section of
+    # the results has the delay between each update and its change arriving.
+    'changefeed': {op_update: 100}
+}
+
+def op_name(op):
+    return op.__name__[len('op_'):]
+
+# -- data
+
+def pick_key(rng, opts):
+    if opts.distribution == 'zipf':
+        # Python has no bounded zipf generator; `paretovariate` has the same tail.
+        return min(int(rng.paretovariate(opts.zipf_alpha)) - 1, opts.keys - 1)
+    return rng.randint(0, opts.keys - 1)
+
+def random_value(rng, opts):
+    return ''.join(rng.choice('abcdefghijklmnopqrstuvwxyz') for _ in range(opts.value_size))
+
+def make_doc(key, rng, opts):
+    return {'id': key, 'bucket': key % 100, 'field0': random_value(rng, opts), 'ts': time.time()}
+
+def load_data(conn, opts):
+    if db_name in r.db_list().run(conn):
+        r.db_drop(db_name).run(conn)
+    r.db_create(db_name).run(conn)
+    r.db(db_name).table_create(table_name).run(conn)
+    r.db(db_name).table(table_name).wait().run(conn)
+    rng = random.Random(0)
+    batch_size = 1000
+    for start in range(0, opts.keys, batch_size):
+        docs = [make_doc(key, rng, opts) for key in range(start, min(start + batch_size, opts.keys))]
+        r.db(db_name).table(table_name).insert(docs, durability='soft').run(conn)
+
+# -- measurement
+
+class LatencyRecorder(object):
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.latencies = {}
+        self.errors = {}
+
+    def record(self, name, latency):
+        with self.lock:
+            self.latencies.setdefault(name, []).append(latency)
+
+    def record_error(self, name):
+        with self.lock:
+            self.errors[name] = self.errors.get(name, 0) + 1
+
+def summarize(latencies, duration):
+    latencies = sorted(latencies)
+    def percentile(fraction):
+        return latencies[min(len(latencies) - 1, int(fraction * len(latencies)))]
+    return {
+        'count': len(latencies),
+        'throughput': len(latencies) / duration,
+        'mean_ms': 1000 * sum(latencies) / len(latencies),
+        'p50_ms': 1000 * percentile(0.5),
+        'p90_ms': 1000 * percentile(0.9),
+        'p99_ms': 1000 * percentile(0.99),
+        'p999_ms': 1000 * percentile(0.999),
+        'max_ms': 1000 * latencies[-1]
+    }
+
+def server_cpu_secs(pid):
+    '''Returns the user and system CPU time of the process, or None if it's unknown.'''
+    if pid is None:
+        return None
+    try:
+        with open('/proc/%d/stat' % pid) as f:
+            # The process name may contain spaces, but not a ')'.
+            fields = f.read().rsplit(')', 1)[1].split()
+        return (int(fields[11]) + int(fields[12])) / float(os.sysconf('SC_CLK_TCK'))
+    except (IOError, OSError):
+        return None
+
+def run_client(host, port, opts, ops, rate, start_time, end_time, record_from, recorder, seed):
+    conn = r.connect(host=host, port=port)
+    rng = random.Random(seed)
+    choices = []
+    for op, weight in ops.items():
+        choices.extend([op] * weight)
+    interval = 1.0 / rate
+    intended = start_time + rng.random() * interval
+    while intended < end_time:
+        now = time.time()
+        if now < intended:
+            time.sleep(intended - now)
+        op = rng.choice(choices)
+        try:
+            op(conn, rng, opts)
+        except r.RqlError:
+            recorder.record_error(op_name(op))
+        else:
+            if intended >= record_from:
+                recorder.record(op_name(op), time.time() - intended)
+        intended += interval
+    conn.close()
+
+def run_changefeed(host, port, stop_event, record_from, recorder):
+    conn = r.connect(host=host, port=port)
+    feed = r.db(db_name).table(table_name).changes()['new_val']['ts'].run(conn)
+    try:
+        for ts in feed:
+            now = time.time()
+            if ts >= record_from:
+                recorder.record('changefeed', now - ts)
+            if stop_event.is_set():
+                break
+    except r.RqlDriverError:
+        pass
+
+def run_workload(host, port, opts, server_pid):
+    ops = profiles[opts.profile]
+    conn = r.connect(host=host, port=port)
+    if not opts.no_load:
+        print('Loading %d documents...' % opts.keys, file=sys.stderr)
+        load_data(conn, opts)
+
+    recorder = LatencyRecorder()
+    stop_event = threading.Event()
+    start_time = time.time() + 1
+    record_from = start_time + opts.warmup
+    end_time = record_from + opts.duration
+
+    feed_thread = None
+    if opts.profile == 'changefeed':
+        feed_thread = threading.Thread(target=run_changefeed, args=(host, port, stop_event, record_from, recorder))
+        feed_thread.daemon = True
+        feed_thread.start()
+
+    clients = [threading.Thread(target=run_client, args=(host, port, opts, ops, float(opts.rate) / opts.clients, start_time, end_time, record_from, recorder, i)) for i in range(opts.clients)]
+    for client in clients:
+        client.start()
+
+    print('Running %s at %d ops/s for %d s after %d s of warmup...' % (opts.profile, opts.rate, opts.duration, opts.warmup), file=sys.stderr)
+    while time.time() < record_from:
+        time.sleep(0.1)
+    cpu_start = server_cpu_secs(server_pid)
+    for client in clients:
+        client.join()
+    cpu_end = server_cpu_secs(server_pid)
+    duration = time.time() - record_from
+    stop_event.set()
+    # Wake the changefeed up, in case nothing else is writing.
+    if feed_thread is not None:
+        r.db(db_name).table(table_name).get(0).update({'ts': time.time()}).run(conn)
+        feed_thread.join(5)
+
+    results = {
+        'profile': opts.profile,
+        'offered_rate': opts.rate,
+        'clients': opts.clients,
+        'keys': opts.keys,
+        'value_size': opts.value_size,
+        'distribution': opts.distribution,
+        'duration_secs': duration,
+        'ops': dict((name, summarize(latencies, duration)) for name, latencies in recorder.latencies.items() if name != 'changefeed'),
+        'errors': recorder.errors,
+        'server_cpu_secs': None,
+        'server_cpu_us_per_op': None
+    }
+    total = sum(op['count'] for op in results['ops'].values())
+    results['throughput'] = total / duration
+    if 'changefeed' in recorder.latencies:
+        results['changefeed'] = summarize(recorder.latencies['changefeed'], duration)
+    if cpu_start is not None and cpu_end is not None:
+        results['server_cpu_secs'] = cpu_end - cpu_start
+        if total > 0:
+            results['server_cpu_us_per_op'] = 1e6 * (cpu_end - cpu_start) / total
+    return results
+
+# --
+
+def main():
+    parser = optparse.OptionParser(usage=__doc__)
+    parser.add_option('--profile', default='ycsb-a', choices=sorted(profiles.keys()), help='workload profile (default ycsb-a)')
+    parser.add_option('--list-profiles', action='store_true', help='list the profiles and exit')
+    parser.add_option('--rate', type='int', default=1000, help='offered load, in operations per second (default 1000)')
+    parser.add_option('--clients', type='int', default=16, help='concurrent connections (default 16)')
+    parser.add_option('--duration', type='int', default=30, help='seconds to measure for (default 30)')
+    parser.add_option('--warmup', type='int', default=5, help='seconds to run before starting to measure (default 5)')
+    parser.add_option('--keys', type='int', default=100000, help='documents to load (default 100000)')
+    parser.add_option('--value-size', type='int', default=100, help='size of each document\'s field (default 100)')
+    parser.add_option('--scan-length', type='int', default=100, help='documents per scan (default 100)')
+    parser.add_option('--distribution', default='uniform', choices=['uniform', 'zipf'], help='key distribution (default uniform)')
+    parser.add_option('--zipf-alpha', type='float', default=1.0, help='skew of the zipf distribution (default 1.0)')
+    parser.add_option('--durability', default='hard', choices=['hard', 'soft'], help='durability of the writes (default hard)')
+    parser.add_option('--no-load', action='store_true', help='reuse the data of a previous run')
+    parser.add_option('--host', help='run against this server instead of starting one')
+    parser.add_option('--port', type='int', default=28015, help='driver port of --host (default 28015)')
+    parser.add_option('--build', help='build directory of the server to start')
+    parser.add_option('--cache-size', type='int', default=1024, help='cache size of the server to start, in MB (default 1024)')
+    parser.add_option('--output', help='write the results here instead of to stdout')
+    opts, args = parser.parse_args()
+
+    if opts.list_profiles:
+        for name in sorted(profiles.keys()):
+            print('%-10s %s' % (name, ', '.join('%d%% %s' % (weight, op_name(op)) for op, weight in sorted(profiles[name].items(), key=lambda x: -x[1]))))
+        return
+    if args or opts.rate <= 0 or opts.clients <= 0 or opts.rate < opts.clients:
+        parser.error('invalid arguments')
+
+    if opts.host is not None:
+        results = run_workload(opts.host, opts.port, opts, None)
+    else:
+        executable_path = utils.find_rethinkdb_executable() if opts.build is None else os.path.realpath(os.path.join(opts.build, 'rethinkdb'))
+        if not os.path.basename(os.path.dirname(executable_path)).startswith('release'):
+            sys.stderr.write('Warning: Testing a non-release build: %s\n' % executable_path)
+        with driver.Process(executable_path=executable_path, extra_options=['--cache-size', str(opts.cache_size)]) as server:
+            results = run_workload(server.host, server.driver_port, opts, server.process.pid)
+        results['executable'] = executable_path
+
+    output = json.dumps(results, indent=4, sort_keys=True)
+    if opts.output is None:
+        print(output)
+    else:
+        with open(opts.output, 'w') as f:
+            f.write(output + '\n')
+
+if __name__ == '__main__':
+    main()